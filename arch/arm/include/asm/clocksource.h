@@ -0,0 +1,20 @@
+#ifndef _ASM_CLOCKSOURCE_H
+#define _ASM_CLOCKSOURCE_H
+
+/*
+ * What the vDSO needs to read a clocksource from user space: the
+ * physical page holding the 32-bit counter register, its offset in
+ * that page, and the bias and shift turning the raw count into the
+ * value ->read() returns.  A zero vdso_phys leaves the clocksource
+ * to the syscall.
+ */
+struct arch_clocksource_data {
+	phys_addr_t vdso_phys;
+	u32 vdso_offset;
+	u32 vdso_bias;
+	u8 vdso_shift;
+	bool vdso_unstable;
+	bool vdso_stopped;
+};
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * linux/arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __ASM_NEON_H
+#define __ASM_NEON_H
+
+#include <linux/types.h>
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * NEON may only be used by the kernel between these two calls, and only
+ * from process context.  Code built with NEON enabled must not be called
+ * outside of such a section.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+/* Claims NEON only if that needs no save of live state, see vfpmodule.c */
+bool kernel_neon_try_begin(void);
+
+#endif
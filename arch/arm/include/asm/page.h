@@ -131,7 +131,14 @@ extern void __cpu_copy_user_highpage(struct page *to, struct page *from,
 #define copy_user_highpage(to,from,vaddr,vma)	\
 	__cpu_copy_user_highpage(to, from, vaddr, vma)
 
+#ifdef CONFIG_ARM_PAGE_NEON
+extern void neon_clear_page(void *page);
+extern void neon_copy_page(void *to, const void *from);
+#define clear_page(page)	neon_clear_page((void *)(page))
+#define copy_page(to, from)	neon_copy_page(to, from)
+#else
 #define clear_page(page)	memset((void *)(page), 0, PAGE_SIZE)
+#endif
 extern void copy_page(void *to, const void *from);
 
 #define __HAVE_ARCH_GATE_AREA 1
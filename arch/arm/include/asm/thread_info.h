@@ -43,6 +43,17 @@ struct cpu_context_save {
 	__u32	extra[2];		
 };
 
+#ifdef CONFIG_MSM_L2_TASK_STATS
+/* Krait L2 traffic charged to the task at context switch */
+struct l2_task_stats {
+	__u64	misses;
+	__u64	bus;
+	/* Per ms on the CPU, averaged over the last few slices */
+	__u32	miss_rate;
+	__u32	bus_rate;
+};
+#endif
+
 struct thread_info {
 	unsigned long		flags;		
 	int			preempt_count;	
@@ -62,6 +73,9 @@ struct thread_info {
 	unsigned long		thumbee_state;	
 #endif
 	struct restart_block	restart_block;
+#ifdef CONFIG_MSM_L2_TASK_STATS
+	struct l2_task_stats	l2_stats;
+#endif
 };
 
 #define INIT_THREAD_INFO(tsk)						\
@@ -0,0 +1,22 @@
+#ifndef __ASM_VDSO_H
+#define __ASM_VDSO_H
+
+#ifdef __KERNEL__
+
+#ifndef __ASSEMBLY__
+
+struct clocksource;
+
+#ifdef CONFIG_VDSO
+extern void vdso_clocksource_changed(struct clocksource *cs);
+#else
+static inline void vdso_clocksource_changed(struct clocksource *cs)
+{
+}
+#endif
+
+#endif
+
+#endif
+
+#endif
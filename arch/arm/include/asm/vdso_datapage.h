@@ -0,0 +1,37 @@
+#ifndef __ASM_VDSO_DATAPAGE_H
+#define __ASM_VDSO_DATAPAGE_H
+
+#ifdef __KERNEL__
+
+#ifndef __ASSEMBLY__
+
+#include <linux/types.h>
+
+/*
+ * Shared with the vDSO, one page, read only in user space.  The counter
+ * page is mapped one page below this one.
+ */
+struct vdso_data {
+	u32 seq_count;
+	u32 use_syscall;
+	u32 cs_cycle_last;
+	u32 cs_mask;
+	u32 cs_mult;
+	u32 cs_shift;
+	u32 cs_offset;
+	u32 cs_bias;
+	u32 cs_raw_shift;
+	u32 cs_unstable;
+	u32 xtime_sec;
+	u32 xtime_nsec;
+	u32 wtm_sec;
+	u32 wtm_nsec;
+	u32 tz_minuteswest;
+	u32 tz_dsttime;
+};
+
+#endif
+
+#endif
+
+#endif
@@ -265,17 +265,21 @@ armpmu_add(struct perf_event *event, int flags)
 	int err = 0;
 
 	perf_pmu_disable(event->pmu);
-	if (armpmu->test_set_event_constraints)
-		if (armpmu->test_set_event_constraints(event) < 0) {
-			pr_err("Event: %llx failed constraint check.\n",
-					event->attr.config);
-			event->state = PERF_EVENT_STATE_OFF;
-			goto out;
-		}
+	/*
+	 * A column already in use is busy for now, not for good: fail the
+	 * add so the core rotates the event in once the holder is out.
+	 */
+	if (armpmu->test_set_event_constraints &&
+	    armpmu->test_set_event_constraints(event) < 0) {
+		err = -EAGAIN;
+		goto out;
+	}
 
 	
 	idx = armpmu->get_event_idx(hw_events, hwc);
 	if (idx < 0) {
+		if (armpmu->clear_event_constraints)
+			armpmu->clear_event_constraints(event);
 		err = idx;
 		goto out;
 	}
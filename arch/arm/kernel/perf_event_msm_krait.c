@@ -519,7 +519,7 @@ static int msm_test_set_ev_constraint(struct perf_event *event)
 	if (!prefix)
 		return 0;
 
-	bitmap_t = 1 << (((prefix - 1) * 32) + (reg * 4) + group);
+	bitmap_t = 1ULL << (((prefix - 1) * 32) + (reg * 4) + group);
 
 	
 	if (!(cpu_pmu_bitmap & bitmap_t)) {
@@ -544,7 +544,7 @@ static int msm_clear_ev_constraint(struct perf_event *event)
 	if (!prefix)
 		return 0;
 
-	bitmap_t = 1 << (((prefix - 1) * 32) + (reg * 4) + group);
+	bitmap_t = 1ULL << (((prefix - 1) * 32) + (reg * 4) + group);
 
 	
 	cpu_pmu_bitmap &= ~(bitmap_t);
@@ -589,8 +589,39 @@ static struct attribute_group msm_pmu_format_group = {
 	.attrs = msm_l1_ev_formats,
 };
 
+PMU_EVENT_ATTR_STRING(cycles, krait_ev_cycles, "config=0xff");
+PMU_EVENT_ATTR_STRING(instructions, krait_ev_instructions, "config=0x08");
+PMU_EVENT_ATTR_STRING(branches, krait_ev_branches, "config=0x0c");
+PMU_EVENT_ATTR_STRING(branch-misses, krait_ev_branch_misses, "config=0x10");
+PMU_EVENT_ATTR_STRING(mem-reads, krait_ev_mem_reads, "config=0x06");
+PMU_EVENT_ATTR_STRING(mem-writes, krait_ev_mem_writes, "config=0x07");
+PMU_EVENT_ATTR_STRING(l1d-access, krait_ev_l1d_access, "config=0x04");
+PMU_EVENT_ATTR_STRING(l1d-refill, krait_ev_l1d_refill, "config=0x03");
+PMU_EVENT_ATTR_STRING(l1i-access, krait_ev_l1i_access, "config=0x10011");
+PMU_EVENT_ATTR_STRING(l1i-refill, krait_ev_l1i_refill, "config=0x10010");
+
+static struct attribute *msm_l1_ev_events[] = {
+	&krait_ev_cycles.attr.attr,
+	&krait_ev_instructions.attr.attr,
+	&krait_ev_branches.attr.attr,
+	&krait_ev_branch_misses.attr.attr,
+	&krait_ev_mem_reads.attr.attr,
+	&krait_ev_mem_writes.attr.attr,
+	&krait_ev_l1d_access.attr.attr,
+	&krait_ev_l1d_refill.attr.attr,
+	&krait_ev_l1i_access.attr.attr,
+	&krait_ev_l1i_refill.attr.attr,
+	NULL,
+};
+
+static struct attribute_group msm_pmu_events_group = {
+	.name = "events",
+	.attrs = msm_l1_ev_events,
+};
+
 static const struct attribute_group *msm_l1_pmu_attr_grps[] = {
 	&msm_pmu_format_group,
+	&msm_pmu_events_group,
 	NULL,
 };
 
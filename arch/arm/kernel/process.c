@@ -623,6 +623,15 @@ int in_gate_area_no_mm(unsigned long addr)
 
 const char *arch_vma_name(struct vm_area_struct *vma)
 {
+#ifdef CONFIG_VDSO
+	unsigned long vdso = vma->vm_mm ? vma->vm_mm->context.vdso : 0;
+
+	if (vdso && vma->vm_start == vdso)
+		return "[vdso]";
+	if (vdso && vma->vm_end <= vdso &&
+	    vma->vm_start >= vdso - 2 * PAGE_SIZE)
+		return "[vvar]";
+#endif
 	return (vma == &gate_vma) ? "[vectors]" : NULL;
 }
 #endif
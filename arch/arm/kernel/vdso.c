@@ -0,0 +1,192 @@
+/*
+ * Time functions served from user space
+ *
+ * Every process gets three pages below its vDSO text: the clocksource
+ * counter register mapped uncached and read only, then the data page
+ * updated by update_vsyscall(), then the text itself.  The counter page
+ * is only mapped when the clocksource driver handed us its physical
+ * address from time_init, before anything could exec.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/binfmts.h>
+#include <linux/clocksource.h>
+#include <linux/spinlock.h>
+#include <linux/time.h>
+#include <asm/vdso.h>
+#include <asm/vdso_datapage.h>
+
+extern char vdso_start, vdso_end;
+
+static unsigned long vdso_pages;
+static struct page **vdso_pagelist;
+static struct page *vdso_data_pages[2];
+
+static union {
+	struct vdso_data data;
+	u8 page[PAGE_SIZE];
+} vdso_data_store __page_aligned_data;
+static struct vdso_data *vdso_data = &vdso_data_store.data;
+
+static DEFINE_RAW_SPINLOCK(vdso_lock);
+static struct clocksource *vdso_clock;
+static phys_addr_t vdso_counter_phys;
+
+static int __init vdso_init(void)
+{
+	int i;
+
+	if (memcmp(&vdso_start, "\177ELF", 4)) {
+		pr_err("vDSO is not a valid ELF object\n");
+		return -EINVAL;
+	}
+
+	vdso_pages = (&vdso_end - &vdso_start) >> PAGE_SHIFT;
+	vdso_pagelist = kcalloc(vdso_pages + 1, sizeof(struct page *),
+				GFP_KERNEL);
+	if (!vdso_pagelist)
+		return -ENOMEM;
+
+	for (i = 0; i < vdso_pages; i++)
+		vdso_pagelist[i] = virt_to_page(&vdso_start + i * PAGE_SIZE);
+	vdso_data_pages[0] = virt_to_page(vdso_data);
+	return 0;
+}
+arch_initcall(vdso_init);
+
+static int vdso_map_counter(struct mm_struct *mm, unsigned long addr)
+{
+	struct vm_area_struct *vma;
+	static struct page *no_pages[1];
+	int ret;
+
+	ret = install_special_mapping(mm, addr, PAGE_SIZE,
+				      VM_READ | VM_MAYREAD, no_pages);
+	if (ret)
+		return ret;
+
+	vma = find_vma(mm, addr);
+	return io_remap_pfn_range(vma, addr, vdso_counter_phys >> PAGE_SHIFT,
+				  PAGE_SIZE, pgprot_noncached(vma->vm_page_prot));
+}
+
+int arch_setup_additional_pages(struct linux_binprm *bprm, int uses_interp)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long addr;
+	int ret;
+
+	if (!vdso_pagelist)
+		return 0;
+
+	down_write(&mm->mmap_sem);
+	addr = get_unmapped_area(NULL, 0, (vdso_pages + 2) << PAGE_SHIFT, 0, 0);
+	if (IS_ERR_VALUE(addr)) {
+		ret = addr;
+		goto out;
+	}
+
+	if (vdso_counter_phys) {
+		ret = vdso_map_counter(mm, addr);
+		if (ret)
+			goto out;
+	}
+
+	ret = install_special_mapping(mm, addr + PAGE_SIZE, PAGE_SIZE,
+				      VM_READ | VM_MAYREAD, vdso_data_pages);
+	if (ret)
+		goto out;
+
+	addr += 2 * PAGE_SIZE;
+	ret = install_special_mapping(mm, addr, vdso_pages << PAGE_SHIFT,
+				      VM_READ | VM_EXEC |
+				      VM_MAYREAD | VM_MAYWRITE | VM_MAYEXEC,
+				      vdso_pagelist);
+	if (ret)
+		goto out;
+
+	mm->context.vdso = addr;
+out:
+	up_write(&mm->mmap_sem);
+	return ret;
+}
+
+static bool vdso_counter_usable(struct clocksource *cs)
+{
+	return vdso_counter_phys && !cs->archdata.vdso_stopped &&
+		(cs->archdata.vdso_phys & PAGE_MASK) == vdso_counter_phys;
+}
+
+static void vdso_write_clock(struct clocksource *cs)
+{
+	vdso_data->use_syscall = !vdso_counter_usable(cs);
+	vdso_data->cs_offset = cs->archdata.vdso_offset;
+	vdso_data->cs_bias = cs->archdata.vdso_bias;
+	vdso_data->cs_raw_shift = cs->archdata.vdso_shift;
+	vdso_data->cs_unstable = cs->archdata.vdso_unstable;
+}
+
+/* Called by the clocksource driver whenever its archdata changes */
+void vdso_clocksource_changed(struct clocksource *cs)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&vdso_lock, flags);
+	if (!vdso_counter_phys && cs->archdata.vdso_phys)
+		vdso_counter_phys = cs->archdata.vdso_phys & PAGE_MASK;
+	if (cs == vdso_clock) {
+		vdso_data->seq_count++;
+		smp_wmb();
+		vdso_write_clock(cs);
+		smp_wmb();
+		vdso_data->seq_count++;
+	}
+	raw_spin_unlock_irqrestore(&vdso_lock, flags);
+}
+
+void update_vsyscall(struct timespec *ts, struct timespec *wtm,
+		     struct clocksource *clock, u32 mult)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&vdso_lock, flags);
+	vdso_data->seq_count++;
+	smp_wmb();
+
+	vdso_clock = clock;
+	vdso_write_clock(clock);
+	vdso_data->cs_cycle_last = clock->cycle_last;
+	vdso_data->cs_mask = clock->mask;
+	vdso_data->cs_mult = mult;
+	vdso_data->cs_shift = clock->shift;
+	vdso_data->xtime_sec = ts->tv_sec;
+	vdso_data->xtime_nsec = ts->tv_nsec;
+	vdso_data->wtm_sec = wtm->tv_sec;
+	vdso_data->wtm_nsec = wtm->tv_nsec;
+
+	smp_wmb();
+	vdso_data->seq_count++;
+	raw_spin_unlock_irqrestore(&vdso_lock, flags);
+}
+
+void update_vsyscall_tz(void)
+{
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&vdso_lock, flags);
+	vdso_data->seq_count++;
+	smp_wmb();
+	vdso_data->tz_minuteswest = sys_tz.tz_minuteswest;
+	vdso_data->tz_dsttime = sys_tz.tz_dsttime;
+	smp_wmb();
+	vdso_data->seq_count++;
+	raw_spin_unlock_irqrestore(&vdso_lock, flags);
+}
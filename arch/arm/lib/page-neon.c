@@ -0,0 +1,219 @@
+/*
+ *  linux/arch/arm/lib/page-neon.c
+ *
+ *  copy_page()/clear_page() through NEON on Krait.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The NEON loops are only taken when the unit can be claimed without
+ * saving live VFP state, since a save plus the lazy reload trap costs
+ * more than a page copy gains.  Otherwise, and off Krait, the ARM
+ * routines are used as before.
+ *
+ * debugfs page_neon/enable switches the NEON path, page_neon/bench
+ * times the ARM and NEON routines and memcpy() at several sizes and
+ * alignments.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/string.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/err.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#include <asm/cputype.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+extern void __copy_page_neon(void *to, const void *from);
+extern void __clear_page_neon(void *page);
+
+static u32 page_neon __read_mostly;
+
+void neon_copy_page(void *to, const void *from)
+{
+	if (page_neon && kernel_neon_try_begin()) {
+		__copy_page_neon(to, from);
+		kernel_neon_end();
+	} else {
+		(copy_page)(to, from);
+	}
+}
+EXPORT_SYMBOL(neon_copy_page);
+
+void neon_clear_page(void *page)
+{
+	if (page_neon && kernel_neon_try_begin()) {
+		__clear_page_neon(page);
+		kernel_neon_end();
+	} else {
+		memset(page, 0, PAGE_SIZE);
+	}
+}
+EXPORT_SYMBOL(neon_clear_page);
+
+static bool __init cpu_is_krait(void)
+{
+	switch (read_cpuid_id() & 0xff00fff0) {
+	case 0x510004d0:
+	case 0x510005d0:
+	case 0x510006f0:
+		return true;
+	default:
+		return false;
+	}
+}
+
+#ifdef CONFIG_DEBUG_FS
+
+#define BENCH_ORDER	4
+#define BENCH_BYTES	(PAGE_SIZE << BENCH_ORDER)
+#define BENCH_PASSES	64
+
+enum bench_op {
+	BENCH_COPY_ARM,
+	BENCH_COPY_NEON,
+	BENCH_CLEAR_ARM,
+	BENCH_CLEAR_NEON,
+	BENCH_MEMCPY,
+};
+
+/* MB/s for BENCH_PASSES sweeps of @len byte operations over the buffers */
+static unsigned long bench_run(enum bench_op op, u8 *dst, u8 *src,
+			       size_t len, size_t dalign, size_t salign)
+{
+	size_t span = BENCH_BYTES - max(dalign, salign);
+	size_t n = max_t(size_t, span / len, 1);
+	ktime_t start;
+	s64 ns;
+	int pass;
+	size_t i;
+
+	if (op == BENCH_COPY_NEON || op == BENCH_CLEAR_NEON)
+		kernel_neon_begin();
+	start = ktime_get();
+	for (pass = 0; pass < BENCH_PASSES; pass++) {
+		for (i = 0; i < n; i++) {
+			u8 *d = dst + dalign + i * len;
+			u8 *s = src + salign + i * len;
+
+			switch (op) {
+			case BENCH_COPY_ARM:
+				(copy_page)(d, s);
+				break;
+			case BENCH_COPY_NEON:
+				__copy_page_neon(d, s);
+				break;
+			case BENCH_CLEAR_ARM:
+				memset(d, 0, PAGE_SIZE);
+				break;
+			case BENCH_CLEAR_NEON:
+				__clear_page_neon(d);
+				break;
+			case BENCH_MEMCPY:
+				memcpy(d, s, len);
+				break;
+			}
+		}
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (op == BENCH_COPY_NEON || op == BENCH_CLEAR_NEON)
+		kernel_neon_end();
+
+	if (ns <= 0)
+		return 0;
+	return (unsigned long)div64_u64((u64)BENCH_PASSES * n * len * 1000,
+					ns);
+}
+
+static int page_neon_bench_show(struct seq_file *m, void *v)
+{
+	static const size_t sizes[] = { 64, 256, 1024, 4096, 16384 };
+	static const size_t aligns[][2] = { {0, 0}, {0, 1}, {3, 0}, {4, 8} };
+	struct page *dp, *sp;
+	u8 *dst, *src;
+	int i, j;
+
+	dp = alloc_pages(GFP_KERNEL, BENCH_ORDER);
+	sp = alloc_pages(GFP_KERNEL, BENCH_ORDER);
+	if (!dp || !sp)
+		goto out;
+	dst = page_address(dp);
+	src = page_address(sp);
+	memset(src, 0x5a, BENCH_BYTES);
+
+	seq_printf(m, "cpuid %08x neon path %s\n", read_cpuid_id(),
+		   page_neon ? "on" : "off");
+	seq_printf(m, "copy_page  arm %6lu MB/s\n",
+		   bench_run(BENCH_COPY_ARM, dst, src, PAGE_SIZE, 0, 0));
+	if (cpu_has_neon())
+		seq_printf(m, "copy_page  neon %5lu MB/s\n",
+			   bench_run(BENCH_COPY_NEON, dst, src, PAGE_SIZE,
+				     0, 0));
+	seq_printf(m, "clear_page arm %6lu MB/s\n",
+		   bench_run(BENCH_CLEAR_ARM, dst, src, PAGE_SIZE, 0, 0));
+	if (cpu_has_neon())
+		seq_printf(m, "clear_page neon %5lu MB/s\n",
+			   bench_run(BENCH_CLEAR_NEON, dst, src, PAGE_SIZE,
+				     0, 0));
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		for (j = 0; j < ARRAY_SIZE(aligns); j++)
+			seq_printf(m, "memcpy %5zu dst+%zu src+%zu %6lu MB/s\n",
+				   sizes[i], aligns[j][0], aligns[j][1],
+				   bench_run(BENCH_MEMCPY, dst, src, sizes[i],
+					     aligns[j][0], aligns[j][1]));
+out:
+	if (dp)
+		__free_pages(dp, BENCH_ORDER);
+	if (sp)
+		__free_pages(sp, BENCH_ORDER);
+	return 0;
+}
+
+static int page_neon_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, page_neon_bench_show, NULL);
+}
+
+static const struct file_operations page_neon_bench_fops = {
+	.open		= page_neon_bench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init page_neon_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("page_neon", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+	if (cpu_has_neon())
+		debugfs_create_bool("enable", S_IRUGO | S_IWUSR, dir,
+				    &page_neon);
+	debugfs_create_file("bench", S_IRUSR, dir, NULL,
+			    &page_neon_bench_fops);
+}
+#else
+static inline void page_neon_debugfs_init(void) { }
+#endif
+
+/* HWCAP_NEON is only known once vfp_init() has run */
+static int __init page_neon_init(void)
+{
+	page_neon = cpu_has_neon() && cpu_is_krait();
+	pr_info("page_neon: NEON copy_page/clear_page %s\n",
+		page_neon ? "enabled" : "disabled");
+	page_neon_debugfs_init();
+	return 0;
+}
+late_initcall_sync(page_neon_init);
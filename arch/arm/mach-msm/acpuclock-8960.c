@@ -24,6 +24,9 @@
 #include <linux/cpu.h>
 #include <linux/regulator/consumer.h>
 #include <linux/platform_device.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 #include <asm/mach-types.h>
 #include <asm/cpu.h>
@@ -204,6 +207,9 @@ struct acpu_level {
 	struct core_speed	speed;
 	struct l2_level		*l2_level;
 	unsigned int		vdd_core;
+	/* Filled in by precompute_levels() */
+	unsigned int		vdd_mem;
+	unsigned int		vdd_dig;
 };
 
 struct scalable {
@@ -493,6 +499,10 @@ static struct msm_bus_scale_pdata bus_client_pdata = {
 };
 
 static uint32_t bus_perf_client;
+static unsigned int bus_bw_level;
+/* Bandwidth the L2 speed asks for, bus_boost votes the top level instead */
+static unsigned int l2_bw_level;
+static bool bus_boost;
 
 #define L2(x) (&l2_freq_tbl_8960_kraitv1[(x)])
 static struct l2_level l2_freq_tbl_8960_kraitv1[] = {
@@ -1325,20 +1335,29 @@ static struct l2_level *compute_l2_level(struct scalable *sc,
 	return new_l;
 }
 
-static void set_bus_bw(unsigned int bw)
+/* Returns true if a new vote went out to the bus driver */
+static bool set_bus_bw(unsigned int bw)
 {
 	int ret;
 
 	
 	if (bw >= ARRAY_SIZE(bw_level_tbl)) {
 		pr_err("invalid bandwidth request (%d)\n", bw);
-		return;
+		return false;
 	}
 
+	if (bw == bus_bw_level)
+		return false;
+
 	
 	ret = msm_bus_scale_client_update_request(bus_perf_client, bw);
-	if (ret)
+	if (ret) {
 		pr_err("bandwidth request failed (%d)\n", ret);
+		return false;
+	}
+	bus_bw_level = bw;
+
+	return true;
 }
 
 static void set_speed(struct scalable *sc, struct core_speed *tgt_s,
@@ -1504,13 +1523,55 @@ static unsigned int calculate_vdd_core(struct acpu_level *tgt)
 	return tgt->vdd_core + (enable_boost ? boost_uv : 0);
 }
 
+/*
+ * Switch latency of cpufreq transitions.  A transition is slow when it
+ * had to change a voltage or the bus vote, which means waiting on the RPM
+ * or the PMIC, and fast when only the clocks changed.
+ */
+enum {
+	SWITCH_FAST,
+	SWITCH_SLOW,
+	NUM_SWITCH_PATHS
+};
+
+static const unsigned int switch_lat_bounds_us[] = {
+	50, 100, 200, 400, 800, 1600,
+};
+#define NUM_SWITCH_LAT_BUCKETS	(ARRAY_SIZE(switch_lat_bounds_us) + 1)
+
+struct switch_stats {
+	unsigned int hist[NUM_SWITCH_PATHS][NUM_SWITCH_LAT_BUCKETS];
+	unsigned int max_us[NUM_SWITCH_PATHS];
+};
+
+static struct switch_stats switch_stats[NR_CPUS];
+
+/* Called with driver_lock held */
+static void account_switch(int cpu, bool slow, ktime_t start)
+{
+	struct switch_stats *st = &switch_stats[cpu];
+	unsigned int us = ktime_to_us(ktime_sub(ktime_get(), start));
+	int path = slow ? SWITCH_SLOW : SWITCH_FAST;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(switch_lat_bounds_us); i++)
+		if (us < switch_lat_bounds_us[i])
+			break;
+
+	st->hist[path][i]++;
+	st->max_us[path] = max(st->max_us[path], us);
+}
+
 static int acpuclk_8960_set_rate(int cpu, unsigned long rate,
 				 enum setrate_reason reason)
 {
 	struct core_speed *strt_acpu_s, *tgt_acpu_s;
 	struct l2_level *tgt_l2_l;
 	struct acpu_level *tgt;
+	struct scalable *sc;
 	unsigned int vdd_mem, vdd_dig, vdd_core;
+	bool vdd_up, slow;
+	ktime_t start = ktime_get();
 	unsigned long flags;
 	int rc = 0;
 
@@ -1553,10 +1614,20 @@ static int acpuclk_8960_set_rate(int cpu, unsigned long rate,
 	}
 
 	
-	vdd_mem  = calculate_vdd_mem(tgt);
-	vdd_dig  = calculate_vdd_dig(tgt);
+	vdd_mem  = tgt->vdd_mem;
+	vdd_dig  = tgt->vdd_dig;
 	vdd_core = calculate_vdd_core(tgt);
 
+	sc = &scalable[cpu];
+	vdd_up = vdd_mem > sc->vreg[VREG_MEM].cur_vdd ||
+		 vdd_dig > sc->vreg[VREG_DIG].cur_vdd ||
+		 (vdd_core > sc->vreg[VREG_CORE].cur_vdd &&
+		  reason != SETRATE_HOTPLUG);
+	slow = vdd_up ||
+	       vdd_mem < sc->vreg[VREG_MEM].cur_vdd ||
+	       vdd_dig < sc->vreg[VREG_DIG].cur_vdd ||
+	       vdd_core < sc->vreg[VREG_CORE].cur_vdd;
+
 	
 	if (reason == SETRATE_CPUFREQ || reason == SETRATE_HOTPLUG) {
 		rc = increase_vdd(cpu, vdd_core, vdd_mem, vdd_dig, reason);
@@ -1566,7 +1637,9 @@ static int acpuclk_8960_set_rate(int cpu, unsigned long rate,
 
 	pr_debug("Switching from ACPU%d rate %u KHz -> %u KHz\n",
 		cpu, strt_acpu_s->khz, tgt_acpu_s->khz);
-	udelay(60);
+	/* Only a raised voltage needs time to settle */
+	if (vdd_up && (reason == SETRATE_CPUFREQ || reason == SETRATE_HOTPLUG))
+		udelay(60);
 	set_acpuclk_foot_print(cpu, 0x3);
 
 	if (reason == SETRATE_CPUFREQ) {
@@ -1599,7 +1672,9 @@ static int acpuclk_8960_set_rate(int cpu, unsigned long rate,
 		goto out;
 
 	
-	set_bus_bw(tgt_l2_l->bw_level);
+	l2_bw_level = tgt_l2_l->bw_level;
+	if (set_bus_bw(bus_boost ? ARRAY_SIZE(bw_level_tbl) - 1 : l2_bw_level))
+		slow = true;
 
 	set_acpuclk_foot_print(cpu, 0x6);
 
@@ -1608,6 +1683,9 @@ static int acpuclk_8960_set_rate(int cpu, unsigned long rate,
 
 	set_acpuclk_foot_print(cpu, 0x7);
 
+	if (reason == SETRATE_CPUFREQ)
+		account_switch(cpu, slow, start);
+
 	pr_debug("ACPU%d speed change complete\n", cpu);
 
 out:
@@ -1754,6 +1832,19 @@ static void __init bus_init(unsigned int init_bw)
 	ret = msm_bus_scale_client_update_request(bus_perf_client, init_bw);
 	if (ret)
 		pr_err("initial bandwidth request failed (%d)\n", ret);
+	bus_bw_level = init_bw;
+	l2_bw_level = init_bw;
+}
+
+/* Memory-bound work gains more from bandwidth than from the CPU clock */
+static int acpuclk_8960_set_bus_boost(bool on)
+{
+	mutex_lock(&driver_lock);
+	bus_boost = on;
+	set_bus_bw(bus_boost ? ARRAY_SIZE(bw_level_tbl) - 1 : l2_bw_level);
+	mutex_unlock(&driver_lock);
+
+	return 0;
 }
 
 #ifdef CONFIG_CPU_FREQ_MSM
@@ -1871,6 +1962,15 @@ static const int krait_needs_vmin(void)
 	};
 }
 
+/* The memory and digital rail votes only depend on the table entry */
+static void __init precompute_levels(struct acpu_level *tbl)
+{
+	for (; tbl->speed.khz != 0; tbl++) {
+		tbl->vdd_mem = calculate_vdd_mem(tbl);
+		tbl->vdd_dig = calculate_vdd_dig(tbl);
+	}
+}
+
 static void kraitv2_apply_vmin(struct acpu_level *tbl)
 {
 	for (; tbl->speed.khz != 0; tbl++)
@@ -2082,11 +2182,71 @@ static void __init select_freq_plan(void)
 			max_acpu_level = l;
 	BUG_ON(!max_acpu_level);
 	pr_info("Max ACPU freq: %u KHz\n", max_acpu_level->speed.khz);
+
+	precompute_levels(acpu_freq_tbl);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int switch_latency_show(struct seq_file *m, void *unused)
+{
+	static const char * const path_names[] = {
+		[SWITCH_FAST] = "fast",
+		[SWITCH_SLOW] = "slow",
+	};
+	int cpu, path, i;
+
+	seq_printf(m, "cpu path ");
+	for (i = 0; i < ARRAY_SIZE(switch_lat_bounds_us); i++)
+		seq_printf(m, " <%uus", switch_lat_bounds_us[i]);
+	seq_printf(m, " more max_us\n");
+
+	mutex_lock(&driver_lock);
+	for_each_possible_cpu(cpu) {
+		struct switch_stats *st = &switch_stats[cpu];
+
+		for (path = 0; path < NUM_SWITCH_PATHS; path++) {
+			seq_printf(m, "%3d %-5s", cpu, path_names[path]);
+			for (i = 0; i < NUM_SWITCH_LAT_BUCKETS; i++)
+				seq_printf(m, " %6u", st->hist[path][i]);
+			seq_printf(m, " %6u\n", st->max_us[path]);
+		}
+	}
+	mutex_unlock(&driver_lock);
+
+	return 0;
+}
+
+static int switch_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, switch_latency_show, inode->i_private);
 }
 
+static const struct file_operations switch_latency_fops = {
+	.open		= switch_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init acpuclk_debugfs_init(void)
+{
+	struct dentry *dent;
+
+	dent = debugfs_create_dir("acpuclk", NULL);
+	if (IS_ERR_OR_NULL(dent))
+		return;
+
+	debugfs_create_file("switch_latency", S_IRUGO, dent, NULL,
+			    &switch_latency_fops);
+}
+#else
+static inline void acpuclk_debugfs_init(void) { }
+#endif
+
 static struct acpuclk_data acpuclk_8960_data = {
 	.set_rate = acpuclk_8960_set_rate,
 	.get_rate = acpuclk_8960_get_rate,
+	.set_bus_boost = acpuclk_8960_set_bus_boost,
 #ifdef CONFIG_APQ8064_ONLY
 	.power_collapse_khz = 384000,
 	.wait_for_irq_khz = 384000,
@@ -2208,6 +2368,7 @@ static int __init acpuclk_8960_probe(struct platform_device *pdev)
 
 	acpuclk_register(&acpuclk_8960_data);
 	register_hotcpu_notifier(&acpuclock_cpu_notifier);
+	acpuclk_debugfs_init();
 
 #ifdef CONFIG_PERFLOCK
 	if(cpu_is_msm8960()){
@@ -11,6 +11,7 @@
  */
 
 #include <linux/cpu.h>
+#include <linux/errno.h>
 #include <linux/smp.h>
 #include "acpuclock.h"
 
@@ -36,6 +37,14 @@ int acpuclk_set_rate(int cpu, unsigned long rate, enum setrate_reason reason)
 	return acpuclk_data->set_rate(cpu, rate, reason);
 }
 
+int acpuclk_set_bus_boost(bool on)
+{
+	if (!init_done || !acpuclk_data->set_bus_boost)
+		return -ENOSYS;
+
+	return acpuclk_data->set_bus_boost(on);
+}
+
 uint32_t acpuclk_get_switch_time(void)
 {
 	return acpuclk_data->switch_time_us;
@@ -35,6 +35,7 @@ struct acpuclk_pdata {
 struct acpuclk_data {
 	unsigned long (*get_rate)(int cpu);
 	int (*set_rate)(int cpu, unsigned long rate, enum setrate_reason);
+	int (*set_bus_boost)(bool on);
 	uint32_t switch_time_us;
 	unsigned long power_collapse_khz;
 	unsigned long wait_for_irq_khz;
@@ -46,6 +47,8 @@ int acpuclk_set_rate(int cpu, unsigned long rate, enum setrate_reason);
 
 uint32_t acpuclk_get_switch_time(void);
 
+int acpuclk_set_bus_boost(bool on);
+
 unsigned long acpuclk_power_collapse(void);
 
 unsigned long acpuclk_wait_for_irq(void);
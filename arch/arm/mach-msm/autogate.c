@@ -0,0 +1,201 @@
+/* Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/clk.h>
+#include <linux/regulator/consumer.h>
+#include <linux/jiffies.h>
+#include <linux/debugfs.h>
+#include <mach/autogate.h>
+
+#define AUTOGATE_DEFAULT_MAX_MS	1000
+
+static struct dentry *autogate_debugfs_root;
+
+static void autogate_off(struct autogate *ag, bool unprepare)
+{
+	int i;
+
+	if (ag->enabled) {
+		for (i = ag->num_clks - 1; i >= 0; i--)
+			clk_disable(ag->clks[i]);
+		ag->enabled = false;
+		ag->gated++;
+	}
+	if (unprepare && ag->prepared) {
+		for (i = ag->num_clks - 1; i >= 0; i--)
+			clk_unprepare(ag->clks[i]);
+		ag->prepared = false;
+	}
+	if (ag->regulator && !ag->enabled && !ag->prepared)
+		regulator_disable(ag->regulator);
+}
+
+static int autogate_on(struct autogate *ag)
+{
+	int i, rc = 0;
+
+	if (ag->regulator && !ag->prepared) {
+		rc = regulator_enable(ag->regulator);
+		if (rc)
+			return rc;
+	}
+	if (!ag->prepared) {
+		for (i = 0; i < ag->num_clks; i++) {
+			rc = clk_prepare(ag->clks[i]);
+			if (rc)
+				goto err_prepare;
+		}
+		ag->prepared = true;
+	}
+	for (i = 0; i < ag->num_clks; i++) {
+		rc = clk_enable(ag->clks[i]);
+		if (rc)
+			goto err_enable;
+	}
+	ag->enabled = true;
+	return 0;
+
+err_enable:
+	while (--i >= 0)
+		clk_disable(ag->clks[i]);
+	if (ag->flags & AUTOGATE_KEEP_PREPARED)
+		return rc;
+	i = ag->num_clks;
+	ag->prepared = false;
+err_prepare:
+	while (--i >= 0)
+		clk_unprepare(ag->clks[i]);
+	if (ag->regulator)
+		regulator_disable(ag->regulator);
+	return rc;
+}
+
+/* An average gap the clocks can stay on across is covered, with margin */
+static void autogate_update_timeout(struct autogate *ag)
+{
+	unsigned int gap;
+
+	if (!ag->last_put)
+		return;
+	gap = jiffies_to_msecs(jiffies - ag->last_put);
+	if (!ag->enabled && gap < ag->max_ms)
+		ag->restarted++;
+
+	ag->avg_gap_ms = ag->avg_gap_ms ?
+		(3 * ag->avg_gap_ms + gap) / 4 : gap;
+	if (ag->avg_gap_ms < ag->max_ms)
+		ag->timeout_ms = clamp(2 * ag->avg_gap_ms, ag->min_ms,
+				       ag->max_ms);
+	else
+		ag->timeout_ms = ag->min_ms;
+}
+
+static void autogate_work(struct work_struct *work)
+{
+	struct autogate *ag = container_of(work, struct autogate, work.work);
+
+	mutex_lock(&ag->lock);
+	if (!ag->users)
+		autogate_off(ag, !(ag->flags & AUTOGATE_KEEP_PREPARED));
+	mutex_unlock(&ag->lock);
+}
+
+int autogate_get(struct autogate *ag)
+{
+	int rc = 0;
+
+	mutex_lock(&ag->lock);
+	if (!ag->users) {
+		cancel_delayed_work(&ag->work);
+		autogate_update_timeout(ag);
+		if (!ag->enabled)
+			rc = autogate_on(ag);
+	}
+	if (!rc)
+		ag->users++;
+	mutex_unlock(&ag->lock);
+	return rc;
+}
+EXPORT_SYMBOL(autogate_get);
+
+void autogate_put(struct autogate *ag)
+{
+	mutex_lock(&ag->lock);
+	if (WARN(!ag->users, "%s: unbalanced autogate_put\n", ag->name))
+		goto out;
+	if (--ag->users)
+		goto out;
+	ag->last_put = jiffies ? : 1;
+	schedule_delayed_work(&ag->work, msecs_to_jiffies(ag->timeout_ms));
+out:
+	mutex_unlock(&ag->lock);
+}
+EXPORT_SYMBOL(autogate_put);
+
+/* Gate and unprepare now if idle, the next get turns everything back on */
+void autogate_suspend(struct autogate *ag)
+{
+	mutex_lock(&ag->lock);
+	if (!ag->users) {
+		cancel_delayed_work(&ag->work);
+		autogate_off(ag, true);
+	}
+	mutex_unlock(&ag->lock);
+}
+EXPORT_SYMBOL(autogate_suspend);
+
+int autogate_init(struct autogate *ag)
+{
+	if (!ag->max_ms)
+		ag->max_ms = AUTOGATE_DEFAULT_MAX_MS;
+	ag->min_ms = min(ag->min_ms, ag->max_ms);
+	ag->timeout_ms = ag->max_ms;
+	ag->avg_gap_ms = 0;
+	ag->last_put = 0;
+	ag->users = 0;
+	ag->enabled = false;
+	ag->prepared = false;
+	mutex_init(&ag->lock);
+	INIT_DELAYED_WORK(&ag->work, autogate_work);
+
+	if (!autogate_debugfs_root)
+		autogate_debugfs_root = debugfs_create_dir("autogate", NULL);
+	if (!IS_ERR_OR_NULL(autogate_debugfs_root) && ag->name) {
+		ag->dent = debugfs_create_dir(ag->name, autogate_debugfs_root);
+		if (!IS_ERR_OR_NULL(ag->dent)) {
+			debugfs_create_u32("timeout_ms", S_IRUGO, ag->dent,
+					   &ag->timeout_ms);
+			debugfs_create_u32("gated", S_IRUGO, ag->dent,
+					   &ag->gated);
+			debugfs_create_u32("restarted", S_IRUGO, ag->dent,
+					   &ag->restarted);
+		}
+	}
+	return 0;
+}
+EXPORT_SYMBOL(autogate_init);
+
+void autogate_destroy(struct autogate *ag)
+{
+	cancel_delayed_work_sync(&ag->work);
+	mutex_lock(&ag->lock);
+	WARN(ag->users, "%s: destroyed while in use\n", ag->name);
+	autogate_off(ag, true);
+	mutex_unlock(&ag->lock);
+	if (!IS_ERR_OR_NULL(ag->dent))
+		debugfs_remove_recursive(ag->dent);
+	mutex_destroy(&ag->lock);
+}
+EXPORT_SYMBOL(autogate_destroy);
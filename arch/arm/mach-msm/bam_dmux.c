@@ -24,6 +24,7 @@
 #include <linux/clk.h>
 #include <linux/wakelock.h>
 #include <linux/kfifo.h>
+#include <linux/ktime.h>
 #include <linux/of.h>
 
 #include <mach/sps.h>
@@ -74,6 +75,14 @@ static int bam_adaptive_timer_enabled = 1;
 module_param_named(adaptive_timer_enabled,
 			bam_adaptive_timer_enabled,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+/* descriptors handled per polling pass, matches the rmnet NAPI weight */
+static int bam_poll_budget = 64;
+module_param_named(poll_budget, bam_poll_budget,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+/* average packets per pass below which polling is left early */
+static int bam_poll_exit_rate = 2;
+module_param_named(poll_exit_rate, bam_poll_exit_rate,
+		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
 #if defined(DEBUG)
 static uint32_t bam_dmux_read_cnt;
@@ -85,6 +94,9 @@ static uint32_t bam_dmux_tx_stall_cnt;
 static atomic_t bam_dmux_ack_out_cnt = ATOMIC_INIT(0);
 static atomic_t bam_dmux_ack_in_cnt = ATOMIC_INIT(0);
 static atomic_t bam_dmux_a2_pwr_cntl_in_cnt = ATOMIC_INIT(0);
+static uint32_t bam_dmux_rx_xfer_cnt;
+static uint32_t bam_dmux_rx_frame_cnt;
+static uint32_t bam_dmux_rx_aggr_max;
 
 #define DBG(x...) do {		                 \
 		if (msm_bam_dmux_debug_enable || ril_debug_flag)  \
@@ -128,11 +140,19 @@ static atomic_t bam_dmux_a2_pwr_cntl_in_cnt = ATOMIC_INIT(0);
 #define DBG_INC_A2_POWER_CONTROL_IN_CNT() \
 	atomic_inc(&bam_dmux_a2_pwr_cntl_in_cnt)
 
+#define DBG_INC_RX_AGGR(x) do {	                               \
+		bam_dmux_rx_xfer_cnt++;                               \
+		bam_dmux_rx_frame_cnt += (x);                         \
+		if ((x) > bam_dmux_rx_aggr_max)                       \
+			bam_dmux_rx_aggr_max = (x);                   \
+	} while (0)
+
 #define DBG_INC_ACK_IN_CNT() \
 	atomic_inc(&bam_dmux_ack_in_cnt)
 #else
 #define DBG(x...) do { } while (0)
 #define DBG_INC_READ_CNT(x...) do { } while (0)
+#define DBG_INC_RX_AGGR(x...) do { } while (0)
 #define DBG_INC_WRITE_CNT(x...) do { } while (0)
 #define DBG_INC_WRITE_CPY(x...) do { } while (0)
 #define DBG_INC_TX_SPS_FAILURE_CNT() do { } while (0)
@@ -168,6 +188,7 @@ struct tx_pkt_info {
 struct rx_pkt_info {
 	struct sk_buff *skb;
 	dma_addr_t dma_address;
+	uint32_t len;
 	struct work_struct work;
 	struct list_head list_node;
 };
@@ -203,6 +224,23 @@ static int bam_mux_initialized;
 static int polling_mode;
 static unsigned long rx_timer_interval;
 
+#define RX_MODE_HIST_BUCKETS 6
+static const s64 rx_mode_hist_us[RX_MODE_HIST_BUCKETS - 1] = {
+	100, 1000, 10000, 100000, 1000000,
+};
+static u32 rx_poll_hist[RX_MODE_HIST_BUCKETS];
+static u32 rx_intr_hist[RX_MODE_HIST_BUCKETS];
+static ktime_t rx_mode_ts;
+static ktime_t rx_irq_ts;
+/* packets per polling pass, moving average in 1/8 units */
+static unsigned int rx_poll_rate;
+static u32 rx_enter_cnt;
+static s64 rx_enter_lat_sum_us;
+static s64 rx_enter_lat_max_us;
+static u32 rx_exit_cnt;
+static s64 rx_exit_lat_sum_us;
+static s64 rx_exit_lat_max_us;
+
 static LIST_HEAD(bam_rx_pool);
 static DEFINE_MUTEX(bam_rx_pool_mutexlock);
 static int bam_rx_pool_len;
@@ -405,6 +443,8 @@ static void queue_rx(void)
 {
 	void *ptr;
 	struct rx_pkt_info *info;
+	struct sk_buff *skbs[NUM_BUFFERS];
+	int nr_skbs, next_skb = 0;
 	int ret;
 	int rx_len_cached;
 
@@ -412,6 +452,13 @@ static void queue_rx(void)
 	rx_len_cached = bam_rx_pool_len;
 	mutex_unlock(&bam_rx_pool_mutexlock);
 
+	/* Refills come in bursts, take all the heads at once */
+	nr_skbs = 0;
+	if (bam_connection_is_active)
+		nr_skbs = __dev_alloc_skb_bulk(BUFFER_SIZE,
+					GFP_NOWAIT | __GFP_NOWARN,
+					skbs, NUM_BUFFERS - rx_len_cached);
+
 	while (bam_connection_is_active && rx_len_cached < NUM_BUFFERS) {
 		if (in_global_reset) {
 			DBG("%s: in_global_reset\n", __func__);
@@ -429,7 +476,10 @@ static void queue_rx(void)
 
 		INIT_WORK(&info->work, handle_bam_mux_cmd);
 
-		info->skb = __dev_alloc_skb(BUFFER_SIZE,
+		if (next_skb < nr_skbs)
+			info->skb = skbs[next_skb++];
+		else
+			info->skb = __dev_alloc_skb(BUFFER_SIZE,
 						GFP_NOWAIT | __GFP_NOWARN);
 		if (info->skb == NULL) {
 			DMUX_LOG_KERR(
@@ -468,7 +518,7 @@ static void queue_rx(void)
 		mutex_unlock(&bam_rx_pool_mutexlock);
 
 	}
-	return;
+	goto out;
 
 fail_skb:
 	dev_kfree_skb_any(info->skb);
@@ -481,6 +531,9 @@ fail:
 		DMUX_LOG_KERR("%s: rescheduling\n", __func__);
 		schedule_delayed_work(&queue_rx_work, msecs_to_jiffies(100));
 	}
+out:
+	while (next_skb < nr_skbs)
+		dev_kfree_skb_any(skbs[next_skb++]);
 }
 
 static void queue_rx_work_func(struct work_struct *work)
@@ -517,6 +570,48 @@ static void bam_mux_process_data(struct sk_buff *rx_skb)
 	DBG("%s: exit\n", __func__);
 }
 
+/*
+ * The A2 may pack several data frames back to back into one transfer.
+ * Split the frames behind the first one into their own skbs, then hand
+ * them to the clients in order after the first.
+ */
+static void bam_mux_process_aggr_data(struct sk_buff *rx_skb, uint32_t len)
+{
+	struct bam_mux_hdr *hdr = (struct bam_mux_hdr *)rx_skb->data;
+	struct sk_buff_head frames;
+	struct sk_buff *skb;
+	uint32_t offset, frame_len;
+
+	__skb_queue_head_init(&frames);
+	len = min_t(uint32_t, len, BUFFER_SIZE);
+	offset = sizeof(*hdr) + hdr->pkt_len + hdr->pad_len;
+	while (offset + sizeof(*hdr) <= len) {
+		hdr = (struct bam_mux_hdr *)(rx_skb->data + offset);
+		frame_len = sizeof(*hdr) + hdr->pkt_len + hdr->pad_len;
+		if (hdr->magic_num != BAM_MUX_HDR_MAGIC_NO ||
+		    hdr->cmd != BAM_MUX_HDR_CMD_DATA ||
+		    hdr->ch_id >= BAM_DMUX_NUM_CHANNELS ||
+		    offset + frame_len > len)
+			break;
+
+		skb = __dev_alloc_skb(frame_len, GFP_NOWAIT | __GFP_NOWARN);
+		if (!skb) {
+			DMUX_LOG_KERR("%s: dropping aggregated frames\n",
+								__func__);
+			break;
+		}
+		memcpy(skb_put(skb, frame_len), hdr, frame_len);
+		__skb_queue_tail(&frames, skb);
+		DBG_INC_READ_CNT(hdr->pkt_len);
+		offset += frame_len;
+	}
+	DBG_INC_RX_AGGR(skb_queue_len(&frames) + 1);
+
+	bam_mux_process_data(rx_skb);
+	while ((skb = __skb_dequeue(&frames)))
+		bam_mux_process_data(skb);
+}
+
 static inline void handle_bam_mux_cmd_open(struct bam_mux_hdr *rx_hdr)
 {
 	unsigned long flags;
@@ -548,9 +643,11 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 	struct bam_mux_hdr *rx_hdr;
 	struct rx_pkt_info *info;
 	struct sk_buff *rx_skb;
+	uint32_t rx_len;
 
 	info = container_of(work, struct rx_pkt_info, work);
 	rx_skb = info->skb;
+	rx_len = info->len;
 	dma_unmap_single(NULL, info->dma_address, BUFFER_SIZE, DMA_FROM_DEVICE);
 	kfree(info);
 
@@ -585,7 +682,7 @@ static void handle_bam_mux_cmd(struct work_struct *work)
 	switch (rx_hdr->cmd) {
 	case BAM_MUX_HDR_CMD_DATA:
 		DBG_INC_READ_CNT(rx_hdr->pkt_len);
-		bam_mux_process_data(rx_skb);
+		bam_mux_process_aggr_data(rx_skb, rx_len);
 		break;
 	case BAM_MUX_HDR_CMD_OPEN:
 		bam_dmux_log("%s: opening cid %d PC enabled\n", __func__,
@@ -1054,14 +1151,29 @@ int msm_bam_dmux_is_ch_low(uint32_t id)
 	return ret;
 }
 
+/* Account the time spent in the mode being left */
+static void rx_mode_hist_add(u32 *hist, ktime_t now)
+{
+	s64 us = ktime_us_delta(now, rx_mode_ts);
+	int b = 0;
+
+	while (b < RX_MODE_HIST_BUCKETS - 1 && us >= rx_mode_hist_us[b])
+		b++;
+	hist[b]++;
+	rx_mode_ts = now;
+}
+
 static void rx_switch_to_interrupt_mode(void)
 {
 	struct sps_connect cur_rx_conn;
 	struct sps_iovec iov;
 	struct rx_pkt_info *info;
+	ktime_t start, now;
+	s64 us;
 	int ret;
 
 	DBG("%s: entry\n", __func__);
+	start = ktime_get();
 	ret = sps_get_config(bam_rx_pipe, &cur_rx_conn);
 	if (ret) {
 		pr_err(MODULE_NAME "%s: sps_get_config() failed %d\n", __func__, ret);
@@ -1082,6 +1194,13 @@ static void rx_switch_to_interrupt_mode(void)
 		pr_err(MODULE_NAME "%s: sps_set_config() failed %d\n", __func__, ret);
 		goto fail;
 	}
+	now = ktime_get();
+	us = ktime_us_delta(now, start);
+	rx_exit_cnt++;
+	rx_exit_lat_sum_us += us;
+	if (us > rx_exit_lat_max_us)
+		rx_exit_lat_max_us = us;
+	rx_mode_hist_add(rx_poll_hist, now);
 	polling_mode = 0;
 	release_wakelock();
 
@@ -1121,6 +1240,7 @@ static void rx_switch_to_interrupt_mode(void)
 		list_del(&info->list_node);
 		--bam_rx_pool_len;
 		mutex_unlock(&bam_rx_pool_mutexlock);
+		info->len = iov.size;
 		handle_bam_mux_cmd(&info->work);
 	}
 	DBG("%s: exit\n", __func__);
@@ -1128,6 +1248,7 @@ static void rx_switch_to_interrupt_mode(void)
 
 fail:
 	pr_err(MODULE_NAME "%s: reverting to polling\n", __func__);
+	rx_irq_ts = ktime_get();
 	queue_work_on(0, bam_mux_rx_workqueue, &rx_timer_work);
 }
 
@@ -1136,13 +1257,23 @@ static void rx_timer_work_func(struct work_struct *work)
 	struct sps_iovec iov;
 	struct rx_pkt_info *info;
 	int inactive_cycles = 0;
+	int budget, pkts;
 	int ret;
 	u32 buffs_unused, buffs_used;
+	s64 us;
 
 	DBG("%s: entry\n", __func__);
+	us = ktime_us_delta(ktime_get(), rx_irq_ts);
+	rx_enter_cnt++;
+	rx_enter_lat_sum_us += us;
+	if (us > rx_enter_lat_max_us)
+		rx_enter_lat_max_us = us;
+
 	while (bam_connection_is_active) { 
 		++inactive_cycles;
-		while (bam_connection_is_active) { 
+		budget = max(bam_poll_budget, 1);
+		pkts = 0;
+		while (bam_connection_is_active && pkts < budget) {
 			if (in_global_reset) {
 				DBG("%s: in_global_reset\n", __func__);
 				return;
@@ -1156,6 +1287,7 @@ static void rx_timer_work_func(struct work_struct *work)
 			if (iov.addr == 0)
 				break;
 			inactive_cycles = 0;
+			++pkts;
 			mutex_lock(&bam_rx_pool_mutexlock);
 			if (unlikely(list_empty(&bam_rx_pool))) {
 				DMUX_LOG_KERR(
@@ -1183,10 +1315,22 @@ static void rx_timer_work_func(struct work_struct *work)
 			list_del(&info->list_node);
 			--bam_rx_pool_len;
 			mutex_unlock(&bam_rx_pool_mutexlock);
+			info->len = iov.size;
 			handle_bam_mux_cmd(&info->work);
 		}
 
-		if (inactive_cycles >= POLLING_INACTIVITY) {
+		rx_poll_rate = rx_poll_rate - rx_poll_rate / 8 + pkts;
+
+		/* Budget used up, descriptors are still pending: no sleep */
+		if (pkts >= budget) {
+			cond_resched();
+			continue;
+		}
+
+		/* Light traffic leaves polling well before a burst would */
+		if (inactive_cycles >= POLLING_INACTIVITY ||
+		    (inactive_cycles >= POLLING_INACTIVITY / 4 &&
+		     rx_poll_rate < bam_poll_exit_rate * 8)) {
 			rx_switch_to_interrupt_mode();
 			break;
 		}
@@ -1289,6 +1433,8 @@ static void bam_mux_rx_notify(struct sps_event_notify *notify)
 				break;
 			}
 			grab_wakelock();
+			rx_irq_ts = ktime_get();
+			rx_mode_hist_add(rx_intr_hist, rx_irq_ts);
 			polling_mode = 1;
 			queue_work_on(0, bam_mux_rx_workqueue, &rx_timer_work);
 		}
@@ -1345,7 +1491,10 @@ static int debug_stats(char *buf, int max)
 			"rx queue len:    %d\n"
 			"a2 ack out cnt:  %d\n"
 			"a2 ack in cnt:   %d\n"
-			"a2 pwr cntl in:  %d\n",
+			"a2 pwr cntl in:  %d\n"
+			"rx transfers:    %u\n"
+			"rx frames:       %u\n"
+			"rx max frames:   %u\n",
 			bam_dmux_read_cnt,
 			bam_dmux_write_cnt,
 			bam_dmux_write_cpy_cnt,
@@ -1355,12 +1504,45 @@ static int debug_stats(char *buf, int max)
 			bam_rx_pool_len,
 			atomic_read(&bam_dmux_ack_out_cnt),
 			atomic_read(&bam_dmux_ack_in_cnt),
-			atomic_read(&bam_dmux_a2_pwr_cntl_in_cnt)
+			atomic_read(&bam_dmux_a2_pwr_cntl_in_cnt),
+			bam_dmux_rx_xfer_cnt,
+			bam_dmux_rx_frame_cnt,
+			bam_dmux_rx_aggr_max
 			);
 
 	return i;
 }
 
+static int debug_poll(char *buf, int max)
+{
+	static const char * const names[RX_MODE_HIST_BUCKETS] = {
+		"<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s",
+	};
+	int i = 0;
+	int j;
+
+	i += scnprintf(buf + i, max - i,
+			"mode:          %s\n"
+			"pkts per pass: %u.%u\n"
+			"residency      polling  interrupt\n",
+			polling_mode ? "polling" : "interrupt",
+			rx_poll_rate / 8, (rx_poll_rate % 8) * 10 / 8);
+	for (j = 0; j < RX_MODE_HIST_BUCKETS; ++j)
+		i += scnprintf(buf + i, max - i, "%-14s %8u %10u\n",
+				names[j], rx_poll_hist[j], rx_intr_hist[j]);
+	i += scnprintf(buf + i, max - i,
+			"enter latency: avg %lld us max %lld us (%u)\n"
+			"exit latency:  avg %lld us max %lld us (%u)\n",
+			rx_enter_cnt ? div_s64(rx_enter_lat_sum_us,
+						rx_enter_cnt) : 0,
+			rx_enter_lat_max_us, rx_enter_cnt,
+			rx_exit_cnt ? div_s64(rx_exit_lat_sum_us,
+						rx_exit_cnt) : 0,
+			rx_exit_lat_max_us, rx_exit_cnt);
+
+	return i;
+}
+
 static int debug_log(char *buff, int max, loff_t *ppos)
 {
 	unsigned long flags;
@@ -1638,6 +1820,12 @@ int msm_bam_dmux_reg_notify(void *priv,
 	return 0;
 }
 
+/* The A2 BAM interrupt every downlink packet starts from, 0 before probe */
+int msm_bam_dmux_get_irq(void)
+{
+	return a2_bam_irq;
+}
+
 static void ul_timeout(struct work_struct *work)
 {
 	unsigned long flags;
@@ -2387,7 +2575,7 @@ static int bam_dmux_probe(struct platform_device *pdev)
 	}
 
 	bam_mux_rx_workqueue = alloc_workqueue("bam_dmux_rx",
-					WQ_MEM_RECLAIM | WQ_CPU_INTENSIVE, 1);
+				WQ_MEM_RECLAIM | WQ_CPU_INTENSIVE | WQ_HIGHPRI, 1);
 	if (!bam_mux_rx_workqueue)
 		return -ENOMEM;
 
@@ -2475,6 +2663,7 @@ static int __init bam_dmux_init(void)
 		debug_create("tbl", 0444, dent, debug_tbl);
 		debug_create("ul_pkt_cnt", 0444, dent, debug_ul_pkt_cnt);
 		debug_create("stats", 0444, dent, debug_stats);
+		debug_create("poll", 0444, dent, debug_poll);
 		debug_create_multiple("log", 0444, dent, debug_log);
 	}
 #endif
@@ -2485,6 +2674,7 @@ static int __init bam_dmux_init(void)
 	}
 
 	rx_timer_interval = DEFAULT_POLLING_MIN_SLEEP;
+	rx_mode_ts = ktime_get();
 
 	if (get_kernel_flag() & KERNEL_FLAG_RIL_DBG_RMNET)
 		ril_debug_flag = 1;
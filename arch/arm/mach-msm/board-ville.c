@@ -79,6 +79,7 @@
 #include <linux/mfd/wcd9xxx/pdata.h>
 #endif
 #include <linux/ion.h>
+#include <linux/dma-contiguous.h>
 #include <mach/ion.h>
 
 #include <mach/msm_rtb.h>
@@ -546,6 +547,17 @@ static struct ion_co_heap_pdata fw_co_ion_pdata = {
 	.adjacent_mem_id = ION_CP_MM_HEAP_ID,
 	.align = SZ_128K,
 };
+
+#ifdef CONFIG_CMA
+/*
+ * The camera and video heaps and the firmware heap next to them hold
+ * movable pages while nothing is allocated from them.
+ */
+static struct device ion_mm_cma_dev;
+#define ION_MM_CMA_DEV	(&ion_mm_cma_dev)
+#else
+#define ION_MM_CMA_DEV	NULL
+#endif
 #endif
 
 static struct ion_platform_data ion_pdata = {
@@ -564,6 +576,7 @@ static struct ion_platform_data ion_pdata = {
 			.size	= MSM_ION_MM_SIZE,
 			.memory_type = ION_EBI_TYPE,
 			.extra_data = (void *) &cp_mm_ion_pdata,
+			.cma_dev = ION_MM_CMA_DEV,
 		},
 		{
 			.id	= ION_MM_FIRMWARE_HEAP_ID,
@@ -572,6 +585,7 @@ static struct ion_platform_data ion_pdata = {
 			.size	= MSM_ION_MM_FW_SIZE,
 			.memory_type = ION_EBI_TYPE,
 			.extra_data = (void *) &fw_co_ion_pdata,
+			.cma_dev = ION_MM_CMA_DEV,
 		},
 		{
 			.id	= ION_CP_MFC_HEAP_ID,
@@ -637,7 +651,26 @@ struct platform_device fmem_device = {
 	.dev = { .platform_data = &fmem_pdata },
 };
 
-static void reserve_ion_memory(void)
+static void __init reserve_ion_mm_memory(void)
+{
+#if defined(CONFIG_ION_MSM) && defined(CONFIG_MSM_MULTIMEDIA_USE_ION)
+#ifdef CONFIG_CMA
+	unsigned int i;
+
+	if (!dma_declare_contiguous(&ion_mm_cma_dev,
+			msm_ion_cp_mm_size + MSM_ION_MM_FW_SIZE, 0, 0))
+		return;
+
+	/* Keep the heaps as plain carveouts */
+	for (i = 0; i < ion_pdata.nr; i++)
+		ion_pdata.heaps[i].cma_dev = NULL;
+#endif
+	msm8960_reserve_table[MEMTYPE_EBI1].size += msm_ion_cp_mm_size;
+	msm8960_reserve_table[MEMTYPE_EBI1].size += MSM_ION_MM_FW_SIZE;
+#endif
+}
+
+static void __init reserve_ion_memory(void)
 {
 #if defined(CONFIG_ION_MSM) && defined(CONFIG_MSM_MULTIMEDIA_USE_ION)
 	unsigned int i;
@@ -653,8 +686,7 @@ static void reserve_ion_memory(void)
 			}
 		}
 	}
-	msm8960_reserve_table[MEMTYPE_EBI1].size += msm_ion_cp_mm_size;
-	msm8960_reserve_table[MEMTYPE_EBI1].size += MSM_ION_MM_FW_SIZE;
+	reserve_ion_mm_memory();
 	msm8960_reserve_table[MEMTYPE_EBI1].size += MSM_ION_MFC_SIZE;
 	msm8960_reserve_table[MEMTYPE_EBI1].size += MSM_ION_QSECOM_SIZE;
 	msm8960_reserve_table[MEMTYPE_EBI1].size += MSM_ION_AUDIO_SIZE;
@@ -365,6 +365,10 @@ int __init clock_debug_add(struct clk *clock)
 				&clock_local_fops))
 		goto error;
 
+	if (!debugfs_create_u32("toggle_count", S_IRUGO | S_IWUSR, clk_dir,
+				&clock->toggle_count))
+		goto error;
+
 	if (!debugfs_create_file("has_hw_gating", S_IRUGO, clk_dir, clock,
 				&clock_hwcg_fops))
 		goto error;
@@ -33,6 +33,12 @@
 #define clk_rpmrs_set_rate_active_noirq(r, value) \
 	   __clk_rpmrs_set_rate((r), (value), (r)->rpmrs_data->ctx_active_id, 1)
 
+/* A lowered vote needn't wait for the RPM, except over SMD */
+#define RPM_CLK_ASYNC	2
+#define clk_rpmrs_set_rate_active_async(r, value) \
+	   __clk_rpmrs_set_rate((r), (value), (r)->rpmrs_data->ctx_active_id, \
+				RPM_CLK_ASYNC)
+
 static int clk_rpmrs_set_rate(struct rpm_clk *r, uint32_t value,
 			   uint32_t context, int noirq)
 {
@@ -40,6 +46,8 @@ static int clk_rpmrs_set_rate(struct rpm_clk *r, uint32_t value,
 		.id = r->rpm_clk_id,
 		.value = value,
 	};
+	if (noirq == RPM_CLK_ASYNC)
+		return msm_rpm_set_async(context, &iv, 1, NULL, NULL);
 	if (noirq)
 		return msm_rpmrs_set_noirq(context, &iv, 1);
 	else
@@ -171,7 +179,7 @@ static void rpm_clk_disable(struct clk *clk)
 		}
 
 		value = r->branch ? !!peer_khz : peer_khz;
-		rc = clk_rpmrs_set_rate_active_noirq(r, value);
+		rc = clk_rpmrs_set_rate_active_async(r, value);
 		if (rc)
 			goto out;
 
@@ -213,7 +221,10 @@ static int rpm_clk_set_rate(struct clk *clk, unsigned long rate)
 		}
 
 		value = max(this_khz, peer_khz);
-		rc = clk_rpmrs_set_rate_active_noirq(r, value);
+		if (value < max(r->last_set_khz, peer_khz))
+			rc = clk_rpmrs_set_rate_active_async(r, value);
+		else
+			rc = clk_rpmrs_set_rate_active_noirq(r, value);
 		if (rc)
 			goto out;
 
@@ -179,6 +179,37 @@ err_prepare_depends:
 EXPORT_SYMBOL(clk_prepare);
 LIST_HEAD(clk_enable_list);
 DEFINE_SPINLOCK(clk_enable_list_lock);
+/*
+ * Only the 0 -> 1 and 1 -> 0 transitions of clk->count are made under
+ * clk->lock.  Any other change is a cmpxchg, which lets enable and
+ * disable of an already running clock skip the lock.
+ */
+static bool clk_count_inc_not_zero(struct clk *clk)
+{
+	unsigned cnt = ACCESS_ONCE(clk->count), old;
+
+	while (cnt) {
+		old = cmpxchg(&clk->count, cnt, cnt + 1);
+		if (old == cnt)
+			return true;
+		cnt = old;
+	}
+	return false;
+}
+
+static bool clk_count_dec_not_one(struct clk *clk)
+{
+	unsigned cnt = ACCESS_ONCE(clk->count), old;
+
+	while (cnt > 1) {
+		old = cmpxchg(&clk->count, cnt, cnt - 1);
+		if (old == cnt)
+			return true;
+		cnt = old;
+	}
+	return false;
+}
+
 int clk_enable(struct clk *clk)
 {
 	int ret = 0;
@@ -190,12 +221,15 @@ int clk_enable(struct clk *clk)
 	if (IS_ERR(clk))
 		return -EINVAL;
 
+	if (clk_count_inc_not_zero(clk))
+		return 0;
+
 	spin_lock_irqsave(&clk->lock, flags);
 	if (WARN(!clk->warned && !clk->prepare_count,
 				"%s: Don't call enable on unprepared clocks\n",
 				clk->dbg_name))
 		clk->warned = true;
-	if (clk->count == 0) {
+	if (!clk_count_inc_not_zero(clk)) {
 		parent = clk_get_parent(clk);
 		if (!(clk->flags&CLKFLAG_IGNORE)) {
 			ret = clk_enable(parent);
@@ -219,8 +253,10 @@ int clk_enable(struct clk *clk)
 		if (!(clk->flags&CLKFLAG_IGNORE))
 			list_add(&clk->enable_list, &clk_enable_list);	
 		spin_unlock(&clk_enable_list_lock);
+		clk->toggle_count++;
+		smp_wmb();
+		ACCESS_ONCE(clk->count) = 1;
 	}
-	clk->count++;
 	spin_unlock_irqrestore(&clk->lock, flags);
 
 	return 0;
@@ -240,36 +276,42 @@ EXPORT_SYMBOL(clk_enable);
 void clk_disable(struct clk *clk)
 {
 	unsigned long flags;
+	struct clk *parent;
 
 	if (IS_ERR_OR_NULL(clk))
 		return;
 
+	if (clk_count_dec_not_one(clk))
+		return;
+
 	spin_lock_irqsave(&clk->lock, flags);
 	if (WARN(!clk->warned && !clk->prepare_count,
 				"%s: Never called prepare or calling disable "
 				"after unprepare\n",
 				clk->dbg_name))
 		clk->warned = true;
-	if (WARN(clk->count == 0, "%s is unbalanced", clk->dbg_name))
-		goto out;
-	if (clk->count == 1) {
-		struct clk *parent = clk_get_parent(clk);
+	for (;;) {
+		if (clk_count_dec_not_one(clk))
+			goto out;
+		if (WARN(clk->count == 0, "%s is unbalanced", clk->dbg_name))
+			goto out;
+		if (cmpxchg(&clk->count, 1, 0) == 1)
+			break;
+	}
 
-		trace_clock_disable(clk->dbg_name, 0, smp_processor_id());
-		if (clk->ops->disable)
-			clk->ops->disable(clk);
-		unvote_rate_vdd(clk, clk->rate);
+	parent = clk_get_parent(clk);
+	trace_clock_disable(clk->dbg_name, 0, smp_processor_id());
+	if (clk->ops->disable)
+		clk->ops->disable(clk);
+	unvote_rate_vdd(clk, clk->rate);
 
-		
-		if (!(clk->flags&CLKFLAG_IGNORE)) {
-			clk_disable(clk->depends);
-			clk_disable(parent);
-			spin_lock(&clk_enable_list_lock);
-			list_del(&clk->enable_list);
-			spin_unlock(&clk_enable_list_lock);
-		}
+	if (!(clk->flags&CLKFLAG_IGNORE)) {
+		clk_disable(clk->depends);
+		clk_disable(parent);
+		spin_lock(&clk_enable_list_lock);
+		list_del(&clk->enable_list);
+		spin_unlock(&clk_enable_list_lock);
 	}
-	clk->count--;
 out:
 	spin_unlock_irqrestore(&clk->lock, flags);
 }
@@ -110,6 +110,7 @@ struct clk {
 
 	bool warned;
 	unsigned count;
+	u32 toggle_count;
 	spinlock_t lock;
 	unsigned prepare_count;
 	struct mutex prepare_lock;
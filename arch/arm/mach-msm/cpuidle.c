@@ -95,6 +95,7 @@ static int msm_cpuidle_enter(
 {
 	int ret = 0;
 	int i = 0;
+	unsigned int predicted_us;
 	enum msm_pm_sleep_mode pm_mode;
 	struct cpuidle_state_usage *st_usage = NULL;
 #ifdef CONFIG_MSM_SLEEP_STATS
@@ -115,6 +116,11 @@ static int msm_cpuidle_enter(
 	pm_mode = msm_pm_idle_prepare(dev, drv, index);
 	trace_cpu_idle_rcuidle(pm_mode + 1, dev->cpu);
 	dev->last_residency = msm_pm_idle_enter(pm_mode);
+
+	predicted_us = cpuidle_predict_get_us(dev);
+	if (predicted_us)
+		msm_idle_stats_account_prediction(dev->cpu, predicted_us,
+						  dev->last_residency);
 	for (i = 0; i < dev->state_count; i++) {
 		st_usage = &dev->states_usage[i];
 		if ((enum msm_pm_sleep_mode) cpuidle_get_statedata(st_usage)
@@ -153,7 +159,7 @@ static void __init msm_cpuidle_set_states(void)
 		state = &msm_cpuidle_driver.states[state_count];
 		snprintf(state->name, CPUIDLE_NAME_LEN, cstate->name);
 		snprintf(state->desc, CPUIDLE_DESC_LEN, cstate->desc);
-		state->flags = 0;
+		state->flags = CPUIDLE_FLAG_TIME_VALID;
 		state->exit_latency = 0;
 		state->power_usage = 0;
 		state->target_residency = 0;
@@ -11,6 +11,7 @@
 #include <linux/errno.h>
 #include <linux/smp.h>
 #include <linux/cpu.h>
+#include <linux/ktime.h>
 
 #include <asm/cacheflush.h>
 #include <asm/smp_plat.h>
@@ -27,6 +28,7 @@ extern volatile int pen_release;
 struct msm_hotplug_device {
 	struct completion cpu_killed;
 	unsigned int warm_boot;
+	ktime_t transition_start;
 };
 
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct msm_hotplug_device,
@@ -97,6 +99,20 @@ int platform_cpu_disable(unsigned int cpu)
 #define CPUSET_SHIFT	4
 #define CPUSET_MASK	0xFFFF
 #define CPUSET_OF(n)	(((n) & CPUSET_MASK) << CPUSET_SHIFT)
+#define ONLINE_OF(n)	(!!(n) << 4)
+#define LATENCY_SHIFT	8
+#define LATENCY_MAX	(~0U >> LATENCY_SHIFT)
+
+/* Time from UP_PREPARE to ONLINE or DOWN_PREPARE to DEAD, in us */
+static void hotplug_rtb_latency(unsigned int cpu, bool online)
+{
+	struct msm_hotplug_device *dev = &per_cpu(msm_hotplug_devices, cpu);
+	s64 us = ktime_us_delta(ktime_get(), dev->transition_start);
+
+	us = clamp_t(s64, us, 0, LATENCY_MAX);
+	uncached_logk(LOGK_HOTPLUG_LATENCY, (void *)(CPU_OF(cpu) |
+		      ONLINE_OF(online) | ((unsigned int) us << LATENCY_SHIFT)));
+}
 
 static int hotplug_rtb_callback(struct notifier_block *nfb,
 				unsigned long action, void *hcpu)
@@ -106,6 +122,17 @@ static int hotplug_rtb_callback(struct notifier_block *nfb,
 	int cpudata = CPU_OF((int)hcpu) | cpumask;
 
 	switch (action & (~CPU_TASKS_FROZEN)) {
+	case CPU_UP_PREPARE:
+	case CPU_DOWN_PREPARE:
+		per_cpu(msm_hotplug_devices, (int)hcpu).transition_start =
+			ktime_get();
+		break;
+	case CPU_ONLINE:
+		hotplug_rtb_latency((int)hcpu, true);
+		break;
+	case CPU_DEAD:
+		hotplug_rtb_latency((int)hcpu, false);
+		break;
 	case CPU_STARTING:
 		uncached_logk(LOGK_HOTPLUG, (void *)(cpudata | this_cpumask));
 		break;
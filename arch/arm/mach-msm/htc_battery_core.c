@@ -24,6 +24,7 @@
 #include <linux/gpio.h>
 #include <linux/rtc.h>
 #include <linux/workqueue.h>
+#include <linux/htc_pnpmgr.h>
 #include <mach/htc_battery_core.h>
 #include <linux/android_alarm.h>
 #include <mach/board_htc.h>
@@ -1040,6 +1041,8 @@ int htc_battery_core_update_changed(void)
 			battery_core_info.rep.batt_id = 66;
 		}
 	}
+
+	pnpmgr_battery_level(battery_core_info.rep.level);
 #if 0
 	battery_core_info.rep.batt_vol = new_batt_info_rep.batt_vol;
 	battery_core_info.rep.batt_id = new_batt_info_rep.batt_id;
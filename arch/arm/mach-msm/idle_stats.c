@@ -20,6 +20,7 @@
 #include <linux/hrtimer.h>
 #include <linux/interrupt.h>
 #include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/version.h>
@@ -65,6 +66,17 @@ struct msm_idle_stats_device {
 static DEFINE_SPINLOCK(msm_idle_stats_devs_lock);
 static DEFINE_PER_CPU(struct msm_idle_stats_device *, msm_idle_stats_devs);
 
+/* How far off the predicted idle durations were, kept all the time */
+struct msm_idle_stats_prediction {
+	u32 count;
+	u32 too_long;
+	u32 too_short;
+	u64 error_us;
+};
+
+static DEFINE_PER_CPU(struct msm_idle_stats_prediction,
+		msm_idle_stats_predictions);
+
 
 static inline int64_t msm_idle_stats_bound_interval(int64_t interval)
 {
@@ -408,6 +420,47 @@ static long msm_idle_stats_ioctl(struct file *filp, unsigned int cmd,
 }
 
 
+/*
+ * Called with interrupts off on the CPU that just woke up.  A prediction is
+ * too long if the CPU slept less than half of it, which is when a deep
+ * state gets entered only to be left right away, and too short if it slept
+ * more than twice as long.
+ */
+void msm_idle_stats_account_prediction(unsigned int cpu,
+		unsigned int predicted_us, unsigned int actual_us)
+{
+	struct msm_idle_stats_prediction *pred =
+		&per_cpu(msm_idle_stats_predictions, cpu);
+
+	pred->count++;
+	if (actual_us * 2 < predicted_us)
+		pred->too_long++;
+	else if (actual_us > predicted_us * 2)
+		pred->too_short++;
+
+	pred->error_us += actual_us > predicted_us ?
+		actual_us - predicted_us : predicted_us - actual_us;
+}
+
+static ssize_t msm_idle_stats_prediction_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	unsigned int cpu = MINOR(dev->devt) - MINOR(msm_idle_stats_dev_nr);
+	struct msm_idle_stats_prediction *pred =
+		&per_cpu(msm_idle_stats_predictions, cpu);
+	u32 count = pred->count;
+
+	return snprintf(buf, PAGE_SIZE,
+		"count %u too_long %u too_short %u avg_error_us %llu\n",
+		count, pred->too_long, pred->too_short,
+		count ? div_u64(pred->error_us, count) : 0);
+}
+
+static struct device_attribute msm_idle_stats_dev_attrs[] = {
+	__ATTR(prediction, S_IRUGO, msm_idle_stats_prediction_show, NULL),
+	__ATTR_NULL,
+};
+
 static const struct file_operations msm_idle_stats_fops = {
 	.owner   = THIS_MODULE,
 	.open    = msm_idle_stats_open,
@@ -440,6 +493,7 @@ static int __init msm_idle_stats_init(void)
 		rc = -ENOMEM;
 		goto init_unreg_bail;
 	}
+	msm_idle_stats_class->dev_attrs = msm_idle_stats_dev_attrs;
 
 	for (i = 0; i < nr_cpus; i++) {
 		dev = device_create(msm_idle_stats_class, NULL,
@@ -0,0 +1,65 @@
+/* Copyright (c) 2012, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#ifndef __ARCH_ARM_MACH_MSM_AUTOGATE_H
+#define __ARCH_ARM_MACH_MSM_AUTOGATE_H
+
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
+struct clk;
+struct regulator;
+struct dentry;
+
+/* Leave the clocks prepared while idle gated, unprepare on suspend only */
+#define AUTOGATE_KEEP_PREPARED	BIT(0)
+
+/*
+ * A set of clocks that is switched on by the first autogate_get() and
+ * switched off once no one has held it for the idle timeout.  The
+ * timeout follows the average gap between a put and the next get: gaps
+ * shorter than max_ms keep the clocks on across them, longer ones gate
+ * after min_ms.  The optional regulator is on while the clocks are
+ * prepared.
+ *
+ * The caller fills in the fields up to flags before autogate_init().
+ */
+struct autogate {
+	const char *name;
+	struct clk **clks;
+	int num_clks;
+	struct regulator *regulator;
+	unsigned int min_ms;
+	unsigned int max_ms;
+	unsigned int flags;
+
+	struct mutex lock;
+	struct delayed_work work;
+	int users;
+	bool enabled;
+	bool prepared;
+	unsigned long last_put;
+	unsigned int avg_gap_ms;
+	unsigned int timeout_ms;
+	u32 gated;
+	u32 restarted;
+	struct dentry *dent;
+};
+
+int autogate_init(struct autogate *ag);
+void autogate_destroy(struct autogate *ag);
+int autogate_get(struct autogate *ag);
+void autogate_put(struct autogate *ag);
+void autogate_suspend(struct autogate *ag);
+
+#endif
@@ -60,6 +60,8 @@ int msm_bam_dmux_is_ch_low(uint32_t id);
 int msm_bam_dmux_reg_notify(void *priv,
 		       void (*notify)(void *priv, int event_type,
 						unsigned long data));
+
+int msm_bam_dmux_get_irq(void);
 #else
 static inline int msm_bam_dmux_open(uint32_t id, void *priv,
 		       void (*notify)(void *priv, int event_type,
@@ -109,5 +111,10 @@ static inline int msm_bam_dmux_reg_notify(void *priv,
 {
 	return -ENODEV;
 }
+
+static inline int msm_bam_dmux_get_irq(void)
+{
+	return 0;
+}
 #endif
 #endif 
@@ -47,6 +47,8 @@ int msm_cpuidle_register_notifier(unsigned int cpu,
 		struct notifier_block *nb);
 int msm_cpuidle_unregister_notifier(unsigned int cpu,
 		struct notifier_block *nb);
+void msm_idle_stats_account_prediction(unsigned int cpu,
+		unsigned int predicted_us, unsigned int actual_us);
 #else
 static inline int msm_cpuidle_register_notifier(unsigned int cpu,
 		struct notifier_block *nb)
@@ -54,6 +56,9 @@ static inline int msm_cpuidle_register_notifier(unsigned int cpu,
 static inline int msm_cpuidle_unregister_notifier(unsigned int cpu,
 		struct notifier_block *nb)
 { return -ENODEV; }
+static inline void msm_idle_stats_account_prediction(unsigned int cpu,
+		unsigned int predicted_us, unsigned int actual_us)
+{ }
 #endif
 
 #endif 
@@ -21,6 +21,7 @@ enum logk_event_type {
 	LOGK_HOTPLUG = 4,
 	LOGK_CTXID = 5,
 	LOGK_TIMESTAMP = 6,
+	LOGK_HOTPLUG_LATENCY = 7,
 	
 	LOGK_IRQ = 10,
 	LOGK_DIE = 11,
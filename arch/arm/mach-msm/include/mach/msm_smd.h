@@ -19,6 +19,7 @@
 #define __ASM_ARCH_MSM_SMD_H
 
 #include <linux/io.h>
+#include <linux/uio.h>
 #include <mach/msm_smsm.h>
 
 typedef struct smd_channel smd_channel_t;
@@ -127,9 +128,30 @@ int smd_read_user_buffer(smd_channel_t *ch, void *data, int len);
 int smd_write(smd_channel_t *ch, const void *data, int len);
 int smd_write_user_buffer(smd_channel_t *ch, const void *data, int len);
 
+/* Writes each vector entry (one packet each on packet channels) with a
+ * single interrupt to the remote side.  Returns the number of bytes
+ * written; packets are never split, so a short count ends on a packet
+ * boundary.
+ */
+int smd_writev(smd_channel_t *ch, const struct kvec *vec, int cnt);
+
+/* Reads up to cnt complete packets from a packet channel, one per vector
+ * entry, and sets each iov_len to the packet size.  Returns the number of
+ * packets read, or -ETOOSMALL if the first pending packet does not fit.
+ */
+int smd_readv(smd_channel_t *ch, struct kvec *vec, int cnt);
+
+/* Holds the write interrupt back for up to usecs so that writes in quick
+ * succession share one interrupt.  0, the default, signals every write.
+ */
+int smd_set_signal_delay(smd_channel_t *ch, unsigned usecs);
+
 int smd_write_avail(smd_channel_t *ch);
 int smd_read_avail(smd_channel_t *ch);
 
+/* Bytes waiting in the receive fifo, packet headers included */
+int smd_read_pending(smd_channel_t *ch);
+
 int smd_cur_packet_size(smd_channel_t *ch);
 
 
@@ -237,6 +259,22 @@ smd_write_user_buffer(smd_channel_t *ch, const void *data, int len)
 	return -ENODEV;
 }
 
+static inline int
+smd_writev(smd_channel_t *ch, const struct kvec *vec, int cnt)
+{
+	return -ENODEV;
+}
+
+static inline int smd_readv(smd_channel_t *ch, struct kvec *vec, int cnt)
+{
+	return -ENODEV;
+}
+
+static inline int smd_set_signal_delay(smd_channel_t *ch, unsigned usecs)
+{
+	return -ENODEV;
+}
+
 static inline int smd_write_avail(smd_channel_t *ch)
 {
 	return -ENODEV;
@@ -247,6 +285,11 @@ static inline int smd_read_avail(smd_channel_t *ch)
 	return -ENODEV;
 }
 
+static inline int smd_read_pending(smd_channel_t *ch)
+{
+	return -ENODEV;
+}
+
 static inline int smd_cur_packet_size(smd_channel_t *ch)
 {
 	return -ENODEV;
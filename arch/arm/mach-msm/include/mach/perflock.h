@@ -20,12 +20,15 @@
 #define __ARCH_ARM_MACH_PERF_LOCK_H
 
 #include <linux/list.h>
+#include <linux/plist.h>
 #include <linux/cpufreq.h>
 
 
 enum {
 	TYPE_PERF_LOCK = 0,	
 	TYPE_CPUFREQ_CEILING,	
+	/* level is a minimum number of online cores */
+	TYPE_PERF_CORES,
 };
 
 enum {
@@ -39,6 +42,9 @@ enum {
 
 struct perf_lock {
 	struct list_head link;
+	struct plist_node node;
+	struct list_head timed;
+	unsigned long expires;
 	unsigned int flags;
 	unsigned int level;
 	const char *name;
@@ -60,9 +66,12 @@ struct perflock_pdata {
 static inline void perf_lock_init(struct perf_lock *lock, unsigned int type,
 	unsigned int level, const char *name) { return; }
 static inline void perf_lock(struct perf_lock *lock) { return; }
+static inline void perf_lock_timeout(struct perf_lock *lock,
+	unsigned long timeout) { return; }
 static inline void perf_unlock(struct perf_lock *lock) { return; }
 static inline int is_perf_lock_active(struct perf_lock *lock) { return 0; }
 static inline int is_perf_locked(void) { return 0; }
+static inline unsigned int perflock_min_cores(void) { return 0; }
 static inline void perflock_scaling_max_freq(unsigned int freq, unsigned int cpu) { return; }
 static inline void perflock_scaling_min_freq(unsigned int freq, unsigned int cpu) { return; }
 static inline void htc_print_active_perf_locks(void) { return; }
@@ -73,9 +82,11 @@ static inline int perflock_release(const char *name) { return 0; }
 extern void perf_lock_init(struct perf_lock *lock, unsigned int type,
 	unsigned int level, const char *name);
 extern void perf_lock(struct perf_lock *lock);
+extern void perf_lock_timeout(struct perf_lock *lock, unsigned long timeout);
 extern void perf_unlock(struct perf_lock *lock);
 extern int is_perf_lock_active(struct perf_lock *lock);
 extern int is_perf_locked(void);
+extern unsigned int perflock_min_cores(void);
 extern void perflock_scaling_max_freq(unsigned int freq, unsigned int cpu);
 extern void perflock_scaling_min_freq(unsigned int freq, unsigned int cpu);
 extern int perflock_override(const struct cpufreq_policy *policy, const unsigned int new_freq);
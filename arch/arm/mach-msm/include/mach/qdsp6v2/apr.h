@@ -13,6 +13,8 @@
 #ifndef __APR_H_
 #define __APR_H_
 
+#include <linux/ktime.h>
+
 #define APR_Q6_NOIMG   0
 #define APR_Q6_LOADING 1
 #define APR_Q6_LOADED  2
@@ -106,6 +108,17 @@ struct apr_client_data {
 
 typedef int32_t (*apr_fn)(struct apr_client_data *data, void *priv);
 
+/* Most commands a single apr_send_pkts() call takes */
+#define APR_MAX_BATCH		16
+#define APR_PENDING_MAX		8
+
+struct apr_pending {
+	uint32_t opcode;
+	uint32_t token;
+	uint16_t port;
+	ktime_t sent;
+};
+
 struct apr_svc {
 	uint16_t id;
 	uint16_t dest_id;
@@ -120,6 +133,9 @@ struct apr_svc {
 	void *priv;
 	struct mutex m_lock;
 	spinlock_t w_lock;
+	spinlock_t pending_lock;
+	uint8_t pending_head;
+	struct apr_pending pending[APR_PENDING_MAX];
 };
 
 struct apr_client {
@@ -129,6 +145,7 @@ struct apr_client {
 	struct mutex m_lock;
 	struct apr_svc_ch_dev *handle;
 	struct apr_svc svc[APR_SVC_MAX];
+	uint8_t svc_map[APR_SVC_MAX];
 };
 
 struct apr_svc *apr_register(char *dest, char *svc_name, apr_fn svc_fn,
@@ -138,6 +155,7 @@ inline int apr_fill_hdr(void *handle, uint32_t *buf, uint16_t src_port,
 			uint32_t token, uint32_t opcode, uint16_t len);
 
 int apr_send_pkt(void *handle, uint32_t *buf);
+int apr_send_pkts(void *handle, uint32_t **bufs, int cnt);
 int apr_deregister(void *handle);
 void change_q6_state(int state);
 void q6audio_dsp_not_responding(void);
@@ -16,6 +16,7 @@
 #include <linux/kernel.h>
 #include <linux/kthread.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
 
 #define APR_CLIENT_AUDIO	0x0
 #define APR_CLIENT_VOICE	0x1
@@ -36,6 +37,8 @@ typedef void (*apr_svc_cb_fn)(void *buf, int len, void *priv);
 struct apr_svc_ch_dev *apr_tal_open(uint32_t svc, uint32_t dest,
 			uint32_t dl, apr_svc_cb_fn func, void *priv);
 int apr_tal_write(struct apr_svc_ch_dev *apr_ch, void *data, int len);
+int apr_tal_writev(struct apr_svc_ch_dev *apr_ch, const struct kvec *vec,
+			int cnt, int len);
 int apr_tal_close(struct apr_svc_ch_dev *apr_ch);
 struct apr_svc_ch_dev {
 	struct smd_channel *ch;
@@ -851,6 +851,12 @@ struct msm_rpm_iv_pair {
 	uint32_t value;
 };
 
+struct msm_rpm_msg_stats {
+	unsigned long requests;
+	unsigned long async_requests;
+	unsigned long messages;
+};
+
 struct msm_rpm_notification {
 	struct list_head list;  
 	struct semaphore sem;
@@ -921,6 +927,18 @@ static inline int msm_rpm_set_nosleep(
 	return rc;
 }
 
+/*
+ * Queue a request without waiting for the RPM.  Queued requests of a set
+ * go out together with the next message for that set, or from a worker,
+ * and done (may be NULL) is called with that message's result, possibly
+ * with irqs disabled and always without calling back into this driver.
+ * Only for votes the caller need not see applied before it goes on, e.g.
+ * dropping a vote.  Safe from any context.
+ */
+int msm_rpm_set_async(int ctx, struct msm_rpm_iv_pair *req, int count,
+	void (*done)(void *data, int rc), void *data);
+void msm_rpm_get_msg_stats(struct msm_rpm_msg_stats *stats);
+
 int msm_rpm_clear(int ctx, struct msm_rpm_iv_pair *req, int count);
 int msm_rpm_clear_noirq(int ctx, struct msm_rpm_iv_pair *req, int count);
 
@@ -978,6 +996,17 @@ static inline int msm_rpm_set_nosleep(
 	return -ENODEV;
 }
 
+static inline int msm_rpm_set_async(int ctx, struct msm_rpm_iv_pair *req,
+	int count, void (*done)(void *data, int rc), void *data)
+{
+	return -ENODEV;
+}
+
+static inline void msm_rpm_get_msg_stats(struct msm_rpm_msg_stats *stats)
+{
+	stats->requests = stats->async_requests = stats->messages = 0;
+}
+
 static inline int msm_rpm_clear(int ctx, struct msm_rpm_iv_pair *req,
 				int count)
 {
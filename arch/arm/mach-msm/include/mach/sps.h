@@ -282,6 +282,14 @@ struct sps_connect {
 	u32 irq_gen_addr;
 	u32 irq_gen_data;
 
+	/*
+	 * Interrupt moderation: once irq_mod_count interrupts arrive within
+	 * irq_mod_usecs the pipe interrupt is masked and the pipe is
+	 * serviced from a timer irq_mod_usecs later.  Zero disables it.
+	 */
+	u32 irq_mod_count;
+	u32 irq_mod_usecs;
+
 	u32 sps_reserved;
 
 };
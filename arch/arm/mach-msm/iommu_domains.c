@@ -54,53 +54,29 @@ int msm_iommu_map_extra(struct iommu_domain *domain,
 	int ret = 0;
 	int i = 0;
 	unsigned long phy_addr = ALIGN(virt_to_phys(iommu_dummy), page_size);
-	unsigned long temp_iova = start_iova;
-	if (page_size == SZ_4K) {
-		struct scatterlist *sglist;
-		unsigned int nrpages = PFN_ALIGN(size) >> PAGE_SHIFT;
-		struct page *dummy_page = phys_to_page(phy_addr);
-
-		sglist = vmalloc(sizeof(*sglist) * nrpages);
-		if (!sglist) {
-			ret = -ENOMEM;
-			goto out;
-		}
+	unsigned long aligned_size = ALIGN(size, page_size);
+	unsigned int nrpages = aligned_size / page_size;
+	struct page *dummy_page = phys_to_page(phy_addr);
+	struct scatterlist *sglist;
 
-		sg_init_table(sglist, nrpages);
+	sglist = vmalloc(sizeof(*sglist) * nrpages);
+	if (!sglist)
+		return -ENOMEM;
 
-		for (i = 0; i < nrpages; i++)
-			sg_set_page(&sglist[i], dummy_page, PAGE_SIZE, 0);
+	sg_init_table(sglist, nrpages);
 
-		ret = iommu_map_range(domain, temp_iova, sglist, size, cached);
-		if (ret) {
-			pr_err("%s: could not map extra %lx in domain %p\n",
-				__func__, start_iova, domain);
-		}
+	for (i = 0; i < nrpages; i++)
+		sg_set_page(&sglist[i], dummy_page, page_size, 0);
 
-		vfree(sglist);
-	} else {
-		unsigned long order = get_order(page_size);
-		unsigned long aligned_size = ALIGN(size, page_size);
-		unsigned long nrpages = aligned_size >> (PAGE_SHIFT + order);
-
-		for (i = 0; i < nrpages; i++) {
-			ret = iommu_map(domain, temp_iova, phy_addr, page_size,
-						cached);
-			if (ret) {
-				pr_err("%s: could not map %lx in domain %p, error: %d\n",
-					__func__, start_iova, domain, ret);
-				ret = -EAGAIN;
-				goto out;
-			}
-			temp_iova += page_size;
-		}
-	}
-	return ret;
-out:
-	for (; i > 0; --i) {
-		temp_iova -= page_size;
-		iommu_unmap(domain, start_iova, page_size);
+	ret = iommu_map_range(domain, start_iova, sglist, aligned_size, cached);
+	if (ret) {
+		pr_err("%s: could not map extra %lx in domain %p, error: %d\n",
+			__func__, start_iova, domain, ret);
+		iommu_unmap_range(domain, start_iova, aligned_size);
+		ret = -EAGAIN;
 	}
+
+	vfree(sglist);
 	return ret;
 }
 
@@ -109,16 +85,7 @@ void msm_iommu_unmap_extra(struct iommu_domain *domain,
 				unsigned long size,
 				unsigned long page_size)
 {
-	int i;
-	unsigned long order = get_order(page_size);
-	unsigned long aligned_size = ALIGN(size, page_size);
-	unsigned long nrpages =  aligned_size >> (PAGE_SHIFT + order);
-	unsigned long temp_iova = start_iova;
-
-	for (i = 0; i < nrpages; ++i) {
-		iommu_unmap(domain, temp_iova, page_size);
-		temp_iova += page_size;
-	}
+	iommu_unmap_range(domain, start_iova, ALIGN(size, page_size));
 }
 
 static int msm_iommu_map_iova_phys(struct iommu_domain *domain,
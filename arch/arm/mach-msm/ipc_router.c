@@ -27,6 +27,7 @@
 #include <linux/platform_device.h>
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
+#include <linux/rculist.h>
 
 #include <asm/uaccess.h>
 #include <asm/byteorder.h>
@@ -152,6 +153,11 @@ struct msm_ipc_routing_table_entry {
 	unsigned long num_rx_bytes;
 };
 
+/*
+ * Entries are only ever added, under routing_table_lock, and never freed.
+ * Lookups walk the hash chains under RCU and need no table lock; the
+ * entry itself is protected by its own lock.
+ */
 static struct list_head routing_table[RT_HASH_SIZE];
 static DEFINE_MUTEX(routing_table_lock);
 static int routing_table_inited;
@@ -234,7 +240,7 @@ static int add_routing_table_entry(
 		return -EINVAL;
 
 	key = (rt_entry->node_id % RT_HASH_SIZE);
-	list_add_tail(&rt_entry->list, &routing_table[key]);
+	list_add_tail_rcu(&rt_entry->list, &routing_table[key]);
 	return 0;
 }
 
@@ -244,10 +250,14 @@ static struct msm_ipc_routing_table_entry *lookup_routing_table(
 	uint32_t key = (node_id % RT_HASH_SIZE);
 	struct msm_ipc_routing_table_entry *rt_entry;
 
-	list_for_each_entry(rt_entry, &routing_table[key], list) {
-		if (rt_entry->node_id == node_id)
+	rcu_read_lock();
+	list_for_each_entry_rcu(rt_entry, &routing_table[key], list) {
+		if (rt_entry->node_id == node_id) {
+			rcu_read_unlock();
 			return rt_entry;
+		}
 	}
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -369,8 +379,10 @@ static int post_control_ports(struct rr_packet *pkt)
 
 	mutex_lock(&control_ports_lock);
 	list_for_each_entry(port_ptr, &control_ports, list) {
-		mutex_lock(&port_ptr->port_rx_q_lock);
 		cloned_pkt = clone_pkt(pkt);
+		if (!cloned_pkt)
+			continue;
+		mutex_lock(&port_ptr->port_rx_q_lock);
 		wake_lock(&port_ptr->port_rx_wake_lock);
 		list_add_tail(&cloned_pkt->list, &port_ptr->port_rx_q);
 		wake_up(&port_ptr->port_rx_wait_q);
@@ -490,10 +502,8 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 	struct msm_ipc_routing_table_entry *rt_entry;
 	int key = (port_id & (RP_HASH_SIZE - 1));
 
-	mutex_lock(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
 		pr_err("%s: Node is not up\n", __func__);
 		return NULL;
 	}
@@ -505,12 +515,10 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_lookup_remote_port(
 			if (rport_ptr->restart_state != RESTART_NORMAL)
 				rport_ptr = NULL;
 			mutex_unlock(&rt_entry->lock);
-			mutex_unlock(&routing_table_lock);
 			return rport_ptr;
 		}
 	}
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
 	return NULL;
 }
 
@@ -522,10 +530,8 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 	struct msm_ipc_routing_table_entry *rt_entry;
 	int key = (port_id & (RP_HASH_SIZE - 1));
 
-	mutex_lock(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
 		pr_err("%s: Node is not up\n", __func__);
 		return NULL;
 	}
@@ -535,7 +541,6 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 			    GFP_KERNEL);
 	if (!rport_ptr) {
 		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
 		pr_err("%s: Remote port alloc failed\n", __func__);
 		return NULL;
 	}
@@ -548,7 +553,6 @@ static struct msm_ipc_router_remote_port *msm_ipc_router_create_remote_port(
 	list_add_tail(&rport_ptr->list,
 		      &rt_entry->remote_port_list[key]);
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
 	return rport_ptr;
 }
 
@@ -562,10 +566,8 @@ static void msm_ipc_router_destroy_remote_port(
 		return;
 
 	node_id = rport_ptr->node_id;
-	mutex_lock(&routing_table_lock);
 	rt_entry = lookup_routing_table(node_id);
 	if (!rt_entry) {
-		mutex_unlock(&routing_table_lock);
 		pr_err("%s: Node %d is not up\n", __func__, node_id);
 		return;
 	}
@@ -574,7 +576,6 @@ static void msm_ipc_router_destroy_remote_port(
 	list_del(&rport_ptr->list);
 	kfree(rport_ptr);
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
 	return;
 }
 
@@ -957,21 +958,23 @@ static int forward_msg(struct msm_ipc_router_xprt_info *xprt_info,
 
 	hdr = (struct rr_header *)head_pkt->data;
 	dst_node_id = hdr->dst_node_id;
-	mutex_lock(&routing_table_lock);
 	rt_entry = lookup_routing_table(dst_node_id);
-	if (!(rt_entry) || !(rt_entry->xprt_info)) {
-		mutex_unlock(&routing_table_lock);
+	if (!rt_entry) {
 		pr_err("%s: Routing table not initialized\n", __func__);
 		return -ENODEV;
 	}
 
 	mutex_lock(&rt_entry->lock);
 	fwd_xprt_info = rt_entry->xprt_info;
+	if (!fwd_xprt_info) {
+		mutex_unlock(&rt_entry->lock);
+		pr_err("%s: Routing table not initialized\n", __func__);
+		return -ENODEV;
+	}
 	mutex_lock(&fwd_xprt_info->tx_lock);
 	if (xprt_info->remote_node_id == fwd_xprt_info->remote_node_id) {
 		mutex_unlock(&fwd_xprt_info->tx_lock);
 		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
 		pr_err("%s: Discarding Command to route back\n", __func__);
 		return -EINVAL;
 	}
@@ -979,14 +982,12 @@ static int forward_msg(struct msm_ipc_router_xprt_info *xprt_info,
 	if (xprt_info->xprt->link_id == fwd_xprt_info->xprt->link_id) {
 		mutex_unlock(&fwd_xprt_info->tx_lock);
 		mutex_unlock(&rt_entry->lock);
-		mutex_unlock(&routing_table_lock);
 		pr_err("%s: DST in the same cluster\n", __func__);
 		return 0;
 	}
 	fwd_xprt_info->xprt->write(pkt, pkt->length, fwd_xprt_info->xprt);
 	mutex_unlock(&fwd_xprt_info->tx_lock);
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
 
 	return 0;
 }
@@ -1712,21 +1713,24 @@ static int msm_ipc_router_write_pkt(struct msm_ipc_port *src,
 		hdr->confirm_rx = 1;
 	mutex_unlock(&rport_ptr->quota_lock);
 
-	mutex_lock(&routing_table_lock);
 	rt_entry = lookup_routing_table(hdr->dst_node_id);
-	if (!rt_entry || !rt_entry->xprt_info) {
-		mutex_unlock(&routing_table_lock);
+	if (!rt_entry) {
 		pr_err("%s: Remote node %d not up\n",
 			__func__, hdr->dst_node_id);
 		return -ENODEV;
 	}
 	mutex_lock(&rt_entry->lock);
 	xprt_info = rt_entry->xprt_info;
+	if (!xprt_info) {
+		mutex_unlock(&rt_entry->lock);
+		pr_err("%s: Remote node %d not up\n",
+			__func__, hdr->dst_node_id);
+		return -ENODEV;
+	}
 	mutex_lock(&xprt_info->tx_lock);
 	ret = xprt_info->xprt->write(pkt, pkt->length, xprt_info->xprt);
 	mutex_unlock(&xprt_info->tx_lock);
 	mutex_unlock(&rt_entry->lock);
-	mutex_unlock(&routing_table_lock);
 
 	if (ret < 0) {
 		pr_err("%s: Write on XPRT failed\n", __func__);
@@ -2518,9 +2522,14 @@ void msm_ipc_router_xprt_notify(struct msm_ipc_router_xprt *xprt,
 		xprt_info = xprt->priv;
 	}
 
-	pkt = clone_pkt((struct rr_packet *)data);
+	/*
+	 * Take the fragments over instead of cloning them, the transport
+	 * only frees the now empty packet it passed in.
+	 */
+	pkt = create_pkt(((struct rr_packet *)data)->pkt_fragment_q);
 	if (!pkt)
 		return;
+	((struct rr_packet *)data)->pkt_fragment_q = NULL;
 
 	mutex_lock(&xprt_info->rx_lock);
 	list_add_tail(&pkt->list, &xprt_info->pkt_list);
@@ -19,6 +19,8 @@
 #include <linux/mutex.h>
 #include <linux/radix-tree.h>
 #include <linux/clk.h>
+#include <linux/workqueue.h>
+#include <linux/perf_telemetry.h>
 #include <mach/msm_bus.h>
 #include "msm_bus_core.h"
 
@@ -43,6 +45,15 @@
 
 static DEFINE_MUTEX(msm_bus_lock);
 
+/*
+ * A vote that lowers every path of a client is held back for
+ * down_vote_delay_ms, further down-votes in that window only replace it
+ * and any other vote cancels it, so bursty clients don't walk the fabric
+ * clocks and the RPM up and down.  Up-votes are always applied at once.
+ */
+static unsigned int down_vote_delay_ms = 50;
+module_param(down_vote_delay_ms, uint, 0644);
+
 static int add_path_node(struct msm_bus_inode_info *info, int next)
 {
 	struct path_node *pnode;
@@ -392,6 +403,8 @@ uint32_t msm_bus_scale_register_client(struct msm_bus_scale_pdata *pdata)
 	mutex_lock(&msm_bus_lock);
 	client->pdata = pdata;
 	client->curr = -1;
+	client->pending = -1;
+	INIT_DELAYED_WORK(&client->down_work, msm_bus_down_vote_fn);
 	for (i = 0; i < pdata->usecase->num_paths; i++) {
 		int *pnode;
 		struct msm_bus_fabric_device *srcfab;
@@ -452,33 +465,18 @@ err:
 }
 EXPORT_SYMBOL(msm_bus_scale_register_client);
 
-int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
+static int msm_bus_apply_request(struct msm_bus_client *client,
+	unsigned index)
 {
 	int i, ret = 0;
 	struct msm_bus_scale_pdata *pdata;
 	int pnode, src, curr, ctx;
 	unsigned long req_clk, req_bw, curr_clk, curr_bw;
-	struct msm_bus_client *client = (struct msm_bus_client *)cl;
-	if (IS_ERR(client)) {
-		MSM_BUS_ERR("msm_bus_scale_client update req error %d\n",
-				(uint32_t)client);
-		return -ENXIO;
-	}
-
-	mutex_lock(&msm_bus_lock);
-	if (client->curr == index)
-		goto err;
+	uint32_t cl = (uint32_t)client;
 
 	curr = client->curr;
 	pdata = client->pdata;
 
-	if (index >= pdata->num_usecases) {
-		MSM_BUS_ERR("Client %u passed invalid index: %d\n",
-			(uint32_t)client, index);
-		ret = -ENXIO;
-		goto err;
-	}
-
 	MSM_BUS_DBG("cl: %u index: %d curr: %d"
 			" num_paths: %d\n", cl, index, client->curr,
 			client->pdata->usecase->num_paths);
@@ -532,8 +530,93 @@ int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
 	client->curr = index;
 	ctx = ACTIVE_CTX;
 	msm_bus_dbg_client_data(client->pdata, index, cl);
+	perf_tm_log(PERF_TM_BUS_VOTE, cl, index, 0);
 	bus_for_each_dev(&msm_bus_type, NULL, NULL, msm_bus_commit_fn);
 
+err:
+	return ret;
+}
+
+static bool msm_bus_is_down_vote(struct msm_bus_client *client,
+	unsigned index)
+{
+	struct msm_bus_vectors *req, *cur;
+	int i;
+
+	if (client->curr < 0)
+		return false;
+
+	req = client->pdata->usecase[index].vectors;
+	cur = client->pdata->usecase[client->curr].vectors;
+	for (i = 0; i < client->pdata->usecase->num_paths; i++)
+		if (req[i].ib > cur[i].ib || req[i].ab > cur[i].ab)
+			return false;
+	return true;
+}
+
+static void msm_bus_down_vote_fn(struct work_struct *work)
+{
+	struct msm_bus_client *client = container_of(work,
+		struct msm_bus_client, down_work.work);
+	int index;
+
+	mutex_lock(&msm_bus_lock);
+	index = client->pending;
+	if (index >= 0) {
+		client->pending = -1;
+		if (!msm_bus_apply_request(client, index))
+			msm_bus_dbg_client_vote((uint32_t)client,
+				MSM_BUS_DBG_VOTE_DOWN);
+	}
+	mutex_unlock(&msm_bus_lock);
+}
+
+int msm_bus_scale_client_update_request(uint32_t cl, unsigned index)
+{
+	int ret = 0;
+	bool down;
+	struct msm_bus_client *client = (struct msm_bus_client *)cl;
+	if (IS_ERR(client)) {
+		MSM_BUS_ERR("msm_bus_scale_client update req error %d\n",
+				(uint32_t)client);
+		return -ENXIO;
+	}
+
+	mutex_lock(&msm_bus_lock);
+	if (index >= client->pdata->num_usecases) {
+		MSM_BUS_ERR("Client %u passed invalid index: %d\n",
+			(uint32_t)client, index);
+		ret = -ENXIO;
+		goto err;
+	}
+
+	down = client->curr != index && msm_bus_is_down_vote(client, index);
+	if (client->pending >= 0) {
+		if (down) {
+			client->pending = index;
+			msm_bus_dbg_client_vote(cl, MSM_BUS_DBG_VOTE_MERGED);
+			goto err;
+		}
+		cancel_delayed_work(&client->down_work);
+		client->pending = -1;
+		msm_bus_dbg_client_vote(cl, MSM_BUS_DBG_VOTE_CANCELLED);
+	}
+
+	if (client->curr == index)
+		goto err;
+
+	if (down && down_vote_delay_ms) {
+		client->pending = index;
+		schedule_delayed_work(&client->down_work,
+			msecs_to_jiffies(down_vote_delay_ms));
+		msm_bus_dbg_client_vote(cl, MSM_BUS_DBG_VOTE_DEFERRED);
+		goto err;
+	}
+
+	ret = msm_bus_apply_request(client, index);
+	if (!ret)
+		msm_bus_dbg_client_vote(cl, down ? MSM_BUS_DBG_VOTE_DOWN :
+			MSM_BUS_DBG_VOTE_UP);
 err:
 	mutex_unlock(&msm_bus_lock);
 	return ret;
@@ -626,13 +709,15 @@ void msm_bus_scale_unregister_client(uint32_t cl)
 	struct msm_bus_client *client = (struct msm_bus_client *)(cl);
 	if (IS_ERR(client) || (!client))
 		return;
-	if (client->curr != 0)
-		msm_bus_scale_client_update_request(cl, 0);
 	MSM_BUS_DBG("Unregistering client %d\n", cl);
 	mutex_lock(&msm_bus_lock);
+	client->pending = -1;
+	if (client->curr != 0)
+		msm_bus_apply_request(client, 0);
 	msm_bus_scale_client_reset_pnodes(cl);
 	msm_bus_dbg_client_data(client->pdata, MSM_BUS_DBG_UNREGISTER, cl);
 	mutex_unlock(&msm_bus_lock);
+	cancel_delayed_work_sync(&client->down_work);
 	kfree(client->src_pnode);
 	kfree(client);
 }
@@ -17,6 +17,7 @@
 #include <linux/device.h>
 #include <linux/radix-tree.h>
 #include <linux/platform_device.h>
+#include <linux/workqueue.h>
 #include <mach/msm_bus_board.h>
 #include <mach/msm_bus.h>
 
@@ -46,6 +47,15 @@ enum msm_bus_dbg_op_type {
 	MSM_BUS_DBG_OP = 1,
 };
 
+enum msm_bus_dbg_vote_type {
+	MSM_BUS_DBG_VOTE_UP,
+	MSM_BUS_DBG_VOTE_DOWN,
+	MSM_BUS_DBG_VOTE_DEFERRED,
+	MSM_BUS_DBG_VOTE_MERGED,
+	MSM_BUS_DBG_VOTE_CANCELLED,
+	MSM_BUS_DBG_VOTE_MAX,
+};
+
 enum msm_bus_hw_sel {
 	MSM_BUS_RPM = 0,
 	MSM_BUS_NOC,
@@ -195,6 +205,8 @@ struct msm_bus_client {
 	struct msm_bus_scale_pdata *pdata;
 	int *src_pnode;
 	int curr;
+	int pending;
+	struct delayed_work down_work;
 };
 
 int msm_bus_fabric_device_register(struct msm_bus_fabric_device *fabric);
@@ -218,6 +230,7 @@ void msm_bus_dbg_client_data(struct msm_bus_scale_pdata *pdata, int index,
 	uint32_t cl);
 void msm_bus_dbg_commit_data(const char *fabname, void *cdata,
 	int nmasters, int nslaves, int ntslaves, int op);
+void msm_bus_dbg_client_vote(uint32_t cl, int type);
 #else
 static inline void msm_bus_dbg_client_data(struct msm_bus_scale_pdata *pdata,
 	int index, uint32_t cl)
@@ -228,6 +241,9 @@ static inline void msm_bus_dbg_commit_data(const char *fabname,
 	int op)
 {
 }
+static inline void msm_bus_dbg_client_vote(uint32_t cl, int type)
+{
+}
 #endif
 
 #endif 
@@ -22,6 +22,7 @@
 #include <linux/string.h>
 #include <linux/uaccess.h>
 #include <linux/hrtimer.h>
+#include <linux/jiffies.h>
 #include <mach/msm_bus_board.h>
 #include <mach/msm_bus.h>
 #include "msm_bus_core.h"
@@ -45,6 +46,8 @@ struct msm_bus_cldata {
 	int size;
 	struct dentry *file;
 	struct list_head list;
+	unsigned long votes[MSM_BUS_DBG_VOTE_MAX];
+	unsigned long start;
 	char buffer[MAX_BUFF_SIZE];
 };
 
@@ -316,6 +319,8 @@ static int msm_bus_dbg_record_client(const struct msm_bus_scale_pdata *pdata,
 	cldata->clid = clid;
 	cldata->file = file;
 	cldata->size = 0;
+	memset(cldata->votes, 0, sizeof(cldata->votes));
+	cldata->start = jiffies;
 	list_add_tail(&cldata->list, &cl_list);
 	return 0;
 }
@@ -572,6 +577,59 @@ void msm_bus_dbg_client_data(struct msm_bus_scale_pdata *pdata, int index,
 }
 EXPORT_SYMBOL(msm_bus_dbg_client_data);
 
+void msm_bus_dbg_client_vote(uint32_t cl, int type)
+{
+	struct msm_bus_cldata *cldata;
+
+	list_for_each_entry(cldata, &cl_list, list) {
+		if (cldata->clid == cl) {
+			cldata->votes[type]++;
+			break;
+		}
+	}
+}
+
+static int msm_bus_dbg_votes_show(struct seq_file *m, void *unused)
+{
+	static const char * const names[MSM_BUS_DBG_VOTE_MAX] = {
+		"up", "down", "deferred", "merged", "cancelled",
+	};
+	struct msm_bus_cldata *cldata;
+	unsigned long total, secs;
+	int i;
+
+	seq_printf(m, "%-24s", "client");
+	for (i = 0; i < MSM_BUS_DBG_VOTE_MAX; i++)
+		seq_printf(m, " %9s", names[i]);
+	seq_printf(m, " %9s\n", "votes/s");
+
+	list_for_each_entry(cldata, &cl_list, list) {
+		total = 0;
+		seq_printf(m, "%-24s", cldata->pdata->name ?
+			cldata->pdata->name : "?");
+		for (i = 0; i < MSM_BUS_DBG_VOTE_MAX; i++) {
+			seq_printf(m, " %9lu", cldata->votes[i]);
+			if (i != MSM_BUS_DBG_VOTE_CANCELLED)
+				total += cldata->votes[i];
+		}
+		secs = (jiffies - cldata->start) / HZ;
+		seq_printf(m, " %9lu\n", total / (secs ? secs : 1));
+	}
+	return 0;
+}
+
+static int msm_bus_dbg_votes_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_bus_dbg_votes_show, NULL);
+}
+
+static const struct file_operations msm_bus_dbg_votes_fops = {
+	.open		= msm_bus_dbg_votes_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void msm_bus_dbg_commit_data(const char *fabname, void *cdata,
 	int nmasters, int nslaves, int ntslaves, int op)
 {
@@ -636,6 +694,9 @@ static int __init msm_bus_debugfs_init(void)
 	if (debugfs_create_file("update-request", S_IRUGO | S_IWUSR,
 		clients, NULL, &msm_bus_dbg_update_request_fops) == NULL)
 		goto err;
+	if (debugfs_create_file("client-votes", S_IRUGO, dir, NULL,
+		&msm_bus_dbg_votes_fops) == NULL)
+		goto err;
 
 	list_for_each_entry(cldata, &cl_list, list) {
 		if (cldata->pdata->name == NULL) {
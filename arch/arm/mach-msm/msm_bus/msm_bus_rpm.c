@@ -41,6 +41,16 @@ void msm_bus_rpm_set_mt_mask()
 
 }
 
+/* Sleep set votes only apply once the RPM sleeps, so don't wait for them */
+static void msm_bus_rpm_sleep_done(void *data, int rc)
+{
+	struct msm_bus_fabric_registration *fab_pdata = data;
+
+	if (rc)
+		MSM_BUS_ERR("fab %d: sleep set vote failed: %d\n",
+			fab_pdata->id, rc);
+}
+
 bool msm_bus_rpm_is_mem_interleaved(void)
 {
 	int status = 0;
@@ -379,9 +389,10 @@ static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
 				MSM_BUS_DBG("msm_rpm_set returned: %d\n",
 					status);
 			} else if (ctx == DUAL_CTX) {
-				status = msm_rpm_set(MSM_RPM_CTX_SET_SLEEP,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_set returned: %d\n",
+				status = msm_rpm_set_async(
+					MSM_RPM_CTX_SET_SLEEP, rpm_data, count,
+					msm_bus_rpm_sleep_done, fab_pdata);
+				MSM_BUS_DBG("msm_rpm_set_async returned: %d\n",
 					status);
 			}
 		} else {
@@ -653,9 +664,10 @@ static int msm_bus_rpm_commit_arb(struct msm_bus_fabric_registration
 				MSM_BUS_DBG("msm_rpm_set returned: %d\n",
 					status);
 			} else if (ctx == DUAL_CTX) {
-				status = msm_rpm_set(MSM_RPM_CTX_SET_SLEEP,
-					rpm_data, count);
-				MSM_BUS_DBG("msm_rpm_set returned: %d\n",
+				status = msm_rpm_set_async(
+					MSM_RPM_CTX_SET_SLEEP, rpm_data, count,
+					msm_bus_rpm_sleep_done, fab_pdata);
+				MSM_BUS_DBG("msm_rpm_set_async returned: %d\n",
 					status);
 			}
 		} else {
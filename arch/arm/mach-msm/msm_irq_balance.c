@@ -0,0 +1,305 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Spread the busiest device interrupts over the online cores.  Every
+ * sample_ms the rate of each balanceable interrupt is taken from its
+ * kstat counts; interrupts above min_rate are placed, busiest first, on
+ * the online core with the least interrupt load, cpu0 starting with the
+ * load of everything left alone.  An interrupt moved here goes back to
+ * cpu0 when its rate drops under half of min_rate, and before the core
+ * it is on goes offline.  An interrupt whose affinity was changed by
+ * someone else is not touched again.
+ *
+ * Affinity only retargets the GIC distributor; the MPM enable and wake
+ * bits that msm_mpm keeps per interrupt do not depend on the target cpu
+ * and stay as they are.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/irq.h>
+#include <linux/interrupt.h>
+#include <linux/kernel_stat.h>
+#include <linux/math64.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define MAX_BALANCED	16
+#define NO_CPU		(-1)
+
+struct irq_balance_stat {
+	unsigned int last_count;
+	unsigned int rate;
+	/* Where this driver put the interrupt, NO_CPU if left alone */
+	s8 cpu;
+	bool foreign;
+};
+
+static struct irq_balance_stat *stats;
+static unsigned int nr_stats;
+static unsigned long last_jiffies;
+static unsigned int moves;
+
+static struct delayed_work balance_work;
+
+static unsigned int enabled = 1;
+module_param(enabled, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int sample_ms = 1000;
+module_param(sample_ms, uint, S_IRUGO | S_IWUSR);
+
+/* Interrupts per second before an interrupt is worth moving */
+static unsigned int min_rate = 2000;
+module_param(min_rate, uint, S_IRUGO | S_IWUSR);
+
+static bool irq_balanceable(unsigned int irq)
+{
+	struct irq_desc *desc = irq_to_desc(irq);
+	struct irq_data *d;
+
+	if (!desc || !desc->action)
+		return false;
+	d = irq_desc_get_irq_data(desc);
+	return !irqd_is_per_cpu(d) && irqd_can_balance(d) &&
+		irq_can_set_affinity(irq);
+}
+
+static bool irq_on_cpu(unsigned int irq, int cpu)
+{
+	struct irq_data *d = irq_get_irq_data(irq);
+
+	return cpumask_equal(d->affinity, cpumask_of(cpu));
+}
+
+/* Affinity this driver did not choose, from /proc or the driver itself */
+static bool irq_foreign(unsigned int irq, struct irq_balance_stat *s)
+{
+	struct irq_data *d = irq_get_irq_data(irq);
+
+	if (s->cpu != NO_CPU)
+		return !irq_on_cpu(irq, s->cpu);
+	return !irq_on_cpu(irq, 0) &&
+		!cpumask_equal(d->affinity, irq_default_affinity);
+}
+
+static void irq_balance_move(unsigned int irq, int cpu)
+{
+	if (irq_set_affinity(irq, cpumask_of(cpu)))
+		return;
+	if (cpu)
+		stats[irq].cpu = cpu;
+	else
+		stats[irq].cpu = NO_CPU;
+	moves++;
+}
+
+static int rate_cmp(const void *a, const void *b)
+{
+	unsigned int ra = stats[*(const unsigned int *)a].rate;
+	unsigned int rb = stats[*(const unsigned int *)b].rate;
+
+	return ra < rb ? 1 : ra > rb ? -1 : 0;
+}
+
+static void irq_balance_sample(unsigned int elapsed_ms)
+{
+	struct irq_balance_stat *s;
+	unsigned int irq, count;
+
+	for (irq = 0; irq < nr_stats; irq++) {
+		s = &stats[irq];
+		count = kstat_irqs(irq);
+		s->rate = div_u64((u64)(count - s->last_count) * MSEC_PER_SEC,
+				  elapsed_ms);
+		s->last_count = count;
+
+		if (!s->foreign && irq_balanceable(irq) &&
+		    irq_foreign(irq, s)) {
+			s->cpu = NO_CPU;
+			s->foreign = true;
+		}
+	}
+}
+
+static void irq_balance(void)
+{
+	unsigned int load[NR_CPUS] = { 0 };
+	unsigned int list[MAX_BALANCED];
+	unsigned int n = 0, irq, i;
+	struct irq_balance_stat *s;
+	int cpu, best;
+
+	for (irq = 0; irq < nr_stats; irq++) {
+		s = &stats[irq];
+		if (s->foreign || !irq_balanceable(irq))
+			continue;
+
+		if (s->cpu != NO_CPU && s->rate < min_rate / 2) {
+			irq_balance_move(irq, 0);
+			continue;
+		}
+		if (n < MAX_BALANCED &&
+		    (s->cpu != NO_CPU || s->rate >= min_rate)) {
+			list[n++] = irq;
+			continue;
+		}
+		load[0] += s->rate;
+	}
+	if (num_online_cpus() < 2)
+		return;
+
+	sort(list, n, sizeof(list[0]), rate_cmp, NULL);
+
+	for (i = 0; i < n; i++) {
+		s = &stats[list[i]];
+		cpu = s->cpu == NO_CPU ? 0 : s->cpu;
+		best = cpu;
+		for_each_online_cpu(cpu)
+			if (load[cpu] < load[best])
+				best = cpu;
+		/* Stay put unless that evens things out noticeably */
+		cpu = s->cpu == NO_CPU ? 0 : s->cpu;
+		if (load[cpu] - load[best] < s->rate / 4)
+			best = cpu;
+
+		load[best] += s->rate;
+		if (best != cpu)
+			irq_balance_move(list[i], best);
+	}
+}
+
+static void irq_balance_work(struct work_struct *work)
+{
+	unsigned long now = jiffies;
+	unsigned int elapsed_ms = jiffies_to_msecs(now - last_jiffies);
+
+	get_online_cpus();
+	if (elapsed_ms) {
+		irq_balance_sample(elapsed_ms);
+		if (enabled)
+			irq_balance();
+	}
+	last_jiffies = now;
+	put_online_cpus();
+
+	schedule_delayed_work(&balance_work,
+			      msecs_to_jiffies(max(sample_ms, 10U)));
+}
+
+/* Runs with the hotplug lock held, so not against irq_balance() */
+static void irq_balance_evacuate(int dead)
+{
+	unsigned int irq;
+
+	for (irq = 0; irq < nr_stats; irq++)
+		if (stats[irq].cpu == dead)
+			irq_balance_move(irq, 0);
+}
+
+static int __cpuinit irq_balance_cpu_callback(struct notifier_block *nfb,
+		unsigned long action, void *hcpu)
+{
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_DOWN_PREPARE:
+		irq_balance_evacuate((long)hcpu);
+		break;
+	case CPU_ONLINE:
+	case CPU_DOWN_FAILED:
+		if (cancel_delayed_work(&balance_work))
+			schedule_delayed_work(&balance_work, 0);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __refdata irq_balance_cpu_notifier = {
+	.notifier_call = irq_balance_cpu_callback,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int irq_balance_show(struct seq_file *m, void *unused)
+{
+	struct irq_balance_stat *s;
+	struct irq_desc *desc;
+	unsigned int irq;
+
+	seq_printf(m, "moves: %u\n", moves);
+	seq_printf(m, "%5s %8s %4s  name\n", "irq", "rate", "cpu");
+	for (irq = 0; irq < nr_stats; irq++) {
+		s = &stats[irq];
+		if (!s->rate && s->cpu == NO_CPU)
+			continue;
+		desc = irq_to_desc(irq);
+		seq_printf(m, "%5u %8u ", irq, s->rate);
+		if (s->foreign)
+			seq_printf(m, "%4s", "user");
+		else if (s->cpu == NO_CPU)
+			seq_printf(m, "%4s", "-");
+		else
+			seq_printf(m, "%4d", s->cpu);
+		seq_printf(m, "  %s\n", desc && desc->action &&
+			   desc->action->name ? desc->action->name : "");
+	}
+	return 0;
+}
+
+static int irq_balance_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irq_balance_show, NULL);
+}
+
+static const struct file_operations irq_balance_fops = {
+	.open		= irq_balance_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void irq_balance_debugfs_init(void)
+{
+	debugfs_create_file("irq_balance", S_IRUGO, NULL, NULL,
+			    &irq_balance_fops);
+}
+#else
+static void irq_balance_debugfs_init(void)
+{
+}
+#endif
+
+static int __init msm_irq_balance_init(void)
+{
+	unsigned int irq;
+
+	nr_stats = nr_irqs;
+	stats = kcalloc(nr_stats, sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+	for (irq = 0; irq < nr_stats; irq++) {
+		stats[irq].cpu = NO_CPU;
+		stats[irq].last_count = kstat_irqs(irq);
+	}
+	last_jiffies = jiffies;
+
+	INIT_DELAYED_WORK_DEFERRABLE(&balance_work, irq_balance_work);
+	register_hotcpu_notifier(&irq_balance_cpu_notifier);
+	schedule_delayed_work(&balance_work, msecs_to_jiffies(sample_ms));
+	irq_balance_debugfs_init();
+	return 0;
+}
+late_initcall(msm_irq_balance_init);
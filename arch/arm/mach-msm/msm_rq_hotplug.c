@@ -0,0 +1,448 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * In-kernel core hotplug driven by the run queue average that the tick
+ * collects for msm_rq_stats.  A core goes online when the average number
+ * of runnable tasks per online core stays above up_threshold for
+ * up_samples samples while the cores are already running close to their
+ * top frequency, and goes offline when the load would fit on one core
+ * less with room to spare for down_samples samples.  The gap between the
+ * two thresholds and the sample counts keep a core from bouncing.
+ *
+ * Thresholds are in tenths of a task, like rq_avg.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/suspend.h>
+#include <linux/rq_stats.h>
+#include <mach/perflock.h>
+
+#define DEFAULT_SAMPLE_MS	50
+#define DEFAULT_UP_THRESHOLD	15
+#define DEFAULT_DOWN_THRESHOLD	8
+#define DEFAULT_UP_SAMPLES	2
+#define DEFAULT_DOWN_SAMPLES	10
+#define DEFAULT_UP_FREQ_PCT	80
+#define DEFAULT_PERFLOCK_CORES	2
+
+struct rq_hotplug_latency {
+	unsigned int count;
+	unsigned int last_us;
+	unsigned int max_us;
+	u64 total_us;
+};
+
+struct rq_hotplug_data {
+	struct mutex lock;
+	struct delayed_work work;
+	unsigned int enabled;
+	unsigned int sample_ms;
+	unsigned int up_threshold;
+	unsigned int down_threshold;
+	unsigned int up_samples;
+	unsigned int down_samples;
+	unsigned int up_freq_pct;
+	unsigned int min_cores;
+	unsigned int max_cores;
+	unsigned int perflock_cores;
+
+	unsigned int up_hits;
+	unsigned int down_hits;
+	/* Cores still to bring back one per sample after resume */
+	unsigned int resume_cores;
+	bool suspended;
+
+	struct rq_hotplug_latency up;
+	struct rq_hotplug_latency down;
+	struct kobject *kobj;
+};
+
+static struct rq_hotplug_data hp;
+static struct workqueue_struct *hp_wq;
+static DEFINE_PER_CPU(unsigned int, hp_cur_freq);
+
+static unsigned int rq_hotplug_read_avg(void)
+{
+	unsigned long flags;
+	unsigned int avg;
+
+	spin_lock_irqsave(&rq_lock, flags);
+	avg = rq_info.hp_rq_avg;
+	rq_info.hp_rq_avg = 0;
+	rq_info.hp_poll_total_jiffies = 0;
+	spin_unlock_irqrestore(&rq_lock, flags);
+
+	return avg;
+}
+
+/* Any online core close to its top speed, more cores are the next step */
+static bool rq_hotplug_freq_high(void)
+{
+	unsigned int cpu, cur, max;
+
+	for_each_online_cpu(cpu) {
+		cur = per_cpu(hp_cur_freq, cpu);
+		max = cpufreq_quick_get_max(cpu);
+		if (!cur || !max || cur * 100 >= max * hp.up_freq_pct)
+			return true;
+	}
+
+	return false;
+}
+
+static void rq_hotplug_account(struct rq_hotplug_latency *lat, ktime_t start)
+{
+	unsigned int us = (unsigned int) ktime_us_delta(ktime_get(), start);
+
+	lat->count++;
+	lat->last_us = us;
+	lat->max_us = max(lat->max_us, us);
+	lat->total_us += us;
+}
+
+static void rq_hotplug_up(void)
+{
+	unsigned int cpu = cpumask_next_zero(0, cpu_online_mask);
+	ktime_t start;
+
+	if (cpu >= nr_cpu_ids)
+		return;
+
+	start = ktime_get();
+	if (!cpu_up(cpu))
+		rq_hotplug_account(&hp.up, start);
+}
+
+static void rq_hotplug_down(void)
+{
+	unsigned int cpu;
+	ktime_t start;
+
+	for (cpu = nr_cpu_ids - 1; cpu > 0; cpu--)
+		if (cpu_online(cpu))
+			break;
+
+	if (!cpu)
+		return;
+
+	start = ktime_get();
+	if (!cpu_down(cpu))
+		rq_hotplug_account(&hp.down, start);
+}
+
+static void rq_hotplug_work_fn(struct work_struct *work)
+{
+	unsigned int online, rq_avg, floor, ceiling;
+
+	mutex_lock(&hp.lock);
+
+	if (!hp.enabled || hp.suspended)
+		goto out_unlock;
+
+	rq_avg = rq_hotplug_read_avg();
+	online = num_online_cpus();
+
+	ceiling = min(hp.max_cores, num_possible_cpus());
+	floor = hp.min_cores;
+	if (is_perf_locked())
+		floor = max(floor, hp.perflock_cores);
+	floor = max(floor, perflock_min_cores());
+	floor = min(floor, ceiling);
+
+	if (hp.resume_cores) {
+		hp.resume_cores--;
+		if (online < ceiling)
+			rq_hotplug_up();
+		goto out;
+	}
+
+	if (online < floor) {
+		rq_hotplug_up();
+		goto out;
+	}
+
+	if (online > ceiling) {
+		rq_hotplug_down();
+		goto out;
+	}
+
+	if (online < ceiling && rq_avg > hp.up_threshold * online &&
+	    rq_hotplug_freq_high()) {
+		hp.down_hits = 0;
+		if (++hp.up_hits >= hp.up_samples) {
+			hp.up_hits = 0;
+			rq_hotplug_up();
+		}
+	} else if (online > floor &&
+		   rq_avg < hp.down_threshold * (online - 1)) {
+		hp.up_hits = 0;
+		if (++hp.down_hits >= hp.down_samples) {
+			hp.down_hits = 0;
+			rq_hotplug_down();
+		}
+	} else {
+		hp.up_hits = 0;
+		hp.down_hits = 0;
+	}
+
+out:
+	queue_delayed_work(hp_wq, &hp.work, msecs_to_jiffies(hp.sample_ms));
+out_unlock:
+	mutex_unlock(&hp.lock);
+}
+
+static int rq_hotplug_freq_notify(struct notifier_block *nb,
+		unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return NOTIFY_OK;
+
+	per_cpu(hp_cur_freq, freqs->cpu) = freqs->new;
+
+	/*
+	 * The load already asked for a core and the governor just ran out of
+	 * frequency, don't wait for the rest of the sample period.
+	 */
+	if (hp.enabled && hp.up_hits &&
+	    freqs->new >= cpufreq_quick_get_max(freqs->cpu) &&
+	    cancel_delayed_work(&hp.work))
+		queue_delayed_work(hp_wq, &hp.work, 0);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block rq_hotplug_freq_nb = {
+	.notifier_call = rq_hotplug_freq_notify,
+};
+
+static int rq_hotplug_pm_notify(struct notifier_block *nb,
+		unsigned long event, void *unused)
+{
+	unsigned int n;
+
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		mutex_lock(&hp.lock);
+		hp.suspended = true;
+		if (hp.enabled) {
+			/* Resume with cpu0 alone and stage the rest back in */
+			hp.resume_cores = num_online_cpus() - 1;
+			for (n = num_online_cpus(); n > 1; n--)
+				rq_hotplug_down();
+		}
+		mutex_unlock(&hp.lock);
+		break;
+	case PM_POST_SUSPEND:
+		mutex_lock(&hp.lock);
+		hp.suspended = false;
+		hp.up_hits = 0;
+		hp.down_hits = 0;
+		if (hp.enabled)
+			queue_delayed_work(hp_wq, &hp.work,
+					   msecs_to_jiffies(hp.sample_ms));
+		mutex_unlock(&hp.lock);
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block rq_hotplug_pm_nb = {
+	.notifier_call = rq_hotplug_pm_notify,
+};
+
+static ssize_t show_enabled(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", hp.enabled);
+}
+
+static ssize_t store_enabled(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&hp.lock);
+	hp.enabled = !!val;
+	rq_info.hotplug_enabled = hp.enabled;
+	if (hp.enabled && !hp.suspended) {
+		rq_hotplug_read_avg();
+		queue_delayed_work(hp_wq, &hp.work,
+				   msecs_to_jiffies(hp.sample_ms));
+	}
+	mutex_unlock(&hp.lock);
+
+	/* Cores are left as they are for user space to take over */
+	if (!val)
+		cancel_delayed_work_sync(&hp.work);
+
+	return count;
+}
+
+static struct kobj_attribute enabled_attr =
+	__ATTR(enabled, S_IWUSR | S_IRUGO, show_enabled, store_enabled);
+
+#define rq_hotplug_attr(name, min, max)					\
+static ssize_t show_##name(struct kobject *kobj,			\
+		struct kobj_attribute *attr, char *buf)			\
+{									\
+	return snprintf(buf, PAGE_SIZE, "%u\n", hp.name);		\
+}									\
+									\
+static ssize_t store_##name(struct kobject *kobj,			\
+		struct kobj_attribute *attr, const char *buf, size_t count) \
+{									\
+	unsigned int val;						\
+	int ret;							\
+									\
+	ret = kstrtouint(buf, 0, &val);					\
+	if (ret)							\
+		return ret;						\
+	if (val < (min) || val > (max))					\
+		return -EINVAL;						\
+									\
+	mutex_lock(&hp.lock);						\
+	hp.name = val;							\
+	mutex_unlock(&hp.lock);						\
+									\
+	return count;							\
+}									\
+									\
+static struct kobj_attribute name##_attr =				\
+	__ATTR(name, S_IWUSR | S_IRUGO, show_##name, store_##name)
+
+rq_hotplug_attr(sample_ms, 10, 10000);
+rq_hotplug_attr(up_threshold, 1, UINT_MAX / NR_CPUS);
+rq_hotplug_attr(down_threshold, 0, UINT_MAX / NR_CPUS);
+rq_hotplug_attr(up_samples, 1, 100);
+rq_hotplug_attr(down_samples, 1, 100);
+rq_hotplug_attr(up_freq_pct, 0, 100);
+rq_hotplug_attr(min_cores, 1, NR_CPUS);
+rq_hotplug_attr(max_cores, 1, NR_CPUS);
+rq_hotplug_attr(perflock_cores, 1, NR_CPUS);
+
+static ssize_t show_stats(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct rq_hotplug_latency *lat[] = { &hp.up, &hp.down };
+	static const char * const dir[] = { "up", "down" };
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&hp.lock);
+	for (i = 0; i < ARRAY_SIZE(lat); i++)
+		len += snprintf(buf + len, PAGE_SIZE - len,
+			"%s: count %u last %u us max %u us avg %llu us\n",
+			dir[i], lat[i]->count, lat[i]->last_us,
+			lat[i]->max_us, lat[i]->count ?
+			div_u64(lat[i]->total_us, lat[i]->count) : 0);
+	mutex_unlock(&hp.lock);
+
+	return len;
+}
+
+static struct kobj_attribute stats_attr = __ATTR(stats, S_IRUGO,
+		show_stats, NULL);
+
+static struct attribute *rq_hotplug_attrs[] = {
+	&enabled_attr.attr,
+	&sample_ms_attr.attr,
+	&up_threshold_attr.attr,
+	&down_threshold_attr.attr,
+	&up_samples_attr.attr,
+	&down_samples_attr.attr,
+	&up_freq_pct_attr.attr,
+	&min_cores_attr.attr,
+	&max_cores_attr.attr,
+	&perflock_cores_attr.attr,
+	&stats_attr.attr,
+	NULL,
+};
+
+static struct attribute_group rq_hotplug_attr_group = {
+	.attrs = rq_hotplug_attrs,
+};
+
+static int __init msm_rq_hotplug_init(void)
+{
+	unsigned int cpu;
+	int ret;
+
+	if (num_possible_cpus() < 2)
+		return -ENODEV;
+
+	mutex_init(&hp.lock);
+	INIT_DELAYED_WORK(&hp.work, rq_hotplug_work_fn);
+	hp.sample_ms = DEFAULT_SAMPLE_MS;
+	hp.up_threshold = DEFAULT_UP_THRESHOLD;
+	hp.down_threshold = DEFAULT_DOWN_THRESHOLD;
+	hp.up_samples = DEFAULT_UP_SAMPLES;
+	hp.down_samples = DEFAULT_DOWN_SAMPLES;
+	hp.up_freq_pct = DEFAULT_UP_FREQ_PCT;
+	hp.min_cores = 1;
+	hp.max_cores = num_possible_cpus();
+	hp.perflock_cores = DEFAULT_PERFLOCK_CORES;
+
+	hp_wq = create_singlethread_workqueue("rq_hotplug");
+	if (!hp_wq)
+		return -ENOMEM;
+
+	for_each_online_cpu(cpu)
+		per_cpu(hp_cur_freq, cpu) = cpufreq_quick_get(cpu);
+
+	hp.kobj = kobject_create_and_add("rq-hotplug",
+			&get_cpu_device(0)->kobj);
+	if (!hp.kobj) {
+		ret = -ENOMEM;
+		goto err_wq;
+	}
+
+	ret = sysfs_create_group(hp.kobj, &rq_hotplug_attr_group);
+	if (ret)
+		goto err_kobj;
+
+	cpufreq_register_notifier(&rq_hotplug_freq_nb,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+	register_pm_notifier(&rq_hotplug_pm_nb);
+
+	mutex_lock(&hp.lock);
+	hp.enabled = 1;
+	rq_info.hotplug_enabled = 1;
+	queue_delayed_work(hp_wq, &hp.work, msecs_to_jiffies(hp.sample_ms));
+	mutex_unlock(&hp.lock);
+
+	return 0;
+
+err_kobj:
+	kobject_put(hp.kobj);
+err_wq:
+	destroy_workqueue(hp_wq);
+	return ret;
+}
+late_initcall_sync(msm_rq_hotplug_init);
@@ -12,7 +12,9 @@
  */
 
 #include <linux/atomic.h>
+#include <linux/debugfs.h>
 #include <linux/export.h>
+#include <linux/fs.h>
 #include <linux/kernel.h>
 #include <linux/memory_alloc.h>
 #include <linux/module.h>
@@ -20,7 +22,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/string.h>
-#include <linux/atomic.h>
+#include <linux/uaccess.h>
 #include <asm/io.h>
 #include <asm-generic/sizes.h>
 #include <mach/memory.h>
@@ -36,8 +38,10 @@ struct msm_rtb_layout {
 	unsigned char sentinel[3];
 	unsigned char log_type;
 	void *caller;
-	unsigned long idx;
 	void *data;
+	unsigned long ts_lo;
+	unsigned long ts_hi;
+	unsigned long idx;
 } __attribute__ ((__packed__));
 
 
@@ -50,6 +54,7 @@ struct msm_rtb_state {
 	int initialized;
 	uint32_t filter;
 	int step_size;
+	int seg_entries;
 };
 
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
@@ -60,7 +65,8 @@ static atomic_t msm_rtb_idx;
 
 struct msm_rtb_state msm_rtb = {
 	.filter = (1 << LOGK_READL)|(1 << LOGK_WRITEL)|(1 << LOGK_LOGBUF)
-		|(1 << LOGK_HOTPLUG)|(1 << LOGK_CTXID)|(1 << LOGK_IRQ)|(1 << LOGK_DIE),
+		|(1 << LOGK_HOTPLUG)|(1 << LOGK_CTXID)|(1 << LOGK_IRQ)|(1 << LOGK_DIE)
+		|(1 << LOGK_HOTPLUG_LATENCY),
 	.enabled = 1,
 };
 
@@ -127,77 +133,63 @@ static void msm_rtb_write_data(void *data, struct msm_rtb_layout *start)
 	start->data = data;
 }
 
-static void uncached_logk_pc_idx(enum logk_event_type log_type, void *caller,
-				 void *data, int idx)
+static void msm_rtb_write_timestamp(struct msm_rtb_layout *start)
+{
+	unsigned long long timestamp = sched_clock();
+
+	start->ts_lo = lower_32_bits(timestamp);
+	start->ts_hi = upper_32_bits(timestamp);
+}
+
+/*
+ * Each cpu owns a contiguous segment of seg_entries with its own index,
+ * so logging never touches another cpu's state.  idx is written last: a
+ * reader that finds the expected idx in a slot knows the rest of it is
+ * complete, see msm_rtb_read().
+ */
+static struct msm_rtb_layout *msm_rtb_slot(int seg, unsigned int idx)
 {
-	struct msm_rtb_layout *start;
+	return &msm_rtb.rtb[seg * msm_rtb.seg_entries +
+			    (idx & (msm_rtb.seg_entries - 1))];
+}
 
-	start = &msm_rtb.rtb[idx & (msm_rtb.nentries - 1)];
+static void uncached_logk_pc_idx(enum logk_event_type log_type, void *caller,
+				 void *data, int seg, unsigned int idx)
+{
+	struct msm_rtb_layout *start = msm_rtb_slot(seg, idx);
 
 	msm_rtb_emit_sentinel(start);
 	msm_rtb_write_type(log_type, start);
 	msm_rtb_write_caller(caller, start);
-	msm_rtb_write_idx(idx, start);
 	msm_rtb_write_data(data, start);
+	msm_rtb_write_timestamp(start);
+	/* Device memory, stores already reach it in order */
+	barrier();
+	msm_rtb_write_idx(idx, start);
 	mb();
 
 	return;
 }
 
-static void uncached_logk_timestamp(int idx)
+#if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
+static atomic_t *msm_rtb_seg_idx(int seg)
 {
-	unsigned long long timestamp;
-	void *timestamp_upper, *timestamp_lower;
-	timestamp = sched_clock();
-	timestamp_lower = (void *)lower_32_bits(timestamp);
-	timestamp_upper = (void *)upper_32_bits(timestamp);
-
-	uncached_logk_pc_idx(LOGK_TIMESTAMP|LOGTYPE_NOPC, timestamp_lower,
-			     timestamp_upper, idx);
+	return &per_cpu(msm_rtb_idx_cpu, seg);
 }
 
-#if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
-static int msm_rtb_get_idx(void)
+static int msm_rtb_this_seg(void)
 {
-	int cpu, i, offset;
-	atomic_t *index;
-
-	cpu = raw_smp_processor_id();
-
-	index = &per_cpu(msm_rtb_idx_cpu, cpu);
-
-	i = atomic_add_return(msm_rtb.step_size, index);
-	i -= msm_rtb.step_size;
-
-	
-	offset = (i & (msm_rtb.nentries - 1)) -
-		 ((i - msm_rtb.step_size) & (msm_rtb.nentries - 1));
-	if (offset < 0) {
-		uncached_logk_timestamp(i);
-		i = atomic_add_return(msm_rtb.step_size, index);
-		i -= msm_rtb.step_size;
-	}
-
-	return i;
+	return raw_smp_processor_id();
 }
 #else
-static int msm_rtb_get_idx(void)
+static atomic_t *msm_rtb_seg_idx(int seg)
 {
-	int i, offset;
-
-	i = atomic_inc_return(&msm_rtb_idx);
-	i--;
-
-	
-	offset = (i & (msm_rtb.nentries - 1)) -
-		 ((i - 1) & (msm_rtb.nentries - 1));
-	if (offset < 0) {
-		uncached_logk_timestamp(i);
-		i = atomic_inc_return(&msm_rtb_idx);
-		i--;
-	}
+	return &msm_rtb_idx;
+}
 
-	return i;
+static int msm_rtb_this_seg(void)
+{
+	return 0;
 }
 #endif
 
@@ -212,14 +204,16 @@ unsigned long get_current_timestamp(void)
 int uncached_logk_pc(enum logk_event_type log_type, void *caller,
 				void *data)
 {
-	int i;
+	int seg;
+	unsigned int i;
 
 	if (!msm_rtb_event_should_log(log_type))
 		return 0;
 
-	i = msm_rtb_get_idx();
+	seg = msm_rtb_this_seg();
+	i = atomic_inc_return(msm_rtb_seg_idx(seg)) - 1;
 
-	uncached_logk_pc_idx(log_type, caller, data, i);
+	uncached_logk_pc_idx(log_type, caller, data, seg, i);
 
 	return 1;
 }
@@ -243,9 +237,119 @@ static void msm_rtb_save_footprint(void)
 	*(unsigned *)RTB_FOOT_PRINT_MAGIC = (unsigned)RTB_MAGIC;
 	*(unsigned *)RTB_FOOT_PRINT_MSM_RTB = (unsigned)virt_to_phys(&msm_rtb);
 	for (cpu = 0; cpu < msm_rtb.step_size; cpu++)
-		*(unsigned *)(RTB_FOOT_PRINT_CPU_IDX + (cpu * 0x4)) = (unsigned)virt_to_phys(&per_cpu(msm_rtb_idx_cpu, cpu));
+		*(unsigned *)(RTB_FOOT_PRINT_CPU_IDX + (cpu * 0x4)) = (unsigned)virt_to_phys(msm_rtb_seg_idx(cpu));
+}
+
+/*
+ * Streams the buffer as binary struct msm_rtb_layout records, merged
+ * across the cpu segments in timestamp order.  Each read continues where
+ * the last one stopped and returns 0 once it has caught up with the
+ * writers; entries overwritten before they could be read are skipped.
+ */
+struct msm_rtb_reader {
+	unsigned int next[NR_CPUS];
+	unsigned long lost;
+};
+
+static int msm_rtb_reader_peek(struct msm_rtb_reader *r, int seg,
+			       struct msm_rtb_layout *ent)
+{
+	unsigned int head, avail;
+
+	for (;;) {
+		head = atomic_read(msm_rtb_seg_idx(seg));
+		avail = head - r->next[seg];
+		if (!avail)
+			return 0;
+		if (avail > msm_rtb.seg_entries) {
+			r->lost += avail - msm_rtb.seg_entries;
+			r->next[seg] = head - msm_rtb.seg_entries;
+		}
+
+		memcpy_fromio(ent, msm_rtb_slot(seg, r->next[seg]),
+			      sizeof(*ent));
+		rmb();
+		if (ent->idx == r->next[seg] &&
+		    ent->sentinel[1] == SENTINEL_BYTE_2)
+			return 1;
+		/* Reserved but not written yet */
+		if ((int)(ent->idx - r->next[seg]) < 0)
+			return 0;
+		r->lost++;
+		r->next[seg]++;
+	}
+}
+
+static ssize_t msm_rtb_read(struct file *file, char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	struct msm_rtb_reader *r = file->private_data;
+	struct msm_rtb_layout ent, best_ent;
+	unsigned long long ts, best_ts = 0;
+	ssize_t done = 0;
+	int seg, best;
+
+	while (count - done >= sizeof(ent)) {
+		best = -1;
+		for (seg = 0; seg < msm_rtb.step_size; seg++) {
+			if (!msm_rtb_reader_peek(r, seg, &ent))
+				continue;
+			ts = ((unsigned long long)ent.ts_hi << 32) | ent.ts_lo;
+			if (best < 0 || ts < best_ts) {
+				best = seg;
+				best_ts = ts;
+				best_ent = ent;
+			}
+		}
+		if (best < 0)
+			break;
+
+		if (copy_to_user(buf + done, &best_ent, sizeof(best_ent)))
+			return done ? done : -EFAULT;
+		r->next[best]++;
+		done += sizeof(best_ent);
+	}
+
+	return done;
 }
 
+static int msm_rtb_open(struct inode *inode, struct file *file)
+{
+	struct msm_rtb_reader *r;
+	unsigned int head;
+	int seg;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+
+	for (seg = 0; seg < msm_rtb.step_size; seg++) {
+		head = atomic_read(msm_rtb_seg_idx(seg));
+		if (head > msm_rtb.seg_entries)
+			r->next[seg] = head - msm_rtb.seg_entries;
+	}
+	file->private_data = r;
+
+	return nonseekable_open(inode, file);
+}
+
+static int msm_rtb_release(struct inode *inode, struct file *file)
+{
+	struct msm_rtb_reader *r = file->private_data;
+
+	if (r->lost)
+		pr_info("msm_rtb: reader lost %lu entries\n", r->lost);
+	kfree(r);
+	return 0;
+}
+
+static const struct file_operations msm_rtb_fops = {
+	.open		= msm_rtb_open,
+	.read		= msm_rtb_read,
+	.release	= msm_rtb_release,
+	.llseek		= no_llseek,
+};
+
 int msm_rtb_probe(struct platform_device *pdev)
 {
 	struct msm_rtb_platform_data *d = pdev->dev.platform_data;
@@ -284,18 +388,21 @@ int msm_rtb_probe(struct platform_device *pdev)
 #if defined(CONFIG_MSM_RTB_SEPARATE_CPUS)
 	for_each_possible_cpu(cpu) {
 		atomic_t *a = &per_cpu(msm_rtb_idx_cpu, cpu);
-		atomic_set(a, cpu);
+		atomic_set(a, 0);
 	}
 	msm_rtb.step_size = num_possible_cpus();
 #else
 	atomic_set(&msm_rtb_idx, 0);
 	msm_rtb.step_size = 1;
 #endif
+	msm_rtb.seg_entries = __rounddown_pow_of_two(msm_rtb.nentries /
+						     msm_rtb.step_size);
 
 	atomic_notifier_chain_register(&panic_notifier_list,
 						&msm_rtb_panic_blk);
 	msm_rtb.initialized = 1;
 	msm_rtb_save_footprint();
+	debugfs_create_file("msm_rtb", S_IRUSR, NULL, NULL, &msm_rtb_fops);
 
 	return 0;
 }
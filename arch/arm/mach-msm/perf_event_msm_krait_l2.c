@@ -15,9 +15,16 @@
 #include <asm/pmu.h>
 #include <linux/platform_device.h>
 #include <linux/spinlock.h>
+#include <linux/moduleparam.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/msm_l2_stats.h>
+#include <asm/thread_notify.h>
 
 #include <mach/msm-krait-l2-accessors.h>
 
+#include "acpuclock.h"
+
 #define MAX_L2_PERIOD	((1ULL << 32) - 1)
 #define MAX_KRAIT_L2_CTRS 10
 
@@ -91,8 +98,21 @@ static struct attribute_group msm_l2_pmu_format_group = {
 	.attrs = msm_l2_ev_formats,
 };
 
+PMU_EVENT_ATTR_STRING(cycles, krait_l2_ev_cycles, "config=0xfe");
+
+static struct attribute *msm_l2_ev_events[] = {
+	&krait_l2_ev_cycles.attr.attr,
+	NULL,
+};
+
+static struct attribute_group msm_l2_pmu_events_group = {
+	.name = "events",
+	.attrs = msm_l2_ev_events,
+};
+
 static const struct attribute_group *msm_l2_pmu_attr_grps[] = {
 	&msm_l2_pmu_format_group,
+	&msm_l2_pmu_events_group,
 	NULL,
 };
 
@@ -449,7 +469,7 @@ static int msm_l2_test_set_ev_constraint(struct perf_event *event)
 
 	raw_spin_lock_irqsave(&l2_pmu_constraints.lock, flags);
 
-	bitmap_t = 1 << ((reg * 4) + group);
+	bitmap_t = 1ULL << ((reg * 4) + group);
 
 	if (!(l2_pmu_constraints.pmu_bitmap & bitmap_t)) {
 		l2_pmu_constraints.pmu_bitmap |= bitmap_t;
@@ -473,7 +493,7 @@ static int msm_l2_clear_ev_constraint(struct perf_event *event)
 
 	raw_spin_lock_irqsave(&l2_pmu_constraints.lock, flags);
 
-	bitmap_t = 1 << ((reg * 4) + group);
+	bitmap_t = 1ULL << ((reg * 4) + group);
 
 	
 	l2_pmu_constraints.pmu_bitmap &= ~bitmap_t;
@@ -513,6 +533,199 @@ static struct arm_pmu krait_l2_pmu = {
 	.pmu.attr_groups		= msm_l2_pmu_attr_grps,
 };
 
+#ifdef CONFIG_MSM_L2_TASK_STATS
+/*
+ * Without perf running, two counters per CPU, filtered to that CPU's
+ * requests, count L2 misses and bus traffic.  At every context switch the
+ * counts since the last one are charged to the task that was running, so
+ * a task that misses a lot is memory bound on whichever CPU it runs next.
+ *
+ * The events are raw kraitl2 configs as given to perf.  Slave port events
+ * can't be filtered by CPU, so those count for the whole L2.  The counters
+ * are taken out of used_mask and their RESR groups out of the constraints,
+ * so perf sees them as busy.
+ */
+static unsigned int miss_event;
+module_param(miss_event, uint, 0444);
+static unsigned int bus_event;
+module_param(bus_event, uint, 0444);
+/* Misses per ms on the CPU from which a task is memory bound */
+static unsigned int mem_bound_rate = 2000;
+module_param(mem_bound_rate, uint, 0644);
+
+/* Slices shorter than this don't say much about a rate, in ns */
+#define L2_STATS_MIN_SLICE	(100 * NSEC_PER_USEC)
+
+struct l2_cpu_stats {
+	int miss_ctr;
+	int bus_ctr;
+	u32 last_miss;
+	u32 last_bus;
+	u64 slice_start;
+};
+
+static DEFINE_PER_CPU(struct l2_cpu_stats, l2_cpu_stats);
+static bool l2_stats_enabled;
+
+static int l2_stats_claim(u32 config)
+{
+	u8 reg = (config & EVENT_REG_MASK) >> EVENT_REG_SHIFT;
+	u8 group = config & EVENT_GROUPSEL_MASK;
+	u64 bitmap_t = 1ULL << ((reg * 4) + group);
+	unsigned long flags;
+	int err = 0;
+
+	raw_spin_lock_irqsave(&l2_pmu_constraints.lock, flags);
+	if (l2_pmu_constraints.pmu_bitmap & bitmap_t)
+		err = -EPERM;
+	else
+		l2_pmu_constraints.pmu_bitmap |= bitmap_t;
+	raw_spin_unlock_irqrestore(&l2_pmu_constraints.lock, flags);
+
+	return err;
+}
+
+static void l2_stats_program(int ctr, u32 config, int cpu)
+{
+	u32 filter_reg = (ctr * 16) + IA_L2PMXEVFILTER_BASE;
+	u32 filter_val = l2_orig_filter_prefix | 1 << cpu;
+	struct event_desc evdesc;
+
+	if (((config & EVENT_PREFIX_MASK) >> EVENT_PREFIX_SHIFT) ==
+	    L2_SLAVE_EV_PREFIX)
+		filter_val = l2_slv_filter_prefix;
+
+	set_evcntcr(ctr);
+	get_event_desc(config, &evdesc);
+	set_evtyper(evdesc.event_groupsel, evdesc.event_reg, ctr);
+	set_evres(evdesc.event_groupsel, evdesc.event_reg,
+		  evdesc.event_group_code);
+	set_l2_indirect_reg(filter_reg, filter_val);
+	krait_l2_write_counter(ctr, 0);
+	enable_counter(ctr);
+}
+
+static u32 l2_stats_rate(u32 count, u64 slice, u32 avg)
+{
+	u32 rate = (u32) div64_u64((u64) count * NSEC_PER_MSEC, slice);
+
+	return (avg * 3 + rate) / 4;
+}
+
+/* Charge the counts since the last switch to @ti, irqs off */
+static void l2_stats_fold(struct l2_cpu_stats *st, struct thread_info *ti)
+{
+	struct l2_task_stats *ts = &ti->l2_stats;
+	u64 now = sched_clock();
+	u64 slice = now - st->slice_start;
+	u32 miss, bus, dmiss, dbus;
+
+	miss = krait_l2_read_counter(st->miss_ctr);
+	bus = krait_l2_read_counter(st->bus_ctr);
+	dmiss = miss - st->last_miss;
+	dbus = bus - st->last_bus;
+
+	ts->misses += dmiss;
+	ts->bus += dbus;
+	if (slice >= L2_STATS_MIN_SLICE) {
+		ts->miss_rate = l2_stats_rate(dmiss, slice, ts->miss_rate);
+		ts->bus_rate = l2_stats_rate(dbus, slice, ts->bus_rate);
+	}
+
+	st->last_miss = miss;
+	st->last_bus = bus;
+	st->slice_start = now;
+}
+
+static int l2_stats_thread_notify(struct notifier_block *self,
+				  unsigned long cmd, void *t)
+{
+	struct thread_info *thread = t;
+
+	switch (cmd) {
+	case THREAD_NOTIFY_COPY:
+		memset(&thread->l2_stats, 0, sizeof(thread->l2_stats));
+		break;
+	case THREAD_NOTIFY_SWITCH:
+		/* Still on the stack of the task going out */
+		if (l2_stats_enabled)
+			l2_stats_fold(&__get_cpu_var(l2_cpu_stats),
+				      current_thread_info());
+		break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block l2_stats_thread_nb = {
+	.notifier_call = l2_stats_thread_notify,
+};
+
+bool msm_l2_stats_mem_bound(void)
+{
+	struct thread_info *ti = current_thread_info();
+	unsigned long flags;
+	bool bound;
+
+	if (!l2_stats_enabled)
+		return false;
+
+	/* Take in the slice so far, a busy task may not switch for a while */
+	local_irq_save(flags);
+	l2_stats_fold(&__get_cpu_var(l2_cpu_stats), ti);
+	bound = ti->l2_stats.miss_rate >= mem_bound_rate;
+	local_irq_restore(flags);
+
+	return bound;
+}
+EXPORT_SYMBOL(msm_l2_stats_mem_bound);
+
+void msm_l2_stats_bus_boost(bool on)
+{
+	acpuclk_set_bus_boost(on);
+}
+EXPORT_SYMBOL(msm_l2_stats_bus_boost);
+
+static void __init l2_stats_init(void)
+{
+	struct pmu_hw_events *hw = &krait_l2_pmu_hw_events;
+	int cpu, ctr = 0;
+
+	thread_register_notifier(&l2_stats_thread_nb);
+
+	if (!miss_event || !bus_event)
+		return;
+
+	/* The last counter is the cycle counter */
+	if (2 * num_possible_cpus() > total_l2_ctrs - 1) {
+		pr_warn("%s: not enough L2 counters\n", __func__);
+		return;
+	}
+
+	if (l2_stats_claim(miss_event) || l2_stats_claim(bus_event)) {
+		pr_warn("%s: events share a group\n", __func__);
+		return;
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct l2_cpu_stats *st = &per_cpu(l2_cpu_stats, cpu);
+
+		st->miss_ctr = ctr++;
+		st->bus_ctr = ctr++;
+		set_bit(st->miss_ctr, hw->used_mask);
+		set_bit(st->bus_ctr, hw->used_mask);
+		l2_stats_program(st->miss_ctr, miss_event, cpu);
+		l2_stats_program(st->bus_ctr, bus_event, cpu);
+		st->slice_start = sched_clock();
+	}
+
+	krait_l2_start();
+	l2_stats_enabled = true;
+}
+#else
+static inline void l2_stats_init(void) { }
+#endif
+
 static int __devinit krait_l2_pmu_device_probe(struct platform_device *pdev)
 {
 	krait_l2_pmu.plat_device = pdev;
@@ -547,6 +760,8 @@ static int __init register_krait_l2_pmu_driver(void)
 	
 	get_reset_pmovsr();
 
+	l2_stats_init();
+
 	return platform_driver_register(&krait_l2_pmu_driver);
 }
 device_initcall(register_krait_l2_pmu_driver);
@@ -23,6 +23,8 @@
 #include <linux/cpufreq.h>
 #include <linux/timer.h>
 #include <linux/slab.h>
+#include <linux/plist.h>
+#include <linux/workqueue.h>
 #include <mach/perflock.h>
 #include "acpuclock.h"
 
@@ -37,10 +39,18 @@ enum {
 	PERF_SCREEN_ON_POLICY_DEBUG = 1U << 4,
 };
 
-static LIST_HEAD(active_perf_locks);
-static LIST_HEAD(inactive_perf_locks);
-static LIST_HEAD(active_cpufreq_ceiling_locks);
-static LIST_HEAD(inactive_cpufreq_ceiling_locks);
+/*
+ * Held locks sit in a plist per type, sorted by level, so the aggregate
+ * of a type is its first or last node, like the PM QoS constraints.  All
+ * initialized locks are also on perf_locks so they can be found by name.
+ */
+static LIST_HEAD(perf_locks);
+static struct plist_head floor_locks = PLIST_HEAD_INIT(floor_locks);
+static struct plist_head ceiling_locks = PLIST_HEAD_INIT(ceiling_locks);
+static struct plist_head cores_locks = PLIST_HEAD_INIT(cores_locks);
+/* Held locks with a timeout, all expired by expire_work */
+static LIST_HEAD(timed_perf_locks);
+static unsigned long next_expiry;
 static DEFINE_SPINLOCK(list_lock);
 static DEFINE_SPINLOCK(policy_update_lock);
 static int initialized;
@@ -274,43 +284,53 @@ void perflock_scaling_min_freq(unsigned int freq, unsigned int cpu)
 	per_cpu(stored_policy_min, cpu) = freq;
 }
 
+static struct plist_head *perf_lock_list(unsigned int type)
+{
+	switch (type) {
+	case TYPE_PERF_LOCK:
+		return &floor_locks;
+	case TYPE_CPUFREQ_CEILING:
+		return &ceiling_locks;
+	case TYPE_PERF_CORES:
+		return &cores_locks;
+	}
+	return NULL;
+}
+
+/* Highest floor and core count, lowest ceiling; -1 if none is held */
+static int perf_lock_aggregate(unsigned int type)
+{
+	struct plist_head *head = perf_lock_list(type);
+
+	if (plist_head_empty(head))
+		return -1;
+	if (type == TYPE_CPUFREQ_CEILING)
+		return plist_first(head)->prio;
+	return plist_last(head)->prio;
+}
+
 static unsigned int get_perflock_speed(void)
 {
 	unsigned long irqflags;
-	struct perf_lock *lock;
-	unsigned int perf_level = 0;
-
-	
-	if (list_empty(&active_perf_locks))
-		return 0;
+	int perf_level;
 
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_perf_locks, link) {
-		if (lock->level > perf_level)
-			perf_level = lock->level;
-	}
+	perf_level = perf_lock_aggregate(TYPE_PERF_LOCK);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 
-	return perf_acpu_table[perf_level];
+	return perf_level < 0 ? 0 : perf_acpu_table[perf_level];
 }
 
 static unsigned int get_cpufreq_ceiling_speed(void)
 {
 	unsigned long irqflags;
-	struct perf_lock *lock;
-	unsigned int perf_level = PERF_LOCK_HIGHEST;
-
-	
-	if (list_empty(&active_cpufreq_ceiling_locks))
-		return 0;
+	int perf_level;
 
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_cpufreq_ceiling_locks, link) {
-		if (lock->level < perf_level)
-			perf_level = lock->level;
-	}
+	perf_level = perf_lock_aggregate(TYPE_CPUFREQ_CEILING);
 	spin_unlock_irqrestore(&list_lock, irqflags);
-	return cpufreq_ceiling_acpu_table[perf_level];
+
+	return perf_level < 0 ? 0 : cpufreq_ceiling_acpu_table[perf_level];
 }
 
 static void print_active_locks(void)
@@ -319,12 +339,15 @@ static void print_active_locks(void)
 	struct perf_lock *lock;
 
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_perf_locks, link) {
+	plist_for_each_entry(lock, &floor_locks, node) {
 		pr_info("active perf lock '%s'\n", lock->name);
 	}
-	list_for_each_entry(lock, &active_cpufreq_ceiling_locks, link) {
+	plist_for_each_entry(lock, &ceiling_locks, node) {
 		pr_info("active cpufreq_ceiling_locks '%s'\n", lock->name);
 	}
+	plist_for_each_entry(lock, &cores_locks, node) {
+		pr_info("active cores lock '%s'\n", lock->name);
+	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
@@ -334,20 +357,27 @@ void htc_print_active_perf_locks(void)
 	struct perf_lock *lock;
 
 	spin_lock_irqsave(&list_lock, irqflags);
-	if (!list_empty(&active_perf_locks)) {
+	if (!plist_head_empty(&floor_locks)) {
 		pr_info("perf_lock:");
-		list_for_each_entry(lock, &active_perf_locks, link) {
+		plist_for_each_entry(lock, &floor_locks, node) {
 			pr_info(" '%s' ", lock->name);
 		}
 		pr_info("\n");
 	}
-	if (!list_empty(&active_cpufreq_ceiling_locks)) {
+	if (!plist_head_empty(&ceiling_locks)) {
 		printk(KERN_WARNING"ceiling_lock:");
-		list_for_each_entry(lock, &active_cpufreq_ceiling_locks, link) {
+		plist_for_each_entry(lock, &ceiling_locks, node) {
 			printk(KERN_WARNING" '%s' ", lock->name);
 		}
 		pr_info("\n");
 	}
+	if (!plist_head_empty(&cores_locks)) {
+		pr_info("cores_lock:");
+		plist_for_each_entry(lock, &cores_locks, node) {
+			pr_info(" '%s' ", lock->name);
+		}
+		pr_info("\n");
+	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
@@ -355,13 +385,15 @@ void perf_lock_init(struct perf_lock *lock, unsigned int type,
 			unsigned int level, const char *name)
 {
 	unsigned long irqflags = 0;
+	unsigned int max_level = type == TYPE_PERF_CORES ?
+		NR_CPUS + 1 : PERF_LOCK_INVALID;
 
 	WARN_ON(!lock);
 	WARN_ON(!name);
-	WARN_ON(level >= PERF_LOCK_INVALID);
+	WARN_ON(level >= max_level);
 	WARN_ON(lock->flags & PERF_LOCK_INITIALIZED);
 
-	if ((!name) || (level >= PERF_LOCK_INVALID) ||
+	if ((!name) || (level >= max_level) || !perf_lock_list(type) ||
 			(lock->flags & PERF_LOCK_INITIALIZED)) {
 		pr_err("%s: ERROR \"%s\" flags %x level %d\n",
 			__func__, name, lock->flags, level);
@@ -373,11 +405,10 @@ void perf_lock_init(struct perf_lock *lock, unsigned int type,
 	lock->type = type;
 
 	INIT_LIST_HEAD(&lock->link);
+	INIT_LIST_HEAD(&lock->timed);
+	plist_node_init(&lock->node, level);
 	spin_lock_irqsave(&list_lock, irqflags);
-	if (lock->type == TYPE_PERF_LOCK)
-		list_add(&lock->link, &inactive_perf_locks);
-	if (lock->type == TYPE_CPUFREQ_CEILING)
-		list_add(&lock->link, &inactive_cpufreq_ceiling_locks);
+	list_add(&lock->link, &perf_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(perf_lock_init);
@@ -405,83 +436,181 @@ static void do_set_rate_fn(struct work_struct *work)
 }
 
 static DECLARE_WORK(do_setrate_work, do_set_rate_fn);
-void perf_lock(struct perf_lock *lock)
-{
-	unsigned long irqflags;
-	int cpu;
 
-	WARN_ON((lock->flags & PERF_LOCK_INITIALIZED) == 0);
-	WARN_ON(lock->flags & PERF_LOCK_ACTIVE);
+static int perf_lock_ready(struct perf_lock *lock)
+{
 	if (lock->type == TYPE_PERF_LOCK) {
 		WARN_ON(!initialized);
 		if (!initialized) {
 			if (debug_mask & PERF_LOCK_DEBUG)
 				pr_info("%s exit because perflock is not initialized\n", __func__);
-			return;
+			return 0;
 		}
 	} else if (lock->type == TYPE_CPUFREQ_CEILING) {
 		WARN_ON(!cpufreq_ceiling_initialized);
 		if (!cpufreq_ceiling_initialized) {
 			if (debug_mask & PERF_LOCK_DEBUG)
 				pr_info("%s exit because cpufreq_ceiling is not initialized\n", __func__);
-			return;
+			return 0;
 		}
 	}
+	return 1;
+}
+
+/*
+ * Both return true if the aggregate of the lock's type changed, only then
+ * does anything need to be told.  Called with list_lock held.
+ */
+static bool __perf_lock_add(struct perf_lock *lock)
+{
+	int old = perf_lock_aggregate(lock->type);
 
-	spin_lock_irqsave(&list_lock, irqflags);
-	if (debug_mask & PERF_LOCK_DEBUG)
-		pr_info("%s: '%s', flags %d level %d type %u\n",
-			__func__, lock->name, lock->flags, lock->level, lock->type);
-	if (lock->flags & PERF_LOCK_ACTIVE) {
-		pr_err("%s:type(%u) over-locked\n", __func__, lock->type);
-		spin_unlock_irqrestore(&list_lock, irqflags);
-		return;
-	}
 	lock->flags |= PERF_LOCK_ACTIVE;
-	list_del(&lock->link);
-	if (lock->type == TYPE_PERF_LOCK)
-		list_add(&lock->link, &active_perf_locks);
-	else if (lock->type == TYPE_CPUFREQ_CEILING)
-		list_add(&lock->link, &active_cpufreq_ceiling_locks);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	plist_node_init(&lock->node, lock->level);
+	plist_add(&lock->node, perf_lock_list(lock->type));
+
+	return perf_lock_aggregate(lock->type) != old;
+}
+
+static bool __perf_lock_del(struct perf_lock *lock)
+{
+	int old = perf_lock_aggregate(lock->type);
+
+	lock->flags &= ~PERF_LOCK_ACTIVE;
+	plist_del(&lock->node, perf_lock_list(lock->type));
+	list_del_init(&lock->timed);
+
+	return perf_lock_aggregate(lock->type) != old;
+}
+
+/* A raised floor or lowered ceiling is pushed to every cpu right away */
+static void perf_lock_apply(unsigned int type, bool tighter)
+{
+	int cpu;
 
 #ifdef CONFIG_HTC_PNPMGR
 	if (!legacy_mode) {
-		if (lock->type == TYPE_PERF_LOCK)
+		if (type == TYPE_PERF_LOCK)
 			sysfs_notify(cpufreq_kobj, NULL, "perflock_scaling_min");
-		else if (lock->type == TYPE_CPUFREQ_CEILING)
+		else if (type == TYPE_CPUFREQ_CEILING)
 			sysfs_notify(cpufreq_kobj, NULL, "perflock_scaling_max");
 		return;
 	}
 #endif
+	if (!tighter || type == TYPE_PERF_CORES)
+		return;
+
 	for_each_online_cpu(cpu) {
 		queue_work_on(cpu, perflock_setrate_workqueue, &do_setrate_work);
 	}
 }
-EXPORT_SYMBOL(perf_lock);
 
-void perf_unlock(struct perf_lock *lock)
+static void expire_perf_locks(struct work_struct *work);
+static DECLARE_DELAYED_WORK(expire_work, expire_perf_locks);
+
+static void expire_perf_locks(struct work_struct *work)
 {
+	struct perf_lock *lock, *n;
 	unsigned long irqflags;
+	unsigned long now = jiffies;
+	bool changed[TYPE_PERF_CORES + 1] = { false };
+	bool pending = false;
+	int type;
 
-	WARN_ON(!initialized);
-	WARN_ON((lock->flags & PERF_LOCK_ACTIVE) == 0);
-	if (lock->type == TYPE_PERF_LOCK) {
-		WARN_ON(!initialized);
-		if (!initialized) {
-			if (debug_mask & PERF_LOCK_DEBUG)
-				pr_info("%s exit because perflock is not initialized\n", __func__);
-			return;
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_for_each_entry_safe(lock, n, &timed_perf_locks, timed) {
+		if (time_before(now, lock->expires)) {
+			if (!pending || time_before(lock->expires, next_expiry))
+				next_expiry = lock->expires;
+			pending = true;
+			continue;
 		}
+		if (debug_mask & PERF_EXPIRE_DEBUG)
+			pr_info("%s: '%s' expired\n", __func__, lock->name);
+		if (__perf_lock_del(lock))
+			changed[lock->type] = true;
 	}
-	if (lock->type == TYPE_CPUFREQ_CEILING) {
-		WARN_ON(!cpufreq_ceiling_initialized);
-		if (!cpufreq_ceiling_initialized) {
-			if (debug_mask & PERF_LOCK_DEBUG)
-				pr_info("%s exit because cpufreq_ceiling is not initialized\n", __func__);
+	if (pending)
+		schedule_delayed_work(&expire_work, next_expiry - now);
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	for (type = 0; type <= TYPE_PERF_CORES; type++)
+		if (changed[type])
+			perf_lock_apply(type, false);
+}
+
+static void __perf_lock(struct perf_lock *lock, unsigned long timeout)
+{
+	unsigned long irqflags;
+	unsigned long expires = jiffies + timeout;
+	bool changed = false;
+
+	WARN_ON((lock->flags & PERF_LOCK_INITIALIZED) == 0);
+	if (!perf_lock_ready(lock))
+		return;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	if (debug_mask & PERF_LOCK_DEBUG)
+		pr_info("%s: '%s', flags %d level %d type %u\n",
+			__func__, lock->name, lock->flags, lock->level, lock->type);
+	if (lock->flags & PERF_LOCK_ACTIVE) {
+		/* Renewing a timed lock only moves its expiry */
+		if (!timeout || list_empty(&lock->timed)) {
+			WARN_ON(1);
+			pr_err("%s:type(%u) over-locked\n", __func__, lock->type);
+			spin_unlock_irqrestore(&list_lock, irqflags);
 			return;
 		}
+	} else {
+		changed = __perf_lock_add(lock);
+		if (timeout)
+			list_add(&lock->timed, &timed_perf_locks);
+	}
+
+	if (timeout) {
+		lock->expires = expires;
+		/* Only run the expiry early, it reschedules for the rest */
+		if (!delayed_work_pending(&expire_work) ||
+		    time_before(expires, next_expiry)) {
+			__cancel_delayed_work(&expire_work);
+			next_expiry = expires;
+			schedule_delayed_work(&expire_work, timeout);
+		}
 	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	if (changed)
+		perf_lock_apply(lock->type, true);
+}
+
+void perf_lock(struct perf_lock *lock)
+{
+	__perf_lock(lock, 0);
+}
+EXPORT_SYMBOL(perf_lock);
+
+/**
+ * perf_lock_timeout - hold a perf_lock for a while
+ * @lock: the lock, must not be held without a timeout
+ * @timeout: how long, in jiffies
+ *
+ * Calling it again before the lock expires extends the timeout.  Timed
+ * locks share one work item, there's no timer per lock.
+ */
+void perf_lock_timeout(struct perf_lock *lock, unsigned long timeout)
+{
+	__perf_lock(lock, max(timeout, 1UL));
+}
+EXPORT_SYMBOL(perf_lock_timeout);
+
+void perf_unlock(struct perf_lock *lock)
+{
+	unsigned long irqflags;
+	bool changed;
+
+	WARN_ON((lock->flags & PERF_LOCK_ACTIVE) == 0);
+	if (!perf_lock_ready(lock))
+		return;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 	if (debug_mask & PERF_LOCK_DEBUG)
@@ -492,21 +621,11 @@ void perf_unlock(struct perf_lock *lock)
 		spin_unlock_irqrestore(&list_lock, irqflags);
 		return;
 	}
-	lock->flags &= ~PERF_LOCK_ACTIVE;
-	list_del(&lock->link);
-	if (lock->type == TYPE_PERF_LOCK)
-		list_add(&lock->link, &inactive_perf_locks);
-	else if (lock->type == TYPE_CPUFREQ_CEILING)
-		list_add(&lock->link, &inactive_cpufreq_ceiling_locks);
+	changed = __perf_lock_del(lock);
 	spin_unlock_irqrestore(&list_lock, irqflags);
-#ifdef CONFIG_HTC_PNPMGR
-	if (!legacy_mode) {
-		if (lock->type == TYPE_PERF_LOCK)
-			sysfs_notify(cpufreq_kobj, NULL, "perflock_scaling_min");
-		else if (lock->type == TYPE_CPUFREQ_CEILING)
-			sysfs_notify(cpufreq_kobj, NULL, "perflock_scaling_max");
-	}
-#endif
+
+	if (changed)
+		perf_lock_apply(lock->type, false);
 }
 EXPORT_SYMBOL(perf_unlock);
 
@@ -518,35 +637,30 @@ EXPORT_SYMBOL(is_perf_lock_active);
 
 int is_perf_locked(void)
 {
-	return (!list_empty(&active_perf_locks));
+	return (!plist_head_empty(&floor_locks));
 }
 EXPORT_SYMBOL(is_perf_locked);
 
+unsigned int perflock_min_cores(void)
+{
+	unsigned long irqflags;
+	int cores;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	cores = perf_lock_aggregate(TYPE_PERF_CORES);
+	spin_unlock_irqrestore(&list_lock, irqflags);
+
+	return cores < 0 ? 0 : cores;
+}
+EXPORT_SYMBOL(perflock_min_cores);
+
 static struct perf_lock *perflock_find(const char *name)
 {
 	struct perf_lock *lock;
 	unsigned long irqflags;
 
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_for_each_entry(lock, &active_perf_locks, link) {
-		if(!strcmp(lock->name, name)) {
-			spin_unlock_irqrestore(&list_lock, irqflags);
-			return lock;
-		}
-	}
-	list_for_each_entry(lock, &inactive_perf_locks, link) {
-		if(!strcmp(lock->name, name)) {
-			spin_unlock_irqrestore(&list_lock, irqflags);
-			return lock;
-		}
-	}
-	list_for_each_entry(lock, &active_cpufreq_ceiling_locks, link) {
-		if(!strcmp(lock->name, name)) {
-			spin_unlock_irqrestore(&list_lock, irqflags);
-			return lock;
-		}
-	}
-	list_for_each_entry(lock, &inactive_cpufreq_ceiling_locks, link) {
+	list_for_each_entry(lock, &perf_locks, link) {
 		if(!strcmp(lock->name, name)) {
 			spin_unlock_irqrestore(&list_lock, irqflags);
 			return lock;
@@ -573,6 +687,8 @@ struct perf_lock *perflock_acquire(const char *name)
 	lock->name = name;
 	
 	lock->flags = 0; 
+	INIT_LIST_HEAD(&lock->link);
+	INIT_LIST_HEAD(&lock->timed);
 
 	return lock;
 }
@@ -603,15 +719,6 @@ EXPORT_SYMBOL(perflock_release);
 #define BOOT_LOCK_TIMEOUT	(60 * HZ)
 static struct perf_lock boot_perf_lock;
 
-static void do_expire_boot_lock(struct work_struct *work)
-{
-	if(is_perf_lock_active(&boot_perf_lock)) {
-		perf_unlock(&boot_perf_lock);
-		pr_info("Release 'boot-time' perf_lock\n");
-	}
-}
-static DECLARE_DELAYED_WORK(work_expire_boot_lock, do_expire_boot_lock);
-
 void release_boot_lock(void)
 {
 	if(is_perf_lock_active(&boot_perf_lock)) {
@@ -692,7 +799,8 @@ static void perflock_floor_init(struct perflock_data *pdata)
 		goto invalid_config;
 
 	perf_acpu_table_fixup();
-	perflock_setrate_workqueue = create_workqueue("perflock_setrate_wq");
+	perflock_setrate_workqueue = alloc_workqueue("perflock_setrate_wq",
+					WQ_MEM_RECLAIM | WQ_HIGHPRI, 1);
 
 	init_local_freq_policy(policy_min, policy_max);
 	initialized = 1;
@@ -700,8 +808,7 @@ static void perflock_floor_init(struct perflock_data *pdata)
 #ifdef CONFIG_PERFLOCK_BOOT_LOCK
 	
 	perf_lock_init(&boot_perf_lock, TYPE_PERF_LOCK, PERF_LOCK_HIGHEST, "boot-time");
-	perf_lock(&boot_perf_lock);
-	schedule_delayed_work(&work_expire_boot_lock, BOOT_LOCK_TIMEOUT);
+	perf_lock_timeout(&boot_perf_lock, BOOT_LOCK_TIMEOUT);
 	pr_info("Acquire 'boot-time' perf_lock\n");
 #endif
 
@@ -20,6 +20,7 @@
 #include <linux/mutex.h>
 #include <linux/memblock.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/atomic.h>
 #include <linux/suspend.h>
 #include <linux/rwsem.h>
@@ -29,6 +30,8 @@
 #include <linux/wakelock.h>
 #include <linux/delay.h>
 #include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include <asm/uaccess.h>
 #include <asm/setup.h>
@@ -46,6 +49,27 @@ static const char *pil_states[] = {
 	[PIL_ONLINE] = "ONLINE",
 };
 
+#define PIL_MAX_SEG_STATS	16
+
+struct pil_seg_stat {
+	unsigned int num;
+	size_t size;
+	unsigned int us;
+};
+
+/* What a successful load put in memory, replayed by the next load */
+struct pil_image_cache {
+	void *mdt;
+	size_t mdt_size;
+	void **segs;
+	unsigned int nsegs;
+	bool incomplete;
+};
+
+static bool cache_images;
+module_param(cache_images, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(cache_images, "Keep a copy of each image for restarts");
+
 struct pil_device {
 	struct pil_desc *desc;
 	int count;
@@ -59,6 +83,24 @@ struct pil_device {
 	struct delayed_work proxy;
 	struct wake_lock wlock;
 	char wake_name[32];
+	/* Last load, for debugfs */
+	unsigned int load_us;
+	int nr_seg_stats;
+	struct pil_seg_stat seg_stats[PIL_MAX_SEG_STATS];
+	struct pil_image_cache cache;
+	bool from_cache;
+};
+
+/* Segments of one image load in parallel, ueventd serves each request */
+static struct workqueue_struct *pil_load_wq;
+
+struct pil_seg_load {
+	struct work_struct work;
+	const struct elf32_phdr *phdr;
+	unsigned num;
+	struct pil_device *pil;
+	int ret;
+	unsigned int us;
 };
 
 #define to_pil_device(d) container_of(d, struct pil_device, dev)
@@ -137,13 +179,68 @@ static void pil_proxy_unvote(struct pil_device *pil, unsigned long timeout)
 
 #define IOMAP_SIZE SZ_4M
 
+static void pil_cache_free(struct pil_device *pil)
+{
+	struct pil_image_cache *cache = &pil->cache;
+	int i;
+
+	for (i = 0; cache->segs && i < cache->nsegs; i++)
+		vfree(cache->segs[i]);
+	kfree(cache->segs);
+	kfree(cache->mdt);
+	memset(cache, 0, sizeof(*cache));
+}
+
+static int pil_copy_io(phys_addr_t paddr, void *data, size_t len, int to_io)
+{
+	while (len) {
+		size_t size = min_t(size_t, IOMAP_SIZE, len);
+		u8 __iomem *buf = ioremap(paddr, size);
+
+		if (!buf)
+			return -ENOMEM;
+		if (to_io)
+			memcpy_toio(buf, data, size);
+		else
+			memcpy_fromio(data, buf, size);
+		iounmap(buf);
+
+		len -= size;
+		paddr += size;
+		data += size;
+	}
+	return 0;
+}
+
+static int pil_cache_restore(const struct elf32_phdr *phdr, unsigned num,
+		struct pil_device *pil)
+{
+	void *blob = pil->cache.segs[num];
+
+	if (!blob)
+		return -ENOENT;
+	return pil_copy_io(phdr->p_paddr, blob, phdr->p_filesz, 1);
+}
+
+/* Runs before auth_and_reset, so memory still holds just the blob */
+static void pil_cache_store(const struct elf32_phdr *phdr, unsigned num,
+		struct pil_device *pil)
+{
+	void *blob = vmalloc(phdr->p_filesz);
+
+	if (blob && !pil_copy_io(phdr->p_paddr, blob, phdr->p_filesz, 0)) {
+		pil->cache.segs[num] = blob;
+		return;
+	}
+	vfree(blob);
+	pil->cache.incomplete = true;
+}
+
 static int load_segment(const struct elf32_phdr *phdr, unsigned num,
 		struct pil_device *pil)
 {
 	int ret = 0, count, paddr;
 	char fw_name[30];
-	const struct firmware *fw = NULL;
-	const u8 *data;
 
 	if (memblock_overlaps_memory(phdr->p_paddr, phdr->p_memsz)) {
 		dev_err(&pil->dev, "%s: kernel memory would be overwritten "
@@ -153,49 +250,36 @@ static int load_segment(const struct elf32_phdr *phdr, unsigned num,
 		return -EPERM;
 	}
 
-	if (phdr->p_filesz) {
+	if (phdr->p_filesz && pil->from_cache) {
+		ret = pil_cache_restore(phdr, num, pil);
+		if (ret) {
+			dev_err(&pil->dev, "%s: Failed to restore blob%u\n",
+					pil->desc->name, num);
+			return ret;
+		}
+	} else if (phdr->p_filesz) {
 		snprintf(fw_name, ARRAY_SIZE(fw_name), "%s.b%02d",
 				pil->desc->name, num);
-		ret = request_firmware(&fw, fw_name, &pil->dev);
-		if (ret) {
+		ret = request_firmware_direct(fw_name, &pil->dev,
+				phdr->p_paddr, phdr->p_filesz);
+		if (ret < 0) {
 			dev_err(&pil->dev, "%s: Failed to locate blob %s\n",
 					pil->desc->name, fw_name);
 			return ret;
 		}
 
-		if (fw->size != phdr->p_filesz) {
+		if (ret != phdr->p_filesz) {
 			dev_err(&pil->dev, "%s: Blob size %u doesn't match "
-					"%u\n", pil->desc->name, fw->size,
+					"%u\n", pil->desc->name, ret,
 					phdr->p_filesz);
-			ret = -EPERM;
-			goto release_fw;
+			return -EPERM;
 		}
+		ret = 0;
+		if (pil->cache.segs)
+			pil_cache_store(phdr, num, pil);
 	}
 
-	
-	count = phdr->p_filesz;
-	paddr = phdr->p_paddr;
-	data = fw ? fw->data : NULL;
-	while (count > 0) {
-		int size;
-		u8 __iomem *buf;
-
-		size = min_t(size_t, IOMAP_SIZE, count);
-		buf = ioremap(paddr, size);
-		if (!buf) {
-			dev_err(&pil->dev, "%s: Failed to map memory\n",
-					pil->desc->name);
-			ret = -ENOMEM;
-			goto release_fw;
-		}
-		memcpy(buf, data, size);
-		iounmap(buf);
-
-		count -= size;
-		paddr += size;
-		data += size;
-	}
-
+	paddr = phdr->p_paddr + phdr->p_filesz;
 	
 	count = phdr->p_memsz - phdr->p_filesz;
 	while (count > 0) {
@@ -207,8 +291,7 @@ static int load_segment(const struct elf32_phdr *phdr, unsigned num,
 		if (!buf) {
 			dev_err(&pil->dev, "%s: Failed to map memory\n",
 					pil->desc->name);
-			ret = -ENOMEM;
-			goto release_fw;
+			return -ENOMEM;
 		}
 		memset(buf, 0, size);
 		iounmap(buf);
@@ -225,11 +308,19 @@ static int load_segment(const struct elf32_phdr *phdr, unsigned num,
 				pil->desc->name, num);
 	}
 
-release_fw:
-	release_firmware(fw);
 	return ret;
 }
 
+static void load_segment_work(struct work_struct *work)
+{
+	struct pil_seg_load *seg = container_of(work, struct pil_seg_load,
+						work);
+	ktime_t start = ktime_get();
+
+	seg->ret = load_segment(seg->phdr, seg->num, seg->pil);
+	seg->us = ktime_us_delta(ktime_get(), start);
+}
+
 #define segment_is_hash(flag) (((flag) & (0x7 << 24)) == (0x2 << 24))
 
 static int segment_is_loadable(const struct elf32_phdr *p)
@@ -245,10 +336,24 @@ static int load_image(struct pil_device *pil)
 	char fw_name[30];
 	struct elf32_hdr *ehdr;
 	const struct elf32_phdr *phdr;
-	const struct firmware *fw;
+	const struct firmware *fw = NULL;
+	const u8 *data;
+	size_t size;
 	unsigned long proxy_timeout = pil->desc->proxy_timeout;
+	struct pil_seg_load *segs;
+	struct pil_seg_stat *stat;
+	ktime_t start = ktime_get();
 
 	down_read(&pil_pm_rwsem);
+	if (!cache_images)
+		pil_cache_free(pil);
+	pil->from_cache = pil->cache.mdt != NULL;
+	if (pil->from_cache) {
+		data = pil->cache.mdt;
+		size = pil->cache.mdt_size;
+		goto parse;
+	}
+
 	snprintf(fw_name, sizeof(fw_name), "%s.mdt", pil->desc->name);
 	ret = request_firmware(&fw, fw_name, &pil->dev);
 	if (ret) {
@@ -256,15 +361,18 @@ static int load_image(struct pil_device *pil)
 				pil->desc->name, fw_name);
 		goto out;
 	}
+	data = fw->data;
+	size = fw->size;
 
-	if (fw->size < sizeof(*ehdr)) {
+parse:
+	if (size < sizeof(*ehdr)) {
 		dev_err(&pil->dev, "%s: Not big enough to be an elf header\n",
 				pil->desc->name);
 		ret = -EIO;
 		goto release_fw;
 	}
 
-	ehdr = (struct elf32_hdr *)fw->data;
+	ehdr = (struct elf32_hdr *)data;
 	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG)) {
 		dev_err(&pil->dev, "%s: Not an elf header\n", pil->desc->name);
 		ret = -EIO;
@@ -278,32 +386,65 @@ static int load_image(struct pil_device *pil)
 		goto release_fw;
 	}
 	if (sizeof(struct elf32_phdr) * ehdr->e_phnum +
-	    sizeof(struct elf32_hdr) > fw->size) {
+	    sizeof(struct elf32_hdr) > size) {
 		dev_err(&pil->dev, "%s: Program headers not within mdt\n",
 				pil->desc->name);
 		ret = -EIO;
 		goto release_fw;
 	}
 
-	ret = pil->desc->ops->init_image(pil->desc, fw->data, fw->size);
+	ret = pil->desc->ops->init_image(pil->desc, data, size);
 	if (ret) {
 		dev_err(&pil->dev, "%s: Invalid firmware metadata\n",
 				pil->desc->name);
 		goto release_fw;
 	}
 
-	phdr = (const struct elf32_phdr *)(fw->data + sizeof(struct elf32_hdr));
+	segs = kcalloc(ehdr->e_phnum, sizeof(*segs), GFP_KERNEL);
+	if (!segs) {
+		ret = -ENOMEM;
+		goto release_fw;
+	}
+
+	if (cache_images && !pil->from_cache) {
+		pil->cache.segs = kcalloc(ehdr->e_phnum, sizeof(void *),
+					  GFP_KERNEL);
+		pil->cache.nsegs = pil->cache.segs ? ehdr->e_phnum : 0;
+	}
+
+	phdr = (const struct elf32_phdr *)(data + sizeof(struct elf32_hdr));
 	for (i = 0; i < ehdr->e_phnum; i++, phdr++) {
 		if (!segment_is_loadable(phdr))
 			continue;
 
-		ret = load_segment(phdr, i, pil);
-		if (ret) {
+		segs[i].phdr = phdr;
+		segs[i].num = i;
+		segs[i].pil = pil;
+		INIT_WORK(&segs[i].work, load_segment_work);
+		queue_work(pil_load_wq, &segs[i].work);
+	}
+
+	pil->nr_seg_stats = 0;
+	for (i = 0; i < ehdr->e_phnum; i++) {
+		if (!segs[i].phdr)
+			continue;
+
+		flush_work(&segs[i].work);
+		if (segs[i].ret && !ret) {
 			dev_err(&pil->dev, "%s: Failed to load segment %d\n",
 					pil->desc->name, i);
-			goto release_fw;
+			ret = segs[i].ret;
+		}
+		if (pil->nr_seg_stats < PIL_MAX_SEG_STATS) {
+			stat = &pil->seg_stats[pil->nr_seg_stats++];
+			stat->num = i;
+			stat->size = segs[i].phdr->p_memsz;
+			stat->us = segs[i].us;
 		}
 	}
+	kfree(segs);
+	if (ret)
+		goto release_fw;
 
 	ret = pil_proxy_vote(pil);
 	if (ret) {
@@ -319,10 +460,19 @@ static int load_image(struct pil_device *pil)
 		proxy_timeout = 0; 
 		goto err_boot;
 	}
-	dev_info(&pil->dev, "%s: Brought out of reset\n", pil->desc->name);
+	pil->load_us = ktime_us_delta(ktime_get(), start);
+	dev_info(&pil->dev, "%s: Brought out of reset in %u ms%s\n",
+			pil->desc->name, pil->load_us / USEC_PER_MSEC,
+			pil->from_cache ? " from cache" : "");
 err_boot:
 	pil_proxy_unvote(pil, proxy_timeout);
 release_fw:
+	if (fw && !ret && pil->cache.segs && !pil->cache.incomplete) {
+		pil->cache.mdt = kmemdup(fw->data, fw->size, GFP_KERNEL);
+		pil->cache.mdt_size = fw->size;
+	}
+	if (ret || !pil->cache.mdt)
+		pil_cache_free(pil);
 	release_firmware(fw);
 out:
 	up_read(&pil_pm_rwsem);
@@ -547,6 +697,40 @@ static const struct file_operations msm_pil_debugfs_fops = {
 	.write	= msm_pil_debugfs_write,
 };
 
+static int __msm_pil_stats_show(struct device *dev, void *data)
+{
+	struct pil_device *pil = to_pil_device(dev);
+	struct seq_file *m = data;
+	int i;
+
+	mutex_lock(&pil->lock);
+	seq_printf(m, "%s: %u us%s\n", pil->desc->name, pil->load_us,
+		   pil->from_cache ? " (cached)" : "");
+	for (i = 0; i < pil->nr_seg_stats; i++)
+		seq_printf(m, "  b%02u %8zu bytes %8u us\n",
+			   pil->seg_stats[i].num, pil->seg_stats[i].size,
+			   pil->seg_stats[i].us);
+	mutex_unlock(&pil->lock);
+	return 0;
+}
+
+static int msm_pil_stats_show(struct seq_file *m, void *unused)
+{
+	return bus_for_each_dev(&pil_bus_type, NULL, m, __msm_pil_stats_show);
+}
+
+static int msm_pil_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_pil_stats_show, NULL);
+}
+
+static const struct file_operations msm_pil_stats_fops = {
+	.open		= msm_pil_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct dentry *pil_base_dir;
 
 static int __init msm_pil_debugfs_init(void)
@@ -556,6 +740,8 @@ static int __init msm_pil_debugfs_init(void)
 		pil_base_dir = NULL;
 		return -ENOMEM;
 	}
+	debugfs_create_file("load_times", S_IRUGO, pil_base_dir, NULL,
+			    &msm_pil_stats_fops);
 
 	return 0;
 }
@@ -601,6 +787,7 @@ late_initcall(msm_pil_shutdown_at_boot);
 static void pil_device_release(struct device *dev)
 {
 	struct pil_device *pil = to_pil_device(dev);
+	pil_cache_free(pil);
 	wake_lock_destroy(&pil->wlock);
 	mutex_destroy(&pil->lock);
 	kfree(pil);
@@ -695,6 +882,9 @@ static int __init msm_pil_init(void)
 	int ret = msm_pil_debugfs_init();
 	if (ret)
 		return ret;
+	pil_load_wq = alloc_workqueue("pil_load", WQ_UNBOUND, 0);
+	if (!pil_load_wq)
+		return -ENOMEM;
 	register_pm_notifier(&pil_pm_notifier);
 	return bus_register(&pil_bus_type);
 }
@@ -704,6 +894,7 @@ static void __exit msm_pil_exit(void)
 {
 	bus_unregister(&pil_bus_type);
 	unregister_pm_notifier(&pil_pm_notifier);
+	destroy_workqueue(pil_load_wq);
 	msm_pil_debugfs_exit();
 }
 module_exit(msm_pil_exit);
@@ -129,12 +129,13 @@ extern unsigned long acpuclk_krait_power_collapse(void);
 #endif
 #define CPU_FOOT_PRINT_MAGIC				0xACBDFE00
 #define CPU_FOOT_PRINT_MAGIC_SPC			0xACBDAA00
+#define CPU_FOOT_PRINT_MAGIC_HOTPLUG			0xACBDCC00
 #define CPU_FOOT_PRINT_BASE_CPU0_VIRT		(CPU_FOOT_PRINT_BASE + 0x0)
 
-static void init_cpu_foot_print(unsigned cpu, bool notify_rpm)
+static void init_cpu_foot_print(unsigned cpu, unsigned magic)
 {
 	unsigned *status = (unsigned *)CPU_FOOT_PRINT_BASE_CPU0_VIRT + cpu;
-	*status = (notify_rpm) ? CPU_FOOT_PRINT_MAGIC : CPU_FOOT_PRINT_MAGIC_SPC;
+	*status = magic;
 	mb();
 }
 
@@ -172,6 +173,15 @@ static void store_pm_boot_vector_addr(unsigned value)
 	mb();
 }
 
+/*
+ * An offlined core waits in power collapse with its context saved, and
+ * onlining it goes through the same exit path as idle power collapse
+ * instead of the secondary boot from reset.
+ */
+static bool msm_pm_warm_hotplug = true;
+module_param_named(warm_hotplug, msm_pm_warm_hotplug, bool,
+		   S_IRUGO | S_IWUSR | S_IWGRP);
+
 enum {
 	MSM_PM_MODE_ATTR_SUSPEND,
 	MSM_PM_MODE_ATTR_IDLE,
@@ -530,6 +540,7 @@ static bool __ref msm_pm_spm_power_collapse(
 {
 	void *entry;
 	bool collapsed = 0;
+	bool warm_hotplug = cpu && !from_idle && msm_pm_warm_hotplug;
 	int ret;
 	unsigned int saved_gic_cpu_ctrl;
 
@@ -544,7 +555,7 @@ static bool __ref msm_pm_spm_power_collapse(
 			MSM_SPM_MODE_POWER_COLLAPSE, notify_rpm);
 	WARN_ON(ret);
 
-	entry = (!cpu || from_idle) ?
+	entry = (!cpu || from_idle || warm_hotplug) ?
 		msm_pm_collapse_exit : msm_secondary_startup;
 	msm_pm_boot_config_before_pc(cpu, virt_to_phys(entry));
 
@@ -573,7 +584,11 @@ static bool __ref msm_pm_spm_power_collapse(
 #endif
 	}
 
-	init_cpu_foot_print(cpu, notify_rpm);
+	if (warm_hotplug)
+		init_cpu_foot_print(cpu, CPU_FOOT_PRINT_MAGIC_HOTPLUG);
+	else
+		init_cpu_foot_print(cpu, notify_rpm ? CPU_FOOT_PRINT_MAGIC :
+				    CPU_FOOT_PRINT_MAGIC_SPC);
 
 	collapsed = msm_pm_l2x0_power_collapse();
 
@@ -819,6 +834,7 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev,
 {
 	uint32_t latency_us;
 	uint32_t sleep_us;
+	uint32_t predicted_us;
 	int i;
 	unsigned int power_usage = -1;
 	int ret = MSM_PM_SLEEP_MODE_NOT_SELECTED;
@@ -827,6 +843,11 @@ int msm_pm_idle_prepare(struct cpuidle_device *dev,
 	sleep_us = (uint32_t) ktime_to_ns(tick_nohz_get_sleep_length());
 	sleep_us = DIV_ROUND_UP(sleep_us, 1000);
 
+	/* Interrupts tend to cut the sleep short of the next timer */
+	predicted_us = cpuidle_predict_get_us(dev);
+	if (predicted_us && predicted_us < sleep_us)
+		sleep_us = predicted_us;
+
 	for (i = 0; i < dev->state_count; i++) {
 		struct cpuidle_state *state = &drv->states[i];
 		struct cpuidle_state_usage *st_usage = &dev->states_usage[i];
@@ -36,6 +36,9 @@
 #include <mach/subsystem_notif.h>
 #include <mach/subsystem_restart.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/apr.h>
+
 struct apr_q6 q6;
 struct apr_client client[APR_DEST_MAX][APR_CLIENT_MAX];
 static atomic_t dsp_state;
@@ -64,20 +67,8 @@ static void apr_q6_check_worker(struct work_struct *work)
 	}
 }
 
-int apr_send_pkt(void *handle, uint32_t *buf)
+static int apr_check_svc(struct apr_svc *svc)
 {
-	struct apr_svc *svc = handle;
-	struct apr_client *clnt;
-	struct apr_hdr *hdr;
-	uint16_t dest_id;
-	uint16_t client_id;
-	uint16_t w_len;
-	unsigned long flags;
-
-	if (!handle || !buf) {
-		pr_err("APR: Wrong parameters\n");
-		return -EINVAL;
-	}
 	if (svc->need_reset) {
 		pr_err("apr: send_pkt service need reset\n");
 		return -ENETRESET;
@@ -92,7 +83,85 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 		pr_err("apr: Still Modem is not Up\n");
 		return -ENETRESET;
 	}
+	return 0;
+}
+
+static void apr_fill_dest(struct apr_svc *svc, struct apr_hdr *hdr)
+{
+	hdr->src_domain = APR_DOMAIN_APPS;
+	hdr->src_svc = svc->id;
+	if (svc->dest_id == APR_DEST_MODEM)
+		hdr->dest_domain = APR_DOMAIN_MODEM;
+	else if (svc->dest_id == APR_DEST_QDSP6)
+		hdr->dest_domain = APR_DOMAIN_ADSP;
+
+	hdr->dest_svc = svc->id;
+}
+
+/* Remember when a command left, for apr_cmd_rtt */
+static void apr_note_sent(struct apr_svc *svc, struct apr_hdr *hdr,
+				ktime_t now)
+{
+	struct apr_pending *p;
+	unsigned long flags;
+
+	spin_lock_irqsave(&svc->pending_lock, flags);
+	p = &svc->pending[svc->pending_head];
+	svc->pending_head = (svc->pending_head + 1) % APR_PENDING_MAX;
+	p->opcode = hdr->opcode;
+	p->token = hdr->token;
+	p->port = hdr->src_port;
+	p->sent = now;
+	spin_unlock_irqrestore(&svc->pending_lock, flags);
+}
+
+static void apr_note_rsp(struct apr_svc *svc, struct apr_client_data *data)
+{
+	struct apr_pending *p;
+	unsigned long flags;
+	uint32_t opcode = 0;
+	int i, n;
+
+	if (data->opcode == APR_BASIC_RSP_RESULT) {
+		if (data->payload_size < sizeof(uint32_t))
+			return;
+		opcode = *(uint32_t *)data->payload;
+	}
+
+	spin_lock_irqsave(&svc->pending_lock, flags);
+	for (n = 0; n < APR_PENDING_MAX; n++) {
+		i = (svc->pending_head + n) % APR_PENDING_MAX;
+		p = &svc->pending[i];
+		if (!p->opcode || p->port != data->dest_port ||
+		    p->token != data->token || (opcode && p->opcode != opcode))
+			continue;
+
+		trace_apr_cmd_rtt(svc->id, p->opcode, p->token,
+			ktime_us_delta(ktime_get(), p->sent));
+		p->opcode = 0;
+		break;
+	}
+	spin_unlock_irqrestore(&svc->pending_lock, flags);
+}
+
+int apr_send_pkt(void *handle, uint32_t *buf)
+{
+	struct apr_svc *svc = handle;
+	struct apr_client *clnt;
+	struct apr_hdr *hdr;
+	uint16_t dest_id;
+	uint16_t client_id;
+	uint16_t w_len;
+	unsigned long flags;
+	int rc;
 
+	if (!handle || !buf) {
+		pr_err("APR: Wrong parameters\n");
+		return -EINVAL;
+	}
+	rc = apr_check_svc(svc);
+	if (rc)
+		return rc;
 
 	spin_lock_irqsave(&svc->w_lock, flags);
 	dest_id = svc->dest_id;
@@ -105,15 +174,8 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 		return -EINVAL;
 	}
 	hdr = (struct apr_hdr *)buf;
-
-	hdr->src_domain = APR_DOMAIN_APPS;
-	hdr->src_svc = svc->id;
-	if (dest_id == APR_DEST_MODEM)
-		hdr->dest_domain = APR_DOMAIN_MODEM;
-	else if (dest_id == APR_DEST_QDSP6)
-		hdr->dest_domain = APR_DOMAIN_ADSP;
-
-	hdr->dest_svc = svc->id;
+	apr_fill_dest(svc, hdr);
+	apr_note_sent(svc, hdr, ktime_get());
 
 	w_len = apr_tal_write(clnt->handle, buf, hdr->pkt_size);
 	if (w_len != hdr->pkt_size)
@@ -123,6 +185,56 @@ int apr_send_pkt(void *handle, uint32_t *buf)
 	return w_len;
 }
 
+/*
+ * Send @cnt complete packets in one SMD transaction, so the DSP takes a
+ * single interrupt for all of them.  Returns the total number of bytes
+ * written, or a negative error when none was.
+ */
+int apr_send_pkts(void *handle, uint32_t **bufs, int cnt)
+{
+	struct apr_svc *svc = handle;
+	struct apr_client *clnt;
+	struct kvec vec[APR_MAX_BATCH];
+	struct apr_hdr *hdr;
+	unsigned long flags;
+	ktime_t now;
+	int i, len = 0, rc;
+
+	if (!handle || !bufs || cnt <= 0 || cnt > APR_MAX_BATCH) {
+		pr_err("APR: Wrong parameters\n");
+		return -EINVAL;
+	}
+	rc = apr_check_svc(svc);
+	if (rc)
+		return rc;
+
+	spin_lock_irqsave(&svc->w_lock, flags);
+	clnt = &client[svc->dest_id][svc->client_id];
+	if (!clnt->handle) {
+		pr_err("APR: Still service is not yet opened\n");
+		spin_unlock_irqrestore(&svc->w_lock, flags);
+		return -EINVAL;
+	}
+
+	now = ktime_get();
+	for (i = 0; i < cnt; i++) {
+		hdr = (struct apr_hdr *)bufs[i];
+		apr_fill_dest(svc, hdr);
+		apr_note_sent(svc, hdr, now);
+		vec[i].iov_base = hdr;
+		vec[i].iov_len = hdr->pkt_size;
+		len += hdr->pkt_size;
+	}
+
+	rc = apr_tal_writev(clnt->handle, vec, cnt, len);
+	if (rc != len)
+		pr_err("Unable to write %d APR pkts successfully: %d\n",
+			cnt, rc);
+	spin_unlock_irqrestore(&svc->w_lock, flags);
+
+	return rc;
+}
+
 static void apr_cb_func(void *buf, int len, void *priv)
 {
 	struct apr_client_data data;
@@ -219,17 +331,12 @@ static void apr_cb_func(void *buf, int len, void *priv)
 
 	pr_debug("src =%d clnt = %d\n", src, clnt);
 	apr_client = &client[src][clnt];
-	for (i = 0; i < APR_SVC_MAX; i++)
-		if (apr_client->svc[i].id == svc) {
-			pr_debug("%d\n", apr_client->svc[i].id);
-			c_svc = &apr_client->svc[i];
-			break;
-		}
-
-	if (i == APR_SVC_MAX) {
+	i = apr_client->svc_map[svc] - 1;
+	if (i < 0 || apr_client->svc[i].id != svc) {
 		pr_err("APR: service is not registered\n");
 		return;
 	}
+	c_svc = &apr_client->svc[i];
 	pr_debug("svc_idx = %d\n", i);
 	pr_debug("%x %x %x %p %p\n", c_svc->id, c_svc->dest_id,
 			c_svc->client_id, c_svc->fn, c_svc->priv);
@@ -242,6 +349,7 @@ static void apr_cb_func(void *buf, int len, void *priv)
 	data.msg_type = msg_type;
 	if (data.payload_size > 0)
 		data.payload = (char *)hdr + hdr_size;
+	apr_note_rsp(c_svc, &data);
 
 	temp_port = ((data.src_port >> 8) * 8) + (data.src_port & 0xFF);
 	pr_debug("port = %d t_port = %d\n", data.src_port, temp_port);
@@ -422,6 +530,7 @@ struct apr_svc *apr_register(char *dest, char *svc_name, apr_fn svc_fn,
 	svc->id = svc_id;
 	svc->dest_id = dest_id;
 	svc->client_id = client_id;
+	client[dest_id][client_id].svc_map[svc_id] = svc_idx + 1;
 	if (src_port != 0xFFFFFFFF) {
 		temp_port = ((src_port >> 8) * 8) + (src_port & 0xFF);
 		pr_debug("port = %d t_port = %d\n", src_port, temp_port);
@@ -679,6 +788,7 @@ static int __init apr_init(void)
 			for (k = 0; k < APR_SVC_MAX; k++) {
 				mutex_init(&client[i][j].svc[k].m_lock);
 				spin_lock_init(&client[i][j].svc[k].w_lock);
+				spin_lock_init(&client[i][j].svc[k].pending_lock);
 			}
 		}
 	mutex_init(&q6.lock);
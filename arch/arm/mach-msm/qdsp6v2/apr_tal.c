@@ -84,6 +84,54 @@ int apr_tal_write(struct apr_svc_ch_dev *apr_ch, void *data, int len)
 	return rc;
 }
 
+/* SMD packet header, not included in smd_write_avail() for the others */
+#define APR_TAL_SMD_HDR	20
+
+static int __apr_tal_writev(struct apr_svc_ch_dev *apr_ch,
+			const struct kvec *vec, int cnt, int len)
+{
+	int w_len;
+	unsigned long flags;
+
+	spin_lock_irqsave(&apr_ch->w_lock, flags);
+	if (smd_write_avail(apr_ch->ch) < len + (cnt - 1) * APR_TAL_SMD_HDR) {
+		spin_unlock_irqrestore(&apr_ch->w_lock, flags);
+		return -EAGAIN;
+	}
+
+	w_len = smd_writev(apr_ch->ch, vec, cnt);
+	spin_unlock_irqrestore(&apr_ch->w_lock, flags);
+	pr_debug("apr_tal:w_len = %d\n", w_len);
+
+	if (w_len != len) {
+		pr_err("apr_tal: Error in writev %d/%d\n", w_len, len);
+		return -ENETRESET;
+	}
+	return w_len;
+}
+
+/* All @cnt packets, @len bytes in total, go out with one interrupt */
+int apr_tal_writev(struct apr_svc_ch_dev *apr_ch, const struct kvec *vec,
+			int cnt, int len)
+{
+	int rc = 0, retries = 0;
+
+	if (!apr_ch->ch)
+		return -EINVAL;
+
+	do {
+		if (rc == -EAGAIN)
+			udelay(50);
+
+		rc = __apr_tal_writev(apr_ch, vec, cnt, len);
+	} while (rc == -EAGAIN && retries++ < 300);
+
+	if (rc == -EAGAIN)
+		pr_err("apr_tal: TIMEOUT for writev\n");
+
+	return rc;
+}
+
 static void apr_tal_notify(void *priv, unsigned event)
 {
 	struct apr_svc_ch_dev *apr_ch = priv;
@@ -229,8 +229,8 @@ int do_ramdump(void *handle, struct ramdump_segment *segments,
 	struct ramdump_device *rd_dev = (struct ramdump_device *)handle;
 
 	if (!rd_dev->consumer_present) {
-		pr_err("Ramdump(%s): No consumers. Aborting..\n", rd_dev->name);
-		return -EPIPE;
+		pr_info("Ramdump(%s): No consumers, skipped\n", rd_dev->name);
+		return 0;
 	}
 
 	for (i = 0; i < nsegments; i++)
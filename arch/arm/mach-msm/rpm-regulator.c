@@ -883,6 +883,16 @@ static int vreg_store(struct vreg *vreg, unsigned mask0, unsigned val0,
 	return 0;
 }
 
+/* Nobody waits on a regulator going off, so that request is not waited on */
+static void vreg_set_async_done(void *data, int rc)
+{
+	struct vreg *vreg = data;
+
+	if (rc)
+		vreg_err(vreg, "msm_rpm_set_async failed, set=active, id=%d, "
+			"rc=%d\n", vreg->req[0].id, rc);
+}
+
 static int vreg_set(struct vreg *vreg, unsigned mask0, unsigned val0,
 		unsigned mask1, unsigned val1, unsigned cnt)
 {
@@ -928,6 +938,9 @@ static int vreg_set(struct vreg *vreg, unsigned mask0, unsigned val0,
 
 	if (voltage_increased && tcxo_workaround_noirq)
 		rc = msm_rpmrs_set_noirq(MSM_RPM_CTX_SET_0, vreg->req, cnt);
+	else if (!voltage_from_req(vreg))
+		rc = msm_rpm_set_async(MSM_RPM_CTX_SET_0, vreg->req, cnt,
+				vreg_set_async_done, vreg);
 	else
 		rc = msm_rpm_set(MSM_RPM_CTX_SET_0, vreg->req, cnt);
 
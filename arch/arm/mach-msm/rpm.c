@@ -28,6 +28,7 @@
 #include <linux/device.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 #include <asm/hardware/gic.h>
 #include <mach/msm_iomap.h>
 #include <mach/rpm.h>
@@ -66,6 +67,33 @@ static LIST_HEAD(msm_rpm_notifications);
 static struct msm_rpm_notif_config msm_rpm_notif_cfgs[MSM_RPM_CTX_SET_COUNT];
 static bool msm_rpm_init_notif_done;
 
+#define MSM_RPM_BATCH_MAX	32
+#define MSM_RPM_BATCH_CBS	8
+
+struct msm_rpm_batch_cb {
+	void (*fn)(void *data, int rc);
+	void *data;
+};
+
+/*
+ * Asynchronous requests of one set, under msm_rpm_lock.  The next message
+ * for the set carries them, written ahead of its own request so that the
+ * newer values of that request win.  A later clear of an id drops it.
+ */
+struct msm_rpm_batch {
+	struct msm_rpm_iv_pair iv[MSM_RPM_BATCH_MAX];
+	int count;
+	uint32_t sel_masks[SEL_MASK_SIZE];
+	struct msm_rpm_batch_cb cbs[MSM_RPM_BATCH_CBS];
+	int ncbs;
+};
+
+static struct msm_rpm_batch msm_rpm_batches[MSM_RPM_CTX_SET_COUNT];
+static struct msm_rpm_msg_stats msm_rpm_msg_stats;
+
+static void msm_rpm_batch_fn(struct work_struct *work);
+static DECLARE_WORK(msm_rpm_batch_work, msm_rpm_batch_fn);
+
 static inline unsigned int target_enum(unsigned int id)
 {
 	BUG_ON(id >= MSM_RPM_ID_LAST);
@@ -151,6 +179,88 @@ static int msm_rpm_fill_sel_masks(
 	return 0;
 }
 
+static int msm_rpm_batch_find(struct msm_rpm_batch *b, uint32_t id)
+{
+	int i;
+
+	for (i = 0; i < b->count; i++)
+		if (b->iv[i].id == id)
+			return i;
+	return -1;
+}
+
+static bool msm_rpm_batch_add_locked(struct msm_rpm_batch *b,
+	uint32_t *sel_masks, struct msm_rpm_iv_pair *req, int count,
+	void (*done)(void *data, int rc), void *data)
+{
+	int room = MSM_RPM_BATCH_MAX - b->count;
+	int i, j;
+
+	if (done && b->ncbs == MSM_RPM_BATCH_CBS)
+		return false;
+	for (i = 0; i < count; i++)
+		if (msm_rpm_batch_find(b, req[i].id) < 0 && --room < 0)
+			return false;
+
+	for (i = 0; i < count; i++) {
+		j = msm_rpm_batch_find(b, req[i].id);
+		if (j < 0)
+			j = b->count++;
+		b->iv[j] = req[i];
+	}
+	for (i = 0; i < msm_rpm_sel_mask_size; i++)
+		b->sel_masks[i] |= sel_masks[i];
+	if (done) {
+		b->cbs[b->ncbs].fn = done;
+		b->cbs[b->ncbs].data = data;
+		b->ncbs++;
+	}
+	return true;
+}
+
+static void msm_rpm_batch_drop_locked(struct msm_rpm_batch *b,
+	struct msm_rpm_iv_pair *req, int count)
+{
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		j = msm_rpm_batch_find(b, req[i].id);
+		if (j >= 0)
+			b->iv[j] = b->iv[--b->count];
+	}
+	memset(b->sel_masks, 0, sizeof(b->sel_masks));
+	msm_rpm_fill_sel_masks(b->sel_masks, b->iv, b->count);
+}
+
+/* Write out the queued requests of ctx and hand back their callbacks */
+static int msm_rpm_batch_write_locked(int ctx, uint32_t *sel_masks,
+	struct msm_rpm_batch_cb *cbs)
+{
+	struct msm_rpm_batch *b = &msm_rpm_batches[ctx];
+	int ncbs = b->ncbs;
+	int i;
+
+	for (i = 0; i < b->count; i++)
+		msm_rpm_write(MSM_RPM_PAGE_REQ,
+				target_enum(b->iv[i].id), b->iv[i].value);
+	for (i = 0; i < msm_rpm_sel_mask_size; i++)
+		sel_masks[i] |= b->sel_masks[i];
+	memcpy(cbs, b->cbs, ncbs * sizeof(*cbs));
+
+	b->count = 0;
+	b->ncbs = 0;
+	memset(b->sel_masks, 0, sizeof(b->sel_masks));
+	return ncbs;
+}
+
+static void msm_rpm_batch_done(struct msm_rpm_batch_cb *cbs, int ncbs, int rc)
+{
+	int i;
+
+	for (i = 0; i < ncbs; i++)
+		cbs[i].fn(cbs[i].data, rc);
+}
+
 static inline void msm_rpm_send_req_interrupt(void)
 {
 	__raw_writel(msm_rpm_data.ipc_rpm_val,
@@ -274,14 +384,17 @@ static void msm_rpm_busy_wait_for_request_completion(
 	} while (rc);
 }
 
-static int msm_rpm_set_exclusive(int ctx,
-	uint32_t *sel_masks, struct msm_rpm_iv_pair *req, int count)
+static int msm_rpm_set_exclusive(int ctx, uint32_t *sel_masks,
+	struct msm_rpm_iv_pair *req, int count, bool batch)
 {
 	DECLARE_COMPLETION_ONSTACK(ack);
 	unsigned long flags;
 	uint32_t ctx_mask = msm_rpm_get_ctx_mask(ctx);
 	uint32_t ctx_mask_ack = 0;
 	uint32_t sel_masks_ack[SEL_MASK_SIZE];
+	struct msm_rpm_batch_cb cbs[MSM_RPM_BATCH_CBS];
+	int ncbs = 0;
+	int rc = 0;
 	int i;
 
 	msm_rpm_request_irq_mode.req = req;
@@ -294,6 +407,19 @@ static int msm_rpm_set_exclusive(int ctx,
 	spin_lock(&msm_rpm_irq_lock);
 
 	BUG_ON(msm_rpm_request);
+
+	if (batch) {
+		bool empty = !count && !msm_rpm_batches[ctx].count;
+
+		ncbs = msm_rpm_batch_write_locked(ctx, sel_masks, cbs);
+		if (empty) {
+			spin_unlock(&msm_rpm_irq_lock);
+			spin_unlock_irqrestore(&msm_rpm_lock, flags);
+			msm_rpm_batch_done(cbs, ncbs, 0);
+			return 0;
+		}
+	}
+
 	msm_rpm_request = &msm_rpm_request_irq_mode;
 
 	for (i = 0; i < count; i++) {
@@ -311,6 +437,9 @@ static int msm_rpm_set_exclusive(int ctx,
 	/* Ensure RPM data is written before sending the interrupt */
 	mb();
 	msm_rpm_send_req_interrupt();
+	msm_rpm_msg_stats.messages++;
+	if (count)
+		msm_rpm_msg_stats.requests++;
 
 	spin_unlock(&msm_rpm_irq_lock);
 	spin_unlock_irqrestore(&msm_rpm_lock, flags);
@@ -325,14 +454,15 @@ static int msm_rpm_set_exclusive(int ctx,
 		pr_warn("[K] %s: following request is rejected by rpm\n", __func__);
 		for (i = 0; i < count; i++)
 				pr_warn("[K] %s: id: %d, value: %d\n", __func__, req[i].id, req[i].value);
-		return -ENOSPC;
-	} else {
-		return 0;
+		rc = -ENOSPC;
 	}
+
+	msm_rpm_batch_done(cbs, ncbs, rc);
+	return rc;
 }
 
-static int msm_rpm_set_exclusive_noirq(int ctx,
-	uint32_t *sel_masks, struct msm_rpm_iv_pair *req, int count)
+static int msm_rpm_set_exclusive_noirq(int ctx, uint32_t *sel_masks,
+	struct msm_rpm_iv_pair *req, int count, bool batch)
 {
 	unsigned int irq = msm_rpm_data.irq_ack;
 	unsigned long flags;
@@ -340,8 +470,17 @@ static int msm_rpm_set_exclusive_noirq(int ctx,
 	uint32_t ctx_mask_ack = 0;
 	uint32_t sel_masks_ack[SEL_MASK_SIZE];
 	struct irq_chip *irq_chip, *err_chip;
+	struct msm_rpm_batch_cb cbs[MSM_RPM_BATCH_CBS];
+	int ncbs = 0;
+	int rc = 0;
 	int i;
 
+	if (batch && !count && !msm_rpm_batches[ctx].count) {
+		ncbs = msm_rpm_batch_write_locked(ctx, sel_masks, cbs);
+		msm_rpm_batch_done(cbs, ncbs, 0);
+		return 0;
+	}
+
 	msm_rpm_request_poll_mode.req = req;
 	msm_rpm_request_poll_mode.count = count;
 	msm_rpm_request_poll_mode.ctx_mask_ack = &ctx_mask_ack;
@@ -368,6 +507,9 @@ static int msm_rpm_set_exclusive_noirq(int ctx,
 		BUG_ON(msm_rpm_request);
 	}
 
+	if (batch)
+		ncbs = msm_rpm_batch_write_locked(ctx, sel_masks, cbs);
+
 	msm_rpm_request = &msm_rpm_request_poll_mode;
 
 	for (i = 0; i < count; i++) {
@@ -385,6 +527,9 @@ static int msm_rpm_set_exclusive_noirq(int ctx,
 	/* Ensure RPM data is written before sending the interrupt */
 	mb();
 	msm_rpm_send_req_interrupt();
+	msm_rpm_msg_stats.messages++;
+	if (count)
+		msm_rpm_msg_stats.requests++;
 
 	msm_rpm_busy_wait_for_request_completion(false);
 	BUG_ON(msm_rpm_request);
@@ -401,10 +546,11 @@ static int msm_rpm_set_exclusive_noirq(int ctx,
 		pr_warn("[K] %s: following request is rejected by rpm\n", __func__);
 		for (i = 0; i < count; i++)
 				pr_warn("[K] %s: id: %d, value: %d\n", __func__, req[i].id, req[i].value);
-		return -ENOSPC;
-	} else {
-		return 0;
+		rc = -ENOSPC;
 	}
+
+	msm_rpm_batch_done(cbs, ncbs, rc);
+	return rc;
 }
 
 static int msm_rpm_set_common(
@@ -426,11 +572,12 @@ static int msm_rpm_set_common(
 		unsigned long flags;
 
 		spin_lock_irqsave(&msm_rpm_lock, flags);
-		rc = msm_rpm_set_exclusive_noirq(ctx, sel_masks, req, count);
+		rc = msm_rpm_set_exclusive_noirq(ctx, sel_masks, req, count,
+			true);
 		spin_unlock_irqrestore(&msm_rpm_lock, flags);
 	} else {
 		mutex_lock(&msm_rpm_mutex);
-		rc = msm_rpm_set_exclusive(ctx, sel_masks, req, count);
+		rc = msm_rpm_set_exclusive(ctx, sel_masks, req, count, true);
 		mutex_unlock(&msm_rpm_mutex);
 	}
 
@@ -443,6 +590,7 @@ static int msm_rpm_clear_common(
 {
 	uint32_t sel_masks[SEL_MASK_SIZE] = {};
 	struct msm_rpm_iv_pair r[SEL_MASK_SIZE];
+	unsigned long flags;
 	int rc;
 	int i;
 
@@ -455,6 +603,10 @@ static int msm_rpm_clear_common(
 	if (rc)
 		goto clear_common_exit;
 
+	spin_lock_irqsave(&msm_rpm_lock, flags);
+	msm_rpm_batch_drop_locked(&msm_rpm_batches[ctx], req, count);
+	spin_unlock_irqrestore(&msm_rpm_lock, flags);
+
 	for (i = 0; i < ARRAY_SIZE(r); i++) {
 		r[i].id = MSM_RPM_ID_INVALIDATE_0 + i;
 		r[i].value = sel_masks[i];
@@ -465,16 +617,15 @@ static int msm_rpm_clear_common(
 		msm_rpm_get_sel_mask(msm_rpm_data.sel_invalidate);
 
 	if (noirq) {
-		unsigned long flags;
-
 		spin_lock_irqsave(&msm_rpm_lock, flags);
 		rc = msm_rpm_set_exclusive_noirq(ctx, sel_masks, r,
-			ARRAY_SIZE(r));
+			ARRAY_SIZE(r), false);
 		spin_unlock_irqrestore(&msm_rpm_lock, flags);
 		BUG_ON(rc);
 	} else {
 		mutex_lock(&msm_rpm_mutex);
-		rc = msm_rpm_set_exclusive(ctx, sel_masks, r, ARRAY_SIZE(r));
+		rc = msm_rpm_set_exclusive(ctx, sel_masks, r, ARRAY_SIZE(r),
+			false);
 		mutex_unlock(&msm_rpm_mutex);
 		BUG_ON(rc);
 	}
@@ -496,8 +647,8 @@ static void msm_rpm_update_notification(uint32_t ctx,
 		sel_masks[msm_rpm_get_sel_mask_reg(sel_notif)]
 			|= msm_rpm_get_sel_mask(sel_notif);
 
-		rc = msm_rpm_set_exclusive(ctx,
-			sel_masks, new_cfg->iv, ARRAY_SIZE(new_cfg->iv));
+		rc = msm_rpm_set_exclusive(ctx, sel_masks, new_cfg->iv,
+			ARRAY_SIZE(new_cfg->iv), false);
 		BUG_ON(rc);
 
 		memcpy(curr_cfg, new_cfg, sizeof(*new_cfg));
@@ -547,7 +698,9 @@ int msm_rpm_local_request_is_outstanding(void)
 	if (!spin_trylock(&msm_rpm_irq_lock))
 		goto local_request_is_outstanding_unlock;
 
-	outstanding = (msm_rpm_request != NULL);
+	outstanding = (msm_rpm_request != NULL) ||
+		msm_rpm_batches[MSM_RPM_CTX_SET_0].count ||
+		msm_rpm_batches[MSM_RPM_CTX_SET_SLEEP].count;
 	spin_unlock(&msm_rpm_irq_lock);
 
 local_request_is_outstanding_unlock:
@@ -614,6 +767,61 @@ int msm_rpm_set_noirq(int ctx, struct msm_rpm_iv_pair *req, int count)
 }
 EXPORT_SYMBOL(msm_rpm_set_noirq);
 
+int msm_rpm_set_async(int ctx, struct msm_rpm_iv_pair *req, int count,
+	void (*done)(void *data, int rc), void *data)
+{
+	uint32_t sel_masks[SEL_MASK_SIZE] = {};
+	unsigned long flags;
+	bool queued;
+	int rc;
+
+	if (ctx >= MSM_RPM_CTX_SET_COUNT)
+		return -EINVAL;
+
+	rc = msm_rpm_fill_sel_masks(sel_masks, req, count);
+	if (rc)
+		return rc;
+
+	spin_lock_irqsave(&msm_rpm_lock, flags);
+	queued = msm_rpm_batch_add_locked(&msm_rpm_batches[ctx], sel_masks,
+		req, count, done, data);
+	if (queued) {
+		msm_rpm_msg_stats.requests++;
+		msm_rpm_msg_stats.async_requests++;
+	}
+	spin_unlock_irqrestore(&msm_rpm_lock, flags);
+
+	if (queued) {
+		schedule_work(&msm_rpm_batch_work);
+		return 0;
+	}
+
+	/* Batch is full: this request takes it out now */
+	rc = msm_rpm_set_nosleep(ctx, req, count);
+	if (done)
+		done(data, rc);
+	return rc;
+}
+EXPORT_SYMBOL(msm_rpm_set_async);
+
+static void msm_rpm_batch_fn(struct work_struct *work)
+{
+	int ctx;
+
+	for (ctx = 0; ctx < MSM_RPM_CTX_SET_COUNT; ctx++)
+		msm_rpm_set_common(ctx, NULL, 0, false);
+}
+
+void msm_rpm_get_msg_stats(struct msm_rpm_msg_stats *stats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_rpm_lock, flags);
+	*stats = msm_rpm_msg_stats;
+	spin_unlock_irqrestore(&msm_rpm_lock, flags);
+}
+EXPORT_SYMBOL(msm_rpm_get_msg_stats);
+
 int msm_rpm_clear(int ctx, struct msm_rpm_iv_pair *req, int count)
 {
 	return msm_rpm_clear_common(ctx, req, count, false);
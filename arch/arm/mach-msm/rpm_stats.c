@@ -22,9 +22,11 @@
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/mm.h>
+#include <linux/seq_file.h>
 #include <asm/uaccess.h>
 
 #include <mach/msm_iomap.h>
+#include <mach/rpm.h>
 #include "rpm_stats.h"
 
 enum {
@@ -194,6 +196,34 @@ static const struct file_operations msm_rpmstats_fops = {
 	.llseek   = no_llseek,
 };
 
+static struct dentry *msm_rpm_msg_stats_dent;
+
+static int msm_rpm_msg_stats_show(struct seq_file *m, void *unused)
+{
+	struct msm_rpm_msg_stats stats;
+
+	msm_rpm_get_msg_stats(&stats);
+	seq_printf(m, "requests: %lu\nasync requests: %lu\nmessages: %lu\n"
+		"round-trips saved: %lu\n", stats.requests,
+		stats.async_requests, stats.messages,
+		stats.requests > stats.messages ?
+			stats.requests - stats.messages : 0);
+	return 0;
+}
+
+static int msm_rpm_msg_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msm_rpm_msg_stats_show, NULL);
+}
+
+static const struct file_operations msm_rpm_msg_stats_fops = {
+	.owner	  = THIS_MODULE,
+	.open	  = msm_rpm_msg_stats_open,
+	.read	  = seq_read,
+	.llseek   = seq_lseek,
+	.release  = single_release,
+};
+
 static  int __devinit msm_rpmstats_probe(struct platform_device *pdev)
 {
 	struct dentry *dent;
@@ -210,6 +240,9 @@ static  int __devinit msm_rpmstats_probe(struct platform_device *pdev)
 		return -ENOMEM;
 	}
 	platform_set_drvdata(pdev, dent);
+
+	msm_rpm_msg_stats_dent = debugfs_create_file("rpm_msg_stats", S_IRUGO,
+			NULL, NULL, &msm_rpm_msg_stats_fops);
 	return 0;
 }
 
@@ -217,6 +250,7 @@ static int __devexit msm_rpmstats_remove(struct platform_device *pdev)
 {
 	struct dentry *dent;
 
+	debugfs_remove(msm_rpm_msg_stats_dent);
 	dent = platform_get_drvdata(pdev);
 	debugfs_remove(dent);
 	platform_set_drvdata(pdev, NULL);
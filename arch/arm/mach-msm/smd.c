@@ -35,6 +35,8 @@
 #include <linux/wakelock.h>
 #include <linux/notifier.h>
 #include <linux/sort.h>
+#include <linux/hrtimer.h>
+#include <linux/uio.h>
 #include <mach/msm_smd.h>
 #include <mach/msm_iomap.h>
 #include <mach/system.h>
@@ -721,6 +723,10 @@ struct smd_channel {
 	char is_pkt_ch;
 
 	struct smd_half_channel_access *half_ch;
+
+	/* write interrupt coalescing, see smd_set_signal_delay() */
+	struct hrtimer signal_timer;
+	unsigned signal_delay_us;
 };
 
 struct edge_to_pid {
@@ -1137,6 +1143,47 @@ static void ch_write_done(struct smd_channel *ch, unsigned count)
 	ch->half_ch->set_fHEAD(ch->send, 1);
 }
 
+static struct interrupt_stat *ch_interrupt_stats(struct smd_channel *ch)
+{
+	if (ch->type >= ARRAY_SIZE(edge_to_pids))
+		return NULL;
+	return &interrupt_stats[edge_to_pids[ch->type].remote_pid];
+}
+
+static enum hrtimer_restart smd_signal_timer_func(struct hrtimer *timer)
+{
+	struct smd_channel *ch = container_of(timer, struct smd_channel,
+						signal_timer);
+
+	ch->notify_other_cpu();
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Tell the remote side new data was written.  With a signal delay set the
+ * interrupt is held back until the delay runs out, so writes within that
+ * window share one interrupt, unless the fifo is more than half full.
+ */
+static void ch_signal_write(struct smd_channel *ch)
+{
+	struct interrupt_stat *stats;
+
+	if (!ch->signal_delay_us ||
+	    smd_stream_write_avail(ch) < ch->fifo_size / 2) {
+		hrtimer_try_to_cancel(&ch->signal_timer);
+		ch->notify_other_cpu();
+		return;
+	}
+
+	stats = ch_interrupt_stats(ch);
+	if (stats)
+		++stats->smd_out_coalesced_count;
+	if (!hrtimer_active(&ch->signal_timer))
+		hrtimer_start(&ch->signal_timer,
+			ns_to_ktime(ch->signal_delay_us * NSEC_PER_USEC),
+			HRTIMER_MODE_REL);
+}
+
 static void ch_set_state(struct smd_channel *ch, unsigned n)
 {
 	if (n == SMD_SS_OPENED) {
@@ -1409,7 +1456,7 @@ static int smd_is_packet(struct smd_alloc_elm *alloc_elm)
 		return 0;
 }
 
-static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
+static int __smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 				int user_buf)
 {
 	void *ptr;
@@ -1449,13 +1496,20 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 			break;
 	}
 
-	if (orig_len - len)
-		ch->notify_other_cpu();
-
 	return orig_len - len;
 }
 
-static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
+static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
+				int user_buf)
+{
+	int r = __smd_stream_write(ch, _data, len, user_buf);
+
+	if (r > 0)
+		ch_signal_write(ch);
+	return r;
+}
+
+static int __smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 				int user_buf)
 {
 	int ret;
@@ -1474,7 +1528,7 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
 
-	ret = smd_stream_write(ch, hdr, sizeof(hdr), 0);
+	ret = __smd_stream_write(ch, hdr, sizeof(hdr), 0);
 	if (ret < 0 || ret != sizeof(hdr)) {
 		SMD_DBG("%s failed to write pkt header: "
 			"%d returned\n", __func__, ret);
@@ -1482,16 +1536,28 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	}
 
 
-	ret = smd_stream_write(ch, _data, len, user_buf);
+	ret = __smd_stream_write(ch, _data, len, user_buf);
 	if (ret < 0 || ret != len) {
 		SMD_DBG("%s failed to write pkt data: "
 			"%d returned\n", __func__, ret);
+		ch_signal_write(ch);
 		return ret;
 	}
 
 	return len;
 }
 
+/* Header and payload go out with a single interrupt */
+static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
+				int user_buf)
+{
+	int r = __smd_packet_write(ch, _data, len, user_buf);
+
+	if (r > 0)
+		ch_signal_write(ch);
+	return r;
+}
+
 static int smd_stream_read(smd_channel_t *ch, void *data, int len, int user_buf)
 {
 	int r;
@@ -1649,6 +1715,8 @@ static int smd_alloc_channel(struct smd_alloc_elm *alloc_elm)
 	}
 
 	ch->fifo_mask = ch->fifo_size - 1;
+	hrtimer_init(&ch->signal_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ch->signal_timer.function = smd_signal_timer_func;
 
 	
 	if (ch->type == SMD_APPS_MODEM)
@@ -1734,6 +1802,8 @@ static int smd_alloc_loopback_channel(void)
 	ch->fifo_mask = ch->fifo_size - 1;
 	ch->type = SMD_LOOPBACK_TYPE;
 	ch->notify_other_cpu = notify_loopback_smd;
+	hrtimer_init(&ch->signal_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ch->signal_timer.function = smd_signal_timer_func;
 
 	ch->read = smd_stream_read;
 	ch->write = smd_stream_write;
@@ -1905,6 +1975,9 @@ int smd_close(smd_channel_t *ch)
 
 	SMD_INFO("smd_close(%s)\n", ch->name);
 
+	ch->signal_delay_us = 0;
+	hrtimer_cancel(&ch->signal_timer);
+
 	spin_lock_irqsave(&smd_lock, flags);
 	list_del(&ch->ch_list);
 	if (ch->n == SMD_LOOPBACK_CID) {
@@ -2077,6 +2150,95 @@ int smd_write_user_buffer(smd_channel_t *ch, const void *data, int len)
 }
 EXPORT_SYMBOL(smd_write_user_buffer);
 
+int smd_writev(smd_channel_t *ch, const struct kvec *vec, int cnt)
+{
+	struct interrupt_stat *stats;
+	int i, r = 0, total = 0;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (ch->pending_pkt_sz)
+		return -EBUSY;
+
+	for (i = 0; i < cnt; i++) {
+		if (ch->is_pkt_ch)
+			r = __smd_packet_write(ch, vec[i].iov_base,
+						vec[i].iov_len, 0);
+		else
+			r = __smd_stream_write(ch, vec[i].iov_base,
+						vec[i].iov_len, 0);
+		if (r <= 0)
+			break;
+		total += r;
+		if (r < vec[i].iov_len)
+			break;
+	}
+
+	if (total) {
+		stats = ch_interrupt_stats(ch);
+		if (stats)
+			++stats->smd_out_batch_count;
+		ch_signal_write(ch);
+		return total;
+	}
+	return r;
+}
+EXPORT_SYMBOL(smd_writev);
+
+int smd_readv(smd_channel_t *ch, struct kvec *vec, int cnt)
+{
+	unsigned long flags;
+	int i, r, len;
+
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+	if (!ch->is_pkt_ch) {
+		pr_err("%s: non-packet channel specified\n", __func__);
+		return -EACCES;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		len = ch->current_packet;
+		if (!len || len > vec[i].iov_len ||
+		    smd_stream_read_avail(ch) < len)
+			break;
+
+		r = ch_read(ch, vec[i].iov_base, len, 0);
+		vec[i].iov_len = r;
+
+		spin_lock_irqsave(&smd_lock, flags);
+		ch->current_packet -= r;
+		update_packet_state(ch);
+		spin_unlock_irqrestore(&smd_lock, flags);
+	}
+
+	if (i && !read_intr_blocked(ch))
+		ch->notify_other_cpu();
+
+	if (!i && cnt && ch->current_packet > vec[0].iov_len)
+		return -ETOOSMALL;
+	return i;
+}
+EXPORT_SYMBOL(smd_readv);
+
+int smd_set_signal_delay(smd_channel_t *ch, unsigned usecs)
+{
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	ch->signal_delay_us = usecs;
+	if (!usecs && hrtimer_try_to_cancel(&ch->signal_timer) > 0)
+		ch->notify_other_cpu();
+	return 0;
+}
+EXPORT_SYMBOL(smd_set_signal_delay);
+
 int smd_read_avail(smd_channel_t *ch)
 {
 	if (!ch) {
@@ -2088,6 +2250,17 @@ int smd_read_avail(smd_channel_t *ch)
 }
 EXPORT_SYMBOL(smd_read_avail);
 
+int smd_read_pending(smd_channel_t *ch)
+{
+	if (!ch) {
+		pr_err("%s: Invalid channel specified\n", __func__);
+		return -ENODEV;
+	}
+
+	return smd_stream_read_avail(ch);
+}
+EXPORT_SYMBOL(smd_read_pending);
+
 int smd_write_avail(smd_channel_t *ch)
 {
 	if (!ch) {
@@ -104,20 +104,24 @@ static int debug_int_stats(char *buf, int max)
 
 	i += scnprintf(buf + i, max - i,
 		"   Subsystem    |     In    | Out (Hardcoded) |"
-		" Out (Configured) |\n");
+		" Out (Configured) | Coalesced |  Batched  |\n");
 
 	for (subsys = 0; subsys < NUM_SMD_SUBSYSTEMS; ++subsys) {
 		subsys_name = smd_pid_to_subsystem(subsys);
 		if (subsys_name) {
 			i += scnprintf(buf + i, max - i,
-				"%-10s %4s | %9u |       %9u |        %9u |\n",
+				"%-10s %4s | %9u |       %9u |        %9u |"
+				" %9u | %9u |\n",
 				smd_pid_to_subsystem(subsys), "smd",
 				stats->smd_in_count,
 				stats->smd_out_hardcode_count,
-				stats->smd_out_config_count);
+				stats->smd_out_config_count,
+				stats->smd_out_coalesced_count,
+				stats->smd_out_batch_count);
 
 			i += scnprintf(buf + i, max - i,
-				"%-10s %4s | %9u |       %9u |        %9u |\n",
+				"%-10s %4s | %9u |       %9u |        %9u |"
+				"           |           |\n",
 				smd_pid_to_subsystem(subsys), "smsm",
 				stats->smsm_in_count,
 				stats->smsm_out_hardcode_count,
@@ -141,6 +145,8 @@ static int debug_int_stats_reset(char *buf, int max)
 		stats->smd_in_count = 0;
 		stats->smd_out_hardcode_count = 0;
 		stats->smd_out_config_count = 0;
+		stats->smd_out_coalesced_count = 0;
+		stats->smd_out_batch_count = 0;
 		stats->smsm_in_count = 0;
 		stats->smsm_out_hardcode_count = 0;
 		stats->smsm_out_config_count = 0;
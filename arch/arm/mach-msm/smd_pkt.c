@@ -28,6 +28,7 @@
 #include <linux/poll.h>
 #include <asm/ioctls.h>
 #include <linux/wakelock.h>
+#include <linux/timer.h>
 
 #include <mach/msm_smd.h>
 #include <mach/peripheral-loader.h>
@@ -111,6 +112,10 @@ struct smd_pkt_dev {
 	struct work_struct packet_arrival_work;
 	struct spinlock pa_spinlock;
 	int wakelock_locked;
+
+	unsigned wake_bytes;
+	unsigned wake_latency_ms;
+	struct timer_list wake_timer;
 } *smd_pkt_devp[NUM_SMD_PKT_PORTS];
 
 struct class *smd_pkt_classp;
@@ -304,6 +309,22 @@ static long smd_pkt_ioctl(struct file *file, unsigned int cmd,
 	case SMD_PKT_IOCTL_BLOCKING_WRITE:
 		ret = get_user(smd_pkt_devp->blocking_write, (int *)arg);
 		break;
+	case SMD_PKT_IOCTL_WAKE_WATERMARK: {
+		struct smd_pkt_wake_watermark wm;
+
+		if (copy_from_user(&wm, (void __user *)arg, sizeof(wm))) {
+			ret = -EFAULT;
+			break;
+		}
+		if (wm.bytes && !wm.latency_ms) {
+			ret = -EINVAL;
+			break;
+		}
+		smd_pkt_devp->wake_latency_ms = wm.latency_ms;
+		smd_pkt_devp->wake_bytes = wm.bytes;
+		ret = 0;
+		break;
+	}
 	default:
 		pr_err("%s: Unrecognized ioctl command %d\n", __func__, cmd);
 		ret = -1;
@@ -575,6 +596,18 @@ static unsigned int smd_pkt_poll(struct file *file, poll_table *wait)
 	return mask;
 }
 
+static void wakeup_reader(struct smd_pkt_dev *smd_pkt_devp)
+{
+	wake_up(&smd_pkt_devp->ch_read_wait_queue);
+	schedule_work(&smd_pkt_devp->packet_arrival_work);
+	D_READ("%s: wake_up smd_pkt_dev id:%d\n", __func__, smd_pkt_devp->i);
+}
+
+static void wake_timer_func(unsigned long data)
+{
+	wakeup_reader((struct smd_pkt_dev *)data);
+}
+
 static void check_and_wakeup_reader(struct smd_pkt_dev *smd_pkt_devp)
 {
 	int sz;
@@ -609,9 +642,17 @@ static void check_and_wakeup_reader(struct smd_pkt_dev *smd_pkt_devp)
 	wake_lock(&smd_pkt_devp->pa_wake_lock);
 	smd_pkt_devp->wakelock_locked = 1;
 	spin_unlock_irqrestore(&smd_pkt_devp->pa_spinlock, flags);
-	wake_up(&smd_pkt_devp->ch_read_wait_queue);
-	schedule_work(&smd_pkt_devp->packet_arrival_work);
-	D_READ("%s: wake_up smd_pkt_dev id:%d\n", __func__, smd_pkt_devp->i);
+
+	/* Below the watermark the reader is woken by the latency timer */
+	if (smd_pkt_devp->wake_bytes &&
+	    smd_read_pending(smd_pkt_devp->ch) < smd_pkt_devp->wake_bytes) {
+		if (!timer_pending(&smd_pkt_devp->wake_timer))
+			mod_timer(&smd_pkt_devp->wake_timer, jiffies +
+				msecs_to_jiffies(smd_pkt_devp->wake_latency_ms));
+		return;
+	}
+	del_timer(&smd_pkt_devp->wake_timer);
+	wakeup_reader(smd_pkt_devp);
 }
 
 static void check_and_wakeup_writer(struct smd_pkt_dev *smd_pkt_devp)
@@ -926,6 +967,9 @@ int smd_pkt_release(struct inode *inode, struct file *file)
 
 	clean_and_signal(smd_pkt_devp);
 
+	smd_pkt_devp->wake_bytes = 0;
+	del_timer_sync(&smd_pkt_devp->wake_timer);
+
 	mutex_lock(&smd_pkt_devp->ch_lock);
 	mutex_lock(&smd_pkt_devp->rx_lock);
 	mutex_lock(&smd_pkt_devp->tx_lock);
@@ -1003,6 +1047,8 @@ static int __init smd_pkt_init(void)
 		smd_pkt_devp[i]->poll_mode = 0;
 		smd_pkt_devp[i]->wakelock_locked = 0;
 		init_waitqueue_head(&smd_pkt_devp[i]->ch_opened_wait_queue);
+		setup_timer(&smd_pkt_devp[i]->wake_timer, wake_timer_func,
+			    (unsigned long)smd_pkt_devp[i]);
 
 		spin_lock_init(&smd_pkt_devp[i]->pa_spinlock);
 		mutex_init(&smd_pkt_devp[i]->ch_lock);
@@ -249,6 +249,8 @@ struct interrupt_stat {
 	uint32_t smd_in_count;
 	uint32_t smd_out_hardcode_count;
 	uint32_t smd_out_config_count;
+	uint32_t smd_out_coalesced_count;
+	uint32_t smd_out_batch_count;
 
 	uint32_t smsm_in_count;
 	uint32_t smsm_out_hardcode_count;
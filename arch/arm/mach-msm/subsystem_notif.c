@@ -26,6 +26,8 @@
 #include <linux/stringify.h>
 #include <linux/delay.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include <mach/subsystem_notif.h>
 
@@ -33,12 +35,90 @@ struct subsys_notif_info {
 	char name[50];
 	struct srcu_notifier_head subsys_notif_rcvr_list;
 	struct list_head list;
+	/* When each notification of the last restart went out, and how
+	 * long its notifier chain ran */
+	ktime_t stamp[SUBSYS_NOTIF_TYPE_COUNT];
+	unsigned int chain_us[SUBSYS_NOTIF_TYPE_COUNT];
+	unsigned int restarts;
 };
 
 static LIST_HEAD(subsystem_list);
 static DEFINE_MUTEX(notif_lock);
 static DEFINE_MUTEX(notif_add_lock);
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *subsys_notif_dir;
+
+static const char * const notif_names[SUBSYS_NOTIF_TYPE_COUNT] = {
+	[SUBSYS_BEFORE_SHUTDOWN] = "before_shutdown",
+	[SUBSYS_AFTER_SHUTDOWN]  = "after_shutdown",
+	[SUBSYS_BEFORE_POWERUP]  = "before_powerup",
+	[SUBSYS_AFTER_POWERUP]   = "after_powerup",
+};
+
+/* From the end of the notifier chain for @from to the start of @to */
+static s64 subsys_phase_us(struct subsys_notif_info *subsys,
+			   enum subsys_notif_type from,
+			   enum subsys_notif_type to)
+{
+	return ktime_us_delta(subsys->stamp[to], subsys->stamp[from]) -
+		subsys->chain_us[from];
+}
+
+static int subsys_timing_show(struct seq_file *m, void *unused)
+{
+	struct subsys_notif_info *subsys = m->private;
+	int i;
+
+	seq_printf(m, "restarts: %u\n", subsys->restarts);
+	if (!subsys->restarts ||
+	    ktime_to_ns(subsys->stamp[SUBSYS_AFTER_POWERUP]) <
+	    ktime_to_ns(subsys->stamp[SUBSYS_BEFORE_SHUTDOWN]))
+		return 0;
+
+	seq_printf(m, "shutdown: %lld us\n", subsys_phase_us(subsys,
+		   SUBSYS_BEFORE_SHUTDOWN, SUBSYS_AFTER_SHUTDOWN));
+	seq_printf(m, "ramdump: %lld us\n", subsys_phase_us(subsys,
+		   SUBSYS_AFTER_SHUTDOWN, SUBSYS_BEFORE_POWERUP));
+	seq_printf(m, "powerup: %lld us\n", subsys_phase_us(subsys,
+		   SUBSYS_BEFORE_POWERUP, SUBSYS_AFTER_POWERUP));
+	for (i = 0; i < SUBSYS_NOTIF_TYPE_COUNT; i++)
+		seq_printf(m, "%s notifiers: %u us\n", notif_names[i],
+			   subsys->chain_us[i]);
+	seq_printf(m, "total: %lld us\n",
+		   ktime_us_delta(subsys->stamp[SUBSYS_AFTER_POWERUP],
+				  subsys->stamp[SUBSYS_BEFORE_SHUTDOWN]) +
+		   subsys->chain_us[SUBSYS_AFTER_POWERUP]);
+	return 0;
+}
+
+static int subsys_timing_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, subsys_timing_show, inode->i_private);
+}
+
+static const struct file_operations subsys_timing_fops = {
+	.open		= subsys_timing_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void subsys_notif_debugfs_add(struct subsys_notif_info *subsys)
+{
+	if (!subsys_notif_dir)
+		subsys_notif_dir = debugfs_create_dir("subsys_notif", NULL);
+	if (IS_ERR_OR_NULL(subsys_notif_dir))
+		return;
+	debugfs_create_file(subsys->name, S_IRUGO, subsys_notif_dir, subsys,
+			    &subsys_timing_fops);
+}
+#else
+static void subsys_notif_debugfs_add(struct subsys_notif_info *subsys)
+{
+}
+#endif
+
 #if defined(SUBSYS_RESTART_DEBUG)
 static void subsys_notif_reg_test_notifier(const char *);
 #endif
@@ -118,7 +198,7 @@ void *subsys_notif_add_subsys(const char *subsys_name)
 		goto done;
 	}
 
-	subsys = kmalloc(sizeof(struct subsys_notif_info), GFP_KERNEL);
+	subsys = kzalloc(sizeof(struct subsys_notif_info), GFP_KERNEL);
 
 	if (!subsys) {
 		mutex_unlock(&notif_add_lock);
@@ -135,6 +215,8 @@ void *subsys_notif_add_subsys(const char *subsys_name)
 	list_add_tail(&subsys->list, &subsystem_list);
 	mutex_unlock(&notif_lock);
 
+	subsys_notif_debugfs_add(subsys);
+
 	#if defined(SUBSYS_RESTART_DEBUG)
 	subsys_notif_reg_test_notifier(subsys->name);
 	#endif
@@ -152,6 +234,7 @@ int subsys_notif_queue_notification(void *subsys_handle,
 	int ret = 0;
 	struct subsys_notif_info *subsys =
 		(struct subsys_notif_info *) subsys_handle;
+	ktime_t start;
 
 	if (!subsys)
 		return -EINVAL;
@@ -159,10 +242,16 @@ int subsys_notif_queue_notification(void *subsys_handle,
 	if (notif_type < 0 || notif_type >= SUBSYS_NOTIF_TYPE_COUNT)
 		return -EINVAL;
 
+	start = ktime_get();
+	if (notif_type == SUBSYS_BEFORE_SHUTDOWN)
+		subsys->restarts++;
+
 	ret = srcu_notifier_call_chain(
 		&subsys->subsys_notif_rcvr_list, notif_type,
 		(void *)subsys);
 
+	subsys->chain_us[notif_type] = ktime_us_delta(ktime_get(), start);
+	subsys->stamp[notif_type] = start;
 	return ret;
 }
 EXPORT_SYMBOL(subsys_notif_queue_notification);
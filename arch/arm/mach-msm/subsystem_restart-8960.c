@@ -100,6 +100,13 @@ struct restart_log {
 	struct list_head list;
 };
 
+struct powerup_work {
+	struct work_struct work;
+	struct subsys_data *subsys;
+	struct subsys_data *crashed;
+	int ret;
+};
+
 static int restart_level;
 static int enable_ramdumps;
 struct workqueue_struct *ssr_wq;
@@ -290,6 +297,10 @@ static void _send_notification_to_order(struct subsys_data
 static int max_restarts;
 module_param(max_restarts, int, 0644);
 
+/* Every subsystem of a restart order loads its image at the same time */
+static int parallel_powerup = 1;
+module_param(parallel_powerup, int, 0644);
+
 static long max_history_time = 3600;
 module_param(max_history_time, long, 0644);
 
@@ -351,6 +362,58 @@ out:
 	mutex_unlock(&restart_log_mutex);
 }
 
+static void subsystem_powerup_work(struct work_struct *work)
+{
+	struct powerup_work *pw = container_of(work, struct powerup_work,
+						work);
+
+	pr_info("[%p]: Powering up %s\n", current, pw->subsys->name);
+	pw->ret = pw->subsys->powerup(pw->crashed);
+}
+
+static void subsystem_powerup_order(struct subsys_data **restart_list,
+				    int count, struct subsys_data *crashed)
+{
+	struct powerup_work *pw = NULL;
+	int i;
+
+	if (parallel_powerup && count > 1)
+		pw = kcalloc(count, sizeof(*pw), GFP_KERNEL);
+
+	for (i = count - 1; i >= 0; i--) {
+		if (!restart_list[i])
+			continue;
+
+		if (pw) {
+			pw[i].subsys = restart_list[i];
+			pw[i].crashed = crashed;
+			INIT_WORK(&pw[i].work, subsystem_powerup_work);
+			queue_work(ssr_wq, &pw[i].work);
+			continue;
+		}
+
+		pr_info("[%p]: Powering up %s\n", current,
+					restart_list[i]->name);
+
+		if (restart_list[i]->powerup(crashed) < 0)
+			panic("%s[%p]: Failed to powerup %s!", __func__,
+				current, restart_list[i]->name);
+	}
+
+	if (!pw)
+		return;
+
+	for (i = count - 1; i >= 0; i--) {
+		if (!pw[i].subsys)
+			continue;
+		flush_work(&pw[i].work);
+		if (pw[i].ret < 0)
+			panic("%s[%p]: Failed to powerup %s!", __func__,
+				current, pw[i].subsys->name);
+	}
+	kfree(pw);
+}
+
 static void subsystem_restart_wq_func(struct work_struct *work)
 {
 	struct restart_wq_data *r_work = container_of(work,
@@ -421,7 +484,7 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 	mutex_unlock(shutdown_lock);
 
 	
-	for (i = 0; i < restart_list_count; i++) {
+	for (i = 0; enable_ramdumps && i < restart_list_count; i++) {
 		if (!restart_list[i])
 			continue;
 
@@ -436,18 +499,7 @@ static void subsystem_restart_wq_func(struct work_struct *work)
 			restart_list_count,
 			SUBSYS_BEFORE_POWERUP);
 
-	for (i = restart_list_count - 1; i >= 0; i--) {
-
-		if (!restart_list[i])
-			continue;
-
-		pr_info("[%p]: Powering up %s\n", current,
-					restart_list[i]->name);
-
-		if (restart_list[i]->powerup(subsys) < 0)
-			panic("%s[%p]: Failed to powerup %s!", __func__,
-				current, restart_list[i]->name);
-	}
+	subsystem_powerup_order(restart_list, restart_list_count, subsys);
 
 	_send_notification_to_order(restart_list,
 				restart_list_count,
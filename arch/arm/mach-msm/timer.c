@@ -29,6 +29,7 @@
 #include <asm/hardware/gic.h>
 #include <asm/sched_clock.h>
 #include <asm/smp_plat.h>
+#include <asm/vdso.h>
 #include <mach/msm_iomap.h>
 #include <mach/irqs.h>
 #include <mach/socinfo.h>
@@ -264,6 +265,27 @@ static cycle_t msm_dgt_read(struct clocksource *cs)
 		clock_state->sleep_offset) >> clock->shift;
 }
 
+#ifdef CONFIG_VDSO
+static void msm_timer_vdso_update(struct msm_clock *clock,
+				  struct msm_clock_percpu_data *clock_state)
+{
+	struct clocksource *cs = &clock->clocksource;
+
+	if (clock != &msm_clocks[MSM_CLOCK_DGT] || !cs->archdata.vdso_phys ||
+	    clock_state != &per_cpu(msm_clocks_percpu, 0)[MSM_CLOCK_DGT])
+		return;
+
+	cs->archdata.vdso_bias = clock_state->sleep_offset;
+	cs->archdata.vdso_stopped = clock_state->stopped;
+	vdso_clocksource_changed(cs);
+}
+#else
+static inline void msm_timer_vdso_update(struct msm_clock *clock,
+				  struct msm_clock_percpu_data *clock_state)
+{
+}
+#endif
+
 static struct msm_clock *clockevent_to_clock(struct clock_event_device *evt)
 {
 	int i;
@@ -378,6 +400,7 @@ static void msm_timer_set_mode(enum clock_event_mode mode,
 		}
 		break;
 	}
+	msm_timer_vdso_update(clock, clock_state);
 	wmb();
 	local_irq_restore(irq_flags);
 }
@@ -639,6 +662,7 @@ static void msm_timer_sync_update(struct msm_timer_sync_data_t *data,
 		else
 			dst_clk_state->non_sleep_offset =
 				new_offset - dst_clk_state->sleep_offset;
+		msm_timer_vdso_update(dst_clk, dst_clk_state);
 
 		if (msm_timer_debug_mask & MSM_TIMER_DEBUG_SYNC)
 			printk(KERN_INFO "sync clock %s: "
@@ -746,8 +770,10 @@ int64_t msm_timer_enter_idle(void)
 		msm_timer_sync_to_gpt(clock, 0);
 
 	count = msm_read_timer_count(clock, LOCAL_TIMER);
-	if (clock_state->stopped++ == 0)
+	if (clock_state->stopped++ == 0) {
 		clock_state->stopped_tick = count + clock_state->sleep_offset;
+		msm_timer_vdso_update(clock, clock_state);
+	}
 	alarm = clock_state->alarm;
 	delta = alarm - count;
 	if (delta <= -(int32_t)((clock->freq << clock->shift) >> 10)) {
@@ -813,7 +839,8 @@ exit_idle_alarm:
 	msm_timer_reactivate_alarm(clock);
 
 exit_idle_exit:
-	clock_state->stopped--;
+	if (--clock_state->stopped == 0)
+		msm_timer_vdso_update(clock, clock_state);
 }
 
 static void msm_timer_get_sclk_time_start(
@@ -1073,6 +1100,13 @@ static void __init msm_timer_init(void)
 			gpt->flags |= MSM_CLOCK_FLAGS_UNSTABLE_COUNT;
 			dgt->flags |= MSM_CLOCK_FLAGS_UNSTABLE_COUNT;
 		}
+#ifdef CONFIG_VDSO
+		dgt->clocksource.archdata.vdso_phys = MSM8960_TMR0_PHYS;
+		dgt->clocksource.archdata.vdso_offset = 0x24 + TIMER_COUNT_VAL;
+		dgt->clocksource.archdata.vdso_shift = dgt->shift;
+		dgt->clocksource.archdata.vdso_unstable =
+			!!(dgt->flags & MSM_CLOCK_FLAGS_UNSTABLE_COUNT);
+#endif
 	} else {
 		WARN(1, "Timer running on unknown hardware. Configure this! "
 			"Assuming default configuration.\n");
@@ -1117,6 +1151,8 @@ static void __init msm_timer_init(void)
 		if (res)
 			printk(KERN_ERR "msm_timer_init: clocksource_register "
 			       "failed for %s\n", cs->name);
+		msm_timer_vdso_update(clock,
+				      &per_cpu(msm_clocks_percpu, 0)[i]);
 
 		ce->irq = clock->irq;
 		if (cpu_is_msm8x60() || cpu_is_msm8960() || cpu_is_apq8064() ||
@@ -0,0 +1,199 @@
+/*
+ * gettimeofday and clock_gettime for the vDSO
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/compiler.h>
+#include <linux/time.h>
+#include <asm/barrier.h>
+#include <asm/page.h>
+#include <asm/processor.h>
+#include <asm/unistd.h>
+#include <asm/vdso_datapage.h>
+
+extern struct vdso_data *__get_datapage(void);
+
+static notrace u32 vdso_read_begin(const struct vdso_data *vd)
+{
+	u32 seq;
+
+	while ((seq = ACCESS_ONCE(vd->seq_count)) & 1)
+		cpu_relax();
+	smp_rmb();
+	return seq;
+}
+
+static notrace int vdso_read_retry(const struct vdso_data *vd, u32 start)
+{
+	smp_rmb();
+	return ACCESS_ONCE(vd->seq_count) != start;
+}
+
+static notrace long clock_gettime_fallback(clockid_t clkid,
+					   struct timespec *ts)
+{
+	register struct timespec *ret_ts asm("r1") = ts;
+	register clockid_t ret_id asm("r0") = clkid;
+	register long ret asm("r0");
+	register long nr asm("r7") = __NR_clock_gettime;
+
+	asm volatile(
+	"	swi #0\n"
+	: "=r" (ret)
+	: "r" (ret_id), "r" (ret_ts), "r" (nr)
+	: "memory");
+
+	return ret;
+}
+
+static notrace long gettimeofday_fallback(struct timeval *tv,
+					  struct timezone *tz)
+{
+	register struct timezone *ret_tz asm("r1") = tz;
+	register struct timeval *ret_tv asm("r0") = tv;
+	register long ret asm("r0");
+	register long nr asm("r7") = __NR_gettimeofday;
+
+	asm volatile(
+	"	swi #0\n"
+	: "=r" (ret)
+	: "r" (ret_tv), "r" (ret_tz), "r" (nr)
+	: "memory");
+
+	return ret;
+}
+
+/* Same settling rule as msm_read_timer_count() for unstable counters */
+static notrace u32 vdso_read_counter(const struct vdso_data *vd)
+{
+	const volatile u32 *reg = (const volatile u32 *)
+		((const char *)vd - PAGE_SIZE + vd->cs_offset);
+	u32 t1, t2, t3;
+	int loop = 0;
+
+	if (!vd->cs_unstable)
+		return *reg;
+
+	t1 = *reg;
+	t2 = *reg;
+	if ((t2 - t1) <= 1)
+		return t2;
+	while (1) {
+		t1 = *reg;
+		t2 = *reg;
+		t3 = *reg;
+		if ((t3 - t2) <= 1)
+			return t3;
+		if ((t2 - t1) <= 1)
+			return t2;
+		if ((t2 >= t1) && (t3 >= t2))
+			return t2;
+		if (++loop == 5)
+			return t3;
+	}
+}
+
+static notrace u32 vdso_get_ns(const struct vdso_data *vd)
+{
+	u32 cycles, delta;
+
+	cycles = (vdso_read_counter(vd) + vd->cs_bias) >> vd->cs_raw_shift;
+	delta = (cycles - vd->cs_cycle_last) & vd->cs_mask;
+	return ((u64)delta * vd->cs_mult) >> vd->cs_shift;
+}
+
+static notrace void vdso_ts_add(struct timespec *ts, u32 sec, u64 nsec)
+{
+	while (nsec >= NSEC_PER_SEC) {
+		nsec -= NSEC_PER_SEC;
+		sec++;
+	}
+	ts->tv_sec = sec;
+	ts->tv_nsec = nsec;
+}
+
+static notrace int do_realtime(const struct vdso_data *vd,
+			       struct timespec *ts, int coarse)
+{
+	u32 seq, sec;
+	u64 nsec;
+
+	do {
+		seq = vdso_read_begin(vd);
+		if (!coarse && vd->use_syscall)
+			return -1;
+		sec = vd->xtime_sec;
+		nsec = vd->xtime_nsec;
+		if (!coarse)
+			nsec += vdso_get_ns(vd);
+	} while (vdso_read_retry(vd, seq));
+
+	vdso_ts_add(ts, sec, nsec);
+	return 0;
+}
+
+static notrace int do_monotonic(const struct vdso_data *vd,
+				struct timespec *ts, int coarse)
+{
+	u32 seq, sec;
+	u64 nsec;
+
+	do {
+		seq = vdso_read_begin(vd);
+		if (!coarse && vd->use_syscall)
+			return -1;
+		sec = vd->xtime_sec + vd->wtm_sec;
+		nsec = (u64)vd->xtime_nsec + vd->wtm_nsec;
+		if (!coarse)
+			nsec += vdso_get_ns(vd);
+	} while (vdso_read_retry(vd, seq));
+
+	vdso_ts_add(ts, sec, nsec);
+	return 0;
+}
+
+notrace int __vdso_clock_gettime(clockid_t clkid, struct timespec *ts)
+{
+	struct vdso_data *vd = __get_datapage();
+	int ret = -1;
+
+	switch (clkid) {
+	case CLOCK_REALTIME:
+		ret = do_realtime(vd, ts, 0);
+		break;
+	case CLOCK_REALTIME_COARSE:
+		ret = do_realtime(vd, ts, 1);
+		break;
+	case CLOCK_MONOTONIC:
+		ret = do_monotonic(vd, ts, 0);
+		break;
+	case CLOCK_MONOTONIC_COARSE:
+		ret = do_monotonic(vd, ts, 1);
+		break;
+	}
+
+	if (ret)
+		return clock_gettime_fallback(clkid, ts);
+	return 0;
+}
+
+notrace int __vdso_gettimeofday(struct timeval *tv, struct timezone *tz)
+{
+	struct vdso_data *vd = __get_datapage();
+	struct timespec ts;
+
+	if (tv) {
+		if (do_realtime(vd, &ts, 0))
+			return gettimeofday_fallback(tv, tz);
+		tv->tv_sec = ts.tv_sec;
+		tv->tv_usec = ts.tv_nsec / 1000;
+	}
+	if (tz) {
+		tz->tz_minuteswest = vd->tz_minuteswest;
+		tz->tz_dsttime = vd->tz_dsttime;
+	}
+	return 0;
+}
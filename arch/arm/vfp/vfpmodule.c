@@ -11,6 +11,7 @@
 #include <linux/types.h>
 #include <linux/cpu.h>
 #include <linux/cpu_pm.h>
+#include <linux/export.h>
 #include <linux/hardirq.h>
 #include <linux/kernel.h>
 #include <linux/notifier.h>
@@ -438,6 +439,74 @@ int vfp_restore_user_hwstate(struct user_vfp __user *ufp,
 	return err ? -EFAULT : 0;
 }
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+/*
+ * Kernel mode NEON runs with preemption disabled and outside of interrupt
+ * context, so the registers it uses never need saving on its behalf.  Any
+ * user state still live in the unit is saved first and reloaded lazily.
+ */
+void kernel_neon_begin(void)
+{
+	struct thread_info *thread = current_thread_info();
+	unsigned int cpu;
+	u32 fpexc;
+
+	BUG_ON(in_interrupt());
+	cpu = get_cpu();
+
+	fpexc = fmrx(FPEXC) | FPEXC_EN;
+	fmxr(FPEXC, fpexc);
+
+	if (vfp_state_in_hw(cpu, thread))
+		vfp_save_state(&thread->vfpstate, fpexc);
+#ifndef CONFIG_SMP
+	else if (vfp_current_hw_state[cpu] != NULL)
+		vfp_save_state(vfp_current_hw_state[cpu], fpexc);
+#endif
+	vfp_current_hw_state[cpu] = NULL;
+}
+EXPORT_SYMBOL(kernel_neon_begin);
+
+/*
+ * As kernel_neon_begin(), but only when no live state would have to be
+ * saved now and faulted back in later.  For short jobs that lose more
+ * to the save and reload trap than NEON buys them.  Returns true if the
+ * unit was claimed, in which case kernel_neon_end() must follow.
+ */
+bool kernel_neon_try_begin(void)
+{
+	struct thread_info *thread = current_thread_info();
+	unsigned int cpu;
+
+	if (in_interrupt())
+		return false;
+	cpu = get_cpu();
+
+#ifdef CONFIG_SMP
+	if (vfp_state_in_hw(cpu, thread)) {
+#else
+	if (vfp_current_hw_state[cpu] != NULL) {
+#endif
+		put_cpu();
+		return false;
+	}
+
+	fmxr(FPEXC, fmrx(FPEXC) | FPEXC_EN);
+	vfp_current_hw_state[cpu] = NULL;
+	return true;
+}
+EXPORT_SYMBOL(kernel_neon_try_begin);
+
+void kernel_neon_end(void)
+{
+	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	put_cpu();
+}
+EXPORT_SYMBOL(kernel_neon_end);
+
+#endif
+
 static int vfp_hotplug(struct notifier_block *b, unsigned long action,
 	void *hcpu)
 {
@@ -179,6 +179,23 @@ static inline void blkio_update_group_iops(struct blkio_group *blkg,
 	}
 }
 
+static inline void blkio_update_group_lat_target(struct blkio_group *blkg,
+			unsigned int usec)
+{
+	struct blkio_policy_type *blkiop;
+
+	list_for_each_entry(blkiop, &blkio_list, list) {
+
+		/* If this policy does not own the blkg, do not send updates */
+		if (blkiop->plid != blkg->plid)
+			continue;
+
+		if (blkiop->ops.blkio_update_group_read_lat_target_fn)
+			blkiop->ops.blkio_update_group_read_lat_target_fn(
+							blkg->key, blkg, usec);
+	}
+}
+
 /*
  * Add to the appropriate stat variable depending on the request type.
  * This should be called with the blkg->stats_lock held.
@@ -462,6 +479,24 @@ void blkiocg_update_io_merged_stats(struct blkio_group *blkg, bool direction,
 }
 EXPORT_SYMBOL_GPL(blkiocg_update_io_merged_stats);
 
+void blkiocg_update_throttled_stats(struct blkio_group *blkg, bool direction,
+					bool sync)
+{
+	struct blkio_group_stats_cpu *stats_cpu;
+	unsigned long flags;
+
+	local_irq_save(flags);
+
+	stats_cpu = this_cpu_ptr(blkg->stats_cpu);
+
+	u64_stats_update_begin(&stats_cpu->syncp);
+	blkio_add_stat(stats_cpu->stat_arr_cpu[BLKIO_STAT_CPU_THROTTLED], 1,
+				direction, sync);
+	u64_stats_update_end(&stats_cpu->syncp);
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(blkiocg_update_throttled_stats);
+
 /*
  * This function allocates the per cpu stats for blkio_group. Should be called
  * from sleepable context as alloc_per_cpu() requires that.
@@ -853,6 +888,14 @@ static int blkio_policy_parse_and_set(char *buf,
 			newpn->fileid = fileid;
 			newpn->val.iops = (unsigned int)temp;
 			break;
+		case BLKIO_THROTL_read_lat_target_device:
+			if (temp > THROTL_LAT_TARGET_MAX)
+				goto out;
+
+			newpn->plid = plid;
+			newpn->fileid = fileid;
+			newpn->val.lat_target = (unsigned int)temp;
+			break;
 		}
 		break;
 	default:
@@ -950,6 +993,23 @@ unsigned int blkcg_get_write_iops(struct blkio_cgroup *blkcg, dev_t dev)
 	return iops;
 }
 
+/* Read latency target in usec, 0 if the group has none on this device */
+unsigned int blkcg_get_read_lat_target(struct blkio_cgroup *blkcg, dev_t dev)
+{
+	struct blkio_policy_node *pn;
+	unsigned long flags;
+	unsigned int usec = 0;
+
+	spin_lock_irqsave(&blkcg->lock, flags);
+	pn = blkio_policy_search_node(blkcg, dev, BLKIO_POLICY_THROTL,
+				BLKIO_THROTL_read_lat_target_device);
+	if (pn)
+		usec = pn->val.lat_target;
+	spin_unlock_irqrestore(&blkcg->lock, flags);
+
+	return usec;
+}
+
 /* Checks whether user asked for deleting a policy rule */
 static bool blkio_delete_rule_command(struct blkio_policy_node *pn)
 {
@@ -969,6 +1029,10 @@ static bool blkio_delete_rule_command(struct blkio_policy_node *pn)
 		case BLKIO_THROTL_write_iops_device:
 			if (pn->val.iops == 0)
 				return 1;
+			break;
+		case BLKIO_THROTL_read_lat_target_device:
+			if (pn->val.lat_target == 0)
+				return 1;
 		}
 		break;
 	default:
@@ -994,6 +1058,9 @@ static void blkio_update_policy_rule(struct blkio_policy_node *oldpn,
 		case BLKIO_THROTL_read_iops_device:
 		case BLKIO_THROTL_write_iops_device:
 			oldpn->val.iops = newpn->val.iops;
+			break;
+		case BLKIO_THROTL_read_lat_target_device:
+			oldpn->val.lat_target = newpn->val.lat_target;
 		}
 		break;
 	default:
@@ -1029,6 +1096,10 @@ static void blkio_update_blkg_policy(struct blkio_cgroup *blkcg,
 			iops = pn->val.iops ? pn->val.iops : (-1);
 			blkio_update_group_iops(blkg, iops, pn->fileid);
 			break;
+		case BLKIO_THROTL_read_lat_target_device:
+			blkio_update_group_lat_target(blkg,
+						pn->val.lat_target);
+			break;
 		}
 		break;
 	default:
@@ -1140,6 +1211,10 @@ blkio_print_policy_node(struct seq_file *m, struct blkio_policy_node *pn)
 				seq_printf(m, "%u:%u\t%u\n", MAJOR(pn->dev),
 					MINOR(pn->dev), pn->val.iops);
 				break;
+			case BLKIO_THROTL_read_lat_target_device:
+				seq_printf(m, "%u:%u\t%u\n", MAJOR(pn->dev),
+					MINOR(pn->dev), pn->val.lat_target);
+				break;
 			}
 			break;
 		default:
@@ -1189,6 +1264,7 @@ static int blkiocg_file_read(struct cgroup *cgrp, struct cftype *cft,
 		case BLKIO_THROTL_write_bps_device:
 		case BLKIO_THROTL_read_iops_device:
 		case BLKIO_THROTL_write_iops_device:
+		case BLKIO_THROTL_read_lat_target_device:
 			blkio_read_policy_node_files(cft, blkcg, m);
 			return 0;
 		default:
@@ -1301,6 +1377,9 @@ static int blkiocg_file_read_map(struct cgroup *cgrp, struct cftype *cft,
 		case BLKIO_THROTL_io_serviced:
 			return blkio_read_blkg_stats(blkcg, cft, cb,
 						BLKIO_STAT_CPU_SERVICED, 1, 1);
+		case BLKIO_THROTL_io_throttled:
+			return blkio_read_blkg_stats(blkcg, cft, cb,
+						BLKIO_STAT_CPU_THROTTLED, 1, 1);
 		default:
 			BUG();
 		}
@@ -1497,6 +1576,20 @@ struct cftype blkio_files[] = {
 				BLKIO_THROTL_io_serviced),
 		.read_map = blkiocg_file_read_map,
 	},
+	{
+		.name = "throttle.read_latency_target_device",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_THROTL,
+				BLKIO_THROTL_read_lat_target_device),
+		.read_seq_string = blkiocg_file_read,
+		.write_string = blkiocg_file_write,
+		.max_write_len = 256,
+	},
+	{
+		.name = "throttle.io_throttled",
+		.private = BLKIOFILE_PRIVATE(BLKIO_POLICY_THROTL,
+				BLKIO_THROTL_io_throttled),
+		.read_map = blkiocg_file_read_map,
+	},
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
 #ifdef CONFIG_DEBUG_BLK_CGROUP
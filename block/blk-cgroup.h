@@ -22,6 +22,7 @@ enum blkio_policy_id {
 };
 
 #define THROTL_IOPS_MAX		UINT_MAX
+#define THROTL_LAT_TARGET_MAX	USEC_PER_SEC
 
 #if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_CGROUP_MODULE)
 
@@ -57,6 +58,8 @@ enum stat_type_cpu {
 	BLKIO_STAT_CPU_SERVICED,
 	
 	BLKIO_STAT_CPU_MERGED,
+	/* Bios held back by blk-throttle */
+	BLKIO_STAT_CPU_THROTTLED,
 	BLKIO_STAT_CPU_NR
 };
 
@@ -100,6 +103,8 @@ enum blkcg_file_name_throtl {
 	BLKIO_THROTL_write_iops_device,
 	BLKIO_THROTL_io_service_bytes,
 	BLKIO_THROTL_io_serviced,
+	BLKIO_THROTL_read_lat_target_device,
+	BLKIO_THROTL_io_throttled,
 };
 
 struct blkio_cgroup {
@@ -175,6 +180,7 @@ struct blkio_policy_node {
 		unsigned int weight;
 		u64 bps;
 		unsigned int iops;
+		unsigned int lat_target;
 	} val;
 };
 
@@ -188,6 +194,8 @@ extern unsigned int blkcg_get_read_iops(struct blkio_cgroup *blkcg,
 				     dev_t dev);
 extern unsigned int blkcg_get_write_iops(struct blkio_cgroup *blkcg,
 				     dev_t dev);
+extern unsigned int blkcg_get_read_lat_target(struct blkio_cgroup *blkcg,
+				     dev_t dev);
 
 typedef void (blkio_unlink_group_fn) (void *key, struct blkio_group *blkg);
 
@@ -201,6 +209,8 @@ typedef void (blkio_update_group_read_iops_fn) (void *key,
 			struct blkio_group *blkg, unsigned int read_iops);
 typedef void (blkio_update_group_write_iops_fn) (void *key,
 			struct blkio_group *blkg, unsigned int write_iops);
+typedef void (blkio_update_group_read_lat_target_fn) (void *key,
+			struct blkio_group *blkg, unsigned int usec);
 
 struct blkio_policy_ops {
 	blkio_unlink_group_fn *blkio_unlink_group_fn;
@@ -209,6 +219,8 @@ struct blkio_policy_ops {
 	blkio_update_group_write_bps_fn *blkio_update_group_write_bps_fn;
 	blkio_update_group_read_iops_fn *blkio_update_group_read_iops_fn;
 	blkio_update_group_write_iops_fn *blkio_update_group_write_iops_fn;
+	blkio_update_group_read_lat_target_fn
+				*blkio_update_group_read_lat_target_fn;
 };
 
 struct blkio_policy_type {
@@ -303,6 +315,8 @@ void blkiocg_update_completion_stats(struct blkio_group *blkg,
 	uint64_t start_time, uint64_t io_start_time, bool direction, bool sync);
 void blkiocg_update_io_merged_stats(struct blkio_group *blkg, bool direction,
 					bool sync);
+void blkiocg_update_throttled_stats(struct blkio_group *blkg, bool direction,
+					bool sync);
 void blkiocg_update_io_add_stats(struct blkio_group *blkg,
 		struct blkio_group *curr_blkg, bool direction, bool sync);
 void blkiocg_update_io_remove_stats(struct blkio_group *blkg,
@@ -336,6 +350,8 @@ static inline void blkiocg_update_completion_stats(struct blkio_group *blkg,
 		bool sync) {}
 static inline void blkiocg_update_io_merged_stats(struct blkio_group *blkg,
 						bool direction, bool sync) {}
+static inline void blkiocg_update_throttled_stats(struct blkio_group *blkg,
+						bool direction, bool sync) {}
 static inline void blkiocg_update_io_add_stats(struct blkio_group *blkg,
 		struct blkio_group *curr_blkg, bool direction, bool sync) {}
 static inline void blkiocg_update_io_remove_stats(struct blkio_group *blkg,
@@ -1626,6 +1626,7 @@ static void blk_finish_request(struct request *req, int error)
 
 
 	blk_account_io_done(req);
+	blk_throtl_rq_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
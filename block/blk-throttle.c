@@ -21,6 +21,15 @@ static int throtl_quantum = 32;
 /* Throttling is performed over 100ms slice and after that slice is renewed */
 static unsigned long throtl_slice = HZ/10;	/* 100 ms */
 
+/*
+ * Read latency is judged over 250ms windows. A window misses the target
+ * when more than 1% of its reads took longer, i.e. its p99 is above it.
+ */
+static unsigned long throtl_lat_window = HZ/4;	/* 250 ms */
+
+/* Floor and additive step of the iops cap on background groups */
+#define THROTL_BG_IOPS_MIN	8
+
 /* A workqueue to queue throttle related work */
 static struct workqueue_struct *kthrotld_workqueue;
 static void throtl_schedule_delayed_work(struct throtl_data *td,
@@ -68,6 +77,9 @@ struct throtl_grp {
 	/* IOPS limits */
 	unsigned int iops[2];
 
+	/* p99 read latency target in usec, 0 for a background group */
+	unsigned int lat_target;
+
 	/* Number of bytes disptached in current slice */
 	uint64_t bytes_disp[2];
 	/* Number of bio's dispatched in current slice */
@@ -106,6 +118,18 @@ struct throtl_data
 	struct delayed_work throtl_work;
 
 	int limits_changed;
+
+	/* Smallest read latency target of any group in usec, 0 if none */
+	unsigned int lat_target;
+
+	/* iops cap on groups without a target, -1 while the target is met */
+	unsigned int bg_iops;
+
+	/* Completions in the current latency window */
+	unsigned long lat_window_end;
+	unsigned int lat_reads;
+	unsigned int lat_missed;
+	unsigned int lat_ios;
 };
 
 enum tg_state_flags {
@@ -148,6 +172,15 @@ static inline unsigned int total_nr_queued(struct throtl_data *td)
 	return td->nr_queued[0] + td->nr_queued[1];
 }
 
+/* The group's own iops limit, tightened while it is background I/O */
+static inline unsigned int
+tg_iops(struct throtl_data *td, struct throtl_grp *tg, bool rw)
+{
+	if (tg->lat_target || !td->lat_target)
+		return tg->iops[rw];
+	return min(tg->iops[rw], td->bg_iops);
+}
+
 static inline struct throtl_grp *throtl_ref_get_tg(struct throtl_grp *tg)
 {
 	atomic_inc(&tg->ref);
@@ -259,6 +292,12 @@ static void throtl_init_add_tg_lists(struct throtl_data *td,
 	tg->bps[WRITE] = blkcg_get_write_bps(blkcg, tg->blkg.dev);
 	tg->iops[READ] = blkcg_get_read_iops(blkcg, tg->blkg.dev);
 	tg->iops[WRITE] = blkcg_get_write_iops(blkcg, tg->blkg.dev);
+	tg->lat_target = blkcg_get_read_lat_target(blkcg, tg->blkg.dev);
+	if (tg->lat_target) {
+		xchg(&tg->limits_changed, true);
+		xchg(&td->limits_changed, true);
+		throtl_schedule_delayed_work(td, 0);
+	}
 
 	throtl_add_group_to_td_list(td, tg);
 }
@@ -558,7 +597,7 @@ throtl_trim_slice(struct throtl_data *td, struct throtl_grp *tg, bool rw)
 	do_div(tmp, HZ);
 	bytes_trim = tmp;
 
-	io_trim = (tg->iops[rw] * throtl_slice * nr_slices)/HZ;
+	io_trim = (tg_iops(td, tg, rw) * throtl_slice * nr_slices)/HZ;
 
 	if (!bytes_trim && !io_trim)
 		return;
@@ -585,7 +624,7 @@ static bool tg_with_in_iops_limit(struct throtl_data *td, struct throtl_grp *tg,
 		struct bio *bio, unsigned long *wait)
 {
 	bool rw = bio_data_dir(bio);
-	unsigned int io_allowed;
+	unsigned int io_allowed, iops = tg_iops(td, tg, rw);
 	unsigned long jiffy_elapsed, jiffy_wait, jiffy_elapsed_rnd;
 	u64 tmp;
 
@@ -604,7 +643,7 @@ static bool tg_with_in_iops_limit(struct throtl_data *td, struct throtl_grp *tg,
 	 * have been trimmed.
 	 */
 
-	tmp = (u64)tg->iops[rw] * jiffy_elapsed_rnd;
+	tmp = (u64)iops * jiffy_elapsed_rnd;
 	do_div(tmp, HZ);
 
 	if (tmp > UINT_MAX)
@@ -619,7 +658,7 @@ static bool tg_with_in_iops_limit(struct throtl_data *td, struct throtl_grp *tg,
 	}
 
 	/* Calc approx time to dispatch */
-	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/tg->iops[rw] + 1;
+	jiffy_wait = ((tg->io_disp[rw] + 1) * HZ)/iops + 1;
 
 	if (jiffy_wait > jiffy_elapsed)
 		jiffy_wait = jiffy_wait - jiffy_elapsed;
@@ -673,8 +712,9 @@ static bool tg_with_in_bps_limit(struct throtl_data *td, struct throtl_grp *tg,
 	return 0;
 }
 
-static bool tg_no_rule_group(struct throtl_grp *tg, bool rw) {
-	if (tg->bps[rw] == -1 && tg->iops[rw] == -1)
+static bool tg_no_rule_group(struct throtl_data *td, struct throtl_grp *tg,
+				bool rw) {
+	if (tg->bps[rw] == -1 && tg_iops(td, tg, rw) == -1)
 		return 1;
 	return 0;
 }
@@ -698,7 +738,7 @@ static bool tg_may_dispatch(struct throtl_data *td, struct throtl_grp *tg,
 	BUG_ON(tg->nr_queued[rw] && bio != bio_list_peek(&tg->bio_lists[rw]));
 
 	/* If tg->bps = -1, then BW is unlimited */
-	if (tg->bps[rw] == -1 && tg->iops[rw] == -1) {
+	if (tg_no_rule_group(td, tg, rw)) {
 		if (wait)
 			*wait = 0;
 		return 1;
@@ -863,10 +903,23 @@ static int throtl_select_dispatch(struct throtl_data *td, struct bio_list *bl)
 	return nr_disp;
 }
 
+/* The cap on background groups moved, restart their slices at the new rate */
+static void throtl_bg_limits_changed(struct throtl_data *td)
+{
+	struct throtl_grp *tg;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(tg, pos, &td->tg_list, tg_node)
+		if (!tg->lat_target)
+			xchg(&tg->limits_changed, true);
+	xchg(&td->limits_changed, true);
+}
+
 static void throtl_process_limit_change(struct throtl_data *td)
 {
 	struct throtl_grp *tg;
 	struct hlist_node *pos, *n;
+	unsigned int lat_target;
 
 	if (!td->limits_changed)
 		return;
@@ -875,6 +928,21 @@ static void throtl_process_limit_change(struct throtl_data *td)
 
 	throtl_log(td, "limits changed");
 
+	lat_target = 0;
+	hlist_for_each_entry(tg, pos, &td->tg_list, tg_node)
+		if (tg->lat_target &&
+		    (!lat_target || tg->lat_target < lat_target))
+			lat_target = tg->lat_target;
+	if (lat_target != td->lat_target) {
+		if (!td->lat_target) {
+			td->lat_window_end = jiffies + throtl_lat_window;
+			td->lat_reads = td->lat_missed = td->lat_ios = 0;
+		}
+		td->lat_target = lat_target;
+		td->bg_iops = -1;
+		throtl_bg_limits_changed(td);
+	}
+
 	hlist_for_each_entry_safe(tg, pos, n, &td->tg_list, tg_node) {
 		if (!tg->limits_changed)
 			continue;
@@ -883,8 +951,9 @@ static void throtl_process_limit_change(struct throtl_data *td)
 			continue;
 
 		throtl_log_tg(td, tg, "limit change rbps=%llu wbps=%llu"
-			" riops=%u wiops=%u", tg->bps[READ], tg->bps[WRITE],
-			tg->iops[READ], tg->iops[WRITE]);
+			" riops=%u wiops=%u lat=%u", tg->bps[READ],
+			tg->bps[WRITE], tg_iops(td, tg, READ),
+			tg_iops(td, tg, WRITE), tg->lat_target);
 
 		/*
 		 * Restart the slices for both READ and WRITES. It
@@ -1087,6 +1156,16 @@ static void throtl_update_blkio_group_write_iops(void *key,
 	throtl_update_blkio_group_common(td, tg);
 }
 
+static void throtl_update_blkio_group_read_lat_target(void *key,
+			struct blkio_group *blkg, unsigned int usec)
+{
+	struct throtl_data *td = key;
+	struct throtl_grp *tg = tg_of_blkg(blkg);
+
+	tg->lat_target = usec;
+	throtl_update_blkio_group_common(td, tg);
+}
+
 static void throtl_shutdown_wq(struct request_queue *q)
 {
 	struct throtl_data *td = q->td;
@@ -1105,6 +1184,8 @@ static struct blkio_policy_type blkio_policy_throtl = {
 					throtl_update_blkio_group_read_iops,
 		.blkio_update_group_write_iops_fn =
 					throtl_update_blkio_group_write_iops,
+		.blkio_update_group_read_lat_target_fn =
+					throtl_update_blkio_group_read_lat_target,
 	},
 	.plid = BLKIO_POLICY_THROTL,
 };
@@ -1134,7 +1215,7 @@ bool blk_throtl_bio(struct request_queue *q, struct bio *bio)
 	if (tg) {
 		throtl_tg_fill_dev_details(td, tg);
 
-		if (tg_no_rule_group(tg, rw)) {
+		if (tg_no_rule_group(td, tg, rw)) {
 			blkiocg_update_dispatch_stats(&tg->blkg, bio->bi_size,
 					rw, rw_is_sync(bio->bi_rw));
 			rcu_read_unlock();
@@ -1190,6 +1271,7 @@ queue_bio:
 			tg->nr_queued[READ], tg->nr_queued[WRITE]);
 
 	throtl_add_bio_tg(q->td, tg, bio);
+	blkiocg_update_throttled_stats(&tg->blkg, rw, rw_is_sync(bio->bi_rw));
 	throttled = true;
 
 	if (update_disptime) {
@@ -1203,6 +1285,70 @@ out:
 	return throttled;
 }
 
+/*
+ * End of a latency window. A miss halves the background cap, starting from
+ * half of what the device completed in the window; a met target raises it
+ * by an eighth, and it is dropped as soon as no reads are coming in.
+ */
+static void throtl_lat_window_done(struct throtl_data *td, unsigned long now)
+{
+	unsigned int bg_iops = td->bg_iops, elapsed;
+	u64 rate;
+
+	elapsed = jiffies_to_msecs(now - td->lat_window_end + throtl_lat_window);
+	rate = div_u64((u64)td->lat_ios * MSEC_PER_SEC, max(elapsed, 1U));
+
+	if (td->lat_missed * 100 > td->lat_reads) {
+		if (bg_iops == -1)
+			bg_iops = min_t(u64, rate, UINT_MAX);
+		bg_iops = max(bg_iops / 2, (unsigned int)THROTL_BG_IOPS_MIN);
+	} else if (!td->lat_reads) {
+		bg_iops = -1;
+	} else if (bg_iops != -1) {
+		bg_iops += max(bg_iops / 8, (unsigned int)THROTL_BG_IOPS_MIN);
+		/* Well above what the device does anyway, stop capping */
+		if (bg_iops > rate * 2)
+			bg_iops = -1;
+	}
+
+	throtl_log(td, "lat window reads=%u missed=%u ios=%u bg_iops=%u",
+			td->lat_reads, td->lat_missed, td->lat_ios, bg_iops);
+
+	td->lat_reads = td->lat_missed = td->lat_ios = 0;
+	td->lat_window_end = now + throtl_lat_window;
+
+	if (bg_iops != td->bg_iops) {
+		td->bg_iops = bg_iops;
+		throtl_bg_limits_changed(td);
+		throtl_schedule_delayed_work(td, 0);
+	}
+}
+
+/*
+ * Called with the queue lock held for every completed request. Only does
+ * anything while some group on the queue has a read latency target.
+ */
+void blk_throtl_rq_done(struct request *rq)
+{
+	struct throtl_data *td = rq->q->td;
+	unsigned long now = jiffies;
+	u64 lat;
+
+	if (!td || !td->lat_target || rq->cmd_type != REQ_TYPE_FS)
+		return;
+
+	td->lat_ios++;
+	if (rq_data_dir(rq) == READ) {
+		lat = sched_clock() - rq_start_time_ns(rq);
+		td->lat_reads++;
+		if (lat > (u64)td->lat_target * NSEC_PER_USEC)
+			td->lat_missed++;
+	}
+
+	if (time_after_eq(now, td->lat_window_end))
+		throtl_lat_window_done(td, now);
+}
+
 /**
  * blk_throtl_drain - drain throttled bios
  * @q: request_queue to drain throttled bios for
@@ -1250,6 +1396,7 @@ int blk_throtl_init(struct request_queue *q)
 	INIT_HLIST_HEAD(&td->tg_list);
 	td->tg_service_tree = THROTL_RB_ROOT;
 	td->limits_changed = false;
+	td->bg_iops = -1;
 	INIT_DELAYED_WORK(&td->throtl_work, blk_throtl_work);
 
 	/* alloc and Init root group. */
@@ -159,6 +159,7 @@ static inline struct io_context *create_io_context(struct task_struct *task,
 #ifdef CONFIG_BLK_DEV_THROTTLING
 extern bool blk_throtl_bio(struct request_queue *q, struct bio *bio);
 extern void blk_throtl_drain(struct request_queue *q);
+extern void blk_throtl_rq_done(struct request *rq);
 extern int blk_throtl_init(struct request_queue *q);
 extern void blk_throtl_exit(struct request_queue *q);
 extern void blk_throtl_release(struct request_queue *q);
@@ -168,6 +169,7 @@ static inline bool blk_throtl_bio(struct request_queue *q, struct bio *bio)
 	return false;
 }
 static inline void blk_throtl_drain(struct request_queue *q) { }
+static inline void blk_throtl_rq_done(struct request *rq) { }
 static inline int blk_throtl_init(struct request_queue *q) { return 0; }
 static inline void blk_throtl_exit(struct request_queue *q) { }
 static inline void blk_throtl_release(struct request_queue *q) { }
@@ -0,0 +1,350 @@
+/*
+ *  ROW (Read Over Write) i/o scheduler.
+ *
+ *  Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Flash has no seek to amortize, so idling for the next request of a
+ * process, as cfq does, only leaves the device empty while reads wait
+ * behind a slice of writes.  ROW never idles.  Requests go to one of a
+ * few FIFO classes and the highest non-empty class is served first:
+ *
+ *	ui_read		reads from tasks with the RT ioprio class
+ *	read		other reads
+ *	sync_write	writes someone waits for (fsync, O_SYNC)
+ *	async_write	writeback
+ *	idle		anything from tasks with the IDLE ioprio class
+ *
+ * A lower class still gets a request in once it has been passed over
+ * <class>_starve times in a row, or once its oldest request is older
+ * than <class>_expire, so a stream of reads can't stall writeback.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/sched.h>
+
+enum row_class {
+	ROW_UI_READ,
+	ROW_READ,
+	ROW_SYNC_WRITE,
+	ROW_ASYNC_WRITE,
+	ROW_IDLE,
+	ROW_NR_CLASSES,
+};
+
+/* Dispatches of higher classes a waiting class lets pass, 0 for no limit */
+static const int row_starve[ROW_NR_CLASSES] = { 0, 8, 4, 16, 64 };
+/* Age in ms after which a class is served first, 0 for never */
+static const int row_expire[ROW_NR_CLASSES] = { 0, 100, 500, 5000, 10000 };
+
+struct row_queue {
+	struct list_head fifo;
+	unsigned int starved;
+	unsigned long dispatched;
+};
+
+struct row_data {
+	struct row_queue rqueue[ROW_NR_CLASSES];
+	int starve[ROW_NR_CLASSES];
+	int fifo_expire[ROW_NR_CLASSES];
+};
+
+#define rq_row_class(rq)	((unsigned long) (rq)->elv.priv[0])
+
+/*
+ * Requests are added at unplug, normally still in the submitter's
+ * context, so its io_context is the hint unless the bio carried one.
+ */
+static enum row_class row_classify(struct request *rq)
+{
+	struct io_context *ioc = current->io_context;
+	int ioclass;
+
+	if (ioprio_valid(rq->ioprio))
+		ioclass = IOPRIO_PRIO_CLASS(rq->ioprio);
+	else if (ioc && ioprio_valid(ioc->ioprio))
+		ioclass = IOPRIO_PRIO_CLASS(ioc->ioprio);
+	else
+		ioclass = task_nice_ioclass(current);
+
+	if (ioclass == IOPRIO_CLASS_IDLE)
+		return ROW_IDLE;
+
+	if (rq_data_dir(rq) == READ)
+		return ioclass == IOPRIO_CLASS_RT ? ROW_UI_READ : ROW_READ;
+
+	return rq_is_sync(rq) ? ROW_SYNC_WRITE : ROW_ASYNC_WRITE;
+}
+
+static void row_add_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	enum row_class class = row_classify(rq);
+
+	rq->elv.priv[0] = (void *) (unsigned long) class;
+	rq_set_fifo_time(rq, jiffies + rd->fifo_expire[class]);
+	list_add_tail(&rq->queuelist, &rd->rqueue[class].fifo);
+}
+
+static void row_merged_requests(struct request_queue *q, struct request *rq,
+				struct request *next)
+{
+	/* Within a class the merged request takes over the older place */
+	if (rq_row_class(rq) == rq_row_class(next) &&
+	    time_before(rq_fifo_time(next), rq_fifo_time(rq))) {
+		list_move(&rq->queuelist, &next->queuelist);
+		rq_set_fifo_time(rq, rq_fifo_time(next));
+	}
+
+	rq_fifo_clear(next);
+}
+
+static bool row_expired(struct row_data *rd, int class)
+{
+	struct request *rq;
+
+	if (!rd->fifo_expire[class])
+		return false;
+
+	rq = rq_entry_fifo(rd->rqueue[class].fifo.next);
+
+	return time_after_eq(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * The highest class whose oldest request has expired, else the highest
+ * class that has been passed over often enough, else the highest class.
+ */
+static int row_pick_class(struct row_data *rd)
+{
+	int class, first = -1, starved = -1;
+
+	for (class = 0; class < ROW_NR_CLASSES; class++) {
+		struct row_queue *rqueue = &rd->rqueue[class];
+
+		if (list_empty(&rqueue->fifo))
+			continue;
+
+		if (row_expired(rd, class))
+			return class;
+
+		if (first < 0)
+			first = class;
+		else if (starved < 0 && rd->starve[class] &&
+			 rqueue->starved >= rd->starve[class])
+			starved = class;
+	}
+
+	return starved >= 0 ? starved : first;
+}
+
+static int row_dispatch_requests(struct request_queue *q, int force)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+	struct request *rq;
+	int class, i;
+
+	class = row_pick_class(rd);
+	if (class < 0)
+		return 0;
+
+	rq = rq_entry_fifo(rd->rqueue[class].fifo.next);
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(q, rq);
+
+	rd->rqueue[class].starved = 0;
+	rd->rqueue[class].dispatched++;
+
+	/* Everyone below that had something queued was passed over */
+	for (i = class + 1; i < ROW_NR_CLASSES; i++)
+		if (!list_empty(&rd->rqueue[i].fifo))
+			rd->rqueue[i].starved++;
+
+	return 1;
+}
+
+static struct request *
+row_former_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	if (rq->queuelist.prev == &rd->rqueue[rq_row_class(rq)].fifo)
+		return NULL;
+	return list_entry(rq->queuelist.prev, struct request, queuelist);
+}
+
+static struct request *
+row_latter_request(struct request_queue *q, struct request *rq)
+{
+	struct row_data *rd = q->elevator->elevator_data;
+
+	if (rq->queuelist.next == &rd->rqueue[rq_row_class(rq)].fifo)
+		return NULL;
+	return list_entry(rq->queuelist.next, struct request, queuelist);
+}
+
+static void *row_init_queue(struct request_queue *q)
+{
+	struct row_data *rd;
+	int i;
+
+	rd = kmalloc_node(sizeof(*rd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!rd)
+		return NULL;
+
+	for (i = 0; i < ROW_NR_CLASSES; i++) {
+		INIT_LIST_HEAD(&rd->rqueue[i].fifo);
+		rd->starve[i] = row_starve[i];
+		rd->fifo_expire[i] = msecs_to_jiffies(row_expire[i]);
+	}
+
+	return rd;
+}
+
+static void row_exit_queue(struct elevator_queue *e)
+{
+	struct row_data *rd = e->elevator_data;
+	int i;
+
+	for (i = 0; i < ROW_NR_CLASSES; i++)
+		BUG_ON(!list_empty(&rd->rqueue[i].fifo));
+
+	kfree(rd);
+}
+
+static ssize_t
+row_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+row_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return row_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(row_read_starve_show, rd->starve[ROW_READ], 0);
+SHOW_FUNCTION(row_sync_write_starve_show, rd->starve[ROW_SYNC_WRITE], 0);
+SHOW_FUNCTION(row_async_write_starve_show, rd->starve[ROW_ASYNC_WRITE], 0);
+SHOW_FUNCTION(row_idle_starve_show, rd->starve[ROW_IDLE], 0);
+SHOW_FUNCTION(row_read_expire_show, rd->fifo_expire[ROW_READ], 1);
+SHOW_FUNCTION(row_sync_write_expire_show, rd->fifo_expire[ROW_SYNC_WRITE], 1);
+SHOW_FUNCTION(row_async_write_expire_show, rd->fifo_expire[ROW_ASYNC_WRITE], 1);
+SHOW_FUNCTION(row_idle_expire_show, rd->fifo_expire[ROW_IDLE], 1);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct row_data *rd = e->elevator_data;				\
+	int __data;							\
+	int ret = row_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(row_read_starve_store, &rd->starve[ROW_READ], 0, INT_MAX, 0);
+STORE_FUNCTION(row_sync_write_starve_store, &rd->starve[ROW_SYNC_WRITE], 0, INT_MAX, 0);
+STORE_FUNCTION(row_async_write_starve_store, &rd->starve[ROW_ASYNC_WRITE], 0, INT_MAX, 0);
+STORE_FUNCTION(row_idle_starve_store, &rd->starve[ROW_IDLE], 0, INT_MAX, 0);
+STORE_FUNCTION(row_read_expire_store, &rd->fifo_expire[ROW_READ], 0, INT_MAX, 1);
+STORE_FUNCTION(row_sync_write_expire_store, &rd->fifo_expire[ROW_SYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(row_async_write_expire_store, &rd->fifo_expire[ROW_ASYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(row_idle_expire_store, &rd->fifo_expire[ROW_IDLE], 0, INT_MAX, 1);
+#undef STORE_FUNCTION
+
+static ssize_t row_dispatched_show(struct elevator_queue *e, char *page)
+{
+	struct row_data *rd = e->elevator_data;
+
+	return sprintf(page, "%lu %lu %lu %lu %lu\n",
+		       rd->rqueue[ROW_UI_READ].dispatched,
+		       rd->rqueue[ROW_READ].dispatched,
+		       rd->rqueue[ROW_SYNC_WRITE].dispatched,
+		       rd->rqueue[ROW_ASYNC_WRITE].dispatched,
+		       rd->rqueue[ROW_IDLE].dispatched);
+}
+
+#define ROW_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
+				      row_##name##_store)
+
+static struct elv_fs_entry row_attrs[] = {
+	ROW_ATTR(read_starve),
+	ROW_ATTR(sync_write_starve),
+	ROW_ATTR(async_write_starve),
+	ROW_ATTR(idle_starve),
+	ROW_ATTR(read_expire),
+	ROW_ATTR(sync_write_expire),
+	ROW_ATTR(async_write_expire),
+	ROW_ATTR(idle_expire),
+	__ATTR(dispatched, S_IRUGO, row_dispatched_show, NULL),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_row = {
+	.ops = {
+		.elevator_merge_req_fn =	row_merged_requests,
+		.elevator_dispatch_fn =		row_dispatch_requests,
+		.elevator_add_req_fn =		row_add_request,
+		.elevator_former_req_fn =	row_former_request,
+		.elevator_latter_req_fn =	row_latter_request,
+		.elevator_init_fn =		row_init_queue,
+		.elevator_exit_fn =		row_exit_queue,
+	},
+
+	.elevator_attrs = row_attrs,
+	.elevator_name = "row",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init row_init(void)
+{
+	return elv_register(&iosched_row);
+}
+
+static void __exit row_exit(void)
+{
+	elv_unregister(&iosched_row);
+}
+
+module_init(row_init);
+module_exit(row_exit);
+
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Read Over Write IO scheduler");
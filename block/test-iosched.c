@@ -26,6 +26,11 @@
 #include <linux/debugfs.h>
 #include <linux/test-iosched.h>
 #include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/random.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
 #include "blk.h"
 
 #define MODULE_NAME "test-iosched"
@@ -887,15 +892,283 @@ static struct elevator_type elevator_test_iosched = {
 	.elevator_owner = THIS_MODULE,
 };
 
+/*
+ * Read latency under a sustained write load.  Unlike the tests above this
+ * doesn't run through test-iosched but through the scheduler the device
+ * has, so schedulers can be compared.  Writing "<major>:<minor>" to
+ * iosched-latency/run keeps write_depth 128K writes in flight and times
+ * nr_reads 4K sync reads, one every 10ms, at random sectors.  Everything
+ * goes to nr_sectors from start_sector, which must be scratch space.
+ */
+#define LATENCY_WRITE_PAGES	32
+#define LATENCY_READ_GAP_MS	10
+#define LATENCY_WARMUP_MS	1000
+
+struct latency_test {
+	struct dentry *debug_root;
+	struct block_device *bdev;
+	u32 start_sector;
+	u32 nr_sectors;
+	u32 nr_reads;
+	u32 write_depth;
+	struct page *pages[LATENCY_WRITE_PAGES];
+	atomic_t writes_inflight;
+	atomic_t writes_done;
+	wait_queue_head_t wait;
+	u32 reads_done;
+	u64 total_us;
+	u64 max_us;
+};
+
+static struct latency_test latency_test = {
+	.nr_sectors = 64 * 2048,
+	.nr_reads = 200,
+	.write_depth = 32,
+};
+static DEFINE_MUTEX(latency_mutex);
+
+static struct bio *latency_bio(struct latency_test *lt, sector_t sector,
+			       int nr_pages)
+{
+	struct bio *bio;
+	int i;
+
+	bio = bio_alloc(GFP_KERNEL, nr_pages);
+	if (!bio)
+		return NULL;
+
+	bio->bi_bdev = lt->bdev;
+	bio->bi_sector = sector;
+	for (i = 0; i < nr_pages; i++) {
+		if (!bio_add_page(bio, lt->pages[i], PAGE_SIZE, 0)) {
+			bio_put(bio);
+			return NULL;
+		}
+	}
+
+	return bio;
+}
+
+static void latency_write_end(struct bio *bio, int err)
+{
+	struct latency_test *lt = bio->bi_private;
+
+	bio_put(bio);
+	atomic_inc(&lt->writes_done);
+	atomic_dec(&lt->writes_inflight);
+	wake_up(&lt->wait);
+}
+
+static int latency_writer(void *data)
+{
+	struct latency_test *lt = data;
+	sector_t span = LATENCY_WRITE_PAGES * (PAGE_SIZE >> 9);
+	sector_t offset = 0;
+	struct bio *bio;
+
+	while (!kthread_should_stop()) {
+		wait_event(lt->wait, kthread_should_stop() ||
+			   atomic_read(&lt->writes_inflight) <
+			   lt->write_depth);
+		if (kthread_should_stop())
+			break;
+
+		bio = latency_bio(lt, lt->start_sector + offset,
+				  LATENCY_WRITE_PAGES);
+		if (!bio)
+			break;
+		bio->bi_end_io = latency_write_end;
+		bio->bi_private = lt;
+		atomic_inc(&lt->writes_inflight);
+		submit_bio(WRITE, bio);
+
+		offset += span;
+		if (offset + span > lt->nr_sectors)
+			offset = 0;
+	}
+
+	wait_event(lt->wait, !atomic_read(&lt->writes_inflight));
+
+	return 0;
+}
+
+static void latency_read_end(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+static int latency_read(struct latency_test *lt)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	unsigned int blocks = lt->nr_sectors / (PAGE_SIZE >> 9);
+	sector_t sector;
+	struct bio *bio;
+	ktime_t start;
+	u64 us;
+
+	sector = lt->start_sector + (random32() % blocks) * (PAGE_SIZE >> 9);
+	bio = latency_bio(lt, sector, 1);
+	if (!bio)
+		return -ENOMEM;
+	bio->bi_end_io = latency_read_end;
+	bio->bi_private = &done;
+
+	start = ktime_get();
+	submit_bio(READ_SYNC, bio);
+	wait_for_completion(&done);
+	us = ktime_us_delta(ktime_get(), start);
+	bio_put(bio);
+
+	lt->reads_done++;
+	lt->total_us += us;
+	lt->max_us = max(lt->max_us, us);
+
+	return 0;
+}
+
+static int latency_run(struct latency_test *lt, dev_t dev)
+{
+	const fmode_t mode = FMODE_READ | FMODE_WRITE;
+	struct task_struct *writer;
+	int i, ret = 0;
+
+	if (!lt->nr_reads || !lt->write_depth ||
+	    lt->nr_sectors < LATENCY_WRITE_PAGES * (PAGE_SIZE >> 9))
+		return -EINVAL;
+
+	lt->bdev = blkdev_get_by_dev(dev, mode, NULL);
+	if (IS_ERR(lt->bdev))
+		return PTR_ERR(lt->bdev);
+
+	for (i = 0; i < LATENCY_WRITE_PAGES; i++) {
+		lt->pages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+		if (!lt->pages[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	atomic_set(&lt->writes_inflight, 0);
+	atomic_set(&lt->writes_done, 0);
+	lt->reads_done = 0;
+	lt->total_us = 0;
+	lt->max_us = 0;
+
+	writer = kthread_run(latency_writer, lt, "iosched-latency");
+	if (IS_ERR(writer)) {
+		ret = PTR_ERR(writer);
+		goto out;
+	}
+
+	/* Let the writes fill the queue first */
+	msleep(LATENCY_WARMUP_MS);
+
+	test_pr_info("%s: %u reads under %u writes in flight", __func__,
+		     lt->nr_reads, lt->write_depth);
+	for (i = 0; i < lt->nr_reads && !ret; i++) {
+		ret = latency_read(lt);
+		msleep(LATENCY_READ_GAP_MS);
+	}
+
+	kthread_stop(writer);
+	test_pr_info("%s: reads %u avg_us %llu max_us %llu writes %d",
+		     __func__, lt->reads_done,
+		     lt->reads_done ? div_u64(lt->total_us, lt->reads_done) : 0,
+		     lt->max_us, atomic_read(&lt->writes_done));
+out:
+	for (i = 0; i < LATENCY_WRITE_PAGES; i++) {
+		if (lt->pages[i])
+			__free_page(lt->pages[i]);
+		lt->pages[i] = NULL;
+	}
+	blkdev_put(lt->bdev, mode);
+	lt->bdev = NULL;
+
+	return ret;
+}
+
+static ssize_t latency_run_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	unsigned int major, minor;
+	char str[32];
+	int ret;
+
+	if (count >= sizeof(str))
+		return -EINVAL;
+	if (copy_from_user(str, buf, count))
+		return -EFAULT;
+	str[count] = '\0';
+
+	if (sscanf(str, "%u:%u", &major, &minor) != 2)
+		return -EINVAL;
+
+	mutex_lock(&latency_mutex);
+	ret = latency_run(&latency_test, MKDEV(major, minor));
+	mutex_unlock(&latency_mutex);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations latency_run_fops = {
+	.write = latency_run_write,
+};
+
+static ssize_t latency_result_read(struct file *file, char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct latency_test *lt = &latency_test;
+	char str[128];
+	int len;
+
+	mutex_lock(&latency_mutex);
+	len = snprintf(str, sizeof(str),
+		       "reads %u avg_us %llu max_us %llu writes %d\n",
+		       lt->reads_done,
+		       lt->reads_done ? div_u64(lt->total_us, lt->reads_done) : 0,
+		       lt->max_us, atomic_read(&lt->writes_done));
+	mutex_unlock(&latency_mutex);
+
+	return simple_read_from_buffer(buf, count, ppos, str, len);
+}
+
+static const struct file_operations latency_result_fops = {
+	.read = latency_result_read,
+};
+
+static void latency_debugfs_init(struct latency_test *lt)
+{
+	init_waitqueue_head(&lt->wait);
+
+	lt->debug_root = debugfs_create_dir("iosched-latency", NULL);
+	if (!lt->debug_root)
+		return;
+
+	debugfs_create_u32("start_sector", S_IRUGO | S_IWUSR, lt->debug_root,
+			   &lt->start_sector);
+	debugfs_create_u32("nr_sectors", S_IRUGO | S_IWUSR, lt->debug_root,
+			   &lt->nr_sectors);
+	debugfs_create_u32("nr_reads", S_IRUGO | S_IWUSR, lt->debug_root,
+			   &lt->nr_reads);
+	debugfs_create_u32("write_depth", S_IRUGO | S_IWUSR, lt->debug_root,
+			   &lt->write_depth);
+	debugfs_create_file("run", S_IWUSR, lt->debug_root, NULL,
+			    &latency_run_fops);
+	debugfs_create_file("result", S_IRUGO, lt->debug_root, NULL,
+			    &latency_result_fops);
+}
+
 static int __init test_init(void)
 {
 	elv_register(&elevator_test_iosched);
+	latency_debugfs_init(&latency_test);
 
 	return 0;
 }
 
 static void __exit test_exit(void)
 {
+	debugfs_remove_recursive(latency_test.debug_root);
 	elv_unregister(&elevator_test_iosched);
 }
 
@@ -370,6 +370,8 @@ static int crypto_init_ablkcipher_ops(struct crypto_tfm *tfm, u32 type,
 	crt->setkey = setkey;
 	crt->encrypt = alg->encrypt;
 	crt->decrypt = alg->decrypt;
+	crt->encrypt_batch = alg->encrypt_batch;
+	crt->decrypt_batch = alg->decrypt_batch;
 	if (!alg->ivsize) {
 		crt->givencrypt = skcipher_null_givencrypt;
 		crt->givdecrypt = skcipher_null_givdecrypt;
@@ -455,6 +457,8 @@ static int crypto_init_givcipher_ops(struct crypto_tfm *tfm, u32 type,
 	crt->decrypt = alg->decrypt;
 	crt->givencrypt = alg->givencrypt;
 	crt->givdecrypt = alg->givdecrypt ?: no_givdecrypt;
+	crt->encrypt_batch = alg->encrypt_batch;
+	crt->decrypt_batch = alg->decrypt_batch;
 	crt->base = __crypto_ablkcipher_cast(tfm);
 	crt->ivsize = alg->ivsize;
 
@@ -707,6 +711,44 @@ err:
 }
 EXPORT_SYMBOL_GPL(crypto_alloc_ablkcipher);
 
+int crypto_ablkcipher_encrypt_batch(struct ablkcipher_request **reqs,
+				    unsigned int nreqs)
+{
+	struct ablkcipher_tfm *crt;
+	unsigned int i;
+
+	if (!nreqs)
+		return 0;
+
+	crt = crypto_ablkcipher_crt(crypto_ablkcipher_reqtfm(reqs[0]));
+	if (crt->encrypt_batch)
+		return crt->encrypt_batch(reqs, nreqs);
+
+	for (i = 0; i < nreqs; i++)
+		crypto_batch_complete(&reqs[i]->base, crt->encrypt(reqs[i]));
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_ablkcipher_encrypt_batch);
+
+int crypto_ablkcipher_decrypt_batch(struct ablkcipher_request **reqs,
+				    unsigned int nreqs)
+{
+	struct ablkcipher_tfm *crt;
+	unsigned int i;
+
+	if (!nreqs)
+		return 0;
+
+	crt = crypto_ablkcipher_crt(crypto_ablkcipher_reqtfm(reqs[0]));
+	if (crt->decrypt_batch)
+		return crt->decrypt_batch(reqs, nreqs);
+
+	for (i = 0; i < nreqs; i++)
+		crypto_batch_complete(&reqs[i]->base, crt->decrypt(reqs[i]));
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_ablkcipher_decrypt_batch);
+
 static int __init skcipher_module_init(void)
 {
 	skcipher_default_geniv = num_possible_cpus() > 1 ?
@@ -276,6 +276,25 @@ int crypto_ahash_digest(struct ahash_request *req)
 }
 EXPORT_SYMBOL_GPL(crypto_ahash_digest);
 
+int crypto_ahash_digest_batch(struct ahash_request **reqs, unsigned int nreqs)
+{
+	struct crypto_ahash *tfm;
+	unsigned int i;
+
+	if (!nreqs)
+		return 0;
+
+	tfm = crypto_ahash_reqtfm(reqs[0]);
+	if (tfm->digest_batch)
+		return tfm->digest_batch(reqs, nreqs);
+
+	for (i = 0; i < nreqs; i++)
+		crypto_batch_complete(&reqs[i]->base,
+				      crypto_ahash_digest(reqs[i]));
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_ahash_digest_batch);
+
 static void ahash_def_finup_finish2(struct ahash_request *req, int err)
 {
 	struct ahash_request_priv *priv = req->priv;
@@ -380,6 +399,7 @@ static int crypto_ahash_init_tfm(struct crypto_tfm *tfm)
 	hash->final = alg->final;
 	hash->finup = alg->finup ?: ahash_def_finup;
 	hash->digest = alg->digest;
+	hash->digest_batch = alg->digest_batch;
 
 	if (alg->setkey)
 		hash->setkey = alg->setkey;
@@ -24,6 +24,7 @@
 #include <linux/wait.h>
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
+#include <linux/bootprof.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -170,6 +171,7 @@ static DECLARE_WAIT_QUEUE_HEAD(probe_waitqueue);
 
 static int really_probe(struct device *dev, struct device_driver *drv)
 {
+	unsigned long long start = bootprof_start();
 	int ret = 0;
 
 	atomic_inc(&probe_count);
@@ -220,6 +222,7 @@ probe_failed:
 	}
 	ret = 0;
 done:
+	bootprof_probe(dev, drv, start);
 	atomic_dec(&probe_count);
 	wake_up(&probe_waitqueue);
 	return ret;
@@ -21,6 +21,8 @@
 #include <linux/firmware.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/io.h>
+#include <asm/sizes.h>
 
 #define to_dev(obj) container_of(obj, struct device, kobj)
 
@@ -98,6 +100,12 @@ struct firmware_priv {
 	struct timer_list timeout;
 	struct device dev;
 	bool nowait;
+	/* request_firmware_direct(): data goes straight to dest_addr */
+	phys_addr_t dest_addr;
+	size_t dest_size;
+	void __iomem *dest_map;
+	size_t dest_map_off;
+	size_t dest_map_len;
 	char fw_id[];
 };
 
@@ -234,6 +242,12 @@ static ssize_t firmware_loading_store(struct device *dev,
 		set_bit(FW_STATUS_LOADING, &fw_priv->status);
 		break;
 	case 0:
+		if (test_bit(FW_STATUS_LOADING, &fw_priv->status) &&
+		    fw_priv->dest_addr) {
+			complete(&fw_priv->completion);
+			clear_bit(FW_STATUS_LOADING, &fw_priv->status);
+			break;
+		}
 		if (test_bit(FW_STATUS_LOADING, &fw_priv->status)) {
 			vunmap(fw_priv->fw->data);
 			fw_priv->fw->data = vmap(fw_priv->pages,
@@ -284,6 +298,10 @@ static ssize_t firmware_data_read(struct file *filp, struct kobject *kobj,
 		ret_count = -ENODEV;
 		goto out;
 	}
+	if (fw_priv->dest_addr) {
+		ret_count = -EINVAL;
+		goto out;
+	}
 	if (offset > fw->size) {
 		ret_count = 0;
 		goto out;
@@ -351,6 +369,44 @@ static int fw_realloc_buffer(struct firmware_priv *fw_priv, int min_size)
 	return 0;
 }
 
+#define FW_DIRECT_MAP_SIZE	SZ_1M
+
+/* Writes are sequential, so keep one window of the destination mapped */
+static int fw_direct_write(struct firmware_priv *fw_priv, const char *buffer,
+			   loff_t offset, size_t count)
+{
+	size_t off, len;
+
+	if (offset + count > fw_priv->dest_size)
+		return -EFBIG;
+
+	while (count) {
+		if (!fw_priv->dest_map || offset < fw_priv->dest_map_off ||
+		    offset >= fw_priv->dest_map_off + fw_priv->dest_map_len) {
+			if (fw_priv->dest_map)
+				iounmap(fw_priv->dest_map);
+			fw_priv->dest_map = NULL;
+			off = offset & ~(FW_DIRECT_MAP_SIZE - 1);
+			len = min_t(size_t, FW_DIRECT_MAP_SIZE,
+				    fw_priv->dest_size - off);
+			fw_priv->dest_map = ioremap(fw_priv->dest_addr + off,
+						    len);
+			if (!fw_priv->dest_map)
+				return -ENOMEM;
+			fw_priv->dest_map_off = off;
+			fw_priv->dest_map_len = len;
+		}
+		len = min_t(size_t, count, fw_priv->dest_map_off +
+			    fw_priv->dest_map_len - offset);
+		memcpy(fw_priv->dest_map + (offset - fw_priv->dest_map_off),
+		       buffer, len);
+		buffer += len;
+		offset += len;
+		count -= len;
+	}
+	return 0;
+}
+
 /**
  * firmware_data_write - write method for firmware
  * @filp: open sysfs file
@@ -381,6 +437,16 @@ static ssize_t firmware_data_write(struct file *filp, struct kobject *kobj,
 		retval = -ENODEV;
 		goto out;
 	}
+	if (fw_priv->dest_addr) {
+		retval = fw_direct_write(fw_priv, buffer, offset, count);
+		if (retval) {
+			fw_load_abort(fw_priv);
+			goto out;
+		}
+		retval = count;
+		fw->size = max_t(size_t, offset + count, fw->size);
+		goto out;
+	}
 	retval = fw_realloc_buffer(fw_priv, offset + count);
 	if (retval)
 		goto out;
@@ -537,6 +603,9 @@ static int _request_firmware_load(struct firmware_priv *fw_priv, bool uevent,
 	if (!fw_priv->fw->size || test_bit(FW_STATUS_ABORT, &fw_priv->status))
 		retval = -ENOENT;
 	fw_priv->fw = NULL;
+	if (fw_priv->dest_map)
+		iounmap(fw_priv->dest_map);
+	fw_priv->dest_map = NULL;
 	mutex_unlock(&fw_lock);
 
 	device_remove_file(f_dev, &dev_attr_loading);
@@ -575,6 +644,65 @@ request_firmware(const struct firmware **firmware_p, const char *name,
 	return ret;
 }
 
+/**
+ * request_firmware_direct - load firmware straight into physical memory
+ * @name: name of firmware file
+ * @device: device for which firmware is being loaded
+ * @dest_addr: physical address the image is written to
+ * @dest_size: size of the destination, larger images fail
+ *
+ * Like request_firmware(), but the data never goes through a kernel
+ * buffer.  Returns the size of the image or a negative error.
+ */
+int request_firmware_direct(const char *name, struct device *device,
+			    phys_addr_t dest_addr, size_t dest_size)
+{
+	const struct firmware *fw;
+	struct firmware_priv *fw_priv;
+	void __iomem *buf;
+	int ret;
+
+	if (!dest_addr || !dest_size)
+		return -EINVAL;
+
+	fw_priv = _request_firmware_prepare(&fw, name, device, true, false);
+	if (IS_ERR(fw_priv))
+		return PTR_ERR(fw_priv);
+
+	if (!fw_priv) {
+		/* Built in, there's no avoiding the copy */
+		ret = -EFBIG;
+		if (fw->size <= dest_size) {
+			ret = -ENOMEM;
+			buf = ioremap(dest_addr, fw->size);
+			if (buf) {
+				memcpy(buf, fw->data, fw->size);
+				iounmap(buf);
+				ret = fw->size;
+			}
+		}
+		release_firmware(fw);
+		return ret;
+	}
+
+	fw_priv->dest_addr = dest_addr;
+	fw_priv->dest_size = dest_size;
+
+	ret = usermodehelper_read_trylock();
+	if (WARN_ON(ret)) {
+		dev_err(device, "firmware: %s will not be loaded\n", name);
+	} else {
+		ret = _request_firmware_load(fw_priv, true,
+					firmware_loading_timeout());
+		usermodehelper_read_unlock();
+	}
+	if (!ret)
+		ret = fw->size;
+	release_firmware(fw);
+
+	return ret;
+}
+
 void release_firmware(const struct firmware *fw)
 {
 	if (fw) {
@@ -674,3 +802,4 @@ module_exit(firmware_class_exit);
 EXPORT_SYMBOL(release_firmware);
 EXPORT_SYMBOL(request_firmware);
 EXPORT_SYMBOL(request_firmware_nowait);
+EXPORT_SYMBOL(request_firmware_direct);
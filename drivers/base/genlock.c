@@ -191,16 +191,25 @@ fail_invalid:
 EXPORT_SYMBOL(genlock_attach_lock);
 
 
-static int handle_has_lock(struct genlock *lock, struct genlock_handle *handle)
+/*
+ * A handle is on lock->active exactly while it holds the lock at least
+ * once, and both only change under lock->lock.
+ */
+static inline int handle_has_lock(struct genlock *lock,
+				  struct genlock_handle *handle)
 {
-	struct genlock_handle *h;
-
-	list_for_each_entry(h, &lock->active, entry) {
-		if (h == handle)
-			return 1;
-	}
+	return handle->active > 0;
+}
 
-	return 0;
+/*
+ * Only wake when someone waits.  Pairs with the barrier in prepare_to_wait:
+ * a waiter not queued yet rechecks the state after it is.
+ */
+static void genlock_wake(struct genlock *lock)
+{
+	smp_mb();
+	if (waitqueue_active(&lock->queue))
+		wake_up(&lock->queue);
 }
 
 
@@ -210,7 +219,7 @@ static void _genlock_signal(struct genlock *lock)
 		
 		lock->state = _UNLOCKED;
 		
-		wake_up(&lock->queue);
+		genlock_wake(lock);
 	}
 }
 
@@ -276,7 +285,7 @@ static int _genlock_lock(struct genlock *lock, struct genlock_handle *handle,
 		if (flags & GENLOCK_WRITE_TO_READ) {
 			if (lock->state == _WRLOCK && op == _RDLOCK) {
 				lock->state = _RDLOCK;
-				wake_up(&lock->queue);
+				genlock_wake(lock);
 				goto done;
 			} else {
 				GENLOCK_LOG_ERR("Invalid state to convert"
@@ -355,7 +364,6 @@ int genlock_lock(struct genlock_handle *handle, int op, int flags,
 	uint32_t timeout)
 {
 	struct genlock *lock;
-	unsigned long irqflags;
 
 	int ret = 0;
 
@@ -376,12 +384,8 @@ int genlock_lock(struct genlock_handle *handle, int op, int flags,
 		ret = _genlock_unlock(lock, handle);
 		break;
 	case GENLOCK_RDLOCK:
-		spin_lock_irqsave(&lock->lock, irqflags);
-		if (handle_has_lock(lock, handle)) {
-			
+		if (ACCESS_ONCE(handle->active))
 			flags |= GENLOCK_WRITE_TO_READ;
-		}
-		spin_unlock_irqrestore(&lock->lock, irqflags);
 		
 	case GENLOCK_WRLOCK:
 		ret = _genlock_lock(lock, handle, op, flags, timeout);
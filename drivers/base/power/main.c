@@ -54,6 +54,8 @@ struct dpm_drv_wd_data {
 
 static int async_error;
 
+static DEFINE_SPINLOCK(dpm_slow_lock);
+
 void device_pm_init(struct device *dev)
 {
 	dev->power.is_prepared = false;
@@ -463,12 +465,40 @@ void dpm_resume_start(pm_message_t state)
 }
 EXPORT_SYMBOL_GPL(dpm_resume_start);
 
+/* Keep the REC_SLOW_NUM slowest resume callbacks of the last resume */
+static void dpm_save_resume_time(struct device *dev, ktime_t starttime)
+{
+	unsigned int usecs;
+	unsigned long flags;
+	int i;
+
+	usecs = ktime_to_us(ktime_sub(ktime_get(), starttime));
+
+	spin_lock_irqsave(&dpm_slow_lock, flags);
+	for (i = 0; i < REC_SLOW_NUM; i++)
+		if (usecs > suspend_stats.slow_usecs[i])
+			break;
+	if (i < REC_SLOW_NUM) {
+		memmove(&suspend_stats.slow_usecs[i + 1],
+			&suspend_stats.slow_usecs[i],
+			(REC_SLOW_NUM - i - 1) * sizeof(suspend_stats.slow_usecs[0]));
+		memmove(suspend_stats.slow_devs[i + 1],
+			suspend_stats.slow_devs[i],
+			(REC_SLOW_NUM - i - 1) * sizeof(suspend_stats.slow_devs[0]));
+		suspend_stats.slow_usecs[i] = usecs;
+		strlcpy(suspend_stats.slow_devs[i], dev_name(dev),
+			sizeof(suspend_stats.slow_devs[0]));
+	}
+	spin_unlock_irqrestore(&dpm_slow_lock, flags);
+}
+
 static int device_resume(struct device *dev, pm_message_t state, bool async)
 {
 	pm_callback_t callback = NULL;
 	char *info = NULL;
 	int error = 0;
 	bool put = false;
+	ktime_t starttime;
 
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
@@ -526,7 +556,10 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	}
 
  End:
+	starttime = ktime_get();
 	error = dpm_run_callback(callback, dev, state, info);
+	if (callback)
+		dpm_save_resume_time(dev, starttime);
 	dev->power.is_suspended = false;
 
  Unlock:
@@ -583,6 +616,8 @@ void dpm_resume(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
+	memset(suspend_stats.slow_usecs, 0, sizeof(suspend_stats.slow_usecs));
+	memset(suspend_stats.slow_devs, 0, sizeof(suspend_stats.slow_devs));
 
 	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
 		INIT_COMPLETION(dev->power.completion);
@@ -616,6 +651,8 @@ void dpm_resume(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	suspend_stats.last_resume_usecs =
+		ktime_to_us(ktime_sub(ktime_get(), starttime));
 	dpm_show_time(starttime, state, NULL);
 }
 
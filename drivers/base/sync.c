@@ -42,6 +42,8 @@ static DEFINE_SPINLOCK(sync_timeline_list_lock);
 static LIST_HEAD(sync_fence_list_head);
 static DEFINE_SPINLOCK(sync_fence_list_lock);
 
+static struct kmem_cache *sync_fence_cache;
+
 struct sync_timeline *sync_timeline_create(const struct sync_timeline_ops *ops,
 					   int size, const char *name)
 {
@@ -249,7 +251,7 @@ static struct sync_fence *sync_fence_alloc(const char *name)
 	struct sync_fence *fence;
 	unsigned long flags;
 
-	fence = kzalloc(sizeof(struct sync_fence), GFP_KERNEL);
+	fence = kmem_cache_zalloc(sync_fence_cache, GFP_KERNEL);
 	if (fence == NULL)
 		return NULL;
 
@@ -274,7 +276,7 @@ static struct sync_fence *sync_fence_alloc(const char *name)
 	return fence;
 
 err:
-	kfree(fence);
+	kmem_cache_free(sync_fence_cache, fence);
 	return NULL;
 }
 
@@ -438,6 +440,20 @@ struct sync_fence *sync_fence_merge(const char *name,
 	struct list_head *pos;
 	int err;
 
+	/*
+	 * Merging with a fence that has signaled without error yields the
+	 * other one; hand out another reference to it instead of a copy.
+	 */
+	smp_rmb();
+	if (b->status == 1 || a == b) {
+		get_file(a->file);
+		return a;
+	}
+	if (a->status == 1) {
+		get_file(b->file);
+		return b;
+	}
+
 	fence = sync_fence_alloc(name);
 	if (fence == NULL)
 		return NULL;
@@ -463,7 +479,7 @@ struct sync_fence *sync_fence_merge(const char *name,
 	return fence;
 err:
 	sync_fence_free_pts(fence);
-	kfree(fence);
+	kmem_cache_free(sync_fence_cache, fence);
 	return NULL;
 }
 EXPORT_SYMBOL(sync_fence_merge);
@@ -602,7 +618,7 @@ static void sync_fence_free(struct kref *kref)
 
 	sync_fence_free_pts(fence);
 
-	kfree(fence);
+	kmem_cache_free(sync_fence_cache, fence);
 }
 
 static int sync_fence_release(struct inode *inode, struct file *file)
@@ -794,6 +810,13 @@ static long sync_fence_ioctl(struct file *file, unsigned int cmd,
 	}
 }
 
+static int __init sync_init(void)
+{
+	sync_fence_cache = KMEM_CACHE(sync_fence, SLAB_PANIC);
+	return 0;
+}
+core_initcall(sync_init);
+
 #ifdef CONFIG_DEBUG_FS
 static const char *sync_status_str(int status)
 {
@@ -28,6 +28,8 @@
 #include <linux/workqueue.h>
 #include <linux/uaccess.h>
 #include <linux/interrupt.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <net/bluetooth/bluetooth.h>
 #include <net/bluetooth/hci_core.h>
 #include <net/bluetooth/hci.h>
@@ -39,12 +41,21 @@
 #define RX_Q_MONITOR		(500)	
 #define HCI_REGISTER_SET	0
 
+#define HCI_SMD_RX_BATCH	16
+/* SMD packet header, which smd_read_avail() does not count */
+#define HCI_SMD_PKT_HDR		20
+
 
 static int hcismd_set;
 static DEFINE_MUTEX(hci_smd_enable);
 
 static int restart_in_progress;
 
+/* ACL writes within this many us share one interrupt to the remote */
+static unsigned int tx_coalesce_us = 100;
+module_param(tx_coalesce_us, uint, 0644);
+MODULE_PARM_DESC(tx_coalesce_us, "ACL write interrupt coalescing in us");
+
 static int hcismd_set_enable(const char *val, struct kernel_param *kp);
 #if 1 
 module_param_call(hcismd_set, hcismd_set_enable, param_get_uint, &hcismd_set, 0644);
@@ -55,6 +66,21 @@ module_param_call(hcismd_set, hcismd_set_enable, NULL, &hcismd_set, 0644);
 static void hci_dev_smd_open(struct work_struct *worker);
 static void hci_dev_restart(struct work_struct *worker);
 
+enum {
+	HCI_SMD_EVENT,
+	HCI_SMD_DATA,
+	HCI_SMD_NR_CHANNELS,
+};
+
+struct hci_smd_stats {
+	unsigned long rx_pkts;
+	unsigned long rx_bytes;
+	unsigned long rx_batches;
+	unsigned long tx_pkts;
+	unsigned long tx_bytes;
+	unsigned long wakeups;
+};
+
 struct hci_smd_data {
 	struct hci_dev *hdev;
 	unsigned long flags;
@@ -64,6 +90,9 @@ struct hci_smd_data {
 	struct wake_lock wake_lock_rx;
 	struct timer_list rx_q_timer;
 	struct tasklet_struct rx_task;
+	struct hci_smd_stats stats[HCI_SMD_NR_CHANNELS];
+	unsigned long stats_since;
+	struct dentry *debugfs;
 };
 static struct hci_smd_data hs;
 
@@ -130,56 +159,81 @@ static void hci_smd_destruct(struct hci_dev *hdev)
 		kfree(hdev->driver_data);
 }
 
-static void hci_smd_recv_data(void)
+/*
+ * Read up to HCI_SMD_RX_BATCH complete ACL packets with one smd_readv().
+ * A2DP and OPP streams are made of equally sized packets, so buffers are
+ * sized for the current one and as many allocated as the fifo looks to
+ * hold; a larger packet ends the batch and starts the next one.  Returns
+ * the number of packets read, 0 when none is complete yet.
+ */
+static int hci_smd_recv_data(void)
 {
-	int len = 0;
-	int rc = 0;
-	struct sk_buff *skb = NULL;
 	struct hci_smd_data *hsmd = &hs;
+	struct hci_smd_stats *st = &hsmd->stats[HCI_SMD_DATA];
+	struct sk_buff *skbs[HCI_SMD_RX_BATCH];
+	struct kvec vec[HCI_SMD_RX_BATCH];
+	int len, n, got, i;
 	wake_lock(&hs.wake_lock_rx);
 
-	len = smd_read_avail(hsmd->data_channel);
+	got = 0;
+	len = smd_cur_packet_size(hsmd->data_channel);
 	if (len > HCI_MAX_FRAME_SIZE) {
 		BT_ERR("Frame larger than the allowed size, flushing frame");
 		smd_read(hsmd->data_channel, NULL, len);
+		got = 1;
 		goto out_data;
 	}
 
-	if (len <= 0)
+	if (len <= 0 || smd_read_avail(hsmd->data_channel) < len)
 		goto out_data;
 
-	skb = bt_skb_alloc(len, GFP_ATOMIC);
-	if (!skb) {
+	n = smd_read_pending(hsmd->data_channel) / (len + HCI_SMD_PKT_HDR) + 1;
+	n = min(n, HCI_SMD_RX_BATCH);
+	for (i = 0; i < n; i++) {
+		skbs[i] = bt_skb_alloc(len, GFP_ATOMIC);
+		if (!skbs[i])
+			break;
+		vec[i].iov_base = skbs[i]->data;
+		vec[i].iov_len = len;
+	}
+	n = i;
+	if (!n) {
 		BT_ERR("Error in allocating socket buffer");
 		smd_read(hsmd->data_channel, NULL, len);
+		got = 1;
 		goto out_data;
 	}
 
-	rc = smd_read(hsmd->data_channel, skb_put(skb, len), len);
-	if (rc < len) {
-		BT_ERR("Error in reading from the channel");
-		goto out_data;
+	got = smd_readv(hsmd->data_channel, vec, n);
+	if (got <= 0) {
+		BT_ERR("Error in reading from the channel %d", got);
+		got = 0;
 	}
 
-	skb->dev = (void *)hsmd->hdev;
-	bt_cb(skb)->pkt_type = HCI_ACLDATA_PKT;
-	skb_orphan(skb);
+	for (i = 0; i < got; i++) {
+		skb_put(skbs[i], vec[i].iov_len);
+		skbs[i]->dev = (void *)hsmd->hdev;
+		bt_cb(skbs[i])->pkt_type = HCI_ACLDATA_PKT;
+		skb_orphan(skbs[i]);
+		st->rx_bytes += vec[i].iov_len;
 
-	rc = hci_recv_frame(skb);
-	if (rc < 0) {
-		BT_ERR("Error in passing the packet to HCI Layer");
-		skb = NULL;
-		goto out_data;
+		if (hci_recv_frame(skbs[i]) < 0)
+			BT_ERR("Error in passing the packet to HCI Layer");
 	}
+	for (; i < n; i++)
+		kfree_skb(skbs[i]);
 
-	BT_DBG("Rx Timer is starting");
-	mod_timer(&hsmd->rx_q_timer,
-			jiffies + msecs_to_jiffies(RX_Q_MONITOR));
+	if (got) {
+		st->rx_pkts += got;
+		st->rx_batches++;
+		BT_DBG("Rx Timer is starting");
+		mod_timer(&hsmd->rx_q_timer,
+				jiffies + msecs_to_jiffies(RX_Q_MONITOR));
+	}
 
 out_data:
 	release_lock();
-	if (rc)
-		kfree_skb(skb);
+	return got;
 }
 
 static void hci_smd_recv_event(void)
@@ -213,6 +267,8 @@ static void hci_smd_recv_event(void)
 
 		skb->dev = (void *)hsmd->hdev;
 		bt_cb(skb)->pkt_type = HCI_EVENT_PKT;
+		hsmd->stats[HCI_SMD_EVENT].rx_pkts++;
+		hsmd->stats[HCI_SMD_EVENT].rx_bytes += len;
 
 		skb_orphan(skb);
 
@@ -239,6 +295,7 @@ static int hci_smd_send_frame(struct sk_buff *skb)
 	int len;
 	int avail;
 	int ret = 0;
+	struct hci_smd_stats *st = NULL;
 	wake_lock(&hs.wake_lock_tx);
 
 	switch (bt_cb(skb)->pkt_type) {
@@ -253,6 +310,7 @@ static int hci_smd_send_frame(struct sk_buff *skb)
 			BT_ERR("Failed to write Command %d", len);
 			ret = -ENODEV;
 		}
+		st = &hs.stats[HCI_SMD_EVENT];
 		break;
 	case HCI_ACLDATA_PKT:
 	case HCI_SCODATA_PKT:
@@ -266,6 +324,7 @@ static int hci_smd_send_frame(struct sk_buff *skb)
 			BT_ERR("Failed to write Data %d", len);
 			ret = -ENODEV;
 		}
+		st = &hs.stats[HCI_SMD_DATA];
 		break;
 	default:
 		BT_ERR("Uknown packet type");
@@ -273,6 +332,11 @@ static int hci_smd_send_frame(struct sk_buff *skb)
 		break;
 	}
 
+	if (st && !ret) {
+		st->tx_pkts++;
+		st->tx_bytes += skb->len;
+	}
+
 	kfree_skb(skb);
 	wake_unlock(&hs.wake_lock_tx);
 	return ret;
@@ -281,12 +345,14 @@ static int hci_smd_send_frame(struct sk_buff *skb)
 static void hci_smd_rx(unsigned long arg)
 {
 	struct hci_smd_data *hsmd = &hs;
+	int more;
 
-	while ((smd_read_avail(hsmd->event_channel) > 0) ||
-				(smd_read_avail(hsmd->data_channel) > 0)) {
+	/* A partly written packet is picked up on the next notification */
+	do {
 		hci_smd_recv_event();
-		hci_smd_recv_data();
-	}
+		more = hci_smd_recv_data() > 0 ||
+			smd_read_avail(hsmd->event_channel) > 0;
+	} while (more);
 }
 
 static void hci_smd_notify_event(void *data, unsigned int event)
@@ -305,6 +371,7 @@ static void hci_smd_notify_event(void *data, unsigned int event)
 
 	switch (event) {
 	case SMD_EVENT_DATA:
+		hsmd->stats[HCI_SMD_EVENT].wakeups++;
 		len = smd_read_avail(hsmd->event_channel);
 		if (len > 0)
 			tasklet_hi_schedule(&hs.rx_task);
@@ -352,6 +419,7 @@ static void hci_smd_notify_data(void *data, unsigned int event)
 
 	switch (event) {
 	case SMD_EVENT_DATA:
+		hsmd->stats[HCI_SMD_DATA].wakeups++;
 		len = smd_read_avail(hsmd->data_channel);
 		if (len > 0)
 			tasklet_hi_schedule(&hs.rx_task);
@@ -441,6 +509,7 @@ static int hci_smd_register_smd(struct hci_smd_data *hsmd)
 	
 	smd_disable_read_intr(hsmd->event_channel);
 	smd_disable_read_intr(hsmd->data_channel);
+	smd_set_signal_delay(hsmd->data_channel, tx_coalesce_us);
 	return 0;
 }
 
@@ -560,6 +629,51 @@ done:
 	return ret;
 #endif 
 }
+static int hci_smd_stats_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[] = { EVENT_CHANNEL, DATA_CHANNEL };
+	unsigned long secs = (jiffies - hs.stats_since) / HZ;
+	struct hci_smd_stats *st;
+	int i;
+
+	for (i = 0; i < HCI_SMD_NR_CHANNELS; i++) {
+		st = &hs.stats[i];
+		seq_printf(s, "%s:\n", names[i]);
+		seq_printf(s, "  rx %lu pkts %lu bytes in %lu batches, "
+			   "%lu wakeups\n", st->rx_pkts, st->rx_bytes,
+			   st->rx_batches, st->wakeups);
+		seq_printf(s, "  tx %lu pkts %lu bytes\n",
+			   st->tx_pkts, st->tx_bytes);
+		if (secs)
+			seq_printf(s, "  rx %lu B/s tx %lu B/s over %lus\n",
+				   st->rx_bytes / secs, st->tx_bytes / secs,
+				   secs);
+	}
+	return 0;
+}
+
+static int hci_smd_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hci_smd_stats_show, NULL);
+}
+
+/* Any write clears the counters */
+static ssize_t hci_smd_stats_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	memset(hs.stats, 0, sizeof(hs.stats));
+	hs.stats_since = jiffies;
+	return count;
+}
+
+static const struct file_operations hci_smd_stats_fops = {
+	.open		= hci_smd_stats_open,
+	.read		= seq_read,
+	.write		= hci_smd_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int  __init hci_smd_init(void)
 {
 	wake_lock_init(&hs.wake_lock_rx, WAKE_LOCK_SUSPEND,
@@ -568,12 +682,16 @@ static int  __init hci_smd_init(void)
 			 "msm_smd_Tx");
 	restart_in_progress = 0;
 	hs.hdev = NULL;
+	hs.stats_since = jiffies;
+	hs.debugfs = debugfs_create_file("hci_smd", S_IRUSR | S_IWUSR, NULL,
+					 NULL, &hci_smd_stats_fops);
 	return 0;
 }
 module_init(hci_smd_init);
 
 static void __exit hci_smd_exit(void)
 {
+	debugfs_remove(hs.debugfs);
 	wake_lock_destroy(&hs.wake_lock_rx);
 	wake_lock_destroy(&hs.wake_lock_tx);
 }
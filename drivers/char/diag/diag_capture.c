@@ -0,0 +1,289 @@
+/* Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
+#include <linux/bitops.h>
+#include <linux/log2.h>
+#include <linux/diagchar.h>
+#include "diagchar_hdlc.h"
+#include "diag_dci.h"
+#include "diag_capture.h"
+
+/* HDLC trailer: CRC16 and the control character */
+#define CAPTURE_HDLC_TRAILER	3
+/* cmd, more, len, log len, log code */
+#define CAPTURE_LOG_HDR_SIZE	8
+
+static DEFINE_MUTEX(capture_mutex);
+static DECLARE_WAIT_QUEUE_HEAD(capture_wait_q);
+static struct diag_capture_ring *capture_ring;
+static unsigned char *capture_data;
+static unsigned long *capture_log_mask;
+static unsigned char *capture_pkt;
+static struct diag_hdlc_decode_type capture_hdlc;
+static int capture_skip;
+static unsigned int capture_watermark;
+static unsigned int capture_avail;
+static int capture_mmap_cnt;
+static int capture_on;
+
+int diag_capture_active(void)
+{
+	return capture_on;
+}
+
+static void capture_free(void)
+{
+	vfree(capture_ring);
+	kfree(capture_log_mask);
+	kfree(capture_pkt);
+	capture_ring = NULL;
+	capture_data = NULL;
+	capture_log_mask = NULL;
+	capture_pkt = NULL;
+}
+
+int diag_capture_start(void __user *arg)
+{
+	struct diag_capture_config cfg;
+	unsigned int size;
+
+	if (copy_from_user(&cfg, arg, sizeof(cfg)))
+		return -EFAULT;
+
+	size = clamp_t(unsigned int, cfg.size, DIAG_CAPTURE_MIN_SIZE,
+			DIAG_CAPTURE_MAX_SIZE);
+	size = roundup_pow_of_two(size);
+
+	mutex_lock(&capture_mutex);
+	if (capture_ring) {
+		mutex_unlock(&capture_mutex);
+		return -EBUSY;
+	}
+
+	capture_ring = vmalloc_user(PAGE_SIZE + size);
+	capture_log_mask = kzalloc(DIAG_CAPTURE_LOG_MASK_SIZE, GFP_KERNEL);
+	capture_pkt = kmalloc(DIAG_CAPTURE_PKT_SIZE, GFP_KERNEL);
+	if (!capture_ring || !capture_log_mask || !capture_pkt) {
+		pr_err("diag: %s, Error allocating memory\n", __func__);
+		capture_free();
+		mutex_unlock(&capture_mutex);
+		return -ENOMEM;
+	}
+
+	capture_data = (unsigned char *)capture_ring + PAGE_SIZE;
+	capture_ring->size = size;
+	capture_watermark = cfg.watermark;
+	if (!capture_watermark || capture_watermark > size / 2)
+		capture_watermark = size / 4;
+
+	memset(&capture_hdlc, 0, sizeof(capture_hdlc));
+	capture_hdlc.dest_ptr = capture_pkt;
+	capture_hdlc.dest_size = DIAG_CAPTURE_PKT_SIZE;
+	capture_skip = 0;
+	capture_avail = 0;
+	capture_on = 1;
+	mutex_unlock(&capture_mutex);
+
+	return 0;
+}
+
+int diag_capture_stop(void)
+{
+	mutex_lock(&capture_mutex);
+	if (!capture_ring) {
+		mutex_unlock(&capture_mutex);
+		return 0;
+	}
+	if (capture_mmap_cnt) {
+		mutex_unlock(&capture_mutex);
+		return -EBUSY;
+	}
+	capture_on = 0;
+	capture_free();
+	mutex_unlock(&capture_mutex);
+	wake_up_interruptible(&capture_wait_q);
+
+	return 0;
+}
+
+int diag_capture_set_log_mask(void __user *arg)
+{
+	int ret = 0;
+
+	mutex_lock(&capture_mutex);
+	if (!capture_log_mask)
+		ret = -ENODEV;
+	else if (copy_from_user(capture_log_mask, arg,
+				DIAG_CAPTURE_LOG_MASK_SIZE))
+		ret = -EFAULT;
+	mutex_unlock(&capture_mutex);
+
+	return ret;
+}
+
+/*
+ * Returns the bytes pending in the ring once the watermark is reached or
+ * the timeout, 0 for none, runs out.
+ */
+int diag_capture_wait(unsigned long timeout_ms)
+{
+	long left = timeout_ms ? msecs_to_jiffies(timeout_ms) :
+				 MAX_SCHEDULE_TIMEOUT;
+	int ret;
+
+	for (;;) {
+		left = wait_event_interruptible_timeout(capture_wait_q,
+				!capture_on || capture_avail >= capture_watermark,
+				left);
+		if (left < 0)
+			return left;
+
+		mutex_lock(&capture_mutex);
+		if (!capture_on) {
+			mutex_unlock(&capture_mutex);
+			return -ENODEV;
+		}
+		capture_avail = capture_ring->head - capture_ring->tail;
+		ret = capture_avail;
+		mutex_unlock(&capture_mutex);
+
+		if (ret >= capture_watermark || !left)
+			return ret;
+	}
+}
+
+static void capture_vm_open(struct vm_area_struct *vma)
+{
+	mutex_lock(&capture_mutex);
+	capture_mmap_cnt++;
+	mutex_unlock(&capture_mutex);
+}
+
+static void capture_vm_close(struct vm_area_struct *vma)
+{
+	mutex_lock(&capture_mutex);
+	capture_mmap_cnt--;
+	mutex_unlock(&capture_mutex);
+}
+
+static const struct vm_operations_struct capture_vm_ops = {
+	.open = capture_vm_open,
+	.close = capture_vm_close,
+};
+
+int diag_capture_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int ret;
+
+	mutex_lock(&capture_mutex);
+	if (!capture_ring) {
+		mutex_unlock(&capture_mutex);
+		return -ENODEV;
+	}
+
+	ret = remap_vmalloc_range(vma, capture_ring, vma->vm_pgoff);
+	if (!ret) {
+		vma->vm_ops = &capture_vm_ops;
+		capture_mmap_cnt++;
+	}
+	mutex_unlock(&capture_mutex);
+
+	return ret;
+}
+
+static void capture_copy(unsigned int pos, const void *src, unsigned int len)
+{
+	unsigned int mask = capture_ring->size - 1;
+	unsigned int off = pos & mask;
+	unsigned int first = min(len, capture_ring->size - off);
+
+	memcpy(capture_data + off, src, first);
+	if (len > first)
+		memcpy(capture_data, src + first, len - first);
+}
+
+static void capture_record(const unsigned char *pkt, unsigned int len)
+{
+	struct diag_capture_ring *ring = capture_ring;
+	unsigned int head = ring->head;
+	unsigned int used = head - ring->tail;
+	unsigned int rec, code;
+	uint32_t rec_len;
+
+	if (len < CAPTURE_LOG_HDR_SIZE + CAPTURE_HDLC_TRAILER)
+		return;
+	len -= CAPTURE_HDLC_TRAILER;
+	if (pkt[0] != LOG_CMD_CODE)
+		return;
+	code = pkt[6] | (pkt[7] << 8);
+	if (!test_bit(code, capture_log_mask))
+		return;
+
+	rec = ALIGN(sizeof(rec_len) + len, 4);
+	if (used > ring->size || rec > ring->size - used) {
+		ring->dropped++;
+		return;
+	}
+
+	rec_len = len;
+	capture_copy(head, &rec_len, sizeof(rec_len));
+	capture_copy(head + sizeof(rec_len), pkt, len);
+	smp_wmb();
+	ring->head = head + rec;
+}
+
+/*
+ * Called with each buffer of HDLC encoded peripheral traffic.  Frames are
+ * decoded one at a time, a frame split across buffers is carried over.
+ */
+void diag_capture_feed(const unsigned char *buf, int len)
+{
+	struct diag_hdlc_decode_type *hdlc = &capture_hdlc;
+
+	mutex_lock(&capture_mutex);
+	if (!capture_on || len <= 0) {
+		mutex_unlock(&capture_mutex);
+		return;
+	}
+
+	hdlc->src_ptr = (uint8_t *)buf;
+	hdlc->src_idx = 0;
+	hdlc->src_size = len;
+	while (hdlc->src_idx < hdlc->src_size) {
+		if (hdlc->dest_idx >= hdlc->dest_size) {
+			/* Too long to capture, skip to the next frame */
+			capture_skip = 1;
+			hdlc->dest_idx = 0;
+		}
+		if (!diag_hdlc_decode(hdlc))
+			continue;
+
+		if (capture_skip) {
+			capture_skip = 0;
+			capture_ring->dropped++;
+		} else {
+			capture_record(capture_pkt, hdlc->dest_idx);
+		}
+		hdlc->dest_idx = 0;
+	}
+
+	capture_avail = capture_ring->head - capture_ring->tail;
+	if (capture_avail >= capture_watermark)
+		wake_up_interruptible(&capture_wait_q);
+	mutex_unlock(&capture_mutex);
+}
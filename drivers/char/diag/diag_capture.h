@@ -0,0 +1,30 @@
+/* Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef DIAG_CAPTURE_H
+#define DIAG_CAPTURE_H
+
+#define DIAG_CAPTURE_MAX_SIZE		(16 * 1024 * 1024)
+#define DIAG_CAPTURE_MIN_SIZE		(64 * 1024)
+#define DIAG_CAPTURE_PKT_SIZE		8192
+
+struct file;
+struct vm_area_struct;
+
+int diag_capture_start(void __user *arg);
+int diag_capture_stop(void);
+int diag_capture_set_log_mask(void __user *arg);
+int diag_capture_wait(unsigned long timeout_ms);
+int diag_capture_mmap(struct file *file, struct vm_area_struct *vma);
+int diag_capture_active(void);
+void diag_capture_feed(const unsigned char *buf, int len);
+
+#endif
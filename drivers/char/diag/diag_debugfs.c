@@ -14,11 +14,16 @@
 
 #include <linux/slab.h>
 #include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/random.h>
 #include "diagchar.h"
+#include "diagchar_hdlc.h"
 #include "diagfwd.h"
 #include "diagfwd_bridge.h"
 
 #define DEBUG_BUF_SIZE	4096
+#define HDLC_BENCH_PKT_SIZE	4096
+#define HDLC_BENCH_LOOPS	256
 static struct dentry *diag_dbgfs_dent;
 static int diag_dbgfs_table_index;
 
@@ -268,6 +273,80 @@ const struct file_operations diag_dbgfs_bridge_ops = {
 };
 #endif
 
+/* Returns the encoder throughput in KB/s over HDLC_BENCH_LOOPS packets */
+static unsigned long diag_hdlc_bench(const uint8_t *pkt, uint8_t *dest)
+{
+	struct diag_send_desc_type send;
+	struct diag_hdlc_dest_type enc;
+	ktime_t start;
+	s64 us;
+	int i;
+
+	start = ktime_get();
+	for (i = 0; i < HDLC_BENCH_LOOPS; i++) {
+		send.state = DIAG_STATE_START;
+		send.pkt = pkt;
+		send.last = pkt + HDLC_BENCH_PKT_SIZE - 1;
+		send.terminate = 1;
+		enc.dest = dest;
+		enc.dest_last = dest + 2 * HDLC_BENCH_PKT_SIZE + 3;
+		diag_hdlc_encode(&send, &enc);
+	}
+	us = ktime_us_delta(ktime_get(), start);
+	if (us <= 0)
+		us = 1;
+
+	return (unsigned long)div64_s64((s64)HDLC_BENCH_PKT_SIZE *
+				HDLC_BENCH_LOOPS * 1000, us * 1024);
+}
+
+static ssize_t diag_dbgfs_read_hdlc_bench(struct file *file,
+				char __user *ubuf, size_t count, loff_t *ppos)
+{
+	char *buf;
+	uint8_t *pkt, *dest;
+	unsigned long plain, mixed, escaped;
+	int ret;
+
+	if (*ppos)
+		return 0;
+
+	buf = kzalloc(sizeof(char) * DEBUG_BUF_SIZE, GFP_KERNEL);
+	pkt = kmalloc(HDLC_BENCH_PKT_SIZE, GFP_KERNEL);
+	dest = kmalloc(2 * HDLC_BENCH_PKT_SIZE + 4, GFP_KERNEL);
+	if (!buf || !pkt || !dest) {
+		pr_err("diag: %s, Error allocating memory\n", __func__);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	memset(pkt, 0x55, HDLC_BENCH_PKT_SIZE);
+	plain = diag_hdlc_bench(pkt, dest);
+	get_random_bytes(pkt, HDLC_BENCH_PKT_SIZE);
+	mixed = diag_hdlc_bench(pkt, dest);
+	memset(pkt, CONTROL_CHAR, HDLC_BENCH_PKT_SIZE);
+	escaped = diag_hdlc_bench(pkt, dest);
+
+	ret = scnprintf(buf, DEBUG_BUF_SIZE,
+		"hdlc encode, %d x %d bytes\n"
+		"no escapes: %lu KB/s\n"
+		"random: %lu KB/s\n"
+		"all escaped: %lu KB/s\n",
+		HDLC_BENCH_LOOPS, HDLC_BENCH_PKT_SIZE,
+		plain, mixed, escaped);
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, ret);
+out:
+	kfree(dest);
+	kfree(pkt);
+	kfree(buf);
+	return ret;
+}
+
+const struct file_operations diag_dbgfs_hdlc_bench_ops = {
+	.read = diag_dbgfs_read_hdlc_bench,
+};
+
 const struct file_operations diag_dbgfs_status_ops = {
 	.read = diag_dbgfs_read_status,
 };
@@ -295,6 +374,9 @@ void diag_debugfs_init(void)
 	debugfs_create_file("work_pending", 0444, diag_dbgfs_dent, 0,
 		&diag_dbgfs_workpending_ops);
 
+	debugfs_create_file("hdlc_bench", 0444, diag_dbgfs_dent, 0,
+		&diag_dbgfs_hdlc_bench_ops);
+
 #ifdef CONFIG_DIAGFWD_BRIDGE_CODE
 	debugfs_create_file("bridge", 0444, diag_dbgfs_dent, 0,
 		&diag_dbgfs_bridge_ops);
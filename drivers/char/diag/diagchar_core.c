@@ -29,6 +29,7 @@
 #include "diagfwd.h"
 #include "diagfwd_cntl.h"
 #include "diag_dci.h"
+#include "diag_capture.h"
 #ifdef CONFIG_DIAG_SDIO_PIPE
 #include "diagfwd_sdio.h"
 #endif
@@ -353,6 +354,8 @@ static int diagchar_close(struct inode *inode, struct file *file)
 		(driver->callback_process->tgid == current->tgid)) {
 		driver->callback_process = NULL;
 	}
+	if (driver->logging_process_id == current->tgid)
+		diag_capture_stop();
 
 #ifdef CONFIG_DIAG_OVER_USB
 	
@@ -898,6 +901,16 @@ long diagchar_ioctl(struct file *filp,
 		mutex_unlock(&driver->diagchar_mutex);
 
 		success = 1;
+	} else if (iocmd == DIAG_IOCTL_CAPTURE_START) {
+		if (driver->logging_mode != MEMORY_DEVICE_MODE)
+			return -EINVAL;
+		return diag_capture_start((void __user *)ioarg);
+	} else if (iocmd == DIAG_IOCTL_CAPTURE_STOP) {
+		return diag_capture_stop();
+	} else if (iocmd == DIAG_IOCTL_CAPTURE_LOG_MASK) {
+		return diag_capture_set_log_mask((void __user *)ioarg);
+	} else if (iocmd == DIAG_IOCTL_CAPTURE_WAIT) {
+		return diag_capture_wait(ioarg);
 	}
 
 	return success;
@@ -1722,6 +1735,7 @@ static const struct file_operations diagcharfops = {
 	.read = diagchar_read,
 	.write = diagchar_write,
 	.unlocked_ioctl = diagchar_ioctl,
+	.mmap = diag_capture_mmap,
 	.open = diagchar_open,
 	.release = diagchar_close
 };
@@ -18,6 +18,7 @@
 #include <linux/device.h>
 #include <linux/uaccess.h>
 #include <linux/crc-ccitt.h>
+#include <asm/unaligned.h>
 #include "diagchar_hdlc.h"
 #include "diagchar.h"
 
@@ -29,6 +30,30 @@ MODULE_LICENSE("GPL v2");
 #define CRC_16_L_STEP(xx_crc, xx_c) \
 	crc_ccitt_byte(xx_crc, xx_c)
 
+#define HDLC_ONES	0x01010101U
+#define HDLC_HIGHS	0x80808080U
+#define HDLC_HAS_BYTE(w, c) \
+	((((w) ^ ((c) * HDLC_ONES)) - HDLC_ONES) & \
+	 ~((w) ^ ((c) * HDLC_ONES)) & HDLC_HIGHS)
+
+/* First byte in [src, end) that has to be escaped, a word at a time */
+static const uint8_t *diag_hdlc_plain_end(const uint8_t *src,
+					  const uint8_t *end)
+{
+	uint32_t w;
+
+	while (end - src >= 4) {
+		w = get_unaligned((const uint32_t *)src);
+		if (HDLC_HAS_BYTE(w, CONTROL_CHAR) ||
+		    HDLC_HAS_BYTE(w, ESC_CHAR))
+			break;
+		src += 4;
+	}
+	while (src < end && *src != CONTROL_CHAR && *src != ESC_CHAR)
+		src++;
+	return src;
+}
+
 void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 		      struct diag_hdlc_dest_type *enc)
 {
@@ -40,6 +65,7 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 	unsigned char src_byte = 0;
 	enum diag_send_state_enum_type state;
 	unsigned int used = 0;
+	unsigned int run;
 
 	if (src_desc && enc) {
 
@@ -61,6 +87,18 @@ void diag_hdlc_encode(struct diag_send_desc_type *src_desc,
 		if (dest && dest_last) {
 			while (src <= src_last && dest <= dest_last) {
 
+				/* Bytes needing no escape are copied as a run */
+				run = min(src_last - src, dest_last - dest) + 1;
+				run = diag_hdlc_plain_end(src, src + run) - src;
+				if (run) {
+					memcpy(dest, src, run);
+					crc = crc_ccitt(crc, src, run);
+					src += run;
+					dest += run;
+					used += run;
+					continue;
+				}
+
 				src_byte = *src++;
 
 				if ((src_byte == CONTROL_CHAR) ||
@@ -41,6 +41,7 @@
 #include "diag_dci.h"
 #include "diag_masks.h"
 #include "diagfwd_bridge.h"
+#include "diag_capture.h"
 
 #define MODE_CMD		41
 #define RESET_ID		2
@@ -329,6 +330,44 @@ drop:
 	}
 }
 
+/*
+ * In capture mode peripheral buffers are filtered into the capture ring
+ * and handed straight back to the SMD read path, the logging process is
+ * not woken per buffer.
+ */
+static int diag_capture_buffer(void *buf, int proc_num,
+			       struct diag_request *write_ptr)
+{
+	if (proc_num == MODEM_DATA) {
+		diag_capture_feed(buf, write_ptr->length);
+		if (buf == driver->buf_in_1)
+			driver->in_busy_1 = 0;
+		else if (buf == driver->buf_in_2)
+			driver->in_busy_2 = 0;
+		queue_work(driver->diag_wq, &(driver->diag_read_smd_work));
+	} else if (proc_num == LPASS_DATA) {
+		diag_capture_feed(buf, write_ptr->length);
+		if (buf == driver->buf_in_lpass_1)
+			driver->in_busy_lpass_1 = 0;
+		else if (buf == driver->buf_in_lpass_2)
+			driver->in_busy_lpass_2 = 0;
+		queue_work(driver->diag_wq,
+			&(driver->diag_read_smd_lpass_work));
+	} else if (proc_num == WCNSS_DATA) {
+		diag_capture_feed(buf, write_ptr->length);
+		if (buf == driver->buf_in_wcnss_1)
+			driver->in_busy_wcnss_1 = 0;
+		else if (buf == driver->buf_in_wcnss_2)
+			driver->in_busy_wcnss_2 = 0;
+		queue_work(driver->diag_wq,
+			&(driver->diag_read_smd_wcnss_work));
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
 int diag_device_write(void *buf, int proc_num, struct diag_request *write_ptr)
 {
 	int i, err = 0;
@@ -337,6 +376,9 @@ int diag_device_write(void *buf, int proc_num, struct diag_request *write_ptr)
 	pr_debug("proc_num: %d, logging_mode: %d\n",
 		proc_num, driver->logging_mode);
 	if (driver->logging_mode == MEMORY_DEVICE_MODE) {
+		if (diag_capture_active() && write_ptr &&
+		    diag_capture_buffer(buf, proc_num, write_ptr))
+			return 0;
 		if (proc_num == APPS_DATA) {
 			for (i = 0; i < driver->poolsize_write_struct; i++)
 				if (driver->buf_tbl[i].length == 0) {
@@ -22,6 +22,10 @@
 #include <linux/io.h>
 #include <linux/err.h>
 #include <linux/types.h>
+#include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/random.h>
+#include <linux/workqueue.h>
 #include <mach/msm_iomap.h>
 #include <mach/socinfo.h>
 
@@ -40,66 +44,151 @@
 #define MAX_HW_FIFO_DEPTH 16                     
 #define MAX_HW_FIFO_SIZE (MAX_HW_FIFO_DEPTH * 4) 
 
+/* Words kept read ahead, refilled with the clock on once it gets low */
+#define POOL_WORDS		256
+#define POOL_LOW_WORDS		(POOL_WORDS / 4)
+#define FIFO_EMPTY_SPINS	64
+
+#define FEED_BYTES		32
+#define FEED_FAST_MS		10
+#define FEED_IDLE_MS		1000
 
 struct msm_rng_device {
 	struct platform_device *pdev;
 	void __iomem *base;
 	struct clk *prng_clk;
+	struct mutex pool_lock;
+	u32 pool[POOL_WORDS];
+	unsigned int pool_avail;
+	struct work_struct refill_work;
+	struct delayed_work feed_work;
 };
 
+/*
+ * Bits of entropy credited to the input pool for every FEED_BYTES fed
+ * in while it is below the write wakeup threshold, 0 to feed nothing.
+ */
+static unsigned int feed_entropy = 64;
+module_param(feed_entropy, uint, S_IRUGO | S_IWUSR);
+
+/* Clock on, pool_lock held; up to words from the fifo, 0 when it is dry */
+static size_t msm_rng_read_fifo(struct msm_rng_device *msm_rng_dev,
+				u32 *buf, size_t words, bool wait)
+{
+	void __iomem *base = msm_rng_dev->base;
+	unsigned int spins = 0;
+	size_t n = 0;
+	u32 val;
+
+	while (n < words) {
+		if (!(readl_relaxed(base + PRNG_STATUS_OFFSET) & 0x00000001)) {
+			if (!wait || ++spins > FIFO_EMPTY_SPINS)
+				break;
+			udelay(1);
+			continue;
+		}
+
+		val = readl_relaxed(base + PRNG_DATA_OUT_OFFSET);
+		if (!val)
+			break;
+		buf[n++] = val;
+	}
+	return n;
+}
+
+static void msm_rng_refill(struct work_struct *work)
+{
+	struct msm_rng_device *msm_rng_dev = container_of(work,
+				struct msm_rng_device, refill_work);
+
+	if (clk_prepare_enable(msm_rng_dev->prng_clk)) {
+		dev_err(&msm_rng_dev->pdev->dev,
+			"failed to enable clock for refill\n");
+		return;
+	}
+
+	mutex_lock(&msm_rng_dev->pool_lock);
+	msm_rng_dev->pool_avail += msm_rng_read_fifo(msm_rng_dev,
+				msm_rng_dev->pool + msm_rng_dev->pool_avail,
+				POOL_WORDS - msm_rng_dev->pool_avail, true);
+	mutex_unlock(&msm_rng_dev->pool_lock);
+
+	clk_disable_unprepare(msm_rng_dev->prng_clk);
+}
+
+/* Every word handed out is cleared, the pool never gives one out twice */
+static size_t msm_rng_take(struct msm_rng_device *msm_rng_dev, u32 *buf,
+			   size_t words)
+{
+	size_t n;
+
+	mutex_lock(&msm_rng_dev->pool_lock);
+	n = min_t(size_t, words, msm_rng_dev->pool_avail);
+	msm_rng_dev->pool_avail -= n;
+	memcpy(buf, msm_rng_dev->pool + msm_rng_dev->pool_avail, n * 4);
+	memset(msm_rng_dev->pool + msm_rng_dev->pool_avail, 0, n * 4);
+	if (msm_rng_dev->pool_avail < POOL_LOW_WORDS)
+		schedule_work(&msm_rng_dev->refill_work);
+	mutex_unlock(&msm_rng_dev->pool_lock);
+
+	return n;
+}
+
 static int msm_rng_read(struct hwrng *rng, void *data, size_t max, bool wait)
 {
 	struct msm_rng_device *msm_rng_dev;
 	struct platform_device *pdev;
-	void __iomem *base;
-	size_t maxsize;
-	size_t currsize = 0;
-	unsigned long val;
-	unsigned long *retdata = data;
+	size_t words = max / 4;
+	size_t n;
 	int ret;
 
 	msm_rng_dev = (struct msm_rng_device *)rng->priv;
 	pdev = msm_rng_dev->pdev;
-	base = msm_rng_dev->base;
-
-	
-	maxsize = min_t(size_t, MAX_HW_FIFO_SIZE, max);
 
 	
-	if (maxsize < 4)
+	if (!words)
 		return 0;
 
-	
+	n = msm_rng_take(msm_rng_dev, data, words);
+	if (n || !wait)
+		return n * 4;
+
+	/* The pool ran dry, read the fifo directly as before */
 	ret = clk_prepare_enable(msm_rng_dev->prng_clk);
 	if (ret) {
 		dev_err(&pdev->dev, "failed to enable clock in callback\n");
 		return 0;
 	}
 
-	
-	do {
-		
-		if (!(readl_relaxed(base + PRNG_STATUS_OFFSET) & 0x00000001))
-			break;	
+	mutex_lock(&msm_rng_dev->pool_lock);
+	n = msm_rng_read_fifo(msm_rng_dev, data,
+			      min_t(size_t, words, MAX_HW_FIFO_DEPTH), false);
+	mutex_unlock(&msm_rng_dev->pool_lock);
 
-		
-		val = readl_relaxed(base + PRNG_DATA_OUT_OFFSET);
-		if (!val)
-			break;	
-
-		
-		*(retdata++) = val;
-		currsize += 4;
+	clk_disable_unprepare(msm_rng_dev->prng_clk);
 
-		
-		if ((maxsize - currsize) < 4)
-			break;
-	} while (currsize < maxsize);
+	return n * 4;
+}
 
-	
-	clk_disable_unprepare(msm_rng_dev->prng_clk);
+/* Tops up the input pool from ours while random.c asks for more */
+static void msm_rng_feed(struct work_struct *work)
+{
+	struct msm_rng_device *msm_rng_dev = container_of(work,
+				struct msm_rng_device, feed_work.work);
+	u32 buf[FEED_BYTES / 4];
+	unsigned int delay = FEED_IDLE_MS;
+	size_t n;
+
+	if (feed_entropy) {
+		n = msm_rng_take(msm_rng_dev, buf, ARRAY_SIZE(buf));
+		if (n == ARRAY_SIZE(buf) &&
+		    !add_hwrng_randomness(buf, sizeof(buf), feed_entropy))
+			delay = FEED_FAST_MS;
+		memset(buf, 0, sizeof(buf));
+	}
 
-	return currsize;
+	schedule_delayed_work(&msm_rng_dev->feed_work,
+			      msecs_to_jiffies(delay));
 }
 
 static struct hwrng msm_rng = {
@@ -160,7 +249,7 @@ static int __devinit msm_rng_probe(struct platform_device *pdev)
 		goto err_exit;
 	}
 
-	msm_rng_dev = kzalloc(sizeof(msm_rng_dev), GFP_KERNEL);
+	msm_rng_dev = kzalloc(sizeof(*msm_rng_dev), GFP_KERNEL);
 	if (!msm_rng_dev) {
 		dev_err(&pdev->dev, "cannot allocate memory\n");
 		error = -ENOMEM;
@@ -185,6 +274,9 @@ static int __devinit msm_rng_probe(struct platform_device *pdev)
 
 	
 	msm_rng_dev->pdev = pdev;
+	mutex_init(&msm_rng_dev->pool_lock);
+	INIT_WORK(&msm_rng_dev->refill_work, msm_rng_refill);
+	INIT_DELAYED_WORK_DEFERRABLE(&msm_rng_dev->feed_work, msm_rng_feed);
 	platform_set_drvdata(pdev, msm_rng_dev);
 
 	
@@ -202,6 +294,8 @@ static int __devinit msm_rng_probe(struct platform_device *pdev)
 		goto rollback_clk;
 	}
 
+	schedule_work(&msm_rng_dev->refill_work);
+	schedule_delayed_work(&msm_rng_dev->feed_work, 0);
 	return 0;
 
 rollback_clk:
@@ -219,6 +313,8 @@ static int __devexit msm_rng_remove(struct platform_device *pdev)
 	struct msm_rng_device *msm_rng_dev = platform_get_drvdata(pdev);
 
 	hwrng_unregister(&msm_rng);
+	cancel_delayed_work_sync(&msm_rng_dev->feed_work);
+	cancel_work_sync(&msm_rng_dev->refill_work);
 	clk_put(msm_rng_dev->prng_clk);
 	iounmap(msm_rng_dev->base);
 	platform_set_drvdata(pdev, NULL);
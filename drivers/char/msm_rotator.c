@@ -23,12 +23,14 @@
 #include <linux/msm_rotator.h>
 #include <linux/io.h>
 #include <mach/msm_rotator_imem.h>
+#include <mach/autogate.h>
 #include <linux/ktime.h>
 #include <linux/workqueue.h>
 #include <linux/file.h>
 #include <linux/major.h>
 #include <linux/regulator/consumer.h>
 #include <linux/msm_ion.h>
+#include <linux/sw_sync.h>
 #ifdef CONFIG_MSM_BUS_SCALING
 #include <mach/msm_bus.h>
 #include <mach/msm_bus_board.h>
@@ -95,6 +97,9 @@
 #define ROTATOR_REVISION_V2		2
 #define ROTATOR_REVISION_NONE	0xffffffff
 
+#define MAX_QUEUED_JOBS		4
+#define ROT_FENCE_TIMEOUT	(10 * MSEC_PER_SEC)
+
 uint32_t rotator_hw_revision;
 static char rot_iommu_split_domain;
 
@@ -120,6 +125,26 @@ struct msm_rotator_fd_info {
 	struct list_head list;
 };
 
+struct msm_rotator_mapping {
+	int s;
+	unsigned int session_id;
+	unsigned int secure;
+	unsigned int in_paddr, out_paddr;
+	unsigned int in_chroma_paddr, out_chroma_paddr, in_chroma2_paddr;
+	struct file *srcp0_file, *dstp0_file;
+	struct file *srcp1_file, *dstp1_file;
+	struct ion_handle *srcp0_ihdl, *dstp0_ihdl;
+	struct ion_handle *srcp1_ihdl, *dstp1_ihdl;
+	int ps0_need;
+};
+
+struct msm_rotator_job {
+	struct list_head list;
+	struct msm_rotator_data_info info;
+	struct msm_rotator_mapping map;
+	struct sync_fence *acq_fence;
+};
+
 struct msm_rotator_dev {
 	void __iomem *io_base;
 	int irq;
@@ -128,9 +153,9 @@ struct msm_rotator_dev {
 	struct msm_rotator_fd_info *fd_info[MAX_SESSIONS];
 	struct list_head fd_list;
 	struct clk *pclk;
-	int rot_clk_state;
+	struct clk *rot_clks[2];
+	struct autogate rot_gate;
 	struct regulator *regulator;
-	struct delayed_work rot_clk_work;
 	struct clk *imem_clk;
 	int imem_clk_state;
 	struct delayed_work imem_clk_work;
@@ -142,10 +167,19 @@ struct msm_rotator_dev {
 	int processing;
 	int last_session_idx;
 	struct mutex rotator_lock;
+	struct mutex hw_lock;		/* held from kickoff to rotation done */
 	struct mutex imem_lock;
 	int imem_owner;
 	wait_queue_head_t wq;
 	struct ion_client *client;
+	struct mutex queue_lock;
+	struct list_head job_list;
+	int jobs_queued;
+	wait_queue_head_t queue_wq;
+	struct workqueue_struct *async_wq;
+	struct work_struct async_work;
+	struct sw_sync_timeline *timeline;
+	u32 timeline_max;
 	#ifdef CONFIG_MSM_BUS_SCALING
 	uint32_t bus_client_handle;
 	#endif
@@ -276,38 +310,6 @@ static void msm_rotator_imem_clk_work_f(struct work_struct *work)
 #endif
 }
 
-static void enable_rot_clks(void)
-{
-	if (msm_rotator_dev->regulator)
-		regulator_enable(msm_rotator_dev->regulator);
-	if (msm_rotator_dev->core_clk != NULL)
-		clk_prepare_enable(msm_rotator_dev->core_clk);
-	if (msm_rotator_dev->pclk != NULL)
-		clk_prepare_enable(msm_rotator_dev->pclk);
-}
-
-static void disable_rot_clks(void)
-{
-	if (msm_rotator_dev->core_clk != NULL)
-		clk_disable_unprepare(msm_rotator_dev->core_clk);
-	if (msm_rotator_dev->pclk != NULL)
-		clk_disable_unprepare(msm_rotator_dev->pclk);
-	if (msm_rotator_dev->regulator)
-		regulator_disable(msm_rotator_dev->regulator);
-}
-
-static void msm_rotator_rot_clk_work_f(struct work_struct *work)
-{
-	if (mutex_trylock(&msm_rotator_dev->rotator_lock)) {
-		if (msm_rotator_dev->rot_clk_state == CLK_EN) {
-			disable_rot_clks();
-			msm_rotator_dev->rot_clk_state = CLK_DIS;
-		} else if (msm_rotator_dev->rot_clk_state == CLK_SUSPEND)
-			msm_rotator_dev->rot_clk_state = CLK_DIS;
-		mutex_unlock(&msm_rotator_dev->rotator_lock);
-	}
-}
-
 static irqreturn_t msm_rotator_isr(int irq, void *dev_id)
 {
 	if (msm_rotator_dev->processing) {
@@ -931,30 +933,13 @@ static void put_img(struct file *p_file, struct ion_handle *p_ihdl,
 	}
 #endif
 }
-static int msm_rotator_do_rotate(unsigned long arg)
+static int msm_rotator_find_session(unsigned int session_id)
 {
-	unsigned int status, format;
-	struct msm_rotator_data_info info;
-	unsigned int in_paddr, out_paddr;
-	unsigned long src_len, dst_len;
-	int use_imem = 0, rc = 0, s, secure_flag = 0;
-	struct file *srcp0_file = NULL, *dstp0_file = NULL;
-	struct file *srcp1_file = NULL, *dstp1_file = NULL;
-	struct ion_handle *srcp0_ihdl = NULL, *dstp0_ihdl = NULL;
-	struct ion_handle *srcp1_ihdl = NULL, *dstp1_ihdl = NULL;
-	int ps0_need = 0, p_need;
-	unsigned int in_chroma_paddr = 0, out_chroma_paddr = 0;
-	unsigned int in_chroma2_paddr = 0;
-	struct msm_rotator_img_info *img_info;
-	struct msm_rotator_mem_planes src_planes, dst_planes;
-
-	if (copy_from_user(&info, (void __user *)arg, sizeof(info)))
-		return -EFAULT;
+	int s;
 
-	mutex_lock(&msm_rotator_dev->rotator_lock);
 	for (s = 0; s < MAX_SESSIONS; s++)
 		if ((msm_rotator_dev->img_info[s] != NULL) &&
-			(info.session_id ==
+			(session_id ==
 			(unsigned int)msm_rotator_dev->img_info[s]
 			))
 			break;
@@ -962,149 +947,202 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	if (s == MAX_SESSIONS) {
 		pr_err("%s() : Attempt to use invalid session_id %d\n",
 			__func__, s);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
 	if (msm_rotator_dev->img_info[s]->enable == 0) {
 		dev_dbg(msm_rotator_dev->device,
 			"%s() : Session_id %d not enabled \n",
 			__func__, s);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
-	img_info = msm_rotator_dev->img_info[s];
+	return s;
+}
+
+static void msm_rotator_unmap(struct msm_rotator_data_info *info,
+			      struct msm_rotator_mapping *m)
+{
+	put_img(m->dstp1_file, m->dstp1_ihdl, ROTATOR_DST_DOMAIN, m->secure);
+	put_img(m->srcp1_file, m->srcp1_ihdl, ROTATOR_SRC_DOMAIN, 0);
+	put_img(m->dstp0_file, m->dstp0_ihdl, ROTATOR_DST_DOMAIN, m->secure);
+
+	if ((info->src.flags & MDP_MEMORY_ID_TYPE_FB) && m->srcp0_file)
+		fput_light(m->srcp0_file, m->ps0_need);
+	else
+		put_img(m->srcp0_file, m->srcp0_ihdl, ROTATOR_SRC_DOMAIN, 0);
+}
+
+/* Resolve and check every plane of info for session s.  rotator_lock held. */
+static int msm_rotator_map(struct msm_rotator_data_info *info, int s,
+			   struct msm_rotator_mapping *m)
+{
+	struct msm_rotator_img_info *img_info = msm_rotator_dev->img_info[s];
+	struct msm_rotator_mem_planes src_planes, dst_planes;
+	unsigned long src_len, dst_len;
+	int rc, p_need;
+
+	memset(m, 0, sizeof(*m));
+	m->s = s;
+	m->session_id = info->session_id;
+	m->secure = img_info->secure;
+
 	if (msm_rotator_get_plane_sizes(img_info->src.format,
 					img_info->src.width,
 					img_info->src.height,
 					&src_planes)) {
 		pr_err("%s: invalid src format\n", __func__);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 	if (msm_rotator_get_plane_sizes(img_info->dst.format,
 					img_info->dst.width,
 					img_info->dst.height,
 					&dst_planes)) {
 		pr_err("%s: invalid dst format\n", __func__);
-		rc = -EINVAL;
-		goto do_rotate_unlock_mutex;
+		return -EINVAL;
 	}
 
-	rc = get_img(&info.src, ROTATOR_SRC_DOMAIN, (unsigned long *)&in_paddr,
-			(unsigned long *)&src_len, &srcp0_file, &ps0_need,
-			&srcp0_ihdl, 0);
+	rc = get_img(&info->src, ROTATOR_SRC_DOMAIN,
+			(unsigned long *)&m->in_paddr,
+			(unsigned long *)&src_len, &m->srcp0_file,
+			&m->ps0_need, &m->srcp0_ihdl, 0);
 	if (rc) {
 		pr_err("%s: in get_img() failed id=0x%08x\n",
-			DRIVER_NAME, info.src.memory_id);
-		goto do_rotate_unlock_mutex;
+			DRIVER_NAME, info->src.memory_id);
+		goto map_err;
 	}
 
-	rc = get_img(&info.dst, ROTATOR_DST_DOMAIN, (unsigned long *)&out_paddr,
-			(unsigned long *)&dst_len, &dstp0_file, &p_need,
-			&dstp0_ihdl, img_info->secure);
+	rc = get_img(&info->dst, ROTATOR_DST_DOMAIN,
+			(unsigned long *)&m->out_paddr,
+			(unsigned long *)&dst_len, &m->dstp0_file, &p_need,
+			&m->dstp0_ihdl, img_info->secure);
 	if (rc) {
 		pr_err("%s: out get_img() failed id=0x%08x\n",
-		       DRIVER_NAME, info.dst.memory_id);
-		goto do_rotate_unlock_mutex;
+		       DRIVER_NAME, info->dst.memory_id);
+		goto map_err;
 	}
 
-	format = msm_rotator_dev->img_info[s]->src.format;
-	if (((info.version_key & VERSION_KEY_MASK) == 0xA5B4C300) &&
-			((info.version_key & ~VERSION_KEY_MASK) > 0) &&
+	if (((info->version_key & VERSION_KEY_MASK) == 0xA5B4C300) &&
+			((info->version_key & ~VERSION_KEY_MASK) > 0) &&
 			(src_planes.num_planes == 2)) {
-		if (checkoffset(info.src.offset,
+		if (checkoffset(info->src.offset,
 				src_planes.plane_size[0],
 				src_len)) {
 			pr_err("%s: invalid src buffer (len=%lu offset=%x)\n",
-			       __func__, src_len, info.src.offset);
+			       __func__, src_len, info->src.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto map_err;
 		}
-		if (checkoffset(info.dst.offset,
+		if (checkoffset(info->dst.offset,
 				dst_planes.plane_size[0],
 				dst_len)) {
 			pr_err("%s: invalid dst buffer (len=%lu offset=%x)\n",
-			       __func__, dst_len, info.dst.offset);
+			       __func__, dst_len, info->dst.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto map_err;
 		}
 
-		rc = get_img(&info.src_chroma, ROTATOR_SRC_DOMAIN,
-				(unsigned long *)&in_chroma_paddr,
-				(unsigned long *)&src_len, &srcp1_file, &p_need,
-				&srcp1_ihdl, 0);
+		rc = get_img(&info->src_chroma, ROTATOR_SRC_DOMAIN,
+				(unsigned long *)&m->in_chroma_paddr,
+				(unsigned long *)&src_len, &m->srcp1_file,
+				&p_need, &m->srcp1_ihdl, 0);
 		if (rc) {
 			pr_err("%s: in chroma get_img() failed id=0x%08x\n",
-				DRIVER_NAME, info.src_chroma.memory_id);
-			goto do_rotate_unlock_mutex;
+				DRIVER_NAME, info->src_chroma.memory_id);
+			goto map_err;
 		}
 
-		rc = get_img(&info.dst_chroma, ROTATOR_DST_DOMAIN,
-				(unsigned long *)&out_chroma_paddr,
-				(unsigned long *)&dst_len, &dstp1_file, &p_need,
-				&dstp1_ihdl, img_info->secure);
+		rc = get_img(&info->dst_chroma, ROTATOR_DST_DOMAIN,
+				(unsigned long *)&m->out_chroma_paddr,
+				(unsigned long *)&dst_len, &m->dstp1_file,
+				&p_need, &m->dstp1_ihdl, img_info->secure);
 		if (rc) {
 			pr_err("%s: out chroma get_img() failed id=0x%08x\n",
-				DRIVER_NAME, info.dst_chroma.memory_id);
-			goto do_rotate_unlock_mutex;
+				DRIVER_NAME, info->dst_chroma.memory_id);
+			goto map_err;
 		}
 
-		if (checkoffset(info.src_chroma.offset,
+		if (checkoffset(info->src_chroma.offset,
 				src_planes.plane_size[1],
 				src_len)) {
 			pr_err("%s: invalid chr src buf len=%lu offset=%x\n",
-			       __func__, src_len, info.src_chroma.offset);
+			       __func__, src_len, info->src_chroma.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto map_err;
 		}
 
-		if (checkoffset(info.dst_chroma.offset,
+		if (checkoffset(info->dst_chroma.offset,
 				src_planes.plane_size[1],
 				dst_len)) {
 			pr_err("%s: invalid chr dst buf len=%lu offset=%x\n",
-			       __func__, dst_len, info.dst_chroma.offset);
+			       __func__, dst_len, info->dst_chroma.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto map_err;
 		}
 
-		in_chroma_paddr += info.src_chroma.offset;
-		out_chroma_paddr += info.dst_chroma.offset;
+		m->in_chroma_paddr += info->src_chroma.offset;
+		m->out_chroma_paddr += info->dst_chroma.offset;
 	} else {
-		if (checkoffset(info.src.offset,
+		if (checkoffset(info->src.offset,
 				src_planes.total_size,
 				src_len)) {
 			pr_err("%s: invalid src buffer (len=%lu offset=%x)\n",
-			       __func__, src_len, info.src.offset);
+			       __func__, src_len, info->src.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto map_err;
 		}
-		if (checkoffset(info.dst.offset,
+		if (checkoffset(info->dst.offset,
 				dst_planes.total_size,
 				dst_len)) {
 			pr_err("%s: invalid dst buffer (len=%lu offset=%x)\n",
-			       __func__, dst_len, info.dst.offset);
+			       __func__, dst_len, info->dst.offset);
 			rc = -ERANGE;
-			goto do_rotate_unlock_mutex;
+			goto map_err;
 		}
 	}
 
-	in_paddr += info.src.offset;
-	out_paddr += info.dst.offset;
+	m->in_paddr += info->src.offset;
+	m->out_paddr += info->dst.offset;
 
-	if (!in_chroma_paddr && src_planes.num_planes >= 2)
-		in_chroma_paddr = in_paddr + src_planes.plane_size[0];
-	if (!out_chroma_paddr && dst_planes.num_planes >= 2)
-		out_chroma_paddr = out_paddr + dst_planes.plane_size[0];
+	if (!m->in_chroma_paddr && src_planes.num_planes >= 2)
+		m->in_chroma_paddr = m->in_paddr + src_planes.plane_size[0];
+	if (!m->out_chroma_paddr && dst_planes.num_planes >= 2)
+		m->out_chroma_paddr = m->out_paddr + dst_planes.plane_size[0];
 	if (src_planes.num_planes >= 3)
-		in_chroma2_paddr = in_chroma_paddr + src_planes.plane_size[1];
+		m->in_chroma2_paddr = m->in_chroma_paddr +
+			src_planes.plane_size[1];
 
-	cancel_delayed_work(&msm_rotator_dev->rot_clk_work);
-	if (msm_rotator_dev->rot_clk_state != CLK_EN) {
-		enable_rot_clks();
-		msm_rotator_dev->rot_clk_state = CLK_EN;
-	}
+	return 0;
+
+map_err:
+	msm_rotator_unmap(info, m);
+	return rc;
+}
+
+static void msm_rotator_release_hw(void)
+{
+	disable_irq(msm_rotator_dev->irq);
+#ifdef CONFIG_MSM_ROTATOR_USE_IMEM
+	msm_rotator_imem_free(ROTATOR_REQUEST);
+#endif
+	autogate_put(&msm_rotator_dev->rot_gate);
+}
+
+/*
+ * Program session s with the planes in m and start the rotator.  On
+ * success the hardware is running and msm_rotator_wait_done() must be
+ * called.  Caller holds hw_lock and rotator_lock.
+ */
+static int msm_rotator_kickoff(int s, struct msm_rotator_mapping *m)
+{
+	unsigned int format;
+	int use_imem = 0, rc = 0;
+
+	format = msm_rotator_dev->img_info[s]->src.format;
+
+	rc = autogate_get(&msm_rotator_dev->rot_gate);
+	if (rc)
+		return rc;
 	enable_irq(msm_rotator_dev->irq);
 
 #ifdef CONFIG_MSM_ROTATOR_USE_IMEM
@@ -1140,7 +1178,7 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	case MDP_YCBCR_H1V1:
 	case MDP_YCRCB_H1V1:
 		rc = msm_rotator_rgb_types(msm_rotator_dev->img_info[s],
-					   in_paddr, out_paddr,
+					   m->in_paddr, m->out_paddr,
 					   use_imem,
 					   msm_rotator_dev->last_session_idx
 								!= s);
@@ -1153,39 +1191,41 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	case MDP_Y_CRCB_H2V2_TILE:
 	case MDP_Y_CBCR_H2V2_TILE:
 		rc = msm_rotator_ycxcx_h2v2(msm_rotator_dev->img_info[s],
-					    in_paddr, out_paddr, use_imem,
+					    m->in_paddr, m->out_paddr, use_imem,
 					    msm_rotator_dev->last_session_idx
 								!= s,
-					    in_chroma_paddr,
-					    out_chroma_paddr,
-					    in_chroma2_paddr);
+					    m->in_chroma_paddr,
+					    m->out_chroma_paddr,
+					    m->in_chroma2_paddr);
 		break;
 	case MDP_Y_CBCR_H2V1:
 	case MDP_Y_CRCB_H2V1:
 		rc = msm_rotator_ycxcx_h2v1(msm_rotator_dev->img_info[s],
-					    in_paddr, out_paddr, use_imem,
+					    m->in_paddr, m->out_paddr, use_imem,
 					    msm_rotator_dev->last_session_idx
 								!= s,
-					    in_chroma_paddr,
-					    out_chroma_paddr);
+					    m->in_chroma_paddr,
+					    m->out_chroma_paddr);
 		break;
 	case MDP_YCBYCR_H2V1:
 	case MDP_YCRYCB_H2V1:
 		rc = msm_rotator_ycxycx(msm_rotator_dev->img_info[s],
-				in_paddr, out_paddr, use_imem,
+				m->in_paddr, m->out_paddr, use_imem,
 				msm_rotator_dev->last_session_idx != s,
-				out_chroma_paddr);
+				m->out_chroma_paddr);
 		break;
 	default:
 		rc = -EINVAL;
 		pr_err("%s(): Unsupported format %u\n", __func__, format);
-		goto do_rotate_exit;
+		msm_rotator_release_hw();
+		return rc;
 	}
 
 	if (rc != 0) {
 		msm_rotator_dev->last_session_idx = INVALID_SESSION;
 		pr_err("%s(): Invalid session error\n", __func__);
-		goto do_rotate_exit;
+		msm_rotator_release_hw();
+		return rc;
 	}
 
 	iowrite32(3, MSM_ROTATOR_INTR_ENABLE);
@@ -1193,6 +1233,14 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	msm_rotator_dev->processing = 1;
 	iowrite32(0x1, MSM_ROTATOR_START);
 
+	return 0;
+}
+
+static int msm_rotator_wait_done(void)
+{
+	unsigned int status;
+	int rc = 0;
+
 	wait_event(msm_rotator_dev->wq,
 		   (msm_rotator_dev->processing == 0));
 
@@ -1205,31 +1253,233 @@ static int msm_rotator_do_rotate(unsigned long arg)
 	iowrite32(0, MSM_ROTATOR_INTR_ENABLE);
 	iowrite32(3, MSM_ROTATOR_INTR_CLEAR);
 
-do_rotate_exit:
-	disable_irq(msm_rotator_dev->irq);
-#ifdef CONFIG_MSM_ROTATOR_USE_IMEM
-	msm_rotator_imem_free(ROTATOR_REQUEST);
-#endif
-	schedule_delayed_work(&msm_rotator_dev->rot_clk_work, HZ);
-do_rotate_unlock_mutex:
-	if (s < MAX_SESSIONS)
-		secure_flag = msm_rotator_dev->img_info[s]->secure;
+	msm_rotator_release_hw();
+	return rc;
+}
+
+static int msm_rotator_do_rotate(unsigned long arg)
+{
+	struct msm_rotator_data_info info;
+	struct msm_rotator_mapping m;
+	int rc = 0, s;
 
-	put_img(dstp1_file, dstp1_ihdl, ROTATOR_DST_DOMAIN, secure_flag);
-	put_img(srcp1_file, srcp1_ihdl, ROTATOR_SRC_DOMAIN, 0);
-	put_img(dstp0_file, dstp0_ihdl, ROTATOR_DST_DOMAIN, secure_flag);
+	if (copy_from_user(&info, (void __user *)arg, sizeof(info)))
+		return -EFAULT;
 
-	
-	if ((info.src.flags & MDP_MEMORY_ID_TYPE_FB) && srcp0_file)
-		fput_light(srcp0_file, ps0_need);
-	else
-		put_img(srcp0_file, srcp0_ihdl, ROTATOR_SRC_DOMAIN, 0);
+	mutex_lock(&msm_rotator_dev->hw_lock);
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	s = msm_rotator_find_session(info.session_id);
+	if (s < 0) {
+		rc = s;
+		goto do_rotate_unlock_mutex;
+	}
+
+	rc = msm_rotator_map(&info, s, &m);
+	if (rc)
+		goto do_rotate_unlock_mutex;
+
+	rc = msm_rotator_kickoff(s, &m);
+	if (!rc)
+		rc = msm_rotator_wait_done();
+
+	msm_rotator_unmap(&info, &m);
+do_rotate_unlock_mutex:
 	mutex_unlock(&msm_rotator_dev->rotator_lock);
+	mutex_unlock(&msm_rotator_dev->hw_lock);
 	dev_dbg(msm_rotator_dev->device, "%s() returning rc = %d\n",
 		__func__, rc);
 	return rc;
 }
 
+/*
+ * Queued rotations.  Buffers are resolved and mapped when the job is
+ * submitted, in the caller's context and while earlier jobs are still on
+ * the hardware, so the worker only waits for the acquire fence and kicks
+ * the rotator.  Jobs complete in order and each one advances the release
+ * timeline by one.
+ */
+static void msm_rotator_async_run(struct msm_rotator_job *job)
+{
+	struct msm_rotator_mapping *m = &job->map;
+	int rc;
+
+	if (job->acq_fence) {
+		rc = sync_fence_wait(job->acq_fence, ROT_FENCE_TIMEOUT);
+		sync_fence_put(job->acq_fence);
+		if (rc < 0) {
+			pr_err("%s: acquire fence wait failed %d\n",
+			       __func__, rc);
+			return;
+		}
+	}
+
+	mutex_lock(&msm_rotator_dev->hw_lock);
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	if ((unsigned int)msm_rotator_dev->img_info[m->s] != m->session_id ||
+	    !msm_rotator_dev->img_info[m->s]->enable) {
+		pr_debug("%s: session %x went away\n", __func__,
+			 m->session_id);
+		mutex_unlock(&msm_rotator_dev->rotator_lock);
+		mutex_unlock(&msm_rotator_dev->hw_lock);
+		return;
+	}
+	rc = msm_rotator_kickoff(m->s, m);
+	mutex_unlock(&msm_rotator_dev->rotator_lock);
+
+	/* the next submission can map its buffers meanwhile */
+	if (!rc)
+		rc = msm_rotator_wait_done();
+	mutex_unlock(&msm_rotator_dev->hw_lock);
+
+	if (rc)
+		pr_err("%s: rotation failed %d\n", __func__, rc);
+}
+
+static void msm_rotator_async_work_f(struct work_struct *work)
+{
+	struct msm_rotator_job *job;
+
+	for (;;) {
+		mutex_lock(&msm_rotator_dev->queue_lock);
+		if (list_empty(&msm_rotator_dev->job_list)) {
+			mutex_unlock(&msm_rotator_dev->queue_lock);
+			break;
+		}
+		job = list_first_entry(&msm_rotator_dev->job_list,
+				       struct msm_rotator_job, list);
+		list_del(&job->list);
+		mutex_unlock(&msm_rotator_dev->queue_lock);
+
+		msm_rotator_async_run(job);
+		msm_rotator_unmap(&job->info, &job->map);
+
+		mutex_lock(&msm_rotator_dev->queue_lock);
+		sw_sync_timeline_inc(msm_rotator_dev->timeline, 1);
+		msm_rotator_dev->jobs_queued--;
+		mutex_unlock(&msm_rotator_dev->queue_lock);
+		wake_up(&msm_rotator_dev->queue_wq);
+
+		kfree(job);
+	}
+}
+
+static int msm_rotator_job_reserve(void)
+{
+	int rc;
+
+	mutex_lock(&msm_rotator_dev->queue_lock);
+	while (msm_rotator_dev->jobs_queued >= MAX_QUEUED_JOBS) {
+		mutex_unlock(&msm_rotator_dev->queue_lock);
+		rc = wait_event_interruptible(msm_rotator_dev->queue_wq,
+			msm_rotator_dev->jobs_queued < MAX_QUEUED_JOBS);
+		if (rc)
+			return rc;
+		mutex_lock(&msm_rotator_dev->queue_lock);
+	}
+	msm_rotator_dev->jobs_queued++;
+	mutex_unlock(&msm_rotator_dev->queue_lock);
+	return 0;
+}
+
+static void msm_rotator_job_unreserve(void)
+{
+	mutex_lock(&msm_rotator_dev->queue_lock);
+	msm_rotator_dev->jobs_queued--;
+	mutex_unlock(&msm_rotator_dev->queue_lock);
+	wake_up(&msm_rotator_dev->queue_wq);
+}
+
+static int msm_rotator_queue(unsigned long arg)
+{
+	struct msm_rotator_async_info async;
+	struct msm_rotator_job *job;
+	struct sync_pt *pt;
+	struct sync_fence *fence;
+	int rc, s, fd;
+
+	if (copy_from_user(&async, (void __user *)arg, sizeof(async)))
+		return -EFAULT;
+
+	/* fget_light() references cannot be handed to the worker */
+	if ((async.data.src.flags & MDP_MEMORY_ID_TYPE_FB) ||
+	    (async.data.dst.flags & MDP_MEMORY_ID_TYPE_FB))
+		return -EINVAL;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+	job->info = async.data;
+
+	if (async.acq_fen_fd >= 0) {
+		job->acq_fence = sync_fence_fdget(async.acq_fen_fd);
+		if (!job->acq_fence) {
+			rc = -EINVAL;
+			goto queue_free;
+		}
+	}
+
+	rc = msm_rotator_job_reserve();
+	if (rc)
+		goto queue_put_fence;
+
+	mutex_lock(&msm_rotator_dev->rotator_lock);
+	s = msm_rotator_find_session(job->info.session_id);
+	if (s < 0)
+		rc = s;
+	else
+		rc = msm_rotator_map(&job->info, s, &job->map);
+	mutex_unlock(&msm_rotator_dev->rotator_lock);
+	if (rc)
+		goto queue_unreserve;
+
+	fd = get_unused_fd_flags(0);
+	if (fd < 0) {
+		rc = fd;
+		goto queue_unmap;
+	}
+	if (copy_to_user(&((struct msm_rotator_async_info __user *)arg)->
+			 rel_fen_fd, &fd, sizeof(fd))) {
+		rc = -EFAULT;
+		goto queue_put_fd;
+	}
+
+	mutex_lock(&msm_rotator_dev->queue_lock);
+	pt = sw_sync_pt_create(msm_rotator_dev->timeline,
+			       msm_rotator_dev->timeline_max + 1);
+	if (!pt) {
+		rc = -ENOMEM;
+		goto queue_unlock;
+	}
+	fence = sync_fence_create("rot-fence", pt);
+	if (!fence) {
+		sync_pt_free(pt);
+		rc = -ENOMEM;
+		goto queue_unlock;
+	}
+	sync_fence_install(fence, fd);
+	msm_rotator_dev->timeline_max++;
+	list_add_tail(&job->list, &msm_rotator_dev->job_list);
+	mutex_unlock(&msm_rotator_dev->queue_lock);
+
+	queue_work(msm_rotator_dev->async_wq, &msm_rotator_dev->async_work);
+	return 0;
+
+queue_unlock:
+	mutex_unlock(&msm_rotator_dev->queue_lock);
+queue_put_fd:
+	put_unused_fd(fd);
+queue_unmap:
+	msm_rotator_unmap(&job->info, &job->map);
+queue_unreserve:
+	msm_rotator_job_unreserve();
+queue_put_fence:
+	if (job->acq_fence)
+		sync_fence_put(job->acq_fence);
+queue_free:
+	kfree(job);
+	return rc;
+}
+
 static void msm_rotator_set_perf_level(u32 wh, u32 is_rgb)
 {
 	u32 perf_level;
@@ -1527,6 +1777,8 @@ static long msm_rotator_ioctl(struct file *file, unsigned cmd,
 		return msm_rotator_do_rotate(arg);
 	case MSM_ROTATOR_IOCTL_FINISH:
 		return msm_rotator_finish(arg);
+	case MSM_ROTATOR_IOCTL_ROTATE_ASYNC:
+		return msm_rotator_queue(arg);
 
 	default:
 		dev_dbg(msm_rotator_dev->device,
@@ -1651,11 +1903,24 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 	if (IS_ERR(msm_rotator_dev->regulator))
 		msm_rotator_dev->regulator = NULL;
 
-	msm_rotator_dev->rot_clk_state = CLK_DIS;
-	INIT_DELAYED_WORK(&msm_rotator_dev->rot_clk_work,
-			  msm_rotator_rot_clk_work_f);
+	msm_rotator_dev->rot_clks[0] = msm_rotator_dev->core_clk;
+	msm_rotator_dev->rot_clks[1] = msm_rotator_dev->pclk;
+	msm_rotator_dev->rot_gate = (struct autogate) {
+		.name = DRIVER_NAME,
+		.clks = msm_rotator_dev->rot_clks,
+		.num_clks = ARRAY_SIZE(msm_rotator_dev->rot_clks),
+		.regulator = msm_rotator_dev->regulator,
+		.min_ms = 20,
+		.max_ms = 1000,
+	};
+	autogate_init(&msm_rotator_dev->rot_gate);
 
 	mutex_init(&msm_rotator_dev->rotator_lock);
+	mutex_init(&msm_rotator_dev->hw_lock);
+	mutex_init(&msm_rotator_dev->queue_lock);
+	INIT_LIST_HEAD(&msm_rotator_dev->job_list);
+	init_waitqueue_head(&msm_rotator_dev->queue_wq);
+	INIT_WORK(&msm_rotator_dev->async_work, msm_rotator_async_work_f);
 #ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
 	msm_rotator_dev->client = msm_ion_client_create(-1, pdev->name);
 #endif
@@ -1681,9 +1946,10 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 	if (msm_rotator_dev->imem_clk)
 		clk_prepare_enable(msm_rotator_dev->imem_clk);
 #endif
-	enable_rot_clks();
+	autogate_get(&msm_rotator_dev->rot_gate);
 	ver = ioread32(MSM_ROTATOR_HW_VERSION);
-	disable_rot_clks();
+	autogate_put(&msm_rotator_dev->rot_gate);
+	autogate_suspend(&msm_rotator_dev->rot_gate);
 
 #ifdef CONFIG_MSM_ROTATOR_USE_IMEM
 	if (msm_rotator_dev->imem_clk)
@@ -1741,6 +2007,18 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 		goto error_class_device_create;
 	}
 
+	msm_rotator_dev->async_wq = create_freezable_workqueue(DRIVER_NAME);
+	if (!msm_rotator_dev->async_wq) {
+		rc = -ENOMEM;
+		goto error_async_wq;
+	}
+
+	msm_rotator_dev->timeline = sw_sync_timeline_create(DRIVER_NAME);
+	if (!msm_rotator_dev->timeline) {
+		rc = -ENOMEM;
+		goto error_timeline;
+	}
+
 	cdev_init(&msm_rotator_dev->cdev, &msm_rotator_fops);
 	rc = cdev_add(&msm_rotator_dev->cdev,
 		      MKDEV(MAJOR(msm_rotator_dev->dev_num), 0),
@@ -1756,6 +2034,10 @@ static int __devinit msm_rotator_probe(struct platform_device *pdev)
 	return rc;
 
 error_cdev_add:
+	sync_timeline_destroy(&msm_rotator_dev->timeline->obj);
+error_timeline:
+	destroy_workqueue(msm_rotator_dev->async_wq);
+error_async_wq:
 	device_destroy(msm_rotator_dev->class, msm_rotator_dev->dev_num);
 error_class_device_create:
 	class_destroy(msm_rotator_dev->class);
@@ -1764,6 +2046,7 @@ error_class_create:
 error_get_irq:
 	iounmap(msm_rotator_dev->io_base);
 error_get_resource:
+	autogate_destroy(&msm_rotator_dev->rot_gate);
 	mutex_destroy(&msm_rotator_dev->rotator_lock);
 	if (msm_rotator_dev->regulator)
 		regulator_put(msm_rotator_dev->regulator);
@@ -1791,9 +2074,11 @@ static int __devexit msm_rotator_remove(struct platform_device *plat_dev)
 		msm_rotator_dev->bus_client_handle = 0;
 	}
 #endif
+	cdev_del(&msm_rotator_dev->cdev);
+	destroy_workqueue(msm_rotator_dev->async_wq);
+	sync_timeline_destroy(&msm_rotator_dev->timeline->obj);
 	free_irq(msm_rotator_dev->irq, NULL);
 	mutex_destroy(&msm_rotator_dev->rotator_lock);
-	cdev_del(&msm_rotator_dev->cdev);
 	device_destroy(msm_rotator_dev->class, msm_rotator_dev->dev_num);
 	class_destroy(msm_rotator_dev->class);
 	unregister_chrdev_region(msm_rotator_dev->dev_num, 1);
@@ -1804,8 +2089,7 @@ static int __devexit msm_rotator_remove(struct platform_device *plat_dev)
 		clk_put(msm_rotator_dev->imem_clk);
 		msm_rotator_dev->imem_clk = NULL;
 	}
-	if (msm_rotator_dev->rot_clk_state == CLK_EN)
-		disable_rot_clks();
+	autogate_destroy(&msm_rotator_dev->rot_gate);
 	clk_put(msm_rotator_dev->core_clk);
 	clk_put(msm_rotator_dev->pclk);
 	if (msm_rotator_dev->regulator)
@@ -1831,10 +2115,7 @@ static int msm_rotator_suspend(struct platform_device *dev, pm_message_t state)
 	}
 	mutex_unlock(&msm_rotator_dev->imem_lock);
 	mutex_lock(&msm_rotator_dev->rotator_lock);
-	if (msm_rotator_dev->rot_clk_state == CLK_EN) {
-		disable_rot_clks();
-		msm_rotator_dev->rot_clk_state = CLK_SUSPEND;
-	}
+	autogate_suspend(&msm_rotator_dev->rot_gate);
 	mutex_unlock(&msm_rotator_dev->rotator_lock);
 	return 0;
 }
@@ -1848,12 +2129,6 @@ static int msm_rotator_resume(struct platform_device *dev)
 		msm_rotator_dev->imem_clk_state = CLK_EN;
 	}
 	mutex_unlock(&msm_rotator_dev->imem_lock);
-	mutex_lock(&msm_rotator_dev->rotator_lock);
-	if (msm_rotator_dev->rot_clk_state == CLK_SUSPEND) {
-		enable_rot_clks();
-		msm_rotator_dev->rot_clk_state = CLK_EN;
-	}
-	mutex_unlock(&msm_rotator_dev->rotator_lock);
 	return 0;
 }
 #endif
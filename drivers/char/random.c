@@ -347,6 +347,23 @@ void add_device_randomness(const void *buf, unsigned int size)
 }
 EXPORT_SYMBOL(add_device_randomness);
 
+/*
+ * For hardware rng drivers: mix into the input pool and credit
+ * entropy_bits, but only while the pool is below the write wakeup
+ * threshold.  Returns -EAGAIN when it is not needed.
+ */
+int add_hwrng_randomness(const void *buf, unsigned int size,
+			 unsigned int entropy_bits)
+{
+	if (input_pool.entropy_count >= random_write_wakeup_thresh)
+		return -EAGAIN;
+
+	mix_pool_bytes(&input_pool, buf, size, NULL);
+	credit_entropy_bits(&input_pool, min(entropy_bits, size * 8));
+	return 0;
+}
+EXPORT_SYMBOL_GPL(add_hwrng_randomness);
+
 static struct timer_rand_state input_timer_state;
 
 static void add_timer_randomness(struct timer_rand_state *state, unsigned num)
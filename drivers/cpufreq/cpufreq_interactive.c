@@ -0,0 +1,786 @@
+/*
+ * drivers/cpufreq/cpufreq_interactive.c
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/cpufreq.h>
+#include <linux/input.h>
+#include <linux/kernel_stat.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/msm_l2_stats.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/tick.h>
+#include <linux/timer.h>
+
+#include <trace/events/cpufreq_interactive.h>
+
+/*
+ * Every CPU samples its load with a deferrable timer, so an idle CPU is
+ * not woken up just to find out that it is idle.  A load above
+ * go_hispeed_load jumps straight to hispeed_freq, otherwise the frequency
+ * is picked so that the load would come out at target_load.  Frequencies
+ * above hispeed_freq are only reached after above_hispeed_delay, and a
+ * frequency is held for at least min_sample_time before going down.
+ *
+ * Since the sampling timer doesn't run while the CPU is idle, a second
+ * non-deferrable timer, timer_slack later, makes sure that a CPU that went
+ * idle above the minimum frequency gets to lower it eventually.
+ *
+ * Touch and key input pulses hispeed_freq for boostpulse_duration so the
+ * first frame after an input event doesn't wait for the load to show up.
+ *
+ * A CPU whose task is memory bound, going by its L2 misses, isn't raised
+ * past hispeed_freq and the bus vote goes up instead, since waiting on
+ * memory doesn't get shorter with the CPU clock.
+ *
+ * The frequency is changed from a realtime thread since the timers run in
+ * atomic context.
+ */
+
+struct cpufreq_interactive_cpuinfo {
+	struct timer_list cpu_timer;
+	struct timer_list cpu_slack_timer;
+	u64 time_in_idle;
+	u64 time_in_idle_timestamp;
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned int target_freq;
+	unsigned int floor_freq;
+	u64 floor_validate_time;
+	u64 hispeed_validate_time;
+	bool mem_bound;
+	int governor_enabled;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
+
+static struct task_struct *speedchange_task;
+static cpumask_t speedchange_cpumask;
+static spinlock_t speedchange_cpumask_lock;
+static struct mutex gov_lock;
+static int active_count;
+static bool input_registered;
+
+/* Frequency to jump to on a load burst, defaults to the policy max */
+static unsigned int hispeed_freq;
+
+/* Load at which to jump to hispeed_freq */
+#define DEFAULT_GO_HISPEED_LOAD 85
+static unsigned long go_hispeed_load = DEFAULT_GO_HISPEED_LOAD;
+
+/* Load that the frequency is picked to come out at */
+#define DEFAULT_TARGET_LOAD 90
+static unsigned long target_load = DEFAULT_TARGET_LOAD;
+
+/* Time a frequency is held before going down, in us */
+#define DEFAULT_MIN_SAMPLE_TIME (80 * USEC_PER_MSEC)
+static unsigned long min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
+
+/* Sampling period in us, short enough to react within a 60Hz frame */
+#define DEFAULT_TIMER_RATE (10 * USEC_PER_MSEC)
+static unsigned long timer_rate = DEFAULT_TIMER_RATE;
+
+/* Time to stay at hispeed_freq before going any higher, in us */
+#define DEFAULT_ABOVE_HISPEED_DELAY DEFAULT_TIMER_RATE
+static unsigned long above_hispeed_delay = DEFAULT_ABOVE_HISPEED_DELAY;
+
+/* Longest an idle CPU stays above the minimum in us, -1 for no limit */
+#define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
+static long timer_slack = DEFAULT_TIMER_SLACK;
+
+/* Length of a boost pulse in us */
+#define DEFAULT_BOOSTPULSE_DURATION (80 * USEC_PER_MSEC)
+static unsigned long boostpulse_duration = DEFAULT_BOOSTPULSE_DURATION;
+static u64 boostpulse_endtime;
+
+/* Non-zero holds every CPU at hispeed_freq or above */
+static unsigned long boost;
+
+/* Pulse a boost on touch and key input */
+static unsigned long input_boost = 1;
+
+/* Count iowait as busy time */
+static unsigned long io_is_busy;
+
+/* Trade the CPU clock for bus bandwidth on memory-bound tasks */
+static unsigned long mem_bound_hold = 1;
+static bool bus_boosted;
+
+static inline u64 get_cpu_idle_time_jiffy(unsigned int cpu, u64 *wall)
+{
+	u64 idle_time;
+	u64 cur_wall_time;
+	u64 busy_time;
+
+	cur_wall_time = jiffies64_to_cputime64(get_jiffies_64());
+
+	busy_time  = kcpustat_cpu(cpu).cpustat[CPUTIME_USER];
+	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_SYSTEM];
+	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_IRQ];
+	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_SOFTIRQ];
+	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_STEAL];
+	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_NICE];
+
+	idle_time = cur_wall_time - busy_time;
+	if (wall)
+		*wall = jiffies_to_usecs(cur_wall_time);
+
+	return jiffies_to_usecs(idle_time);
+}
+
+/* Same accounting as msm_rq_stats, iowait is idle unless io_is_busy */
+static inline u64 get_cpu_idle_time(unsigned int cpu, u64 *wall)
+{
+	u64 idle_time = get_cpu_idle_time_us(cpu, wall);
+
+	if (idle_time == -1ULL)
+		return get_cpu_idle_time_jiffy(cpu, wall);
+	else if (!io_is_busy)
+		idle_time += get_cpu_iowait_time_us(cpu, wall);
+
+	return idle_time;
+}
+
+static void cpufreq_interactive_timer_resched(unsigned int cpu)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, cpu);
+	unsigned long expires = jiffies + usecs_to_jiffies(timer_rate);
+
+	mod_timer_pinned(&pcpu->cpu_timer, expires);
+	if (timer_slack >= 0 && pcpu->target_freq > pcpu->policy->min) {
+		expires += usecs_to_jiffies(timer_slack);
+		mod_timer_pinned(&pcpu->cpu_slack_timer, expires);
+	}
+
+	pcpu->time_in_idle = get_cpu_idle_time(cpu,
+					       &pcpu->time_in_idle_timestamp);
+}
+
+static void cpufreq_interactive_timer(unsigned long data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, data);
+	unsigned int delta_time, delta_idle;
+	unsigned int cpu_load, new_freq, index;
+	u64 now, now_idle, wall;
+	unsigned long flags;
+	bool boosted, mem_bound;
+
+	smp_rmb();
+	if (!pcpu->governor_enabled)
+		return;
+
+	now_idle = get_cpu_idle_time(data, &wall);
+	delta_idle = (unsigned int) (now_idle - pcpu->time_in_idle);
+	delta_time = (unsigned int) (wall - pcpu->time_in_idle_timestamp);
+
+	if (!delta_time)
+		goto rearm;
+
+	if (delta_idle > delta_time)
+		cpu_load = 0;
+	else
+		cpu_load = 100 * (delta_time - delta_idle) / delta_time;
+
+	/* The speedchange task moves the bus vote */
+	mem_bound = mem_bound_hold && msm_l2_stats_mem_bound();
+	if (mem_bound != pcpu->mem_bound) {
+		pcpu->mem_bound = mem_bound;
+		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		cpumask_set_cpu(data, &speedchange_cpumask);
+		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+		wake_up_process(speedchange_task);
+	}
+
+	now = ktime_to_us(ktime_get());
+	boosted = boost || now < boostpulse_endtime;
+
+	/* Frequency at which the load would come out at target_load */
+	new_freq = pcpu->policy->cur * cpu_load / target_load;
+
+	if (cpu_load >= go_hispeed_load || boosted) {
+		if (pcpu->target_freq < hispeed_freq)
+			new_freq = hispeed_freq;
+		else
+			new_freq = max(new_freq, hispeed_freq);
+	}
+
+	if (mem_bound && !boosted)
+		new_freq = min(new_freq, max(hispeed_freq, pcpu->target_freq));
+
+	if (pcpu->target_freq >= hispeed_freq &&
+	    new_freq > pcpu->target_freq &&
+	    now - pcpu->hispeed_validate_time < above_hispeed_delay) {
+		trace_cpufreq_interactive_notyet(data, cpu_load,
+						 pcpu->target_freq, new_freq);
+		goto rearm;
+	}
+
+	pcpu->hispeed_validate_time = now;
+
+	if (cpufreq_frequency_table_target(pcpu->policy, pcpu->freq_table,
+					   new_freq, CPUFREQ_RELATION_L,
+					   &index))
+		goto rearm;
+
+	new_freq = pcpu->freq_table[index].frequency;
+
+	if (new_freq < pcpu->floor_freq &&
+	    now - pcpu->floor_validate_time < min_sample_time) {
+		trace_cpufreq_interactive_notyet(data, cpu_load,
+						 pcpu->target_freq, new_freq);
+		goto rearm;
+	}
+
+	/* A boost at hispeed_freq doesn't extend the hold time */
+	if (!boosted || new_freq > hispeed_freq) {
+		pcpu->floor_freq = new_freq;
+		pcpu->floor_validate_time = now;
+	}
+
+	if (pcpu->target_freq == new_freq) {
+		trace_cpufreq_interactive_already(data, cpu_load,
+						  pcpu->target_freq, new_freq);
+		goto rearm;
+	}
+
+	trace_cpufreq_interactive_target(data, cpu_load, pcpu->target_freq,
+					 new_freq);
+	pcpu->target_freq = new_freq;
+
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+	cpumask_set_cpu(data, &speedchange_cpumask);
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+	wake_up_process(speedchange_task);
+
+rearm:
+	if (!timer_pending(&pcpu->cpu_timer))
+		cpufreq_interactive_timer_resched(data);
+}
+
+/* The slack timer only has to wake the CPU, the sampling timer does the rest */
+static void cpufreq_interactive_nop_timer(unsigned long data)
+{
+}
+
+static int cpufreq_interactive_speedchange_task(void *data)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned long flags;
+	cpumask_t tmp_mask;
+	unsigned int cpu;
+	bool mem_bound;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+
+		if (cpumask_empty(&speedchange_cpumask)) {
+			spin_unlock_irqrestore(&speedchange_cpumask_lock,
+					       flags);
+			schedule();
+
+			if (kthread_should_stop())
+				break;
+
+			spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		}
+
+		set_current_state(TASK_RUNNING);
+		tmp_mask = speedchange_cpumask;
+		cpumask_clear(&speedchange_cpumask);
+		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+
+		for_each_cpu(cpu, &tmp_mask) {
+			unsigned int j, max_freq = 0;
+
+			pcpu = &per_cpu(cpuinfo, cpu);
+			smp_rmb();
+			if (!pcpu->governor_enabled)
+				continue;
+
+			/* CPUs that share a clock run at the highest target */
+			for_each_cpu(j, pcpu->policy->cpus) {
+				struct cpufreq_interactive_cpuinfo *pjcpu =
+					&per_cpu(cpuinfo, j);
+
+				if (pjcpu->target_freq > max_freq)
+					max_freq = pjcpu->target_freq;
+			}
+
+			if (max_freq == pcpu->policy->cur)
+				continue;
+
+			if (max_freq > pcpu->policy->cur)
+				trace_cpufreq_interactive_up(cpu, max_freq,
+							     pcpu->policy->cur);
+			else
+				trace_cpufreq_interactive_down(cpu, max_freq,
+							       pcpu->policy->cur);
+
+			cpufreq_driver_target(pcpu->policy, max_freq,
+					      CPUFREQ_RELATION_H);
+		}
+
+		/* Any memory-bound CPU keeps the bus boosted */
+		mem_bound = false;
+		for_each_possible_cpu(cpu) {
+			pcpu = &per_cpu(cpuinfo, cpu);
+			if (pcpu->governor_enabled && pcpu->mem_bound)
+				mem_bound = true;
+		}
+
+		if (mem_bound != bus_boosted) {
+			bus_boosted = mem_bound;
+			msm_l2_stats_bus_boost(mem_bound);
+		}
+	}
+
+	return 0;
+}
+
+static void cpufreq_interactive_boost(void)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned long flags;
+	bool anyboost = false;
+	u64 now = ktime_to_us(ktime_get());
+	int i;
+
+	spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+
+	for_each_online_cpu(i) {
+		pcpu = &per_cpu(cpuinfo, i);
+		if (!pcpu->governor_enabled)
+			continue;
+
+		if (pcpu->target_freq < hispeed_freq) {
+			pcpu->target_freq = hispeed_freq;
+			cpumask_set_cpu(i, &speedchange_cpumask);
+			pcpu->hispeed_validate_time = now;
+			anyboost = true;
+		}
+
+		pcpu->floor_freq = hispeed_freq;
+		pcpu->floor_validate_time = now;
+	}
+
+	spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+
+	if (anyboost)
+		wake_up_process(speedchange_task);
+}
+
+static void cpufreq_interactive_boostpulse(const char *reason)
+{
+	boostpulse_endtime = ktime_to_us(ktime_get()) + boostpulse_duration;
+	trace_cpufreq_interactive_boost(reason);
+	cpufreq_interactive_boost();
+}
+
+static void cpufreq_interactive_input_event(struct input_handle *handle,
+		unsigned int type, unsigned int code, int value)
+{
+	u64 now;
+
+	if (!input_boost || type != EV_SYN || code != SYN_REPORT)
+		return;
+
+	/* A gesture reports every few ms, only pulse again halfway through */
+	now = ktime_to_us(ktime_get());
+	if (now + boostpulse_duration / 2 < boostpulse_endtime)
+		return;
+
+	cpufreq_interactive_boostpulse("input");
+}
+
+static int input_dev_filter(const char *input_dev_name)
+{
+	if (strstr(input_dev_name, "touchscreen") ||
+	    strstr(input_dev_name, "keypad"))
+		return 0;
+
+	return 1;
+}
+
+static int cpufreq_interactive_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	if (input_dev_filter(dev->name))
+		return -ENODEV;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "cpufreq_interactive";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
+}
+
+static void cpufreq_interactive_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id cpufreq_interactive_ids[] = {
+	{ .driver_info = 1 },
+	{ },
+};
+
+static struct input_handler cpufreq_interactive_input_handler = {
+	.event		= cpufreq_interactive_input_event,
+	.connect	= cpufreq_interactive_input_connect,
+	.disconnect	= cpufreq_interactive_input_disconnect,
+	.name		= "cpufreq_interactive",
+	.id_table	= cpufreq_interactive_ids,
+};
+
+#define show_one(name)							\
+static ssize_t show_##name(struct kobject *kobj,			\
+			   struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%lu\n", (unsigned long) name);		\
+}
+
+#define store_one(name, min, max)					\
+static ssize_t store_##name(struct kobject *kobj,			\
+			    struct attribute *attr,			\
+			    const char *buf, size_t count)		\
+{									\
+	unsigned long val;						\
+	int ret;							\
+									\
+	ret = kstrtoul(buf, 0, &val);					\
+	if (ret < 0)							\
+		return ret;						\
+	if (val < (min) || val > (max))					\
+		return -EINVAL;						\
+	name = val;							\
+	return count;							\
+}
+
+#define interactive_attr_rw(name, min, max)				\
+show_one(name)								\
+store_one(name, min, max)						\
+static struct global_attr name##_attr =					\
+	__ATTR(name, 0644, show_##name, store_##name)
+
+interactive_attr_rw(hispeed_freq, 0, UINT_MAX);
+interactive_attr_rw(go_hispeed_load, 1, 100);
+interactive_attr_rw(target_load, 1, 100);
+interactive_attr_rw(min_sample_time, 0, ULONG_MAX);
+interactive_attr_rw(timer_rate, 1, ULONG_MAX);
+interactive_attr_rw(above_hispeed_delay, 0, ULONG_MAX);
+interactive_attr_rw(boostpulse_duration, 0, ULONG_MAX);
+interactive_attr_rw(input_boost, 0, 1);
+interactive_attr_rw(io_is_busy, 0, 1);
+interactive_attr_rw(mem_bound_hold, 0, 1);
+
+static ssize_t show_timer_slack(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%ld\n", timer_slack);
+}
+
+static ssize_t store_timer_slack(struct kobject *kobj,
+				 struct attribute *attr,
+				 const char *buf, size_t count)
+{
+	long val;
+	int ret;
+
+	ret = kstrtol(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (val < -1)
+		return -EINVAL;
+
+	timer_slack = val;
+	return count;
+}
+
+static struct global_attr timer_slack_attr = __ATTR(timer_slack, 0644,
+		show_timer_slack, store_timer_slack);
+
+static ssize_t show_boost(struct kobject *kobj, struct attribute *attr,
+			  char *buf)
+{
+	return sprintf(buf, "%lu\n", boost);
+}
+
+static ssize_t store_boost(struct kobject *kobj, struct attribute *attr,
+			   const char *buf, size_t count)
+{
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	boost = val;
+
+	if (boost) {
+		trace_cpufreq_interactive_boost("on");
+		cpufreq_interactive_boost();
+	} else {
+		trace_cpufreq_interactive_unboost("off");
+	}
+
+	return count;
+}
+
+static struct global_attr boost_attr = __ATTR(boost, 0644,
+		show_boost, store_boost);
+
+static ssize_t store_boostpulse(struct kobject *kobj, struct attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long val;
+	int ret;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+
+	cpufreq_interactive_boostpulse("pulse");
+	return count;
+}
+
+static struct global_attr boostpulse_attr = __ATTR(boostpulse, 0200,
+		NULL, store_boostpulse);
+
+static struct attribute *interactive_attributes[] = {
+	&hispeed_freq_attr.attr,
+	&go_hispeed_load_attr.attr,
+	&target_load_attr.attr,
+	&min_sample_time_attr.attr,
+	&timer_rate_attr.attr,
+	&above_hispeed_delay_attr.attr,
+	&timer_slack_attr.attr,
+	&boost_attr.attr,
+	&boostpulse_attr.attr,
+	&boostpulse_duration_attr.attr,
+	&input_boost_attr.attr,
+	&io_is_busy_attr.attr,
+	&mem_bound_hold_attr.attr,
+	NULL,
+};
+
+static struct attribute_group interactive_attr_group = {
+	.attrs = interactive_attributes,
+	.name = "interactive",
+};
+
+static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	struct cpufreq_frequency_table *freq_table;
+	unsigned long expires, flags;
+	unsigned int j;
+	int rc;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(policy->cpu))
+			return -EINVAL;
+
+		freq_table = cpufreq_frequency_get_table(policy->cpu);
+		if (!freq_table)
+			return -EINVAL;
+
+		mutex_lock(&gov_lock);
+
+		if (!hispeed_freq)
+			hispeed_freq = policy->max;
+
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->policy = policy;
+			pcpu->freq_table = freq_table;
+			pcpu->target_freq = policy->cur;
+			pcpu->floor_freq = pcpu->target_freq;
+			pcpu->floor_validate_time = ktime_to_us(ktime_get());
+			pcpu->hispeed_validate_time =
+				pcpu->floor_validate_time;
+			pcpu->time_in_idle = get_cpu_idle_time(j,
+					&pcpu->time_in_idle_timestamp);
+			pcpu->governor_enabled = 1;
+			smp_wmb();
+
+			expires = jiffies + usecs_to_jiffies(timer_rate);
+			pcpu->cpu_timer.expires = expires;
+			add_timer_on(&pcpu->cpu_timer, j);
+			if (timer_slack >= 0) {
+				pcpu->cpu_slack_timer.expires = expires +
+					usecs_to_jiffies(timer_slack);
+				add_timer_on(&pcpu->cpu_slack_timer, j);
+			}
+		}
+
+		if (++active_count > 1) {
+			mutex_unlock(&gov_lock);
+			return 0;
+		}
+
+		rc = sysfs_create_group(cpufreq_global_kobject,
+					&interactive_attr_group);
+		if (rc)
+			pr_warn("cpufreq_interactive: no sysfs tunables: %d\n",
+				rc);
+
+		/* Not fatal, there just won't be any input boost */
+		rc = input_register_handler(&cpufreq_interactive_input_handler);
+		if (rc)
+			pr_warn("cpufreq_interactive: no input handler: %d\n",
+				rc);
+		input_registered = !rc;
+
+		mutex_unlock(&gov_lock);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&gov_lock);
+
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->governor_enabled = 0;
+			smp_wmb();
+			del_timer_sync(&pcpu->cpu_timer);
+			del_timer_sync(&pcpu->cpu_slack_timer);
+			pcpu->mem_bound = false;
+		}
+
+		/* Let the speedchange task drop a bus boost these CPUs held */
+		spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+		cpumask_set_cpu(policy->cpu, &speedchange_cpumask);
+		spin_unlock_irqrestore(&speedchange_cpumask_lock, flags);
+		wake_up_process(speedchange_task);
+
+		if (--active_count > 0) {
+			mutex_unlock(&gov_lock);
+			return 0;
+		}
+
+		if (input_registered)
+			input_unregister_handler(
+				&cpufreq_interactive_input_handler);
+		input_registered = false;
+
+		sysfs_remove_group(cpufreq_global_kobject,
+				   &interactive_attr_group);
+
+		mutex_unlock(&gov_lock);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy, policy->max,
+						CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy, policy->min,
+						CPUFREQ_RELATION_L);
+		break;
+	}
+
+	return 0;
+}
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
+static
+#endif
+struct cpufreq_governor cpufreq_gov_interactive = {
+	.name			= "interactive",
+	.governor		= cpufreq_governor_interactive,
+	.max_transition_latency	= 10000000,
+	.owner			= THIS_MODULE,
+};
+
+static int __init cpufreq_interactive_init(void)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
+	struct cpufreq_interactive_cpuinfo *pcpu;
+	unsigned int i;
+
+	for_each_possible_cpu(i) {
+		pcpu = &per_cpu(cpuinfo, i);
+		init_timer_deferrable(&pcpu->cpu_timer);
+		pcpu->cpu_timer.function = cpufreq_interactive_timer;
+		pcpu->cpu_timer.data = i;
+		init_timer(&pcpu->cpu_slack_timer);
+		pcpu->cpu_slack_timer.function = cpufreq_interactive_nop_timer;
+	}
+
+	spin_lock_init(&speedchange_cpumask_lock);
+	mutex_init(&gov_lock);
+
+	speedchange_task = kthread_create(cpufreq_interactive_speedchange_task,
+					  NULL, "cfinteractive");
+	if (IS_ERR(speedchange_task))
+		return PTR_ERR(speedchange_task);
+
+	sched_setscheduler_nocheck(speedchange_task, SCHED_FIFO, &param);
+	get_task_struct(speedchange_task);
+
+	/* Let it go to sleep until there is something to do */
+	wake_up_process(speedchange_task);
+
+	return cpufreq_register_governor(&cpufreq_gov_interactive);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE
+fs_initcall(cpufreq_interactive_init);
+#else
+module_init(cpufreq_interactive_init);
+#endif
+
+static void __exit cpufreq_interactive_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_interactive);
+	kthread_stop(speedchange_task);
+	put_task_struct(speedchange_task);
+}
+
+module_exit(cpufreq_interactive_exit);
+
+MODULE_DESCRIPTION("'cpufreq_interactive' - A cpufreq governor for "
+	"latency sensitive workloads");
+MODULE_LICENSE("GPL");
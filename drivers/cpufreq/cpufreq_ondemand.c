@@ -26,8 +26,8 @@
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
 #include <linux/slab.h>
+#include <linux/perf_telemetry.h>
 
-#define CREATE_TRACE_POINTS
 #include <trace/events/cpufreq_interactive.h>
 
 
@@ -1122,6 +1122,7 @@ static void dbs_check_cpu(struct cpu_dbs_info_s *this_dbs_info)
 		int freq_avg;
 
 		cur_load = get_cpu_current_load(j, &prev_load);
+		perf_tm_log(PERF_TM_CPU_LOAD, j, cur_load, policy->cur);
 		freq_avg = __cpufreq_driver_getavg(policy, j);
 		if (freq_avg <= 0)
 			freq_avg = policy->cur;
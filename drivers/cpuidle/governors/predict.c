@@ -0,0 +1,260 @@
+/*
+ * predict.c - idle duration prediction from the wakeup history
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This code is licenced under the GPL.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/tick.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+
+/*
+ * The next timer only bounds how long a CPU is going to sleep.  With a lot
+ * of interrupts (network RX, touch) the CPU is woken long before that and
+ * a state picked by the timer alone doesn't pay back its exit cost.
+ *
+ * Each CPU keeps the residency of its last few sleeps and whether the
+ * sleep ended before the timer.  If the recent residencies are consistent
+ * their average is the prediction, menu style.  Otherwise, if most recent
+ * sleeps were cut short by something other than the timer, the average of
+ * those is used.  The prediction never exceeds the time to the next timer.
+ */
+
+#define PREDICT_HISTORY		8
+/* Residencies are capped so that the variance fits in 64 bits */
+#define PREDICT_MAX_US		USEC_PER_SEC
+/* A sleep that ends before this share of the timer was not the timer */
+#define PREDICT_EARLY_PCT	80
+/* Early wakeups in the history before they are trusted over the timer */
+#define PREDICT_EARLY_MIN	(PREDICT_HISTORY * 3 / 4)
+
+struct predict_device {
+	int		last_state_idx;
+	int		needs_update;
+	int		active;
+
+	unsigned int	sleep_length_us;
+	unsigned int	predicted_us;
+
+	unsigned int	residency[PREDICT_HISTORY];
+	bool		early[PREDICT_HISTORY];
+	int		next;
+};
+
+static DEFINE_PER_CPU(struct predict_device, predict_devices);
+
+/* Average of the history if it is consistent enough to go by, else 0 */
+static unsigned int predict_typical_interval(struct predict_device *data)
+{
+	unsigned int max, thresh = UINT_MAX;
+	u64 avg, stddev;
+	int i, divisor;
+
+again:
+	avg = 0;
+	max = 0;
+	divisor = 0;
+	for (i = 0; i < PREDICT_HISTORY; i++) {
+		unsigned int value = data->residency[i];
+
+		if (value > thresh)
+			continue;
+		avg += value;
+		divisor++;
+		if (value > max)
+			max = value;
+	}
+
+	if (!divisor)
+		return 0;
+	do_div(avg, divisor);
+
+	stddev = 0;
+	for (i = 0; i < PREDICT_HISTORY; i++) {
+		unsigned int value = data->residency[i];
+		s64 diff;
+
+		if (value > thresh)
+			continue;
+		diff = (s64) value - (s64) avg;
+		stddev += diff * diff;
+	}
+	do_div(stddev, divisor);
+	stddev = int_sqrt((unsigned long) min_t(u64, stddev, ULONG_MAX));
+
+	if ((avg > stddev * 6 && divisor * 4 >= PREDICT_HISTORY * 3) ||
+	    stddev <= 20)
+		return (unsigned int) avg;
+
+	/* Drop the longest sleep and try again while most of it is left */
+	if (divisor * 4 > PREDICT_HISTORY * 3) {
+		thresh = max - 1;
+		goto again;
+	}
+
+	return 0;
+}
+
+static unsigned int predict_early_interval(struct predict_device *data)
+{
+	unsigned int count = 0;
+	u64 sum = 0;
+	int i;
+
+	for (i = 0; i < PREDICT_HISTORY; i++) {
+		if (!data->early[i])
+			continue;
+		sum += data->residency[i];
+		count++;
+	}
+
+	if (count < PREDICT_EARLY_MIN)
+		return 0;
+
+	do_div(sum, count);
+	return (unsigned int) sum;
+}
+
+static void predict_update(struct cpuidle_driver *drv,
+			   struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	struct cpuidle_state *target = &drv->states[data->last_state_idx];
+	unsigned int measured;
+
+	/* Without a residency from the driver assume the timer woke us */
+	if (target->flags & CPUIDLE_FLAG_TIME_VALID)
+		measured = cpuidle_get_last_residency(dev);
+	else
+		measured = data->sleep_length_us;
+
+	if (measured > target->exit_latency)
+		measured -= target->exit_latency;
+
+	data->early[data->next] = (u64) measured * 100 <
+		(u64) data->sleep_length_us * PREDICT_EARLY_PCT;
+	data->residency[data->next] = min_t(unsigned int, measured,
+					    PREDICT_MAX_US);
+	data->next = (data->next + 1) % PREDICT_HISTORY;
+}
+
+static int predict_select(struct cpuidle_driver *drv,
+			  struct cpuidle_device *dev)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int predicted, interval;
+	s64 sleep_length;
+	int i;
+
+	if (data->needs_update) {
+		predict_update(drv, dev);
+		data->needs_update = 0;
+	}
+
+	data->last_state_idx = 0;
+
+	if (unlikely(latency_req == 0))
+		return 0;
+
+	sleep_length = ktime_to_us(tick_nohz_get_sleep_length());
+	data->sleep_length_us = (unsigned int) clamp_t(s64, sleep_length, 0,
+						       UINT_MAX);
+	predicted = data->sleep_length_us;
+
+	interval = predict_typical_interval(data);
+	if (!interval)
+		interval = predict_early_interval(data);
+	if (interval && interval < predicted)
+		predicted = interval;
+
+	data->predicted_us = predicted;
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+
+		if (s->disable)
+			continue;
+		if (s->target_residency > predicted)
+			continue;
+		if (s->exit_latency > latency_req)
+			continue;
+
+		data->last_state_idx = i;
+	}
+
+	return data->last_state_idx;
+}
+
+static void predict_reflect(struct cpuidle_device *dev, int index)
+{
+	struct predict_device *data = &__get_cpu_var(predict_devices);
+
+	data->last_state_idx = index;
+	if (index >= 0)
+		data->needs_update = 1;
+}
+
+static int predict_enable_device(struct cpuidle_driver *drv,
+				 struct cpuidle_device *dev)
+{
+	struct predict_device *data = &per_cpu(predict_devices, dev->cpu);
+
+	memset(data, 0, sizeof(struct predict_device));
+	data->active = 1;
+
+	return 0;
+}
+
+static void predict_disable_device(struct cpuidle_driver *drv,
+				   struct cpuidle_device *dev)
+{
+	per_cpu(predict_devices, dev->cpu).active = 0;
+}
+
+/**
+ * cpuidle_predict_get_us - the idle duration predicted for this sleep
+ * @dev: the CPU about to enter idle
+ *
+ * For drivers that pick the state themselves.  Returns 0 if the predict
+ * governor isn't in use.
+ */
+unsigned int cpuidle_predict_get_us(struct cpuidle_device *dev)
+{
+	struct predict_device *data = &per_cpu(predict_devices, dev->cpu);
+
+	return data->active ? data->predicted_us : 0;
+}
+EXPORT_SYMBOL_GPL(cpuidle_predict_get_us);
+
+static struct cpuidle_governor predict_governor = {
+	.name =		"predict",
+	.rating =	30,
+	.enable =	predict_enable_device,
+	.disable =	predict_disable_device,
+	.select =	predict_select,
+	.reflect =	predict_reflect,
+	.owner =	THIS_MODULE,
+};
+
+static int __init init_predict(void)
+{
+	return cpuidle_register_governor(&predict_governor);
+}
+
+static void __exit exit_predict(void)
+{
+	cpuidle_unregister_governor(&predict_governor);
+}
+
+MODULE_LICENSE("GPL");
+module_init(init_predict);
+module_exit(exit_predict);
@@ -136,6 +136,8 @@ struct qce_req {
 	unsigned int cryptlen;		
 	unsigned int use_pmem;		
 	struct qcedev_pmem_info *pmem;	
+	/* XTS data unit, tweak steps by one per unit; 0 means cryptlen */
+	unsigned int xts_du_size;
 };
 
 void *qce_open(struct platform_device *pdev, int *rc);
@@ -568,6 +568,7 @@ static int _ce_setup_cipher(struct qce_device *pce_dev, struct qce_req *creq,
 			memcpy(buffer->encr_xts_key, (creq->enckey +
 					creq->encklen/2), creq->encklen/2);
 			*((uint32_t *)(buffer->encr_xts_du_size)) =
+					creq->xts_du_size ? creq->xts_du_size :
 							creq->cryptlen;
 
 		}
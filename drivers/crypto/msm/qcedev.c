@@ -449,6 +449,7 @@ static int start_cipher_req(struct qcedev_control *podev)
 	qcedev_areq = podev->active_command;
 
 	qcedev_areq->cipher_req.cookie = qcedev_areq->handle;
+	creq.xts_du_size = 0;
 	creq.use_pmem = qcedev_areq->cipher_op_req.use_pmem;
 	if (qcedev_areq->cipher_op_req.use_pmem == QCEDEV_USE_PMEM)
 		creq.pmem = &qcedev_areq->cipher_op_req.pmem;
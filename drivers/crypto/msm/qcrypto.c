@@ -24,6 +24,8 @@
 #include <linux/interrupt.h>
 #include <linux/spinlock.h>
 #include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <asm/unaligned.h>
 
 #include <crypto/ctr.h>
 #include <crypto/des.h>
@@ -44,7 +46,11 @@
 
 #define MAX_CRYPTO_DEVICE 3
 #define DEBUG_MAX_FNAME  16
-#define DEBUG_MAX_RW_BUF 1024
+#define DEBUG_MAX_RW_BUF 2048
+
+/* Most cipher requests, and scatterlist entries, one CE operation carries */
+#define QCRYPTO_BATCH_MAX	16
+#define QCRYPTO_BATCH_SG	64
 
 struct crypto_stat {
 	u32 aead_sha1_aes_enc;
@@ -71,6 +77,14 @@ struct crypto_stat {
 	u32 sha256_hmac_digest;
 	u32 sha_hmac_op_success;
 	u32 sha_hmac_op_fail;
+	u32 ablk_cipher_ce_op;
+	u32 ablk_cipher_sw_op;
+	u64 ablk_cipher_ce_ns;
+	u64 ablk_cipher_sw_ns;
+	u32 ablk_cipher_batch_op;
+	u32 ablk_cipher_batched;
+	u32 ablk_cipher_list_op;
+	u32 sha_list_op;
 };
 static struct crypto_stat _qcrypto_stat[MAX_CRYPTO_DEVICE];
 static struct dentry *_debug_dent;
@@ -109,6 +123,16 @@ struct crypto_priv {
 	struct work_struct unlock_ce_ws;
 
 	struct tasklet_struct done_tasklet;
+
+	/* XTS sectors merged into the CE operation in flight */
+	struct ablkcipher_request *batch_req;
+	struct ablkcipher_request *batch[QCRYPTO_BATCH_MAX];
+	unsigned int batch_cnt;
+	struct scatterlist batch_src[QCRYPTO_BATCH_SG];
+	struct scatterlist batch_dst[QCRYPTO_BATCH_SG];
+
+	/* Batch submissions in progress, the queue is not kicked meanwhile */
+	unsigned int plugged;
 };
 
 
@@ -120,6 +144,29 @@ struct crypto_priv {
 
 static DEFINE_MUTEX(sent_bw_req);
 
+/*
+ * Cipher requests shorter than this, or arriving while more than
+ * qcrypto_sw_qlen requests wait for the CE, run on the CPU instead of
+ * paying for the CE lock, bus vote and DMA setup.  0 turns either off.
+ */
+static unsigned int qcrypto_sw_bytes = 512;
+module_param(qcrypto_sw_bytes, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(qcrypto_sw_bytes, "Run shorter cipher requests on the CPU");
+
+static unsigned int qcrypto_sw_qlen;
+module_param(qcrypto_sw_qlen, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(qcrypto_sw_qlen, "Run cipher requests on the CPU past this CE backlog");
+
+/*
+ * Queued XTS requests on the same tfm with equal length and consecutive
+ * tweaks (dm-crypt plain64 sectors) are run as one CE operation, the
+ * engine stepping the tweak every data unit.  Up to this many requests
+ * are merged, 1 or 0 turns it off.
+ */
+static unsigned int qcrypto_xts_batch;
+module_param(qcrypto_xts_batch, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(qcrypto_xts_batch, "Merge up to this many XTS sectors per CE operation");
+
 static int qcrypto_scm_cmd(int resource, int cmd, int *response)
 {
 #ifdef CONFIG_MSM_SCM
@@ -211,6 +258,9 @@ struct qcrypto_cipher_ctx {
 	unsigned int auth_key_len;
 
 	struct crypto_priv *cp;
+
+	struct crypto_blkcipher *fallback;
+	bool fallback_keyed;
 };
 
 struct qcrypto_cipher_req_ctx {
@@ -224,6 +274,7 @@ struct qcrypto_cipher_req_ctx {
 	enum qce_cipher_alg_enum alg;
 	enum qce_cipher_dir_enum dir;
 	enum qce_cipher_mode_enum mode;
+	ktime_t start;
 };
 
 #define SHA_MAX_BLOCK_SIZE      SHA256_BLOCK_SIZE
@@ -352,6 +403,80 @@ static void qcrypto_ce_high_bw_req(struct crypto_priv *cp, bool high_bw_req)
 
 static void _start_qcrypto_process(struct crypto_priv *cp);
 
+static void _qcrypto_plug(struct crypto_priv *cp)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cp->lock, flags);
+	cp->plugged++;
+	spin_unlock_irqrestore(&cp->lock, flags);
+}
+
+static void _qcrypto_unplug(struct crypto_priv *cp)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cp->lock, flags);
+	cp->plugged--;
+	spin_unlock_irqrestore(&cp->lock, flags);
+	_start_qcrypto_process(cp);
+}
+
+/*
+ * Queue the whole batch before the engine is started, so consecutive
+ * XTS sectors can share a CE operation and an idle CE is set up once.
+ */
+static int _qcrypto_ablk_batch(struct ablkcipher_request **reqs,
+				unsigned int nreqs, bool encrypt)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(reqs[0]->base.tfm);
+	struct crypto_priv *cp = ctx->cp;
+	unsigned int i;
+	int ret;
+
+	_qcrypto_plug(cp);
+	for (i = 0; i < nreqs; i++) {
+		if (encrypt)
+			ret = crypto_ablkcipher_encrypt(reqs[i]);
+		else
+			ret = crypto_ablkcipher_decrypt(reqs[i]);
+		crypto_batch_complete(&reqs[i]->base, ret);
+	}
+	_qcrypto_unplug(cp);
+
+	_qcrypto_stat[cp->pdev->id].ablk_cipher_list_op++;
+	return 0;
+}
+
+static int _qcrypto_ablk_encrypt_batch(struct ablkcipher_request **reqs,
+				unsigned int nreqs)
+{
+	return _qcrypto_ablk_batch(reqs, nreqs, true);
+}
+
+static int _qcrypto_ablk_decrypt_batch(struct ablkcipher_request **reqs,
+				unsigned int nreqs)
+{
+	return _qcrypto_ablk_batch(reqs, nreqs, false);
+}
+
+static int _qcrypto_sha_digest_batch(struct ahash_request **reqs,
+				unsigned int nreqs)
+{
+	struct qcrypto_sha_ctx *sha_ctx = crypto_tfm_ctx(reqs[0]->base.tfm);
+	struct crypto_priv *cp = sha_ctx->cp;
+	unsigned int i;
+
+	_qcrypto_plug(cp);
+	for (i = 0; i < nreqs; i++)
+		crypto_batch_complete(&reqs[i]->base,
+				crypto_ahash_digest(reqs[i]));
+	_qcrypto_unplug(cp);
+
+	_qcrypto_stat[cp->pdev->id].sha_list_op++;
+	return 0;
+}
+
 static struct qcrypto_alg *_qcrypto_sha_alg_alloc(struct crypto_priv *cp,
 		struct ahash_alg *template)
 {
@@ -365,6 +490,7 @@ static struct qcrypto_alg *_qcrypto_sha_alg_alloc(struct crypto_priv *cp,
 
 	q_alg->alg_type = QCRYPTO_ALG_SHA;
 	q_alg->sha_alg = *template;
+	q_alg->sha_alg.digest_batch = _qcrypto_sha_digest_batch;
 	q_alg->cp = cp;
 
 	return q_alg;
@@ -384,6 +510,13 @@ static struct qcrypto_alg *_qcrypto_cipher_alg_alloc(struct crypto_priv *cp,
 
 	q_alg->alg_type = QCRYPTO_ALG_CIPHER;
 	q_alg->cipher_alg = *template;
+	if ((template->cra_flags & CRYPTO_ALG_TYPE_MASK) ==
+					CRYPTO_ALG_TYPE_ABLKCIPHER) {
+		q_alg->cipher_alg.cra_ablkcipher.encrypt_batch =
+					_qcrypto_ablk_encrypt_batch;
+		q_alg->cipher_alg.cra_ablkcipher.decrypt_batch =
+					_qcrypto_ablk_decrypt_batch;
+	}
 	q_alg->cp = cp;
 
 	return q_alg;
@@ -500,7 +633,23 @@ static int _qcrypto_ahash_hmac_cra_init(struct crypto_tfm *tfm)
 
 static int _qcrypto_cra_ablkcipher_init(struct crypto_tfm *tfm)
 {
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(tfm);
+
 	tfm->crt_ablkcipher.reqsize = sizeof(struct qcrypto_cipher_req_ctx);
+
+	/* A synchronous software tfm for the CPU path, AES modes only */
+	ctx->fallback = NULL;
+	ctx->fallback_keyed = false;
+	if (strstr(name, "(aes)")) {
+		ctx->fallback = crypto_alloc_blkcipher(name, 0,
+				CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+		if (IS_ERR(ctx->fallback)) {
+			pr_debug("qcrypto: no %s fallback\n", name);
+			ctx->fallback = NULL;
+		}
+	}
+
 	return _qcrypto_cipher_cra_init(tfm);
 };
 
@@ -514,6 +663,9 @@ static void _qcrypto_cra_ablkcipher_exit(struct crypto_tfm *tfm)
 {
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
 
+	if (ctx->fallback)
+		crypto_free_blkcipher(ctx->fallback);
+
 	if (ctx->cp->platform_support.bus_scale_table != NULL)
 		qcrypto_ce_high_bw_req(ctx->cp, false);
 };
@@ -616,6 +768,34 @@ static int _disp_stats(int id)
 	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   SHA HMAC operation success          : %d\n",
 					pstat->sha_hmac_op_success);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER on CE            : %d\n",
+					pstat->ablk_cipher_ce_op);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER CE avg latency us: %llu\n",
+			pstat->ablk_cipher_ce_op ?
+			div_u64(div_u64(pstat->ablk_cipher_ce_ns,
+				pstat->ablk_cipher_ce_op), 1000) : 0);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER on CPU           : %d\n",
+					pstat->ablk_cipher_sw_op);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER CPU avg latency us: %llu\n",
+			pstat->ablk_cipher_sw_op ?
+			div_u64(div_u64(pstat->ablk_cipher_sw_ns,
+				pstat->ablk_cipher_sw_op), 1000) : 0);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER batched CE ops   : %d\n",
+					pstat->ablk_cipher_batch_op);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER batched requests : %d\n",
+					pstat->ablk_cipher_batched);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER batch submits    : %d\n",
+					pstat->ablk_cipher_list_op);
+	len += snprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   SHA batch submits            : %d\n",
+					pstat->sha_list_op);
 	return len;
 }
 
@@ -645,6 +825,7 @@ static int _qcrypto_remove(struct platform_device *pdev)
 	if (cp->qce)
 		qce_close(cp->qce);
 	tasklet_kill(&cp->done_tasklet);
+	kfree(cp->batch_req);
 	kfree(cp);
 	return 0;
 };
@@ -669,6 +850,10 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 	};
 	ctx->enc_key_len = len;
 	memcpy(ctx->enc_key, key, len);
+
+	if (ctx->fallback)
+		ctx->fallback_keyed =
+			!crypto_blkcipher_setkey(ctx->fallback, key, len);
 	return 0;
 };
 
@@ -710,19 +895,35 @@ static int _qcrypto_setkey_3des(struct crypto_ablkcipher *cipher, const u8 *key,
 	return 0;
 };
 
-static void req_done(unsigned long data)
+/* Complete the request(s) of the finished CE operation with @res */
+static void _qcrypto_finish_req(struct crypto_priv *cp, int res)
 {
 	struct crypto_async_request *areq;
-	struct crypto_priv *cp = (struct crypto_priv *)data;
+	struct ablkcipher_request *batch[QCRYPTO_BATCH_MAX];
+	unsigned int batch_cnt;
 	unsigned long flags;
+	int i;
 
 	spin_lock_irqsave(&cp->lock, flags);
 	areq = cp->req;
 	cp->req = NULL;
+	batch_cnt = cp->batch_cnt;
+	memcpy(batch, cp->batch, batch_cnt * sizeof(batch[0]));
+	cp->batch_cnt = 0;
 	spin_unlock_irqrestore(&cp->lock, flags);
 
-	if (areq)
-		areq->complete(areq, cp->res);
+	if (batch_cnt) {
+		for (i = 0; i < batch_cnt; i++)
+			batch[i]->base.complete(&batch[i]->base, res);
+	} else if (areq)
+		areq->complete(areq, res);
+}
+
+static void req_done(unsigned long data)
+{
+	struct crypto_priv *cp = (struct crypto_priv *)data;
+
+	_qcrypto_finish_req(cp, cp->res);
 	_start_qcrypto_process(cp);
 };
 
@@ -826,6 +1027,7 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 	struct ablkcipher_request *areq = (struct ablkcipher_request *) cookie;
 	struct crypto_ablkcipher *ablk = crypto_ablkcipher_reqtfm(areq);
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(areq->base.tfm);
+	struct qcrypto_cipher_req_ctx *rctx;
 	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
@@ -838,6 +1040,11 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 	if (iv)
 		memcpy(ctx->iv, iv, crypto_ablkcipher_ivsize(ablk));
 
+	rctx = ablkcipher_request_ctx(areq);
+	pstat->ablk_cipher_ce_op++;
+	pstat->ablk_cipher_ce_ns += ktime_to_ns(ktime_sub(ktime_get(),
+							rctx->start));
+
 	if (ret) {
 		cp->res = -ENXIO;
 		pstat->ablk_cipher_op_fail++;
@@ -984,6 +1191,140 @@ static int qcrypto_aead_ccm_format_adata(struct qce_req *qreq, uint32_t alen,
 	return 0;
 }
 
+static int _qcrypto_batch_add_sg(struct scatterlist *tbl, unsigned int *n,
+		struct scatterlist *sg, unsigned int nbytes)
+{
+	unsigned int i = *n;
+	unsigned int len;
+
+	for (; nbytes; sg = sg_next(sg)) {
+		if (!sg || i >= QCRYPTO_BATCH_SG)
+			return -ENOMEM;
+		len = min(nbytes, sg->length);
+		sg_set_page(&tbl[i++], sg_page(sg), len, sg->offset);
+		nbytes -= len;
+	}
+	*n = i;
+	return 0;
+}
+
+static bool _qcrypto_batch_match(struct ablkcipher_request *req,
+		struct crypto_async_request *async_req, unsigned int k)
+{
+	struct ablkcipher_request *next;
+	struct qcrypto_cipher_req_ctx *rctx = ablkcipher_request_ctx(req);
+	struct qcrypto_cipher_req_ctx *nctx;
+	u8 *iv = req->info;
+	u8 *niv;
+
+	if (async_req->tfm != req->base.tfm)
+		return false;
+	next = ablkcipher_request_cast(async_req);
+	nctx = ablkcipher_request_ctx(next);
+	niv = next->info;
+
+	return nctx->mode == QCE_MODE_XTS && nctx->dir == rctx->dir &&
+		next->nbytes == req->nbytes &&
+		(next->src == next->dst) == (req->src == req->dst) &&
+		get_unaligned_le64(niv) == get_unaligned_le64(iv) + k &&
+		!memcmp(niv + 8, iv + 8, AES_BLOCK_SIZE - 8);
+}
+
+/*
+ * Dequeue the XTS sectors queued right behind @req that continue its
+ * tweak and build cp->batch_req over all of them.  Returns the number
+ * of requests merged, 0 when @req goes to the CE alone.
+ */
+static unsigned int _qcrypto_ablk_batch(struct crypto_priv *cp,
+				struct ablkcipher_request *req)
+{
+	struct ablkcipher_request *breq = cp->batch_req;
+	struct crypto_async_request *async_req;
+	struct crypto_stat *pstat = &_qcrypto_stat[cp->pdev->id];
+	bool inplace = (req->src == req->dst);
+	unsigned int max = min_t(unsigned int, qcrypto_xts_batch,
+							QCRYPTO_BATCH_MAX);
+	unsigned int nsrc = 0, ndst = 0;
+	unsigned int osrc, odst;
+	unsigned int cnt = 1;
+	unsigned long flags;
+
+	/* Shared CE locks are counted per request, keep those unbatched */
+	if (max < 2 || !breq || cp->platform_support.ce_shared ||
+			(req->nbytes % AES_BLOCK_SIZE) ||
+			crypto_ablkcipher_ivsize(crypto_ablkcipher_reqtfm(req))
+							!= AES_BLOCK_SIZE)
+		return 0;
+
+	spin_lock_irqsave(&cp->lock, flags);
+	if (!cp->queue.qlen || crypto_get_backlog(&cp->queue) ||
+			!_qcrypto_batch_match(req, list_first_entry(
+				&cp->queue.list, struct crypto_async_request,
+				list), 1)) {
+		spin_unlock_irqrestore(&cp->lock, flags);
+		return 0;
+	}
+
+	sg_init_table(cp->batch_src, QCRYPTO_BATCH_SG);
+	if (!inplace)
+		sg_init_table(cp->batch_dst, QCRYPTO_BATCH_SG);
+	if (_qcrypto_batch_add_sg(cp->batch_src, &nsrc, req->src,
+							req->nbytes) ||
+			(!inplace && _qcrypto_batch_add_sg(cp->batch_dst,
+					&ndst, req->dst, req->nbytes))) {
+		spin_unlock_irqrestore(&cp->lock, flags);
+		return 0;
+	}
+	cp->batch[0] = req;
+
+	while (cnt < max && cp->queue.qlen &&
+				!crypto_get_backlog(&cp->queue)) {
+		struct ablkcipher_request *next;
+
+		async_req = list_first_entry(&cp->queue.list,
+					struct crypto_async_request, list);
+		if (!_qcrypto_batch_match(req, async_req, cnt))
+			break;
+		next = ablkcipher_request_cast(async_req);
+		osrc = nsrc;
+		odst = ndst;
+		if (_qcrypto_batch_add_sg(cp->batch_src, &nsrc, next->src,
+							next->nbytes) ||
+				(!inplace && _qcrypto_batch_add_sg(
+					cp->batch_dst, &ndst, next->dst,
+					next->nbytes))) {
+			nsrc = osrc;
+			ndst = odst;
+			break;
+		}
+		crypto_dequeue_request(&cp->queue);
+		cp->batch[cnt++] = next;
+	}
+	if (cnt > 1)
+		cp->batch_cnt = cnt;
+	spin_unlock_irqrestore(&cp->lock, flags);
+
+	if (cnt == 1)
+		return 0;
+
+	sg_mark_end(&cp->batch_src[nsrc - 1]);
+	if (!inplace)
+		sg_mark_end(&cp->batch_dst[ndst - 1]);
+
+	breq->base.tfm = req->base.tfm;
+	breq->base.flags = req->base.flags;
+	breq->nbytes = req->nbytes * cnt;
+	breq->info = req->info;
+	breq->src = cp->batch_src;
+	breq->dst = inplace ? cp->batch_src : cp->batch_dst;
+	memcpy(ablkcipher_request_ctx(breq), ablkcipher_request_ctx(req),
+				sizeof(struct qcrypto_cipher_req_ctx));
+
+	pstat->ablk_cipher_batch_op++;
+	pstat->ablk_cipher_batched += cnt;
+	return cnt;
+}
+
 static void _start_qcrypto_process(struct crypto_priv *cp)
 {
 	struct crypto_async_request *async_req = NULL;
@@ -1022,6 +1363,14 @@ again:
 		rctx = ablkcipher_request_ctx(req);
 		tfm = crypto_ablkcipher_reqtfm(req);
 
+		qreq.xts_du_size = 0;
+		if (rctx->mode == QCE_MODE_XTS &&
+				_qcrypto_ablk_batch(cp, req)) {
+			qreq.xts_du_size = req->nbytes;
+			req = cp->batch_req;
+			rctx = ablkcipher_request_ctx(req);
+		}
+
 		qreq.op = QCE_REQ_ABLK_CIPHER;
 		qreq.qce_cb = _qce_ablk_cipher_complete;
 		qreq.areq = req;
@@ -1094,6 +1443,7 @@ again:
 
 			qreq.op = QCE_REQ_AEAD;
 			qreq.qce_cb = _qce_aead_complete;
+			qreq.xts_du_size = 0;
 
 			qreq.areq = req;
 			qreq.alg = rctx->alg;
@@ -1137,11 +1487,6 @@ again:
 	};
 done:
 	if (ret) {
-
-		spin_lock_irqsave(&cp->lock, flags);
-		cp->req = NULL;
-		spin_unlock_irqrestore(&cp->lock, flags);
-
 		if (type == CRYPTO_ALG_TYPE_ABLKCIPHER)
 			pstat->ablk_cipher_op_fail++;
 		else
@@ -1150,7 +1495,7 @@ done:
 			else
 				pstat->aead_op_fail++;
 
-		async_req->complete(async_req, ret);
+		_qcrypto_finish_req(cp, ret);
 		goto again;
 	};
 };
@@ -1159,6 +1504,7 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 				struct crypto_async_request *req)
 {
 	int ret;
+	bool plugged;
 	unsigned long flags;
 
 	if (cp->platform_support.ce_shared) {
@@ -1169,12 +1515,63 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 
 	spin_lock_irqsave(&cp->lock, flags);
 	ret = crypto_enqueue_request(&cp->queue, req);
+	plugged = cp->plugged;
 	spin_unlock_irqrestore(&cp->lock, flags);
-	_start_qcrypto_process(cp);
+	if (!plugged)
+		_start_qcrypto_process(cp);
 
 	return ret;
 }
 
+static bool _qcrypto_ablk_use_sw(struct crypto_priv *cp,
+				struct qcrypto_cipher_ctx *ctx,
+				struct ablkcipher_request *req)
+{
+	if (!ctx->fallback_keyed)
+		return false;
+	if (qcrypto_sw_bytes && req->nbytes < qcrypto_sw_bytes)
+		return true;
+	if (qcrypto_sw_qlen && cp->queue.qlen > qcrypto_sw_qlen)
+		return true;
+	return false;
+}
+
+static int _qcrypto_ablk_queue_req(struct crypto_priv *cp,
+				struct ablkcipher_request *req)
+{
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
+	struct qcrypto_cipher_req_ctx *rctx = ablkcipher_request_ctx(req);
+	struct crypto_stat *pstat = &_qcrypto_stat[cp->pdev->id];
+	struct blkcipher_desc desc;
+	ktime_t start = ktime_get();
+	int ret;
+
+	if (!_qcrypto_ablk_use_sw(cp, ctx, req)) {
+		rctx->start = start;
+		return _qcrypto_queue_req(cp, &req->base);
+	}
+
+	desc.tfm = ctx->fallback;
+	desc.info = req->info;
+	desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	/* CTR decryption is queued as QCE_ENCRYPT, which is the same thing */
+	if (rctx->dir == QCE_ENCRYPT)
+		ret = crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						req->nbytes);
+	else
+		ret = crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+						req->nbytes);
+
+	pstat->ablk_cipher_sw_op++;
+	pstat->ablk_cipher_sw_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (ret)
+		pstat->ablk_cipher_op_fail++;
+	else
+		pstat->ablk_cipher_op_success++;
+	return ret;
+}
+
 static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
@@ -1196,7 +1593,7 @@ static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_aes_enc++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_enc_aes_cbc(struct ablkcipher_request *req)
@@ -1220,7 +1617,7 @@ static int _qcrypto_enc_aes_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_aes_enc++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_enc_aes_ctr(struct ablkcipher_request *req)
@@ -1244,7 +1641,7 @@ static int _qcrypto_enc_aes_ctr(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CTR;
 
 	pstat->ablk_cipher_aes_enc++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_enc_aes_xts(struct ablkcipher_request *req)
@@ -1265,7 +1662,7 @@ static int _qcrypto_enc_aes_xts(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_XTS;
 
 	pstat->ablk_cipher_aes_enc++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_aead_encrypt_aes_ccm(struct aead_request *req)
@@ -1312,7 +1709,7 @@ static int _qcrypto_enc_des_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_des_enc++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_enc_des_cbc(struct ablkcipher_request *req)
@@ -1333,7 +1730,7 @@ static int _qcrypto_enc_des_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_des_enc++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_enc_3des_ecb(struct ablkcipher_request *req)
@@ -1354,7 +1751,7 @@ static int _qcrypto_enc_3des_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_3des_enc++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_enc_3des_cbc(struct ablkcipher_request *req)
@@ -1375,7 +1772,7 @@ static int _qcrypto_enc_3des_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_3des_enc++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_dec_aes_ecb(struct ablkcipher_request *req)
@@ -1399,7 +1796,7 @@ static int _qcrypto_dec_aes_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_aes_dec++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_dec_aes_cbc(struct ablkcipher_request *req)
@@ -1424,7 +1821,7 @@ static int _qcrypto_dec_aes_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_aes_dec++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_dec_aes_ctr(struct ablkcipher_request *req)
@@ -1450,7 +1847,7 @@ static int _qcrypto_dec_aes_ctr(struct ablkcipher_request *req)
 	rctx->dir = QCE_ENCRYPT;
 
 	pstat->ablk_cipher_aes_dec++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_dec_des_ecb(struct ablkcipher_request *req)
@@ -1471,7 +1868,7 @@ static int _qcrypto_dec_des_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_des_dec++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_dec_des_cbc(struct ablkcipher_request *req)
@@ -1492,7 +1889,7 @@ static int _qcrypto_dec_des_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_des_dec++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_dec_3des_ecb(struct ablkcipher_request *req)
@@ -1513,7 +1910,7 @@ static int _qcrypto_dec_3des_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_3des_dec++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_dec_3des_cbc(struct ablkcipher_request *req)
@@ -1534,7 +1931,7 @@ static int _qcrypto_dec_3des_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_3des_dec++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 static int _qcrypto_dec_aes_xts(struct ablkcipher_request *req)
@@ -1555,7 +1952,7 @@ static int _qcrypto_dec_aes_xts(struct ablkcipher_request *req)
 	rctx->dir = QCE_DECRYPT;
 
 	pstat->ablk_cipher_aes_dec++;
-	return _qcrypto_queue_req(cp, &req->base);
+	return _qcrypto_ablk_queue_req(cp, req);
 };
 
 
@@ -3055,6 +3452,9 @@ static int  _qcrypto_probe(struct platform_device *pdev)
 	spin_lock_init(&cp->lock);
 	tasklet_init(&cp->done_tasklet, req_done, (unsigned long)cp);
 	crypto_init_queue(&cp->queue, 50);
+	/* Batching is simply left off if this fails */
+	cp->batch_req = kzalloc(sizeof(struct ablkcipher_request) +
+			sizeof(struct qcrypto_cipher_req_ctx), GFP_KERNEL);
 	cp->qce = handle;
 	cp->pdev = pdev;
 	qce_hw_support(cp->qce, &cp->ce_support);
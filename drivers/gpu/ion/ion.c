@@ -22,6 +22,7 @@
 #include <linux/anon_inodes.h>
 #include <linux/ion.h>
 #include <linux/list.h>
+#include <linux/lockstat_lite.h>
 #include <linux/memblock.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
@@ -206,6 +207,7 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	buffer->sg_table = table;
 
 	mutex_init(&buffer->lock);
+	INIT_LIST_HEAD(&buffer->kmap_cache);
 	ion_buffer_add(dev, buffer);
 	return buffer;
 }
@@ -238,22 +240,125 @@ static void ion_iommu_delayed_unmap(struct ion_buffer *buffer)
 	mutex_unlock(&buffer->lock);
 }
 
-static void ion_buffer_destroy(struct kref *kref)
+/*
+ * The kernel mapping of a system or iommu heap buffer outlives its last
+ * ion_unmap_kernel() on a short LRU, so buffers that are mapped and
+ * unmapped over and over (camera post-processing, the rotator) do not
+ * vmap and vunmap, and flush the TLB for it, every time.  A parked
+ * buffer has a vaddr with a zero kmap_cnt.  Lock order is buffer->lock,
+ * then ion_kmap_cache_lock; the LRU only trylocks the buffers it evicts.
+ */
+#define ION_KMAP_CACHE_MAX	8
+
+static DEFINE_MUTEX(ion_kmap_cache_lock);
+static LIST_HEAD(ion_kmap_cache);
+static unsigned int ion_kmap_cache_count;
+
+static bool ion_kmap_cacheable(struct ion_buffer *buffer)
 {
-	struct ion_buffer *buffer = container_of(kref, struct ion_buffer, ref);
-	struct ion_device *dev = buffer->dev;
+	return buffer->heap->type == ION_HEAP_TYPE_SYSTEM ||
+	       buffer->heap->type == ION_HEAP_TYPE_IOMMU;
+}
+
+/* Call with buffer->lock held, once kmap_cnt has dropped to zero */
+static bool ion_kmap_cache_park(struct ion_buffer *buffer)
+{
+	struct ion_buffer *victim, *tmp;
+
+	if (!ion_kmap_cacheable(buffer))
+		return false;
+
+	mutex_lock(&ion_kmap_cache_lock);
+	list_add(&buffer->kmap_cache, &ion_kmap_cache);
+	ion_kmap_cache_count++;
+	list_for_each_entry_safe_reverse(victim, tmp, &ion_kmap_cache,
+					 kmap_cache) {
+		if (ion_kmap_cache_count <= ION_KMAP_CACHE_MAX)
+			break;
+		if (victim == buffer || !mutex_trylock(&victim->lock))
+			continue;
+		victim->heap->ops->unmap_kernel(victim->heap, victim);
+		victim->vaddr = NULL;
+		list_del_init(&victim->kmap_cache);
+		ion_kmap_cache_count--;
+		mutex_unlock(&victim->lock);
+	}
+	mutex_unlock(&ion_kmap_cache_lock);
+	return true;
+}
+
+/*
+ * Call with buffer->lock held on a parked buffer.  Returns false, with the
+ * mapping gone, if it was made for other flags than the buffer has now.
+ */
+static bool ion_kmap_cache_take(struct ion_buffer *buffer)
+{
+	mutex_lock(&ion_kmap_cache_lock);
+	list_del_init(&buffer->kmap_cache);
+	ion_kmap_cache_count--;
+	mutex_unlock(&ion_kmap_cache_lock);
+
+	if (buffer->kmap_flags == buffer->flags)
+		return true;
+	buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
+	buffer->vaddr = NULL;
+	return false;
+}
+
+static void ion_kmap_cache_drop(struct ion_buffer *buffer)
+{
+	bool parked;
+
+	if (!ion_kmap_cacheable(buffer))
+		return;
+
+	mutex_lock(&ion_kmap_cache_lock);
+	parked = !list_empty(&buffer->kmap_cache);
+	if (parked) {
+		list_del_init(&buffer->kmap_cache);
+		ion_kmap_cache_count--;
+	}
+	mutex_unlock(&ion_kmap_cache_lock);
 
+	if (parked) {
+		buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
+		buffer->vaddr = NULL;
+	}
+}
+
+/*
+ * Release the memory of a buffer that is no longer on the device's tree.
+ * This can run on the heap's deferred free thread or from a shrinker so it
+ * must not take the device lock.
+ */
+void ion_buffer_destroy(struct ion_buffer *buffer)
+{
 	if (WARN_ON(buffer->kmap_cnt > 0))
 		buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
+	else
+		ion_kmap_cache_drop(buffer);
 
 	buffer->heap->ops->unmap_dma(buffer->heap, buffer);
 
 	ion_iommu_delayed_unmap(buffer);
+	buffer->heap->ops->free(buffer);
+	kfree(buffer);
+}
+
+static void _ion_buffer_destroy(struct kref *kref)
+{
+	struct ion_buffer *buffer = container_of(kref, struct ion_buffer, ref);
+	struct ion_heap *heap = buffer->heap;
+	struct ion_device *dev = buffer->dev;
+
 	mutex_lock(&dev->lock);
 	rb_erase(&buffer->node, &dev->buffers);
 	mutex_unlock(&dev->lock);
-	buffer->heap->ops->free(buffer);
-	kfree(buffer);
+
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		ion_heap_freelist_add(heap, buffer);
+	else
+		ion_buffer_destroy(buffer);
 }
 
 static void ion_buffer_get(struct ion_buffer *buffer)
@@ -263,7 +368,7 @@ static void ion_buffer_get(struct ion_buffer *buffer)
 
 static int ion_buffer_put(struct ion_buffer *buffer)
 {
-	return kref_put(&buffer->ref, ion_buffer_destroy);
+	return kref_put(&buffer->ref, _ion_buffer_destroy);
 }
 
 static struct ion_handle *ion_handle_create(struct ion_client *client,
@@ -440,7 +545,7 @@ struct ion_handle *ion_alloc(struct ion_client *client, size_t len,
 	ion_buffer_put(buffer);
 
 	if (!IS_ERR(handle)) {
-		mutex_lock(&client->lock);
+		lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 		ion_handle_add(client, handle);
 		mutex_unlock(&client->lock);
 	}
@@ -456,7 +561,7 @@ void ion_free(struct ion_client *client, struct ion_handle *handle)
 
 	BUG_ON(client != handle->client);
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	valid_handle = ion_handle_validate(client, handle);
 	if (!valid_handle) {
 		mutex_unlock(&client->lock);
@@ -474,7 +579,7 @@ int ion_phys(struct ion_client *client, struct ion_handle *handle,
 	struct ion_buffer *buffer;
 	int ret;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	if (!ion_handle_validate(client, handle)) {
 		mutex_unlock(&client->lock);
 		return -EINVAL;
@@ -502,10 +607,15 @@ static void *ion_buffer_kmap_get(struct ion_buffer *buffer)
 		buffer->kmap_cnt++;
 		return buffer->vaddr;
 	}
+	if (buffer->vaddr && ion_kmap_cache_take(buffer)) {
+		buffer->kmap_cnt++;
+		return buffer->vaddr;
+	}
 	vaddr = buffer->heap->ops->map_kernel(buffer->heap, buffer);
 	if (IS_ERR_OR_NULL(vaddr))
 		return vaddr;
 	buffer->vaddr = vaddr;
+	buffer->kmap_flags = buffer->flags;
 	buffer->kmap_cnt++;
 	return vaddr;
 }
@@ -529,7 +639,7 @@ static void *ion_handle_kmap_get(struct ion_handle *handle)
 static void ion_buffer_kmap_put(struct ion_buffer *buffer)
 {
 	buffer->kmap_cnt--;
-	if (!buffer->kmap_cnt) {
+	if (!buffer->kmap_cnt && !ion_kmap_cache_park(buffer)) {
 		buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
 		buffer->vaddr = NULL;
 	}
@@ -598,7 +708,7 @@ int ion_map_iommu(struct ion_client *client, struct ion_handle *handle,
 		return -EINVAL;
 	}
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	if (!ion_handle_validate(client, handle)) {
 		pr_err("%s: invalid handle passed to map_kernel.\n",
 		       __func__);
@@ -694,7 +804,7 @@ void ion_unmap_iommu(struct ion_client *client, struct ion_handle *handle,
 	struct ion_iommu_map *iommu_map;
 	struct ion_buffer *buffer;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	buffer = handle->buffer;
 
 	mutex_lock(&buffer->lock);
@@ -724,7 +834,7 @@ void *ion_map_kernel(struct ion_client *client, struct ion_handle *handle,
 	struct ion_buffer *buffer;
 	void *vaddr;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	if (!ion_handle_validate(client, handle)) {
 		pr_err("%s: invalid handle passed to map_kernel.\n",
 		       __func__);
@@ -758,7 +868,7 @@ void ion_unmap_kernel(struct ion_client *client, struct ion_handle *handle)
 {
 	struct ion_buffer *buffer;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	buffer = handle->buffer;
 	mutex_lock(&buffer->lock);
 	ion_handle_kmap_put(handle);
@@ -774,7 +884,7 @@ int ion_do_cache_op(struct ion_client *client, struct ion_handle *handle,
 	struct ion_buffer *buffer;
 	int ret = -EINVAL;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	if (!ion_handle_validate(client, handle)) {
 		pr_err("%s: invalid handle passed to do_cache_op.\n",
 		       __func__);
@@ -818,7 +928,7 @@ static int ion_debug_client_show(struct seq_file *s, void *unused)
 			"heap_name", "size_in_bytes", "handle refcount",
 			"buffer", "physical", "[domain,partition] - virt");
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	for (n = rb_first(&client->handles); n; n = rb_next(n)) {
 		struct ion_handle *handle = rb_entry(n, struct ion_handle,
 						     node);
@@ -951,7 +1061,7 @@ void ion_client_destroy(struct ion_client *client)
 	while ((n = rb_first(&client->handles))) {
 		struct ion_handle *handle = rb_entry(n, struct ion_handle,
 						     node);
-		mutex_lock(&client->lock);
+		lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 		ion_handle_destroy(&handle->ref);
 		mutex_unlock(&client->lock);
 	}
@@ -972,7 +1082,7 @@ int ion_handle_get_flags(struct ion_client *client, struct ion_handle *handle,
 {
 	struct ion_buffer *buffer;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	if (!ion_handle_validate(client, handle)) {
 		pr_err("%s: invalid handle passed to %s.\n",
 		       __func__, __func__);
@@ -994,7 +1104,7 @@ int ion_handle_get_size(struct ion_client *client, struct ion_handle *handle,
 {
 	struct ion_buffer *buffer;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	if (!ion_handle_validate(client, handle)) {
 		pr_err("%s: invalid handle passed to %s.\n",
 		       __func__, __func__);
@@ -1017,7 +1127,7 @@ struct sg_table *ion_sg_table(struct ion_client *client,
 	struct ion_buffer *buffer;
 	struct sg_table *table;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	if (!ion_handle_validate(client, handle)) {
 		pr_err("%s: invalid handle passed to map_dma.\n",
 		       __func__);
@@ -1180,7 +1290,7 @@ static int ion_share_set_flags(struct ion_client *client,
 	if (flags & O_DSYNC)
 		ion_flags = ION_SET_CACHE(UNCACHED);
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	valid_handle = ion_handle_validate(client, handle);
 	mutex_unlock(&client->lock);
 	if (!valid_handle) {
@@ -1207,7 +1317,7 @@ int ion_share_dma_buf(struct ion_client *client, struct ion_handle *handle)
 	bool valid_handle;
 	int fd;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	valid_handle = ion_handle_validate(client, handle);
 	mutex_unlock(&client->lock);
 	if (!valid_handle) {
@@ -1249,7 +1359,7 @@ struct ion_handle *ion_import_dma_buf(struct ion_client *client, int fd)
 	}
 	buffer = dmabuf->priv;
 
-	mutex_lock(&client->lock);
+	lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 	
 	handle = ion_handle_lookup(client, buffer);
 	if (!IS_ERR_OR_NULL(handle)) {
@@ -1317,7 +1427,7 @@ static long ion_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		if (copy_from_user(&data, (void __user *)arg,
 				   sizeof(struct ion_handle_data)))
 			return -EFAULT;
-		mutex_lock(&client->lock);
+		lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 		valid = ion_handle_validate(client, data.handle);
 		mutex_unlock(&client->lock);
 		if (!valid)
@@ -1627,6 +1737,14 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 	}
 	ion_heap_print_debug(s, heap);
 	mutex_unlock(&dev->lock);
+
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE) {
+		spin_lock(&heap->free_lock);
+		seq_printf(s, "deferred free: %u buffers (%zu bytes) last drain %lu us max drain %lu us\n",
+			   heap->free_list_count, heap->free_list_size,
+			   heap->drain_last_us, heap->drain_max_us);
+		spin_unlock(&heap->free_lock);
+	}
 	return 0;
 }
 
@@ -1670,6 +1788,14 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap)
 		}
 	}
 
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE) {
+		if (ion_heap_init_deferred_free(heap)) {
+			pr_err("%s: no deferred free thread for heap %s, freeing synchronously\n",
+				__func__, heap->name);
+			heap->flags &= ~ION_HEAP_FLAG_DEFER_FREE;
+		}
+	}
+
 	rb_link_node(&heap->node, parent, p);
 	rb_insert_color(&heap->node, &dev->heaps);
 	debugfs_create_file(heap->name, 0664, dev->debug_root, heap,
@@ -1748,7 +1874,7 @@ static int ion_debug_leak_show(struct seq_file *s, void *unused)
 		struct ion_client *client = rb_entry(n, struct ion_client,
 						     node);
 
-		mutex_lock(&client->lock);
+		lsl_mutex_lock(&client->lock, LSL_ION_CLIENT);
 		for (n2 = rb_first(&client->handles); n2; n2 = rb_next(n2)) {
 			struct ion_handle *handle = rb_entry(n2,
 						struct ion_handle, node);
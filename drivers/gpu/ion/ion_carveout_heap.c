@@ -43,6 +43,7 @@ struct ion_carveout_heap {
 	atomic_t map_count;
 	void *bus_id;
 	unsigned int has_outer_cache;
+	struct ion_cma_region *cma;
 };
 
 ion_phys_addr_t ion_carveout_allocate(struct ion_heap *heap,
@@ -51,10 +52,16 @@ ion_phys_addr_t ion_carveout_allocate(struct ion_heap *heap,
 {
 	struct ion_carveout_heap *carveout_heap =
 		container_of(heap, struct ion_carveout_heap, heap);
-	unsigned long offset = gen_pool_alloc_aligned(carveout_heap->pool,
-							size, ilog2(align));
+	unsigned long offset;
 
+	if (carveout_heap->cma && ion_cma_region_get(carveout_heap->cma))
+		return ION_CARVEOUT_ALLOCATE_FAIL;
+
+	offset = gen_pool_alloc_aligned(carveout_heap->pool, size,
+					ilog2(align));
 	if (!offset) {
+		if (carveout_heap->cma)
+			ion_cma_region_put(carveout_heap->cma);
 		if ((carveout_heap->total_size -
 		      carveout_heap->allocated_bytes) >= size)
 			pr_debug("%s: heap %s has enough memory (%lx) but"
@@ -80,6 +87,8 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
 		return;
 	gen_pool_free(carveout_heap->pool, addr, size);
 	carveout_heap->allocated_bytes -= size;
+	if (carveout_heap->cma)
+		ion_cma_region_put(carveout_heap->cma);
 }
 
 static int ion_carveout_heap_phys(struct ion_heap *heap,
@@ -182,7 +191,9 @@ void *ion_carveout_heap_map_kernel(struct ion_heap *heap,
 	if (ion_carveout_request_region(carveout_heap))
 		return NULL;
 
-	if (ION_IS_CACHED(buffer->flags))
+	if (carveout_heap->cma)
+		ret_value = ion_cma_map_kernel(buffer);
+	else if (ION_IS_CACHED(buffer->flags))
 		ret_value = ioremap_cached(buffer->priv_phys, buffer->size);
 	else
 		ret_value = ioremap(buffer->priv_phys, buffer->size);
@@ -277,6 +288,8 @@ static int ion_carveout_print_debug(struct ion_heap *heap, struct seq_file *s,
 	seq_printf(s, "total bytes currently allocated: %lx\n",
 		carveout_heap->allocated_bytes);
 	seq_printf(s, "total heap size: %lx\n", carveout_heap->total_size);
+	if (carveout_heap->cma)
+		ion_cma_region_print_debug(carveout_heap->cma, s);
 
 	if (mem_map) {
 		unsigned long base = carveout_heap->base;
@@ -469,6 +482,12 @@ struct ion_heap *ion_carveout_heap_create(struct ion_platform_heap *heap_data)
 	carveout_heap->allocated_bytes = 0;
 	carveout_heap->total_size = heap_data->size;
 	carveout_heap->has_outer_cache = heap_data->has_outer_cache;
+	carveout_heap->cma = ion_cma_region_find(heap_data);
+	if (IS_ERR(carveout_heap->cma)) {
+		gen_pool_destroy(carveout_heap->pool);
+		kfree(carveout_heap);
+		return ERR_PTR(-EINVAL);
+	}
 
 	if (heap_data->extra_data) {
 		struct ion_co_heap_pdata *extra_data =
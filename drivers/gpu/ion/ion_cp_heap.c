@@ -28,6 +28,9 @@
 #include <linux/seq_file.h>
 #include <linux/fmem.h>
 #include <linux/iommu.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
 
 #include <asm/mach/map.h>
 
@@ -41,6 +44,24 @@
 #include <asm/cacheflush.h>
 
 #include "msm/ion_cp_common.h"
+
+/*
+ * The TrustZone calls that protect and unprotect a heap take several ms.
+ * Once the last user unsecures a heap it stays protected for this long, and
+ * securing it again in the meantime costs nothing.  0 unprotects at once.
+ */
+static unsigned int unprotect_holdoff_ms = 3000;
+module_param(unprotect_holdoff_ms, uint, S_IRUGO | S_IWUSR);
+
+#define ION_CP_LOG_LEN	8
+
+struct ion_cp_transition {
+	ktime_t time;
+	unsigned int protected;
+	unsigned int scm_us;
+	int error;
+};
+
 struct ion_cp_heap {
 	struct ion_heap heap;
 	struct gen_pool *pool;
@@ -66,6 +87,19 @@ struct ion_cp_heap {
 	int iommu_2x_map_domain;
 	unsigned int has_outer_cache;
 	atomic_t protect_cnt;
+	struct ion_cma_region *cma;
+	/* Unprotect waiting out the hold-off, and what to call it with */
+	struct delayed_work unprotect_work;
+	int unprotect_version;
+	void *unprotect_data;
+	/* TrustZone calls made and avoided, and the time spent in them */
+	unsigned long protect_calls;
+	unsigned long unprotect_calls;
+	unsigned long holdoff_hits;
+	unsigned long long scm_total_us;
+	unsigned int scm_max_us;
+	struct ion_cp_transition log[ION_CP_LOG_LEN];
+	unsigned int log_next;
 };
 
 enum {
@@ -87,23 +121,127 @@ static unsigned long ion_cp_get_total_kmap_count(
 	return cp_heap->kmap_cached_count + cp_heap->kmap_uncached_count;
 }
 
+/* Call with cp_heap->lock held */
+static void ion_cp_log_scm(struct ion_cp_heap *cp_heap, ktime_t start,
+			   unsigned int protected, int error)
+{
+	struct ion_cp_transition *t;
+	ktime_t now = ktime_get();
+	unsigned int us = ktime_to_us(ktime_sub(now, start));
+
+	if (protected)
+		cp_heap->protect_calls++;
+	else
+		cp_heap->unprotect_calls++;
+	cp_heap->scm_total_us += us;
+	if (us > cp_heap->scm_max_us)
+		cp_heap->scm_max_us = us;
+
+	t = &cp_heap->log[cp_heap->log_next++ % ION_CP_LOG_LEN];
+	t->time = now;
+	t->protected = protected;
+	t->scm_us = us;
+	t->error = error;
+}
+
+static void ion_cp_do_unprotect(struct ion_cp_heap *cp_heap, int version,
+				void *data)
+{
+	struct ion_heap *heap = &cp_heap->heap;
+	ktime_t start = ktime_get();
+	int error_code;
+
+	error_code = ion_cp_unprotect_mem(cp_heap->secure_base,
+			cp_heap->secure_size, cp_heap->permission_type,
+			version, data);
+	ion_cp_log_scm(cp_heap, start, 0, error_code);
+	if (error_code) {
+		pr_err("Failed to un-protect memory for heap %s - "
+			"error code: %d\n", heap->name, error_code);
+	} else  {
+		cp_heap->heap_protected = HEAP_NOT_PROTECTED;
+		pr_debug("Un-protected heap %s @ 0x%x\n", heap->name,
+			(unsigned int) cp_heap->base);
+
+		if (cp_heap->reusable && !cp_heap->allocated_bytes) {
+			if (fmem_set_state(FMEM_T_STATE) != 0)
+				pr_err("%s: unable to transition heap to T-state",
+					__func__);
+		}
+		if (cp_heap->cma)
+			ion_cma_region_put(cp_heap->cma);
+	}
+}
+
+/* Call with cp_heap->lock held */
+static void ion_cp_unprotect_now(struct ion_cp_heap *cp_heap)
+{
+	if (cp_heap->heap_protected != HEAP_PROTECTED)
+		return;
+
+	cancel_delayed_work(&cp_heap->unprotect_work);
+	ion_cp_do_unprotect(cp_heap, cp_heap->unprotect_version,
+			    cp_heap->unprotect_data);
+}
+
+/*
+ * Protected only because of the hold-off: unprotect now rather than when
+ * it runs out.  Call with cp_heap->lock held.
+ */
+static void ion_cp_unprotect_idle(struct ion_cp_heap *cp_heap)
+{
+	if (!atomic_read(&cp_heap->protect_cnt))
+		ion_cp_unprotect_now(cp_heap);
+}
+
+static void ion_cp_unprotect_work(struct work_struct *work)
+{
+	struct ion_cp_heap *cp_heap = container_of(to_delayed_work(work),
+					struct ion_cp_heap, unprotect_work);
+
+	mutex_lock(&cp_heap->lock);
+	ion_cp_unprotect_idle(cp_heap);
+	mutex_unlock(&cp_heap->lock);
+}
+
 static int ion_cp_protect(struct ion_heap *heap, int version, void *data)
 {
 	struct ion_cp_heap *cp_heap =
 		container_of(heap, struct ion_cp_heap, heap);
+	ktime_t start;
 	int ret_value = 0;
 
 	if (atomic_inc_return(&cp_heap->protect_cnt) == 1) {
-		
+		/* Left protected by the last user, for the same usage */
+		if (cp_heap->heap_protected == HEAP_PROTECTED &&
+		    cp_heap->unprotect_version == version &&
+		    cp_heap->unprotect_data == data) {
+			cancel_delayed_work(&cp_heap->unprotect_work);
+			cp_heap->holdoff_hits++;
+			goto out;
+		}
+		ion_cp_unprotect_now(cp_heap);
+
 		if (cp_heap->reusable && !cp_heap->allocated_bytes) {
 			ret_value = fmem_set_state(FMEM_C_STATE);
 			if (ret_value)
 				goto out;
 		}
 
+		/* The secure range must not hold movable pages */
+		if (cp_heap->cma) {
+			ret_value = ion_cma_region_get(cp_heap->cma);
+			if (ret_value) {
+				atomic_dec(&cp_heap->protect_cnt);
+				goto out;
+			}
+		}
+
+		start = ktime_get();
 		ret_value = ion_cp_protect_mem(cp_heap->secure_base,
 				cp_heap->secure_size, cp_heap->permission_type,
 				version, data);
+		ion_cp_log_scm(cp_heap, start, 1, ret_value);
 		if (ret_value) {
 			pr_err("Failed to protect memory for heap %s - "
 				"error code: %d\n", heap->name, ret_value);
@@ -113,9 +251,13 @@ static int ion_cp_protect(struct ion_heap *heap, int version, void *data)
 					pr_err("%s: unable to transition heap to T-state\n",
 						__func__);
 			}
+			if (cp_heap->cma)
+				ion_cma_region_put(cp_heap->cma);
 			atomic_dec(&cp_heap->protect_cnt);
 		} else {
 			cp_heap->heap_protected = HEAP_PROTECTED;
+			cp_heap->unprotect_version = version;
+			cp_heap->unprotect_data = data;
 			pr_debug("Protected heap %s @ 0x%lx\n",
 				heap->name, cp_heap->base);
 		}
@@ -133,22 +275,12 @@ static void ion_cp_unprotect(struct ion_heap *heap, int version, void *data)
 		container_of(heap, struct ion_cp_heap, heap);
 
 	if (atomic_dec_and_test(&cp_heap->protect_cnt)) {
-		int error_code = ion_cp_unprotect_mem(
-			cp_heap->secure_base, cp_heap->secure_size,
-			cp_heap->permission_type, version, data);
-		if (error_code) {
-			pr_err("Failed to un-protect memory for heap %s - "
-				"error code: %d\n", heap->name, error_code);
-		} else  {
-			cp_heap->heap_protected = HEAP_NOT_PROTECTED;
-			pr_debug("Un-protected heap %s @ 0x%x\n", heap->name,
-				(unsigned int) cp_heap->base);
-
-			if (cp_heap->reusable && !cp_heap->allocated_bytes) {
-				if (fmem_set_state(FMEM_T_STATE) != 0)
-					pr_err("%s: unable to transition heap to T-state",
-						__func__);
-			}
+		if (unprotect_holdoff_ms &&
+		    cp_heap->heap_protected == HEAP_PROTECTED) {
+			schedule_delayed_work(&cp_heap->unprotect_work,
+				msecs_to_jiffies(unprotect_holdoff_ms));
+		} else {
+			ion_cp_do_unprotect(cp_heap, version, data);
 		}
 	}
 	pr_debug("%s: protect count is %d\n", __func__,
@@ -168,6 +300,8 @@ ion_phys_addr_t ion_cp_allocate(struct ion_heap *heap,
 		container_of(heap, struct ion_cp_heap, heap);
 
 	mutex_lock(&cp_heap->lock);
+	if (!secure_allocation)
+		ion_cp_unprotect_idle(cp_heap);
 	if (!secure_allocation && cp_heap->heap_protected == HEAP_PROTECTED) {
 		mutex_unlock(&cp_heap->lock);
 		pr_err("ION cannot allocate un-secure memory from protected"
@@ -192,6 +326,11 @@ ion_phys_addr_t ion_cp_allocate(struct ion_heap *heap,
 		}
 	}
 
+	if (cp_heap->cma && ion_cma_region_get(cp_heap->cma)) {
+		mutex_unlock(&cp_heap->lock);
+		return ION_CP_ALLOCATE_FAIL;
+	}
+
 	cp_heap->allocated_bytes += size;
 	mutex_unlock(&cp_heap->lock);
 
@@ -216,6 +355,8 @@ ion_phys_addr_t ion_cp_allocate(struct ion_heap *heap,
 				pr_err("%s: unable to transition heap to T-state\n",
 					__func__);
 		}
+		if (cp_heap->cma)
+			ion_cma_region_put(cp_heap->cma);
 		mutex_unlock(&cp_heap->lock);
 
 		return ION_CP_ALLOCATE_FAIL;
@@ -286,6 +427,8 @@ void ion_cp_free(struct ion_heap *heap, ion_phys_addr_t addr,
 			cp_heap->iommu_partition[i] = 0;
 		}
 	}
+	if (cp_heap->cma)
+		ion_cma_region_put(cp_heap->cma);
 	mutex_unlock(&cp_heap->lock);
 }
 
@@ -400,6 +543,7 @@ void *ion_cp_heap_map_kernel(struct ion_heap *heap, struct ion_buffer *buffer)
 	void *ret_value = NULL;
 
 	mutex_lock(&cp_heap->lock);
+	ion_cp_unprotect_idle(cp_heap);
 	if ((cp_heap->heap_protected == HEAP_NOT_PROTECTED) ||
 	    ((cp_heap->heap_protected == HEAP_PROTECTED) &&
 	      !ION_IS_CACHED(buffer->flags))) {
@@ -413,6 +557,8 @@ void *ion_cp_heap_map_kernel(struct ion_heap *heap, struct ion_buffer *buffer)
 			ret_value = ion_map_fmem_buffer(buffer, cp_heap->base,
 				cp_heap->reserved_vrange, buffer->flags);
 
+		} else if (cp_heap->cma) {
+			ret_value = ion_cma_map_kernel(buffer);
 		} else {
 			if (ION_IS_CACHED(buffer->flags))
 				ret_value = ioremap_cached(buffer->priv_phys,
@@ -467,6 +613,7 @@ int ion_cp_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 		container_of(heap, struct ion_cp_heap, heap);
 
 	mutex_lock(&cp_heap->lock);
+	ion_cp_unprotect_idle(cp_heap);
 	if (cp_heap->heap_protected == HEAP_NOT_PROTECTED) {
 		if (ion_cp_request_region(cp_heap)) {
 			mutex_unlock(&cp_heap->lock);
@@ -543,6 +690,8 @@ static int ion_cp_print_debug(struct ion_heap *heap, struct seq_file *s,
 	unsigned long umap_count;
 	unsigned long kmap_count;
 	unsigned long heap_protected;
+	struct ion_cp_transition log[ION_CP_LOG_LEN];
+	unsigned int i, log_next;
 	struct ion_cp_heap *cp_heap =
 		container_of(heap, struct ion_cp_heap, heap);
 
@@ -552,14 +701,35 @@ static int ion_cp_print_debug(struct ion_heap *heap, struct seq_file *s,
 	umap_count = cp_heap->umap_count;
 	kmap_count = ion_cp_get_total_kmap_count(cp_heap);
 	heap_protected = cp_heap->heap_protected == HEAP_PROTECTED;
+	memcpy(log, cp_heap->log, sizeof(log));
+	log_next = cp_heap->log_next;
 	mutex_unlock(&cp_heap->lock);
 
 	seq_printf(s, "total bytes currently allocated: %lx\n", total_alloc);
 	seq_printf(s, "total heap size: %lx\n", total_size);
 	seq_printf(s, "umapping count: %lx\n", umap_count);
 	seq_printf(s, "kmapping count: %lx\n", kmap_count);
-	seq_printf(s, "heap protected: %s\n", heap_protected ? "Yes" : "No");
+	seq_printf(s, "heap protected: %s%s\n", heap_protected ? "Yes" : "No",
+		   heap_protected && !atomic_read(&cp_heap->protect_cnt) ?
+		   " (hold-off)" : "");
 	seq_printf(s, "reusable: %s\n", cp_heap->reusable  ? "Yes" : "No");
+	seq_printf(s, "protect calls: %lu unprotect calls: %lu "
+		   "hold-off hits: %lu\n", cp_heap->protect_calls,
+		   cp_heap->unprotect_calls, cp_heap->holdoff_hits);
+	seq_printf(s, "scm time: %llu us total, %u us max\n",
+		   cp_heap->scm_total_us, cp_heap->scm_max_us);
+	i = log_next > ION_CP_LOG_LEN ? log_next - ION_CP_LOG_LEN : 0;
+	for (; i < log_next; i++) {
+		struct ion_cp_transition *t = &log[i % ION_CP_LOG_LEN];
+		struct timespec ts = ktime_to_timespec(t->time);
+
+		seq_printf(s, "  [%5lu.%06lu] %s %u us%s\n",
+			   (unsigned long)ts.tv_sec, ts.tv_nsec / NSEC_PER_USEC,
+			   t->protected ? "protect" : "unprotect", t->scm_us,
+			   t->error ? " failed" : "");
+	}
+	if (cp_heap->cma)
+		ion_cma_region_print_debug(cp_heap->cma, s);
 
 	if (mem_map) {
 		unsigned long base = cp_heap->base;
@@ -874,6 +1044,7 @@ struct ion_heap *ion_cp_heap_create(struct ion_platform_heap *heap_data)
 	cp_heap->secure_size = heap_data->size;
 	cp_heap->has_outer_cache = heap_data->has_outer_cache;
 	atomic_set(&cp_heap->protect_cnt, 0);
+	INIT_DELAYED_WORK(&cp_heap->unprotect_work, ion_cp_unprotect_work);
 	if (heap_data->extra_data) {
 		struct ion_cp_heap_pdata *extra_data =
 				heap_data->extra_data;
@@ -897,6 +1068,10 @@ struct ion_heap *ion_cp_heap_create(struct ion_platform_heap *heap_data)
 
 	}
 
+	cp_heap->cma = ion_cma_region_find(heap_data);
+	if (IS_ERR(cp_heap->cma))
+		goto destroy_pool;
+
 	return &cp_heap->heap;
 
 destroy_pool:
@@ -913,6 +1088,10 @@ void ion_cp_heap_destroy(struct ion_heap *heap)
 	struct ion_cp_heap *cp_heap =
 	     container_of(heap, struct  ion_cp_heap, heap);
 
+	cancel_delayed_work_sync(&cp_heap->unprotect_work);
+	mutex_lock(&cp_heap->lock);
+	ion_cp_unprotect_idle(cp_heap);
+	mutex_unlock(&cp_heap->lock);
 	gen_pool_destroy(cp_heap->pool);
 	kfree(cp_heap);
 	cp_heap = NULL;
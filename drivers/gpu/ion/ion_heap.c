@@ -16,7 +16,18 @@
  */
 
 #include <linux/err.h>
+#include <linux/freezer.h>
+#include <linux/highmem.h>
 #include <linux/ion.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/dma-contiguous.h>
+#include <asm/cacheflush.h>
+#include <asm/mach/map.h>
 #include "ion_priv.h"
 
 struct ion_heap *ion_heap_create(struct ion_platform_heap *heap_data)
@@ -62,6 +73,11 @@ void ion_heap_destroy(struct ion_heap *heap)
 	if (!heap)
 		return;
 
+	if ((heap->flags & ION_HEAP_FLAG_DEFER_FREE) && heap->task) {
+		kthread_stop(heap->task);
+		ion_heap_freelist_drain(heap, 0);
+	}
+
 	switch (heap->type) {
 	case ION_HEAP_TYPE_SYSTEM_CONTIG:
 		ion_system_contig_heap_destroy(heap);
@@ -83,3 +99,315 @@ void ion_heap_destroy(struct ion_heap *heap)
 		       heap->type);
 	}
 }
+
+/*
+ * Heaps that set ION_HEAP_FLAG_DEFER_FREE don't release their buffers in
+ * the context of whoever dropped the last reference.  The buffers are put
+ * on a per heap list instead and a low priority thread releases them (and
+ * does any zeroing the heap needs) in the background.
+ */
+
+/**
+ * ion_heap_freelist_add - Queue a buffer to be released by the heap thread
+ * @heap: heap the buffer belongs to
+ * @buffer: buffer to release, already removed from the device tree
+ */
+void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer)
+{
+	spin_lock(&heap->free_lock);
+	list_add_tail(&buffer->list, &heap->free_list);
+	heap->free_list_size += buffer->size;
+	heap->free_list_count++;
+	spin_unlock(&heap->free_lock);
+	wake_up(&heap->waitqueue);
+}
+
+/**
+ * ion_heap_freelist_size - Return the total size of the queued buffers
+ * @heap: heap to check
+ */
+size_t ion_heap_freelist_size(struct ion_heap *heap)
+{
+	size_t size;
+
+	spin_lock(&heap->free_lock);
+	size = heap->free_list_size;
+	spin_unlock(&heap->free_lock);
+
+	return size;
+}
+
+/**
+ * ion_heap_freelist_drain - Release queued buffers right away
+ * @heap: heap whose free list should be drained
+ * @size: release at least this many bytes, 0 to empty the list
+ *
+ * Called by the heap thread and, when memory is tight, from the heap's
+ * shrinker.  Returns the number of bytes that were released.
+ */
+size_t ion_heap_freelist_drain(struct ion_heap *heap, size_t size)
+{
+	struct ion_buffer *buffer;
+	size_t total = 0;
+	ktime_t start = ktime_get();
+	unsigned long elapsed;
+
+	spin_lock(&heap->free_lock);
+	if (size == 0)
+		size = heap->free_list_size;
+
+	while (total < size && !list_empty(&heap->free_list)) {
+		buffer = list_first_entry(&heap->free_list, struct ion_buffer,
+					  list);
+		list_del(&buffer->list);
+		heap->free_list_size -= buffer->size;
+		heap->free_list_count--;
+		total += buffer->size;
+		spin_unlock(&heap->free_lock);
+
+		ion_buffer_destroy(buffer);
+
+		spin_lock(&heap->free_lock);
+	}
+
+	if (total) {
+		elapsed = (unsigned long) ktime_us_delta(ktime_get(), start);
+		heap->drain_last_us = elapsed;
+		if (elapsed > heap->drain_max_us)
+			heap->drain_max_us = elapsed;
+	}
+	spin_unlock(&heap->free_lock);
+
+	return total;
+}
+
+static int ion_heap_deferred_free(void *data)
+{
+	struct ion_heap *heap = data;
+
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(heap->waitqueue,
+				     ion_heap_freelist_size(heap) > 0 ||
+				     kthread_should_stop());
+
+		ion_heap_freelist_drain(heap, 0);
+	}
+
+	return 0;
+}
+
+/**
+ * ion_heap_init_deferred_free - Start the deferred free thread for a heap
+ * @heap: heap that has ION_HEAP_FLAG_DEFER_FREE set
+ *
+ * The thread runs as SCHED_IDLE so releasing buffers never competes with
+ * the clients of the heap.  The shrinker of the heap is expected to drain
+ * the list itself when the system is short of memory.
+ */
+int ion_heap_init_deferred_free(struct ion_heap *heap)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	INIT_LIST_HEAD(&heap->free_list);
+	heap->free_list_size = 0;
+	heap->free_list_count = 0;
+	spin_lock_init(&heap->free_lock);
+	init_waitqueue_head(&heap->waitqueue);
+
+	heap->task = kthread_run(ion_heap_deferred_free, heap,
+				 "ion_%s", heap->name);
+	if (IS_ERR(heap->task)) {
+		pr_err("%s: creating thread for deferred free failed\n",
+		       __func__);
+		heap->task = NULL;
+		return -ENOMEM;
+	}
+	sched_setscheduler(heap->task, SCHED_IDLE, &param);
+
+	return 0;
+}
+
+/*
+ * Heaps with a cma_dev sit on a CMA area.  While nothing is allocated from
+ * them the page allocator uses the area for movable pages, the first
+ * allocation migrates those out and the last free hands the area back.
+ */
+static LIST_HEAD(ion_cma_regions);
+static DEFINE_MUTEX(ion_cma_regions_lock);
+
+/**
+ * ion_cma_region_find - Get the region of a heap's CMA area
+ * @heap_data: platform data of the heap, with base already set
+ *
+ * Returns NULL when the heap has no CMA area.
+ */
+struct ion_cma_region *ion_cma_region_find(struct ion_platform_heap *heap_data)
+{
+	struct ion_cma_region *region;
+	phys_addr_t base;
+	unsigned long size, count;
+
+	if (!heap_data->cma_dev)
+		return NULL;
+
+	if (dma_contiguous_area(heap_data->cma_dev, &base, &size) ||
+	    heap_data->base < base ||
+	    heap_data->base + heap_data->size > base + size) {
+		pr_err("%s: heap %s is not inside its CMA area\n", __func__,
+		       heap_data->name);
+		return ERR_PTR(-EINVAL);
+	}
+	count = PFN_UP(heap_data->base + heap_data->size - base);
+
+	mutex_lock(&ion_cma_regions_lock);
+	list_for_each_entry(region, &ion_cma_regions, list)
+		if (region->dev == heap_data->cma_dev)
+			goto found;
+
+	region = kzalloc(sizeof(*region), GFP_KERNEL);
+	if (!region) {
+		region = ERR_PTR(-ENOMEM);
+		goto out;
+	}
+	region->dev = heap_data->cma_dev;
+	region->base = base;
+	mutex_init(&region->lock);
+	list_add(&region->list, &ion_cma_regions);
+found:
+	mutex_lock(&region->lock);
+	region->count = max(region->count, count);
+	mutex_unlock(&region->lock);
+out:
+	mutex_unlock(&ion_cma_regions_lock);
+	return region;
+}
+
+static int ion_cma_region_claim(struct ion_cma_region *region)
+{
+	ktime_t start = ktime_get();
+	struct page *pages;
+	unsigned long i;
+	u64 ns;
+
+	pages = dma_alloc_from_contiguous(region->dev, region->count, 0);
+	if (pages && page_to_phys(pages) != region->base) {
+		dma_release_from_contiguous(region->dev, pages, region->count);
+		pages = NULL;
+	}
+	if (!pages) {
+		region->failures++;
+		pr_err("%s: could not migrate pages out of %lx\n", __func__,
+		       region->base);
+		return -ENOMEM;
+	}
+
+	/* Drop lines the page cache left behind before devices use it */
+	for (i = 0; i < region->count; i++) {
+		void *ptr = kmap_atomic(pages + i);
+
+		dmac_flush_range(ptr, ptr + PAGE_SIZE);
+		kunmap_atomic(ptr);
+	}
+	outer_flush_range(region->base,
+			  region->base + (region->count << PAGE_SHIFT));
+
+	region->pages = pages;
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	region->claims++;
+	region->claim_ns += ns;
+	if (ns > region->claim_max_ns)
+		region->claim_max_ns = ns;
+	return 0;
+}
+
+/**
+ * ion_cma_region_get - Hold the region for an allocation or protection
+ * @region: region of the heap
+ *
+ * The first holder migrates the movable pages out, which can take a
+ * while.  Returns -ENOMEM when some pages could not be moved.
+ */
+int ion_cma_region_get(struct ion_cma_region *region)
+{
+	int ret = 0;
+
+	mutex_lock(&region->lock);
+	if (!region->users)
+		ret = ion_cma_region_claim(region);
+	if (!ret)
+		region->users++;
+	mutex_unlock(&region->lock);
+
+	return ret;
+}
+
+/**
+ * ion_cma_region_put - Drop a hold taken by ion_cma_region_get
+ * @region: region of the heap
+ */
+void ion_cma_region_put(struct ion_cma_region *region)
+{
+	mutex_lock(&region->lock);
+	BUG_ON(!region->users);
+	if (!--region->users) {
+		dma_release_from_contiguous(region->dev, region->pages,
+					    region->count);
+		region->pages = NULL;
+	}
+	mutex_unlock(&region->lock);
+}
+
+/**
+ * ion_cma_map_kernel - Map a buffer of a CMA backed heap
+ * @buffer: buffer to map
+ *
+ * ioremap() refuses memory the kernel manages, so the pages are mapped
+ * into a fresh area instead.  __arm_iounmap() undoes the mapping.
+ */
+void *ion_cma_map_kernel(struct ion_buffer *buffer)
+{
+	const struct mem_type *type = ION_IS_CACHED(buffer->flags) ?
+				get_mem_type(MT_DEVICE_CACHED) :
+				get_mem_type(MT_DEVICE);
+	struct vm_struct *area;
+
+	area = get_vm_area(PAGE_ALIGN(buffer->size), VM_IOREMAP);
+	if (!area)
+		return NULL;
+
+	if (ioremap_pages((unsigned long)area->addr, buffer->priv_phys,
+			  buffer->size, type)) {
+		free_vm_area(area);
+		return NULL;
+	}
+
+	return area->addr;
+}
+
+void ion_cma_region_print_debug(struct ion_cma_region *region,
+				struct seq_file *s)
+{
+	unsigned long claims, failures;
+	u64 claim_ns, claim_max_ns;
+	bool claimed;
+
+	mutex_lock(&region->lock);
+	claimed = region->pages != NULL;
+	claims = region->claims;
+	failures = region->failures;
+	claim_ns = region->claim_ns;
+	claim_max_ns = region->claim_max_ns;
+	mutex_unlock(&region->lock);
+
+	seq_printf(s, "cma area: %lx size %lx %s\n", region->base,
+		   region->count << PAGE_SHIFT,
+		   claimed ? "claimed" : "lent out");
+	seq_printf(s, "cma claims: %lu failed: %lu\n", claims, failures);
+	if (claims)
+		claim_ns = div64_u64(claim_ns, claims);
+	seq_printf(s, "cma claim avg: %llu us max: %llu us\n",
+		   div64_u64(claim_ns, NSEC_PER_USEC),
+		   div64_u64(claim_max_ns, NSEC_PER_USEC));
+}
@@ -0,0 +1,134 @@
+/*
+ * drivers/gpu/ion/ion_page_pool.c
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/err.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/seq_file.h>
+#include "ion_priv.h"
+
+/*
+ * A page pool holds blocks of a single order that have been given back by
+ * a heap.  The pool doesn't know anything about the state of the pages, it
+ * is up to the heap to make sure that everything it puts in is ready to be
+ * handed out again (zeroed and, for uncached pools, out of the caches).
+ */
+
+struct ion_page_pool *ion_page_pool_create(unsigned int order)
+{
+	struct ion_page_pool *pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+
+	if (!pool)
+		return NULL;
+
+	pool->order = order;
+	INIT_LIST_HEAD(&pool->items);
+	mutex_init(&pool->mutex);
+
+	return pool;
+}
+
+void ion_page_pool_destroy(struct ion_page_pool *pool)
+{
+	ion_page_pool_shrink(pool, INT_MAX);
+	kfree(pool);
+}
+
+/**
+ * ion_page_pool_alloc - Take a block out of the pool
+ * @pool: pool to take the block from
+ *
+ * Returns NULL if the pool is empty, the caller is expected to go to the
+ * page allocator in that case.
+ */
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	struct page *page = NULL;
+
+	mutex_lock(&pool->mutex);
+	if (pool->count) {
+		page = list_first_entry(&pool->items, struct page, lru);
+		list_del(&page->lru);
+		pool->count--;
+		pool->hits++;
+	} else {
+		pool->misses++;
+	}
+	mutex_unlock(&pool->mutex);
+
+	return page;
+}
+
+/**
+ * ion_page_pool_free - Give a block back to the pool
+ * @pool: pool to put the block in
+ * @page: first page of the block, must be of the same order as the pool
+ */
+void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
+{
+	mutex_lock(&pool->mutex);
+	list_add_tail(&page->lru, &pool->items);
+	pool->count++;
+	mutex_unlock(&pool->mutex);
+}
+
+/**
+ * ion_page_pool_shrink - Release blocks from the pool to the system
+ * @pool: pool to shrink
+ * @nr_to_scan: number of pages to release, 0 to just count them
+ *
+ * Returns the number of pages that were released or, if @nr_to_scan is 0,
+ * the number of pages that are held by the pool.
+ */
+int ion_page_pool_shrink(struct ion_page_pool *pool, int nr_to_scan)
+{
+	int freed = 0;
+
+	if (nr_to_scan == 0)
+		return pool->count << pool->order;
+
+	while (freed < nr_to_scan) {
+		struct page *page;
+
+		mutex_lock(&pool->mutex);
+		if (!pool->count) {
+			mutex_unlock(&pool->mutex);
+			break;
+		}
+		page = list_first_entry(&pool->items, struct page, lru);
+		list_del(&page->lru);
+		pool->count--;
+		mutex_unlock(&pool->mutex);
+
+		__free_pages(page, pool->order);
+		freed += (1 << pool->order);
+	}
+
+	return freed;
+}
+
+void ion_page_pool_print_debug(struct ion_page_pool *pool, struct seq_file *s,
+			       const char *name)
+{
+	mutex_lock(&pool->mutex);
+	seq_printf(s, "%s order %u: %d blocks (%lu bytes) hits %u misses %u\n",
+		   name, pool->order, pool->count,
+		   (unsigned long) pool->count * (PAGE_SIZE << pool->order),
+		   pool->hits, pool->misses);
+	mutex_unlock(&pool->mutex);
+}
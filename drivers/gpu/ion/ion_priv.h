@@ -25,6 +25,8 @@
 #include <linux/ion.h>
 #include <linux/iommu.h>
 #include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 enum {
 	DI_PARTITION_NUM = 0,
@@ -62,12 +64,15 @@ struct ion_buffer {
 	struct mutex lock;
 	int kmap_cnt;
 	void *vaddr;
+	unsigned long kmap_flags;
+	struct list_head kmap_cache;
 	int dmap_cnt;
 	struct sg_table *sg_table;
 	int umap_cnt;
 	unsigned int iommu_map_cnt;
 	struct rb_root iommu_maps;
 	int marked;
+	struct list_head list;
 };
 
 struct ion_heap_ops {
@@ -102,13 +107,46 @@ struct ion_heap_ops {
 	int (*unsecure_heap)(struct ion_heap *heap, int version, void *data);
 };
 
+/* Buffers of the heap are released by a kernel thread */
+#define ION_HEAP_FLAG_DEFER_FREE (1 << 0)
+
+/**
+ * struct ion_heap - represents a heap in the system
+ * @node:		rb node to put the heap on the device's tree of heaps
+ * @dev:		back pointer to the ion_device
+ * @type:		type of heap
+ * @ops:		ops struct as above
+ * @flags:		ION_HEAP_FLAG_* flags
+ * @id:			id of heap, also indicates priority of this heap when
+ *			allocating.  These are specified by platform data and
+ *			MUST be unique
+ * @name:		used for debugging
+ * @free_list:		buffers waiting to be released when the heap has
+ *			ION_HEAP_FLAG_DEFER_FREE set
+ * @free_list_size:	total size of the buffers on @free_list
+ * @free_list_count:	number of buffers on @free_list
+ * @free_lock:		protects the free list and the drain statistics
+ * @waitqueue:		the deferred free thread waits here for work
+ * @task:		the deferred free thread
+ * @drain_last_us:	time taken by the most recent drain of the free list
+ * @drain_max_us:	longest drain of the free list so far
+ */
 struct ion_heap {
 	struct rb_node node;
 	struct ion_device *dev;
 	enum ion_heap_type type;
 	struct ion_heap_ops *ops;
+	unsigned long flags;
 	int id;
 	const char *name;
+	struct list_head free_list;
+	size_t free_list_size;
+	unsigned int free_list_count;
+	spinlock_t free_lock;
+	wait_queue_head_t waitqueue;
+	struct task_struct *task;
+	unsigned long drain_last_us;
+	unsigned long drain_max_us;
 };
 
 struct mem_map_data {
@@ -136,6 +174,13 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap);
 struct ion_heap *ion_heap_create(struct ion_platform_heap *);
 void ion_heap_destroy(struct ion_heap *);
 
+void ion_buffer_destroy(struct ion_buffer *buffer);
+
+int ion_heap_init_deferred_free(struct ion_heap *heap);
+void ion_heap_freelist_add(struct ion_heap *heap, struct ion_buffer *buffer);
+size_t ion_heap_freelist_drain(struct ion_heap *heap, size_t size);
+size_t ion_heap_freelist_size(struct ion_heap *heap);
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *);
 void ion_system_heap_destroy(struct ion_heap *);
 
@@ -160,6 +205,35 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
 		       unsigned long size);
 
 
+/**
+ * struct ion_page_pool - pagepool struct
+ * @count:	number of blocks in the pool
+ * @order:	order of the blocks in the pool
+ * @items:	list of blocks, linked through page->lru
+ * @mutex:	protects the list and the counters
+ * @hits:	number of allocations served from the pool
+ * @misses:	number of allocations that found the pool empty
+ *
+ * Heaps keep one pool per order and cache type so that freed buffers can
+ * be reused without going back to the page allocator.
+ */
+struct ion_page_pool {
+	int count;
+	unsigned int order;
+	struct list_head items;
+	struct mutex mutex;
+	unsigned int hits;
+	unsigned int misses;
+};
+
+struct ion_page_pool *ion_page_pool_create(unsigned int order);
+void ion_page_pool_destroy(struct ion_page_pool *pool);
+struct page *ion_page_pool_alloc(struct ion_page_pool *pool);
+void ion_page_pool_free(struct ion_page_pool *pool, struct page *page);
+int ion_page_pool_shrink(struct ion_page_pool *pool, int nr_to_scan);
+void ion_page_pool_print_debug(struct ion_page_pool *pool, struct seq_file *s,
+			       const char *name);
+
 struct ion_heap *msm_get_contiguous_heap(void);
 #define ION_CARVEOUT_ALLOCATE_FAIL -1
 #define ION_CP_ALLOCATE_FAIL -1
@@ -169,6 +243,45 @@ struct ion_heap *msm_get_contiguous_heap(void);
 void *ion_map_fmem_buffer(struct ion_buffer *buffer, unsigned long phys_base,
 				void *virt_base, unsigned long flags);
 
+/**
+ * struct ion_cma_region - heap memory lent to the page allocator when idle
+ * @list:	entry in the list of regions
+ * @dev:	device owning the CMA area
+ * @base:	start of the area
+ * @count:	pages from @base on used by heaps
+ * @lock:	protects the fields below
+ * @users:	allocations and protections holding the region
+ * @pages:	first page while the region is claimed, NULL while lent out
+ * @claims:	times the pages were migrated out for the heaps
+ * @failures:	claims that found pages that could not be migrated
+ * @claim_ns:	total time spent in claims
+ * @claim_max_ns: longest claim
+ *
+ * Heaps sharing a CMA area, like a carveout adjacent to a CP heap, share
+ * the region.  The whole region is claimed with its first user and given
+ * back with its last, an allocation does not migrate pages on its own.
+ */
+struct ion_cma_region {
+	struct list_head list;
+	struct device *dev;
+	ion_phys_addr_t base;
+	unsigned long count;
+	struct mutex lock;
+	unsigned int users;
+	struct page *pages;
+	unsigned long claims;
+	unsigned long failures;
+	u64 claim_ns;
+	u64 claim_max_ns;
+};
+
+struct ion_cma_region *ion_cma_region_find(struct ion_platform_heap *heap_data);
+int ion_cma_region_get(struct ion_cma_region *region);
+void ion_cma_region_put(struct ion_cma_region *region);
+void *ion_cma_map_kernel(struct ion_buffer *buffer);
+void ion_cma_region_print_debug(struct ion_cma_region *region,
+				struct seq_file *s);
+
 int ion_do_cache_op(struct ion_client *client, struct ion_handle *handle,
 			void *uaddr, unsigned long offset, unsigned long len,
 			unsigned int cmd);
@@ -18,6 +18,7 @@
 #include <linux/err.h>
 #include <linux/ion.h>
 #include <linux/mm.h>
+#include <linux/shrinker.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
@@ -33,49 +34,200 @@ static atomic_t system_contig_heap_allocated;
 static unsigned int system_heap_has_outer_cache;
 static unsigned int system_heap_contig_has_outer_cache;
 
+/*
+ * Buffers are built from the largest blocks that are available, going down
+ * to single pages only for the tail or when memory is fragmented.  Freed
+ * blocks are kept in per order pools, separate for cached and uncached
+ * buffers so that uncached buffers never get pages with dirty cache lines.
+ * Every block in a pool has already been zeroed.  Buffers are freed on the
+ * heap's deferred free thread so the zeroing is never done by the task that
+ * dropped the last reference.
+ */
+static const unsigned int orders[] = {8, 4, 0};
+#define NUM_ORDERS ARRAY_SIZE(orders)
+
+/* Don't stall or wake kswapd for a large block, a smaller one will do */
+static const gfp_t high_order_gfp_flags = (GFP_KERNEL | __GFP_ZERO |
+	__GFP_NOWARN | __GFP_NORETRY | __GFP_NO_KSWAPD) & ~__GFP_WAIT;
+static const gfp_t low_order_gfp_flags = GFP_KERNEL | __GFP_ZERO;
+
+struct ion_system_heap {
+	struct ion_heap heap;
+	struct ion_page_pool *cached_pools[NUM_ORDERS];
+	struct ion_page_pool *uncached_pools[NUM_ORDERS];
+	struct shrinker shrinker;
+};
+
+struct page_info {
+	struct page *page;
+	unsigned int order;
+	struct list_head list;
+};
+
+static int order_to_index(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++)
+		if (order == orders[i])
+			return i;
+	BUG();
+	return -1;
+}
+
+static struct ion_page_pool *order_to_pool(struct ion_system_heap *heap,
+					   bool cached, unsigned int order)
+{
+	int i = order_to_index(order);
+
+	return cached ? heap->cached_pools[i] : heap->uncached_pools[i];
+}
+
+/* Push a block out of the CPU caches so it can be used uncached */
+static void ion_system_heap_flush_block(struct page *page, unsigned int order)
+{
+	void *vaddr = page_address(page);
+	unsigned long paddr = page_to_phys(page);
+	unsigned long len = PAGE_SIZE << order;
+
+	dmac_flush_range(vaddr, vaddr + len);
+	outer_flush_range(paddr, paddr + len);
+}
+
+static struct page *alloc_buffer_page(struct ion_system_heap *heap,
+				      bool cached, unsigned int order)
+{
+	struct page *page;
+
+	page = ion_page_pool_alloc(order_to_pool(heap, cached, order));
+	if (page)
+		return page;
+
+	page = alloc_pages(order ? high_order_gfp_flags : low_order_gfp_flags,
+			   order);
+	if (!page)
+		return NULL;
+
+	if (!cached)
+		ion_system_heap_flush_block(page, order);
+
+	return page;
+}
+
+static void free_buffer_page(struct ion_system_heap *heap, bool cached,
+			     struct page *page, unsigned int order)
+{
+	memset(page_address(page), 0, PAGE_SIZE << order);
+
+	if (!cached)
+		ion_system_heap_flush_block(page, order);
+
+	ion_page_pool_free(order_to_pool(heap, cached, order), page);
+}
+
+static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
+						 unsigned long size,
+						 bool cached,
+						 unsigned int max_order)
+{
+	struct page *page;
+	struct page_info *info;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (size < (PAGE_SIZE << orders[i]))
+			continue;
+		if (max_order < orders[i])
+			continue;
+
+		page = alloc_buffer_page(heap, cached, orders[i]);
+		if (!page)
+			continue;
+
+		info = kmalloc(sizeof(struct page_info), GFP_KERNEL);
+		if (!info) {
+			free_buffer_page(heap, cached, page, orders[i]);
+			return NULL;
+		}
+
+		info->page = page;
+		info->order = orders[i];
+		return info;
+	}
+
+	return NULL;
+}
+
 static int ion_system_heap_allocate(struct ion_heap *heap,
 				     struct ion_buffer *buffer,
 				     unsigned long size, unsigned long align,
 				     unsigned long flags)
 {
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
 	struct sg_table *table;
 	struct scatterlist *sg;
-	int i, j;
-	int npages = PAGE_ALIGN(size) / PAGE_SIZE;
+	struct list_head pages;
+	struct page_info *info, *tmp_info;
+	bool cached = ION_IS_CACHED(flags);
+	long size_remaining = PAGE_ALIGN(size);
+	unsigned int max_order = orders[0];
+	int i = 0;
+
+	INIT_LIST_HEAD(&pages);
+	while (size_remaining > 0) {
+		info = alloc_largest_available(sys_heap, size_remaining, cached,
+					       max_order);
+		if (!info)
+			goto err;
+		list_add_tail(&info->list, &pages);
+		size_remaining -= PAGE_SIZE << info->order;
+		max_order = info->order;
+		i++;
+	}
 
 	table = kmalloc(sizeof(struct sg_table), GFP_KERNEL);
 	if (!table)
-		return -ENOMEM;
-	i = sg_alloc_table(table, npages, GFP_KERNEL);
-	if (i)
-		goto err0;
-	for_each_sg(table->sgl, sg, table->nents, i) {
-		struct page *page;
-		page = alloc_page(GFP_KERNEL|__GFP_ZERO);
-		if (!page)
-			goto err1;
-		sg_set_page(sg, page, PAGE_SIZE, 0);
+		goto err;
+
+	if (sg_alloc_table(table, i, GFP_KERNEL))
+		goto err1;
+
+	sg = table->sgl;
+	list_for_each_entry_safe(info, tmp_info, &pages, list) {
+		sg_set_page(sg, info->page, PAGE_SIZE << info->order, 0);
+		sg = sg_next(sg);
+		list_del(&info->list);
+		kfree(info);
 	}
+
 	buffer->priv_virt = table;
 	atomic_add(size, &system_heap_allocated);
 	return 0;
 err1:
-	for_each_sg(table->sgl, sg, i, j)
-		__free_page(sg_page(sg));
-	sg_free_table(table);
-err0:
 	kfree(table);
+err:
+	list_for_each_entry_safe(info, tmp_info, &pages, list) {
+		free_buffer_page(sys_heap, cached, info->page, info->order);
+		kfree(info);
+	}
 	return -ENOMEM;
 }
 
 void ion_system_heap_free(struct ion_buffer *buffer)
 {
+	struct ion_system_heap *sys_heap = container_of(buffer->heap,
+							struct ion_system_heap,
+							heap);
+	bool cached = ION_IS_CACHED(buffer->flags);
 	int i;
 	struct scatterlist *sg;
 	struct sg_table *table = buffer->priv_virt;
 
 	for_each_sg(table->sgl, sg, table->nents, i)
-		__free_page(sg_page(sg));
+		free_buffer_page(sys_heap, cached, sg_page(sg),
+				 get_order(sg->length));
 	if (buffer->sg_table)
 		sg_free_table(buffer->sg_table);
 	kfree(buffer->sg_table);
@@ -102,17 +254,26 @@ void *ion_system_heap_map_kernel(struct ion_heap *heap,
 		return ERR_PTR(-EINVAL);
 	} else {
 		struct scatterlist *sg;
-		int i;
+		int i, j;
 		void *vaddr;
 		struct sg_table *table = buffer->priv_virt;
-		struct page **pages = kmalloc(
-					sizeof(struct page *) * table->nents,
-					GFP_KERNEL);
+		int npages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
+		struct page **pages = vmalloc(sizeof(struct page *) * npages);
+		struct page **tmp = pages;
+
+		if (!pages)
+			return ERR_PTR(-ENOMEM);
+
+		for_each_sg(table->sgl, sg, table->nents, i) {
+			int npages_this_entry = PAGE_ALIGN(sg->length) >>
+						 PAGE_SHIFT;
+			struct page *page = sg_page(sg);
 
-		for_each_sg(table->sgl, sg, table->nents, i)
-			pages[i] = sg_page(sg);
-		vaddr = vmap(pages, table->nents, VM_MAP, PAGE_KERNEL);
-		kfree(pages);
+			for (j = 0; j < npages_this_entry; j++)
+				*(tmp++) = page++;
+		}
+		vaddr = vmap(pages, npages, VM_MAP, PAGE_KERNEL);
+		vfree(pages);
 
 		return vaddr;
 	}
@@ -159,17 +320,36 @@ int ion_system_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 	} else {
 		struct sg_table *table = buffer->priv_virt;
 		unsigned long addr = vma->vm_start;
-		unsigned long offset = vma->vm_pgoff;
+		unsigned long offset = vma->vm_pgoff * PAGE_SIZE;
 		struct scatterlist *sg;
 		int i;
+		int ret;
 
+		/*
+		 * The blocks aren't compound pages so the tail pages can't be
+		 * refcounted through vm_insert_page, map them by pfn instead
+		 */
 		for_each_sg(table->sgl, sg, table->nents, i) {
-			if (offset) {
-				offset--;
+			struct page *page = sg_page(sg);
+			unsigned long remainder = vma->vm_end - addr;
+			unsigned long len = sg->length;
+
+			if (offset >= len) {
+				offset -= len;
 				continue;
+			} else if (offset) {
+				page += offset / PAGE_SIZE;
+				len -= offset;
+				offset = 0;
 			}
-			vm_insert_page(vma, addr, sg_page(sg));
-			addr += PAGE_SIZE;
+			len = min(len, remainder);
+			ret = remap_pfn_range(vma, addr, page_to_pfn(page), len,
+					      vma->vm_page_prot);
+			if (ret)
+				return ret;
+			addr += len;
+			if (addr >= vma->vm_end)
+				return 0;
 		}
 		return 0;
 	}
@@ -210,7 +390,7 @@ int ion_system_heap_cache_ops(struct ion_heap *heap, struct ion_buffer *buffer,
 				WARN(1, "Could not translate virtual address to physical address\n");
 				return -EINVAL;
 			}
-			outer_cache_op(pstart, pstart + PAGE_SIZE);
+			outer_cache_op(pstart, pstart + sg->length);
 		}
 	}
 	return 0;
@@ -219,9 +399,21 @@ int ion_system_heap_cache_ops(struct ion_heap *heap, struct ion_buffer *buffer,
 static int ion_system_print_debug(struct ion_heap *heap, struct seq_file *s,
 				  const struct rb_root *unused)
 {
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+	int i;
+
 	seq_printf(s, "total bytes currently allocated: %lx\n",
 			(unsigned long) atomic_read(&system_heap_allocated));
 
+	for (i = 0; i < NUM_ORDERS; i++) {
+		ion_page_pool_print_debug(sys_heap->cached_pools[i], s,
+					  "cached");
+		ion_page_pool_print_debug(sys_heap->uncached_pools[i], s,
+					  "uncached");
+	}
+
 	return 0;
 }
 
@@ -305,22 +497,92 @@ static struct ion_heap_ops vmalloc_ops = {
 	.unmap_iommu = ion_system_heap_unmap_iommu,
 };
 
+static int ion_system_heap_shrink(struct shrinker *shrinker,
+				  struct shrink_control *sc)
+{
+	struct ion_system_heap *sys_heap = container_of(shrinker,
+							struct ion_system_heap,
+							shrinker);
+	int nr_to_scan = sc->nr_to_scan;
+	int nr_total = 0;
+	int i;
+
+	/* Buffers waiting on the deferred free list go back to the pools */
+	if (nr_to_scan > 0 && sys_heap->heap.task)
+		ion_heap_freelist_drain(&sys_heap->heap, 0);
+
+	/* Give back the small blocks first, the large ones are harder to get */
+	for (i = NUM_ORDERS - 1; i >= 0 && nr_to_scan > 0; i--) {
+		nr_to_scan -= ion_page_pool_shrink(sys_heap->uncached_pools[i],
+						   nr_to_scan);
+		if (nr_to_scan > 0)
+			nr_to_scan -= ion_page_pool_shrink(
+					sys_heap->cached_pools[i], nr_to_scan);
+	}
+
+	if (sys_heap->heap.task)
+		nr_total += ion_heap_freelist_size(&sys_heap->heap) / PAGE_SIZE;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		nr_total += ion_page_pool_shrink(sys_heap->uncached_pools[i], 0);
+		nr_total += ion_page_pool_shrink(sys_heap->cached_pools[i], 0);
+	}
+
+	return nr_total;
+}
+
+static void ion_system_heap_destroy_pools(struct ion_system_heap *heap)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (heap->cached_pools[i])
+			ion_page_pool_destroy(heap->cached_pools[i]);
+		if (heap->uncached_pools[i])
+			ion_page_pool_destroy(heap->uncached_pools[i]);
+	}
+}
+
 struct ion_heap *ion_system_heap_create(struct ion_platform_heap *pheap)
 {
-	struct ion_heap *heap;
+	struct ion_system_heap *heap;
+	int i;
 
-	heap = kzalloc(sizeof(struct ion_heap), GFP_KERNEL);
+	heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
 	if (!heap)
 		return ERR_PTR(-ENOMEM);
-	heap->ops = &vmalloc_ops;
-	heap->type = ION_HEAP_TYPE_SYSTEM;
+	heap->heap.ops = &vmalloc_ops;
+	heap->heap.type = ION_HEAP_TYPE_SYSTEM;
+	heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		heap->cached_pools[i] = ion_page_pool_create(orders[i]);
+		heap->uncached_pools[i] = ion_page_pool_create(orders[i]);
+		if (!heap->cached_pools[i] || !heap->uncached_pools[i])
+			goto err;
+	}
+
+	heap->shrinker.shrink = ion_system_heap_shrink;
+	heap->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&heap->shrinker);
+
 	system_heap_has_outer_cache = pheap->has_outer_cache;
-	return heap;
+	return &heap->heap;
+err:
+	ion_system_heap_destroy_pools(heap);
+	kfree(heap);
+	return ERR_PTR(-ENOMEM);
 }
 
 void ion_system_heap_destroy(struct ion_heap *heap)
 {
-	kfree(heap);
+	struct ion_system_heap *sys_heap = container_of(heap,
+							struct ion_system_heap,
+							heap);
+
+	unregister_shrinker(&sys_heap->shrinker);
+	ion_system_heap_destroy_pools(sys_heap);
+	kfree(sys_heap);
 }
 
 static int ion_system_contig_heap_allocate(struct ion_heap *heap,
@@ -18,6 +18,7 @@
 #include <linux/slab.h>
 #include <linux/memory_alloc.h>
 #include <linux/fmem.h>
+#include <linux/dma-contiguous.h>
 #include <linux/mm.h>
 #include <linux/mm_types.h>
 #include <linux/sched.h>
@@ -87,6 +88,20 @@ static unsigned long msm_ion_get_base(unsigned long size, int memory_type,
 	}
 }
 
+/* Both heaps of an adjacent pair are placed at the start of the area */
+static unsigned long msm_ion_get_cma_base(struct ion_platform_heap *heap)
+{
+	phys_addr_t base;
+	unsigned long size;
+
+	if (dma_contiguous_area(heap->cma_dev, &base, &size)) {
+		pr_err("%s: no CMA area for heap %s\n", __func__, heap->name);
+		return 0;
+	}
+	pr_info("ION heap %s using CMA\n", heap->name);
+	return base;
+}
+
 static struct ion_platform_heap *find_heap(const struct ion_platform_heap
 					   heap_data[],
 					   unsigned int nr_heaps,
@@ -117,6 +132,8 @@ static void ion_set_base_address(struct ion_platform_heap *heap,
 		heap->base = fmem_info->phys - fmem_info->reserved_size_low;
 		cp_data->virt_addr = fmem_info->virt;
 		pr_info("ION heap %s using FMEM\n", shared_heap->name);
+	} else if (shared_heap->cma_dev) {
+		heap->base = msm_ion_get_cma_base(shared_heap);
 	} else {
 		heap->base = msm_ion_get_base(heap->size + shared_heap->size,
 						shared_heap->memory_type,
@@ -186,6 +203,10 @@ static void msm_ion_heap_fixup(struct ion_platform_heap heap_data[],
 
 static void msm_ion_allocate(struct ion_platform_heap *heap)
 {
+	if (!heap->base && heap->cma_dev) {
+		heap->base = msm_ion_get_cma_base(heap);
+		return;
+	}
 
 	if (!heap->base && heap->extra_data) {
 		unsigned int align = 0;
@@ -1548,6 +1548,7 @@ adreno_probe(struct platform_device *pdev)
 	kgsl_pwrscale_attach_policy(device, ADRENO_DEFAULT_PWRSCALE_POLICY);
 
 	device->flags &= ~KGSL_FLAGS_SOFT_RESET;
+	device_enable_async_suspend(&pdev->dev);
 	return 0;
 
 error_close_rb:
@@ -1585,6 +1586,9 @@ static int adreno_init(struct kgsl_device *device)
 	/* Power up the device */
 	kgsl_pwrctrl_enable(device);
 
+	/* GMEM contents did not survive the power down */
+	adreno_dev->gmem_owner = NULL;
+
 	/* Identify the specific GPU */
 	adreno_identify_gpu(adreno_dev);
 
@@ -2552,7 +2556,7 @@ adreno_dump_and_exec_ft(struct kgsl_device *device)
 	if (device->state == KGSL_STATE_DUMP_AND_FT) {
 		mutex_unlock(&device->mutex);
 		wait_for_completion(&device->ft_gate);
-		mutex_lock(&device->mutex);
+		lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 		if (device->state != KGSL_STATE_HUNG)
 			result = 0;
 	} else {
@@ -3373,7 +3377,7 @@ static int adreno_check_interrupt_timestamp(struct kgsl_device *device,
 {
 	int status;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	status = adreno_check_hw_ts(device, context, timestamp);
 	mutex_unlock(&device->mutex);
 
@@ -3675,7 +3679,7 @@ static int adreno_waittimestamp(struct kgsl_device *device,
 		 */
 
 		if (kgsl_check_timestamp(device, context, timestamp)) {
-			queue_work(device->work_queue, &device->ts_expired_ws);
+			kgsl_schedule_events(device);
 			ret = 0;
 			break;
 		}
@@ -3700,7 +3704,7 @@ static int adreno_waittimestamp(struct kgsl_device *device,
 			adreno_check_interrupt_timestamp(device, context,
 				timestamp), msecs_to_jiffies(wait), io);
 
-		mutex_lock(&device->mutex);
+		lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 		/*
 		 * If status is non zero then either the condition was satisfied
@@ -3848,6 +3852,9 @@ static long adreno_ioctl(struct kgsl_device_private *dev_priv,
 			read->reads, read->count);
 		break;
 	}
+	case IOCTL_KGSL_SUBMIT_BATCH:
+		result = adreno_ringbuffer_submit_batch(dev_priv, data);
+		break;
 	default:
 		KGSL_DRV_INFO(dev_priv->device,
 			"invalid ioctl code %08x\n", cmd);
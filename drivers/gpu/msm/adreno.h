@@ -81,6 +81,46 @@ enum adreno_gpurev {
 
 struct adreno_gpudev;
 
+/**
+ * struct adreno_dispatcher - Hold off low priority submissions
+ * @high_ctxt_id: Context that owns the most recent high priority submission,
+ * 0 if no high priority work is outstanding
+ * @high_ts: Timestamp of the most recent high priority submission
+ * @waiting: Number of low priority submissions currently held
+ * @max_waiting: Largest number of low priority submissions held at once
+ * @waits: Total number of low priority submissions that were held
+ * @timeouts: Number of holds that ended because the wait timer expired
+ * @total_wait_us: Total time spent holding low priority submissions
+ * @max_wait_us: Longest time a low priority submission was held
+ */
+struct adreno_dispatcher {
+	unsigned int high_ctxt_id;
+	unsigned int high_ts;
+	unsigned int waiting;
+	unsigned int max_waiting;
+	unsigned int waits;
+	unsigned int timeouts;
+	u64 total_wait_us;
+	unsigned int max_wait_us;
+};
+
+/**
+ * struct adreno_ctx_switch_stats - draw context switch counters
+ * @switches: switches between two different contexts (NULL included)
+ * @gmem_saves: GMEM shadow saves issued for the outgoing context
+ * @gmem_restores: GMEM shadow restores issued for the incoming context
+ * @gmem_restores_skipped: restores dropped because GMEM still held the
+ * context's data or the context said it clears GMEM first
+ * @gmem_bytes_skipped: shadow bytes those skipped restores did not copy
+ */
+struct adreno_ctx_switch_stats {
+	unsigned int switches;
+	unsigned int gmem_saves;
+	unsigned int gmem_restores;
+	unsigned int gmem_restores_skipped;
+	u64 gmem_bytes_skipped;
+};
+
 struct adreno_device {
 	struct kgsl_device dev;    /* Must be first field in this struct */
 	unsigned int chip_id;
@@ -88,6 +128,7 @@ struct adreno_device {
 	unsigned long gmem_base;
 	unsigned int gmem_size;
 	struct adreno_context *drawctxt_active;
+	struct adreno_context *gmem_owner;
 	const char *pfp_fwfile;
 	unsigned int *pfp_fw;
 	size_t pfp_fw_size;
@@ -115,6 +156,8 @@ struct adreno_device {
 	struct ocmem_buf *ocmem_hdl;
 	unsigned int ocmem_base;
 	unsigned int gpu_cycles;
+	struct adreno_dispatcher dispatcher;
+	struct adreno_ctx_switch_stats ctx_switch_stats;
 };
 
 #define PERFCOUNTER_FLAG_NONE 0x0
@@ -310,6 +353,11 @@ int adreno_perfcounter_get(struct adreno_device *adreno_dev,
 int adreno_perfcounter_put(struct adreno_device *adreno_dev,
 	unsigned int groupid, unsigned int countable);
 
+void adreno_dispatcher_throttle(struct adreno_device *adreno_dev,
+	struct kgsl_context *context);
+void adreno_dispatcher_queued(struct adreno_device *adreno_dev,
+	struct adreno_context *drawctxt, unsigned int timestamp);
+
 int adreno_ft_init_sysfs(struct kgsl_device *device);
 void adreno_ft_uninit_sysfs(struct kgsl_device *device);
 
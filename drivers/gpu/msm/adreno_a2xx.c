@@ -1764,7 +1764,7 @@ static void a2xx_cp_intrcallback(struct kgsl_device *device)
 
 	if (status & (CP_INT_CNTL__IB1_INT_MASK | CP_INT_CNTL__RB_INT_MASK)) {
 		KGSL_CMD_WARN(rb->device, "ringbuffer ib1/rb interrupt\n");
-		queue_work(device->work_queue, &device->ts_expired_ws);
+		kgsl_schedule_events(device);
 		wake_up_interruptible_all(&device->wait_queue);
 	}
 }
@@ -2618,7 +2618,7 @@ static void a3xx_cp_callback(struct adreno_device *adreno_dev, int irq)
 	wake_up_interruptible_all(&device->wait_queue);
 
 	/* Schedule work to free mem and issue ibs */
-	queue_work(device->work_queue, &device->ts_expired_ws);
+	kgsl_schedule_events(device);
 }
 
 /**
@@ -16,6 +16,8 @@
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
 #include <linux/io.h>
+#include <linux/seq_file.h>
+#include <asm/div64.h>
 
 #include "kgsl.h"
 #include "adreno.h"
@@ -43,6 +45,43 @@ static int kgsl_cff_dump_enable_get(void *data, u64 *val)
 DEFINE_SIMPLE_ATTRIBUTE(kgsl_cff_dump_enable_fops, kgsl_cff_dump_enable_get,
 			kgsl_cff_dump_enable_set, "%llu\n");
 
+static int dispatcher_print(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+	struct adreno_dispatcher *dispatcher =
+		&ADRENO_DEVICE(device)->dispatcher;
+	u64 avg_us = 0;
+
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+
+	if (dispatcher->waits) {
+		avg_us = dispatcher->total_wait_us;
+		do_div(avg_us, dispatcher->waits);
+	}
+
+	seq_printf(s, "waiting: %u\n", dispatcher->waiting);
+	seq_printf(s, "max_waiting: %u\n", dispatcher->max_waiting);
+	seq_printf(s, "waits: %u\n", dispatcher->waits);
+	seq_printf(s, "timeouts: %u\n", dispatcher->timeouts);
+	seq_printf(s, "avg_wait_us: %llu\n", avg_us);
+	seq_printf(s, "max_wait_us: %u\n", dispatcher->max_wait_us);
+
+	mutex_unlock(&device->mutex);
+	return 0;
+}
+
+static int dispatcher_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dispatcher_print, inode->i_private);
+}
+
+static const struct file_operations dispatcher_fops = {
+	.open = dispatcher_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 typedef void (*reg_read_init_t)(struct kgsl_device *device);
 typedef void (*reg_read_fill_t)(struct kgsl_device *device, int i,
 	unsigned int *vals, int linec);
@@ -62,4 +101,16 @@ void adreno_debugfs_init(struct kgsl_device *device)
 			   &adreno_dev->ib_check_level);
 	debugfs_create_u32("active_cnt", 0444, device->d_debugfs,
 			   &device->active_cnt);
+	debugfs_create_file("dispatcher", 0444, device->d_debugfs, device,
+			    &dispatcher_fops);
+	debugfs_create_u32("ctx_switches", 0444, device->d_debugfs,
+			   &adreno_dev->ctx_switch_stats.switches);
+	debugfs_create_u32("gmem_saves", 0444, device->d_debugfs,
+			   &adreno_dev->ctx_switch_stats.gmem_saves);
+	debugfs_create_u32("gmem_restores", 0444, device->d_debugfs,
+			   &adreno_dev->ctx_switch_stats.gmem_restores);
+	debugfs_create_u32("gmem_restores_skipped", 0444, device->d_debugfs,
+			   &adreno_dev->ctx_switch_stats.gmem_restores_skipped);
+	debugfs_create_u64("gmem_bytes_skipped", 0444, device->d_debugfs,
+			   &adreno_dev->ctx_switch_stats.gmem_bytes_skipped);
 }
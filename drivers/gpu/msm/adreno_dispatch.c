@@ -0,0 +1,134 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/ktime.h>
+
+#include "kgsl.h"
+#include "adreno.h"
+
+/*
+ * The GPU can't preempt, so once a low priority context has filled the
+ * ringbuffer anything submitted by a high priority context has to wait
+ * for it to drain.  To keep the ringbuffer clear for the high priority
+ * contexts, submissions from low priority contexts are held in front of
+ * the ringbuffer for as long as the most recent high priority submission
+ * is still in flight.  The hold is bounded so that a busy high priority
+ * context can't starve everything else.
+ */
+
+/* Maximum time in ms that a low priority submission is held */
+#define ADRENO_DISPATCH_WAIT_MS 20
+
+static inline int _is_high_priority(struct adreno_context *drawctxt)
+{
+	return drawctxt->priority < ADRENO_CONTEXT_DEFAULT_PRIORITY;
+}
+
+static inline int _is_low_priority(struct adreno_context *drawctxt)
+{
+	return drawctxt->priority > ADRENO_CONTEXT_DEFAULT_PRIORITY;
+}
+
+/**
+ * adreno_dispatcher_throttle - Hold a submission behind high priority work
+ * @adreno_dev: Pointer to the adreno device
+ * @context: The context that is about to submit commands
+ *
+ * If @context is low priority and a high priority submission is still in
+ * flight, wait for it to retire (or for the hold to time out) before
+ * letting the submission through.  The device mutex is dropped while
+ * waiting so the caller has to revalidate any device or context state
+ * after this returns.  Caller must hold the device mutex.
+ */
+void adreno_dispatcher_throttle(struct adreno_device *adreno_dev,
+	struct kgsl_context *context)
+{
+	struct kgsl_device *device = &adreno_dev->dev;
+	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
+	struct adreno_context *drawctxt = context->devctxt;
+	struct kgsl_context *high;
+	unsigned int timestamp;
+	ktime_t start;
+	s64 wait_us;
+	int ret;
+
+	if (drawctxt == NULL || !_is_low_priority(drawctxt))
+		return;
+
+	/* Never drop the mutex in the middle of a batch submission */
+	if (dispatcher->high_ctxt_id == 0 || adreno_dev->ringbuffer.submit_hold)
+		return;
+
+	high = kgsl_context_get(device, dispatcher->high_ctxt_id);
+	if (high == NULL) {
+		dispatcher->high_ctxt_id = 0;
+		return;
+	}
+
+	timestamp = dispatcher->high_ts;
+
+	if (kgsl_check_timestamp(device, high, timestamp))
+		goto retired;
+
+	dispatcher->waiting++;
+	dispatcher->waits++;
+	if (dispatcher->waiting > dispatcher->max_waiting)
+		dispatcher->max_waiting = dispatcher->waiting;
+
+	start = ktime_get();
+
+	ret = device->ftbl->waittimestamp(device, high, timestamp,
+		ADRENO_DISPATCH_WAIT_MS);
+
+	wait_us = ktime_us_delta(ktime_get(), start);
+
+	dispatcher->waiting--;
+	dispatcher->total_wait_us += wait_us;
+	if (wait_us > dispatcher->max_wait_us)
+		dispatcher->max_wait_us = (unsigned int) wait_us;
+
+	if (ret == -ETIMEDOUT) {
+		dispatcher->timeouts++;
+		goto done;
+	}
+
+retired:
+	/* Only clear the state if no new high priority work came in */
+	if (dispatcher->high_ctxt_id == high->id &&
+		dispatcher->high_ts == timestamp &&
+		kgsl_check_timestamp(device, high, timestamp))
+		dispatcher->high_ctxt_id = 0;
+done:
+	kgsl_context_put(high);
+}
+
+/**
+ * adreno_dispatcher_queued - Note a submission that made it to the ringbuffer
+ * @adreno_dev: Pointer to the adreno device
+ * @drawctxt: The context that submitted the commands
+ * @timestamp: Timestamp assigned to the submission
+ *
+ * Remember the most recent high priority submission so that low priority
+ * contexts can be held behind it.  Caller must hold the device mutex.
+ */
+void adreno_dispatcher_queued(struct adreno_device *adreno_dev,
+	struct adreno_context *drawctxt, unsigned int timestamp)
+{
+	struct adreno_dispatcher *dispatcher = &adreno_dev->dispatcher;
+
+	if (!_is_high_priority(drawctxt))
+		return;
+
+	dispatcher->high_ctxt_id = drawctxt->id;
+	dispatcher->high_ts = timestamp;
+}
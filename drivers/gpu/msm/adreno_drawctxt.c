@@ -167,7 +167,8 @@ int adreno_drawctxt_create(struct kgsl_device *device,
 		KGSL_CONTEXT_PER_CONTEXT_TS |
 		KGSL_CONTEXT_USER_GENERATED_TS |
 		KGSL_CONTEXT_NO_FAULT_TOLERANCE |
-		KGSL_CONTEXT_TYPE_MASK);
+		KGSL_CONTEXT_TYPE_MASK |
+		KGSL_CONTEXT_PRIORITY_MASK);
 
 	if (*flags & KGSL_CONTEXT_PREAMBLE)
 		drawctxt->flags |= CTXT_FLAGS_PREAMBLE;
@@ -192,6 +193,17 @@ int adreno_drawctxt_create(struct kgsl_device *device,
 	drawctxt->type =
 		(*flags & KGSL_CONTEXT_TYPE_MASK) >> KGSL_CONTEXT_TYPE_SHIFT;
 
+	drawctxt->priority = (*flags & KGSL_CONTEXT_PRIORITY_MASK) >>
+		KGSL_CONTEXT_PRIORITY_SHIFT;
+
+	/* Report the priority that is actually used back to the caller */
+	if (drawctxt->priority == KGSL_CONTEXT_PRIORITY_UNDEF) {
+		drawctxt->priority = ADRENO_CONTEXT_DEFAULT_PRIORITY;
+		*flags |= (ADRENO_CONTEXT_DEFAULT_PRIORITY <<
+			KGSL_CONTEXT_PRIORITY_SHIFT) &
+			KGSL_CONTEXT_PRIORITY_MASK;
+	}
+
 	ret = adreno_dev->gpudev->ctxt_create(adreno_dev, drawctxt);
 	if (ret)
 		goto err;
@@ -249,6 +261,9 @@ void adreno_drawctxt_destroy(struct kgsl_device *device,
 		adreno_drawctxt_switch(adreno_dev, NULL, 0);
 	}
 
+	if (adreno_dev->gmem_owner == drawctxt)
+		adreno_dev->gmem_owner = NULL;
+
 	if (device->state != KGSL_STATE_HUNG)
 		adreno_idle(device);
 
@@ -296,6 +311,7 @@ void adreno_drawctxt_switch(struct adreno_device *adreno_dev,
 				unsigned int flags)
 {
 	struct kgsl_device *device = &adreno_dev->dev;
+	struct adreno_ctx_switch_stats *stats = &adreno_dev->ctx_switch_stats;
 
 	if (drawctxt) {
 		if (flags & KGSL_CONTEXT_SAVE_GMEM)
@@ -319,10 +335,32 @@ void adreno_drawctxt_switch(struct adreno_device *adreno_dev,
 	KGSL_CTXT_INFO(device, "from %p to %p flags %d\n",
 			adreno_dev->drawctxt_active, drawctxt, flags);
 
+	stats->switches++;
+
 	/* Save the old context */
 	adreno_dev->gpudev->ctxt_save(adreno_dev, adreno_dev->drawctxt_active);
+	if (adreno_dev->drawctxt_active &&
+	    (adreno_dev->drawctxt_active->flags & CTXT_FLAGS_GMEM_RESTORE))
+		stats->gmem_saves++;
+
+	/*
+	 * Saving does not change GMEM, so after a switch through the NULL
+	 * context it may still hold exactly what the shadow would restore.
+	 */
+	if (drawctxt && (drawctxt->flags & CTXT_FLAGS_GMEM_RESTORE)) {
+		if (drawctxt == adreno_dev->gmem_owner ||
+		    (flags & KGSL_CONTEXT_CLEAR_GMEM)) {
+			drawctxt->flags &= ~CTXT_FLAGS_GMEM_RESTORE;
+			stats->gmem_restores_skipped++;
+			stats->gmem_bytes_skipped +=
+				drawctxt->context_gmem_shadow.size;
+		} else
+			stats->gmem_restores++;
+	}
 
 	/* Set the new context */
 	adreno_dev->gpudev->ctxt_restore(adreno_dev, drawctxt);
 	adreno_dev->drawctxt_active = drawctxt;
+	if (drawctxt)
+		adreno_dev->gmem_owner = drawctxt;
 }
@@ -57,6 +57,9 @@
 /* Context no fault tolerance */
 #define CTXT_FLAGS_NO_FAULT_TOLERANCE  BIT(16)
 
+/* Priority given to contexts that don't ask for one */
+#define ADRENO_CONTEXT_DEFAULT_PRIORITY	8
+
 /* Symbolic table for the adreno draw context type */
 #define ADRENO_DRAWCTXT_TYPES \
 	{ KGSL_CONTEXT_TYPE_ANY, "any" }, \
@@ -105,6 +108,7 @@ struct adreno_context {
 	uint32_t pagefault;
 	unsigned long pagefault_ts;
 	unsigned int type;
+	unsigned int priority;
 	struct kgsl_pagetable *pagetable;
 	struct kgsl_memdesc gpustate;
 	unsigned int reg_restore[3];
@@ -14,6 +14,8 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/log2.h>
+#include <linux/uaccess.h>
+#include <linux/frametime.h>
 
 #include "kgsl.h"
 #include "kgsl_sharedmem.h"
@@ -52,6 +54,18 @@ void adreno_ringbuffer_submit(struct adreno_ringbuffer *rb)
 	adreno_regwrite(rb->device, REG_CP_RB_WPTR, rb->wptr);
 }
 
+/*
+ * Tell the hardware about any commands that were queued while WPTR updates
+ * were being held back for a batch submission
+ */
+static void adreno_ringbuffer_submit_held(struct adreno_ringbuffer *rb)
+{
+	if (rb->submit_pending) {
+		rb->submit_pending = 0;
+		adreno_ringbuffer_submit(rb);
+	}
+}
+
 static int
 adreno_ringbuffer_waitspace(struct adreno_ringbuffer *rb,
 				struct adreno_context *context,
@@ -68,6 +82,12 @@ adreno_ringbuffer_waitspace(struct adreno_ringbuffer *rb,
 
 	memset(prev_reg_val, 0, sizeof(prev_reg_val));
 
+	/*
+	 * The space we are waiting for can only be freed by the GPU so make
+	 * sure that it can see everything that has been queued so far
+	 */
+	adreno_ringbuffer_submit_held(rb);
+
 	/* if wptr ahead, fill the remaining with NOPs */
 	if (wptr_ahead) {
 		/* -1 for header */
@@ -723,7 +743,10 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 		GSL_RB_WRITE(ringcmds, rcmd_gpu, KGSL_END_OF_FRAME_IDENTIFIER);
 	}
 
-	adreno_ringbuffer_submit(rb);
+	if (rb->submit_hold)
+		rb->submit_pending = 1;
+	else
+		adreno_ringbuffer_submit(rb);
 
 	return 0;
 }
@@ -955,6 +978,14 @@ adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 	unsigned int start_index = 0;
 	int ret = 0;
 
+	/*
+	 * Low priority contexts may be held here while high priority work is
+	 * in flight. This can drop the device mutex so do it before checking
+	 * any of the device or context state.
+	 */
+	if (context)
+		adreno_dispatcher_throttle(adreno_dev, context);
+
 	if (device->state & KGSL_STATE_HUNG) {
 		ret = -EBUSY;
 		goto done;
@@ -967,6 +998,12 @@ adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 	}
 	drawctxt = context->devctxt;
 
+	/* The context may have been destroyed while we were held */
+	if (drawctxt == NULL) {
+		ret = -EINVAL;
+		goto done;
+	}
+
 	if (drawctxt->flags & CTXT_FLAGS_GPU_HANG) {
 		KGSL_CTXT_ERR(device, "proc %s failed fault tolerance"
 			" will not accept commands for context %d\n",
@@ -1031,9 +1068,11 @@ adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 	*cmds++ = cp_nop_packet(1);
 	*cmds++ = KGSL_END_OF_IB_IDENTIFIER;
 
-	kgsl_setstate(&device->mmu, context->id,
-		      kgsl_mmu_pt_get_flags(device->mmu.hwpagetable,
-					device->id));
+	/* Leave the TLB flush to the pagetable switch if there is one */
+	kgsl_mmu_flush_deferred(&device->mmu,
+		adreno_dev->drawctxt_active != drawctxt ?
+			drawctxt->pagetable : NULL,
+		context->id);
 
 	adreno_drawctxt_switch(adreno_dev, drawctxt, flags);
 
@@ -1062,12 +1101,16 @@ adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 	else
 		*timestamp = adreno_dev->ringbuffer.global_ts;
 
+	adreno_dispatcher_queued(adreno_dev, drawctxt, *timestamp);
+	frametime_gpu_submit(context->id, *timestamp);
+
 #ifdef CONFIG_MSM_KGSL_CFF_DUMP
 	/*
 	 * insert wait for idle after every IB1
 	 * this is conservative but works reliably and is ok
 	 * even for performance simulations
 	 */
+	adreno_ringbuffer_submit_held(&adreno_dev->ringbuffer);
 	adreno_idle(device);
 #endif
 
@@ -1089,6 +1132,109 @@ done:
 	return ret;
 }
 
+/* Put a reasonable upper limit on the size of a batch */
+#define ADRENO_SUBMIT_BATCH_MAX		64
+#define ADRENO_SUBMIT_BATCH_MAX_IBS	10000
+
+/**
+ * adreno_ringbuffer_submit_batch - Submit commands for several contexts
+ * @dev_priv: Pointer to the private device structure for the caller
+ * @param: The kgsl_submit_batch argument from user space
+ *
+ * Queue each command batch in the list to the ringbuffer in order through
+ * adreno_ringbuffer_issueibcmds but hold back the WPTR update until all of
+ * them are queued so that the hardware is only kicked once for the batch.
+ * The timestamp and result for each entry are written back to user space.
+ * Caller must hold the device mutex.
+ */
+int adreno_ringbuffer_submit_batch(struct kgsl_device_private *dev_priv,
+				struct kgsl_submit_batch *param)
+{
+	struct kgsl_device *device = dev_priv->device;
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct adreno_ringbuffer *rb = &adreno_dev->ringbuffer;
+	struct kgsl_submit_batch_entry entry;
+	struct kgsl_ibdesc *ibdesc = NULL;
+	unsigned int ibdesc_count = 0;
+	unsigned int i;
+	int ret = 0;
+
+	if (param->count == 0 || param->count > ADRENO_SUBMIT_BATCH_MAX)
+		return -EINVAL;
+
+	rb->submit_hold++;
+
+	for (i = 0; i < param->count; i++) {
+		struct kgsl_submit_batch_entry __user *uentry =
+			&param->entries[i];
+		struct kgsl_context *context = NULL;
+
+		if (copy_from_user(&entry, uentry, sizeof(entry))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		if (entry.numcmds == 0 ||
+			entry.numcmds > ADRENO_SUBMIT_BATCH_MAX_IBS) {
+			KGSL_DRV_ERR(device,
+				"Invalid number of IBs in batch %d: %d\n",
+				i, entry.numcmds);
+			ret = -EINVAL;
+			goto result;
+		}
+
+		/* Reuse the IB list between entries when it is big enough */
+		if (entry.numcmds > ibdesc_count) {
+			kfree(ibdesc);
+			ibdesc_count = 0;
+
+			ibdesc = kmalloc(sizeof(*ibdesc) * entry.numcmds,
+				GFP_KERNEL);
+			if (ibdesc == NULL) {
+				KGSL_MEM_ERR(device, "kmalloc(%d) failed\n",
+					sizeof(*ibdesc) * entry.numcmds);
+				ret = -ENOMEM;
+				goto result;
+			}
+
+			ibdesc_count = entry.numcmds;
+		}
+
+		if (copy_from_user(ibdesc, entry.cmdlist,
+			sizeof(*ibdesc) * entry.numcmds)) {
+			ret = -EFAULT;
+			goto result;
+		}
+
+		context = kgsl_context_get_owner(dev_priv, entry.context_id);
+		if (context == NULL) {
+			ret = -EINVAL;
+			goto result;
+		}
+
+		ret = adreno_ringbuffer_issueibcmds(dev_priv, context, ibdesc,
+			entry.numcmds, &entry.timestamp,
+			entry.flags | KGSL_CONTEXT_SUBMIT_IB_LIST);
+
+		kgsl_context_put(context);
+result:
+		entry.result = ret;
+
+		if (copy_to_user(uentry, &entry, sizeof(entry)) && !ret)
+			ret = -EFAULT;
+
+		if (ret)
+			break;
+	}
+
+	/* Ring the doorbell once for everything that made it in */
+	if (--rb->submit_hold == 0)
+		adreno_ringbuffer_submit_held(rb);
+
+	kfree(ibdesc);
+	return ret;
+}
+
 static void _turn_preamble_on_for_ib_seq(struct adreno_ringbuffer *rb,
 				unsigned int rb_rptr)
 {
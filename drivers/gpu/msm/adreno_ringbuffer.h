@@ -28,6 +28,7 @@
 struct kgsl_device;
 struct kgsl_device_private;
 struct adreno_ft_data;
+struct kgsl_submit_batch;
 
 #define GSL_RB_MEMPTRS_SCRATCH_COUNT	 8
 struct kgsl_rbmemptrs {
@@ -57,6 +58,11 @@ struct adreno_ringbuffer {
 	unsigned int rptr; /* read pointer offset in dwords from baseaddr */
 
 	unsigned int global_ts;
+
+	/* Non zero while WPTR updates are being held back for a batch */
+	unsigned int submit_hold;
+	/* Set if commands were queued while WPTR updates were held back */
+	unsigned int submit_pending;
 };
 
 
@@ -95,6 +101,9 @@ int adreno_ringbuffer_issueibcmds(struct kgsl_device_private *dev_priv,
 				uint32_t *timestamp,
 				unsigned int flags);
 
+int adreno_ringbuffer_submit_batch(struct kgsl_device_private *dev_priv,
+				struct kgsl_submit_batch *param);
+
 int adreno_ringbuffer_init(struct kgsl_device *device);
 
 int adreno_ringbuffer_start(struct adreno_ringbuffer *rb);
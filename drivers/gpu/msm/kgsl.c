@@ -29,6 +29,8 @@
 #include <linux/io.h>
 #include <mach/socinfo.h>
 #include <linux/mman.h>
+#include <linux/oom.h>
+#include <linux/pid_namespace.h>
 
 #include "kgsl.h"
 #include "kgsl_debugfs.h"
@@ -38,6 +40,7 @@
 #include "kgsl_device.h"
 #include "kgsl_trace.h"
 #include "kgsl_sync.h"
+#include "kgsl_pool.h"
 #include "adreno.h"
 
 #undef MODULE_PARAM_PREFIX
@@ -52,6 +55,11 @@ module_param_named(mmutype, ksgl_mmu_type, charp, 0);
 MODULE_PARM_DESC(ksgl_mmu_type,
 "Type of MMU to be used for graphics. Valid values are 'iommu' or 'gpummu' or 'nommu'");
 
+static int kgsl_purge_min_adj = 529;
+module_param_named(purge_min_adj, kgsl_purge_min_adj, int, 0644);
+MODULE_PARM_DESC(kgsl_purge_min_adj,
+"Lowest oom_score_adj of a process whose purgeable memory can be purged");
+
 static struct ion_client *kgsl_ion_client;
 
 static void kgsl_put_process_private(struct kgsl_device *device,
@@ -112,7 +120,7 @@ void kgsl_hang_check(struct work_struct *work)
 							hang_check_ws);
 	static unsigned int prev_reg_val[FT_DETECT_REGS_COUNT];
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	if (device->state == KGSL_STATE_ACTIVE) {
 
@@ -270,6 +278,24 @@ kgsl_get_mem_entry(struct kgsl_device *device, unsigned int ptbase,
 }
 EXPORT_SYMBOL(kgsl_get_mem_entry);
 
+/* Call with kgsl_driver.purge_lock held */
+static void kgsl_purge_list_add(struct kgsl_mem_entry *entry)
+{
+	list_add_tail(&entry->purge_node, &kgsl_driver.purge_list);
+	kgsl_driver.purge_entries++;
+	kgsl_driver.stats.purgeable += entry->memdesc.size;
+}
+
+static void kgsl_purge_list_del(struct kgsl_mem_entry *entry)
+{
+	if (list_empty(&entry->purge_node))
+		return;
+
+	list_del_init(&entry->purge_node);
+	kgsl_driver.purge_entries--;
+	kgsl_driver.stats.purgeable -= entry->memdesc.size;
+}
+
 static inline struct kgsl_mem_entry *
 kgsl_mem_entry_create(void)
 {
@@ -277,8 +303,11 @@ kgsl_mem_entry_create(void)
 
 	if (!entry)
 		KGSL_CORE_ERR("kzalloc(%d) failed\n", sizeof(*entry));
-	else
+	else {
 		kref_init(&entry->refcount);
+		mutex_init(&entry->purge_lock);
+		INIT_LIST_HEAD(&entry->purge_node);
+	}
 
 	return entry;
 }
@@ -290,6 +319,21 @@ kgsl_mem_entry_destroy(struct kref *kref)
 						    struct kgsl_mem_entry,
 						    refcount);
 
+	/* Off the purge list, and wait out a shrinker that got to it first */
+	if (entry->purge_device) {
+		spin_lock(&kgsl_driver.purge_lock);
+		kgsl_purge_list_del(entry);
+		spin_unlock(&kgsl_driver.purge_lock);
+		mutex_lock(&entry->purge_lock);
+		mutex_unlock(&entry->purge_lock);
+
+		if (entry->memdesc.priv & KGSL_MEMDESC_PURGED) {
+			spin_lock(&kgsl_driver.purge_lock);
+			kgsl_driver.stats.purged -= entry->memdesc.size;
+			spin_unlock(&kgsl_driver.purge_lock);
+		}
+	}
+
 	/* Detach from process list */
 	kgsl_mem_entry_detach_process(entry);
 
@@ -405,6 +449,23 @@ kgsl_mem_entry_untrack_gpuaddr(struct kgsl_process_private *process,
 	}
 }
 
+/* Account for the large page coverage of a mapping in the owning process */
+static void kgsl_mem_entry_large_page_stats(struct kgsl_mem_entry *entry,
+	int mapped)
+{
+	unsigned int size_64k, size_1m;
+
+	kgsl_memdesc_large_page_size(&entry->memdesc, &size_64k, &size_1m);
+
+	if (mapped) {
+		entry->priv->mapped_64k += size_64k;
+		entry->priv->mapped_1m += size_1m;
+	} else {
+		entry->priv->mapped_64k -= size_64k;
+		entry->priv->mapped_1m -= size_1m;
+	}
+}
+
 /**
  * kgsl_mem_entry_attach_process - Attach a mem_entry to its owner process
  * @entry: the memory entry
@@ -459,6 +520,8 @@ kgsl_mem_entry_attach_process(struct kgsl_mem_entry *entry,
 		ret = kgsl_mmu_map(process->pagetable, &entry->memdesc);
 		if (ret)
 			kgsl_mem_entry_detach_process(entry);
+		else
+			kgsl_mem_entry_large_page_stats(entry, 1);
 	}
 	return ret;
 
@@ -474,6 +537,9 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
 	if (entry == NULL)
 		return;
 
+	if (entry->memdesc.priv & KGSL_MEMDESC_MAPPED)
+		kgsl_mem_entry_large_page_stats(entry, 0);
+
 	/* Unmap here so that below we can call kgsl_mmu_put_gpuaddr */
 	kgsl_mmu_unmap(entry->priv->pagetable, &entry->memdesc);
 
@@ -485,12 +551,230 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
 	entry->id = 0;
 
 	entry->priv->stats[entry->memtype].cur -= entry->memdesc.size;
+	if (entry->memdesc.priv & KGSL_MEMDESC_PURGED)
+		entry->priv->purged -= entry->memdesc.size;
 	spin_unlock(&entry->priv->mem_lock);
 	kgsl_put_process_private(entry->dev_priv->device, entry->priv);
 
 	entry->priv = NULL;
 }
 
+/*
+ * Purgeable memory
+ *
+ * Userspace marks a KGSL_MEM_ENTRY_KERNEL allocation purgeable along with
+ * the timestamp of the last submission using it, much like unpinning an
+ * ashmem region.  Under memory pressure the shrinker below frees the pages
+ * of such allocations once that timestamp has retired, as long as the owner
+ * is in the background.  The GPU address stays reserved, so pinning the
+ * allocation again only needs new pages mapped at the same place.
+ *
+ * entry->purge_lock orders a purge against pinning, mmap and the CPU cache
+ * ioctls.  CPU faults do not take it, they are kept out by purging with the
+ * mmap_sem of the only CPU mapping held for writing.
+ */
+
+/* Call with entry->purge_lock held */
+static bool kgsl_mem_entry_purge_ready(struct kgsl_mem_entry *entry)
+{
+	struct kgsl_context *context;
+	struct task_struct *task;
+	bool ready = false;
+
+	if (!entry->purgeable || entry->purge_hold ||
+		(entry->memdesc.priv & KGSL_MEMDESC_PURGED))
+		return false;
+
+	rcu_read_lock();
+	task = pid_task(find_pid_ns(entry->priv->pid, &init_pid_ns),
+			PIDTYPE_PID);
+	if (task && task->signal->oom_score_adj >= kgsl_purge_min_adj)
+		ready = true;
+	rcu_read_unlock();
+
+	if (!ready)
+		return false;
+
+	/* A context that is gone has nothing left in flight */
+	context = kgsl_context_get(entry->purge_device, entry->purge_context_id);
+	if (context) {
+		ready = kgsl_check_timestamp(entry->purge_device, context,
+					     entry->purge_timestamp);
+		kgsl_context_put(context);
+	}
+
+	return ready;
+}
+
+/*
+ * Take the CPU mapping of the entry, if there is one, away from the owner.
+ * On success the mmap_sem of @mm is held for writing when *mm is set, and
+ * both that and the mm_users reference have to be dropped by the caller.
+ */
+static int kgsl_mem_entry_zap_cpu(struct kgsl_mem_entry *entry,
+				  struct mm_struct **mmp)
+{
+	struct mm_struct *mm = entry->vm_mm;
+	struct vm_area_struct *vma;
+
+	*mmp = NULL;
+	if (entry->vm_count == 0)
+		return 0;
+	/* Mappings in more than one place, or split up, are left alone */
+	if (entry->vm_count > 1 || !mm || !entry->memdesc.useraddr)
+		return -EBUSY;
+
+	if (!atomic_inc_not_zero(&mm->mm_users))
+		return -EBUSY;
+	if (!down_write_trylock(&mm->mmap_sem)) {
+		*mmp = mm;
+		return -EBUSY;
+	}
+
+	vma = find_vma(mm, entry->memdesc.useraddr);
+	if (!vma || vma->vm_private_data != entry ||
+		vma->vm_start != entry->memdesc.useraddr) {
+		up_write(&mm->mmap_sem);
+		*mmp = mm;
+		return -EBUSY;
+	}
+
+	zap_page_range(vma, vma->vm_start, vma->vm_end - vma->vm_start, NULL);
+	*mmp = mm;
+	return 0;
+}
+
+/*
+ * Call with entry->purge_lock held.  Returns the number of pages freed and
+ * leaves in *mmp an mm that has to be released with mmput() once the lock
+ * is dropped, as the last reference takes down the mappings.
+ */
+static int kgsl_mem_entry_purge(struct kgsl_mem_entry *entry,
+				struct mm_struct **mmp)
+{
+	struct kgsl_memdesc *memdesc = &entry->memdesc;
+	int locked;
+
+	*mmp = NULL;
+	if (!kgsl_mem_entry_purge_ready(entry))
+		return 0;
+
+	if (kgsl_mem_entry_zap_cpu(entry, mmp))
+		return 0;
+	locked = *mmp != NULL;
+
+	if (memdesc->priv & KGSL_MEMDESC_MAPPED) {
+		kgsl_mem_entry_large_page_stats(entry, 0);
+		kgsl_mmu_unmap(entry->priv->pagetable, memdesc);
+	}
+	kgsl_sharedmem_page_purge(memdesc);
+
+	if (locked)
+		up_write(&(*mmp)->mmap_sem);
+
+	spin_lock(&entry->priv->mem_lock);
+	entry->priv->purged += memdesc->size;
+	spin_unlock(&entry->priv->mem_lock);
+
+	spin_lock(&kgsl_driver.purge_lock);
+	kgsl_purge_list_del(entry);
+	kgsl_driver.stats.purged += memdesc->size;
+	spin_unlock(&kgsl_driver.purge_lock);
+
+	return memdesc->size >> PAGE_SHIFT;
+}
+
+/* Call with entry->purge_lock held */
+static int kgsl_mem_entry_refill(struct kgsl_mem_entry *entry)
+{
+	struct kgsl_memdesc *memdesc = &entry->memdesc;
+	int ret;
+
+	ret = kgsl_sharedmem_page_refill(memdesc);
+	if (ret)
+		return ret;
+
+	ret = kgsl_mmu_map(entry->priv->pagetable, memdesc);
+	if (ret) {
+		kgsl_sharedmem_page_purge(memdesc);
+		return ret;
+	}
+	kgsl_mem_entry_large_page_stats(entry, 1);
+
+	spin_lock(&entry->priv->mem_lock);
+	entry->priv->purged -= memdesc->size;
+	spin_unlock(&entry->priv->mem_lock);
+
+	spin_lock(&kgsl_driver.purge_lock);
+	kgsl_driver.stats.purged -= memdesc->size;
+	spin_unlock(&kgsl_driver.purge_lock);
+
+	return 0;
+}
+
+static int kgsl_purge_shrink(struct shrinker *shrinker,
+	struct shrink_control *sc)
+{
+	struct kgsl_mem_entry *entry;
+	struct mm_struct *mm;
+	long nr_to_scan = sc->nr_to_scan;
+	unsigned int count;
+	int ret;
+
+	if (nr_to_scan && !(sc->gfp_mask & __GFP_FS))
+		return -1;
+	if (!nr_to_scan)
+		return kgsl_driver.stats.purgeable >> PAGE_SHIFT;
+
+	/* Once round the list, entries that are not ready go to the back */
+	spin_lock(&kgsl_driver.purge_lock);
+	count = kgsl_driver.purge_entries;
+	while (nr_to_scan > 0 && count-- &&
+		!list_empty(&kgsl_driver.purge_list)) {
+		entry = list_first_entry(&kgsl_driver.purge_list,
+					 struct kgsl_mem_entry, purge_node);
+		list_move_tail(&entry->purge_node, &kgsl_driver.purge_list);
+		if (!mutex_trylock(&entry->purge_lock))
+			continue;
+		spin_unlock(&kgsl_driver.purge_lock);
+
+		nr_to_scan -= kgsl_mem_entry_purge(entry, &mm);
+		mutex_unlock(&entry->purge_lock);
+		if (mm)
+			mmput(mm);
+
+		spin_lock(&kgsl_driver.purge_lock);
+	}
+	ret = kgsl_driver.stats.purgeable >> PAGE_SHIFT;
+	spin_unlock(&kgsl_driver.purge_lock);
+
+	return ret;
+}
+
+static struct shrinker kgsl_purge_shrinker = {
+	.shrink = kgsl_purge_shrink,
+	.seeks = DEFAULT_SEEKS * 4,
+};
+
+/* Pages of GPU memory that killing tgid gives back, for the lowmemorykiller */
+static unsigned long kgsl_oom_driver_pages(pid_t tgid)
+{
+	struct kgsl_process_private *private;
+	unsigned long pages = 0;
+
+	spin_lock(&kgsl_driver.process_dump_lock);
+	list_for_each_entry(private, &kgsl_driver.process_list, list) {
+		if (private->pid == tgid) {
+			pages = (private->stats[KGSL_MEM_ENTRY_KERNEL].cur -
+				 private->purged) >> PAGE_SHIFT;
+			break;
+		}
+	}
+	spin_unlock(&kgsl_driver.process_dump_lock);
+
+	return pages;
+}
+
 /* Allocate a new context id */
 
 static struct kgsl_context *
@@ -678,7 +962,7 @@ static int kgsl_suspend_device(struct kgsl_device *device, pm_message_t state)
 
 	KGSL_PWR_WARN(device, "suspend start\n");
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	nap_allowed_saved = device->pwrctrl.nap_allowed;
 	device->pwrctrl.nap_allowed = false;
 	policy_saved = device->pwrscale.policy;
@@ -739,7 +1023,7 @@ static int kgsl_resume_device(struct kgsl_device *device)
 		return -EINVAL;
 
 	KGSL_PWR_WARN(device, "resume start\n");
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	if (device->state == KGSL_STATE_SUSPEND) {
 		kgsl_pwrctrl_set_state(device, KGSL_STATE_SLUMBER);
 		complete_all(&device->hwaccess_gate);
@@ -801,7 +1085,7 @@ void kgsl_early_suspend_driver(struct early_suspend *h)
 	struct kgsl_device *device = container_of(h,
 					struct kgsl_device, display_off);
 	KGSL_PWR_WARN(device, "early suspend start\n");
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	/* Only go to slumber if active_cnt is 0 */
 	if (device->active_cnt == 0) {
@@ -835,7 +1119,7 @@ void kgsl_late_resume_driver(struct early_suspend *h)
 	struct kgsl_device *device = container_of(h,
 					struct kgsl_device, display_off);
 	KGSL_PWR_WARN(device, "late resume start\n");
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	device->pwrctrl.restore_slumber = false;
 	if (device->pwrscale.policy == NULL)
 		kgsl_pwrctrl_pwrlevel_change(device, KGSL_PWRLEVEL_TURBO);
@@ -896,7 +1180,9 @@ static void kgsl_destroy_process_private(struct kref *kref)
 	if (private->debug_root)
 		debugfs_remove_recursive(private->debug_root);
 
+	spin_lock(&kgsl_driver.process_dump_lock);
 	list_del(&private->list);
+	spin_unlock(&kgsl_driver.process_dump_lock);
 	mutex_unlock(&kgsl_driver.process_mutex);
 
 	kgsl_mmu_putpagetable(private->pagetable);
@@ -956,7 +1242,9 @@ kgsl_find_process_private(struct kgsl_device_private *cur_dev_priv)
 	spin_lock_init(&private->mem_lock);
 	mutex_init(&private->process_private_mutex);
 	/* Add the newly created process struct obj to the process list */
+	spin_lock(&kgsl_driver.process_dump_lock);
 	list_add(&private->list, &kgsl_driver.process_list);
+	spin_unlock(&kgsl_driver.process_dump_lock);
 done:
 	mutex_unlock(&kgsl_driver.process_mutex);
 	return private;
@@ -1023,7 +1311,7 @@ static int kgsl_release(struct inode *inodep, struct file *filep)
 
 	filep->private_data = NULL;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	kgsl_active_count_get(device);
 
 	while (1) {
@@ -1123,7 +1411,7 @@ static int kgsl_open(struct inode *inodep, struct file *filep)
 	dev_priv->device = device;
 	filep->private_data = dev_priv;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	if (device->open_count == 0) {
 		/*
@@ -1172,7 +1460,7 @@ static int kgsl_open(struct inode *inodep, struct file *filep)
 	return result;
 
 err_stop:
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	device->open_count--;
 	if (device->open_count == 0) {
 		/* make sure power is on to stop the device */
@@ -1666,7 +1954,8 @@ static long _cmdstream_freememontimestamp(struct kgsl_device_private *dev_priv,
 						  KGSL_TIMESTAMP_RETIRED),
 				       timestamp);
 	result = kgsl_add_event(dev_priv->device, context_id, timestamp,
-				kgsl_freemem_event_cb, entry, dev_priv);
+				kgsl_freemem_event_cb, entry, dev_priv,
+				KGSL_EVENT_UNLOCKED);
 	kgsl_mem_entry_put(entry);
 	return result;
 }
@@ -2311,12 +2600,8 @@ error:
 	return result;
 }
 
-static int _kgsl_gpumem_sync_cache(struct kgsl_mem_entry *entry, int op)
+static int _kgsl_gpumem_cache_op(unsigned int op)
 {
-	int ret = 0;
-	int cacheop;
-	int mode;
-
 	/*
 	 * Flush is defined as (clean | invalidate).  If both bits are set, then
 	 * do a flush, otherwise check for the individual bits and clean or inv
@@ -2324,23 +2609,65 @@ static int _kgsl_gpumem_sync_cache(struct kgsl_mem_entry *entry, int op)
 	 */
 
 	if ((op & KGSL_GPUMEM_CACHE_FLUSH) == KGSL_GPUMEM_CACHE_FLUSH)
-		cacheop = KGSL_CACHE_OP_FLUSH;
+		return KGSL_CACHE_OP_FLUSH;
 	else if (op & KGSL_GPUMEM_CACHE_CLEAN)
-		cacheop = KGSL_CACHE_OP_CLEAN;
+		return KGSL_CACHE_OP_CLEAN;
 	else if (op & KGSL_GPUMEM_CACHE_INV)
-		cacheop = KGSL_CACHE_OP_INV;
-	else {
-		ret = -EINVAL;
-		goto done;
-	}
+		return KGSL_CACHE_OP_INV;
 
-	mode = kgsl_memdesc_get_cachemode(&entry->memdesc);
-	if (mode != KGSL_CACHEMODE_UNCACHED
-		&& mode != KGSL_CACHEMODE_WRITECOMBINE)
-		kgsl_cache_range_op(&entry->memdesc, cacheop);
+	return -EINVAL;
+}
 
-done:
-	return ret;
+static inline int _kgsl_gpumem_cached(struct kgsl_mem_entry *entry)
+{
+	int mode = kgsl_memdesc_get_cachemode(&entry->memdesc);
+
+	return (mode != KGSL_CACHEMODE_UNCACHED
+		&& mode != KGSL_CACHEMODE_WRITECOMBINE);
+}
+
+/*
+ * The caches are done without the purge_lock held, as the user address may
+ * fault, but with a purge held off.  Nothing to do for a purged entry.
+ */
+static void _kgsl_gpumem_cache_range_op(struct kgsl_mem_entry *entry,
+		unsigned int offset, unsigned int length, int cacheop)
+{
+	int purged;
+
+	mutex_lock(&entry->purge_lock);
+	purged = entry->memdesc.priv & KGSL_MEMDESC_PURGED;
+	if (!purged)
+		entry->purge_hold++;
+	mutex_unlock(&entry->purge_lock);
+
+	if (purged)
+		return;
+
+	kgsl_cache_range_op_partial(&entry->memdesc, offset, length, cacheop);
+
+	mutex_lock(&entry->purge_lock);
+	entry->purge_hold--;
+	mutex_unlock(&entry->purge_lock);
+}
+
+static int _kgsl_gpumem_sync_cache(struct kgsl_mem_entry *entry,
+		unsigned int offset, unsigned int length, unsigned int op)
+{
+	int cacheop = _kgsl_gpumem_cache_op(op);
+
+	if (cacheop < 0)
+		return cacheop;
+
+	if (!_kgsl_gpumem_cached(entry))
+		return 0;
+
+	if (length > kgsl_driver.full_cache_threshold)
+		kgsl_cache_flush_all();
+	else
+		_kgsl_gpumem_cache_range_op(entry, offset, length, cacheop);
+
+	return 0;
 }
 
 /* New cache sync function - supports both directions (clean and invalidate) */
@@ -2352,6 +2679,7 @@ kgsl_ioctl_gpumem_sync_cache(struct kgsl_device_private *dev_priv,
 	struct kgsl_gpumem_sync_cache *param = data;
 	struct kgsl_process_private *private = dev_priv->process_priv;
 	struct kgsl_mem_entry *entry = NULL;
+	unsigned int offset = 0, length;
 	long ret;
 
 	if (param->id != 0) {
@@ -2373,11 +2701,101 @@ kgsl_ioctl_gpumem_sync_cache(struct kgsl_device_private *dev_priv,
 		return -EINVAL;
 	}
 
-	ret = _kgsl_gpumem_sync_cache(entry, param->op);
+	length = entry->memdesc.size;
+
+	/* Older user space leaves garbage in offset and length */
+	if (param->op & KGSL_GPUMEM_CACHE_RANGE) {
+		if (param->offset >= entry->memdesc.size) {
+			ret = -ERANGE;
+			goto done;
+		}
+
+		offset = param->offset;
+		length = min_t(size_t, param->length,
+			entry->memdesc.size - offset);
+	}
+
+	ret = _kgsl_gpumem_sync_cache(entry, offset, length, param->op);
+done:
 	kgsl_mem_entry_put(entry);
 	return ret;
 }
 
+/*
+ * Sync a list of buffers at once.  The total size of the list decides
+ * whether the buffers are walked one by one or the whole cache is flushed.
+ */
+
+static long
+kgsl_ioctl_gpumem_sync_cache_bulk(struct kgsl_device_private *dev_priv,
+	unsigned int cmd, void *data)
+{
+	struct kgsl_gpumem_sync_cache_bulk *param = data;
+	struct kgsl_process_private *private = dev_priv->process_priv;
+	struct kgsl_mem_entry **entries = NULL;
+	unsigned int *id_list = NULL;
+	unsigned int i, count = 0, total = 0;
+	int cacheop;
+	long ret = 0;
+
+	cacheop = _kgsl_gpumem_cache_op(param->op);
+	if (cacheop < 0)
+		return cacheop;
+
+	if (param->id_list == NULL || param->count == 0 ||
+		param->count > (PAGE_SIZE / sizeof(unsigned int)))
+		return -EINVAL;
+
+	id_list = kzalloc(param->count * sizeof(unsigned int), GFP_KERNEL);
+	entries = kzalloc(param->count * sizeof(*entries), GFP_KERNEL);
+	if (id_list == NULL || entries == NULL) {
+		ret = -ENOMEM;
+		goto done;
+	}
+
+	if (copy_from_user(id_list, param->id_list,
+				param->count * sizeof(unsigned int))) {
+		ret = -EFAULT;
+		goto done;
+	}
+
+	for (i = 0; i < param->count; i++) {
+		struct kgsl_mem_entry *entry =
+			kgsl_sharedmem_find_id(private, id_list[i]);
+
+		if (entry == NULL) {
+			KGSL_MEM_INFO(dev_priv->device, "can't find id %d\n",
+					id_list[i]);
+			ret = -EINVAL;
+			goto done;
+		}
+
+		if (!_kgsl_gpumem_cached(entry)) {
+			kgsl_mem_entry_put(entry);
+			continue;
+		}
+
+		entries[count++] = entry;
+		total += entry->memdesc.size;
+	}
+
+	if (total > kgsl_driver.full_cache_threshold)
+		kgsl_cache_flush_all();
+	else {
+		for (i = 0; i < count; i++)
+			_kgsl_gpumem_cache_range_op(entries[i], 0,
+				entries[i]->memdesc.size, cacheop);
+	}
+
+done:
+	for (i = 0; i < count; i++)
+		kgsl_mem_entry_put(entries[i]);
+
+	kfree(entries);
+	kfree(id_list);
+	return ret;
+}
+
 /* Legacy cache function, does a flush (clean  + invalidate) */
 
 static long
@@ -2396,7 +2814,8 @@ kgsl_ioctl_sharedmem_flush_cache(struct kgsl_device_private *dev_priv,
 				param->gpuaddr);
 		return -EINVAL;
 	}
-	ret = _kgsl_gpumem_sync_cache(entry, KGSL_GPUMEM_CACHE_FLUSH);
+	ret = _kgsl_gpumem_sync_cache(entry, 0, entry->memdesc.size,
+		KGSL_GPUMEM_CACHE_FLUSH);
 	kgsl_mem_entry_put(entry);
 	return ret;
 }
@@ -2550,6 +2969,62 @@ kgsl_ioctl_gpumem_get_info(struct kgsl_device_private *dev_priv,
 	return result;
 }
 
+static long
+kgsl_ioctl_gpumem_set_purgeable(struct kgsl_device_private *dev_priv,
+			unsigned int cmd, void *data)
+{
+	struct kgsl_process_private *private = dev_priv->process_priv;
+	struct kgsl_gpumem_set_purgeable *param = data;
+	struct kgsl_mem_entry *entry;
+	int result = 0;
+
+	entry = kgsl_sharedmem_find_id(private, param->id);
+	if (entry == NULL) {
+		KGSL_MEM_INFO(dev_priv->device, "can't find id %d\n",
+				param->id);
+		return -EINVAL;
+	}
+
+	/* Only memory from the page allocator that the kernel doesn't use */
+	if (entry->memtype != KGSL_MEM_ENTRY_KERNEL ||
+		entry->memdesc.ops != &kgsl_page_alloc_ops ||
+		entry->memdesc.hostptr || !entry->memdesc.gpuaddr) {
+		result = -EINVAL;
+		goto done;
+	}
+
+	mutex_lock(&entry->purge_lock);
+	param->was_purged = 0;
+	if (param->purgeable) {
+		entry->purge_device = dev_priv->device;
+		entry->purge_context_id = param->context_id;
+		entry->purge_timestamp = param->timestamp;
+		entry->purgeable = 1;
+
+		spin_lock(&kgsl_driver.purge_lock);
+		if (!(entry->memdesc.priv & KGSL_MEMDESC_PURGED) &&
+			list_empty(&entry->purge_node))
+			kgsl_purge_list_add(entry);
+		spin_unlock(&kgsl_driver.purge_lock);
+	} else {
+		entry->purgeable = 0;
+
+		spin_lock(&kgsl_driver.purge_lock);
+		kgsl_purge_list_del(entry);
+		spin_unlock(&kgsl_driver.purge_lock);
+
+		if (entry->memdesc.priv & KGSL_MEMDESC_PURGED) {
+			param->was_purged = 1;
+			result = kgsl_mem_entry_refill(entry);
+		}
+	}
+	mutex_unlock(&entry->purge_lock);
+
+done:
+	kgsl_mem_entry_put(entry);
+	return result;
+}
+
 static long kgsl_ioctl_cff_syncmem(struct kgsl_device_private *dev_priv,
 					unsigned int cmd, void *data)
 {
@@ -2654,7 +3129,7 @@ static int kgsl_add_genlock_event(struct kgsl_device *device,
 	}
 
 	ret = kgsl_add_event(device, context_id, timestamp,
-			kgsl_genlock_event_cb, event, owner);
+			kgsl_genlock_event_cb, event, owner, KGSL_EVENT_UNLOCKED);
 	if (ret)
 		kfree(event);
 
@@ -2774,6 +3249,10 @@ static const struct {
 			kgsl_ioctl_gpumem_get_info, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_GPUMEM_SYNC_CACHE,
 			kgsl_ioctl_gpumem_sync_cache, 0),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_GPUMEM_SYNC_CACHE_BULK,
+			kgsl_ioctl_gpumem_sync_cache_bulk, 0),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_GPUMEM_SET_PURGEABLE,
+			kgsl_ioctl_gpumem_set_purgeable, 0),
 };
 
 static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
@@ -2853,7 +3332,7 @@ static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 	}
 
 	if (lock) {
-		mutex_lock(&dev_priv->device->mutex);
+		lsl_mutex_lock(&dev_priv->device->mutex, LSL_KGSL_DEVICE);
 		if (use_hw) {
 			ret = kgsl_active_count_get(dev_priv->device);
 			if (ret < 0)
@@ -2920,8 +3399,14 @@ kgsl_mmap_memstore(struct kgsl_device *device, struct vm_area_struct *vma)
 static void kgsl_gpumem_vm_open(struct vm_area_struct *vma)
 {
 	struct kgsl_mem_entry *entry = vma->vm_private_data;
-	if (!kgsl_mem_entry_get(entry))
+	if (!kgsl_mem_entry_get(entry)) {
 		vma->vm_private_data = NULL;
+		return;
+	}
+
+	mutex_lock(&entry->purge_lock);
+	entry->vm_count++;
+	mutex_unlock(&entry->purge_lock);
 }
 
 static int
@@ -2933,6 +3418,10 @@ kgsl_gpumem_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 		return VM_FAULT_SIGBUS;
 	if (!entry->memdesc.ops || !entry->memdesc.ops->vmfault)
 		return VM_FAULT_SIGBUS;
+	/* A purge holds the mmap_sem for writing, a refill orders the sg */
+	if (entry->memdesc.priv & KGSL_MEMDESC_PURGED)
+		return VM_FAULT_SIGBUS;
+	smp_rmb();
 
 	return entry->memdesc.ops->vmfault(&entry->memdesc, vma, vmf);
 }
@@ -2945,6 +3434,13 @@ kgsl_gpumem_vm_close(struct vm_area_struct *vma)
 	if (!entry)
 		return;
 
+	mutex_lock(&entry->purge_lock);
+	if (--entry->vm_count == 0 && entry->vm_mm) {
+		mmdrop(entry->vm_mm);
+		entry->vm_mm = NULL;
+	}
+	mutex_unlock(&entry->purge_lock);
+
 	entry->memdesc.useraddr = 0;
 	kgsl_mem_entry_put(entry);
 }
@@ -3095,7 +3591,8 @@ kgsl_get_unmapped_area(struct file *file, unsigned long addr,
 				kgsl_mem_entry_untrack_gpuaddr(private, entry);
 				spin_unlock(&private->mem_lock);
 				ret = ret_val;
-			}
+			} else
+				kgsl_mem_entry_large_page_stats(entry, 1);
 			break;
 		}
 		spin_unlock(&private->mem_lock);
@@ -3181,6 +3678,12 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 
 	vma->vm_ops = &kgsl_gpumem_vm_ops;
 
+	mutex_lock(&entry->purge_lock);
+	if (entry->vm_count++ == 0) {
+		atomic_inc(&vma->vm_mm->mm_count);
+		entry->vm_mm = vma->vm_mm;
+	}
+
 	if (cache == KGSL_CACHEMODE_WRITEBACK
 		|| cache == KGSL_CACHEMODE_WRITETHROUGH) {
 		struct scatterlist *s;
@@ -3202,6 +3705,7 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 	vma->vm_file = file;
 
 	entry->memdesc.useraddr = vma->vm_start;
+	mutex_unlock(&entry->purge_lock);
 
 	trace_kgsl_mem_mmap(entry);
 	return 0;
@@ -3227,9 +3731,14 @@ static const struct file_operations kgsl_fops = {
 struct kgsl_driver kgsl_driver  = {
 	.process_mutex = __MUTEX_INITIALIZER(kgsl_driver.process_mutex),
 	.ptlock = __SPIN_LOCK_UNLOCKED(kgsl_driver.ptlock),
+	.process_dump_lock =
+		__SPIN_LOCK_UNLOCKED(kgsl_driver.process_dump_lock),
 	.devlock = __MUTEX_INITIALIZER(kgsl_driver.devlock),
 	.memfree_hist_mutex =
 		__MUTEX_INITIALIZER(kgsl_driver.memfree_hist_mutex),
+	.full_cache_threshold = KGSL_FULL_CACHE_THRESHOLD,
+	.purge_list = LIST_HEAD_INIT(kgsl_driver.purge_list),
+	.purge_lock = __SPIN_LOCK_UNLOCKED(kgsl_driver.purge_lock),
 };
 EXPORT_SYMBOL(kgsl_driver);
 
@@ -3383,10 +3892,14 @@ int kgsl_device_platform_probe(struct kgsl_device *device)
 	if (status)
 		goto error_pwrctrl_close;
 
+	status = kgsl_events_init(device);
+	if (status)
+		goto error_dest_work_q;
+
 	status = kgsl_mmu_init(device);
 	if (status != 0) {
 		KGSL_DRV_ERR(device, "kgsl_mmu_init failed %d\n", status);
-		goto error_dest_work_q;
+		goto error_close_events;
 	}
 
 	status = kgsl_allocate_contiguous(&device->memstore,
@@ -3411,6 +3924,8 @@ int kgsl_device_platform_probe(struct kgsl_device *device)
 
 error_close_mmu:
 	kgsl_mmu_close(device);
+error_close_events:
+	kgsl_events_close(device);
 error_dest_work_q:
 	destroy_workqueue(device->work_queue);
 	device->work_queue = NULL;
@@ -3498,6 +4013,8 @@ void kgsl_device_platform_remove(struct kgsl_device *device)
 
 	pm_qos_remove_request(&device->pm_qos_req_dma);
 
+	kgsl_events_close(device);
+
 	idr_destroy(&device->context_idr);
 
 	kgsl_sharedmem_free(&device->memstore);
@@ -3526,6 +4043,11 @@ kgsl_ptdata_init(void)
 
 static void kgsl_core_exit(void)
 {
+	oom_driver_pages = NULL;
+	synchronize_rcu();
+	unregister_shrinker(&kgsl_purge_shrinker);
+	kgsl_pool_exit();
+
 	kgsl_mmu_ptpool_destroy(kgsl_driver.ptpool);
 	kgsl_driver.ptpool = NULL;
 
@@ -3556,6 +4078,10 @@ static void kgsl_core_exit(void)
 static int __init kgsl_core_init(void)
 {
 	int result = 0;
+
+	kgsl_pool_init();
+	register_shrinker(&kgsl_purge_shrinker);
+
 	/* alloc major and minor device numbers */
 	result = alloc_chrdev_region(&kgsl_driver.major, 0, KGSL_DEVICE_MAX,
 				  KGSL_NAME);
@@ -3624,6 +4150,8 @@ static int __init kgsl_core_init(void)
 	if (kgsl_memfree_hist_init())
 		KGSL_CORE_ERR("failed to init memfree_hist");
 
+	oom_driver_pages = kgsl_oom_driver_pages;
+
 	return 0;
 
 err:
@@ -38,6 +38,9 @@
 /* Timestamp window used to detect rollovers (half of integer range) */
 #define KGSL_TIMESTAMP_WINDOW 0x80000000
 
+/* Default size above which a cache sync flushes the whole cache */
+#define KGSL_FULL_CACHE_THRESHOLD (SZ_4M)
+
 /*cache coherency ops */
 #define DRM_KGSL_GEM_CACHE_OP_TO_DEV	0x0001
 #define DRM_KGSL_GEM_CACHE_OP_FROM_DEV	0x0002
@@ -121,6 +124,14 @@ struct kgsl_driver {
 	struct mutex memfree_hist_mutex;
 	struct kgsl_memfree_hist memfree_hist;
 
+	/* Cache syncs larger than this flush the whole cache instead */
+	unsigned int full_cache_threshold;
+
+	/* Purgeable entries that still have their pages, oldest first */
+	struct list_head purge_list;
+	spinlock_t purge_lock;
+	unsigned int purge_entries;
+
 	struct {
 		unsigned int vmalloc;
 		unsigned int vmalloc_max;
@@ -134,6 +145,8 @@ struct kgsl_driver {
 		unsigned int pre_alloc;
 		unsigned int pre_alloc_max;
 		unsigned int pre_alloc_kernel;
+		unsigned int purgeable;
+		unsigned int purged;
 		unsigned int histogram[16];
 	} stats;
 };
@@ -159,6 +172,8 @@ struct kgsl_memdesc_ops {
 #define KGSL_MEMDESC_FROZEN BIT(2)
 /* The memdesc is mapped into a pagetable */
 #define KGSL_MEMDESC_MAPPED BIT(3)
+/* The pages of the memdesc were given back while it was purgeable */
+#define KGSL_MEMDESC_PURGED BIT(4)
 
 /* shared memory allocation */
 struct kgsl_memdesc {
@@ -201,6 +216,22 @@ struct kgsl_mem_entry {
 	/* Initialized to 0, set to 1 when entry is marked for freeing */
 	int pending_free;
 	struct kgsl_device_private *dev_priv;
+	/*
+	 * Held while the pages are purged or refilled, and across CPU
+	 * faults and mmap bookkeeping so they see a consistent memdesc
+	 */
+	struct mutex purge_lock;
+	/* On kgsl_driver.purge_list while purgeable and not yet purged */
+	struct list_head purge_node;
+	int purgeable;
+	struct kgsl_device *purge_device;
+	unsigned int purge_context_id;
+	unsigned int purge_timestamp;
+	/* CPU cache ioctls walking the pages, they hold off a purge */
+	int purge_hold;
+	/* CPU mappings, and the mm of the first one */
+	int vm_count;
+	struct mm_struct *vm_mm;
 };
 
 #ifdef CONFIG_MSM_KGSL_MMU_PAGE_FAULT
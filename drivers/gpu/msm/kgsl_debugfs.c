@@ -29,7 +29,7 @@ static int pm_dump_set(void *data, u64 val)
 	struct kgsl_device *device = data;
 
 	if (val) {
-		mutex_lock(&device->mutex);
+		lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 		kgsl_postmortem_dump(device, 1);
 		mutex_unlock(&device->mutex);
 	}
@@ -169,6 +169,61 @@ static const struct file_operations memfree_hist_fops = {
 	.release = single_release,
 };
 
+static int event_latency_print(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+	int i;
+
+	for (i = 0; i < KGSL_EVENT_LATENCY_BUCKETS - 1; i++)
+		seq_printf(s, "<%6uus: %u\n", KGSL_EVENT_LATENCY_BASE_US << i,
+			device->events_latency[i]);
+
+	seq_printf(s, ">=%5uus: %u\n", KGSL_EVENT_LATENCY_BASE_US << i,
+		device->events_latency[i]);
+	seq_printf(s, "max: %uus\n", device->events_latency_max);
+
+	return 0;
+}
+
+static int event_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, event_latency_print, inode->i_private);
+}
+
+static const struct file_operations event_latency_fops = {
+	.open = event_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mmu_stats_print(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+	struct kgsl_mmu *mmu = &device->mmu;
+
+	seq_printf(s, "pt_switches: %u\n", mmu->stats.pt_switches);
+	seq_printf(s, "pt_switches_avoided: %u\n",
+		mmu->stats.pt_switches_avoided);
+	seq_printf(s, "tlb_flushes: %u\n", mmu->stats.tlb_flushes);
+	seq_printf(s, "tlb_flushes_avoided: %u\n",
+		mmu->stats.tlb_flushes_avoided);
+
+	return 0;
+}
+
+static int mmu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmu_stats_print, inode->i_private);
+}
+
+static const struct file_operations mmu_stats_fops = {
+	.open = mmu_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void kgsl_device_debugfs_init(struct kgsl_device *device)
 {
 	if (kgsl_debugfs_dir && !IS_ERR(kgsl_debugfs_dir))
@@ -190,6 +245,10 @@ void kgsl_device_debugfs_init(struct kgsl_device *device)
 				&pwr_log_fops);
 	debugfs_create_file("memfree_history", 0444, device->d_debugfs, device,
 				&memfree_hist_fops);
+	debugfs_create_file("event_latency", 0444, device->d_debugfs, device,
+				&event_latency_fops);
+	debugfs_create_file("mmu_stats", 0444, device->d_debugfs, device,
+				&mmu_stats_fops);
 
 	/* Create postmortem dump control files */
 
@@ -14,8 +14,11 @@
 #define __KGSL_DEVICE_H
 
 #include <linux/idr.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/pm_qos.h>
 #include <linux/earlysuspend.h>
+#include <linux/lockstat_lite.h>
 
 #include "kgsl.h"
 #include "kgsl_mmu.h"
@@ -68,6 +71,7 @@ struct kgsl_device_private;
 struct kgsl_context;
 struct kgsl_power_stats;
 struct kgsl_event;
+struct kgsl_snapshot_pack;
 
 struct kgsl_functable {
 	/* Mandatory functions - these functions must be implemented
@@ -138,6 +142,9 @@ struct kgsl_mh {
 
 typedef void (*kgsl_event_func)(struct kgsl_device *, void *, u32, u32, u32);
 
+/* The event callback can be called without holding the device mutex */
+#define KGSL_EVENT_UNLOCKED	BIT(0)
+
 struct kgsl_event {
 	struct kgsl_context *context;
 	uint32_t timestamp;
@@ -146,8 +153,14 @@ struct kgsl_event {
 	struct list_head list;
 	void *owner;
 	unsigned int created;
+	unsigned int flags;
 };
 
+/* Number of power of two buckets in the event latency histogram */
+#define KGSL_EVENT_LATENCY_BUCKETS	8
+/* Upper bound of the first latency bucket in microseconds */
+#define KGSL_EVENT_LATENCY_BASE_US	64
+
 
 struct kgsl_device {
 	struct device *dev;
@@ -203,6 +216,10 @@ struct kgsl_device {
 	 * dumped
 	 */
 	struct list_head snapshot_obj_list;
+	unsigned int snapshot_budget;	/* Capture time budget in ms */
+	unsigned long snapshot_deadline;
+	int snapshot_skipped;	/* Optional sections dropped over budget */
+	struct kgsl_snapshot_pack *snapshot_pack;
 
 	/* Logging levels */
 	int cmd_log;
@@ -215,9 +232,17 @@ struct kgsl_device {
 	struct kgsl_pwrscale pwrscale;
 	struct kobject pwrscale_kobj;
 	struct pm_qos_request pm_qos_req_dma;
-	struct work_struct ts_expired_ws;
+	struct kthread_work ts_expired_ws;
+	struct kthread_worker events_worker;
+	struct task_struct *events_thread;
+	/* Protects the event lists and events_kick */
+	spinlock_t events_lock;
 	struct list_head events;
 	struct list_head events_pending_list;
+	/* Time of the first interrupt since the events were last processed */
+	ktime_t events_kick;
+	unsigned int events_latency[KGSL_EVENT_LATENCY_BUCKETS];
+	unsigned int events_latency_max;
 	s64 on_time;
 
 	/* Postmortem Control switches */
@@ -227,7 +252,7 @@ struct kgsl_device {
 	int reset_counter; /* Track how many GPU core resets have occured */
 };
 
-void kgsl_process_events(struct work_struct *work);
+void kgsl_process_events(struct kthread_work *work);
 void kgsl_check_fences(struct work_struct *work);
 
 #define KGSL_DEVICE_COMMON_INIT(_dev) \
@@ -238,8 +263,10 @@ void kgsl_check_fences(struct work_struct *work);
 			kgsl_idle_check),\
 	.hang_check_ws = __WORK_INITIALIZER((_dev).hang_check_ws,\
 			kgsl_hang_check),\
-	.ts_expired_ws  = __WORK_INITIALIZER((_dev).ts_expired_ws,\
+	.ts_expired_ws  = KTHREAD_WORK_INIT((_dev).ts_expired_ws,\
 			kgsl_process_events),\
+	.events_worker = KTHREAD_WORKER_INIT((_dev).events_worker),\
+	.events_lock = __SPIN_LOCK_UNLOCKED((_dev).events_lock),\
 	.context_idr = IDR_INIT((_dev).context_idr),\
 	.events = LIST_HEAD_INIT((_dev).events),\
 	.events_pending_list = LIST_HEAD_INIT((_dev).events_pending_list), \
@@ -313,6 +340,11 @@ struct kgsl_process_private {
 		unsigned int cur;
 		unsigned int max;
 	} stats[KGSL_MEM_ENTRY_MAX];
+	/* Bytes mapped with 64K pages and 1M sections in the IOMMU */
+	unsigned int mapped_64k;
+	unsigned int mapped_1m;
+	/* Bytes of KGSL_MEM_ENTRY_KERNEL memory currently purged */
+	unsigned int purged;
 };
 
 /**
@@ -336,7 +368,10 @@ struct kgsl_power_stats {
 struct kgsl_device *kgsl_get_device(int dev_idx);
 
 int kgsl_add_event(struct kgsl_device *device, u32 id, u32 ts,
-	kgsl_event_func func, void *priv, void *owner);
+	kgsl_event_func func, void *priv, void *owner, unsigned int flags);
+void kgsl_schedule_events(struct kgsl_device *device);
+int kgsl_events_init(struct kgsl_device *device);
+void kgsl_events_close(struct kgsl_device *device);
 
 static inline void kgsl_process_add_stats(struct kgsl_process_private *priv,
 	unsigned int type, size_t size)
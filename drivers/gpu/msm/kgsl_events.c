@@ -1,4 +1,4 @@
-/* Copyright (c) 2011-2013, The Linux Foundation. All rights reserved.
+/* Copyright (c) 2011-2014, The Linux Foundation. All rights reserved.
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License version 2 and
@@ -14,10 +14,24 @@
 #include <linux/slab.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/frametime.h>
 #include <kgsl_device.h>
 
 #include "kgsl_trace.h"
 
+/*
+ * Events are kept in timestamp order on the list for the owning context (or
+ * on the device list for global timestamps) and the lists are protected by
+ * device->events_lock.  When the GPU raises a timestamp interrupt the events
+ * are retired on a dedicated high priority thread.  Events that were added
+ * with KGSL_EVENT_UNLOCKED are taken off the lists and fired without the
+ * device mutex so that fence, genlock and free-on-timestamp users don't have
+ * to wait for whoever is holding the mutex in an ioctl.  The mutex is only
+ * taken afterwards, once per batch, to fire the remaining events, drop the
+ * active counts held by the events and arm the interrupt for the next one.
+ */
+
 static inline struct list_head *_get_list_head(struct kgsl_device *device,
 		struct kgsl_context *context)
 {
@@ -42,6 +56,10 @@ static void _add_event_to_list(struct list_head *head, struct kgsl_event *event)
 		list_add_tail(&event->list, head);
 }
 
+/*
+ * Fire an event that has already been taken off the event lists.  The
+ * caller is responsible for dropping the active count held by the event.
+ */
 static inline void _do_signal_event(struct kgsl_device *device,
 		struct kgsl_event *event, unsigned int timestamp,
 		unsigned int type)
@@ -56,12 +74,31 @@ static inline void _do_signal_event(struct kgsl_device *device,
 	list_del(&event->list);
 	kgsl_context_put(event->context);
 	kfree(event);
+}
 
-	kgsl_active_count_put(device);
+/*
+ * Fire all the events in a private list and drop their active counts.  The
+ * caller must hold the device mutex.
+ */
+static void _signal_event_list(struct kgsl_device *device,
+		struct list_head *head, unsigned int timestamp,
+		unsigned int type)
+{
+	struct kgsl_event *event, *tmp;
+
+	list_for_each_entry_safe(event, tmp, head, list) {
+		_do_signal_event(device, event, timestamp, type);
+		kgsl_active_count_put(device);
+	}
 }
 
-static void _retire_events(struct kgsl_device *device,
-		struct list_head *head, unsigned int timestamp)
+/*
+ * Move the expired events from an event list to a private list.  If
+ * unlocked is set only the events that can be fired without the device
+ * mutex are moved.  Caller must hold the events lock.
+ */
+static void _retire_events(struct list_head *head, unsigned int timestamp,
+		int unlocked, struct list_head *retired)
 {
 	struct kgsl_event *event, *tmp;
 
@@ -69,69 +106,93 @@ static void _retire_events(struct kgsl_device *device,
 		if (timestamp_cmp(timestamp, event->timestamp) < 0)
 			break;
 
-		_do_signal_event(device, event, event->timestamp,
-			KGSL_EVENT_TIMESTAMP_RETIRED);
+		if (unlocked && !(event->flags & KGSL_EVENT_UNLOCKED))
+			continue;
+
+		list_move_tail(&event->list, retired);
 	}
 }
 
-static struct kgsl_event *_find_event(struct kgsl_device *device,
-		struct list_head *head, unsigned int timestamp,
-		kgsl_event_func func, void *priv)
+/*
+ * Collect the expired events from the device list and all the contexts
+ * with pending events.  Contexts that run out of events are dropped from
+ * the pending list - the context stays alive for as long as it has events
+ * because each event holds a reference to it.
+ */
+static void _retire_pending_events(struct kgsl_device *device, int unlocked,
+		struct list_head *retired)
 {
-	struct kgsl_event *event, *tmp;
+	struct kgsl_context *context, *tmp;
+	unsigned int timestamp;
+	unsigned long flags;
 
-	list_for_each_entry_safe(event, tmp, head, list) {
-		if (timestamp == event->timestamp && func == event->func &&
-			event->priv == priv)
-			return event;
+	spin_lock_irqsave(&device->events_lock, flags);
+
+	timestamp = kgsl_readtimestamp(device, NULL, KGSL_TIMESTAMP_RETIRED);
+	_retire_events(&device->events, timestamp, unlocked, retired);
+
+	list_for_each_entry_safe(context, tmp, &device->events_pending_list,
+		events_list) {
+		timestamp = kgsl_readtimestamp(device, context,
+			KGSL_TIMESTAMP_RETIRED);
+		if (unlocked)
+			frametime_gpu_retire(context->id, timestamp);
+		_retire_events(&context->events, timestamp, unlocked, retired);
+
+		if (list_empty(&context->events))
+			list_del_init(&context->events_list);
 	}
 
-	return NULL;
+	spin_unlock_irqrestore(&device->events_lock, flags);
 }
 
-/**
- * _signal_event - send a signal to a specific event in the list
- * @device - KGSL device
- * @head - Pointer to the event list to process
- * @timestamp - timestamp of the event to signal
- * @cur - timestamp value to send to the callback
- * @type - Signal ID to send to the callback
- *
- * Send the specified signal to the events in the list with the specified
- * timestamp. The timestamp 'cur' is sent to the callback so it knows
- * when the signal was delivered
- */
-static void _signal_event(struct kgsl_device *device,
-		struct list_head *head, unsigned int timestamp,
-		unsigned int cur, unsigned int type)
+static void _record_latency(struct kgsl_device *device, ktime_t kick)
+{
+	unsigned int usecs, bucket;
+
+	/* Only events retired because of an interrupt are counted */
+	if (kick.tv64 == 0)
+		return;
+
+	usecs = (unsigned int) ktime_us_delta(ktime_get(), kick);
+	bucket = min_t(unsigned int, fls(usecs / KGSL_EVENT_LATENCY_BASE_US),
+		KGSL_EVENT_LATENCY_BUCKETS - 1);
+
+	device->events_latency[bucket]++;
+	if (usecs > device->events_latency_max)
+		device->events_latency_max = usecs;
+}
+
+/* Fire a list of retired events, return the number of events fired */
+static int _fire_retired_events(struct kgsl_device *device,
+		struct list_head *head, ktime_t kick)
 {
 	struct kgsl_event *event, *tmp;
+	int count = 0;
 
 	list_for_each_entry_safe(event, tmp, head, list) {
-		if (timestamp_cmp(timestamp, event->timestamp) == 0)
-			_do_signal_event(device, event, cur, type);
+		_record_latency(device, kick);
+		_do_signal_event(device, event, event->timestamp,
+			KGSL_EVENT_TIMESTAMP_RETIRED);
+		count++;
 	}
+
+	return count;
 }
 
-/**
- * _signal_events - send a signal to all the events in a list
- * @device - KGSL device
- * @head - Pointer to the event list to process
- * @timestamp - Timestamp to pass to the events (this should be the current
- * timestamp when the signal is sent)
- * @type - Signal ID to send to the callback
- *
- * Send the specified signal to all the events in the list and destroy them
- */
-static void _signal_events(struct kgsl_device *device,
-		struct list_head *head, uint32_t timestamp,
-		unsigned int type)
+static struct kgsl_event *_find_event(struct kgsl_device *device,
+		struct list_head *head, unsigned int timestamp,
+		kgsl_event_func func, void *priv)
 {
 	struct kgsl_event *event, *tmp;
 
-	list_for_each_entry_safe(event, tmp, head, list)
-		_do_signal_event(device, event, timestamp, type);
+	list_for_each_entry_safe(event, tmp, head, list) {
+		if (timestamp == event->timestamp && func == event->func &&
+			event->priv == priv)
+			return event;
+	}
 
+	return NULL;
 }
 
 void kgsl_signal_event(struct kgsl_device *device,
@@ -139,15 +200,32 @@ void kgsl_signal_event(struct kgsl_device *device,
 		unsigned int type)
 {
 	struct list_head *head = _get_list_head(device, context);
+	struct kgsl_event *event, *tmp;
+	unsigned long flags;
+	LIST_HEAD(list);
 	uint32_t cur;
 
 	BUG_ON(!mutex_is_locked(&device->mutex));
 
 	cur = kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_RETIRED);
-	_signal_event(device, head, timestamp, cur, type);
+
+	spin_lock_irqsave(&device->events_lock, flags);
+
+	list_for_each_entry_safe(event, tmp, head, list) {
+		if (timestamp_cmp(timestamp, event->timestamp) == 0)
+			list_move_tail(&event->list, &list);
+	}
 
 	if (context && list_empty(&context->events))
 		list_del_init(&context->events_list);
+
+	spin_unlock_irqrestore(&device->events_lock, flags);
+
+	/*
+	 * The timestamp 'cur' is sent to the callback so it knows when the
+	 * signal was delivered
+	 */
+	_signal_event_list(device, &list, cur, type);
 }
 EXPORT_SYMBOL(kgsl_signal_event);
 
@@ -155,6 +233,8 @@ void kgsl_signal_events(struct kgsl_device *device,
 		struct kgsl_context *context, unsigned int type)
 {
 	struct list_head *head = _get_list_head(device, context);
+	unsigned long flags;
+	LIST_HEAD(list);
 	uint32_t cur;
 
 	BUG_ON(!mutex_is_locked(&device->mutex));
@@ -166,7 +246,9 @@ void kgsl_signal_events(struct kgsl_device *device,
 
 	cur = kgsl_readtimestamp(device, context, KGSL_TIMESTAMP_RETIRED);
 
-	_signal_events(device, head, cur, type);
+	spin_lock_irqsave(&device->events_lock, flags);
+
+	list_splice_init(head, &list);
 
 	/*
 	 * Remove the context from the master list since we know everything on
@@ -175,6 +257,10 @@ void kgsl_signal_events(struct kgsl_device *device,
 
 	if (context)
 		list_del_init(&context->events_list);
+
+	spin_unlock_irqrestore(&device->events_lock, flags);
+
+	_signal_event_list(device, &list, cur, type);
 }
 EXPORT_SYMBOL(kgsl_signal_events);
 
@@ -186,16 +272,21 @@ EXPORT_SYMBOL(kgsl_signal_events);
  * @func - callback function to call when the timestamp expires
  * @priv - private data for the specific event type
  * @owner - driver instance that owns this event
+ * @flags - KGSL_EVENT_* flags for the event
+ *
+ * If KGSL_EVENT_UNLOCKED is set in @flags the callback may be called from
+ * the event thread without the device mutex held.
  *
  * @returns - 0 on success or error code on failure
  */
 int kgsl_add_event(struct kgsl_device *device, u32 id, u32 ts,
-	kgsl_event_func func, void *priv, void *owner)
+	kgsl_event_func func, void *priv, void *owner, unsigned int flags)
 {
 	int ret;
 	struct kgsl_event *event;
 	unsigned int cur_ts;
 	struct kgsl_context *context = NULL;
+	unsigned long irqflags;
 
 	BUG_ON(!mutex_is_locked(&device->mutex));
 
@@ -246,11 +337,14 @@ int kgsl_add_event(struct kgsl_device *device, u32 id, u32 ts,
 	event->func = func;
 	event->owner = owner;
 	event->created = jiffies;
+	event->flags = flags;
 
 	trace_kgsl_register_event(id, ts);
 
 	/* Add the event to either the owning context or the global list */
 
+	spin_lock_irqsave(&device->events_lock, irqflags);
+
 	if (context) {
 		_add_event_to_list(&context->events, event);
 
@@ -266,7 +360,9 @@ int kgsl_add_event(struct kgsl_device *device, u32 id, u32 ts,
 	} else
 		_add_event_to_list(&device->events, event);
 
-	queue_work(device->work_queue, &device->ts_expired_ws);
+	spin_unlock_irqrestore(&device->events_lock, irqflags);
+
+	queue_kthread_work(&device->events_worker, &device->ts_expired_ws);
 	return 0;
 }
 EXPORT_SYMBOL(kgsl_add_event);
@@ -280,18 +376,24 @@ EXPORT_SYMBOL(kgsl_add_event);
 void kgsl_cancel_events(struct kgsl_device *device, void *owner)
 {
 	struct kgsl_event *event, *event_tmp;
+	unsigned long flags;
+	LIST_HEAD(list);
 	unsigned int cur;
 
 	BUG_ON(!mutex_is_locked(&device->mutex));
 
 	cur = kgsl_readtimestamp(device, NULL, KGSL_TIMESTAMP_RETIRED);
 
-	list_for_each_entry_safe(event, event_tmp, &device->events, list) {
-		if (event->owner != owner)
-			continue;
+	spin_lock_irqsave(&device->events_lock, flags);
 
-		_do_signal_event(device, event, cur, KGSL_EVENT_CANCELLED);
+	list_for_each_entry_safe(event, event_tmp, &device->events, list) {
+		if (event->owner == owner)
+			list_move_tail(&event->list, &list);
 	}
+
+	spin_unlock_irqrestore(&device->events_lock, flags);
+
+	_signal_event_list(device, &list, cur, KGSL_EVENT_CANCELLED);
 }
 EXPORT_SYMBOL(kgsl_cancel_events);
 
@@ -301,14 +403,22 @@ void kgsl_cancel_event(struct kgsl_device *device, struct kgsl_context *context,
 {
 	struct kgsl_event *event;
 	struct list_head *head = _get_list_head(device, context);
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&device->events_lock, flags);
 
 	event = _find_event(device, head, timestamp, func, priv);
+	if (event)
+		list_move_tail(&event->list, &list);
+
+	spin_unlock_irqrestore(&device->events_lock, flags);
 
 	if (event) {
 		unsigned int cur = kgsl_readtimestamp(device, context,
 			KGSL_TIMESTAMP_RETIRED);
 
-		_do_signal_event(device, event, cur, KGSL_EVENT_CANCELLED);
+		_signal_event_list(device, &list, cur, KGSL_EVENT_CANCELLED);
 	}
 }
 EXPORT_SYMBOL(kgsl_cancel_event);
@@ -333,66 +443,108 @@ static inline int _mark_next_event(struct kgsl_device *device,
 	return 0;
 }
 
-static int kgsl_process_context_events(struct kgsl_device *device,
-		struct kgsl_context *context)
+/**
+ * kgsl_schedule_events - Kick the event thread after a timestamp interrupt
+ * @device - KGSL device that raised the interrupt
+ *
+ * Safe to call from interrupt context.  The time of the first kick since
+ * the last pass of the event thread is used for the latency histogram.
+ */
+void kgsl_schedule_events(struct kgsl_device *device)
 {
-	while (1) {
-		unsigned int timestamp = kgsl_readtimestamp(device, context,
-			KGSL_TIMESTAMP_RETIRED);
+	unsigned long flags;
 
-		_retire_events(device, &context->events, timestamp);
+	spin_lock_irqsave(&device->events_lock, flags);
+	if (device->events_kick.tv64 == 0)
+		device->events_kick = ktime_get();
+	spin_unlock_irqrestore(&device->events_lock, flags);
 
-		/*
-		 * _mark_next event will return 1 as long as the next event
-		 * timestamp has expired - this is to cope with an unavoidable
-		 * race condition with the GPU that is still processing events.
-		 */
+	queue_kthread_work(&device->events_worker, &device->ts_expired_ws);
+}
+EXPORT_SYMBOL(kgsl_schedule_events);
 
-		if (!_mark_next_event(device, &context->events))
-			break;
-	}
+void kgsl_process_events(struct kthread_work *work)
+{
+	struct kgsl_device *device = container_of(work, struct kgsl_device,
+		ts_expired_ws);
+	struct kgsl_context *context;
+	unsigned long flags;
+	LIST_HEAD(retired);
+	ktime_t kick;
+	int count, again;
+
+	spin_lock_irqsave(&device->events_lock, flags);
+	kick = device->events_kick;
+	device->events_kick = ktime_set(0, 0);
+	spin_unlock_irqrestore(&device->events_lock, flags);
+
+	/* Fire everything that doesn't need the device mutex first */
+	_retire_pending_events(device, 1, &retired);
+	count = _fire_retired_events(device, &retired, kick);
+
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+
+	_retire_pending_events(device, 0, &retired);
+	count += _fire_retired_events(device, &retired, kick);
+
+	while (count--)
+		kgsl_active_count_put(device);
 
 	/*
-	 * Return 0 if the list is empty so the calling function can remove the
-	 * context from the pending list
+	 * Only the event thread and holders of the device mutex take events
+	 * off the lists so the first event on each list stays put while the
+	 * interrupts are armed.  If a timestamp passed in the meantime run
+	 * again to catch it.
 	 */
 
-	return list_empty(&context->events) ? 0 : 1;
+	again = _mark_next_event(device, &device->events);
+
+	list_for_each_entry(context, &device->events_pending_list, events_list)
+		again |= _mark_next_event(device, &context->events);
+
+	mutex_unlock(&device->mutex);
+
+	if (again)
+		queue_kthread_work(&device->events_worker,
+			&device->ts_expired_ws);
 }
+EXPORT_SYMBOL(kgsl_process_events);
 
-void kgsl_process_events(struct work_struct *work)
+/**
+ * kgsl_events_init - Start the event thread for a device
+ * @device - KGSL device to start the thread for
+ *
+ * The thread runs SCHED_FIFO so that fences and genlocks are signaled
+ * promptly even when the CPUs are busy with the rendering threads.
+ */
+int kgsl_events_init(struct kgsl_device *device)
 {
-	struct kgsl_device *device = container_of(work, struct kgsl_device,
-		ts_expired_ws);
-	struct kgsl_context *context, *tmp;
-	uint32_t timestamp;
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO / 4 };
 
-	mutex_lock(&device->mutex);
+	device->events_thread = kthread_run(kthread_worker_fn,
+		&device->events_worker, "kgsl_events_%s", device->name);
 
-	/* Process expired global events */
-	timestamp = kgsl_readtimestamp(device, NULL, KGSL_TIMESTAMP_RETIRED);
-	_retire_events(device, &device->events, timestamp);
-	_mark_next_event(device, &device->events);
+	if (IS_ERR(device->events_thread)) {
+		int ret = PTR_ERR(device->events_thread);
 
-	/* Now process all of the pending contexts */
-	list_for_each_entry_safe(context, tmp, &device->events_pending_list,
-		events_list) {
+		KGSL_DRV_ERR(device, "unable to start the event thread: %d\n",
+			ret);
+		device->events_thread = NULL;
+		return ret;
+	}
 
-		/*
-		 * Increment the refcount to make sure that the list_del_init
-		 * is called with a valid context's list
-		 */
-		_kgsl_context_get(context);
-		/*
-		 * If kgsl_timestamp_expired_context returns 0 then it no longer
-		 * has any pending events and can be removed from the list
-		 */
+	sched_setscheduler(device->events_thread, SCHED_FIFO, &param);
+	return 0;
+}
+EXPORT_SYMBOL(kgsl_events_init);
 
-		if (kgsl_process_context_events(device, context) == 0)
-			list_del_init(&context->events_list);
-		kgsl_context_put(context);
-	}
+void kgsl_events_close(struct kgsl_device *device)
+{
+	if (device->events_thread == NULL)
+		return;
 
-	mutex_unlock(&device->mutex);
+	flush_kthread_worker(&device->events_worker);
+	kthread_stop(device->events_thread);
+	device->events_thread = NULL;
 }
-EXPORT_SYMBOL(kgsl_process_events);
+EXPORT_SYMBOL(kgsl_events_close);
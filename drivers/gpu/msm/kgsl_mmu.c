@@ -578,7 +578,13 @@ void kgsl_setstate(struct kgsl_mmu *mmu, unsigned int context_id,
 
 	if (KGSL_MMU_TYPE_NONE == kgsl_mmu_type)
 		return;
-	else if (device->ftbl->setstate)
+
+	if (flags & KGSL_MMUFLAGS_PTUPDATE)
+		mmu->stats.pt_switches++;
+	if (flags & KGSL_MMUFLAGS_TLBFLUSH)
+		mmu->stats.tlb_flushes++;
+
+	if (device->ftbl->setstate)
 		device->ftbl->setstate(device, context_id, flags);
 	else if (mmu->mmu_ops->mmu_device_setstate)
 		mmu->mmu_ops->mmu_device_setstate(mmu, flags);
@@ -912,6 +918,41 @@ int kgsl_mmu_pt_get_flags(struct kgsl_pagetable *pt,
 }
 EXPORT_SYMBOL(kgsl_mmu_pt_get_flags);
 
+/**
+ * kgsl_mmu_flush_deferred - Flush the TLB for the unmaps since the last
+ * submission
+ * @mmu: Pointer to the device MMU
+ * @pagetable: Pagetable the submission is about to switch to or NULL if it
+ * stays on the current one
+ * @context_id: Context that the submission belongs to
+ *
+ * Unmaps only mark the pagetable as needing a TLB flush so all the unmaps
+ * between two submissions share a single invalidate.  If the submission is
+ * going to switch to a different pagetable then the switch invalidates the
+ * whole TLB anyway and the flush is skipped - the old pagetable keeps its
+ * pending flag until it is switched back in, which flushes again.
+ */
+void kgsl_mmu_flush_deferred(struct kgsl_mmu *mmu,
+	struct kgsl_pagetable *pagetable, unsigned int context_id)
+{
+	struct kgsl_pagetable *hwpt = mmu->hwpagetable;
+	unsigned int flags = 0;
+	int id = mmu->device->id;
+
+	if (pagetable == NULL || pagetable == hwpt ||
+		!(mmu->flags & KGSL_FLAGS_STARTED))
+		flags = kgsl_mmu_pt_get_flags(hwpt, id);
+	else if (hwpt) {
+		spin_lock(&hwpt->lock);
+		if (hwpt->tlb_flags & (1 << id))
+			mmu->stats.tlb_flushes_avoided++;
+		spin_unlock(&hwpt->lock);
+	}
+
+	kgsl_setstate(mmu, context_id, flags);
+}
+EXPORT_SYMBOL(kgsl_mmu_flush_deferred);
+
 void kgsl_mmu_ptpool_destroy(void *ptpool)
 {
 	if (KGSL_MMU_TYPE_GPU == kgsl_mmu_type)
@@ -189,6 +189,12 @@ struct kgsl_mmu {
 	const struct kgsl_mmu_ops *mmu_ops;
 	void *priv;
 	int fault;
+	struct {
+		unsigned int pt_switches;
+		unsigned int pt_switches_avoided;
+		unsigned int tlb_flushes;
+		unsigned int tlb_flushes_avoided;
+	} stats;
 };
 
 #include "kgsl_gpummu.h"
@@ -214,6 +220,8 @@ int kgsl_mmu_unmap(struct kgsl_pagetable *pagetable,
 int kgsl_mmu_put_gpuaddr(struct kgsl_pagetable *pagetable,
 		 struct kgsl_memdesc *memdesc);
 unsigned int kgsl_virtaddr_to_physaddr(void *virtaddr);
+void kgsl_mmu_flush_deferred(struct kgsl_mmu *mmu,
+	struct kgsl_pagetable *pagetable, unsigned int context_id);
 void kgsl_setstate(struct kgsl_mmu *mmu, unsigned int context_id,
 			uint32_t flags);
 int kgsl_mmu_get_ptname_from_ptbase(struct kgsl_mmu *mmu,
@@ -247,6 +255,10 @@ static inline void kgsl_mmu_setstate(struct kgsl_mmu *mmu,
 			struct kgsl_pagetable *pagetable,
 			unsigned int context_id)
 {
+	/* Consecutive submissions from the same pagetable don't switch */
+	if ((mmu->flags & KGSL_FLAGS_STARTED) && mmu->hwpagetable == pagetable)
+		mmu->stats.pt_switches_avoided++;
+
 	if (mmu->mmu_ops && mmu->mmu_ops->mmu_setstate)
 		mmu->mmu_ops->mmu_setstate(mmu, pagetable, context_id);
 }
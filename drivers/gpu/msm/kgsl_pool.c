@@ -0,0 +1,355 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/gfp.h>
+#include <linux/highmem.h>
+#include <linux/list.h>
+#include <linux/mm.h>
+#include <linux/shrinker.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <asm/cacheflush.h>
+
+#include "kgsl.h"
+#include "kgsl_pool.h"
+
+/*
+ * The page pool keeps a small reserve of pages that have already been
+ * zeroed and flushed from the caches so that GPU allocations do not have
+ * to pay for that work in the ioctl path.  Pages freed by the GPU go on a
+ * dirty list and are scrubbed by a background worker that runs when the
+ * GPU goes idle.  The pool is given back to the system through a shrinker
+ * when memory gets tight.
+ */
+
+struct kgsl_page_pool {
+	unsigned int order;
+	/* Number of clean entries to keep around after a refill */
+	unsigned int reserve;
+	/* Maximum number of entries (clean + dirty) held by the pool */
+	unsigned int max;
+	spinlock_t lock;
+	struct list_head clean;
+	struct list_head dirty;
+	unsigned int clean_count;
+	unsigned int dirty_count;
+	unsigned int hits;
+	unsigned int misses;
+};
+
+static struct kgsl_page_pool kgsl_pools[] = {
+	{ .order = KGSL_POOL_ORDER_SMALL, .reserve = 256, .max = 1024 },
+	{ .order = KGSL_POOL_ORDER_LARGE, .reserve = 16, .max = 64 },
+};
+
+static void kgsl_pool_refill_work(struct work_struct *work);
+static DECLARE_WORK(kgsl_pool_refill_ws, kgsl_pool_refill_work);
+
+static struct kgsl_page_pool *_kgsl_get_pool(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		if (kgsl_pools[i].order == order)
+			return &kgsl_pools[i];
+	}
+
+	return NULL;
+}
+
+static gfp_t _kgsl_pool_gfp(unsigned int order)
+{
+	gfp_t gfp_mask = __GFP_HIGHMEM | __GFP_NORETRY | __GFP_NOWARN;
+
+	/* Match the flags used for 64K chunks in kgsl_sharedmem */
+	if (order)
+		gfp_mask |= __GFP_COMP | __GFP_NO_KSWAPD;
+
+	return gfp_mask | GFP_KERNEL;
+}
+
+/*
+ * _kgsl_pool_scrub - Zero a block of pages and push it out of the caches
+ * @page: First page of the block
+ * @order: Order of the block
+ *
+ * After this the block can be handed to the GPU (and to user space)
+ * without any further cache maintenance.
+ */
+static void _kgsl_pool_scrub(struct page *page, unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < (1 << order); i++) {
+		void *ptr = kmap_atomic(nth_page(page, i));
+
+		memset(ptr, 0, PAGE_SIZE);
+		dmac_flush_range(ptr, ptr + PAGE_SIZE);
+		kunmap_atomic(ptr);
+	}
+
+	outer_flush_range(page_to_phys(page),
+		page_to_phys(page) + (PAGE_SIZE << order));
+}
+
+static struct page *_kgsl_pool_pop(struct kgsl_page_pool *pool,
+	struct list_head *list, unsigned int *count)
+{
+	struct page *page;
+
+	if (list_empty(list))
+		return NULL;
+
+	page = list_first_entry(list, struct page, lru);
+	list_del(&page->lru);
+	(*count)--;
+
+	return page;
+}
+
+/**
+ * kgsl_pool_alloc_page - Get a clean block of pages from the pool
+ * @order: Order of the block to get
+ *
+ * Return a block of pages that is already zeroed and flushed from the
+ * caches or NULL if the pool is empty (or doesn't cache the order).  The
+ * caller is expected to fall back to the page allocator and do the
+ * scrubbing itself.
+ */
+struct page *kgsl_pool_alloc_page(unsigned int order)
+{
+	struct kgsl_page_pool *pool = _kgsl_get_pool(order);
+	struct page *page;
+
+	if (pool == NULL)
+		return NULL;
+
+	spin_lock(&pool->lock);
+	page = _kgsl_pool_pop(pool, &pool->clean, &pool->clean_count);
+	if (page)
+		pool->hits++;
+	else
+		pool->misses++;
+	spin_unlock(&pool->lock);
+
+	return page;
+}
+
+/**
+ * kgsl_pool_free_page - Return a block of pages to the pool
+ * @page: First page of the block
+ * @order: Order of the block
+ *
+ * The block is put on the dirty list to be scrubbed by the refill worker.
+ * If the pool is full (or doesn't cache this order) the pages go straight
+ * back to the system.
+ */
+void kgsl_pool_free_page(struct page *page, unsigned int order)
+{
+	struct kgsl_page_pool *pool = _kgsl_get_pool(order);
+
+	if (pool) {
+		spin_lock(&pool->lock);
+		if (pool->clean_count + pool->dirty_count < pool->max) {
+			list_add_tail(&page->lru, &pool->dirty);
+			pool->dirty_count++;
+			page = NULL;
+		}
+		spin_unlock(&pool->lock);
+	}
+
+	if (page)
+		__free_pages(page, order);
+}
+
+static void _kgsl_pool_refill(struct kgsl_page_pool *pool)
+{
+	struct page *page;
+
+	/* First recycle everything that has been returned to the pool */
+	for (;;) {
+		spin_lock(&pool->lock);
+		page = _kgsl_pool_pop(pool, &pool->dirty, &pool->dirty_count);
+		spin_unlock(&pool->lock);
+
+		if (page == NULL)
+			break;
+
+		_kgsl_pool_scrub(page, pool->order);
+
+		spin_lock(&pool->lock);
+		list_add_tail(&page->lru, &pool->clean);
+		pool->clean_count++;
+		spin_unlock(&pool->lock);
+
+		cond_resched();
+	}
+
+	/* Then top up the reserve from the system */
+	for (;;) {
+		spin_lock(&pool->lock);
+		if (pool->clean_count >= pool->reserve) {
+			spin_unlock(&pool->lock);
+			break;
+		}
+		spin_unlock(&pool->lock);
+
+		page = alloc_pages(_kgsl_pool_gfp(pool->order), pool->order);
+		if (page == NULL)
+			break;
+
+		_kgsl_pool_scrub(page, pool->order);
+
+		spin_lock(&pool->lock);
+		list_add_tail(&page->lru, &pool->clean);
+		pool->clean_count++;
+		spin_unlock(&pool->lock);
+
+		cond_resched();
+	}
+}
+
+static void kgsl_pool_refill_work(struct work_struct *work)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		_kgsl_pool_refill(&kgsl_pools[i]);
+}
+
+/**
+ * kgsl_pool_refill - Schedule a background refill of the page pool
+ *
+ * Called when a GPU goes idle.  The worker scrubs any returned pages and
+ * tops up the clean reserve outside of the allocation path.
+ */
+void kgsl_pool_refill(void)
+{
+	queue_work(system_unbound_wq, &kgsl_pool_refill_ws);
+}
+
+static unsigned int _kgsl_pool_size(void)
+{
+	unsigned int count = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+
+		count += (pool->clean_count + pool->dirty_count) << pool->order;
+	}
+
+	return count;
+}
+
+/* Give back up to nr_pages pages from a pool, dirty pages first */
+static int _kgsl_pool_shrink(struct kgsl_page_pool *pool, int nr_pages)
+{
+	int freed = 0;
+
+	while (freed < nr_pages) {
+		struct page *page;
+
+		spin_lock(&pool->lock);
+		page = _kgsl_pool_pop(pool, &pool->dirty, &pool->dirty_count);
+		if (page == NULL)
+			page = _kgsl_pool_pop(pool, &pool->clean,
+				&pool->clean_count);
+		spin_unlock(&pool->lock);
+
+		if (page == NULL)
+			break;
+
+		__free_pages(page, pool->order);
+		freed += 1 << pool->order;
+	}
+
+	return freed;
+}
+
+static int kgsl_pool_shrink(struct shrinker *shrinker,
+	struct shrink_control *sc)
+{
+	int nr = sc->nr_to_scan;
+	int i;
+
+	if (nr == 0)
+		return _kgsl_pool_size();
+
+	/* Release the large chunks last, they are the hardest to get back */
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools) && nr > 0; i++)
+		nr -= _kgsl_pool_shrink(&kgsl_pools[i], nr);
+
+	return _kgsl_pool_size();
+}
+
+static struct shrinker kgsl_pool_shrinker = {
+	.shrink = kgsl_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+/**
+ * kgsl_pool_stats_show - Print the pool statistics
+ * @buf: Buffer to print into
+ * @size: Size of the buffer
+ *
+ * Print one line per pool order with the clean and dirty page counts
+ * and the hit/miss counts for the allocation path.
+ */
+ssize_t kgsl_pool_stats_show(char *buf, size_t size)
+{
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+
+		spin_lock(&pool->lock);
+		len += snprintf(buf + len, size - len,
+			"order %u: clean %u dirty %u hits %u misses %u\n",
+			pool->order, pool->clean_count, pool->dirty_count,
+			pool->hits, pool->misses);
+		spin_unlock(&pool->lock);
+	}
+
+	return len;
+}
+
+int kgsl_pool_init(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+
+		spin_lock_init(&pool->lock);
+		INIT_LIST_HEAD(&pool->clean);
+		INIT_LIST_HEAD(&pool->dirty);
+	}
+
+	register_shrinker(&kgsl_pool_shrinker);
+	kgsl_pool_refill();
+
+	return 0;
+}
+
+void kgsl_pool_exit(void)
+{
+	int i;
+
+	unregister_shrinker(&kgsl_pool_shrinker);
+	cancel_work_sync(&kgsl_pool_refill_ws);
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		_kgsl_pool_shrink(&kgsl_pools[i], INT_MAX);
+}
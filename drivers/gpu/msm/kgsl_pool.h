@@ -0,0 +1,30 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef __KGSL_POOL_H
+#define __KGSL_POOL_H
+
+#include <linux/mm_types.h>
+
+/* Orders kept in the page pool - a single page and a 64K chunk */
+#define KGSL_POOL_ORDER_SMALL	0
+#define KGSL_POOL_ORDER_LARGE	4
+
+struct page *kgsl_pool_alloc_page(unsigned int order);
+void kgsl_pool_free_page(struct page *page, unsigned int order);
+void kgsl_pool_refill(void);
+ssize_t kgsl_pool_stats_show(char *buf, size_t size);
+
+int kgsl_pool_init(void);
+void kgsl_pool_exit(void);
+
+#endif /* __KGSL_POOL_H */
@@ -18,12 +18,17 @@
 #include <mach/msm_iomap.h>
 #include <mach/msm_bus.h>
 #include <linux/ktime.h>
+#include <linux/msm_thermal.h>
+#include <linux/htc_pnpmgr.h>
+#include <linux/input/input_boost.h>
+#include <linux/perf_telemetry.h>
 
 #include "kgsl.h"
 #include "kgsl_pwrscale.h"
 #include "kgsl_device.h"
 #include "kgsl_trace.h"
 #include "kgsl_sharedmem.h"
+#include "kgsl_pool.h"
 
 #define KGSL_PWRFLAGS_POWER_ON 0
 #define KGSL_PWRFLAGS_CLK_ON   1
@@ -169,6 +174,8 @@ void kgsl_pwrctrl_pwrlevel_change(struct kgsl_device *device,
 	}
 
 	trace_kgsl_pwrlevel(device, pwr->active_pwrlevel, pwrlevel->gpu_freq);
+	perf_tm_log(PERF_TM_GPU_LEVEL, pwr->active_pwrlevel,
+		pwrlevel->gpu_freq, 0);
 }
 
 EXPORT_SYMBOL(kgsl_pwrctrl_pwrlevel_change);
@@ -192,7 +199,7 @@ static int kgsl_pwrctrl_thermal_pwrlevel_store(struct device *dev,
 	if (ret)
 		return ret;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	if (level > pwr->num_pwrlevels - 2)
 		level = pwr->num_pwrlevels - 2;
@@ -247,7 +254,7 @@ static int kgsl_pwrctrl_max_pwrlevel_store(struct device *dev,
 	if (ret)
 		return ret;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	/* You can't set a maximum power level lower than the minimum */
 	if (level > pwr->min_pwrlevel)
@@ -302,7 +309,7 @@ static int kgsl_pwrctrl_min_pwrlevel_store(struct device *dev,
 	if (ret)
 		return ret;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	if (level > pwr->num_pwrlevels - 2)
 		level = pwr->num_pwrlevels - 2;
 
@@ -365,6 +372,89 @@ static int _get_nearest_pwrlevel(struct kgsl_pwrctrl *pwr, unsigned int clock)
 	return -ERANGE;
 }
 
+/*
+ * msm_thermal hands out a mitigation level, each level is one pwrlevel
+ * below turbo.  Same as a write to thermal_pwrlevel.
+ */
+static int kgsl_pwrctrl_thermal_notify(struct notifier_block *nb,
+				       unsigned long level, void *data)
+{
+	struct kgsl_pwrctrl *pwr = container_of(nb, struct kgsl_pwrctrl,
+						thermal_nb);
+	struct kgsl_device *device = container_of(pwr, struct kgsl_device,
+						  pwrctrl);
+
+	if (pwr->num_pwrlevels < 2)
+		return NOTIFY_DONE;
+
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+
+	if (level > pwr->num_pwrlevels - 2)
+		level = pwr->num_pwrlevels - 2;
+
+	pwr->thermal_pwrlevel = level;
+
+	if (pwr->thermal_pwrlevel > pwr->active_pwrlevel)
+		kgsl_pwrctrl_pwrlevel_change(device, pwr->thermal_pwrlevel);
+
+	mutex_unlock(&device->mutex);
+
+	return NOTIFY_OK;
+}
+
+/*
+ * The pnpmgr profile caps the GPU at a pwrlevel, 0 for none.  Same as a
+ * write to max_pwrlevel.
+ */
+static int kgsl_pwrctrl_pnp_notify(struct notifier_block *nb,
+				   unsigned long level, void *data)
+{
+	struct kgsl_pwrctrl *pwr = container_of(nb, struct kgsl_pwrctrl,
+						pnp_nb);
+	struct kgsl_device *device = container_of(pwr, struct kgsl_device,
+						  pwrctrl);
+	int max_level;
+
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+
+	if (level > pwr->min_pwrlevel)
+		level = pwr->min_pwrlevel;
+
+	pwr->max_pwrlevel = level;
+
+	max_level = max_t(int, pwr->thermal_pwrlevel, pwr->max_pwrlevel);
+	if (device->pwrscale.policy == NULL ||
+		(max_level > pwr->active_pwrlevel))
+		kgsl_pwrctrl_pwrlevel_change(device, max_level);
+
+	mutex_unlock(&device->mutex);
+
+	return NOTIFY_OK;
+}
+
+/*
+ * A first touch jumps to the highest allowed pwrlevel, the pwrscale
+ * policy brings it back down once the GPU turns out to be idle.
+ */
+static int kgsl_pwrctrl_boost_notify(struct notifier_block *nb,
+				     unsigned long ms, void *data)
+{
+	struct kgsl_pwrctrl *pwr = container_of(nb, struct kgsl_pwrctrl,
+						boost_nb);
+	struct kgsl_device *device = container_of(pwr, struct kgsl_device,
+						  pwrctrl);
+
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+
+	if (device->pwrscale.policy != NULL &&
+		pwr->active_pwrlevel > pwr->max_pwrlevel)
+		kgsl_pwrctrl_pwrlevel_change(device, pwr->max_pwrlevel);
+
+	mutex_unlock(&device->mutex);
+
+	return NOTIFY_OK;
+}
+
 static int kgsl_pwrctrl_max_gpuclk_store(struct device *dev,
 					 struct device_attribute *attr,
 					 const char *buf, size_t count)
@@ -383,7 +473,7 @@ static int kgsl_pwrctrl_max_gpuclk_store(struct device *dev,
 	if (ret)
 		return ret;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	level = _get_nearest_pwrlevel(pwr, val);
 	if (level < 0)
 		goto done;
@@ -435,7 +525,7 @@ static int kgsl_pwrctrl_gpuclk_store(struct device *dev,
 	if (ret)
 		return ret;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	level = _get_nearest_pwrlevel(pwr, val);
 	if (level >= 0)
 		kgsl_pwrctrl_pwrlevel_change(device, level);
@@ -474,7 +564,7 @@ static int kgsl_pwrctrl_pwrnap_store(struct device *dev,
 	if (ret)
 		return ret;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	if (val == 1)
 		pwr->nap_allowed = true;
@@ -519,7 +609,7 @@ static int kgsl_pwrctrl_idle_timer_store(struct device *dev,
 	if (org_interval_timeout == 1)
 		org_interval_timeout = pwr->interval_timeout;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	/* Let the timeout be requested in ms, but convert to jiffies. */
 	val /= div;
@@ -693,6 +783,7 @@ static void update_statistics(struct kgsl_device *device)
 	clkstats->on_time_old = on_time;
 	clkstats->elapsed_old = clkstats->elapsed;
 	clkstats->elapsed = 0;
+	perf_tm_log(PERF_TM_GPU_BUSY, on_time, clkstats->elapsed_old, 0);
 }
 
 /* Track the amount of time the gpu is on vs the total system time. *
@@ -960,6 +1051,13 @@ int kgsl_pwrctrl_init(struct kgsl_device *device)
 
 	pm_runtime_enable(device->parentdev);
 	register_early_suspend(&device->display_off);
+
+	pwr->thermal_nb.notifier_call = kgsl_pwrctrl_thermal_notify;
+	msm_thermal_register_gpu_notifier(&pwr->thermal_nb);
+	pwr->pnp_nb.notifier_call = kgsl_pwrctrl_pnp_notify;
+	pnpmgr_register_gpu_notifier(&pwr->pnp_nb);
+	pwr->boost_nb.notifier_call = kgsl_pwrctrl_boost_notify;
+	input_boost_register_gpu_notifier(&pwr->boost_nb);
 	return result;
 
 clk_err:
@@ -978,6 +1076,10 @@ void kgsl_pwrctrl_close(struct kgsl_device *device)
 
 	KGSL_PWR_INFO(device, "close device %d\n", device->id);
 
+	msm_thermal_unregister_gpu_notifier(&pwr->thermal_nb);
+	pnpmgr_unregister_gpu_notifier(&pwr->pnp_nb);
+	input_boost_unregister_gpu_notifier(&pwr->boost_nb);
+
 	pm_runtime_disable(device->parentdev);
 	unregister_early_suspend(&device->display_off);
 
@@ -1024,7 +1126,7 @@ void kgsl_idle_check(struct work_struct *work)
 	if (device == NULL)
 		return;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	kgsl_pwrscale_idle(device);
 
@@ -1149,6 +1251,8 @@ _sleep(struct kgsl_device *device)
 		kgsl_pwrctrl_set_state(device, KGSL_STATE_SLEEP);
 		pm_qos_update_request(&device->pm_qos_req_dma,
 					PM_QOS_DEFAULT_VALUE);
+		/* Use the idle time to restock the GPU page pool */
+		kgsl_pool_refill();
 		break;
 	case KGSL_STATE_SLEEP:
 	case KGSL_STATE_SLUMBER:
@@ -1187,6 +1291,7 @@ _slumber(struct kgsl_device *device)
 		kgsl_pwrctrl_set_state(device, KGSL_STATE_SLUMBER);
 		pm_qos_update_request(&device->pm_qos_req_dma,
 						PM_QOS_DEFAULT_VALUE);
+		kgsl_pool_refill();
 		break;
 	case KGSL_STATE_SLUMBER:
 		break;
@@ -1379,7 +1484,7 @@ int kgsl_active_count_get(struct kgsl_device *device)
 			mutex_unlock(&device->mutex);
 			wait_for_completion(&device->hwaccess_gate);
 			wait_for_completion(&device->ft_gate);
-			mutex_lock(&device->mutex);
+			lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 		}
 
 		ret = kgsl_pwrctrl_wake(device);
@@ -1470,7 +1575,7 @@ void kgsl_active_count_wait(struct kgsl_device *device)
 	if (device->active_cnt != 0) {
 		mutex_unlock(&device->mutex);
 		wait_for_completion(&device->suspend_gate);
-		mutex_lock(&device->mutex);
+		lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	}
 }
 EXPORT_SYMBOL(kgsl_active_count_wait);
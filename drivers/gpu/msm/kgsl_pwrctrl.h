@@ -13,6 +13,8 @@
 #ifndef __KGSL_PWRCTRL_H
 #define __KGSL_PWRCTRL_H
 
+#include <linux/notifier.h>
+
 /*****************************************************************************
 ** power flags
 *****************************************************************************/
@@ -60,6 +62,9 @@ struct kgsl_clk_stats {
  * @irq_name - resource name for the IRQ
  * @restore_slumber - Flag to indicate that we are in a suspend/restore sequence
  * @clk_stats - structure of clock statistics
+ * @thermal_nb - notifier for the msm_thermal mitigation level
+ * @pnp_nb - notifier for the pnpmgr profile GPU cap
+ * @boost_nb - notifier for the touch input boost
  */
 
 struct kgsl_pwrctrl {
@@ -85,6 +90,9 @@ struct kgsl_pwrctrl {
 	s64 time;
 	unsigned int restore_slumber;
 	struct kgsl_clk_stats clk_stats;
+	struct notifier_block thermal_nb;
+	struct notifier_block pnp_nb;
+	struct notifier_block boost_nb;
 };
 
 void kgsl_pwrctrl_irq(struct kgsl_device *device, int state);
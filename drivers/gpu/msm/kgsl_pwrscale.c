@@ -50,6 +50,9 @@ static struct kgsl_pwrscale_policy *kgsl_pwrscale_policies[] = {
 #endif
 #ifdef CONFIG_MSM_DCVS
 	&kgsl_pwrscale_policy_msm,
+#endif
+#ifdef CONFIG_MSM_KGSL_FRAME_POLICY
+	&kgsl_pwrscale_policy_frame,
 #endif
 	NULL
 };
@@ -312,7 +315,7 @@ static void _kgsl_pwrscale_detach_policy(struct kgsl_device *device)
 
 void kgsl_pwrscale_detach_policy(struct kgsl_device *device)
 {
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	_kgsl_pwrscale_detach_policy(device);
 	mutex_unlock(&device->mutex);
 }
@@ -323,7 +326,7 @@ int kgsl_pwrscale_attach_policy(struct kgsl_device *device,
 {
 	int ret = 0;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	if (device->pwrscale.policy == policy)
 		goto done;
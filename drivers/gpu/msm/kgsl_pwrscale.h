@@ -55,6 +55,7 @@ struct kgsl_pwrscale_policy_attribute {
 extern struct kgsl_pwrscale_policy kgsl_pwrscale_policy_tz;
 extern struct kgsl_pwrscale_policy kgsl_pwrscale_policy_idlestats;
 extern struct kgsl_pwrscale_policy kgsl_pwrscale_policy_msm;
+extern struct kgsl_pwrscale_policy kgsl_pwrscale_policy_frame;
 
 int kgsl_pwrscale_init(struct kgsl_device *device);
 void kgsl_pwrscale_close(struct kgsl_device *device);
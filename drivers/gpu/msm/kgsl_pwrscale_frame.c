@@ -0,0 +1,324 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/export.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/notifier.h>
+#include <linux/ktime.h>
+#include <linux/msm_mdp.h>
+#include <asm/div64.h>
+
+#include "kgsl.h"
+#include "kgsl_pwrscale.h"
+#include "kgsl_device.h"
+
+/*
+ * The frame policy sizes the GPU clock to the display refresh.  Once per
+ * vsync it works out how much of the last frame period the GPU was busy
+ * for, scales that to each of the available power levels and picks the
+ * slowest level that would still have finished the work within the target
+ * share of the frame budget.  Going up happens on the next vsync, going
+ * down only after a few frames in a row agree.  When no timestamps retire
+ * for a few frames the animation is considered to be over and the clock
+ * drops to the lowest level; the first submission after that goes straight
+ * back to the level that was last used while frames were being drawn.
+ */
+
+/* Used until the panel has reported a few vsyncs - 60Hz */
+#define FRAME_DEFAULT_PERIOD_US	16667
+/* Vsync intervals outside of this range are treated as gaps */
+#define FRAME_PERIOD_MIN_US	8000
+#define FRAME_PERIOD_MAX_US	50000
+/* Share of the frame period that the GPU is allowed to be busy */
+#define FRAME_DEFAULT_TARGET	85
+/* Frames in a row that must ask for a lower level before going down */
+#define FRAME_DOWN_FRAMES	3
+/* Frames without a retired timestamp before the GPU is considered idle */
+#define FRAME_IDLE_FRAMES	4
+
+struct frame_priv {
+	struct kgsl_device *device;
+	struct notifier_block vsync_nb;
+	/* Protects the vsync state that is updated from interrupt context */
+	spinlock_t lock;
+	unsigned int vsync_count;
+	s64 last_vsync_us;
+	unsigned int period_us;
+
+	unsigned int last_vsync_count;
+	struct kgsl_power_stats bin;
+	unsigned int last_retired;
+	unsigned int idle_frames;
+	unsigned int down_frames;
+	unsigned int active_level;
+	unsigned int target;
+};
+
+static int frame_vsync_notify(struct notifier_block *nb, unsigned long val,
+	void *data)
+{
+	struct frame_priv *priv = container_of(nb, struct frame_priv, vsync_nb);
+	s64 now = ktime_to_us(*(ktime_t *) data);
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->lock, flags);
+
+	if (priv->last_vsync_us) {
+		s64 delta = now - priv->last_vsync_us;
+
+		if (delta > FRAME_PERIOD_MIN_US && delta < FRAME_PERIOD_MAX_US)
+			priv->period_us = (priv->period_us * 7 +
+				(unsigned int) delta) >> 3;
+	}
+
+	priv->last_vsync_us = now;
+	priv->vsync_count++;
+
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	return NOTIFY_OK;
+}
+
+/*
+ * Return the slowest power level that could have executed busy_us worth of
+ * work at the current level in budget_us
+ */
+static unsigned int frame_select_level(struct kgsl_pwrctrl *pwr,
+	unsigned int busy_us, unsigned int budget_us)
+{
+	unsigned int cur = pwr->pwrlevels[pwr->active_pwrlevel].gpu_freq;
+	int fastest = max_t(int, pwr->thermal_pwrlevel, pwr->max_pwrlevel);
+	int level = max_t(int, pwr->thermal_pwrlevel, pwr->min_pwrlevel);
+
+	/* Levels are ordered from the fastest (0) to the slowest */
+	for (; level > fastest; level--) {
+		u64 need = (u64) busy_us * cur;
+
+		if (pwr->pwrlevels[level].gpu_freq == 0)
+			continue;
+
+		do_div(need, pwr->pwrlevels[level].gpu_freq);
+		if (need <= budget_us)
+			break;
+	}
+
+	return level;
+}
+
+static void frame_idle(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale)
+{
+	struct frame_priv *priv = pwrscale->priv;
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	struct kgsl_power_stats stats;
+	unsigned int vsyncs, period, retired, level;
+	unsigned long flags;
+	u64 busy;
+
+	device->ftbl->power_stats(device, &stats);
+	priv->bin.total_time += stats.total_time;
+	priv->bin.busy_time += stats.busy_time;
+
+	spin_lock_irqsave(&priv->lock, flags);
+	vsyncs = priv->vsync_count;
+	period = priv->period_us;
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	/*
+	 * Make a decision once per vsync or, if the panel isn't sending
+	 * vsyncs (command mode or the display is off), once per period
+	 */
+	if (vsyncs == priv->last_vsync_count && priv->bin.total_time < period)
+		return;
+
+	priv->last_vsync_count = vsyncs;
+
+	if (priv->bin.total_time <= 0)
+		goto reset;
+
+	retired = kgsl_readtimestamp(device, NULL, KGSL_TIMESTAMP_RETIRED);
+
+	if (retired == priv->last_retired) {
+		if (++priv->idle_frames >= FRAME_IDLE_FRAMES) {
+			kgsl_pwrctrl_pwrlevel_change(device, pwr->min_pwrlevel);
+			priv->down_frames = 0;
+		}
+		goto reset;
+	}
+
+	priv->last_retired = retired;
+	priv->idle_frames = 0;
+
+	/* Scale the busy time in the window to a single frame period */
+	busy = (u64) priv->bin.busy_time * period;
+	do_div(busy, (u32) min_t(s64, priv->bin.total_time, UINT_MAX));
+
+	level = frame_select_level(pwr, (unsigned int) busy,
+		period * priv->target / 100);
+
+	if (level < pwr->active_pwrlevel) {
+		priv->down_frames = 0;
+		kgsl_pwrctrl_pwrlevel_change(device, level);
+	} else if (level > pwr->active_pwrlevel) {
+		if (++priv->down_frames >= FRAME_DOWN_FRAMES) {
+			priv->down_frames = 0;
+			kgsl_pwrctrl_pwrlevel_change(device,
+				pwr->active_pwrlevel + 1);
+		}
+	} else
+		priv->down_frames = 0;
+
+	priv->active_level = pwr->active_pwrlevel;
+
+reset:
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+}
+
+static void frame_busy(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale)
+{
+	struct frame_priv *priv = pwrscale->priv;
+
+	/* Start of a new animation - don't wait a frame to ramp up */
+	if (priv->idle_frames >= FRAME_IDLE_FRAMES) {
+		priv->idle_frames = 0;
+		kgsl_pwrctrl_pwrlevel_change(device, priv->active_level);
+	}
+}
+
+static void frame_sleep(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale)
+{
+	struct frame_priv *priv = pwrscale->priv;
+
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+	priv->down_frames = 0;
+}
+
+static void frame_wake(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale)
+{
+	struct frame_priv *priv = pwrscale->priv;
+
+	if (device->state != KGSL_STATE_NAP)
+		kgsl_pwrctrl_pwrlevel_change(device, priv->active_level);
+}
+
+static ssize_t frame_target_show(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale, char *buf)
+{
+	struct frame_priv *priv = pwrscale->priv;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->target);
+}
+
+static ssize_t frame_target_store(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale, const char *buf, size_t count)
+{
+	struct frame_priv *priv = pwrscale->priv;
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	if (val == 0 || val > 100)
+		return -EINVAL;
+
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+	priv->target = val;
+	mutex_unlock(&device->mutex);
+
+	return count;
+}
+
+static ssize_t frame_period_show(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale, char *buf)
+{
+	struct frame_priv *priv = pwrscale->priv;
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", priv->period_us);
+}
+
+PWRSCALE_POLICY_ATTR(target, 0644, frame_target_show, frame_target_store);
+PWRSCALE_POLICY_ATTR(period_us, 0444, frame_period_show, NULL);
+
+static struct attribute *frame_attrs[] = {
+	&policy_attr_target.attr,
+	&policy_attr_period_us.attr,
+	NULL
+};
+
+static struct attribute_group frame_attr_group = {
+	.attrs = frame_attrs,
+};
+
+static int frame_init(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale)
+{
+	struct frame_priv *priv;
+	int ret;
+
+	priv = pwrscale->priv = kzalloc(sizeof(struct frame_priv), GFP_KERNEL);
+	if (pwrscale->priv == NULL)
+		return -ENOMEM;
+
+	priv->device = device;
+	priv->period_us = FRAME_DEFAULT_PERIOD_US;
+	priv->target = FRAME_DEFAULT_TARGET;
+	priv->active_level = device->pwrctrl.default_pwrlevel;
+	spin_lock_init(&priv->lock);
+
+	priv->vsync_nb.notifier_call = frame_vsync_notify;
+	ret = msm_fb_register_vsync_notifier(&priv->vsync_nb);
+	if (ret) {
+		kfree(pwrscale->priv);
+		pwrscale->priv = NULL;
+		return ret;
+	}
+
+	kgsl_pwrscale_policy_add_files(device, pwrscale, &frame_attr_group);
+
+	return 0;
+}
+
+static void frame_close(struct kgsl_device *device,
+	struct kgsl_pwrscale *pwrscale)
+{
+	struct frame_priv *priv = pwrscale->priv;
+
+	if (priv == NULL)
+		return;
+
+	msm_fb_unregister_vsync_notifier(&priv->vsync_nb);
+	kgsl_pwrscale_policy_remove_files(device, pwrscale, &frame_attr_group);
+
+	kfree(pwrscale->priv);
+	pwrscale->priv = NULL;
+}
+
+struct kgsl_pwrscale_policy kgsl_pwrscale_policy_frame = {
+	.name = "frame",
+	.init = frame_init,
+	.idle = frame_idle,
+	.busy = frame_busy,
+	.sleep = frame_sleep,
+	.wake = frame_wake,
+	.close = frame_close
+};
+EXPORT_SYMBOL(kgsl_pwrscale_policy_frame);
@@ -69,7 +69,7 @@ static void idlestats_get_sample(struct msm_idle_stats_device *idledev,
 	struct kgsl_device *device = priv->device;
 	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	/* If the GPU is asleep, don't wake it up - assume that we
 	   are idle */
 
@@ -70,7 +70,7 @@ static int msm_set_freq(int core_num, unsigned int freq)
 	if (i == pwr->num_pwrlevels)
 		return 0;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	priv->req_level = i;
 	if (priv->req_level <= priv->floor_level) {
 		kgsl_pwrctrl_pwrlevel_change(device, priv->req_level);
@@ -97,7 +97,7 @@ static int msm_set_min_freq(int core_num, unsigned int freq)
 	if (i == pwr->num_pwrlevels)
 		return 0;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 	priv->floor_level = i;
 	if (priv->floor_level <= priv->req_level)
 		kgsl_pwrctrl_pwrlevel_change(device, priv->floor_level);
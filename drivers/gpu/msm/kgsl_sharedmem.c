@@ -18,11 +18,13 @@
 #include <linux/slab.h>
 #include <linux/kmemleak.h>
 #include <linux/highmem.h>
+#include <linux/smp.h>
 
 #include "kgsl.h"
 #include "kgsl_sharedmem.h"
 #include "kgsl_cffdump.h"
 #include "kgsl_device.h"
+#include "kgsl_pool.h"
 
 /* An attribute for showing per-process memory statistics */
 struct kgsl_mem_entry_attribute {
@@ -158,6 +160,40 @@ static struct mem_entry_stats mem_stats[] = {
 #endif
 };
 
+/**
+ * Show how much of the memory mapped for the process uses large pages
+ */
+
+static ssize_t
+mapped_64k_show(struct kgsl_process_private *priv, int type, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", priv->mapped_64k);
+}
+
+static ssize_t
+mapped_1m_show(struct kgsl_process_private *priv, int type, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", priv->mapped_1m);
+}
+
+static struct kgsl_mem_entry_attribute large_page_stats[] = {
+	__MEM_ENTRY_ATTR(0, mapped_64k, mapped_64k_show),
+	__MEM_ENTRY_ATTR(0, mapped_1m, mapped_1m_show),
+};
+
+/**
+ * Show how much of the kernel memory of the process was purged
+ */
+
+static ssize_t
+purged_show(struct kgsl_process_private *priv, int type, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", priv->purged);
+}
+
+static struct kgsl_mem_entry_attribute purged_attr =
+	__MEM_ENTRY_ATTR(0, purged, purged_show);
+
 void
 kgsl_process_uninit_sysfs(struct kgsl_process_private *private)
 {
@@ -169,6 +205,10 @@ kgsl_process_uninit_sysfs(struct kgsl_process_private *private)
 			&mem_stats[i].max_attr.attr);
 	}
 
+	for (i = 0; i < ARRAY_SIZE(large_page_stats); i++)
+		sysfs_remove_file(&private->kobj, &large_page_stats[i].attr);
+	sysfs_remove_file(&private->kobj, &purged_attr.attr);
+
 	kobject_put(&private->kobj);
 }
 
@@ -193,6 +233,47 @@ kgsl_process_init_sysfs(struct kgsl_process_private *private)
 		ret = sysfs_create_file(&private->kobj,
 			&mem_stats[i].max_attr.attr);
 	}
+
+	for (i = 0; i < ARRAY_SIZE(large_page_stats); i++)
+		ret = sysfs_create_file(&private->kobj,
+			&large_page_stats[i].attr);
+	ret = sysfs_create_file(&private->kobj, &purged_attr.attr);
+}
+
+/**
+ * kgsl_memdesc_large_page_size - Get the large page coverage of a mapping
+ * @memdesc: Memory descriptor to check
+ * @size_64k: Returns the number of bytes that can be mapped with 64K pages
+ * @size_1m: Returns the number of bytes that can be mapped with 1M sections
+ *
+ * The IOMMU uses the largest page that both the GPU and the physical
+ * address of a chunk are aligned to, so go through the scatterlist and see
+ * which chunks qualify.  Always zero for the GPU MMU.
+ */
+void kgsl_memdesc_large_page_size(const struct kgsl_memdesc *memdesc,
+	unsigned int *size_64k, unsigned int *size_1m)
+{
+	struct scatterlist *s;
+	unsigned int gpuaddr = memdesc->gpuaddr;
+	int i;
+
+	*size_64k = 0;
+	*size_1m = 0;
+
+	if (kgsl_mmu_get_mmutype() != KGSL_MMU_TYPE_IOMMU ||
+		memdesc->sg == NULL)
+		return;
+
+	for_each_sg(memdesc->sg, s, memdesc->sglen, i) {
+		unsigned int addr = gpuaddr | sg_phys(s);
+
+		if (s->length >= SZ_1M && IS_ALIGNED(addr, SZ_1M))
+			*size_1m += s->length & ~(SZ_1M - 1);
+		else if (s->length >= SZ_64K && IS_ALIGNED(addr, SZ_64K))
+			*size_64k += s->length & ~(SZ_64K - 1);
+
+		gpuaddr += s->length;
+	}
 }
 
 static int kgsl_drv_memstat_show(struct device *dev,
@@ -217,6 +298,10 @@ static int kgsl_drv_memstat_show(struct device *dev,
 		val = kgsl_driver.stats.mapped;
 	else if (!strncmp(attr->attr.name, "mapped_max", 10))
 		val = kgsl_driver.stats.mapped_max;
+	else if (!strncmp(attr->attr.name, "purgeable", 9))
+		val = kgsl_driver.stats.purgeable;
+	else if (!strncmp(attr->attr.name, "purged", 6))
+		val = kgsl_driver.stats.purged;
 
 	return snprintf(buf, PAGE_SIZE, "%u\n", val);
 }
@@ -236,6 +321,37 @@ static int kgsl_drv_histogram_show(struct device *dev,
 	return len;
 }
 
+static int kgsl_drv_full_cache_threshold_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+		kgsl_driver.full_cache_threshold);
+}
+
+static int kgsl_drv_full_cache_threshold_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	kgsl_driver.full_cache_threshold = val;
+
+	return count;
+}
+
+static int kgsl_drv_page_pool_show(struct device *dev,
+				   struct device_attribute *attr,
+				   char *buf)
+{
+	return kgsl_pool_stats_show(buf, PAGE_SIZE);
+}
+
 DEVICE_ATTR(vmalloc, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(vmalloc_max, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(page_alloc, 0444, kgsl_drv_memstat_show, NULL);
@@ -244,7 +360,13 @@ DEVICE_ATTR(coherent, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(coherent_max, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(mapped, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(mapped_max, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(purgeable, 0444, kgsl_drv_memstat_show, NULL);
+DEVICE_ATTR(purged, 0444, kgsl_drv_memstat_show, NULL);
 DEVICE_ATTR(histogram, 0444, kgsl_drv_histogram_show, NULL);
+DEVICE_ATTR(page_pool, 0444, kgsl_drv_page_pool_show, NULL);
+DEVICE_ATTR(full_cache_threshold, 0644,
+		kgsl_drv_full_cache_threshold_show,
+		kgsl_drv_full_cache_threshold_store);
 
 static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_vmalloc,
@@ -255,7 +377,11 @@ static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_coherent_max,
 	&dev_attr_mapped,
 	&dev_attr_mapped_max,
+	&dev_attr_purgeable,
+	&dev_attr_purged,
 	&dev_attr_histogram,
+	&dev_attr_page_pool,
+	&dev_attr_full_cache_threshold,
 	NULL
 };
 
@@ -288,19 +414,51 @@ static void _outer_cache_range_op(int op, unsigned long addr, size_t size)
 	}
 }
 
-static void outer_cache_range_op_sg(struct scatterlist *sg, int sglen, int op)
+/*
+ * Operate on the part of the scatterlist that covers [offset, offset + size)
+ * of the buffer.  Entries outside of the range are skipped.
+ */
+static void outer_cache_range_op_sg(struct scatterlist *sg, int sglen,
+		unsigned int offset, unsigned int size, int op)
 {
 	struct scatterlist *s;
 	int i;
 
 	for_each_sg(sg, s, sglen, i) {
-		unsigned int paddr = kgsl_get_sg_pa(s);
-		_outer_cache_range_op(op, paddr, s->length);
+		unsigned int paddr, len;
+
+		if (size == 0)
+			break;
+
+		if (offset >= s->length) {
+			offset -= s->length;
+			continue;
+		}
+
+		paddr = kgsl_get_sg_pa(s) + offset;
+		len = min(s->length - offset, size);
+		_outer_cache_range_op(op, paddr, len);
+
+		offset = 0;
+		size -= len;
 	}
 }
 
+static void outer_cache_range_op_pages(struct page **pages, int count, int op)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		_outer_cache_range_op(op, page_to_phys(pages[i]), PAGE_SIZE);
+}
+
 #else
-static void outer_cache_range_op_sg(struct scatterlist *sg, int sglen, int op)
+static void outer_cache_range_op_sg(struct scatterlist *sg, int sglen,
+		unsigned int offset, unsigned int size, int op)
+{
+}
+
+static void outer_cache_range_op_pages(struct page **pages, int count, int op)
 {
 }
 #endif
@@ -358,6 +516,10 @@ static void kgsl_page_alloc_free(struct kgsl_memdesc *memdesc)
 	struct scatterlist *sg;
 	int sglen = memdesc->sglen;
 
+	/* The pages went with kgsl_sharedmem_page_purge() */
+	if (memdesc->priv & KGSL_MEMDESC_PURGED)
+		return;
+
 	kgsl_driver.stats.page_alloc -= memdesc->size;
 
 	if (memdesc->hostptr) {
@@ -368,7 +530,7 @@ static void kgsl_page_alloc_free(struct kgsl_memdesc *memdesc)
 		for_each_sg(memdesc->sg, sg, sglen, i){
 			if (sg->length == 0)
 				break;
-			__free_pages(sg_page(sg), get_order(sg->length));
+			kgsl_pool_free_page(sg_page(sg), get_order(sg->length));
 		}
 }
 
@@ -496,7 +658,19 @@ static struct kgsl_memdesc_ops kgsl_coherent_ops = {
 	.free = kgsl_coherent_free,
 };
 
-void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op)
+/**
+ * kgsl_cache_range_op_partial - Do cache maintenance on part of a buffer
+ * @memdesc: Memory descriptor of the buffer
+ * @offset: Offset of the first byte to operate on
+ * @size: Number of bytes to operate on
+ * @op: KGSL_CACHE_OP_* operation to perform
+ *
+ * The range is rounded out to page boundaries and clamped to the end of the
+ * buffer.  Only the scatterlist entries that overlap the range are passed to
+ * the outer cache.
+ */
+void kgsl_cache_range_op_partial(struct kgsl_memdesc *memdesc,
+		unsigned int offset, unsigned int size, int op)
 {
 	/*
 	 * If the buffer is mapped in the kernel operate on that address
@@ -506,9 +680,21 @@ void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op)
 	void *addr = (memdesc->hostptr) ?
 		memdesc->hostptr : (void *) memdesc->useraddr;
 
-	int size = memdesc->size;
+	unsigned int end;
+
+	if (offset >= memdesc->size || size == 0)
+		return;
+
+	if (size > memdesc->size - offset)
+		size = memdesc->size - offset;
+
+	end = min_t(unsigned int, PAGE_ALIGN(offset + size), memdesc->size);
+	offset &= PAGE_MASK;
+	size = end - offset;
 
 	if (addr !=  NULL) {
+		addr += offset;
+
 		switch (op) {
 		case KGSL_CACHE_OP_FLUSH:
 			dmac_flush_range(addr, addr + size);
@@ -521,17 +707,52 @@ void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op)
 			break;
 		}
 	}
-	outer_cache_range_op_sg(memdesc->sg, memdesc->sglen, op);
+	outer_cache_range_op_sg(memdesc->sg, memdesc->sglen, offset, size, op);
+}
+EXPORT_SYMBOL(kgsl_cache_range_op_partial);
+
+void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op)
+{
+	kgsl_cache_range_op_partial(memdesc, 0, memdesc->size, op);
 }
 EXPORT_SYMBOL(kgsl_cache_range_op);
 
+static void _kgsl_cache_flush_all(void *unused)
+{
+	flush_cache_all();
+}
+
+/**
+ * kgsl_cache_flush_all - Clean and invalidate all of the CPU caches
+ *
+ * Used instead of a range operation when the range is so large that walking
+ * it costs more than flushing everything.  An invalidate can't be done this
+ * way without losing other dirty data so every operation becomes a flush.
+ */
+void kgsl_cache_flush_all(void)
+{
+	on_each_cpu(_kgsl_cache_flush_all, NULL, 1);
+	outer_flush_all();
+}
+EXPORT_SYMBOL(kgsl_cache_flush_all);
+
+/*
+ * Step down to the next smaller chunk size.  The chunks only ever get
+ * smaller during an allocation so every chunk stays naturally aligned
+ * within the GPU mapping.
+ */
+static inline unsigned int _kgsl_next_chunk_size(unsigned int size)
+{
+	return (size == SZ_1M) ? SZ_64K : PAGE_SIZE;
+}
+
 static int
 _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 			struct kgsl_pagetable *pagetable,
 			size_t size)
 {
 	int pcount = 0, order, ret = 0;
-	int j, len, page_size, sglen_alloc, sglen = 0;
+	int i, j, len, page_size, sglen_alloc, sglen = 0;
 	struct page **pages = NULL;
 	pgprot_t page_prot = pgprot_writecombine(PAGE_KERNEL);
 	void *ptr;
@@ -539,8 +760,29 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 
 	align = (memdesc->flags & KGSL_MEMALIGN_MASK) >> KGSL_MEMALIGN_SHIFT;
 
-	page_size = (align >= ilog2(SZ_64K) && size >= SZ_64K)
-			? SZ_64K : PAGE_SIZE;
+	/*
+	 * Back large allocations with 1M or 64K chunks so that the IOMMU can
+	 * map them with sections or large pages.  The GPU address has to be
+	 * aligned to the chunk size for that to work which is only done for
+	 * the IOMMU and can't be done when the GPU address is the CPU address.
+	 * The GPU MMU only has 4K pages so only honor the requested alignment
+	 * there.
+	 */
+	if (kgsl_mmu_get_mmutype() == KGSL_MMU_TYPE_IOMMU &&
+		!kgsl_memdesc_use_cpu_map(memdesc)) {
+		if (size >= SZ_1M)
+			align = max_t(unsigned int, align, ilog2(SZ_1M));
+		else if (size >= SZ_64K)
+			align = max_t(unsigned int, align, ilog2(SZ_64K));
+	}
+
+	if (align >= ilog2(SZ_1M) && size >= SZ_1M)
+		page_size = SZ_1M;
+	else if (align >= ilog2(SZ_64K) && size >= SZ_64K)
+		page_size = SZ_64K;
+	else
+		page_size = PAGE_SIZE;
+
 	/* update align flags for what we actually use */
 	if (page_size != PAGE_SIZE)
 		kgsl_memdesc_set_align(memdesc, ilog2(page_size));
@@ -593,8 +835,8 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 		int j;
 
 		/* don't waste space at the end of the allocation*/
-		if (len < page_size)
-			page_size = PAGE_SIZE;
+		while (len < page_size)
+			page_size = _kgsl_next_chunk_size(page_size);
 
 		/*
 		 * Don't do some of the more aggressive memory recovery
@@ -606,11 +848,22 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 		else
 			gfp_mask |= GFP_KERNEL;
 
+		/*
+		 * Blocks from the page pool are already zeroed and flushed so
+		 * they don't need to go on the list of pages to scrub below
+		 */
+		page = kgsl_pool_alloc_page(get_order(page_size));
+		if (page != NULL) {
+			sg_set_page(&memdesc->sg[sglen++], page, page_size, 0);
+			len -= page_size;
+			continue;
+		}
+
 		page = alloc_pages(gfp_mask, get_order(page_size));
 
 		if (page == NULL) {
 			if (page_size != PAGE_SIZE) {
-				page_size = PAGE_SIZE;
+				page_size = _kgsl_next_chunk_size(page_size);
 				continue;
 			}
 
@@ -656,19 +909,28 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 	 * microseconds at best.  The only downside is that there needs to be
 	 * enough temporary space in vmalloc to accomodate the map. This
 	 * shouldn't be a problem, but if it happens, fall back to a much slower
-	 * path
+	 * path.  Blocks that came from the page pool have already been
+	 * scrubbed so only the pages that came from the system are mapped.
+	 * The map is done VMAP_MAX_ALLOC pages at a time so that it comes out
+	 * of this cpu's vmap block instead of the global vmap area tree.
 	 */
 
-	ptr = vmap(pages, pcount, VM_IOREMAP, page_prot);
+	if (pcount == 0)
+		goto stats;
 
-	if (ptr != NULL) {
-		memset(ptr, 0, memdesc->size);
-		dmac_flush_range(ptr, ptr + memdesc->size);
-		vunmap(ptr);
-	} else {
-		/* Very, very, very slow path */
+	for (i = 0; i < pcount; i += VMAP_MAX_ALLOC) {
+		int n = min_t(int, pcount - i, VMAP_MAX_ALLOC);
 
-		for (j = 0; j < pcount; j++) {
+		ptr = vm_map_ram(pages + i, n, -1, page_prot);
+		if (ptr != NULL) {
+			memset(ptr, 0, n << PAGE_SHIFT);
+			dmac_flush_range(ptr, ptr + (n << PAGE_SHIFT));
+			vm_unmap_ram(ptr, n);
+			continue;
+		}
+
+		/* Very, very, very slow path */
+		for (j = i; j < i + n; j++) {
 			ptr = kmap_atomic(pages[j]);
 			memset(ptr, 0, PAGE_SIZE);
 			dmac_flush_range(ptr, ptr + PAGE_SIZE);
@@ -676,9 +938,9 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 		}
 	}
 
-	outer_cache_range_op_sg(memdesc->sg, memdesc->sglen,
-				KGSL_CACHE_OP_FLUSH);
+	outer_cache_range_op_pages(pages, pcount, KGSL_CACHE_OP_FLUSH);
 
+stats:
 	order = get_order(size);
 
 	if (order < 16)
@@ -726,6 +988,58 @@ kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 }
 EXPORT_SYMBOL(kgsl_sharedmem_page_alloc_user);
 
+/**
+ * kgsl_sharedmem_page_purge - Free the pages behind a user page_alloc memdesc
+ * @memdesc: memdesc that is no longer mapped into the GPU or the CPU
+ *
+ * The size and the GPU address are kept, so the memdesc can be refilled with
+ * kgsl_sharedmem_page_refill() or freed with kgsl_sharedmem_free() as usual.
+ */
+void kgsl_sharedmem_page_purge(struct kgsl_memdesc *memdesc)
+{
+	struct scatterlist *sg;
+	int i;
+
+	kgsl_driver.stats.page_alloc -= memdesc->size;
+
+	/* Straight back to the system, this runs when memory is short */
+	for_each_sg(memdesc->sg, sg, memdesc->sglen, i)
+		__free_pages(sg_page(sg), get_order(sg->length));
+	kgsl_sg_free(memdesc->sg, memdesc->sglen_alloc);
+
+	memdesc->sg = NULL;
+	memdesc->sglen = 0;
+	memdesc->sglen_alloc = 0;
+	memdesc->priv |= KGSL_MEMDESC_PURGED;
+}
+EXPORT_SYMBOL(kgsl_sharedmem_page_purge);
+
+/**
+ * kgsl_sharedmem_page_refill - Give a purged memdesc new, zeroed pages
+ * @memdesc: memdesc emptied by kgsl_sharedmem_page_purge()
+ *
+ * The caller maps the memdesc back into its pagetable at the same address.
+ */
+int kgsl_sharedmem_page_refill(struct kgsl_memdesc *memdesc)
+{
+	struct kgsl_memdesc tmp = { .flags = memdesc->flags };
+	int ret;
+
+	ret = _kgsl_sharedmem_page_alloc(&tmp, memdesc->pagetable,
+					 memdesc->size);
+	if (ret)
+		return ret;
+
+	memdesc->sg = tmp.sg;
+	memdesc->sglen = tmp.sglen;
+	memdesc->sglen_alloc = tmp.sglen_alloc;
+	/* Pairs with the read barrier in kgsl_gpumem_vm_fault() */
+	smp_wmb();
+	memdesc->priv &= ~KGSL_MEMDESC_PURGED;
+	return 0;
+}
+EXPORT_SYMBOL(kgsl_sharedmem_page_refill);
+
 int
 kgsl_sharedmem_alloc_coherent(struct kgsl_memdesc *memdesc, size_t size)
 {
@@ -39,6 +39,10 @@ int kgsl_sharedmem_page_alloc_user(struct kgsl_memdesc *memdesc,
 				struct kgsl_pagetable *pagetable,
 				size_t size);
 
+void kgsl_sharedmem_page_purge(struct kgsl_memdesc *memdesc);
+
+int kgsl_sharedmem_page_refill(struct kgsl_memdesc *memdesc);
+
 int kgsl_sharedmem_alloc_coherent(struct kgsl_memdesc *memdesc, size_t size);
 
 int kgsl_sharedmem_ebimem_user(struct kgsl_memdesc *memdesc,
@@ -51,6 +55,9 @@ int kgsl_sharedmem_ebimem(struct kgsl_memdesc *memdesc,
 
 void kgsl_sharedmem_free(struct kgsl_memdesc *memdesc);
 
+void kgsl_memdesc_large_page_size(const struct kgsl_memdesc *memdesc,
+	unsigned int *size_64k, unsigned int *size_1m);
+
 int kgsl_sharedmem_readl(const struct kgsl_memdesc *memdesc,
 			uint32_t *dst,
 			unsigned int offsetbytes);
@@ -64,6 +71,9 @@ int kgsl_sharedmem_set(const struct kgsl_memdesc *memdesc,
 			unsigned int sizebytes);
 
 void kgsl_cache_range_op(struct kgsl_memdesc *memdesc, int op);
+void kgsl_cache_range_op_partial(struct kgsl_memdesc *memdesc,
+		unsigned int offset, unsigned int size, int op);
+void kgsl_cache_flush_all(void);
 
 void kgsl_process_init_sysfs(struct kgsl_process_private *private);
 void kgsl_process_uninit_sysfs(struct kgsl_process_private *private);
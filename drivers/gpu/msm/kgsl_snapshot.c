@@ -16,6 +16,10 @@
 #include <linux/utsname.h>
 #include <linux/sched.h>
 #include <linux/idr.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <linux/lz4.h>
 
 #include "kgsl.h"
 #include "kgsl_log.h"
@@ -43,6 +47,31 @@ struct snapshot_obj_itr {
 	size_t write;   /* Bytes written so far */
 };
 
+/*
+ * Frozen GPU objects are packed into lz4 chunks by a work item once the
+ * capture is done, so the buffers can be released without waiting for
+ * the dump to be read.  Each chunk holds SNAPSHOT_CHUNK_SIZE bytes of the
+ * object stream as it would be written out by snapshot_show.
+ */
+
+#define SNAPSHOT_CHUNK_SIZE (64 * 1024)
+
+struct kgsl_snapshot_chunk {
+	struct list_head node;
+	size_t size;		/* Unpacked size */
+	size_t len;		/* Packed size */
+	unsigned char data[0];
+};
+
+struct kgsl_snapshot_pack {
+	struct kgsl_device *device;
+	struct work_struct work;
+	struct list_head chunks;
+	unsigned int gen;	/* Bumped by every new capture */
+	void *buf;		/* Unpacked copy of cur */
+	struct kgsl_snapshot_chunk *cur;
+};
+
 static void obj_itr_init(struct snapshot_obj_itr *itr, void *buf,
 	loff_t offset, size_t remain)
 {
@@ -307,6 +336,161 @@ static void kgsl_snapshot_put_object(struct kgsl_device *device,
 	kfree(obj);
 }
 
+static void snapshot_free_chunks(struct list_head *chunks)
+{
+	struct kgsl_snapshot_chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, chunks, node) {
+		list_del(&chunk->node);
+		kfree(chunk);
+	}
+}
+
+/* Drop the packed objects of the last snapshot, with the device mutex held */
+static void snapshot_pack_reset(struct kgsl_snapshot_pack *pack)
+{
+	snapshot_free_chunks(&pack->chunks);
+	pack->cur = NULL;
+	vfree(pack->buf);
+	pack->buf = NULL;
+}
+
+static void snapshot_pack_work(struct work_struct *work)
+{
+	struct kgsl_snapshot_pack *pack =
+		container_of(work, struct kgsl_snapshot_pack, work);
+	struct kgsl_device *device = pack->device;
+	struct kgsl_snapshot_object *obj, *tmp;
+	struct kgsl_snapshot_chunk *chunk;
+	struct snapshot_obj_itr itr;
+	LIST_HEAD(objs);
+	LIST_HEAD(chunks);
+	void *raw, *dst, *wrkmem;
+	size_t len;
+	loff_t off;
+	unsigned int gen;
+
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+	gen = pack->gen;
+	list_splice_init(&device->snapshot_obj_list, &objs);
+	mutex_unlock(&device->mutex);
+
+	if (list_empty(&objs))
+		return;
+
+	/* The objects stay frozen, so they can be read without the mutex */
+	raw = vmalloc(SNAPSHOT_CHUNK_SIZE);
+	dst = vmalloc(LZ4_COMPRESSBOUND(SNAPSHOT_CHUNK_SIZE));
+	wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	if (!raw || !dst || !wrkmem)
+		goto err;
+
+	for (off = 0; ; off += SNAPSHOT_CHUNK_SIZE) {
+		obj_itr_init(&itr, raw, off, SNAPSHOT_CHUNK_SIZE);
+		list_for_each_entry(obj, &objs, node)
+			kgsl_snapshot_dump_object(device, obj, &itr);
+
+		if (itr.write == 0)
+			break;
+
+		if (lz4_compress(raw, itr.write, dst, &len, wrkmem) < 0)
+			goto err;
+
+		chunk = kmalloc(sizeof(*chunk) + len, GFP_KERNEL);
+		if (chunk == NULL)
+			goto err;
+
+		chunk->size = itr.write;
+		chunk->len = len;
+		memcpy(chunk->data, dst, len);
+		list_add_tail(&chunk->node, &chunks);
+
+		if (itr.write < SNAPSHOT_CHUNK_SIZE)
+			break;
+	}
+
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+	/* A newer capture owns the chunk list now */
+	if (gen == pack->gen)
+		list_splice_tail_init(&chunks, &pack->chunks);
+	list_for_each_entry_safe(obj, tmp, &objs, node)
+		kgsl_snapshot_put_object(device, obj);
+	mutex_unlock(&device->mutex);
+
+	snapshot_free_chunks(&chunks);
+	goto done;
+err:
+	KGSL_DRV_ERR(device, "snapshot: Unable to pack GPU objects\n");
+	snapshot_free_chunks(&chunks);
+
+	/* Leave the objects to be copied out when the dump is read */
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
+	list_splice(&objs, &device->snapshot_obj_list);
+	mutex_unlock(&device->mutex);
+done:
+	kfree(wrkmem);
+	vfree(dst);
+	vfree(raw);
+}
+
+static void snapshot_dump_chunk(struct kgsl_device *device,
+	struct kgsl_snapshot_chunk *chunk, struct snapshot_obj_itr *itr)
+{
+	struct kgsl_snapshot_pack *pack = device->snapshot_pack;
+	size_t len = chunk->len;
+
+	if (itr->remain == 0)
+		return;
+
+	if (itr->pos + chunk->size <= itr->offset) {
+		itr->pos += chunk->size;
+		return;
+	}
+
+	if (pack->buf == NULL) {
+		pack->buf = vmalloc(SNAPSHOT_CHUNK_SIZE);
+		if (pack->buf == NULL)
+			goto err;
+	}
+
+	if (pack->cur != chunk) {
+		pack->cur = NULL;
+		if (lz4_decompress(chunk->data, &len, pack->buf,
+				   chunk->size) < 0)
+			goto err;
+		pack->cur = chunk;
+	}
+
+	obj_itr_out(itr, pack->buf, chunk->size);
+	return;
+err:
+	KGSL_DRV_ERR(device, "snapshot: Unable to unpack GPU objects\n");
+	itr->pos += chunk->size;
+}
+
+/*
+ * kgsl_snapshot_skip_section - Return 1 if a section should be left out
+ * @device - the device that is being snapshotted
+ * @id - the section id
+ *
+ * Debug memory and debug bus sections are only captured while the
+ * capture is within its time budget.
+ */
+int kgsl_snapshot_skip_section(struct kgsl_device *device, u16 id)
+{
+	if (id != KGSL_SNAPSHOT_SECTION_DEBUG &&
+	    id != KGSL_SNAPSHOT_SECTION_DEBUGBUS)
+		return 0;
+
+	if (!device->snapshot_budget ||
+	    time_before(jiffies, device->snapshot_deadline))
+		return 0;
+
+	device->snapshot_skipped++;
+	return 1;
+}
+EXPORT_SYMBOL(kgsl_snapshot_skip_section);
+
 /* ksgl_snapshot_have_object - Return 1 if the object has been processed
  *@device - the device that is being snapshotted
  * @ptbase - the pagetable base of the object to freeze
@@ -581,6 +765,13 @@ int kgsl_device_snapshot(struct kgsl_device *device, int hang)
 		goto done;
 	}
 
+	device->snapshot_deadline = jiffies +
+		msecs_to_jiffies(device->snapshot_budget);
+	device->snapshot_skipped = 0;
+
+	device->snapshot_pack->gen++;
+	snapshot_pack_reset(device->snapshot_pack);
+
 	header->magic = SNAPSHOT_MAGIC;
 
 	header->gpuid = kgsl_gpuid(device, &header->chipid);
@@ -612,6 +803,13 @@ int kgsl_device_snapshot(struct kgsl_device *device, int hang)
 	/* log buffer info to aid in ramdump fault tolerance */
 	KGSL_DRV_ERR(device, "snapshot created at pa %lx size %d\n",
 			__pa(device->snapshot),	device->snapshot_size);
+	if (device->snapshot_skipped)
+		KGSL_DRV_ERR(device,
+			"snapshot: over the %ums budget, %d sections skipped\n",
+			device->snapshot_budget, device->snapshot_skipped);
+
+	if (!list_empty(&device->snapshot_obj_list))
+		queue_work(system_unbound_wq, &device->snapshot_pack->work);
 	if (hang)
 		sysfs_notify(&device->snapshot_kobj, NULL, "timestamp");
 
@@ -642,6 +840,7 @@ static ssize_t snapshot_show(struct file *filep, struct kobject *kobj,
 {
 	struct kgsl_device *device = kobj_to_device(kobj);
 	struct kgsl_snapshot_object *obj, *tmp;
+	struct kgsl_snapshot_chunk *chunk;
 	struct kgsl_snapshot_section_header head;
 	struct snapshot_obj_itr itr;
 	int ret;
@@ -653,8 +852,11 @@ static ssize_t snapshot_show(struct file *filep, struct kobject *kobj,
 	if (device->snapshot_timestamp == 0)
 		return 0;
 
+	/* Let the objects finish packing */
+	flush_work(&device->snapshot_pack->work);
+
 	/* Get the mutex to keep things from changing while we are dumping */
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	obj_itr_init(&itr, buf, off, count);
 
@@ -663,6 +865,9 @@ static ssize_t snapshot_show(struct file *filep, struct kobject *kobj,
 	if (ret == 0)
 		goto done;
 
+	list_for_each_entry(chunk, &device->snapshot_pack->chunks, node)
+		snapshot_dump_chunk(device, chunk, &itr);
+
 	list_for_each_entry(obj, &device->snapshot_obj_list, node)
 		kgsl_snapshot_dump_object(device, obj, &itr);
 
@@ -686,6 +891,8 @@ static ssize_t snapshot_show(struct file *filep, struct kobject *kobj,
 			node)
 			kgsl_snapshot_put_object(device, obj);
 
+		snapshot_pack_reset(device->snapshot_pack);
+
 		if (device->snapshot_frozen)
 			KGSL_DRV_ERR(device, "Snapshot objects released\n");
 
@@ -709,7 +916,7 @@ static ssize_t trigger_store(struct kgsl_device *device, const char *buf,
 	size_t count)
 {
 	if (device && count > 0) {
-		mutex_lock(&device->mutex);
+		lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 		kgsl_device_snapshot(device, 0);
 		mutex_unlock(&device->mutex);
 	}
@@ -731,8 +938,30 @@ struct kgsl_snapshot_attribute attr_##_name = { \
 	.store = _store, \
 }
 
+/* Show the capture time budget in ms */
+static ssize_t budget_ms_show(struct kgsl_device *device, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%u\n", device->snapshot_budget);
+}
+
+/* Set the capture time budget in ms, 0 captures every section */
+static ssize_t budget_ms_store(struct kgsl_device *device, const char *buf,
+	size_t count)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	device->snapshot_budget = val;
+	return count;
+}
+
 SNAPSHOT_ATTR(trigger, 0600, NULL, trigger_store);
 SNAPSHOT_ATTR(timestamp, 0444, timestamp_show, NULL);
+SNAPSHOT_ATTR(budget_ms, 0644, budget_ms_show, budget_ms_store);
 
 static void snapshot_sysfs_release(struct kobject *kobj)
 {
@@ -796,8 +1025,23 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 	if (device->snapshot == NULL)
 		return -ENOMEM;
 
+	if (device->snapshot_pack == NULL) {
+		device->snapshot_pack = kzalloc(sizeof(*device->snapshot_pack),
+			GFP_KERNEL);
+		if (device->snapshot_pack == NULL) {
+			kfree(device->snapshot);
+			device->snapshot = NULL;
+			return -ENOMEM;
+		}
+
+		device->snapshot_pack->device = device;
+		INIT_WORK(&device->snapshot_pack->work, snapshot_pack_work);
+		INIT_LIST_HEAD(&device->snapshot_pack->chunks);
+	}
+
 	device->snapshot_maxsize = KGSL_SNAPSHOT_MEMSIZE;
 	device->snapshot_timestamp = 0;
+	device->snapshot_budget = KGSL_SNAPSHOT_BUDGET_MS;
 
 	INIT_LIST_HEAD(&device->snapshot_obj_list);
 
@@ -815,6 +1059,10 @@ int kgsl_device_snapshot_init(struct kgsl_device *device)
 		goto done;
 
 	ret  = sysfs_create_file(&device->snapshot_kobj, &attr_timestamp.attr);
+	if (ret)
+		goto done;
+
+	ret  = sysfs_create_file(&device->snapshot_kobj, &attr_budget_ms.attr);
 
 done:
 	return ret;
@@ -833,9 +1081,17 @@ void kgsl_device_snapshot_close(struct kgsl_device *device)
 	sysfs_remove_bin_file(&device->snapshot_kobj, &snapshot_attr);
 	sysfs_remove_file(&device->snapshot_kobj, &attr_trigger.attr);
 	sysfs_remove_file(&device->snapshot_kobj, &attr_timestamp.attr);
+	sysfs_remove_file(&device->snapshot_kobj, &attr_budget_ms.attr);
 
 	kobject_put(&device->snapshot_kobj);
 
+	if (device->snapshot_pack) {
+		cancel_work_sync(&device->snapshot_pack->work);
+		snapshot_pack_reset(device->snapshot_pack);
+		kfree(device->snapshot_pack);
+		device->snapshot_pack = NULL;
+	}
+
 	kfree(device->snapshot);
 
 	device->snapshot = NULL;
@@ -184,6 +184,9 @@ struct kgsl_snapshot_gpu_object {
 /* Allocate 512K for each device snapshot */
 #define KGSL_SNAPSHOT_MEMSIZE (512 * 1024)
 
+/* Default time allowed for a capture before the debug sections are dropped */
+#define KGSL_SNAPSHOT_BUDGET_MS 200
+
 struct kgsl_device;
 /*
  * A helper macro to print out "not enough memory functions" - this
@@ -191,6 +194,8 @@ struct kgsl_device;
  * the number of strings in the binary
  */
 
+int kgsl_snapshot_skip_section(struct kgsl_device *device, u16 id);
+
 #define SNAPSHOT_ERR_NOMEM(_d, _s) \
 	KGSL_DRV_ERR((_d), \
 	"snapshot: not enough snapshot memory for section %s\n", (_s))
@@ -226,6 +231,10 @@ static inline void *kgsl_snapshot_add_section(struct kgsl_device *device,
 	if (*remain < sizeof(*header))
 		return snapshot;
 
+	/* Debug sections are the first to go when the capture runs long */
+	if (kgsl_snapshot_skip_section(device, id))
+		return snapshot;
+
 	/* It is legal to have no function (i.e. - make an empty section) */
 
 	if (func) {
@@ -171,7 +171,7 @@ int kgsl_add_fence_event(struct kgsl_device *device,
 	 * the callback
 	 */
 	ret = kgsl_add_event(device, context_id, timestamp,
-			kgsl_fence_event_cb, event, owner);
+			kgsl_fence_event_cb, event, owner, KGSL_EVENT_UNLOCKED);
 	if (ret)
 		goto fail_event;
 
@@ -13,6 +13,7 @@
 #include <linux/module.h>
 #include <linux/uaccess.h>
 #include <linux/sched.h>
+#include <linux/log2.h>
 
 #include "kgsl.h"
 #include "kgsl_cffdump.h"
@@ -129,6 +130,10 @@ static void z180_cmdwindow_write(struct kgsl_device *device,
 
 static const struct kgsl_functable z180_functable;
 
+static unsigned int z180_rb_slots = Z180_PACKET_COUNT_DEFAULT;
+module_param_named(rb_slots, z180_rb_slots, uint, 0444);
+MODULE_PARM_DESC(rb_slots, "2D submissions in flight (power of 2, max 128)");
+
 static struct z180_device device_2d0 = {
 	.dev = {
 		KGSL_DEVICE_COMMON_INIT(device_2d0.dev),
@@ -228,7 +233,7 @@ static irqreturn_t z180_irq_handler(struct kgsl_device *device)
 			count &= 255;
 			z180_dev->timestamp += count;
 
-			queue_work(device->work_queue, &device->ts_expired_ws);
+			kgsl_schedule_events(device);
 			wake_up_interruptible(&device->wait_queue);
 		}
 	}
@@ -294,22 +299,24 @@ error:
 	return result;
 }
 
-static inline unsigned int rb_offset(unsigned int timestamp)
+static inline unsigned int rb_offset(struct z180_ringbuffer *rb,
+				     unsigned int timestamp)
 {
-	return (timestamp % Z180_PACKET_COUNT)
+	return (timestamp & (rb->count - 1))
 		*sizeof(unsigned int)*(Z180_PACKET_SIZE);
 }
 
 static inline unsigned int rb_gpuaddr(struct z180_device *z180_dev,
 					unsigned int timestamp)
 {
-	return z180_dev->ringbuffer.cmdbufdesc.gpuaddr + rb_offset(timestamp);
+	return z180_dev->ringbuffer.cmdbufdesc.gpuaddr +
+		rb_offset(&z180_dev->ringbuffer, timestamp);
 }
 
 static void addmarker(struct z180_ringbuffer *rb, unsigned int timestamp)
 {
 	char *ptr = (char *)(rb->cmdbufdesc.hostptr);
-	unsigned int *p = (unsigned int *)(ptr + rb_offset(timestamp));
+	unsigned int *p = (unsigned int *)(ptr + rb_offset(rb, timestamp));
 
 	*p++ = Z180_STREAM_PACKET;
 	*p++ = (Z180_MARKER_CMD | 5);
@@ -327,7 +334,7 @@ static void addcmd(struct z180_ringbuffer *rb, unsigned int timestamp,
 			unsigned int cmd, unsigned int nextcnt)
 {
 	char * ptr = (char *)(rb->cmdbufdesc.hostptr);
-	unsigned int *p = (unsigned int *)(ptr + (rb_offset(timestamp)
+	unsigned int *p = (unsigned int *)(ptr + (rb_offset(rb, timestamp)
 			   + (Z180_MARKER_SIZE * sizeof(unsigned int))));
 
 	*p++ = Z180_STREAM_PACKET_CALL;
@@ -368,7 +375,7 @@ static int room_in_rb(struct z180_device *device)
 
 	ts_diff = device->current_timestamp - device->timestamp;
 
-	return ts_diff < Z180_PACKET_COUNT;
+	return ts_diff < (int)device->ringbuffer.count;
 }
 
 static int z180_idle(struct kgsl_device *device)
@@ -513,10 +520,17 @@ static int z180_ringbuffer_init(struct kgsl_device *device)
 {
 	struct z180_device *z180_dev = Z180_DEVICE(device);
 	memset(&z180_dev->ringbuffer, 0, sizeof(struct z180_ringbuffer));
+	if (!is_power_of_2(z180_rb_slots) || z180_rb_slots < 2 ||
+	    z180_rb_slots > Z180_PACKET_COUNT_MAX) {
+		KGSL_DRV_ERR(device, "bad rb_slots %u, using %u\n",
+			     z180_rb_slots, Z180_PACKET_COUNT_DEFAULT);
+		z180_rb_slots = Z180_PACKET_COUNT_DEFAULT;
+	}
+	z180_dev->ringbuffer.count = z180_rb_slots;
 	z180_dev->ringbuffer.prevctx = Z180_INVALID_CONTEXT;
 	z180_dev->ringbuffer.cmdbufdesc.flags = KGSL_MEMFLAGS_GPUREADONLY;
 	return kgsl_allocate_contiguous(&z180_dev->ringbuffer.cmdbufdesc,
-		Z180_RB_SIZE);
+		Z180_RB_SIZE(&z180_dev->ringbuffer));
 }
 
 static void z180_ringbuffer_close(struct kgsl_device *device)
@@ -859,14 +873,14 @@ static int z180_waittimestamp(struct kgsl_device *device,
 		status = 0;
 	else if (timeout == 0) {
 		status = -ETIMEDOUT;
-		mutex_lock(&device->mutex);
+		lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 		kgsl_pwrctrl_set_state(device, KGSL_STATE_HUNG);
 		kgsl_postmortem_dump(device, 0);
 		mutex_unlock(&device->mutex);
 	} else
 		status = timeout;
 
-	mutex_lock(&device->mutex);
+	lsl_mutex_lock(&device->mutex, LSL_KGSL_DEVICE);
 
 	return status;
 }
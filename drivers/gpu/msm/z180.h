@@ -20,9 +20,14 @@
 #define DEVICE_2D1_NAME "kgsl-2d1"
 
 #define Z180_PACKET_SIZE 15
-#define Z180_PACKET_COUNT 8
-#define Z180_RB_SIZE (Z180_PACKET_SIZE*Z180_PACKET_COUNT \
-			  *sizeof(uint32_t))
+/*
+ * Ringbuffer slots, one per submission in flight.  A power of two so the
+ * slot sequence stays continuous across timestamp wrap, and below the
+ * 8 bit completion count the core reports per interrupt.
+ */
+#define Z180_PACKET_COUNT_DEFAULT 32
+#define Z180_PACKET_COUNT_MAX 128
+#define Z180_RB_SIZE(rb) (Z180_PACKET_SIZE * (rb)->count * sizeof(uint32_t))
 #define Z180_DEVICE(device) \
 		KGSL_CONTAINER_OF(device, struct z180_device, dev)
 
@@ -33,6 +38,7 @@
 
 struct z180_ringbuffer {
 	unsigned int prevctx;
+	unsigned int count;
 	struct kgsl_memdesc      cmdbufdesc;
 };
 
@@ -85,7 +85,7 @@ static void z180_dump_ringbuffer(struct kgsl_device *device)
 
 	rb_hostptr = (unsigned int *) z180_dev->ringbuffer.cmdbufdesc.hostptr;
 
-	rb_size = Z180_RB_SIZE;
+	rb_size = Z180_RB_SIZE(&z180_dev->ringbuffer);
 	rb_gpuaddr = z180_dev->ringbuffer.cmdbufdesc.gpuaddr;
 
 	rb_words = rb_size/sizeof(unsigned int);
@@ -129,7 +129,7 @@ static void z180_dump_ib(struct kgsl_device *device)
 
 	rb_hostptr = (unsigned int *) z180_dev->ringbuffer.cmdbufdesc.hostptr;
 
-	rb_size = Z180_RB_SIZE;
+	rb_size = Z180_RB_SIZE(&z180_dev->ringbuffer);
 	rb_gpuaddr = z180_dev->ringbuffer.cmdbufdesc.gpuaddr;
 
 	rb_words = rb_size/sizeof(unsigned int);
@@ -146,7 +146,8 @@ static void z180_dump_ib(struct kgsl_device *device)
 
 			rb_slot_num++;
 			current_ib_slot =
-				z180_dev->current_timestamp % Z180_PACKET_COUNT;
+				z180_dev->current_timestamp &
+				(z180_dev->ringbuffer.count - 1);
 			if (rb_slot_num != current_ib_slot)
 				continue;
 
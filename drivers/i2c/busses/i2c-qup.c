@@ -123,6 +123,8 @@ enum {
 };
 
 #define QUP_MAX_CLK_STATE_RETRIES	300
+/* Bit times spent spinning on the bus before sleeping a byte time */
+#define QUP_SPIN_BITS			9
 
 
 #define RECOVER_LIMIT 5
@@ -416,6 +418,7 @@ static int
 qup_i2c_poll_writeready(struct qup_i2c_dev *dev, int rem)
 {
 	uint32_t retries = 0;
+	int spin = 0;
 
 	while (retries != 2000) {
 		uint32_t status = readl_relaxed(dev->base + QUP_I2C_STATUS);
@@ -426,8 +429,11 @@ qup_i2c_poll_writeready(struct qup_i2c_dev *dev, int rem)
 				return 0;
 			else if ((dev->msg->flags == 0) && (rem > 0))
 				return 0;
-			else 
+			else if (spin++ < QUP_SPIN_BITS)
 				udelay(dev->one_bit_t);
+			else
+				usleep_range(dev->one_bit_t * QUP_SPIN_BITS,
+					dev->one_bit_t * QUP_SPIN_BITS * 2);
 		}
 		if (retries++ == 1000) {
 			usleep_range((dev->one_bit_t * (dev->out_fifo_sz * 9)),
@@ -443,15 +449,23 @@ static int qup_i2c_poll_clock_ready(struct qup_i2c_dev *dev)
 	uint32_t retries = 0;
 
 
-	while (retries++ < QUP_MAX_CLK_STATE_RETRIES) {
+	while (retries < QUP_MAX_CLK_STATE_RETRIES) {
 		uint32_t status = readl_relaxed(dev->base + QUP_I2C_STATUS);
 		uint32_t clk_state = (status >> 13) & 0x7;
 
 		if (clk_state == I2C_CLK_RESET_BUSIDLE_STATE ||
 				clk_state == I2C_CLK_FORCED_LOW_STATE)
 			return 0;
-		
-		udelay(dev->one_bit_t);
+
+		/* A STOP is over in a bit or two, a stretched clock is not */
+		if (retries < QUP_SPIN_BITS) {
+			udelay(dev->one_bit_t);
+			retries++;
+		} else {
+			usleep_range(dev->one_bit_t * QUP_SPIN_BITS,
+				dev->one_bit_t * QUP_SPIN_BITS * 2);
+			retries += QUP_SPIN_BITS;
+		}
 	}
 
 	dev_err(dev->dev, "Error waiting for clk ready\n");
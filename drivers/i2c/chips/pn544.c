@@ -866,7 +866,7 @@ static int __init pn544_dev_init(void)
 	I("%s: Loading pn544 driver\n", __func__);
 	return i2c_add_driver(&pn544_driver);
 }
-module_init(pn544_dev_init);
+deferred_initcall(pn544_dev_init);
 
 static void __exit pn544_dev_exit(void)
 {
@@ -1964,7 +1964,7 @@ static void __exit r3gd20_exit(void)
 	return;
 }
 
-module_init(r3gd20_init);
+deferred_initcall(r3gd20_init);
 module_exit(r3gd20_exit);
 
 MODULE_DESCRIPTION("r3gd20 digital gyroscope sysfs driver");
@@ -0,0 +1,183 @@
+/* drivers/input/input-boost.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
+#include <linux/notifier.h>
+#include <linux/input/input_boost.h>
+#include <mach/perflock.h>
+
+/*
+ * Boost on the first contact of any touchscreen, whatever its driver:
+ *
+ *  - a cpufreq floor at boost_level for boost_ms, then at decay_level
+ *    for a further decay_ms
+ *  - boost_cores online cores for boost_ms, 0 for none
+ *  - a GPU jump to its highest allowed pwrlevel, the GPU governor takes
+ *    it back down
+ *
+ * A contact is BTN_TOUCH going down or a new ABS_MT_TRACKING_ID.  New
+ * contacts within the first half of a boost don't renew it.
+ */
+
+static unsigned int boost_ms = 200;
+module_param(boost_ms, uint, 0644);
+static unsigned int decay_ms = 800;
+module_param(decay_ms, uint, 0644);
+static unsigned int boost_level = PERF_LOCK_HIGH;
+module_param(boost_level, uint, 0444);
+static unsigned int decay_level = PERF_LOCK_MEDIUM;
+module_param(decay_level, uint, 0444);
+static unsigned int boost_cores = 2;
+module_param(boost_cores, uint, 0444);
+static bool gpu_boost = true;
+module_param(gpu_boost, bool, 0644);
+
+static struct perf_lock boost_lock;
+static struct perf_lock decay_lock;
+static struct perf_lock cores_lock;
+static unsigned long boost_end;
+
+static BLOCKING_NOTIFIER_HEAD(gpu_notifier);
+
+int input_boost_register_gpu_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&gpu_notifier, nb);
+}
+EXPORT_SYMBOL(input_boost_register_gpu_notifier);
+
+int input_boost_unregister_gpu_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&gpu_notifier, nb);
+}
+EXPORT_SYMBOL(input_boost_unregister_gpu_notifier);
+
+static void input_boost_fn(struct work_struct *work)
+{
+	unsigned int ms = boost_ms;
+
+	if (!ms)
+		return;
+
+	perf_lock_timeout(&boost_lock, msecs_to_jiffies(ms));
+	if (decay_ms)
+		perf_lock_timeout(&decay_lock, msecs_to_jiffies(ms + decay_ms));
+	if (boost_cores)
+		perf_lock_timeout(&cores_lock, msecs_to_jiffies(ms));
+	if (gpu_boost)
+		blocking_notifier_call_chain(&gpu_notifier, ms, NULL);
+}
+static DECLARE_WORK(input_boost_work, input_boost_fn);
+
+static void input_boost_event(struct input_handle *handle,
+			      unsigned int type, unsigned int code, int value)
+{
+	if (!(type == EV_KEY && code == BTN_TOUCH && value) &&
+	    !(type == EV_ABS && code == ABS_MT_TRACKING_ID && value >= 0))
+		return;
+
+	/* Racy between devices, at worst that's one extra boost */
+	if (time_before(jiffies + msecs_to_jiffies(boost_ms / 2), boost_end))
+		return;
+	boost_end = jiffies + msecs_to_jiffies(boost_ms);
+
+	schedule_work(&input_boost_work);
+}
+
+static int input_boost_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "input_boost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_register;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_open;
+
+	return 0;
+
+err_open:
+	input_unregister_handle(handle);
+err_register:
+	kfree(handle);
+	return error;
+}
+
+static void input_boost_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id input_boost_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_KEY) | BIT_MASK(EV_ABS) },
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{ },
+};
+
+static struct input_handler input_boost_handler = {
+	.event		= input_boost_event,
+	.connect	= input_boost_connect,
+	.disconnect	= input_boost_disconnect,
+	.name		= "input_boost",
+	.id_table	= input_boost_ids,
+};
+
+static int __init input_boost_init(void)
+{
+	if (boost_level >= PERF_LOCK_INVALID)
+		boost_level = PERF_LOCK_HIGH;
+	if (decay_level >= PERF_LOCK_INVALID)
+		decay_level = PERF_LOCK_MEDIUM;
+	if (boost_cores > NR_CPUS)
+		boost_cores = NR_CPUS;
+	boost_end = jiffies;
+
+	perf_lock_init(&boost_lock, TYPE_PERF_LOCK, boost_level, "input_boost");
+	perf_lock_init(&decay_lock, TYPE_PERF_LOCK, decay_level,
+		       "input_boost_decay");
+	perf_lock_init(&cores_lock, TYPE_PERF_CORES, boost_cores,
+		       "input_boost_cores");
+
+	return input_register_handler(&input_boost_handler);
+}
+late_initcall(input_boost_init);
@@ -36,6 +36,7 @@
 #include <linux/firmware.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
+#include <linux/frametime.h>
 
 #define SYN_I2C_RETRY_TIMES 10
 #define SYN_UPDATE_RETRY_TIMES 5
@@ -45,6 +46,8 @@
 
 #define SYN_FW_NAME "tp_SYN.img"
 #define SYN_FW_TIMEOUT (30000)
+#define SYN_BURST_MAX	128
+#define SYN_LAT_BUCKETS	8
 static DEFINE_MUTEX(syn_fw_mutex);
 
 struct synaptics_ts_data {
@@ -137,8 +140,19 @@ struct synaptics_ts_data {
 	uint8_t block_touch_time_near;
 	uint8_t block_touch_time_far;
 	uint8_t block_touch_event;
+	uint16_t burst_addr;
+	uint8_t burst_len;
+	uint8_t burst_finger_off;
+	uint8_t burst_noise_off;
+	uint8_t burst_buf[SYN_BURST_MAX];
+	ktime_t irq_time;
+	uint32_t latency[SYN_LAT_BUCKETS];
 };
 
+static bool burst_read = true;
+module_param(burst_read, bool, 0644);
+MODULE_PARM_DESC(burst_read, "Read status and finger data in one transfer");
+
 #ifdef CONFIG_HAS_EARLYSUSPEND
 static void synaptics_ts_early_suspend(struct early_suspend *h);
 static void synaptics_ts_late_resume(struct early_suspend *h);
@@ -155,6 +169,7 @@ static int i2c_syn_write_byte_data(struct i2c_client *client, uint16_t addr, uin
 static int syn_pdt_scan(struct synaptics_ts_data *ts, int num_page);
 static int synaptics_init_panel(struct synaptics_ts_data *ts);
 
+static irqreturn_t synaptics_irq_handler(int irq, void *ptr);
 static irqreturn_t synaptics_irq_thread(int irq, void *ptr);
 
 extern unsigned int get_tamper_sf(void);
@@ -1678,7 +1693,7 @@ static ssize_t syn_int_status_store(struct device *dev,
 		return -EINVAL;
 
 	if (value) {
-		ret = request_threaded_irq(ts->client->irq, NULL, synaptics_irq_thread,
+		ret = request_threaded_irq(ts->client->irq, synaptics_irq_handler, synaptics_irq_thread,
 			IRQF_TRIGGER_LOW | IRQF_ONESHOT, ts->client->name, ts);
 		if (ret == 0) {
 			ts->irq_enabled = 1;
@@ -1718,6 +1733,34 @@ static ssize_t syn_reset(struct device *dev,
 static DEVICE_ATTR(reset, (S_IWUSR),
 	0, syn_reset);
 
+static ssize_t syn_latency_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct synaptics_ts_data *ts = gl_ts;
+	size_t count = 0;
+	int i;
+
+	for (i = 0; i < SYN_LAT_BUCKETS - 1; i++)
+		count += sprintf(buf + count, "<%5u us: %u\n",
+			250 << i, ts->latency[i]);
+	count += sprintf(buf + count, ">=%4u us: %u\n",
+		250 << (SYN_LAT_BUCKETS - 2), ts->latency[i]);
+
+	return count;
+}
+
+static ssize_t syn_latency_store(struct device *dev,
+	struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct synaptics_ts_data *ts = gl_ts;
+
+	memset(ts->latency, 0, sizeof(ts->latency));
+	return count;
+}
+
+static DEVICE_ATTR(latency, (S_IWUSR|S_IRUGO),
+	syn_latency_show, syn_latency_store);
+
 #endif
 
 enum SR_REG_STATE{
@@ -1828,6 +1871,7 @@ static int synaptics_touch_sysfs_init(void)
 		sysfs_create_file(android_touch_kobj, &dev_attr_pdt.attr) ||
 		sysfs_create_file(android_touch_kobj, &dev_attr_htc_event.attr) ||
 		sysfs_create_file(android_touch_kobj, &dev_attr_reset.attr) ||
+		sysfs_create_file(android_touch_kobj, &dev_attr_latency.attr) ||
 		sysfs_create_file(android_touch_kobj, &dev_attr_sr_en.attr)
 #ifdef SYN_WIRELESS_DEBUG
 		|| sysfs_create_file(android_touch_kobj, &dev_attr_enabled.attr)
@@ -1884,6 +1928,7 @@ static void synaptics_touch_sysfs_remove(void)
 	sysfs_remove_file(android_touch_kobj, &dev_attr_pdt.attr);
 	sysfs_remove_file(android_touch_kobj, &dev_attr_htc_event.attr);
 	sysfs_remove_file(android_touch_kobj, &dev_attr_reset.attr);
+	sysfs_remove_file(android_touch_kobj, &dev_attr_latency.attr);
 	sysfs_remove_file(android_touch_kobj, &dev_attr_sr_en.attr);
 #ifdef SYN_WIRELESS_DEBUG
 	sysfs_remove_file(android_touch_kobj, &dev_attr_enabled.attr);
@@ -1999,16 +2044,25 @@ static int synaptics_init_panel(struct synaptics_ts_data *ts)
 	return ret;
 }
 
-static void synaptics_ts_finger_func(struct synaptics_ts_data *ts)
+static void synaptics_ts_finger_func(struct synaptics_ts_data *ts, uint8_t *burst)
 {
-	int ret;
-	uint8_t buf[ts->finger_support * 8 ], noise_index[10];
+	int ret = 0;
+	uint8_t buf[ts->finger_support * 8 ];
+	static uint8_t noise_index[10];
 	uint16_t temp_im = 0, temp_cidim = 0;
 	static int x_pos[10] = {0}, y_pos[10] = {0};
 
 	memset(buf, 0x0, sizeof(buf));
-	memset(noise_index, 0x0, sizeof(noise_index));
-	if (ts->package_id < 3400)
+	if (burst) {
+		memcpy(buf, burst + ts->burst_finger_off, sizeof(buf));
+		if (ts->burst_noise_off)
+			memcpy(noise_index, burst + ts->burst_noise_off, sizeof(noise_index));
+		else if (ts->package_id >= 3400 && ts->debug_log_level & BIT(17))
+			i2c_syn_read(ts->client,
+				get_address_base(ts, 0x54, DATA_BASE) + 4, noise_index, sizeof(noise_index));
+		temp_im = (noise_index[1] <<8) | noise_index[0];
+		temp_cidim = (noise_index[6] <<8) | noise_index[5];
+	} else if (ts->package_id < 3400)
 		ret = i2c_syn_read(ts->client,
 			get_address_base(ts, 0x01, DATA_BASE) + 2, buf, sizeof(buf));
 	else {
@@ -2544,7 +2598,7 @@ static void synaptics_ts_work_func(struct work_struct *work)
 		i2c_syn_error_handler(ts, ts->i2c_err_handler_en, "r", __func__);
 	} else {
 		if (buf & get_address_base(ts, ts->finger_func_idx, INTR_SOURCE))
-			synaptics_ts_finger_func(ts);
+			synaptics_ts_finger_func(ts, NULL);
 		if (buf & get_address_base(ts, 0x01, INTR_SOURCE))
 			synaptics_ts_status_func(ts);
 		if (buf & get_address_base(ts, 0x54, INTR_SOURCE))
@@ -2553,25 +2607,48 @@ static void synaptics_ts_work_func(struct work_struct *work)
 
 }
 
+static void syn_latency_account(struct synaptics_ts_data *ts)
+{
+	uint32_t us = ktime_us_delta(ktime_get(), ts->irq_time);
+
+	ts->latency[us < 250 ? 0 : min(fls(us / 250), SYN_LAT_BUCKETS - 1)]++;
+}
+
+static irqreturn_t synaptics_irq_handler(int irq, void *ptr)
+{
+	struct synaptics_ts_data *ts = ptr;
+
+	ts->irq_time = ktime_get();
+	return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t synaptics_irq_thread(int irq, void *ptr)
 {
 	struct synaptics_ts_data *ts = ptr;
 	int ret;
-	uint8_t buf = 0;
+	uint8_t buf = 0, *burst = NULL;
 	struct timespec timeStart, timeEnd, timeDelta;
 
+	frametime_input();
+
 	if (ts->debug_log_level & BIT(2)) {
 			getnstimeofday(&timeStart);
 	}
 
-	ret = i2c_syn_read(ts->client, get_address_base(ts, 0x01, DATA_BASE) + 1, &buf, 1);
+	if (burst_read && ts->burst_len) {
+		burst = ts->burst_buf;
+		ret = i2c_syn_read(ts->client, ts->burst_addr, burst, ts->burst_len);
+		buf = burst[0];
+	} else
+		ret = i2c_syn_read(ts->client, get_address_base(ts, 0x01, DATA_BASE) + 1, &buf, 1);
 
 	if (ret < 0) {
 		i2c_syn_error_handler(ts, ts->i2c_err_handler_en, "r", __func__);
 	} else {
 		if (buf & get_address_base(ts, ts->finger_func_idx, INTR_SOURCE)) {
 			if (!vk_press) {
-				synaptics_ts_finger_func(ts);
+				synaptics_ts_finger_func(ts, burst);
+				syn_latency_account(ts);
 				if(ts->debug_log_level & BIT(2)) {
 					getnstimeofday(&timeEnd);
 					timeDelta.tv_nsec = (timeEnd.tv_sec*1000000000+timeEnd.tv_nsec)
@@ -2761,6 +2838,47 @@ static int syn_pdt_scan(struct synaptics_ts_data *ts, int num_page)
 	}
 	return ts->num_function;
 }
+
+/*
+ * Interrupt status sits at F01 data + 1 and the finger registers follow
+ * on the same page, so one read per interrupt can fetch both.
+ */
+static void syn_burst_layout(struct synaptics_ts_data *ts)
+{
+	int start, finger, noise, end;
+
+	ts->burst_len = 0;
+	ts->burst_noise_off = 0;
+	start = get_address_base(ts, 0x01, DATA_BASE);
+	if (start < 0)
+		return;
+	start += 1;
+	if (ts->package_id < 3400)
+		finger = start + 1;
+	else
+		finger = get_address_base(ts, ts->finger_func_idx, DATA_BASE);
+	if (finger < start || (finger >> 8) != (start >> 8))
+		return;
+	end = finger + ts->finger_support * 8;
+	if (end - start > SYN_BURST_MAX)
+		return;
+
+	if (ts->package_id >= 3400 && get_address_base(ts, 0x54, FUNCTION)) {
+		noise = get_address_base(ts, 0x54, DATA_BASE) + 4;
+		if (noise > start && (noise >> 8) == (start >> 8) &&
+		    max(end, noise + 10) - start <= SYN_BURST_MAX) {
+			ts->burst_noise_off = noise - start;
+			end = max(end, noise + 10);
+		}
+	}
+
+	ts->burst_addr = start;
+	ts->burst_finger_off = finger - start;
+	ts->burst_len = end - start;
+	printk(KERN_INFO "[TP] %s: %d bytes from %x per interrupt\n",
+		__func__, ts->burst_len, ts->burst_addr);
+}
+
 static int syn_get_version(struct synaptics_ts_data *ts)
 {
 	uint8_t data[16] = {0};
@@ -3162,6 +3280,7 @@ static int syn_probe_init(void *arg)
 		printk(KERN_ERR "[TP] TOUCH_ERR: syn_get_information fail\n");
 		goto err_syn_get_info_failed;
 	}
+	syn_burst_layout(ts);
 
 	if (pdata->abs_x_max  == 0 && pdata->abs_y_max == 0) {
 		ts->layout[0] = ts->layout[2] = 0;
@@ -3232,7 +3351,7 @@ static int syn_probe_init(void *arg)
 	ts->irq_enabled = 0;
 	if (ts->client->irq) {
 		ts->use_irq = 1;
-		ret = request_threaded_irq(ts->client->irq, NULL, synaptics_irq_thread,
+		ret = request_threaded_irq(ts->client->irq, synaptics_irq_handler, synaptics_irq_thread,
 			IRQF_TRIGGER_LOW | IRQF_ONESHOT, ts->client->name, ts);
 		if (ret == 0) {
 			ts->irq_enabled = 1;
@@ -3377,6 +3496,7 @@ static int synaptics_ts_probe(
 		kthread_run(syn_fw_update_init, (void *)ts, "SYN_FW_UPDATE");
 	}
 
+	device_enable_async_suspend(&client->dev);
 	kthread_run(syn_probe_init, (void *)ts, "SYN_PROBE_INIT");
 	return 0;
 
@@ -19,6 +19,7 @@
 #include <linux/workqueue.h>
 #include <linux/backing-dev.h>
 #include <linux/atomic.h>
+#include <linux/cpumask.h>
 #include <linux/scatterlist.h>
 #include <asm/page.h>
 #include <asm/unaligned.h>
@@ -30,6 +31,8 @@
 
 #define DM_MSG_PREFIX "crypt"
 
+struct dm_crypt_chunk;
+
 struct convert_context {
 	struct completion restart;
 	struct bio *bio_in;
@@ -39,8 +42,10 @@ struct convert_context {
 	unsigned int idx_in;
 	unsigned int idx_out;
 	sector_t sector;
+	sector_t sector_end;
 	atomic_t cc_pending;
 	struct ablkcipher_request *req;
+	struct dm_crypt_chunk *chunk;
 };
 
 struct dm_crypt_io {
@@ -63,6 +68,19 @@ struct dm_crypt_request {
 	sector_t iv_sector;
 };
 
+/*
+ * A slice of a large bio converted on another CPU.  The worker that owns
+ * the io converts the first slice itself and waits for the rest, so the
+ * io carries on exactly as after a single crypt_convert().
+ */
+struct dm_crypt_chunk {
+	struct work_struct work;
+	struct dm_crypt_io *io;
+	struct convert_context ctx;
+	atomic_t *pending;
+	struct completion *done;
+};
+
 struct crypt_config;
 
 struct crypt_iv_operations {
@@ -105,6 +123,8 @@ struct crypt_config {
 
 	struct workqueue_struct *io_queue;
 	struct workqueue_struct *crypt_queue;
+	struct workqueue_struct *chunk_queue;
+	unsigned int crypt_workers;
 
 	char *cipher;
 	char *cipher_string;
@@ -134,6 +154,9 @@ struct crypt_config {
 #define MIN_IOS        16
 #define MIN_POOL_PAGES 32
 
+#define MAX_CRYPT_WORKERS	8
+#define MIN_CHUNK_SECTORS	64
+
 static struct kmem_cache *_crypt_io_pool;
 
 static void clone_init(struct dm_crypt_io *, struct bio *);
@@ -564,6 +587,8 @@ static void crypt_convert_init(struct crypt_config *cc,
 	ctx->idx_in = bio_in ? bio_in->bi_idx : 0;
 	ctx->idx_out = bio_out ? bio_out->bi_idx : 0;
 	ctx->sector = sector + cc->iv_offset;
+	ctx->sector_end = (sector_t)-1;
+	ctx->chunk = NULL;
 	init_completion(&ctx->restart);
 }
 
@@ -666,7 +691,8 @@ static int crypt_convert(struct crypt_config *cc,
 	atomic_set(&ctx->cc_pending, 1);
 
 	while(ctx->idx_in < ctx->bio_in->bi_vcnt &&
-	      ctx->idx_out < ctx->bio_out->bi_vcnt) {
+	      ctx->idx_out < ctx->bio_out->bi_vcnt &&
+	      ctx->sector < ctx->sector_end) {
 
 		crypt_alloc_req(cc, ctx);
 
@@ -702,6 +728,131 @@ static int crypt_convert(struct crypt_config *cc,
 	return 0;
 }
 
+static void crypt_advance_bvec(struct bio *bio, unsigned int *idx,
+			       unsigned int *offset, unsigned int bytes)
+{
+	struct bio_vec *bv;
+	unsigned int len;
+
+	while (bytes) {
+		bv = bio_iovec_idx(bio, *idx);
+		len = min(bytes, bv->bv_len - *offset);
+		*offset += len;
+		bytes -= len;
+		if (*offset >= bv->bv_len) {
+			*offset = 0;
+			(*idx)++;
+		}
+	}
+}
+
+static void crypt_convert_advance(struct convert_context *ctx,
+				  unsigned int sectors)
+{
+	crypt_advance_bvec(ctx->bio_in, &ctx->idx_in, &ctx->offset_in,
+			   sectors << SECTOR_SHIFT);
+	crypt_advance_bvec(ctx->bio_out, &ctx->idx_out, &ctx->offset_out,
+			   sectors << SECTOR_SHIFT);
+	ctx->sector += sectors;
+}
+
+static void crypt_chunk_done(struct dm_crypt_chunk *chunk)
+{
+	struct crypt_config *cc = chunk->io->target->private;
+
+	if (chunk->ctx.req)
+		mempool_free(chunk->ctx.req, cc->req_pool);
+
+	if (atomic_dec_and_test(chunk->pending))
+		complete(chunk->done);
+}
+
+static void crypt_chunk_run(struct dm_crypt_chunk *chunk)
+{
+	struct crypt_config *cc = chunk->io->target->private;
+
+	if (crypt_convert(cc, &chunk->ctx) < 0)
+		chunk->io->error = -EIO;
+
+	if (atomic_dec_and_test(&chunk->ctx.cc_pending))
+		crypt_chunk_done(chunk);
+}
+
+static void kcryptd_crypt_chunk(struct work_struct *work)
+{
+	crypt_chunk_run(container_of(work, struct dm_crypt_chunk, work));
+}
+
+/*
+ * Convert the next @sectors of io->ctx, spread over up to crypt_workers
+ * CPUs when there is enough of it.  Either way it returns like
+ * crypt_convert(), but with every sector already done.
+ */
+static int crypt_convert_io(struct crypt_config *cc, struct dm_crypt_io *io,
+			    unsigned int sectors)
+{
+	struct dm_crypt_chunk chunks[MAX_CRYPT_WORKERS];
+	struct convert_context *ctx = &io->ctx;
+	struct completion done;
+	atomic_t pending;
+	unsigned int n, per, len, i;
+	int cpu;
+
+	n = min3(cc->crypt_workers, num_online_cpus(),
+		 sectors / MIN_CHUNK_SECTORS);
+	if (n < 2)
+		return crypt_convert(cc, ctx);
+
+	per = round_up(DIV_ROUND_UP(sectors, n), PAGE_SIZE >> SECTOR_SHIFT);
+	n = DIV_ROUND_UP(sectors, per);
+
+	init_completion(&done);
+	atomic_set(&pending, n);
+
+	cpu = raw_smp_processor_id();
+	for (i = 0; i < n; i++) {
+		struct dm_crypt_chunk *chunk = &chunks[i];
+
+		len = min(per, sectors);
+		chunk->io = io;
+		chunk->pending = &pending;
+		chunk->done = &done;
+		chunk->ctx.bio_in = ctx->bio_in;
+		chunk->ctx.bio_out = ctx->bio_out;
+		chunk->ctx.offset_in = ctx->offset_in;
+		chunk->ctx.offset_out = ctx->offset_out;
+		chunk->ctx.idx_in = ctx->idx_in;
+		chunk->ctx.idx_out = ctx->idx_out;
+		chunk->ctx.sector = ctx->sector;
+		chunk->ctx.sector_end = ctx->sector + len;
+		chunk->ctx.req = NULL;
+		chunk->ctx.chunk = chunk;
+		init_completion(&chunk->ctx.restart);
+
+		crypt_convert_advance(ctx, len);
+		sectors -= len;
+
+		if (!i)
+			continue;
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		INIT_WORK_ONSTACK(&chunk->work, kcryptd_crypt_chunk);
+		queue_work_on(cpu, cc->chunk_queue, &chunk->work);
+	}
+
+	crypt_chunk_run(&chunks[0]);
+	wait_for_completion(&done);
+
+	for (i = 1; i < n; i++)
+		destroy_work_on_stack(&chunks[i].work);
+
+	atomic_set(&ctx->cc_pending, 1);
+
+	return io->error < 0 ? -EIO : 0;
+}
+
 static void dm_crypt_bio_destructor(struct bio *bio)
 {
 	struct dm_crypt_io *io = bio->bi_private;
@@ -952,7 +1103,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 
 		crypt_inc_pending(io);
 
-		r = crypt_convert(cc, &io->ctx);
+		r = crypt_convert_io(cc, io, bio_sectors(clone));
 		if (r < 0)
 			io->error = -EIO;
 		crypt_finished = atomic_dec_and_test(&io->ctx.cc_pending);
@@ -1009,7 +1160,7 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
 
-	r = crypt_convert(cc, &io->ctx);
+	r = crypt_convert_io(cc, io, bio_sectors(io->base_bio));
 
 	if (r < 0)
 		io->error = -EIO;
@@ -1025,7 +1176,8 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 {
 	struct dm_crypt_request *dmreq = async_req->data;
 	struct convert_context *ctx = dmreq->ctx;
-	struct dm_crypt_io *io = container_of(ctx, struct dm_crypt_io, ctx);
+	struct dm_crypt_io *io = ctx->chunk ? ctx->chunk->io :
+				 container_of(ctx, struct dm_crypt_io, ctx);
 	struct crypt_config *cc = io->target->private;
 
 	if (error == -EINPROGRESS) {
@@ -1044,6 +1196,11 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 	if (!atomic_dec_and_test(&ctx->cc_pending))
 		return;
 
+	if (ctx->chunk) {
+		crypt_chunk_done(ctx->chunk);
+		return;
+	}
+
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_crypt_read_done(io);
 	else
@@ -1203,6 +1360,8 @@ static void crypt_dtr(struct dm_target *ti)
 		destroy_workqueue(cc->io_queue);
 	if (cc->crypt_queue)
 		destroy_workqueue(cc->crypt_queue);
+	if (cc->chunk_queue)
+		destroy_workqueue(cc->chunk_queue);
 
 	crypt_free_tfms(cc);
 
@@ -1372,7 +1531,7 @@ bad_mem:
 static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 {
 	struct crypt_config *cc;
-	unsigned int key_size, opt_params;
+	unsigned int key_size, opt_params, val;
 	unsigned long long tmpll;
 	int ret;
 	struct dm_arg_set as;
@@ -1380,7 +1539,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	char dummy;
 
 	static struct dm_arg _args[] = {
-		{0, 1, "Invalid number of feature args"},
+		{0, 2, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1464,15 +1623,25 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		if (ret)
 			goto bad;
 
-		opt_string = dm_shift_arg(&as);
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (!opt_string) {
+				ret = -EINVAL;
+				ti->error = "Not enough feature arguments";
+				goto bad;
+			}
 
-		if (opt_params == 1 && opt_string &&
-		    !strcasecmp(opt_string, "allow_discards"))
-			ti->num_discard_requests = 1;
-		else if (opt_params) {
-			ret = -EINVAL;
-			ti->error = "Invalid feature arguments";
-			goto bad;
+			if (!strcasecmp(opt_string, "allow_discards"))
+				ti->num_discard_requests = 1;
+			else if (sscanf(opt_string, "crypt_workers:%u%c",
+					&val, &dummy) == 1 &&
+				 val >= 1 && val <= MAX_CRYPT_WORKERS)
+				cc->crypt_workers = val;
+			else {
+				ret = -EINVAL;
+				ti->error = "Invalid feature arguments";
+				goto bad;
+			}
 		}
 	}
 
@@ -1496,6 +1665,17 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	if (cc->crypt_workers > 1) {
+		cc->chunk_queue = alloc_workqueue("kcryptd_chunk",
+						  WQ_CPU_INTENSIVE|
+						  WQ_MEM_RECLAIM,
+						  1);
+		if (!cc->chunk_queue) {
+			ti->error = "Couldn't create kcryptd chunk queue";
+			goto bad;
+		}
+	}
+
 	ti->num_flush_requests = 1;
 	ti->discard_zeroes_data_unsupported = 1;
 
@@ -1536,6 +1716,7 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 {
 	struct crypt_config *cc = ti->private;
 	unsigned int sz = 0;
+	unsigned int num_feature_args = 0;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -1560,8 +1741,15 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
 
-		if (ti->num_discard_requests)
-			DMEMIT(" 1 allow_discards");
+		num_feature_args += !!ti->num_discard_requests;
+		num_feature_args += cc->crypt_workers > 1;
+		if (num_feature_args) {
+			DMEMIT(" %u", num_feature_args);
+			if (ti->num_discard_requests)
+				DMEMIT(" allow_discards");
+			if (cc->crypt_workers > 1)
+				DMEMIT(" crypt_workers:%u", cc->crypt_workers);
+		}
 
 		break;
 	}
@@ -1655,7 +1843,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 11, 0},
+	.version = {1, 12, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
@@ -28,6 +28,9 @@
 
 #define DM_VERITY_MAX_LEVELS		63
 
+/* Smallest run of blocks worth verifying in a work item of its own */
+#define DM_VERITY_PARALLEL_BLOCKS	8
+
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
@@ -79,6 +82,20 @@ struct dm_verity_io {
 	struct bio_vec *io_vec;
 	unsigned io_vec_size;
 
+	/*
+	 * A bio with many blocks is verified by several dm_verity_io, each
+	 * for a range of it.  A part points to the io owning the bio and
+	 * starts at io_vec[vec_start] + vec_offset; "tail" is set when the
+	 * range runs to the end of the bio.  The owner completes the bio
+	 * when "pending" drops to zero.
+	 */
+	struct dm_verity_io *parent;
+	unsigned vec_start;
+	unsigned vec_offset;
+	bool tail;
+	atomic_t pending;
+	int error;
+
 	struct work_struct work;
 
 	/* A space for short vectors; longer vectors are allocated separately. */
@@ -281,7 +298,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 	struct dm_verity *v = io->v;
 	unsigned b;
 	int i;
-	unsigned vector = 0, offset = 0;
+	unsigned vector = io->vec_start, offset = io->vec_offset;
 
 	for (b = 0; b < io->n_blocks; b++) {
 		struct shash_desc *desc;
@@ -378,8 +395,10 @@ test_block_hash:
 			return -EIO;
 		}
 	}
-	BUG_ON(vector != io->io_vec_size);
-	BUG_ON(offset);
+	if (io->tail) {
+		BUG_ON(vector != io->io_vec_size);
+		BUG_ON(offset);
+	}
 
 	return 0;
 }
@@ -403,11 +422,87 @@ static void verity_finish_io(struct dm_verity_io *io, int error)
 	bio_endio(bio, error);
 }
 
+static void verity_range_done(struct dm_verity_io *io, int error)
+{
+	if (error)
+		cmpxchg(&io->error, 0, error);
+	if (atomic_dec_and_test(&io->pending))
+		verity_finish_io(io, io->error);
+}
+
+static void verity_part_work(struct work_struct *w)
+{
+	struct dm_verity_io *part = container_of(w, struct dm_verity_io, work);
+	struct dm_verity_io *io = part->parent;
+	int r = verity_verify_io(part);
+
+	mempool_free(part, io->v->io_mempool);
+	verity_range_done(io, r);
+}
+
+/*
+ * Hand the blocks from "start" on to a new part.  The part never waits
+ * for anything and the owner does not wait for its parts, so they can
+ * share the bounded kverityd workqueue without deadlocking.
+ */
+static bool verity_queue_part(struct dm_verity_io *io, unsigned start,
+			      unsigned n_blocks)
+{
+	struct dm_verity *v = io->v;
+	struct dm_verity_io *part;
+	unsigned vector = 0, offset = start << v->data_dev_block_bits;
+
+	part = mempool_alloc(v->io_mempool, GFP_NOWAIT | __GFP_NOWARN);
+	if (!part)
+		return false;
+
+	while (offset >= io->io_vec[vector].bv_len)
+		offset -= io->io_vec[vector++].bv_len;
+
+	part->v = v;
+	part->bio = io->bio;
+	part->block = io->block + start;
+	part->n_blocks = n_blocks;
+	part->io_vec = io->io_vec;
+	part->io_vec_size = io->io_vec_size;
+	part->parent = io;
+	part->vec_start = vector;
+	part->vec_offset = offset;
+	part->tail = start + n_blocks == io->n_blocks;
+
+	atomic_inc(&io->pending);
+	INIT_WORK(&part->work, verity_part_work);
+	queue_work(v->verify_wq, &part->work);
+	return true;
+}
+
 static void verity_work(struct work_struct *w)
 {
 	struct dm_verity_io *io = container_of(w, struct dm_verity_io, work);
+	unsigned parts, per, start;
+
+	parts = min(num_online_cpus(),
+		    io->n_blocks / DM_VERITY_PARALLEL_BLOCKS);
+	if (parts <= 1) {
+		verity_finish_io(io, verity_verify_io(io));
+		return;
+	}
 
-	verity_finish_io(io, verity_verify_io(io));
+	atomic_set(&io->pending, 1);
+	io->error = 0;
+
+	/* Parts are handed out from the end, the owner keeps what is left */
+	per = DIV_ROUND_UP(io->n_blocks, parts);
+	for (start = (parts - 1) * per; start; start -= per) {
+		if (start >= io->n_blocks)
+			continue;
+		if (!verity_queue_part(io, start, io->n_blocks - start))
+			break;
+		io->n_blocks = start;
+		io->tail = false;
+	}
+
+	verity_range_done(io, verity_verify_io(io));
 }
 
 static void verity_end_io(struct bio *bio, int error)
@@ -423,20 +518,30 @@ static void verity_end_io(struct bio *bio, int error)
 	queue_work(io->v->verify_wq, &io->work);
 }
 
+struct dm_verity_prefetch_work {
+	struct work_struct work;
+	struct dm_verity *v;
+	sector_t block;
+	unsigned n_blocks;
+};
+
 /*
  * Prefetch buffers for the specified io.
  * The root buffer is not prefetched, it is assumed that it will be cached
  * all the time.
  */
-static void verity_prefetch_io(struct dm_verity *v, struct dm_verity_io *io)
+static void verity_prefetch_io(struct work_struct *work)
 {
+	struct dm_verity_prefetch_work *pw =
+		container_of(work, struct dm_verity_prefetch_work, work);
+	struct dm_verity *v = pw->v;
 	int i;
 
 	for (i = v->levels - 2; i >= 0; i--) {
 		sector_t hash_block_start;
 		sector_t hash_block_end;
-		verity_hash_at_level(v, io->block, i, &hash_block_start, NULL);
-		verity_hash_at_level(v, io->block + io->n_blocks - 1, i, &hash_block_end, NULL);
+		verity_hash_at_level(v, pw->block, i, &hash_block_start, NULL);
+		verity_hash_at_level(v, pw->block + pw->n_blocks - 1, i, &hash_block_end, NULL);
 		if (!i) {
 			unsigned cluster = *(volatile unsigned *)&dm_verity_prefetch_cluster;
 
@@ -456,6 +561,29 @@ no_prefetch_cluster:
 		dm_bufio_prefetch(v->bufio, hash_block_start,
 				  hash_block_end - hash_block_start + 1);
 	}
+
+	kfree(pw);
+}
+
+/*
+ * dm_bufio_prefetch() may sleep allocating buffers and reading them, so
+ * it is issued from the workqueue instead of delaying the data bio.
+ * Prefetching is only an optimization, it is skipped when memory is low.
+ */
+static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io)
+{
+	struct dm_verity_prefetch_work *pw;
+
+	pw = kmalloc(sizeof(*pw), GFP_NOIO | __GFP_NORETRY | __GFP_NOMEMALLOC |
+		     __GFP_NOWARN);
+	if (!pw)
+		return;
+
+	INIT_WORK(&pw->work, verity_prefetch_io);
+	pw->v = v;
+	pw->block = io->block;
+	pw->n_blocks = io->n_blocks;
+	queue_work(v->verify_wq, &pw->work);
 }
 
 /*
@@ -493,6 +621,10 @@ static int verity_map(struct dm_target *ti, struct bio *bio,
 	io->orig_bi_private = bio->bi_private;
 	io->block = bio->bi_sector >> (v->data_dev_block_bits - SECTOR_SHIFT);
 	io->n_blocks = bio->bi_size >> v->data_dev_block_bits;
+	io->parent = NULL;
+	io->vec_start = 0;
+	io->vec_offset = 0;
+	io->tail = true;
 
 	bio->bi_end_io = verity_end_io;
 	bio->bi_private = io;
@@ -504,7 +636,7 @@ static int verity_map(struct dm_target *ti, struct bio *bio,
 	memcpy(io->io_vec, bio_iovec(bio),
 	       io->io_vec_size * sizeof(struct bio_vec));
 
-	verity_prefetch_io(v, io);
+	verity_submit_prefetch(v, io);
 
 	generic_make_request(bio);
 
@@ -3692,7 +3692,7 @@ static int __init iris_radio_init(void)
 {
 	return platform_driver_probe(&iris_driver, iris_probe);
 }
-module_init(iris_radio_init);
+deferred_initcall(iris_radio_init);
 
 static void __exit iris_radio_exit(void)
 {
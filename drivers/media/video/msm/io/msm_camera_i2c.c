@@ -10,8 +10,12 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/hash.h>
 #include "msm_camera_i2c.h"
 
+#define MSM_CAMERA_I2C_BURST_MAX	128
+#define MSM_CAMERA_I2C_SHADOW_PROBE	8
+
 #if defined(CONFIG_MACH_MONARUDO) || defined(CONFIG_MACH_DELUXE_J) || defined(CONFIG_MACH_DELUXE_R) || defined(CONFIG_MACH_IMPRESSION_J)\
 			|| defined(CONFIG_MACH_DELUXE_U) || defined(CONFIG_MACH_DELUXE_UL) || defined(CONFIG_MACH_DELUXE_UB1)\
 			|| defined(CONFIG_MACH_T6_TL) || defined(CONFIG_MACH_T6_DUG) || defined(CONFIG_MACH_T6_DWG)\
@@ -48,6 +52,73 @@ static int i2c_transfer_retry(struct i2c_adapter *adap,
 }
 #endif
 
+/* Slot of @addr, or a new one for it if @add; -1 if neither */
+static int msm_camera_i2c_shadow_slot(struct msm_camera_i2c_shadow *shadow,
+	uint16_t addr, int add)
+{
+	int slot = hash_32(addr, MSM_CAMERA_I2C_SHADOW_BITS);
+	int i;
+
+	for (i = 0; i < MSM_CAMERA_I2C_SHADOW_PROBE; i++) {
+		if (!test_bit(slot, shadow->valid)) {
+			if (!add)
+				return -1;
+			set_bit(slot, shadow->valid);
+			shadow->addr[slot] = addr;
+			return slot;
+		}
+		if (shadow->addr[slot] == addr)
+			return slot;
+		slot = (slot + 1) & (MSM_CAMERA_I2C_SHADOW_SIZE - 1);
+	}
+	return -1;
+}
+
+void msm_camera_i2c_shadow_reset(struct msm_camera_i2c_client *client)
+{
+	if (client->shadow)
+		bitmap_zero(client->shadow->valid, MSM_CAMERA_I2C_SHADOW_SIZE);
+}
+
+static void msm_camera_i2c_shadow_update(struct msm_camera_i2c_client *client,
+	unsigned char *txdata, int length)
+{
+	uint16_t addr;
+	int i, slot;
+
+	if (!client->shadow || length <= client->addr_type)
+		return;
+
+	if (client->addr_type == MSM_CAMERA_I2C_WORD_ADDR)
+		addr = txdata[0] << BITS_PER_BYTE | txdata[1];
+	else
+		addr = txdata[0];
+
+	for (i = client->addr_type; i < length; i++, addr++) {
+		slot = msm_camera_i2c_shadow_slot(client->shadow, addr, 1);
+		if (slot >= 0)
+			client->shadow->data[slot] = txdata[i];
+	}
+}
+
+static int msm_camera_i2c_shadow_same(struct msm_camera_i2c_client *client,
+	struct msm_camera_i2c_reg_conf *reg, int dt)
+{
+	int slot, i;
+
+	if (!client->shadow)
+		return 0;
+
+	for (i = 0; i < dt; i++) {
+		slot = msm_camera_i2c_shadow_slot(client->shadow,
+			reg->reg_addr + i, 0);
+		if (slot < 0 || client->shadow->data[slot] !=
+			(uint8_t)(reg->reg_data >> ((dt - 1 - i) * BITS_PER_BYTE)))
+			return 0;
+	}
+	return 1;
+}
+
 int32_t msm_camera_i2c_rxdata(struct msm_camera_i2c_client *dev_client,
 	unsigned char *rxdata, int data_length)
 {
@@ -104,8 +175,11 @@ int32_t msm_camera_i2c_txdata(struct msm_camera_i2c_client *dev_client,
 	rc = i2c_transfer(dev_client->client->adapter, msg, 1);
 #endif
 
-	if (rc < 0)
+	if (rc < 0) {
 		S_I2C_DBG("msm_camera_i2c_txdata faild 0x%x\n", saddr);
+		msm_camera_i2c_shadow_reset(dev_client);
+	} else
+		msm_camera_i2c_shadow_update(dev_client, txdata, length);
 	return 0;
 }
 
@@ -414,17 +488,77 @@ int32_t msm_camera_i2c_poll2(struct msm_camera_i2c_client *client,
 	return rc;
 }
 
-int32_t msm_camera_i2c_write_tbl(struct msm_camera_i2c_client *client,
-	struct msm_camera_i2c_reg_conf *reg_conf_tbl, uint16_t size,
+/* Byte count of a plain register write, 0 for anything else */
+static int msm_camera_i2c_plain_dt(struct msm_camera_i2c_reg_conf *reg,
 	enum msm_camera_i2c_data_type data_type)
+{
+	int dt = reg->dt ? reg->dt : data_type;
+
+	if (reg->cmd_type != MSM_CAMERA_I2C_CMD_WRITE || reg->reg_addr == 0xffff)
+		return 0;
+	if (dt != MSM_CAMERA_I2C_BYTE_DATA && dt != MSM_CAMERA_I2C_WORD_DATA)
+		return 0;
+	return dt;
+}
+
+/*
+ * Write @reg and the entries after it that continue its address range
+ * as one auto-increment burst, leaving out registers already holding
+ * their value if @skip.  Returns the number of entries done, 0 if @reg
+ * is not for this path.
+ */
+static int msm_camera_i2c_write_run(struct msm_camera_i2c_client *client,
+	struct msm_camera_i2c_reg_conf *reg, int left,
+	enum msm_camera_i2c_data_type data_type, int skip, int32_t *rc)
+{
+	uint8_t buf[MSM_CAMERA_I2C_BURST_MAX];
+	int dt = msm_camera_i2c_plain_dt(reg, data_type);
+	int n = 0, len = 0;
+
+	if (!dt || !(client->burst_tbl || (skip && client->shadow)))
+		return 0;
+
+	if (skip && msm_camera_i2c_shadow_same(client, reg, dt)) {
+		*rc = 0;
+		return 1;
+	}
+
+	do {
+		if (dt == MSM_CAMERA_I2C_WORD_DATA)
+			buf[len++] = reg[n].reg_data >> BITS_PER_BYTE;
+		buf[len++] = reg[n].reg_data;
+		n++;
+	} while (client->burst_tbl && n < left &&
+		msm_camera_i2c_plain_dt(&reg[n], data_type) == dt &&
+		reg[n].reg_addr == reg->reg_addr + len &&
+		len + dt <= MSM_CAMERA_I2C_BURST_MAX &&
+		!(skip && msm_camera_i2c_shadow_same(client, &reg[n], dt)));
+
+	if (n == 1)
+		*rc = msm_camera_i2c_write(client, reg->reg_addr,
+			reg->reg_data, dt);
+	else
+		*rc = msm_camera_i2c_write_seq(client, reg->reg_addr, buf, len);
+	return n;
+}
+
+static int32_t __msm_camera_i2c_write_tbl(struct msm_camera_i2c_client *client,
+	struct msm_camera_i2c_reg_conf *reg_conf_tbl, uint16_t size,
+	enum msm_camera_i2c_data_type data_type, int skip)
 {
 #define MIN(a,b) ((a)>(b)?(b):(a))
 	int i,write_len,burst_size=128,remain_len=0,addr=0;
 	uint8_t* buf=0;
 	int32_t rc = -EFAULT;
+	int n;
 	for (i = 0; i < size; i++) {
 		enum msm_camera_i2c_data_type dt;
-		if (reg_conf_tbl->cmd_type == MSM_CAMERA_I2C_CMD_POLL) {
+		n = msm_camera_i2c_write_run(client, reg_conf_tbl, size - i,
+			data_type, skip, &rc);
+		if (n > 0) {
+			i += n - 1;
+			reg_conf_tbl += n - 1;
+		} else if (reg_conf_tbl->cmd_type == MSM_CAMERA_I2C_CMD_POLL) {
 			rc = msm_camera_i2c_poll(client, reg_conf_tbl->reg_addr,
 				reg_conf_tbl->reg_data, reg_conf_tbl->dt);
 		} 
@@ -509,6 +643,14 @@ int32_t msm_camera_i2c_write_tbl(struct msm_camera_i2c_client *client,
 	return rc;
 }
 
+int32_t msm_camera_i2c_write_tbl(struct msm_camera_i2c_client *client,
+	struct msm_camera_i2c_reg_conf *reg_conf_tbl, uint16_t size,
+	enum msm_camera_i2c_data_type data_type)
+{
+	return __msm_camera_i2c_write_tbl(client, reg_conf_tbl, size,
+		data_type, 0);
+}
+
 int32_t msm_camera_i2c_read_b(struct msm_camera_i2c_client *client,
 	uint16_t addr, uint16_t *data)
 {
@@ -604,14 +746,15 @@ int32_t msm_camera_i2c_read_seq(struct msm_camera_i2c_client *client,
 	return rc;
 }
 
-int32_t msm_sensor_write_conf_array(struct msm_camera_i2c_client *client,
-			struct msm_camera_i2c_conf_array *array, uint16_t index)
+static int32_t __msm_sensor_write_conf_array(
+	struct msm_camera_i2c_client *client,
+	struct msm_camera_i2c_conf_array *array, uint16_t index, int skip)
 {
 	int32_t rc;
 
-	rc = msm_camera_i2c_write_tbl(client,
+	rc = __msm_camera_i2c_write_tbl(client,
 		(struct msm_camera_i2c_reg_conf *) array[index].conf,
-		array[index].size, array[index].data_type);
+		array[index].size, array[index].data_type, skip);
 	if (array[index].delay > 20)
 		msleep(array[index].delay);
 	else
@@ -620,6 +763,19 @@ int32_t msm_sensor_write_conf_array(struct msm_camera_i2c_client *client,
 	return rc;
 }
 
+int32_t msm_sensor_write_conf_array(struct msm_camera_i2c_client *client,
+			struct msm_camera_i2c_conf_array *array, uint16_t index)
+{
+	return __msm_sensor_write_conf_array(client, array, index, 0);
+}
+
+/* A mode table: registers that already hold their value are left out */
+int32_t msm_sensor_write_mode_conf_array(struct msm_camera_i2c_client *client,
+			struct msm_camera_i2c_conf_array *array, uint16_t index)
+{
+	return __msm_sensor_write_conf_array(client, array, index, 1);
+}
+
 int32_t msm_sensor_write_enum_conf_array(struct msm_camera_i2c_client *client,
 			struct msm_camera_i2c_enum_conf_array *conf,
 			uint16_t enum_val)
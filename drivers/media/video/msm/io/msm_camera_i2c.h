@@ -30,9 +30,25 @@ enum msm_camera_i2c_reg_addr_type {
 	MSM_CAMERA_I2C_WORD_ADDR,
 };
 
+#define MSM_CAMERA_I2C_SHADOW_BITS	9
+#define MSM_CAMERA_I2C_SHADOW_SIZE	(1 << MSM_CAMERA_I2C_SHADOW_BITS)
+
+/*
+ * Last byte written to each register address since the init table, so
+ * that mode tables can leave out what the sensor already holds.
+ */
+struct msm_camera_i2c_shadow {
+	uint16_t addr[MSM_CAMERA_I2C_SHADOW_SIZE];
+	uint8_t data[MSM_CAMERA_I2C_SHADOW_SIZE];
+	DECLARE_BITMAP(valid, MSM_CAMERA_I2C_SHADOW_SIZE);
+};
+
 struct msm_camera_i2c_client {
 	struct i2c_client *client;
 	enum msm_camera_i2c_reg_addr_type addr_type;
+	/* Registers auto-increment: tables may merge runs into one write */
+	uint8_t burst_tbl;
+	struct msm_camera_i2c_shadow *shadow;
 };
 
 enum msm_camera_i2c_data_type {
@@ -122,9 +138,14 @@ int32_t msm_camera_i2c_write_tbl(struct msm_camera_i2c_client *client,
 	struct msm_camera_i2c_reg_conf *reg_conf_tbl, uint16_t size,
 	enum msm_camera_i2c_data_type data_type);
 
+void msm_camera_i2c_shadow_reset(struct msm_camera_i2c_client *client);
+
 int32_t msm_sensor_write_conf_array(struct msm_camera_i2c_client *client,
 	struct msm_camera_i2c_conf_array *array, uint16_t index);
 
+int32_t msm_sensor_write_mode_conf_array(struct msm_camera_i2c_client *client,
+	struct msm_camera_i2c_conf_array *array, uint16_t index);
+
 int32_t msm_sensor_write_enum_conf_array(struct msm_camera_i2c_client *client,
 	struct msm_camera_i2c_enum_conf_array *conf, uint16_t enum_val);
 
@@ -1301,6 +1301,7 @@ static int msm_camera_v4l2_streamoff(struct file *f, void *pctx,
 	
 	rc = vb2_streamoff(&pcam_inst->vid_bufq, buf_type);
 	D("%s, videobuf_streamoff returns %d\n", __func__, rc);
+	msm_mctl_buf_stats(pcam_inst);
 	mutex_unlock(&pcam_inst->inst_lock);
 	mutex_unlock(&pcam->vid_lock);
 
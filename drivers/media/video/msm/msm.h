@@ -20,6 +20,7 @@
 #include <linux/i2c.h>
 #include <linux/videodev2.h>
 #include <linux/pm_qos.h>
+#include <linux/ktime.h>
 #include <media/v4l2-dev.h>
 #include <media/v4l2-ioctl.h>
 #include <media/v4l2-device.h>
@@ -135,6 +136,8 @@ struct isp_msg_output {
 	uint8_t   output_id;
 	struct msm_free_buf buf;
 	uint32_t  frameCounter;
+	/* Buffer done only, the batch's last frame carries the event */
+	uint8_t   skip_event;
 };
 
 struct rdi_count_msg {
@@ -192,6 +195,7 @@ struct msm_frame_buffer {
 	enum v4l2_mbus_pixelcode  pxlcode;
 	enum msm_buffer_state state;
 	int active;
+	ktime_t reserve_time;
 };
 
 struct msm_isp_color_fmt {
@@ -345,6 +349,13 @@ struct msm_cam_v4l2_dev_inst {
 	int vbqueue_initialized;
     struct mutex inst_lock;
 	int no_free_buf_cnt; 
+	/* Reserved buffers by vb2 index, matched on buf_done */
+	struct msm_frame_buffer *buf_slot[VIDEO_MAX_FRAME];
+	uint32_t slot_paddr[VIDEO_MAX_FRAME];
+	uint32_t frame_cnt;
+	uint32_t frame_drop_cnt;
+	uint32_t latency_max_us;
+	uint64_t latency_sum_us;
 };
 
 struct msm_cam_mctl_node {
@@ -555,6 +566,7 @@ struct msm_frame_buffer *msm_mctl_buf_find(
 	struct msm_cam_v4l2_dev_inst *pcam_inst, int del_buf,
 	int msg_type, struct msm_free_buf *fbuf);
 void msm_mctl_gettimeofday(struct timeval *tv);
+void msm_mctl_buf_stats(struct msm_cam_v4l2_dev_inst *pcam_inst);
 struct msm_frame_buffer *msm_mctl_get_free_buf(
 		struct msm_cam_media_controller *pmctl,
 		int msg_type);
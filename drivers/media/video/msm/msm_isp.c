@@ -468,7 +468,10 @@ static int msm_isp_notify_vfe(struct v4l2_subdev *sd,
 			BUG_ON(image_mode  < 0);
 			msm_mctl_buf_done(pmctl, image_mode ,
 				&buf, isp_output->frameCounter);
-			
+			if (isp_output->skip_event) {
+				kfree(isp_event);
+				return rc;
+			}
             }
 		}
 		}
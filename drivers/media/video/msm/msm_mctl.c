@@ -1595,6 +1595,7 @@ static int msm_mctl_v4l2_streamoff(struct file *f, void *pctx,
 	
 	rc = vb2_streamoff(&pcam_inst->vid_bufq, buf_type);
 	D("%s, videobuf_streamoff returns %d\n", __func__, rc);
+	msm_mctl_buf_stats(pcam_inst);
 	mutex_unlock(&pcam_inst->inst_lock);
 	mutex_unlock(&pcam->mctl_node.dev_lock);
 	return rc;
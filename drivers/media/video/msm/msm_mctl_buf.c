@@ -18,6 +18,7 @@
 #include <linux/spinlock.h>
 #include <linux/videodev2.h>
 #include <linux/vmalloc.h>
+#include <linux/math64.h>
 
 #include <media/v4l2-dev.h>
 #include <media/v4l2-ioctl.h>
@@ -219,6 +220,11 @@ static void msm_vb2_ops_buf_cleanup(struct vb2_buffer *vb)
 	pcam = pcam_inst->pcam;
 	buf = container_of(vb, struct msm_frame_buffer, vidbuf);
 
+	spin_lock_irqsave(&pcam_inst->vq_irqlock, flags);
+	if (vb->v4l2_buf.index < VIDEO_MAX_FRAME)
+		pcam_inst->buf_slot[vb->v4l2_buf.index] = NULL;
+	spin_unlock_irqrestore(&pcam_inst->vq_irqlock, flags);
+
 	if (pcam_inst->vid_fmt.type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
 		for (i = 0; i < vb->num_planes; i++) {
 			mem = vb2_plane_cookie(vb, i);
@@ -380,6 +386,49 @@ void msm_mctl_gettimeofday(struct timeval *tv)
 	tv->tv_usec = ts.tv_nsec/1000;
 }
 
+/*
+ * Look a done address up among the buffers handed to the VFE by
+ * msm_mctl_reserve_free_buf.  Called with vq_irqlock held.
+ */
+static struct msm_frame_buffer *msm_mctl_buf_slot_find(
+	struct msm_cam_v4l2_dev_inst *pcam_inst, uint32_t paddr,
+	int del_buf)
+{
+	struct msm_frame_buffer *buf;
+	int i, cnt = min(pcam_inst->buf_count, VIDEO_MAX_FRAME);
+
+	for (i = 0; i < cnt; i++) {
+		buf = pcam_inst->buf_slot[i];
+		if (!buf || pcam_inst->slot_paddr[i] != paddr)
+			continue;
+		if (del_buf)
+			pcam_inst->buf_slot[i] = NULL;
+		if (buf->state != MSM_BUFFER_STATE_RESERVED ||
+			list_empty(&buf->list))
+			return NULL;
+		return buf;
+	}
+	return NULL;
+}
+
+void msm_mctl_buf_stats(struct msm_cam_v4l2_dev_inst *pcam_inst)
+{
+	if (!pcam_inst->frame_cnt && !pcam_inst->frame_drop_cnt)
+		return;
+
+	pr_info("%s: inst=%p image_mode=%d frames=%u dropped=%u "
+		"latency avg=%lluus max=%uus\n", __func__, pcam_inst,
+		pcam_inst->image_mode, pcam_inst->frame_cnt,
+		pcam_inst->frame_drop_cnt,
+		pcam_inst->frame_cnt ? div_u64(pcam_inst->latency_sum_us,
+			pcam_inst->frame_cnt) : 0,
+		pcam_inst->latency_max_us);
+	pcam_inst->frame_cnt = 0;
+	pcam_inst->frame_drop_cnt = 0;
+	pcam_inst->latency_max_us = 0;
+	pcam_inst->latency_sum_us = 0;
+}
+
 struct msm_frame_buffer *msm_mctl_buf_find(
 	struct msm_cam_media_controller *pmctl,
 	struct msm_cam_v4l2_dev_inst *pcam_inst, int del_buf,
@@ -393,12 +442,20 @@ struct msm_frame_buffer *msm_mctl_buf_find(
 
 	
 	spin_lock_irqsave(&pcam_inst->vq_irqlock, flags);
+	buf = msm_mctl_buf_slot_find(pcam_inst, fbuf->ch_paddr[0], del_buf);
+	if (buf) {
+		if (del_buf)
+			list_del_init(&buf->list);
+		spin_unlock_irqrestore(&pcam_inst->vq_irqlock, flags);
+		return buf;
+	}
 	list_for_each_entry_safe(buf, tmp,
 			&pcam_inst->free_vq, list) {
 		buf_idx = buf->vidbuf.v4l2_buf.index;
 		mem = vb2_plane_cookie(&buf->vidbuf, 0);
 		if (!mem) { 
 			pr_err("%s: null pointer check, line(%d)", __func__, __LINE__);
+			spin_unlock_irqrestore(&pcam_inst->vq_irqlock, flags);
 			return NULL;
 		} 
 		if (mem->buffer_type ==	VIDEOBUF2_MULTIPLE_PLANES)
@@ -436,6 +493,7 @@ int msm_mctl_buf_done_proc(
 	struct msm_frame_buffer *buf = NULL;
 	int del_buf = 1;
 	struct videobuf2_contig_pmem *mem;
+	uint32_t latency;
 
 	buf = msm_mctl_buf_find(pmctl, pcam_inst, del_buf,
 					image_mode, fbuf);
@@ -445,6 +503,16 @@ int msm_mctl_buf_done_proc(
 		return -EINVAL;
 	}
 
+	if (ktime_to_ns(buf->reserve_time)) {
+		latency = (uint32_t)ktime_us_delta(ktime_get(),
+			buf->reserve_time);
+		buf->reserve_time = ktime_set(0, 0);
+		pcam_inst->latency_sum_us += latency;
+		if (latency > pcam_inst->latency_max_us)
+			pcam_inst->latency_max_us = latency;
+	}
+	pcam_inst->frame_cnt++;
+
 	mem = vb2_plane_cookie(&buf->vidbuf, 0);
 	if (!mem) {
 		pr_err("%s: mem is null\n",__func__);
@@ -688,6 +756,11 @@ int msm_mctl_reserve_free_buf(
 		}
 		free_buf->vb = (uint32_t)buf;
 		buf->state = MSM_BUFFER_STATE_RESERVED;
+		buf->reserve_time = ktime_get();
+		if (buf_idx < VIDEO_MAX_FRAME) {
+			pcam_inst->buf_slot[buf_idx] = buf;
+			pcam_inst->slot_paddr[buf_idx] = free_buf->ch_paddr[0];
+		}
 		if (pcam_inst->no_free_buf_cnt) {
 			pcam_inst->no_free_buf_cnt = 0;
 			pr_info("%s: inst=0x%p, idx=%d, paddr=0x%x, "
@@ -700,6 +773,7 @@ int msm_mctl_reserve_free_buf(
 	}
 	if (rc != 0) {
 		++pcam_inst->no_free_buf_cnt;
+		++pcam_inst->frame_drop_cnt;
 		if (pcam_inst->no_free_buf_cnt < 50 ||
 			pcam_inst->no_free_buf_cnt % 5 == 0)
 			pr_info("%s: No free buffer available: image_mode=%d inst = 0x%p, cnt %d\n",
@@ -736,6 +810,15 @@ int msm_mctl_return_free_buf(struct msm_cam_media_controller *pmctl,
 
     spin_lock_irqsave(&pcam_inst->vq_irqlock, flags);
 
+    pcam_inst->frame_drop_cnt++;
+    buf = msm_mctl_buf_slot_find(pcam_inst, free_buf->ch_paddr[0], 1);
+    if (buf) {
+        buf->state = MSM_BUFFER_STATE_QUEUED;
+        buf->reserve_time = ktime_set(0, 0);
+        spin_unlock_irqrestore(&pcam_inst->vq_irqlock, flags);
+        return 0;
+    }
+
     if (!list_empty(&pcam_inst->free_vq)) {
         list_for_each_entry(buf, &pcam_inst->free_vq, list) {
             buf_phyaddr =
@@ -3432,6 +3432,12 @@ static void vfe_send_outmsg(struct v4l2_subdev *sd, uint8_t msgid,
 		break;
 	}
 
+	/* HFR video: one config event per hfr_mode frames, like SOF */
+	msg.skip_event = (vfe32_ctrl->hfr_mode != HFR_MODE_OFF) &&
+		(vfe32_ctrl->operation_mode == VFE_MODE_OF_OPERATION_VIDEO) &&
+		(msgid != MSG_ID_OUTPUT_TERTIARY1) &&
+		(msg.frameCounter % vfe32_ctrl->hfr_mode != 0);
+
 	v4l2_subdev_notify(&vfe32_ctrl->subdev,
 			NOTIFY_VFE_MSG_OUT,
 			&msg);
@@ -1070,8 +1070,12 @@ static struct i2c_driver imx175_i2c_driver = {
 	},
 };
 
+static struct msm_camera_i2c_shadow imx175_i2c_shadow;
+
 static struct msm_camera_i2c_client imx175_sensor_i2c_client = {
 	.addr_type = MSM_CAMERA_I2C_WORD_ADDR,
+	.burst_tbl = 1,
+	.shadow = &imx175_i2c_shadow,
 };
 
 int32_t imx175_power_up(struct msm_sensor_ctrl_t *s_ctrl)
@@ -163,6 +163,8 @@ int32_t msm_sensor_write_init_settings(struct msm_sensor_ctrl_t *s_ctrl)
 	int32_t rc;
 	CDBG("%s: called\n", __func__);
 
+	msm_camera_i2c_shadow_reset(s_ctrl->sensor_i2c_client);
+
 	if ((s_ctrl->sensordata->htc_image == HTC_CAMERA_IMAGE_YUSHANII_BOARD) && (s_ctrl->msm_sensor_reg->init_settings_yushanii))
 	{
 		rc = msm_sensor_write_all_conf_array(
@@ -185,7 +187,7 @@ int32_t msm_sensor_write_res_settings(struct msm_sensor_ctrl_t *s_ctrl,
 	int32_t rc;
 	CDBG("%s: called\n", __func__);
 
-	rc = msm_sensor_write_conf_array(
+	rc = msm_sensor_write_mode_conf_array(
 		s_ctrl->sensor_i2c_client,
 		s_ctrl->msm_sensor_reg->mode_settings, res);
 	if (rc < 0)
@@ -427,7 +429,7 @@ int32_t msm_sensor_setting3(struct msm_sensor_ctrl_t *s_ctrl,
 		if (res == 0)
 			return 0;
 		if (!csi_config) {
-			msm_sensor_write_conf_array(
+			msm_sensor_write_mode_conf_array(
 				s_ctrl->sensor_i2c_client,
 				s_ctrl->msm_sensor_reg->mode_settings, res);
 			msleep(30);
@@ -600,7 +602,7 @@ int32_t msm_sensor_setting1(struct msm_sensor_ctrl_t *s_ctrl,
 		csi_config = 0;
 	} else if (update_type == MSM_SENSOR_UPDATE_PERIODIC) {
 		CDBG("PERIODIC : %d\n", res);
-		msm_sensor_write_conf_array(
+		msm_sensor_write_mode_conf_array(
 			s_ctrl->sensor_i2c_client,
 			s_ctrl->msm_sensor_reg->mode_settings, res);
 		msleep(30);
@@ -835,10 +837,33 @@ int32_t msm_sensor_setting_parallel(struct msm_sensor_ctrl_t *s_ctrl,
 	return rc;
 }
 
+static unsigned int stream_on_budget_ms = 150;
+module_param(stream_on_budget_ms, uint, 0644);
+
+/* Phases of a mode switch, logged when the whole took over the budget */
+static void msm_sensor_stream_on_times(int res, ktime_t start, ktime_t stop,
+	ktime_t mode, ktime_t csi)
+{
+	ktime_t end = ktime_get();
+	s64 total = ktime_to_ms(ktime_sub(end, start));
+
+	if (total < stream_on_budget_ms) {
+		CDBG("%s: res %d in %lld ms\n", __func__, res, total);
+		return;
+	}
+	pr_info("%s: res %d took %lld ms: stop %lld mode %lld csi %lld "
+		"start %lld\n", __func__, res, total,
+		ktime_to_ms(ktime_sub(stop, start)),
+		ktime_to_ms(ktime_sub(mode, stop)),
+		ktime_to_ms(ktime_sub(csi, mode)),
+		ktime_to_ms(ktime_sub(end, csi)));
+}
+
 int32_t msm_sensor_setting(struct msm_sensor_ctrl_t *s_ctrl,
 			int update_type, int res)
 {
 	int32_t rc = 0;
+	ktime_t t_start, t_stop, t_mode, t_csi;
 
 #ifdef CONFIG_RAWCHIP
 	struct rawchip_sensor_data rawchip_data;
@@ -846,6 +871,7 @@ int32_t msm_sensor_setting(struct msm_sensor_ctrl_t *s_ctrl,
 #endif
 
 	pr_info("%s: update_type=%d, res=%d\n", __func__, update_type, res);
+	t_start = ktime_get();
 
 	switch (s_ctrl->intf) {
 	case RDI0:
@@ -863,11 +889,15 @@ int32_t msm_sensor_setting(struct msm_sensor_ctrl_t *s_ctrl,
 	s_ctrl->func_tbl->sensor_stop_stream(s_ctrl);
 
 	msleep(30);
+	t_stop = ktime_get();
 	if (update_type == MSM_SENSOR_REG_INIT) {
 		s_ctrl->curr_csi_params = NULL;
 		msm_sensor_enable_debugfs(s_ctrl);
 		msm_sensor_write_init_settings(s_ctrl);
 		s_ctrl->first_init = 1;
+		CDBG("%s: stop %lld init %lld ms\n", __func__,
+			ktime_to_ms(ktime_sub(t_stop, t_start)),
+			ktime_to_ms(ktime_sub(ktime_get(), t_stop)));
 	} else if (update_type == MSM_SENSOR_UPDATE_PERIODIC) {
 		
 		if(!s_ctrl->first_init)
@@ -875,6 +905,7 @@ int32_t msm_sensor_setting(struct msm_sensor_ctrl_t *s_ctrl,
 		s_ctrl->first_init = 0;
 
 		msm_sensor_write_res_settings(s_ctrl, res);
+		t_mode = ktime_get();
 		if (s_ctrl->curr_csi_params != s_ctrl->csi_params[res]) {
 			s_ctrl->curr_csi_params = s_ctrl->csi_params[res];
 			s_ctrl->curr_csi_params->csid_params.lane_assign =
@@ -933,6 +964,7 @@ int32_t msm_sensor_setting(struct msm_sensor_ctrl_t *s_ctrl,
 			}
 #endif
 
+		t_csi = ktime_get();
 
 		v4l2_subdev_notify(&s_ctrl->sensor_v4l2_subdev,
 			NOTIFY_PCLK_CHANGE, &s_ctrl->msm_sensor_reg->
@@ -951,6 +983,7 @@ int32_t msm_sensor_setting(struct msm_sensor_ctrl_t *s_ctrl,
 		}
 		s_ctrl->func_tbl->sensor_start_stream(s_ctrl);
 		msleep(30);
+		msm_sensor_stream_on_times(res, t_start, t_stop, t_mode, t_csi);
 	}
 	return rc;
 }
@@ -1871,6 +1904,8 @@ int32_t msm_sensor_power_down(struct msm_sensor_ctrl_t *s_ctrl)
 	struct msm_camera_sensor_info *data = s_ctrl->sensordata;
 	CDBG("%s: called %d\n", __func__, __LINE__);
 
+	msm_camera_i2c_shadow_reset(s_ctrl->sensor_i2c_client);
+
 	if (data->sensor_platform_info->i2c_conf &&
 		data->sensor_platform_info->i2c_conf->use_i2c_mux)
 		msm_sensor_disable_i2c_mux(
@@ -249,8 +249,12 @@ static int s5k6a1gx_sysfs_init(void)
 	return 0 ;
 }
 
+static struct msm_camera_i2c_shadow s5k6a1gx_i2c_shadow;
+
 static struct msm_camera_i2c_client s5k6a1gx_sensor_i2c_client = {
 	.addr_type = MSM_CAMERA_I2C_WORD_ADDR,
+	.burst_tbl = 1,
+	.shadow = &s5k6a1gx_i2c_shadow,
 };
 
 int32_t s5k6a1gx_power_up(struct msm_sensor_ctrl_t *s_ctrl)
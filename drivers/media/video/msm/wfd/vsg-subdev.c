@@ -62,25 +62,10 @@ static void vsg_set_last_buffer(struct vsg_context *context,
 			(void *)buf->mdp_buf_info.paddr);
 }
 
-static void vsg_encode_helper_func(struct work_struct *task)
-{
-	struct vsg_encode_work *work =
-		container_of(task, struct vsg_encode_work, work);
-
-	int rc = vsg_encode_frame(work->context, work->buf);
-	if (rc < 0) {
-		mutex_lock(&work->context->mutex);
-		work->context->state = VSG_STATE_ERROR;
-		mutex_unlock(&work->context->mutex);
-	}
-	kfree(work);
-}
-
 static void vsg_work_func(struct work_struct *task)
 {
 	struct vsg_work *work =
 		container_of(task, struct vsg_work, work);
-	struct vsg_encode_work *encode_work;
 	struct vsg_context *context = work->context;
 	struct vsg_buf_info *buf_info = NULL, *temp = NULL;
 	int rc = 0, count = 0;
@@ -126,18 +111,6 @@ static void vsg_work_func(struct work_struct *task)
 		context->last_buffer->flags |= VSG_NEVER_RELEASE;
 	}
 
-	encode_work = kmalloc(sizeof(*encode_work), GFP_KERNEL);
-	encode_work->buf = buf_info;
-	encode_work->context = context;
-	INIT_WORK(&encode_work->work, vsg_encode_helper_func);
-	rc = queue_work(context->work_queue, &encode_work->work);
-	if (!rc) {
-		WFD_MSG_ERR("Queueing buffer for encode failed\n");
-		kfree(encode_work);
-		encode_work = NULL;
-		goto err_skip_encode;
-	}
-
 	buf_info->flags |= VSG_BUF_BEING_ENCODED;
 	if (!(buf_info->flags & VSG_NEVER_SET_LAST_BUFFER)) {
 		if (context->last_buffer) {
@@ -161,6 +134,21 @@ static void vsg_work_func(struct work_struct *task)
 	}
 
 	list_add_tail(&buf_info->node, &context->busy_queue.node);
+	mutex_unlock(&context->mutex);
+
+	/*
+	 * The workqueue is single threaded, so encodes still go out in
+	 * busy_queue order; buf_info stays there until the encoder
+	 * returns it.
+	 */
+	rc = vsg_encode_frame(context, buf_info);
+	if (rc < 0) {
+		mutex_lock(&context->mutex);
+		context->state = VSG_STATE_ERROR;
+		mutex_unlock(&context->mutex);
+	}
+	kfree(work);
+	return;
 err_skip_encode:
 	mutex_unlock(&context->mutex);
 	kfree(work);
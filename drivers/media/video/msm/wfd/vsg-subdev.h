@@ -73,12 +73,6 @@ struct vsg_work {
 	struct work_struct work;
 };
 
-struct vsg_encode_work {
-	struct vsg_buf_info *buf;
-	struct vsg_context *context;
-	struct work_struct work;
-};
-
 #define VSG_OPEN  _IO(VSG_MAGIC_IOCTL, 1)
 #define VSG_CLOSE  _IO(VSG_MAGIC_IOCTL, 2)
 #define VSG_START  _IO(VSG_MAGIC_IOCTL, 3)
@@ -17,6 +17,8 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/bitops.h>
 #include <linux/string.h>
 #include <linux/err.h>
 #include <linux/msm_ssbi.h>
@@ -52,6 +54,12 @@
 #define REG_PM8921_PON_CNTRL_3	0x01D
 #define PM8921_RESTART_REASON_MASK	0x07
 
+#define PM8921_CACHE_REGS	0x400
+
+static const u16 pm8921_const_regs[] = {
+	REG_HWSUBREV, REG_HWREV, REG_HWREV_2,
+};
+
 #define SINGLE_IRQ_RESOURCE(_name, _irq) \
 { \
 	.name	= _name, \
@@ -66,24 +74,70 @@ struct pm8921 {
 	struct mfd_cell					*mfd_regulators;
 	struct pm8xxx_regulator_core_platform_data	*regulator_cdata;
 	u32						rev_registers;
+	spinlock_t					cache_lock;
+	DECLARE_BITMAP(cache_regs, PM8921_CACHE_REGS);
+	DECLARE_BITMAP(cache_valid, PM8921_CACHE_REGS);
+	u8						cache[PM8921_CACHE_REGS];
 };
 
 static struct pm8921 *pmic8921_chip;
 
+static inline bool pm8921_cached(const struct pm8921 *pmic, u16 addr)
+{
+	return addr < PM8921_CACHE_REGS && test_bit(addr, pmic->cache_regs);
+}
+
+/*
+ * Cached registers are accessed with cache_lock held so that a read
+ * racing with a write cannot leave the old value in the shadow copy.
+ */
 static int pm8921_readb(const struct device *dev, u16 addr, u8 *val)
 {
 	const struct pm8xxx_drvdata *pm8921_drvdata = dev_get_drvdata(dev);
-	const struct pm8921 *pmic = pm8921_drvdata->pm_chip_data;
+	struct pm8921 *pmic = pm8921_drvdata->pm_chip_data;
+	unsigned long flags;
+	int rc;
+
+	if (!pm8921_cached(pmic, addr))
+		return msm_ssbi_read(pmic->dev->parent, addr, val, 1);
 
-	return msm_ssbi_read(pmic->dev->parent, addr, val, 1);
+	spin_lock_irqsave(&pmic->cache_lock, flags);
+	if (test_bit(addr, pmic->cache_valid)) {
+		*val = pmic->cache[addr];
+		rc = 0;
+	} else {
+		rc = msm_ssbi_read(pmic->dev->parent, addr, val, 1);
+		if (!rc) {
+			pmic->cache[addr] = *val;
+			set_bit(addr, pmic->cache_valid);
+		}
+	}
+	spin_unlock_irqrestore(&pmic->cache_lock, flags);
+
+	return rc;
 }
 
 static int pm8921_writeb(const struct device *dev, u16 addr, u8 val)
 {
 	const struct pm8xxx_drvdata *pm8921_drvdata = dev_get_drvdata(dev);
-	const struct pm8921 *pmic = pm8921_drvdata->pm_chip_data;
+	struct pm8921 *pmic = pm8921_drvdata->pm_chip_data;
+	unsigned long flags;
+	int rc;
 
-	return msm_ssbi_write(pmic->dev->parent, addr, &val, 1);
+	if (!pm8921_cached(pmic, addr))
+		return msm_ssbi_write(pmic->dev->parent, addr, &val, 1);
+
+	spin_lock_irqsave(&pmic->cache_lock, flags);
+	rc = msm_ssbi_write(pmic->dev->parent, addr, &val, 1);
+	if (!rc) {
+		pmic->cache[addr] = val;
+		set_bit(addr, pmic->cache_valid);
+	} else {
+		clear_bit(addr, pmic->cache_valid);
+	}
+	spin_unlock_irqrestore(&pmic->cache_lock, flags);
+
+	return rc;
 }
 
 static int pm8921_read_buf(const struct device *dev, u16 addr, u8 *buf,
@@ -95,13 +149,69 @@ static int pm8921_read_buf(const struct device *dev, u16 addr, u8 *buf,
 	return msm_ssbi_read(pmic->dev->parent, addr, buf, cnt);
 }
 
+/* Buffers repeat one address, just drop the shadow of a cached one */
+
 static int pm8921_write_buf(const struct device *dev, u16 addr, u8 *buf,
 									int cnt)
 {
 	const struct pm8xxx_drvdata *pm8921_drvdata = dev_get_drvdata(dev);
-	const struct pm8921 *pmic = pm8921_drvdata->pm_chip_data;
+	struct pm8921 *pmic = pm8921_drvdata->pm_chip_data;
+	unsigned long flags;
+	int rc;
+
+	if (!pm8921_cached(pmic, addr))
+		return msm_ssbi_write(pmic->dev->parent, addr, buf, cnt);
+
+	spin_lock_irqsave(&pmic->cache_lock, flags);
+	clear_bit(addr, pmic->cache_valid);
+	rc = msm_ssbi_write(pmic->dev->parent, addr, buf, cnt);
+	spin_unlock_irqrestore(&pmic->cache_lock, flags);
+
+	return rc;
+}
 
-	return msm_ssbi_write(pmic->dev->parent, addr, buf, cnt);
+static int pm8921_xfer(const struct device *dev, struct msm_ssbi_xfer *xfer,
+								int n)
+{
+	const struct pm8xxx_drvdata *pm8921_drvdata = dev_get_drvdata(dev);
+	struct pm8921 *pmic = pm8921_drvdata->pm_chip_data;
+	unsigned long flags;
+	int i, rc;
+
+	spin_lock_irqsave(&pmic->cache_lock, flags);
+	rc = msm_ssbi_xfer(pmic->dev->parent, xfer, n);
+	for (i = 0; i < n; i++) {
+		if (!pm8921_cached(pmic, xfer[i].addr))
+			continue;
+		if (rc) {
+			clear_bit(xfer[i].addr, pmic->cache_valid);
+			continue;
+		}
+		pmic->cache[xfer[i].addr] = xfer[i].val;
+		set_bit(xfer[i].addr, pmic->cache_valid);
+	}
+	spin_unlock_irqrestore(&pmic->cache_lock, flags);
+
+	return rc;
+}
+
+static int pm8921_cache_regs(const struct device *dev, const u16 *addr, int n)
+{
+	const struct pm8xxx_drvdata *pm8921_drvdata = dev_get_drvdata(dev);
+	struct pm8921 *pmic = pm8921_drvdata->pm_chip_data;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (addr[i] >= PM8921_CACHE_REGS)
+			return -EINVAL;
+
+	spin_lock_irqsave(&pmic->cache_lock, flags);
+	for (i = 0; i < n; i++)
+		set_bit(addr[i], pmic->cache_regs);
+	spin_unlock_irqrestore(&pmic->cache_lock, flags);
+
+	return 0;
 }
 
 static int pm8921_read_irq_stat(const struct device *dev, int irq)
@@ -146,6 +256,8 @@ static struct pm8xxx_drvdata pm8921_drvdata = {
 	.pmic_read_irq_stat	= pm8921_read_irq_stat,
 	.pmic_get_version	= pm8921_get_version,
 	.pmic_get_revision	= pm8921_get_revision,
+	.pmic_xfer		= pm8921_xfer,
+	.pmic_cache_regs	= pm8921_cache_regs,
 };
 
 static struct resource gpio_cell_resources[] = {
@@ -945,8 +1057,11 @@ static int __devinit pm8921_probe(struct platform_device *pdev)
 	pmic->rev_registers |= val << BITS_PER_BYTE;
 
 	pmic->dev = &pdev->dev;
+	spin_lock_init(&pmic->cache_lock);
 	pm8921_drvdata.pm_chip_data = pmic;
 	platform_set_drvdata(pdev, &pm8921_drvdata);
+	pm8921_cache_regs(pmic->dev, pm8921_const_regs,
+			  ARRAY_SIZE(pm8921_const_regs));
 
 	
 	version = pm8xxx_get_version(pmic->dev);
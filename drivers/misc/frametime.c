@@ -0,0 +1,213 @@
+/* drivers/misc/frametime.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/atomic.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/frametime.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/frametime.h>
+
+#define FRAMETIME_MAX_FB		4
+#define FRAMETIME_HIST_BASE_US		1000
+#define FRAMETIME_HIST_BUCKETS		10
+
+/*
+ * With histogram set, the first touch after a commit is latched by the
+ * next commit on a framebuffer and its latency is taken when that
+ * commit reaches the panel: DMA done on command panels, the following
+ * vsync on video panels.
+ */
+static bool histogram;
+module_param(histogram, bool, 0644);
+
+struct frametime_fb {
+	u32 commit;
+	u32 shown;
+	u32 seq;
+	ktime_t input;
+};
+
+static atomic_t frametime_seq = ATOMIC_INIT(0);
+static DEFINE_SPINLOCK(frametime_lock);
+static struct frametime_fb frametime_fbs[FRAMETIME_MAX_FB];
+static ktime_t frametime_first;
+static u32 frametime_first_seq;
+static unsigned long frametime_hist[FRAMETIME_HIST_BUCKETS];
+static unsigned int frametime_max_us;
+
+static inline u32 frametime_cur_seq(void)
+{
+	return atomic_read(&frametime_seq);
+}
+
+void frametime_input(void)
+{
+	unsigned long flags;
+	u32 seq = atomic_inc_return(&frametime_seq);
+
+	trace_frame_input(seq);
+
+	if (!histogram)
+		return;
+
+	spin_lock_irqsave(&frametime_lock, flags);
+	if (frametime_first.tv64 == 0) {
+		frametime_first = ktime_get();
+		frametime_first_seq = seq;
+	}
+	spin_unlock_irqrestore(&frametime_lock, flags);
+}
+EXPORT_SYMBOL(frametime_input);
+
+void frametime_binder(int debug_id)
+{
+	trace_frame_binder(frametime_cur_seq(), debug_id);
+}
+EXPORT_SYMBOL(frametime_binder);
+
+void frametime_gpu_submit(unsigned int context, unsigned int ts)
+{
+	trace_frame_gpu_submit(frametime_cur_seq(), context, ts);
+}
+EXPORT_SYMBOL(frametime_gpu_submit);
+
+void frametime_gpu_retire(unsigned int context, unsigned int ts)
+{
+	trace_frame_gpu_retire(frametime_cur_seq(), context, ts);
+}
+EXPORT_SYMBOL(frametime_gpu_retire);
+
+void frametime_commit(int fb)
+{
+	struct frametime_fb *f;
+	unsigned long flags;
+	u32 commit;
+
+	if (fb < 0 || fb >= FRAMETIME_MAX_FB)
+		return;
+	f = &frametime_fbs[fb];
+
+	spin_lock_irqsave(&frametime_lock, flags);
+	commit = ++f->commit;
+	if (frametime_first.tv64 && f->input.tv64 == 0) {
+		f->input = frametime_first;
+		f->seq = frametime_first_seq;
+		frametime_first = ktime_set(0, 0);
+	}
+	spin_unlock_irqrestore(&frametime_lock, flags);
+
+	trace_frame_commit(frametime_cur_seq(), fb, commit);
+}
+EXPORT_SYMBOL(frametime_commit);
+
+void frametime_display(int fb)
+{
+	struct frametime_fb *f;
+	unsigned long flags;
+	unsigned int usecs, bucket;
+	s64 latency = -1;
+	u32 seq, commit;
+
+	if (fb < 0 || fb >= FRAMETIME_MAX_FB)
+		return;
+	f = &frametime_fbs[fb];
+
+	spin_lock_irqsave(&frametime_lock, flags);
+	if (f->shown == f->commit) {
+		spin_unlock_irqrestore(&frametime_lock, flags);
+		return;
+	}
+	commit = f->shown = f->commit;
+	seq = frametime_cur_seq();
+
+	if (f->input.tv64) {
+		latency = ktime_us_delta(ktime_get(), f->input);
+		seq = f->seq;
+		f->input = ktime_set(0, 0);
+
+		usecs = (unsigned int) latency;
+		bucket = min_t(unsigned int,
+			fls(usecs / FRAMETIME_HIST_BASE_US),
+			FRAMETIME_HIST_BUCKETS - 1);
+		frametime_hist[bucket]++;
+		if (usecs > frametime_max_us)
+			frametime_max_us = usecs;
+	}
+	spin_unlock_irqrestore(&frametime_lock, flags);
+
+	trace_frame_display(seq, fb, commit, latency);
+}
+EXPORT_SYMBOL(frametime_display);
+
+static int frametime_hist_show(struct seq_file *s, void *unused)
+{
+	unsigned long hist[FRAMETIME_HIST_BUCKETS];
+	unsigned long flags;
+	unsigned int max_us;
+	int i;
+
+	spin_lock_irqsave(&frametime_lock, flags);
+	memcpy(hist, frametime_hist, sizeof(hist));
+	max_us = frametime_max_us;
+	spin_unlock_irqrestore(&frametime_lock, flags);
+
+	seq_printf(s, "input to display latency, histogram %s\n",
+		   histogram ? "on" : "off");
+	for (i = 0; i < FRAMETIME_HIST_BUCKETS - 1; i++)
+		seq_printf(s, "  < %6u us: %lu\n",
+			   FRAMETIME_HIST_BASE_US << i, hist[i]);
+	seq_printf(s, ">= %6u us: %lu\n",
+		   FRAMETIME_HIST_BASE_US << (FRAMETIME_HIST_BUCKETS - 2),
+		   hist[FRAMETIME_HIST_BUCKETS - 1]);
+	seq_printf(s, "max: %u us\n", max_us);
+	return 0;
+}
+
+static int frametime_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, frametime_hist_show, NULL);
+}
+
+static ssize_t frametime_hist_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&frametime_lock, flags);
+	memset(frametime_hist, 0, sizeof(frametime_hist));
+	frametime_max_us = 0;
+	spin_unlock_irqrestore(&frametime_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations frametime_hist_fops = {
+	.open		= frametime_hist_open,
+	.read		= seq_read,
+	.write		= frametime_hist_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init frametime_init(void)
+{
+	debugfs_create_file("frametime_latency", S_IRUGO | S_IWUSR, NULL,
+			    NULL, &frametime_hist_fops);
+	return 0;
+}
+late_initcall(frametime_init);
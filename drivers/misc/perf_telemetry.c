@@ -0,0 +1,226 @@
+/* drivers/misc/perf_telemetry.c
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/miscdevice.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/mutex.h>
+#include <linux/irq_work.h>
+#include <linux/cpufreq.h>
+#include <linux/sched.h>
+#include <linux/rcupdate.h>
+#include <linux/log2.h>
+#include <linux/perf_telemetry.h>
+
+static unsigned int ring_pages = 4;
+module_param(ring_pages, uint, 0644);
+MODULE_PARM_DESC(ring_pages, "Sample pages per cpu ring, from the next open");
+static unsigned int watermark = 50;
+module_param(watermark, uint, 0644);
+MODULE_PARM_DESC(watermark, "Ring fill in percent that wakes the reader");
+
+int perf_tm_on;
+EXPORT_SYMBOL(perf_tm_on);
+
+static DEFINE_MUTEX(perf_tm_mutex);
+static DECLARE_WAIT_QUEUE_HEAD(perf_tm_wait);
+static struct irq_work perf_tm_wake_work;
+static void *perf_tm_buf;
+static unsigned int perf_tm_span;
+static unsigned int perf_tm_thresh;
+static int perf_tm_busy;
+
+static struct perf_tm_ring *perf_tm_ring(void *buf, int cpu)
+{
+	return buf + cpu * perf_tm_span;
+}
+
+static struct perf_tm_sample *perf_tm_sample(struct perf_tm_ring *ring,
+					     unsigned int pos)
+{
+	struct perf_tm_sample *samples = (void *)ring + PAGE_SIZE;
+
+	return &samples[pos & (ring->size - 1)];
+}
+
+/* Any context; the ring of the local cpu, so irqs off is all it takes */
+void __perf_tm_log(unsigned int type, u32 a0, u32 a1, u32 a2)
+{
+	struct perf_tm_ring *ring;
+	struct perf_tm_sample *s;
+	unsigned long flags;
+	unsigned int head, used;
+	void *buf;
+	int cpu;
+
+	local_irq_save(flags);
+	buf = ACCESS_ONCE(perf_tm_buf);
+	if (!buf)
+		goto out;
+
+	cpu = smp_processor_id();
+	ring = perf_tm_ring(buf, cpu);
+	head = ring->head;
+	used = head - ring->tail;
+	if (used >= ring->size) {
+		ring->lost++;
+		goto out;
+	}
+
+	s = perf_tm_sample(ring, head);
+	s->timestamp = sched_clock();
+	s->type = type;
+	s->cpu = cpu;
+	s->arg[0] = a0;
+	s->arg[1] = a1;
+	s->arg[2] = a2;
+	smp_wmb();
+	ring->head = head + 1;
+
+	if (used + 1 == perf_tm_thresh)
+		irq_work_queue(&perf_tm_wake_work);
+out:
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(__perf_tm_log);
+
+static void perf_tm_wake(struct irq_work *work)
+{
+	wake_up_interruptible(&perf_tm_wait);
+}
+
+static int perf_tm_cpufreq_notifier(struct notifier_block *nb,
+				    unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freqs = data;
+
+	if (val == CPUFREQ_POSTCHANGE)
+		perf_tm_log(PERF_TM_CPU_FREQ, freqs->cpu, freqs->old,
+			    freqs->new);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block perf_tm_cpufreq_nb = {
+	.notifier_call = perf_tm_cpufreq_notifier,
+};
+
+static int perf_tm_open(struct inode *inode, struct file *file)
+{
+	struct perf_tm_ring *ring;
+	unsigned int size, pages;
+	void *buf;
+	int cpu, ret = 0;
+
+	mutex_lock(&perf_tm_mutex);
+	if (perf_tm_busy) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	pages = max(ring_pages, 1U);
+	size = rounddown_pow_of_two(pages * PAGE_SIZE /
+				    sizeof(struct perf_tm_sample));
+	perf_tm_span = (pages + 1) * PAGE_SIZE;
+	perf_tm_thresh = max(size * min(watermark, 100U) / 100, 1U);
+
+	buf = vmalloc_user(nr_cpu_ids * perf_tm_span);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		ring = perf_tm_ring(buf, cpu);
+		ring->size = size;
+		ring->span = perf_tm_span;
+		ring->nr_rings = nr_cpu_ids;
+	}
+
+	perf_tm_busy = 1;
+	smp_wmb();
+	perf_tm_buf = buf;
+	perf_tm_on = 1;
+out:
+	mutex_unlock(&perf_tm_mutex);
+	return ret ? ret : nonseekable_open(inode, file);
+}
+
+static int perf_tm_release(struct inode *inode, struct file *file)
+{
+	void *buf;
+
+	mutex_lock(&perf_tm_mutex);
+	perf_tm_on = 0;
+	buf = perf_tm_buf;
+	perf_tm_buf = NULL;
+	/* Loggers run with irqs off */
+	synchronize_sched();
+	irq_work_sync(&perf_tm_wake_work);
+	vfree(buf);
+	perf_tm_busy = 0;
+	mutex_unlock(&perf_tm_mutex);
+
+	return 0;
+}
+
+static int perf_tm_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	return remap_vmalloc_range(vma, perf_tm_buf, vma->vm_pgoff);
+}
+
+static unsigned int perf_tm_poll(struct file *file, poll_table *wait)
+{
+	struct perf_tm_ring *ring;
+	int cpu;
+
+	poll_wait(file, &perf_tm_wait, wait);
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		ring = perf_tm_ring(perf_tm_buf, cpu);
+		if (ring->head - ring->tail >= perf_tm_thresh)
+			return POLLIN | POLLRDNORM;
+	}
+	return 0;
+}
+
+static const struct file_operations perf_tm_fops = {
+	.owner		= THIS_MODULE,
+	.open		= perf_tm_open,
+	.release	= perf_tm_release,
+	.mmap		= perf_tm_mmap,
+	.poll		= perf_tm_poll,
+	.llseek		= no_llseek,
+};
+
+static struct miscdevice perf_tm_dev = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "perf_telemetry",
+	.fops	= &perf_tm_fops,
+};
+
+static int __init perf_tm_init(void)
+{
+	init_irq_work(&perf_tm_wake_work, perf_tm_wake);
+	cpufreq_register_notifier(&perf_tm_cpufreq_nb,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+
+	return misc_register(&perf_tm_dev);
+}
+module_init(perf_tm_init);
+
+MODULE_DESCRIPTION("Per-cpu performance telemetry ring");
+MODULE_LICENSE("GPL v2");
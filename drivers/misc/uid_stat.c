@@ -13,47 +13,58 @@
  *
  */
 
-#include <asm/atomic.h>
-
 #include <linux/err.h>
+#include <linux/hash.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
+#include <linux/rculist.h>
 #include <linux/slab.h>
-#include <linux/spinlock.h>
 #include <linux/stat.h>
 #include <linux/uid_stat.h>
 #include <net/activity_stats.h>
 
-static DEFINE_SPINLOCK(uid_lock);
-static LIST_HEAD(uid_list);
+#define UID_HASH_BITS	6
+
+/* Entries are never freed: lookups need no lock, only creation does */
+static DEFINE_MUTEX(uid_lock);
+static struct hlist_head uid_hash[1 << UID_HASH_BITS];
 static struct proc_dir_entry *parent;
 
+struct uid_stat_cpu {
+	unsigned int tcp_rcv;
+	unsigned int tcp_snd;
+	unsigned int tcp_rcv_pkt;
+	unsigned int tcp_snd_pkt;
+	unsigned int udp_rcv;
+	unsigned int udp_snd;
+	unsigned int udp_rcv_pkt;
+	unsigned int udp_snd_pkt;
+};
+
 struct uid_stat {
-	struct list_head link;
+	struct hlist_node link;
 	uid_t uid;
-	atomic_t tcp_rcv;
-	atomic_t tcp_snd;
-	atomic_t tcp_rcv_pkt;
-	atomic_t tcp_snd_pkt;
-	atomic_t udp_rcv;
-	atomic_t udp_snd;
-	atomic_t udp_rcv_pkt;
-	atomic_t udp_snd_pkt;
+	struct uid_stat_cpu __percpu *stats;
 };
 
+/* data is the __percpu address of one counter, summed over the cpus */
 static int read_proc_entry(char *page, char **start, off_t off,
 				int count, int *eof, void *data)
 {
 	int len;
-	unsigned int value;
+	int cpu;
+	unsigned int value = 0;
 	char *p = page;
-	atomic_t *uid_entry = (atomic_t *) data;
+	unsigned int __percpu *counter = (unsigned int __percpu *) data;
 	if (!data)
 		return 0;
 
-	value = (unsigned int) (atomic_read(uid_entry) + INT_MIN);
+	for_each_possible_cpu(cpu)
+		value += *per_cpu_ptr(counter, cpu);
 	p += sprintf(p, "%u\n", value);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
@@ -61,70 +72,72 @@ static int read_proc_entry(char *page, char **start, off_t off,
 	return len;
 }
 
-static struct uid_stat *get_uid_stat(uid_t uid) {
-	unsigned long flags;
+static struct uid_stat *find_uid_stat(struct hlist_head *head, uid_t uid)
+{
 	struct uid_stat *uid_entry;
-	struct uid_stat *new_uid;
-	struct proc_dir_entry *proc_entry;
-	char uid_s[32];
+	struct hlist_node *node;
 
-	spin_lock_irqsave(&uid_lock, flags);
-	list_for_each_entry(uid_entry, &uid_list, link) {
-		if (uid_entry->uid == uid) {
-			spin_unlock_irqrestore(&uid_lock, flags);
+	hlist_for_each_entry_rcu(uid_entry, node, head, link)
+		if (uid_entry->uid == uid)
 			return uid_entry;
-		}
-	}
-	spin_unlock_irqrestore(&uid_lock, flags);
+	return NULL;
+}
 
-	
-	if ((new_uid = kmalloc(sizeof(struct uid_stat), GFP_KERNEL)) == NULL)
-		return NULL;
+static void create_uid_proc(struct uid_stat *new_uid)
+{
+	struct proc_dir_entry *proc_entry;
+	char uid_s[32];
 
-	new_uid->uid = uid;
-	
-	atomic_set(&new_uid->tcp_rcv, INT_MIN);
-	atomic_set(&new_uid->tcp_snd, INT_MIN);
-	atomic_set(&new_uid->tcp_snd_pkt, INT_MIN);
-	atomic_set(&new_uid->tcp_rcv_pkt, INT_MIN);
-	atomic_set(&new_uid->udp_rcv, INT_MIN);
-	atomic_set(&new_uid->udp_snd, INT_MIN);
-	atomic_set(&new_uid->udp_snd_pkt, INT_MIN);
-	atomic_set(&new_uid->udp_rcv_pkt, INT_MIN);
-
-	
-	spin_lock_irqsave(&uid_lock, flags);
-	list_add_tail(&new_uid->link, &uid_list);
-	spin_unlock_irqrestore(&uid_lock, flags);
-
-	sprintf(uid_s, "%d", uid);
+	sprintf(uid_s, "%d", new_uid->uid);
 	proc_entry = proc_mkdir(uid_s, parent);
 
-	
-	create_proc_read_entry("tcp_snd", S_IRUGO, proc_entry, read_proc_entry,
-		(void *) &new_uid->tcp_snd);
-
-	create_proc_read_entry("tcp_rcv", S_IRUGO, proc_entry, read_proc_entry,
-		(void *) &new_uid->tcp_rcv);
-
-	create_proc_read_entry("tcp_snd_pkt", S_IRUGO, proc_entry, read_proc_entry,
-		(void *) &new_uid->tcp_snd_pkt);
-
-	create_proc_read_entry("tcp_rcv_pkt", S_IRUGO, proc_entry, read_proc_entry,
-		(void *) &new_uid->tcp_rcv_pkt);
-
-	create_proc_read_entry("udp_snd", S_IRUGO, proc_entry, read_proc_entry,
-		(void *) &new_uid->udp_snd);
-
-	create_proc_read_entry("udp_rcv", S_IRUGO, proc_entry, read_proc_entry,
-		(void *) &new_uid->udp_rcv);
+#define UID_PROC_ENTRY(name) \
+	create_proc_read_entry(#name, S_IRUGO, proc_entry, read_proc_entry, \
+		(void __force *) &new_uid->stats->name)
+
+	UID_PROC_ENTRY(tcp_snd);
+	UID_PROC_ENTRY(tcp_rcv);
+	UID_PROC_ENTRY(tcp_snd_pkt);
+	UID_PROC_ENTRY(tcp_rcv_pkt);
+	UID_PROC_ENTRY(udp_snd);
+	UID_PROC_ENTRY(udp_rcv);
+	UID_PROC_ENTRY(udp_snd_pkt);
+	UID_PROC_ENTRY(udp_rcv_pkt);
+#undef UID_PROC_ENTRY
+}
 
-	create_proc_read_entry("udp_snd_pkt", S_IRUGO, proc_entry, read_proc_entry,
-		(void *) &new_uid->udp_snd_pkt);
+static struct uid_stat *get_uid_stat(uid_t uid) {
+	struct hlist_head *head = &uid_hash[hash_long(uid, UID_HASH_BITS)];
+	struct uid_stat *uid_entry;
+	struct uid_stat *new_uid;
 
-	create_proc_read_entry("udp_rcv_pkt", S_IRUGO, proc_entry, read_proc_entry,
-		(void *) &new_uid->udp_rcv_pkt);
+	rcu_read_lock();
+	uid_entry = find_uid_stat(head, uid);
+	rcu_read_unlock();
+	if (uid_entry)
+		return uid_entry;
+
+	mutex_lock(&uid_lock);
+	new_uid = find_uid_stat(head, uid);
+	if (new_uid)
+		goto out;
+
+	new_uid = kmalloc(sizeof(struct uid_stat), GFP_KERNEL);
+	if (new_uid == NULL)
+		goto out;
+	new_uid->stats = alloc_percpu(struct uid_stat_cpu);
+	if (new_uid->stats == NULL) {
+		kfree(new_uid);
+		new_uid = NULL;
+		goto out;
+	}
+	new_uid->uid = uid;
 
+	/* Published only once the counters are zeroed by alloc_percpu */
+	hlist_add_head_rcu(&new_uid->link, head);
+	create_uid_proc(new_uid);
+out:
+	mutex_unlock(&uid_lock);
 	return new_uid;
 }
 
@@ -134,7 +147,7 @@ int uid_stat_tcp_snd(uid_t uid, int size) {
 	if ((entry = get_uid_stat(uid)) == NULL) {
 		return -1;
 	}
-	atomic_add(size, &entry->tcp_snd);
+	this_cpu_add(entry->stats->tcp_snd, size);
 	return 0;
 }
 
@@ -144,8 +157,8 @@ int uid_stat_tcp_rcv(uid_t uid, int size) {
 	if ((entry = get_uid_stat(uid)) == NULL) {
 		return -1;
 	}
-	atomic_add(size, &entry->tcp_rcv);
-	atomic_inc(&entry->tcp_rcv_pkt);
+	this_cpu_add(entry->stats->tcp_rcv, size);
+	this_cpu_inc(entry->stats->tcp_rcv_pkt);
 	return 0;
 }
 
@@ -155,8 +168,8 @@ int uid_stat_udp_snd(uid_t uid, int size) {
 	if ((entry = get_uid_stat(uid)) == NULL) {
 		return -1;
 	}
-	atomic_add(size, &entry->udp_snd);
-	atomic_inc(&entry->udp_snd_pkt);
+	this_cpu_add(entry->stats->udp_snd, size);
+	this_cpu_inc(entry->stats->udp_snd_pkt);
 	return 0;
 }
 
@@ -166,8 +179,8 @@ int uid_stat_udp_rcv(uid_t uid, int size) {
 	if ((entry = get_uid_stat(uid)) == NULL) {
 		return -1;
 	}
-	atomic_add(size, &entry->udp_rcv);
-	atomic_inc(&entry->udp_rcv_pkt);
+	this_cpu_add(entry->stats->udp_rcv, size);
+	this_cpu_inc(entry->stats->udp_rcv_pkt);
 	return 0;
 }
 
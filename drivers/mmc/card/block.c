@@ -313,8 +313,11 @@ num_wr_reqs_to_start_packing_store(struct device *dev,
 	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
 
 	sscanf(buf, "%d", &value);
-	if (value >= 0)
+	if (value >= 0) {
 		md->queue.num_wr_reqs_to_start_packing = value;
+		/* A value set by hand sticks */
+		md->queue.card->wr_pack_adapt.enabled = false;
+	}
 
 	mmc_blk_put(md);
 	return count;
@@ -1491,6 +1494,149 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 
 }
 
+#define PACK_ADAPT_EPOCH	64	
+#define PACK_ADAPT_SMALL	128	
+#define PACK_ADAPT_MAX_TRIGGER	64
+
+/*
+ * Every PACK_ADAPT_EPOCH writes, compare packed against unpacked small
+ * write throughput and the worst read dispatch delay, then retune the
+ * packing trigger and the pack size.  Packing that doesn't beat plain
+ * writes by an eighth starts later; reads waiting past read_target_ms
+ * halve the pack size.
+ */
+static void mmc_blk_pack_adapt_epoch(struct mmc_queue *mq,
+				     struct mmc_wr_pack_adapt *adapt)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_pack_adapt_entry *e;
+	int trigger = mq->num_wr_reqs_to_start_packing;
+	u8 max_packed = adapt->max_packed;
+	u32 packed_kbps = 0, unpacked_kbps = 0;
+	char action = '-';
+
+	if (adapt->packed_us)
+		packed_kbps = div64_u64((adapt->packed_bytes >> 10) *
+					USEC_PER_SEC, adapt->packed_us);
+	if (adapt->unpacked_us)
+		unpacked_kbps = div64_u64((adapt->unpacked_bytes >> 10) *
+					  USEC_PER_SEC, adapt->unpacked_us);
+
+	if (adapt->read_wait_ms > adapt->read_target_ms) {
+		if (max_packed > 2) {
+			max_packed = max_t(u8, max_packed / 2, 2);
+			action = 'R';
+		}
+	} else if (packed_kbps && unpacked_kbps) {
+		if (packed_kbps > unpacked_kbps + unpacked_kbps / 8) {
+			trigger = max(trigger - 1, 1);
+			if (adapt->read_wait_ms < adapt->read_target_ms / 2)
+				max_packed = min_t(u32, max_packed * 2,
+					card->ext_csd.max_packed_writes);
+			action = 'P';
+		} else if (packed_kbps < unpacked_kbps) {
+			trigger = min(trigger + trigger / 2 + 1,
+				      PACK_ADAPT_MAX_TRIGGER);
+			action = 'U';
+		}
+	} else if (unpacked_kbps && trigger > 1) {
+		/* Nothing got packed, probe an earlier start */
+		trigger--;
+		action = 'p';
+	}
+
+	mq->num_wr_reqs_to_start_packing = trigger;
+	adapt->max_packed = max_packed;
+
+	e = &adapt->log[adapt->log_next];
+	adapt->log_next = (adapt->log_next + 1) % MMC_PACK_ADAPT_LOG;
+	e->time = jiffies;
+	e->packed_kbps = packed_kbps;
+	e->unpacked_kbps = unpacked_kbps;
+	e->read_wait_ms = adapt->read_wait_ms;
+	e->trigger = trigger;
+	e->max_packed = max_packed;
+	e->action = action;
+
+	adapt->packed_bytes = 0;
+	adapt->packed_us = 0;
+	adapt->unpacked_bytes = 0;
+	adapt->unpacked_us = 0;
+	adapt->read_wait_ms = 0;
+	adapt->nr_writes = 0;
+}
+
+static void mmc_blk_pack_adapt_done(struct mmc_queue *mq,
+				    struct mmc_queue_req *mqrq)
+{
+	struct mmc_wr_pack_adapt *adapt = &mq->card->wr_pack_adapt;
+	u32 sectors = mqrq->brq.data.bytes_xfered >> 9;
+	ktime_t now, start;
+	s64 us;
+
+	if (!adapt->enabled)
+		return;
+
+	/*
+	 * With two requests in flight this one started when the previous
+	 * one finished, or when it was issued if the host was idle.
+	 */
+	now = ktime_get();
+	start = mqrq->issue_t;
+	if (ktime_to_ns(adapt->last_done) > ktime_to_ns(start))
+		start = adapt->last_done;
+	adapt->last_done = now;
+	us = ktime_us_delta(now, start);
+
+	if (rq_data_dir(mqrq->req) != WRITE || us <= 0)
+		return;
+
+	spin_lock(&adapt->lock);
+	if (mqrq->packed_cmd != MMC_PACKED_NONE) {
+		if (sectors <= mqrq->packed_num * PACK_ADAPT_SMALL) {
+			adapt->packed_bytes += sectors << 9;
+			adapt->packed_us += us;
+		}
+	} else if (sectors <= PACK_ADAPT_SMALL) {
+		adapt->unpacked_bytes += sectors << 9;
+		adapt->unpacked_us += us;
+	}
+	if (++adapt->nr_writes >= PACK_ADAPT_EPOCH)
+		mmc_blk_pack_adapt_epoch(mq, adapt);
+	spin_unlock(&adapt->lock);
+}
+
+static void mmc_blk_pack_adapt_read(struct mmc_queue *mq,
+				    struct request *req)
+{
+	struct mmc_wr_pack_adapt *adapt = &mq->card->wr_pack_adapt;
+	u32 wait;
+
+	if (!adapt->enabled || !req || rq_data_dir(req) != READ)
+		return;
+
+	wait = jiffies_to_msecs(jiffies - req->start_time);
+	if (wait > adapt->read_wait_ms)
+		adapt->read_wait_ms = wait;
+}
+
+void mmc_blk_init_pack_adapt(struct mmc_card *card, bool enable)
+{
+	struct mmc_wr_pack_adapt *adapt = &card->wr_pack_adapt;
+
+	spin_lock(&adapt->lock);
+	adapt->max_packed = card->ext_csd.max_packed_writes;
+	adapt->packed_bytes = 0;
+	adapt->packed_us = 0;
+	adapt->unpacked_bytes = 0;
+	adapt->unpacked_us = 0;
+	adapt->read_wait_ms = 0;
+	adapt->nr_writes = 0;
+	adapt->enabled = enable;
+	spin_unlock(&adapt->lock);
+}
+EXPORT_SYMBOL(mmc_blk_init_pack_adapt);
+
 struct mmc_wr_pack_stats *mmc_blk_get_packed_statistics(struct mmc_card *card)
 {
 	if (!card)
@@ -1605,6 +1751,10 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 			(card->host->caps2 & MMC_CAP2_PACKED_WR))
 		max_packed_rw = card->ext_csd.max_packed_writes;
 
+	if (card->wr_pack_adapt.enabled)
+		max_packed_rw = min(max_packed_rw,
+				    card->wr_pack_adapt.max_packed);
+
 	if (max_packed_rw == 0)
 		goto no_packed;
 
@@ -1863,6 +2013,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			else
 				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
 			areq = &mq->mqrq_cur->mmc_active;
+			mq->mqrq_cur->issue_t = ktime_get();
 			if (mmc_card_mmc(card)) {
 				if (atomic_read(&emmc_reboot)) {
 					mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
@@ -1899,6 +2050,8 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		case MMC_BLK_SUCCESS:
 		case MMC_BLK_PARTIAL:
 			mmc_blk_reset_success(md, type);
+			if (status == MMC_BLK_SUCCESS)
+				mmc_blk_pack_adapt_done(mq, mq_rq);
 
 			if (mq_rq->packed_cmd != MMC_PACKED_NONE) {
 				ret = mmc_blk_end_packed_req(mq, mq_rq);
@@ -2042,6 +2195,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 	}
 
 	mmc_blk_write_packing_control(mq, req);
+	mmc_blk_pack_adapt_read(mq, req);
 
 	if (req && req->cmd_flags & REQ_SANITIZE) {
 		
@@ -48,6 +48,7 @@ static int mmc_queue_thread(void *d)
 	struct mmc_queue *mq = d;
 	struct request_queue *q = mq->queue;
 	struct request *req;
+	unsigned int idle_ms;
 
 	current->flags |= PF_MEMALLOC;
 
@@ -65,6 +66,8 @@ static int mmc_queue_thread(void *d)
 		if (req || mq->mqrq_prev->req) {
 			if (mmc_card_doing_bkops(mq->card))
 				mmc_interrupt_bkops(mq->card);
+			if (req && rq_data_dir(req) == WRITE)
+				mq->bkops_idle_armed = true;
 
 			set_current_state(TASK_RUNNING);
 			mq->issue_fn(mq, req);
@@ -75,9 +78,21 @@ static int mmc_queue_thread(void *d)
 			}
 
 			mmc_start_bkops(mq->card);
+			idle_ms = mq->bkops_idle_armed ?
+				mmc_bkops_idle_delay(mq->card) : 0;
 			up(&mq->thread_sem);
-			schedule();
+			if (idle_ms)
+				idle_ms = !schedule_timeout(
+						msecs_to_jiffies(idle_ms));
+			else
+				schedule();
 			down(&mq->thread_sem);
+
+			/* Still idle after the writes: let BKOPS run */
+			if (idle_ms) {
+				mq->bkops_idle_armed = false;
+				mmc_start_idle_bkops(mq->card);
+			}
 		}
 
 		
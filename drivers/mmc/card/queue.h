@@ -42,6 +42,7 @@ struct mmc_queue_req {
 	enum mmc_packed_cmd	packed_cmd;
 	int		packed_fail_idx;
 	u8		packed_num;
+	ktime_t		issue_t;
 };
 
 struct mmc_queue {
@@ -58,6 +59,7 @@ struct mmc_queue {
 	bool			wr_packing_enabled;
 	int			num_of_potential_packed_wr_reqs;
 	int			num_wr_reqs_to_start_packing;
+	bool			bkops_idle_armed;
 	int (*err_check_fn) (struct mmc_card *, struct mmc_async_req *);
 	void (*packed_test_fn) (struct request_queue *, struct mmc_queue_req *);
 };
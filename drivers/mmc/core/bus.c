@@ -235,6 +235,7 @@ struct mmc_card *mmc_alloc_card(struct mmc_host *host, struct device_type *type)
 	card->dev.type = type;
 
 	spin_lock_init(&card->wr_pack_stats.lock);
+	spin_lock_init(&card->wr_pack_adapt.lock);
 
 	return card;
 }
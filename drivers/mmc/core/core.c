@@ -19,6 +19,7 @@
 #include <linux/pagemap.h>
 #include <linux/err.h>
 #include <linux/leds.h>
+#include <linux/lockstat_lite.h>
 #include <linux/scatterlist.h>
 #include <linux/log2.h>
 #include <linux/regulator/consumer.h>
@@ -59,6 +60,17 @@ bool mmc_assume_removable = 1;
 #endif
 EXPORT_SYMBOL(mmc_assume_removable);
 module_param_named(removable, mmc_assume_removable, bool, 0644);
+
+/* Idle time before non-urgent BKOPS are started, screen on and off */
+static unsigned int bkops_idle_ms = 2000;
+module_param(bkops_idle_ms, uint, 0644);
+static unsigned int bkops_idle_screen_off_ms = 200;
+module_param(bkops_idle_screen_off_ms, uint, 0644);
+/* BKOPS given over suspend once the screen has been off this long */
+static unsigned int bkops_suspend_idle_ms = 60000;
+module_param(bkops_suspend_idle_ms, uint, 0644);
+static unsigned int bkops_suspend_ms = 10000;
+module_param(bkops_suspend_ms, uint, 0644);
 MODULE_PARM_DESC(
 	removable,
 	"MMC/SD cards are removable and may be removed during suspend");
@@ -267,6 +279,7 @@ void mmc_start_bkops(struct mmc_card *card)
 			if (card->ext_csd.raw_bkops_status >= EXT_CSD_BKOPS_LEVEL_2) {
 				spin_lock_irqsave(&card->host->lock, flags);
 				mmc_card_set_need_bkops(card);
+				card->bkops_stats.urgent++;
 				spin_unlock_irqrestore(&card->host->lock, flags);
 			}
 	}
@@ -303,6 +316,91 @@ out:
 }
 EXPORT_SYMBOL(mmc_start_bkops);
 
+static bool mmc_can_idle_bkops(struct mmc_card *card)
+{
+	/* Without HPI a new request would wait for the card to finish */
+	return card->ext_csd.bkops_en && card->ext_csd.hpi_en &&
+		(card->host->caps2 & MMC_CAP2_BKOPS);
+}
+
+unsigned int mmc_bkops_idle_delay(struct mmc_card *card)
+{
+	if (!mmc_can_idle_bkops(card))
+		return 0;
+
+	return card->host->screen_off ? bkops_idle_screen_off_ms :
+		bkops_idle_ms;
+}
+EXPORT_SYMBOL(mmc_bkops_idle_delay);
+
+/*
+ * Called by the queue once it has been idle for mmc_bkops_idle_delay()
+ * after writes.  Starts whatever BKOPS the card reports outstanding, so
+ * they don't build up to the urgent level in the middle of user I/O.
+ * The next request interrupts them with HPI.
+ */
+void mmc_start_idle_bkops(struct mmc_card *card)
+{
+	unsigned long flags;
+	u8 level;
+	int err;
+
+	if (!mmc_can_idle_bkops(card) || mmc_card_doing_bkops(card))
+		return;
+
+	if (mmc_read_bkops_status(card))
+		return;
+
+	level = card->ext_csd.raw_bkops_status & 0x3;
+	if (!level)
+		return;
+
+	mmc_claim_host(card->host);
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL,
+			EXT_CSD_BKOPS_START, 1, 0);
+	if (err) {
+		pr_warning("%s: error %d starting idle bkops\n",
+			   mmc_hostname(card->host), err);
+		goto out;
+	}
+
+	spin_lock_irqsave(&card->host->lock, flags);
+	mmc_card_set_doing_bkops(card);
+	card->bkops_stats.idle_started++;
+	card->bkops_stats.idle_level[level]++;
+	card->bkops_stats.start = ktime_get();
+	card->bkops_stats.idle_running = true;
+	spin_unlock_irqrestore(&card->host->lock, flags);
+out:
+	mmc_release_host(card->host);
+}
+EXPORT_SYMBOL(mmc_start_idle_bkops);
+
+/*
+ * BKOPS time in ms to give the card over system suspend: the screen has
+ * been off long enough to call this a long idle, and the card still
+ * reports outstanding work.
+ */
+int mmc_bkops_suspend_time(struct mmc_card *card)
+{
+	struct mmc_host *host = card->host;
+
+	if (!card->ext_csd.bkops_en || !(host->caps2 & MMC_CAP2_BKOPS))
+		return 0;
+
+	if (!host->screen_off || time_before(jiffies, host->screen_off_jiffies +
+				msecs_to_jiffies(bkops_suspend_idle_ms)))
+		return 0;
+
+	if (mmc_read_bkops_status(card) ||
+	    !(card->ext_csd.raw_bkops_status & 0x3))
+		return 0;
+
+	card->bkops_stats.suspend_started++;
+	return bkops_suspend_ms;
+}
+EXPORT_SYMBOL(mmc_bkops_suspend_time);
+
 static void mmc_wait_done(struct mmc_request *mrq)
 {
 	complete(&mrq->completion);
@@ -497,6 +595,12 @@ int mmc_interrupt_bkops(struct mmc_card *card)
 
 	spin_lock_irqsave(&card->host->lock, flags);
 	mmc_card_clr_doing_bkops(card);
+	if (card->bkops_stats.idle_running) {
+		card->bkops_stats.idle_ms += ktime_to_ms(ktime_sub(ktime_get(),
+						card->bkops_stats.start));
+		card->bkops_stats.interrupted++;
+		card->bkops_stats.idle_running = false;
+	}
 	spin_unlock_irqrestore(&card->host->lock, flags);
 	if (err)
 		pr_err("%s: send hpi fail : %d\n",
@@ -616,10 +720,27 @@ int __mmc_claim_host(struct mmc_host *host, atomic_t *abort)
 {
 	DECLARE_WAITQUEUE(wait, current);
 	unsigned long flags;
+	u64 start;
 	int stop;
 
 	might_sleep();
 
+	lsl_acquired(LSL_MMC_CLAIM);
+	/* Uncontended or nested claim: no need to queue up */
+	spin_lock_irqsave(&host->lock, flags);
+	stop = abort ? atomic_read(abort) : 0;
+	if (!stop && (!host->claimed || host->claimer == current)) {
+		host->claimed = 1;
+		host->claimer = current;
+		host->claim_cnt += 1;
+		spin_unlock_irqrestore(&host->lock, flags);
+		if (host->ops->enable && host->claim_cnt == 1)
+			host->ops->enable(host);
+		return 0;
+	}
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	start = lsl_wait_start();
 	add_wait_queue(&host->wq, &wait);
 
 	spin_lock_irqsave(&host->lock, flags);
@@ -641,6 +762,7 @@ int __mmc_claim_host(struct mmc_host *host, atomic_t *abort)
 		wake_up(&host->wq);
 	spin_unlock_irqrestore(&host->lock, flags);
 	remove_wait_queue(&host->wq, &wait);
+	lsl_contended(LSL_MMC_CLAIM, start);
 	if (host->ops->enable && !stop && host->claim_cnt == 1)
 		host->ops->enable(host);
 	return stop;
@@ -684,7 +806,8 @@ void mmc_release_host(struct mmc_host *host)
 		host->claimed = 0;
 		host->claimer = NULL;
 		spin_unlock_irqrestore(&host->lock, flags);
-		wake_up(&host->wq);
+		if (waitqueue_active(&host->wq))
+			wake_up(&host->wq);
 	}
 }
 EXPORT_SYMBOL(mmc_release_host);
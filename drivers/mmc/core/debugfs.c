@@ -15,6 +15,8 @@
 #include <linux/slab.h>
 #include <linux/stat.h>
 #include <linux/fault-inject.h>
+#include <linux/uaccess.h>
+#include <linux/math64.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -158,6 +160,44 @@ static const struct file_operations mmc_ios_fops = {
 	.release	= single_release,
 };
 
+/* Card interrupt to function handler, as timed by the SDIO IRQ thread */
+static int mmc_sdio_irq_latency_show(struct seq_file *s, void *data)
+{
+	struct mmc_host *host = s->private;
+	u32 count = host->sdio_irq_lat_count;
+
+	seq_printf(s, "count:\t%u\n", count);
+	seq_printf(s, "avg:\t%llu ns\n",
+		   count ? div_u64(host->sdio_irq_lat_sum, count) : 0);
+	seq_printf(s, "max:\t%u ns\n", host->sdio_irq_lat_max);
+	return 0;
+}
+
+static int mmc_sdio_irq_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_sdio_irq_latency_show, inode->i_private);
+}
+
+/* Any write clears the statistics */
+static ssize_t mmc_sdio_irq_latency_write(struct file *file,
+		const char __user *ubuf, size_t cnt, loff_t *ppos)
+{
+	struct mmc_host *host = ((struct seq_file *)file->private_data)->private;
+
+	host->sdio_irq_lat_count = 0;
+	host->sdio_irq_lat_sum = 0;
+	host->sdio_irq_lat_max = 0;
+	return cnt;
+}
+
+static const struct file_operations mmc_sdio_irq_latency_fops = {
+	.open		= mmc_sdio_irq_latency_open,
+	.read		= seq_read,
+	.write		= mmc_sdio_irq_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int mmc_clock_opt_get(void *data, u64 *val)
 {
 	struct mmc_host *host = data;
@@ -205,6 +245,10 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 			&mmc_clock_fops))
 		goto err_node;
 
+	if (!debugfs_create_file("sdio_irq_latency", S_IRUSR | S_IWUSR, root,
+			host, &mmc_sdio_irq_latency_fops))
+		goto err_node;
+
 #ifdef CONFIG_MMC_CLKGATE
 	if (!debugfs_create_u32("clk_delay", (S_IRUSR | S_IWUSR),
 				root, &host->clk_delay))
@@ -473,6 +517,131 @@ static const struct file_operations mmc_dbg_wr_pack_stats_fops = {
 	.write		= mmc_wr_pack_stats_write,
 };
 
+/*
+ * urgent counts the urgent BKOPS raised during user I/O, the excursions
+ * idle BKOPS are there to avoid; idle_level is the BKOPS_STATUS found
+ * when idle BKOPS started, level 2 and up being work that would have
+ * hit writes.
+ */
+static int mmc_bkops_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_card *card = s->private;
+	struct mmc_bkops_stats stats;
+	unsigned long flags;
+	u64 running_ms = 0;
+
+	spin_lock_irqsave(&card->host->lock, flags);
+	stats = card->bkops_stats;
+	if (stats.idle_running)
+		running_ms = ktime_to_ms(ktime_sub(ktime_get(), stats.start));
+	spin_unlock_irqrestore(&card->host->lock, flags);
+
+	seq_printf(s, "idle_started %u\n", stats.idle_started);
+	seq_printf(s, "idle_level %u %u %u\n", stats.idle_level[1],
+		   stats.idle_level[2], stats.idle_level[3]);
+	seq_printf(s, "idle_ms %llu\n", stats.idle_ms + running_ms);
+	seq_printf(s, "interrupted %u\n", stats.interrupted);
+	seq_printf(s, "urgent %u\n", stats.urgent);
+	seq_printf(s, "suspend_started %u\n", stats.suspend_started);
+
+	return 0;
+}
+
+static int mmc_bkops_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_bkops_stats_show, inode->i_private);
+}
+
+static const struct file_operations mmc_dbg_bkops_stats_fops = {
+	.open		= mmc_bkops_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * Decisions oldest first.  Actions: P packing pays, start earlier and
+ * pack more; U it doesn't, start later; p nothing packed, probe; R reads
+ * starved, pack less; - no change.
+ */
+static int mmc_wr_pack_adapt_open(struct inode *inode, struct file *filp)
+{
+	struct mmc_card *card = inode->i_private;
+	struct mmc_wr_pack_adapt *adapt = &card->wr_pack_adapt;
+	struct mmc_pack_adapt_entry *e;
+	char *buf;
+	size_t n = 0;
+	int i;
+
+	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock(&adapt->lock);
+	n += scnprintf(buf + n, PAGE_SIZE - n,
+		       "enabled %d max_packed %u read_target_ms %u\n",
+		       adapt->enabled, adapt->max_packed,
+		       adapt->read_target_ms);
+	for (i = 0; i < MMC_PACK_ADAPT_LOG; i++) {
+		e = &adapt->log[(adapt->log_next + i) % MMC_PACK_ADAPT_LOG];
+		if (!e->time)
+			continue;
+		n += scnprintf(buf + n, PAGE_SIZE - n,
+			       "%u %c packed_kbps %u unpacked_kbps %u "
+			       "read_wait_ms %u trigger %u max_packed %u\n",
+			       jiffies_to_msecs(e->time), e->action,
+			       e->packed_kbps, e->unpacked_kbps,
+			       e->read_wait_ms, e->trigger, e->max_packed);
+	}
+	spin_unlock(&adapt->lock);
+
+	filp->private_data = buf;
+	return 0;
+}
+
+static ssize_t mmc_wr_pack_adapt_read(struct file *filp, char __user *ubuf,
+				      size_t cnt, loff_t *ppos)
+{
+	char *buf = filp->private_data;
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, strlen(buf));
+}
+
+static ssize_t mmc_wr_pack_adapt_write(struct file *filp,
+				       const char __user *ubuf, size_t cnt,
+				       loff_t *ppos)
+{
+	struct mmc_card *card = filp->f_dentry->d_inode->i_private;
+	char str[8];
+	int value;
+
+	if (cnt >= sizeof(str))
+		return -EINVAL;
+	if (copy_from_user(str, ubuf, cnt))
+		return -EFAULT;
+	str[cnt] = '\0';
+
+	if (sscanf(str, "%d", &value) != 1)
+		return -EINVAL;
+
+	mmc_blk_init_pack_adapt(card, !!value);
+
+	return cnt;
+}
+
+static int mmc_wr_pack_adapt_release(struct inode *inode, struct file *filp)
+{
+	kfree(filp->private_data);
+	return 0;
+}
+
+static const struct file_operations mmc_dbg_wr_pack_adapt_fops = {
+	.open		= mmc_wr_pack_adapt_open,
+	.read		= mmc_wr_pack_adapt_read,
+	.write		= mmc_wr_pack_adapt_write,
+	.release	= mmc_wr_pack_adapt_release,
+};
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -509,6 +678,23 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					 &mmc_dbg_wr_pack_stats_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) && card->ext_csd.bkops)
+		if (!debugfs_create_file("bkops_stats", S_IRUSR, root, card,
+					 &mmc_dbg_bkops_stats_fops))
+			goto err;
+
+	if (mmc_card_mmc(card) && (card->ext_csd.rev >= 6) &&
+	    (card->host->caps2 & MMC_CAP2_PACKED_WR_CONTROL)) {
+		if (!debugfs_create_file("wr_pack_adapt", S_IRUSR | S_IWUSR,
+					 root, card,
+					 &mmc_dbg_wr_pack_adapt_fops))
+			goto err;
+		if (!debugfs_create_u32("wr_pack_read_target_ms",
+					S_IRUSR | S_IWUSR, root,
+					&card->wr_pack_adapt.read_target_ms))
+			goto err;
+	}
+
 	return;
 
 err:
@@ -106,10 +106,12 @@ static void mmc_host_clk_gate_delayed(struct mmc_host *host)
 	mutex_lock(&host->clk_gate_mutex);
 	spin_lock_irqsave(&host->clk_lock, flags);
 	if (!host->clk_requests) {
+		host->clk_gating = true;
 		spin_unlock_irqrestore(&host->clk_lock, flags);
 		
 		mmc_gate_clock(host);
 		spin_lock_irqsave(&host->clk_lock, flags);
+		host->clk_gating = false;
 		pr_debug("%s: gated MCI clock\n", mmc_hostname(host));
 	}
 	spin_unlock_irqrestore(&host->clk_lock, flags);
@@ -128,6 +130,19 @@ void mmc_host_clk_hold(struct mmc_host *host)
 {
 	unsigned long flags;
 
+	/*
+	 * Clock running and not being gated: a pending gate work will see the
+	 * request and leave it alone, so there is nothing to wait for.
+	 */
+	spin_lock_irqsave(&host->clk_lock, flags);
+	if (!host->clk_gated && !host->clk_gating) {
+		host->clk_requests++;
+		spin_unlock_irqrestore(&host->clk_lock, flags);
+		cancel_delayed_work(&host->clk_gate_work);
+		return;
+	}
+	spin_unlock_irqrestore(&host->clk_lock, flags);
+
 	
 	cancel_delayed_work_sync(&host->clk_gate_work);
 	mutex_lock(&host->clk_gate_mutex);
@@ -151,6 +166,20 @@ static bool mmc_host_may_gate_card(struct mmc_card *card)
 	return !(card->quirks & MMC_QUIRK_BROKEN_CLK_GATING);
 }
 
+/* Keep the clock up this long after an SDIO interrupt was handled */
+#define MMC_CLKGATE_SDIO_BUSY_MS	50
+
+static unsigned long mmc_host_clk_gate_delay(struct mmc_host *host)
+{
+	unsigned long delay = host->clkgate_delay;
+
+	if (host->sdio_irqs &&
+	    time_before(jiffies, host->sdio_irq_active +
+			msecs_to_jiffies(MMC_CLKGATE_SDIO_BUSY_MS)))
+		delay = max_t(unsigned long, delay, MMC_CLKGATE_SDIO_BUSY_MS);
+	return msecs_to_jiffies(delay);
+}
+
 void mmc_host_clk_release(struct mmc_host *host)
 {
 	unsigned long flags;
@@ -160,7 +189,7 @@ void mmc_host_clk_release(struct mmc_host *host)
 	if (mmc_host_may_gate_card(host->card) &&
 	    !host->clk_requests)
 		queue_delayed_work(system_nrt_wq, &host->clk_gate_work,
-				msecs_to_jiffies(host->clkgate_delay));
+				mmc_host_clk_gate_delay(host));
 	spin_unlock_irqrestore(&host->clk_lock, flags);
 }
 
@@ -185,6 +214,7 @@ static inline void mmc_host_clk_init(struct mmc_host *host)
 	host->clk_delay = 8;
 	host->clkgate_delay = 0;
 	host->clk_gated = false;
+	host->clk_gating = false;
 	INIT_DELAYED_WORK(&host->clk_gate_work, mmc_host_clk_gate_work);
 	spin_lock_init(&host->clk_lock);
 	mutex_init(&host->clk_gate_mutex);
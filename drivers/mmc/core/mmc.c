@@ -1189,6 +1189,13 @@ static int mmc_init_card(struct mmc_host *host, u32 ocr,
 				GFP_KERNEL);
 			if (!card->wr_pack_stats.packing_events)
 				goto free_card;
+
+			card->wr_pack_adapt.max_packed =
+				card->ext_csd.max_packed_writes;
+			card->wr_pack_adapt.read_target_ms =
+				MMC_PACK_ADAPT_READ_TARGET_MS;
+			card->wr_pack_adapt.enabled =
+				!!(host->caps2 & MMC_CAP2_PACKED_WR_CONTROL);
 		}
 	}
 
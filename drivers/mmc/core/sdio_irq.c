@@ -28,6 +28,26 @@
 
 #include "sdio_ops.h"
 
+/* Interrupts handled back to back before the host is given up */
+#define SDIO_IRQ_BURST_MAX	8
+
+/* Time from the card interrupt to its function handler running */
+static void sdio_irq_account(struct mmc_host *host)
+{
+	u32 ns;
+
+	if (!host->sdio_irq_pending || !host->sdio_irq_stamp.tv64)
+		return;
+
+	ns = (u32)min_t(s64, ktime_to_ns(ktime_sub(ktime_get(),
+					host->sdio_irq_stamp)), UINT_MAX);
+	host->sdio_irq_stamp.tv64 = 0;
+	host->sdio_irq_lat_count++;
+	host->sdio_irq_lat_sum += ns;
+	if (ns > host->sdio_irq_lat_max)
+		host->sdio_irq_lat_max = ns;
+}
+
 static int process_sdio_pending_irqs(struct mmc_host *host)
 {
 	struct mmc_card *card = host->card;
@@ -37,6 +57,7 @@ static int process_sdio_pending_irqs(struct mmc_host *host)
 
 	func = card->sdio_single_irq;
 	if (func && host->sdio_irq_pending) {
+		sdio_irq_account(host);
 		func->irq_handler(func);
 		return 1;
 	}
@@ -48,6 +69,7 @@ static int process_sdio_pending_irqs(struct mmc_host *host)
 		return ret;
 	}
 
+	sdio_irq_account(host);
 	count = 0;
 	for (i = 1; i <= 7; i++) {
 		if (pending & (1 << i)) {
@@ -74,11 +96,46 @@ static int process_sdio_pending_irqs(struct mmc_host *host)
 	return ret;
 }
 
+static void sdio_irq_unmask(struct mmc_host *host)
+{
+	mmc_host_clk_hold(host);
+	host->ops->enable_sdio_irq(host, 1);
+	mmc_host_clk_release(host);
+}
+
+/*
+ * With one function owning the interrupt, unmask it again before giving up
+ * the host: an interrupt raised while the handler ran is then taken at once
+ * and handled under the same claim instead of after a release, a wakeup
+ * and a fresh claim.
+ */
+static int sdio_irq_burst(struct mmc_host *host, bool *unmasked)
+{
+	int ret, burst = 0;
+
+	for (;;) {
+		ret = process_sdio_pending_irqs(host);
+		host->sdio_irq_pending = false;
+		*unmasked = false;
+		if (ret <= 0 || !host->card->sdio_single_irq ||
+		    !(host->caps & MMC_CAP_SDIO_IRQ) ||
+		    ++burst >= SDIO_IRQ_BURST_MAX)
+			break;
+		sdio_irq_unmask(host);
+		*unmasked = true;
+		smp_mb();
+		if (!host->sdio_irq_pending)
+			break;
+	}
+	return ret;
+}
+
 static int sdio_irq_thread(void *_host)
 {
 	struct mmc_host *host = _host;
-	struct sched_param param = { .sched_priority = 1 };
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
 	unsigned long period, idle_period;
+	bool unmasked;
 	int ret;
 
 	sched_setscheduler(current, SCHED_FIFO, &param);
@@ -94,9 +151,10 @@ static int sdio_irq_thread(void *_host)
 		ret = __mmc_claim_host(host, &host->sdio_irq_thread_abort);
 		if (ret)
 			break;
-		ret = process_sdio_pending_irqs(host);
-		host->sdio_irq_pending = false;
+		ret = sdio_irq_burst(host, &unmasked);
 		mmc_release_host(host);
+		if (ret > 0)
+			host->sdio_irq_active = jiffies;
 
 		if (ret < 0) {
 			set_current_state(TASK_INTERRUPTIBLE);
@@ -117,9 +175,12 @@ static int sdio_irq_thread(void *_host)
 
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (host->caps & MMC_CAP_SDIO_IRQ) {
-			mmc_host_clk_hold(host);
-			host->ops->enable_sdio_irq(host, 1);
-			mmc_host_clk_release(host);
+			if (!unmasked)
+				sdio_irq_unmask(host);
+			else if (host->sdio_irq_pending) {
+				set_current_state(TASK_RUNNING);
+				continue;
+			}
 		}
 		if (!kthread_should_stop())
 			schedule_timeout(period);
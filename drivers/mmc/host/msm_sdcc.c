@@ -549,10 +549,14 @@ msmsdcc_sps_complete_cb(struct sps_event_notify *notify)
 		notify->data.transfer.iovec.size,
 		notify->data.transfer.iovec.flags);
 	
-	tasklet_schedule(&host->sps.tlet);
+	queue_kthread_work(&host->sps.worker, &host->sps.complete_work);
 }
 
-static void msmsdcc_sps_complete_tlet(unsigned long data)
+/*
+ * Runs on an RT thread, like a threaded irq handler, rather than in a
+ * tasklet that ends up behind ksoftirqd when other softirqs are busy.
+ */
+static void msmsdcc_sps_complete_work(struct kthread_work *work)
 {
 	unsigned long flags;
 	int i, rc;
@@ -560,7 +564,8 @@ static void msmsdcc_sps_complete_tlet(unsigned long data)
 	struct mmc_request *mrq;
 	struct sps_iovec iovec;
 	struct sps_pipe *sps_pipe_handle;
-	struct msmsdcc_host *host = (struct msmsdcc_host *)data;
+	struct msmsdcc_host *host = container_of(work, struct msmsdcc_host,
+						 sps.complete_work);
 	struct sps_event_notify *notify = &host->sps.notify;
 
 	spin_lock_irqsave(&host->lock, flags);
@@ -682,7 +687,6 @@ static void msmsdcc_sps_exit_curr_xfer(struct msmsdcc_host *host)
 }
 #else
 static inline void msmsdcc_sps_complete_cb(struct sps_event_notify *notify) { }
-static inline void msmsdcc_sps_complete_tlet(unsigned long data) { }
 static inline void msmsdcc_sps_exit_curr_xfer(struct msmsdcc_host *host) { }
 #endif 
 
@@ -904,6 +908,24 @@ static int msmsdcc_sps_start_xfer(struct msmsdcc_host *host,
 			host->dma.num_ents = 0;
 			goto out;
 		}
+	} else if (host->sps.prep.data == data) {
+		struct sps_transfer transfer = {
+			.iovec = host->sps.prep.iovec,
+			.iovec_count = host->sps.prep.count,
+			.user = host,
+		};
+
+		/* One lock and one doorbell for the whole request */
+		host->sps.prep.data = NULL;
+		rc = sps_transfer(sps_pipe_handle, &transfer);
+		if (rc) {
+			pr_err("%s: sps_transfer() error! rc=%d, pipe=0x%x\n",
+				mmc_hostname(host->mmc), rc,
+				(u32)sps_pipe_handle);
+			goto dma_map_err;
+		}
+		host->sps.xfer_req_cnt = transfer.iovec_count;
+		goto out;
 	}
 
 	for (i = 0; i < data->sg_len; i++) {
@@ -944,9 +966,53 @@ dma_map_err:
 out:
 	return rc;
 }
+
+/*
+ * Build the descriptors for a request that was mapped in pre_req, while
+ * the previous one is still on the bus.  pre_req and request are both
+ * issued by the host's claimer, so the slot needs no locking.
+ */
+static void msmsdcc_sps_prep_desc(struct msmsdcc_host *host,
+				  struct mmc_data *data)
+{
+	struct msmsdcc_sps_prep *prep = &host->sps.prep;
+	struct scatterlist *sg;
+	u32 addr, len, data_cnt;
+	u32 n = 0;
+	int i;
+
+	prep->data = NULL;
+	if (!prep->iovec)
+		return;
+
+	for_each_sg(data->sg, sg, data->sg_len, i) {
+		len = sg_dma_len(sg);
+		addr = sg_dma_address(sg);
+		while (len > 0) {
+			
+			if (n == SPS_PREP_DESCS)
+				return;
+			data_cnt = min_t(u32, len, SPS_MAX_DESC_SIZE);
+			prep->iovec[n].addr = addr;
+			prep->iovec[n].size = data_cnt;
+			prep->iovec[n].flags = 0;
+			addr += data_cnt;
+			len -= data_cnt;
+			n++;
+		}
+	}
+	if (!n)
+		return;
+
+	prep->iovec[n - 1].flags = SPS_IOVEC_FLAG_INT | SPS_IOVEC_FLAG_EOT;
+	prep->count = n;
+	prep->data = data;
+}
 #else
 static int msmsdcc_sps_start_xfer(struct msmsdcc_host *host,
 				struct mmc_data *data) { return 0; }
+static inline void msmsdcc_sps_prep_desc(struct msmsdcc_host *host,
+					 struct mmc_data *data) { }
 #endif 
 
 static void
@@ -1717,6 +1783,8 @@ msmsdcc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
 	}
 
 	data->host_cookie = 1;
+	if (is_sps_mode(host))
+		msmsdcc_sps_prep_desc(host, data);
 }
 
 static void
@@ -1741,6 +1809,8 @@ msmsdcc_post_req(struct mmc_host *mmc, struct mmc_request *mrq, int err)
 			     data->sg_len, dir);
 
 	data->host_cookie = 0;
+	if (host->sps.prep.data == data)
+		host->sps.prep.data = NULL;
 }
 
 static void
@@ -2906,21 +2976,23 @@ static void msmsdcc_enable_sdio_irq(struct mmc_host *mmc, int enable)
 {
 	struct msmsdcc_host *host = mmc_priv(mmc);
 	unsigned long flags;
+	u32 mask0, new_mask0;
 
 
 	spin_lock_irqsave(&host->lock, flags);
-	if (enable) {
+	if (enable)
 		host->mci_irqenable |= MCI_SDIOINTOPERMASK;
-		if (atomic_read(&host->clks_on)) {
-			writel_relaxed(readl_relaxed(host->base + MMCIMASK0) |
-				MCI_SDIOINTOPERMASK, host->base + MMCIMASK0);
-			mb();
-		}
-	} else {
+	else
 		host->mci_irqenable &= ~MCI_SDIOINTOPERMASK;
-		if (atomic_read(&host->clks_on)) {
-			writel_relaxed(readl_relaxed(host->base + MMCIMASK0) &
-				~MCI_SDIOINTOPERMASK, host->base + MMCIMASK0);
+	if (atomic_read(&host->clks_on)) {
+		mask0 = readl_relaxed(host->base + MMCIMASK0);
+		if (enable)
+			new_mask0 = mask0 | MCI_SDIOINTOPERMASK;
+		else
+			new_mask0 = mask0 & ~MCI_SDIOINTOPERMASK;
+		
+		if (new_mask0 != mask0) {
+			writel_relaxed(new_mask0, host->base + MMCIMASK0);
 			mb();
 		}
 	}
@@ -3948,6 +4020,24 @@ static int msmsdcc_sps_init(struct msmsdcc_host *host)
 {
 	int rc = 0;
 	struct sps_bam_props bam = {0};
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
+
+	host->sps.prep.iovec = kmalloc(SPS_PREP_DESCS *
+				       sizeof(struct sps_iovec), GFP_KERNEL);
+	if (!host->sps.prep.iovec)
+		pr_warn("%s: no memory for prepared descriptors\n",
+			mmc_hostname(host->mmc));
+
+	init_kthread_worker(&host->sps.worker);
+	init_kthread_work(&host->sps.complete_work, msmsdcc_sps_complete_work);
+	host->sps.worker_task = kthread_run(kthread_worker_fn,
+					    &host->sps.worker, "%s-sps",
+					    mmc_hostname(host->mmc));
+	if (IS_ERR(host->sps.worker_task)) {
+		rc = PTR_ERR(host->sps.worker_task);
+		goto worker_err;
+	}
+	sched_setscheduler(host->sps.worker_task, SCHED_FIFO, &param);
 
 	host->bam_base = ioremap(host->bam_memres->start,
 				resource_size(host->bam_memres));
@@ -4009,6 +4099,13 @@ sps_reset_err:
 reg_bam_err:
 	iounmap(host->bam_base);
 out:
+	if (rc)
+		kthread_stop(host->sps.worker_task);
+worker_err:
+	if (rc) {
+		kfree(host->sps.prep.iovec);
+		host->sps.prep.iovec = NULL;
+	}
 	return rc;
 }
 
@@ -4018,6 +4115,10 @@ static void msmsdcc_sps_exit(struct msmsdcc_host *host)
 	msmsdcc_sps_exit_ep_conn(host, &host->sps.prod);
 	sps_deregister_bam_device(host->sps.bam_handle);
 	iounmap(host->bam_base);
+	flush_kthread_worker(&host->sps.worker);
+	kthread_stop(host->sps.worker_task);
+	kfree(host->sps.prep.iovec);
+	host->sps.prep.iovec = NULL;
 }
 #endif 
 
@@ -4100,6 +4201,8 @@ static void msmsdcc_early_suspend(struct early_suspend *h)
 	spin_lock_irqsave(&host->lock, flags);
 	host->polling_enabled = host->mmc->caps & MMC_CAP_NEEDS_POLL;
 	host->mmc->caps &= ~MMC_CAP_NEEDS_POLL;
+	host->mmc->screen_off_jiffies = jiffies;
+	host->mmc->screen_off = true;
 	spin_unlock_irqrestore(&host->lock, flags);
 };
 static void msmsdcc_late_resume(struct early_suspend *h)
@@ -4108,6 +4211,7 @@ static void msmsdcc_late_resume(struct early_suspend *h)
 		container_of(h, struct msmsdcc_host, early_suspend);
 	unsigned long flags;
 
+	host->mmc->screen_off = false;
 	if (host->polling_enabled) {
 		spin_lock_irqsave(&host->lock, flags);
 		host->mmc->caps |= MMC_CAP_NEEDS_POLL;
@@ -4672,9 +4776,6 @@ msmsdcc_probe(struct platform_device *pdev)
 
 	tasklet_init(&host->dma_tlet, msmsdcc_dma_complete_tlet,
 			(unsigned long)host);
-
-	tasklet_init(&host->sps.tlet, msmsdcc_sps_complete_tlet,
-			(unsigned long)host);
 	if (is_dma_mode(host)) {
 		
 		ret = msmsdcc_init_dma(host);
@@ -5034,6 +5135,7 @@ msmsdcc_probe(struct platform_device *pdev)
 			pr_warning("%s: Failed to create emmc_bkops entry\n",
 				mmc_hostname(host->mmc));
 	}
+	device_enable_async_suspend(&pdev->dev);
 	return 0;
 
  remove_max_bus_bw_file:
@@ -5119,7 +5221,6 @@ static int msmsdcc_remove(struct platform_device *pdev)
 
 	del_timer_sync(&host->req_tout_timer);
 	tasklet_kill(&host->dma_tlet);
-	tasklet_kill(&host->sps.tlet);
 	mmc_remove_host(mmc);
 
 	if (plat->status_irq)
@@ -5618,6 +5719,8 @@ static int msmsdcc_pm_prepare_suspend(struct device *dev)
 	mmc_claim_host(mmc);
 
 	mmc->bkops_alarm_set = 0;
+	if (!mmc->bkops_trigger && !mmc->bkops_timer.need_bkops)
+		mmc->bkops_trigger = mmc_bkops_suspend_time(mmc->card);
 	if (mmc->bkops_trigger || mmc->bkops_timer.need_bkops || emmc_bkops_prerun) {
 		if (emmc_bkops_prerun) {
 			mmc->bkops_timer.need_bkops = EMMC_BKOPS_PRERUN_TIMER; 
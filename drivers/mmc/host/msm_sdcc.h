@@ -18,6 +18,7 @@
 
 #include <linux/ioport.h>
 #include <linux/interrupt.h>
+#include <linux/kthread.h>
 #include <linux/mmc/host.h>
 #include <linux/mmc/card.h>
 #include <linux/mmc/mmc.h>
@@ -229,6 +230,7 @@
 #define SPS_MAX_DESC_SIZE	(16 * 1024)
 #define SPS_MAX_DESC_LENGTH	8
 #define SPS_MAX_DESCS		(SPS_MAX_DESC_FIFO_SIZE / SPS_MAX_DESC_LENGTH)
+#define SPS_PREP_DESCS		256
 
 #define MMC_MAX_DMA_ROWS (64 * 1024 - 1)
 #define MMC_MAX_DMA_BOX_LENGTH (MMC_MAX_DMA_ROWS * MCI_FIFOSIZE)
@@ -290,6 +292,13 @@ struct msmsdcc_sps_ep_conn_data {
 	struct sps_register_event	event;
 };
 
+/* Descriptors built in pre_req for the next request */
+struct msmsdcc_sps_prep {
+	struct mmc_data			*data;
+	struct sps_iovec		*iovec;
+	u32				count;
+};
+
 struct msmsdcc_sps_data {
 	struct msmsdcc_sps_ep_conn_data	prod;
 	struct msmsdcc_sps_ep_conn_data	cons;
@@ -303,7 +312,10 @@ struct msmsdcc_sps_data {
 	unsigned int			busy;
 	unsigned int			xfer_req_cnt;
 	bool				pipe_reset_pending;
-	struct tasklet_struct		tlet;
+	struct msmsdcc_sps_prep		prep;
+	struct kthread_worker		worker;
+	struct task_struct		*worker_task;
+	struct kthread_work		complete_work;
 };
 
 struct msmsdcc_msm_bus_vote {
@@ -26,6 +26,7 @@
 #include <linux/if_arp.h>
 #include <linux/msm_rmnet.h>
 #include <linux/platform_device.h>
+#include <net/activity_stats.h>
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/earlysuspend.h>
@@ -42,6 +43,10 @@ static int msm_rmnet_bam_debug_mask;
 module_param_named(debug_enable, msm_rmnet_bam_debug_mask,
 			int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/* RFS flow entries per device, 0 leaves rx steering to userspace */
+static unsigned int rps_flows = 256;
+module_param(rps_flows, uint, S_IRUGO);
+
 #define DEBUG_MASK_LVL0 (1U << 0)
 #define DEBUG_MASK_LVL1 (1U << 1)
 #define DEBUG_MASK_LVL2 (1U << 2)
@@ -67,6 +72,9 @@ module_param_named(debug_enable, msm_rmnet_bam_debug_mask,
 #define HEADROOM_FOR_QOS    8
 #define TAILROOM            8 
 
+#define RMNET_NAPI_WEIGHT   64
+#define RMNET_RX_QUEUE_MAX  1000
+
 struct rmnet_private {
 	struct net_device_stats stats;
 	uint32_t ch_id;
@@ -83,6 +91,10 @@ struct rmnet_private {
 	u32 operation_mode; 
 	uint8_t device_up;
 	uint8_t in_reset;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;
+	unsigned long rx_polls;
+	unsigned long rx_gro_merged;
 };
 
 #ifdef CONFIG_MSM_RMNET_DEBUG
@@ -199,6 +211,47 @@ static ssize_t timeout_show(struct device *d, struct device_attribute *attr,
 DEVICE_ATTR(timeout, 0664, timeout_show, timeout_store);
 #endif
 
+static ssize_t napi_weight_store(struct device *d,
+				 struct device_attribute *attr,
+				 const char *buf, size_t n)
+{
+	struct rmnet_private *p = netdev_priv(to_net_dev(d));
+	unsigned long weight;
+
+	if (kstrtoul(buf, 10, &weight) || !weight ||
+	    weight > RMNET_NAPI_WEIGHT * 4)
+		return -EINVAL;
+	p->napi.weight = weight;
+	return n;
+}
+
+static ssize_t napi_weight_show(struct device *d,
+				struct device_attribute *attr, char *buf)
+{
+	struct rmnet_private *p = netdev_priv(to_net_dev(d));
+	return sprintf(buf, "%d\n", p->napi.weight);
+}
+
+static DEVICE_ATTR(napi_weight, 0664, napi_weight_show, napi_weight_store);
+
+static ssize_t rx_polls_show(struct device *d,
+			     struct device_attribute *attr, char *buf)
+{
+	struct rmnet_private *p = netdev_priv(to_net_dev(d));
+	return sprintf(buf, "%lu\n", p->rx_polls);
+}
+
+static DEVICE_ATTR(rx_polls, 0444, rx_polls_show, NULL);
+
+static ssize_t rx_gro_merged_show(struct device *d,
+				  struct device_attribute *attr, char *buf)
+{
+	struct rmnet_private *p = netdev_priv(to_net_dev(d));
+	return sprintf(buf, "%lu\n", p->rx_gro_merged);
+}
+
+static DEVICE_ATTR(rx_gro_merged, 0444, rx_gro_merged_show, NULL);
+
 static int rmnet_ioctl(struct net_device *dev, struct ifreq *ifr, int cmd);
 
 static __be16 rmnet_ip_type_trans(struct sk_buff *skb, struct net_device *dev)
@@ -260,18 +313,58 @@ static void bam_recv_notify(void *dev, struct sk_buff *skb)
 #endif
 			p->stats.rx_packets++;
 			p->stats.rx_bytes += skb->len;
+			activity_stats_radio(ACTIVITY_UID_NONE, skb->len, 0);
 		}
 		DBG1("[%s] Rx packet #%lu len=%d\n",
 			((struct net_device *)dev)->name,
 			p->stats.rx_packets, skb->len);
 
-		
-		netif_rx(skb);
+		if (!netif_running(dev) ||
+		    skb_queue_len(&p->rx_queue) >= RMNET_RX_QUEUE_MAX) {
+			p->stats.rx_dropped++;
+			dev_kfree_skb_any(skb);
+			return;
+		}
+
+		/* Delivered from bam_dmux's RX work, poll in softirq */
+		skb_queue_tail(&p->rx_queue, skb);
+		local_bh_disable();
+		napi_schedule(&p->napi);
+		local_bh_enable();
 	} else
 		pr_err(MODULE_NAME "[%s] %s: No skb received",
 			((struct net_device *)dev)->name, __func__);
 }
 
+static int rmnet_poll(struct napi_struct *napi, int budget)
+{
+	struct rmnet_private *p = container_of(napi, struct rmnet_private,
+					       napi);
+	struct sk_buff *skb;
+	gro_result_t ret;
+	int work = 0;
+
+	p->rx_polls++;
+	while (work < budget) {
+		skb = skb_dequeue(&p->rx_queue);
+		if (!skb)
+			break;
+		ret = napi_gro_receive(napi, skb);
+		if (ret == GRO_MERGED || ret == GRO_MERGED_FREE)
+			p->rx_gro_merged++;
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* Catch packets queued while NAPI_STATE_SCHED was still set */
+		if (!skb_queue_empty(&p->rx_queue))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
 static int _rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct rmnet_private *p = netdev_priv(dev);
@@ -402,8 +495,10 @@ static int rmnet_open(struct net_device *dev)
 
 	rc = __rmnet_open(dev);
 
-	if (rc == 0)
+	if (rc == 0) {
+		napi_enable(&((struct rmnet_private *)netdev_priv(dev))->napi);
 		netif_start_queue(dev);
+	}
 
 	return rc;
 }
@@ -426,10 +521,14 @@ static int __rmnet_close(struct net_device *dev)
 
 static int rmnet_stop(struct net_device *dev)
 {
+	struct rmnet_private *p = netdev_priv(dev);
+
 	DBG0("[%s] rmnet_stop()\n", dev->name);
 
 	__rmnet_close(dev);
 	netif_stop_queue(dev);
+	napi_disable(&p->napi);
+	skb_queue_purge(&p->rx_queue);
 
 	return 0;
 }
@@ -452,6 +551,8 @@ static int rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 	unsigned long flags;
 	int awake;
 	int ret = 0;
+	unsigned int len = skb->len;
+	uid_t uid;
 
 	DBG0("[%s] rmnet_xmit()\n", dev->name);
 	if (netif_queue_stopped(dev)) {
@@ -460,6 +561,9 @@ static int rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 		return 0;
 	}
 
+	/* The skb may be gone once handed to bam_dmux */
+	uid = activity_stats_skb_uid(skb);
+
 	spin_lock_irqsave(&p->lock, flags);
 	awake = msm_bam_dmux_ul_power_vote();
 	if (!awake) {
@@ -467,6 +571,7 @@ static int rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 		netif_stop_queue(dev);
 		p->waiting_for_ul_skb = skb;
 		spin_unlock_irqrestore(&p->lock, flags);
+		activity_stats_radio(uid, len, 1);
 		ret = 0;
 		goto exit;
 	}
@@ -490,6 +595,7 @@ static int rmnet_xmit(struct sk_buff *skb, struct net_device *dev)
 		ret = NETDEV_TX_BUSY;
 		goto exit;
 	}
+	activity_stats_radio(uid, len, 1);
 
 	spin_lock_irqsave(&p->tx_queue_lock, flags);
 	if (msm_bam_dmux_is_ch_full(p->ch_id)) {
@@ -685,6 +791,9 @@ static int bam_rmnet_probe(struct platform_device *pdev)
        
 
 	p = netdev_priv(netdevs[i]);
+	if (rps_flows)
+		netif_rps_follow_irq(netdevs[i], msm_bam_dmux_get_irq(),
+				     rps_flows);
 	if (p->in_reset) {
 		DBG0("[%s] is reset\n", pdev->name);
 		p->in_reset = 0;
@@ -767,6 +876,8 @@ static int __init rmnet_init(void)
 		p->in_reset = 0;
 		spin_lock_init(&p->lock);
 		spin_lock_init(&p->tx_queue_lock);
+		skb_queue_head_init(&p->rx_queue);
+		netif_napi_add(dev, &p->napi, rmnet_poll, RMNET_NAPI_WEIGHT);
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		p->timeout_us = timeout_us;
 		p->wakeups_xmit = p->wakeups_rcv = 0;
@@ -780,6 +891,12 @@ static int __init rmnet_init(void)
 			return ret;
 		}
 
+		if (device_create_file(d, &dev_attr_napi_weight) ||
+		    device_create_file(d, &dev_attr_rx_polls) ||
+		    device_create_file(d, &dev_attr_rx_gro_merged))
+			pr_err(MODULE_NAME "%s: unable to create napi attrs"
+			       " %d\n", __func__, n);
+
 #ifdef CONFIG_MSM_RMNET_DEBUG
 		if (device_create_file(d, &dev_attr_timeout))
 			continue;
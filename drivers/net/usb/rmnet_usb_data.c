@@ -29,6 +29,12 @@
 
 static int	data_msg_dbg_mask;
 
+/* Bulk urbs kept in flight per direction, 0 leaves it to usbnet */
+static unsigned int rx_qlen = 100;
+module_param(rx_qlen, uint, S_IRUGO | S_IWUSR);
+static unsigned int tx_qlen = 100;
+module_param(tx_qlen, uint, S_IRUGO | S_IWUSR);
+
 enum {
 	DEBUG_MASK_LVL0 = 1U << 0,
 	DEBUG_MASK_LVL1 = 1U << 1,
@@ -202,6 +208,8 @@ static int rmnet_usb_bind(struct usbnet *usbnet, struct usb_interface *iface)
 	usbnet->out = usb_sndbulkpipe(usbnet->udev,
 		bulk_out->desc.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK);
 	usbnet->status = int_in;
+	usbnet->rx_qlen = rx_qlen;
+	usbnet->tx_qlen = tx_qlen;
 
 	
 	strlcpy(usbnet->net->name, "rmnet_usb%d", IFNAMSIZ);
@@ -444,6 +452,7 @@ static void rmnet_usb_setup(struct net_device *dev)
 static int rmnet_usb_data_status(struct seq_file *s, void *unused)
 {
 	struct usbnet *unet = s->private;
+	int i;
 
 	seq_printf(s, "RMNET_MODE_LLP_IP:  %d\n",
 			test_bit(RMNET_MODE_LLP_IP, &unet->data[0]));
@@ -478,6 +487,13 @@ static int rmnet_usb_data_status(struct seq_file *s, void *unused)
 	seq_printf(s, "EVENT_DEV_ASLEEP:   %d\n",
 			test_bit(EVENT_DEV_ASLEEP, &unet->flags));
 
+	seq_printf(s, "urb usec     rx         tx\n");
+	for (i = 0; i < USBNET_LAT_BUCKETS; i++)
+		seq_printf(s, "%s%-8u %-10u %u\n",
+			i == USBNET_LAT_BUCKETS - 1 ? ">=" : "< ",
+			1U << (i == USBNET_LAT_BUCKETS - 1 ? i - 1 : i),
+			unet->rx_lat[i], unet->tx_lat[i]);
+
 	return 0;
 }
 
@@ -633,6 +649,7 @@ static const struct driver_info rmnet_info_pid9034 = {
 	.tx_fixup      = rmnet_usb_tx_fixup,
 	.rx_fixup      = rmnet_usb_rx_fixup,
 	.manage_power  = rmnet_usb_manage_power,
+	.flags         = FLAG_RX_NAPI,
 	.data          = PID9034_IFACE_MASK,
 };
 
@@ -642,6 +659,7 @@ static const struct driver_info rmnet_info_pid9048 = {
 	.tx_fixup      = rmnet_usb_tx_fixup,
 	.rx_fixup      = rmnet_usb_rx_fixup,
 	.manage_power  = rmnet_usb_manage_power,
+	.flags         = FLAG_RX_NAPI,
 	.data          = PID9048_IFACE_MASK,
 };
 
@@ -651,6 +669,7 @@ static const struct driver_info rmnet_info_pid904c = {
 	.tx_fixup      = rmnet_usb_tx_fixup,
 	.rx_fixup      = rmnet_usb_rx_fixup,
 	.manage_power  = rmnet_usb_manage_power,
+	.flags         = FLAG_RX_NAPI,
 	.data          = PID904C_IFACE_MASK,
 };
 
@@ -42,11 +42,15 @@
 
 
 #define RX_MAX_QUEUE_MEMORY (60 * 1518)
-#define	RX_QLEN(dev) (((dev)->udev->speed == USB_SPEED_HIGH) ? \
+#define	RX_QLEN(dev) ((dev)->rx_qlen ? (dev)->rx_qlen : \
+			((dev)->udev->speed == USB_SPEED_HIGH) ? \
 			(RX_MAX_QUEUE_MEMORY/(dev)->rx_urb_size) : 4)
-#define	TX_QLEN(dev) (((dev)->udev->speed == USB_SPEED_HIGH) ? \
+#define	TX_QLEN(dev) ((dev)->tx_qlen ? (dev)->tx_qlen : \
+			((dev)->udev->speed == USB_SPEED_HIGH) ? \
 			(RX_MAX_QUEUE_MEMORY/(dev)->hard_mtu) : 4)
 
+#define USBNET_NAPI_WEIGHT	64
+
 #define TX_TIMEOUT_JIFFIES	(5*HZ)
 
 #define THROTTLE_JIFFIES	(HZ/8)
@@ -219,7 +223,11 @@ void usbnet_skb_return (struct usbnet *dev, struct sk_buff *skb)
 	if (skb_defer_rx_timestamp(skb))
 		return;
 
-	status = netif_rx_ni(skb);
+	/* Straight up the stack when called from usbnet_poll() */
+	if ((dev->driver_info->flags & FLAG_RX_NAPI) && in_serving_softirq())
+		status = netif_receive_skb(skb);
+	else
+		status = netif_rx_ni(skb);
 	if (status != NET_RX_SUCCESS)
 		netif_dbg(dev, rx_err, dev->net,
 			  "netif_rx status %d\n", status);
@@ -262,6 +270,21 @@ static void __usbnet_queue_skb(struct sk_buff_head *list,
 	entry->state = state;
 }
 
+static void usbnet_count_lat(unsigned int *hist, struct skb_data *entry)
+{
+	s64 us = ktime_us_delta(ktime_get(), entry->submitted);
+
+	hist[min_t(int, fls64(us > 0 ? us : 0), USBNET_LAT_BUCKETS - 1)]++;
+}
+
+static void usbnet_kick_bh(struct usbnet *dev)
+{
+	if (dev->driver_info->flags & FLAG_RX_NAPI)
+		napi_schedule(&dev->napi);
+	else
+		queue_work(usbnet_wq, &dev->bh_w);
+}
+
 
 
 static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
@@ -279,7 +302,7 @@ static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 	spin_lock(&dev->done.lock);
 	__skb_queue_tail(&dev->done, skb);
 	if (dev->done.qlen == 1)
-		queue_work(usbnet_wq, &dev->bh_w);
+		usbnet_kick_bh(dev);
 	spin_unlock_irqrestore(&dev->done.lock, flags);
 	return old_state;
 }
@@ -323,6 +346,7 @@ static int rx_submit (struct usbnet *dev, struct urb *urb, gfp_t flags)
 
 	usb_fill_bulk_urb (urb, dev->udev, dev->in,
 		skb->data, size, rx_complete, skb);
+	entry->submitted = ktime_get();
 
 	spin_lock_irqsave (&dev->rxq.lock, lockflags);
 
@@ -411,6 +435,7 @@ static void rx_complete (struct urb *urb)
 	skb_put (skb, urb->actual_length);
 	state = rx_done;
 	entry->urb = NULL;
+	usbnet_count_lat(dev->rx_lat, entry);
 
 	
 	if (enable_tx_rx_debug && (urb_status != -ECONNRESET))
@@ -672,6 +697,8 @@ int usbnet_stop (struct net_device *net)
 
 	usbnet_purge_paused_rxq(dev);
 
+	if (info->flags & FLAG_RX_NAPI)
+		napi_disable(&dev->napi);
 	dev->flags = 0;
 	del_timer_sync (&dev->delay);
 	cancel_work_sync(&dev->bh_w);
@@ -737,6 +764,8 @@ int usbnet_open (struct net_device *net)
 	}
 
 	set_bit(EVENT_DEV_OPEN, &dev->flags);
+	if (info->flags & FLAG_RX_NAPI)
+		napi_enable(&dev->napi);
 	netif_start_queue (net);
 	netif_info(dev, ifup, dev->net,
 		   "open: enable queueing (rx %d, tx %d) mtu %d %s framing\n",
@@ -975,6 +1004,7 @@ static void tx_complete (struct urb *urb)
 		netdev_info(dev->net, "[RMNET_D] tx_c, status: %d, tx bytes: %lu\n", urb->status, (dev->net->stats.tx_bytes + entry->length) );
 	
 
+	usbnet_count_lat(dev->tx_lat, entry);
 	if (urb->status == 0) {
 		if (!(dev->driver_info->flags & FLAG_MULTI_PACKET))
 			dev->net->stats.tx_packets++;
@@ -1078,6 +1108,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 
 	usb_fill_bulk_urb (urb, dev->udev, dev->out,
 			skb->data, skb->len, tx_complete, skb);
+	entry->submitted = ktime_get();
 
 	if (length % dev->maxpacket == 0) {
 		if (!(info->flags & FLAG_SEND_ZLP)) {
@@ -1163,18 +1194,20 @@ EXPORT_SYMBOL_GPL(usbnet_start_xmit);
 
 
 
-static void usbnet_bh (unsigned long param)
+/* Returns the number of received frames handed to rx_process() */
+static int usbnet_done(struct usbnet *dev, int budget)
 {
-	struct usbnet		*dev = (struct usbnet *) param;
 	struct sk_buff		*skb;
 	struct skb_data		*entry;
+	int			work = 0;
 
-	while ((skb = skb_dequeue (&dev->done))) {
+	while (work < budget && (skb = skb_dequeue (&dev->done))) {
 		entry = (struct skb_data *) skb->cb;
 		switch (entry->state) {
 		case rx_done:
 			entry->state = rx_cleanup;
 			rx_process (dev, skb);
+			work++;
 			continue;
 		case tx_done:
 		case rx_cleanup:
@@ -1185,8 +1218,11 @@ static void usbnet_bh (unsigned long param)
 			netdev_dbg(dev->net, "bogus skb state %d\n", entry->state);
 		}
 	}
+	return work;
+}
 
-	
+static void usbnet_refill(struct usbnet *dev)
+{
 	if (dev->wait) {
 		if ((dev->txq.qlen + dev->rxq.qlen + dev->done.qlen) == 0) {
 			wake_up(&unlink_wakeup);
@@ -1225,15 +1261,50 @@ static void usbnet_bh (unsigned long param)
 	}
 }
 
+static void usbnet_bh (unsigned long param)
+{
+	struct usbnet		*dev = (struct usbnet *) param;
+
+	if (dev->driver_info->flags & FLAG_RX_NAPI) {
+		napi_schedule(&dev->napi);
+		return;
+	}
+	usbnet_done(dev, INT_MAX);
+	usbnet_refill(dev);
+}
+
 static void usbnet_bh_w(struct work_struct *work)
 {
 	struct usbnet		*dev =
 		container_of(work, struct usbnet, bh_w);
 	unsigned long param = (unsigned long)dev;
 
+	/* From process context, let the softirq run the poll right away */
+	if (dev->driver_info->flags & FLAG_RX_NAPI) {
+		local_bh_disable();
+		napi_schedule(&dev->napi);
+		local_bh_enable();
+		return;
+	}
 	usbnet_bh(param);
 }
 
+static int usbnet_poll(struct napi_struct *napi, int budget)
+{
+	struct usbnet		*dev = container_of(napi, struct usbnet, napi);
+	int			work;
+
+	work = usbnet_done(dev, budget);
+	usbnet_refill(dev);
+	if (work < budget) {
+		napi_complete(napi);
+		/* defer_bh() only kicks us when done goes non-empty */
+		if (!skb_queue_empty(&dev->done))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
 
 
 void usbnet_disconnect (struct usb_interface *intf)
@@ -1352,6 +1423,9 @@ usbnet_probe (struct usb_interface *udev, const struct usb_device_id *prod)
 	skb_queue_head_init (&dev->done);
 	skb_queue_head_init(&dev->rxq_pause);
 	INIT_WORK(&dev->bh_w, usbnet_bh_w);
+	if (info->flags & FLAG_RX_NAPI)
+		netif_napi_add(net, &dev->napi, usbnet_poll,
+			       USBNET_NAPI_WEIGHT);
 	INIT_WORK (&dev->kevent, kevent);
 	init_usb_anchor(&dev->deferred);
 	dev->delay.function = usbnet_bh;
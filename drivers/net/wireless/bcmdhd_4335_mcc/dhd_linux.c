@@ -337,6 +337,12 @@ typedef struct dhd_info {
 	spinlock_t	rxf_lock;
 #endif 
 #endif 
+#ifdef DHD_NAPI_RX
+	struct napi_struct	rx_napi;
+	struct net_device	rx_napi_dev;
+	struct sk_buff_head	rx_napi_queue;
+	bool			rx_napi_enabled;
+#endif
 	bool dhd_tasklet_create;
 	tsk_ctl_t	thr_sysioc_ctl;
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27))
@@ -483,6 +489,22 @@ int dhd_rxf_prio = CUSTOM_RXF_PRIO_SETTING;
 module_param(dhd_rxf_prio, int, 0);
 #endif 
 
+#ifdef DHD_NAPI_RX
+/* Deliver received frames through NAPI/GRO instead of netif_rx_ni() */
+uint dhd_napi_rx = 1;
+module_param(dhd_napi_rx, uint, 0644);
+
+/* CPU the NAPI poll runs on, -1 for the one that ran the DPC */
+int dhd_napi_cpu = -1;
+module_param(dhd_napi_cpu, int, 0644);
+#endif
+
+#ifdef CONFIG_RPS
+/* RFS flow entries for each registered interface, 0 leaves it to userspace */
+uint dhd_rps_flows = 256;
+module_param(dhd_rps_flows, uint, 0644);
+#endif
+
 extern int dhd_dongle_ramsize;
 module_param(dhd_dongle_ramsize, int, 0);
 #endif 
@@ -627,6 +649,9 @@ extern int register_pm_notifier(struct notifier_block *nb);
 extern int unregister_pm_notifier(struct notifier_block *nb);
 #endif 
 
+#ifdef DHD_NAPI_RX
+static void dhd_napi_sched_rx(dhd_info_t *dhd, struct sk_buff_head *rxq);
+#endif
 #if defined(DHDTHREAD) && defined(RXFRAME_THREAD)
 static void dhd_sched_rxf(dhd_pub_t *dhdp, void *skb);
 static void dhd_os_rxflock(dhd_pub_t *pub);
@@ -1693,6 +1718,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	void *skbhead = NULL;
 	void *skbprev = NULL;
 #endif 
+#ifdef DHD_NAPI_RX
+	struct sk_buff_head napi_rxq;
+#endif
 #ifdef DHD_RX_DUMP
 #ifdef DHD_RX_FULL_DUMP
 	int k;
@@ -1703,6 +1731,9 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
+#ifdef DHD_NAPI_RX
+	__skb_queue_head_init(&napi_rxq);
+#endif
 #ifdef CUSTOMER_HW_ONE
 	memset(&event,0,sizeof(event));
 	if (dhdp->os_stopped) {
@@ -1898,6 +1929,12 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 		ifp->stats.rx_bytes += skb->len;
 		ifp->stats.rx_packets++;
 
+#ifdef DHD_NAPI_RX
+		if (dhd->rx_napi_enabled && dhd_napi_rx) {
+			__skb_queue_tail(&napi_rxq, skb);
+			continue;
+		}
+#endif
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -1923,6 +1960,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 #if defined(DHDTHREAD) && defined(RXFRAME_THREAD)
 	if (skbhead)
 		dhd_sched_rxf(dhdp, skbhead);
+#endif
+#ifdef DHD_NAPI_RX
+	if (!skb_queue_empty(&napi_rxq))
+		dhd_napi_sched_rx(dhd, &napi_rxq);
 #endif
 	DHD_OS_WAKE_LOCK_RX_TIMEOUT_ENABLE(dhdp, tout_rx);
 	DHD_OS_WAKE_LOCK_CTRL_TIMEOUT_ENABLE(dhdp, tout_ctrl);
@@ -2322,6 +2363,114 @@ dhd_sched_rxf(dhd_pub_t *dhdp, void *skb)
 }
 #endif 
 
+#ifdef DHD_NAPI_RX
+#define DHD_NAPI_WEIGHT		64
+#define DHD_NAPI_QUEUE_MAX	2048
+
+static int
+dhd_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, rx_napi);
+	struct sk_buff_head rxq;
+	struct sk_buff *skb;
+	unsigned long flags;
+	int done = 0;
+
+	__skb_queue_head_init(&rxq);
+	spin_lock_irqsave(&dhd->rx_napi_queue.lock, flags);
+	while (skb_queue_len(&rxq) < budget &&
+	       (skb = __skb_dequeue(&dhd->rx_napi_queue)) != NULL)
+		__skb_queue_tail(&rxq, skb);
+	spin_unlock_irqrestore(&dhd->rx_napi_queue.lock, flags);
+
+	while ((skb = __skb_dequeue(&rxq)) != NULL) {
+		napi_gro_receive(napi, skb);
+		done++;
+	}
+
+	if (done < budget) {
+		napi_complete(napi);
+		/* A batch queued before the complete did not reschedule us */
+		if (!skb_queue_empty(&dhd->rx_napi_queue))
+			napi_schedule(napi);
+	}
+	return done;
+}
+
+static void
+dhd_napi_kick(void *info)
+{
+	dhd_info_t *dhd = (dhd_info_t *)info;
+
+	napi_schedule(&dhd->rx_napi);
+}
+
+static void
+dhd_napi_nop(void *info)
+{
+}
+
+/* Called from the DPC with a batch of frames ready for the stack */
+static void
+dhd_napi_sched_rx(dhd_info_t *dhd, struct sk_buff_head *rxq)
+{
+	unsigned long flags;
+	int cpu;
+
+	spin_lock_irqsave(&dhd->rx_napi_queue.lock, flags);
+	if (skb_queue_len(&dhd->rx_napi_queue) < DHD_NAPI_QUEUE_MAX)
+		skb_queue_splice_tail_init(rxq, &dhd->rx_napi_queue);
+	spin_unlock_irqrestore(&dhd->rx_napi_queue.lock, flags);
+
+	if (!skb_queue_empty(rxq)) {
+		DHD_ERROR(("%s: napi backlog full, drop %d\n", __FUNCTION__,
+			skb_queue_len(rxq)));
+		dhd->pub.dstats.rx_dropped += skb_queue_len(rxq);
+		__skb_queue_purge(rxq);
+	}
+
+	cpu = get_cpu();
+	if (dhd_napi_cpu < 0 || dhd_napi_cpu == cpu ||
+	    smp_call_function_single(dhd_napi_cpu, dhd_napi_kick, dhd, 0)) {
+		local_bh_disable();
+		napi_schedule(&dhd->rx_napi);
+		local_bh_enable();
+	}
+	put_cpu();
+}
+
+static void
+dhd_napi_init(dhd_info_t *dhd)
+{
+	skb_queue_head_init(&dhd->rx_napi_queue);
+	init_dummy_netdev(&dhd->rx_napi_dev);
+	netif_napi_add(&dhd->rx_napi_dev, &dhd->rx_napi, dhd_napi_poll,
+		DHD_NAPI_WEIGHT);
+	napi_enable(&dhd->rx_napi);
+	dhd->rx_napi_enabled = TRUE;
+}
+
+static void
+dhd_napi_deinit(dhd_info_t *dhd)
+{
+	int cpu;
+
+	if (!dhd->rx_napi_enabled)
+		return;
+	dhd->rx_napi_enabled = FALSE;
+	napi_disable(&dhd->rx_napi);
+
+	/* Let kicks still in flight to other CPUs run before the napi goes */
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		smp_call_function_single(cpu, dhd_napi_nop, NULL, 1);
+	put_online_cpus();
+
+	netif_napi_del(&dhd->rx_napi);
+	skb_queue_purge(&dhd->rx_napi_queue);
+}
+#endif 
+
 #ifdef TOE
 static int
 dhd_toe_get(dhd_info_t *dhd, int ifidx, uint32 *toe_ol)
@@ -3304,6 +3453,9 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 #if defined(DHDTHREAD) && defined(RXFRAME_THREAD)
 	spin_lock_init(&dhd->rxf_lock);
 #endif 
+#ifdef DHD_NAPI_RX
+	dhd_napi_init(dhd);
+#endif
 
 	
 	spin_lock_init(&dhd->wakelock_spinlock);
@@ -4630,6 +4782,12 @@ dhd_net_attach(dhd_pub_t *dhdp, int ifidx)
 		net->name,
 		MAC2STRDBG(net->dev_addr));
 
+#ifdef CONFIG_RPS
+	/* The OOB interrupt is the sdio layer's, steer away from cpu0 */
+	if (dhd_rps_flows)
+		netif_rps_follow_irq(net, 0, dhd_rps_flows);
+#endif
+
 #if defined(SOFTAP) && defined(WL_WIRELESS_EXT) && !defined(WL_CFG80211)
 		wl_iw_iscan_set_scan_broadcast_prep(net, 1);
 #endif
@@ -4796,6 +4954,9 @@ void dhd_detach(dhd_pub_t *dhdp)
 #endif 
 		tasklet_kill(&dhd->tasklet);
 	}
+#ifdef DHD_NAPI_RX
+	dhd_napi_deinit(dhd);
+#endif
 #ifdef WL_CFG80211
 	if (dhd->dhd_state & DHD_ATTACH_STATE_CFG80211) {
 		wl_cfg80211_detach(NULL);
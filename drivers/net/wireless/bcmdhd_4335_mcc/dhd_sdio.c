@@ -354,6 +354,9 @@ typedef struct dhd_bus {
 	uint		rxglomfail;		
 	uint		rxglomframes;		
 	uint		rxglompkts;		
+	uint		rxglomclone;		
+	uint		txglomframes;		
+	uint		txglompkts;		
 	uint		f2rxhdrs;		
 	uint		f2rxdata;		
 	uint		f2txdata;		
@@ -379,6 +382,13 @@ typedef struct dhd_bus {
 	bool		glom_enable;	
 	uint8		glom_mode;	
 	uint32		glomsize;	
+	bool		glom_adapt;	
+	uint16		glom_cur;	
+	int8		glom_dir;	
+	uint16		glom_capped;	
+	uint32		glom_win_start;	
+	uint32		glom_win_bytes;	
+	uint32		glom_win_rate;	
 #endif
 } dhd_bus_t;
 
@@ -2009,6 +2019,60 @@ dhd_bus_txdata(struct dhd_bus *bus, void *pkt)
 	return ret;
 }
 
+#ifdef BCMSDIOH_TXGLOM
+#define TXGLOM_ADAPT_MS		100
+
+/*
+ * Tune the TX glom size after each superframe.  A failed write halves it.
+ * Otherwise, once per window in which the size held packets back, take one
+ * step and keep going the same way while the bus throughput improves,
+ * turning round when it drops.  A window stretched by an idle link says
+ * nothing about the size and only restarts the measurement.
+ */
+static void
+dhdsdio_txglom_adapt(dhd_bus_t *bus, uint bytes, int ret, bool capped)
+{
+	uint32 now, elapsed, rate;
+
+	if (ret) {
+		bus->glom_cur = MAX(bus->glom_cur / 2, 1);
+		bus->glom_dir = -1;
+		return;
+	}
+
+	now = OSL_SYSUPTIME();
+	if (!bus->glom_win_start)
+		bus->glom_win_start = now;
+	bus->glom_win_bytes += bytes;
+	if (capped)
+		bus->glom_capped++;
+
+	elapsed = now - bus->glom_win_start;
+	if (elapsed < TXGLOM_ADAPT_MS)
+		return;
+
+	rate = bus->glom_win_bytes / elapsed;
+	if (elapsed > 2 * TXGLOM_ADAPT_MS)
+		rate = 0;
+	else if (bus->glom_capped) {
+		if (rate < bus->glom_win_rate)
+			bus->glom_dir = -bus->glom_dir;
+		if (bus->glom_dir > 0 && bus->glom_cur < bus->glomsize)
+			bus->glom_cur++;
+		else if (bus->glom_dir < 0 && bus->glom_cur > 1)
+			bus->glom_cur--;
+		else
+			bus->glom_dir = -bus->glom_dir;
+		DHD_GLOM(("%s: %u bytes/ms (was %u), txglomsize now %u\n",
+		          __FUNCTION__, rate, bus->glom_win_rate, bus->glom_cur));
+	}
+	bus->glom_win_rate = rate;
+	bus->glom_win_start = now;
+	bus->glom_win_bytes = 0;
+	bus->glom_capped = 0;
+}
+#endif
+
 static uint
 dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 {
@@ -2021,7 +2085,7 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 	uint8 tx_prec_map;
 	uint8 txpktqlen = 0;
 #ifdef BCMSDIOH_TXGLOM
-	uint i;
+	uint i, qlen, glom_max;
 	uint8 glom_cnt;
 #endif
 
@@ -2043,8 +2107,10 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 		if (bus->glom_enable) {
 			void *pkttable[SDPCM_MAXGLOM_SIZE];
 			dhd_os_sdlock_txq(bus->dhd);
-			glom_cnt = MIN(DATABUFCNT(bus), bus->glomsize);
-			glom_cnt = MIN(glom_cnt, pktq_mlen(&bus->txq, tx_prec_map));
+			glom_max = bus->glom_adapt ? bus->glom_cur : bus->glomsize;
+			qlen = pktq_mlen(&bus->txq, tx_prec_map);
+			glom_cnt = MIN(DATABUFCNT(bus), glom_max);
+			glom_cnt = MIN(glom_cnt, qlen);
 
 			
 			if (bus->glom_mode == SDPCM_TXGLOM_CPY)
@@ -2087,6 +2153,14 @@ dhdsdio_sendfromq(dhd_bus_t *bus, uint maxframes)
 					datalen += datalen_tmp;
 			}
 			cnt += i-1;
+
+			bus->txglomframes++;
+			bus->txglompkts += i;
+			DHD_GLOM(("%s: txglom %d pkts %d bytes, size %d/%d, queued %d, ret %d\n",
+			          __FUNCTION__, i, datalen, glom_max, bus->glomsize, qlen, ret));
+			if (bus->glom_adapt)
+				dhdsdio_txglom_adapt(bus, datalen, ret,
+				                     (glom_cnt == glom_max) && (qlen > glom_max));
 		} else
 #endif 
 		{
@@ -2547,6 +2621,7 @@ enum {
 #endif
 	IOV_TXGLOMSIZE,
 	IOV_TXGLOMMODE,
+	IOV_TXGLOMADAPT,
 	IOV_HANGREPORT
 };
 
@@ -2600,6 +2675,7 @@ const bcm_iovar_t dhdsdio_iovars[] = {
 #endif
 	{"txglomsize", IOV_TXGLOMSIZE, 0, IOVT_UINT32, 0 },
 	{"txglommode", IOV_TXGLOMMODE, 0, IOVT_UINT32, 0 },
+	{"txglomadapt", IOV_TXGLOMADAPT, 0, IOVT_BOOL, 0 },
 	{"fw_hang_report", IOV_HANGREPORT, 0, IOVT_BOOL, 0 },
 	{NULL, 0, 0, 0, 0 }
 };
@@ -2642,8 +2718,15 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 	            bus->rx_hdrfail, bus->rx_badhdr, bus->rx_badseq);
 	bcm_bprintf(strbuf, "fc_rcvd %u, fc_xoff %u, fc_xon %u\n",
 	            bus->fc_rcvd, bus->fc_xoff, bus->fc_xon);
-	bcm_bprintf(strbuf, "rxglomfail %u, rxglomframes %u, rxglompkts %u\n",
-	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts);
+	bcm_bprintf(strbuf, "rxglomfail %u, rxglomframes %u, rxglompkts %u, rxglomclone %u\n",
+	            bus->rxglomfail, bus->rxglomframes, bus->rxglompkts, bus->rxglomclone);
+	bcm_bprintf(strbuf, "txglomframes %u, txglompkts %u",
+	            bus->txglomframes, bus->txglompkts);
+#ifdef BCMSDIOH_TXGLOM
+	bcm_bprintf(strbuf, ", txglomsize %u/%u%s",
+	            bus->glom_cur, bus->glomsize, bus->glom_adapt ? " adaptive" : "");
+#endif
+	bcm_bprintf(strbuf, "\n");
 	bcm_bprintf(strbuf, "f2rx (hdrs/data) %u (%u/%u), f2tx %u f1regs %u\n",
 	            (bus->f2rxhdrs + bus->f2rxdata), bus->f2rxhdrs, bus->f2rxdata,
 	            bus->f2txdata, bus->f1regdata);
@@ -2661,6 +2744,11 @@ dhd_bus_dump(dhd_pub_t *dhdp, struct bcmstrbuf *strbuf)
 		dhd_dump_pct(strbuf, ", pkts/glom", bus->rxglompkts, bus->rxglomframes);
 		bcm_bprintf(strbuf, "\n");
 
+		dhd_dump_pct(strbuf, "Tx: glom pct", (100 * bus->txglompkts),
+		             bus->dhd->tx_packets);
+		dhd_dump_pct(strbuf, ", pkts/glom", bus->txglompkts, bus->txglomframes);
+		bcm_bprintf(strbuf, "\n");
+
 		dhd_dump_pct(strbuf, "Tx: pkts/f2wr", bus->dhd->tx_packets, bus->f2txdata);
 		dhd_dump_pct(strbuf, ", pkts/f1sd", bus->dhd->tx_packets, bus->f1regdata);
 		dhd_dump_pct(strbuf, ", pkts/sd", bus->dhd->tx_packets,
@@ -2710,6 +2798,7 @@ dhd_bus_clearcounts(dhd_pub_t *dhdp)
 	bus->rx_hdrfail = bus->rx_badhdr = bus->rx_badseq = 0;
 	bus->tx_sderrs = bus->fc_rcvd = bus->fc_xoff = bus->fc_xon = 0;
 	bus->rxglomfail = bus->rxglomframes = bus->rxglompkts = 0;
+	bus->rxglomclone = bus->txglomframes = bus->txglompkts = 0;
 	bus->f2rxhdrs = bus->f2rxdata = bus->f2txdata = bus->f1regdata = 0;
 }
 
@@ -3813,6 +3902,7 @@ dhdsdio_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, const ch
 			bcmerror = BCME_ERROR;
 		} else {
 			bus->glomsize = (uint)int_val;
+			bus->glom_cur = MAX(bus->glomsize, 1);
 		}
 		break;
 	case IOV_GVAL(IOV_TXGLOMMODE):
@@ -3828,6 +3918,16 @@ dhdsdio_doiovar(dhd_bus_t *bus, const bcm_iovar_t *vi, uint32 actionid, const ch
 				bcmerror = BCME_ERROR;
 		}
 		break;
+
+	case IOV_GVAL(IOV_TXGLOMADAPT):
+		int_val = (int32)bus->glom_adapt;
+		bcopy(&int_val, arg, val_size);
+		break;
+
+	case IOV_SVAL(IOV_TXGLOMADAPT):
+		bus->glom_adapt = bool_val;
+		bus->glom_cur = MAX(bus->glomsize, 1);
+		break;
 #endif 
 	case IOV_SVAL(IOV_HANGREPORT):
 		bus->dhd->hang_report = bool_val;
@@ -4658,6 +4758,39 @@ int
 dhd_process_pkt_reorder_info(dhd_pub_t *dhd, uchar *reorder_info_buf, uint reorder_info_len,
 	void **pkt, uint32 *pkt_count);
 
+/*
+ * Carve a superframe read into one buffer into its subframes without a
+ * copy: each becomes a clone of @super sharing its data, trimmed to the
+ * length the descriptor gave the matching packet of @chain.
+ */
+static void *
+dhdsdio_glom_split(dhd_bus_t *bus, void *super, void *chain)
+{
+	osl_t *osh = bus->dhd->osh;
+	struct sk_buff *skb;
+	void *p, *pnew, *pfirst = NULL, *plast = NULL;
+	uint off = 0;
+
+	for (p = chain; p; p = PKTNEXT(osh, p)) {
+		if ((skb = skb_clone((struct sk_buff *)super, GFP_ATOMIC)) == NULL) {
+			if (pfirst)
+				PKTFREE(osh, pfirst, FALSE);
+			return NULL;
+		}
+		pnew = PKTFRMNATIVE(osh, skb);
+		PKTPULL(osh, pnew, off);
+		PKTSETLEN(osh, pnew, PKTLEN(osh, p));
+		off += PKTLEN(osh, p);
+
+		if (!pfirst)
+			pfirst = pnew;
+		else
+			PKTSETNEXT(osh, plast, pnew);
+		plast = pnew;
+	}
+	return pfirst;
+}
+
 static uint8
 dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 {
@@ -4679,6 +4812,8 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 
 	int ifidx = 0;
 	bool usechain = bus->use_rxchain;
+	void *super;
+	bool shared = FALSE;
 
 	
 	
@@ -4785,11 +4920,42 @@ dhdsdio_rxglom(dhd_bus_t *bus, uint8 rxseq)
 		pfirst = bus->glom;
 		dlen = (uint16)pkttotlen(osh, pfirst);
 
+		super = NULL;
+		if (!usechain &&
+		    (super = PKTGET(osh, dlen + DHD_SDALIGN, FALSE)) != NULL)
+			PKTALIGN(osh, super, dlen, DHD_SDALIGN);
+
 		if (usechain) {
 			errcode = dhd_bcmsdh_recv_buf(bus,
 			                              bcmsdh_cur_sbwad(bus->sdh), SDIO_FUNC_2,
 			                              F2SYNC, (uint8*)PKTDATA(osh, pfirst),
 			                              dlen, pfirst, NULL, NULL);
+		} else if (super) {
+			errcode = dhd_bcmsdh_recv_buf(bus,
+			                              bcmsdh_cur_sbwad(bus->sdh), SDIO_FUNC_2,
+			                              F2SYNC, (uint8*)PKTDATA(osh, super),
+			                              dlen, NULL, NULL, NULL);
+			if (errcode >= 0) {
+				dhd_os_sdlock_rxq(bus->dhd);
+				if ((pnext = dhdsdio_glom_split(bus, super, pfirst)) != NULL) {
+					PKTFREE(osh, pfirst, FALSE);
+					bus->glom = pfirst = pnext;
+					bus->rxglomclone++;
+					shared = TRUE;
+				} else {
+					sublen = (uint16)pktfrombuf(osh, pfirst, 0, dlen,
+					                            (uint8*)PKTDATA(osh, super));
+					if (sublen != dlen)
+						errcode = -1;
+				}
+				dhd_os_sdunlock_rxq(bus->dhd);
+				pnext = NULL;
+			}
+			DHD_GLOM(("%s: misaligned superframe of %d bytes %s\n", __FUNCTION__,
+			          dlen, shared ? "shared" : "copied"));
+			dhd_os_sdlock_rxq(bus->dhd);
+			PKTFREE(osh, super, FALSE);
+			dhd_os_sdunlock_rxq(bus->dhd);
 		} else if (bus->dataptr) {
 			errcode = dhd_bcmsdh_recv_buf(bus,
 			                              bcmsdh_cur_sbwad(bus->sdh), SDIO_FUNC_2,
@@ -7414,6 +7580,9 @@ dhdsdio_probe_attach(struct dhd_bus *bus, osl_t *osh, void *sdh, void *regsva,
 	bus->glom_mode = bcmsdh_set_mode(bus->sdh, SDPCM_DEFGLOM_MODE);
 	
 	bus->glomsize = SDPCM_DEFGLOM_SIZE;
+	bus->glom_adapt = TRUE;
+	bus->glom_cur = bus->glomsize;
+	bus->glom_dir = -1;
 #endif
 
 	return TRUE;
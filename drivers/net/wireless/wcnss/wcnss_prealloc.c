@@ -10,74 +10,213 @@
  * GNU General Public License for more details.
  */
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/wcnss_wlan.h>
 
-static DEFINE_MUTEX(alloc_lock);
+#include "wcnss_prealloc.h"
+
+/*
+ * The pool is a set of size classes, each holding a fixed number of chunks
+ * allocated at boot.  A request is served from the smallest class it fits
+ * and spills into larger ones when that class is exhausted.  Per class the
+ * high-water mark of requests that wanted it is recorded, so that the
+ * counts shown in debugfs can be fed back on the command line as
+ * wcnss_prealloc.counts= to size the pool for the observed load.
+ */
+#define WCNSS_PREALLOC_CLASSES	4
+
+static unsigned int sizes[WCNSS_PREALLOC_CLASSES] = { 8, 16, 32, 64 };
+static unsigned int counts[WCNSS_PREALLOC_CLASSES] = { 4, 0, 7, 2 };
+static int nr_sizes = WCNSS_PREALLOC_CLASSES;
+static int nr_counts = WCNSS_PREALLOC_CLASSES;
+module_param_array(sizes, uint, &nr_sizes, 0444);
+MODULE_PARM_DESC(sizes, "Chunk size of each class in KB, ascending");
+module_param_array(counts, uint, &nr_counts, 0444);
+MODULE_PARM_DESC(counts, "Number of chunks in each class");
 
 struct wcnss_prealloc {
 	int occupied;
-	unsigned int size;
+	int want;
 	void *ptr;
 };
 
-static struct wcnss_prealloc wcnss_allocs[] = {
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
+struct wcnss_prealloc_class {
+	unsigned int size;
+	unsigned int count;
+	struct wcnss_prealloc *chunks;
+	unsigned int used;
+	unsigned int used_hwm;
+	unsigned int want;
+	unsigned int want_hwm;
+	unsigned long misses;
+	unsigned long spills;
+};
+
+static DEFINE_SPINLOCK(alloc_lock);
+static struct wcnss_prealloc_class wcnss_classes[WCNSS_PREALLOC_CLASSES];
+static int nr_classes;
+static unsigned long oversize_misses;
+static unsigned int oversize_max;
+static struct dentry *wcnss_prealloc_dent;
+
+static int wcnss_prealloc_class_of(unsigned int size)
+{
+	int c;
+
+	for (c = 0; c < nr_classes; c++)
+		if (wcnss_classes[c].size >= size)
+			return c;
+	return -1;
+}
+
+static int wcnss_prealloc_show(struct seq_file *s, void *unused)
+{
+	struct wcnss_prealloc_class *cls;
+	unsigned long flags;
+	int c;
+
+	seq_printf(s, "%8s %6s %6s %6s %6s %8s %8s\n", "size", "count",
+		   "used", "hwm", "want", "misses", "spills");
+	spin_lock_irqsave(&alloc_lock, flags);
+	for (c = 0; c < nr_classes; c++) {
+		cls = &wcnss_classes[c];
+		seq_printf(s, "%8u %6u %6u %6u %6u %8lu %8lu\n", cls->size,
+			   cls->count, cls->used, cls->used_hwm,
+			   cls->want_hwm, cls->misses, cls->spills);
+	}
+	seq_printf(s, "oversize misses %lu, largest %u\n",
+		   oversize_misses, oversize_max);
+
+	/* A class that missed needs more than it was ever able to serve */
+	seq_printf(s, "boot: wcnss_prealloc.counts=");
+	for (c = 0; c < nr_classes; c++) {
+		cls = &wcnss_classes[c];
+		seq_printf(s, "%s%u", c ? "," : "",
+			   cls->want_hwm + (cls->misses ? 1 : 0));
+	}
+	seq_printf(s, "\n");
+	spin_unlock_irqrestore(&alloc_lock, flags);
+	return 0;
+}
+
+static int wcnss_prealloc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wcnss_prealloc_show, NULL);
+}
+
+static const struct file_operations wcnss_prealloc_fops = {
+	.open		= wcnss_prealloc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
 };
 
 int wcnss_prealloc_init(void)
 {
-	int i;
+	struct wcnss_prealloc_class *cls;
+	int c, i;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		wcnss_allocs[i].occupied = 0;
-		wcnss_allocs[i].ptr = kmalloc(wcnss_allocs[i].size, GFP_KERNEL);
-		if (wcnss_allocs[i].ptr == NULL)
-			return -ENOMEM;
+	nr_classes = min(nr_sizes, nr_counts);
+	for (c = 0; c < nr_classes; c++) {
+		cls = &wcnss_classes[c];
+		if (c && sizes[c] <= sizes[c - 1]) {
+			pr_err("wcnss: prealloc sizes must be ascending\n");
+			nr_classes = c;
+			break;
+		}
+		cls->size = sizes[c] * 1024;
+		cls->count = counts[c];
+		if (!cls->count)
+			continue;
+
+		cls->chunks = kcalloc(cls->count, sizeof(*cls->chunks),
+				      GFP_KERNEL);
+		if (!cls->chunks)
+			goto nomem;
+		for (i = 0; i < cls->count; i++) {
+			cls->chunks[i].ptr = kmalloc(cls->size, GFP_KERNEL);
+			if (cls->chunks[i].ptr == NULL)
+				goto nomem;
+		}
 	}
 
+	wcnss_prealloc_dent = debugfs_create_file("wcnss_prealloc", S_IRUSR,
+						  NULL, NULL,
+						  &wcnss_prealloc_fops);
 	return 0;
+
+nomem:
+	wcnss_prealloc_deinit();
+	return -ENOMEM;
 }
 
 void wcnss_prealloc_deinit(void)
 {
-	int i = 0;
+	struct wcnss_prealloc_class *cls;
+	int c, i;
+
+	debugfs_remove(wcnss_prealloc_dent);
+	wcnss_prealloc_dent = NULL;
 
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++)
-		kfree(wcnss_allocs[i].ptr);
+	for (c = 0; c < nr_classes; c++) {
+		cls = &wcnss_classes[c];
+		if (cls->chunks) {
+			for (i = 0; i < cls->count; i++)
+				kfree(cls->chunks[i].ptr);
+			kfree(cls->chunks);
+		}
+		cls->chunks = NULL;
+		cls->count = 0;
+	}
+	nr_classes = 0;
 }
 
 void *wcnss_prealloc_get(unsigned int size)
 {
-	int i = 0;
+	struct wcnss_prealloc_class *cls;
+	unsigned long flags;
+	int want, c, i;
 
-	mutex_lock(&alloc_lock);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].occupied)
+	spin_lock_irqsave(&alloc_lock, flags);
+	want = wcnss_prealloc_class_of(size);
+	if (want < 0) {
+		oversize_misses++;
+		oversize_max = max(oversize_max, size);
+		goto miss;
+	}
+
+	for (c = want; c < nr_classes; c++) {
+		cls = &wcnss_classes[c];
+		if (cls->used == cls->count)
 			continue;
 
-		if (wcnss_allocs[i].size > size) {
-			
-			wcnss_allocs[i].occupied = 1;
-			mutex_unlock(&alloc_lock);
-			return wcnss_allocs[i].ptr;
+		for (i = 0; i < cls->count; i++) {
+			if (cls->chunks[i].occupied)
+				continue;
+
+			cls->chunks[i].occupied = 1;
+			cls->chunks[i].want = want;
+			cls->used++;
+			cls->used_hwm = max(cls->used_hwm, cls->used);
+			if (c != want)
+				wcnss_classes[want].spills++;
+			cls = &wcnss_classes[want];
+			cls->want++;
+			cls->want_hwm = max(cls->want_hwm, cls->want);
+			spin_unlock_irqrestore(&alloc_lock, flags);
+			return wcnss_classes[c].chunks[i].ptr;
 		}
 	}
-	pr_err("wcnss: %s: prealloc not available\n", __func__);
-	mutex_unlock(&alloc_lock);
+	wcnss_classes[want].misses++;
+miss:
+	spin_unlock_irqrestore(&alloc_lock, flags);
+	pr_err_ratelimited("wcnss: %s: prealloc not available for %u bytes\n",
+			   __func__, size);
 
 	return NULL;
 }
@@ -85,17 +224,29 @@ EXPORT_SYMBOL(wcnss_prealloc_get);
 
 int wcnss_prealloc_put(void *ptr)
 {
-	int i = 0;
+	struct wcnss_prealloc_class *cls;
+	struct wcnss_prealloc *chunk;
+	unsigned long flags;
+	int c, i;
+
+	spin_lock_irqsave(&alloc_lock, flags);
+	for (c = 0; c < nr_classes; c++) {
+		cls = &wcnss_classes[c];
+		for (i = 0; i < cls->count; i++) {
+			chunk = &cls->chunks[i];
+			if (chunk->ptr != ptr)
+				continue;
 
-	mutex_lock(&alloc_lock);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].ptr == ptr) {
-			wcnss_allocs[i].occupied = 0;
-			mutex_unlock(&alloc_lock);
+			if (chunk->occupied) {
+				chunk->occupied = 0;
+				cls->used--;
+				wcnss_classes[chunk->want].want--;
+			}
+			spin_unlock_irqrestore(&alloc_lock, flags);
 			return 1;
 		}
 	}
-	mutex_unlock(&alloc_lock);
+	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	return 0;
 }
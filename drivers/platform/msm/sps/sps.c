@@ -95,6 +95,7 @@ struct dentry *dfile_debug_level_option;
 struct dentry *dfile_print_limit_option;
 struct dentry *dfile_reg_dump_option;
 struct dentry *dfile_bam_addr;
+struct dentry *dfile_pipe_stats;
 
 static struct sps_bam *phy2bam(u32 phys_addr);
 
@@ -341,6 +342,43 @@ const struct file_operations sps_bam_addr_ops = {
 	.write = sps_set_bam_addr,
 };
 
+#define PIPE_STATS_BUF_SIZE	4096
+
+/* Interrupt rate is per second since the previous read of the file */
+static ssize_t sps_read_pipe_stats(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	struct sps_bam *bam;
+	unsigned long flags;
+	char *buf;
+	int len = 0;
+	ssize_t ret;
+
+	buf = kzalloc(PIPE_STATS_BUF_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	len += scnprintf(buf + len, PIPE_STATS_BUF_SIZE - len,
+			"bam        pipe mod_cnt mod_us       irqs   deferred"
+			"   irqs/s\n");
+	mutex_lock(&sps->lock);
+	list_for_each_entry(bam, &sps->bams_q, list) {
+		spin_lock_irqsave(&bam->connection_lock, flags);
+		len += sps_bam_pipe_stats(bam, buf + len,
+					  PIPE_STATS_BUF_SIZE - len);
+		spin_unlock_irqrestore(&bam->connection_lock, flags);
+	}
+	mutex_unlock(&sps->lock);
+
+	ret = simple_read_from_buffer(ubuf, count, ppos, buf, len);
+	kfree(buf);
+	return ret;
+}
+
+const struct file_operations sps_pipe_stats_ops = {
+	.read = sps_read_pipe_stats,
+};
+
 static void sps_debugfs_init(void)
 {
 	debugfs_record_enabled = false;
@@ -405,8 +443,18 @@ static void sps_debugfs_init(void)
 		goto bam_addr_err;
 	}
 
+	dfile_pipe_stats = debugfs_create_file("pipe_stats", 0444,
+			dent, 0, &sps_pipe_stats_ops);
+	if (!dfile_pipe_stats || IS_ERR(dfile_pipe_stats)) {
+		pr_err("sps:fail to create the file for debug_fs "
+			"pipe_stats.\n");
+		goto pipe_stats_err;
+	}
+
 	return;
 
+pipe_stats_err:
+	debugfs_remove(dfile_bam_addr);
 bam_addr_err:
 	debugfs_remove(dfile_reg_dump_option);
 reg_dump_option_err:
@@ -435,6 +483,8 @@ static void sps_debugfs_exit(void)
 		debugfs_remove(dfile_reg_dump_option);
 	if (dfile_bam_addr)
 		debugfs_remove(dfile_bam_addr);
+	if (dfile_pipe_stats)
+		debugfs_remove(dfile_pipe_stats);
 	if (dent)
 		debugfs_remove(dent);
 	kfree(debugfs_buf);
@@ -1248,6 +1298,8 @@ int sps_set_config(struct sps_pipe *h, struct sps_connect *config)
 	if (bam == NULL)
 		return SPS_ERROR;
 
+	pipe->connect.irq_mod_count = config->irq_mod_count;
+	pipe->connect.irq_mod_usecs = config->irq_mod_usecs;
 	result = sps_bam_pipe_set_params(bam, pipe->pipe_index,
 					 config->options);
 	if (result == 0)
@@ -73,6 +73,10 @@ static void pipe_handler(struct sps_bam *dev,
 static void pipe_handler_eot(struct sps_bam *dev,
 			   struct sps_pipe *pipe);
 
+static void pipe_mod_irq(struct sps_bam *dev, struct sps_pipe *pipe);
+
+static enum hrtimer_restart pipe_mod_timer(struct hrtimer *timer);
+
 int sps_bam_driver_init(u32 options)
 {
 	int n;
@@ -133,7 +137,10 @@ static irqreturn_t bam_isr(int irq, void *ctxt)
 		
 		if ((source & pipe->pipe_index_mask)) {
 			
+			pipe->irq_count++;
 			pipe_handler(dev, pipe);
+			if (pipe->connect.irq_mod_usecs)
+				pipe_mod_irq(dev, pipe);
 			source &= ~pipe->pipe_index_mask;
 		}
 		if (source == 0)
@@ -575,6 +582,13 @@ int sps_bam_pipe_connect(struct sps_pipe *bam_pipe,
 	
 	pipe_clear(bam_pipe);
 	memset(&hw_params, 0, sizeof(hw_params));
+	hrtimer_init(&bam_pipe->mod_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	bam_pipe->mod_timer.function = pipe_mod_timer;
+	bam_pipe->mod_active = false;
+	bam_pipe->irq_count = 0;
+	bam_pipe->irq_deferred = 0;
+	bam_pipe->irq_count_last = 0;
+	bam_pipe->irq_stamp_last = jiffies;
 
 	
 	bam_pipe->mode = params->mode;
@@ -783,6 +797,7 @@ int sps_bam_pipe_disconnect(struct sps_bam *dev, u32 pipe_index)
 			dev->pipe_active_mask &= ~(1UL << pipe_index);
 		}
 		dev->pipe_remote_mask &= ~(1UL << pipe_index);
+		hrtimer_cancel(&pipe->mod_timer);
 		bam_pipe_exit(dev->base, pipe_index, dev->props.ee);
 		if (pipe->sys.desc_cache != NULL) {
 			u32 size = pipe->num_descs * sizeof(void *);
@@ -806,12 +821,70 @@ int sps_bam_pipe_disconnect(struct sps_bam *dev, u32 pipe_index)
 	return result;
 }
 
+/* Called with isr_lock held, pipe interrupt is known to be enabled */
+static void pipe_mod_irq(struct sps_bam *dev, struct sps_pipe *pipe)
+{
+	ktime_t now = ktime_get();
+
+	if ((pipe->state & BAM_STATE_MTI) || !(pipe->state & BAM_STATE_IRQ)
+	    || pipe->mod_active)
+		return;
+
+	if (ktime_us_delta(now, pipe->mod_window) >
+	    pipe->connect.irq_mod_usecs) {
+		pipe->mod_window = now;
+		pipe->mod_burst = 0;
+	}
+	if (++pipe->mod_burst < pipe->connect.irq_mod_count)
+		return;
+
+	bam_pipe_set_irq(dev->base, pipe->pipe_index, BAM_DISABLE,
+			 pipe->irq_mask, dev->props.ee);
+	pipe->mod_active = true;
+	pipe->irq_deferred++;
+	hrtimer_start(&pipe->mod_timer,
+		      ns_to_ktime(pipe->connect.irq_mod_usecs * NSEC_PER_USEC),
+		      HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart pipe_mod_timer(struct hrtimer *timer)
+{
+	struct sps_pipe *pipe = container_of(timer, struct sps_pipe,
+					     mod_timer);
+	struct sps_bam *dev = pipe->bam;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->isr_lock, flags);
+	if (pipe->mod_active && (pipe->state & BAM_STATE_IRQ)) {
+		pipe->mod_active = false;
+		pipe->mod_window = ktime_get();
+		pipe->mod_burst = 0;
+		pipe_handler(dev, pipe);
+		
+		if ((pipe->state & BAM_STATE_IRQ))
+			bam_pipe_set_irq(dev->base, pipe->pipe_index,
+					 BAM_ENABLE, pipe->irq_mask,
+					 dev->props.ee);
+	}
+	spin_unlock_irqrestore(&dev->isr_lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
 static void pipe_set_irq(struct sps_bam *dev, u32 pipe_index,
 				 u32 poll)
 {
 	struct sps_pipe *pipe = dev->pipes[pipe_index];
 	enum bam_enable irq_enable;
 
+	/*
+	 * Only try: a running timer may be inside a client callback that
+	 * wants connection_lock, which the caller holds.
+	 */
+	hrtimer_try_to_cancel(&pipe->mod_timer);
+	pipe->mod_active = false;
+	pipe->mod_burst = 0;
+
 	if (poll == 0 && pipe->irq_mask != 0 &&
 	    (dev->state & BAM_STATE_IRQ)) {
 		if ((pipe->state & BAM_STATE_BAM2BAM) != 0 &&
@@ -1669,3 +1742,30 @@ int sps_bam_pipe_get_unused_desc_num(struct sps_bam *dev, u32 pipe_index,
 
 	return 0;
 }
+
+/* Caller holds connection_lock, the rate is since the previous call */
+int sps_bam_pipe_stats(struct sps_bam *dev, char *buf, int size)
+{
+	struct sps_pipe *pipe;
+	unsigned long elapsed;
+	u32 n, rate;
+	int len = 0;
+
+	for (n = 0; n < dev->props.num_pipes; n++) {
+		pipe = dev->pipes[n];
+		if (!BAM_PIPE_IS_ASSIGNED(pipe))
+			continue;
+		elapsed = jiffies - pipe->irq_stamp_last;
+		rate = elapsed ? (pipe->irq_count - pipe->irq_count_last)
+				* HZ / elapsed : 0;
+		pipe->irq_count_last = pipe->irq_count;
+		pipe->irq_stamp_last = jiffies;
+		len += scnprintf(buf + len, size - len,
+			"0x%08x %4u %7u %6u %10u %10u %8u\n",
+			dev->props.phys_addr, n, pipe->connect.irq_mod_count,
+			pipe->connect.irq_mod_usecs, pipe->irq_count,
+			pipe->irq_deferred, rate);
+	}
+
+	return len;
+}
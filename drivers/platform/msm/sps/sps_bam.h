@@ -20,6 +20,7 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
 
 #include "spsi.h"
 
@@ -165,6 +166,15 @@ struct sps_pipe {
 	
 	struct sps_bam_sys_mode sys;
 
+	
+	struct hrtimer mod_timer;
+	int mod_active;
+	u32 mod_burst;
+	ktime_t mod_window;
+	u32 irq_count;
+	u32 irq_deferred;
+	u32 irq_count_last;
+	unsigned long irq_stamp_last;
 };
 
 struct sps_bam {
@@ -250,4 +260,6 @@ int sps_bam_pipe_timer_ctrl(struct sps_bam *dev, u32 pipe_index,
 int sps_bam_pipe_get_unused_desc_num(struct sps_bam *dev, u32 pipe_index,
 					u32 *desc_num);
 
+int sps_bam_pipe_stats(struct sps_bam *dev, char *buf, int size);
+
 #endif	
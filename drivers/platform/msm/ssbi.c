@@ -288,6 +288,42 @@ int msm_ssbi_write(struct device *dev, u16 addr, u8 *buf, int len)
 }
 EXPORT_SYMBOL(msm_ssbi_write);
 
+/*
+ * Runs a list of single byte reads and writes under one hold of the bus
+ * lock, stopping at the first error.  There is no completion interrupt
+ * for the apps processor on either controller, so each byte is still
+ * polled, but the lock and irq toggling is paid once per batch.
+ */
+int msm_ssbi_xfer(struct device *dev, struct msm_ssbi_xfer *xfer, int n)
+{
+	struct msm_ssbi *ssbi = to_msm_ssbi(dev);
+	unsigned long flags;
+	int i, ret = 0;
+
+	if (ssbi->dev != dev)
+		return -ENXIO;
+
+	if (ssbi->use_rlock)
+		remote_spin_lock_irqsave(&ssbi->rspin_lock, flags);
+	else
+		spin_lock_irqsave(&ssbi->lock, flags);
+
+	for (i = 0; i < n && !ret; i++) {
+		if (xfer[i].write)
+			ret = ssbi->write(ssbi, xfer[i].addr, &xfer[i].val, 1);
+		else
+			ret = ssbi->read(ssbi, xfer[i].addr, &xfer[i].val, 1);
+	}
+
+	if (ssbi->use_rlock)
+		remote_spin_unlock_irqrestore(&ssbi->rspin_lock, flags);
+	else
+		spin_unlock_irqrestore(&ssbi->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(msm_ssbi_xfer);
+
 static int __devinit msm_ssbi_add_slave(struct msm_ssbi *ssbi,
 				const struct msm_ssbi_slave_info *slave)
 {
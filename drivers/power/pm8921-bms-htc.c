@@ -235,6 +235,47 @@ module_param_cb(last_soc, &bms_param_ops, &last_soc, 0644);
 static int bms_fake_battery = -EINVAL;
 module_param(bms_fake_battery, int, 0644);
 
+/*
+ * pm8921_bms_get_percent_charge hands back the last result instead of
+ * redoing the temperature conversion and table walk while the coulomb
+ * counter has moved less than soc_hold_uah, the OCV is unchanged and
+ * no charger event came in for soc_hold_ms.
+ */
+static int soc_hold_ms = 30000;
+module_param(soc_hold_ms, int, 0644);
+static int soc_hold_uah = 2000;
+module_param(soc_hold_uah, int, 0644);
+
+static DEFINE_SPINLOCK(bms_memo_lock);
+
+static struct {
+	int		valid;
+	int		soc;
+	int		cc_uah;
+	int		ocv_uv;
+	unsigned long	stamp;
+} soc_memo;
+
+struct pc_memo {
+	int	valid;
+	int	ocv_mv;
+	int	batt_temp;
+	int	chargecycles;
+	int	pc;
+	int	scalefactor;
+};
+
+static struct pc_memo pc_memo[2];
+static int pc_memo_next;
+
+static struct {
+	int		valid;
+	int		batt_temp;
+	int		chargecycles;
+	void		*lut;
+	int		fcc_uah;
+} fcc_memo;
+
 static int bms_start_percent;
 static int bms_start_ocv_uv;
 static int bms_start_cc_uah;
@@ -282,6 +323,7 @@ static int interpolate_fcc(struct pm8921_bms_chip *chip, int batt_temp);
 static void readjust_fcc_table(void)
 {
 	struct single_row_lut *temp, *old;
+	unsigned long flags;
 	int i, fcc, ratio;
 
 	if (!the_chip->fcc_temp_lut) {
@@ -310,6 +352,9 @@ static void readjust_fcc_table(void)
 
 	old = the_chip->adjusted_fcc_temp_lut;
 	the_chip->adjusted_fcc_temp_lut = temp;
+	spin_lock_irqsave(&bms_memo_lock, flags);
+	fcc_memo.valid = 0;
+	spin_unlock_irqrestore(&bms_memo_lock, flags);
 	kfree(old);
 }
 
@@ -1238,7 +1283,7 @@ static int calculate_rbatt_resume(struct pm8921_bms_chip *chip,
 	return r_batt;
 }
 
-static int calculate_fcc_uah(struct pm8921_bms_chip *chip, int batt_temp,
+static int __calculate_fcc_uah(struct pm8921_bms_chip *chip, int batt_temp,
 							int chargecycles)
 {
 	int initfcc, result, scalefactor = 0;
@@ -1257,6 +1302,34 @@ static int calculate_fcc_uah(struct pm8921_bms_chip *chip, int batt_temp,
 	}
 }
 
+static int calculate_fcc_uah(struct pm8921_bms_chip *chip, int batt_temp,
+							int chargecycles)
+{
+	unsigned long flags;
+	int result;
+
+	spin_lock_irqsave(&bms_memo_lock, flags);
+	if (fcc_memo.valid && fcc_memo.batt_temp == batt_temp
+			&& fcc_memo.chargecycles == chargecycles
+			&& fcc_memo.lut == chip->adjusted_fcc_temp_lut) {
+		result = fcc_memo.fcc_uah;
+		spin_unlock_irqrestore(&bms_memo_lock, flags);
+		return result;
+	}
+	spin_unlock_irqrestore(&bms_memo_lock, flags);
+
+	result = __calculate_fcc_uah(chip, batt_temp, chargecycles);
+
+	spin_lock_irqsave(&bms_memo_lock, flags);
+	fcc_memo.batt_temp = batt_temp;
+	fcc_memo.chargecycles = chargecycles;
+	fcc_memo.lut = chip->adjusted_fcc_temp_lut;
+	fcc_memo.fcc_uah = result;
+	fcc_memo.valid = 1;
+	spin_unlock_irqrestore(&bms_memo_lock, flags);
+	return result;
+}
+
 static int get_battery_uvolts(struct pm8921_bms_chip *chip, int *uvolts)
 {
 	int rc;
@@ -1295,10 +1368,31 @@ static int adc_based_ocv(struct pm8921_bms_chip *chip, int *ocv)
 	return 0;
 }
 
+/*
+ * Two entries, one for the OCV behind the remaining charge and one for
+ * the unusable voltage, both of which only move with a new OCV, a new
+ * rbatt or a temperature change.
+ */
 static int calculate_pc(struct pm8921_bms_chip *chip, int ocv_uv, int batt_temp,
 							int chargecycles)
 {
-	int pc, scalefactor;
+	struct pc_memo *m;
+	unsigned long flags;
+	int i, pc, scalefactor;
+
+	spin_lock_irqsave(&bms_memo_lock, flags);
+	for (i = 0; i < ARRAY_SIZE(pc_memo); i++) {
+		m = &pc_memo[i];
+		if (m->valid && m->ocv_mv == ocv_uv / 1000
+				&& m->batt_temp == batt_temp
+				&& m->chargecycles == chargecycles) {
+			pc = m->pc;
+			bms_dbg.scalefactor = m->scalefactor;
+			spin_unlock_irqrestore(&bms_memo_lock, flags);
+			return pc;
+		}
+	}
+	spin_unlock_irqrestore(&bms_memo_lock, flags);
 
 	pc = interpolate_pc(chip, batt_temp, ocv_uv / 1000);
 	pr_debug("pc = %u for ocv = %dmicroVolts batt_temp = %d\n",
@@ -1311,6 +1405,17 @@ static int calculate_pc(struct pm8921_bms_chip *chip, int ocv_uv, int batt_temp,
 	bms_dbg.scalefactor = scalefactor;
 	
 	pc = (pc * scalefactor) / 100;
+
+	spin_lock_irqsave(&bms_memo_lock, flags);
+	m = &pc_memo[pc_memo_next];
+	pc_memo_next = !pc_memo_next;
+	m->ocv_mv = ocv_uv / 1000;
+	m->batt_temp = batt_temp;
+	m->chargecycles = chargecycles;
+	m->pc = pc;
+	m->scalefactor = scalefactor;
+	m->valid = 1;
+	spin_unlock_irqrestore(&bms_memo_lock, flags);
 	return pc;
 }
 
@@ -1687,9 +1792,57 @@ int pm8921_bms_get_battery_current(int *result_ua)
 }
 EXPORT_SYMBOL(pm8921_bms_get_battery_current);
 
+static void soc_memo_put(struct pm8921_bms_chip *chip,
+			struct pm8921_soc_params *raw, int soc)
+{
+	unsigned long flags;
+	int cc_uah;
+
+	calculate_cc_uah(chip, raw->cc, &cc_uah);
+
+	spin_lock_irqsave(&bms_memo_lock, flags);
+	soc_memo.soc = soc;
+	soc_memo.cc_uah = cc_uah;
+	soc_memo.ocv_uv = raw->last_good_ocv_uv;
+	soc_memo.stamp = jiffies;
+	soc_memo.valid = 1;
+	spin_unlock_irqrestore(&bms_memo_lock, flags);
+}
+
+static int soc_memo_get(struct pm8921_bms_chip *chip,
+			struct pm8921_soc_params *raw, int *soc)
+{
+	unsigned long flags;
+	int cc_uah, hit;
+
+	if (bms_fake_battery != -EINVAL)
+		return 0;
+
+	calculate_cc_uah(chip, raw->cc, &cc_uah);
+
+	spin_lock_irqsave(&bms_memo_lock, flags);
+	hit = soc_memo.valid && soc_memo.ocv_uv == raw->last_good_ocv_uv
+		&& abs(cc_uah - soc_memo.cc_uah) < soc_hold_uah
+		&& time_before(jiffies, soc_memo.stamp
+				+ msecs_to_jiffies(soc_hold_ms));
+	if (hit)
+		*soc = soc_memo.soc;
+	spin_unlock_irqrestore(&bms_memo_lock, flags);
+	return hit;
+}
+
+static void soc_memo_invalidate(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&bms_memo_lock, flags);
+	soc_memo.valid = 0;
+	spin_unlock_irqrestore(&bms_memo_lock, flags);
+}
+
 int pm8921_bms_get_percent_charge(void)
 {
-	int batt_temp, rc;
+	int batt_temp, rc, soc;
 	struct pm8xxx_adc_chan_result result;
 	struct pm8921_soc_params raw;
 
@@ -1698,6 +1851,10 @@ int pm8921_bms_get_percent_charge(void)
 		return -EINVAL;
 	}
 
+	read_soc_params_raw(the_chip, &raw);
+	if (soc_memo_get(the_chip, &raw, &soc))
+		return soc;
+
 	rc = pm8xxx_adc_read(the_chip->batt_temp_channel, &result);
 	if (rc) {
 		pr_err("error reading adc channel = %d, rc = %d\n",
@@ -1708,10 +1865,10 @@ int pm8921_bms_get_percent_charge(void)
 						result.measurement);
 	batt_temp = (int)result.physical;
 
-	read_soc_params_raw(the_chip, &raw);
-
-	return calculate_state_of_charge(the_chip, &raw,
+	soc = calculate_state_of_charge(the_chip, &raw,
 					batt_temp, last_chargecycles, 0);
+	soc_memo_put(the_chip, &raw, soc);
+	return soc;
 }
 EXPORT_SYMBOL_GPL(pm8921_bms_get_percent_charge);
 
@@ -1979,6 +2136,7 @@ int pm8921_bms_get_batt_soc(int *result)
 
 	*result = calculate_state_of_charge(the_chip, &raw,
 					batt_temp, last_chargecycles, 1);
+	soc_memo_put(the_chip, &raw, *result);
 
 	state_of_charge = *result;
 
@@ -2113,6 +2271,7 @@ int pm8921_bms_charging_began(void)
 	pm_bms_masked_write(the_chip, BMS_TOLERANCES,
 			IBAT_TOL_MASK, IBAT_TOL_DEFAULT);
 	pr_info("start_percent = %d%%\n", the_chip->start_percent);
+	soc_memo_invalidate();
 	bms_discharge_percent = 0;
 	disable_ocv_update_with_reason(true, OCV_UPDATE_STOP_BIT_CABLE_IN);
 
@@ -2227,6 +2386,7 @@ void pm8921_bms_charging_end(int is_battery_full)
 	the_chip->end_percent = -EINVAL;
 	pm_bms_masked_write(the_chip, BMS_TOLERANCES,
 				IBAT_TOL_MASK, IBAT_TOL_NOCHG);
+	soc_memo_invalidate();
 }
 EXPORT_SYMBOL_GPL(pm8921_bms_charging_end);
 
@@ -3449,6 +3609,7 @@ static int __devinit pm8921_bms_probe(struct platform_device *pdev)
 			chip->r_sense, chip->i_test, chip->v_failure,
 			chip->default_rbatt_mohm);
 
+	device_enable_async_suspend(&pdev->dev);
 	return 0;
 
 free_irqs:
@@ -492,6 +492,17 @@ release_lpm_lock:
 	return rc;
 }
 
+/*
+ * Set points only this driver writes, read back by the masked writes and
+ * the getters.  The OTP backed SAFE limits are left out, a write to them
+ * can be silently ignored by the PMIC.
+ */
+static const u16 pm_chg_cached_regs[] = {
+	CHG_IBAT_MAX, CHG_VDD_MAX, CHG_VIN_MIN, CHG_ITERM, CHG_VBAT_DET,
+	CHG_ITRICKLE, CHG_VTRICKLE, CHG_TCHG_MAX, CHG_TTRKL_MAX, CHG_TWDOG,
+	CHG_TEMP_THRESH,
+};
+
 static int pm_chg_masked_write(struct pm8921_chg_chip *chip, u16 addr,
 							u8 mask, u8 val)
 {
@@ -4729,69 +4740,62 @@ static void dump_irq_rt_status(void)
 		pm_chg_get_rt_status(the_chip, DCIN_UV_IRQ));
 }
 
+static const struct {
+	const char	*name;
+	u16		addr;
+} dump_regs[] = {
+	{ "CNTRL", CHG_CNTRL },
+	{ "CNTRL_2", CHG_CNTRL_2 },
+	{ "CNTRL_3", CHG_CNTRL_3 },
+	{ "PBL_ACCESS1", PBL_ACCESS1 },
+	{ "PBL_ACCESS2", PBL_ACCESS2 },
+	{ "SYS_CONFIG_1", SYS_CONFIG_1 },
+	{ "SYS_CONFIG_2", SYS_CONFIG_2 },
+	{ "IBAT_SAFE", CHG_IBAT_SAFE },
+	{ "IBAT_MAX", CHG_IBAT_MAX },
+	{ "VBAT_DET", CHG_VBAT_DET },
+	{ "VDD_SAFE", CHG_VDD_SAFE },
+	{ "VDD_MAX", CHG_VDD_MAX },
+	{ "VIN_MIN", CHG_VIN_MIN },
+	{ "VTRICKLE", CHG_VTRICKLE },
+	{ "ITRICKLE", CHG_ITRICKLE },
+	{ "ITERM", CHG_ITERM },
+	{ "TCHG_MAX", CHG_TCHG_MAX },
+	{ "TWDOG", CHG_TWDOG },
+	{ "TEMP_THRESH", CHG_TEMP_THRESH },
+	{ "COMP_OVR", CHG_COMP_OVR },
+	{ "BUCK_CTRL_TEST1", CHG_BUCK_CTRL_TEST1 },
+	{ "BUCK_CTRL_TEST2", CHG_BUCK_CTRL_TEST2 },
+	{ "BUCK_CTRL_TEST3", CHG_BUCK_CTRL_TEST3 },
+	{ "CHG_TEST", CHG_TEST },
+	{ "USB_OVP_CONTROL", USB_OVP_CONTROL },
+	{ "USB_OVP_TEST", USB_OVP_TEST },
+	{ "DC_OVP_CONTROL", DC_OVP_CONTROL },
+	{ "DC_OVP_TEST", DC_OVP_TEST },
+};
+
 static void dump_reg(void)
 {
+	struct msm_ssbi_xfer xfer[ARRAY_SIZE(dump_regs)];
 	u64 val;
 	unsigned int len =0;
+	int i, rc;
 
 	memset(batt_log_buf, 0, sizeof(BATT_LOG_BUF_LEN));
 
-	get_reg((void *)CHG_CNTRL, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "CNTRL=0x%llx,", val);
-	get_reg((void *)CHG_CNTRL_2, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "CNTRL_2=0x%llx,", val);
-	get_reg((void *)CHG_CNTRL_3, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "CNTRL_3=0x%llx,", val);
-	get_reg((void *)PBL_ACCESS1, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "PBL_ACCESS1=0x%llx,", val);
-	get_reg((void *)PBL_ACCESS2, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "PBL_ACCESS2=0x%llx,", val);
-	get_reg((void *)SYS_CONFIG_1, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "SYS_CONFIG_1=0x%llx,", val);
-	get_reg((void *)SYS_CONFIG_2, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "SYS_CONFIG_2=0x%llx,", val);
-	get_reg((void *)CHG_IBAT_SAFE, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "IBAT_SAFE=0x%llx,", val);
-	get_reg((void *)CHG_IBAT_MAX, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "IBAT_MAX=0x%llx,", val);
-	get_reg((void *)CHG_VBAT_DET, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "VBAT_DET=0x%llx,", val);
-	get_reg((void *)CHG_VDD_SAFE, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "VDD_SAFE=0x%llx,", val);
-	get_reg((void *)CHG_VDD_MAX, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "VDD_MAX=0x%llx,", val);
-	get_reg((void *)CHG_VIN_MIN, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "VIN_MIN=0x%llx,", val);
-	get_reg((void *)CHG_VTRICKLE, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "VTRICKLE=0x%llx,", val);
-	get_reg((void *)CHG_ITRICKLE, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "ITRICKLE=0x%llx,", val);
-	get_reg((void *)CHG_ITERM, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "ITERM=0x%llx,", val);
-	get_reg((void *)CHG_TCHG_MAX, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "TCHG_MAX=0x%llx,", val);
-	get_reg((void *)CHG_TWDOG, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "TWDOG=0x%llx,", val);
-	get_reg((void *)CHG_TEMP_THRESH, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "TEMP_THRESH=0x%llx,", val);
-	get_reg((void *)CHG_COMP_OVR, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "COMP_OVR=0x%llx,", val);
-	get_reg((void *)CHG_BUCK_CTRL_TEST1, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "BUCK_CTRL_TEST1=0x%llx,", val);
-	get_reg((void *)CHG_BUCK_CTRL_TEST2, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "BUCK_CTRL_TEST2=0x%llx,", val);
-	get_reg((void *)CHG_BUCK_CTRL_TEST3, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "BUCK_CTRL_TEST3=0x%llx,", val);
-	get_reg((void *)CHG_TEST, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "CHG_TEST=0x%llx,", val);
-	get_reg((void *)USB_OVP_CONTROL, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "USB_OVP_CONTROL=0x%llx,", val);
-	get_reg((void *)USB_OVP_TEST, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "USB_OVP_TEST=0x%llx,", val);
-	get_reg((void *)DC_OVP_CONTROL, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "DC_OVP_CONTROL=0x%llx,", val);
-	get_reg((void *)DC_OVP_TEST, &val);
-	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "DC_OVP_TEST=0x%llx,", val);
+	
+	for (i = 0; i < ARRAY_SIZE(dump_regs); i++) {
+		xfer[i].addr = dump_regs[i].addr;
+		xfer[i].write = 0;
+	}
+	rc = pm8xxx_xfer(the_chip->dev->parent, xfer, ARRAY_SIZE(xfer));
+	if (rc) {
+		pr_err("pm8xxx_xfer failed: rc=%d\n", rc);
+		return;
+	}
+	for (i = 0; i < ARRAY_SIZE(dump_regs); i++)
+		len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len,
+				"%s=0x%x,", dump_regs[i].name, xfer[i].val);
 	get_reg_loop((void *)NULL, &val);
 	len += scnprintf(batt_log_buf + len, BATT_LOG_BUF_LEN - len, "REGULATION_LOOP_CONTROL=0x%llx", val);
 
@@ -6903,6 +6907,11 @@ static int __devinit pm8921_charger_probe(struct platform_device *pdev)
 		chip->pj_full_vol = pdata->pj_full_vol;
 	}
 
+	rc = pm8xxx_cache_regs(chip->dev->parent, pm_chg_cached_regs,
+				ARRAY_SIZE(pm_chg_cached_regs));
+	if (rc)
+		pr_err("couldn't cache charger registers rc=%d\n", rc);
+
 	rc = pm8921_chg_hw_init(chip);
 	if (rc) {
 		pr_err("couldn't init hardware rc=%d\n", rc);
@@ -7038,6 +7047,7 @@ static int __devinit pm8921_charger_probe(struct platform_device *pdev)
 			"wlc_tx_gpio=%d, vin_min=%d, vin_min_wlc=%d\n", __func__,
 			chip->max_voltage_mv, chip->cool_bat_voltage, chip->warm_bat_voltage,
 			chip->wlc_tx_gpio, chip->vin_min, chip->vin_min_wlc);
+	device_enable_async_suspend(&pdev->dev);
 	return 0;
 
 free_cable_in_irq:
@@ -63,6 +63,7 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	unsigned long flags;
 	struct timespec new_alarm_time;
 	struct timespec new_rtc_time;
+	struct android_alarm_window new_alarm_window;
 	struct timespec tmp_time;
 	enum android_alarm_type alarm_type = ANDROID_ALARM_IOCTL_TO_TYPE(cmd);
 	uint32_t alarm_type_mask = 1U << alarm_type;
@@ -100,6 +101,30 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		break;
 
+	case ANDROID_ALARM_SET_WINDOW(0):
+		if (copy_from_user(&new_alarm_window, (void __user *)arg,
+		    sizeof(new_alarm_window))) {
+			rv = -EFAULT;
+			goto err1;
+		}
+		if (!timespec_valid(&new_alarm_window.window)) {
+			rv = -EINVAL;
+			goto err1;
+		}
+		spin_lock_irqsave(&alarm_slock, flags);
+		pr_alarm(INFO, "alarm %d set %ld.%09ld window %ld.%09ld\n",
+			alarm_type, new_alarm_window.start.tv_sec,
+			new_alarm_window.start.tv_nsec,
+			new_alarm_window.window.tv_sec,
+			new_alarm_window.window.tv_nsec);
+		alarm_enabled |= alarm_type_mask;
+		alarm_start_range(&alarms[alarm_type],
+			timespec_to_ktime(new_alarm_window.start),
+			ktime_add(timespec_to_ktime(new_alarm_window.start),
+				  timespec_to_ktime(new_alarm_window.window)));
+		spin_unlock_irqrestore(&alarm_slock, flags);
+		break;
+
 	case ANDROID_ALARM_SET_OLD:
 	case ANDROID_ALARM_SET_AND_WAIT_OLD:
 		if (get_user(new_alarm_time.tv_sec, (int __user *)arg)) {
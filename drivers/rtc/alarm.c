@@ -15,11 +15,13 @@
 
 #include <linux/module.h>
 #include <linux/android_alarm.h>
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 #include <linux/platform_device.h>
 #include <linux/rtc.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/spinlock.h>
 #include <linux/wakelock.h>
 
@@ -67,6 +69,14 @@ module_param_array_named(offalarm_snooze, offalarm_snooze, uint, &offalarm_snooz
 #define ANDROID_ALARM_SET_OLD               _IOW('a', 2, time_t) 
 #define ANDROID_ALARM_SET_AND_WAIT_OLD      _IOW('a', 3, time_t)
 
+/*
+ * An alarm may fire anywhere between softexpires and expires.  The queue
+ * is sorted on expires and the timer is programmed for the first hard
+ * deadline, so every alarm whose window has opened by then is run from the
+ * same expiry: while suspended that is one resume instead of one each.
+ * max_window bounds how far past now the trigger loop has to look for
+ * such alarms.
+ */
 struct alarm_queue {
 	struct rb_root alarms;
 	struct rb_node *first;
@@ -74,6 +84,11 @@ struct alarm_queue {
 	ktime_t delta;
 	bool stopped;
 	ktime_t stopped_time;
+	ktime_t max_window;
+	unsigned long fired;
+	unsigned long batches;
+	u64 late_ns;
+	u64 late_max_ns;
 };
 
 static struct rtc_device *alarm_rtc_dev;
@@ -83,6 +98,7 @@ static struct wake_lock alarm_rtc_wake_lock;
 static struct platform_device *alarm_platform_dev;
 struct alarm_queue alarms[ANDROID_ALARM_TYPE_COUNT];
 static bool suspended;
+static unsigned long rtc_wakeups;
 
 #ifdef CONFIG_HTC_OFFMODE_ALARM
 int htc_is_offalarm_enabled(void);
@@ -134,6 +150,11 @@ static void alarm_enqueue_locked(struct alarm *alarm)
 	pr_alarm(FLOW, "added alarm, type %d, func %pF at %lld\n",
 		alarm->type, alarm->function, ktime_to_ns(alarm->expires));
 
+	if (ktime_sub(alarm->expires, alarm->softexpires).tv64 >
+	    base->max_window.tv64)
+		base->max_window = ktime_sub(alarm->expires,
+					     alarm->softexpires);
+
 	if (base->first == &alarm->node) {
 		base->first = rb_next(&alarm->node);
 		was_first = true;
@@ -318,12 +339,32 @@ ktime_t alarm_get_elapsed_realtime(void)
 	return now;
 }
 
+static struct rb_node *alarm_first_due_locked(struct alarm_queue *base,
+					       ktime_t now)
+{
+	struct rb_node *node;
+	struct alarm *alarm;
+	ktime_t horizon = ktime_add(now, base->max_window);
+
+	for (node = base->first; node; node = rb_next(node)) {
+		alarm = rb_entry(node, struct alarm, node);
+		if (alarm->expires.tv64 > horizon.tv64)
+			return NULL;
+		if (alarm->softexpires.tv64 <= now.tv64)
+			return node;
+	}
+	return NULL;
+}
+
 static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
 {
 	struct alarm_queue *base;
+	struct rb_node *node;
 	struct alarm *alarm;
 	unsigned long flags;
 	ktime_t now;
+	u64 late;
+	int fired = 0;
 
 	spin_lock_irqsave(&alarm_slock, flags);
 
@@ -334,25 +375,29 @@ static enum hrtimer_restart alarm_timer_triggered(struct hrtimer *timer)
 	pr_alarm(INT, "alarm_timer_triggered type %d at %lld\n",
 		base - alarms, ktime_to_ns(now));
 
-	while (base->first) {
-		alarm = container_of(base->first, struct alarm, node);
-		if (alarm->softexpires.tv64 > now.tv64) {
-			pr_alarm(FLOW, "don't call alarm, %pF, %lld (s %lld)\n",
-				alarm->function, ktime_to_ns(alarm->expires),
-				ktime_to_ns(alarm->softexpires));
-			break;
-		}
-		base->first = rb_next(&alarm->node);
+	while ((node = alarm_first_due_locked(base, now))) {
+		alarm = rb_entry(node, struct alarm, node);
+		if (base->first == node)
+			base->first = rb_next(node);
 		rb_erase(&alarm->node, &base->alarms);
 		RB_CLEAR_NODE(&alarm->node);
 		pr_alarm(CALL, "call alarm, type %d, func %pF, %lld (s %lld)\n",
 			alarm->type, alarm->function,
 			ktime_to_ns(alarm->expires),
 			ktime_to_ns(alarm->softexpires));
+
+		late = ktime_to_ns(ktime_sub(now, alarm->softexpires));
+		base->late_ns += late;
+		base->late_max_ns = max(base->late_max_ns, late);
+		base->fired++;
+		fired++;
+
 		spin_unlock_irqrestore(&alarm_slock, flags);
 		alarm->function(alarm);
 		spin_lock_irqsave(&alarm_slock, flags);
 	}
+	if (fired)
+		base->batches++;
 	if (!base->first)
 		pr_alarm(FLOW, "no more alarms of type %d\n", base - alarms);
 	update_timer_locked(base, true);
@@ -366,6 +411,7 @@ static void alarm_triggered_func(void *p)
 	if (!(rtc->irq_data & RTC_AF))
 		return;
 	pr_alarm(INT, "rtc alarm triggered\n");
+	rtc_wakeups++;
 	wake_lock_timeout(&alarm_rtc_wake_lock, 1 * HZ);
 }
 
@@ -578,6 +624,48 @@ static struct platform_driver alarm_driver = {
 	}
 };
 
+static int alarm_stats_show(struct seq_file *s, void *unused)
+{
+	struct alarm_queue *base;
+	unsigned long flags;
+	unsigned long fired, batches;
+	u64 late_ns, late_max_ns;
+	int i;
+
+	seq_printf(s, "%4s %8s %8s %8s %12s %12s\n", "type", "fired",
+		   "batches", "saved", "avg_late_us", "max_late_us");
+	for (i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+		base = &alarms[i];
+		spin_lock_irqsave(&alarm_slock, flags);
+		fired = base->fired;
+		batches = base->batches;
+		late_ns = base->late_ns;
+		late_max_ns = base->late_max_ns;
+		spin_unlock_irqrestore(&alarm_slock, flags);
+
+		if (fired)
+			do_div(late_ns, fired);
+		do_div(late_ns, NSEC_PER_USEC);
+		do_div(late_max_ns, NSEC_PER_USEC);
+		seq_printf(s, "%4d %8lu %8lu %8lu %12llu %12llu\n", i, fired,
+			   batches, fired - batches, late_ns, late_max_ns);
+	}
+	seq_printf(s, "rtc wakeups %lu\n", rtc_wakeups);
+	return 0;
+}
+
+static int alarm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, alarm_stats_show, NULL);
+}
+
+static const struct file_operations alarm_stats_fops = {
+	.open		= alarm_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init alarm_late_init(void)
 {
 	unsigned long   flags;
@@ -592,6 +680,9 @@ static int __init alarm_late_init(void)
 			timespec_to_ktime(timespec_sub(tmp_time, system_time));
 
 	spin_unlock_irqrestore(&alarm_slock, flags);
+
+	debugfs_create_file("alarm_stats", S_IRUGO, NULL, NULL,
+			    &alarm_stats_fops);
 	return 0;
 }
 
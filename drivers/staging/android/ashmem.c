@@ -27,6 +27,8 @@
 #include <linux/personality.h>
 #include <linux/bitops.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/lockstat_lite.h>
 #include <linux/shmem_fs.h>
 #include <linux/ashmem.h>
 #include <asm/cacheflush.h>
@@ -35,6 +37,12 @@
 #define ASHMEM_NAME_PREFIX_LEN (sizeof(ASHMEM_NAME_PREFIX) - 1)
 #define ASHMEM_FULL_NAME_LEN (ASHMEM_NAME_LEN + ASHMEM_NAME_PREFIX_LEN)
 
+/*
+ * Locking: each area's lock covers the area and its unpinned ranges.
+ * ashmem_lru_lock covers the LRU list and lru_count and nests inside
+ * the area locks, so the shrinker can only trylock an area it finds on
+ * the LRU.
+ */
 struct ashmem_area {
 	char name[ASHMEM_FULL_NAME_LEN]; 
 	struct list_head unpinned_list;	 
@@ -42,6 +50,9 @@ struct ashmem_area {
 	size_t size;			 
 	unsigned long vm_start;		 
 	unsigned long prot_mask;	 
+	struct mutex lock;
+	/* pages in unpinned_list, read without the lock by ashmem_pin_unpin */
+	size_t unpinned_pages;
 };
 
 struct ashmem_range {
@@ -57,7 +68,7 @@ static LIST_HEAD(ashmem_lru_list);
 
 static unsigned long lru_count;
 
-static DEFINE_MUTEX(ashmem_mutex);
+static DEFINE_SPINLOCK(ashmem_lru_lock);
 
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
@@ -88,14 +99,18 @@ static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
 static inline void lru_add(struct ashmem_range *range)
 {
+	lsl_spin_lock(&ashmem_lru_lock, LSL_ASHMEM_LRU);
 	list_add_tail(&range->lru, &ashmem_lru_list);
 	lru_count += range_size(range);
+	spin_unlock(&ashmem_lru_lock);
 }
 
 static inline void lru_del(struct ashmem_range *range)
 {
+	lsl_spin_lock(&ashmem_lru_lock, LSL_ASHMEM_LRU);
 	list_del(&range->lru);
 	lru_count -= range_size(range);
+	spin_unlock(&ashmem_lru_lock);
 }
 
 static int range_alloc(struct ashmem_area *asma,
@@ -118,6 +133,7 @@ static int range_alloc(struct ashmem_area *asma,
 	range->purged = purged;
 
 	list_add_tail(&range->unpinned, &prev_range->unpinned);
+	asma->unpinned_pages += range_size(range);
 
 	if (range_on_lru(range))
 		lru_add(range);
@@ -128,6 +144,7 @@ static int range_alloc(struct ashmem_area *asma,
 static void range_del(struct ashmem_range *range)
 {
 	list_del(&range->unpinned);
+	range->asma->unpinned_pages -= range_size(range);
 	if (range_on_lru(range))
 		lru_del(range);
 	kmem_cache_free(ashmem_range_cachep, range);
@@ -140,9 +157,13 @@ static inline void range_shrink(struct ashmem_range *range,
 
 	range->pgstart = start;
 	range->pgend = end;
+	range->asma->unpinned_pages -= pre - range_size(range);
 
-	if (range_on_lru(range))
+	if (range_on_lru(range)) {
+		lsl_spin_lock(&ashmem_lru_lock, LSL_ASHMEM_LRU);
 		lru_count -= pre - range_size(range);
+		spin_unlock(&ashmem_lru_lock);
+	}
 }
 
 static int ashmem_open(struct inode *inode, struct file *file)
@@ -163,6 +184,7 @@ static int ashmem_open(struct inode *inode, struct file *file)
 	}
 
 	INIT_LIST_HEAD(&asma->unpinned_list);
+	mutex_init(&asma->lock);
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
 	file->private_data = asma;
@@ -175,10 +197,10 @@ static int ashmem_release(struct inode *ignored, struct file *file)
 	struct ashmem_area *asma = file->private_data;
 	struct ashmem_range *range, *next;
 
-	mutex_lock(&ashmem_mutex);
+	lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
 		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 
 	if (asma->file)
 		fput(asma->file);
@@ -193,7 +215,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 
 	
 	if (asma->size == 0)
@@ -212,7 +234,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	asma->file->f_pos = *pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
@@ -221,7 +243,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 
 	if (asma->size == 0) {
 		ret = -EINVAL;
@@ -241,7 +263,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	file->f_pos = asma->file->f_pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
@@ -257,7 +279,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 
 	
 	if (unlikely(!asma->size)) {
@@ -301,40 +323,85 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	asma->vm_start = vma->vm_start;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
+/*
+ * Purge every unpinned range of @asma still on the LRU, with one
+ * truncation per run of adjacent ranges.  The unpinned list is sorted
+ * by descending page, so a run grows downwards.  Called with asma->lock
+ * held, returns the number of pages purged.
+ */
+static size_t ashmem_purge_area(struct ashmem_area *asma)
+{
+	struct inode *inode = asma->file->f_dentry->d_inode;
+	struct ashmem_range *range;
+	size_t start = 0, end = 0, purged = 0;
+	bool run = false;
+
+	list_for_each_entry(range, &asma->unpinned_list, unpinned) {
+		if (!range_on_lru(range))
+			continue;
+
+		if (run && range->pgend + 1 != start) {
+			vmtruncate_range(inode, start * PAGE_SIZE,
+					 (end + 1) * PAGE_SIZE - 1);
+			run = false;
+		}
+		if (!run) {
+			end = range->pgend;
+			run = true;
+		}
+		start = range->pgstart;
+
+		range->purged = ASHMEM_WAS_PURGED;
+		lru_del(range);
+		purged += range_size(range);
+	}
+	if (run)
+		vmtruncate_range(inode, start * PAGE_SIZE,
+				 (end + 1) * PAGE_SIZE - 1);
+
+	return purged;
+}
+
 static int ashmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
-	struct ashmem_range *range, *next;
+	struct ashmem_range *range;
+	struct ashmem_area *asma;
+	long nr_to_scan = sc->nr_to_scan;
+	int ret;
 
 	
-	if (sc->nr_to_scan && !(sc->gfp_mask & __GFP_FS))
+	if (nr_to_scan && !(sc->gfp_mask & __GFP_FS))
 		return -1;
-	if (!sc->nr_to_scan)
+	if (!nr_to_scan)
 		return lru_count;
 
-	
-	if (!mutex_trylock(&ashmem_mutex)) {
-                return -1;
-	}
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		struct inode *inode = range->asma->file->f_dentry->d_inode;
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE - 1;
+	/* Areas busy with pin, unpin or their own reclaim are passed over */
+	lsl_spin_lock(&ashmem_lru_lock, LSL_ASHMEM_LRU);
+	while (nr_to_scan > 0) {
+		asma = NULL;
+		list_for_each_entry(range, &ashmem_lru_list, lru) {
+			if (mutex_trylock(&range->asma->lock)) {
+				asma = range->asma;
+				break;
+			}
+		}
+		if (!asma)
+			break;
+		spin_unlock(&ashmem_lru_lock);
 
-		vmtruncate_range(inode, start, end);
-		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
+		nr_to_scan -= ashmem_purge_area(asma);
+		mutex_unlock(&asma->lock);
 
-		sc->nr_to_scan -= range_size(range);
-		if (sc->nr_to_scan <= 0)
-			break;
+		lsl_spin_lock(&ashmem_lru_lock, LSL_ASHMEM_LRU);
 	}
-	mutex_unlock(&ashmem_mutex);
+	ret = lru_count;
+	spin_unlock(&ashmem_lru_lock);
 
-	return lru_count;
+	return ret;
 }
 
 static struct shrinker ashmem_shrinker = {
@@ -346,7 +413,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 
 	
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -361,15 +428,24 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 	return ret;
 }
 
+/*
+ * The names are copied through a local buffer: a fault on the user
+ * buffer takes mmap_sem, which ashmem_mmap() holds when taking the lock.
+ */
 static int set_name(struct ashmem_area *asma, void __user *name)
 {
+	char local_name[ASHMEM_NAME_LEN];
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	if (unlikely(copy_from_user(local_name, name, ASHMEM_NAME_LEN)))
+		return -EFAULT;
+	local_name[ASHMEM_NAME_LEN - 1] = '\0';
+
+	lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 
 	
 	if (unlikely(asma->file)) {
@@ -377,37 +453,33 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 		goto out;
 	}
 
-	if (unlikely(copy_from_user(asma->name + ASHMEM_NAME_PREFIX_LEN,
-				    name, ASHMEM_NAME_LEN)))
-		ret = -EFAULT;
-	asma->name[ASHMEM_FULL_NAME_LEN-1] = '\0';
+	strcpy(asma->name + ASHMEM_NAME_PREFIX_LEN, local_name);
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 
 	return ret;
 }
 
 static int get_name(struct ashmem_area *asma, void __user *name)
 {
-	int ret = 0;
+	char local_name[ASHMEM_NAME_LEN];
+	size_t len;
 
-	mutex_lock(&ashmem_mutex);
+	lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
-		size_t len;
-
 		len = strlen(asma->name + ASHMEM_NAME_PREFIX_LEN) + 1;
-		if (unlikely(copy_to_user(name,
-				asma->name + ASHMEM_NAME_PREFIX_LEN, len)))
-			ret = -EFAULT;
+		memcpy(local_name, asma->name + ASHMEM_NAME_PREFIX_LEN, len);
 	} else {
-		if (unlikely(copy_to_user(name, ASHMEM_NAME_DEF,
-					  sizeof(ASHMEM_NAME_DEF))))
-			ret = -EFAULT;
+		len = sizeof(ASHMEM_NAME_DEF);
+		memcpy(local_name, ASHMEM_NAME_DEF, len);
 	}
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 
-	return ret;
+	if (unlikely(copy_to_user(name, local_name, len)))
+		return -EFAULT;
+
+	return 0;
 }
 
 static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
@@ -523,7 +595,29 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	pgstart = pin.offset / PAGE_SIZE;
 	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
 
-	mutex_lock(&ashmem_mutex);
+	/*
+	 * Nothing to do when the area is already all pinned, or all
+	 * unpinned and the whole of it is unpinned again.  The racy read
+	 * is fine, a concurrent pin or unpin could just as well come after.
+	 */
+	switch (cmd) {
+	case ASHMEM_PIN:
+		if (!ACCESS_ONCE(asma->unpinned_pages))
+			return ASHMEM_NOT_PURGED;
+		break;
+	case ASHMEM_UNPIN:
+		if (!pgstart &&
+		    pgend + 1 == PAGE_ALIGN(asma->size) / PAGE_SIZE &&
+		    ACCESS_ONCE(asma->unpinned_pages) == pgend + 1)
+			return 0;
+		break;
+	case ASHMEM_GET_PIN_STATUS:
+		if (!ACCESS_ONCE(asma->unpinned_pages))
+			return ASHMEM_IS_PINNED;
+		break;
+	}
+
+	lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 
 	switch (cmd) {
 	case ASHMEM_PIN:
@@ -537,7 +631,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 		break;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->lock);
 
 	return ret;
 }
@@ -648,10 +742,12 @@ static long ashmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		break;
 	case ASHMEM_SET_SIZE:
 		ret = -EINVAL;
+		lsl_mutex_lock(&asma->lock, LSL_ASHMEM);
 		if (!asma->file) {
 			ret = 0;
 			asma->size = (size_t) arg;
 		}
+		mutex_unlock(&asma->lock);
 		break;
 	case ASHMEM_GET_SIZE:
 		ret = asma->size;
@@ -19,7 +19,9 @@
 #include <linux/fdtable.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/lockstat_lite.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
@@ -37,7 +39,27 @@
 
 #include "binder.h"
 
-static DEFINE_MUTEX(binder_lock);
+#define CREATE_TRACE_POINTS
+#include <trace/events/binder.h>
+#include <linux/frametime.h>
+
+/*
+ * Lock ordering:
+ *
+ * binder_main_lock
+ *   binder_deferred_lock
+ *   proc->alloc_lock
+ *     mmap_sem of the proc owning the buffer
+ *
+ * binder_main_lock protects procs, threads, nodes, refs, transactions and
+ * the todo lists.  proc->alloc_lock protects the buffer allocator of a proc
+ * (the buffer list, both buffer trees, the small buffer cache, the page
+ * array and free_async_space) and is also taken without binder_main_lock
+ * by binder_transaction while it allocates and fills the target buffer.
+ * binder_mmap_lock nests inside the mmap_sem of the caller and nothing is
+ * taken under it.
+ */
+static DEFINE_MUTEX(binder_main_lock);
 static DEFINE_MUTEX(binder_deferred_lock);
 static DEFINE_MUTEX(binder_mmap_lock);
 
@@ -148,7 +170,7 @@ enum binder_stat_types {
 
 struct binder_stats {
 	int br[_IOC_NR(BR_FAILED_REPLY) + 1];
-	int bc[_IOC_NR(BC_DEAD_BINDER_DONE) + 1];
+	int bc[_IOC_NR(BC_REPLY_SG) + 1];
 	int obj_created[BINDER_STAT_COUNT];
 	int obj_deleted[BINDER_STAT_COUNT];
 };
@@ -165,6 +187,53 @@ static inline void binder_stats_created(enum binder_stat_types type)
 	binder_stats.obj_created[type]++;
 }
 
+struct binder_lock_stats {
+	unsigned long acquired;
+	unsigned long contended;
+	u64 wait_us;
+	u64 max_wait_us;
+};
+
+static struct binder_lock_stats binder_main_lock_stats;
+
+/* Updated with the lock held */
+static void binder_mutex_lock(struct mutex *lock,
+			      struct binder_lock_stats *stats, int cls)
+{
+	ktime_t start;
+	u64 lsl_start;
+	s64 wait_us;
+
+	lsl_acquired(cls);
+	if (mutex_trylock(lock)) {
+		stats->acquired++;
+		return;
+	}
+
+	start = ktime_get();
+	lsl_start = lsl_wait_start();
+	mutex_lock(lock);
+	lsl_contended(cls, lsl_start);
+	wait_us = ktime_us_delta(ktime_get(), start);
+
+	stats->acquired++;
+	stats->contended++;
+	stats->wait_us += wait_us;
+	if (wait_us > stats->max_wait_us)
+		stats->max_wait_us = wait_us;
+}
+
+static inline void binder_lock(void)
+{
+	binder_mutex_lock(&binder_main_lock, &binder_main_lock_stats,
+			  LSL_BINDER);
+}
+
+static inline void binder_unlock(void)
+{
+	mutex_unlock(&binder_main_lock);
+}
+
 struct binder_transaction_log_entry {
 	int debug_id;
 	int call_type;
@@ -211,6 +280,11 @@ struct binder_work {
 	} type;
 };
 
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;	/* rt_priority for SCHED_FIFO and SCHED_RR, else nice */
+};
+
 struct binder_node {
 	int debug_id;
 	struct binder_work work;
@@ -232,6 +306,7 @@ struct binder_node {
 	unsigned has_async_transaction:1;
 	unsigned accept_fds:1;
 	unsigned min_priority:8;
+	unsigned sched_policy:2;
 	struct list_head async_todo;
 };
 
@@ -259,12 +334,17 @@ struct binder_ref {
 
 struct binder_buffer {
 	struct list_head entry; 
-	struct rb_node rb_node; 
+	union {
+		struct rb_node rb_node; 
+		/* on proc->small_free while cached */
+		struct list_head cache_entry;
+	};
 				
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
-	unsigned debug_id:29;
+	unsigned small_class:3;	/* size class + 1, 0 if not small */
+	unsigned debug_id:26;
 
 	struct binder_transaction *transaction;
 
@@ -274,6 +354,22 @@ struct binder_buffer {
 	uint8_t data[0];
 };
 
+/*
+ * Small buffers are carved out of the free tree rounded up to one of a few
+ * size classes.  When such a buffer is freed it is kept on a per class list
+ * with its pages still mapped instead of being merged back into the tree,
+ * so that the next small transaction doesn't have to split, merge and map
+ * pages again.  The binder shrinker gives the cached buffers back to the
+ * tree (and the pages back to the system) when memory is tight.
+ */
+#define BINDER_SMALL_CLASSES	4
+#define BINDER_SMALL_MIN	32
+#define BINDER_SMALL_MAX	(BINDER_SMALL_MIN << (BINDER_SMALL_CLASSES - 1))
+/* Most buffers cached per class and process */
+#define BINDER_SMALL_CACHE	16
+
+static atomic_t binder_small_cached = ATOMIC_INIT(0);
+
 enum binder_deferred_state {
 	BINDER_DEFERRED_PUT_FILES    = 0x01,
 	BINDER_DEFERRED_FLUSH        = 0x02,
@@ -296,10 +392,19 @@ struct binder_proc {
 	void *buffer;
 	ptrdiff_t user_buffer_offset;
 
+	struct mutex alloc_lock;
+	struct binder_lock_stats alloc_lock_stats;
+	/* Pins the proc while binder_main_lock is dropped */
+	int tmp_ref;
+	int release_pending;
 	struct list_head buffers;
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
+	struct list_head small_free[BINDER_SMALL_CLASSES];
+	int small_free_count[BINDER_SMALL_CLASSES];
+	unsigned int small_hits;
+	unsigned int small_misses;
 
 	struct page **pages;
 	size_t buffer_size;
@@ -312,7 +417,7 @@ struct binder_proc {
 	int requested_threads;
 	int requested_threads_started;
 	int ready_threads;
-	long default_priority;
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
 };
 
@@ -354,14 +459,24 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
+	ktime_t	start;
 	uid_t	sender_euid;
 };
 
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
 
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	BUG_ON(proc->tmp_ref <= 0);
+	if (--proc->tmp_ref == 0 && proc->release_pending) {
+		proc->release_pending = 0;
+		binder_defer_work(proc, BINDER_DEFERRED_RELEASE);
+	}
+}
+
 int task_get_unused_fd_flags(struct binder_proc *proc, int flags)
 {
 	struct files_struct *files = proc->files;
@@ -499,6 +614,57 @@ static void binder_set_nice(long nice)
 	binder_user_error("binder: %d RLIMIT_NICE not set\n", current->pid);
 }
 
+static bool binder_is_rt_policy(unsigned int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static void binder_get_priority(struct task_struct *task,
+				struct binder_priority *p)
+{
+	p->sched_policy = task->policy;
+	if (binder_is_rt_policy(task->policy))
+		p->prio = task->rt_priority;
+	else
+		p->prio = task_nice(task);
+}
+
+/* Returns true if a task at priority a runs ahead of one at b */
+static bool binder_priority_higher(const struct binder_priority *a,
+				   const struct binder_priority *b)
+{
+	if (binder_is_rt_policy(a->sched_policy))
+		return !binder_is_rt_policy(b->sched_policy) ||
+			a->prio > b->prio;
+	if (binder_is_rt_policy(b->sched_policy))
+		return false;
+	return a->prio < b->prio;
+}
+
+static void binder_set_priority(const struct binder_priority *p)
+{
+	struct binder_priority old;
+	struct sched_param param;
+
+	binder_get_priority(current, &old);
+	if (old.sched_policy == p->sched_policy && old.prio == p->prio)
+		return;
+
+	trace_binder_set_priority(current, old.sched_policy, old.prio,
+				  p->sched_policy, p->prio);
+
+	if (binder_is_rt_policy(p->sched_policy)) {
+		param.sched_priority = p->prio;
+		sched_setscheduler_nocheck(current, p->sched_policy, &param);
+		return;
+	}
+	if (old.sched_policy != p->sched_policy) {
+		param.sched_priority = 0;
+		sched_setscheduler_nocheck(current, p->sched_policy, &param);
+	}
+	binder_set_nice(p->prio);
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -694,9 +860,38 @@ err_no_vma:
 	return -ENOMEM;
 }
 
-static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
-					      size_t data_size,
-					      size_t offsets_size, int is_async)
+static int binder_small_class(size_t size)
+{
+	int class = 0;
+
+	while ((BINDER_SMALL_MIN << class) < size)
+		class++;
+	return class;
+}
+
+static struct binder_buffer *binder_get_cached_buf(struct binder_proc *proc,
+						   int class)
+{
+	struct binder_buffer *buffer;
+
+	if (list_empty(&proc->small_free[class])) {
+		proc->small_misses++;
+		return NULL;
+	}
+	buffer = list_first_entry(&proc->small_free[class],
+				  struct binder_buffer, cache_entry);
+	list_del(&buffer->cache_entry);
+	proc->small_free_count[class]--;
+	proc->small_hits++;
+	atomic_dec(&binder_small_cached);
+	binder_insert_allocated_buffer(proc, buffer);
+	return buffer;
+}
+
+static struct binder_buffer *binder_alloc_buf_locked(struct binder_proc *proc,
+						     size_t data_size,
+						     size_t offsets_size,
+						     int is_async)
 {
 	struct rb_node *n = proc->free_buffers.rb_node;
 	struct binder_buffer *buffer;
@@ -704,7 +899,8 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	struct rb_node *best_fit = NULL;
 	void *has_page_addr;
 	void *end_page_addr;
-	size_t size;
+	size_t size, alloc_size;
+	int class = -1;
 
 	if (proc->vma == NULL) {
 		printk(KERN_ERR "binder: %d: binder_alloc_buf, no vma\n",
@@ -728,15 +924,28 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 		return NULL;
 	}
 
+	alloc_size = size;
+	if (size <= BINDER_SMALL_MAX) {
+		class = binder_small_class(size);
+		buffer = binder_get_cached_buf(proc, class);
+		if (buffer) {
+			binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+				     "binder: %d: binder_alloc_buf size %zd "
+				     "got cached %p\n", proc->pid, size, buffer);
+			goto found;
+		}
+		alloc_size = BINDER_SMALL_MIN << class;
+	}
+
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
 		buffer_size = binder_buffer_size(proc, buffer);
 
-		if (size < buffer_size) {
+		if (alloc_size < buffer_size) {
 			best_fit = n;
 			n = n->rb_left;
-		} else if (size > buffer_size)
+		} else if (alloc_size > buffer_size)
 			n = n->rb_right;
 		else {
 			best_fit = n;
@@ -760,10 +969,10 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	has_page_addr =
 		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK);
 	if (n == NULL) {
-		if (size + sizeof(struct binder_buffer) + 4 >= buffer_size)
-			buffer_size = size; 
+		if (alloc_size + sizeof(struct binder_buffer) + 4 >= buffer_size)
+			buffer_size = alloc_size; 
 		else
-			buffer_size = size + sizeof(struct binder_buffer);
+			buffer_size = alloc_size + sizeof(struct binder_buffer);
 	}
 	end_page_addr =
 		(void *)PAGE_ALIGN((uintptr_t)buffer->data + buffer_size);
@@ -775,9 +984,11 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 
 	rb_erase(best_fit, &proc->free_buffers);
 	buffer->free = 0;
+	buffer->small_class = class + 1;
 	binder_insert_allocated_buffer(proc, buffer);
-	if (buffer_size != size) {
-		struct binder_buffer *new_buffer = (void *)buffer->data + size;
+	if (buffer_size != alloc_size) {
+		struct binder_buffer *new_buffer = (void *)buffer->data +
+						   alloc_size;
 		list_add(&new_buffer->entry, &buffer->entry);
 		new_buffer->free = 1;
 		binder_insert_free_buffer(proc, new_buffer);
@@ -785,6 +996,10 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
 		     "binder: %d: binder_alloc_buf size %zd got "
 		     "%p\n", proc->pid, size, buffer);
+found:
+	/* binder_buffer_lookup() can see it as soon as alloc_lock drops */
+	buffer->allow_user_free = 0;
+	buffer->transaction = NULL;
 	buffer->data_size = data_size;
 	buffer->offsets_size = offsets_size;
 	buffer->async_transaction = is_async;
@@ -799,6 +1014,20 @@ static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
 	return buffer;
 }
 
+static struct binder_buffer *binder_alloc_buf(struct binder_proc *proc,
+					      size_t data_size,
+					      size_t offsets_size, int is_async)
+{
+	struct binder_buffer *buffer;
+
+	binder_mutex_lock(&proc->alloc_lock, &proc->alloc_lock_stats,
+			  LSL_BINDER_ALLOC);
+	buffer = binder_alloc_buf_locked(proc, data_size, offsets_size,
+					 is_async);
+	mutex_unlock(&proc->alloc_lock);
+	return buffer;
+}
+
 static void *buffer_start_page(struct binder_buffer *buffer)
 {
 	return (void *)((uintptr_t)buffer & PAGE_MASK);
@@ -856,8 +1085,77 @@ static void binder_delete_free_buffer(struct binder_proc *proc,
 	}
 }
 
-static void binder_free_buf(struct binder_proc *proc,
+/* Give a buffer that is no longer in allocated_buffers back to the tree */
+static void __binder_free_buf(struct binder_proc *proc,
+			      struct binder_buffer *buffer, size_t buffer_size)
+{
+	binder_update_page_range(proc, 0,
+		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
+		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
+		NULL);
+	buffer->free = 1;
+	if (!list_is_last(&buffer->entry, &proc->buffers)) {
+		struct binder_buffer *next = list_entry(buffer->entry.next,
+						struct binder_buffer, entry);
+		if (next->free) {
+			rb_erase(&next->rb_node, &proc->free_buffers);
+			binder_delete_free_buffer(proc, next);
+		}
+	}
+	if (proc->buffers.next != &buffer->entry) {
+		struct binder_buffer *prev = list_entry(buffer->entry.prev,
+						struct binder_buffer, entry);
+		if (prev->free) {
+			binder_delete_free_buffer(proc, buffer);
+			rb_erase(&prev->rb_node, &proc->free_buffers);
+			buffer = prev;
+		}
+	}
+	binder_insert_free_buffer(proc, buffer);
+}
+
+static int binder_cache_buf(struct binder_proc *proc,
 			    struct binder_buffer *buffer)
+{
+	int class;
+
+	if (!buffer->small_class || proc->vma == NULL)
+		return 0;
+	class = buffer->small_class - 1;
+	if (proc->small_free_count[class] >= BINDER_SMALL_CACHE)
+		return 0;
+	list_add(&buffer->cache_entry, &proc->small_free[class]);
+	proc->small_free_count[class]++;
+	atomic_inc(&binder_small_cached);
+	return 1;
+}
+
+/* Free up to nr cached small buffers of proc, returns the number freed */
+static int binder_drain_cached_bufs(struct binder_proc *proc, int nr)
+{
+	struct binder_buffer *buffer;
+	int class, freed = 0;
+
+	binder_mutex_lock(&proc->alloc_lock, &proc->alloc_lock_stats,
+			  LSL_BINDER_ALLOC);
+	for (class = BINDER_SMALL_CLASSES - 1; class >= 0; class--) {
+		while (freed < nr && !list_empty(&proc->small_free[class])) {
+			buffer = list_first_entry(&proc->small_free[class],
+					struct binder_buffer, cache_entry);
+			list_del(&buffer->cache_entry);
+			proc->small_free_count[class]--;
+			atomic_dec(&binder_small_cached);
+			__binder_free_buf(proc, buffer,
+					  binder_buffer_size(proc, buffer));
+			freed++;
+		}
+	}
+	mutex_unlock(&proc->alloc_lock);
+	return freed;
+}
+
+static void binder_free_buf_locked(struct binder_proc *proc,
+				   struct binder_buffer *buffer)
 {
 	size_t size, buffer_size;
 
@@ -885,30 +1183,19 @@ static void binder_free_buf(struct binder_proc *proc,
 			     proc->free_async_space);
 	}
 
-	binder_update_page_range(proc, 0,
-		(void *)PAGE_ALIGN((uintptr_t)buffer->data),
-		(void *)(((uintptr_t)buffer->data + buffer_size) & PAGE_MASK),
-		NULL);
 	rb_erase(&buffer->rb_node, &proc->allocated_buffers);
-	buffer->free = 1;
-	if (!list_is_last(&buffer->entry, &proc->buffers)) {
-		struct binder_buffer *next = list_entry(buffer->entry.next,
-						struct binder_buffer, entry);
-		if (next->free) {
-			rb_erase(&next->rb_node, &proc->free_buffers);
-			binder_delete_free_buffer(proc, next);
-		}
-	}
-	if (proc->buffers.next != &buffer->entry) {
-		struct binder_buffer *prev = list_entry(buffer->entry.prev,
-						struct binder_buffer, entry);
-		if (prev->free) {
-			binder_delete_free_buffer(proc, buffer);
-			rb_erase(&prev->rb_node, &proc->free_buffers);
-			buffer = prev;
-		}
-	}
-	binder_insert_free_buffer(proc, buffer);
+	if (binder_cache_buf(proc, buffer))
+		return;
+	__binder_free_buf(proc, buffer, buffer_size);
+}
+
+static void binder_free_buf(struct binder_proc *proc,
+			    struct binder_buffer *buffer)
+{
+	binder_mutex_lock(&proc->alloc_lock, &proc->alloc_lock_stats,
+			  LSL_BINDER_ALLOC);
+	binder_free_buf_locked(proc, buffer);
+	mutex_unlock(&proc->alloc_lock);
 }
 
 static struct binder_node *binder_get_node(struct binder_proc *proc,
@@ -1366,13 +1653,51 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+static int binder_check_sg(const struct binder_sg_entry *sg, size_t count,
+			   size_t data_size)
+{
+	size_t i, total = 0;
+
+	for (i = 0; i < count; i++) {
+		if (sg[i].size > data_size - total)
+			return -EINVAL;
+		total += ALIGN(sg[i].size, sizeof(void *));
+		if (total > data_size)
+			return -EINVAL;
+	}
+	return total == data_size ? 0 : -EINVAL;
+}
+
+static int binder_copy_sg(void *dst, const struct binder_sg_entry *sg,
+			  size_t count)
+{
+	size_t i, pad;
+
+	for (i = 0; i < count; i++) {
+		if (copy_from_user(dst, sg[i].buffer, sg[i].size))
+			return -EFAULT;
+		pad = ALIGN(sg[i].size, sizeof(void *)) - sg[i].size;
+		memset(dst + sg[i].size, 0, pad);
+		dst += sg[i].size + pad;
+	}
+	return 0;
+}
+
+/*
+ * sg is NULL for BC_TRANSACTION and BC_REPLY, otherwise the payload is
+ * gathered from the sg_count user buffers of a BC_*_SG command.
+ */
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
-			       struct binder_transaction_data *tr, int reply)
+			       struct binder_transaction_data *tr, int reply,
+			       const struct binder_sg_entry *sg,
+			       size_t sg_count)
 {
 	struct binder_transaction *t;
 	struct binder_work *tcomplete;
+	struct binder_buffer *buffer;
 	size_t *offp, *off_end;
+	int copy_failed = 0;
 	struct binder_proc *target_proc;
 	struct binder_thread *target_thread = NULL;
 	struct binder_node *target_node = NULL;
@@ -1400,7 +1725,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(&in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("binder: %d:%d got reply transaction "
 				"with bad transaction stack,"
@@ -1487,16 +1812,17 @@ static void binder_transaction(struct binder_proc *proc,
 			}
 		}
 	}
-	if (target_thread) {
+	if (target_thread)
 		e->to_thread = target_thread->pid;
-		target_list = &target_thread->todo;
-		target_wait = &target_thread->wait;
-	} else {
-		target_list = &target_proc->todo;
-		target_wait = &target_proc->wait;
-	}
 	e->to_proc = target_proc->pid;
 
+	if (sg && binder_check_sg(sg, sg_count, tr->data_size)) {
+		binder_user_error("binder: %d:%d got transaction with bad "
+			"scatter-gather list\n", proc->pid, thread->pid);
+		return_error = BR_FAILED_REPLY;
+		goto err_bad_sg;
+	}
+
 	
 	t = kzalloc(sizeof(*t), GFP_KERNEL);
 	if (t == NULL) {
@@ -1543,35 +1869,89 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
-	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
+	binder_get_priority(current, &t->priority);
+	t->start = ktime_get();
+	if (target_node)
+		binder_inc_node(target_node, 1, 0, NULL);
+
+	/*
+	 * Allocating the buffer can map pages and the copies can fault, so
+	 * both are done without binder_main_lock.  The tmp_ref holds off the
+	 * release of target_proc and with it the buffer pages and
+	 * target_node->proc.  Threads can still exit meanwhile, so the
+	 * target thread is looked up again once the lock is back.
+	 */
+	target_proc->tmp_ref++;
+	binder_unlock();
+
+	buffer = binder_alloc_buf(target_proc, tr->data_size,
 		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
-	if (t->buffer == NULL) {
+	if (buffer) {
+		offp = (size_t *)(buffer->data +
+				  ALIGN(tr->data_size, sizeof(void *)));
+		if (sg) {
+			if (binder_copy_sg(buffer->data, sg, sg_count))
+				copy_failed = 1;
+		} else if (copy_from_user(buffer->data, tr->data.ptr.buffer,
+					  tr->data_size))
+			copy_failed = 1;
+		if (!copy_failed && copy_from_user(offp, tr->data.ptr.offsets,
+						   tr->offsets_size))
+			copy_failed = 2;
+	}
+
+	binder_lock();
+	/* The release runs under binder_main_lock, so not before we return */
+	binder_proc_dec_tmpref(target_proc);
+
+	if (buffer == NULL) {
+		if (target_node)
+			binder_dec_node(target_node, 1, 0);
 		return_error = BR_FAILED_REPLY;
 		printk(KERN_INFO "binder: t->buffer binder_alloc_buf fail\n");
 		goto err_binder_alloc_buf_failed;
 	}
-	t->buffer->allow_user_free = 0;
+	t->buffer = buffer;
 	t->buffer->debug_id = t->debug_id;
 	t->buffer->transaction = t;
 	t->buffer->target_node = target_node;
-	if (target_node)
-		binder_inc_node(target_node, 1, 0, NULL);
 
-	offp = (size_t *)(t->buffer->data + ALIGN(tr->data_size, sizeof(void *)));
-
-	if (copy_from_user(t->buffer->data, tr->data.ptr.buffer, tr->data_size)) {
+	if (copy_failed == 1) {
 		binder_user_error("binder: %d:%d got transaction with invalid "
 			"data ptr\n", proc->pid, thread->pid);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
-	if (copy_from_user(offp, tr->data.ptr.offsets, tr->offsets_size)) {
+	if (copy_failed == 2) {
 		binder_user_error("binder: %d:%d got transaction with invalid "
 			"offsets ptr\n", proc->pid, thread->pid);
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
+
+	if (reply) {
+		if (in_reply_to->from == NULL) {
+			return_error = BR_DEAD_REPLY;
+			brdr_fp = 0x44;
+			goto err_dead_target_thread;
+		}
+	} else if (target_thread) {
+		struct binder_transaction *tmp;
+
+		target_thread = NULL;
+		for (tmp = thread->transaction_stack; tmp;
+		     tmp = tmp->from_parent)
+			if (tmp->from && tmp->from->proc == target_proc)
+				target_thread = tmp->from;
+	}
+	t->to_thread = target_thread;
+	if (target_thread) {
+		target_list = &target_thread->todo;
+		target_wait = &target_thread->wait;
+	} else {
+		target_list = &target_proc->todo;
+		target_wait = &target_proc->wait;
+	}
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(size_t))) {
 		binder_user_error("binder: %d:%d got transaction with "
 			"invalid offsets size, %zd\n",
@@ -1605,6 +1985,13 @@ static void binder_transaction(struct binder_proc *proc,
 					goto err_binder_new_node_failed;
 				}
 				node->min_priority = fp->flags & FLAT_BINDER_FLAG_PRIORITY_MASK;
+				node->sched_policy = (fp->flags &
+					FLAT_BINDER_FLAG_SCHED_POLICY_MASK) >>
+					FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT;
+				if (binder_is_rt_policy(node->sched_policy))
+					node->min_priority = clamp_t(int,
+						node->min_priority, 1,
+						MAX_USER_RT_PRIO - 1);
 				node->accept_fds = !!(fp->flags & FLAT_BINDER_FLAG_ACCEPTS_FDS);
 			}
 			if (fp->cookie != node->cookie) {
@@ -1751,6 +2138,10 @@ static void binder_transaction(struct binder_proc *proc,
 		} else
 			target_node->has_async_transaction = 1;
 	}
+	trace_binder_transaction(t->debug_id, reply, target_proc->pid,
+				 target_thread ? target_thread->pid : 0,
+				 t->code, t->flags);
+	frametime_binder(t->debug_id);
 	t->work.type = BINDER_WORK_TRANSACTION;
 	list_add_tail(&t->work.entry, target_list);
 	tcomplete->type = BINDER_WORK_TRANSACTION_COMPLETE;
@@ -1767,6 +2158,7 @@ err_binder_get_ref_failed:
 err_binder_new_node_failed:
 err_bad_object_type:
 err_bad_offset:
+err_dead_target_thread:
 err_copy_data_failed:
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
@@ -1778,6 +2170,7 @@ err_alloc_tcomplete_failed:
 	kfree(t);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 err_alloc_t_failed:
+err_bad_sg:
 err_bad_call_stack:
 err_empty_call_stack:
 err_dead_binder:
@@ -1952,7 +2345,11 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				return -EFAULT;
 			ptr += sizeof(void *);
 
+			binder_mutex_lock(&proc->alloc_lock,
+					  &proc->alloc_lock_stats,
+					  LSL_BINDER_ALLOC);
 			buffer = binder_buffer_lookup(proc, data_ptr);
+			mutex_unlock(&proc->alloc_lock);
 			if (buffer == NULL) {
 				binder_user_error("binder: %d:%d "
 					"BC_FREE_BUFFER u%p no match\n",
@@ -1994,7 +2391,39 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			if (copy_from_user(&tr, ptr, sizeof(tr)))
 				return -EFAULT;
 			ptr += sizeof(tr);
-			binder_transaction(proc, thread, &tr, cmd == BC_REPLY);
+			binder_transaction(proc, thread, &tr, cmd == BC_REPLY,
+					   NULL, 0);
+			break;
+		}
+
+		case BC_TRANSACTION_SG:
+		case BC_REPLY_SG: {
+			struct binder_transaction_data_sg tr;
+			struct binder_sg_entry *sg;
+
+			if (copy_from_user(&tr, ptr, sizeof(tr)))
+				return -EFAULT;
+			ptr += sizeof(tr);
+			if (tr.entries_count == 0 ||
+			    tr.entries_count > BINDER_SG_MAX_ENTRIES) {
+				binder_user_error("binder: %d:%d %s with %zd "
+					"entries\n", proc->pid, thread->pid,
+					cmd == BC_REPLY_SG ? "BC_REPLY_SG" :
+					"BC_TRANSACTION_SG", tr.entries_count);
+				return -EINVAL;
+			}
+			sg = kmalloc(tr.entries_count * sizeof(*sg), GFP_KERNEL);
+			if (sg == NULL)
+				return -ENOMEM;
+			if (copy_from_user(sg, tr.entries,
+					   tr.entries_count * sizeof(*sg))) {
+				kfree(sg);
+				return -EFAULT;
+			}
+			binder_transaction(proc, thread, &tr.transaction_data,
+					   cmd == BC_REPLY_SG, sg,
+					   tr.entries_count);
+			kfree(sg);
 			break;
 		}
 
@@ -2251,7 +2680,7 @@ retry:
 	thread->looper |= BINDER_LOOPER_STATE_WAITING;
 	if (wait_for_proc_work)
 		proc->ready_threads++;
-	mutex_unlock(&binder_lock);
+	binder_unlock();
 	if (wait_for_proc_work) {
 		if (!(thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 					BINDER_LOOPER_STATE_ENTERED))) {
@@ -2262,7 +2691,7 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(&proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
@@ -2275,7 +2704,7 @@ retry:
 		} else
 			ret = wait_event_interruptible(thread->wait, binder_has_thread_work(thread));
 	}
-	mutex_lock(&binder_lock);
+	binder_lock();
 	if (wait_for_proc_work)
 		proc->ready_threads--;
 	thread->looper &= ~BINDER_LOOPER_STATE_WAITING;
@@ -2423,15 +2852,25 @@ retry:
 		BUG_ON(t->buffer == NULL);
 		if (t->buffer->target_node) {
 			struct binder_node *target_node = t->buffer->target_node;
+			struct binder_priority node_prio, prio;
+
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			binder_get_priority(current, &t->saved_priority);
+			/*
+			 * Synchronous calls run at the priority of the caller,
+			 * policy included, until the reply restores ours.  The
+			 * node minimum applies in both cases.
+			 */
+			if (t->flags & TF_ONE_WAY)
+				prio = t->saved_priority;
+			else
+				prio = t->priority;
+			node_prio.sched_policy = target_node->sched_policy;
+			node_prio.prio = target_node->min_priority;
+			if (binder_priority_higher(&node_prio, &prio))
+				prio = node_prio;
+			binder_set_priority(&prio);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = NULL;
@@ -2441,6 +2880,8 @@ retry:
 		tr.code = t->code;
 		tr.flags = t->flags;
 		tr.sender_euid = t->sender_euid;
+		trace_binder_transaction_received(t->debug_id, cmd == BR_REPLY,
+			ktime_us_delta(ktime_get(), t->start));
 
 		if (t->from) {
 			struct task_struct *sender = t->from->proc->tsk;
@@ -2641,12 +3082,12 @@ static unsigned int binder_poll(struct file *filp,
 	struct binder_thread *thread = NULL;
 	int wait_for_proc_work;
 
-	mutex_lock(&binder_lock);
+	binder_lock();
 	thread = binder_get_thread(proc);
 
 	wait_for_proc_work = thread->transaction_stack == NULL &&
 		list_empty(&thread->todo) && thread->return_error == BR_OK;
-	mutex_unlock(&binder_lock);
+	binder_unlock();
 
 	if (wait_for_proc_work) {
 		if (binder_has_proc_work(proc, thread))
@@ -2678,7 +3119,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	if (ret)
 		return ret;
 
-	mutex_lock(&binder_lock);
+	binder_lock();
 	thread = binder_get_thread(proc);
 	if (thread == NULL) {
 		ret = -ENOMEM;
@@ -2790,7 +3231,7 @@ static long binder_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 err:
 	if (thread)
 		thread->looper &= ~BINDER_LOOPER_STATE_NEED_RETURN;
-	mutex_unlock(&binder_lock);
+	binder_unlock();
 	wait_event_interruptible(binder_user_error_wait, binder_stop_on_user_error < 2);
 	if (ret && ret != -ERESTARTSYS)
 		printk(KERN_INFO "binder: %d:%d ioctl %x %lx returned %d\n",
@@ -2924,6 +3365,7 @@ err_bad_arg:
 static int binder_open(struct inode *nodp, struct file *filp)
 {
 	struct binder_proc *proc;
+	int i;
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE, "binder_open: %d:%d\n",
 		     current->group_leader->pid, current->pid);
@@ -2935,14 +3377,22 @@ static int binder_open(struct inode *nodp, struct file *filp)
 	proc->tsk = current;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
-	mutex_lock(&binder_lock);
+	/* Looper threads never idle at RT, whoever opened the device */
+	binder_get_priority(current, &proc->default_priority);
+	if (binder_is_rt_policy(proc->default_priority.sched_policy)) {
+		proc->default_priority.sched_policy = SCHED_NORMAL;
+		proc->default_priority.prio = 0;
+	}
+	mutex_init(&proc->alloc_lock);
+	for (i = 0; i < BINDER_SMALL_CLASSES; i++)
+		INIT_LIST_HEAD(&proc->small_free[i]);
+	binder_lock();
 	binder_stats_created(BINDER_STAT_PROC);
 	hlist_add_head(&proc->proc_node, &binder_procs);
 	proc->pid = current->group_leader->pid;
 	INIT_LIST_HEAD(&proc->delivered_death);
 	filp->private_data = proc;
-	mutex_unlock(&binder_lock);
+	binder_unlock();
 
 	if (binder_debugfs_dir_entry_proc) {
 		char strbuf[11];
@@ -2997,6 +3447,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 	struct binder_transaction *t;
 	struct rb_node *n;
 	int threads, nodes, incoming_refs, outgoing_refs, buffers, active_transactions, page_count;
+	int i;
 
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
@@ -3066,6 +3517,10 @@ static void binder_deferred_release(struct binder_proc *proc)
 	binder_release_work(&proc->delivered_death);
 	buffers = 0;
 
+	/* The cached buffers go away with the pages below */
+	for (i = 0; i < BINDER_SMALL_CLASSES; i++)
+		atomic_sub(proc->small_free_count[i], &binder_small_cached);
+
 	while ((n = rb_first(&proc->allocated_buffers))) {
 		struct binder_buffer *buffer = rb_entry(n, struct binder_buffer,
 							rb_node);
@@ -3086,7 +3541,6 @@ static void binder_deferred_release(struct binder_proc *proc)
 
 	page_count = 0;
 	if (proc->pages) {
-		int i;
 		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
 			if (proc->pages[i]) {
 				void *page_addr = proc->buffer + i * PAGE_SIZE;
@@ -3124,7 +3578,7 @@ static void binder_deferred_func(struct work_struct *work)
 
 	int defer;
 	do {
-		mutex_lock(&binder_lock);
+		binder_lock();
 		mutex_lock(&binder_deferred_lock);
 		if (!hlist_empty(&binder_deferred_list)) {
 			proc = hlist_entry(binder_deferred_list.first,
@@ -3148,16 +3602,60 @@ static void binder_deferred_func(struct work_struct *work)
 		if (defer & BINDER_DEFERRED_FLUSH)
 			binder_deferred_flush(proc);
 
-		if (defer & BINDER_DEFERRED_RELEASE)
-			binder_deferred_release(proc); 
+		if (defer & BINDER_DEFERRED_RELEASE) {
+			if (proc->tmp_ref)
+				proc->release_pending = 1;
+			else
+				binder_deferred_release(proc);
+		}
 
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 		if (files)
 			put_files_struct(files);
 	} while (proc);
 }
 static DECLARE_WORK(binder_deferred_work, binder_deferred_func);
 
+static atomic_t binder_shrink_nr = ATOMIC_INIT(0);
+
+static void binder_shrink_func(struct work_struct *work)
+{
+	struct binder_proc *proc;
+	struct hlist_node *pos;
+	int nr;
+
+	binder_lock();
+	nr = atomic_xchg(&binder_shrink_nr, 0);
+	hlist_for_each_entry(proc, pos, &binder_procs, proc_node) {
+		if (nr <= 0)
+			break;
+		nr -= binder_drain_cached_bufs(proc, nr);
+	}
+	binder_unlock();
+}
+static DECLARE_WORK(binder_shrink_work, binder_shrink_func);
+
+/*
+ * Freeing the cached buffers needs binder_main_lock and the mmap_sem of the
+ * owner, neither of which can be taken from reclaim, so the shrinker only
+ * counts them and leaves the freeing to the binder workqueue.
+ */
+static int binder_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	int count = atomic_read(&binder_small_cached);
+
+	if (sc->nr_to_scan > 0 && count) {
+		atomic_add(min_t(int, sc->nr_to_scan, count), &binder_shrink_nr);
+		queue_work(binder_deferred_workqueue, &binder_shrink_work);
+	}
+	return count;
+}
+
+static struct shrinker binder_shrinker = {
+	.shrink = binder_shrink,
+	.seeks = DEFAULT_SEEKS * 4,
+};
+
 static void
 binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer)
 {
@@ -3175,13 +3673,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %u:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.prio, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3332,9 +3831,11 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3383,7 +3884,9 @@ static const char *binder_command_strings[] = {
 	"BC_EXIT_LOOPER",
 	"BC_REQUEST_DEATH_NOTIFICATION",
 	"BC_CLEAR_DEATH_NOTIFICATION",
-	"BC_DEAD_BINDER_DONE"
+	"BC_DEAD_BINDER_DONE",
+	"BC_TRANSACTION_SG",
+	"BC_REPLY_SG"
 };
 
 static const char *binder_objstat_strings[] = {
@@ -3430,12 +3933,23 @@ static void print_binder_stats(struct seq_file *m, const char *prefix,
 	}
 }
 
+static void print_binder_lock_stats(struct seq_file *m, const char *prefix,
+				    const char *name,
+				    struct binder_lock_stats *stats)
+{
+	seq_printf(m, "%s%s lock: acquired %lu contended %lu "
+		   "wait %llu us max %llu us\n", prefix, name,
+		   stats->acquired, stats->contended,
+		   (unsigned long long)stats->wait_us,
+		   (unsigned long long)stats->max_wait_us);
+}
+
 static void print_binder_proc_stats(struct seq_file *m,
 				    struct binder_proc *proc)
 {
 	struct binder_work *w;
 	struct rb_node *n;
-	int count, strong, weak;
+	int count, strong, weak, i;
 
 	seq_printf(m, "proc %d\n", proc->pid);
 	count = 0;
@@ -3463,11 +3977,20 @@ static void print_binder_proc_stats(struct seq_file *m,
 	}
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
+	mutex_lock(&proc->alloc_lock);
 	count = 0;
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
 	seq_printf(m, "  buffers: %d\n", count);
 
+	count = 0;
+	for (i = 0; i < BINDER_SMALL_CLASSES; i++)
+		count += proc->small_free_count[i];
+	seq_printf(m, "  cached small buffers: %d hits %u misses %u\n",
+		   count, proc->small_hits, proc->small_misses);
+	print_binder_lock_stats(m, "  ", "alloc", &proc->alloc_lock_stats);
+	mutex_unlock(&proc->alloc_lock);
+
 	count = 0;
 	list_for_each_entry(w, &proc->todo, entry) {
 		switch (w->type) {
@@ -3492,7 +4015,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock();
 
 	seq_puts(m, "binder state:\n");
 
@@ -3504,7 +4027,7 @@ static int binder_state_show(struct seq_file *m, void *unused)
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 	return 0;
 }
 
@@ -3515,16 +4038,17 @@ static int binder_stats_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock();
 
 	seq_puts(m, "binder stats:\n");
 
 	print_binder_stats(m, "", &binder_stats);
+	print_binder_lock_stats(m, "", "main", &binder_main_lock_stats);
 
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc_stats(m, proc);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 	return 0;
 }
 
@@ -3535,13 +4059,13 @@ static int binder_transactions_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock();
 
 	seq_puts(m, "binder transactions:\n");
 	hlist_for_each_entry(proc, pos, &binder_procs, proc_node)
 		print_binder_proc(m, proc, 0);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 	return 0;
 }
 
@@ -3551,11 +4075,11 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	int do_lock = !binder_debug_no_lock;
 
 	if (do_lock)
-		mutex_lock(&binder_lock);
+		binder_lock();
 	seq_puts(m, "binder proc state:\n");
 	print_binder_proc(m, proc, 1);
 	if (do_lock)
-		mutex_unlock(&binder_lock);
+		binder_unlock();
 	return 0;
 }
 
@@ -3618,6 +4142,8 @@ static int __init binder_init(void)
 		binder_debugfs_dir_entry_proc = debugfs_create_dir("proc",
 						 binder_debugfs_dir_entry_root);
 	ret = misc_register(&binder_miscdev);
+	if (!ret)
+		register_shrinker(&binder_shrinker);
 	if (binder_debugfs_dir_entry_root) {
 		debugfs_create_file("state",
 				    S_IRUGO,
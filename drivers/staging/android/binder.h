@@ -37,6 +37,14 @@ enum {
 enum {
 	FLAT_BINDER_FLAG_PRIORITY_MASK = 0xff,
 	FLAT_BINDER_FLAG_ACCEPTS_FDS = 0x100,
+	/*
+	 * Scheduling policy of the minimum priority of a node, one of
+	 * SCHED_NORMAL, SCHED_FIFO, SCHED_RR or SCHED_BATCH.  With an RT
+	 * policy the priority bits hold the rt_priority instead of a nice
+	 * value.
+	 */
+	FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT = 9,
+	FLAT_BINDER_FLAG_SCHED_POLICY_MASK = 3U << FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT,
 };
 
 struct flat_binder_object {
@@ -113,6 +121,26 @@ struct binder_transaction_data {
 	} data;
 };
 
+/*
+ * BC_TRANSACTION_SG and BC_REPLY_SG gather the payload from entries_count
+ * user buffers instead of transaction_data.data.ptr.buffer, straight into
+ * the buffer of the target.  Each entry is padded to a multiple of
+ * sizeof(void *), data_size must be the total including the padding and
+ * the offsets are relative to the gathered payload.
+ */
+#define BINDER_SG_MAX_ENTRIES	64
+
+struct binder_sg_entry {
+	const void	*buffer;
+	size_t		size;
+};
+
+struct binder_transaction_data_sg {
+	struct binder_transaction_data	transaction_data;
+	const struct binder_sg_entry	*entries;
+	size_t				entries_count;
+};
+
 struct binder_ptr_cookie {
 	void *ptr;
 	void *cookie;
@@ -191,6 +219,9 @@ enum BinderDriverCommandProtocol {
 	BC_CLEAR_DEATH_NOTIFICATION = _IOW('c', 15, struct binder_ptr_cookie),
 
 	BC_DEAD_BINDER_DONE = _IOW('c', 16, void *),
+
+	BC_TRANSACTION_SG = _IOW('c', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('c', 18, struct binder_transaction_data_sg),
 };
 
 #endif 
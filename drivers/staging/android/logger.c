@@ -25,10 +25,33 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/percpu.h>
+#include <linux/spinlock.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+/*
+ * Writers don't take log->mutex if they can help it.  Each CPU has a small
+ * staging buffer per log that a writer appends its entry to under a per
+ * CPU spinlock, copying the payload with page faults disabled.  Whoever
+ * takes log->mutex next (a reader, or a writer that didn't fit or faulted)
+ * swaps the staging buffers and merges the staged entries into the log in
+ * timestamp order, so readers see the same stream as before.
+ */
+#define LOGGER_STAGE_SIZE	(8 * 1024)
+
+struct logger_stage {
+	spinlock_t		lock;
+	unsigned char		*buf[2];
+	int			active;
+	size_t			used;
+	/* Buffer being merged, only touched with log->mutex held */
+	unsigned char		*merge_buf;
+	size_t			merge_len;
+	size_t			merge_pos;
+};
+
 struct logger_log {
 	unsigned char		*buffer;
 	struct miscdevice	misc;	
@@ -38,6 +61,8 @@ struct logger_log {
 	size_t			w_off;	
 	size_t			head;	
 	size_t			size;	
+	struct logger_stage __percpu *stage;
+	unsigned long		dropped;	/* entries overwritten unread */
 };
 
 struct logger_reader {
@@ -197,6 +222,8 @@ start:
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
+		logger_merge_stages(log);
+
 		ret = (log->w_off == reader->r_off);
 		mutex_unlock(&log->mutex);
 		if (!ret)
@@ -248,7 +275,8 @@ out:
 	return ret;
 }
 
-static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
+static size_t get_next_entry(struct logger_log *log, size_t off, size_t len,
+			     unsigned long *entries)
 {
 	size_t count = 0;
 
@@ -257,6 +285,7 @@ static size_t get_next_entry(struct logger_log *log, size_t off, size_t len)
 			get_entry_msg_len(log, off);
 		off = logger_offset(log, off + nr);
 		count += nr;
+		(*entries)++;
 	} while (count < len);
 
 	return off;
@@ -282,13 +311,22 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 	size_t old = log->w_off;
 	size_t new = logger_offset(log, old + len);
 	struct logger_reader *reader;
+	unsigned long skipped, dropped = 0;
 
-	if (is_between(old, new, log->head))
-		log->head = get_next_entry(log, log->head, len);
+	if (is_between(old, new, log->head)) {
+		skipped = 0;
+		log->head = get_next_entry(log, log->head, len, &skipped);
+	}
 
 	list_for_each_entry(reader, &log->readers, list)
-		if (is_between(old, new, reader->r_off))
-			reader->r_off = get_next_entry(log, reader->r_off, len);
+		if (is_between(old, new, reader->r_off)) {
+			skipped = 0;
+			reader->r_off = get_next_entry(log, reader->r_off, len,
+						       &skipped);
+			dropped = max(dropped, skipped);
+		}
+
+	log->dropped += dropped;
 }
 
 static void do_write_log(struct logger_log *log, const void *buf, size_t count)
@@ -305,6 +343,115 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 
 }
 
+/*
+ * logger_merge_stages - move the staged entries into the log, oldest first
+ *
+ * Caller holds log->mutex.
+ */
+static void logger_merge_stages(struct logger_log *log)
+{
+	struct logger_stage *stage, *oldest;
+	struct logger_entry hdr, oldest_hdr;
+	size_t len;
+	int cpu;
+
+	if (!log->stage)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		stage = per_cpu_ptr(log->stage, cpu);
+		spin_lock(&stage->lock);
+		stage->merge_buf = stage->buf[stage->active];
+		stage->merge_len = stage->used;
+		stage->merge_pos = 0;
+		stage->active ^= 1;
+		stage->used = 0;
+		spin_unlock(&stage->lock);
+	}
+
+	for (;;) {
+		oldest = NULL;
+		for_each_possible_cpu(cpu) {
+			stage = per_cpu_ptr(log->stage, cpu);
+			if (stage->merge_pos == stage->merge_len)
+				continue;
+			memcpy(&hdr, stage->merge_buf + stage->merge_pos,
+			       sizeof(hdr));
+			if (!oldest || hdr.sec < oldest_hdr.sec ||
+			    (hdr.sec == oldest_hdr.sec &&
+			     hdr.nsec < oldest_hdr.nsec)) {
+				oldest = stage;
+				oldest_hdr = hdr;
+			}
+		}
+		if (!oldest)
+			break;
+
+		len = sizeof(struct logger_entry) + oldest_hdr.len;
+		fix_up_readers(log, len);
+		do_write_log(log, oldest->merge_buf + oldest->merge_pos, len);
+		oldest->merge_pos += len;
+	}
+}
+
+/*
+ * logger_stage_write - append an entry to the staging buffer of this CPU
+ *
+ * Returns the payload length, or -EAGAIN if the entry has to go through
+ * log->mutex because the buffer is full or the payload isn't resident.
+ */
+static ssize_t logger_stage_write(struct logger_log *log,
+				  struct logger_entry *header,
+				  const struct iovec *iov,
+				  unsigned long nr_segs)
+{
+	struct logger_stage *stage;
+	struct timespec now;
+	unsigned char *dst;
+	size_t count = 0;
+	ssize_t ret = -EAGAIN;
+
+	if (!log->stage)
+		return -EAGAIN;
+
+	stage = get_cpu_ptr(log->stage);
+	spin_lock(&stage->lock);
+
+	if (stage->used + sizeof(struct logger_entry) + header->len >
+	    LOGGER_STAGE_SIZE)
+		goto out;
+
+	/* Taken under the lock so that each stage is in timestamp order */
+	now = current_kernel_time();
+	header->sec = now.tv_sec;
+	header->nsec = now.tv_nsec;
+
+	dst = stage->buf[stage->active] + stage->used;
+	memcpy(dst, header, sizeof(struct logger_entry));
+	dst += sizeof(struct logger_entry);
+
+	pagefault_disable();
+	while (nr_segs-- > 0 && count < header->len) {
+		size_t len = min_t(size_t, iov->iov_len, header->len - count);
+
+		if (!access_ok(VERIFY_READ, iov->iov_base, len) ||
+		    __copy_from_user_inatomic(dst + count, iov->iov_base, len))
+			break;
+		count += len;
+		iov++;
+	}
+	pagefault_enable();
+
+	if (count == header->len) {
+		stage->used += sizeof(struct logger_entry) + header->len;
+		ret = count;
+	}
+out:
+	spin_unlock(&stage->lock);
+	put_cpu_ptr(log->stage);
+	return ret;
+}
+
 static ssize_t do_write_log_from_user(struct logger_log *log,
 				      const void __user *buf, size_t count)
 {
@@ -327,17 +474,13 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
+	size_t orig;
 	struct logger_entry header;
 	struct timespec now;
 	ssize_t ret = 0;
 
-	now = current_kernel_time();
-
 	header.pid = current->tgid;
 	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
 	header.euid = current_euid();
 	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
 	header.hdr_size = sizeof(struct logger_entry);
@@ -346,8 +489,23 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
+	ret = logger_stage_write(log, &header, iov, nr_segs);
+	if (ret != -EAGAIN) {
+		wake_up_interruptible(&log->wq);
+		return ret;
+	}
+	ret = 0;
+
 	mutex_lock(&log->mutex);
 
+	/* Keep the log in order, anything staged goes first */
+	logger_merge_stages(log);
+
+	now = current_kernel_time();
+	header.sec = now.tv_sec;
+	header.nsec = now.tv_nsec;
+	orig = log->w_off;
+
 	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
 
 	do_write_log(log, &header, sizeof(struct logger_entry));
@@ -451,6 +609,7 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 	poll_wait(file, &log->wq, wait);
 
 	mutex_lock(&log->mutex);
+	logger_merge_stages(log);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
@@ -483,6 +642,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	void __user *argp = (void __user *) arg;
 
 	mutex_lock(&log->mutex);
+	logger_merge_stages(log);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -542,6 +702,9 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		reader = file->private_data;
 		ret = logger_set_version(reader, argp);
 		break;
+	case LOGGER_GET_DROPPED:
+		ret = log->dropped;
+		break;
 	}
 
 	mutex_unlock(&log->mutex);
@@ -596,10 +759,48 @@ static struct logger_log *get_log_from_minor(int minor)
 	return NULL;
 }
 
+static void __init free_log_stage(struct logger_log *log)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(log->stage, cpu)->buf[0]);
+	free_percpu(log->stage);
+	log->stage = NULL;
+}
+
+static int __init init_log_stage(struct logger_log *log)
+{
+	int cpu;
+
+	log->stage = alloc_percpu(struct logger_stage);
+	if (!log->stage)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct logger_stage *stage = per_cpu_ptr(log->stage, cpu);
+
+		spin_lock_init(&stage->lock);
+		stage->buf[0] = kmalloc(2 * LOGGER_STAGE_SIZE, GFP_KERNEL);
+		if (!stage->buf[0]) {
+			free_log_stage(log);
+			return -ENOMEM;
+		}
+		stage->buf[1] = stage->buf[0] + LOGGER_STAGE_SIZE;
+	}
+
+	return 0;
+}
+
 static int __init init_log(struct logger_log *log)
 {
 	int ret;
 
+	/* Without the staging buffers every write takes log->mutex */
+	if (init_log_stage(log))
+		printk(KERN_WARNING "logger: no staging buffers for log "
+		       "'%s'\n", log->misc.name);
+
 	ret = misc_register(&log->misc);
 	if (unlikely(ret)) {
 		printk(KERN_ERR "logger: failed to register misc "
@@ -56,5 +56,6 @@ struct logger_entry {
 #define LOGGER_FLUSH_LOG		_IO(__LOGGERIO, 4) 
 #define LOGGER_GET_VERSION		_IO(__LOGGERIO, 5) 
 #define LOGGER_SET_VERSION		_IO(__LOGGERIO, 6) 
+#define LOGGER_GET_DROPPED		_IO(__LOGGERIO, 7) /* entries lost unread */
 
 #endif 
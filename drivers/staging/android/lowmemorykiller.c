@@ -42,6 +42,18 @@
 #include <linux/swap.h>
 #include <linux/memory.h>
 #include <linux/memory_hotplug.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/perf_telemetry.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/lowmemorykiller.h>
+
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+#include <linux/bitops.h>
+#include <linux/spinlock.h>
+#include <linux/vmpressure.h>
+#endif
 
 #ifdef CONFIG_ZRAM_FOR_ANDROID
 #include <linux/fs.h>
@@ -209,61 +221,37 @@ static void dump_tasks(void)
 
 static DEFINE_MUTEX(scan_mutex);
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+/*
+ * Work out the lowest oom_score_adj that may be killed at the current level
+ * of free memory.  Returns OOM_SCORE_ADJ_MAX + 1 if there is enough memory.
+ */
+static int lowmem_min_score_adj(int *other_free, int *other_file,
+				int *reserved_free, int *fork_boost)
 {
-	struct task_struct *tsk;
-#ifdef ENHANCED_LMK_ROUTINE
-	struct task_struct *selected[LOWMEM_DEATHPENDING_DEPTH] = {NULL,};
-#else
-	struct task_struct *selected = NULL;
-#endif
-	int rem = 0;
-	int tasksize;
-	int i;
 	int min_score_adj = OOM_SCORE_ADJ_MAX + 1;
-#ifdef ENHANCED_LMK_ROUTINE
-	int selected_tasksize[LOWMEM_DEATHPENDING_DEPTH] = {0,};
-	int selected_oom_score_adj[LOWMEM_DEATHPENDING_DEPTH] = {OOM_ADJUST_MAX,};
-	int all_selected_oom = 0;
-	int max_selected_oom_idx = 0;
-#else
-	int selected_tasksize = 0;
-	int selected_oom_score_adj;
-	int selected_oom_adj = 0;
-#endif
 	int array_size = ARRAY_SIZE(lowmem_adj);
-	int other_free;
-	int other_file;
-	int reserved_free = 0;
-	unsigned long nr_to_scan = sc->nr_to_scan;
-	int fork_boost = 0;
 	size_t *min_array;
 	struct zone *zone;
+	int i;
 
-	if (nr_to_scan > 0) {
-		if (!mutex_trylock(&scan_mutex)) {
-			if (!(lowmem_only_kswapd_sleep && !current_is_kswapd())) {
-				msleep_interruptible(lowmem_sleep_ms);
-			}
-			return 0;
-		}
-	}
+	*reserved_free = 0;
+	*fork_boost = 0;
 
 	for_each_zone(zone)
 	{
 		if(is_normal(zone))
 		{
-			reserved_free = zone->watermark[WMARK_MIN] + zone->lowmem_reserve[_ZONE];
+			*reserved_free = zone->watermark[WMARK_MIN] + zone->lowmem_reserve[_ZONE];
 			break;
 		}
 	}
 
-	other_free = global_page_state(NR_FREE_PAGES);
-	other_file = global_page_state(NR_FILE_PAGES) -
+	*other_free = global_page_state(NR_FREE_PAGES);
+	*other_file = global_page_state(NR_FILE_PAGES) -
 		global_page_state(NR_SHMEM) - global_page_state(NR_MLOCK) ;
 
 #ifdef CONFIG_ZRAM_FOR_ANDROID
-	other_file -= total_swapcache_pages;
+	*other_file -= total_swapcache_pages;
 #endif
  
 	if (lowmem_fork_boost &&
@@ -281,14 +269,201 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		array_size = lowmem_minfree_size;
 
 	for (i = 0; i < array_size; i++) {
-		if ((other_free - reserved_free) < min_array[i] &&
-		    other_file < min_array[i]) {
+		if ((*other_free - *reserved_free) < min_array[i] &&
+		    *other_file < min_array[i]) {
 			min_score_adj = lowmem_adj[i];
-			fork_boost = lowmem_fork_boost_minfree[i];
+			*fork_boost = lowmem_fork_boost_minfree[i];
+			break;
+		}
+	}
+
+	return min_score_adj;
+}
+
+/*
+ * Reaping.  A victim that is blocked can take a long time to get to
+ * exit_mm, but nobody needs its private memory once SIGKILL is pending.
+ * Right after the kill a worker unmaps it the way MADV_DONTNEED would, so
+ * the memory comes back while the victim is still on its way out.  Shared
+ * mappings are left alone since unmapping them frees nothing, as are
+ * mlocked ones which exit_mmap has to munlock first.
+ */
+#define LMK_REAP_SLOTS		3
+#define LMK_REAP_RETRIES	10
+
+struct lowmem_reap {
+	struct work_struct work;
+	struct task_struct *task;
+	ktime_t kill_time;
+};
+
+static struct workqueue_struct *lowmem_wq;
+static struct lowmem_reap lowmem_reaps[LMK_REAP_SLOTS];
+static unsigned long lowmem_reap_busy;
+static uint32_t lowmem_reap_enable = 1;
+
+/* Pages that killing the owner of mm gives back, in RAM or in swap */
+static int lowmem_mm_size(struct mm_struct *mm)
+{
+	return get_mm_rss(mm) + get_mm_counter(mm, MM_SWAPENTS);
+}
+
+/* Pages the victim holds outside of its mm, GPU memory for one */
+static int lowmem_driver_pages(struct task_struct *p)
+{
+	unsigned long (*driver_pages)(pid_t) = ACCESS_ONCE(oom_driver_pages);
+
+	return driver_pages ? driver_pages(p->tgid) : 0;
+}
+
+static bool lowmem_reap_mm(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma;
+
+	/* The victim may be stuck with it held for writing */
+	if (!down_read_trylock(&mm->mmap_sem))
+		return false;
+
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (vma->vm_flags & (VM_SHARED | VM_LOCKED | VM_HUGETLB |
+				     VM_PFNMAP))
+			continue;
+		zap_page_range(vma, vma->vm_start, vma->vm_end - vma->vm_start,
+			       NULL);
+	}
+
+	up_read(&mm->mmap_sem);
+	return true;
+}
+
+static void lowmem_reap_work(struct work_struct *work)
+{
+	struct lowmem_reap *reap = container_of(work, struct lowmem_reap, work);
+	struct task_struct *p;
+	struct mm_struct *mm = NULL;
+	int before, after, tries;
+
+	p = find_lock_task_mm(reap->task);
+	if (p) {
+		mm = p->mm;
+		/* Memory that is used outside the thread group stays */
+		if (atomic_read(&mm->mm_users) > get_nr_threads(p))
+			mm = NULL;
+		else
+			atomic_inc(&mm->mm_users);
+		task_unlock(p);
+	}
+	if (!mm)
+		goto out;
+
+	before = lowmem_mm_size(mm);
+	for (tries = 0; tries < LMK_REAP_RETRIES; tries++) {
+		if (lowmem_reap_mm(mm))
 			break;
+		schedule_timeout_uninterruptible(HZ / 10);
+	}
+	after = lowmem_mm_size(mm);
+	mmput(mm);
+
+	if (tries == LMK_REAP_RETRIES) {
+		lowmem_print(2, "lowmem_reap: %d (%s) busy, left to exit\n",
+			     reap->task->pid, reap->task->comm);
+		goto out;
+	}
+
+	lowmem_print(1, "lowmem_reap: %d (%s), reclaimed %dK in %lldus\n",
+		     reap->task->pid, reap->task->comm,
+		     (before - after) << (PAGE_SHIFT - 10),
+		     ktime_us_delta(ktime_get(), reap->kill_time));
+	trace_lowmemory_reap(reap->task, before - after,
+			     ktime_us_delta(ktime_get(), reap->kill_time));
+out:
+	put_task_struct(reap->task);
+	clear_bit(reap - lowmem_reaps, &lowmem_reap_busy);
+}
+
+/* Start reaping a task that was just sent SIGKILL, if a slot is free */
+static void lowmem_reap_task(struct task_struct *task)
+{
+	struct lowmem_reap *reap;
+	int i;
+
+	if (!lowmem_reap_enable || !lowmem_wq)
+		return;
+
+	for (i = 0; i < LMK_REAP_SLOTS; i++) {
+		if (!test_and_set_bit(i, &lowmem_reap_busy))
+			break;
+	}
+	if (i == LMK_REAP_SLOTS)
+		return;
+
+	reap = &lowmem_reaps[i];
+	get_task_struct(task);
+	reap->task = task;
+	reap->kill_time = ktime_get();
+	queue_work(lowmem_wq, &reap->work);
+}
+
+static void __init lowmem_reap_init(void)
+{
+	int i;
+
+	for (i = 0; i < LMK_REAP_SLOTS; i++)
+		INIT_WORK(&lowmem_reaps[i].work, lowmem_reap_work);
+}
+
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+static uint32_t lowmem_event_mode = 1;
+#endif
+
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	struct task_struct *tsk;
+#ifdef ENHANCED_LMK_ROUTINE
+	struct task_struct *selected[LOWMEM_DEATHPENDING_DEPTH] = {NULL,};
+#else
+	struct task_struct *selected = NULL;
+#endif
+	int rem = 0;
+	int tasksize;
+	int i;
+	int min_score_adj;
+#ifdef ENHANCED_LMK_ROUTINE
+	int selected_tasksize[LOWMEM_DEATHPENDING_DEPTH] = {0,};
+	int selected_oom_score_adj[LOWMEM_DEATHPENDING_DEPTH] = {OOM_ADJUST_MAX,};
+	int all_selected_oom = 0;
+	int max_selected_oom_idx = 0;
+#else
+	int selected_tasksize = 0;
+	int selected_oom_score_adj;
+	int selected_oom_adj = 0;
+#endif
+	int other_free;
+	int other_file;
+	int reserved_free;
+	unsigned long nr_to_scan = sc->nr_to_scan;
+	int fork_boost;
+	ktime_t start = ktime_get();
+
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+	/* Kills are driven by reclaim pressure, see lowmem_vmpressure() */
+	if (lowmem_event_mode)
+		return 0;
+#endif
+
+	if (nr_to_scan > 0) {
+		if (!mutex_trylock(&scan_mutex)) {
+			if (!(lowmem_only_kswapd_sleep && !current_is_kswapd())) {
+				msleep_interruptible(lowmem_sleep_ms);
+			}
+			return 0;
 		}
 	}
 
+	min_score_adj = lowmem_min_score_adj(&other_free, &other_file,
+					     &reserved_free, &fork_boost);
+
 	if (nr_to_scan > 0)
 		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %d, rfree %d\n",
 				nr_to_scan, sc->gfp_mask, other_free,
@@ -355,8 +530,9 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			task_unlock(p);
 			continue;
 		}
-		tasksize = get_mm_rss(p->mm);
+		tasksize = lowmem_mm_size(p->mm);
 		task_unlock(p);
+		tasksize += lowmem_driver_pages(p);
 		if (tasksize <= 0)
 			continue;
 
@@ -425,6 +601,14 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			lowmem_deathpending_timeout = jiffies + HZ;
 			send_sig(SIGKILL, selected[i], 0);
 			set_tsk_thread_flag(selected[i], TIF_MEMDIE);
+			trace_lowmemory_kill(selected[i],
+					     selected_oom_score_adj[i],
+					     selected_tasksize[i],
+					     ktime_us_delta(ktime_get(), start));
+			perf_tm_log(PERF_TM_LMK_KILL, selected[i]->pid,
+				    selected_oom_score_adj[i],
+				    selected_tasksize[i]);
+			lowmem_reap_task(selected[i]);
 			rem -= selected_tasksize[i];
 #ifdef LMK_COUNT_READ
 			lmk_count++;
@@ -448,6 +632,12 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		}
 		send_sig(SIGKILL, selected, 0);
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
+		trace_lowmemory_kill(selected, selected_oom_score_adj,
+				     selected_tasksize,
+				     ktime_us_delta(ktime_get(), start));
+		perf_tm_log(PERF_TM_LMK_KILL, selected->pid,
+			    selected_oom_score_adj, selected_tasksize);
+		lowmem_reap_task(selected);
 		rem -= selected_tasksize;
 #ifdef LMK_COUNT_READ
 		lmk_count++;
@@ -461,6 +651,9 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	else
 		rcu_read_unlock();
 #endif
+	/* The sizes include swap, the count is of pages on the LRU */
+	if (rem < 0)
+		rem = 0;
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     sc->nr_to_scan, sc->gfp_mask, rem);
 #ifdef CONFIG_ZRAM_FOR_ANDROID
@@ -470,6 +663,314 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	return rem;
 }
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+/*
+ * Event mode.  Instead of walking every process from the shrinker, thread
+ * group leaders are kept in one bucket per oom_score_adj value, in the
+ * order in which they got there, so the highest one that is populated is
+ * found straight away.  Kills are decided from a worker that is kicked by
+ * the reclaim pressure notifier once the pressure reaches event_pressure.
+ * The minfree thresholds still decide which oom_score_adj may be killed.
+ *
+ * lmk_adj_lock is innermost: it is taken under the tasklist_lock, the
+ * siglock and task_lock, and nothing is taken while holding it.
+ */
+#define LMK_ADJ_BUCKETS		(OOM_SCORE_ADJ_MAX - OOM_SCORE_ADJ_MIN + 1)
+/* Tasks looked at per kill, from the highest oom_score_adj down */
+#define LMK_CANDIDATES		16
+
+static DEFINE_SPINLOCK(lmk_adj_lock);
+static struct list_head lmk_adj_buckets[LMK_ADJ_BUCKETS];
+static DECLARE_BITMAP(lmk_adj_map, LMK_ADJ_BUCKETS);
+static bool lmk_adj_ready;
+
+/* Tasks that were sent a kill and haven't exited yet */
+static struct {
+	pid_t pid;
+	ktime_t time;
+} lmk_victims[LOWMEM_DEATHPENDING_DEPTH];
+
+static uint32_t lowmem_event_pressure = 60;
+static struct work_struct lowmem_event_work;
+static ktime_t lowmem_event_time;
+
+static void __lowmem_adj_insert(struct task_struct *p, int adj)
+{
+	int idx = adj - OOM_SCORE_ADJ_MIN;
+
+	p->lmk_adj = adj;
+	list_add_tail(&p->lmk_adj_node, &lmk_adj_buckets[idx]);
+	__set_bit(idx, lmk_adj_map);
+}
+
+static void __lowmem_adj_remove(struct task_struct *p)
+{
+	int idx = p->lmk_adj - OOM_SCORE_ADJ_MIN;
+
+	list_del_init(&p->lmk_adj_node);
+	if (list_empty(&lmk_adj_buckets[idx]))
+		__clear_bit(idx, lmk_adj_map);
+}
+
+/* A new thread group, called from fork with the tasklist_lock held */
+void lowmem_adj_add(struct task_struct *p)
+{
+	if (!lmk_adj_ready)
+		return;
+
+	spin_lock(&lmk_adj_lock);
+	__lowmem_adj_insert(p, p->signal->oom_score_adj);
+	spin_unlock(&lmk_adj_lock);
+}
+
+/* The thread group is gone, called with the tasklist_lock held */
+void lowmem_adj_del(struct task_struct *p)
+{
+	int i;
+
+	spin_lock(&lmk_adj_lock);
+	if (!list_empty(&p->lmk_adj_node))
+		__lowmem_adj_remove(p);
+
+	for (i = 0; i < LOWMEM_DEATHPENDING_DEPTH; i++) {
+		if (lmk_victims[i].pid && lmk_victims[i].pid == p->pid) {
+			trace_lowmemory_kill_done(p,
+				ktime_us_delta(ktime_get(), lmk_victims[i].time));
+			lmk_victims[i].pid = 0;
+		}
+	}
+	spin_unlock(&lmk_adj_lock);
+}
+
+/* oom_score_adj of p's thread group changed, called with the siglock held */
+void lowmem_adj_update(struct task_struct *p)
+{
+	struct task_struct *leader = p->group_leader;
+	int adj = p->signal->oom_score_adj;
+
+	spin_lock(&lmk_adj_lock);
+	if (!list_empty(&leader->lmk_adj_node) && leader->lmk_adj != adj) {
+		__lowmem_adj_remove(leader);
+		__lowmem_adj_insert(leader, adj);
+	}
+	spin_unlock(&lmk_adj_lock);
+}
+
+/* A thread took over as leader in exec, called with the tasklist_lock held */
+void lowmem_adj_replace(struct task_struct *old, struct task_struct *new)
+{
+	spin_lock(&lmk_adj_lock);
+	if (!list_empty(&old->lmk_adj_node)) {
+		new->lmk_adj = old->lmk_adj;
+		list_replace_init(&old->lmk_adj_node, &new->lmk_adj_node);
+	}
+	spin_unlock(&lmk_adj_lock);
+}
+
+/* Put the tasks that exist already in the buckets */
+static void __init lowmem_adj_init_buckets(void)
+{
+	struct task_struct *p;
+	int i;
+
+	for (i = 0; i < LMK_ADJ_BUCKETS; i++)
+		INIT_LIST_HEAD(&lmk_adj_buckets[i]);
+
+	read_lock(&tasklist_lock);
+	spin_lock(&lmk_adj_lock);
+	for_each_process(p)
+		__lowmem_adj_insert(p, p->signal->oom_score_adj);
+	lmk_adj_ready = true;
+	spin_unlock(&lmk_adj_lock);
+	read_unlock(&tasklist_lock);
+}
+
+/*
+ * Take a reference on up to LMK_CANDIDATES leaders with an oom_score_adj
+ * of at least min_score_adj, highest first.  Returns the number taken, or
+ * -EBUSY if an earlier victim is still exiting.
+ */
+static int lowmem_get_candidates(struct task_struct **cand, int min_score_adj)
+{
+	int min_idx = min_score_adj - OOM_SCORE_ADJ_MIN;
+	struct task_struct *p;
+	int idx, next, i, nr = 0;
+
+	spin_lock(&lmk_adj_lock);
+
+	if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+		for (i = 0; i < LOWMEM_DEATHPENDING_DEPTH; i++) {
+			if (lmk_victims[i].pid) {
+				spin_unlock(&lmk_adj_lock);
+				return -EBUSY;
+			}
+		}
+	}
+
+	idx = find_last_bit(lmk_adj_map, LMK_ADJ_BUCKETS);
+	while (idx < LMK_ADJ_BUCKETS && idx >= min_idx) {
+		list_for_each_entry(p, &lmk_adj_buckets[idx], lmk_adj_node) {
+			if (p->flags & PF_KTHREAD)
+				continue;
+			get_task_struct(p);
+			cand[nr++] = p;
+			if (nr == LMK_CANDIDATES)
+				goto out;
+		}
+
+		next = find_last_bit(lmk_adj_map, idx);
+		if (next >= idx)
+			break;
+		idx = next;
+	}
+out:
+	spin_unlock(&lmk_adj_lock);
+
+	return nr;
+}
+
+static void lowmem_event_kill(struct work_struct *work)
+{
+	struct task_struct *cand[LMK_CANDIDATES];
+	struct task_struct *selected[LOWMEM_DEATHPENDING_DEPTH] = {NULL,};
+	int selected_tasksize[LOWMEM_DEATHPENDING_DEPTH] = {0,};
+	int selected_oom_score_adj[LOWMEM_DEATHPENDING_DEPTH] = {0,};
+	int other_free, other_file, reserved_free, fork_boost;
+	int min_score_adj, nr, i, j, weakest;
+	ktime_t start = lowmem_event_time;
+
+	mutex_lock(&scan_mutex);
+
+	min_score_adj = lowmem_min_score_adj(&other_free, &other_file,
+					     &reserved_free, &fork_boost);
+	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1)
+		goto out;
+
+	nr = lowmem_get_candidates(cand, min_score_adj);
+	if (nr < 0) {
+		lowmem_print(2, "lowmem_event: waiting for a victim to exit\n");
+		goto out;
+	}
+
+#ifdef CONFIG_ZRAM_FOR_ANDROID
+	atomic_set(&s_reclaim.lmk_running, 1);
+#endif
+
+	/*
+	 * Same choice as the shrinker: the LOWMEM_DEATHPENDING_DEPTH tasks
+	 * with the highest oom_score_adj, the biggest ones first on a tie
+	 */
+	for (i = 0; i < nr; i++) {
+		struct task_struct *p;
+		int tasksize, adj;
+
+		p = find_lock_task_mm(cand[i]);
+		if (!p)
+			continue;
+		adj = p->signal->oom_score_adj;
+		tasksize = lowmem_mm_size(p->mm);
+		task_unlock(p);
+		if (adj < min_score_adj || tasksize <= 0)
+			continue;
+
+		weakest = 0;
+		for (j = 0; j < LOWMEM_DEATHPENDING_DEPTH; j++) {
+			if (!selected[j]) {
+				weakest = j;
+				break;
+			}
+			if (selected_oom_score_adj[j] <
+			    selected_oom_score_adj[weakest] ||
+			    (selected_oom_score_adj[j] ==
+			     selected_oom_score_adj[weakest] &&
+			     selected_tasksize[j] < selected_tasksize[weakest]))
+				weakest = j;
+		}
+
+		if (selected[weakest] &&
+		    (adj < selected_oom_score_adj[weakest] ||
+		     (adj == selected_oom_score_adj[weakest] &&
+		      tasksize <= selected_tasksize[weakest])))
+			continue;
+
+		selected[weakest] = cand[i];
+		selected_tasksize[weakest] = tasksize;
+		selected_oom_score_adj[weakest] = adj;
+	}
+
+	for (i = 0; i < LOWMEM_DEATHPENDING_DEPTH; i++) {
+		struct task_struct *p = selected[i];
+
+		if (!p)
+			continue;
+
+		lowmem_print(1, "lowmem_event: send sigkill to %d (%s), adj %d, size %dK, free %dK, file %dK\n",
+			     p->pid, p->comm, selected_oom_score_adj[i],
+			     selected_tasksize[i] << 2, other_free << 2,
+			     other_file << 2);
+		lowmem_deathpending_timeout = jiffies + HZ;
+		send_sig(SIGKILL, p, 0);
+		set_tsk_thread_flag(p, TIF_MEMDIE);
+		trace_lowmemory_kill(p, selected_oom_score_adj[i],
+				     selected_tasksize[i],
+				     ktime_us_delta(ktime_get(), start));
+		perf_tm_log(PERF_TM_LMK_KILL, p->pid,
+			    selected_oom_score_adj[i], selected_tasksize[i]);
+		lowmem_reap_task(p);
+
+		spin_lock(&lmk_adj_lock);
+		lmk_victims[i].pid = p->pid;
+		lmk_victims[i].time = ktime_get();
+		spin_unlock(&lmk_adj_lock);
+#ifdef LMK_COUNT_READ
+		lmk_count++;
+#endif
+	}
+
+	for (i = 0; i < nr; i++)
+		put_task_struct(cand[i]);
+
+#ifdef CONFIG_ZRAM_FOR_ANDROID
+	atomic_set(&s_reclaim.lmk_running, 0);
+#endif
+out:
+	mutex_unlock(&scan_mutex);
+}
+
+/* Called from reclaim, so only note the time and kick the worker */
+static int lowmem_vmpressure(struct notifier_block *nb,
+			     unsigned long pressure, void *data)
+{
+	if (!lowmem_event_mode || pressure < lowmem_event_pressure)
+		return NOTIFY_OK;
+
+	if (!work_pending(&lowmem_event_work)) {
+		lowmem_event_time = ktime_get();
+		queue_work(lowmem_wq, &lowmem_event_work);
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_vmpressure_nb = {
+	.notifier_call = lowmem_vmpressure,
+};
+
+static void __init lowmem_event_init(void)
+{
+	lowmem_adj_init_buckets();
+
+	INIT_WORK(&lowmem_event_work, lowmem_event_kill);
+	if (!lowmem_wq) {
+		pr_err("lowmemorykiller: no workqueue, using the shrinker\n");
+		lowmem_event_mode = 0;
+		return;
+	}
+
+	vmpressure_register_notifier(&lowmem_vmpressure_nb);
+}
+#endif /* CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT */
+
 #ifdef CONFIG_ZRAM_FOR_ANDROID
 void could_cswap(void)
 {
@@ -637,6 +1138,12 @@ static int __init lowmem_init(void)
 {
 	task_fork_register(&task_fork_nb);
 	register_shrinker(&lowmem_shrinker);
+	lowmem_reap_init();
+	lowmem_wq = alloc_workqueue("lowmemorykiller",
+				    WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+	lowmem_event_init();
+#endif
 #ifdef CONFIG_ZRAM_FOR_ANDROID
 	kcompcache_class = class_create(THIS_MODULE, "kcompcache");
 	if (IS_ERR(kcompcache_class)) {
@@ -672,6 +1179,12 @@ static void __exit lowmem_exit(void)
 {
 	unregister_shrinker(&lowmem_shrinker);
 	task_fork_unregister(&task_fork_nb);
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+	if (lowmem_wq)
+		vmpressure_unregister_notifier(&lowmem_vmpressure_nb);
+#endif
+	if (lowmem_wq)
+		destroy_workqueue(lowmem_wq);
 #ifdef CONFIG_ZRAM_FOR_ANDROID
 	if (s_reclaim.kcompcached) {
 		cancel_soft_reclaim();
@@ -777,6 +1290,7 @@ module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
 module_param_named(fork_boost, lowmem_fork_boost, uint, S_IRUGO | S_IWUSR);
+module_param_named(reap, lowmem_reap_enable, uint, S_IRUGO | S_IWUSR);
 module_param_array_named(fork_boost_minfree, lowmem_fork_boost_minfree, uint,
 			 &lowmem_fork_boost_minfree_size, S_IRUGO | S_IWUSR);
 
@@ -784,6 +1298,12 @@ module_param_array_named(fork_boost_minfree, lowmem_fork_boost_minfree, uint,
 module_param_named(lmkcount, lmk_count, uint, S_IRUGO);
 #endif
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+module_param_named(event_mode, lowmem_event_mode, uint, S_IRUGO | S_IWUSR);
+module_param_named(event_pressure, lowmem_event_pressure, uint,
+		   S_IRUGO | S_IWUSR);
+#endif
+
 #ifdef CONFIG_ZRAM_FOR_ANDROID
 module_param_named(min_freeswap, minimum_freeswap_pages, uint, S_IRUSR | S_IWUSR);
 module_param_named(min_reclaim, minimun_reclaim_pages, uint, S_IRUSR | S_IWUSR);
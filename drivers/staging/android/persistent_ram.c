@@ -20,10 +20,14 @@
 #include <linux/io.h>
 #include <linux/list.h>
 #include <linux/memblock.h>
+#include <linux/module.h>
+#include <linux/notifier.h>
+#include <linux/reboot.h>
 #include <linux/persistent_ram.h>
 #include <linux/rslib.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 struct persistent_ram_buffer {
 	uint32_t    sig;
@@ -36,6 +40,23 @@ struct persistent_ram_buffer {
 
 static __devinitdata LIST_HEAD(persistent_ram_list);
 
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_BUFFERED
+/*
+ * Zones are mapped write-combined and writers only mark the ECC blocks
+ * they touch.  Parity is brought up to date from a deferrable work
+ * every ecc_flush_ms, and from the panic and reboot notifiers.
+ */
+static unsigned int ecc_flush_ms = 200;
+module_param(ecc_flush_ms, uint, 0644);
+MODULE_PARM_DESC(ecc_flush_ms, "Interval between persistent ram ECC updates");
+
+static LIST_HEAD(persistent_ram_zones);
+static DEFINE_MUTEX(persistent_ram_zones_lock);
+
+static void persistent_ram_flush_work(struct work_struct *work);
+static DECLARE_DEFERRED_WORK(persistent_ram_flush, persistent_ram_flush_work);
+#endif
+
 static inline size_t buffer_size(struct persistent_ram_zone *prz)
 {
 	return atomic_read(&prz->buffer->size);
@@ -116,6 +137,20 @@ static void notrace persistent_ram_update_ecc(struct persistent_ram_zone *prz,
 	if (!prz->ecc)
 		return;
 
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_BUFFERED
+	if (prz->ecc_dirty) {
+		unsigned int i = start / ecc_block_size;
+		unsigned int last = (start + count - 1) / ecc_block_size;
+
+		/* The data must be in place before the flush can see the bit */
+		smp_wmb();
+		for (; i <= last; i++)
+			if (!test_bit(i, prz->ecc_dirty))
+				set_bit(i, prz->ecc_dirty);
+		return;
+	}
+#endif
+
 	block = buffer->data + (start & ~(ecc_block_size - 1));
 	par = prz->par_buffer + (start / ecc_block_size) * prz->ecc_size;
 
@@ -135,10 +170,123 @@ static void persistent_ram_update_header_ecc(struct persistent_ram_zone *prz)
 	if (!prz->ecc)
 		return;
 
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_BUFFERED
+	if (prz->ecc_dirty) {
+		smp_wmb();
+		if (!test_bit(prz->ecc_blocks, prz->ecc_dirty))
+			set_bit(prz->ecc_blocks, prz->ecc_dirty);
+		return;
+	}
+#endif
+
 	persistent_ram_encode_rs8(prz, (uint8_t *)buffer, sizeof(*buffer),
 				  prz->par_header);
 }
 
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_BUFFERED
+static void notrace persistent_ram_flush_ecc(struct persistent_ram_zone *prz)
+{
+	struct persistent_ram_buffer *buffer = prz->buffer;
+	uint8_t *block;
+	int size;
+	int i;
+
+	if (!prz->ecc_dirty)
+		return;
+
+	for_each_set_bit(i, prz->ecc_dirty, prz->ecc_blocks) {
+		/* Writers racing with the encode mark the block again */
+		if (!test_and_clear_bit(i, prz->ecc_dirty))
+			continue;
+		block = buffer->data + i * prz->ecc_block_size;
+		size = min_t(size_t, prz->ecc_block_size,
+			     prz->buffer_size - i * prz->ecc_block_size);
+		persistent_ram_encode_rs8(prz, block, size,
+					  prz->par_buffer + i * prz->ecc_size);
+	}
+	if (test_and_clear_bit(prz->ecc_blocks, prz->ecc_dirty))
+		persistent_ram_encode_rs8(prz, (uint8_t *)buffer,
+					  sizeof(*buffer), prz->par_header);
+	wmb();
+}
+
+static void persistent_ram_flush_all(void)
+{
+	struct persistent_ram_zone *prz;
+
+	list_for_each_entry(prz, &persistent_ram_zones, node)
+		persistent_ram_flush_ecc(prz);
+}
+
+static void persistent_ram_flush_work(struct work_struct *work)
+{
+	mutex_lock(&persistent_ram_zones_lock);
+	persistent_ram_flush_all();
+	mutex_unlock(&persistent_ram_zones_lock);
+
+	schedule_delayed_work(&persistent_ram_flush,
+			      msecs_to_jiffies(max(ecc_flush_ms, 10U)));
+}
+
+/* Other cpus are stopped by now, so the zone list is left unlocked */
+static int persistent_ram_panic(struct notifier_block *nb,
+				unsigned long event, void *unused)
+{
+	persistent_ram_flush_all();
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block persistent_ram_panic_nb = {
+	.notifier_call	= persistent_ram_panic,
+	.priority	= INT_MAX,
+};
+
+static int persistent_ram_reboot(struct notifier_block *nb,
+				 unsigned long event, void *unused)
+{
+	cancel_delayed_work_sync(&persistent_ram_flush);
+	mutex_lock(&persistent_ram_zones_lock);
+	persistent_ram_flush_all();
+	mutex_unlock(&persistent_ram_zones_lock);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block persistent_ram_reboot_nb = {
+	.notifier_call	= persistent_ram_reboot,
+};
+
+static int __devinit persistent_ram_buffered_init(
+		struct persistent_ram_zone *prz)
+{
+	static bool registered;
+
+	if (prz->ecc) {
+		prz->ecc_dirty = kzalloc(BITS_TO_LONGS(prz->ecc_blocks + 1) *
+					 sizeof(long), GFP_KERNEL);
+		if (!prz->ecc_dirty)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&persistent_ram_zones_lock);
+	list_add_tail(&prz->node, &persistent_ram_zones);
+	if (!registered) {
+		atomic_notifier_chain_register(&panic_notifier_list,
+					       &persistent_ram_panic_nb);
+		register_reboot_notifier(&persistent_ram_reboot_nb);
+		schedule_delayed_work(&persistent_ram_flush,
+				      msecs_to_jiffies(ecc_flush_ms));
+		registered = true;
+	}
+	mutex_unlock(&persistent_ram_zones_lock);
+	return 0;
+}
+#else
+static inline int persistent_ram_buffered_init(struct persistent_ram_zone *prz)
+{
+	return 0;
+}
+#endif
+
 static void persistent_ram_ecc_old(struct persistent_ram_zone *prz)
 {
 	struct persistent_ram_buffer *buffer = prz->buffer;
@@ -188,6 +336,7 @@ static int persistent_ram_init_ecc(struct persistent_ram_zone *prz,
 	ecc_blocks = DIV_ROUND_UP(prz->buffer_size - prz->ecc_size,
 				  prz->ecc_block_size + prz->ecc_size);
 	prz->buffer_size -= (ecc_blocks + 1) * prz->ecc_size;
+	prz->ecc_blocks = ecc_blocks;
 
 	if (prz->buffer_size > buffer_size) {
 		pr_err("persistent_ram: invalid size %zu, non-ecc datasize %zu\n",
@@ -325,7 +474,11 @@ static int persistent_ram_buffer_map(phys_addr_t start, phys_addr_t size,
 	page_start = start - offset_in_page(start);
 	page_count = DIV_ROUND_UP(size + offset_in_page(start), PAGE_SIZE);
 
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_BUFFERED
+	prot = pgprot_writecombine(PAGE_KERNEL);
+#else
 	prot = pgprot_noncached(PAGE_KERNEL);
+#endif
 
 	pages = kmalloc(sizeof(struct page *) * page_count, GFP_KERNEL);
 	if (!pages) {
@@ -421,6 +574,11 @@ struct persistent_ram_zone *__persistent_ram_init(struct device *dev, bool ecc)
 	prz->buffer->sig = PERSISTENT_RAM_SIG;
 	atomic_set(&prz->buffer->start, 0);
 	atomic_set(&prz->buffer->size, 0);
+	persistent_ram_update_header_ecc(prz);
+
+	ret = persistent_ram_buffered_init(prz);
+	if (ret)
+		goto err;
 
 	return prz;
 err:
@@ -469,7 +469,11 @@ static int ram_console_driver_probe(struct platform_device *pdev)
 	start = res->start;
 	printk(KERN_INFO "[K] ram_console: got buffer at %zx, size %zx\n",
 	       start, buffer_size);
+#ifdef CONFIG_ANDROID_PERSISTENT_RAM_BUFFERED
+	buffer = ioremap_wc(res->start, buffer_size);
+#else
 	buffer = ioremap(res->start, buffer_size);
+#endif
 	if (buffer == NULL) {
 		printk(KERN_ERR "[K] ram_console: failed to map memory\n");
 		return -ENOMEM;
@@ -5,7 +5,8 @@
  *
  * Qcache provides an in-kernel "host implementation" for transcendent memory
  * and, thus indirectly, for cleancache and frontswap.  Qcache includes a
- * page-accessible memory [1] interface, utilizing lzo1x compression:
+ * page-accessible memory [1] interface, utilizing LZ4 or LZO compression
+ * through the crypto API:
  * 1) "compression buddies" ("zbud") is used for ephemeral pages
  * Zbud allows pairs (and potentially,
  * in the future, more than a pair of) compressed pages to be closely linked
@@ -20,7 +21,7 @@
 #include <linux/cpu.h>
 #include <linux/highmem.h>
 #include <linux/list.h>
-#include <linux/lzo.h>
+#include <linux/crypto.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
@@ -28,6 +29,9 @@
 #include <linux/math64.h>
 #include <linux/bitmap.h>
 #include <linux/fmem.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "tmem.h"
 
 #if !defined(CONFIG_CLEANCACHE)
@@ -64,6 +68,33 @@ static unsigned long zcache_qc_freed;
 static unsigned long zcache_qc_used;
 static unsigned long zcache_qc_max_used;
 
+#define QCACHE_COMPRESSOR_DEFAULT "lz4"
+#define QCACHE_COMPRESSOR_FALLBACK "lzo"
+#define QCACHE_DSTMEM_ORDER 1
+
+static char *qcache_compressor = QCACHE_COMPRESSOR_DEFAULT;
+static DEFINE_PER_CPU(struct crypto_comp *, zcache_comp_tfm);
+static DEFINE_PER_CPU(unsigned char *, zcache_dstmem);
+
+/* Latencies of cleancache gets and of whole-cache evictions, in ns */
+struct qcache_lat {
+	unsigned long count;
+	u64 total_ns;
+	u64 max_ns;
+};
+static struct qcache_lat qcache_hit_lat, qcache_miss_lat, qcache_evict_lat;
+static unsigned long qcache_evict_pages;
+
+static void qcache_lat_add(struct qcache_lat *lat, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	lat->count++;
+	lat->total_ns += ns;
+	if (ns > lat->max_ns)
+		lat->max_ns = ns;
+}
+
 static struct zcache_client zcache_host;
 static struct zcache_client zcache_clients[MAX_CLIENTS];
 
@@ -400,7 +431,8 @@ static int zbud_decompress(struct page *page, struct zbud_hdr *zh)
 {
 	struct zbud_page *zbpg;
 	unsigned budnum = zbud_budnum(zh);
-	size_t out_len = PAGE_SIZE;
+	unsigned int out_len = PAGE_SIZE;
+	struct crypto_comp *tfm = __get_cpu_var(zcache_comp_tfm);
 	char *to_va, *from_va;
 	unsigned size;
 	int ret = 0;
@@ -416,8 +448,8 @@ static int zbud_decompress(struct page *page, struct zbud_hdr *zh)
 	to_va = kmap_atomic(page);
 	size = zh->size;
 	from_va = zbud_data(zh, size);
-	ret = lzo1x_decompress_safe(from_va, size, to_va, &out_len);
-	BUG_ON(ret != LZO_E_OK);
+	ret = crypto_comp_decompress(tfm, from_va, size, to_va, &out_len);
+	BUG_ON(ret);
 	BUG_ON(out_len != PAGE_SIZE);
 	kunmap_atomic(to_va);
 out:
@@ -688,27 +720,49 @@ static void zcache_obj_free(struct tmem_obj *obj, struct tmem_pool *pool)
 	kmem_cache_free(zcache_obj_cache, obj);
 }
 
+static bool zcache_evicting;
+
+/*
+ * fmem is being handed to ION, so everything goes.  The tmem trees still
+ * have to be torn down, but the zbud pages are not unlinked and released
+ * one at a time: once no tree points at them the bud lists and the fmem
+ * bitmap are reset in one go, which keeps the time ION waits short.
+ */
 static void zcache_flush_all_obj(void)
 {
+	struct qcache_info *qc = &qcache_info;
 	struct tmem_pool *pool;
-	int pool_id;
-	struct zcache_preload *kp;
-
-	kp = &__get_cpu_var(zcache_preloads);
+	unsigned long flags, pages;
+	ktime_t start = ktime_get();
+	int pool_id, cpu;
 
+	pages = atomic_read(&zcache_zbud_curr_zpages);
+	zcache_evicting = true;
 	for (pool_id = 0; pool_id < MAX_POOLS_PER_CLIENT; pool_id++) {
 		pool = zcache_get_pool_by_id(LOCAL_CLIENT, pool_id);
 		tmem_flush_pool(pool);
 		if (pool)
 			zcache_put_pool(pool);
 	}
-	if (kp->page) {
-		qcache_free(kp->page);
-		kp->page = NULL;
-	}
-	if (zcache_qc_used)
-		pr_warn("pages used not 0 after qcache flush all, is %ld\n",
-			zcache_qc_used);
+	zcache_evicting = false;
+
+	spin_lock(&zbud_budlists_spinlock);
+	zbud_init();
+	spin_unlock(&zbud_budlists_spinlock);
+	atomic_set(&zcache_zbud_curr_raw_pages, 0);
+	atomic_set(&zcache_zbud_curr_zpages, 0);
+	zcache_zbud_curr_zbytes = 0;
+
+	for_each_possible_cpu(cpu)
+		per_cpu(zcache_preloads, cpu).page = NULL;
+	spin_lock_irqsave(&qc->lock, flags);
+	bitmap_zero(qc->bitmap, qc->pages);
+	zcache_qc_freed += zcache_qc_used;
+	zcache_qc_used = 0;
+	spin_unlock_irqrestore(&qc->lock, flags);
+
+	qcache_evict_pages += pages;
+	qcache_lat_add(&qcache_evict_lat, start);
 }
 
 static bool zcache_freeze;
@@ -786,7 +840,8 @@ static int zcache_pampd_get_data_and_free(char *data, size_t *bufsize, bool raw,
 static void zcache_pampd_free(void *pampd, struct tmem_pool *pool,
 				struct tmem_oid *oid, uint32_t index)
 {
-	zbud_free_and_delist((struct zbud_hdr *)pampd);
+	if (!zcache_evicting)
+		zbud_free_and_delist((struct zbud_hdr *)pampd);
 	atomic_dec(&zcache_curr_eph_pampd_count);
 	BUG_ON(atomic_read(&zcache_curr_eph_pampd_count) < 0);
 }
@@ -821,32 +876,77 @@ static struct tmem_pamops zcache_pamops = {
 };
 
 
-#define LZO_WORKMEM_BYTES LZO1X_1_MEM_COMPRESS
-#define LZO_DSTMEM_PAGE_ORDER 1
-static DEFINE_PER_CPU(unsigned char *, zcache_workmem);
-static DEFINE_PER_CPU(unsigned char *, zcache_dstmem);
-
 static int zcache_compress(struct page *from, void **out_va, size_t *out_len)
 {
 	int ret = 0;
 	unsigned char *dmem = __get_cpu_var(zcache_dstmem);
-	unsigned char *wmem = __get_cpu_var(zcache_workmem);
+	struct crypto_comp *tfm = __get_cpu_var(zcache_comp_tfm);
+	unsigned int dlen = PAGE_SIZE << QCACHE_DSTMEM_ORDER;
 	char *from_va;
 
 	BUG_ON(!irqs_disabled());
-	if (unlikely(dmem == NULL || wmem == NULL))
-		goto out;  
+	if (unlikely(dmem == NULL || tfm == NULL))
+		goto out;
 	from_va = kmap_atomic(from);
 	mb();
-	ret = lzo1x_1_compress(from_va, PAGE_SIZE, dmem, out_len, wmem);
-	BUG_ON(ret != LZO_E_OK);
-	*out_va = dmem;
+	ret = crypto_comp_compress(tfm, from_va, PAGE_SIZE, dmem, &dlen);
 	kunmap_atomic(from_va);
+	if (ret) {
+		ret = 0;
+		goto out;
+	}
+	*out_va = dmem;
+	*out_len = dlen;
 	ret = 1;
 out:
 	return ret;
 }
 
+static void zcache_comp_free(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (per_cpu(zcache_comp_tfm, cpu))
+			crypto_free_comp(per_cpu(zcache_comp_tfm, cpu));
+		free_pages((unsigned long)per_cpu(zcache_dstmem, cpu),
+			   QCACHE_DSTMEM_ORDER);
+		per_cpu(zcache_comp_tfm, cpu) = NULL;
+		per_cpu(zcache_dstmem, cpu) = NULL;
+	}
+}
+
+/* Buffers for every possible cpu, as there is no hotplug notifier here */
+static int __init zcache_comp_init(void)
+{
+	struct crypto_comp *tfm;
+	unsigned int cpu;
+
+	if (!crypto_has_comp(qcache_compressor, 0, 0)) {
+		pr_info("qcache: %s is not available\n", qcache_compressor);
+		qcache_compressor = QCACHE_COMPRESSOR_FALLBACK;
+		if (!crypto_has_comp(qcache_compressor, 0, 0))
+			return -ENODEV;
+	}
+
+	for_each_possible_cpu(cpu) {
+		tfm = crypto_alloc_comp(qcache_compressor, 0, 0);
+		if (IS_ERR(tfm))
+			goto fail;
+		per_cpu(zcache_comp_tfm, cpu) = tfm;
+		per_cpu(zcache_dstmem, cpu) = (void *)__get_free_pages(
+			GFP_KERNEL | __GFP_REPEAT, QCACHE_DSTMEM_ORDER);
+		if (!per_cpu(zcache_dstmem, cpu))
+			goto fail;
+	}
+	pr_info("qcache: using %s compressor\n", qcache_compressor);
+	return 0;
+
+fail:
+	zcache_comp_free();
+	return -ENOMEM;
+}
+
 #ifdef CONFIG_SYSFS
 #define ZCACHE_SYSFS_RO(_name) \
 	static ssize_t zcache_##_name##_show(struct kobject *kobj, \
@@ -951,6 +1051,51 @@ static struct attribute_group qcache_attr_group = {
 
 #endif 
 
+#ifdef CONFIG_DEBUG_FS
+static void qcache_lat_show(struct seq_file *m, const char *name,
+				struct qcache_lat *lat)
+{
+	seq_printf(m, "%-6s %10lu avg %8llu ns max %8llu ns\n", name,
+		   lat->count,
+		   lat->count ? div64_u64(lat->total_ns, lat->count) : 0ULL,
+		   lat->max_ns);
+}
+
+static int qcache_stats_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "compressor %s\n", qcache_compressor);
+	qcache_lat_show(m, "hit", &qcache_hit_lat);
+	qcache_lat_show(m, "miss", &qcache_miss_lat);
+	qcache_lat_show(m, "evict", &qcache_evict_lat);
+	seq_printf(m, "evicted_pages %lu\n", qcache_evict_pages);
+	return 0;
+}
+
+static int qcache_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qcache_stats_show, NULL);
+}
+
+static const struct file_operations qcache_stats_fops = {
+	.open		= qcache_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init qcache_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("qcache", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+	debugfs_create_file("stats", S_IRUGO, dir, NULL, &qcache_stats_fops);
+}
+#else
+static inline void qcache_debugfs_init(void) { }
+#endif
+
 
 static int zcache_put_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 				uint32_t index, struct page *page)
@@ -989,6 +1134,7 @@ static int zcache_get_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 	int ret = -1;
 	unsigned long flags;
 	size_t size = PAGE_SIZE;
+	ktime_t start = ktime_get();
 
 	local_irq_save(flags);
 	pool = zcache_get_pool_by_id(cli_id, pool_id);
@@ -999,6 +1145,7 @@ static int zcache_get_page(int cli_id, int pool_id, struct tmem_oid *oidp,
 		zcache_put_pool(pool);
 	}
 	local_irq_restore(flags);
+	qcache_lat_add(ret == 0 ? &qcache_hit_lat : &qcache_miss_lat, start);
 	return ret;
 }
 
@@ -1210,7 +1357,6 @@ static int __init qcache_init(void)
 	struct qcache_info *qc = &qcache_info;
 	struct fmem_data *fdp;
 	int bitmap_size;
-	unsigned int cpu;
 	struct cleancache_ops old_ops;
 
 #ifdef CONFIG_SYSFS
@@ -1227,16 +1373,13 @@ static int __init qcache_init(void)
 	if (!qc->pages)
 		goto out;
 
+	ret = zcache_comp_init();
+	if (ret) {
+		pr_err("qcache: can't set up compressor\n");
+		goto out;
+	}
 	tmem_register_hostops(&zcache_hostops);
 	tmem_register_pamops(&zcache_pamops);
-	for_each_online_cpu(cpu) {
-		per_cpu(zcache_dstmem, cpu) = (void *)__get_free_pages(
-			GFP_KERNEL | __GFP_REPEAT,
-			LZO_DSTMEM_PAGE_ORDER),
-		per_cpu(zcache_workmem, cpu) =
-			kzalloc(LZO1X_MEM_COMPRESS,
-				GFP_KERNEL | __GFP_REPEAT);
-	}
 	zcache_objnode_cache = kmem_cache_create("zcache_objnode",
 				sizeof(struct tmem_objnode), 0, 0, NULL);
 	zcache_obj_cache = kmem_cache_create("zcache_obj",
@@ -1264,6 +1407,7 @@ static int __init qcache_init(void)
 		goto out;
 	}
 	spin_lock_init(&qc->lock);
+	qcache_debugfs_init();
 
 	fmem_set_state(FMEM_T_STATE);
 
@@ -1272,3 +1416,5 @@ out:
 }
 
 module_init(qcache_init)
+module_param_named(compressor, qcache_compressor, charp, 0444);
+MODULE_PARM_DESC(compressor, "crypto compressor for clean pages (lz4, lzo)");
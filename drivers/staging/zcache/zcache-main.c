@@ -32,6 +32,7 @@
 #include <linux/crypto.h>
 #include <linux/string.h>
 #include <linux/idr.h>
+#include <linux/workqueue.h>
 #include "tmem.h"
 
 #include "../zsmalloc/zsmalloc.h"
@@ -159,6 +160,7 @@ struct zbud_hdr {
 
 struct zbud_page {
 	struct list_head bud_list;
+	struct list_head lru;
 	spinlock_t lock;
 	struct zbud_hdr buddy[ZBUD_MAX_BUDS];
 	DECL_SENTINEL
@@ -183,7 +185,10 @@ static unsigned long zbud_cumul_chunk_counts[NCHUNKS];
 struct list_head zbud_buddied_list;
 static unsigned long zcache_zbud_buddied_count;
 
-/* protects the buddied list and all unbuddied lists */
+/* all listed zbpgs, oldest first; eviction works from the head */
+static LIST_HEAD(zbud_lru_list);
+
+/* protects the buddied list, all unbuddied lists and the lru list */
 static DEFINE_SPINLOCK(zbud_budlists_spinlock);
 
 static LIST_HEAD(zbpg_unused_list);
@@ -359,6 +364,7 @@ static void zbud_free_and_delist(struct zbud_hdr *zh)
 		chunks = zbud_size_to_chunks(size) ;
 		BUG_ON(list_empty(&zbud_unbuddied[chunks].list));
 		list_del_init(&zbpg->bud_list);
+		list_del_init(&zbpg->lru);
 		zbud_unbuddied[chunks].count--;
 		spin_unlock(&zbud_budlists_spinlock);
 		zbud_free_raw_page(zbpg);
@@ -406,6 +412,7 @@ static struct zbud_hdr *zbud_create(uint16_t client_id, uint16_t pool_id,
 	spin_lock(&zbud_budlists_spinlock);
 	spin_lock(&zbpg->lock);
 	list_add_tail(&zbpg->bud_list, &zbud_unbuddied[nchunks].list);
+	list_add_tail(&zbpg->lru, &zbud_lru_list);
 	zbud_unbuddied[nchunks].count++;
 	zh = &zbpg->buddy[0];
 	goto init_zh;
@@ -530,6 +537,28 @@ static void zbud_evict_zbpg(struct zbud_page *zbpg)
 	zbud_free_raw_page(zbpg);
 }
 
+/*
+ * Take a locked zbpg off the lru and bud lists for eviction.  Caller holds
+ * zbud_budlists_spinlock.
+ */
+static void zbud_unlist(struct zbud_page *zbpg)
+{
+	struct zbud_hdr *zh0 = &zbpg->buddy[0], *zh1 = &zbpg->buddy[1];
+	unsigned chunks;
+
+	ASSERT_SPINLOCK(&zbpg->lock);
+	if (zh0->size != 0 && zh1->size != 0) {
+		zcache_zbud_buddied_count--;
+		zcache_evicted_buddied_pages++;
+	} else {
+		chunks = zbud_size_to_chunks(zh0->size ? zh0->size : zh1->size);
+		zbud_unbuddied[chunks].count--;
+		zcache_evicted_unbuddied_pages++;
+	}
+	list_del_init(&zbpg->bud_list);
+	list_del_init(&zbpg->lru);
+}
+
 /*
  * Free nr pages.  This code is funky because we want to hold the locks
  * protecting various lists for as short a time as possible, and in some
@@ -541,7 +570,6 @@ static void zbud_evict_zbpg(struct zbud_page *zbpg)
 static void zbud_evict_pages(int nr)
 {
 	struct zbud_page *zbpg;
-	int i;
 
 	/* first try freeing any pages on unused list */
 retry_unused_list:
@@ -562,57 +590,87 @@ retry_unused_list:
 	}
 	spin_unlock_bh(&zbpg_unused_list_spinlock);
 
-	/* now try freeing unbuddied pages, starting with least space avail */
-	for (i = 0; i < MAX_CHUNK; i++) {
-retry_unbud_list_i:
-		spin_lock_bh(&zbud_budlists_spinlock);
-		if (list_empty(&zbud_unbuddied[i].list)) {
-			spin_unlock_bh(&zbud_budlists_spinlock);
-			continue;
-		}
-		list_for_each_entry(zbpg, &zbud_unbuddied[i].list, bud_list) {
-			if (unlikely(!spin_trylock(&zbpg->lock)))
-				continue;
-			list_del_init(&zbpg->bud_list);
-			zbud_unbuddied[i].count--;
-			spin_unlock(&zbud_budlists_spinlock);
-			zcache_evicted_unbuddied_pages++;
-			/* want budlists unlocked when doing zbpg eviction */
-			zbud_evict_zbpg(zbpg);
-			local_bh_enable();
-			if (--nr <= 0)
-				goto out;
-			goto retry_unbud_list_i;
-		}
-		spin_unlock_bh(&zbud_budlists_spinlock);
-	}
-
-	/* as a last resort, free buddied pages */
-retry_bud_list:
+	/* then the oldest pages, buddied or not */
+retry_lru:
 	spin_lock_bh(&zbud_budlists_spinlock);
-	if (list_empty(&zbud_buddied_list)) {
-		spin_unlock_bh(&zbud_budlists_spinlock);
-		goto out;
-	}
-	list_for_each_entry(zbpg, &zbud_buddied_list, bud_list) {
+	list_for_each_entry(zbpg, &zbud_lru_list, lru) {
 		if (unlikely(!spin_trylock(&zbpg->lock)))
 			continue;
-		list_del_init(&zbpg->bud_list);
-		zcache_zbud_buddied_count--;
+		zbud_unlist(zbpg);
 		spin_unlock(&zbud_budlists_spinlock);
-		zcache_evicted_buddied_pages++;
 		/* want budlists unlocked when doing zbpg eviction */
 		zbud_evict_zbpg(zbpg);
 		local_bh_enable();
 		if (--nr <= 0)
 			goto out;
-		goto retry_bud_list;
+		goto retry_lru;
 	}
 	spin_unlock_bh(&zbud_budlists_spinlock);
 out:
 	return;
 }
 
+/*
+ * Shared budget.  zbud (cleancache) and zsmalloc (frontswap) pages together
+ * may not exceed zcache_max_pool_percent of totalram.  A put that would go
+ * over is refused and the oldest zbud pages are evicted in the background;
+ * frontswap pages can't be dropped, so they only ever displace clean ones.
+ */
+static unsigned int zcache_max_pool_percent = 25;
+static unsigned long zcache_budget_evicted;
+static unsigned long zcache_budget_rejected;
+
+static unsigned long zcache_pool_pages(void)
+{
+	unsigned long pages = atomic_read(&zcache_zbud_curr_raw_pages);
+
+	if (zcache_host.zspool)
+		pages += zs_get_total_size_bytes(zcache_host.zspool) >>
+			 PAGE_SHIFT;
+	return pages;
+}
+
+static unsigned long zcache_pool_budget(void)
+{
+	return totalram_pages * zcache_max_pool_percent / 100;
+}
+
+static void zcache_budget_work_fn(struct work_struct *work)
+{
+	unsigned long budget = zcache_pool_budget();
+	unsigned long target = budget - budget / 32;
+	unsigned long pages, raw, events;
+
+	while ((pages = zcache_pool_pages()) > target) {
+		raw = atomic_read(&zcache_zbud_curr_raw_pages);
+		if (!raw)
+			break;
+		events = zcache_evicted_raw_pages +
+			 zcache_evicted_unbuddied_pages +
+			 zcache_evicted_buddied_pages;
+		/* evicted zbpgs go to the unused list, freed next round */
+		zbud_evict_pages(min(pages - target, 32UL));
+		zcache_budget_evicted +=
+			raw - atomic_read(&zcache_zbud_curr_raw_pages);
+		if (events == zcache_evicted_raw_pages +
+			      zcache_evicted_unbuddied_pages +
+			      zcache_evicted_buddied_pages)
+			break;
+		cond_resched();
+	}
+}
+static DECLARE_WORK(zcache_budget_work, zcache_budget_work_fn);
+
+/* Called with irqs off from the put path */
+static bool zcache_over_budget(void)
+{
+	if (likely(zcache_pool_pages() < zcache_pool_budget()))
+		return false;
+	zcache_budget_rejected++;
+	schedule_work(&zcache_budget_work);
+	return true;
+}
+
 static void __init zbud_init(void)
 {
 	int i;
@@ -904,6 +962,41 @@ static ssize_t zv_page_count_policy_percent_store(struct kobject *kobj,
 	return count;
 }
 
+/*
+ * Percentage of totalram that zbud and zsmalloc pages may use together,
+ * see zcache_over_budget().
+ */
+static ssize_t zcache_max_pool_percent_show(struct kobject *kobj,
+					    struct kobj_attribute *attr,
+					    char *buf)
+{
+	return sprintf(buf, "%u\n", zcache_max_pool_percent);
+}
+
+static ssize_t zcache_max_pool_percent_store(struct kobject *kobj,
+					     struct kobj_attribute *attr,
+					     const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	err = kstrtoul(buf, 10, &val);
+	if (err || (val == 0) || (val > 100))
+		return -EINVAL;
+	zcache_max_pool_percent = val;
+	schedule_work(&zcache_budget_work);
+	return count;
+}
+
+static struct kobj_attribute zcache_max_pool_percent_attr = {
+		.attr = { .name = "max_pool_percent", .mode = 0644 },
+		.show = zcache_max_pool_percent_show,
+		.store = zcache_max_pool_percent_store,
+};
+
 static struct kobj_attribute zcache_zv_max_zsize_attr = {
 		.attr = { .name = "zv_max_zsize", .mode = 0644 },
 		.show = zv_max_zsize_show,
@@ -1179,6 +1272,8 @@ static void *zcache_pampd_create(char *data, size_t size, bool raw, int eph,
 	unsigned long curr_pers_pampd_count;
 	u64 total_zsize;
 
+	if (zcache_over_budget())
+		goto out;
 	if (eph) {
 		ret = zcache_compress(page, &cdata, &clen);
 		if (ret == 0)
@@ -1441,6 +1536,25 @@ static struct notifier_block zcache_cpu_notifier_block = {
 		.show = zcache_##_name##_show, \
 	}
 
+/* Both tiers side by side, in pages */
+static int zcache_tiers_show(char *buf)
+{
+	u64 zs_pages = 0;
+
+	if (zcache_host.zspool)
+		zs_pages = zs_get_total_size_bytes(zcache_host.zspool) >>
+			   PAGE_SHIFT;
+	return sprintf(buf,
+		"anon stored %d pool %llu\n"
+		"file stored %d pool %d\n"
+		"total pool %lu budget %lu rejected %lu evicted %lu\n",
+		atomic_read(&zcache_curr_pers_pampd_count), zs_pages,
+		atomic_read(&zcache_curr_eph_pampd_count),
+		atomic_read(&zcache_zbud_curr_raw_pages),
+		zcache_pool_pages(), zcache_pool_budget(),
+		zcache_budget_rejected, zcache_budget_evicted);
+}
+
 ZCACHE_SYSFS_RO(curr_obj_count_max);
 ZCACHE_SYSFS_RO(curr_objnode_count_max);
 ZCACHE_SYSFS_RO(flush_total);
@@ -1474,6 +1588,7 @@ ZCACHE_SYSFS_RO_CUSTOM(zv_curr_dist_counts,
 			zv_curr_dist_counts_show);
 ZCACHE_SYSFS_RO_CUSTOM(zv_cumul_dist_counts,
 			zv_cumul_dist_counts_show);
+ZCACHE_SYSFS_RO_CUSTOM(tiers, zcache_tiers_show);
 
 static struct attribute *zcache_attrs[] = {
 	&zcache_curr_obj_count_attr.attr,
@@ -1508,6 +1623,8 @@ static struct attribute *zcache_attrs[] = {
 	&zcache_zv_max_zsize_attr.attr,
 	&zcache_zv_max_mean_zsize_attr.attr,
 	&zcache_zv_page_count_policy_percent_attr.attr,
+	&zcache_max_pool_percent_attr.attr,
+	&zcache_tiers_attr.attr,
 	NULL,
 };
 
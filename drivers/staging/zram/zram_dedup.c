@@ -0,0 +1,241 @@
+/*
+ * Compressed RAM block device - deduplication of compressed pages
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#include <linux/jhash.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zram_drv.h"
+
+/*
+ * Every compressed object that is stored goes into the index, keyed by a
+ * hash of its compressed data.  When a page compresses to exactly the same
+ * data as an object that is already stored the table entry simply points
+ * to the existing handle and the object's reference count goes up.  The
+ * object is freed when the last table entry that points to it goes away.
+ * A second tree keyed by handle finds the entry again on free.
+ */
+
+struct zram_dedup_entry {
+	struct rb_node checksum_node;
+	struct rb_node handle_node;
+	unsigned long handle;
+	u32 checksum;
+	unsigned int len;
+	unsigned int refcount;
+};
+
+u32 zram_dedup_checksum(const void *src, unsigned int len)
+{
+	return jhash(src, len, 0);
+}
+
+static bool zram_dedup_match(struct zram *zram,
+			     struct zram_dedup_entry *entry,
+			     const void *src, unsigned int len)
+{
+	unsigned char *cmem;
+	bool match;
+
+	if (entry->len != len)
+		return false;
+
+	cmem = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+	match = !memcmp(cmem, src, len);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return match;
+}
+
+/**
+ * zram_dedup_get - Look for a stored object with the same contents
+ * @zram: the device
+ * @src: compressed data of the page being written
+ * @len: length of the compressed data
+ * @checksum: zram_dedup_checksum() of the data
+ *
+ * Returns the handle of the matching object with a reference taken for the
+ * caller, or 0 if there is no match.
+ */
+unsigned long zram_dedup_get(struct zram *zram, const void *src,
+			     unsigned int len, u32 checksum)
+{
+	struct zram_dedup *dedup = &zram->dedup;
+	struct rb_node *node;
+	unsigned long handle = 0;
+
+	spin_lock(&dedup->lock);
+	node = dedup->by_checksum.rb_node;
+	while (node) {
+		struct zram_dedup_entry *entry = rb_entry(node,
+				struct zram_dedup_entry, checksum_node);
+
+		if (checksum < entry->checksum) {
+			node = node->rb_left;
+		} else if (checksum > entry->checksum) {
+			node = node->rb_right;
+		} else {
+			struct rb_node *prev;
+
+			/* Equal checksums are kept together, go to the first */
+			while ((prev = rb_prev(node)) &&
+			       rb_entry(prev, struct zram_dedup_entry,
+					checksum_node)->checksum == checksum)
+				node = prev;
+
+			for (; node; node = rb_next(node)) {
+				entry = rb_entry(node, struct zram_dedup_entry,
+						 checksum_node);
+				if (entry->checksum != checksum)
+					break;
+				if (zram_dedup_match(zram, entry, src, len)) {
+					entry->refcount++;
+					handle = entry->handle;
+					break;
+				}
+			}
+			break;
+		}
+	}
+	spin_unlock(&dedup->lock);
+
+	return handle;
+}
+
+/**
+ * zram_dedup_insert - Add a newly stored object to the index
+ * @zram: the device
+ * @handle: zsmalloc handle of the object
+ * @len: length of the compressed data
+ * @checksum: zram_dedup_checksum() of the data
+ *
+ * Returns true if the object was added.  Objects that are not in the index
+ * are freed directly and are never shared.
+ */
+bool zram_dedup_insert(struct zram *zram, unsigned long handle,
+		       unsigned int len, u32 checksum)
+{
+	struct zram_dedup *dedup = &zram->dedup;
+	struct zram_dedup_entry *entry, *e;
+	struct rb_node **p, *parent;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return false;
+
+	entry->handle = handle;
+	entry->checksum = checksum;
+	entry->len = len;
+	entry->refcount = 1;
+
+	spin_lock(&dedup->lock);
+
+	p = &dedup->by_checksum.rb_node;
+	parent = NULL;
+	while (*p) {
+		parent = *p;
+		e = rb_entry(parent, struct zram_dedup_entry, checksum_node);
+		if (checksum < e->checksum)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&entry->checksum_node, parent, p);
+	rb_insert_color(&entry->checksum_node, &dedup->by_checksum);
+
+	p = &dedup->by_handle.rb_node;
+	parent = NULL;
+	while (*p) {
+		parent = *p;
+		e = rb_entry(parent, struct zram_dedup_entry, handle_node);
+		if (handle < e->handle)
+			p = &parent->rb_left;
+		else
+			p = &parent->rb_right;
+	}
+	rb_link_node(&entry->handle_node, parent, p);
+	rb_insert_color(&entry->handle_node, &dedup->by_handle);
+
+	spin_unlock(&dedup->lock);
+
+	return true;
+}
+
+/**
+ * zram_dedup_put - Drop a reference to an object in the index
+ * @zram: the device
+ * @handle: zsmalloc handle of the object
+ *
+ * Returns true if that was the last reference, the caller must then free
+ * the object.
+ */
+bool zram_dedup_put(struct zram *zram, unsigned long handle)
+{
+	struct zram_dedup *dedup = &zram->dedup;
+	struct zram_dedup_entry *entry = NULL;
+	struct rb_node *node;
+	bool last = false;
+
+	spin_lock(&dedup->lock);
+	node = dedup->by_handle.rb_node;
+	while (node) {
+		entry = rb_entry(node, struct zram_dedup_entry, handle_node);
+		if (handle < entry->handle)
+			node = node->rb_left;
+		else if (handle > entry->handle)
+			node = node->rb_right;
+		else
+			break;
+	}
+
+	if (WARN_ON(!node)) {
+		spin_unlock(&dedup->lock);
+		return true;
+	}
+
+	if (--entry->refcount == 0) {
+		rb_erase(&entry->checksum_node, &dedup->by_checksum);
+		rb_erase(&entry->handle_node, &dedup->by_handle);
+		last = true;
+	}
+	spin_unlock(&dedup->lock);
+
+	if (last)
+		kfree(entry);
+
+	return last;
+}
+
+void zram_dedup_init(struct zram *zram)
+{
+	spin_lock_init(&zram->dedup.lock);
+	zram->dedup.by_checksum = RB_ROOT;
+	zram->dedup.by_handle = RB_ROOT;
+}
+
+/* Free every indexed object, the device must be idle */
+void zram_dedup_destroy(struct zram *zram)
+{
+	struct zram_dedup *dedup = &zram->dedup;
+	struct rb_node *node;
+
+	while ((node = rb_first(&dedup->by_handle))) {
+		struct zram_dedup_entry *entry = rb_entry(node,
+				struct zram_dedup_entry, handle_node);
+
+		rb_erase(&entry->handle_node, &dedup->by_handle);
+		zs_free(zram->mem_pool, entry->handle);
+		kfree(entry);
+	}
+	dedup->by_checksum = RB_ROOT;
+}
@@ -0,0 +1,78 @@
+/*
+ * Compressed RAM block device - deduplication of compressed pages
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+
+struct zram;
+
+#ifdef CONFIG_ZRAM_DEDUP
+
+/* Index of the compressed objects of a device, by content and by handle */
+struct zram_dedup {
+	spinlock_t lock;
+	struct rb_root by_checksum;
+	struct rb_root by_handle;
+};
+
+u32 zram_dedup_checksum(const void *src, unsigned int len);
+unsigned long zram_dedup_get(struct zram *zram, const void *src,
+			     unsigned int len, u32 checksum);
+bool zram_dedup_insert(struct zram *zram, unsigned long handle,
+		       unsigned int len, u32 checksum);
+bool zram_dedup_put(struct zram *zram, unsigned long handle);
+void zram_dedup_init(struct zram *zram);
+void zram_dedup_destroy(struct zram *zram);
+
+#else
+
+struct zram_dedup {
+};
+
+static inline u32 zram_dedup_checksum(const void *src, unsigned int len)
+{
+	return 0;
+}
+
+static inline unsigned long zram_dedup_get(struct zram *zram,
+					   const void *src, unsigned int len,
+					   u32 checksum)
+{
+	return 0;
+}
+
+static inline bool zram_dedup_insert(struct zram *zram, unsigned long handle,
+				     unsigned int len, u32 checksum)
+{
+	return false;
+}
+
+static inline bool zram_dedup_put(struct zram *zram, unsigned long handle)
+{
+	return true;
+}
+
+static inline void zram_dedup_init(struct zram *zram)
+{
+}
+
+static inline void zram_dedup_destroy(struct zram *zram)
+{
+}
+
+#endif /* CONFIG_ZRAM_DEDUP */
+
+#endif
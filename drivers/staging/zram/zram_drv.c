@@ -23,16 +23,23 @@
 #include <linux/kernel.h>
 #include <linux/bio.h>
 #include <linux/bitops.h>
+#include <linux/bit_spinlock.h>
 #include <linux/blkdev.h>
 #include <linux/buffer_head.h>
+#include <linux/completion.h>
 #include <linux/device.h>
+#include <linux/file.h>
+#include <linux/fs.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
+#include <linux/lockstat_lite.h>
 #include <linux/slab.h>
 #include <linux/crypto.h>
 #include <linux/cpu.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
 
@@ -45,14 +52,14 @@ struct zram *zram_devices;
 /* Module params (documentation at end) */
 static unsigned int num_devices = 1;
 
-static void zram_stat_inc(u32 *v)
+static void zram_stat_inc(atomic_t *v)
 {
-	*v = *v + 1;
+	atomic_inc(v);
 }
 
-static void zram_stat_dec(u32 *v)
+static void zram_stat_dec(atomic_t *v)
 {
-	*v = *v - 1;
+	atomic_dec(v);
 }
 
 /* Cryptographic API features */
@@ -216,6 +223,161 @@ out:
 }
 /* end of Cryptographic API features */
 
+/*
+ * Compression streams.  Writers used to serialize on a single compression
+ * buffer; now every device has a set of streams, each with its own tfm and
+ * output buffer, so that up to max_comp_streams pages can be compressed at
+ * the same time.  A stream is held while the compressed object is being
+ * allocated, which can sleep, so they can't simply be per-cpu.  Streams are
+ * only allocated from process context (init and sysfs), never in the I/O
+ * path.
+ */
+static void zram_comp_strm_free(struct zram_comp_strm *strm)
+{
+	if (strm->tfm)
+		crypto_free_comp(strm->tfm);
+	free_pages((unsigned long)strm->buffer, 1);
+	kfree(strm);
+}
+
+static struct zram_comp_strm *zram_comp_strm_alloc(void)
+{
+	struct zram_comp_strm *strm;
+
+	strm = kzalloc(sizeof(*strm), GFP_KERNEL);
+	if (!strm)
+		return NULL;
+
+	strm->tfm = crypto_alloc_comp(zram_compressor, 0, 0);
+	if (IS_ERR(strm->tfm)) {
+		strm->tfm = NULL;
+		goto fail;
+	}
+
+	/* Compressed data can be larger than a page for bad input */
+	strm->buffer = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
+	if (!strm->buffer)
+		goto fail;
+
+	return strm;
+
+fail:
+	zram_comp_strm_free(strm);
+	return NULL;
+}
+
+/* Wait for an idle stream and take it */
+static struct zram_comp_strm *zram_comp_strm_find(struct zram_comp *comp)
+{
+	struct zram_comp_strm *strm;
+	u64 start = 0;
+
+	lsl_acquired(LSL_ZRAM_COMP);
+	spin_lock(&comp->lock);
+	while (list_empty(&comp->idle)) {
+		if (!start)
+			start = lsl_wait_start();
+		spin_unlock(&comp->lock);
+		wait_event(comp->wait, !list_empty(&comp->idle));
+		spin_lock(&comp->lock);
+	}
+	strm = list_first_entry(&comp->idle, struct zram_comp_strm, list);
+	list_del(&strm->list);
+	spin_unlock(&comp->lock);
+
+	if (start)
+		lsl_contended(LSL_ZRAM_COMP, start);
+
+	return strm;
+}
+
+/* Give a stream back, or free it if there are more than comp->max */
+static void zram_comp_strm_release(struct zram_comp *comp,
+				   struct zram_comp_strm *strm)
+{
+	spin_lock(&comp->lock);
+	if (comp->avail <= comp->max) {
+		list_add(&strm->list, &comp->idle);
+		spin_unlock(&comp->lock);
+		wake_up(&comp->wait);
+		return;
+	}
+	comp->avail--;
+	spin_unlock(&comp->lock);
+
+	zram_comp_strm_free(strm);
+}
+
+/*
+ * Grow or shrink the set of streams to num.  Streams that are in use when
+ * shrinking are freed as they are released.  Returns 0 or -ENOMEM if not
+ * a single stream could be added; in that case the old streams are kept.
+ */
+int zram_comp_set_max_streams(struct zram_comp *comp, int num)
+{
+	struct zram_comp_strm *strm;
+	int added = 0;
+
+	spin_lock(&comp->lock);
+	comp->max = num;
+	while (comp->avail > comp->max && !list_empty(&comp->idle)) {
+		strm = list_first_entry(&comp->idle, struct zram_comp_strm,
+					list);
+		list_del(&strm->list);
+		comp->avail--;
+		spin_unlock(&comp->lock);
+		zram_comp_strm_free(strm);
+		spin_lock(&comp->lock);
+	}
+
+	while (comp->avail < comp->max) {
+		spin_unlock(&comp->lock);
+		strm = zram_comp_strm_alloc();
+		spin_lock(&comp->lock);
+		if (!strm)
+			break;
+		list_add(&strm->list, &comp->idle);
+		comp->avail++;
+		added++;
+	}
+
+	/* Run with what we have, as long as there is at least one */
+	if (comp->avail < comp->max)
+		comp->max = max(comp->avail, 1);
+	spin_unlock(&comp->lock);
+
+	if (added)
+		wake_up_all(&comp->wait);
+
+	return comp->avail ? 0 : -ENOMEM;
+}
+
+static int zram_comp_init_streams(struct zram_comp *comp, int num)
+{
+	spin_lock_init(&comp->lock);
+	INIT_LIST_HEAD(&comp->idle);
+	init_waitqueue_head(&comp->wait);
+	comp->avail = 0;
+	comp->max = 0;
+
+	return zram_comp_set_max_streams(comp, num);
+}
+
+/* All streams must be idle */
+static void zram_comp_destroy_streams(struct zram_comp *comp)
+{
+	struct zram_comp_strm *strm;
+
+	while (!list_empty(&comp->idle)) {
+		strm = list_first_entry(&comp->idle, struct zram_comp_strm,
+					list);
+		list_del(&strm->list);
+		zram_comp_strm_free(strm);
+	}
+	comp->avail = 0;
+	comp->max = 0;
+}
+
 static void zram_stat64_add(struct zram *zram, u64 *v, u64 inc)
 {
 	spin_lock(&zram->stat64_lock);
@@ -235,43 +397,403 @@ static void zram_stat64_inc(struct zram *zram, u64 *v)
 	zram_stat64_add(zram, v, 1);
 }
 
+/*
+ * Table entries are locked individually so that I/O to different pages
+ * doesn't serialize.  The lock is a bit spinlock in the entry itself, the
+ * size and the other flags share the word and must only be changed with
+ * the lock held.
+ */
+static void zram_lock_slot(struct zram *zram, u32 index)
+{
+	lsl_bit_spin_lock(ZRAM_ACCESS, &zram->table[index].value,
+			  LSL_ZRAM_SLOT);
+}
+
+static void zram_unlock_slot(struct zram *zram, u32 index)
+{
+	bit_spin_unlock(ZRAM_ACCESS, &zram->table[index].value);
+}
+
 static int zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
-	return zram->table[index].flags & BIT(flag);
+	return zram->table[index].value & BIT(flag);
 }
 
 static void zram_set_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
-	zram->table[index].flags |= BIT(flag);
+	zram->table[index].value |= BIT(flag);
 }
 
 static void zram_clear_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
 {
-	zram->table[index].flags &= ~BIT(flag);
+	zram->table[index].value &= ~BIT(flag);
+}
+
+static size_t zram_get_obj_size(struct zram *zram, u32 index)
+{
+	return zram->table[index].value & (BIT(ZRAM_FLAG_SHIFT) - 1);
 }
 
-static int page_zero_filled(void *ptr)
+static void zram_set_obj_size(struct zram *zram, u32 index, size_t size)
+{
+	unsigned long flags = zram->table[index].value >> ZRAM_FLAG_SHIFT;
+
+	zram->table[index].value = (flags << ZRAM_FLAG_SHIFT) | size;
+}
+
+/* Check if the page is one word repeated, and return that word */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
+static void zram_fill_page(void *ptr, unsigned int len, unsigned long value)
+{
+	unsigned long *page = ptr;
+	unsigned int pos;
+
+	if (!value) {
+		memset(ptr, 0, len);
+		return;
+	}
+
+	for (pos = 0; pos != len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/*
+ * Writeback.  Pages that are idle or that don't compress can be moved to a
+ * backing block device to free their memory.  A page that has been written
+ * back keeps the index of its block on the device in the table handle.
+ * Block 0 is never used so that a handle of 0 still means "no data".
+ */
+#define ZRAM_BDEV_MODE	(FMODE_READ | FMODE_WRITE | FMODE_EXCL)
+
+static unsigned long zram_alloc_block(struct zram *zram)
+{
+	unsigned long blk = 1;
+
+	do {
+		blk = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk);
+		if (blk >= zram->nr_pages)
+			return 0;
+	} while (test_and_set_bit(blk, zram->bitmap));
+
+	zram_stat_inc(&zram->stats.bd_count);
+	return blk;
+}
+
+static void zram_free_block(struct zram *zram, unsigned long blk)
+{
+	WARN_ON_ONCE(!test_and_clear_bit(blk, zram->bitmap));
+	zram_stat_dec(&zram->stats.bd_count);
+}
+
+struct zram_bio_wait {
+	struct completion done;
+	int error;
+};
+
+static void zram_bdev_end_io_sync(struct bio *bio, int err)
+{
+	struct zram_bio_wait *wait = bio->bi_private;
+
+	wait->error = err;
+	complete(&wait->done);
+}
+
+/*
+ * Synchronous I/O of one page to the backing device.  Must not be called
+ * from the make_request path, the bio would only be submitted once that
+ * returns, see zram_read_from_bdev().
+ */
+static int zram_bdev_rw_page(struct zram *zram, struct page *page,
+			     unsigned long blk, int rw)
+{
+	struct zram_bio_wait wait;
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	init_completion(&wait.done);
+	wait.error = 0;
+	bio->bi_end_io = zram_bdev_end_io_sync;
+	bio->bi_private = &wait;
+
+	submit_bio(rw | REQ_SYNC, bio);
+	wait_for_completion(&wait.done);
+
+	ret = wait.error;
+	if (!ret && !test_bit(BIO_UPTODATE, &bio->bi_flags))
+		ret = -EIO;
+	bio_put(bio);
+
+	return ret;
+}
+
+struct zram_read_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct page *page;
+	unsigned long blk;
+	int error;
+};
+
+static void zram_read_work_fn(struct work_struct *work)
+{
+	struct zram_read_work *rw = container_of(work, struct zram_read_work,
+						 work);
+
+	rw->error = zram_bdev_rw_page(rw->zram, rw->page, rw->blk, READ);
+}
+
+/*
+ * Read a page that has been written back into mem.  Used for partial I/O
+ * and for pages that get written back while being read.  The read is done
+ * from a worker since a bio submitted by a make_request function is only
+ * started after it returns.
+ */
+static int zram_read_from_bdev(struct zram *zram, char *mem,
+			       unsigned long blk)
+{
+	struct zram_read_work rw;
+	void *src;
+
+	rw.page = alloc_page(GFP_NOIO);
+	if (!rw.page)
+		return -ENOMEM;
+
+	rw.zram = zram;
+	rw.blk = blk;
+	INIT_WORK_ONSTACK(&rw.work, zram_read_work_fn);
+	queue_work(system_unbound_wq, &rw.work);
+	flush_work(&rw.work);
+	destroy_work_on_stack(&rw.work);
+
+	if (!rw.error) {
+		src = kmap(rw.page);
+		memcpy(mem, src, PAGE_SIZE);
+		kunmap(rw.page);
+		zram_stat64_inc(zram, &zram->stats.bd_reads);
+	} else {
+		pr_err("Backing device read failed! err=%d, block=%lu\n",
+		       rw.error, blk);
+		zram_stat64_inc(zram, &zram->stats.failed_reads);
+	}
+	__free_page(rw.page);
+
+	return rw.error;
+}
+
+static void zram_bdev_read_end_io(struct bio *bio, int err)
+{
+	struct bio *parent = bio->bi_private;
+
+	if (err || !test_bit(BIO_UPTODATE, &bio->bi_flags)) {
+		bio_io_error(parent);
+	} else {
+		set_bit(BIO_UPTODATE, &parent->bi_flags);
+		bio_endio(parent, 0);
+	}
+	bio_put(bio);
+}
+
+/*
+ * Swap reads are single pages.  If such a page has been written back, hand
+ * the page to the backing device and complete the request from there so
+ * that nothing waits for the I/O in zram.  Returns true if the bio was
+ * taken over.
+ */
+static bool zram_read_bdev_async(struct zram *zram, struct bio *bio,
+				 u32 index, int offset)
+{
+	struct bio_vec *bvec = bio_iovec(bio);
+	struct bio *rbio;
+	unsigned long blk;
+
+	if (!zram->bdev || offset || bio_segments(bio) != 1 ||
+	    bvec->bv_len != PAGE_SIZE)
+		return false;
+
+	zram_lock_slot(zram, index);
+	if (!zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_unlock_slot(zram, index);
+		return false;
+	}
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	blk = zram->table[index].handle;
+	zram_unlock_slot(zram, index);
+
+	rbio = bio_alloc(GFP_NOIO, 1);
+	rbio->bi_bdev = zram->bdev;
+	rbio->bi_sector = blk << SECTORS_PER_PAGE_SHIFT;
+	if (!bio_add_page(rbio, bvec->bv_page, PAGE_SIZE, bvec->bv_offset)) {
+		bio_put(rbio);
+		return false;
+	}
+	rbio->bi_end_io = zram_bdev_read_end_io;
+	rbio->bi_private = bio;
+
+	submit_bio(READ, rbio);
+	zram_stat64_inc(zram, &zram->stats.bd_reads);
+
+	return true;
+}
+
+static void zram_reset_bdev(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	set_blocksize(zram->bdev, zram->old_block_size);
+	blkdev_put(zram->bdev, ZRAM_BDEV_MODE);
+	filp_close(zram->backing_dev, NULL);
+	vfree(zram->bitmap);
+
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+/**
+ * zram_set_backing_dev - Set up the device that pages are written back to
+ * @zram: the device, must not be initialized yet
+ * @file_name: path of a block device (a file has to go through loop)
+ *
+ * Replaces the current backing device, if any.  zram->init_lock must be
+ * held for writing.
+ */
+int zram_set_backing_dev(struct zram *zram, const char *file_name)
+{
+	struct file *backing_dev;
+	struct block_device *bdev;
+	struct inode *inode;
+	unsigned long nr_pages, *bitmap;
+	int ret;
+
+	zram_reset_bdev(zram);
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev))
+		return PTR_ERR(backing_dev);
+
+	inode = backing_dev->f_mapping->host;
+	if (!S_ISBLK(inode->i_mode)) {
+		ret = -ENOTBLK;
+		goto out_close;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	ret = blkdev_get(bdev, ZRAM_BDEV_MODE, zram);
+	if (ret < 0)
+		goto out_close;
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	if (nr_pages < 2) {
+		ret = -EINVAL;
+		goto out_put;
+	}
+
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		ret = -ENOMEM;
+		goto out_put;
+	}
+
+	zram->old_block_size = block_size(bdev);
+	ret = set_blocksize(bdev, PAGE_SIZE);
+	if (ret) {
+		vfree(bitmap);
+		goto out_put;
+	}
+
+	set_bit(0, bitmap);
+	zram->backing_dev = backing_dev;
+	zram->bdev = bdev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+
+	pr_info("Backing device %s, %lu pages\n", file_name, nr_pages);
+	return 0;
+
+out_put:
+	blkdev_put(bdev, ZRAM_BDEV_MODE);
+out_close:
+	filp_close(backing_dev, NULL);
+	return ret;
+}
+#else
+static void zram_free_block(struct zram *zram, unsigned long blk)
+{
+}
+
+static int zram_read_from_bdev(struct zram *zram, char *mem,
+			       unsigned long blk)
+{
+	return -EIO;
+}
+
+static bool zram_read_bdev_async(struct zram *zram, struct bio *bio,
+				 u32 index, int offset)
+{
+	return false;
+}
+
+static void zram_reset_bdev(struct zram *zram)
+{
+}
+#endif /* CONFIG_ZRAM_WRITEBACK */
+
+/* Must be called with the slot locked */
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	unsigned long handle = zram->table[index].handle;
-	u16 size = zram->table[index].size;
+	size_t size = zram_get_obj_size(zram, index);
+
+	/* Tell a writeback in progress that the data has gone */
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_clear_flag(zram, index, ZRAM_WB);
+		zram_free_block(zram, handle);
+		zram->table[index].handle = 0;
+		return;
+	}
+
+	/*
+	 * No memory is allocated for same filled pages, the handle holds
+	 * the fill pattern.  Simply clear the flag.
+	 */
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_clear_flag(zram, index, ZRAM_SAME);
+		zram_stat_dec(&zram->stats.pages_same);
+		zram->table[index].handle = 0;
+		return;
+	}
 
 	if (unlikely(!handle)) {
 		/*
@@ -288,26 +810,36 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (unlikely(size > max_zpage_size))
 		zram_stat_dec(&zram->stats.bad_compress);
 
-	zs_free(zram->mem_pool, handle);
+	/* Shared objects are only freed with the last reference */
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		if (zram_dedup_put(zram, handle)) {
+			zs_free(zram->mem_pool, handle);
+			zram_stat64_sub(zram, &zram->stats.compr_size, size);
+		} else {
+			zram_stat_dec(&zram->stats.pages_dup);
+		}
+	} else {
+		zs_free(zram->mem_pool, handle);
+		zram_stat64_sub(zram, &zram->stats.compr_size, size);
+	}
 
 	if (size <= PAGE_SIZE / 2)
 		zram_stat_dec(&zram->stats.good_compress);
 
-	zram_stat64_sub(zram, &zram->stats.compr_size,
-			zram->table[index].size);
 	zram_stat_dec(&zram->stats.pages_stored);
 
 	zram->table[index].handle = 0;
-	zram->table[index].size = 0;
+	zram_set_obj_size(zram, index, 0);
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
@@ -321,23 +853,42 @@ static inline int is_partial_io(struct bio_vec *bvec)
 static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 {
 	int ret = 0;
-	size_t clen = PAGE_SIZE;
+	unsigned int clen = PAGE_SIZE;
 	unsigned char *cmem;
-	unsigned long handle = zram->table[index].handle;
+	unsigned long handle;
+	size_t size;
+
+	zram_lock_slot(zram, index);
+	handle = zram->table[index].handle;
+	size = zram_get_obj_size(zram, index);
+
+	/* The handle is a block on the backing device, see zram_read_page() */
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		zram_unlock_slot(zram, index);
+		return -EAGAIN;
+	}
+
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		zram_unlock_slot(zram, index);
+		zram_fill_page(mem, PAGE_SIZE, handle);
+		return 0;
+	}
 
 	if (!handle || zram_test_flag(zram, index, ZRAM_ZERO)) {
+		zram_unlock_slot(zram, index);
 		memset(mem, 0, PAGE_SIZE);
 		return 0;
 	}
 
 	cmem = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
-	if (zram->table[index].size == PAGE_SIZE)
+	if (size == PAGE_SIZE)
 		memcpy(mem, cmem, PAGE_SIZE);
 	else
 		ret = zram_comp_op(ZRAM_COMPOP_DECOMPRESS, cmem,
-				zram->table[index].size, mem, &clen);
+				size, mem, &clen);
 
 	zs_unmap_object(zram->mem_pool, handle);
+	zram_unlock_slot(zram, index);
 
 	/* Should NEVER happen. Return bio error if it does. */
 	if (unlikely(ret != 0)) {
@@ -349,67 +900,233 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+/*
+ * Like zram_decompress_page() but also reads pages that have been written
+ * back.  May sleep.
+ */
+static int zram_read_page(struct zram *zram, char *mem, u32 index)
+{
+	unsigned long blk;
+	int ret;
+
+	while ((ret = zram_decompress_page(zram, mem, index)) == -EAGAIN) {
+		zram_lock_slot(zram, index);
+		if (!zram_test_flag(zram, index, ZRAM_WB)) {
+			zram_unlock_slot(zram, index);
+			continue;
+		}
+		blk = zram->table[index].handle;
+		zram_unlock_slot(zram, index);
+
+		return zram_read_from_bdev(zram, mem, blk);
+	}
+
+	return ret;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Serializes writebacks, see the ZRAM_UNDER_WB check in zram_writeback() */
+static DEFINE_MUTEX(zram_wb_mutex);
+
+/**
+ * zram_mark_idle - Mark all stored pages idle
+ * @zram: the device
+ *
+ * Pages are no longer idle once they are read or written.  A later
+ * zram_writeback(ZRAM_WB_IDLE) picks the ones that are still idle.
+ * zram->init_lock must be held and the device initialized.
+ */
+void zram_mark_idle(struct zram *zram)
+{
+	size_t index;
+
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		zram_lock_slot(zram, index);
+		if (zram->table[index].handle &&
+		    !zram_test_flag(zram, index, ZRAM_SAME) &&
+		    !zram_test_flag(zram, index, ZRAM_WB))
+			zram_set_flag(zram, index, ZRAM_IDLE);
+		zram_unlock_slot(zram, index);
+		cond_resched();
+	}
+}
+
+/* Must be called with the slot locked */
+static bool zram_wb_candidate(struct zram *zram, u32 index,
+			      enum zram_wb_mode mode)
+{
+	if (!zram->table[index].handle ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB))
+		return false;
+
+	if (mode == ZRAM_WB_IDLE)
+		return zram_test_flag(zram, index, ZRAM_IDLE);
+
+	return zram_get_obj_size(zram, index) == PAGE_SIZE;
+}
+
+/**
+ * zram_writeback - Move pages to the backing device
+ * @zram: the device
+ * @mode: ZRAM_WB_IDLE for pages still idle since zram_mark_idle(),
+ *	  ZRAM_WB_HUGE for pages that didn't compress
+ *
+ * Each page is written out with the slot unlocked; if the page is freed or
+ * rewritten in the meantime the block is dropped again.  Returns 0, or an
+ * error if the backing device is full or failed.  zram->init_lock must be
+ * held and the device initialized.
+ */
+int zram_writeback(struct zram *zram, enum zram_wb_mode mode)
+{
+	size_t index, nr_pages = zram->disksize >> PAGE_SHIFT;
+	struct page *page;
+	unsigned long blk;
+	int ret = 0, err;
+
+	if (!zram->backing_dev)
+		return -ENODEV;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+
+	mutex_lock(&zram_wb_mutex);
+	for (index = 0; index < nr_pages; index++) {
+		cond_resched();
+
+		zram_lock_slot(zram, index);
+		if (!zram_wb_candidate(zram, index, mode)) {
+			zram_unlock_slot(zram, index);
+			continue;
+		}
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+		zram_unlock_slot(zram, index);
+
+		err = zram_decompress_page(zram, kmap(page), index);
+		kunmap(page);
+		if (err)
+			goto skip;
+
+		blk = zram_alloc_block(zram);
+		if (!blk) {
+			ret = -ENOSPC;
+			goto skip;
+		}
+
+		err = zram_bdev_rw_page(zram, page, blk, WRITE);
+		if (err) {
+			pr_err("Backing device write failed! err=%d\n", err);
+			zram_free_block(zram, blk);
+			ret = err;
+			goto skip;
+		}
+
+		zram_lock_slot(zram, index);
+		if (!zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
+			/* Freed or rewritten while it was being written out */
+			zram_unlock_slot(zram, index);
+			zram_free_block(zram, blk);
+			continue;
+		}
+		zram_free_page(zram, index);
+		zram->table[index].handle = blk;
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_unlock_slot(zram, index);
+
+		zram_stat64_inc(zram, &zram->stats.bd_writes);
+		continue;
+skip:
+		zram_lock_slot(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_unlock_slot(zram, index);
+		if (ret)
+			break;
+	}
+	mutex_unlock(&zram_wb_mutex);
+
+	__free_page(page);
+
+	return ret;
+}
+#endif /* CONFIG_ZRAM_WRITEBACK */
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
 	int ret;
 	struct page *page;
-	unsigned char *user_mem, *uncmem = NULL;
+	unsigned char *user_mem, *uncmem;
+	bool wb;
 
 	page = bvec->bv_page;
 
+	zram_lock_slot(zram, index);
+	if (zram_test_flag(zram, index, ZRAM_SAME)) {
+		unsigned long element = zram->table[index].handle;
+
+		zram_unlock_slot(zram, index);
+		handle_same_page(bvec, element);
+		return 0;
+	}
+
 	if (unlikely(!zram->table[index].handle) ||
 			zram_test_flag(zram, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
+		zram_unlock_slot(zram, index);
+		handle_same_page(bvec, 0);
 		return 0;
 	}
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	wb = zram_test_flag(zram, index, ZRAM_WB);
+	zram_unlock_slot(zram, index);
 
-	if (is_partial_io(bvec))
-		/* Use  a temporary buffer to decompress the page */
-		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
-
-	user_mem = kmap_atomic(page);
-	if (!is_partial_io(bvec))
-		uncmem = user_mem;
+	if (!is_partial_io(bvec) && !wb) {
+		user_mem = kmap_atomic(page);
+		ret = zram_decompress_page(zram, user_mem, index);
+		kunmap_atomic(user_mem);
+		/* Otherwise it was written back since the check above */
+		if (ret != -EAGAIN)
+			goto out;
+	}
 
+	/* Use a temporary buffer to decompress or read the page */
+	uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
 	if (!uncmem) {
 		pr_info("Unable to allocate temp memory\n");
-		ret = -ENOMEM;
-		goto out_cleanup;
+		return -ENOMEM;
 	}
 
-	ret = zram_decompress_page(zram, uncmem, index);
-	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != 0)) {
-		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
-		zram_stat64_inc(zram, &zram->stats.failed_reads);
-		goto out_cleanup;
+	ret = zram_read_page(zram, uncmem, index);
+	if (!ret) {
+		user_mem = kmap_atomic(page);
+		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
+		       bvec->bv_len);
+		kunmap_atomic(user_mem);
 	}
+	kfree(uncmem);
 
-	if (is_partial_io(bvec))
-		memcpy(user_mem + bvec->bv_offset, uncmem + offset,
-				bvec->bv_len);
+out:
+	if (ret)
+		return ret;
 
 	flush_dcache_page(page);
-	ret = 0;
-out_cleanup:
-	kunmap_atomic(user_mem);
-	if (is_partial_io(bvec))
-		kfree(uncmem);
-	return ret;
+	return 0;
 }
 
 static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			   int offset)
 {
 	int ret = 0;
-	size_t clen;
-	unsigned long handle;
+	unsigned int clen = 2 * PAGE_SIZE;
+	unsigned long handle, element;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
+	struct zram_comp_strm *strm = NULL;
+	bool dedup = false;
+	u32 checksum;
 
 	page = bvec->bv_page;
-	src = zram->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -422,19 +1139,13 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
-		ret = zram_decompress_page(zram, uncmem, index);
+		ret = zram_read_page(zram, uncmem, index);
 		if (ret)
 			goto out;
 	}
 
-	/*
-	 * System overwrites unused sectors. Free memory associated
-	 * with this sector now.
-	 */
-	if (zram->table[index].handle ||
-	    zram_test_flag(zram, index, ZRAM_ZERO))
-		zram_free_page(zram, index);
-
+	/* May sleep waiting for another writer, so do it before kmap */
+	strm = zram_comp_strm_find(&zram->comp);
 	user_mem = kmap_atomic(page);
 
 	if (is_partial_io(bvec)) {
@@ -446,17 +1157,31 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		if (!is_partial_io(bvec))
 			kunmap_atomic(user_mem);
-		zram_stat_inc(&zram->stats.pages_zero);
-		zram_set_flag(zram, index, ZRAM_ZERO);
+		/*
+		 * System overwrites unused sectors. Free memory associated
+		 * with this sector now.
+		 */
+		zram_lock_slot(zram, index);
+		zram_free_page(zram, index);
+		if (element) {
+			/* Nothing is allocated, the handle keeps the pattern */
+			zram->table[index].handle = element;
+			zram_set_flag(zram, index, ZRAM_SAME);
+		} else {
+			zram_set_flag(zram, index, ZRAM_ZERO);
+		}
+		zram_unlock_slot(zram, index);
+		zram_stat_inc(element ? &zram->stats.pages_same :
+			      &zram->stats.pages_zero);
 		ret = 0;
 		goto out;
 	}
 
-	ret = zram_comp_op(ZRAM_COMPOP_COMPRESS, uncmem,
-			   PAGE_SIZE, src, &clen);
+	src = strm->buffer;
+	ret = crypto_comp_compress(strm->tfm, uncmem, PAGE_SIZE, src, &clen);
 
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
@@ -477,10 +1202,25 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			src = uncmem;
 	}
 
+	/* Share the object if the same data is already stored */
+	if ((clen == PAGE_SIZE) && !is_partial_io(bvec))
+		src = kmap_atomic(page);
+	checksum = zram_dedup_checksum(src, clen);
+	handle = zram_dedup_get(zram, src, clen, checksum);
+	if ((clen == PAGE_SIZE) && !is_partial_io(bvec))
+		kunmap_atomic(src);
+	if (handle) {
+		zram_comp_strm_release(&zram->comp, strm);
+		strm = NULL;
+		zram_stat_inc(&zram->stats.pages_dup);
+		dedup = true;
+		goto found;
+	}
+
 	handle = zs_malloc(zram->mem_pool, clen);
 	if (!handle) {
 		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
+			"page: %u, size=%u\n", index, clen);
 		ret = -ENOMEM;
 		goto out;
 	}
@@ -494,16 +1234,33 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	zs_unmap_object(zram->mem_pool, handle);
 
+	zram_comp_strm_release(&zram->comp, strm);
+	strm = NULL;
+
+	dedup = zram_dedup_insert(zram, handle, clen, checksum);
+	zram_stat64_add(zram, &zram->stats.compr_size, clen);
+
+found:
+	/*
+	 * System overwrites unused sectors. Free memory associated
+	 * with this sector now.
+	 */
+	zram_lock_slot(zram, index);
+	zram_free_page(zram, index);
 	zram->table[index].handle = handle;
-	zram->table[index].size = clen;
+	zram_set_obj_size(zram, index, clen);
+	if (dedup)
+		zram_set_flag(zram, index, ZRAM_DEDUP);
+	zram_unlock_slot(zram, index);
 
 	/* Update stats */
-	zram_stat64_add(zram, &zram->stats.compr_size, clen);
 	zram_stat_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		zram_stat_inc(&zram->stats.good_compress);
 
 out:
+	if (strm)
+		zram_comp_strm_release(&zram->comp, strm);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
 
@@ -517,15 +1274,10 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 {
 	int ret;
 
-	if (rw == READ) {
-		down_read(&zram->lock);
+	if (rw == READ)
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
-		up_read(&zram->lock);
-	} else {
-		down_write(&zram->lock);
+	else
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
-	}
 
 	return ret;
 }
@@ -555,6 +1307,10 @@ static void __zram_make_request(struct zram *zram, struct bio *bio, int rw)
 	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
 	offset = (bio->bi_sector & (SECTORS_PER_PAGE - 1)) << SECTOR_SHIFT;
 
+	/* Completed by the backing device */
+	if (rw == READ && zram_read_bdev_async(zram, bio, index, offset))
+		return;
+
 	bio_for_each_segment(bvec, bio, i) {
 		int max_transfer_size = PAGE_SIZE - offset;
 
@@ -645,20 +1401,19 @@ void __zram_reset_device(struct zram *zram)
 	zram->init_done = 0;
 
 	/* Free various per-device buffers */
-	kfree(zram->compress_workmem);
-	free_pages((unsigned long)zram->compress_buffer, 1);
-
-	zram->compress_workmem = NULL;
-	zram->compress_buffer = NULL;
+	zram_comp_destroy_streams(&zram->comp);
 
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = zram->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_DEDUP) ||
+		    zram_test_flag(zram, index, ZRAM_WB))
 			continue;
 
 		zs_free(zram->mem_pool, handle);
 	}
+	zram_dedup_destroy(zram);
 
 	vfree(zram->table);
 	zram->table = NULL;
@@ -677,6 +1432,7 @@ void zram_reset_device(struct zram *zram)
 {
 	down_write(&zram->init_lock);
 	__zram_reset_device(zram);
+	zram_reset_bdev(zram);
 	up_write(&zram->init_lock);
 }
 
@@ -700,11 +1456,9 @@ int zram_init_device(struct zram *zram)
 		);
 	}
 
-	zram->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!zram->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	ret = zram_comp_init_streams(&zram->comp, zram->max_comp_streams);
+	if (ret) {
+		pr_err("Error allocating compression streams\n");
 		goto fail_no_table;
 	}
 
@@ -712,6 +1466,7 @@ int zram_init_device(struct zram *zram)
 	zram->table = vzalloc(num_pages * sizeof(*zram->table));
 	if (!zram->table) {
 		pr_err("Error allocating zram address table\n");
+		zram_comp_destroy_streams(&zram->comp);
 		ret = -ENOMEM;
 		goto fail_no_table;
 	}
@@ -719,12 +1474,14 @@ int zram_init_device(struct zram *zram)
 	/* zram devices sort of resembles non-rotational disks */
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
-	zram->mem_pool = zs_create_pool("zram", GFP_NOIO | __GFP_HIGHMEM);
+	zram->mem_pool = zs_create_pool(zram->disk->disk_name,
+					GFP_NOIO | __GFP_HIGHMEM);
 	if (!zram->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		ret = -ENOMEM;
 		goto fail;
 	}
+	zram_dedup_init(zram);
 
 	zram->init_done = 1;
 
@@ -746,7 +1503,9 @@ static void zram_slot_free_notify(struct block_device *bdev,
 	struct zram *zram;
 
 	zram = bdev->bd_disk->private_data;
+	zram_lock_slot(zram, index);
 	zram_free_page(zram, index);
+	zram_unlock_slot(zram, index);
 	zram_stat64_inc(zram, &zram->stats.notify_free);
 }
 
@@ -759,9 +1518,9 @@ static int create_device(struct zram *zram, int device_id)
 {
 	int ret = 0;
 
-	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
 	spin_lock_init(&zram->stat64_lock);
+	zram->max_comp_streams = num_online_cpus();
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
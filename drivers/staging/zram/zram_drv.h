@@ -17,8 +17,12 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/wait.h>
+#include <linux/crypto.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zram_dedup.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -51,10 +55,28 @@ static const size_t max_zpage_size = PAGE_SIZE / 4 * 3;
 #define ZRAM_SECTOR_PER_LOGICAL_BLOCK	\
 	(1 << (ZRAM_LOGICAL_BLOCK_SHIFT - SECTOR_SHIFT))
 
-/* Flags for zram pages (table[page_no].flags) */
+/*
+ * The lower ZRAM_FLAG_SHIFT bits of table[page_no].value hold the object
+ * size (excluding header), the higher bits are the zram_pageflags.
+ */
+#define ZRAM_FLAG_SHIFT 16
+
+/* Flags for zram pages (table[page_no].value) */
 enum zram_pageflags {
 	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	ZRAM_ZERO = ZRAM_FLAG_SHIFT,
+	/* Lock for the table entry, see zram_lock_slot() */
+	ZRAM_ACCESS,
+	/* Page is one repeated word, kept in the handle */
+	ZRAM_SAME,
+	/* Object is in the dedup index and may be shared */
+	ZRAM_DEDUP,
+	/* Page is on the backing device, the handle is the block index */
+	ZRAM_WB,
+	/* Page is being written back, cleared if the slot is freed */
+	ZRAM_UNDER_WB,
+	/* Page has not been accessed since it was last marked idle */
+	ZRAM_IDLE,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -64,10 +86,8 @@ enum zram_pageflags {
 /* Allocated for each disk page */
 struct table {
 	unsigned long handle;
-	u16 size;	/* object size (excluding header) */
-	u8 count;	/* object ref count (not yet used) */
-	u8 flags;
-} __aligned(4);
+	unsigned long value;	/* object size and zram_pageflags */
+};
 
 struct zram_stats {
 	u64 compr_size;		/* compressed size of pages stored */
@@ -77,20 +97,45 @@ struct zram_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-page-aligned I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
-	u32 pages_zero;		/* no. of zero filled pages */
-	u32 pages_stored;	/* no. of pages currently stored */
-	u32 good_compress;	/* % of pages with compression ratio<=50% */
-	u32 bad_compress;	/* % of pages with compression ratio>=75% */
+	atomic_t pages_zero;	/* no. of zero filled pages */
+	atomic_t pages_same;	/* no. of other same filled pages */
+	atomic_t pages_dup;	/* no. of pages sharing a stored object */
+	atomic_t pages_stored;	/* no. of pages currently stored */
+	atomic_t good_compress;	/* % of pages with compression ratio<=50% */
+	atomic_t bad_compress;	/* % of pages with compression ratio>=75% */
+	atomic_t bd_count;	/* no. of pages on the backing device */
+	u64 bd_reads;		/* pages read back from the backing device */
+	u64 bd_writes;		/* pages written back to the backing device */
+};
+
+/* Which pages to write back, see zram_writeback() */
+enum zram_wb_mode {
+	ZRAM_WB_IDLE,		/* pages marked idle that weren't accessed */
+	ZRAM_WB_HUGE,		/* pages that are stored uncompressed */
+};
+
+/* A compressor transform together with its output buffer */
+struct zram_comp_strm {
+	struct crypto_comp *tfm;
+	void *buffer;		/* compressed data, two pages */
+	struct list_head list;
+};
+
+/* Set of compression streams shared by the writers of a device */
+struct zram_comp {
+	spinlock_t lock;	/* protects the idle list and the counters */
+	struct list_head idle;
+	int avail;		/* no. of streams allocated */
+	int max;		/* max. no. of streams */
+	wait_queue_head_t wait;	/* writers waiting for an idle stream */
 };
 
 struct zram {
 	struct zs_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct zram_comp comp;
+	struct zram_dedup dedup;
 	struct table *table;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct rw_semaphore lock; /* protect compression buffers and table
-				   * against concurrent read and writes */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -101,6 +146,16 @@ struct zram {
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
+	/* Number of compression streams, applied on init */
+	int max_comp_streams;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* Set before init, released on reset */
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned int old_block_size;
+	unsigned long *bitmap;	/* blocks in use on the backing device */
+	unsigned long nr_pages;	/* size of the backing device */
+#endif
 
 	struct zram_stats stats;
 };
@@ -113,5 +168,11 @@ extern struct attribute_group zram_disk_attr_group;
 
 extern int zram_init_device(struct zram *zram);
 extern void zram_reset_device(struct zram *zram);
+extern int zram_comp_set_max_streams(struct zram_comp *comp, int num);
+#ifdef CONFIG_ZRAM_WRITEBACK
+extern int zram_set_backing_dev(struct zram *zram, const char *file_name);
+extern void zram_mark_idle(struct zram *zram);
+extern int zram_writeback(struct zram *zram, enum zram_wb_mode mode);
+#endif
 
 #endif
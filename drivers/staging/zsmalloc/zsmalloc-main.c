@@ -51,11 +51,19 @@
  *	page->lru: links together first pages of various zspages.
  *		Basically forming list of zspages in a fullness group.
  *	page->mapping: class index and fullness group of the zspage
+ *	page->private: for huge classes (one object per single page zspage)
+ *		the handle of the object, as there is no room for it in the
+ *		object itself
  *
  * Usage of struct page flags:
  *	PG_private: identifies the first component page
  *	PG_private2: identifies the last component page
  *
+ * The handle zs_malloc() returns points to a word holding the object's
+ * location, so that zs_compact() can move objects out of sparsely used
+ * zspages and free them.  Each allocated object starts with its handle,
+ * which compaction uses to find and update the owner's word.
+ *
  */
 
 #ifdef CONFIG_ZSMALLOC_DEBUG
@@ -77,7 +85,11 @@
 #include <linux/vmalloc.h>
 #include <linux/hardirq.h>
 #include <linux/spinlock.h>
+#include <linux/bit_spinlock.h>
 #include <linux/types.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
 
 #include "zsmalloc.h"
 
@@ -119,9 +131,25 @@
 #endif
 #endif
 #define _PFN_BITS		(MAX_PHYSMEM_BITS - PAGE_SHIFT)
-#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS)
+
+/*
+ * The low bit of the first word of an object tells an allocated object,
+ * which starts with its tagged handle, from a free one, which starts with
+ * the link to the next free object.  Object locations are shifted left by
+ * OBJ_TAG_BITS so that free links always have it clear.
+ */
+#define OBJ_ALLOCATED_TAG	1
+#define OBJ_TAG_BITS	1
+#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS - OBJ_TAG_BITS)
 #define OBJ_INDEX_MASK	((_AC(1, UL) << OBJ_INDEX_BITS) - 1)
 
+/*
+ * Handles are words from zs_handle_cache holding the object location.
+ * Their low bit pins the object while it is mapped or being freed.
+ */
+#define ZS_HANDLE_SIZE	(sizeof(unsigned long))
+#define HANDLE_PIN_BIT	0
+
 #define MAX(a, b) ((a) >= (b) ? (a) : (b))
 /* ZS_MIN_ALLOC_SIZE must be multiple of ZS_ALIGN */
 #define ZS_MIN_ALLOC_SIZE \
@@ -183,11 +211,15 @@ struct size_class {
 
 	/* Number of PAGE_SIZE sized pages to combine to form a 'zspage' */
 	int pages_per_zspage;
+	int objs_per_zspage;
+	/* One object per single page zspage, its handle in page->private */
+	bool huge;
 
 	spinlock_t lock;
 
 	/* stats */
 	u64 pages_allocated;
+	unsigned long obj_used;
 
 	struct page *fullness_list[_ZS_NR_FULLNESS_GROUPS];
 };
@@ -199,8 +231,12 @@ struct size_class {
  * This must be power of 2 and less than or equal to ZS_ALIGN
  */
 struct link_free {
-	/* Handle of next free chunk (encodes <PFN, obj_idx>) */
-	void *next;
+	union {
+		/* Location of next free chunk (encodes <PFN, obj_idx>) */
+		void *next;
+		/* Handle of allocated object, with OBJ_ALLOCATED_TAG */
+		unsigned long handle;
+	};
 };
 
 struct zs_pool {
@@ -208,8 +244,16 @@ struct zs_pool {
 
 	gfp_t flags;	/* allocation flags used when growing pool */
 	const char *name;
+
+	struct shrinker shrinker;
+	atomic_long_t pages_compacted;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *stat_dentry;
+#endif
 };
 
+static struct kmem_cache *zs_handle_cache;
+
 /*
  * A zspage's class index and fullness group
  * are encoded in its (first)page->mapping
@@ -284,7 +328,8 @@ static int get_size_class_index(int size)
 		idx = DIV_ROUND_UP(size - ZS_MIN_ALLOC_SIZE,
 				ZS_SIZE_CLASS_DELTA);
 
-	return idx;
+	/* A PAGE_SIZE object plus its handle still goes to the last class */
+	return min_t(int, idx, ZS_SIZE_CLASSES - 1);
 }
 
 static enum fullness_group get_fullness_group(struct page *page)
@@ -431,28 +476,76 @@ static struct page *get_next_page(struct page *page)
 	return next;
 }
 
-/* Encode <page, obj_idx> as a single handle value */
-static void *obj_location_to_handle(struct page *page, unsigned long obj_idx)
+/* Encode <page, obj_idx> as a single object location value */
+static unsigned long location_to_obj(struct page *page, unsigned long obj_idx)
 {
-	unsigned long handle;
+	unsigned long obj;
 
 	if (!page) {
 		BUG_ON(obj_idx);
-		return NULL;
+		return 0;
 	}
 
-	handle = page_to_pfn(page) << OBJ_INDEX_BITS;
-	handle |= (obj_idx & OBJ_INDEX_MASK);
+	obj = page_to_pfn(page) << OBJ_INDEX_BITS;
+	obj |= (obj_idx & OBJ_INDEX_MASK);
+	obj <<= OBJ_TAG_BITS;
 
-	return (void *)handle;
+	return obj;
 }
 
-/* Decode <page, obj_idx> pair from the given object handle */
-static void obj_handle_to_location(unsigned long handle, struct page **page,
+/* Decode <page, obj_idx> pair from the given object location */
+static void obj_to_location(unsigned long obj, struct page **page,
 				unsigned long *obj_idx)
 {
-	*page = pfn_to_page(handle >> OBJ_INDEX_BITS);
-	*obj_idx = handle & OBJ_INDEX_MASK;
+	obj >>= OBJ_TAG_BITS;
+	*page = pfn_to_page(obj >> OBJ_INDEX_BITS);
+	*obj_idx = obj & OBJ_INDEX_MASK;
+}
+
+static unsigned long alloc_handle(struct zs_pool *pool)
+{
+	return (unsigned long)kmem_cache_alloc(zs_handle_cache,
+				pool->flags & ~__GFP_HIGHMEM);
+}
+
+static void free_handle(unsigned long handle)
+{
+	kmem_cache_free(zs_handle_cache, (void *)handle);
+}
+
+static void record_obj(unsigned long handle, unsigned long obj)
+{
+	ACCESS_ONCE(*(unsigned long *)handle) = obj;
+}
+
+static unsigned long handle_to_obj(unsigned long handle)
+{
+	return ACCESS_ONCE(*(unsigned long *)handle) &
+			~(_AC(1, UL) << HANDLE_PIN_BIT);
+}
+
+static void pin_tag(unsigned long handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static int trypin_tag(unsigned long handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void unpin_tag(unsigned long handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+/* First word of the object at @obj_addr in @page, see OBJ_ALLOCATED_TAG */
+static unsigned long obj_to_head(struct size_class *class, struct page *page,
+				void *obj_addr)
+{
+	if (class->huge)
+		return page_private(page);
+	return *(unsigned long *)obj_addr;
 }
 
 static unsigned long obj_idx_to_offset(struct page *page,
@@ -529,7 +622,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		for (i = 1; i <= objs_on_page; i++) {
 			off += class->size;
 			if (off < PAGE_SIZE) {
-				link->next = obj_location_to_handle(page, i);
+				link->next = (void *)location_to_obj(page, i);
 				link += class->size / sizeof(*link);
 			}
 		}
@@ -540,7 +633,7 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		 * page (if present)
 		 */
 		next_page = get_next_page(page);
-		link->next = obj_location_to_handle(next_page, 0);
+		link->next = (void *)location_to_obj(next_page, 0);
 		kunmap_atomic(link);
 		page = next_page;
 		off = (off + class->size) % PAGE_SIZE;
@@ -594,9 +687,9 @@ static struct page *alloc_zspage(struct size_class *class, gfp_t flags)
 
 	init_zspage(first_page, class);
 
-	first_page->freelist = obj_location_to_handle(first_page, 0);
+	first_page->freelist = (void *)location_to_obj(first_page, 0);
 	/* Maximum number of objects we can store in this zspage */
-	first_page->objects = class->pages_per_zspage * PAGE_SIZE / class->size;
+	first_page->objects = class->objs_per_zspage;
 
 	error = 0; /* Success */
 
@@ -623,6 +716,59 @@ static struct page *find_get_zspage(struct size_class *class)
 	return page;
 }
 
+/* Take a free object of @first_page for @handle, returns its location */
+static unsigned long obj_malloc(struct page *first_page,
+				struct size_class *class, unsigned long handle)
+{
+	unsigned long obj;
+	struct link_free *link;
+	struct page *m_page;
+	unsigned long m_objidx, m_offset;
+	void *vaddr;
+
+	obj = (unsigned long)first_page->freelist;
+	obj_to_location(obj, &m_page, &m_objidx);
+	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
+
+	vaddr = kmap_atomic(m_page);
+	link = (struct link_free *)vaddr + m_offset / sizeof(*link);
+	first_page->freelist = link->next;
+	if (!class->huge)
+		link->handle = handle | OBJ_ALLOCATED_TAG;
+	else
+		set_page_private(first_page, handle | OBJ_ALLOCATED_TAG);
+	kunmap_atomic(vaddr);
+
+	first_page->inuse++;
+	class->obj_used++;
+
+	return obj;
+}
+
+/* Return the object at @obj to its zspage's freelist */
+static void obj_free(struct size_class *class, unsigned long obj)
+{
+	struct link_free *link;
+	struct page *first_page, *f_page;
+	unsigned long f_objidx, f_offset;
+	void *vaddr;
+
+	obj_to_location(obj, &f_page, &f_objidx);
+	first_page = get_first_page(f_page);
+	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+
+	vaddr = kmap_atomic(f_page);
+	link = (struct link_free *)((unsigned char *)vaddr + f_offset);
+	link->next = first_page->freelist;
+	if (class->huge)
+		set_page_private(first_page, 0);
+	kunmap_atomic(vaddr);
+	first_page->freelist = (void *)obj;
+
+	first_page->inuse--;
+	class->obj_used--;
+}
+
 #ifdef USE_PGTABLE_MAPPING
 static inline int __zs_cpu_up(struct mapping_area *area)
 {
@@ -723,6 +869,11 @@ static void __zs_unmap_object(struct mapping_area *area,
 	if (area->vm_mm == ZS_MM_RO)
 		goto out;
 
+	/* The handle at the start was not handed out, don't write it back */
+	buf += ZS_HANDLE_SIZE;
+	size -= ZS_HANDLE_SIZE;
+	off += ZS_HANDLE_SIZE;
+
 	sizes[0] = PAGE_SIZE - off;
 	sizes[1] = size - sizes[0];
 
@@ -775,12 +926,23 @@ static void zs_exit(void)
 	for_each_online_cpu(cpu)
 		zs_cpu_notifier(NULL, CPU_DEAD, (void *)(long)cpu);
 	unregister_cpu_notifier(&zs_cpu_nb);
+
+	zs_stat_exit();
+	if (zs_handle_cache)
+		kmem_cache_destroy(zs_handle_cache);
 }
 
 static int zs_init(void)
 {
 	int cpu, ret;
 
+	zs_handle_cache = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					0, 0, NULL);
+	if (!zs_handle_cache)
+		return -ENOMEM;
+
+	zs_stat_init();
+
 	register_cpu_notifier(&zs_cpu_nb);
 	for_each_online_cpu(cpu) {
 		ret = zs_cpu_notifier(NULL, CPU_UP_PREPARE, (void *)(long)cpu);
@@ -793,6 +955,433 @@ fail:
 	return notifier_to_errno(ret);
 }
 
+/* Copy the object at @src over the one at @dst, either may span pages */
+static void zs_object_copy(unsigned long dst, unsigned long src,
+				struct size_class *class)
+{
+	struct page *s_page, *d_page;
+	unsigned long s_objidx, d_objidx;
+	unsigned long s_off, d_off;
+	void *s_addr, *d_addr;
+	int s_size, d_size, size;
+	int written = 0;
+
+	s_size = d_size = class->size;
+
+	obj_to_location(src, &s_page, &s_objidx);
+	obj_to_location(dst, &d_page, &d_objidx);
+
+	s_off = obj_idx_to_offset(s_page, s_objidx, class->size);
+	d_off = obj_idx_to_offset(d_page, d_objidx, class->size);
+
+	if (s_off + class->size > PAGE_SIZE)
+		s_size = PAGE_SIZE - s_off;
+
+	if (d_off + class->size > PAGE_SIZE)
+		d_size = PAGE_SIZE - d_off;
+
+	s_addr = kmap_atomic(s_page);
+	d_addr = kmap_atomic(d_page);
+
+	while (1) {
+		size = min(s_size, d_size);
+		memcpy(d_addr + d_off, s_addr + s_off, size);
+		written += size;
+
+		if (written == class->size)
+			break;
+
+		s_off += size;
+		s_size -= size;
+		d_off += size;
+		d_size -= size;
+
+		if (s_off >= PAGE_SIZE) {
+			/* atomic kmaps are undone in reverse order */
+			kunmap_atomic(d_addr);
+			kunmap_atomic(s_addr);
+			s_page = get_next_page(s_page);
+			BUG_ON(!s_page);
+			s_addr = kmap_atomic(s_page);
+			d_addr = kmap_atomic(d_page);
+			s_size = class->size - written;
+			s_off = 0;
+		}
+
+		if (d_off >= PAGE_SIZE) {
+			kunmap_atomic(d_addr);
+			d_page = get_next_page(d_page);
+			BUG_ON(!d_page);
+			d_addr = kmap_atomic(d_page);
+			d_size = class->size - written;
+			d_off = 0;
+		}
+	}
+
+	kunmap_atomic(d_addr);
+	kunmap_atomic(s_addr);
+}
+
+/*
+ * Find the first allocated object of @page from *@index on and pin it.
+ * Objects pinned by someone else are passed over.  Returns its handle,
+ * or 0 with *@index past the last object starting in @page.
+ */
+static unsigned long find_alloced_obj(struct size_class *class,
+					struct page *page, int *index)
+{
+	unsigned long head, handle = 0;
+	unsigned long offset;
+	void *addr = kmap_atomic(page);
+
+	offset = obj_idx_to_offset(page, *index, class->size);
+	while (offset < PAGE_SIZE) {
+		head = obj_to_head(class, page, addr + offset);
+		if (head & OBJ_ALLOCATED_TAG) {
+			handle = head & ~OBJ_ALLOCATED_TAG;
+			if (trypin_tag(handle))
+				break;
+			handle = 0;
+		}
+
+		offset += class->size;
+		(*index)++;
+	}
+
+	kunmap_atomic(addr);
+	return handle;
+}
+
+struct zs_compact_control {
+	/* Component page of the source zspage to resume scanning at */
+	struct page *s_page;
+	/* First page of the destination zspage */
+	struct page *d_page;
+	/* Object index in s_page to resume scanning at */
+	int index;
+	/* Objects moved so far out of the source zspage */
+	int nr_migrated;
+};
+
+/*
+ * Move objects out of the source zspage into cc->d_page.  Returns -ENOMEM
+ * when the destination filled up before the source was drained.
+ */
+static int migrate_zspage(struct zs_pool *pool, struct size_class *class,
+				struct zs_compact_control *cc)
+{
+	unsigned long used_obj, free_obj;
+	unsigned long handle;
+	struct page *s_page = cc->s_page;
+	struct page *d_page = cc->d_page;
+	int index = cc->index;
+	int ret = 0;
+
+	while (1) {
+		handle = find_alloced_obj(class, s_page, &index);
+		if (!handle) {
+			s_page = get_next_page(s_page);
+			if (!s_page)
+				break;
+			index = 0;
+			continue;
+		}
+
+		if (d_page->inuse == d_page->objects) {
+			unpin_tag(handle);
+			ret = -ENOMEM;
+			break;
+		}
+
+		used_obj = handle_to_obj(handle);
+		free_obj = obj_malloc(d_page, class, handle);
+		zs_object_copy(free_obj, used_obj, class);
+		index++;
+		/* The handle must stay pinned until it names the new copy */
+		record_obj(handle, free_obj | (_AC(1, UL) << HANDLE_PIN_BIT));
+		unpin_tag(handle);
+		obj_free(class, used_obj);
+		cc->nr_migrated++;
+	}
+
+	cc->s_page = s_page;
+	cc->index = index;
+
+	return ret;
+}
+
+/* Take a zspage to move objects into, fuller ones first */
+static struct page *isolate_target_page(struct size_class *class)
+{
+	int i;
+	struct page *page;
+
+	for (i = 0; i < _ZS_NR_FULLNESS_GROUPS; i++) {
+		page = class->fullness_list[i];
+		if (page) {
+			remove_zspage(page, class, i);
+			return page;
+		}
+	}
+
+	return NULL;
+}
+
+static struct page *isolate_source_page(struct size_class *class)
+{
+	struct page *page;
+
+	page = class->fullness_list[ZS_ALMOST_EMPTY];
+	if (page)
+		remove_zspage(page, class, ZS_ALMOST_EMPTY);
+
+	return page;
+}
+
+/* Put an isolated zspage back on its class list, freeing it if empty */
+static enum fullness_group putback_zspage(struct zs_pool *pool,
+				struct size_class *class, struct page *first_page)
+{
+	enum fullness_group fullness;
+
+	fullness = get_fullness_group(first_page);
+	insert_zspage(first_page, class, fullness);
+	set_zspage_mapping(first_page, class->index, fullness);
+
+	if (fullness == ZS_EMPTY) {
+		class->pages_allocated -= class->pages_per_zspage;
+		atomic_long_add(class->pages_per_zspage,
+				&pool->pages_compacted);
+		free_zspage(first_page);
+	}
+
+	return fullness;
+}
+
+/* Pages a perfect compaction of @class would free, called unlocked too */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long obj_allocated, obj_used;
+
+	obj_allocated = (unsigned long)class->pages_allocated /
+			class->pages_per_zspage * class->objs_per_zspage;
+	obj_used = ACCESS_ONCE(class->obj_used);
+	if (obj_allocated <= obj_used)
+		return 0;
+
+	return (obj_allocated - obj_used) / class->objs_per_zspage *
+			class->pages_per_zspage;
+}
+
+static unsigned long __zs_compact(struct zs_pool *pool,
+				struct size_class *class)
+{
+	struct zs_compact_control cc;
+	struct page *src_page;
+	struct page *dst_page = NULL;
+	unsigned long freed = 0;
+
+	spin_lock(&class->lock);
+	while (zs_can_compact(class)) {
+		src_page = isolate_source_page(class);
+		if (!src_page)
+			break;
+
+		cc.s_page = src_page;
+		cc.index = 0;
+		cc.nr_migrated = 0;
+
+		while ((dst_page = isolate_target_page(class))) {
+			cc.d_page = dst_page;
+			if (!migrate_zspage(pool, class, &cc))
+				break;
+
+			putback_zspage(pool, class, dst_page);
+		}
+
+		/* Nowhere left to move objects to */
+		if (!dst_page) {
+			putback_zspage(pool, class, src_page);
+			break;
+		}
+
+		putback_zspage(pool, class, dst_page);
+		if (putback_zspage(pool, class, src_page) == ZS_EMPTY)
+			freed += class->pages_per_zspage;
+		else if (!cc.nr_migrated)
+			/* Only pinned objects left, it would come right back */
+			break;
+
+		spin_unlock(&class->lock);
+		cond_resched();
+		spin_lock(&class->lock);
+	}
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+/**
+ * zs_compact - Move objects to free sparsely used zspages.
+ * @pool: pool to compact
+ *
+ * Objects of the emptiest zspages of each class are moved into fuller
+ * ones.  Mapped objects are left where they are.
+ *
+ * Returns the number of pages freed.
+ */
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	int i;
+	unsigned long freed = 0;
+
+	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--)
+		freed += __zs_compact(pool, &pool->size_class[i]);
+
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+unsigned long zs_get_compacted_pages(struct zs_pool *pool)
+{
+	return atomic_long_read(&pool->pages_compacted);
+}
+EXPORT_SYMBOL_GPL(zs_get_compacted_pages);
+
+static int zs_shrinker_shrink(struct shrinker *shrinker,
+				struct shrink_control *sc)
+{
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+					shrinker);
+	unsigned long pages = 0;
+	int i;
+
+	if (sc->nr_to_scan)
+		zs_compact(pool);
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++)
+		pages += zs_can_compact(&pool->size_class[i]);
+
+	return min_t(unsigned long, pages, INT_MAX);
+}
+
+#ifdef CONFIG_DEBUG_FS
+
+static struct dentry *zs_stat_root;
+
+static int zs_count_zspages(struct page *head)
+{
+	struct list_head *pos;
+	int n;
+
+	if (!head)
+		return 0;
+
+	n = 1;
+	list_for_each(pos, &head->lru)
+		n++;
+
+	return n;
+}
+
+static int zs_stats_classes_show(struct seq_file *s, void *v)
+{
+	struct zs_pool *pool = s->private;
+	unsigned long total_objs = 0, total_used = 0, total_pages = 0;
+	unsigned long obj_allocated, obj_used, pages_used, freeable;
+	int almost_full, almost_empty;
+	int i;
+
+	seq_printf(s, " %5s %5s %11s %12s %13s %10s %10s %9s %16s\n",
+		"class", "size", "almost_full", "almost_empty",
+		"obj_allocated", "obj_used", "pages_used", "freeable",
+		"pages_per_zspage");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		struct size_class *class = &pool->size_class[i];
+
+		spin_lock(&class->lock);
+		almost_full = zs_count_zspages(
+				class->fullness_list[ZS_ALMOST_FULL]);
+		almost_empty = zs_count_zspages(
+				class->fullness_list[ZS_ALMOST_EMPTY]);
+		pages_used = class->pages_allocated;
+		obj_allocated = pages_used / class->pages_per_zspage *
+				class->objs_per_zspage;
+		obj_used = class->obj_used;
+		freeable = zs_can_compact(class);
+		spin_unlock(&class->lock);
+
+		if (!pages_used)
+			continue;
+
+		seq_printf(s, " %5d %5d %11d %12d %13lu %10lu %10lu %9lu %16d\n",
+			i, class->size, almost_full, almost_empty,
+			obj_allocated, obj_used, pages_used, freeable,
+			class->pages_per_zspage);
+
+		total_objs += obj_allocated;
+		total_used += obj_used;
+		total_pages += pages_used;
+	}
+
+	seq_printf(s, " %5s %5s %11s %12s %13lu %10lu %10lu\n",
+		"Total", "", "", "", total_objs, total_used, total_pages);
+	seq_printf(s, "pages_compacted %lu\n",
+		zs_get_compacted_pages(pool));
+
+	return 0;
+}
+
+static int zs_stats_classes_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_classes_show, inode->i_private);
+}
+
+static const struct file_operations zs_stats_classes_fops = {
+	.open		= zs_stats_classes_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void zs_pool_stat_create(struct zs_pool *pool)
+{
+	if (IS_ERR_OR_NULL(zs_stat_root))
+		return;
+
+	pool->stat_dentry = debugfs_create_dir(pool->name, zs_stat_root);
+	if (IS_ERR_OR_NULL(pool->stat_dentry)) {
+		pool->stat_dentry = NULL;
+		return;
+	}
+
+	debugfs_create_file("classes", S_IRUGO, pool->stat_dentry, pool,
+			&zs_stats_classes_fops);
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+	debugfs_remove_recursive(pool->stat_dentry);
+}
+
+static void zs_stat_init(void)
+{
+	zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
+}
+
+static void zs_stat_exit(void)
+{
+	debugfs_remove_recursive(zs_stat_root);
+}
+
+#else
+static inline void zs_pool_stat_create(struct zs_pool *pool) { }
+static inline void zs_pool_stat_destroy(struct zs_pool *pool) { }
+static inline void zs_stat_init(void) { }
+static inline void zs_stat_exit(void) { }
+#endif
+
 /**
  * zs_create_pool - Creates an allocation pool to work from.
  * @name: name of the pool to be created
@@ -830,12 +1419,22 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 		class->index = i;
 		spin_lock_init(&class->lock);
 		class->pages_per_zspage = get_pages_per_zspage(size);
-
+		class->objs_per_zspage = class->pages_per_zspage *
+					PAGE_SIZE / size;
+		class->huge = class->pages_per_zspage == 1 &&
+				class->objs_per_zspage == 1;
 	}
 
 	pool->flags = flags;
 	pool->name = name;
 
+	zs_pool_stat_create(pool);
+
+	/* Reclaim compacts the pool, there is nothing else to shrink */
+	pool->shrinker.shrink = zs_shrinker_shrink;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
+
 	return pool;
 }
 EXPORT_SYMBOL_GPL(zs_create_pool);
@@ -844,6 +1443,9 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	unregister_shrinker(&pool->shrinker);
+	zs_pool_stat_destroy(pool);
+
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int fg;
 		struct size_class *class = &pool->size_class[i];
@@ -871,17 +1473,20 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
  */
 unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 {
-	unsigned long obj;
-	struct link_free *link;
+	unsigned long handle, obj;
 	int class_idx;
 	struct size_class *class;
-
-	struct page *first_page, *m_page;
-	unsigned long m_objidx, m_offset;
+	struct page *first_page;
 
 	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
 		return 0;
 
+	handle = alloc_handle(pool);
+	if (!handle)
+		return 0;
+
+	/* extra space in chunk to keep the handle */
+	size += ZS_HANDLE_SIZE;
 	class_idx = get_size_class_index(size);
 	class = &pool->size_class[class_idx];
 	BUG_ON(class_idx != class->index);
@@ -892,72 +1497,59 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 	if (!first_page) {
 		spin_unlock(&class->lock);
 		first_page = alloc_zspage(class, pool->flags);
-		if (unlikely(!first_page))
+		if (unlikely(!first_page)) {
+			free_handle(handle);
 			return 0;
+		}
 
 		set_zspage_mapping(first_page, class->index, ZS_EMPTY);
 		spin_lock(&class->lock);
 		class->pages_allocated += class->pages_per_zspage;
 	}
 
-	obj = (unsigned long)first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
-	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
-
-	link = (struct link_free *)kmap_atomic(m_page) +
-					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link);
-
-	first_page->inuse++;
+	obj = obj_malloc(first_page, class, handle);
 	/* Now move the zspage to another fullness group, if required */
 	fix_fullness_group(pool, first_page);
+	record_obj(handle, obj);
 	spin_unlock(&class->lock);
 
-	return obj;
+	return handle;
 }
 EXPORT_SYMBOL_GPL(zs_malloc);
 
-void zs_free(struct zs_pool *pool, unsigned long obj)
+void zs_free(struct zs_pool *pool, unsigned long handle)
 {
-	struct link_free *link;
 	struct page *first_page, *f_page;
-	unsigned long f_objidx, f_offset;
-
+	unsigned long obj, f_objidx;
 	int class_idx;
 	struct size_class *class;
 	enum fullness_group fullness;
 
-	if (unlikely(!obj))
+	if (unlikely(!handle))
 		return;
 
-	obj_handle_to_location(obj, &f_page, &f_objidx);
+	/* Keep compaction from moving the object while we look it up */
+	pin_tag(handle);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &f_page, &f_objidx);
 	first_page = get_first_page(f_page);
 
 	get_zspage_mapping(first_page, &class_idx, &fullness);
 	class = &pool->size_class[class_idx];
-	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
 	spin_lock(&class->lock);
-
-	/* Insert this object in containing zspage's freelist */
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
-							+ f_offset);
-	link->next = first_page->freelist;
-	kunmap_atomic(link);
-	first_page->freelist = (void *)obj;
-
-	first_page->inuse--;
+	obj_free(class, obj);
 	fullness = fix_fullness_group(pool, first_page);
 
 	if (fullness == ZS_EMPTY)
 		class->pages_allocated -= class->pages_per_zspage;
 
 	spin_unlock(&class->lock);
+	unpin_tag(handle);
 
 	if (fullness == ZS_EMPTY)
 		free_zspage(first_page);
+	free_handle(handle);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
@@ -974,12 +1566,14 @@ EXPORT_SYMBOL_GPL(zs_free);
  * against nested mappings.
  *
  * This function returns with preemption and page faults disabled.
+ * The object is pinned, zs_compact() leaves it in place until unmapped.
 */
 void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 			enum zs_mapmode mm)
 {
 	struct page *page;
-	unsigned long obj_idx, off;
+	unsigned long obj, obj_idx, off;
+	void *ret;
 
 	unsigned int class_idx;
 	enum fullness_group fg;
@@ -996,7 +1590,11 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 	 */
 	BUG_ON(in_interrupt());
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	/* The object stays put until zs_unmap_object() */
+	pin_tag(handle);
+
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -1006,7 +1604,8 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 	if (off + class->size <= PAGE_SIZE) {
 		/* this object is contained entirely within a page */
 		area->vm_addr = kmap_atomic(page);
-		return area->vm_addr + off;
+		ret = area->vm_addr + off;
+		goto out;
 	}
 
 	/* this object spans two pages */
@@ -1014,14 +1613,18 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 	pages[1] = get_next_page(page);
 	BUG_ON(!pages[1]);
 
-	return __zs_map_object(area, pages, off, class->size);
+	ret = __zs_map_object(area, pages, off, class->size);
+out:
+	if (!class->huge)
+		ret += ZS_HANDLE_SIZE;
+	return ret;
 }
 EXPORT_SYMBOL_GPL(zs_map_object);
 
 void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 {
 	struct page *page;
-	unsigned long obj_idx, off;
+	unsigned long obj, obj_idx, off;
 
 	unsigned int class_idx;
 	enum fullness_group fg;
@@ -1030,7 +1633,8 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -1048,6 +1652,7 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 		__zs_unmap_object(area, pages, off, class->size);
 	}
 	put_cpu_var(zs_map_area);
+	unpin_tag(handle);
 }
 EXPORT_SYMBOL_GPL(zs_unmap_object);
 
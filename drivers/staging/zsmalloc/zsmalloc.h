@@ -32,7 +32,7 @@ struct zs_pool *zs_create_pool(const char *name, gfp_t flags);
 void zs_destroy_pool(struct zs_pool *pool);
 
 unsigned long zs_malloc(struct zs_pool *pool, size_t size);
-void zs_free(struct zs_pool *pool, unsigned long obj);
+void zs_free(struct zs_pool *pool, unsigned long handle);
 
 void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 			enum zs_mapmode mm);
@@ -40,4 +40,7 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle);
 
 u64 zs_get_total_size_bytes(struct zs_pool *pool);
 
+unsigned long zs_compact(struct zs_pool *pool);
+unsigned long zs_get_compacted_pages(struct zs_pool *pool);
+
 #endif
@@ -22,6 +22,7 @@
 #include <linux/err.h>
 #include <linux/pm.h>
 #include <linux/mfd/pm8xxx/pm8xxx-adc.h>
+#include <linux/perf_telemetry.h>
 
 #include <mach/msm_iomap.h>
 #include <mach/socinfo.h>
@@ -219,6 +220,7 @@ static void tsens8960_get_temp(int sensor_num, unsigned long *temp)
 	code = readl_relaxed(sensor_addr + offset +
 			(sensor_num << TSENS_STATUS_ADDR_OFFSET));
 	*temp = tsens_tz_code_to_degC(code, sensor_num);
+	perf_tm_log(PERF_TM_TEMP, sensor_num, *temp, 0);
 }
 
 static int tsens_tz_get_temp(struct thermal_zone_device *thermal,
@@ -21,14 +21,68 @@
 #include <linux/cpufreq.h>
 #include <linux/msm_tsens.h>
 #include <linux/msm_thermal.h>
+#include <linux/notifier.h>
 #include <mach/cpufreq.h>
 #include <mach/perflock.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/msm_thermal.h>
+
+/*
+ * Each zone keeps its last few readings.  The slope over that window is
+ * used to predict the temperature predict_ms ahead, and the mitigation
+ * level moves by one step per poll: down while the prediction is over
+ * the limit, up once both the reading and the prediction are below the
+ * hysteresis band.  That settles on the highest level the zone can hold
+ * instead of bouncing between no limit and limit_freq.
+ *
+ * Level n limits the cpus to the n-th frequency below the top of the
+ * cpufreq table and is handed to the GPU notifier chain, which KGSL maps
+ * to its thermal pwrlevel.  A reading at or above limit_temp throttles
+ * at least to limit_freq, like before.
+ */
+
+#define THERM_HISTORY	8
+#define THERM_MAX_FREQS	32
+
+struct therm_zone {
+	uint32_t sensor;
+	long temp[THERM_HISTORY];
+	unsigned long stamp[THERM_HISTORY];
+	int count;
+	int next;
+};
+
 static int enabled;
 static struct msm_thermal_data msm_thermal_info;
 static uint32_t limited_max_freq = MSM_CPUFREQ_NO_LIMIT;
 static struct delayed_work check_temp_work;
 
+static struct therm_zone zones[TSENS_MAX_SENSORS];
+static int nr_zones;
+
+static unsigned int cpu_freqs[THERM_MAX_FREQS];
+static int nr_cpu_freqs;
+static unsigned int mitigation;
+
+static unsigned int predict_ms = 5000;
+module_param(predict_ms, uint, 0644);
+MODULE_PARM_DESC(predict_ms, "how far ahead the temperature is predicted");
+
+static BLOCKING_NOTIFIER_HEAD(gpu_notifier);
+
+int msm_thermal_register_gpu_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&gpu_notifier, nb);
+}
+EXPORT_SYMBOL(msm_thermal_register_gpu_notifier);
+
+int msm_thermal_unregister_gpu_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&gpu_notifier, nb);
+}
+EXPORT_SYMBOL(msm_thermal_unregister_gpu_notifier);
+
 static int update_cpu_max_freq(int cpu, uint32_t max_freq)
 {
 	int ret = 0;
@@ -43,51 +97,166 @@ static int update_cpu_max_freq(int cpu, uint32_t max_freq)
 
 	limited_max_freq = max_freq;
 	if (max_freq != MSM_CPUFREQ_NO_LIMIT)
-		pr_info("msm_thermal: Limiting cpu%d max frequency to %d\n",
+		pr_debug("msm_thermal: Limiting cpu%d max frequency to %d\n",
 				cpu, max_freq);
 	else
-		pr_info("msm_thermal: Max frequency reset for cpu%d\n", cpu);
+		pr_debug("msm_thermal: Max frequency reset for cpu%d\n", cpu);
 
 	return ret;
 }
 
+/* Distinct cpufreq frequencies, highest first, once cpufreq is up */
+static int init_cpu_freqs(void)
+{
+	struct cpufreq_frequency_table *table;
+	unsigned int last = UINT_MAX;
+	int i;
+
+	if (nr_cpu_freqs)
+		return 0;
+
+	table = cpufreq_frequency_get_table(0);
+	if (!table)
+		return -EAGAIN;
+
+	while (nr_cpu_freqs < THERM_MAX_FREQS) {
+		unsigned int next = 0;
+
+		for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+			unsigned int f = table[i].frequency;
+
+			if (f != CPUFREQ_ENTRY_INVALID && f < last && f > next)
+				next = f;
+		}
+		if (!next)
+			break;
+		cpu_freqs[nr_cpu_freqs++] = next;
+		last = next;
+	}
+
+	return nr_cpu_freqs ? 0 : -EINVAL;
+}
+
+static uint32_t level_to_freq(unsigned int level)
+{
+	if (!level)
+		return MSM_CPUFREQ_NO_LIMIT;
+	if (!nr_cpu_freqs)
+		return msm_thermal_info.limit_freq;
+
+	return cpu_freqs[min_t(int, level, nr_cpu_freqs - 1)];
+}
+
+/* The first level that is at or below limit_freq */
+static unsigned int limit_freq_level(void)
+{
+	unsigned int level;
+
+	for (level = 1; level < nr_cpu_freqs; level++)
+		if (cpu_freqs[level] <= msm_thermal_info.limit_freq)
+			break;
+
+	return level;
+}
+
+static unsigned int max_level(void)
+{
+	return nr_cpu_freqs > 1 ? nr_cpu_freqs - 1 : 1;
+}
+
+/* Returns the predicted temperature in millidegrees */
+static long zone_update(struct therm_zone *zone, long temp)
+{
+	int oldest;
+	long slope = 0, predicted;
+	unsigned long dt;
+
+	zone->temp[zone->next] = temp;
+	zone->stamp[zone->next] = jiffies;
+	zone->next = (zone->next + 1) % THERM_HISTORY;
+	if (zone->count < THERM_HISTORY)
+		zone->count++;
+
+	oldest = zone->count < THERM_HISTORY ? 0 : zone->next;
+	dt = jiffies_to_msecs(jiffies - zone->stamp[oldest]);
+	if (dt)
+		slope = (temp - zone->temp[oldest]) * 1000 * 1000 / (long) dt;
+
+	predicted = temp * 1000 + slope * (long) predict_ms / 1000;
+	trace_msm_thermal_zone(zone->sensor, temp, slope, predicted);
+
+	return predicted;
+}
+
+static void set_mitigation(unsigned int level, long temp, long predicted)
+{
+	uint32_t max_freq = level_to_freq(level);
+	int cpu;
+	int ret;
+
+	trace_msm_thermal_throttle(level, max_freq, temp, predicted);
+
+	if (max_freq != limited_max_freq) {
+		for_each_possible_cpu(cpu) {
+			ret = update_cpu_max_freq(cpu, max_freq);
+			if (ret)
+				pr_debug("Unable to limit cpu%d max freq to %d\n",
+						cpu, max_freq);
+		}
+	}
+
+	if (level != mitigation) {
+		if (!mitigation || !level)
+			pr_info("msm_thermal: %s at %ld C, max freq %u\n",
+				level ? "Throttling" : "Throttle released",
+				temp, max_freq);
+		blocking_notifier_call_chain(&gpu_notifier, level, NULL);
+	}
+	mitigation = level;
+}
+
 static void check_temp(struct work_struct *work)
 {
-	struct tsens_device tsens_dev;
-	unsigned long temp = 0;
-	uint32_t max_freq = limited_max_freq;
-	int cpu = 0;
-	int ret = 0;
+	long limit = msm_thermal_info.limit_temp;
+	long release = limit - msm_thermal_info.temp_hysteresis;
+	long hottest = LONG_MIN, predicted = LONG_MIN;
+	unsigned int level = mitigation;
+	int i;
 
-	tsens_dev.sensor_num = msm_thermal_info.sensor_id;
-	ret = tsens_get_temp(&tsens_dev, &temp);
-	if (ret) {
-		pr_debug("msm_thermal: Unable to read TSENS sensor %d\n",
-				tsens_dev.sensor_num);
-		goto reschedule;
+	for (i = 0; i < nr_zones; i++) {
+		unsigned long temp = 0;
+		long p;
+
+		if (tsens_get_sensor_temp(zones[i].sensor, &temp)) {
+			pr_debug("msm_thermal: Unable to read TSENS sensor %d\n",
+					zones[i].sensor);
+			continue;
+		}
+
+		p = zone_update(&zones[i], temp);
+		hottest = max(hottest, (long) temp);
+		predicted = max(predicted, p);
 	}
-	if (temp >= msm_thermal_info.limit_temp) {
-		max_freq = msm_thermal_info.limit_freq;
-                pr_info("msm_thermal: TSENS sensor %d (%ld C)\n",
-				tsens_dev.sensor_num, temp);
+	if (hottest == LONG_MIN)
+		goto reschedule;
+
+	init_cpu_freqs();
+
+	if (predicted >= limit * 1000)
+		level++;
+	else if (level && hottest < release && predicted < release * 1000)
+		level--;
+
+	if (hottest >= limit) {
+		level = max(level, limit_freq_level());
 #ifdef CONFIG_PERFLOCK_BOOT_LOCK
 		release_boot_lock();
 #endif
 	}
-	else if (temp <
-		msm_thermal_info.limit_temp - msm_thermal_info.temp_hysteresis)
-		max_freq = MSM_CPUFREQ_NO_LIMIT;
+	level = min(level, max_level());
 
-	if (max_freq == limited_max_freq)
-		goto reschedule;
-
-	
-	for_each_possible_cpu(cpu) {
-		ret = update_cpu_max_freq(cpu, max_freq);
-		if (ret)
-			pr_debug("Unable to limit cpu%d max freq to %d\n",
-					cpu, max_freq);
-	}
+	if (level != mitigation || level_to_freq(level) != limited_max_freq)
+		set_mitigation(level, hottest, predicted);
 
 reschedule:
 	if (enabled)
@@ -107,6 +276,11 @@ static void disable_msm_thermal(void)
 	for_each_possible_cpu(cpu) {
 		update_cpu_max_freq(cpu, MSM_CPUFREQ_NO_LIMIT);
 	}
+
+	if (mitigation) {
+		mitigation = 0;
+		blocking_notifier_call_chain(&gpu_notifier, 0, NULL);
+	}
 }
 
 static int set_enabled(const char *val, const struct kernel_param *kp)
@@ -135,11 +309,17 @@ MODULE_PARM_DESC(enabled, "enforce thermal limit on cpu");
 int __init msm_thermal_init(struct msm_thermal_data *pdata)
 {
 	int ret = 0;
+	int i;
 
 	BUG_ON(!pdata);
 	BUG_ON(pdata->sensor_id >= TSENS_MAX_SENSORS);
 	memcpy(&msm_thermal_info, pdata, sizeof(struct msm_thermal_data));
 
+	zones[nr_zones++].sensor = pdata->sensor_id;
+	for (i = 0; i < TSENS_MAX_SENSORS; i++)
+		if ((pdata->zone_mask & BIT(i)) && i != pdata->sensor_id)
+			zones[nr_zones++].sensor = i;
+
 	enabled = 1;
 	INIT_DELAYED_WORK(&check_temp_work, check_temp);
 	schedule_delayed_work(&check_temp_work, 0);
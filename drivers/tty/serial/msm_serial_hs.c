@@ -67,6 +67,14 @@ static int hs_serial_debug_mask = 1;
 module_param_named(debug_mask, hs_serial_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Clock off is held back this long after the last rx or tx when the
+ * clock came straight back on the last time it went off; the hold
+ * doubles every time that happens again and halves when it does not.
+ */
+static unsigned int clk_off_hold_max_ms = 64;
+module_param(clk_off_hold_max_ms, uint, S_IRUGO | S_IWUSR);
+
 enum flush_reason {
 	FLUSH_NONE,
 	FLUSH_DATA_READY,
@@ -113,7 +121,10 @@ struct msm_hs_rx {
 	u32 *command_ptr_ptr;
 	dma_addr_t mapped_cmd_ptr;
 	wait_queue_head_t wait;
-	dma_addr_t rbuffer;
+	/* Transfers alternate between the two, see msm_hs_start_rx_locked */
+	dma_addr_t rbuffer[2];
+	unsigned char *rx_buf[2];
+	unsigned int dma_buf;
 	unsigned char *buffer;
 	unsigned int buffer_pending;
 	struct dma_pool *pool;
@@ -155,6 +166,10 @@ struct msm_hs_port {
 	int dma_rx_crci;
 	struct hrtimer clk_off_timer;  
 	ktime_t clk_off_delay;
+	ktime_t clk_off_retry;
+	ktime_t last_active;
+	ktime_t clk_off_at;
+	unsigned int clk_off_hold_ms;
 	enum msm_hs_clk_states_e clk_state;
 	enum msm_hs_clk_req_off_state_e clk_req_off_state;
 
@@ -401,8 +416,10 @@ static int __devexit msm_hs_remove(struct platform_device *pdev)
 
 	dma_unmap_single(dev, msm_uport->rx.mapped_cmd_ptr, sizeof(dmov_box),
 			 DMA_TO_DEVICE);
-	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.buffer,
-		      msm_uport->rx.rbuffer);
+	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.rx_buf[1],
+		      msm_uport->rx.rbuffer[1]);
+	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.rx_buf[0],
+		      msm_uport->rx.rbuffer[0]);
 	dma_pool_destroy(msm_uport->rx.pool);
 
 	dma_unmap_single(dev, msm_uport->rx.cmdptr_dmaaddr, sizeof(u32),
@@ -832,9 +849,14 @@ static void msm_hs_submit_tx_locked(struct uart_port *uport)
 	msm_dmov_enqueue_cmd(msm_uport->dma_tx_channel, &tx->xfer);
 }
 
+/*
+ * Every transfer goes to the other buffer, so the rx tasklet can start
+ * the next one before it copies the last one into the tty.
+ */
 static void msm_hs_start_rx_locked(struct uart_port *uport)
 {
 	struct msm_hs_port *msm_uport = UARTDM_TO_MSM(uport);
+	struct msm_hs_rx *rx = &msm_uport->rx;
 	unsigned int buffer_pending = msm_uport->rx.buffer_pending;
 	unsigned int data;
 
@@ -843,6 +865,11 @@ static void msm_hs_start_rx_locked(struct uart_port *uport)
 		printk(KERN_ERR "Error: rx started in buffer state = %x",
 		       buffer_pending);
 
+	rx->dma_buf ^= 1;
+	rx->command_ptr->dst_row_addr = rx->rbuffer[rx->dma_buf];
+	dma_sync_single_for_device(uport->dev, rx->mapped_cmd_ptr,
+				   sizeof(dmov_box), DMA_TO_DEVICE);
+
 	msm_hs_write(uport, UARTDM_CR_ADDR, RESET_STALE_INT);
 	msm_hs_write(uport, UARTDM_DMRX_ADDR, UARTDM_RX_BUF_SIZE);
 	msm_hs_write(uport, UARTDM_CR_ADDR, STALE_EVENT_ENABLE);
@@ -925,6 +952,7 @@ static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 	struct uart_port *uport;
 	struct msm_hs_port *msm_uport;
 	unsigned int flush;
+	bool restarted = false;
 	struct tty_struct *tty;
 
 	msm_uport = container_of((struct tasklet_struct *)tlet_ptr,
@@ -984,10 +1012,24 @@ static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 	
 	rmb();
 
+	msm_uport->rx.buffer = msm_uport->rx.rx_buf[msm_uport->rx.dma_buf];
+	if (rx_count)
+		msm_uport->last_active = ktime_get();
+
+	/* Room for all of it means nothing will be left pending */
+	if (!msm_uport->rx.buffer_pending && (uport->read_status_mask & CREAD) &&
+	    tty_buffer_request_room(tty, rx_count) >= rx_count) {
+		msm_hs_start_rx_locked(uport);
+		restarted = true;
+	}
+
 	if (0 != (uport->read_status_mask & CREAD)) {
 		retval = tty_insert_flip_string(tty, msm_uport->rx.buffer,
 						rx_count);
-		if (retval != rx_count) {
+		/* Already receiving into the other buffer, cannot hold it */
+		if (retval != rx_count && restarted) {
+			uport->icount.buf_overrun++;
+		} else if (retval != rx_count) {
 			msm_uport->rx.buffer_pending |= CHARS_NORMAL |
 				retval << 5 | (rx_count - retval) << 16;
 		}
@@ -996,7 +1038,7 @@ static void msm_serial_hs_rx_tlet(unsigned long tlet_ptr)
 	
 	wmb();
 
-	if (!msm_uport->rx.buffer_pending)
+	if (!restarted && !msm_uport->rx.buffer_pending)
 		msm_hs_start_rx_locked(uport);
 
 out:
@@ -1178,9 +1220,11 @@ static int msm_hs_check_clock_off(struct uart_port *uport)
 	unsigned long flags;
 	struct msm_hs_port *msm_uport = UARTDM_TO_MSM(uport);
 	struct circ_buf *tx_buf = &uport->state->xmit;
+	s64 idle_us;
 
 	mutex_lock(&msm_uport->clk_mutex);
 	spin_lock_irqsave(&uport->lock, flags);
+	msm_uport->clk_off_retry = msm_uport->clk_off_delay;
 
 	if (msm_uport->clk_state != MSM_HS_CLK_REQUEST_OFF ||
 	    !uart_circ_empty(tx_buf) || msm_uport->tx.dma_in_flight ||
@@ -1201,6 +1245,15 @@ static int msm_hs_check_clock_off(struct uart_port *uport)
 	
 	switch (msm_uport->clk_req_off_state) {
 	case CLK_REQ_OFF_START:
+		idle_us = ktime_us_delta(ktime_get(), msm_uport->last_active);
+		if (idle_us < msm_uport->clk_off_hold_ms * USEC_PER_MSEC) {
+			msm_uport->clk_off_retry = ns_to_ktime(
+				(msm_uport->clk_off_hold_ms * USEC_PER_MSEC -
+				 idle_us) * NSEC_PER_USEC);
+			spin_unlock_irqrestore(&uport->lock, flags);
+			mutex_unlock(&msm_uport->clk_mutex);
+			return 0;
+		}
 		msm_uport->clk_req_off_state = CLK_REQ_OFF_RXSTALE_ISSUED;
 		msm_hs_write(uport, UARTDM_CR_ADDR, FORCE_STALE_EVENT);
 		mb();
@@ -1233,6 +1286,7 @@ static int msm_hs_check_clock_off(struct uart_port *uport)
 		clk_disable_unprepare(msm_uport->pclk);
 
 	msm_uport->clk_state = MSM_HS_CLK_OFF;
+	msm_uport->clk_off_at = ktime_get();
 
 	spin_lock_irqsave(&uport->lock, flags);
 	if (use_low_power_wakeup(msm_uport)) {
@@ -1254,7 +1308,7 @@ static void hsuart_clock_off_work(struct work_struct *w)
 
 	if (!msm_hs_check_clock_off(uport)) {
 		hrtimer_start(&msm_uport->clk_off_timer,
-				msm_uport->clk_off_delay,
+				msm_uport->clk_off_retry,
 				HRTIMER_MODE_REL);
 	}
 }
@@ -1320,6 +1374,7 @@ static irqreturn_t msm_hs_isr(int irq, void *dev)
 		tx_buf->tail = (tx_buf->tail + tx->tx_count) & ~UART_XMIT_SIZE;
 
 		tx->dma_in_flight = 0;
+		msm_uport->last_active = ktime_get();
 
 		uport->icount.tx += tx->tx_count;
 		if (tx->tx_ready_int_en)
@@ -1361,6 +1416,19 @@ void msm_hs_request_clock_off(struct uart_port *uport) {
 }
 EXPORT_SYMBOL(msm_hs_request_clock_off);
 
+/* Called with the clock off, before it comes back on */
+static void msm_hs_update_clk_off_hold(struct msm_hs_port *msm_uport)
+{
+	unsigned int hold = msm_uport->clk_off_hold_ms;
+	s64 off_us = ktime_us_delta(ktime_get(), msm_uport->clk_off_at);
+
+	if (off_us < clk_off_hold_max_ms * USEC_PER_MSEC)
+		hold = hold ? hold * 2 : 2;
+	else
+		hold /= 2;
+	msm_uport->clk_off_hold_ms = min(hold, clk_off_hold_max_ms);
+}
+
 void msm_hs_request_clock_on(struct uart_port *uport)
 {
 	struct msm_hs_port *msm_uport = UARTDM_TO_MSM(uport);
@@ -1373,6 +1441,7 @@ void msm_hs_request_clock_on(struct uart_port *uport)
 
 	switch (msm_uport->clk_state) {
 	case MSM_HS_CLK_OFF:
+		msm_hs_update_clk_off_hold(msm_uport);
 		wake_lock(&msm_uport->dma_wake_lock);
 		disable_irq_nosync(msm_uport->wakeup.irq);
 		spin_unlock_irqrestore(&uport->lock, flags);
@@ -1642,13 +1711,22 @@ static int uartdm_init_port(struct uart_port *uport)
 		goto exit_tasket_init;
 	}
 
-	rx->buffer = dma_pool_alloc(rx->pool, GFP_KERNEL, &rx->rbuffer);
-	if (!rx->buffer) {
+	rx->rx_buf[0] = dma_pool_alloc(rx->pool, GFP_KERNEL, &rx->rbuffer[0]);
+	if (!rx->rx_buf[0]) {
 		pr_err("%s(): cannot allocate rx->buffer", __func__);
 		ret = -ENOMEM;
 		goto free_pool;
 	}
 
+	rx->rx_buf[1] = dma_pool_alloc(rx->pool, GFP_KERNEL, &rx->rbuffer[1]);
+	if (!rx->rx_buf[1]) {
+		pr_err("%s(): cannot allocate rx->buffer", __func__);
+		ret = -ENOMEM;
+		goto free_rx_buffer0;
+	}
+	rx->buffer = rx->rx_buf[0];
+	rx->dma_buf = 1;
+
 	
 	rx->command_ptr = kmalloc(sizeof(dmov_box), GFP_KERNEL | __GFP_DMA);
 	if (!rx->command_ptr) {
@@ -1667,7 +1745,7 @@ static int uartdm_init_port(struct uart_port *uport)
 	rx->command_ptr->num_rows = ((UARTDM_RX_BUF_SIZE >> 4) << 16) |
 					 (UARTDM_RX_BUF_SIZE >> 4);
 
-	rx->command_ptr->dst_row_addr = rx->rbuffer;
+	rx->command_ptr->dst_row_addr = rx->rbuffer[0];
 
 	
 	msm_hs_write(uport, UARTDM_RFWR_ADDR, 0);
@@ -1699,8 +1777,12 @@ free_rx_command_ptr:
 	kfree(rx->command_ptr);
 
 free_rx_buffer:
-	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.buffer,
-			msm_uport->rx.rbuffer);
+	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.rx_buf[1],
+			msm_uport->rx.rbuffer[1]);
+
+free_rx_buffer0:
+	dma_pool_free(msm_uport->rx.pool, msm_uport->rx.rx_buf[0],
+			msm_uport->rx.rbuffer[0]);
 
 free_pool:
 	dma_pool_destroy(msm_uport->rx.pool);
@@ -1841,6 +1923,7 @@ static int __devinit msm_hs_probe(struct platform_device *pdev)
 		     HRTIMER_MODE_REL);
 	msm_uport->clk_off_timer.function = msm_hs_clk_off_retry;
 	msm_uport->clk_off_delay = ktime_set(0, 1000000);  
+	msm_uport->clk_off_retry = msm_uport->clk_off_delay;
 
 	ret = sysfs_create_file(&pdev->dev.kobj, &dev_attr_clock.attr);
 	if (unlikely(ret))
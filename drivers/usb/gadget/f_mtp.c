@@ -45,8 +45,8 @@
 #define STATE_CANCELED              3   
 #define STATE_ERROR                 4   
 
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+#define TX_REQ_MAX 16
+#define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
 #define MTP_OS_STRING_ID   0xEE
@@ -61,6 +61,27 @@
 
 static int htc_mtp_performance_debug;
 static int mtp_qos;
+
+/* Bulk request sizes and counts, read when the function binds */
+static unsigned int mtp_tx_req_len = 65536;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "MTP IN request length in bytes");
+
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "MTP IN requests in flight");
+
+static unsigned int mtp_rx_req_len = 65536;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "MTP OUT request length in bytes");
+
+static unsigned int mtp_rx_reqs = 4;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "MTP OUT requests, one more than in flight");
+
+static bool mtp_perf_lock_on_xfer;
+module_param(mtp_perf_lock_on_xfer, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_perf_lock_on_xfer, "Hold perflock for file transfers");
 #ifdef CONFIG_PERFLOCK
 #include <mach/perflock.h>
 #endif
@@ -93,6 +114,10 @@ struct mtp_dev {
 	struct usb_request *rx_req[RX_REQ_MAX];
 	int rx_done;
 
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned rx_reqs;
+
 	struct workqueue_struct *wq;
 	struct work_struct send_file_work;
 	struct work_struct receive_file_work;
@@ -411,7 +436,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
+	dev->rx_done++;
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
@@ -470,17 +495,40 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	dev->tx_req_len = rounddown(max_t(unsigned, mtp_tx_req_len,
+				MTP_BULK_BUFFER_SIZE), MTP_BULK_BUFFER_SIZE);
+	dev->rx_req_len = rounddown(max_t(unsigned, mtp_rx_req_len,
+				MTP_BULK_BUFFER_SIZE), MTP_BULK_BUFFER_SIZE);
+	dev->rx_reqs = clamp_t(unsigned, mtp_rx_reqs, 2, RX_REQ_MAX);
+
+	/* Fall back to the small buffers when memory is fragmented */
+retry_tx_alloc:
+	for (i = 0; i < clamp_t(unsigned, mtp_tx_reqs, 1, TX_REQ_MAX); i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len == MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_tx_alloc;
+		}
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+retry_rx_alloc:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len == MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
@@ -729,8 +777,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -794,8 +842,8 @@ static void receive_file_work(struct work_struct *data)
 	struct usb_request *read_req = NULL, *write_req = NULL;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, to_queue;
+	int ret, head = 0, queued = 0, depth, done = 0;
 	int r = 0;
 	long diff = 0;
 
@@ -809,23 +857,31 @@ static void receive_file_work(struct work_struct *data)
 	if (htc_mtp_performance_debug)
 		do_gettimeofday(&dev->st0);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/*
+	 * With a known length keep all but one buffer queued while the
+	 * last one is written out.  An unknown length ends on a short
+	 * packet, so only one read may be outstanding then.
+	 */
+	to_queue = count;
+	depth = (count == 0xFFFFFFFF) ? 1 : dev->rx_reqs - 1;
+	dev->rx_done = 0;
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
+	while (to_queue > 0 || queued || write_req) {
+		while (to_queue > 0 && queued < depth) {
+			read_req = dev->rx_req[(head + queued) % dev->rx_reqs];
+			read_req->length = (to_queue > dev->rx_req_len
+					? dev->rx_req_len : to_queue);
 			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
 			if (ret < 0) {
 				INFO(cdev, "%s(%d) usb_ep_queue error, ret:%d\n",__func__, __LINE__, ret);
 				r = -EIO;
 				if (dev->state != STATE_OFFLINE)
 					dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			if (count != 0xFFFFFFFF)
+				to_queue -= read_req->length;
+			queued++;
 		}
 
 		if (write_req) {
@@ -838,31 +894,56 @@ static void receive_file_work(struct work_struct *data)
 				INFO(cdev, "%s(%d) vfs_write error, ret:%d\n",__func__, __LINE__, ret);
 				if (dev->state != STATE_OFFLINE)
 					dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
 			write_req = NULL;
 		}
 
-		if (read_req) {
+		if (queued) {
+			read_req = dev->rx_req[head];
 			
 			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
+				dev->rx_done > done || dev->state != STATE_BUSY);
 			if (dev->state == STATE_CANCELED) {
 				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
+				goto out;
 			}
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
+			if (dev->rx_done <= done || read_req->status) {
+				r = -EIO;
+				goto out;
+			}
+			done++;
+			head = (head + 1) % dev->rx_reqs;
+			queued--;
+
 			if (read_req->actual < read_req->length) {
 				DBG(cdev, "got short packet\n");
-				count = 0;
+				to_queue = 0;
 			}
 
 			write_req = read_req;
 			read_req = NULL;
 		}
+
+		/* The host ended the transfer early */
+		if (!to_queue && queued && write_req &&
+		    write_req->actual < write_req->length)
+			break;
+	}
+
+out:
+	while (queued--) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[head]);
+		head = (head + 1) % dev->rx_reqs;
+	}
+	if (!r && write_req) {
+		ret = vfs_write(filp, write_req->buf, write_req->actual,
+			&offset);
+		if (ret != write_req->actual) {
+			r = -EIO;
+			if (dev->state != STATE_OFFLINE)
+				dev->state = STATE_ERROR;
+		}
 	}
 
 	DBG(cdev, "receive_file_work returning %d\n", r);
@@ -927,7 +1008,8 @@ static long mtp_ioctl(struct file *fp, unsigned code, unsigned long value)
 			struct mtp_file_range	mfr;
 			struct work_struct *work;
 #ifdef CONFIG_PERFLOCK
-			mtp_setup_perflock(true);
+			if (mtp_perf_lock_on_xfer)
+				mtp_setup_perflock(true);
 #endif
 			spin_lock_irq(&dev->lock);
 			if (dev->state == STATE_CANCELED) {
@@ -1202,8 +1284,10 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < RX_REQ_MAX; i++) {
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -41,6 +41,18 @@ struct f_rndis {
 	atomic_t			online;
 };
 
+/* Frames packed into one IN transfer, 1 disables aggregation */
+static unsigned int rndis_dl_max_pkt_per_xfer = 10;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+	"Maximum packets per transfer for DL aggregation");
+
+/* Frames the host may pack into one OUT transfer */
+static unsigned int rndis_ul_max_pkt_per_xfer = 3;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+	"Maximum packets per transfer for UL aggregation");
+
 static inline struct f_rndis *func_to_rndis(struct usb_function *f)
 {
 	return container_of(f, struct f_rndis, port.func);
@@ -403,6 +415,8 @@ static void rndis_command_complete(struct usb_ep *ep, struct usb_request *req)
 	if (status < 0)
 		ERROR(cdev, "RNDIS command error %d, %d/%d\n",
 			status, req->actual, req->length);
+
+	rndis->port.dl_max_xfer_size = rndis_get_dl_max_xfer_size(rndis->config);
 }
 
 static int
@@ -525,6 +539,13 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 
 		rndis->port.cdc_filter = 0;
 
+		rndis->port.dl_max_pkts_per_xfer = rndis_dl_max_pkt_per_xfer;
+		rndis->port.ul_max_pkts_per_xfer = rndis_ul_max_pkt_per_xfer;
+		rndis->port.dl_max_xfer_size =
+			rndis_get_dl_max_xfer_size(rndis->config);
+		rndis_set_max_pkt_xfer(rndis->config,
+				rndis_ul_max_pkt_per_xfer);
+
 		DBG(cdev, "RNDIS RX/TX early activation ... \n");
 		net = gether_connect(&rndis->port);
 		if (IS_ERR(net))
@@ -544,16 +544,19 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
-	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
+	resp->MaxPacketsPerTransfer = cpu_to_le32(params->ul_max_pkts_per_xfer);
+	resp->MaxTransferSize = cpu_to_le32(params->ul_max_pkts_per_xfer *
+		(params->dev->mtu
 		+ sizeof(struct ethhdr)
 		+ sizeof(struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
 
+	/* Largest transfer the host will take from us */
+	params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
+
 	params->resp_avail(params->v);
 	return 0;
 }
@@ -729,6 +732,7 @@ void rndis_uninit(int configNr)
 	if (configNr >= RNDIS_MAX_CONFIGS)
 		return;
 	rndis_per_dev_params[configNr].state = RNDIS_UNINITIALIZED;
+	rndis_per_dev_params[configNr].dl_max_xfer_size = 0;
 
 	
 	while ((buf = rndis_get_next_response(configNr, &length)))
@@ -841,6 +845,8 @@ int rndis_register(void (*resp_avail)(void *v), void *v)
 			rndis_per_dev_params[i].used = 1;
 			rndis_per_dev_params[i].resp_avail = resp_avail;
 			rndis_per_dev_params[i].v = v;
+			rndis_per_dev_params[i].ul_max_pkts_per_xfer = 1;
+			rndis_per_dev_params[i].dl_max_xfer_size = 0;
 			pr_debug("%s: configNr = %d\n", __func__, i);
 			return i;
 		}
@@ -894,6 +900,24 @@ int rndis_set_param_medium(u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+int rndis_set_max_pkt_xfer(u8 configNr, u32 max_pkt_per_xfer)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params[configNr].ul_max_pkts_per_xfer =
+		max_t(u32, max_pkt_per_xfer, 1);
+
+	return 0;
+}
+
+u32 rndis_get_dl_max_xfer_size(u8 configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS) return 0;
+
+	return rndis_per_dev_params[configNr].dl_max_xfer_size;
+}
+
 void rndis_add_hdr(struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type *header;
@@ -966,26 +990,52 @@ int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	
-	__le32 *tmp = (void *)skb->data;
+	/* A transfer may carry several packet messages back to back */
+	while (skb->len >= sizeof(struct rndis_packet_msg_type)) {
+		__le32		*tmp = (void *)skb->data;
+		struct sk_buff	*skb2;
+		u32		msg_len, data_offset, data_len;
+
+		if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			dev_kfree_skb_any(skb);
+			return -EINVAL;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+		data_offset = get_unaligned_le32(tmp++);
+		data_len = get_unaligned_le32(tmp++);
+
+		if (msg_len > skb->len)
+			msg_len = skb->len;
+		if (msg_len < sizeof(struct rndis_packet_msg_type) ||
+		    data_offset > msg_len - 8 ||
+		    data_len > msg_len - 8 - data_offset) {
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
 
-	
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+		/* Last message, anything after it is host padding */
+		if (skb->len - msg_len < sizeof(struct rndis_packet_msg_type)) {
+			skb_pull(skb, data_offset + 8);
+			skb_trim(skb, data_len);
+			skb_queue_tail(list, skb);
+			return 0;
+		}
 
-	
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_pull(skb2, data_offset + 8);
+		skb_trim(skb2, data_len);
+		skb_queue_tail(list, skb2);
+
+		skb_pull(skb, msg_len);
 	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
 
-	skb_queue_tail(list, skb);
-	return 0;
+	dev_kfree_skb_any(skb);
+	return -EINVAL;
 }
 
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
@@ -229,6 +229,9 @@ typedef struct rndis_params
 	void			(*resp_avail)(void *v);
 	void			*v;
 	struct list_head	resp_queue;
+
+	u32			ul_max_pkts_per_xfer;
+	u32			dl_max_xfer_size;
 } rndis_params;
 
 int  rndis_msg_parser (u8 configNr, u8 *buf);
@@ -239,6 +242,8 @@ int  rndis_set_param_dev (u8 configNr, struct net_device *dev,
 int  rndis_set_param_vendor (u8 configNr, u32 vendorID,
 			    const char *vendorDescr);
 int  rndis_set_param_medium (u8 configNr, u32 medium, u32 speed);
+int  rndis_set_max_pkt_xfer(u8 configNr, u32 max_pkt_per_xfer);
+u32  rndis_get_dl_max_xfer_size(u8 configNr);
 void rndis_add_hdr (struct sk_buff *skb);
 int rndis_rm_hdr(struct gether *port, struct sk_buff *skb,
 			struct sk_buff_head *list);
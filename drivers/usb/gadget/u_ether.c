@@ -14,6 +14,7 @@
 
 #include <linux/kernel.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
 #include <linux/device.h>
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
@@ -54,6 +55,12 @@ struct eth_dev {
 
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
+
+	/* IN aggregation, tx requests own tx_req_bufsize byte buffers */
+	unsigned		dl_max_pkts_per_xfer;
+	unsigned		tx_req_bufsize;
+	unsigned		tx_skb_hold_count;
+	unsigned		tx_reqs_in_flight;
 };
 
 
@@ -182,6 +189,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->port_usb->ul_max_pkts_per_xfer > 1)
+		size *= dev->port_usb->ul_max_pkts_per_xfer;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -323,6 +332,44 @@ extra:
 	return 0;
 }
 
+static void tx_aggr_complete(struct usb_ep *ep, struct usb_request *req);
+
+static void alloc_tx_buffers(struct eth_dev *dev, struct gether *link)
+{
+	struct usb_request	*req;
+	unsigned		size;
+
+	dev->tx_req_bufsize = 0;
+	dev->tx_skb_hold_count = 0;
+	dev->tx_reqs_in_flight = 0;
+	if (link->dl_max_pkts_per_xfer <= 1)
+		return;
+
+	size = link->dl_max_pkts_per_xfer *
+		(dev->net->mtu + sizeof(struct ethhdr) + link->header_len);
+
+	/* One spare byte so a short packet can always end the transfer */
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		req->buf = kmalloc(size + 1, GFP_ATOMIC);
+		if (!req->buf)
+			goto fail;
+		req->length = 0;
+		req->complete = tx_aggr_complete;
+	}
+	dev->tx_req_bufsize = size;
+	dev->dl_max_pkts_per_xfer = link->dl_max_pkts_per_xfer;
+	return;
+
+fail:
+	DBG(dev, "no tx aggregation buffers\n");
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		if (!req->buf)
+			break;
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+}
+
 static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 {
 	int	status;
@@ -334,6 +381,7 @@ static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 	status = prealloc(&dev->rx_reqs, link->out_ep, n);
 	if (status < 0)
 		goto fail;
+	alloc_tx_buffers(dev, link);
 	goto done;
 fail:
 	DBG(dev, "can't alloc requests\n");
@@ -416,6 +464,73 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static int tx_aggr_queue(struct eth_dev *dev, struct usb_ep *in,
+			struct usb_request *req, unsigned pkts)
+{
+	unsigned long	flags;
+	int		retval;
+
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+	req->zero = 1;
+	req->no_interrupt = 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (retval) {
+		DBG(dev, "tx queue err %d\n", retval);
+		dev->net->stats.tx_dropped += pkts;
+		spin_lock_irqsave(&dev->req_lock, flags);
+		dev->tx_reqs_in_flight--;
+		req->length = 0;
+		if (list_empty(&dev->tx_reqs))
+			netif_start_queue(dev->net);
+		list_add_tail(&req->list, &dev->tx_reqs);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+	} else {
+		dev->net->trans_start = jiffies;
+	}
+	return retval;
+}
+
+static void tx_aggr_complete(struct usb_ep *ep, struct usb_request *req)
+{
+	struct eth_dev		*dev = ep->driver_data;
+	struct usb_request	*held = NULL;
+	unsigned		pkts = 0;
+
+	if (req->status && req->status != -ECONNRESET &&
+	    req->status != -ESHUTDOWN) {
+		dev->net->stats.tx_errors++;
+		VDBG(dev, "tx err %d\n", req->status);
+	}
+
+	spin_lock(&dev->req_lock);
+	dev->tx_reqs_in_flight--;
+	req->length = 0;
+	list_add_tail(&req->list, &dev->tx_reqs);
+
+	/* Flush frames held back while this transfer was busy */
+	if (!req->status) {
+		held = container_of(dev->tx_reqs.next,
+				struct usb_request, list);
+		if (held->length) {
+			list_del(&held->list);
+			pkts = dev->tx_skb_hold_count;
+			dev->tx_skb_hold_count = 0;
+			dev->tx_reqs_in_flight++;
+		} else {
+			held = NULL;
+		}
+	}
+	spin_unlock(&dev->req_lock);
+
+	if (held)
+		tx_aggr_queue(dev, ep, held, pkts);
+
+	if (netif_carrier_ok(dev->net))
+		netif_wake_queue(dev->net);
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context;
@@ -448,6 +563,77 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+static netdev_tx_t eth_aggr_xmit(struct eth_dev *dev, struct sk_buff *skb,
+					struct usb_ep *in)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req;
+	unsigned long		flags;
+	unsigned		max_frame, limit = 0, pkts;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (list_empty(&dev->tx_reqs)) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return NETDEV_TX_BUSY;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb) {
+		if (dev->wrap)
+			skb = dev->wrap(dev->port_usb, skb);
+		limit = dev->port_usb->dl_max_xfer_size;
+	} else {
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	max_frame = net->mtu + sizeof(struct ethhdr) + dev->header_len;
+	if (skb && skb->len > max_frame) {
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+	if (!skb) {
+		net->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+
+	/* Frames go out one by one until the host reports its limit */
+	if (!limit)
+		limit = max_frame;
+	limit = min(limit, dev->tx_req_bufsize);
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = container_of(dev->tx_reqs.next, struct usb_request, list);
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	net->stats.tx_packets++;
+	net->stats.tx_bytes += skb->len;
+	dev->tx_skb_hold_count++;
+
+	/* Keep filling while a transfer is busy, its completion flushes us */
+	if (dev->tx_reqs_in_flight &&
+	    dev->tx_skb_hold_count < dev->dl_max_pkts_per_xfer &&
+	    req->length + max_frame <= limit) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		dev_kfree_skb_any(skb);
+		return NETDEV_TX_OK;
+	}
+
+	list_del(&req->list);
+	pkts = dev->tx_skb_hold_count;
+	dev->tx_skb_hold_count = 0;
+	dev->tx_reqs_in_flight++;
+	if (list_empty(&dev->tx_reqs))
+		netif_stop_queue(net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+	dev_kfree_skb_any(skb);
+
+	tx_aggr_queue(dev, in, req, pkts);
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
@@ -493,6 +679,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		
 	}
 
+	if (dev->tx_req_bufsize)
+		return eth_aggr_xmit(dev, skb, in);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	if (list_empty(&dev->tx_reqs)) {
 		spin_unlock_irqrestore(&dev->req_lock, flags);
@@ -864,9 +1053,12 @@ void gether_disconnect(struct gether *link)
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_req_bufsize)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
+	dev->tx_req_bufsize = 0;
 	spin_unlock(&dev->req_lock);
 	link->in_ep->driver_data = NULL;
 	link->in_ep->desc = NULL;
@@ -42,6 +42,10 @@ struct gether {
 	bool				is_fixed;
 	u32				fixed_out_len;
 	u32				fixed_in_len;
+	
+	u32				dl_max_pkts_per_xfer;
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
@@ -2797,6 +2797,7 @@ static int mdp_probe(struct platform_device *pdev)
 		mdp_hw_cursor_init();
 #endif
 		mdp_resource_initialized = 1;
+		device_enable_async_suspend(&pdev->dev);
 		return 0;
 	}
 
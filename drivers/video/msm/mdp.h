@@ -807,6 +807,7 @@ void mdp_hw_vsync_clk_enable(struct msm_fb_data_type *mfd);
 void mdp_hw_vsync_clk_disable(struct msm_fb_data_type *mfd);
 void mdp_vsync_clk_disable(void);
 void mdp_vsync_clk_enable(void);
+void mdp_vsync_notify(ktime_t vsync_time);
 #endif
 
 #ifdef CONFIG_DEBUG_FS
@@ -554,6 +554,7 @@ int mdp4_overlay_dtv_unset(struct msm_fb_data_type *mfd,
 void mdp4_dtv_overlay(struct msm_fb_data_type *mfd);
 int mdp4_dtv_on(struct platform_device *pdev);
 int mdp4_dtv_off(struct platform_device *pdev);
+void mdp4_dtv_bus_scale_release(void);
 void mdp4_atv_overlay(struct msm_fb_data_type *mfd);
 int mdp4_atv_on(struct platform_device *pdev);
 int mdp4_atv_off(struct platform_device *pdev);
@@ -952,6 +953,7 @@ int mdp4_calc_blt_mdp_bw(struct msm_fb_data_type *mfd,
 			 struct mdp4_overlay_pipe *pipe);
 int mdp4_overlay_mdp_perf_req(struct msm_fb_data_type *mfd);
 void mdp4_overlay_mdp_perf_upd(struct msm_fb_data_type *mfd, int flag);
+void mdp4_overlay_mdp_perf_cache(int mixer);
 int mdp4_overlay_reset(void);
 void mdp4_vg_csc_restore(void);
 
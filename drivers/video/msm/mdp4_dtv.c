@@ -152,6 +152,19 @@ static int dtv_off_sub(void)
 	return ret;
 }
 
+/*
+ * Drop the worst-case vote taken in dtv_on once the MDP client votes
+ * for the pipes actually staged on mixer1.
+ */
+void mdp4_dtv_bus_scale_release(void)
+{
+#ifdef CONFIG_MSM_BUS_SCALING
+	if (dtv_bus_scale_handle > 0)
+		msm_bus_scale_client_update_request(dtv_bus_scale_handle,
+							0);
+#endif
+}
+
 static void dtv_off_work_func(struct work_struct *work)
 {
 	dtv_off_sub();
@@ -38,6 +38,7 @@
 #include <linux/uaccess.h>
 #include <linux/mutex.h>
 #include <linux/msm_kgsl.h>
+#include <linux/frametime.h>
 #include "mdp.h"
 #include "msm_fb.h"
 #include "mdp4.h"
@@ -325,9 +326,14 @@ int mdp4_overlay_iommu_map_buf(int mem_id,
 	pr_debug("%s(): ion_hdl %p, ion_buf %d\n", __func__, *srcp_ihdl, mem_id);
 	pr_debug("mixer %u, pipe %u, plane %u\n", pipe->mixer_num,
 		pipe->pipe_ndx, plane);
+	/*
+	 * Gralloc cycles the same few buffers through each pipe: keep the
+	 * display mapping until ION destroys the buffer so later frames only
+	 * take a reference on it instead of mapping and unmapping again.
+	 */
 	if (ion_map_iommu(display_iclient, *srcp_ihdl,
 		DISPLAY_READ_DOMAIN, GEN_POOL, SZ_4K, 0, start,
-		len, 0, 0)) {
+		len, 0, ION_IOMMU_UNMAP_DELAYED)) {
 		ion_free(display_iclient, *srcp_ihdl);
 		pr_err("ion_map_iommu() failed\n");
 		return -EINVAL;
@@ -3299,6 +3305,32 @@ void mdp4_overlay_mdp_perf_upd(struct msm_fb_data_type *mfd,
 	return;
 }
 
+/*
+ * Drop the bus vote to what DMA_P needs to scan out a cached blt frame.
+ * The next mdp4_overlay_mdp_perf_upd(mfd, 1) restores the full request.
+ */
+void mdp4_overlay_mdp_perf_cache(int mixer)
+{
+	struct mdp4_overlay_perf *perf_req = &perf_request;
+	struct mdp4_overlay_perf *perf_cur = &perf_current;
+	u64 ab, ib, ab_port0 = 0, ab_port1 = 0;
+
+	ab = roundup(perf_req->mdp_ov_ab_bw[mixer] >> 1, MDP_BUS_SCALE_AB_STEP);
+	ib = roundup(perf_req->mdp_ov_ib_bw[mixer] >> 1, MDP_BUS_SCALE_AB_STEP);
+	if (ab >= perf_cur->mdp_ab_bw && ib >= perf_cur->mdp_ib_bw)
+		return;
+
+	if (mdp4_axi_port_read_client_mixer(mixer))
+		ab_port1 = ab;
+	else
+		ab_port0 = ab;
+
+	mdp_bus_scale_update_request(ab_port0, ib, ab_port1, ib);
+	pr_debug("%s: ab bw %llu ib bw %llu\n", __func__, ab, ib);
+	perf_cur->mdp_ab_bw = ab;
+	perf_cur->mdp_ib_bw = ib;
+}
+
 static int get_img(struct msmfb_data *img, struct fb_info *info,
 	struct mdp4_overlay_pipe *pipe, unsigned int plane,
 	unsigned long *start, unsigned long *len, struct file **srcp_file,
@@ -3887,6 +3919,8 @@ int mdp4_overlay_commit(struct fb_info *info)
 		ret = -EINVAL;
 		break;
 	}
+	if (!ret)
+		frametime_commit(mfd->index);
 	msm_fb_signal_timeline(mfd);
 
 	mdp4_overlay_mdp_perf_upd(mfd, 0);
@@ -22,6 +22,7 @@
 #include <linux/semaphore.h>
 #include <linux/spinlock.h>
 #include <linux/fb.h>
+#include <linux/frametime.h>
 #include <asm/system.h>
 #include <asm/mach-types.h>
 #include <mach/hardware.h>
@@ -64,6 +65,8 @@ static struct vsycn_ctrl {
 	struct msm_fb_data_type *mfd;
 	struct mdp4_overlay_pipe *base_pipe;
 	struct vsync_update vlist[2];
+	struct mdp_rect roi_req;	/* dirty region of the queued pan */
+	struct mdp_rect roi;		/* window the panel is set up for */
 	int vsync_enabled;
 	int clk_enabled;
 	int clk_control;
@@ -261,6 +264,59 @@ static void mdp4_dsi_cmd_pipe_clean(struct vsync_update *vp)
 static void mdp4_dsi_cmd_blt_ov_update(struct mdp4_overlay_pipe *pipe);
 static int mdp4_dsi_cmd_clk_check(struct vsycn_ctrl *vctrl);
 
+/*
+ * Pick the window for this kickoff.  Only a pan of the base layer with
+ * nothing staged above it can be cut down to its dirty region; anything
+ * else goes out full frame.  The queued copy of the base pipe is trimmed
+ * to the window so it fetches just the dirty rows and columns.
+ */
+static struct mdp4_overlay_pipe *mdp4_dsi_cmd_roi_select(
+			struct vsycn_ctrl *vctrl, struct vsync_update *vp,
+			struct mdp_rect *roi)
+{
+	struct mdp4_overlay_pipe *base = vctrl->base_pipe;
+	struct mdp4_overlay_pipe *pipe;
+	struct mdp_rect *req = &vctrl->roi_req;
+	int stage;
+
+	roi->x = 0;
+	roi->y = 0;
+	roi->w = base->src_width;
+	roi->h = base->src_height;
+
+	pipe = &vp->plist[base->pipe_ndx - 1];
+	if (!vctrl->mfd->panel_info.mipi.partial_update || !pipe->pipe_used ||
+	    !req->w || base->ov_blt_addr || base->is_3d)
+		goto out;
+
+	for (stage = MDP4_MIXER_STAGE0; stage < MDP4_MIXER_STAGE_MAX; stage++)
+		if (mdp4_overlay_stage_pipe(base->mixer_num, stage))
+			goto out;
+
+	/* panels latch windows on even pixel boundaries */
+	roi->x = req->x & ~1;
+	roi->y = req->y & ~1;
+	roi->w = min_t(uint32, ALIGN(req->x + req->w, 2), base->src_width) -
+		roi->x;
+	roi->h = min_t(uint32, ALIGN(req->y + req->h, 2), base->src_height) -
+		roi->y;
+
+	if (roi->w == base->src_width && roi->h == base->src_height)
+		goto out;
+
+	pipe->srcp0_addr += roi->y * pipe->srcp0_ystride + roi->x * pipe->bpp;
+	pipe->src_width = roi->w;
+	pipe->src_height = roi->h;
+	pipe->src_w = roi->w;
+	pipe->src_h = roi->h;
+	pipe->dst_w = roi->w;
+	pipe->dst_h = roi->h;
+	base = pipe;
+out:
+	req->w = 0;
+	return base;
+}
+
 int mdp4_dsi_cmd_pipe_commit(int cndx, int wait)
 {
 	int  i, undx;
@@ -269,6 +325,8 @@ int mdp4_dsi_cmd_pipe_commit(int cndx, int wait)
 	struct vsync_update *vp;
 	struct mdp4_overlay_pipe *pipe;
 	struct mdp4_overlay_pipe *real_pipe;
+	struct mdp4_overlay_pipe *roi_pipe;
+	struct mdp_rect roi;
 	unsigned long flags;
 	int need_dmap_wait = 0;
 	int need_ov_wait = 0;
@@ -291,6 +349,8 @@ int mdp4_dsi_cmd_pipe_commit(int cndx, int wait)
 	mdp_update_pm(vctrl->mfd, vctrl->vsync_time);
 
 
+	roi_pipe = mdp4_dsi_cmd_roi_select(vctrl, vp, &roi);
+
 	vctrl->update_ndx++;
 	vctrl->update_ndx &= 0x01;
 	vp->update_cnt = 0;     
@@ -357,6 +417,17 @@ int mdp4_dsi_cmd_pipe_commit(int cndx, int wait)
 		vctrl->blt_change = 0;
 	}
 
+	if (vctrl->mfd->panel_info.mipi.partial_update &&
+	    memcmp(&roi, &vctrl->roi, sizeof(roi))) {
+		/* a full frame without the base queued still needs its fetch */
+		if (roi_pipe == vctrl->base_pipe)
+			mdp4_overlay_rgb_setup(roi_pipe);
+		mdp4_overlayproc_cfg(roi_pipe);
+		mdp4_overlay_dmap_xy(roi_pipe);
+		mipi_dsi_cmd_set_roi(&vctrl->mfd->panel_info.mipi, &roi);
+		vctrl->roi = roi;
+	}
+
 	pipe = vp->plist;
 	for (i = 0; i < OVERLAY_PIPE_MAX; i++, pipe++) {
 		if (pipe->pipe_used) {
@@ -562,6 +633,7 @@ void mdp4_dmap_done_dsi_cmd(int cndx)
 	spin_lock(&vctrl->spin_lock);
 	vsync_irq_disable(INTR_DMA_P_DONE, MDP_DMAP_TERM);
 	vctrl->dmap_done++;
+	frametime_display(cndx);
 
 	if (vctrl->pan_display)
 		vctrl->pan_display--;
@@ -1008,6 +1080,8 @@ int mdp4_dsi_cmd_on(struct platform_device *pdev)
 	vctrl->mfd = mfd;
 	vctrl->dev = mfd->fbi->dev;
 	vctrl->vsync_enabled = 0;
+	/* resend the panel window on the first kickoff */
+	memset(&vctrl->roi, 0, sizeof(vctrl->roi));
 
 	mdp_clk_ctrl(1);
 	mdp4_overlay_update_dsi_cmd(mfd);
@@ -1182,6 +1256,10 @@ void mdp4_dsi_cmd_overlay(struct msm_fb_data_type *mfd)
 	if (pipe->mixer_stage == MDP4_MIXER_STAGE_BASE) {
 		mdp4_mipi_vsync_enable(mfd, pipe, 0);
 		mdp4_overlay_setup_pipe_addr(mfd, pipe);
+		vctrl->roi_req.x = mfd->ibuf.dma_x;
+		vctrl->roi_req.y = mfd->ibuf.dma_y;
+		vctrl->roi_req.w = mfd->ibuf.dma_w;
+		vctrl->roi_req.h = mfd->ibuf.dma_h;
 		mdp4_dsi_cmd_pipe_queue(0, pipe);
 	}
 
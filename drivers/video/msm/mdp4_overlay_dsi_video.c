@@ -27,6 +27,8 @@
 #include <linux/ktime.h>
 #include <linux/wakelock.h>
 #include <linux/time.h>
+#include <linux/workqueue.h>
+#include <linux/frametime.h>
 #include <asm/system.h>
 #include <asm/mach-types.h>
 #include <mach/hardware.h>
@@ -46,6 +48,9 @@ static int vsync_irq_cnt;
 
 #define MAX_CONTROLLER	1
 
+/* unchanged frames before a multi-layer composition is cached */
+#define COMP_CACHE_FRAMES	8
+
 static struct vsycn_ctrl {
 	struct device *dev;
 	int inited;
@@ -67,6 +72,9 @@ static struct vsycn_ctrl {
 	int vsync_irq_enabled;
 	ktime_t vsync_time;
 	wait_queue_head_t wait_queue;
+	int comp_cache;		/* blt is on only to cache the composition */
+	unsigned long last_commit;
+	struct delayed_work cache_work;
 } vsync_ctrl_db[MAX_CONTROLLER];
 
 static void vsync_irq_enable(int intr, int term)
@@ -157,6 +165,77 @@ static void mdp4_dsi_video_pipe_clean(struct vsync_update *vp)
 static void mdp4_dsi_video_blt_ov_update(struct mdp4_overlay_pipe *pipe);
 static void mdp4_dsi_video_wait4dmap(int cndx);
 static void mdp4_dsi_video_wait4ov(int cndx);
+static void mdp4_dsi_video_do_blt(struct msm_fb_data_type *mfd, int enable);
+
+static unsigned long mdp4_dsi_video_cache_delay(struct vsycn_ctrl *vctrl)
+{
+	u32 fps = mdp_get_panel_framerate(vctrl->mfd);
+
+	return msecs_to_jiffies(COMP_CACHE_FRAMES * 1000 / (fps ? fps : 60));
+}
+
+static int mdp4_dsi_video_cacheable(struct vsycn_ctrl *vctrl)
+{
+	struct mdp4_overlay_pipe *pipe = vctrl->base_pipe;
+	int stage;
+
+	if (!pipe || pipe->ov_blt_addr || !vctrl->mfd->ov0_wb_buf->size ||
+	    vctrl->blt_ctrl != OVERLAY_BLT_SWITCH_TG_ON)
+		return 0;
+
+	/* a lone base layer costs the same fetch as the cached frame */
+	for (stage = MDP4_MIXER_STAGE0; stage < MDP4_MIXER_STAGE_MAX; stage++)
+		if (mdp4_overlay_stage_pipe(pipe->mixer_num, stage))
+			return 1;
+
+	return 0;
+}
+
+/*
+ * Once the composition has been left alone for COMP_CACHE_FRAMES, switch
+ * overlay0 to blt so it writes the blended frame out once and DMA_P keeps
+ * scanning that buffer.  The layers are not fetched again until the next
+ * commit, which switches back to direct composition.
+ */
+static void mdp4_dsi_video_cache_work(struct work_struct *work)
+{
+	struct vsycn_ctrl *vctrl =
+		container_of(work, struct vsycn_ctrl, cache_work.work);
+	struct msm_fb_data_type *mfd = vctrl->mfd;
+	unsigned long idle, delay;
+	unsigned long flags;
+
+	mutex_lock(&mfd->dma->ov_mutex);
+	if (!mfd->panel_power_on || atomic_read(&vctrl->suspend) ||
+	    vctrl->comp_cache || !mdp4_dsi_video_cacheable(vctrl))
+		goto out;
+
+	delay = mdp4_dsi_video_cache_delay(vctrl);
+	idle = jiffies - vctrl->last_commit;
+	if (idle < delay) {
+		schedule_delayed_work(&vctrl->cache_work, delay - idle);
+		goto out;
+	}
+
+	mdp4_dsi_video_do_blt(mfd, 1);
+	if (!vctrl->blt_change)
+		goto out;
+	vctrl->comp_cache = 1;
+
+	/* let dmap_done latch blt and kick the one overlay0 write */
+	spin_lock_irqsave(&vctrl->spin_lock, flags);
+	INIT_COMPLETION(vctrl->dmap_comp);
+	INIT_COMPLETION(vctrl->ov_comp);
+	vsync_irq_enable(INTR_DMA_P_DONE, MDP_DMAP_TERM);
+	spin_unlock_irqrestore(&vctrl->spin_lock, flags);
+	mdp4_dsi_video_wait4dmap(0);
+	mdp4_dsi_video_wait4ov(0);
+
+	mdp4_overlay_mdp_perf_cache(MDP4_MIXER0);
+	pr_debug("%s: composition cached\n", __func__);
+out:
+	mutex_unlock(&mfd->dma->ov_mutex);
+}
 
 int mdp4_dsi_video_pipe_commit(int cndx, int wait)
 {
@@ -195,8 +274,16 @@ int mdp4_dsi_video_pipe_commit(int cndx, int wait)
 		if (vctrl->blt_free == 0)
 			mdp4_free_writeback_buf(vctrl->mfd, mixer);
 	}
+	vctrl->last_commit = jiffies;
 	mutex_unlock(&vctrl->update_lock);
 
+	if (vctrl->comp_cache) {
+		vctrl->comp_cache = 0;
+		mdp4_dsi_video_do_blt(vctrl->mfd, 0);
+		/* keep the buffer for the next static stretch */
+		vctrl->blt_free = 0;
+	}
+
 	spin_lock_irqsave(&vctrl->spin_lock, flags);
 	if (vctrl->ov_koff != vctrl->ov_done) {
 		spin_unlock_irqrestore(&vctrl->spin_lock, flags);
@@ -268,6 +355,11 @@ int mdp4_dsi_video_pipe_commit(int cndx, int wait)
 
 	mdp4_stat.overlay_commit[pipe->mixer_num]++;
 
+	if (mdp4_dsi_video_cacheable(vctrl) &&
+	    !delayed_work_pending(&vctrl->cache_work))
+		schedule_delayed_work(&vctrl->cache_work,
+				      mdp4_dsi_video_cache_delay(vctrl));
+
 	if (wait) {
 		if (pipe->ov_blt_addr)
 			mdp4_dsi_video_wait4ov(0);
@@ -452,6 +544,7 @@ void mdp4_dsi_vsync_init(int cndx)
 	atomic_set(&vctrl->suspend, 1);
 	spin_lock_init(&vctrl->spin_lock);
 	init_waitqueue_head(&vctrl->wait_queue);
+	INIT_DELAYED_WORK(&vctrl->cache_work, mdp4_dsi_video_cache_work);
 }
 
 void mdp4_dsi_video_free_base_pipe(struct msm_fb_data_type *mfd)
@@ -738,8 +831,10 @@ int mdp4_dsi_video_off(struct platform_device *pdev)
 
 	mfd = (struct msm_fb_data_type *)platform_get_drvdata(pdev);
 
-	mutex_lock(&mfd->dma->ov_mutex);
 	vctrl = &vsync_ctrl_db[cndx];
+	cancel_delayed_work_sync(&vctrl->cache_work);
+
+	mutex_lock(&mfd->dma->ov_mutex);
 	pipe = vctrl->base_pipe;
 	if (pipe == NULL) {
 		pr_err("%s: NO base pipe\n", __func__);
@@ -785,6 +880,7 @@ int mdp4_dsi_video_off(struct platform_device *pdev)
 				mdp4_overlay_pipe_free(pipe, 1);
 			}
 			vctrl->base_pipe = NULL;
+			vctrl->comp_cache = 0;
 		} else {
 			
 			mdp4_mixer_stage_down(vctrl->base_pipe, 1);
@@ -964,6 +1060,9 @@ void mdp4_primary_vsync_dsi_video(void)
 	vctrl->vsync_time = ktime_get();
 	wake_up_interruptible_all(&vctrl->wait_queue);
 	spin_unlock(&vctrl->spin_lock);
+
+	mdp_vsync_notify(vctrl->vsync_time);
+	frametime_display(cndx);
 }
 
 void mdp4_dmap_done_dsi_video(int cndx)
@@ -1072,7 +1171,7 @@ static void mdp4_dsi_video_do_blt(struct msm_fb_data_type *mfd, int enable)
 		vctrl->blt_change++;
 	}
 
-	pr_info("%s: changed=%d enable=%d ov_blt_addr=%x\n", __func__,
+	pr_debug("%s: changed=%d enable=%d ov_blt_addr=%x\n", __func__,
 		vctrl->blt_change, enable, (int)pipe->ov_blt_addr);
 
 	if (!vctrl->blt_change) {
@@ -1116,16 +1215,19 @@ static void mdp4_dsi_video_do_blt(struct msm_fb_data_type *mfd, int enable)
 void mdp4_dsi_video_overlay_blt(struct msm_fb_data_type *mfd,
 					struct msmfb_overlay_blt *req)
 {
+	vsync_ctrl_db[0].comp_cache = 0;
 	mdp4_dsi_video_do_blt(mfd, req->enable);
 }
 
 void mdp4_dsi_video_blt_start(struct msm_fb_data_type *mfd)
 {
+	vsync_ctrl_db[0].comp_cache = 0;
 	mdp4_dsi_video_do_blt(mfd, 1);
 }
 
 void mdp4_dsi_video_blt_stop(struct msm_fb_data_type *mfd)
 {
+	vsync_ctrl_db[0].comp_cache = 0;
 	mdp4_dsi_video_do_blt(mfd, 0);
 }
 
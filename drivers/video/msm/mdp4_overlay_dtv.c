@@ -647,6 +647,15 @@ int mdp4_dtv_on(struct platform_device *pdev)
 	if (ret != 0)
 		pr_warn("%s: panel_next_on failed", __func__);
 
+	/* The timing is final now, vote the base layer at this mode's rate */
+	if (vctrl->base_pipe) {
+		mdp4_overlay_mdp_pipe_req(vctrl->base_pipe, mfd);
+		mdp4_calc_blt_mdp_bw(mfd, vctrl->base_pipe);
+		mdp4_overlay_mdp_perf_req(mfd);
+		mdp4_overlay_mdp_perf_upd(mfd, 1);
+		mdp4_dtv_bus_scale_release();
+	}
+
 	atomic_set(&vctrl->suspend, 0);
 
 	mutex_unlock(&mfd->dma->ov_mutex);
@@ -890,6 +890,8 @@ void mdp4_primary_vsync_lcdc(void)
 	complete_all(&vctrl->vsync_comp);
 	vctrl->wait_vsync_cnt = 0;
 	spin_unlock(&vctrl->spin_lock);
+
+	mdp_vsync_notify(vctrl->vsync_time);
 }
 
 void mdp4_dmap_done_lcdc(int cndx)
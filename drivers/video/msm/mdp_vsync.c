@@ -21,6 +21,7 @@
 #include <linux/hrtimer.h>
 #include <linux/vmalloc.h>
 #include <linux/clk.h>
+#include <linux/notifier.h>
 
 #include <mach/hardware.h>
 #include <linux/io.h>
@@ -68,6 +69,25 @@ int vsync_clk_status;
 DEFINE_MUTEX(vsync_clk_lock);
 static DEFINE_SPINLOCK(vsync_timer_lock);
 
+static ATOMIC_NOTIFIER_HEAD(mdp_vsync_notifier_list);
+
+int msm_fb_register_vsync_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&mdp_vsync_notifier_list, nb);
+}
+EXPORT_SYMBOL(msm_fb_register_vsync_notifier);
+
+int msm_fb_unregister_vsync_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&mdp_vsync_notifier_list, nb);
+}
+EXPORT_SYMBOL(msm_fb_unregister_vsync_notifier);
+
+void mdp_vsync_notify(ktime_t vsync_time)
+{
+	atomic_notifier_call_chain(&mdp_vsync_notifier_list, 0, &vsync_time);
+}
+
 static struct clk *mdp_vsync_clk;
 static struct msm_fb_data_type *vsync_mfd;
 static unsigned char timer_shutdown_flag;
@@ -1071,6 +1071,56 @@ void mipi_dsi_set_tear_off(struct msm_fb_data_type *mfd)
 	mipi_dsi_cmdlist_put(&cmdreq);
 }
 
+static char set_col_addr[5] = {0x2a, 0x00, 0x00, 0x00, 0x00};
+static char set_page_addr[5] = {0x2b, 0x00, 0x00, 0x00, 0x00};
+static struct dsi_cmd_desc dsi_roi_cmds[] = {
+	{DTYPE_DCS_LWRITE, 1, 0, 0, 0, sizeof(set_col_addr), set_col_addr},
+	{DTYPE_DCS_LWRITE, 1, 0, 0, 0, sizeof(set_page_addr), set_page_addr},
+};
+
+/*
+ * Point the panel's frame memory window at roi and size the MDP stream
+ * to match, so the next kickoff only transfers that region.  Must be
+ * called with the DSI clocks on and before the MDP stream is started.
+ */
+void mipi_dsi_cmd_set_roi(struct mipi_panel_info *mipi, struct mdp_rect *roi)
+{
+	uint32 x2, y2, data;
+	int bpp;
+
+	x2 = roi->x + roi->w - 1;
+	y2 = roi->y + roi->h - 1;
+
+	set_col_addr[1] = roi->x >> 8;
+	set_col_addr[2] = roi->x & 0xff;
+	set_col_addr[3] = x2 >> 8;
+	set_col_addr[4] = x2 & 0xff;
+
+	set_page_addr[1] = roi->y >> 8;
+	set_page_addr[2] = roi->y & 0xff;
+	set_page_addr[3] = y2 >> 8;
+	set_page_addr[4] = y2 & 0xff;
+
+	if (mipi->dst_format == DSI_CMD_DST_FORMAT_RGB565)
+		bpp = 2;
+	else
+		bpp = 3;
+
+	mutex_lock(&cmd_mutex);
+	mipi_dsi_cmd_mdp_busy();
+
+	mipi_dsi_buf_init(&dsi_tx_buf);
+	mipi_dsi_cmds_tx(&dsi_tx_buf, dsi_roi_cmds, ARRAY_SIZE(dsi_roi_cmds));
+
+	data = ((roi->w * bpp + 1) << 16) | (mipi->vc << 8) | DTYPE_DCS_LWRITE;
+	MIPI_OUTP(MIPI_DSI_BASE + 0x54, data);
+	data = roi->h << 16 | roi->w;
+	MIPI_OUTP(MIPI_DSI_BASE + 0x58, data);
+	wmb();
+
+	mutex_unlock(&cmd_mutex);
+}
+
 int mipi_dsi_cmd_reg_tx(uint32 data)
 {
 #ifdef DSI_HOST_DEBUG
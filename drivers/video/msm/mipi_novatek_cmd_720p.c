@@ -86,6 +86,7 @@ static int __init mipi_cmd_novatek_sony_hd720p_init(void)
 	pinfo.mipi.insert_dcs_cmd = TRUE;
 	pinfo.mipi.wr_mem_continue = 0x3c;
 	pinfo.mipi.wr_mem_start = 0x2c;
+	pinfo.mipi.partial_update = TRUE;
 	pinfo.mipi.dsi_phy_db = &mipi_dsi_sony_panel_id28103_phy_ctrl_720p;
 
 	ret = mipi_novatek_device_register(&pinfo, MIPI_DSI_PRIM,
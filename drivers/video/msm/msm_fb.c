@@ -46,6 +46,8 @@
 #include <linux/minifb.h>
 #include <linux/sw_sync.h>
 #include <linux/file.h>
+#include <linux/perf_telemetry.h>
+#include <linux/frametime.h>
 
 #define MSM_FB_C
 #include "msm_fb.h"
@@ -127,6 +129,7 @@ static int msm_fb_mmap(struct fb_info *info, struct vm_area_struct * vma);
 static int mdp_bl_scale_config(struct msm_fb_data_type *mfd,
 						struct mdp_bl_scale_data *data);
 static void msm_fb_commit_wq_handler(struct work_struct *work);
+static void msm_fb_atomic_wq_handler(struct work_struct *work);
 static int msm_fb_pan_idle(struct msm_fb_data_type *mfd);
 static void msm_fb_scale_bl(__u32 *bl_lvl);
 void msm_fb_shutdown(struct platform_device *pdev);
@@ -172,6 +175,8 @@ char *get_fb_addr(void)
 #define WAIT_FENCE_FINAL_TIMEOUT 10 * MSEC_PER_SEC
 #define WAIT_DISP_OP_TIMEOUT (WAIT_FENCE_FIRST_TIMEOUT +\
         WAIT_FENCE_FINAL_TIMEOUT) * MDP_MAX_FENCE_FD
+/* Frames MSMFB_ATOMIC_COMMIT may have queued ahead of the display */
+#define MSM_FB_ATOMIC_DEPTH 2
 #define MAX_TIMELINE_NAME_LEN 16
 
 int msm_fb_debugfs_file_index;
@@ -1980,6 +1985,9 @@ static int msm_fb_register(struct msm_fb_data_type *mfd)
 	init_completion(&mfd->commit_comp);
 	mutex_init(&mfd->sync_mutex);
 	INIT_WORK(&mfd->commit_work, msm_fb_commit_wq_handler);
+	INIT_LIST_HEAD(&mfd->atomic_list);
+	INIT_WORK(&mfd->atomic_work, msm_fb_atomic_wq_handler);
+	init_waitqueue_head(&mfd->atomic_waitq);
 	mfd->msm_fb_backup = kzalloc(sizeof(struct msm_fb_backup_type),
 		GFP_KERNEL);
 	if (mfd->msm_fb_backup == 0) {
@@ -2330,18 +2338,18 @@ static int msm_fb_release(struct fb_info *info, int user)
 	return ret;
 }
 
-void msm_fb_wait_for_fence(struct msm_fb_data_type *mfd)
+static void msm_fb_wait_fences(struct sync_fence **acq_fen, u32 *acq_fen_cnt)
 {
 	int i, ret = 0;
 	
-	for (i = 0; i < mfd->acq_fen_cnt; i++) {
-		ret = sync_fence_wait(mfd->acq_fen[i],
+	for (i = 0; i < *acq_fen_cnt; i++) {
+		ret = sync_fence_wait(acq_fen[i],
 				WAIT_FENCE_FIRST_TIMEOUT);
 		if (ret == -ETIME) {
 			pr_warn("%s: sync_fence_wait timed out!"
 				"Waiting %ld more seconds\n",
 				__func__,WAIT_FENCE_FINAL_TIMEOUT/MSEC_PER_SEC);
-			ret = sync_fence_wait(mfd->acq_fen[i],
+			ret = sync_fence_wait(acq_fen[i],
 					WAIT_FENCE_FINAL_TIMEOUT);
 		}
 		if (ret < 0) {
@@ -2349,15 +2357,20 @@ void msm_fb_wait_for_fence(struct msm_fb_data_type *mfd)
 				__func__, ret);
 			break;
 		}
-		sync_fence_put(mfd->acq_fen[i]);
+		sync_fence_put(acq_fen[i]);
 	}
 	if (ret < 0) {
-		while (i < mfd->acq_fen_cnt) {
-			sync_fence_put(mfd->acq_fen[i]);
+		while (i < *acq_fen_cnt) {
+			sync_fence_put(acq_fen[i]);
 			i++;
 		}
 	}
-	mfd->acq_fen_cnt = 0;
+	*acq_fen_cnt = 0;
+}
+
+void msm_fb_wait_for_fence(struct msm_fb_data_type *mfd)
+{
+	msm_fb_wait_fences(mfd->acq_fen, &mfd->acq_fen_cnt);
 }
 int msm_fb_signal_timeline(struct msm_fb_data_type *mfd)
 {
@@ -2390,6 +2403,13 @@ static int msm_fb_pan_idle(struct msm_fb_data_type *mfd)
 {
 	int ret = 0;
 
+	/* Queued atomic frames count as a commit in progress */
+	if (!wait_event_timeout(mfd->atomic_waitq, !mfd->atomic_pending,
+			msecs_to_jiffies(WAIT_DISP_OP_TIMEOUT *
+					 MSM_FB_ATOMIC_DEPTH)))
+		pr_err("%s wait for %d atomic frames timeout", __func__,
+			mfd->atomic_pending);
+
 	mutex_lock(&mfd->sync_mutex);
 	if (mfd->is_committing) {
 		mutex_unlock(&mfd->sync_mutex);
@@ -2464,7 +2484,7 @@ static int msm_fb_pan_display_ex(struct fb_info *info,
 		sizeof(struct mdp_display_commit));
 	mfd->is_committing = 1;
 	INIT_COMPLETION(mfd->commit_comp);
-	schedule_work(&mfd->commit_work);
+	queue_work(system_highpri_wq, &mfd->commit_work);
 	mutex_unlock(&mfd->sync_mutex);
 	if (wait_for_finish)
 		msm_fb_pan_idle(mfd);
@@ -2607,6 +2627,7 @@ static void msm_fb_commit_wq_handler(struct work_struct *work)
 	struct fb_info *info;
 	struct msm_fb_backup_type *fb_backup;
 	static bool ignore_bkl_zero = false;
+	ktime_t start = ktime_get();
 
 	mfd = container_of(work, struct msm_fb_data_type, commit_work);
 	fb_backup = (struct msm_fb_backup_type *)mfd->msm_fb_backup;
@@ -2622,9 +2643,13 @@ static void msm_fb_commit_wq_handler(struct work_struct *work)
 		var = &fb_backup->disp_commit.var;
 		msm_fb_pan_display_sub(var, info);
 	}
+	frametime_commit(mfd->index);
+	perf_tm_log(PERF_TM_FRAME_COMMIT, mfd->index,
+		ktime_us_delta(ktime_get(), start), 0);
 
 	if (mfd->request_display_on) {
 		msm_fb_display_on(mfd);
+		deferred_initcalls_kick();
 		if (!ignore_bkl_zero) {
 			PR_DISP_INFO("%s: bl_level %d ignore_bkl_zero %d\n", __func__, mfd->bl_level, ignore_bkl_zero);
 			
@@ -3726,23 +3751,13 @@ static int msmfb_overlay_play_wait(struct fb_info *info, unsigned long *argp)
 	return ret;
 }
 
-static int msmfb_overlay_play(struct fb_info *info, unsigned long *argp)
+static int msmfb_overlay_play_req(struct fb_info *info,
+				  struct msmfb_overlay_data *req)
 {
 	int	ret;
-	struct msmfb_overlay_data req;
 	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
 	struct msm_fb_panel_data *pdata;
 
-	if (mfd->overlay_play_enable == 0)	
-		return 0;
-
-	ret = copy_from_user(&req, argp, sizeof(req));
-	if (ret) {
-		printk(KERN_ERR "%s:msmfb_overlay_play ioctl failed \n",
-			__func__);
-		return ret;
-	}
-
 	if (info->node == 0 && !(mfd->cont_splash_done)) { 
 		mdp_set_dma_pan_info(info, NULL, TRUE);
 		if (msm_fb_blank_sub(FB_BLANK_UNBLANK, info, mfd->op_enable)) {
@@ -3763,7 +3778,7 @@ static int msmfb_overlay_play(struct fb_info *info, unsigned long *argp)
 	add_timer(&mfd->msmfb_no_update_notify_timer);
 	mutex_unlock(&msm_fb_notify_update_sem);
 
-	ret = mdp4_overlay_play(info, &req);
+	ret = mdp4_overlay_play(info, req);
 
 	if (unset_bl_level && !bl_updated) {
 		pdata = (struct msm_fb_panel_data *)mfd->pdev->
@@ -3784,6 +3799,25 @@ static int msmfb_overlay_play(struct fb_info *info, unsigned long *argp)
 	return ret;
 }
 
+static int msmfb_overlay_play(struct fb_info *info, unsigned long *argp)
+{
+	int	ret;
+	struct msmfb_overlay_data req;
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+
+	if (mfd->overlay_play_enable == 0)	
+		return 0;
+
+	ret = copy_from_user(&req, argp, sizeof(req));
+	if (ret) {
+		printk(KERN_ERR "%s:msmfb_overlay_play ioctl failed \n",
+			__func__);
+		return ret;
+	}
+
+	return msmfb_overlay_play_req(info, &req);
+}
+
 static int msmfb_overlay_play_enable(struct fb_info *info, unsigned long *argp)
 {
 	int	ret, enable;
@@ -4177,11 +4211,18 @@ static int msmfb_handle_pp_ioctl(struct msm_fb_data_type *mfd,
 	return ret;
 }
 
-static int msmfb_handle_buf_sync_ioctl(struct msm_fb_data_type *mfd,
-						struct mdp_buf_sync *buf_sync)
+/*
+ * Take the acquire fences into acq_fen and return a release fence for the
+ * frame.  An atomic frame goes behind the ones still queued for the worker
+ * and is counted in atomic_pending under the same lock.
+ */
+static int __msmfb_buf_sync(struct msm_fb_data_type *mfd,
+			    struct mdp_buf_sync *buf_sync,
+			    struct sync_fence **acq_fen, u32 *acq_fen_cnt,
+			    bool atomic)
 {
 	int i, ret = 0;
-	u32 threshold;
+	u32 threshold, queued;
 	int acq_fen_fd[MDP_MAX_FENCE_FD];
 	struct sync_fence *fence;
 
@@ -4208,20 +4249,21 @@ static int msmfb_handle_buf_sync_ioctl(struct msm_fb_data_type *mfd,
 			ret = -EINVAL;
 			break;
 		}
-		mfd->acq_fen[i] = fence;
+		acq_fen[i] = fence;
 	}
-	mfd->acq_fen_cnt = i;
+	*acq_fen_cnt = i;
 	if (ret)
 		goto buf_sync_err_1;
 	if (buf_sync->flags & MDP_BUF_SYNC_FLAG_WAIT) {
-		msm_fb_wait_for_fence(mfd);
+		msm_fb_wait_fences(acq_fen, acq_fen_cnt);
 	}
 	if (mfd->panel.type == WRITEBACK_PANEL)
 		threshold = 1;
 	else
 		threshold = 2;
+	queued = atomic ? mfd->atomic_pending : 0;
 	mfd->cur_rel_sync_pt = sw_sync_pt_create(mfd->timeline,
-			mfd->timeline_value + threshold);
+			mfd->timeline_value + queued + threshold);
 	if (mfd->cur_rel_sync_pt == NULL) {
 		pr_err("%s: cannot create sync point", __func__);
 		ret = -ENOMEM;
@@ -4251,6 +4293,8 @@ static int msmfb_handle_buf_sync_ioctl(struct msm_fb_data_type *mfd,
 		pr_err("%s:copy_to_user failed", __func__);
 		goto buf_sync_err_3;
 	}
+	if (atomic)
+		mfd->atomic_pending++;
 	mutex_unlock(&mfd->sync_mutex);
 	return ret;
 buf_sync_err_3:
@@ -4260,13 +4304,20 @@ buf_sync_err_2:
 	mfd->cur_rel_fence = NULL;
 	mfd->cur_rel_fen_fd = 0;
 buf_sync_err_1:
-	for (i = 0; i < mfd->acq_fen_cnt; i++)
-		sync_fence_put(mfd->acq_fen[i]);
-	mfd->acq_fen_cnt = 0;
+	for (i = 0; i < *acq_fen_cnt; i++)
+		sync_fence_put(acq_fen[i]);
+	*acq_fen_cnt = 0;
 	mutex_unlock(&mfd->sync_mutex);
 	return ret;
 }
 
+static int msmfb_handle_buf_sync_ioctl(struct msm_fb_data_type *mfd,
+						struct mdp_buf_sync *buf_sync)
+{
+	return __msmfb_buf_sync(mfd, buf_sync, mfd->acq_fen,
+				&mfd->acq_fen_cnt, false);
+}
+
 static int msmfb_display_commit(struct fb_info *info,
 						unsigned long *argp)
 {
@@ -4284,6 +4335,211 @@ static int msmfb_display_commit(struct fb_info *info,
 	return ret;
 }
 
+#ifdef CONFIG_FB_MSM_OVERLAY
+struct msm_fb_atomic_frame {
+	struct list_head list;
+	struct mdp_atomic_commit ac;
+	struct mdp_atomic_layer layers[MDP_ATOMIC_MAX_LAYERS];
+	u32 acq_fen_cnt;
+	struct sync_fence *acq_fen[MDP_MAX_FENCE_FD];
+};
+
+static int msmfb_atomic_validate(struct mdp_atomic_commit *ac,
+				 struct mdp_atomic_layer *layers)
+{
+	int i, j;
+
+	if (ac->buf_sync.acq_fen_fd_cnt > MDP_MAX_FENCE_FD)
+		return -EINVAL;
+
+	for (i = 0; i < ac->num_layers; i++)
+		for (j = i + 1; j < ac->num_layers; j++)
+			if (layers[i].overlay.z_order ==
+			    layers[j].overlay.z_order)
+				return -EINVAL;
+
+	return 0;
+}
+
+static int msmfb_atomic_stage(struct fb_info *info,
+			      struct msm_fb_atomic_frame *frame)
+{
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+	struct mdp_atomic_layer *layers = frame->layers;
+	int i, ret;
+
+	for (i = 0; i < frame->ac.num_layers; i++) {
+		ret = mdp4_overlay_set(info, &layers[i].overlay);
+		if (ret) {
+			pr_err("%s: layer %d set failed, rc=%d\n",
+				__func__, i, ret);
+			return ret;
+		}
+		layers[i].data.id = layers[i].overlay.id;
+	}
+
+	if (mfd->overlay_play_enable) {
+		for (i = 0; i < frame->ac.num_layers; i++) {
+			ret = msmfb_overlay_play_req(info, &layers[i].data);
+			if (ret) {
+				pr_err("%s: layer %d play failed, rc=%d\n",
+					__func__, i, ret);
+				return ret;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void msm_fb_atomic_wq_handler(struct work_struct *work)
+{
+	struct msm_fb_data_type *mfd = container_of(work,
+				struct msm_fb_data_type, atomic_work);
+	struct fb_info *info = mfd->fbi;
+	struct msm_fb_atomic_frame *frame;
+
+	for (;;) {
+		mutex_lock(&mfd->sync_mutex);
+		if (list_empty(&mfd->atomic_list)) {
+			mutex_unlock(&mfd->sync_mutex);
+			break;
+		}
+		frame = list_first_entry(&mfd->atomic_list,
+				struct msm_fb_atomic_frame, list);
+		list_del(&frame->list);
+		mutex_unlock(&mfd->sync_mutex);
+
+		msm_fb_wait_fences(frame->acq_fen, &frame->acq_fen_cnt);
+
+		/*
+		 * The release fence counts on this frame advancing the
+		 * timeline, so do that even if it cannot be shown.
+		 */
+		if (!mfd->panel_power_on || msmfb_atomic_stage(info, frame) ||
+		    msm_fb_pan_display_sub(&frame->ac.commit.var, info))
+			msm_fb_signal_timeline(mfd);
+
+		mutex_lock(&mfd->sync_mutex);
+		mfd->atomic_pending--;
+		mutex_unlock(&mfd->sync_mutex);
+		wake_up_all(&mfd->atomic_waitq);
+
+		kfree(frame);
+	}
+}
+
+static bool msmfb_atomic_can_queue(struct msm_fb_data_type *mfd,
+				   struct msm_fb_atomic_frame *frame)
+{
+	int i;
+
+	/* Turning the display on is left to the commit work */
+	if (!(frame->ac.flags & MDP_ATOMIC_COMMIT_ASYNC) ||
+	    mfd->request_display_on)
+		return false;
+
+	/* Pipe ids have to be known before the ioctl returns */
+	for (i = 0; i < frame->ac.num_layers; i++)
+		if (frame->layers[i].overlay.id == MSMFB_NEW_REQUEST)
+			return false;
+
+	return true;
+}
+
+static int msmfb_atomic_queue(struct fb_info *info,
+			      struct msm_fb_atomic_frame *frame)
+{
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+	int ret;
+
+	ret = wait_event_interruptible(mfd->atomic_waitq,
+			mfd->atomic_pending < MSM_FB_ATOMIC_DEPTH);
+	if (ret)
+		return ret;
+
+	ret = __msmfb_buf_sync(mfd, &frame->ac.buf_sync, frame->acq_fen,
+			       &frame->acq_fen_cnt, true);
+	if (ret)
+		return ret;
+
+	mutex_lock(&mfd->sync_mutex);
+	list_add_tail(&frame->list, &mfd->atomic_list);
+	mutex_unlock(&mfd->sync_mutex);
+	schedule_work(&mfd->atomic_work);
+
+	return 0;
+}
+
+static int msmfb_atomic_commit(struct fb_info *info, void __user *argp)
+{
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)info->par;
+	struct msm_fb_atomic_frame *frame;
+	struct mdp_atomic_layer __user *ulayers;
+	size_t size;
+	int ret;
+
+	frame = kzalloc(sizeof(*frame), GFP_KERNEL);
+	if (!frame)
+		return -ENOMEM;
+
+	if (copy_from_user(&frame->ac, argp, sizeof(frame->ac))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	ret = -EINVAL;
+	if (!frame->ac.num_layers ||
+	    frame->ac.num_layers > MDP_ATOMIC_MAX_LAYERS)
+		goto out;
+
+	ret = -EPERM;
+	if (!mfd->panel_power_on)
+		goto out;
+
+	ulayers = frame->ac.layers;
+	size = frame->ac.num_layers * sizeof(*ulayers);
+	if (copy_from_user(frame->layers, ulayers, size)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	/* Nothing is staged unless the whole frame is acceptable */
+	ret = msmfb_atomic_validate(&frame->ac, frame->layers);
+	if (ret)
+		goto out;
+
+	frame->ac.commit.flags |= MDP_DISPLAY_COMMIT_OVERLAY;
+
+	if (msmfb_atomic_can_queue(mfd, frame)) {
+		ret = msmfb_atomic_queue(info, frame);
+		if (!ret)
+			return 0;
+		goto out;
+	}
+
+	/* Synchronous: let queued frames and any commit finish first */
+	msm_fb_pan_idle(mfd);
+
+	ret = msmfb_atomic_stage(info, frame);
+	if (!ret)
+		ret = msmfb_handle_buf_sync_ioctl(mfd, &frame->ac.buf_sync);
+	if (!ret)
+		ret = msm_fb_pan_display_ex(info, &frame->ac.commit);
+
+	/* Pipes may have been allocated, hand their ids back even on failure */
+	if (copy_to_user(ulayers, frame->layers, size) && !ret)
+		ret = -EFAULT;
+out:
+	kfree(frame);
+	return ret;
+}
+#else
+static void msm_fb_atomic_wq_handler(struct work_struct *work)
+{
+}
+#endif
+
 static int msmfb_get_metadata(struct msm_fb_data_type *mfd,
 				struct msmfb_metadata *metadata_ptr)
 {
@@ -4323,7 +4579,9 @@ static int msm_fb_ioctl(struct fb_info *info, unsigned int cmd,
 	int ret = 0;
 	struct msmfb_usb_projector_info tmp_info;
 
-	msm_fb_pan_idle(mfd);
+	/* Atomic commits wait for the display themselves, if at all */
+	if (cmd != MSMFB_ATOMIC_COMMIT)
+		msm_fb_pan_idle(mfd);
 
 	switch (cmd) {
 #ifdef CONFIG_FB_MSM_OVERLAY
@@ -4625,6 +4883,12 @@ static int msm_fb_ioctl(struct fb_info *info, unsigned int cmd,
 		ret = msmfb_display_commit(info, argp);
 		break;
 
+#ifdef CONFIG_FB_MSM_OVERLAY
+	case MSMFB_ATOMIC_COMMIT:
+		ret = msmfb_atomic_commit(info, argp);
+		break;
+#endif
+
 	case MSMFB_USBFB_INIT:
 		ret = minifb_ioctl_handler(MINIFB_INIT, argp);
 		break;
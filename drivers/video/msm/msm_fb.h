@@ -217,6 +217,10 @@ struct msm_fb_data_type {
 	struct completion commit_comp;
 	u32 is_committing;
 	struct work_struct commit_work;
+	struct list_head atomic_list;
+	struct work_struct atomic_work;
+	wait_queue_head_t atomic_waitq;
+	u32 atomic_pending;
 	void *msm_fb_backup;
 	boolean panel_driver_on;
 	int vsync_sysfs_created;
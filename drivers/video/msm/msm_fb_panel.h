@@ -134,6 +134,8 @@ struct mipi_panel_info {
 	char no_max_pkt_size;
 	
 	char force_clk_lane_hs;
+	/* panel honours column/page address windows for partial updates */
+	char partial_update;
 	
 	struct mipi_dsi_reg_set *dsi_reg_db;
 	uint32 dsi_reg_db_size;
@@ -1466,6 +1466,49 @@ static int vid_dec_get_next_msg(struct video_client_ctx *client_ctx,
 	return 0;
 }
 
+/* Waits for the first message only, then drains what is already queued */
+static int vid_dec_get_next_msgs(struct video_client_ctx *client_ctx,
+				 struct vdec_msginfo_batch *batch,
+				 unsigned int *returned)
+{
+	struct vdec_msginfo vdec_msg_info;
+	struct vid_dec_msg *vid_dec_msg;
+	unsigned int n = 0;
+	int rc;
+
+	*returned = 0;
+	if (!batch->count)
+		return 0;
+
+	rc = vid_dec_get_next_msg(client_ctx, &vdec_msg_info);
+	if (rc)
+		return rc;
+
+	for (;;) {
+		if (copy_to_user(&batch->msgs[n], &vdec_msg_info,
+				 sizeof(vdec_msg_info)))
+			return n ? 0 : -EFAULT;
+		*returned = ++n;
+		if (n == batch->count)
+			break;
+
+		mutex_lock(&client_ctx->msg_queue_lock);
+		vid_dec_msg = NULL;
+		if (!list_empty(&client_ctx->msg_queue)) {
+			vid_dec_msg = list_first_entry(&client_ctx->msg_queue,
+						       struct vid_dec_msg, list);
+			list_del(&vid_dec_msg->list);
+			memcpy(&vdec_msg_info, &vid_dec_msg->vdec_msg_info,
+			       sizeof(vdec_msg_info));
+			kfree(vid_dec_msg);
+		}
+		mutex_unlock(&client_ctx->msg_queue_lock);
+		if (!vid_dec_msg)
+			break;
+	}
+	return 0;
+}
+
 static long vid_dec_ioctl(struct file *file,
 			 unsigned cmd, unsigned long u_arg)
 {
@@ -1733,6 +1776,36 @@ static long vid_dec_ioctl(struct file *file,
 			return -EIO;
 		break;
 	}
+	case VDEC_IOCTL_FILL_OUTPUT_BUFFERS:
+	{
+		struct vdec_fillbuffer_batch batch;
+		struct vdec_fillbuffer_cmd fill_buffer_cmd;
+		unsigned int queued;
+		int err = 0;
+		DBG("VDEC_IOCTL_FILL_OUTPUT_BUFFERS\n");
+		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
+			return -EFAULT;
+		if (copy_from_user(&batch, vdec_msg.in, sizeof(batch)))
+			return -EFAULT;
+		for (queued = 0; queued < batch.count; queued++) {
+			if (copy_from_user(&fill_buffer_cmd,
+					   &batch.cmds[queued],
+					   sizeof(fill_buffer_cmd))) {
+				err = -EFAULT;
+				break;
+			}
+			if (!vid_dec_fill_output_buffer(client_ctx,
+							&fill_buffer_cmd)) {
+				err = -EIO;
+				break;
+			}
+		}
+		if (copy_to_user(vdec_msg.out, &queued, sizeof(queued)))
+			return -EFAULT;
+		if (!queued && err)
+			return err;
+		break;
+	}
 	case VDEC_IOCTL_CMD_FLUSH:
 	{
 		enum vdec_bufferflush flush_dir;
@@ -1761,6 +1834,23 @@ static long vid_dec_ioctl(struct file *file,
 			return -EFAULT;
 		break;
 	}
+	case VDEC_IOCTL_GET_NEXT_MSGS:
+	{
+		struct vdec_msginfo_batch batch;
+		unsigned int returned;
+		int err;
+		DBG("VDEC_IOCTL_GET_NEXT_MSGS\n");
+		if (copy_from_user(&vdec_msg, arg, sizeof(vdec_msg)))
+			return -EFAULT;
+		if (copy_from_user(&batch, vdec_msg.in, sizeof(batch)))
+			return -EFAULT;
+		err = vid_dec_get_next_msgs(client_ctx, &batch, &returned);
+		if (err)
+			return err;
+		if (copy_to_user(vdec_msg.out, &returned, sizeof(returned)))
+			return -EFAULT;
+		break;
+	}
 	case VDEC_IOCTL_STOP_NEXT_MSG:
 	{
 		DBG("VDEC_IOCTL_STOP_NEXT_MSG\n");
@@ -27,6 +27,9 @@
 #include <linux/workqueue.h>
 #include <linux/android_pmem.h>
 #include <linux/clk.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/sw_sync.h>
 #include <media/msm/vidc_type.h>
 #include <media/msm/vcd_api.h>
 #include <media/msm/vidc_init.h>
@@ -35,6 +38,7 @@
 #include "vcd_res_tracker_api.h"
 
 #define VID_ENC_NAME	"msm_vidc_enc"
+#define VID_ENC_FENCE_TIMEOUT	(1 * MSEC_PER_SEC)
 
 extern u32 vidc_msg_debug;
 #define DBG(x...)				\
@@ -163,6 +167,51 @@ void vid_enc_vcd_open_done(struct video_client_ctx *client_ctx,
 			__func__);
 }
 
+struct vid_enc_fence_job {
+	struct list_head list;
+	struct work_struct work;
+	struct video_client_ctx *client_ctx;
+	struct venc_buffer buf;
+	struct sync_fence *acq_fence;
+	u8 *virtual;
+	u32 queued;
+	u32 done;
+};
+
+/* Signal finished jobs in submission order, fence_lock held */
+static void vid_enc_fence_retire(struct video_client_ctx *client_ctx)
+{
+	struct vid_enc_fence_job *job, *tmp;
+
+	list_for_each_entry_safe(job, tmp, &client_ctx->fence_jobs, list) {
+		if (!job->done || job->queued)
+			break;
+		list_del(&job->list);
+		sw_sync_timeline_inc(client_ctx->timeline, 1);
+		kfree(job);
+	}
+}
+
+static void vid_enc_fence_input_done(struct video_client_ctx *client_ctx,
+		struct vcd_frame_data *vcd_frame_data)
+{
+	struct vid_enc_fence_job *job;
+
+	if (!client_ctx->timeline)
+		return;
+
+	mutex_lock(&client_ctx->fence_lock);
+	list_for_each_entry(job, &client_ctx->fence_jobs, list) {
+		if (job->done)
+			continue;
+		if (job->virtual == vcd_frame_data->virtual)
+			job->done = true;
+		break;
+	}
+	vid_enc_fence_retire(client_ctx);
+	mutex_unlock(&client_ctx->fence_lock);
+}
+
 static void vid_enc_input_frame_done(struct video_client_ctx *client_ctx,
 		u32 event, u32 status,
 		struct vcd_frame_data *vcd_frame_data)
@@ -174,6 +223,8 @@ static void vid_enc_input_frame_done(struct video_client_ctx *client_ctx,
 		return;
 	}
 
+	vid_enc_fence_input_done(client_ctx, vcd_frame_data);
+
 	venc_msg = kzalloc(sizeof(struct vid_enc_msg),
 					    GFP_KERNEL);
 	if (!venc_msg) {
@@ -488,6 +539,161 @@ static int vid_enc_get_next_msg(struct video_client_ctx *client_ctx,
 	return 0;
 }
 
+static void vid_enc_fence_work(struct work_struct *work)
+{
+	struct vid_enc_fence_job *job =
+		container_of(work, struct vid_enc_fence_job, work);
+	struct video_client_ctx *client_ctx = job->client_ctx;
+	struct vcd_frame_data vcd_frame_data;
+	u32 result = true;
+
+	if (job->acq_fence) {
+		if (sync_fence_wait(job->acq_fence, VID_ENC_FENCE_TIMEOUT) < 0) {
+			ERR("%s(): acquire fence wait failed\n", __func__);
+			result = false;
+		}
+		sync_fence_put(job->acq_fence);
+		job->acq_fence = NULL;
+	}
+	if (result)
+		result = vid_enc_encode_frame(client_ctx, &job->buf);
+	if (!result) {
+		/* Hand the buffer back as if the core had flushed it */
+		memset(&vcd_frame_data, 0, sizeof(vcd_frame_data));
+		vcd_frame_data.virtual = job->virtual;
+		vcd_frame_data.frm_clnt_data = (u32) job->buf.clientdata;
+		vid_enc_input_frame_done(client_ctx,
+			VCD_EVT_RESP_INPUT_FLUSHED, VCD_ERR_FAIL,
+			&vcd_frame_data);
+	}
+
+	mutex_lock(&client_ctx->fence_lock);
+	job->queued = false;
+	if (!result)
+		job->done = true;
+	vid_enc_fence_retire(client_ctx);
+	mutex_unlock(&client_ctx->fence_lock);
+}
+
+static int vid_enc_encode_frame_fence(struct video_client_ctx *client_ctx,
+		struct venc_ioctl_msg *venc_msg)
+{
+	struct venc_buffer_fence fbuf;
+	struct vid_enc_fence_job *job;
+	unsigned long kernel_vaddr, phy_addr, user_vaddr;
+	struct file *file;
+	struct sync_pt *pt;
+	struct sync_fence *fence;
+	s32 buffer_index = -1;
+	int pmem_fd, fd, rc;
+
+	if (copy_from_user(&fbuf, venc_msg->in, sizeof(fbuf)))
+		return -EFAULT;
+
+	/* Input buffers are registered once with VEN_IOCTL_SET_INPUT_BUFFER */
+	user_vaddr = (unsigned long)fbuf.buf.ptrbuffer;
+	if (!vidc_lookup_addr_table(client_ctx, BUFFER_TYPE_INPUT,
+			true, &user_vaddr, &kernel_vaddr,
+			&phy_addr, &pmem_fd, &file,
+			&buffer_index)) {
+		ERR("%s(): input buffer not registered\n", __func__);
+		return -EINVAL;
+	}
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+	INIT_WORK(&job->work, vid_enc_fence_work);
+	job->client_ctx = client_ctx;
+	job->buf = fbuf.buf;
+	job->virtual = (u8 *)(kernel_vaddr + fbuf.buf.offset);
+	job->queued = true;
+
+	if (fbuf.acq_fen_fd >= 0) {
+		job->acq_fence = sync_fence_fdget(fbuf.acq_fen_fd);
+		if (!job->acq_fence) {
+			rc = -EINVAL;
+			goto fence_free;
+		}
+	}
+
+	fd = get_unused_fd_flags(0);
+	if (fd < 0) {
+		rc = fd;
+		goto fence_put;
+	}
+	if (copy_to_user(&((struct venc_buffer_fence __user *)
+			venc_msg->out)->rel_fen_fd, &fd, sizeof(fd))) {
+		rc = -EFAULT;
+		goto fence_put_fd;
+	}
+
+	mutex_lock(&client_ctx->fence_lock);
+	if (!client_ctx->timeline) {
+		client_ctx->fence_wq = alloc_ordered_workqueue("vid_enc_fence",
+								0);
+		client_ctx->timeline = sw_sync_timeline_create(VID_ENC_NAME);
+		if (!client_ctx->fence_wq || !client_ctx->timeline) {
+			if (client_ctx->fence_wq)
+				destroy_workqueue(client_ctx->fence_wq);
+			if (client_ctx->timeline)
+				sync_timeline_destroy(
+					&client_ctx->timeline->obj);
+			client_ctx->fence_wq = NULL;
+			client_ctx->timeline = NULL;
+			rc = -ENOMEM;
+			goto fence_unlock;
+		}
+	}
+	pt = sw_sync_pt_create(client_ctx->timeline,
+			       client_ctx->timeline_max + 1);
+	if (!pt) {
+		rc = -ENOMEM;
+		goto fence_unlock;
+	}
+	fence = sync_fence_create("venc-fence", pt);
+	if (!fence) {
+		sync_pt_free(pt);
+		rc = -ENOMEM;
+		goto fence_unlock;
+	}
+	sync_fence_install(fence, fd);
+	client_ctx->timeline_max++;
+	list_add_tail(&job->list, &client_ctx->fence_jobs);
+	queue_work(client_ctx->fence_wq, &job->work);
+	mutex_unlock(&client_ctx->fence_lock);
+	return 0;
+
+fence_unlock:
+	mutex_unlock(&client_ctx->fence_lock);
+fence_put_fd:
+	put_unused_fd(fd);
+fence_put:
+	if (job->acq_fence)
+		sync_fence_put(job->acq_fence);
+fence_free:
+	kfree(job);
+	return rc;
+}
+
+/* Called once vcd is closed, so no more input done callbacks can come */
+static void vid_enc_fence_release(struct video_client_ctx *client_ctx)
+{
+	struct vid_enc_fence_job *job, *tmp;
+
+	if (!client_ctx->timeline)
+		return;
+
+	list_for_each_entry_safe(job, tmp, &client_ctx->fence_jobs, list) {
+		list_del(&job->list);
+		kfree(job);
+	}
+	destroy_workqueue(client_ctx->fence_wq);
+	sync_timeline_destroy(&client_ctx->timeline->obj);
+	client_ctx->fence_wq = NULL;
+	client_ctx->timeline = NULL;
+}
+
 static u32 vid_enc_close_client(struct video_client_ctx *client_ctx)
 {
 	struct vid_enc_msg *vid_enc_msg = NULL;
@@ -502,6 +708,9 @@ static u32 vid_enc_close_client(struct video_client_ctx *client_ctx)
 
 	mutex_lock(&vid_enc_device_p->lock);
 
+	if (client_ctx->fence_wq)
+		flush_workqueue(client_ctx->fence_wq);
+
 	if (start_cmd && !stop_cmd) {
 		vcd_status = vcd_stop(client_ctx->vcd_handle);
 		DBG("Waiting for VCD_STOP: Before Timeout\n");
@@ -530,6 +739,7 @@ static u32 vid_enc_close_client(struct video_client_ctx *client_ctx)
 	}
 	mutex_unlock(&client_ctx->msg_queue_lock);
 	vcd_status = vcd_close(client_ctx->vcd_handle);
+	vid_enc_fence_release(client_ctx);
 
 	if (vcd_status) {
 		mutex_unlock(&vid_enc_device_p->lock);
@@ -592,7 +802,9 @@ static int vid_enc_open(struct inode *inode, struct file *file)
 	init_completion(&client_ctx->event);
 	mutex_init(&client_ctx->msg_queue_lock);
 	mutex_init(&client_ctx->enrty_queue_lock);
+	mutex_init(&client_ctx->fence_lock);
 	INIT_LIST_HEAD(&client_ctx->msg_queue);
+	INIT_LIST_HEAD(&client_ctx->fence_jobs);
 	init_waitqueue_head(&client_ctx->msg_wait);
 	if (vcd_get_ion_status()) {
 		client_ctx->user_ion_client = vcd_get_ion_client();
@@ -844,6 +1056,17 @@ static long vid_enc_ioctl(struct file *file,
 		}
 		break;
 	}
+	case VEN_IOCTL_CMD_ENCODE_FRAME_FENCE:
+	{
+		int rc;
+		if (copy_from_user(&venc_msg, arg, sizeof(venc_msg)))
+			return -EFAULT;
+		DBG("VEN_IOCTL_CMD_ENCODE_FRAME_FENCE\n");
+		rc = vid_enc_encode_frame_fence(client_ctx, &venc_msg);
+		if (rc)
+			return rc;
+		break;
+	}
 	case VEN_IOCTL_SET_INPUT_BUFFER:
 	case VEN_IOCTL_SET_OUTPUT_BUFFER:
 	{
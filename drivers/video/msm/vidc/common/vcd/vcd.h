@@ -383,6 +383,12 @@ u32 vcd_sched_get_client_frame(struct list_head *sched_clnt_list,
 	struct vcd_clnt_ctxt **cctxt,
 	struct vcd_buffer_entry **buffer);
 
+u32 vcd_sched_set_priority(struct vcd_clnt_ctxt *cctxt,
+	struct vcd_property_sched_priority *prio);
+
+u32 vcd_sched_get_priority(struct vcd_clnt_ctxt *cctxt,
+	struct vcd_property_sched_priority *prio);
+
 void vcd_handle_clnt_fatal(struct vcd_clnt_ctxt *cctxt, u32 trans_end);
 
 void vcd_handle_clnt_fatal_input_done(struct vcd_clnt_ctxt *cctxt,
@@ -501,6 +501,12 @@ static u32 vcd_set_property_cmn
 		return VCD_ERR_ILLEGAL_PARM;
 	}
 
+	if (prop_hdr->prop_id == VCD_I_SCHED_PRIORITY) {
+		if (prop_hdr->sz != sizeof(struct vcd_property_sched_priority))
+			return VCD_ERR_ILLEGAL_PARM;
+		return vcd_sched_set_priority(cctxt, prop_val);
+	}
+
 	rc = ddl_set_property(cctxt->ddl_handle, prop_hdr, prop_val);
 	if (rc) {
 		
@@ -591,6 +597,11 @@ static u32 vcd_get_property_cmn
 
 		return VCD_ERR_ILLEGAL_PARM;
 	}
+	if (prop_hdr->prop_id == VCD_I_SCHED_PRIORITY) {
+		if (prop_hdr->sz != sizeof(struct vcd_property_sched_priority))
+			return VCD_ERR_ILLEGAL_PARM;
+		return vcd_sched_get_priority(cctxt, prop_val);
+	}
 	rc = ddl_get_property(cctxt->ddl_handle, prop_hdr, prop_val);
 	if (rc) {
 		
@@ -14,6 +14,7 @@
 #define _VCD_CORE_H_
 
 #include <linux/ion.h>
+#include <linux/ktime.h>
 #include <media/msm/vcd_api.h>
 #include "vcd_ddl_api.h"
 
@@ -81,7 +82,7 @@ struct vcd_buffer_entry {
 	u32 allocated;
 	u32 in_use;
 	struct vcd_frame_data frame;
-
+	ktime_t queued;
 };
 
 struct vcd_buffer_pool {
@@ -174,6 +175,8 @@ struct vcd_sched_clnt_ctx {
 	u32 tkns;
 	u32 round_perfrm;
 	u32 rounds;
+	u32 priority;
+	u32 deadline_us;
 	struct list_head ip_frm_list;
 };
 
@@ -193,6 +196,7 @@ struct vcd_clnt_ctxt {
 	u32 reqd_perf_lvl;
 	u32 time_resoln;
 	u32 time_frame_delta;
+	struct vcd_property_sched_priority sched_prio;
 
 	struct vcd_buffer_pool in_buf_pool;
 	struct vcd_buffer_pool out_buf_pool;
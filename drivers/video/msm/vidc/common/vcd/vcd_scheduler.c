@@ -111,6 +111,9 @@ u32 vcd_sched_add_client(struct vcd_clnt_ctxt *cctxt)
 			memset(sched_cctxt, 0,
 				sizeof(struct vcd_sched_clnt_ctx));
 			sched_cctxt->tkns = 0;
+			sched_cctxt->priority = cctxt->sched_prio.priority;
+			sched_cctxt->deadline_us =
+				cctxt->sched_prio.deadline_us;
 			sched_cctxt->round_perfrm = NORMALIZATION_FACTOR *
 				cctxt->frm_rate.fps_denominator /
 				cctxt->frm_rate.fps_numerator;
@@ -174,10 +177,11 @@ u32 vcd_sched_queue_buffer(
 	if (!sched_cctxt || !buffer) {
 		VCD_MSG_ERROR("%s(): Invalid parameter", __func__);
 		rc = VCD_ERR_ILLEGAL_PARM;
-	} else if (tail)
+	} else if (tail) {
+		buffer->queued = ktime_get();
 		list_add_tail(&buffer->sched_list,
 				&sched_cctxt->ip_frm_list);
-	else
+	} else
 		list_add(&buffer->sched_list, &sched_cctxt->ip_frm_list);
 	return rc;
 }
@@ -242,11 +246,53 @@ u32 vcd_sched_suspend_resume_clnt(
 	return rc;
 }
 
+u32 vcd_sched_set_priority(struct vcd_clnt_ctxt *cctxt,
+	struct vcd_property_sched_priority *prio)
+{
+	if (!cctxt || !prio) {
+		VCD_MSG_ERROR("%s(): Invalid parameter", __func__);
+		return VCD_ERR_ILLEGAL_PARM;
+	}
+	cctxt->sched_prio.priority = prio->priority;
+	cctxt->sched_prio.deadline_us = prio->deadline_us;
+	if (cctxt->sched_clnt_hdl) {
+		cctxt->sched_clnt_hdl->priority = prio->priority;
+		cctxt->sched_clnt_hdl->deadline_us = prio->deadline_us;
+	}
+	return VCD_S_SUCCESS;
+}
+
+u32 vcd_sched_get_priority(struct vcd_clnt_ctxt *cctxt,
+	struct vcd_property_sched_priority *prio)
+{
+	if (!cctxt || !prio) {
+		VCD_MSG_ERROR("%s(): Invalid parameter", __func__);
+		return VCD_ERR_ILLEGAL_PARM;
+	}
+	*prio = cctxt->sched_prio;
+	return VCD_S_SUCCESS;
+}
+
+static void vcd_sched_check_deadline(struct vcd_sched_clnt_ctx *sched_cctxt,
+	struct vcd_buffer_entry *buffer)
+{
+	s64 waited;
+	if (!sched_cctxt->deadline_us)
+		return;
+	waited = ktime_us_delta(ktime_get(), buffer->queued);
+	if (waited > sched_cctxt->deadline_us) {
+		((struct vcd_clnt_ctxt *)sched_cctxt->clnt_data)->
+			sched_prio.missed++;
+		VCD_MSG_MED("%s(): client %p waited %lld us", __func__,
+			sched_cctxt->clnt_data, waited);
+	}
+}
+
 u32 vcd_sched_get_client_frame(struct list_head *sched_clnt_list,
 	struct vcd_clnt_ctxt **cctxt,
 	struct vcd_buffer_entry **buffer)
 {
-	u32 rc = VCD_ERR_QEMPTY, round_adjustment = 0;
+	u32 rc = VCD_ERR_QEMPTY, round_adjustment = 0, top_prio = 0;
 	struct vcd_sched_clnt_ctx *sched_clnt, *clnt_nxt;
 	if (!sched_clnt_list || !cctxt || !buffer) {
 		VCD_MSG_ERROR("%s(): Invalid parameter", __func__);
@@ -254,6 +300,12 @@ u32 vcd_sched_get_client_frame(struct list_head *sched_clnt_list,
 	} else if (!list_empty(sched_clnt_list)) {
 		*cctxt = NULL;
 		*buffer = NULL;
+		list_for_each_entry(sched_clnt, sched_clnt_list, list) {
+			if (sched_clnt->tkns &&
+				!list_empty(&sched_clnt->ip_frm_list) &&
+				sched_clnt->priority > top_prio)
+				top_prio = sched_clnt->priority;
+		}
 		list_for_each_entry_safe(sched_clnt,
 			clnt_nxt, sched_clnt_list, list) {
 			if (&sched_clnt->list == sched_clnt_list->next)
@@ -266,6 +318,7 @@ u32 vcd_sched_get_client_frame(struct list_head *sched_clnt_list,
 				ADJUST_CLIENT_ROUNDS(sched_clnt,
 					round_adjustment);
 			} else if (sched_clnt->tkns &&
+				sched_clnt->priority == top_prio &&
 				!list_empty(&sched_clnt->ip_frm_list)) {
 				*cctxt = sched_clnt->clnt_data;
 				sched_clnt->rounds += sched_clnt->round_perfrm;
@@ -277,6 +330,8 @@ u32 vcd_sched_get_client_frame(struct list_head *sched_clnt_list,
 			rc = vcd_sched_dequeue_buffer(
 				(*cctxt)->sched_clnt_hdl, buffer);
 			if (rc == VCD_S_SUCCESS) {
+				vcd_sched_check_deadline(
+					(*cctxt)->sched_clnt_hdl, *buffer);
 				(*cctxt)->sched_clnt_hdl->tkns--;
 				ADJUST_CLIENT_ROUNDS((*cctxt)->\
 					sched_clnt_hdl, round_adjustment);
@@ -31,23 +31,13 @@
 #include <linux/key.h>
 #include <linux/namei.h>
 #include <linux/crypto.h>
+#include <linux/completion.h>
 #include <linux/file.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
 #include <asm/unaligned.h>
 #include "ecryptfs_kernel.h"
 
-static int
-ecryptfs_decrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv);
-static int
-ecryptfs_encrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv);
-
 void ecryptfs_to_hex(char *dst, char *src, size_t src_size)
 {
 	int x;
@@ -192,7 +182,7 @@ void ecryptfs_destroy_crypt_stat(struct ecryptfs_crypt_stat *crypt_stat)
 	struct ecryptfs_key_sig *key_sig, *key_sig_tmp;
 
 	if (crypt_stat->tfm)
-		crypto_free_blkcipher(crypt_stat->tfm);
+		crypto_free_ablkcipher(crypt_stat->tfm);
 	if (crypt_stat->hash_tfm)
 		crypto_free_hash(crypt_stat->hash_tfm);
 	list_for_each_entry_safe(key_sig, key_sig_tmp,
@@ -258,16 +248,71 @@ int virt_to_scatterlist(const void *addr, int size, struct scatterlist *sg,
 	return i;
 }
 
-static int encrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
-			       struct scatterlist *dest_sg,
-			       struct scatterlist *src_sg, int size,
-			       unsigned char *iv)
+struct extent_crypt_result {
+	struct completion completion;
+	atomic_t pending;
+	int rc;
+};
+
+/*
+ * One request per extent of a page.  The cipher context follows the
+ * request, so the stride is rounded to keep every __ctx aligned.
+ */
+struct extent_crypt_req {
+	struct scatterlist src_sg;
+	struct scatterlist dst_sg;
+	char iv[ECRYPTFS_MAX_IV_BYTES];
+	struct ablkcipher_request req;
+};
+
+#define ENCRYPT		1
+#define DECRYPT		0
+
+static void extent_crypt_complete(struct crypto_async_request *req, int rc)
 {
-	struct blkcipher_desc desc = {
-		.tfm = crypt_stat->tfm,
-		.info = iv,
-		.flags = CRYPTO_TFM_REQ_MAY_SLEEP
-	};
+	struct extent_crypt_result *ecr = req->data;
+
+	if (rc == -EINPROGRESS)
+		return;
+
+	if (rc)
+		ecr->rc = rc;
+	if (atomic_dec_and_test(&ecr->pending))
+		complete(&ecr->completion);
+}
+
+static void ecryptfs_lower_offset_for_extent(loff_t *offset, loff_t extent_num,
+					     struct ecryptfs_crypt_stat *crypt_stat)
+{
+	(*offset) = ecryptfs_lower_header_size(crypt_stat)
+		    + (crypt_stat->extent_size * extent_num);
+}
+
+/**
+ * crypt_page
+ * @crypt_stat: Cryptographic context for the file
+ * @dst_page: The page to write the result to
+ * @src_page: The page to read from, may be @dst_page
+ * @index: Upper page index, the extent IVs are derived from it
+ * @op: ENCRYPT or DECRYPT
+ *
+ * Submits the requests for all extents of the page before waiting, so
+ * an asynchronous cipher driver has them all in flight at once.  The
+ * tfm mutex only covers setting the key; requests carry their own state.
+ *
+ * Returns zero on success; negative on error
+ */
+static int crypt_page(struct ecryptfs_crypt_stat *crypt_stat,
+		      struct page *dst_page, struct page *src_page,
+		      pgoff_t index, int op)
+{
+	unsigned long extents = PAGE_CACHE_SIZE / crypt_stat->extent_size;
+	loff_t extent_base = (loff_t)index * extents;
+	struct extent_crypt_result ecr;
+	struct extent_crypt_req *ereq;
+	unsigned long i;
+	size_t stride;
+	char *reqs;
 	int rc = 0;
 
 	BUG_ON(!crypt_stat || !crypt_stat->tfm
@@ -278,66 +323,86 @@ static int encrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
 		ecryptfs_dump_hex(crypt_stat->key,
 				  crypt_stat->key_size);
 	}
-	
+
 	mutex_lock(&crypt_stat->cs_tfm_mutex);
 	if (!(crypt_stat->flags & ECRYPTFS_KEY_SET)) {
-		rc = crypto_blkcipher_setkey(crypt_stat->tfm, crypt_stat->key,
-					     crypt_stat->key_size);
-		crypt_stat->flags |= ECRYPTFS_KEY_SET;
+		rc = crypto_ablkcipher_setkey(crypt_stat->tfm, crypt_stat->key,
+					      crypt_stat->key_size);
+		if (!rc)
+			crypt_stat->flags |= ECRYPTFS_KEY_SET;
 	}
+	mutex_unlock(&crypt_stat->cs_tfm_mutex);
 	if (rc) {
 		ecryptfs_printk(KERN_ERR, "Error setting key; rc = [%d]\n",
 				rc);
-		mutex_unlock(&crypt_stat->cs_tfm_mutex);
-		rc = -EINVAL;
-		goto out;
+		return -EINVAL;
 	}
-	ecryptfs_printk(KERN_DEBUG, "Encrypting [%d] bytes.\n", size);
-	crypto_blkcipher_encrypt_iv(&desc, dest_sg, src_sg, size);
-	mutex_unlock(&crypt_stat->cs_tfm_mutex);
-out:
-	return rc;
-}
 
-static void ecryptfs_lower_offset_for_extent(loff_t *offset, loff_t extent_num,
-					     struct ecryptfs_crypt_stat *crypt_stat)
-{
-	(*offset) = ecryptfs_lower_header_size(crypt_stat)
-		    + (crypt_stat->extent_size * extent_num);
-}
+	stride = ALIGN(sizeof(*ereq) +
+		       crypto_ablkcipher_reqsize(crypt_stat->tfm),
+		       CRYPTO_MINALIGN);
+	reqs = kmalloc(stride * extents, GFP_NOFS);
+	if (!reqs)
+		return -ENOMEM;
 
-static int ecryptfs_encrypt_extent(struct page *enc_extent_page,
-				   struct ecryptfs_crypt_stat *crypt_stat,
-				   struct page *page,
-				   unsigned long extent_offset)
-{
-	loff_t extent_base;
-	char extent_iv[ECRYPTFS_MAX_IV_BYTES];
-	int rc;
+	init_completion(&ecr.completion);
+	/* Biased by one so no completion fires before all are submitted */
+	atomic_set(&ecr.pending, 1);
+	ecr.rc = 0;
 
-	extent_base = (((loff_t)page->index)
-		       * (PAGE_CACHE_SIZE / crypt_stat->extent_size));
-	rc = ecryptfs_derive_iv(extent_iv, crypt_stat,
-				(extent_base + extent_offset));
-	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error attempting to derive IV for "
-			"extent [0x%.16llx]; rc = [%d]\n",
-			(unsigned long long)(extent_base + extent_offset), rc);
-		goto out;
-	}
-	rc = ecryptfs_encrypt_page_offset(crypt_stat, enc_extent_page, 0,
-					  page, (extent_offset
-						 * crypt_stat->extent_size),
-					  crypt_stat->extent_size, extent_iv);
-	if (rc < 0) {
-		printk(KERN_ERR "%s: Error attempting to encrypt page with "
-		       "page->index = [%ld], extent_offset = [%ld]; "
-		       "rc = [%d]\n", __func__, page->index, extent_offset,
-		       rc);
-		goto out;
+	for (i = 0; i < extents; i++) {
+		unsigned int offset = i * crypt_stat->extent_size;
+
+		ereq = (struct extent_crypt_req *)(reqs + i * stride);
+		rc = ecryptfs_derive_iv(ereq->iv, crypt_stat, extent_base + i);
+		if (rc) {
+			ecryptfs_printk(KERN_ERR, "Error attempting to derive "
+				"IV for extent [0x%.16llx]; rc = [%d]\n",
+				(unsigned long long)(extent_base + i), rc);
+			break;
+		}
+
+		sg_init_table(&ereq->src_sg, 1);
+		sg_set_page(&ereq->src_sg, src_page, crypt_stat->extent_size,
+			    offset);
+		sg_init_table(&ereq->dst_sg, 1);
+		sg_set_page(&ereq->dst_sg, dst_page, crypt_stat->extent_size,
+			    offset);
+
+		ablkcipher_request_set_tfm(&ereq->req, crypt_stat->tfm);
+		ablkcipher_request_set_callback(&ereq->req,
+				CRYPTO_TFM_REQ_MAY_BACKLOG |
+				CRYPTO_TFM_REQ_MAY_SLEEP,
+				extent_crypt_complete, &ecr);
+		ablkcipher_request_set_crypt(&ereq->req, &ereq->src_sg,
+					     &ereq->dst_sg,
+					     crypt_stat->extent_size,
+					     ereq->iv);
+
+		atomic_inc(&ecr.pending);
+		rc = op == ENCRYPT ? crypto_ablkcipher_encrypt(&ereq->req) :
+				     crypto_ablkcipher_decrypt(&ereq->req);
+		if (rc == -EINPROGRESS || rc == -EBUSY) {
+			rc = 0;
+			continue;
+		}
+		/* Completed synchronously, the callback is not called */
+		atomic_dec(&ecr.pending);
+		if (rc) {
+			ecryptfs_printk(KERN_ERR, "Error %scrypting extent "
+				"[0x%.16llx]; rc = [%d]\n",
+				op == ENCRYPT ? "en" : "de",
+				(unsigned long long)(extent_base + i), rc);
+			break;
+		}
 	}
-	rc = 0;
-out:
+
+	if (!atomic_dec_and_test(&ecr.pending))
+		wait_for_completion(&ecr.completion);
+	if (!rc)
+		rc = ecr.rc;
+
+	kfree(reqs);
 	return rc;
 }
 
@@ -347,9 +412,10 @@ out:
  *        decrypted content that needs to be encrypted (to a temporary
  *        page; not in place) and written out to the lower file
  *
- * Encrypt an eCryptfs page. This is done on a per-extent basis. Note
- * that eCryptfs pages may straddle the lower pages -- for instance,
- * if the file was created on a machine with an 8K page size
+ * Encrypt an eCryptfs page. All extents are encrypted into one
+ * temporary page, which is then written to the lower file at once.
+ * Note that eCryptfs pages may straddle the lower pages -- for
+ * instance, if the file was created on a machine with an 8K page size
  * (resulting in an 8K header), and then the file is copied onto a
  * host with a 32K page size, then when reading page 0 of the eCryptfs
  * file, 24K of page 0 of the lower file will be read and decrypted,
@@ -363,7 +429,7 @@ int ecryptfs_encrypt_page(struct page *page)
 	struct ecryptfs_crypt_stat *crypt_stat;
 	char *enc_extent_virt;
 	struct page *enc_extent_page = NULL;
-	loff_t extent_offset;
+	loff_t lower_offset;
 	int rc = 0;
 
 	ecryptfs_inode = page->mapping->host;
@@ -377,75 +443,32 @@ int ecryptfs_encrypt_page(struct page *page)
 				"encrypted extent\n");
 		goto out;
 	}
-	enc_extent_virt = kmap(enc_extent_page);
-	for (extent_offset = 0;
-	     extent_offset < (PAGE_CACHE_SIZE / crypt_stat->extent_size);
-	     extent_offset++) {
-		loff_t offset;
-
-		rc = ecryptfs_encrypt_extent(enc_extent_page, crypt_stat, page,
-					     extent_offset);
-		if (rc) {
-			printk(KERN_ERR "%s: Error encrypting extent; "
-			       "rc = [%d]\n", __func__, rc);
-			goto out;
-		}
-		ecryptfs_lower_offset_for_extent(
-			&offset, ((((loff_t)page->index)
-				   * (PAGE_CACHE_SIZE
-				      / crypt_stat->extent_size))
-				  + extent_offset), crypt_stat);
-		rc = ecryptfs_write_lower(ecryptfs_inode, enc_extent_virt,
-					  offset, crypt_stat->extent_size);
-		if (rc < 0) {
-			ecryptfs_printk(KERN_ERR, "Error attempting "
-					"to write lower page; rc = [%d]"
-					"\n", rc);
-			goto out;
-		}
-	}
-	rc = 0;
-out:
-	if (enc_extent_page) {
-		kunmap(enc_extent_page);
-		__free_page(enc_extent_page);
-	}
-	return rc;
-}
 
-static int ecryptfs_decrypt_extent(struct page *page,
-				   struct ecryptfs_crypt_stat *crypt_stat,
-				   struct page *enc_extent_page,
-				   unsigned long extent_offset)
-{
-	loff_t extent_base;
-	char extent_iv[ECRYPTFS_MAX_IV_BYTES];
-	int rc;
-
-	extent_base = (((loff_t)page->index)
-		       * (PAGE_CACHE_SIZE / crypt_stat->extent_size));
-	rc = ecryptfs_derive_iv(extent_iv, crypt_stat,
-				(extent_base + extent_offset));
+	rc = crypt_page(crypt_stat, enc_extent_page, page, page->index,
+			ENCRYPT);
 	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error attempting to derive IV for "
-			"extent [0x%.16llx]; rc = [%d]\n",
-			(unsigned long long)(extent_base + extent_offset), rc);
+		printk(KERN_ERR "%s: Error encrypting page with index "
+		       "[%ld]; rc = [%d]\n", __func__, page->index, rc);
 		goto out;
 	}
-	rc = ecryptfs_decrypt_page_offset(crypt_stat, page,
-					  (extent_offset
-					   * crypt_stat->extent_size),
-					  enc_extent_page, 0,
-					  crypt_stat->extent_size, extent_iv);
+
+	ecryptfs_lower_offset_for_extent(&lower_offset,
+		(loff_t)page->index * (PAGE_CACHE_SIZE /
+				       crypt_stat->extent_size), crypt_stat);
+	enc_extent_virt = kmap(enc_extent_page);
+	rc = ecryptfs_write_lower(ecryptfs_inode, enc_extent_virt,
+				  lower_offset, PAGE_CACHE_SIZE);
+	kunmap(enc_extent_page);
 	if (rc < 0) {
-		printk(KERN_ERR "%s: Error attempting to decrypt to page with "
-		       "page->index = [%ld], extent_offset = [%ld]; "
-		       "rc = [%d]\n", __func__, page->index, extent_offset,
-		       rc);
+		ecryptfs_printk(KERN_ERR, "Error attempting "
+				"to write lower page; rc = [%d]"
+				"\n", rc);
 		goto out;
 	}
 	rc = 0;
 out:
+	if (enc_extent_page)
+		__free_page(enc_extent_page);
 	return rc;
 }
 
@@ -455,13 +478,15 @@ out:
  *        and decrypted from the lower file will be written into this
  *        page
  *
- * Decrypt an eCryptfs page. This is done on a per-extent basis. Note
- * that eCryptfs pages may straddle the lower pages -- for instance,
- * if the file was created on a machine with an 8K page size
- * (resulting in an 8K header), and then the file is copied onto a
- * host with a 32K page size, then when reading page 0 of the eCryptfs
- * file, 24K of page 0 of the lower file will be read and decrypted,
- * and then 8K of page 1 of the lower file will be read and decrypted.
+ * Decrypt an eCryptfs page. The encrypted extents are read from the
+ * lower file straight into @page and decrypted in place, without a
+ * temporary page. Note that eCryptfs pages may straddle the lower
+ * pages -- for instance, if the file was created on a machine with an
+ * 8K page size (resulting in an 8K header), and then the file is
+ * copied onto a host with a 32K page size, then when reading page 0
+ * of the eCryptfs file, 24K of page 0 of the lower file will be read
+ * and decrypted, and then 8K of page 1 of the lower file will be read
+ * and decrypted.
  *
  * Returns zero on success; negative on error
  */
@@ -469,126 +494,39 @@ int ecryptfs_decrypt_page(struct page *page)
 {
 	struct inode *ecryptfs_inode;
 	struct ecryptfs_crypt_stat *crypt_stat;
-	char *enc_extent_virt;
-	struct page *enc_extent_page = NULL;
-	unsigned long extent_offset;
+	char *page_virt;
+	loff_t lower_offset;
 	int rc = 0;
 
 	ecryptfs_inode = page->mapping->host;
 	crypt_stat =
 		&(ecryptfs_inode_to_private(ecryptfs_inode)->crypt_stat);
 	BUG_ON(!(crypt_stat->flags & ECRYPTFS_ENCRYPTED));
-	enc_extent_page = alloc_page(GFP_USER);
-	if (!enc_extent_page) {
-		rc = -ENOMEM;
-		ecryptfs_printk(KERN_ERR, "Error allocating memory for "
-				"encrypted extent\n");
-		goto out;
-	}
-	enc_extent_virt = kmap(enc_extent_page);
-	for (extent_offset = 0;
-	     extent_offset < (PAGE_CACHE_SIZE / crypt_stat->extent_size);
-	     extent_offset++) {
-		loff_t offset;
-
-		ecryptfs_lower_offset_for_extent(
-			&offset, ((page->index * (PAGE_CACHE_SIZE
-						  / crypt_stat->extent_size))
-				  + extent_offset), crypt_stat);
-		rc = ecryptfs_read_lower(enc_extent_virt, offset,
-					 crypt_stat->extent_size,
-					 ecryptfs_inode);
-		if (rc < 0) {
-			ecryptfs_printk(KERN_ERR, "Error attempting "
-					"to read lower page; rc = [%d]"
-					"\n", rc);
-			goto out;
-		}
-		rc = ecryptfs_decrypt_extent(page, crypt_stat, enc_extent_page,
-					     extent_offset);
-		if (rc) {
-			printk(KERN_ERR "%s: Error encrypting extent; "
-			       "rc = [%d]\n", __func__, rc);
-			goto out;
-		}
-	}
-out:
-	if (enc_extent_page) {
-		kunmap(enc_extent_page);
-		__free_page(enc_extent_page);
-	}
-	return rc;
-}
-
-static int decrypt_scatterlist(struct ecryptfs_crypt_stat *crypt_stat,
-			       struct scatterlist *dest_sg,
-			       struct scatterlist *src_sg, int size,
-			       unsigned char *iv)
-{
-	struct blkcipher_desc desc = {
-		.tfm = crypt_stat->tfm,
-		.info = iv,
-		.flags = CRYPTO_TFM_REQ_MAY_SLEEP
-	};
-	int rc = 0;
 
-	
-	mutex_lock(&crypt_stat->cs_tfm_mutex);
-	rc = crypto_blkcipher_setkey(crypt_stat->tfm, crypt_stat->key,
-				     crypt_stat->key_size);
-	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error setting key; rc = [%d]\n",
-				rc);
-		mutex_unlock(&crypt_stat->cs_tfm_mutex);
-		rc = -EINVAL;
+	ecryptfs_lower_offset_for_extent(&lower_offset,
+		(loff_t)page->index * (PAGE_CACHE_SIZE /
+				       crypt_stat->extent_size), crypt_stat);
+	page_virt = kmap(page);
+	rc = ecryptfs_read_lower(page_virt, lower_offset, PAGE_CACHE_SIZE,
+				 ecryptfs_inode);
+	kunmap(page);
+	if (rc < 0) {
+		ecryptfs_printk(KERN_ERR, "Error attempting "
+				"to read lower page; rc = [%d]"
+				"\n", rc);
 		goto out;
 	}
-	ecryptfs_printk(KERN_DEBUG, "Decrypting [%d] bytes.\n", size);
-	rc = crypto_blkcipher_decrypt_iv(&desc, dest_sg, src_sg, size);
-	mutex_unlock(&crypt_stat->cs_tfm_mutex);
+
+	rc = crypt_page(crypt_stat, page, page, page->index, DECRYPT);
 	if (rc) {
-		ecryptfs_printk(KERN_ERR, "Error decrypting; rc = [%d]\n",
-				rc);
+		printk(KERN_ERR "%s: Error decrypting page with index "
+		       "[%ld]; rc = [%d]\n", __func__, page->index, rc);
 		goto out;
 	}
-	rc = size;
 out:
 	return rc;
 }
 
-static int
-ecryptfs_encrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv)
-{
-	struct scatterlist src_sg, dst_sg;
-
-	sg_init_table(&src_sg, 1);
-	sg_init_table(&dst_sg, 1);
-
-	sg_set_page(&src_sg, src_page, size, src_offset);
-	sg_set_page(&dst_sg, dst_page, size, dst_offset);
-	return encrypt_scatterlist(crypt_stat, &dst_sg, &src_sg, size, iv);
-}
-
-static int
-ecryptfs_decrypt_page_offset(struct ecryptfs_crypt_stat *crypt_stat,
-			     struct page *dst_page, int dst_offset,
-			     struct page *src_page, int src_offset, int size,
-			     unsigned char *iv)
-{
-	struct scatterlist src_sg, dst_sg;
-
-	sg_init_table(&src_sg, 1);
-	sg_set_page(&src_sg, src_page, size, src_offset);
-
-	sg_init_table(&dst_sg, 1);
-	sg_set_page(&dst_sg, dst_page, size, dst_offset);
-
-	return decrypt_scatterlist(crypt_stat, &dst_sg, &src_sg, size, iv);
-}
-
 #define ECRYPTFS_MAX_SCATTERLIST_LEN 4
 
 int ecryptfs_init_crypt_ctx(struct ecryptfs_crypt_stat *crypt_stat)
@@ -614,8 +552,7 @@ int ecryptfs_init_crypt_ctx(struct ecryptfs_crypt_stat *crypt_stat)
 						    crypt_stat->cipher, "cbc");
 	if (rc)
 		goto out_unlock;
-	crypt_stat->tfm = crypto_alloc_blkcipher(full_alg_name, 0,
-						 CRYPTO_ALG_ASYNC);
+	crypt_stat->tfm = crypto_alloc_ablkcipher(full_alg_name, 0, 0);
 	kfree(full_alg_name);
 	if (IS_ERR(crypt_stat->tfm)) {
 		rc = PTR_ERR(crypt_stat->tfm);
@@ -625,7 +562,7 @@ int ecryptfs_init_crypt_ctx(struct ecryptfs_crypt_stat *crypt_stat)
 				crypt_stat->cipher);
 		goto out_unlock;
 	}
-	crypto_blkcipher_set_flags(crypt_stat->tfm, CRYPTO_TFM_REQ_WEAK_KEY);
+	crypto_ablkcipher_set_flags(crypt_stat->tfm, CRYPTO_TFM_REQ_WEAK_KEY);
 	rc = 0;
 out_unlock:
 	mutex_unlock(&crypt_stat->cs_tfm_mutex);
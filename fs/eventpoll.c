@@ -603,9 +603,15 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 		goto out_unlock;
 	}
 
-	
-	if (!ep_is_linked(&epi->rdllink))
-		list_add_tail(&epi->rdllink, &ep->rdllist);
+	/*
+	 * An item already on the ready list had its wakeup issued when it
+	 * was linked (here, or by insert, modify or the end of a scan), and
+	 * the woken waiter harvests it with everything else that is ready.
+	 * Repeated events on the same fd do not wake anyone again.
+	 */
+	if (ep_is_linked(&epi->rdllink))
+		goto out_unlock;
+	list_add_tail(&epi->rdllink, &ep->rdllist);
 
 	if (waitqueue_active(&ep->wq))
 		wake_up_locked(&ep->wq);
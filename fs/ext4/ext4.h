@@ -930,6 +930,7 @@ struct ext4_sb_info {
 	unsigned long s_commit_interval;
 	u32 s_max_batch_time;
 	u32 s_min_batch_time;
+	u32 s_fsync_batch_time;
 	struct block_device *journal_bdev;
 #ifdef CONFIG_QUOTA
 	char *s_qf_names[MAXQUOTAS];		
@@ -1011,6 +1012,12 @@ struct ext4_sb_info {
 	
 	atomic_t s_last_trim_minblks;
 
+	/* Background trim of freed groups while the device idles */
+	struct delayed_work s_idle_trim_work;
+	unsigned int s_idle_trim_interval;	/* ms between passes, 0 off */
+	unsigned int s_idle_trim_budget;	/* ms per pass */
+	ext4_group_t s_idle_trim_group;		/* where the next pass starts */
+
 #ifdef CONFIG_EXT4_E2FSCK_RECOVER
 	
 	struct work_struct reboot_work;
@@ -1522,6 +1529,7 @@ extern int ext4_mb_add_groupinfo(struct super_block *sb,
 extern int ext4_group_add_blocks(handle_t *handle, struct super_block *sb,
 				ext4_fsblk_t block, unsigned long count);
 extern int ext4_trim_fs(struct super_block *, struct fstrim_range *);
+extern void ext4_idle_trim_work(struct work_struct *work);
 
 struct buffer_head *ext4_getblk(handle_t *, struct inode *,
 						ext4_lblk_t, int, int *);
@@ -1780,6 +1788,7 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_fragments;	
 	ext4_grpblk_t	bb_largest_free_order;
 	struct          list_head bb_prealloc_list;
+	atomic_t	bb_busy;	/* allocator found the lock held */
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
 #endif
@@ -1826,6 +1835,18 @@ static inline void ext4_lock_group(struct super_block *sb, ext4_group_t group)
 	}
 }
 
+static inline int ext4_trylock_group(struct super_block *sb,
+				     ext4_group_t group)
+{
+	if (!spin_trylock(ext4_group_lock_ptr(sb, group))) {
+		atomic_add_unless(&EXT4_SB(sb)->s_lock_busy, 1,
+				  EXT4_MAX_CONTENTION);
+		return 0;
+	}
+	atomic_add_unless(&EXT4_SB(sb)->s_lock_busy, -1, 0);
+	return 1;
+}
+
 static inline void ext4_unlock_group(struct super_block *sb,
 					ext4_group_t group)
 {
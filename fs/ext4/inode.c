@@ -2940,6 +2940,19 @@ struct inode *ext4_iget(struct super_block *sb, unsigned long ino)
 		EXT4_ERROR_INODE(inode, "bogus i_mode (%o)", inode->i_mode);
 		goto bad_inode;
 	}
+#ifdef CONFIG_EXT4_FS_POSIX_ACL
+	/*
+	 * Load the access ACL while the inode block is cached, or the first
+	 * rcu-walk permission check on the inode has to drop to ref-walk.
+	 * ACLs in an external xattr block are left for their first use.
+	 */
+	if (IS_POSIXACL(inode) && !ei->i_file_acl) {
+		struct posix_acl *acl = ext4_get_acl(inode, ACL_TYPE_ACCESS);
+
+		if (!IS_ERR(acl))
+			posix_acl_release(acl);
+	}
+#endif
 	brelse(iloc.bh);
 	ext4_set_inode_flags(inode);
 	unlock_new_inode(inode);
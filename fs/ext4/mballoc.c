@@ -22,6 +22,8 @@
 #include "mballoc.h"
 #include <linux/debugfs.h>
 #include <linux/slab.h>
+#include <linux/blkdev.h>
+#include <linux/power_supply.h>
 #include <trace/events/ext4.h>
 
 
@@ -1414,7 +1416,7 @@ static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
 	ext4_group_t ngroups, group, i;
-	int cr;
+	int cr, skip_busy, skipped;
 	int err = 0;
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
@@ -1458,7 +1460,15 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 repeat:
 	for (; cr < 4 && ac->ac_status == AC_STATUS_CONTINUE; cr++) {
 		ac->ac_criteria = cr;
+		/*
+		 * Parallel writers would spin on the lock of the same good
+		 * group: pass over groups whose lock is held first, and only
+		 * wait for them if nothing else at this criteria fits.
+		 */
+		skip_busy = 1;
+rescan:
 		group = ac->ac_g_ex.fe_group;
+		skipped = 0;
 
 		for (i = 0; i < ngroups; group++, i++) {
 			if (group == ngroups)
@@ -1472,7 +1482,15 @@ repeat:
 			if (err)
 				goto out;
 
-			ext4_lock_group(sb, group);
+			if (!ext4_trylock_group(sb, group)) {
+				atomic_inc(&e4b.bd_info->bb_busy);
+				if (skip_busy) {
+					skipped++;
+					ext4_mb_unload_buddy(&e4b);
+					continue;
+				}
+				spin_lock(ext4_group_lock_ptr(sb, group));
+			}
 
 			if (!ext4_mb_good_group(ac, group, cr)) {
 				ext4_unlock_group(sb, group);
@@ -1495,6 +1513,11 @@ repeat:
 			if (ac->ac_status != AC_STATUS_CONTINUE)
 				break;
 		}
+
+		if (skipped && ac->ac_status == AC_STATUS_CONTINUE) {
+			skip_busy = 0;
+			goto rescan;
+		}
 	}
 
 	if (ac->ac_b_ex.fe_len > 0 && ac->ac_status != AC_STATUS_FOUND &&
@@ -1553,10 +1576,10 @@ static int ext4_mb_seq_groups_show(struct seq_file *seq, void *v)
 
 	group--;
 	if (group == 0)
-		seq_printf(seq, "#%-5s: %-5s %-5s %-5s "
+		seq_printf(seq, "#%-5s: %-5s %-5s %-5s %-5s "
 				"[ %-5s %-5s %-5s %-5s %-5s %-5s %-5s "
 				  "%-5s %-5s %-5s %-5s %-5s %-5s %-5s ]\n",
-			   "group", "free", "frags", "first",
+			   "group", "free", "frags", "first", "busy",
 			   "2^0", "2^1", "2^2", "2^3", "2^4", "2^5", "2^6",
 			   "2^7", "2^8", "2^9", "2^10", "2^11", "2^12", "2^13");
 
@@ -1572,8 +1595,9 @@ static int ext4_mb_seq_groups_show(struct seq_file *seq, void *v)
 	ext4_unlock_group(sb, group);
 	ext4_mb_unload_buddy(&e4b);
 
-	seq_printf(seq, "#%-5u: %-5u %-5u %-5u [", group, sg.info.bb_free,
-			sg.info.bb_fragments, sg.info.bb_first_free);
+	seq_printf(seq, "#%-5u: %-5u %-5u %-5u %-5u [", group, sg.info.bb_free,
+			sg.info.bb_fragments, sg.info.bb_first_free,
+			atomic_read(&sg.info.bb_busy));
 	for (i = 0; i <= 13; i++)
 		seq_printf(seq, " %-5u", i <= sb->s_blocksize_bits + 1 ?
 				sg.info.bb_counters[i] : 0);
@@ -4079,3 +4103,88 @@ out:
 	range->len = trimmed * sb->s_blocksize;
 	return ret;
 }
+
+#define EXT4_IDLE_TRIM_BUDGET	200	/* ms, when s_idle_trim_budget is 0 */
+
+static bool ext4_idle_trim_allowed(struct super_block *sb)
+{
+	struct request_queue *q = bdev_get_queue(sb->s_bdev);
+	int supplied;
+
+	if (!(sb->s_flags & MS_ACTIVE) || (sb->s_flags & MS_RDONLY) ||
+	    !blk_queue_discard(q))
+		return false;
+
+	/* Any request allocated against the queue means foreground I/O */
+	if (q->rq.count[BLK_RW_SYNC] || q->rq.count[BLK_RW_ASYNC])
+		return false;
+
+	/* Only on external power, unless there is no power supply class */
+	supplied = power_supply_is_system_supplied();
+	return supplied != 0;
+}
+
+/*
+ * Discard the free space of groups freed into since they were last trimmed,
+ * starting where the previous pass stopped.  Stops at the budget or as soon
+ * as the queue sees other I/O, so the discards never queue up ahead of
+ * foreground requests for long.
+ */
+static void ext4_idle_trim(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct request_queue *q = bdev_get_queue(sb->s_bdev);
+	ext4_group_t ngroups = ext4_get_groups_count(sb);
+	ext4_group_t group = sbi->s_idle_trim_group;
+	ext4_grpblk_t minblocks;
+	unsigned long deadline;
+	unsigned int budget;
+	ext4_group_t i;
+
+	budget = sbi->s_idle_trim_budget ?: EXT4_IDLE_TRIM_BUDGET;
+	deadline = jiffies + msecs_to_jiffies(budget);
+	minblocks = max_t(ext4_grpblk_t, 1,
+			  q->limits.discard_granularity >> sb->s_blocksize_bits);
+
+	for (i = 0; i < ngroups; i++, group++) {
+		struct ext4_group_info *grp;
+
+		if (group >= ngroups)
+			group = 0;
+
+		if (time_after(jiffies, deadline) ||
+		    !ext4_idle_trim_allowed(sb))
+			break;
+
+		grp = ext4_get_group_info(sb, group);
+		if (EXT4_MB_GRP_WAS_TRIMMED(grp) || grp->bb_free < minblocks)
+			continue;
+		if (unlikely(EXT4_MB_GRP_NEED_INIT(grp)) &&
+		    ext4_mb_init_group(sb, group))
+			break;
+
+		if (ext4_trim_all_free(sb, group, 0,
+				       EXT4_CLUSTERS_PER_GROUP(sb) - 1,
+				       minblocks) < 0)
+			break;
+	}
+
+	sbi->s_idle_trim_group = group;
+}
+
+void ext4_idle_trim_work(struct work_struct *work)
+{
+	struct ext4_sb_info *sbi = container_of(to_delayed_work(work),
+						struct ext4_sb_info,
+						s_idle_trim_work);
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+
+	if (!sbi->s_idle_trim_interval || !(sb->s_flags & MS_ACTIVE))
+		return;
+
+	if (ext4_idle_trim_allowed(sb))
+		ext4_idle_trim(sb);
+
+	queue_delayed_work(system_freezable_wq, &sbi->s_idle_trim_work,
+			   msecs_to_jiffies(sbi->s_idle_trim_interval));
+}
@@ -778,6 +778,7 @@ static void ext4_put_super(struct super_block *sb)
 	int i, err;
 
 	ext4_unregister_li_request(sb);
+	cancel_delayed_work_sync(&sbi->s_idle_trim_work);
 	dquot_disable(sb, -1, DQUOT_USAGE_ENABLED | DQUOT_LIMITS_ENABLED);
 
 	flush_workqueue(sbi->dio_unwritten_wq);
@@ -1092,7 +1093,7 @@ enum {
 	Opt_nouid32, Opt_debug, Opt_removed,
 	Opt_user_xattr, Opt_nouser_xattr, Opt_acl, Opt_noacl,
 	Opt_auto_da_alloc, Opt_noauto_da_alloc, Opt_noload,
-	Opt_commit, Opt_min_batch_time, Opt_max_batch_time,
+	Opt_commit, Opt_min_batch_time, Opt_max_batch_time, Opt_fsync_batch_time,
 	Opt_journal_dev, Opt_journal_checksum, Opt_journal_async_commit,
 	Opt_abort, Opt_data_journal, Opt_data_ordered, Opt_data_writeback,
 	Opt_data_err_abort, Opt_data_err_ignore,
@@ -1135,6 +1136,7 @@ static const match_table_t tokens = {
 	{Opt_commit, "commit=%u"},
 	{Opt_min_batch_time, "min_batch_time=%u"},
 	{Opt_max_batch_time, "max_batch_time=%u"},
+	{Opt_fsync_batch_time, "fsync_batch_time=%u"},
 	{Opt_journal_dev, "journal_dev=%u"},
 	{Opt_journal_checksum, "journal_checksum"},
 	{Opt_journal_async_commit, "journal_async_commit"},
@@ -1318,6 +1320,7 @@ static const struct mount_opts {
 	{Opt_commit, 0, MOPT_GTE0},
 	{Opt_max_batch_time, 0, MOPT_GTE0},
 	{Opt_min_batch_time, 0, MOPT_GTE0},
+	{Opt_fsync_batch_time, 0, MOPT_GTE0},
 	{Opt_inode_readahead_blks, 0, MOPT_GTE0},
 	{Opt_init_itable, 0, MOPT_GTE0},
 	{Opt_stripe, 0, MOPT_GTE0},
@@ -1442,6 +1445,8 @@ static int handle_mount_opt(struct super_block *sb, char *opt, int token,
 			sbi->s_max_batch_time = arg;
 		} else if (token == Opt_min_batch_time) {
 			sbi->s_min_batch_time = arg;
+		} else if (token == Opt_fsync_batch_time) {
+			sbi->s_fsync_batch_time = arg;
 		} else if (token == Opt_inode_readahead_blks) {
 			if (arg > (1 << 30))
 				return -1;
@@ -1657,6 +1662,8 @@ static int _ext4_show_options(struct seq_file *seq, struct super_block *sb,
 		SEQ_OPTS_PRINT("min_batch_time=%u", sbi->s_min_batch_time);
 	if (nodefs || sbi->s_max_batch_time != EXT4_DEF_MAX_BATCH_TIME)
 		SEQ_OPTS_PRINT("max_batch_time=%u", sbi->s_max_batch_time);
+	if (nodefs || sbi->s_fsync_batch_time)
+		SEQ_OPTS_PRINT("fsync_batch_time=%u", sbi->s_fsync_batch_time);
 	if (sb->s_flags & MS_I_VERSION)
 		SEQ_OPTS_PUTS("i_version");
 	if (nodefs || sbi->s_stripe)
@@ -2206,6 +2213,22 @@ static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 	return count;
 }
 
+static ssize_t idle_trim_interval_ms_store(struct ext4_attr *a,
+					   struct ext4_sb_info *sbi,
+					   const char *buf, size_t count)
+{
+	unsigned long t;
+
+	if (parse_strtoul(buf, 0xffffffff, &t))
+		return -EINVAL;
+
+	sbi->s_idle_trim_interval = t;
+	if (t && !delayed_work_pending(&sbi->s_idle_trim_work))
+		queue_delayed_work(system_freezable_wq, &sbi->s_idle_trim_work,
+				   msecs_to_jiffies(t));
+	return count;
+}
+
 static ssize_t sbi_ui_show(struct ext4_attr *a,
 			   struct ext4_sb_info *sbi, char *buf)
 {
@@ -2257,6 +2280,9 @@ EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
+EXT4_ATTR_OFFSET(idle_trim_interval_ms, 0644, sbi_ui_show,
+		 idle_trim_interval_ms_store, s_idle_trim_interval);
+EXT4_RW_ATTR_SBI_UI(idle_trim_budget_ms, s_idle_trim_budget);
 
 static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(delayed_allocation_blocks),
@@ -2271,6 +2297,8 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
 	ATTR_LIST(max_writeback_mb_bump),
+	ATTR_LIST(idle_trim_interval_ms),
+	ATTR_LIST(idle_trim_budget_ms),
 	NULL,
 };
 
@@ -3431,6 +3459,8 @@ no_journal:
 		goto failed_mount5;
 	}
 
+	INIT_DELAYED_WORK(&sbi->s_idle_trim_work, ext4_idle_trim_work);
+
 	err = ext4_register_li_request(sb, first_not_zeroed);
 	if (err)
 		goto failed_mount6;
@@ -3533,6 +3563,7 @@ static void ext4_init_journal_params(struct super_block *sb, journal_t *journal)
 	journal->j_commit_interval = sbi->s_commit_interval;
 	journal->j_min_batch_time = sbi->s_min_batch_time;
 	journal->j_max_batch_time = sbi->s_max_batch_time;
+	journal->j_fsync_batch_time = sbi->s_fsync_batch_time;
 
 	write_lock(&journal->j_state_lock);
 	if (test_opt(sb, BARRIER))
@@ -3945,7 +3976,7 @@ struct ext4_mount_options {
 	uid_t s_resuid;
 	gid_t s_resgid;
 	unsigned long s_commit_interval;
-	u32 s_min_batch_time, s_max_batch_time;
+	u32 s_min_batch_time, s_max_batch_time, s_fsync_batch_time;
 #ifdef CONFIG_QUOTA
 	int s_jquota_fmt;
 	char *s_qf_names[MAXQUOTAS];
@@ -3977,6 +4008,7 @@ static int ext4_remount(struct super_block *sb, int *flags, char *data)
 	old_opts.s_commit_interval = sbi->s_commit_interval;
 	old_opts.s_min_batch_time = sbi->s_min_batch_time;
 	old_opts.s_max_batch_time = sbi->s_max_batch_time;
+	old_opts.s_fsync_batch_time = sbi->s_fsync_batch_time;
 #ifdef CONFIG_QUOTA
 	old_opts.s_jquota_fmt = sbi->s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++)
@@ -4103,6 +4135,7 @@ restore_opts:
 	sbi->s_commit_interval = old_opts.s_commit_interval;
 	sbi->s_min_batch_time = old_opts.s_min_batch_time;
 	sbi->s_max_batch_time = old_opts.s_max_batch_time;
+	sbi->s_fsync_batch_time = old_opts.s_fsync_batch_time;
 #ifdef CONFIG_QUOTA
 	sbi->s_jquota_fmt = old_opts.s_jquota_fmt;
 	for (i = 0; i < MAXQUOTAS; i++) {
@@ -172,6 +172,63 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+static ssize_t fuse_conn_negative_timeout_read(struct file *file,
+					       char __user *buf, size_t len,
+					       loff_t *ppos)
+{
+	struct fuse_conn *fc;
+	unsigned val;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	val = fc->negative_timeout;
+	fuse_conn_put(fc);
+
+	return fuse_conn_limit_read(file, buf, len, ppos, val);
+}
+
+static ssize_t fuse_conn_negative_timeout_write(struct file *file,
+						const char __user *buf,
+						size_t count, loff_t *ppos)
+{
+	unsigned val;
+	ssize_t ret;
+
+	ret = fuse_conn_limit_write(file, buf, count, ppos, &val,
+				    (1 << 16) - 1);
+	if (ret > 0) {
+		struct fuse_conn *fc = fuse_ctl_file_conn_get(file);
+		if (fc) {
+			fc->negative_timeout = val;
+			fuse_conn_put(fc);
+		}
+	}
+
+	return ret;
+}
+
+static ssize_t fuse_conn_lookup_stats_read(struct file *file, char __user *buf,
+					   size_t len, loff_t *ppos)
+{
+	char tmp[64];
+	size_t size;
+	struct fuse_conn *fc;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	size = sprintf(tmp, "cached %u\nnegative %u\nsent %u\n",
+		       atomic_read(&fc->lookup_cached),
+		       atomic_read(&fc->lookup_negative),
+		       atomic_read(&fc->lookup_sent));
+	fuse_conn_put(fc);
+
+	return simple_read_from_buffer(buf, len, ppos, tmp, size);
+}
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -198,6 +255,19 @@ static const struct file_operations fuse_conn_congestion_threshold_ops = {
 	.llseek = no_llseek,
 };
 
+static const struct file_operations fuse_conn_negative_timeout_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_negative_timeout_read,
+	.write = fuse_conn_negative_timeout_write,
+	.llseek = no_llseek,
+};
+
+static const struct file_operations fuse_conn_lookup_stats_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_lookup_stats_read,
+	.llseek = no_llseek,
+};
+
 static struct dentry *fuse_ctl_add_dentry(struct dentry *parent,
 					  struct fuse_conn *fc,
 					  const char *name,
@@ -258,7 +328,12 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 1, NULL, &fuse_conn_max_background_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "congestion_threshold",
 				 S_IFREG | 0600, 1, NULL,
-				 &fuse_conn_congestion_threshold_ops))
+				 &fuse_conn_congestion_threshold_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "negative_timeout_ms",
+				 S_IFREG | 0600, 1, NULL,
+				 &fuse_conn_negative_timeout_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "lookup_stats", S_IFREG | 0400,
+				 1, NULL, &fuse_conn_lookup_stats_ops))
 		goto err;
 
 	return 0;
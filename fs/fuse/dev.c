@@ -20,6 +20,7 @@
 #include <linux/swap.h>
 #include <linux/splice.h>
 #include <linux/freezer.h>
+#include <linux/hash.h>
 
 MODULE_ALIAS_MISCDEV(FUSE_MINOR);
 MODULE_ALIAS("devname:fuse");
@@ -183,6 +184,9 @@ void fuse_put_request(struct fuse_conn *fc, struct fuse_req *req)
 		if (req->waiting)
 			atomic_dec(&fc->num_waiting);
 
+		if (req->passthrough_filp)
+			fput(req->passthrough_filp);
+
 		if (req->stolen_file)
 			put_reserved_req(fc, req);
 		else
@@ -202,6 +206,11 @@ static unsigned len_args(unsigned numargs, struct fuse_arg *args)
 	return nbytes;
 }
 
+static inline unsigned int fuse_req_hash(u64 unique)
+{
+	return hash_64(unique, FUSE_PQ_HASH_BITS);
+}
+
 static u64 fuse_get_unique(struct fuse_conn *fc)
 {
 	fc->reqctr++;
@@ -1013,6 +1022,7 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	struct fuse_req *req;
 	struct fuse_in *in;
 	unsigned reqsize;
+	unsigned int hash;
 
  restart:
 	spin_lock(&fc->lock);
@@ -1080,7 +1090,8 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 		request_end(fc, req);
 	else {
 		req->state = FUSE_REQ_SENT;
-		list_move_tail(&req->list, &fc->processing);
+		hash = fuse_req_hash(req->in.h.unique);
+		list_move_tail(&req->list, &fc->processing[hash]);
 		if (req->interrupted)
 			queue_interrupt(fc, req);
 		spin_unlock(&fc->lock);
@@ -1567,14 +1578,21 @@ static int fuse_notify(struct fuse_conn *fc, enum fuse_notify_code code,
 
 static struct fuse_req *request_find(struct fuse_conn *fc, u64 unique)
 {
-	struct list_head *entry;
+	struct fuse_req *req;
+	int i;
 
-	list_for_each(entry, &fc->processing) {
-		struct fuse_req *req;
-		req = list_entry(entry, struct fuse_req, list);
-		if (req->in.h.unique == unique || req->intr_unique == unique)
+	list_for_each_entry(req, &fc->processing[fuse_req_hash(unique)], list) {
+		if (req->in.h.unique == unique)
 			return req;
 	}
+
+	/* Interrupt replies carry their own unique, search the whole table */
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++) {
+		list_for_each_entry(req, &fc->processing[i], list) {
+			if (req->intr_unique == unique)
+				return req;
+		}
+	}
 	return NULL;
 }
 
@@ -1671,6 +1689,8 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
+	if (!err)
+		fuse_passthrough_setup(fc, req);
 
 	spin_lock(&fc->lock);
 	req->locked = 0;
@@ -1843,10 +1863,13 @@ static void end_queued_requests(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
+	int i;
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
 	end_requests(fc, &fc->pending);
-	end_requests(fc, &fc->processing);
+	for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
+		end_requests(fc, &fc->processing[i]);
 	while (forget_pending(fc))
 		kfree(dequeue_forget(fc, 1, NULL));
 }
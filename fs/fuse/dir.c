@@ -86,6 +86,7 @@ static void fuse_lookup_init(struct fuse_conn *fc, struct fuse_req *req,
 			     struct fuse_entry_out *outarg)
 {
 	memset(outarg, 0, sizeof(struct fuse_entry_out));
+	atomic_inc(&fc->lookup_sent);
 	req->in.h.opcode = FUSE_LOOKUP;
 	req->in.h.nodeid = nodeid;
 	req->in.numargs = 1;
@@ -174,6 +175,10 @@ static int fuse_dentry_revalidate(struct dentry *entry, struct nameidata *nd)
 				       entry_attr_timeout(&outarg),
 				       attr_version);
 		fuse_change_entry_timeout(entry, &outarg);
+	} else {
+		struct fuse_conn *fc = get_fuse_conn_super(entry->d_sb);
+
+		atomic_inc(inode ? &fc->lookup_cached : &fc->lookup_negative);
 	}
 	return 1;
 }
@@ -304,6 +309,9 @@ static struct dentry *fuse_lookup(struct inode *dir, struct dentry *entry,
 	entry = newent ? newent : entry;
 	if (outarg_valid)
 		fuse_change_entry_timeout(entry, &outarg);
+	else if (fc->negative_timeout)
+		fuse_dentry_settime(entry, get_jiffies_64() +
+				    msecs_to_jiffies(fc->negative_timeout));
 	else
 		fuse_invalidate_entry_cache(entry);
 
@@ -384,6 +392,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	if (!S_ISREG(outentry.attr.mode) || invalid_nodeid(outentry.nodeid))
 		goto out_free_ff;
 
+	fuse_passthrough_open(ff, req);
 	fuse_put_request(fc, req);
 	ff->fh = outopen.fh;
 	ff->nodeid = outentry.nodeid;
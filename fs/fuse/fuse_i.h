@@ -29,7 +29,12 @@
 
 #define FUSE_NAME_MAX 1024
 
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 7
+
+#define FUSE_SUPER_MAGIC 0x65735546
+
+#define FUSE_PQ_HASH_BITS 6
+#define FUSE_PQ_HASH_SIZE (1 << FUSE_PQ_HASH_BITS)
 
 #define FUSE_DEFAULT_PERMISSIONS (1 << 0)
 
@@ -41,6 +46,7 @@ extern struct mutex fuse_mutex;
 
 extern unsigned max_user_bgreq;
 extern unsigned max_user_congthresh;
+extern unsigned negative_timeout_ms;
 
 struct fuse_forget_link {
 	struct fuse_forget_one forget_one;
@@ -120,6 +126,9 @@ struct fuse_file {
 
 	
 	bool flock:1;
+
+	/* Lower file that reads, writes and mmap go to directly */
+	struct file *passthrough_filp;
 };
 
 struct fuse_in_arg {
@@ -271,6 +280,9 @@ struct fuse_req {
 
 	
 	struct file *stolen_file;
+
+	/* Lower file handed back in an open reply, see passthrough.c */
+	struct file *passthrough_filp;
 };
 
 struct fuse_conn {
@@ -305,7 +317,8 @@ struct fuse_conn {
 	struct list_head pending;
 
 	
-	struct list_head processing;
+	/* Sent requests awaiting a reply, hashed by unique ID */
+	struct list_head processing[FUSE_PQ_HASH_SIZE];
 
 	
 	struct list_head io;
@@ -323,6 +336,9 @@ struct fuse_conn {
 	unsigned congestion_threshold;
 
 	
+	unsigned negative_timeout;
+
+	
 	unsigned num_background;
 
 	
@@ -420,10 +436,16 @@ struct fuse_conn {
 	
 	unsigned no_flock:1;
 
+	/* Open replies may hand back a lower file for I/O */
+	unsigned passthrough:1;
+
 	
 	atomic_t num_waiting;
 
 	
+	atomic_t lookup_cached, lookup_negative, lookup_sent;
+
+	
 	unsigned minor;
 
 	
@@ -614,4 +636,13 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_open(struct fuse_file *ff, struct fuse_req *req);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif 
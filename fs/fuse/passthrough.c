@@ -0,0 +1,159 @@
+/*
+  FUSE: Filesystem in Userspace
+  Copyright (C) 2001-2008  Miklos Szeredi <miklos@szeredi.hu>
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough: the daemon answers FUSE_OPEN/FUSE_CREATE with
+ * FOPEN_PASSTHROUGH and a descriptor of the file backing the node.  Reads,
+ * writes and mmap of the opened file then go straight to that lower file
+ * and only metadata operations still reach the daemon.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/aio.h>
+#include <linux/file.h>
+#include <linux/fsnotify.h>
+#include <linux/mm.h>
+#include <linux/uio.h>
+#include <linux/cred.h>
+
+/* Called in the daemon's context while it writes the open reply */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *lower;
+	struct inode *inode;
+
+	if (!fc->passthrough || req->out.h.error)
+		return;
+
+	if (req->in.h.opcode == FUSE_OPEN)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE)
+		outarg = req->out.args[1].value;
+	else
+		return;
+
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+
+	lower = fget(outarg->passthrough_fd);
+	if (!lower)
+		return;
+
+	inode = lower->f_dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) || !lower->f_op ||
+	    !lower->f_op->aio_read || !lower->f_op->aio_write ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC) {
+		fput(lower);
+		return;
+	}
+
+	req->passthrough_filp = lower;
+}
+
+void fuse_passthrough_open(struct fuse_file *ff, struct fuse_req *req)
+{
+	ff->passthrough_filp = req->passthrough_filp;
+	req->passthrough_filp = NULL;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct inode *inode = file->f_dentry->d_inode;
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	if (!(lower->f_mode & (rw == WRITE ? FMODE_WRITE : FMODE_READ)))
+		return -EBADF;
+
+	if (rw == WRITE && (file->f_flags & O_APPEND))
+		pos = i_size_read(lower->f_dentry->d_inode);
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = iov_length(iov, nr_segs);
+	kiocb.ki_nbytes = kiocb.ki_left;
+
+	/* The lower file is accessed with the daemon's credentials */
+	old_cred = override_creds(lower->f_cred);
+	if (rw == WRITE)
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	else
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, kiocb.ki_pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	revert_creds(old_cred);
+
+	if (ret > 0) {
+		iocb->ki_pos = kiocb.ki_pos;
+		if (rw == WRITE) {
+			fsnotify_modify(lower);
+			fuse_write_update_size(inode, kiocb.ki_pos);
+			fuse_invalidate_attr(inode);
+		} else {
+			fsnotify_access(lower);
+		}
+	}
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	const struct cred *old_cred;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	if ((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE) &&
+	    !(lower->f_mode & FMODE_WRITE))
+		return -EACCES;
+
+	old_cred = override_creds(lower->f_cred);
+	ret = lower->f_op->mmap(lower, vma);
+	revert_creds(old_cred);
+	if (ret)
+		return ret;
+
+	/* Faults and writeback now go through the lower file's mapping */
+	get_file(lower);
+	fput(vma->vm_file);
+	vma->vm_file = lower;
+
+	return 0;
+}
@@ -803,6 +803,11 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	stats.run.rs_fsyncs = atomic_read(&commit_transaction->t_fsync_count);
+	if (stats.run.rs_fsyncs) {
+		journal->j_stats.ts_fsync_commits++;
+		journal->j_stats.run.rs_fsyncs += stats.run.rs_fsyncs;
+	}
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
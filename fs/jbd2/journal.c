@@ -82,6 +82,7 @@ EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
 EXPORT_SYMBOL(jbd2_log_start_commit);
+EXPORT_SYMBOL(jbd2_log_fsync_batch);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
 EXPORT_SYMBOL(jbd2_journal_wipe);
@@ -427,6 +428,48 @@ int jbd2_log_start_commit(journal_t *journal, tid_t tid)
 	return ret;
 }
 
+/*
+ * Called by fsync before it commits @tid.  When fsyncs come from more
+ * than one process, hold off committing a young running transaction for
+ * j_fsync_batch_time us, or the average commit time if that's shorter,
+ * so the other fsyncs join it and share one commit and one cache flush.
+ * A single process fsyncing back to back gains nothing from waiting.
+ */
+void jbd2_log_fsync_batch(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	u64 batch_time, trans_time;
+	pid_t pid = current->pid;
+
+	read_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	if (!transaction || transaction->t_tid != tid) {
+		transaction = journal->j_committing_transaction;
+		if (transaction && transaction->t_tid == tid)
+			atomic_inc(&transaction->t_fsync_count);
+		read_unlock(&journal->j_state_lock);
+		return;
+	}
+	atomic_inc(&transaction->t_fsync_count);
+	batch_time = min_t(u64, journal->j_average_commit_time,
+			   1000ULL * journal->j_fsync_batch_time);
+	trans_time = ktime_to_ns(ktime_sub(ktime_get(),
+					   transaction->t_start_time));
+	read_unlock(&journal->j_state_lock);
+
+	if (!batch_time || journal->j_last_fsync_pid == pid)
+		goto out;
+
+	if (trans_time < batch_time) {
+		ktime_t expires = ktime_add_ns(ktime_get(),
+					       batch_time - trans_time);
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+	}
+out:
+	journal->j_last_fsync_pid = pid;
+}
+
 int jbd2_journal_force_commit_nested(journal_t *journal)
 {
 	transaction_t *transaction = NULL;
@@ -711,6 +754,11 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+	if (s->stats->ts_fsync_commits)
+		seq_printf(seq, "  %lu fsyncs per commit with fsyncs "
+			   "(%lu commits)\n",
+			   s->stats->run.rs_fsyncs / s->stats->ts_fsync_commits,
+			   s->stats->ts_fsync_commits);
 	return 0;
 }
 
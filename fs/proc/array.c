@@ -152,6 +152,11 @@ static inline const char *get_task_state(struct task_struct *tsk)
 	return *p;
 }
 
+char task_state_char(struct task_struct *tsk)
+{
+	return *get_task_state(tsk);
+}
+
 static inline void task_state(struct seq_file *m, struct pid_namespace *ns,
 				struct pid *pid, struct task_struct *p)
 {
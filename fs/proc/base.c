@@ -331,6 +331,19 @@ static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 			(unsigned long long)task->sched_info.run_delay,
 			task->sched_info.pcount);
 }
+
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static int proc_pid_schedlat(struct task_struct *task, char *buffer)
+{
+	int i, len = 0;
+
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+		len += sprintf(buffer + len, "%u ",
+			       task->sched_info.lat_hist[i]);
+	buffer[len - 1] = '\n';
+	return len;
+}
+#endif
 #endif
 
 #ifdef CONFIG_LATENCYTOP
@@ -915,6 +928,7 @@ static ssize_t oom_adjust_write(struct file *file, const char __user *buf,
 		task->signal->oom_score_adj = (oom_adjust * OOM_SCORE_ADJ_MAX) /
 								-OOM_DISABLE;
 	trace_oom_score_adj_update(task);
+	lowmem_adj_update(task);
 err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
@@ -1028,6 +1042,7 @@ static ssize_t oom_score_adj_write(struct file *file, const char __user *buf,
 	if (has_capability_noaudit(current, CAP_SYS_RESOURCE))
 		task->signal->oom_score_adj_min = oom_score_adj;
 	trace_oom_score_adj_update(task);
+	lowmem_adj_update(task);
 	if (task->signal->oom_score_adj == OOM_SCORE_ADJ_MIN)
 		task->signal->oom_adj = OOM_DISABLE;
 	else
@@ -2879,6 +2894,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	INF("schedlat",   S_IRUGO, proc_pid_schedlat),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
@@ -3193,6 +3211,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	INF("schedlat",  S_IRUGO, proc_pid_schedlat),
+#endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
 #endif
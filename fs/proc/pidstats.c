@@ -0,0 +1,150 @@
+/*
+ * /proc/pidstats: what /proc/<pid>/stat, statm and oom_score_adj give
+ * for every process, as fixed size binary records read in one pass.
+ *
+ * The position is the next pid to look at, so a read that stops half
+ * way carries on where it left off.  Processes are looked up under rcu
+ * and none is pinned; each record is filled while rcu is held.
+ */
+
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/cred.h>
+#include <linux/ptrace.h>
+#include <linux/pid_namespace.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/proc_pidstats.h>
+#include "internal.h"
+
+static bool pidstats_visible(struct pid_namespace *ns, struct task_struct *task)
+{
+	if (ns->hide_pid < 1 || in_group_p(ns->pid_gid))
+		return true;
+	return ptrace_may_access(task, PTRACE_MODE_READ);
+}
+
+static struct task_struct *pidstats_find(struct pid_namespace *ns, loff_t *pos)
+{
+	struct task_struct *task;
+	struct pid *pid;
+
+	while (*pos <= PID_MAX_LIMIT && (pid = find_ge_pid(*pos, ns))) {
+		*pos = pid_nr_ns(pid, ns);
+		task = pid_task(pid, PIDTYPE_PID);
+		if (task && has_group_leader_pid(task) &&
+		    pidstats_visible(ns, task))
+			return task;
+		(*pos)++;
+	}
+	return NULL;
+}
+
+static void *pidstats_start(struct seq_file *m, loff_t *pos)
+{
+	rcu_read_lock();
+	if (!*pos)
+		return SEQ_START_TOKEN;
+	return pidstats_find(m->private, pos);
+}
+
+static void *pidstats_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	(*pos)++;
+	return pidstats_find(m->private, pos);
+}
+
+static void pidstats_stop(struct seq_file *m, void *v)
+{
+	rcu_read_unlock();
+}
+
+static void pidstats_fill(struct pidstats_rec *rec, struct pid_namespace *ns,
+			  struct task_struct *task)
+{
+	cputime_t utime = 0, stime = 0;
+	struct mm_struct *mm;
+	unsigned long flags;
+
+	BUILD_BUG_ON(sizeof(rec->comm) != sizeof(task->comm));
+
+	memset(rec, 0, sizeof(*rec));
+	rec->pid = task_tgid_nr_ns(task, ns);
+	rec->ppid = task_tgid_nr_ns(rcu_dereference(task->real_parent), ns);
+	rec->uid = __task_cred(task)->uid;
+	rec->state = task_state_char(task);
+	rec->start_time_ns = timespec_to_ns(&task->real_start_time);
+
+	if (lock_task_sighand(task, &flags)) {
+		rec->nr_threads = get_nr_threads(task);
+		rec->oom_score_adj = task->signal->oom_score_adj;
+		thread_group_times(task, &utime, &stime);
+		unlock_task_sighand(task, &flags);
+	}
+	rec->utime_ns = (u64)cputime_to_usecs(utime) * NSEC_PER_USEC;
+	rec->stime_ns = (u64)cputime_to_usecs(stime) * NSEC_PER_USEC;
+
+	/* exit_mm clears ->mm under task_lock, so no reference is needed */
+	task_lock(task);
+	memcpy(rec->comm, task->comm, sizeof(rec->comm));
+	mm = task->mm;
+	if (mm) {
+		rec->vm_pages = mm->total_vm;
+		rec->rss_pages = get_mm_rss(mm);
+		rec->swap_pages = get_mm_counter(mm, MM_SWAPENTS);
+	}
+	task_unlock(task);
+}
+
+static int pidstats_show(struct seq_file *m, void *v)
+{
+	struct pidstats_rec rec;
+
+	if (v == SEQ_START_TOKEN) {
+		struct pidstats_hdr hdr = {
+			.version	= PIDSTATS_VERSION,
+			.rec_size	= sizeof(rec),
+			.page_size	= PAGE_SIZE,
+		};
+
+		seq_write(m, &hdr, sizeof(hdr));
+		return 0;
+	}
+
+	pidstats_fill(&rec, m->private, v);
+	seq_write(m, &rec, sizeof(rec));
+	return 0;
+}
+
+static const struct seq_operations pidstats_op = {
+	.start	= pidstats_start,
+	.next	= pidstats_next,
+	.stop	= pidstats_stop,
+	.show	= pidstats_show,
+};
+
+static int pidstats_open(struct inode *inode, struct file *file)
+{
+	int ret = seq_open(file, &pidstats_op);
+
+	if (!ret)
+		((struct seq_file *)file->private_data)->private =
+			inode->i_sb->s_fs_info;
+	return ret;
+}
+
+static const struct file_operations proc_pidstats_operations = {
+	.open		= pidstats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init proc_pidstats_init(void)
+{
+	proc_create("pidstats", 0, NULL, &proc_pidstats_operations);
+	return 0;
+}
+module_init(proc_pidstats_init);
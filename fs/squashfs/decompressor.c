@@ -52,6 +52,12 @@ static const struct squashfs_decompressor squashfs_xz_comp_ops = {
 };
 #endif
 
+#ifndef CONFIG_SQUASHFS_LZ4
+static const struct squashfs_decompressor squashfs_lz4_comp_ops = {
+	NULL, NULL, NULL, LZ4_COMPRESSION, "lz4", 0
+};
+#endif
+
 #ifndef CONFIG_SQUASHFS_ZLIB
 static const struct squashfs_decompressor squashfs_zlib_comp_ops = {
 	NULL, NULL, NULL, ZLIB_COMPRESSION, "zlib", 0
@@ -66,6 +72,7 @@ static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzo_comp_ops,
 	&squashfs_xz_comp_ops,
+	&squashfs_lz4_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
 	&squashfs_unknown_comp_ops
 };
@@ -83,11 +90,28 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 }
 
 
-void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
+	struct squashfs_stream *stream)
+{
+	int cpu;
+
+	if (stream == NULL)
+		return;
+
+	for_each_possible_cpu(cpu)
+		if (stream[cpu].stream)
+			msblk->decompressor->free(stream[cpu].stream);
+	kfree(stream);
+}
+
+
+struct squashfs_stream *squashfs_decompressor_init(struct super_block *sb,
+	unsigned short flags)
 {
 	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	struct squashfs_stream *stream;
 	void *strm, *buffer = NULL;
-	int length = 0;
+	int length = 0, cpu;
 
 	/*
 	 * Read decompressor specific options from file system if present
@@ -102,15 +126,30 @@ void *squashfs_decompressor_init(struct super_block *sb, unsigned short flags)
 			PAGE_CACHE_SIZE, 1);
 
 		if (length < 0) {
-			strm = ERR_PTR(length);
+			stream = ERR_PTR(length);
 			goto finished;
 		}
 	}
 
-	strm = msblk->decompressor->init(msblk, buffer, length);
+	stream = kcalloc(nr_cpu_ids, sizeof(*stream), GFP_KERNEL);
+	if (stream == NULL) {
+		stream = ERR_PTR(-ENOMEM);
+		goto finished;
+	}
+
+	for_each_possible_cpu(cpu) {
+		strm = msblk->decompressor->init(msblk, buffer, length);
+		if (IS_ERR(strm)) {
+			squashfs_decompressor_free(msblk, stream);
+			stream = strm;
+			goto finished;
+		}
+		mutex_init(&stream[cpu].mutex);
+		stream[cpu].stream = strm;
+	}
 
 finished:
 	kfree(buffer);
 
-	return strm;
+	return stream;
 }
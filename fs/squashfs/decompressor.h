@@ -23,29 +23,43 @@
  * decompressor.h
  */
 
+#include <linux/mutex.h>
+#include <linux/smp.h>
+
 struct squashfs_decompressor {
 	void	*(*init)(struct squashfs_sb_info *, void *, int);
 	void	(*free)(void *);
-	int	(*decompress)(struct squashfs_sb_info *, void **,
+	int	(*decompress)(struct squashfs_sb_info *, void *, void **,
 		struct buffer_head **, int, int, int, int, int);
 	int	id;
 	char	*name;
 	int	supported;
 };
 
-static inline void squashfs_decompressor_free(struct squashfs_sb_info *msblk,
-	void *s)
-{
-	if (msblk->decompressor)
-		msblk->decompressor->free(s);
-}
+/*
+ * One decompressor stream per possible cpu, so reads on different cpus
+ * decompress in parallel.  The mutex is only contended when a reader
+ * migrates, or is preempted, while holding the stream of its cpu.
+ */
+struct squashfs_stream {
+	struct mutex	mutex;
+	void		*stream;
+};
 
 static inline int squashfs_decompress(struct squashfs_sb_info *msblk,
 	void **buffer, struct buffer_head **bh, int b, int offset, int length,
 	int srclength, int pages)
 {
-	return msblk->decompressor->decompress(msblk, buffer, bh, b, offset,
-		length, srclength, pages);
+	struct squashfs_stream *stream;
+	int res;
+
+	stream = &msblk->stream[raw_smp_processor_id()];
+
+	mutex_lock(&stream->mutex);
+	res = msblk->decompressor->decompress(msblk, stream->stream, buffer,
+		bh, b, offset, length, srclength, pages);
+	mutex_unlock(&stream->mutex);
+	return res;
 }
 
 #ifdef CONFIG_SQUASHFS_XZ
@@ -56,6 +70,10 @@ extern const struct squashfs_decompressor squashfs_xz_comp_ops;
 extern const struct squashfs_decompressor squashfs_lzo_comp_ops;
 #endif
 
+#ifdef CONFIG_SQUASHFS_LZ4
+extern const struct squashfs_decompressor squashfs_lz4_comp_ops;
+#endif
+
 #ifdef CONFIG_SQUASHFS_ZLIB
 extern const struct squashfs_decompressor squashfs_zlib_comp_ops;
 #endif
@@ -371,6 +371,81 @@ static int read_blocklist(struct inode *inode, int index, u64 *block)
 }
 
 
+/*
+ * Decompress a datablock straight into the page cache pages it covers,
+ * instead of into the read_page cache entry and copying from there.  Only
+ * possible when every page of the block can be grabbed and none is
+ * uptodate already; -EAGAIN sends the caller down the copying path.  On
+ * any return other than 0 @target_page is still locked.
+ */
+static int squashfs_readpage_direct(struct page *target_page, u64 block,
+	int bsize, int start_index, int end_index)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int i, n, pages, res = -EAGAIN;
+	struct page **page;
+	void **pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	page = kcalloc(pages, sizeof(*page), GFP_KERNEL);
+	pageaddr = kcalloc(pages, sizeof(*pageaddr), GFP_KERNEL);
+	if (page == NULL || pageaddr == NULL)
+		goto out;
+
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+		if (page[i] == NULL || (page[i] != target_page &&
+						PageUptodate(page[i])))
+			goto release;
+	}
+
+	for (i = 0; i < pages; i++)
+		pageaddr[i] = kmap(page[i]);
+	res = squashfs_read_data(inode->i_sb, pageaddr, block, bsize, NULL,
+		msblk->block_size, pages);
+	for (i = 0; i < pages; i++) {
+		/* Zero the tail past the end of the decompressed data */
+		n = clamp_t(int, res - i * (int)PAGE_CACHE_SIZE, 0,
+			PAGE_CACHE_SIZE);
+		if (res >= 0 && n < PAGE_CACHE_SIZE)
+			memset(pageaddr[i] + n, 0, PAGE_CACHE_SIZE - n);
+		kunmap(page[i]);
+	}
+	if (res < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		goto release;
+	}
+
+	for (i = 0; i < pages; i++) {
+		flush_dcache_page(page[i]);
+		SetPageUptodate(page[i]);
+	}
+	res = 0;
+
+release:
+	for (i = 0; i < pages && page[i]; i++) {
+		if (page[i] == target_page) {
+			if (res == 0)
+				unlock_page(page[i]);
+			continue;
+		}
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+out:
+	kfree(pageaddr);
+	kfree(page);
+	return res;
+}
+
+
 static int squashfs_readpage(struct file *file, struct page *page)
 {
 	struct inode *inode = page->mapping->host;
@@ -409,6 +484,13 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				 msblk->block_size;
 			sparse = 1;
 		} else {
+			bytes = squashfs_readpage_direct(page, block, bsize,
+				start_index, end_index);
+			if (bytes == 0)
+				return 0;
+			if (bytes != -EAGAIN)
+				goto error_out;
+
 			/*
 			 * Read and decompress datablock.
 			 */
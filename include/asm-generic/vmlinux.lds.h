@@ -543,7 +543,10 @@
 		INIT_CALLS_LEVEL(rootfs)				\
 		INIT_CALLS_LEVEL(6)					\
 		INIT_CALLS_LEVEL(7)					\
-		VMLINUX_SYMBOL(__initcall_end) = .;
+		VMLINUX_SYMBOL(__initcall_end) = .;			\
+		VMLINUX_SYMBOL(__deferred_initcall_start) = .;		\
+		*(.initcalldeferred.init)				\
+		VMLINUX_SYMBOL(__deferred_initcall_end) = .;
 
 #define CON_INITCALL							\
 		VMLINUX_SYMBOL(__con_initcall_start) = .;		\
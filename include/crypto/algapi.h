@@ -172,6 +172,16 @@ void *crypto_alloc_instance2(const char *name, struct crypto_alg *alg,
 struct crypto_instance *crypto_alloc_instance(const char *name,
 					      struct crypto_alg *alg);
 
+/* Report the result of a batched request unless it is still in flight */
+static inline void crypto_batch_complete(struct crypto_async_request *req,
+					 int err)
+{
+	if (err == -EINPROGRESS ||
+	    (err == -EBUSY && (req->flags & CRYPTO_TFM_REQ_MAY_BACKLOG)))
+		return;
+	req->complete(req, err);
+}
+
 void crypto_init_queue(struct crypto_queue *queue, unsigned int max_qlen);
 int crypto_enqueue_request(struct crypto_queue *queue,
 			   struct crypto_async_request *request);
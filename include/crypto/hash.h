@@ -47,6 +47,7 @@ struct ahash_alg {
 	int (*import)(struct ahash_request *req, const void *in);
 	int (*setkey)(struct crypto_ahash *tfm, const u8 *key,
 		      unsigned int keylen);
+	int (*digest_batch)(struct ahash_request **reqs, unsigned int nreqs);
 
 	struct hash_alg_common halg;
 };
@@ -92,6 +93,7 @@ struct crypto_ahash {
 	int (*import)(struct ahash_request *req, const void *in);
 	int (*setkey)(struct crypto_ahash *tfm, const u8 *key,
 		      unsigned int keylen);
+	int (*digest_batch)(struct ahash_request **reqs, unsigned int nreqs);
 
 	unsigned int reqsize;
 	struct crypto_tfm base;
@@ -184,6 +186,8 @@ int crypto_ahash_setkey(struct crypto_ahash *tfm, const u8 *key,
 int crypto_ahash_finup(struct ahash_request *req);
 int crypto_ahash_final(struct ahash_request *req);
 int crypto_ahash_digest(struct ahash_request *req);
+/* Digest @nreqs requests of one tfm, each completing through its callback */
+int crypto_ahash_digest_batch(struct ahash_request **reqs, unsigned int nreqs);
 
 static inline int crypto_ahash_export(struct ahash_request *req, void *out)
 {
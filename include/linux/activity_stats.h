@@ -0,0 +1,53 @@
+/*
+ * Per-UID radio activity, as laid out in /proc/net/stat/activity_uid.
+ *
+ * The file can be read or mmap()ed read-only.  It holds one header followed
+ * by nr_entries entries, of which the first nr_used are valid.  A radio
+ * window is a run of traffic with no gap longer than tail_ms; the UID that
+ * opened it gets "first", the one that moved the most bytes in it gets
+ * "dominant" once the window has closed.  seq is odd while the kernel is
+ * updating the table: a sampler copies what it needs and retries if seq
+ * was odd or changed meanwhile.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#ifndef _LINUX_ACTIVITY_STATS_H
+#define _LINUX_ACTIVITY_STATS_H
+
+#include <linux/types.h>
+
+#define ACTIVITY_UID_MAGIC	0x41555344
+#define ACTIVITY_UID_VERSION	1
+
+/* Traffic without a local socket: received, forwarded or tethered */
+#define ACTIVITY_UID_NONE	((__u32)-1)
+/* Every UID seen once the table was full */
+#define ACTIVITY_UID_OTHER	((__u32)-2)
+
+struct activity_uid_header {
+	__u32 magic;
+	__u32 version;
+	__u32 seq;
+	__u32 nr_entries;
+	__u32 nr_used;
+	__u32 entry_size;
+	__u32 tail_ms;
+	__u32 windows;
+	__u64 window_bytes;
+};
+
+struct activity_uid_entry {
+	__u32 uid;
+	__u32 first;
+	__u32 dominant;
+	__u32 windows;
+	__u64 tx_bytes;
+	__u64 rx_bytes;
+	__u32 tx_packets;
+	__u32 rx_packets;
+};
+
+#endif
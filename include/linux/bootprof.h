@@ -0,0 +1,41 @@
+#ifndef _LINUX_BOOTPROF_H
+#define _LINUX_BOOTPROF_H
+
+#include <linux/init.h>
+#include <linux/sched.h>
+
+struct device;
+struct device_driver;
+
+#ifdef CONFIG_BOOTPROF
+static inline unsigned long long bootprof_start(void)
+{
+	return sched_clock();
+}
+
+extern void bootprof_initcall(initcall_t fn, unsigned long long start);
+extern void bootprof_probe(struct device *dev, struct device_driver *drv,
+			   unsigned long long start);
+extern void bootprof_mark(const char *what);
+#else
+static inline unsigned long long bootprof_start(void)
+{
+	return 0;
+}
+
+static inline void bootprof_initcall(initcall_t fn, unsigned long long start)
+{
+}
+
+static inline void bootprof_probe(struct device *dev,
+				  struct device_driver *drv,
+				  unsigned long long start)
+{
+}
+
+static inline void bootprof_mark(const char *what)
+{
+}
+#endif
+
+#endif
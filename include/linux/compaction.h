@@ -21,6 +21,13 @@ extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 extern int compact_pgdat(pg_data_t *pgdat, int order);
 extern unsigned long compaction_suitable(struct zone *zone, int order);
 
+extern int sysctl_kcompactd_order;
+extern int sysctl_kcompactd_extfrag_threshold;
+extern int sysctl_kcompactd_interval_ms;
+extern int sysctl_kcompactd_budget_ms;
+extern int kcompactd_run(int nid);
+extern void wakeup_kcompactd(pg_data_t *pgdat, int order);
+
 #define COMPACT_MAX_DEFER_SHIFT 6
 
 static inline void defer_compaction(struct zone *zone, int order)
@@ -76,6 +83,15 @@ static inline bool compaction_deferred(struct zone *zone, int order)
 	return 1;
 }
 
+static inline int kcompactd_run(int nid)
+{
+	return 0;
+}
+
+static inline void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+}
+
 #endif 
 
 #if defined(CONFIG_COMPACTION) && defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
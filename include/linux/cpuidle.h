@@ -192,6 +192,13 @@ static inline void cpuidle_unregister_governor(struct cpuidle_governor *gov) { }
 
 #endif
 
+#ifdef CONFIG_CPU_IDLE_GOV_PREDICT
+extern unsigned int cpuidle_predict_get_us(struct cpuidle_device *dev);
+#else
+static inline unsigned int cpuidle_predict_get_us(struct cpuidle_device *dev)
+{return 0; }
+#endif
+
 #ifdef CONFIG_ARCH_HAS_CPU_RELAX
 #define CPUIDLE_DRIVER_STATE_START	1
 #else
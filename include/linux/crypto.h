@@ -154,6 +154,10 @@ struct ablkcipher_alg {
 	int (*decrypt)(struct ablkcipher_request *req);
 	int (*givencrypt)(struct skcipher_givcrypt_request *req);
 	int (*givdecrypt)(struct skcipher_givcrypt_request *req);
+	int (*encrypt_batch)(struct ablkcipher_request **reqs,
+			     unsigned int nreqs);
+	int (*decrypt_batch)(struct ablkcipher_request **reqs,
+			     unsigned int nreqs);
 
 	const char *geniv;
 
@@ -274,6 +278,10 @@ struct ablkcipher_tfm {
 	int (*decrypt)(struct ablkcipher_request *req);
 	int (*givencrypt)(struct skcipher_givcrypt_request *req);
 	int (*givdecrypt)(struct skcipher_givcrypt_request *req);
+	int (*encrypt_batch)(struct ablkcipher_request **reqs,
+			     unsigned int nreqs);
+	int (*decrypt_batch)(struct ablkcipher_request **reqs,
+			     unsigned int nreqs);
 
 	struct crypto_ablkcipher *base;
 
@@ -599,6 +607,16 @@ static inline int crypto_ablkcipher_decrypt(struct ablkcipher_request *req)
 	return crt->decrypt(req);
 }
 
+/*
+ * Submit @nreqs requests of one tfm at once.  Every result, including
+ * those of requests finished synchronously, is reported through that
+ * request's own completion callback.
+ */
+int crypto_ablkcipher_encrypt_batch(struct ablkcipher_request **reqs,
+				    unsigned int nreqs);
+int crypto_ablkcipher_decrypt_batch(struct ablkcipher_request **reqs,
+				    unsigned int nreqs);
+
 static inline unsigned int crypto_ablkcipher_reqsize(
 	struct crypto_ablkcipher *tfm)
 {
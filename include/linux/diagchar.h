@@ -47,6 +47,33 @@
 #define DIAG_IOCTL_DCI_HEALTH_STATS	25
 #define DIAG_IOCTL_REMOTE_DEV		32
 #define DIAG_IOCTL_NONBLOCKING_TIMEOUT 64
+#define DIAG_IOCTL_CAPTURE_START	65
+#define DIAG_IOCTL_CAPTURE_STOP		66
+#define DIAG_IOCTL_CAPTURE_LOG_MASK	67
+#define DIAG_IOCTL_CAPTURE_WAIT		68
+
+/*
+ * Capture mode: while in MEMORY_DEVICE_MODE, peripheral log packets whose
+ * code is set in the capture log mask (one bit per 16-bit log code) are
+ * decoded and appended to a ring that the logger mmaps from /dev/diag.
+ * The first page holds struct diag_capture_ring, the data area follows.
+ * Each record is a 32-bit length followed by the packet, padded to 4
+ * bytes; head and tail are free running byte counts, the data offset is
+ * the count modulo size.  The logger advances tail after consuming.
+ */
+#define DIAG_CAPTURE_LOG_MASK_SIZE	(0x10000 / 8)
+
+struct diag_capture_config {
+	unsigned int size;		/* data area, rounded to a power of 2 */
+	unsigned int watermark;		/* bytes pending before a wakeup */
+};
+
+struct diag_capture_ring {
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	unsigned int size;
+	unsigned int dropped;
+};
 
 #define APQ8060_TOOLS_ID	4062
 #define AO8960_TOOLS_ID		4064
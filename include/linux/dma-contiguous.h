@@ -35,6 +35,8 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 				       unsigned int order);
 bool dma_release_from_contiguous(struct device *dev, struct page *pages,
 				 int count);
+int dma_contiguous_area(struct device *dev, phys_addr_t *base,
+			unsigned long *size);
 
 #else
 
@@ -63,6 +65,13 @@ bool dma_release_from_contiguous(struct device *dev, struct page *pages,
 	return false;
 }
 
+static inline
+int dma_contiguous_area(struct device *dev, phys_addr_t *base,
+			unsigned long *size)
+{
+	return -ENODEV;
+}
+
 #endif
 
 #endif
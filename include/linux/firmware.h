@@ -41,6 +41,9 @@ int request_firmware_nowait(
 	const char *name, struct device *device, gfp_t gfp, void *context,
 	void (*cont)(const struct firmware *fw, void *context));
 
+int request_firmware_direct(const char *name, struct device *device,
+			    phys_addr_t dest_addr, size_t dest_size);
+
 void release_firmware(const struct firmware *fw);
 #else
 static inline int request_firmware(const struct firmware **fw,
@@ -57,6 +60,14 @@ static inline int request_firmware_nowait(
 	return -EINVAL;
 }
 
+static inline int request_firmware_direct(const char *name,
+					  struct device *device,
+					  phys_addr_t dest_addr,
+					  size_t dest_size)
+{
+	return -EINVAL;
+}
+
 static inline void release_firmware(const struct firmware *fw)
 {
 }
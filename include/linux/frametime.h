@@ -0,0 +1,42 @@
+/* include/linux/frametime.h
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __LINUX_FRAMETIME_H
+#define __LINUX_FRAMETIME_H
+
+#include <linux/types.h>
+
+/*
+ * Points along the path of a touch to the panel.  Each one emits a
+ * frametime tracepoint tagged with the current input sequence number;
+ * frametime_display() also feeds the input to photon latency histogram.
+ * frametime_display() may be called from irq context.
+ */
+#ifdef CONFIG_FRAMETIME
+extern void frametime_input(void);
+extern void frametime_binder(int debug_id);
+extern void frametime_gpu_submit(unsigned int context, unsigned int ts);
+extern void frametime_gpu_retire(unsigned int context, unsigned int ts);
+extern void frametime_commit(int fb);
+extern void frametime_display(int fb);
+#else
+static inline void frametime_input(void) {}
+static inline void frametime_binder(int debug_id) {}
+static inline void frametime_gpu_submit(unsigned int context,
+					unsigned int ts) {}
+static inline void frametime_gpu_retire(unsigned int context,
+					unsigned int ts) {}
+static inline void frametime_commit(int fb) {}
+static inline void frametime_display(int fb) {}
+#endif
+
+#endif
@@ -73,6 +73,9 @@ struct inodes_stat_t {
 
 #define FMODE_PATH		((__force fmode_t)0x4000)
 
+/* Written pages are not reused: reclaim them first once written back */
+#define FMODE_NOREUSE		((__force fmode_t)0x8000)
+
 #define FMODE_NONOTIFY		((__force fmode_t)0x1000000)
 
 #define RW_MASK			REQ_WRITE
@@ -0,0 +1,39 @@
+/* include/linux/htc_pnpmgr.h
+ *
+ * Copyright (C) 2014 HTC Corporation.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __LINUX_HTC_PNPMGR_H
+#define __LINUX_HTC_PNPMGR_H
+
+#include <linux/errno.h>
+
+struct notifier_block;
+
+#ifdef CONFIG_HTC_PNPMGR_POLICY
+extern void pnpmgr_battery_level(int level);
+/* Called with the GPU pwrlevel cap of the active profile, 0 for none */
+extern int pnpmgr_register_gpu_notifier(struct notifier_block *nb);
+extern int pnpmgr_unregister_gpu_notifier(struct notifier_block *nb);
+#else
+static inline void pnpmgr_battery_level(int level) { return; }
+static inline int pnpmgr_register_gpu_notifier(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+static inline int pnpmgr_unregister_gpu_notifier(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+#endif
+
+#endif
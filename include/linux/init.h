@@ -94,6 +94,12 @@ extern void (*late_time_init)(void);
 
 extern bool initcall_debug;
 
+#ifdef CONFIG_DEFERRED_INITCALLS
+extern void deferred_initcalls_kick(void);
+#else
+static inline void deferred_initcalls_kick(void) { }
+#endif
+
 #endif
   
 #ifndef MODULE
@@ -125,6 +131,13 @@ extern bool initcall_debug;
 #define late_initcall(fn)		__define_initcall("7",fn,7)
 #define late_initcall_sync(fn)		__define_initcall("7s",fn,7s)
 
+/* Runs after the display is up, see init/main.c */
+#ifdef CONFIG_DEFERRED_INITCALLS
+#define deferred_initcall(fn)		__define_initcall("deferred",fn,deferred)
+#else
+#define deferred_initcall(fn)		device_initcall(fn)
+#endif
+
 #define __initcall(fn) device_initcall(fn)
 
 #define __exitcall(fn) \
@@ -176,6 +189,7 @@ void __init parse_early_options(char *cmdline);
 #define fs_initcall(fn)			module_init(fn)
 #define device_initcall(fn)		module_init(fn)
 #define late_initcall(fn)		module_init(fn)
+#define deferred_initcall(fn)		module_init(fn)
 
 #define security_initcall(fn)		module_init(fn)
 
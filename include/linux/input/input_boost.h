@@ -0,0 +1,35 @@
+/* include/linux/input/input_boost.h
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __LINUX_INPUT_BOOST_H
+#define __LINUX_INPUT_BOOST_H
+
+#include <linux/errno.h>
+
+struct notifier_block;
+
+#ifdef CONFIG_INPUT_BOOST
+/* Called on a first touch with the boost duration in ms */
+extern int input_boost_register_gpu_notifier(struct notifier_block *nb);
+extern int input_boost_unregister_gpu_notifier(struct notifier_block *nb);
+#else
+static inline int input_boost_register_gpu_notifier(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+static inline int input_boost_unregister_gpu_notifier(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+#endif
+
+#endif
@@ -108,6 +108,7 @@ struct ion_heap;
 struct ion_mapper;
 struct ion_client;
 struct ion_buffer;
+struct device;
 
 #define ion_phys_addr_t unsigned long
 #define ion_virt_addr_t unsigned long
@@ -121,6 +122,11 @@ struct ion_platform_heap {
 	enum ion_memory_types memory_type;
 	unsigned int has_outer_cache;
 	void *extra_data;
+	/*
+	 * CMA area the heap memory comes from.  It holds movable pages
+	 * while the heap is empty and is migrated clear on allocation.
+	 */
+	struct device *cma_dev;
 };
 
 struct ion_cp_heap_pdata {
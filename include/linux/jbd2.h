@@ -353,6 +353,9 @@ struct transaction_s
 
 	atomic_t		t_handle_count;
 
+	
+	atomic_t		t_fsync_count;
+
 	unsigned int t_synchronous_commit:1;
 
 	
@@ -371,10 +374,12 @@ struct transaction_run_stats_s {
 	__u32			rs_handle_count;
 	__u32			rs_blocks;
 	__u32			rs_blocks_logged;
+	__u32			rs_fsyncs;
 };
 
 struct transaction_stats_s {
 	unsigned long		ts_tid;
+	unsigned long		ts_fsync_commits;
 	struct transaction_run_stats_s run;
 };
 
@@ -500,6 +505,10 @@ struct journal_s
 	u32			j_max_batch_time;
 
 	
+	u32			j_fsync_batch_time;
+	pid_t			j_last_fsync_pid;
+
+	
 	void			(*j_commit_callback)(journal_t *,
 						     transaction_t *);
 
@@ -696,6 +705,7 @@ int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
+void jbd2_log_fsync_batch(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
@@ -0,0 +1,119 @@
+#ifndef _LINUX_LOCKSTAT_LITE_H
+#define _LINUX_LOCKSTAT_LITE_H
+
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/bit_spinlock.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+
+/*
+ * Contention counts for a fixed set of hot locks.  Only the call sites
+ * converted to the lsl_ helpers are counted: a trylock first, and only
+ * when that fails the wait is timed with sched_clock and charged to the
+ * cpu that got the lock.
+ */
+enum lsl_class {
+	LSL_BINDER,
+	LSL_BINDER_ALLOC,
+	LSL_ASHMEM,
+	LSL_ASHMEM_LRU,
+	LSL_KGSL_DEVICE,
+	LSL_ZRAM_SLOT,
+	LSL_ZRAM_COMP,
+	LSL_ION_CLIENT,
+	LSL_MMC_CLAIM,
+	LSL_NR,
+};
+
+#ifdef CONFIG_LOCKSTAT_LITE
+struct lsl_stat {
+	unsigned long acquired;
+	unsigned long contended;
+	u64 wait_ns;
+	u64 max_ns;
+};
+
+DECLARE_PER_CPU(struct lsl_stat, lsl_stats[LSL_NR]);
+
+extern void lsl_contended(int cls, u64 start);
+
+static inline void lsl_acquired(int cls)
+{
+	this_cpu_inc(lsl_stats[cls].acquired);
+}
+
+static inline u64 lsl_wait_start(void)
+{
+	return sched_clock();
+}
+
+static inline void lsl_mutex_lock(struct mutex *lock, int cls)
+{
+	u64 start;
+
+	lsl_acquired(cls);
+	if (mutex_trylock(lock))
+		return;
+
+	start = sched_clock();
+	mutex_lock(lock);
+	lsl_contended(cls, start);
+}
+
+static inline void lsl_spin_lock(spinlock_t *lock, int cls)
+{
+	u64 start;
+
+	lsl_acquired(cls);
+	if (spin_trylock(lock))
+		return;
+
+	start = sched_clock();
+	spin_lock(lock);
+	lsl_contended(cls, start);
+}
+
+static inline void lsl_bit_spin_lock(int bitnum, unsigned long *addr, int cls)
+{
+	u64 start;
+
+	lsl_acquired(cls);
+	if (bit_spin_trylock(bitnum, addr))
+		return;
+
+	start = sched_clock();
+	bit_spin_lock(bitnum, addr);
+	lsl_contended(cls, start);
+}
+#else
+static inline void lsl_acquired(int cls)
+{
+}
+
+static inline u64 lsl_wait_start(void)
+{
+	return 0;
+}
+
+static inline void lsl_contended(int cls, u64 start)
+{
+}
+
+static inline void lsl_mutex_lock(struct mutex *lock, int cls)
+{
+	mutex_lock(lock);
+}
+
+static inline void lsl_spin_lock(spinlock_t *lock, int cls)
+{
+	spin_lock(lock);
+}
+
+static inline void lsl_bit_spin_lock(int bitnum, unsigned long *addr, int cls)
+{
+	bit_spin_lock(bitnum, addr);
+}
+#endif
+
+#endif
@@ -81,4 +81,9 @@ int lz4_decompress(const unsigned char *src, size_t *src_len,
  */
 int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
 		unsigned char *dest, size_t *dest_len);
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+/* Decompress with the NEON copy loops when the CPU has NEON, default on */
+extern bool lz4_decompress_neon;
+#endif
 #endif
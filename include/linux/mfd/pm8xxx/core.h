@@ -15,6 +15,7 @@
 #define __MFD_PM8XXX_CORE_H
 
 #include <linux/mfd/core.h>
+#include <linux/msm_ssbi.h>
 
 enum pm8xxx_version {
 	PM8XXX_VERSION_8058,
@@ -83,6 +84,10 @@ struct pm8xxx_drvdata {
 						int irq);
 	enum pm8xxx_version	(*pmic_get_version) (const struct device *dev);
 	int			(*pmic_get_revision) (const struct device *dev);
+	int			(*pmic_xfer) (const struct device *dev,
+					struct msm_ssbi_xfer *xfer, int n);
+	int			(*pmic_cache_regs) (const struct device *dev,
+					const u16 *addr, int n);
 	void			*pm_chip_data;
 };
 
@@ -124,6 +129,32 @@ static inline int pm8xxx_write_buf(const struct device *dev, u16 addr, u8 *buf,
 	return dd->pmic_write_buf(dev, addr, buf, n);
 }
 
+/* Batched single byte accesses, one bus lock hold for the whole list */
+static inline int pm8xxx_xfer(const struct device *dev,
+			      struct msm_ssbi_xfer *xfer, int n)
+{
+	struct pm8xxx_drvdata *dd = dev_get_drvdata(dev);
+
+	if (!dd)
+		return -EINVAL;
+	return dd->pmic_xfer(dev, xfer, n);
+}
+
+/*
+ * Registers only ever changed by writes from this processor, which may
+ * then be answered from a shadow copy by pm8xxx_readb.  Batches from
+ * pm8xxx_xfer always go to the hardware and refresh the copy.
+ */
+static inline int pm8xxx_cache_regs(const struct device *dev,
+				    const u16 *addr, int n)
+{
+	struct pm8xxx_drvdata *dd = dev_get_drvdata(dev);
+
+	if (!dd)
+		return -EINVAL;
+	return dd->pmic_cache_regs(dev, addr, n);
+}
+
 static inline int pm8xxx_read_irq_stat(const struct device *dev, int irq)
 {
 	struct pm8xxx_drvdata *dd = dev_get_drvdata(dev);
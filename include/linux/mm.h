@@ -96,7 +96,7 @@ extern unsigned int kobjsize(const void *objp);
 #define VM_NORESERVE	0x00200000	
 #define VM_HUGETLB	0x00400000	
 #define VM_NONLINEAR	0x00800000	
-#ifndef CONFIG_TRANSPARENT_HUGEPAGE
+#if !defined(CONFIG_TRANSPARENT_HUGEPAGE) && !defined(CONFIG_ANON_LARGE_PAGES)
 #define VM_MAPPED_COPY	0x01000000	
 #else
 #define VM_HUGEPAGE	0x01000000	
@@ -12,6 +12,7 @@
 
 #include <linux/device.h>
 #include <linux/mmc/core.h>
+#include <linux/ktime.h>
 #include <linux/mod_devicetable.h>
 
 #ifdef CONFIG_MMC_MUST_PREVENT_WP_VIOLATION
@@ -234,6 +235,48 @@ struct mmc_wr_pack_stats {
 	bool print_in_read;
 };
 
+struct mmc_bkops_stats {
+	unsigned int	idle_started;
+	unsigned int	idle_level[4];	
+	unsigned int	interrupted;
+	unsigned int	urgent;		
+	unsigned int	suspend_started;
+	u64		idle_ms;
+	ktime_t		start;
+	bool		idle_running;
+};
+
+#define MMC_PACK_ADAPT_LOG		32
+#define MMC_PACK_ADAPT_READ_TARGET_MS	50
+
+/* One decision of the adaptive write packing controller */
+struct mmc_pack_adapt_entry {
+	unsigned long	time;
+	u32		packed_kbps;
+	u32		unpacked_kbps;
+	u32		read_wait_ms;
+	u16		trigger;
+	u8		max_packed;
+	char		action;
+};
+
+struct mmc_wr_pack_adapt {
+	bool		enabled;
+	u32		read_target_ms;
+	u8		max_packed;
+	ktime_t		last_done;
+	
+	u64		packed_bytes;
+	u64		packed_us;
+	u64		unpacked_bytes;
+	u64		unpacked_us;
+	u32		read_wait_ms;
+	u32		nr_writes;
+	struct mmc_pack_adapt_entry log[MMC_PACK_ADAPT_LOG];
+	unsigned int	log_next;
+	spinlock_t	lock;
+};
+
 struct mmc_card {
 	struct mmc_host		*host;		
 	struct device		dev;		
@@ -321,6 +364,8 @@ struct mmc_card {
 	unsigned int		wr_perf; 
 
 	struct mmc_wr_pack_stats wr_pack_stats; 
+	struct mmc_wr_pack_adapt wr_pack_adapt;
+	struct mmc_bkops_stats	bkops_stats;
 };
 
 static inline void mmc_part_add(struct mmc_card *card, unsigned int size,
@@ -535,5 +580,6 @@ extern void mmc_fixup_device(struct mmc_card *card,
 extern struct mmc_wr_pack_stats *mmc_blk_get_packed_statistics(
 			struct mmc_card *card);
 extern void mmc_blk_init_packed_statistics(struct mmc_card *card);
+extern void mmc_blk_init_pack_adapt(struct mmc_card *card, bool enable);
 
 #endif 
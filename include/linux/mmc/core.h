@@ -113,6 +113,9 @@ struct mmc_async_req;
 
 extern int mmc_interrupt_bkops(struct mmc_card *);
 extern int mmc_read_bkops_status(struct mmc_card *);
+extern unsigned int mmc_bkops_idle_delay(struct mmc_card *);
+extern void mmc_start_idle_bkops(struct mmc_card *);
+extern int mmc_bkops_suspend_time(struct mmc_card *);
 extern int mmc_is_exception_event(struct mmc_card *, unsigned int);
 extern struct mmc_async_req *mmc_start_req(struct mmc_host *,
 					   struct mmc_async_req *, int *);
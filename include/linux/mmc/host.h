@@ -229,6 +229,7 @@ struct mmc_host {
 	int			clk_requests;	
 	unsigned int		clk_delay;	
 	bool			clk_gated;	
+	bool			clk_gating;	
 	struct delayed_work	clk_gate_work; 
 	unsigned int		clk_old;	
 	spinlock_t		clk_lock;	
@@ -264,6 +265,8 @@ struct mmc_host {
 	int 		hpi_issued;
 	int 		bkops_trigger;
 	int 		bkops_alarm_set;
+	bool		screen_off;
+	unsigned long	screen_off_jiffies;
 	struct mmc_card		*card;		
 
 	wait_queue_head_t	wq;
@@ -289,6 +292,11 @@ struct mmc_host {
 	struct task_struct	*sdio_irq_thread;
 	bool			sdio_irq_pending;
 	atomic_t		sdio_irq_thread_abort;
+	unsigned long		sdio_irq_active;
+	ktime_t			sdio_irq_stamp;
+	u32			sdio_irq_lat_count;
+	u32			sdio_irq_lat_max;
+	u64			sdio_irq_lat_sum;
 
 	mmc_pm_flag_t		pm_flags;	
 
@@ -398,6 +406,7 @@ int mmc_card_start_bkops(struct mmc_host *host);
 static inline void mmc_signal_sdio_irq(struct mmc_host *host)
 {
 	host->ops->enable_sdio_irq(host, 0);
+	host->sdio_irq_stamp = ktime_get();
 	host->sdio_irq_pending = true;
 	wake_up_process(host->sdio_irq_thread);
 }
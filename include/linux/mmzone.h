@@ -177,6 +177,19 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/* Orders 1..PCP_HIGH_ORDER get their own small per-cpu caches */
+#define PCP_HIGH_ORDER		3
+
+struct per_cpu_order_pages {
+	int count;		/* blocks of this order on the lists */
+	int high;		/* 0 bypasses the cache */
+	int batch;
+	unsigned long hit;
+	unsigned long miss;
+
+	struct list_head lists[MIGRATE_PCPTYPES];
+};
+
 struct per_cpu_pages {
 	int count;		
 	int high;		
@@ -184,6 +197,8 @@ struct per_cpu_pages {
 
 	
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	struct per_cpu_order_pages orders[PCP_HIGH_ORDER];
 };
 
 struct per_cpu_pageset {
@@ -230,6 +245,8 @@ enum zone_type {
 struct zone_reclaim_stat {
 	unsigned long		recent_rotated[2];
 	unsigned long		recent_scanned[2];
+	/* Refault and swap out cost in us, see mm/workingset.c */
+	unsigned long		recent_cost[2];
 };
 
 struct zone {
@@ -269,6 +286,11 @@ struct zone {
 	unsigned int		compact_considered;
 	unsigned int		compact_defer_shift;
 	int			compact_order_failed;
+
+	/* Where kcompactd resumes, and the order it last made available */
+	unsigned long		kcompactd_migrate_pfn;
+	unsigned long		kcompactd_free_pfn;
+	int			kcompactd_ready_order;
 #endif
 
 	ZONE_PADDING(_pad1_)
@@ -279,6 +301,9 @@ struct zone {
 
 	struct zone_reclaim_stat reclaim_stat;
 
+	/* Evictions and refault activations, for workingset detection */
+	atomic_long_t		inactive_age;
+
 	unsigned long		pages_scanned;	   
 	unsigned long		flags;		   
 
@@ -428,6 +453,11 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;	
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	bool kcompactd_wake;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
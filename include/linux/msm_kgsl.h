@@ -24,7 +24,15 @@
 
 #define KGSL_CONTEXT_NO_FAULT_TOLERANCE 0x00000200
 #define KGSL_CONTEXT_SYNC               0x00000400
-/* bits [12:15] are reserved for future use */
+#define KGSL_CONTEXT_CLEAR_GMEM         0x00000800
+/*
+ * bits [12:15] specify the context priority.  Lower values are higher
+ * priority, 0 means no priority was requested and the default is used.
+ */
+#define KGSL_CONTEXT_PRIORITY_MASK      0x0000F000
+#define KGSL_CONTEXT_PRIORITY_SHIFT     12
+#define KGSL_CONTEXT_PRIORITY_UNDEF     0
+
 #define KGSL_CONTEXT_TYPE_MASK          0x01F00000
 #define KGSL_CONTEXT_TYPE_SHIFT         20
 
@@ -660,18 +668,21 @@ struct kgsl_gpumem_get_info {
  * @gpuaddr: GPU address of the buffer to sync.
  * @id: id of the buffer to sync. Either gpuaddr or id is sufficient.
  * @op: a mask of KGSL_GPUMEM_CACHE_* values
+ * @offset: offset into the buffer (only used with KGSL_GPUMEM_CACHE_RANGE)
+ * @length: number of bytes to sync (only used with KGSL_GPUMEM_CACHE_RANGE)
  *
  * Sync the L2 cache for memory headed to and from the GPU - this replaces
  * KGSL_SHAREDMEM_FLUSH_CACHE since it can handle cache management for both
- * directions
+ * directions.  If KGSL_GPUMEM_CACHE_RANGE is set in @op only the pages
+ * covered by @offset and @length are synced, otherwise the whole buffer is
  *
  */
 struct kgsl_gpumem_sync_cache {
 	unsigned int gpuaddr;
 	unsigned int id;
 	unsigned int op;
-/* private: reserved for future use*/
-	unsigned int __pad[2]; /* For future binary compatibility */
+	size_t offset;
+	size_t length;
 };
 
 #define KGSL_GPUMEM_CACHE_CLEAN (1 << 0)
@@ -683,6 +694,9 @@ struct kgsl_gpumem_sync_cache {
 #define KGSL_GPUMEM_CACHE_FLUSH \
 	(KGSL_GPUMEM_CACHE_CLEAN | KGSL_GPUMEM_CACHE_INV)
 
+/* Flag to ensure backwards compatibility of kgsl_gpumem_sync_cache struct */
+#define KGSL_GPUMEM_CACHE_RANGE (1 << 31U)
+
 #define IOCTL_KGSL_GPUMEM_SYNC_CACHE \
 	_IOW(KGSL_IOC_TYPE, 0x37, struct kgsl_gpumem_sync_cache)
 
@@ -882,6 +896,78 @@ struct kgsl_submit_commands {
 #define IOCTL_KGSL_SUBMIT_COMMANDS \
 	_IOWR(KGSL_IOC_TYPE, 0x3D, struct kgsl_submit_commands)
 
+/**
+ * struct kgsl_submit_batch_entry - One command batch in IOCTL_KGSL_SUBMIT_BATCH
+ * @context_id: KGSL context ID that owns the commands
+ * @flags: Mask of KGSL_CONTEXT_ values for this batch
+ * @cmdlist: User pointer to a list of kgsl_ibdesc structures
+ * @numcmds: Number of commands listed in cmdlist
+ * @timestamp: On entry the user defined timestamp (if the context uses them),
+ * on exit the timestamp assigned to the command batch
+ * @result: On exit, 0 if the batch was queued or the error code for the batch
+ */
+struct kgsl_submit_batch_entry {
+	unsigned int context_id;
+	unsigned int flags;
+	struct kgsl_ibdesc __user *cmdlist;
+	unsigned int numcmds;
+	unsigned int timestamp;
+	int result;
+/* private: reserved for future use */
+	unsigned int __pad[2];
+};
+
+/**
+ * struct kgsl_submit_batch - Argument to IOCTL_KGSL_SUBMIT_BATCH
+ * @entries: User pointer to a list of kgsl_submit_batch_entry structures
+ * @count: Number of entries in the list
+ *
+ * Submit command batches for one or more draw contexts in a single call.  The
+ * batches are written to the ringbuffer in order and the hardware is only
+ * told about the new commands once all of them have been queued.  If a batch
+ * fails, its result is written back, no further batches are submitted and the
+ * error is returned from the ioctl.  Batches queued before the failing one
+ * are still executed.
+ */
+struct kgsl_submit_batch {
+	struct kgsl_submit_batch_entry __user *entries;
+	unsigned int count;
+/* private: reserved for future use */
+	unsigned int __pad[4];
+};
+
+#define IOCTL_KGSL_SUBMIT_BATCH \
+	_IOWR(KGSL_IOC_TYPE, 0x3E, struct kgsl_submit_batch)
+
+/**
+ * struct kgsl_gpumem_set_purgeable - Argument to IOCTL_KGSL_GPUMEM_SET_PURGEABLE
+ * @id: GPU allocation id to change
+ * @purgeable: 1 to let the kernel drop the contents, 0 to pin them again
+ * @context_id: Context of the last submission that uses the allocation
+ * @timestamp: Timestamp of that submission in @context_id
+ * @was_purged: On exit, 1 if the contents were dropped while purgeable
+ *
+ * Much like ashmem unpin, an allocation marked purgeable may have its pages
+ * freed under memory pressure once @timestamp has retired and the owning
+ * process is in the background.  GPU and CPU accesses to it are undefined
+ * until it is pinned again; pinning reallocates zeroed pages if it was
+ * purged.  @context_id and @timestamp are ignored when pinning.  Only
+ * allocations from IOCTL_KGSL_GPUMEM_ALLOC or IOCTL_KGSL_GPUMEM_ALLOC_ID
+ * can be made purgeable.
+ */
+struct kgsl_gpumem_set_purgeable {
+	unsigned int id;
+	unsigned int purgeable;
+	unsigned int context_id;
+	unsigned int timestamp;
+	unsigned int was_purged;
+/* private: reserved for future use */
+	unsigned int __pad[3];
+};
+
+#define IOCTL_KGSL_GPUMEM_SET_PURGEABLE \
+	_IOWR(KGSL_IOC_TYPE, 0x3F, struct kgsl_gpumem_set_purgeable)
+
 #ifdef __KERNEL__
 #ifdef CONFIG_MSM_KGSL_DRM
 int kgsl_gem_obj_addr(int drm_fd, int handle, unsigned long *start,
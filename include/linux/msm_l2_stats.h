@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MSM_L2_STATS_H
+#define __MSM_L2_STATS_H
+
+#include <linux/types.h>
+
+#ifdef CONFIG_MSM_L2_TASK_STATS
+/* Whether the task running on this CPU is memory bound */
+extern bool msm_l2_stats_mem_bound(void);
+/* Vote the bus up for memory-bound work, process context only */
+extern void msm_l2_stats_bus_boost(bool on);
+#else
+static inline bool msm_l2_stats_mem_bound(void) { return false; }
+static inline void msm_l2_stats_bus_boost(bool on) { }
+#endif
+
+#endif
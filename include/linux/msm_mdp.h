@@ -76,6 +76,8 @@
 #define MSMFB_WRITEBACK_SET_MIRRORING_HINT _IOW(MSMFB_IOCTL_MAGIC, 165, \
 						unsigned int)
 #define MSMFB_METADATA_GET  _IOW(MSMFB_IOCTL_MAGIC, 166, struct msmfb_metadata)
+#define MSMFB_ATOMIC_COMMIT _IOWR(MSMFB_IOCTL_MAGIC, 167, \
+						struct mdp_atomic_commit)
 
 #define MSMFB_WRITEBACK_PLAY      	_IOW(MSMFB_IOCTL_MAGIC, 200, struct msmfb_overlay_data)
 #define MSMFB_GET_USB_PROJECTOR_INFO _IOR(MSMFB_IOCTL_MAGIC, 201, struct msmfb_usb_projector_info)
@@ -670,6 +672,33 @@ struct mdp_display_commit {
 	struct fb_var_screeninfo var;
 };
 
+#define MDP_ATOMIC_MAX_LAYERS	8
+
+/*
+ * Queue the frame and return once its release fence exists; acquire fences
+ * are waited on by the commit worker.  Every layer must name a pipe that
+ * was set up before, new pipes are committed synchronously.
+ */
+#define MDP_ATOMIC_COMMIT_ASYNC	0x00000001
+
+/* overlay.id is written back; data.id is taken from it */
+struct mdp_atomic_layer {
+	struct mdp_overlay overlay;
+	struct msmfb_overlay_data data;
+};
+
+/*
+ * Set and play every layer, take the acquire fences and return the release
+ * fence, then commit the frame, all in one call.
+ */
+struct mdp_atomic_commit {
+	uint32_t flags;
+	uint32_t num_layers;
+	struct mdp_atomic_layer *layers;
+	struct mdp_buf_sync buf_sync;
+	struct mdp_display_commit commit;
+};
+
 struct mdp_page_protection {
 	uint32_t page_protection;
 };
@@ -716,6 +745,15 @@ int msm_fb_writeback_dequeue_buffer(struct fb_info *info,
 		struct msmfb_data *data);
 int msm_fb_writeback_stop(struct fb_info *info);
 int msm_fb_writeback_terminate(struct fb_info *info);
+
+struct notifier_block;
+
+/*
+ * Notifiers registered here are called from interrupt context on every
+ * vsync of the primary panel with a pointer to the ktime_t of the vsync
+ */
+int msm_fb_register_vsync_notifier(struct notifier_block *nb);
+int msm_fb_unregister_vsync_notifier(struct notifier_block *nb);
 #endif
 
 #endif 
@@ -12,6 +12,8 @@
 		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 2, struct msm_rotator_data_info)
 #define MSM_ROTATOR_IOCTL_FINISH   \
 		_IOW(MSM_ROTATOR_IOCTL_MAGIC, 3, int)
+#define MSM_ROTATOR_IOCTL_ROTATE_ASYNC   \
+		_IOWR(MSM_ROTATOR_IOCTL_MAGIC, 4, struct msm_rotator_async_info)
 
 #define ROTATOR_VERSION_01	0xA5B4C301
 
@@ -46,6 +48,17 @@ struct msm_rotator_data_info {
 	struct msmfb_data dst_chroma;
 };
 
+/*
+ * Queued rotation: returns once the job is queued.  The rotator waits for
+ * acq_fen_fd (-1 for none) before reading src, and rel_fen_fd is returned
+ * to signal when dst has been written.
+ */
+struct msm_rotator_async_info {
+	struct msm_rotator_data_info data;
+	int acq_fen_fd;
+	int rel_fen_fd;
+};
+
 struct msm_rot_clocks {
 	const char *clk_name;
 	enum rotator_clk_type clk_type;
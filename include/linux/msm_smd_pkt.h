@@ -20,4 +20,17 @@
 #define SMD_PKT_IOCTL_BLOCKING_WRITE \
 	_IOR(SMD_PKT_IOCTL_MAGIC, 0, unsigned int)
 
+/*
+ * Hold reader wakeups back until bytes are pending in the channel, or
+ * latency_ms after the first held back packet.  bytes == 0 wakes on
+ * every packet, which is the default on each open.
+ */
+struct smd_pkt_wake_watermark {
+	unsigned int bytes;
+	unsigned int latency_ms;
+};
+
+#define SMD_PKT_IOCTL_WAKE_WATERMARK \
+	_IOW(SMD_PKT_IOCTL_MAGIC, 1, struct smd_pkt_wake_watermark)
+
 #endif 
@@ -35,9 +35,17 @@ struct msm_ssbi_platform_data {
 	enum msm_ssbi_controller_type controller_type;
 };
 
+/* One byte of a batch, val is filled in for reads */
+struct msm_ssbi_xfer {
+	u16	addr;
+	u8	val;
+	u8	write;
+};
+
 #ifdef CONFIG_MSM_SSBI
 int msm_ssbi_write(struct device *dev, u16 addr, u8 *buf, int len);
 int msm_ssbi_read(struct device *dev, u16 addr, u8 *buf, int len);
+int msm_ssbi_xfer(struct device *dev, struct msm_ssbi_xfer *xfer, int n);
 #else
 static inline int msm_ssbi_write(struct device *dev, u16 addr, u8 *buf, int len)
 {
@@ -47,5 +55,10 @@ static inline int msm_ssbi_read(struct device *dev, u16 addr, u8 *buf, int len)
 {
 	return -ENXIO;
 }
+static inline int msm_ssbi_xfer(struct device *dev, struct msm_ssbi_xfer *xfer,
+				int n)
+{
+	return -ENXIO;
+}
 #endif
 #endif
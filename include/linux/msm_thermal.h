@@ -20,15 +20,31 @@ struct msm_thermal_data {
 	uint32_t limit_temp;
 	uint32_t temp_hysteresis;
 	uint32_t limit_freq;
+	/* other TSENS sensors to watch besides sensor_id, one bit each */
+	uint32_t zone_mask;
 };
 
+struct notifier_block;
+
 #ifdef CONFIG_THERMAL_MONITOR
 extern int msm_thermal_init(struct msm_thermal_data *pdata);
+/* Called with the mitigation level, 0 for none, whenever it changes */
+extern int msm_thermal_register_gpu_notifier(struct notifier_block *nb);
+extern int msm_thermal_unregister_gpu_notifier(struct notifier_block *nb);
 #else
 static inline int msm_thermal_init(struct msm_thermal_data *pdata)
 {
 	return -ENOSYS;
 }
+static inline int msm_thermal_register_gpu_notifier(struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+static inline int msm_thermal_unregister_gpu_notifier(
+		struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
 #endif
 
 #endif 
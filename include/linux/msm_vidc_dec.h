@@ -171,6 +171,14 @@ struct vdec_ioctl_msg {
 #define VDEC_IOCTL_SET_PERF_CLK \
 	_IOR(VDEC_IOCTL_MAGIC, 38, struct vdec_ioctl_msg)
 
+/* in: struct vdec_fillbuffer_batch, out: unsigned int queued */
+#define VDEC_IOCTL_FILL_OUTPUT_BUFFERS \
+	_IOW(VDEC_IOCTL_MAGIC, 39, struct vdec_ioctl_msg)
+
+/* in: struct vdec_msginfo_batch, out: unsigned int returned */
+#define VDEC_IOCTL_GET_NEXT_MSGS \
+	_IOR(VDEC_IOCTL_MAGIC, 40, struct vdec_ioctl_msg)
+
 enum vdec_picture {
 	PICTURE_TYPE_I,
 	PICTURE_TYPE_P,
@@ -214,6 +222,11 @@ struct vdec_fillbuffer_cmd {
 	void *client_data;
 };
 
+struct vdec_fillbuffer_batch {
+	struct vdec_fillbuffer_cmd __user *cmds;
+	unsigned int count;
+};
+
 enum vdec_bufferflush {
 	VDEC_FLUSH_TYPE_INPUT,
 	VDEC_FLUSH_TYPE_OUTPUT,
@@ -510,6 +523,11 @@ struct vdec_msginfo {
 	size_t msgdatasize;
 };
 
+struct vdec_msginfo_batch {
+	struct vdec_msginfo __user *msgs;
+	unsigned int count;
+};
+
 struct vdec_framerate {
 	unsigned long fps_denominator;
 	unsigned long fps_numerator;
@@ -213,6 +213,14 @@ struct venc_ioctl_msg{
 #define VEN_IOCTL_GET_RECON_BUFFER_SIZE \
 	_IOW(VEN_IOCTLBASE_NENC, 22, struct venc_ioctl_msg)
 
+/*
+ * in and out both point to a struct venc_buffer_fence.  The frame is
+ * handed to the core once acq_fen_fd signals; rel_fen_fd is returned and
+ * signals when the core is done reading the input buffer.
+ */
+#define VEN_IOCTL_CMD_ENCODE_FRAME_FENCE \
+	_IOWR(VEN_IOCTLBASE_NENC, 23, struct venc_ioctl_msg)
+
 
 
 
@@ -402,6 +410,12 @@ struct venc_buffer{
  void	*clientdata;
 };
 
+struct venc_buffer_fence {
+	struct venc_buffer buf;
+	int acq_fen_fd;
+	int rel_fen_fd;
+};
+
 struct venc_basecfg{
 	unsigned long	input_width;
 	unsigned long	input_height;
@@ -1043,6 +1043,11 @@ struct net_device {
 
 	
 	int group;
+
+	
+	unsigned int		tcp_rmem_default;
+	unsigned int		tcp_wmem_default;
+	unsigned int		tcp_initrwnd;
 };
 #define to_net_dev(d) container_of(d, struct net_device, dev)
 
@@ -1688,12 +1693,24 @@ extern int netif_set_real_num_tx_queues(struct net_device *dev,
 #ifdef CONFIG_RPS
 extern int netif_set_real_num_rx_queues(struct net_device *dev,
 					unsigned int rxq);
+extern int netdev_rx_queue_set_rps_mask(struct netdev_rx_queue *queue,
+					const struct cpumask *mask);
+extern int netdev_rx_queue_set_rps_flow_cnt(struct netdev_rx_queue *queue,
+					    unsigned long count);
+extern int netif_rps_follow_irq(struct net_device *dev, int irq,
+				unsigned long flow_cnt);
 #else
 static inline int netif_set_real_num_rx_queues(struct net_device *dev,
 						unsigned int rxq)
 {
 	return 0;
 }
+
+static inline int netif_rps_follow_irq(struct net_device *dev, int irq,
+				       unsigned long flow_cnt)
+{
+	return 0;
+}
 #endif
 
 static inline int netif_copy_real_num_queues(struct net_device *to_dev,
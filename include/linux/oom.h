@@ -53,6 +53,52 @@ static inline void oom_killer_enable(void)
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+/*
+ * Pages a driver holds for a thread group outside of its mm, such as GPU
+ * memory, that are freed when it dies.  Called under rcu_read_lock from the
+ * lowmemorykiller; the driver clears it and waits for rcu before going away.
+ */
+extern unsigned long (*oom_driver_pages)(pid_t tgid);
+
+/*
+ * The lowmemorykiller keeps thread group leaders in buckets by
+ * oom_score_adj.  These are called with the tasklist_lock or the siglock
+ * held whenever a leader comes or goes or its oom_score_adj changes.
+ */
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+static inline void lowmem_adj_init(struct task_struct *p)
+{
+	INIT_LIST_HEAD(&p->lmk_adj_node);
+}
+
+extern void lowmem_adj_add(struct task_struct *p);
+extern void lowmem_adj_del(struct task_struct *p);
+extern void lowmem_adj_update(struct task_struct *p);
+extern void lowmem_adj_replace(struct task_struct *old,
+			       struct task_struct *new);
+#else
+static inline void lowmem_adj_init(struct task_struct *p)
+{
+}
+
+static inline void lowmem_adj_add(struct task_struct *p)
+{
+}
+
+static inline void lowmem_adj_del(struct task_struct *p)
+{
+}
+
+static inline void lowmem_adj_update(struct task_struct *p)
+{
+}
+
+static inline void lowmem_adj_replace(struct task_struct *old,
+				      struct task_struct *new)
+{
+}
+#endif
+
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
 extern int sysctl_panic_on_oom;
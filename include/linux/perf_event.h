@@ -913,5 +913,19 @@ _name##_show(struct device *dev,					\
 									\
 static struct device_attribute format_attr_##_name = __ATTR_RO(_name)
 
+struct perf_pmu_events_attr {
+	struct device_attribute attr;
+	const char *event_str;
+};
+
+extern ssize_t perf_event_sysfs_show(struct device *dev,
+				     struct device_attribute *attr, char *page);
+
+#define PMU_EVENT_ATTR_STRING(_name, _var, _str)			\
+static struct perf_pmu_events_attr _var = {				\
+	.attr		= __ATTR(_name, 0444, perf_event_sysfs_show, NULL),\
+	.event_str	= _str,						\
+}
+
 #endif 
 #endif 
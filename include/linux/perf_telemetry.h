@@ -0,0 +1,72 @@
+/* include/linux/perf_telemetry.h
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __LINUX_PERF_TELEMETRY_H
+#define __LINUX_PERF_TELEMETRY_H
+
+#include <linux/types.h>
+
+/*
+ * Fixed-format samples from cpufreq, kgsl, msm_bus, tsens, the low memory
+ * killer and msm_fb go into one ring per cpu, which a single reader
+ * mmaps from /dev/perf_telemetry while it holds the device open.  Ring n
+ * starts n * span bytes into the mapping: one page holding struct
+ * perf_tm_ring, then size samples.  head and tail are free running
+ * sample counts, the reader advances tail after consuming.  A full ring
+ * drops new samples and counts them in lost.  poll() returns once a ring
+ * is past the watermark.
+ */
+enum perf_tm_type {
+	PERF_TM_CPU_FREQ = 1,	/* cpu, old kHz, new kHz */
+	PERF_TM_CPU_LOAD,	/* cpu, load %, cur kHz */
+	PERF_TM_GPU_LEVEL,	/* pwrlevel, gpu Hz */
+	PERF_TM_GPU_BUSY,	/* busy us, elapsed us */
+	PERF_TM_BUS_VOTE,	/* client, usecase */
+	PERF_TM_TEMP,		/* sensor, degC */
+	PERF_TM_LMK_KILL,	/* pid, oom_score_adj, pages */
+	PERF_TM_FRAME_COMMIT,	/* fb node, us */
+};
+
+struct perf_tm_sample {
+	__u64 timestamp;	/* sched_clock, ns */
+	__u16 type;
+	__u16 cpu;
+	__u32 arg[3];
+};
+
+struct perf_tm_ring {
+	volatile __u32 head;
+	volatile __u32 tail;
+	__u32 size;
+	__u32 lost;
+	__u32 span;
+	__u32 nr_rings;
+};
+
+#ifdef __KERNEL__
+#ifdef CONFIG_PERF_TELEMETRY
+extern int perf_tm_on;
+extern void __perf_tm_log(unsigned int type, u32 a0, u32 a1, u32 a2);
+
+static inline void perf_tm_log(unsigned int type, u32 a0, u32 a1, u32 a2)
+{
+	if (unlikely(perf_tm_on))
+		__perf_tm_log(type, a0, a1, a2);
+}
+#else
+static inline void perf_tm_log(unsigned int type, u32 a0, u32 a1, u32 a2)
+{
+}
+#endif
+#endif
+
+#endif
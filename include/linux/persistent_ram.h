@@ -59,6 +59,8 @@ struct persistent_ram_zone {
 	int ecc_size;
 	int ecc_symsize;
 	int ecc_poly;
+	int ecc_blocks;
+	unsigned long *ecc_dirty;
 
 	char *old_log;
 	size_t old_log_size;
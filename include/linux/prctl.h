@@ -93,4 +93,6 @@
 #define PR_SET_CHILD_SUBREAPER 36
 #define PR_GET_CHILD_SUBREAPER 37
 
+#define PR_SET_FORK_TEMPLATE 0x464b5450
+
 #endif 
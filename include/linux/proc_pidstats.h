@@ -0,0 +1,37 @@
+#ifndef _LINUX_PROC_PIDSTATS_H
+#define _LINUX_PROC_PIDSTATS_H
+
+#include <linux/types.h>
+
+/*
+ * /proc/pidstats: one fixed size record per process, in pid order,
+ * after a header giving the layout.  Times are in nanoseconds, memory
+ * in pages.  A record only grows at the end; readers step by rec_size.
+ */
+#define PIDSTATS_VERSION	1
+
+struct pidstats_hdr {
+	__u32	version;
+	__u32	rec_size;
+	__u32	page_size;
+	__u32	__pad;
+};
+
+struct pidstats_rec {
+	__s32	pid;
+	__s32	ppid;
+	__u32	uid;
+	__s16	oom_score_adj;
+	__u8	state;
+	__u8	__pad;
+	__u32	nr_threads;
+	__u32	vm_pages;
+	__u32	rss_pages;
+	__u32	swap_pages;
+	__u64	utime_ns;
+	__u64	stime_ns;
+	__u64	start_time_ns;
+	char	comm[16];
+};
+
+#endif
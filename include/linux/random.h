@@ -33,6 +33,8 @@ struct rnd_state {
 #ifdef __KERNEL__
 
 extern void add_device_randomness(const void *, unsigned int);
+extern int add_hwrng_randomness(const void *buf, unsigned int size,
+				unsigned int entropy_bits);
 extern void add_input_randomness(unsigned int type, unsigned int code,
 				 unsigned int value);
 extern void add_interrupt_randomness(int irq, int irq_flags);
@@ -24,6 +24,10 @@ struct rq_data {
 	struct kobject *kobj;
 	struct work_struct def_timer_work;
 	int init;
+	/* Average for the in-kernel hotplug engine, reset by its reads */
+	unsigned int hp_rq_avg;
+	unsigned long hp_poll_total_jiffies;
+	int hotplug_enabled;
 };
 
 extern spinlock_t rq_lock;
@@ -356,6 +356,7 @@ extern int get_dumpable(struct mm_struct *mm);
 					
 #define MMF_VM_MERGEABLE	16	
 #define MMF_VM_HUGEPAGE		17	
+#define MMF_FORK_TEMPLATE	18	
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -564,6 +565,8 @@ struct backing_dev_info;
 struct reclaim_state;
 
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
+#define SCHED_LAT_HIST_BUCKETS	18
+
 struct sched_info {
 	
 	unsigned long pcount;	      
@@ -572,6 +575,11 @@ struct sched_info {
 	
 	unsigned long long last_arrival,
 			   last_queued;	
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* Wakeup to run, log2 buckets of 1024ns, see /proc/<pid>/schedlat */
+	unsigned int lat_pending;
+	unsigned int lat_hist[SCHED_LAT_HIST_BUCKETS];
+#endif
 };
 #endif 
 
@@ -962,6 +970,15 @@ struct sched_entity {
 
 	u64			nr_migrations;
 
+#ifdef CONFIG_SMP
+	/* runtime share between wakeups, see update_small_task() */
+	u64			wakeup_start;
+	u64			wakeup_sum_exec;
+	unsigned int		wakeup_count;
+	unsigned int		small_ratio;
+	unsigned int		small_task;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	struct sched_statistics statistics;
 #endif
@@ -1051,6 +1068,11 @@ struct task_struct {
 #endif
 
 	struct list_head tasks;
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER_EVENT
+	/* lowmemorykiller oom_score_adj bucket, leaders only */
+	struct list_head lmk_adj_node;
+	short lmk_adj;
+#endif
 #ifdef CONFIG_SMP
 	struct plist_node pushable_tasks;
 #endif
@@ -1643,6 +1665,7 @@ extern unsigned int sysctl_sched_min_granularity;
 extern unsigned int sysctl_sched_wakeup_granularity;
 extern unsigned int sysctl_sched_child_runs_first;
 extern unsigned int sysctl_sched_wake_to_idle;
+extern unsigned int sysctl_sched_small_task_pct;
 
 enum sched_tunable_scaling {
 	SCHED_TUNABLESCALING_NONE,
@@ -1098,6 +1098,15 @@ extern struct sk_buff *dev_alloc_skb(unsigned int length);
 
 extern struct sk_buff *__netdev_alloc_skb(struct net_device *dev,
 		unsigned int length, gfp_t gfp_mask);
+extern int __netdev_alloc_skb_bulk(struct net_device *dev,
+		unsigned int length, gfp_t gfp_mask,
+		struct sk_buff **skbs, int nr);
+
+static inline int __dev_alloc_skb_bulk(unsigned int length, gfp_t gfp_mask,
+				       struct sk_buff **skbs, int nr)
+{
+	return __netdev_alloc_skb_bulk(NULL, length, gfp_mask, skbs, nr);
+}
 
 static inline struct sk_buff *netdev_alloc_skb(struct net_device *dev,
 		unsigned int length)
@@ -67,6 +67,10 @@ struct suspend_stats {
 	int	errno[REC_FAILED_NUM];
 	int	last_failed_step;
 	enum suspend_stat_step	failed_steps[REC_FAILED_NUM];
+#define	REC_SLOW_NUM	4
+	unsigned int	last_resume_usecs;
+	char	slow_devs[REC_SLOW_NUM][40];
+	unsigned int	slow_usecs[REC_SLOW_NUM];
 };
 
 extern struct suspend_stats suspend_stats;
@@ -101,6 +101,7 @@ enum {
 	SWP_SOLIDSTATE	= (1 << 4),	
 	SWP_CONTINUED	= (1 << 5),	
 	SWP_BLKDEV	= (1 << 6),	
+	SWP_INMEM	= (1 << 7),	
 					
 	SWP_SCANNING	= (1 << 8),	
 };
@@ -174,6 +175,16 @@ extern void swap_setup(void);
 
 extern void add_page_to_unevictable_list(struct page *page);
 
+/* linux/mm/workingset.c */
+extern void workingset_eviction(struct address_space *mapping,
+				struct page *page);
+extern bool workingset_refault(struct address_space *mapping, pgoff_t index);
+extern void workingset_swap_cost(struct page *page, int rw, unsigned long ns);
+extern unsigned long workingset_cost_unit(void);
+extern void workingset_costs(unsigned long *anon_read,
+			     unsigned long *anon_write,
+			     unsigned long *file_read);
+
 static inline void lru_cache_add_anon(struct page *page)
 {
 	__lru_cache_add(page, LRU_INACTIVE_ANON);
@@ -250,6 +261,7 @@ static inline void mem_cgroup_uncharge_swap(swp_entry_t ent)
 #ifdef CONFIG_SWAP
 extern int swap_readpage(struct page *);
 extern int swap_writepage(struct page *page, struct writeback_control *wbc);
+extern void swap_write_unplug(struct bio **plug);
 extern void end_swap_bio_read(struct bio *bio, int err);
 
 extern struct address_space swapper_space;
@@ -266,6 +278,8 @@ extern struct page *read_swap_cache_async(swp_entry_t, gfp_t,
 			struct vm_area_struct *vma, unsigned long addr);
 extern struct page *swapin_readahead(swp_entry_t, gfp_t,
 			struct vm_area_struct *vma, unsigned long addr);
+extern struct page *swapin_readahead_vma(swp_entry_t, gfp_t,
+			struct vm_area_struct *vma, unsigned long addr);
 
 extern long nr_swap_pages;
 extern long total_swap_pages;
@@ -282,6 +296,7 @@ extern int free_swap_and_cache(swp_entry_t);
 extern int swap_type_of(dev_t, sector_t, struct block_device **);
 extern unsigned int count_swap_pages(int, int);
 extern sector_t map_swap_page(struct page *, struct block_device **);
+extern struct swap_info_struct *swp_swap_info(swp_entry_t);
 extern sector_t swapdev_block(int, pgoff_t);
 extern int reuse_swap_page(struct page *);
 extern int try_to_free_swap(struct page *);
@@ -362,11 +377,22 @@ static inline struct page *swapin_readahead(swp_entry_t swp, gfp_t gfp_mask,
 	return NULL;
 }
 
+static inline struct page *swapin_readahead_vma(swp_entry_t swp,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr)
+{
+	return NULL;
+}
+
 static inline int swap_writepage(struct page *p, struct writeback_control *wbc)
 {
 	return 0;
 }
 
+static inline void swap_write_unplug(struct bio **plug)
+{
+}
+
 static inline struct page *lookup_swap_cache(swp_entry_t swp)
 {
 	return NULL;
@@ -47,6 +47,8 @@ struct usbnet {
 	u32			xid;
 	u32			hard_mtu;	/* count any extra framing */
 	size_t			rx_urb_size;	/* size for rx urbs */
+	unsigned		rx_qlen;	/* rx urbs in flight, 0: default */
+	unsigned		tx_qlen;	/* tx urbs in flight, 0: default */
 	struct mii_if_info	mii;
 
 	/* various kinds of pending driver work */
@@ -56,7 +58,13 @@ struct usbnet {
 	struct sk_buff_head	rxq_pause;
 	struct urb		*interrupt;
 	struct usb_anchor	deferred;
-	struct tasklet_struct	bh;
+	struct work_struct	bh_w;
+	struct napi_struct	napi;
+
+	/* urb submit to completion, bucket n counts < 2^n usec */
+#define USBNET_LAT_BUCKETS	16
+	unsigned int		rx_lat[USBNET_LAT_BUCKETS];
+	unsigned int		tx_lat[USBNET_LAT_BUCKETS];
 
 	struct work_struct	kevent;
 	unsigned long		flags;
@@ -106,6 +114,7 @@ struct driver_info {
  */
 #define FLAG_MULTI_PACKET	0x2000
 #define FLAG_RX_ASSEMBLE	0x4000	/* rx packets may span >1 frames */
+#define FLAG_RX_NAPI		0x8000	/* rx completions handled by NAPI */
 
 	/* init device ... can sleep, or cause probe() failure */
 	int	(*bind)(struct usbnet *, struct usb_interface *);
@@ -200,6 +209,7 @@ struct skb_data {	/* skb->cb is one of these */
 	struct usbnet		*dev;
 	enum skb_state		state;
 	size_t			length;
+	ktime_t			submitted;
 };
 
 extern int usbnet_open(struct net_device *net);
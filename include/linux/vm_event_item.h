@@ -37,9 +37,15 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		WORKINGSET_REFAULT, WORKINGSET_ACTIVATE,
+		PGSCAN_BALANCE_ANON, PGSCAN_BALANCE_FILE,
+#ifdef CONFIG_ANON_LARGE_PAGES
+		ANON_LARGE_FAULT_ALLOC, ANON_LARGE_FAULT_FALLBACK,
+#endif
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		KCOMPACTD_RUN, KCOMPACTD_SUCCESS, KCOMPACTD_AVOIDED,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
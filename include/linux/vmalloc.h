@@ -14,6 +14,9 @@ struct vm_area_struct;
 #define VM_VPAGES	0x00000010	
 #define VM_UNLIST	0x00000020	
 
+/* Largest vm_map_ram(), in pages, served from the per-cpu vmap blocks */
+#define VMAP_MAX_ALLOC		(BITS_PER_LONG * 4)
+
 #ifndef IOREMAP_MAX_ORDER
 #define IOREMAP_MAX_ORDER	(7 + PAGE_SHIFT)	
 #endif
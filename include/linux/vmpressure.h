@@ -0,0 +1,24 @@
+#ifndef __LINUX_VMPRESSURE_H
+#define __LINUX_VMPRESSURE_H
+
+#include <linux/gfp.h>
+#include <linux/notifier.h>
+
+/*
+ * Notifiers are called with the pressure, 0 to 100, as the action once per
+ * window of scanned pages.  They are called from reclaim and must not
+ * block or allocate memory.
+ */
+#ifdef CONFIG_VMPRESSURE
+extern void vmpressure(gfp_t gfp, unsigned long scanned,
+		       unsigned long reclaimed);
+extern int vmpressure_register_notifier(struct notifier_block *nb);
+extern int vmpressure_unregister_notifier(struct notifier_block *nb);
+#else
+static inline void vmpressure(gfp_t gfp, unsigned long scanned,
+			      unsigned long reclaimed)
+{
+}
+#endif
+
+#endif /* __LINUX_VMPRESSURE_H */
@@ -57,6 +57,8 @@ struct writeback_control {
 	unsigned tagged_writepages:1;	
 	unsigned for_reclaim:1;		
 	unsigned range_cyclic:1;	
+	struct bio **swap_plug;		/* batch of swap writes, see
+					   swap_writepage() */
 };
 
 	
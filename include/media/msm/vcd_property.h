@@ -61,6 +61,7 @@
 #define VCD_I_FREE_EXT_METABUFFER (VCD_START_BASE + 0x2D)
 #define VCD_I_ENABLE_SEC_METADATA (VCD_START_BASE + 0x2E)
 #define VCD_I_ENABLE_VUI_BITSTREAM_RESTRICT_FLAG (VCD_START_BASE + 0x2F)
+#define VCD_I_SCHED_PRIORITY (VCD_START_BASE + 0x30)
 
 #define VCD_START_REQ      (VCD_START_BASE + 0x1000)
 #define VCD_I_REQ_IFRAME   (VCD_START_REQ + 0x1)
@@ -316,6 +317,17 @@ struct vcd_property_vop_timing_constant_delta {
 	u32 constant_delta; 
 };
 
+/*
+ * Frames of the highest priority client with work are always scheduled
+ * first.  deadline_us is the longest a frame may wait in the scheduler,
+ * 0 for none; missed counts frames that waited longer and is read only.
+ */
+struct vcd_property_sched_priority {
+	u32 priority;
+	u32 deadline_us;
+	u32 missed;
+};
+
 struct vcd_property_short_header {
 	u32             short_header;
 };
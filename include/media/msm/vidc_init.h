@@ -18,6 +18,9 @@
 #include <media/msm/vcd_property.h>
 
 #define VIDC_MAX_NUM_CLIENTS 4
+
+struct sw_sync_timeline;
+struct workqueue_struct;
 #define MAX_VIDEO_NUM_OF_BUFF 100
 
 enum buffer_dir {
@@ -60,6 +63,12 @@ struct video_client_ctx {
 	struct ion_handle *h264_mv_ion_handle;
 	struct ion_handle *recon_buffer_ion_handle[4];
 	u32 dmx_disable;
+	/* Encoder fenced submission, see VEN_IOCTL_CMD_ENCODE_FRAME_FENCE */
+	struct workqueue_struct *fence_wq;
+	struct sw_sync_timeline *timeline;
+	u32 timeline_max;
+	struct list_head fence_jobs;
+	struct mutex fence_lock;
 };
 
 void __iomem *vidc_get_ioaddr(void);
@@ -16,10 +16,18 @@
 #ifndef __activity_stats_h
 #define __activity_stats_h
 
+#include <linux/activity_stats.h>
+
+struct sk_buff;
+
 #ifdef CONFIG_NET_ACTIVITY_STATS
 void activity_stats_update(void);
+uid_t activity_stats_skb_uid(struct sk_buff *skb);
+void activity_stats_radio(uid_t uid, unsigned int len, int tx);
 #else
 #define activity_stats_update(void) {}
+#define activity_stats_skb_uid(skb) ACTIVITY_UID_NONE
+#define activity_stats_radio(uid, len, tx) do { } while (0)
 #endif
 
 #endif 
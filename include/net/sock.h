@@ -143,6 +143,7 @@ struct sock_common {
 };
 
 struct cg_proto;
+struct sock_tag;
 struct sock {
 	struct sock_common	__sk_common;
 #define sk_node			__sk_common.skc_node
@@ -235,6 +236,9 @@ struct sock {
 	int			sk_write_pending;
 #ifdef CONFIG_SECURITY
 	void			*sk_security;
+#endif
+#ifdef CONFIG_NETFILTER_XT_MATCH_QTAGUID
+	struct sock_tag __rcu	*sk_qtaguid;
 #endif
 	__u32			sk_mark;
 	u32			sk_classid;
@@ -842,6 +842,17 @@ extern void tcp_select_initial_window(int __space, __u32 mss,
 				      __u32 *rcv_wnd, __u32 *window_clamp,
 				      int wscale_ok, __u8 *rcv_wscale,
 				      __u32 init_rcv_wnd);
+extern void tcp_init_dev_buffers(struct sock *sk, const struct dst_entry *dst);
+
+/* Initial receive window: the route metric, else the device default */
+static inline u32 tcp_dst_initrwnd(const struct dst_entry *dst)
+{
+	u32 rwnd = dst_metric(dst, RTAX_INITRWND);
+
+	if (!rwnd && dst->dev)
+		rwnd = dst->dev->tcp_initrwnd;
+	return rwnd;
+}
 
 static inline int tcp_win_from_space(int space)
 {
@@ -0,0 +1,36 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM apr
+
+#if !defined(_TRACE_APR_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_APR_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(apr_cmd_rtt,
+
+	TP_PROTO(uint16_t svc, uint32_t opcode, uint32_t token, s64 rtt_us),
+
+	TP_ARGS(svc, opcode, token, rtt_us),
+
+	TP_STRUCT__entry(
+		__field(	uint16_t,	svc	)
+		__field(	uint32_t,	opcode	)
+		__field(	uint32_t,	token	)
+		__field(	s64,		rtt_us	)
+	),
+
+	TP_fast_assign(
+		__entry->svc = svc;
+		__entry->opcode = opcode;
+		__entry->token = token;
+		__entry->rtt_us = rtt_us;
+	),
+
+	TP_printk("svc=%u opcode=0x%08x token=0x%x rtt=%lldus",
+		__entry->svc, __entry->opcode, __entry->token,
+		__entry->rtt_us)
+);
+
+#endif
+
+#include <trace/define_trace.h>
@@ -0,0 +1,93 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM binder
+
+#if !defined(_TRACE_BINDER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_BINDER_H
+
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(binder_transaction,
+
+	TP_PROTO(int debug_id, int reply, pid_t to_proc, pid_t to_thread,
+		 unsigned int code, unsigned int flags),
+
+	TP_ARGS(debug_id, reply, to_proc, to_thread, code, flags),
+
+	TP_STRUCT__entry(
+		__field(	int,		debug_id)
+		__field(	int,		reply)
+		__field(	pid_t,		to_proc)
+		__field(	pid_t,		to_thread)
+		__field(	unsigned int,	code)
+		__field(	unsigned int,	flags)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id = debug_id;
+		__entry->reply = reply;
+		__entry->to_proc = to_proc;
+		__entry->to_thread = to_thread;
+		__entry->code = code;
+		__entry->flags = flags;
+	),
+
+	TP_printk("transaction=%d dest_proc=%d dest_thread=%d reply=%d "
+		  "flags=0x%x code=0x%x",
+		__entry->debug_id, __entry->to_proc, __entry->to_thread,
+		__entry->reply, __entry->flags, __entry->code)
+);
+
+TRACE_EVENT(binder_transaction_received,
+
+	TP_PROTO(int debug_id, int reply, s64 latency_us),
+
+	TP_ARGS(debug_id, reply, latency_us),
+
+	TP_STRUCT__entry(
+		__field(	int,	debug_id)
+		__field(	int,	reply)
+		__field(	s64,	latency_us)
+	),
+
+	TP_fast_assign(
+		__entry->debug_id = debug_id;
+		__entry->reply = reply;
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk("transaction=%d reply=%d latency=%lldus",
+		__entry->debug_id, __entry->reply, __entry->latency_us)
+);
+
+TRACE_EVENT(binder_set_priority,
+
+	TP_PROTO(struct task_struct *task, unsigned int old_policy,
+		 int old_prio, unsigned int new_policy, int new_prio),
+
+	TP_ARGS(task, old_policy, old_prio, new_policy, new_prio),
+
+	TP_STRUCT__entry(
+		__field(	pid_t,		pid)
+		__field(	unsigned int,	old_policy)
+		__field(	int,		old_prio)
+		__field(	unsigned int,	new_policy)
+		__field(	int,		new_prio)
+	),
+
+	TP_fast_assign(
+		__entry->pid = task->pid;
+		__entry->old_policy = old_policy;
+		__entry->old_prio = old_prio;
+		__entry->new_policy = new_policy;
+		__entry->new_prio = new_prio;
+	),
+
+	TP_printk("pid=%d policy=%u:%d -> %u:%d",
+		__entry->pid, __entry->old_policy, __entry->old_prio,
+		__entry->new_policy, __entry->new_prio)
+);
+
+#endif
+
+#include <trace/define_trace.h>
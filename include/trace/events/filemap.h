@@ -0,0 +1,57 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM filemap
+
+#if !defined(_TRACE_FILEMAP_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_FILEMAP_H
+
+#include <linux/fs.h>
+#include <linux/kdev_t.h>
+#include <linux/tracepoint.h>
+
+/*
+ * Page cache misses, in the order they happen.  A launch trace recorded
+ * from these can be sorted by file and offset and replayed with
+ * readahead(2) ahead of the next cold start.
+ */
+DECLARE_EVENT_CLASS(mm_filemap_miss,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t index),
+
+	TP_ARGS(mapping, index),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,		s_dev	)
+		__field(	unsigned long,	i_ino	)
+		__field(	pgoff_t,	index	)
+		__field(	pid_t,		pid	)
+	),
+
+	TP_fast_assign(
+		__entry->s_dev	= mapping->host->i_sb->s_dev;
+		__entry->i_ino	= mapping->host->i_ino;
+		__entry->index	= index;
+		__entry->pid	= current->pid;
+	),
+
+	TP_printk("dev %d:%d ino %lu index %lu pid %d",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino, (unsigned long)__entry->index, __entry->pid)
+);
+
+DEFINE_EVENT(mm_filemap_miss, mm_filemap_fault,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t index),
+
+	TP_ARGS(mapping, index)
+);
+
+DEFINE_EVENT(mm_filemap_miss, mm_filemap_read,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t index),
+
+	TP_ARGS(mapping, index)
+);
+
+#endif
+
+#include <trace/define_trace.h>
@@ -0,0 +1,130 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM frametime
+
+#if !defined(_TRACE_FRAMETIME_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_FRAMETIME_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * seq is the number of the latest touch input when the event happened,
+ * so everything a touch caused carries at least its seq.
+ */
+TRACE_EVENT(frame_input,
+
+	TP_PROTO(u32 seq),
+
+	TP_ARGS(seq),
+
+	TP_STRUCT__entry(
+		__field(	u32,	seq)
+	),
+
+	TP_fast_assign(
+		__entry->seq = seq;
+	),
+
+	TP_printk("seq=%u", __entry->seq)
+);
+
+TRACE_EVENT(frame_binder,
+
+	TP_PROTO(u32 seq, int debug_id),
+
+	TP_ARGS(seq, debug_id),
+
+	TP_STRUCT__entry(
+		__field(	u32,	seq)
+		__field(	int,	debug_id)
+	),
+
+	TP_fast_assign(
+		__entry->seq = seq;
+		__entry->debug_id = debug_id;
+	),
+
+	TP_printk("seq=%u transaction=%d", __entry->seq, __entry->debug_id)
+);
+
+DECLARE_EVENT_CLASS(frame_gpu,
+
+	TP_PROTO(u32 seq, unsigned int context, unsigned int timestamp),
+
+	TP_ARGS(seq, context, timestamp),
+
+	TP_STRUCT__entry(
+		__field(	u32,		seq)
+		__field(	unsigned int,	context)
+		__field(	unsigned int,	timestamp)
+	),
+
+	TP_fast_assign(
+		__entry->seq = seq;
+		__entry->context = context;
+		__entry->timestamp = timestamp;
+	),
+
+	TP_printk("seq=%u ctx=%u ts=%u", __entry->seq, __entry->context,
+		__entry->timestamp)
+);
+
+DEFINE_EVENT(frame_gpu, frame_gpu_submit,
+	TP_PROTO(u32 seq, unsigned int context, unsigned int timestamp),
+	TP_ARGS(seq, context, timestamp)
+);
+
+DEFINE_EVENT(frame_gpu, frame_gpu_retire,
+	TP_PROTO(u32 seq, unsigned int context, unsigned int timestamp),
+	TP_ARGS(seq, context, timestamp)
+);
+
+TRACE_EVENT(frame_commit,
+
+	TP_PROTO(u32 seq, int fb, u32 commit),
+
+	TP_ARGS(seq, fb, commit),
+
+	TP_STRUCT__entry(
+		__field(	u32,	seq)
+		__field(	int,	fb)
+		__field(	u32,	commit)
+	),
+
+	TP_fast_assign(
+		__entry->seq = seq;
+		__entry->fb = fb;
+		__entry->commit = commit;
+	),
+
+	TP_printk("seq=%u fb=%d commit=%u", __entry->seq, __entry->fb,
+		__entry->commit)
+);
+
+TRACE_EVENT(frame_display,
+
+	TP_PROTO(u32 seq, int fb, u32 commit, s64 latency_us),
+
+	TP_ARGS(seq, fb, commit, latency_us),
+
+	TP_STRUCT__entry(
+		__field(	u32,	seq)
+		__field(	int,	fb)
+		__field(	u32,	commit)
+		__field(	s64,	latency_us)
+	),
+
+	TP_fast_assign(
+		__entry->seq = seq;
+		__entry->fb = fb;
+		__entry->commit = commit;
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk("seq=%u fb=%d commit=%u input_latency=%lldus",
+		__entry->seq, __entry->fb, __entry->commit,
+		__entry->latency_us)
+);
+
+#endif
+
+#include <trace/define_trace.h>
@@ -0,0 +1,87 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_TRACE_LOWMEMORYKILLER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LOWMEMORYKILLER_H
+
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(lowmemory_kill,
+
+	TP_PROTO(struct task_struct *task, int oom_score_adj, int tasksize,
+		 s64 latency_us),
+
+	TP_ARGS(task, oom_score_adj, tasksize, latency_us),
+
+	TP_STRUCT__entry(
+		__field(	pid_t,	pid)
+		__array(	char,	comm,	TASK_COMM_LEN)
+		__field(	int,	oom_score_adj)
+		__field(	int,	tasksize)
+		__field(	s64,	latency_us)
+	),
+
+	TP_fast_assign(
+		__entry->pid = task->pid;
+		memcpy(__entry->comm, task->comm, TASK_COMM_LEN);
+		__entry->oom_score_adj = oom_score_adj;
+		__entry->tasksize = tasksize;
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk("pid=%d comm=%s oom_score_adj=%d size=%dkB latency=%lldus",
+		__entry->pid, __entry->comm, __entry->oom_score_adj,
+		__entry->tasksize << (PAGE_SHIFT - 10), __entry->latency_us)
+);
+
+TRACE_EVENT(lowmemory_kill_done,
+
+	TP_PROTO(struct task_struct *task, s64 latency_us),
+
+	TP_ARGS(task, latency_us),
+
+	TP_STRUCT__entry(
+		__field(	pid_t,	pid)
+		__array(	char,	comm,	TASK_COMM_LEN)
+		__field(	s64,	latency_us)
+	),
+
+	TP_fast_assign(
+		__entry->pid = task->pid;
+		memcpy(__entry->comm, task->comm, TASK_COMM_LEN);
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk("pid=%d comm=%s latency=%lldus",
+		__entry->pid, __entry->comm, __entry->latency_us)
+);
+
+TRACE_EVENT(lowmemory_reap,
+
+	TP_PROTO(struct task_struct *task, int reclaimed, s64 latency_us),
+
+	TP_ARGS(task, reclaimed, latency_us),
+
+	TP_STRUCT__entry(
+		__field(	pid_t,	pid)
+		__array(	char,	comm,	TASK_COMM_LEN)
+		__field(	int,	reclaimed)
+		__field(	s64,	latency_us)
+	),
+
+	TP_fast_assign(
+		__entry->pid = task->pid;
+		memcpy(__entry->comm, task->comm, TASK_COMM_LEN);
+		__entry->reclaimed = reclaimed;
+		__entry->latency_us = latency_us;
+	),
+
+	TP_printk("pid=%d comm=%s reclaimed=%dkB latency=%lldus",
+		__entry->pid, __entry->comm,
+		__entry->reclaimed << (PAGE_SHIFT - 10), __entry->latency_us)
+);
+
+#endif
+
+#include <trace/define_trace.h>
@@ -0,0 +1,59 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM msm_thermal
+
+#if !defined(_TRACE_MSM_THERMAL_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MSM_THERMAL_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(msm_thermal_zone,
+	TP_PROTO(u32 sensor, long temp, long slope, long predicted),
+	TP_ARGS(sensor, temp, slope, predicted),
+
+	TP_STRUCT__entry(
+	    __field(u32,	sensor		)
+	    __field(long,	temp		)
+	    __field(long,	slope		)
+	    __field(long,	predicted	)
+	),
+
+	TP_fast_assign(
+	    __entry->sensor = sensor;
+	    __entry->temp = temp;
+	    __entry->slope = slope;
+	    __entry->predicted = predicted;
+	),
+
+	TP_printk("sensor=%u temp=%ld slope_mc_per_s=%ld predicted_mc=%ld",
+	      __entry->sensor, __entry->temp, __entry->slope,
+	      __entry->predicted)
+);
+
+TRACE_EVENT(msm_thermal_throttle,
+	TP_PROTO(unsigned int level, unsigned int max_freq, long temp,
+		 long predicted),
+	TP_ARGS(level, max_freq, temp, predicted),
+
+	TP_STRUCT__entry(
+	    __field(unsigned int,	level		)
+	    __field(unsigned int,	max_freq	)
+	    __field(long,		temp		)
+	    __field(long,		predicted	)
+	),
+
+	TP_fast_assign(
+	    __entry->level = level;
+	    __entry->max_freq = max_freq;
+	    __entry->temp = temp;
+	    __entry->predicted = predicted;
+	),
+
+	TP_printk("level=%u max_freq=%u temp=%ld predicted_mc=%ld",
+	      __entry->level, __entry->max_freq, __entry->temp,
+	      __entry->predicted)
+);
+
+#endif /* _TRACE_MSM_THERMAL_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,179 @@
+/*
+ * Boot profiler
+ *
+ * Every initcall (module inits included) and driver probe is recorded
+ * with its sched_clock start, duration and the cpu it finished on.  The
+ * log stays in memory and is shown by /proc/bootprof until a write to
+ * that file stops the recording or the log is full.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/atomic.h>
+#include <linux/device.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/smp.h>
+#include <linux/bootprof.h>
+
+#define BOOTPROF_MAX	1024
+#define BOOTPROF_NAME	32
+
+enum {
+	BOOTPROF_INITCALL,
+	BOOTPROF_PROBE,
+	BOOTPROF_MARK,
+};
+
+static const char * const bootprof_types[] = {
+	[BOOTPROF_INITCALL]	= "init",
+	[BOOTPROF_PROBE]	= "probe",
+	[BOOTPROF_MARK]		= "mark",
+};
+
+struct bootprof_entry {
+	unsigned long long start;
+	unsigned int usecs;
+	unsigned short cpu;
+	unsigned char type;
+	unsigned char valid;
+	union {
+		initcall_t fn;
+		char name[BOOTPROF_NAME];
+	};
+};
+
+static struct bootprof_entry bootprof_log[BOOTPROF_MAX];
+static atomic_t bootprof_count = ATOMIC_INIT(0);
+static atomic_t bootprof_lost = ATOMIC_INIT(0);
+static int bootprof_stopped;
+
+static unsigned int min_us;
+module_param(min_us, uint, 0644);
+MODULE_PARM_DESC(min_us, "Shortest initcall or probe recorded");
+
+static struct bootprof_entry *bootprof_get(int type,
+		unsigned long long start)
+{
+	struct bootprof_entry *e;
+	unsigned long long now;
+	int idx;
+
+	if (bootprof_stopped)
+		return NULL;
+
+	now = sched_clock();
+	if (type != BOOTPROF_MARK && now - start < min_us * 1000ULL)
+		return NULL;
+
+	idx = atomic_inc_return(&bootprof_count) - 1;
+	if (idx >= BOOTPROF_MAX) {
+		atomic_set(&bootprof_count, BOOTPROF_MAX);
+		atomic_inc(&bootprof_lost);
+		return NULL;
+	}
+
+	e = &bootprof_log[idx];
+	e->start = start;
+	e->usecs = div_u64(now - start, 1000);
+	e->cpu = raw_smp_processor_id();
+	e->type = type;
+	return e;
+}
+
+static void bootprof_put(struct bootprof_entry *e)
+{
+	smp_wmb();
+	e->valid = 1;
+}
+
+void bootprof_initcall(initcall_t fn, unsigned long long start)
+{
+	struct bootprof_entry *e = bootprof_get(BOOTPROF_INITCALL, start);
+
+	if (!e)
+		return;
+	e->fn = fn;
+	bootprof_put(e);
+}
+
+void bootprof_probe(struct device *dev, struct device_driver *drv,
+		    unsigned long long start)
+{
+	struct bootprof_entry *e = bootprof_get(BOOTPROF_PROBE, start);
+
+	if (!e)
+		return;
+	snprintf(e->name, BOOTPROF_NAME, "%s %s", drv->name, dev_name(dev));
+	bootprof_put(e);
+}
+
+void bootprof_mark(const char *what)
+{
+	struct bootprof_entry *e = bootprof_get(BOOTPROF_MARK, sched_clock());
+
+	if (!e)
+		return;
+	strlcpy(e->name, what, BOOTPROF_NAME);
+	bootprof_put(e);
+}
+
+static int bootprof_show(struct seq_file *m, void *v)
+{
+	struct bootprof_entry *e;
+	unsigned long long t;
+	unsigned long rem;
+	int i, n = min(atomic_read(&bootprof_count), BOOTPROF_MAX);
+
+	seq_printf(m, "%14s %9s %3s %-5s %s\n",
+		   "start", "usecs", "cpu", "type", "name");
+	for (i = 0; i < n; i++) {
+		e = &bootprof_log[i];
+		if (!e->valid)
+			continue;
+		smp_rmb();
+		t = e->start;
+		rem = do_div(t, NSEC_PER_SEC) / NSEC_PER_USEC;
+		seq_printf(m, "%7lu.%06lu %9u %3u %-5s ", (unsigned long)t,
+			   rem, e->usecs, e->cpu, bootprof_types[e->type]);
+		if (e->type == BOOTPROF_INITCALL)
+			seq_printf(m, "%pf\n", e->fn);
+		else
+			seq_printf(m, "%s\n", e->name);
+	}
+	seq_printf(m, "%s, %d lost\n", bootprof_stopped ? "stopped" :
+		   "recording", atomic_read(&bootprof_lost));
+	return 0;
+}
+
+static int bootprof_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bootprof_show, NULL);
+}
+
+static ssize_t bootprof_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	bootprof_mark("stop");
+	bootprof_stopped = 1;
+	return count;
+}
+
+static const struct file_operations bootprof_fops = {
+	.open		= bootprof_open,
+	.read		= seq_read,
+	.write		= bootprof_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init bootprof_init(void)
+{
+	proc_create("bootprof", S_IRUGO | S_IWUSR, NULL, &bootprof_fops);
+	return 0;
+}
+pure_initcall(bootprof_init);
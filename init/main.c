@@ -68,6 +68,9 @@
 #include <linux/shmem_fs.h>
 #include <linux/slab.h>
 #include <linux/perf_event.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+#include <linux/bootprof.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -608,12 +611,14 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 int __init_or_module do_one_initcall(initcall_t fn)
 {
 	int count = preempt_count();
+	unsigned long long start = bootprof_start();
 	int ret;
 
 	if (initcall_debug)
 		ret = do_one_initcall_debug(fn);
 	else
 		ret = fn();
+	bootprof_initcall(fn, start);
 
 	msgbuf[0] = 0;
 
@@ -714,6 +719,104 @@ static void __init do_pre_smp_initcalls(void)
 		do_one_initcall(*fn);
 }
 
+#ifdef CONFIG_DEFERRED_INITCALLS
+extern initcall_t __deferred_initcall_start[], __deferred_initcall_end[];
+
+/*
+ * deferred_initcall()s run once, from a work item, when the display
+ * first comes up, /proc/deferred_initcalls is read or
+ * deferred_initcall_timeout seconds after init was started, whichever
+ * comes first.  They live in init memory like the others, so freeing it
+ * waits for them.
+ */
+static unsigned int deferred_initcall_timeout = 30;
+core_param(deferred_initcall_timeout, deferred_initcall_timeout, uint, 0644);
+
+static DEFINE_MUTEX(deferred_initcall_mutex);
+static bool deferred_initcall_ready;
+static bool deferred_initcall_kicked;
+static bool deferred_initcall_done;
+
+static void __ref do_deferred_initcalls(struct work_struct *work)
+{
+	initcall_t *fn;
+
+	mutex_lock(&deferred_initcall_mutex);
+	if (deferred_initcall_done)
+		goto out;
+
+	bootprof_mark("deferred initcalls");
+	for (fn = __deferred_initcall_start; fn < __deferred_initcall_end; fn++)
+		do_one_initcall(*fn);
+	async_synchronize_full();
+	deferred_initcall_done = true;
+	bootprof_mark("deferred initcalls done");
+
+	free_initmem();
+out:
+	mutex_unlock(&deferred_initcall_mutex);
+}
+
+static DECLARE_WORK(deferred_initcall_work, do_deferred_initcalls);
+static DECLARE_DELAYED_WORK(deferred_initcall_timer, do_deferred_initcalls);
+
+void deferred_initcalls_kick(void)
+{
+	deferred_initcall_kicked = true;
+	smp_mb();
+	if (deferred_initcall_ready && !deferred_initcall_done)
+		queue_work(system_unbound_wq, &deferred_initcall_work);
+}
+EXPORT_SYMBOL(deferred_initcalls_kick);
+
+static bool deferred_initcalls_start(void)
+{
+	if (__deferred_initcall_start == __deferred_initcall_end)
+		return false;
+
+	deferred_initcall_ready = true;
+	smp_mb();
+	if (deferred_initcall_kicked)
+		queue_work(system_unbound_wq, &deferred_initcall_work);
+	queue_delayed_work(system_unbound_wq, &deferred_initcall_timer,
+			   deferred_initcall_timeout * HZ);
+	return true;
+}
+
+static int deferred_initcalls_show(struct seq_file *m, void *v)
+{
+	if (deferred_initcall_ready)
+		do_deferred_initcalls(NULL);
+	seq_printf(m, "%d\n", deferred_initcall_done);
+	return 0;
+}
+
+static int deferred_initcalls_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, deferred_initcalls_show, NULL);
+}
+
+static const struct file_operations deferred_initcalls_fops = {
+	.open		= deferred_initcalls_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init deferred_initcalls_init(void)
+{
+	proc_create("deferred_initcalls", S_IRUSR, NULL,
+		    &deferred_initcalls_fops);
+	return 0;
+}
+late_initcall(deferred_initcalls_init);
+#else
+static inline bool deferred_initcalls_start(void)
+{
+	return false;
+}
+#endif
+
 static void run_init_process(const char *init_filename)
 {
 	argv_init[0] = init_filename;
@@ -724,7 +827,9 @@ static noinline int init_post(void)
 {
 	
 	async_synchronize_full();
-	free_initmem();
+	bootprof_mark("init");
+	if (!deferred_initcalls_start())
+		free_initmem();
 	mark_rodata_ro();
 	system_state = SYSTEM_RUNNING;
 	numa_default_policy();
@@ -0,0 +1,108 @@
+/*
+ * Always-on contention counts for the locks in enum lsl_class
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/lockstat_lite.h>
+
+DEFINE_PER_CPU(struct lsl_stat, lsl_stats[LSL_NR]);
+EXPORT_PER_CPU_SYMBOL(lsl_stats);
+
+static const char * const lsl_names[LSL_NR] = {
+	[LSL_BINDER]		= "binder_main_lock",
+	[LSL_BINDER_ALLOC]	= "binder_alloc_lock",
+	[LSL_ASHMEM]		= "ashmem_area",
+	[LSL_ASHMEM_LRU]	= "ashmem_lru_lock",
+	[LSL_KGSL_DEVICE]	= "kgsl_device_mutex",
+	[LSL_ZRAM_SLOT]		= "zram_slot",
+	[LSL_ZRAM_COMP]		= "zram_comp_strm",
+	[LSL_ION_CLIENT]	= "ion_client_lock",
+	[LSL_MMC_CLAIM]		= "mmc_claim_host",
+};
+
+/* irqs off, an annotated lock may be taken from an irq on this cpu too */
+void lsl_contended(int cls, u64 start)
+{
+	u64 ns = sched_clock() - start;
+	struct lsl_stat *s;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	s = &__get_cpu_var(lsl_stats)[cls];
+	s->contended++;
+	s->wait_ns += ns;
+	if (ns > s->max_ns)
+		s->max_ns = ns;
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(lsl_contended);
+
+static int lsl_show(struct seq_file *m, void *v)
+{
+	struct lsl_stat *s;
+	unsigned long acquired, contended;
+	u64 wait_ns, max_ns;
+	int cls, cpu;
+
+	seq_printf(m, "%-20s %12s %10s %12s %10s  contended per cpu\n",
+		   "lock", "acquired", "contended", "wait_us", "max_us");
+	for (cls = 0; cls < LSL_NR; cls++) {
+		acquired = contended = 0;
+		wait_ns = max_ns = 0;
+		for_each_possible_cpu(cpu) {
+			s = &per_cpu(lsl_stats, cpu)[cls];
+			acquired += s->acquired;
+			contended += s->contended;
+			wait_ns += s->wait_ns;
+			max_ns = max(max_ns, s->max_ns);
+		}
+		seq_printf(m, "%-20s %12lu %10lu %12llu %10llu ",
+			   lsl_names[cls], acquired, contended,
+			   div_u64(wait_ns, NSEC_PER_USEC),
+			   div_u64(max_ns, NSEC_PER_USEC));
+		for_each_possible_cpu(cpu)
+			seq_printf(m, " %lu",
+				   per_cpu(lsl_stats, cpu)[cls].contended);
+		seq_putc(m, '\n');
+	}
+	return 0;
+}
+
+static int lsl_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lsl_show, NULL);
+}
+
+/* Not atomic against the lockers, a count racing with it may survive */
+static ssize_t lsl_write(struct file *file, const char __user *buf,
+			 size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(lsl_stats, cpu), 0,
+		       sizeof(per_cpu(lsl_stats, cpu)));
+	return count;
+}
+
+static const struct file_operations lsl_fops = {
+	.open		= lsl_open,
+	.read		= seq_read,
+	.write		= lsl_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init lsl_init(void)
+{
+	proc_create("lockstat_lite", S_IRUGO | S_IWUSR, NULL, &lsl_fops);
+	return 0;
+}
+module_init(lsl_init);
@@ -0,0 +1,621 @@
+/*
+ * Microbenchmarks for MSM hot paths
+ *
+ * Each benchmark times one operation (an ION or KGSL allocation, a zram
+ * compressor call, a hash of a page, an SMD loopback round trip) for a
+ * fixed number of iterations and keeps the distribution.  Writing a
+ * benchmark name, or "all", to microbench/run in debugfs runs it;
+ * microbench/results shows the last result of every benchmark as
+ * min/p50/p90/p99/max in ns, so builds can be compared by a script.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/completion.h>
+#include <linux/scatterlist.h>
+#include <linux/crypto.h>
+#include <crypto/hash.h>
+#include <linux/ion.h>
+#include <mach/msm_smd.h>
+#include <mach/msm_smsm.h>
+#include <asm/sizes.h>
+
+/* KGSL can only be called from here if it is built in, or if both are modules */
+#if defined(CONFIG_MSM_KGSL) || \
+	(defined(MODULE) && defined(CONFIG_MSM_KGSL_MODULE))
+#define MICROBENCH_KGSL
+#include "kgsl.h"
+#include "kgsl_sharedmem.h"
+#endif
+
+static unsigned int iterations = 1000;
+module_param(iterations, uint, 0644);
+MODULE_PARM_DESC(iterations, "Timed iterations per benchmark");
+static unsigned int warmup = 16;
+module_param(warmup, uint, 0644);
+MODULE_PARM_DESC(warmup, "Untimed iterations before each benchmark");
+static char *crypto_alg = "sha256";
+module_param(crypto_alg, charp, 0644);
+MODULE_PARM_DESC(crypto_alg, "Hash or driver name timed by crypto-custom");
+
+struct microbench {
+	const char *name;
+	int (*setup)(struct microbench *mb);
+	int (*run)(struct microbench *mb);
+	void (*teardown)(struct microbench *mb);
+	size_t size;		/* Bytes per operation */
+	unsigned int heap;	/* ION heap id */
+	const char *alg;
+	void *priv;
+
+	/* Last result */
+	int err;
+	unsigned int runs;
+	u32 min, p50, p90, p99, max;
+};
+
+static DEFINE_MUTEX(microbench_lock);
+static u32 *samples;
+
+/* A page that compresses about as well as an application heap page */
+static void microbench_fill(u8 *p, size_t len)
+{
+	static const char words[] =
+		"binder ion kgsl zram smd surfaceflinger dalvik heap ";
+	u32 seed = 0x2545f491;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		if ((i / 64) % 4 == 3)
+			p[i] = seed >> 24;
+		else if ((i / 64) % 4 == 2)
+			p[i] = 0;
+		else
+			p[i] = words[(i * 5 + i / 37) % (sizeof(words) - 1)];
+	}
+}
+
+/* ION */
+
+struct microbench_ion {
+	struct ion_client *client;
+};
+
+static int ion_setup(struct microbench *mb)
+{
+	struct microbench_ion *ion;
+
+	ion = kzalloc(sizeof(*ion), GFP_KERNEL);
+	if (!ion)
+		return -ENOMEM;
+
+	ion->client = msm_ion_client_create(UINT_MAX, "microbench");
+	if (IS_ERR_OR_NULL(ion->client)) {
+		kfree(ion);
+		return -ENODEV;
+	}
+
+	mb->priv = ion;
+	return 0;
+}
+
+static int ion_run(struct microbench *mb)
+{
+	struct microbench_ion *ion = mb->priv;
+	struct ion_handle *handle;
+
+	handle = ion_alloc(ion->client, mb->size, SZ_4K, ION_HEAP(mb->heap));
+	if (IS_ERR_OR_NULL(handle))
+		return handle ? PTR_ERR(handle) : -ENOMEM;
+
+	ion_free(ion->client, handle);
+	return 0;
+}
+
+static void ion_teardown(struct microbench *mb)
+{
+	struct microbench_ion *ion = mb->priv;
+
+	ion_client_destroy(ion->client);
+	kfree(ion);
+}
+
+/* KGSL */
+
+#ifdef MICROBENCH_KGSL
+static int kgsl_run(struct microbench *mb)
+{
+	struct kgsl_memdesc memdesc;
+	int ret;
+
+	memset(&memdesc, 0, sizeof(memdesc));
+	ret = kgsl_sharedmem_page_alloc(&memdesc, NULL, mb->size);
+	if (ret)
+		return ret;
+
+	kgsl_sharedmem_free(&memdesc);
+	return 0;
+}
+#else
+static int kgsl_run(struct microbench *mb)
+{
+	return -ENODEV;
+}
+#endif
+
+/* zram compressors, through the same crypto_comp calls zram makes */
+
+struct microbench_comp {
+	struct crypto_comp *tfm;
+	u8 *src;
+	u8 *cmp;
+	u8 *dst;
+	unsigned int cmp_len;
+	bool decompress;
+};
+
+static int comp_setup(struct microbench *mb)
+{
+	struct microbench_comp *comp;
+	int ret = -ENOMEM;
+
+	comp = kzalloc(sizeof(*comp), GFP_KERNEL);
+	if (!comp)
+		return -ENOMEM;
+
+	comp->decompress = strstr(mb->name, "-decompress") != NULL;
+	comp->src = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	comp->cmp = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	comp->dst = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!comp->src || !comp->cmp || !comp->dst)
+		goto err;
+
+	comp->tfm = crypto_alloc_comp(mb->alg, 0, 0);
+	if (IS_ERR(comp->tfm)) {
+		ret = PTR_ERR(comp->tfm);
+		goto err;
+	}
+
+	microbench_fill(comp->src, PAGE_SIZE);
+	comp->cmp_len = 2 * PAGE_SIZE;
+	ret = crypto_comp_compress(comp->tfm, comp->src, PAGE_SIZE,
+				   comp->cmp, &comp->cmp_len);
+	if (ret) {
+		crypto_free_comp(comp->tfm);
+		goto err;
+	}
+
+	mb->priv = comp;
+	return 0;
+err:
+	kfree(comp->dst);
+	kfree(comp->cmp);
+	kfree(comp->src);
+	kfree(comp);
+	return ret;
+}
+
+static int comp_run(struct microbench *mb)
+{
+	struct microbench_comp *comp = mb->priv;
+	unsigned int len;
+
+	if (comp->decompress) {
+		len = PAGE_SIZE;
+		return crypto_comp_decompress(comp->tfm, comp->cmp,
+					      comp->cmp_len, comp->dst, &len);
+	}
+
+	len = 2 * PAGE_SIZE;
+	return crypto_comp_compress(comp->tfm, comp->src, PAGE_SIZE,
+				    comp->cmp, &len);
+}
+
+static void comp_teardown(struct microbench *mb)
+{
+	struct microbench_comp *comp = mb->priv;
+
+	crypto_free_comp(comp->tfm);
+	kfree(comp->dst);
+	kfree(comp->cmp);
+	kfree(comp->src);
+	kfree(comp);
+}
+
+/* Crypto hash throughput, by algorithm or driver name */
+
+struct microbench_hash {
+	struct crypto_ahash *tfm;
+	struct ahash_request *req;
+	struct completion done;
+	int err;
+	struct scatterlist sg;
+	u8 *buf;
+	u8 digest[64];
+};
+
+static void hash_done(struct crypto_async_request *req, int err)
+{
+	struct microbench_hash *hash = req->data;
+
+	if (err == -EINPROGRESS)
+		return;
+	hash->err = err;
+	complete(&hash->done);
+}
+
+static int hash_setup(struct microbench *mb)
+{
+	struct microbench_hash *hash;
+	const char *alg = mb->alg ?: crypto_alg;
+	int ret = -ENOMEM;
+
+	hash = kzalloc(sizeof(*hash), GFP_KERNEL);
+	if (!hash)
+		return -ENOMEM;
+
+	hash->buf = kmalloc(mb->size, GFP_KERNEL);
+	if (!hash->buf)
+		goto err;
+
+	hash->tfm = crypto_alloc_ahash(alg, 0, 0);
+	if (IS_ERR(hash->tfm)) {
+		ret = PTR_ERR(hash->tfm);
+		goto err;
+	}
+
+	if (crypto_ahash_digestsize(hash->tfm) > sizeof(hash->digest)) {
+		ret = -EINVAL;
+		goto err_tfm;
+	}
+
+	hash->req = ahash_request_alloc(hash->tfm, GFP_KERNEL);
+	if (!hash->req)
+		goto err_tfm;
+
+	init_completion(&hash->done);
+	ahash_request_set_callback(hash->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   hash_done, hash);
+	microbench_fill(hash->buf, mb->size);
+	sg_init_one(&hash->sg, hash->buf, mb->size);
+	ahash_request_set_crypt(hash->req, &hash->sg, hash->digest, mb->size);
+
+	mb->priv = hash;
+	return 0;
+err_tfm:
+	crypto_free_ahash(hash->tfm);
+err:
+	kfree(hash->buf);
+	kfree(hash);
+	return ret;
+}
+
+static int hash_run(struct microbench *mb)
+{
+	struct microbench_hash *hash = mb->priv;
+	int ret;
+
+	ret = crypto_ahash_digest(hash->req);
+	if (ret == -EINPROGRESS || ret == -EBUSY) {
+		wait_for_completion(&hash->done);
+		INIT_COMPLETION(hash->done);
+		ret = hash->err;
+	}
+	return ret;
+}
+
+static void hash_teardown(struct microbench *mb)
+{
+	struct microbench_hash *hash = mb->priv;
+
+	ahash_request_free(hash->req);
+	crypto_free_ahash(hash->tfm);
+	kfree(hash->buf);
+	kfree(hash);
+}
+
+/* SMD loopback round trip to the modem */
+
+struct microbench_smd {
+	smd_channel_t *ch;
+	struct completion opened;
+	struct completion data;
+	u8 *buf;
+};
+
+static void smd_bench_notify(void *priv, unsigned event)
+{
+	struct microbench_smd *smd = priv;
+
+	if (event == SMD_EVENT_OPEN)
+		complete(&smd->opened);
+	else if (event == SMD_EVENT_DATA && smd_read_avail(smd->ch) > 0)
+		complete(&smd->data);
+}
+
+static int smd_setup(struct microbench *mb)
+{
+	struct microbench_smd *smd;
+	int ret;
+
+	smd = kzalloc(sizeof(*smd), GFP_KERNEL);
+	if (!smd)
+		return -ENOMEM;
+
+	smd->buf = kmalloc(mb->size, GFP_KERNEL);
+	if (!smd->buf) {
+		kfree(smd);
+		return -ENOMEM;
+	}
+	init_completion(&smd->opened);
+	init_completion(&smd->data);
+	microbench_fill(smd->buf, mb->size);
+
+	/* The modem only echoes once it is told to run the loopback server */
+	smsm_change_state(SMSM_APPS_STATE, 0, SMSM_SMD_LOOPBACK);
+
+	ret = smd_open("LOOPBACK", &smd->ch, smd, smd_bench_notify);
+	if (!ret && !wait_for_completion_timeout(&smd->opened, HZ)) {
+		smd_close(smd->ch);
+		ret = -ETIMEDOUT;
+	}
+	if (ret) {
+		kfree(smd->buf);
+		kfree(smd);
+		return ret;
+	}
+
+	mb->priv = smd;
+	return 0;
+}
+
+static int smd_run(struct microbench *mb)
+{
+	struct microbench_smd *smd = mb->priv;
+	int len = mb->size;
+
+	INIT_COMPLETION(smd->data);
+	if (smd_write(smd->ch, smd->buf, len) != len)
+		return -EIO;
+
+	while (len > 0) {
+		int avail = smd_read_avail(smd->ch);
+
+		if (avail <= 0) {
+			if (!wait_for_completion_timeout(&smd->data, HZ))
+				return -ETIMEDOUT;
+			INIT_COMPLETION(smd->data);
+			continue;
+		}
+		len -= smd_read(smd->ch, smd->buf, min(avail, len));
+	}
+	return 0;
+}
+
+static void smd_teardown(struct microbench *mb)
+{
+	struct microbench_smd *smd = mb->priv;
+
+	smd_close(smd->ch);
+	kfree(smd->buf);
+	kfree(smd);
+}
+
+#define ION_BENCH(_heap, _id, _size, _sname)				\
+	{ .name = "ion-" _heap "-" _sname, .setup = ion_setup,		\
+	  .run = ion_run, .teardown = ion_teardown,			\
+	  .size = _size, .heap = _id }
+#define KGSL_BENCH(_size, _sname)					\
+	{ .name = "kgsl-alloc-" _sname, .run = kgsl_run, .size = _size }
+#define COMP_BENCH(_alg, _op)						\
+	{ .name = "zram-" _alg "-" _op, .setup = comp_setup,		\
+	  .run = comp_run, .teardown = comp_teardown,			\
+	  .size = PAGE_SIZE, .alg = _alg }
+#define HASH_BENCH(_name, _alg)						\
+	{ .name = "crypto-" _name, .setup = hash_setup,		\
+	  .run = hash_run, .teardown = hash_teardown,			\
+	  .size = PAGE_SIZE, .alg = _alg }
+
+static struct microbench benches[] = {
+	ION_BENCH("system", ION_SYSTEM_HEAP_ID, SZ_4K, "4k"),
+	ION_BENCH("system", ION_SYSTEM_HEAP_ID, SZ_64K, "64k"),
+	ION_BENCH("system", ION_SYSTEM_HEAP_ID, SZ_1M, "1m"),
+	ION_BENCH("iommu", ION_IOMMU_HEAP_ID, SZ_4K, "4k"),
+	ION_BENCH("iommu", ION_IOMMU_HEAP_ID, SZ_64K, "64k"),
+	ION_BENCH("iommu", ION_IOMMU_HEAP_ID, SZ_1M, "1m"),
+	KGSL_BENCH(SZ_8K, "8k"),
+	KGSL_BENCH(SZ_64K, "64k"),
+	KGSL_BENCH(SZ_1M, "1m"),
+	COMP_BENCH("lzo", "compress"),
+	COMP_BENCH("lzo", "decompress"),
+	COMP_BENCH("lz4", "compress"),
+	COMP_BENCH("lz4", "decompress"),
+	HASH_BENCH("sha1", "sha1"),
+	HASH_BENCH("sha256", "sha256"),
+	HASH_BENCH("custom", NULL),
+	{ .name = "smd-loopback-64", .setup = smd_setup, .run = smd_run,
+	  .teardown = smd_teardown, .size = 64 },
+};
+
+static int microbench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 microbench_pct(unsigned int n, unsigned int pct)
+{
+	return samples[min(n - 1, n * pct / 100)];
+}
+
+static void microbench_run(struct microbench *mb, unsigned int n)
+{
+	ktime_t start;
+	s64 ns;
+	unsigned int i;
+	int ret = 0;
+
+	mb->runs = 0;
+	mb->err = 0;
+	mb->priv = NULL;
+
+	if (mb->setup) {
+		ret = mb->setup(mb);
+		if (ret)
+			goto out;
+	}
+
+	for (i = 0; i < warmup && !ret; i++)
+		ret = mb->run(mb);
+
+	for (i = 0; i < n && !ret; i++) {
+		start = ktime_get();
+		ret = mb->run(mb);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		samples[i] = min_t(s64, ns, UINT_MAX);
+		cond_resched();
+	}
+
+	if (mb->teardown)
+		mb->teardown(mb);
+	if (ret)
+		goto out;
+
+	sort(samples, n, sizeof(*samples), microbench_cmp, NULL);
+	mb->runs = n;
+	mb->min = samples[0];
+	mb->p50 = microbench_pct(n, 50);
+	mb->p90 = microbench_pct(n, 90);
+	mb->p99 = microbench_pct(n, 99);
+	mb->max = samples[n - 1];
+out:
+	mb->err = ret;
+	if (ret)
+		pr_info("microbench: %s failed, %d\n", mb->name, ret);
+}
+
+static ssize_t microbench_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	char name[32], *s;
+	unsigned int n;
+	size_t len = min(count, sizeof(name) - 1);
+	bool all;
+	int i, found = 0;
+
+	if (copy_from_user(name, buf, len))
+		return -EFAULT;
+	name[len] = '\0';
+	s = strim(name);
+	all = !strcmp(s, "all");
+
+	n = max(iterations, 1U);
+	mutex_lock(&microbench_lock);
+	samples = vmalloc(n * sizeof(*samples));
+	if (!samples) {
+		mutex_unlock(&microbench_lock);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		if (!all && strcmp(s, benches[i].name))
+			continue;
+		microbench_run(&benches[i], n);
+		found = 1;
+	}
+
+	vfree(samples);
+	samples = NULL;
+	mutex_unlock(&microbench_lock);
+
+	return found ? count : -EINVAL;
+}
+
+static const struct file_operations microbench_run_fops = {
+	.owner	= THIS_MODULE,
+	.open	= nonseekable_open,
+	.write	= microbench_write,
+	.llseek	= no_llseek,
+};
+
+static int microbench_show(struct seq_file *m, void *v)
+{
+	struct microbench *mb;
+	int i;
+
+	seq_printf(m, "%-24s %6s %10s %10s %10s %10s %10s %8s\n", "name",
+		   "runs", "min", "p50", "p90", "p99", "max", "MB/s");
+
+	mutex_lock(&microbench_lock);
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		mb = &benches[i];
+		if (mb->err) {
+			seq_printf(m, "%-24s error %d\n", mb->name, mb->err);
+			continue;
+		}
+		if (!mb->runs) {
+			seq_printf(m, "%-24s -\n", mb->name);
+			continue;
+		}
+		seq_printf(m, "%-24s %6u %10u %10u %10u %10u %10u %8u\n",
+			   mb->name, mb->runs, mb->min, mb->p50, mb->p90,
+			   mb->p99, mb->max, mb->p50 ?
+			   (u32)div_u64((u64)mb->size * 1000, mb->p50) : 0);
+	}
+	mutex_unlock(&microbench_lock);
+	return 0;
+}
+
+static int microbench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, microbench_show, NULL);
+}
+
+static const struct file_operations microbench_results_fops = {
+	.owner		= THIS_MODULE,
+	.open		= microbench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct dentry *microbench_dir;
+
+static int __init microbench_init(void)
+{
+	microbench_dir = debugfs_create_dir("microbench", NULL);
+	if (IS_ERR_OR_NULL(microbench_dir))
+		return -ENODEV;
+
+	debugfs_create_file("run", S_IWUSR, microbench_dir, NULL,
+			    &microbench_run_fops);
+	debugfs_create_file("results", S_IRUGO, microbench_dir, NULL,
+			    &microbench_results_fops);
+	return 0;
+}
+module_init(microbench_init);
+
+static void __exit microbench_exit(void)
+{
+	debugfs_remove_recursive(microbench_dir);
+}
+module_exit(microbench_exit);
+
+MODULE_DESCRIPTION("Microbenchmarks for MSM hot paths");
+MODULE_LICENSE("GPL v2");
@@ -43,6 +43,14 @@ static int debug_mask = DEBUG_USER_STATE;
 
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Handlers of one level have no ordering between them, so on late resume
+ * they are run concurrently and each level waits for the one above it.
+ */
+static bool parallel_resume = true;
+module_param(parallel_resume, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+static struct workqueue_struct *late_resume_wq;
+
 static DEFINE_MUTEX(early_suspend_lock);
 static LIST_HEAD(early_suspend_handlers);
 static void early_suspend(struct work_struct *work);
@@ -115,6 +123,47 @@ static void __ref boost_cpu_speed(int boost)
 static void boost_cpu_speed(int boost) { return; }
 #endif
 
+#define EARLY_SUSPEND_TIMEOUT_VALUE 5
+static void early_suspend_handlers_timeout(unsigned long data)
+{
+	printk(KERN_EMERG "**** early_suspend_handlers %d secs timeout: %pf ****\n", \
+		EARLY_SUSPEND_TIMEOUT_VALUE, (void *)data);
+	pr_info("### Show Blocked State in ###\n");
+	show_state_filter(TASK_UNINTERRUPTIBLE);
+	BUG();
+}
+
+static void early_suspend_call(void (*fn)(struct early_suspend *),
+			       struct early_suspend *h)
+{
+	struct timer_list timer;
+	ktime_t start;
+
+	setup_timer_on_stack(&timer, early_suspend_handlers_timeout,
+			     (unsigned long)fn);
+	mod_timer(&timer, jiffies + HZ * EARLY_SUSPEND_TIMEOUT_VALUE);
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("calling %pf\n", fn);
+
+	start = ktime_get();
+	fn(h);
+	del_timer_sync(&timer);
+	destroy_timer_on_stack(&timer);
+
+	if (debug_mask & DEBUG_VERBOSE)
+		pr_info("%pf took %lld usecs\n", fn,
+			ktime_to_us(ktime_sub(ktime_get(), start)));
+}
+
+static void late_resume_handler(struct work_struct *work)
+{
+	struct early_suspend *h =
+		container_of(work, struct early_suspend, resume_work);
+
+	early_suspend_call(h->resume, h);
+}
+
 void register_early_suspend(struct early_suspend *handler)
 {
 	struct list_head *pos;
@@ -127,6 +176,7 @@ void register_early_suspend(struct early_suspend *handler)
 			break;
 	}
 	list_add_tail(&handler->link, pos);
+	INIT_WORK(&handler->resume_work, late_resume_handler);
 	if ((state & SUSPENDED) && handler->suspend)
 		handler->suspend(handler);
 	mutex_unlock(&early_suspend_lock);
@@ -141,20 +191,9 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
-#define EARLY_SUSPEND_TIMEOUT_VALUE 5
-static void early_suspend_handlers_timeout(unsigned long data)
-{
-	printk(KERN_EMERG "**** early_suspend_handlers %d secs timeout: %pf ****\n", \
-		EARLY_SUSPEND_TIMEOUT_VALUE, (void *)data);
-	pr_info("### Show Blocked State in ###\n");
-	show_state_filter(TASK_UNINTERRUPTIBLE);
-	BUG();
-}
-
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
-	struct timer_list timer;
 	unsigned long irqflags;
 	int abort = 0;
 
@@ -180,26 +219,13 @@ static void early_suspend(struct work_struct *work)
 
 	boost_cpu_speed(1);
 
-	init_timer_on_stack(&timer);
-	timer.function = early_suspend_handlers_timeout;
-
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			timer.expires = jiffies + HZ * EARLY_SUSPEND_TIMEOUT_VALUE;
-			timer.data = (unsigned long)pos->suspend;
-			add_timer(&timer);
-
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("early_suspend: calling %pf\n", pos->suspend);
-
-			pos->suspend(pos);
-			del_timer_sync(&timer);
-		}
+		if (pos->suspend != NULL)
+			early_suspend_call(pos->suspend, pos);
 	}
 
-	destroy_timer_on_stack(&timer);
 	boost_cpu_speed(0);
 	mutex_unlock(&early_suspend_lock);
 
@@ -224,9 +250,10 @@ abort:
 static void late_resume(struct work_struct *work)
 {
 	struct early_suspend *pos;
-	struct timer_list timer;
 	unsigned long irqflags;
 	int abort = 0;
+	int level;
+	ktime_t start;
 
 	pr_info("[R] late_resume start\n");
 	mutex_lock(&early_suspend_lock);
@@ -248,30 +275,32 @@ static void late_resume(struct work_struct *work)
 	}
 
 	boost_cpu_speed(1);
-	init_timer_on_stack(&timer);
-	timer.function = early_suspend_handlers_timeout;
 
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	start = ktime_get();
+	level = INT_MAX;
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
-		if (pos->resume != NULL) {
-			timer.expires = jiffies + HZ * EARLY_SUSPEND_TIMEOUT_VALUE;
-			timer.data = (unsigned long)pos->suspend;
-			add_timer(&timer);
-
-			if (debug_mask & DEBUG_VERBOSE)
-				pr_info("late_resume: calling %pf\n", pos->resume);
-
-			pos->resume(pos);
-			del_timer_sync(&timer);
+		if (pos->resume == NULL)
+			continue;
+		if (!parallel_resume || !late_resume_wq) {
+			early_suspend_call(pos->resume, pos);
+			continue;
+		}
+		if (pos->level != level) {
+			flush_workqueue(late_resume_wq);
+			level = pos->level;
 		}
+		queue_work(late_resume_wq, &pos->resume_work);
 	}
+	if (late_resume_wq)
+		flush_workqueue(late_resume_wq);
 
-	destroy_timer_on_stack(&timer);
 	boost_cpu_speed(0);
 
 	if (debug_mask & DEBUG_SUSPEND)
-		pr_info("late_resume: done\n");
+		pr_info("late_resume: done after %lld usecs\n",
+			ktime_to_us(ktime_sub(ktime_get(), start)));
 
 	if (debug_mask & DEBUG_NO_SUSPEND)
 		wake_unlock(&no_suspend_wake_lock);
@@ -450,3 +479,13 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+static int __init early_suspend_init(void)
+{
+	late_resume_wq = alloc_workqueue("late_resume", WQ_HIGHPRI | WQ_UNBOUND,
+					 0);
+	if (!late_resume_wq)
+		pr_err("early_suspend: no late_resume workqueue, resuming serially\n");
+	return 0;
+}
+core_initcall(early_suspend_init);
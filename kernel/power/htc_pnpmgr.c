@@ -80,8 +80,13 @@ static void null_cb(const char *attr) {
 	do { } while (0);
 }
 
+static void activity_cb(const char *attr)
+{
+	pnp_policy_activity(activity_buf);
+}
+
 define_string_show(activity_trigger, activity_buf);
-define_string_store(activity_trigger, activity_buf, null_cb);
+define_string_store(activity_trigger, activity_buf, activity_cb);
 power_attr(activity_trigger);
 
 define_string_show(non_activity_trigger, non_activity_buf);
@@ -124,8 +129,13 @@ power_attr(thermal_c3);
 #endif
 #endif
 
+static void thermal_final_cb(const char *attr)
+{
+	pnp_policy_thermal_final(thermal_final_value);
+}
+
 define_int_show(thermal_final, thermal_final_value);
-define_int_store(thermal_final, thermal_final_value, null_cb);
+define_int_store(thermal_final, thermal_final_value, thermal_final_cb);
 power_attr(thermal_final);
 
 define_int_show(thermal_g0, thermal_g0_value);
@@ -301,6 +311,7 @@ int pnpmgr_battery_charging_enabled(int charging_enabled)
 	pr_debug("%s: result = %d\n", __func__, charging_enabled);
 	if (charging_enabled_value != charging_enabled) {
 		charging_enabled_value = charging_enabled;
+		pnp_policy_charging(charging_enabled);
 		sysfs_notify(battery_kobj, NULL, "charging_enabled");
 	}
 
@@ -368,10 +379,12 @@ app_timeout_store(struct kobject *kobj, struct kobj_attribute *attr,
 		if (val == 0) {
 			del_timer_sync(&app_timer);
 			app_timeout_expired = 0;
+			pnp_policy_app_idle(false);
 			sysfs_notify(apps_kobj, NULL, "app_timeout");
 		}
 		else {
 			del_timer_sync(&app_timer);
+			pnp_policy_app_idle(false);
 			app_timer.expires = jiffies + HZ * val;
 			app_timer.data = 0;
 			add_timer(&app_timer);
@@ -496,6 +509,7 @@ static struct attribute_group adaptive_attr_group = {
 static void app_timeout_handler(unsigned long data)
 {
 	app_timeout_expired = 1;
+	pnp_policy_app_idle(true);
 	sysfs_notify(apps_kobj, NULL, "app_timeout");
 }
 
@@ -539,6 +553,10 @@ static int __init pnpmgr_init(void)
 		return ret;
 	}
 
+	ret = pnp_policy_init(pnpmgr_kobj);
+	if (ret)
+		return ret;
+
 #ifdef CONFIG_HOTPLUG_CPU
 	register_hotcpu_notifier(&cpu_hotplug_notifier);
 #endif
@@ -0,0 +1,572 @@
+/* linux/kernel/power/htc_pnpmgr_policy.c
+ *
+ * Copyright (C) 2014 HTC Corporation.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/input.h>
+#include <linux/notifier.h>
+#include <linux/sched.h>
+#include <linux/msm_thermal.h>
+#include <linux/htc_pnpmgr.h>
+#include <mach/perflock.h>
+
+#include "power.h"
+
+/*
+ * The pnpmgr daemon reads the relays under /sys/power/pnpmgr and answers
+ * through perflock, a userspace round trip for every decision.  This picks
+ * the answer in the kernel from the same inputs:
+ *
+ *  - the foreground activity selects a profile by name, "default" when
+ *    none matches and "idle" once app_timeout has expired
+ *  - a profile is a cpufreq floor and ceiling (perflock levels), a minimum
+ *    number of cores, a GPU pwrlevel cap and a touch boost
+ *  - the floor and the cores only hold while the run queue has work
+ *  - thermal mitigation, or a low battery that isn't charging, drops the
+ *    boosts but keeps the ceiling and the GPU cap
+ *
+ * Userspace writes the profiles once to policy/profiles, one per line:
+ *
+ *   <name> <floor> <ceiling> <cores> <gpu> <touch_level> <touch_ms>
+ *
+ * A floor, ceiling or touch_level of -1 and cores or gpu of 0 is none.
+ */
+
+#define PNP_MAX_PROFILES	16
+#define PNP_NAME_LEN		64
+#define PNP_NONE		-1
+/* thermal_final while the thermal engine isn't limiting */
+#define PNP_THERMAL_NONE	9999999
+
+struct pnp_profile {
+	char name[PNP_NAME_LEN];
+	int floor;
+	int ceiling;
+	int cores;
+	int gpu;
+	int touch_level;
+	unsigned int touch_ms;
+};
+
+static struct pnp_profile *profiles;
+static int nr_profiles;
+static struct pnp_profile *active_profile;
+static DEFINE_MUTEX(policy_mutex);
+
+/* The inputs, set from timer and notifier context */
+static DEFINE_SPINLOCK(input_lock);
+static char activity[PNP_NAME_LEN];
+static bool app_idle;
+static bool thermal_final_limited;
+static unsigned long thermal_level;
+static int battery_level = 100;
+static bool charging;
+
+/* Touch boost of the active profile, PNP_NONE while boosts are dropped */
+static int touch_level = PNP_NONE;
+static unsigned int touch_ms;
+static unsigned long touch_end;
+
+static unsigned int enabled = 1;
+/* Below this level and not charging, boosts are dropped */
+static unsigned int low_battery = 15;
+/* Run queue average, in tenths of a task, below which the floor drops */
+static unsigned int busy_rq_avg = 10;
+static unsigned int sample_ms = 200;
+static unsigned int rq_avg;
+
+static struct perf_lock floor_locks[PERF_LOCK_INVALID];
+static struct perf_lock ceiling_locks[PERF_LOCK_INVALID];
+static struct perf_lock touch_locks[PERF_LOCK_INVALID];
+static struct perf_lock cores_locks[NR_CPUS + 1];
+static int floor_held = PNP_NONE;
+static int ceiling_held = PNP_NONE;
+static int cores_held = PNP_NONE;
+static int gpu_level;
+
+static BLOCKING_NOTIFIER_HEAD(gpu_notifier);
+
+static void policy_evaluate(struct work_struct *work);
+static DECLARE_WORK(evaluate_work, policy_evaluate);
+static DECLARE_DEFERRED_WORK(sample_work, policy_evaluate);
+static void policy_touch_boost(struct work_struct *work);
+static DECLARE_WORK(touch_work, policy_touch_boost);
+
+static struct pnp_profile *find_profile(const char *name)
+{
+	int i;
+
+	for (i = 0; i < nr_profiles; i++)
+		if (!strcmp(profiles[i].name, name))
+			return &profiles[i];
+
+	return NULL;
+}
+
+/* Take the new lock before dropping the old one so the level never dips */
+static void pnp_hold(struct perf_lock *locks, int *held, int want)
+{
+	if (*held == want)
+		return;
+	if (want != PNP_NONE)
+		perf_lock(&locks[want]);
+	if (*held != PNP_NONE)
+		perf_unlock(&locks[*held]);
+	*held = want;
+}
+
+/* An average of nr_running over the last few samples, like rq_avg */
+static bool policy_rq_busy(void)
+{
+	rq_avg = (rq_avg * 3 + nr_running() * 10) / 4;
+
+	return rq_avg >= busy_rq_avg;
+}
+
+static void policy_evaluate(struct work_struct *work)
+{
+	struct pnp_profile *prof = NULL;
+	char name[PNP_NAME_LEN];
+	int floor, ceiling, cores, gpu;
+	unsigned long flags;
+	bool idle, boost;
+
+	spin_lock_irqsave(&input_lock, flags);
+	strlcpy(name, activity, sizeof(name));
+	idle = app_idle;
+	boost = !thermal_level && !thermal_final_limited &&
+		(charging || battery_level >= low_battery);
+	spin_unlock_irqrestore(&input_lock, flags);
+
+	mutex_lock(&policy_mutex);
+
+	if (enabled) {
+		if (idle)
+			prof = find_profile("idle");
+		if (!prof)
+			prof = find_profile(name);
+		if (!prof)
+			prof = find_profile("default");
+	}
+	active_profile = prof;
+
+	floor = prof ? prof->floor : PNP_NONE;
+	ceiling = prof ? prof->ceiling : PNP_NONE;
+	cores = prof && prof->cores ? min(prof->cores, NR_CPUS) : PNP_NONE;
+	gpu = prof ? prof->gpu : 0;
+
+	if (!boost) {
+		floor = PNP_NONE;
+		cores = PNP_NONE;
+	}
+
+	/* Keep sampling the run queue while a floor is wanted */
+	if (floor != PNP_NONE || cores != PNP_NONE) {
+		if (!policy_rq_busy()) {
+			floor = PNP_NONE;
+			cores = PNP_NONE;
+		}
+		schedule_delayed_work(&sample_work,
+				      msecs_to_jiffies(sample_ms));
+	} else {
+		rq_avg = 0;
+	}
+
+	pnp_hold(floor_locks, &floor_held, floor);
+	pnp_hold(ceiling_locks, &ceiling_held, ceiling);
+	pnp_hold(cores_locks, &cores_held, cores);
+
+	if (gpu != gpu_level) {
+		gpu_level = gpu;
+		blocking_notifier_call_chain(&gpu_notifier, gpu, NULL);
+	}
+
+	spin_lock_irqsave(&input_lock, flags);
+	touch_level = prof && boost ? prof->touch_level : PNP_NONE;
+	touch_ms = prof ? prof->touch_ms : 0;
+	spin_unlock_irqrestore(&input_lock, flags);
+
+	mutex_unlock(&policy_mutex);
+}
+
+static void policy_kick(void)
+{
+	schedule_work(&evaluate_work);
+}
+
+void pnp_policy_activity(const char *name)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&input_lock, flags);
+	strlcpy(activity, name, sizeof(activity));
+	strim(activity);
+	spin_unlock_irqrestore(&input_lock, flags);
+	policy_kick();
+}
+
+void pnp_policy_app_idle(bool idle)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&input_lock, flags);
+	if (app_idle == idle) {
+		spin_unlock_irqrestore(&input_lock, flags);
+		return;
+	}
+	app_idle = idle;
+	spin_unlock_irqrestore(&input_lock, flags);
+	policy_kick();
+}
+
+void pnp_policy_thermal_final(int value)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&input_lock, flags);
+	thermal_final_limited = value < PNP_THERMAL_NONE;
+	spin_unlock_irqrestore(&input_lock, flags);
+	policy_kick();
+}
+
+void pnp_policy_charging(int charging_enabled)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&input_lock, flags);
+	charging = !!charging_enabled;
+	spin_unlock_irqrestore(&input_lock, flags);
+	policy_kick();
+}
+
+void pnpmgr_battery_level(int level)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&input_lock, flags);
+	if (battery_level == level) {
+		spin_unlock_irqrestore(&input_lock, flags);
+		return;
+	}
+	battery_level = level;
+	spin_unlock_irqrestore(&input_lock, flags);
+	policy_kick();
+}
+
+int pnpmgr_register_gpu_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&gpu_notifier, nb);
+}
+EXPORT_SYMBOL(pnpmgr_register_gpu_notifier);
+
+int pnpmgr_unregister_gpu_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&gpu_notifier, nb);
+}
+EXPORT_SYMBOL(pnpmgr_unregister_gpu_notifier);
+
+static int policy_thermal_notify(struct notifier_block *nb,
+				 unsigned long level, void *data)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&input_lock, flags);
+	thermal_level = level;
+	spin_unlock_irqrestore(&input_lock, flags);
+	policy_kick();
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block policy_thermal_nb = {
+	.notifier_call = policy_thermal_notify,
+};
+
+/* perflock notifies pnpmgr through sysfs, which can't be done from here */
+static void policy_touch_boost(struct work_struct *work)
+{
+	unsigned long flags, timeout;
+	int level;
+
+	spin_lock_irqsave(&input_lock, flags);
+	level = touch_level;
+	timeout = msecs_to_jiffies(touch_ms);
+	spin_unlock_irqrestore(&input_lock, flags);
+
+	if (level != PNP_NONE && timeout)
+		perf_lock_timeout(&touch_locks[level], timeout);
+}
+
+static void policy_input_event(struct input_handle *handle,
+			       unsigned int type, unsigned int code, int value)
+{
+	unsigned long flags;
+	bool boost = false;
+
+	if (type != EV_SYN || code != SYN_REPORT)
+		return;
+
+	/* A gesture reports every few ms, only boost again halfway through */
+	spin_lock_irqsave(&input_lock, flags);
+	if (touch_level != PNP_NONE &&
+	    time_after(jiffies + msecs_to_jiffies(touch_ms / 2), touch_end)) {
+		touch_end = jiffies + msecs_to_jiffies(touch_ms);
+		boost = true;
+	}
+	spin_unlock_irqrestore(&input_lock, flags);
+
+	if (boost)
+		schedule_work(&touch_work);
+}
+
+static int policy_input_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	if (!strstr(dev->name, "touchscreen") && !strstr(dev->name, "keypad"))
+		return -ENODEV;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "pnpmgr_policy";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_register;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_open;
+
+	return 0;
+
+err_open:
+	input_unregister_handle(handle);
+err_register:
+	kfree(handle);
+	return error;
+}
+
+static void policy_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id policy_input_ids[] = {
+	{ .driver_info = 1 },
+	{ },
+};
+
+static struct input_handler policy_input_handler = {
+	.event		= policy_input_event,
+	.connect	= policy_input_connect,
+	.disconnect	= policy_input_disconnect,
+	.name		= "pnpmgr_policy",
+	.id_table	= policy_input_ids,
+};
+
+static bool valid_level(int level)
+{
+	return level >= PNP_NONE && level < PERF_LOCK_INVALID;
+}
+
+static int parse_profiles(char *buf, struct pnp_profile *table)
+{
+	struct pnp_profile *p;
+	char *line;
+	int n = 0;
+
+	while ((line = strsep(&buf, "\n")) != NULL) {
+		line = strim(line);
+		if (!*line)
+			continue;
+		if (n == PNP_MAX_PROFILES)
+			return -ENOSPC;
+
+		p = &table[n];
+		if (sscanf(line, "%63s %d %d %d %d %d %u", p->name, &p->floor,
+			   &p->ceiling, &p->cores, &p->gpu, &p->touch_level,
+			   &p->touch_ms) != 7)
+			return -EINVAL;
+		if (!valid_level(p->floor) || !valid_level(p->ceiling) ||
+		    !valid_level(p->touch_level) || p->cores < 0 ||
+		    p->gpu < 0)
+			return -EINVAL;
+		n++;
+	}
+
+	return n;
+}
+
+static ssize_t profiles_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&policy_mutex);
+	for (i = 0; i < nr_profiles; i++) {
+		struct pnp_profile *p = &profiles[i];
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%s %d %d %d %d %d %u\n", p->name, p->floor,
+				 p->ceiling, p->cores, p->gpu, p->touch_level,
+				 p->touch_ms);
+	}
+	mutex_unlock(&policy_mutex);
+
+	return len;
+}
+
+static ssize_t profiles_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t n)
+{
+	struct pnp_profile *table, *old;
+	char *dup;
+	int ret;
+
+	table = kcalloc(PNP_MAX_PROFILES, sizeof(*table), GFP_KERNEL);
+	dup = kstrndup(buf, n, GFP_KERNEL);
+	if (!table || !dup) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = parse_profiles(dup, table);
+	if (ret < 0)
+		goto out;
+
+	mutex_lock(&policy_mutex);
+	old = profiles;
+	profiles = table;
+	nr_profiles = ret;
+	active_profile = NULL;
+	mutex_unlock(&policy_mutex);
+
+	table = old;
+	ret = n;
+	policy_kick();
+out:
+	kfree(dup);
+	kfree(table);
+	return ret;
+}
+power_attr(profiles);
+
+static ssize_t active_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	ssize_t ret;
+
+	mutex_lock(&policy_mutex);
+	ret = sprintf(buf, "%s\n",
+		      active_profile ? active_profile->name : "none");
+	mutex_unlock(&policy_mutex);
+
+	return ret;
+}
+power_ro_attr(active);
+
+#define define_policy_uint(_name)					\
+static ssize_t _name##_show						\
+(struct kobject *kobj, struct kobj_attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%u\n", _name);				\
+}									\
+static ssize_t _name##_store						\
+(struct kobject *kobj, struct kobj_attribute *attr,			\
+ const char *buf, size_t n)						\
+{									\
+	unsigned int val;						\
+	if (sscanf(buf, "%u", &val) != 1)				\
+		return -EINVAL;						\
+	_name = val;							\
+	policy_kick();							\
+	return n;							\
+}									\
+power_attr(_name)
+
+define_policy_uint(enabled);
+define_policy_uint(low_battery);
+define_policy_uint(busy_rq_avg);
+define_policy_uint(sample_ms);
+
+static struct attribute *policy_g[] = {
+	&profiles_attr.attr,
+	&active_attr.attr,
+	&enabled_attr.attr,
+	&low_battery_attr.attr,
+	&busy_rq_avg_attr.attr,
+	&sample_ms_attr.attr,
+	NULL,
+};
+
+static struct attribute_group policy_attr_group = {
+	.attrs = policy_g,
+};
+
+int __init pnp_policy_init(struct kobject *parent)
+{
+	struct kobject *policy_kobj;
+	int i, ret;
+
+	for (i = 0; i < PERF_LOCK_INVALID; i++) {
+		perf_lock_init(&floor_locks[i], TYPE_PERF_LOCK, i,
+			       "pnp_floor");
+		perf_lock_init(&ceiling_locks[i], TYPE_CPUFREQ_CEILING, i,
+			       "pnp_ceiling");
+		perf_lock_init(&touch_locks[i], TYPE_PERF_LOCK, i,
+			       "pnp_touch");
+	}
+	for (i = 1; i <= NR_CPUS; i++)
+		perf_lock_init(&cores_locks[i], TYPE_PERF_CORES, i,
+			       "pnp_cores");
+
+	policy_kobj = kobject_create_and_add("policy", parent);
+	if (!policy_kobj) {
+		pr_err("%s: Can not allocate enough memory.\n", __func__);
+		return -ENOMEM;
+	}
+
+	ret = sysfs_create_group(policy_kobj, &policy_attr_group);
+	if (ret) {
+		pr_err("%s: sysfs_create_group failed\n", __func__);
+		kobject_put(policy_kobj);
+		return ret;
+	}
+
+	msm_thermal_register_gpu_notifier(&policy_thermal_nb);
+
+	/* Not fatal, there just won't be a touch boost */
+	ret = input_register_handler(&policy_input_handler);
+	if (ret)
+		pr_warn("%s: no input handler: %d\n", __func__, ret);
+
+	return 0;
+}
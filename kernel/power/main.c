@@ -291,6 +291,11 @@ static int suspend_stats_show(struct seq_file *s, void *unused)
 			suspend_step_name(
 				suspend_stats.failed_steps[index]));
 	}
+	seq_printf(s,	"last_resume:\t%u usecs\n  slowest_devs:\n",
+			suspend_stats.last_resume_usecs);
+	for (i = 0; i < REC_SLOW_NUM && suspend_stats.slow_usecs[i]; i++)
+		seq_printf(s, "\t\t\t%-s %u usecs\n",
+			suspend_stats.slow_devs[i], suspend_stats.slow_usecs[i]);
 
 	return 0;
 }
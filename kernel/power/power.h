@@ -241,3 +241,17 @@ void request_onchg_state(int on);
 int get_onchg_state(void);
 #endif
 #endif
+
+#ifdef CONFIG_HTC_PNPMGR_POLICY
+int pnp_policy_init(struct kobject *parent);
+void pnp_policy_activity(const char *name);
+void pnp_policy_app_idle(bool idle);
+void pnp_policy_thermal_final(int value);
+void pnp_policy_charging(int charging_enabled);
+#else
+static inline int pnp_policy_init(struct kobject *parent) { return 0; }
+static inline void pnp_policy_activity(const char *name) {}
+static inline void pnp_policy_app_idle(bool idle) {}
+static inline void pnp_policy_thermal_final(int value) {}
+static inline void pnp_policy_charging(int charging_enabled) {}
+#endif
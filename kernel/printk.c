@@ -41,6 +41,8 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
 
 #include <asm/uaccess.h>
 
@@ -732,6 +734,8 @@ static char printk_buf[1024];
 
 int printk_delay_msec __read_mostly;
 
+static bool printk_defer_console(void);
+
 static inline void printk_delay(void)
 {
 	if (unlikely(printk_delay_msec)) {
@@ -874,7 +878,10 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 			new_text_line = 1;
 	}
 
-	if (console_trylock_for_printk(this_cpu))
+	if (printk_defer_console()) {
+		printk_cpu = UINT_MAX;
+		raw_spin_unlock(&logbuf_lock);
+	} else if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
 	lockdep_on();
@@ -1094,10 +1101,76 @@ int is_console_locked(void)
 
 #define PRINTK_PENDING_WAKEUP	0x01
 #define PRINTK_PENDING_SCHED	0x02
+#define PRINTK_PENDING_CONSOLE	0x04
 
 static DEFINE_PER_CPU(int, printk_pending);
 static DEFINE_PER_CPU(char [PRINTK_BUF_SIZE], printk_sched_buf);
 
+/*
+ * Once kconsole runs, printk only fills the log buffer and the console
+ * drivers are called from that thread, woken from the next tick like
+ * klogd.  Oopses, panics and shutdown still write the console directly.
+ */
+static bool __read_mostly console_async = 1;
+module_param(console_async, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *console_task;
+static DECLARE_WAIT_QUEUE_HEAD(console_wait);
+/* local_clock() when output was first left for kconsole, under logbuf_lock */
+static u64 console_queued;
+
+static unsigned long console_flushes;
+static u64 console_flush_ns, console_flush_max_ns, console_queued_max_ns;
+
+static int console_stats_get(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "flushes %lu flush_us %llu max_us %llu "
+		       "queued_max_us %llu", console_flushes,
+		       div_u64(console_flush_ns, NSEC_PER_USEC),
+		       div_u64(console_flush_max_ns, NSEC_PER_USEC),
+		       div_u64(console_queued_max_ns, NSEC_PER_USEC));
+}
+
+static struct kernel_param_ops console_stats_ops = {
+	.get = console_stats_get,
+};
+module_param_cb(console_stats, &console_stats_ops, NULL, S_IRUGO);
+
+#ifdef CONFIG_PRINTK
+/* Called by vprintk() with logbuf_lock held */
+static bool printk_defer_console(void)
+{
+	if (!console_async || !console_task || oops_in_progress ||
+	    system_state > SYSTEM_RUNNING)
+		return false;
+	if (!console_queued)
+		console_queued = local_clock();
+	__this_cpu_or(printk_pending, PRINTK_PENDING_CONSOLE);
+	return true;
+}
+#endif
+
+static int console_thread(void *unused)
+{
+	unsigned long flags;
+	u64 queued;
+
+	for (;;) {
+		wait_event_interruptible(console_wait,
+					 ACCESS_ONCE(console_queued));
+		raw_spin_lock_irqsave(&logbuf_lock, flags);
+		queued = local_clock() - console_queued;
+		console_queued = 0;
+		raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+
+		if (queued > console_queued_max_ns)
+			console_queued_max_ns = queued;
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
 void printk_tick(void)
 {
 	if (__this_cpu_read(printk_pending)) {
@@ -1108,6 +1181,8 @@ void printk_tick(void)
 		}
 		if (pending & PRINTK_PENDING_WAKEUP)
 			wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_CONSOLE)
+			wake_up_interruptible(&console_wait);
 	}
 }
 
@@ -1129,6 +1204,8 @@ void console_unlock(void)
 	unsigned long flags;
 	unsigned _con_start, _log_end;
 	unsigned wake_klogd = 0, retry = 0;
+	bool flushed = false;
+	u64 start, ns;
 
 	if (console_suspended) {
 		up(&console_sem);
@@ -1138,11 +1215,13 @@ void console_unlock(void)
 	console_may_schedule = 0;
 
 again:
+	start = local_clock();
 	for ( ; ; ) {
 		raw_spin_lock_irqsave(&logbuf_lock, flags);
 		wake_klogd |= log_start - log_end;
 		if (con_start == log_end)
 			break;			
+		flushed = true;
 		_con_start = con_start;
 		_log_end = log_end;
 		con_start = log_end;		
@@ -1154,6 +1233,15 @@ again:
 	}
 	console_locked = 0;
 
+	if (flushed) {
+		ns = local_clock() - start;
+		console_flushes++;
+		console_flush_ns += ns;
+		if (ns > console_flush_max_ns)
+			console_flush_max_ns = ns;
+		flushed = false;
+	}
+
 	
 	if (unlikely(exclusive_console))
 		exclusive_console = NULL;
@@ -1395,6 +1483,7 @@ EXPORT_SYMBOL(unregister_console);
 static int __init printk_late_init(void)
 {
 	struct console *con;
+	struct task_struct *t;
 
 	for_each_console(con) {
 		if (!keep_bootcon && con->flags & CON_BOOT) {
@@ -1404,6 +1493,10 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+
+	t = kthread_run(console_thread, NULL, "kconsole");
+	if (!IS_ERR(t))
+		console_task = t;
 	return 0;
 }
 late_initcall(printk_late_init);
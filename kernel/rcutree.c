@@ -61,7 +61,7 @@
 
 static struct lock_class_key rcu_node_class[NUM_RCU_LVLS];
 
-#define RCU_STATE_INITIALIZER(structname) { \
+#define RCU_STATE_INITIALIZER(structname, cr) { \
 	.level = { &structname##_state.node[0] }, \
 	.levelcnt = { \
 		NUM_RCU_LVL_0,   \
@@ -78,12 +78,13 @@ static struct lock_class_key rcu_node_class[NUM_RCU_LVLS];
 	.n_force_qs = 0, \
 	.n_force_qs_ngp = 0, \
 	.name = #structname, \
+	.call = cr, \
 }
 
-struct rcu_state rcu_sched_state = RCU_STATE_INITIALIZER(rcu_sched);
+struct rcu_state rcu_sched_state = RCU_STATE_INITIALIZER(rcu_sched, call_rcu_sched);
 DEFINE_PER_CPU(struct rcu_data, rcu_sched_data);
 
-struct rcu_state rcu_bh_state = RCU_STATE_INITIALIZER(rcu_bh);
+struct rcu_state rcu_bh_state = RCU_STATE_INITIALIZER(rcu_bh, call_rcu_bh);
 DEFINE_PER_CPU(struct rcu_data, rcu_bh_data);
 
 static struct rcu_state *rcu_state;
@@ -245,6 +246,7 @@ static void rcu_idle_enter_common(struct rcu_dynticks *rdtp, long long oldval)
 			  current->pid, current->comm,
 			  idle->pid, idle->comm); 
 	}
+	rcu_nocb_deferred_wakeup(smp_processor_id());
 	rcu_prepare_for_idle(smp_processor_id());
 	
 	smp_mb__before_atomic_inc();  
@@ -1063,6 +1065,7 @@ void rcu_check_callbacks(int cpu, int user)
 {
 	trace_rcu_utilization("Start scheduler-tick");
 	increment_cpu_stall_ticks();
+	rcu_nocb_deferred_wakeup(cpu);
 	if (user || rcu_is_cpu_rrupt_from_idle()) {
 
 
@@ -1260,6 +1263,11 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(rsp->rda);
 
+	if (rcu_nocb_enqueue(rdp, head, lazy, irqs_disabled_flags(flags))) {
+		local_irq_restore(flags);
+		return;
+	}
+
 	
 	*rdp->nxttail[RCU_NEXT_TAIL] = head;
 	rdp->nxttail[RCU_NEXT_TAIL] = &head->next;
@@ -1503,7 +1511,10 @@ static void _rcu_barrier(struct rcu_state *rsp,
 	mutex_lock(&rcu_barrier_mutex);
 	init_completion(&rcu_barrier_completion);
 	atomic_set(&rcu_barrier_cpu_count, 1);
+	get_online_cpus();
 	on_each_cpu(rcu_barrier_func, (void *)call_rcu_func, 1);
+	rcu_nocb_barrier(rsp);
+	put_online_cpus();
 	if (atomic_dec_and_test(&rcu_barrier_cpu_count))
 		complete(&rcu_barrier_completion);
 	wait_for_completion(&rcu_barrier_completion);
@@ -1543,6 +1554,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	WARN_ON_ONCE(atomic_read(&rdp->dynticks->dynticks) != 1);
 	rdp->cpu = cpu;
 	rdp->rsp = rsp;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
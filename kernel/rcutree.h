@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/wait.h>
 
 #define MAX_RCU_LVLS 4
 #if CONFIG_RCU_FANOUT > 16
@@ -249,6 +250,21 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* Callbacks handed to this cpu's offload kthread, see rcu_nocbs= */
+	struct rcu_head *nocb_head;
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;
+	atomic_long_t nocb_q_count_lazy;
+	long nocb_p_count;
+	long nocb_p_count_lazy;
+	bool nocb_nonlazy;
+	bool nocb_defer_wakeup;
+	unsigned long n_nocbs_invoked;
+	wait_queue_head_t nocb_wq;
+	struct task_struct *nocb_kthread;
+#endif
+
 	int cpu;
 	struct rcu_state *rsp;
 };
@@ -325,6 +341,8 @@ struct rcu_state {
 	unsigned long gp_max;			
 						
 	char *name;				
+	void (*call)(struct rcu_head *head,
+		     void (*func)(struct rcu_head *head));
 };
 
 
@@ -408,5 +426,10 @@ static void print_cpu_stall_info(struct rcu_state *rsp, int cpu);
 static void print_cpu_stall_info_end(void);
 static void zero_cpu_stall_ticks(struct rcu_data *rdp);
 static void increment_cpu_stall_ticks(void);
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head,
+			     bool lazy, bool irqs_off);
+static void rcu_nocb_deferred_wakeup(int cpu);
+static void rcu_nocb_barrier(struct rcu_state *rsp);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
 
 #endif 
@@ -25,6 +25,7 @@
  */
 
 #include <linux/delay.h>
+#include <linux/bootmem.h>
 
 #define RCU_KTHREAD_PRIO 1
 
@@ -69,7 +70,7 @@ static void __init rcu_bootup_announce_oddness(void)
 
 #ifdef CONFIG_TREE_PREEMPT_RCU
 
-struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt);
+struct rcu_state rcu_preempt_state = RCU_STATE_INITIALIZER(rcu_preempt, call_rcu);
 DEFINE_PER_CPU(struct rcu_data, rcu_preempt_data);
 static struct rcu_state *rcu_state = &rcu_preempt_state;
 
@@ -1610,3 +1611,282 @@ static void increment_cpu_stall_ticks(void)
 }
 
 #endif 
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Callbacks queued on a cpu in rcu_nocbs= go to a per-cpu, per-flavour
+ * kthread that runs on the other cpus, waits for a grace period and
+ * invokes them, so the cpu has no RCU softirq work of its own and
+ * rcu_needs_cpu() lets it go idle.  While only lazy (kfree_rcu)
+ * callbacks are queued the kthread sleeps up to nocb_lazy_ms before
+ * doing anything, batching them into one grace period.
+ */
+static cpumask_var_t rcu_nocb_mask;
+static bool have_rcu_nocb_mask;
+
+static unsigned int nocb_lazy_ms = 6000;
+module_param(nocb_lazy_ms, uint, 0644);
+
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	have_rcu_nocb_mask = true;
+	cpulist_parse(str, rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+static bool is_nocb_cpu(int cpu)
+{
+	return have_rcu_nocb_mask && cpumask_test_cpu(cpu, rcu_nocb_mask);
+}
+
+struct rcu_nocb_gp {
+	struct rcu_head head;
+	struct completion done;
+};
+
+static void rcu_nocb_gp_done(struct rcu_head *head)
+{
+	complete(&container_of(head, struct rcu_nocb_gp, head)->done);
+}
+
+/*
+ * Like wait_rcu_gp(), but the callback is never offloaded itself: a
+ * kthread running on a nocb cpu must not end up waiting on its own, or
+ * another blocked kthread's, queue.
+ */
+static void rcu_nocb_wait_gp(struct rcu_state *rsp)
+{
+	struct rcu_nocb_gp gp;
+
+	init_rcu_head_on_stack(&gp.head);
+	init_completion(&gp.done);
+	rsp->call(&gp.head, rcu_nocb_gp_done);
+	wait_for_completion(&gp.done);
+	destroy_rcu_head_on_stack(&gp.head);
+}
+
+/* Called with irqs off by __call_rcu(), func already set */
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head,
+			     bool lazy, bool irqs_off)
+{
+	struct task_struct *t = ACCESS_ONCE(rdp->nocb_kthread);
+	struct rcu_head **old;
+	bool wake;
+	long c;
+
+	if (!t || head->func == rcu_nocb_gp_done)
+		return false;
+
+	old = xchg(&rdp->nocb_tail, &head->next);
+	ACCESS_ONCE(*old) = head;
+	c = atomic_long_inc_return(&rdp->nocb_q_count);
+	if (lazy)
+		atomic_long_inc(&rdp->nocb_q_count_lazy);
+
+	wake = old == &rdp->nocb_head || c == qhimark;
+	if (!lazy && !ACCESS_ONCE(rdp->nocb_nonlazy)) {
+		smp_wmb();
+		ACCESS_ONCE(rdp->nocb_nonlazy) = true;
+		wake = true;
+	}
+	if (!wake)
+		return true;
+
+	/* call_rcu() under a runqueue lock must not wake anybody up */
+	if (irqs_off)
+		ACCESS_ONCE(rdp->nocb_defer_wakeup) = true;
+	else
+		wake_up(&rdp->nocb_wq);
+	return true;
+}
+
+static void __rcu_nocb_deferred_wakeup(struct rcu_data *rdp)
+{
+	if (!ACCESS_ONCE(rdp->nocb_defer_wakeup))
+		return;
+	ACCESS_ONCE(rdp->nocb_defer_wakeup) = false;
+	wake_up(&rdp->nocb_wq);
+}
+
+static void rcu_nocb_deferred_wakeup(int cpu)
+{
+	if (!is_nocb_cpu(cpu))
+		return;
+	__rcu_nocb_deferred_wakeup(&per_cpu(rcu_sched_data, cpu));
+	__rcu_nocb_deferred_wakeup(&per_cpu(rcu_bh_data, cpu));
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	__rcu_nocb_deferred_wakeup(&per_cpu(rcu_preempt_data, cpu));
+#endif
+}
+
+/*
+ * Offline nocb cpus still have callbacks in their kthread's queue, which
+ * the on_each_cpu() in _rcu_barrier() does not reach.  Called with the
+ * hotplug lock held.
+ */
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+	struct rcu_data *rdp;
+	struct rcu_head *head;
+	unsigned long flags;
+	int cpu;
+
+	if (!have_rcu_nocb_mask)
+		return;
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		if (cpu_online(cpu))
+			continue;
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		head = &per_cpu(rcu_barrier_head, cpu);
+		head->func = rcu_barrier_callback;
+		head->next = NULL;
+		atomic_inc(&rcu_barrier_cpu_count);
+		local_irq_save(flags);
+		if (!rcu_nocb_enqueue(rdp, head, false, false))
+			atomic_dec(&rcu_barrier_cpu_count);
+		local_irq_restore(flags);
+	}
+}
+
+static bool rcu_nocb_ready(struct rcu_data *rdp)
+{
+	return ACCESS_ONCE(rdp->nocb_nonlazy) ||
+	       atomic_long_read(&rdp->nocb_q_count) >= qhimark;
+}
+
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list, *next, **tail;
+	long c, cl;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+		if (nocb_lazy_ms && !rcu_nocb_ready(rdp))
+			wait_event_interruptible_timeout(rdp->nocb_wq,
+				rcu_nocb_ready(rdp),
+				msecs_to_jiffies(nocb_lazy_ms));
+
+		list = ACCESS_ONCE(rdp->nocb_head);
+		if (!list)
+			continue;
+		ACCESS_ONCE(rdp->nocb_nonlazy) = false;
+		smp_mb();
+		ACCESS_ONCE(rdp->nocb_head) = NULL;
+		tail = xchg(&rdp->nocb_tail, &rdp->nocb_head);
+		c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+		cl = atomic_long_xchg(&rdp->nocb_q_count_lazy, 0);
+		ACCESS_ONCE(rdp->nocb_p_count) += c;
+		ACCESS_ONCE(rdp->nocb_p_count_lazy) += cl;
+		rcu_nocb_wait_gp(rdp->rsp);
+
+		trace_rcu_batch_start(rdp->rsp->name, cl, c, -1);
+		c = cl = 0;
+		while (list) {
+			next = list->next;
+			/* Enqueuer between the xchg and linking itself in */
+			while (next == NULL && &list->next != tail) {
+				schedule_timeout_interruptible(1);
+				next = list->next;
+			}
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			if (__rcu_reclaim(rdp->rsp->name, list))
+				cl++;
+			c++;
+			local_bh_enable();
+			list = next;
+			cond_resched();
+		}
+		trace_rcu_batch_end(rdp->rsp->name, c, 0, 0, 0, 1);
+		ACCESS_ONCE(rdp->nocb_p_count) -= c;
+		ACCESS_ONCE(rdp->nocb_p_count_lazy) -= cl;
+		rdp->n_nocbs_invoked += c;
+	}
+	return 0;
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_tail = &rdp->nocb_head;
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp,
+					   const struct cpumask *housekeeping)
+{
+	struct rcu_data *rdp;
+	struct task_struct *t;
+	int cpu;
+
+	for_each_cpu(cpu, rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_create(rcu_nocb_kthread, rdp, "rcuo%c/%d",
+				   rsp->name[4], cpu);
+		if (IS_ERR(t)) {
+			pr_err("RCU: no offload kthread for cpu %d\n", cpu);
+			continue;
+		}
+		set_cpus_allowed_ptr(t, housekeeping);
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+		wake_up_process(t);
+	}
+}
+
+static int __init rcu_nocb_init(void)
+{
+	cpumask_var_t housekeeping;
+	char buf[32];
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	cpumask_and(rcu_nocb_mask, rcu_nocb_mask, cpu_possible_mask);
+	if (cpumask_test_cpu(0, rcu_nocb_mask)) {
+		pr_info("RCU: cpu 0 keeps its callbacks\n");
+		cpumask_clear_cpu(0, rcu_nocb_mask);
+	}
+	if (cpumask_empty(rcu_nocb_mask)) {
+		have_rcu_nocb_mask = false;
+		return 0;
+	}
+	if (!alloc_cpumask_var(&housekeeping, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_andnot(housekeeping, cpu_possible_mask, rcu_nocb_mask);
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	pr_info("RCU: offloading callbacks from cpus %s\n", buf);
+
+	rcu_spawn_nocb_kthreads(&rcu_sched_state, housekeeping);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state, housekeeping);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state, housekeeping);
+#endif
+	free_cpumask_var(housekeeping);
+	return 0;
+}
+early_initcall(rcu_nocb_init);
+
+#else 
+
+static bool rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *head,
+			     bool lazy, bool irqs_off)
+{
+	return false;
+}
+
+static void rcu_nocb_deferred_wakeup(int cpu)
+{
+}
+
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+}
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+#endif
@@ -91,6 +91,15 @@ static void print_one_rcu_data(struct seq_file *m, struct rcu_data *rdp)
 		   per_cpu(rcu_cpu_kthread_loops, rdp->cpu) & 0xffff);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 	seq_printf(m, " b=%ld", rdp->blimit);
+#ifdef CONFIG_RCU_NOCB_CPU
+	if (rdp->nocb_kthread)
+		seq_printf(m, " nq=%ld/%ld np=%ld/%ld ni=%lu",
+			   atomic_long_read(&rdp->nocb_q_count_lazy),
+			   atomic_long_read(&rdp->nocb_q_count),
+			   ACCESS_ONCE(rdp->nocb_p_count_lazy),
+			   ACCESS_ONCE(rdp->nocb_p_count),
+			   rdp->n_nocbs_invoked);
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 	seq_printf(m, " ci=%lu co=%lu ca=%lu\n",
 		   rdp->n_cbs_invoked, rdp->n_cbs_orphaned, rdp->n_cbs_adopted);
 }
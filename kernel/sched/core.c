@@ -1098,6 +1098,7 @@ ttwu_stat(struct task_struct *p, int cpu, int wake_flags)
 
 static void ttwu_activate(struct rq *rq, struct task_struct *p, int en_flags)
 {
+	sched_lat_hist_wakeup(p);
 	activate_task(rq, p, en_flags);
 	p->on_rq = 1;
 
@@ -1337,6 +1338,14 @@ static void __sched_fork(struct task_struct *p)
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
+#ifdef CONFIG_SMP
+	p->se.wakeup_start		= 0;
+	p->se.wakeup_sum_exec		= 0;
+	p->se.wakeup_count		= 0;
+	p->se.small_ratio		= SCHED_POWER_SCALE;
+	p->se.small_task		= 0;
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
@@ -6270,6 +6279,34 @@ long tg_get_cfs_period(struct task_group *tg)
 	return cfs_period_us;
 }
 
+int tg_set_cfs_period_slack(struct task_group *tg, u64 slack_us)
+{
+	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	if (slack_us * NSEC_PER_USEC > max_cfs_quota_period / 2)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	raw_spin_lock_irq(&cfs_b->lock);
+	cfs_b->period_slack = slack_us * NSEC_PER_USEC;
+	if (cfs_b->quota != RUNTIME_INF && cfs_b->timer_active) {
+		cfs_b->timer_active = 0;
+		__start_cfs_bandwidth(cfs_b);
+	}
+	raw_spin_unlock_irq(&cfs_b->lock);
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return 0;
+}
+
+u64 tg_get_cfs_period_slack(struct task_group *tg)
+{
+	return div_u64(tg->cfs_bandwidth.period_slack, NSEC_PER_USEC);
+}
+
 static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
 {
 	return tg_get_cfs_quota(cgroup_tg(cgrp));
@@ -6292,6 +6329,18 @@ static int cpu_cfs_period_write_u64(struct cgroup *cgrp, struct cftype *cftype,
 	return tg_set_cfs_period(cgroup_tg(cgrp), cfs_period_us);
 }
 
+static u64 cpu_cfs_period_slack_read_u64(struct cgroup *cgrp,
+					 struct cftype *cft)
+{
+	return tg_get_cfs_period_slack(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_period_slack_write_u64(struct cgroup *cgrp,
+					  struct cftype *cftype, u64 slack_us)
+{
+	return tg_set_cfs_period_slack(cgroup_tg(cgrp), slack_us);
+}
+
 struct cfs_schedulable_data {
 	struct task_group *tg;
 	u64 period, quota;
@@ -6371,6 +6420,7 @@ static int cpu_stats_show(struct cgroup *cgrp, struct cftype *cft,
 	cb->fill(cb, "nr_periods", cfs_b->nr_periods);
 	cb->fill(cb, "nr_throttled", cfs_b->nr_throttled);
 	cb->fill(cb, "throttled_time", cfs_b->throttled_time);
+	cb->fill(cb, "throttled_max", cfs_b->throttled_max);
 
 	return 0;
 }
@@ -6401,6 +6451,20 @@ static u64 cpu_rt_period_read_uint(struct cgroup *cgrp, struct cftype *cft)
 }
 #endif 
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static int cpu_latency_hist_write(struct cgroup *cgrp, struct cftype *cft,
+				  u64 val)
+{
+	cgroup_tg(cgrp)->latency_hist = !!val;
+	return 0;
+}
+
+static u64 cpu_latency_hist_read(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cgroup_tg(cgrp)->latency_hist;
+}
+#endif
+
 static struct cftype cpu_files[] = {
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	{
@@ -6420,6 +6484,11 @@ static struct cftype cpu_files[] = {
 		.read_u64 = cpu_cfs_period_read_u64,
 		.write_u64 = cpu_cfs_period_write_u64,
 	},
+	{
+		.name = "cfs_period_slack_us",
+		.read_u64 = cpu_cfs_period_slack_read_u64,
+		.write_u64 = cpu_cfs_period_slack_write_u64,
+	},
 	{
 		.name = "stat",
 		.read_map = cpu_stats_show,
@@ -6437,6 +6506,13 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_rt_period_write_uint,
 	},
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	{
+		.name = "latency_hist",
+		.read_u64 = cpu_latency_hist_read,
+		.write_u64 = cpu_latency_hist_write,
+	},
+#endif
 };
 
 static int cpu_cgroup_populate(struct cgroup_subsys *ss, struct cgroup *cont)
@@ -46,6 +46,12 @@ unsigned int sysctl_sched_child_runs_first __read_mostly;
 
 unsigned int __read_mostly sysctl_sched_wake_to_idle;
 
+/*
+ * A task that runs for less than this share of the time between its
+ * wakeups is small, see SMALL_TASK_PACKING.
+ */
+unsigned int __read_mostly sysctl_sched_small_task_pct = 10;
+
 unsigned int sysctl_sched_wakeup_granularity = 1000000UL;
 unsigned int normalized_sysctl_sched_wakeup_granularity = 1000000UL;
 
@@ -1348,12 +1354,16 @@ void unthrottle_cfs_rq(struct cfs_rq *cfs_rq)
 	struct sched_entity *se;
 	int enqueue = 1;
 	long task_delta;
+	u64 delta;
 
 	se = cfs_rq->tg->se[cpu_of(rq_of(cfs_rq))];
 
 	cfs_rq->throttled = 0;
+	delta = rq->clock - cfs_rq->throttled_timestamp;
 	raw_spin_lock(&cfs_b->lock);
-	cfs_b->throttled_time += rq->clock - cfs_rq->throttled_timestamp;
+	cfs_b->throttled_time += delta;
+	if (delta > cfs_b->throttled_max)
+		cfs_b->throttled_max = delta;
 	list_del_rcu(&cfs_rq->throttled_list);
 	raw_spin_unlock(&cfs_b->lock);
 	cfs_rq->throttled_timestamp = 0;
@@ -1622,6 +1632,15 @@ static enum hrtimer_restart sched_cfs_slack_timer(struct hrtimer *timer)
 	return HRTIMER_NORESTART;
 }
 
+/*
+ * Coalescing window for the period timer: the refill may run anywhere in
+ * [expiry, expiry + slack] so it rides on another wakeup of that cpu.
+ */
+static inline u64 cfs_period_slack(struct cfs_bandwidth *cfs_b)
+{
+	return min(cfs_b->period_slack, (u64)ktime_to_ns(cfs_b->period) / 2);
+}
+
 static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
 {
 	struct cfs_bandwidth *cfs_b =
@@ -1631,7 +1650,12 @@ static enum hrtimer_restart sched_cfs_period_timer(struct hrtimer *timer)
 	int idle = 0;
 
 	for (;;) {
-		now = hrtimer_cb_get_time(timer);
+		/*
+		 * With a slack range the timer may run before its hard expiry,
+		 * forward from the soft end so an early run still counts.
+		 */
+		now = ktime_add_ns(hrtimer_cb_get_time(timer),
+				   cfs_period_slack(cfs_b));
 		overrun = hrtimer_forward(timer, now, cfs_b->period);
 
 		if (!overrun)
@@ -1649,6 +1673,7 @@ void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 	cfs_b->runtime = 0;
 	cfs_b->quota = RUNTIME_INF;
 	cfs_b->period = ns_to_ktime(default_cfs_period());
+	cfs_b->period_slack = 0;
 
 	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
 	hrtimer_init(&cfs_b->period_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
@@ -1677,6 +1702,9 @@ void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 	}
 
 	cfs_b->timer_active = 1;
+	hrtimer_set_expires_range_ns(&cfs_b->period_timer,
+			hrtimer_get_softexpires(&cfs_b->period_timer),
+			cfs_period_slack(cfs_b));
 	start_bandwidth_timer(&cfs_b->period_timer, cfs_b->period);
 }
 
@@ -1788,6 +1816,27 @@ static inline void hrtick_update(struct rq *rq)
 }
 #endif
 
+#ifdef CONFIG_SMP
+/*
+ * Counted for every queued fair task, throttled or not, so the count may
+ * run ahead of nr_running but never wraps.
+ */
+static inline void inc_small_running(struct rq *rq, struct task_struct *p)
+{
+	if (p->se.small_task)
+		rq->nr_small_running++;
+}
+
+static inline void dec_small_running(struct rq *rq, struct task_struct *p)
+{
+	if (p->se.small_task)
+		rq->nr_small_running--;
+}
+#else
+static inline void inc_small_running(struct rq *rq, struct task_struct *p) { }
+static inline void dec_small_running(struct rq *rq, struct task_struct *p) { }
+#endif
+
 static void
 enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 {
@@ -1820,6 +1869,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 	if (!se)
 		inc_nr_running(rq);
+	inc_small_running(rq, p);
 	hrtick_update(rq);
 }
 
@@ -1864,6 +1914,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 
 	if (!se)
 		dec_nr_running(rq);
+	dec_small_running(rq, p);
 	hrtick_update(rq);
 }
 
@@ -2147,6 +2198,80 @@ done:
 	return target;
 }
 
+/* Wakeups seen before a task can be called small */
+#define SMALL_TASK_WAKEUPS	4
+/* Small tasks packed onto one CPU before it counts as saturated */
+#define SMALL_TASK_PACK_MAX	4
+
+static inline unsigned int nr_big_running(struct rq *rq)
+{
+	unsigned int nr = rq->nr_running;
+	unsigned int small = rq->nr_small_running;
+
+	return nr > small ? nr - small : 0;
+}
+
+/*
+ * Called on every wakeup while the task is not queued.  The share of the
+ * time since the previous wakeup the task spent running is averaged over
+ * the last few wakeups, in SCHED_POWER_SCALE units.
+ */
+static int update_small_task(struct task_struct *p)
+{
+	struct sched_entity *se = &p->se;
+	u64 now = local_clock();
+	u64 period = now - se->wakeup_start;
+	u64 runtime = se->sum_exec_runtime - se->wakeup_sum_exec;
+	unsigned int ratio = SCHED_POWER_SCALE;
+
+	if (runtime < period)
+		ratio = div64_u64(runtime << SCHED_POWER_SHIFT, period);
+	se->small_ratio = (se->small_ratio * 3 + ratio) >> 2;
+
+	se->wakeup_start = now;
+	se->wakeup_sum_exec = se->sum_exec_runtime;
+	if (se->wakeup_count < SMALL_TASK_WAKEUPS)
+		se->wakeup_count++;
+
+	se->small_task = se->wakeup_count >= SMALL_TASK_WAKEUPS &&
+		se->small_ratio * 100 <
+		sysctl_sched_small_task_pct * SCHED_POWER_SCALE;
+
+	return se->small_task;
+}
+
+/*
+ * Pick the busiest CPU that isn't saturated, a CPU being saturated when it
+ * runs more than one task that isn't small or is full of small ones.  When
+ * everything is idle the lowest CPU is used, which is the one the hotplug
+ * code keeps online.
+ */
+static int pack_small_task(struct task_struct *p, int prev_cpu)
+{
+	struct sched_domain *sd = rcu_dereference(per_cpu(sd_llc, prev_cpu));
+	const struct cpumask *span = sd ? sched_domain_span(sd) :
+					  cpu_active_mask;
+	unsigned int best_nr = 0;
+	int i, best = -1;
+
+	for_each_cpu_and(i, span, tsk_cpus_allowed(p)) {
+		struct rq *rq = cpu_rq(i);
+		unsigned int nr = rq->nr_running;
+
+		if (nr_big_running(rq) > 1 ||
+		    rq->nr_small_running >= SMALL_TASK_PACK_MAX)
+			continue;
+
+		if (best < 0 || nr > best_nr ||
+		    (nr && nr == best_nr && i == prev_cpu)) {
+			best = i;
+			best_nr = nr;
+		}
+	}
+
+	return best;
+}
+
 static int
 select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 {
@@ -2158,9 +2283,24 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	int want_sd = 1;
 	int sync = wake_flags & WF_SYNC;
 
+	if ((sd_flag & SD_BALANCE_WAKE) && update_small_task(p))
+		schedstat_inc(this_rq(), ttwu_small);
+
 	if (p->rt.nr_cpus_allowed == 1)
 		return prev_cpu;
 
+	if ((sd_flag & SD_BALANCE_WAKE) && p->se.small_task &&
+	    sched_feat(SMALL_TASK_PACKING)) {
+		rcu_read_lock();
+		new_cpu = pack_small_task(p, prev_cpu);
+		rcu_read_unlock();
+		if (new_cpu >= 0) {
+			schedstat_inc(this_rq(), ttwu_packed);
+			return new_cpu;
+		}
+		new_cpu = cpu;
+	}
+
 	if (sd_flag & SD_BALANCE_WAKE) {
 		if (cpumask_test_cpu(cpu, tsk_cpus_allowed(p)))
 			want_affine = 1;
@@ -3873,7 +4013,8 @@ static inline int nohz_kick_needed(struct rq *rq, int cpu)
 	if (time_before(now, nohz.next_balance))
 		return 0;
 
-	if (rq->nr_running >= 2)
+	if (rq->nr_running >= 2 &&
+	    (!sched_feat(SMALL_TASK_PACKING) || nr_big_running(rq) >= 2))
 		goto need_kick;
 
 	rcu_read_lock();
@@ -25,3 +25,10 @@ SCHED_FEAT(TTWU_QUEUE, true)
 SCHED_FEAT(FORCE_SD_OVERLAP, false)
 SCHED_FEAT(RT_RUNTIME_SHARE, true)
 SCHED_FEAT(LB_MIN, false)
+
+/*
+ * Wake tasks that only run for a small share of the time between their
+ * wakeups on the busiest CPU that still has room, so that the other CPUs
+ * can stay in deep idle.
+ */
+SCHED_FEAT(SMALL_TASK_PACKING, false)
@@ -71,10 +71,11 @@ struct cfs_bandwidth {
 	int idle, timer_active;
 	struct hrtimer period_timer, slack_timer;
 	struct list_head throttled_cfs_rq;
+	u64 period_slack;
 
 	
 	int nr_periods, nr_throttled;
-	u64 throttled_time;
+	u64 throttled_time, throttled_max;
 #endif
 };
 
@@ -108,6 +109,9 @@ struct task_group {
 #ifdef CONFIG_SCHED_AUTOGROUP
 	struct autogroup *autogroup;
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	int latency_hist;
+#endif
 
 	struct cfs_bandwidth cfs_bandwidth;
 };
@@ -322,6 +326,8 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	unsigned int nr_small_running;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -362,6 +368,10 @@ struct rq {
 	
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* small task packing */
+	unsigned int ttwu_small;
+	unsigned int ttwu_packed;
 #endif
 
 #ifdef CONFIG_SMP
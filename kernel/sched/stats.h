@@ -41,6 +41,34 @@ rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 # define schedstat_set(var, val)	do { } while (0)
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/* With the rq lock held, before the enqueue stamps last_queued */
+static inline void sched_lat_hist_wakeup(struct task_struct *p)
+{
+	if (task_group(p)->latency_hist)
+		p->sched_info.lat_pending = 1;
+}
+
+static inline void
+sched_lat_hist_arrive(struct task_struct *t, unsigned long long delta)
+{
+	int bucket;
+
+	if (!t->sched_info.lat_pending)
+		return;
+
+	t->sched_info.lat_pending = 0;
+	bucket = min(fls64(delta >> 10), SCHED_LAT_HIST_BUCKETS - 1);
+	t->sched_info.lat_hist[bucket]++;
+}
+#else
+static inline void sched_lat_hist_wakeup(struct task_struct *p)
+{}
+static inline void
+sched_lat_hist_arrive(struct task_struct *t, unsigned long long delta)
+{}
+#endif
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 static inline void sched_info_reset_dequeued(struct task_struct *t)
 {
@@ -70,6 +98,7 @@ static void sched_info_arrive(struct task_struct *t)
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
 	t->sched_info.pcount++;
+	sched_lat_hist_arrive(t, delta);
 
 	rq_sched_info_arrive(task_rq(t), delta);
 }
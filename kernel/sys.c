@@ -1763,6 +1763,17 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 			error = put_user(me->signal->is_child_subreaper,
 					 (int __user *) arg2);
 			break;
+		case PR_SET_FORK_TEMPLATE:
+			if (!me->mm) {
+				error = -EINVAL;
+				break;
+			}
+			if (arg2)
+				set_bit(MMF_FORK_TEMPLATE, &me->mm->flags);
+			else
+				clear_bit(MMF_FORK_TEMPLATE, &me->mm->flags);
+			error = 0;
+			break;
 		default:
 			error = -EINVAL;
 			break;
@@ -558,13 +558,15 @@ static void update_rq_stats(void)
 	jiffy_gap = jiffies - rq_info.rq_poll_last_jiffy;
 
 	if (jiffy_gap >= rq_info.rq_poll_jiffies) {
+		unsigned int cur_rq = nr_running() * 10;
+		u64 hp_avg = cur_rq;
 
 		spin_lock_irqsave(&rq_lock, flags);
 
 		if (!rq_info.rq_avg)
 			rq_info.rq_poll_total_jiffies = 0;
 
-		rq_avg = nr_running() * 10;
+		rq_avg = cur_rq;
 
 		if (rq_info.rq_poll_total_jiffies) {
 			rq_avg = (rq_avg * jiffy_gap) +
@@ -578,6 +580,18 @@ static void update_rq_stats(void)
 		rq_info.rq_poll_total_jiffies += jiffy_gap;
 		rq_info.rq_poll_last_jiffy = jiffies;
 
+		/* Kept apart so the hotplug engine doesn't reset rq_avg */
+		if (rq_info.hp_poll_total_jiffies) {
+			hp_avg = hp_avg * jiffy_gap +
+				(u64) rq_info.hp_rq_avg *
+				rq_info.hp_poll_total_jiffies;
+			do_div(hp_avg,
+			       rq_info.hp_poll_total_jiffies + jiffy_gap);
+		}
+
+		rq_info.hp_rq_avg = (unsigned int) hp_avg;
+		rq_info.hp_poll_total_jiffies += jiffy_gap;
+
 		spin_unlock_irqrestore(&rq_lock, flags);
 	}
 }
@@ -622,7 +636,9 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 
 			update_rq_stats();
 
-			wakeup_user();
+			/* Nobody to poll for when hotplug is done in kernel */
+			if (!rq_info.hotplug_enabled)
+				wakeup_user();
 		}
 	}
 
@@ -38,6 +38,8 @@
 #include <linux/hardirq.h>
 #include <linux/mempolicy.h>
 #include <linux/freezer.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <linux/kallsyms.h>
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
@@ -204,6 +206,11 @@ struct cpu_workqueue_struct {
 	int			nr_active;	
 	int			max_active;	
 	struct list_head	delayed_works;	
+#ifdef CONFIG_WQ_LATENCY_STATS
+	unsigned long		lat_count;
+	u64			lat_total_ns;
+	u64			lat_max_ns;
+#endif
 };
 
 struct wq_flusher {
@@ -263,12 +270,14 @@ struct workqueue_struct *system_nrt_wq __read_mostly;
 struct workqueue_struct *system_unbound_wq __read_mostly;
 struct workqueue_struct *system_freezable_wq __read_mostly;
 struct workqueue_struct *system_nrt_freezable_wq __read_mostly;
+struct workqueue_struct *system_highpri_wq __read_mostly;
 EXPORT_SYMBOL_GPL(system_wq);
 EXPORT_SYMBOL_GPL(system_long_wq);
 EXPORT_SYMBOL_GPL(system_nrt_wq);
 EXPORT_SYMBOL_GPL(system_unbound_wq);
 EXPORT_SYMBOL_GPL(system_freezable_wq);
 EXPORT_SYMBOL_GPL(system_nrt_freezable_wq);
+EXPORT_SYMBOL_GPL(system_highpri_wq);
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/workqueue.h>
@@ -707,6 +716,9 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 
 	
 	set_work_cwq(work, cwq, extra_flags);
+#ifdef CONFIG_WQ_LATENCY_STATS
+	work->queued_ns = sched_clock();
+#endif
 
 	smp_wmb();
 
@@ -1308,6 +1320,16 @@ __acquires(&gcwq->lock)
 	
 	set_work_cpu(work, gcwq->cpu);
 	list_del_init(&work->entry);
+#ifdef CONFIG_WQ_LATENCY_STATS
+	{
+		u64 lat = sched_clock() - work->queued_ns;
+
+		cwq->lat_count++;
+		cwq->lat_total_ns += lat;
+		if (lat > cwq->lat_max_ns)
+			cwq->lat_max_ns = lat;
+	}
+#endif
 
 	if (unlikely(gcwq->flags & GCWQ_HIGHPRI_PENDING)) {
 		struct work_struct *nwork = list_first_entry(&gcwq->worklist,
@@ -2697,9 +2719,84 @@ static int __init init_workqueues(void)
 					      WQ_FREEZABLE, 0);
 	system_nrt_freezable_wq = alloc_workqueue("events_nrt_freezable",
 			WQ_NON_REENTRANT | WQ_FREEZABLE, 0);
+	system_highpri_wq = alloc_workqueue("events_highpri",
+			WQ_UNBOUND | WQ_HIGHPRI, WQ_UNBOUND_MAX_ACTIVE);
 	BUG_ON(!system_wq || !system_long_wq || !system_nrt_wq ||
 	       !system_unbound_wq || !system_freezable_wq ||
-		!system_nrt_freezable_wq);
+		!system_nrt_freezable_wq || !system_highpri_wq);
 	return 0;
 }
 early_initcall(init_workqueues);
+
+#ifdef CONFIG_WQ_LATENCY_STATS
+static int wq_latency_show(struct seq_file *m, void *v)
+{
+	struct workqueue_struct *wq;
+	struct cpu_workqueue_struct *cwq;
+	unsigned long count;
+	u64 total, max;
+	unsigned int cpu;
+
+	seq_printf(m, "%-24s %12s %10s %10s\n",
+		   "workqueue", "works", "avg_us", "max_us");
+	spin_lock(&workqueue_lock);
+	list_for_each_entry(wq, &workqueues, list) {
+		count = 0;
+		total = max = 0;
+		for_each_cwq_cpu(cpu, wq) {
+			cwq = get_cwq(cpu, wq);
+			count += cwq->lat_count;
+			total += cwq->lat_total_ns;
+			max = max(max, cwq->lat_max_ns);
+		}
+		if (!count)
+			continue;
+		seq_printf(m, "%-24s %12lu %10llu %10llu\n", wq->name, count,
+			   div_u64(div_u64(total, count), NSEC_PER_USEC),
+			   div_u64(max, NSEC_PER_USEC));
+	}
+	spin_unlock(&workqueue_lock);
+	return 0;
+}
+
+static int wq_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wq_latency_show, NULL);
+}
+
+/* Not under gcwq->lock, a work item finishing meanwhile may survive */
+static ssize_t wq_latency_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct workqueue_struct *wq;
+	struct cpu_workqueue_struct *cwq;
+	unsigned int cpu;
+
+	spin_lock(&workqueue_lock);
+	list_for_each_entry(wq, &workqueues, list) {
+		for_each_cwq_cpu(cpu, wq) {
+			cwq = get_cwq(cpu, wq);
+			cwq->lat_count = 0;
+			cwq->lat_total_ns = 0;
+			cwq->lat_max_ns = 0;
+		}
+	}
+	spin_unlock(&workqueue_lock);
+	return count;
+}
+
+static const struct file_operations wq_latency_fops = {
+	.open		= wq_latency_open,
+	.read		= seq_read,
+	.write		= wq_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init wq_latency_init(void)
+{
+	proc_create("wq_latency", S_IRUGO | S_IWUSR, NULL, &wq_latency_fops);
+	return 0;
+}
+late_initcall(wq_latency_init);
+#endif
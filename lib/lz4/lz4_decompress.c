@@ -47,7 +47,79 @@
 
 #include "lz4defs.h"
 
-static int lz4_uncompress(const char *source, char *dest, int osize)
+#if defined(CONFIG_KERNEL_MODE_NEON) && !defined(STATIC)
+#include <linux/hardirq.h>
+#include <asm/neon.h>
+
+#define LZ4_NEON	1
+/* Below this output size the NEON unit is not worth claiming */
+#define LZ4_NEON_MIN	1024
+
+bool lz4_decompress_neon = true;
+module_param_named(neon, lz4_decompress_neon, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(neon, "Use NEON copy loops when the CPU has NEON");
+EXPORT_SYMBOL_GPL(lz4_decompress_neon);
+
+/*
+ * Copies exactly n bytes, n a non-zero multiple of 16, in 16 byte steps.
+ * An overlapping match must be at least 16 bytes back.  The kernel is not
+ * built to use q0 itself, so it needs no clobber.
+ */
+static inline void lz4_neon_copy(BYTE *d, const BYTE *s, size_t n)
+{
+	asm volatile(
+	"	.fpu	neon\n"
+	"1:	vld1.8	{d0, d1}, [%1]!\n"
+	"	subs	%2, %2, #16\n"
+	"	vst1.8	{d0, d1}, [%0]!\n"
+	"	bne	1b\n"
+	: "+r" (d), "+r" (s), "+r" (n)
+	:
+	: "cc", "memory");
+}
+
+static inline bool lz4_neon_begin(size_t osize)
+{
+	if (!lz4_decompress_neon || !cpu_has_neon() || in_interrupt() ||
+			osize < LZ4_NEON_MIN)
+		return false;
+	kernel_neon_begin();
+	return true;
+}
+
+static inline void lz4_neon_end(bool neon)
+{
+	if (neon)
+		kernel_neon_end();
+}
+#else
+#define LZ4_NEON	0
+#define lz4_neon_copy(d, s, n)	do { } while (0)
+#define lz4_neon_begin(osize)	false
+#define lz4_neon_end(neon)	do { } while (0)
+#endif
+
+/* Literal and match runs this long get their 16 byte steps done by NEON */
+#define LZ4_NEON_COPY	32
+#define LZ4_NEON_STEP	16
+
+/*
+ * Moves the bulk of a long run with NEON, leaving no more than
+ * LZ4_NEON_STEP - 1 bytes for the wild copy that finishes it.  Exact
+ * lengths keep the over-read and over-write bounds of the generic loops.
+ */
+#define LZ4_NEON_RUN(neon, s, d, len)				\
+	do {							\
+		if (LZ4_NEON && (neon) && (len) >= LZ4_NEON_COPY) { \
+			size_t __n = (len) & ~(LZ4_NEON_STEP - 1); \
+			lz4_neon_copy(d, s, __n);		\
+			d += __n;				\
+			s += __n;				\
+		}						\
+	} while (0)
+
+static int lz4_uncompress(const char *source, char *dest, int osize,
+				bool neon)
 {
 	const BYTE *ip = (const BYTE *) source;
 	const BYTE *ref;
@@ -94,6 +166,7 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 		ip += length;
 		break; /* EOF */
 	}
+	LZ4_NEON_RUN(neon, ip, op, length);
 	LZ4_WILDCOPY(ip, op, cpy);
 	ip -= (op - cpy);
 	op = cpy;
@@ -152,6 +225,8 @@ static int lz4_uncompress(const char *source, char *dest, int osize)
 			goto _output_error;
 		continue;
 	}
+		if (neon && op - ref >= LZ4_NEON_STEP)
+			LZ4_NEON_RUN(neon, ref, op, cpy - op);
 		LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
@@ -164,7 +239,7 @@ _output_error:
 }
 
 static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
-				int isize, size_t maxoutputsize)
+				int isize, size_t maxoutputsize, bool neon)
 {
 	const BYTE *ip = (const BYTE *) source;
 	const BYTE *const iend = ip + isize;
@@ -214,6 +289,7 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 			op += length;
 			break;/* Necessarily EOF, due to parsing restrictions */
 		}
+		LZ4_NEON_RUN(neon, ip, op, length);
 		LZ4_WILDCOPY(ip, op, cpy);
 		ip -= (op - cpy);
 		op = cpy;
@@ -277,6 +353,8 @@ static int lz4_uncompress_unknownoutputsize(const char *source, char *dest,
 				goto _output_error;
 			continue;
 		}
+		if (neon && op - ref >= LZ4_NEON_STEP)
+			LZ4_NEON_RUN(neon, ref, op, cpy - op);
 		LZ4_SECURECOPY(ref, op, cpy);
 		op = cpy; /* correction */
 	}
@@ -293,8 +371,10 @@ int lz4_decompress(const unsigned char *src, size_t *src_len,
 {
 	int ret = -1;
 	int input_len = 0;
+	bool neon = lz4_neon_begin(actual_dest_len);
 
-	input_len = lz4_uncompress(src, dest, actual_dest_len);
+	input_len = lz4_uncompress(src, dest, actual_dest_len, neon);
+	lz4_neon_end(neon);
 	if (input_len < 0)
 		goto exit_0;
 	*src_len = input_len;
@@ -312,9 +392,11 @@ int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
 {
 	int ret = -1;
 	int out_len = 0;
+	bool neon = lz4_neon_begin(*dest_len);
 
 	out_len = lz4_uncompress_unknownoutputsize(src, dest, src_len,
-					*dest_len);
+					*dest_len, neon);
+	lz4_neon_end(neon);
 	if (out_len < 0)
 		goto exit_0;
 	*dest_len = out_len;
@@ -40,6 +40,56 @@ typedef struct _U64_S { u64 v; } U64_S;
 		A16(p) = v; \
 		p += 2; \
 	} while (0)
+#elif defined(CONFIG_ARM) && __LINUX_ARM_ARCH__ >= 6 && !defined(STATIC)
+/*
+ * ARMv6+ single LDR(H)/STR(H) handle unaligned addresses, only LDM/LDRD/STRD
+ * trap.  The kernel is built with -mno-unaligned-access so get_unaligned()
+ * goes a byte at a time; issue the word accesses explicitly instead.  Not
+ * for the preboot decompressor, which may run with the MMU off.
+ */
+static inline u16 lz4_ldrh(const void *p)
+{
+	u16 v;
+
+	asm("ldrh	%0, %1" : "=r" (v) : "Q" (*(const u16 *)p));
+	return v;
+}
+
+static inline u32 lz4_ldr(const void *p)
+{
+	u32 v;
+
+	asm("ldr	%0, %1" : "=r" (v) : "Q" (*(const u32 *)p));
+	return v;
+}
+
+static inline void lz4_str(void *p, u32 v)
+{
+	asm("str	%1, %0" : "=Q" (*(u32 *)p) : "r" (v));
+}
+
+static inline void lz4_strh(void *p, u16 v)
+{
+	asm("strh	%1, %0" : "=Q" (*(u16 *)p) : "r" (v));
+}
+
+#define A64(x) get_unaligned((u64 *)&(((U16_S *)(x))->v))
+#define A32(x) lz4_ldr(x)
+#define A16(x) lz4_ldrh(x)
+
+#define PUT4(s, d) lz4_str(d, lz4_ldr(s))
+#define PUT8(s, d) \
+	put_unaligned(get_unaligned((const u64 *) s), (u64 *) d)
+
+#define LZ4_WRITE_LITTLEENDIAN_16(p, v)        \
+	do {    \
+		lz4_strh(p, v); \
+		p += 2; \
+	} while (0)
+
+#ifndef __ARMEB__
+#define LZ4_GET_LE16(p)	lz4_ldrh(p)
+#endif
 #else /* CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS */
 
 #define A64(x) get_unaligned((u64 *)&(((U16_S *)(x))->v))
@@ -140,8 +190,12 @@ typedef struct _U64_S { u64 v; } U64_S;
 
 #endif
 
+#ifndef LZ4_GET_LE16
+#define LZ4_GET_LE16(p)	get_unaligned_le16(p)
+#endif
+
 #define LZ4_READ_LITTLEENDIAN_16(d, s, p) \
-	(d = s - get_unaligned_le16(p))
+	(d = s - LZ4_GET_LE16(p))
 #define LZ4_WILDCOPY(s, d, e)	\
 	do {				\
 		LZ4_COPYPACKET(s, d);	\
@@ -0,0 +1,113 @@
+/*
+ * Benchmark of kmem_cache_alloc_bulk()/kmem_cache_free_bulk().
+ *
+ * Objects of a few sizes are allocated and freed in batches, once one at
+ * a time and once through the bulk calls, and the time per object is
+ * printed for both.  get_cycles() reads 0 on most ARM parts, so the times
+ * are in ns; with a cycle counter the cycles are printed as well.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/timex.h>
+
+#define TEST_BULK_MAX		64
+#define TEST_BULK_LOOPS		2000
+
+static void *objs[TEST_BULK_MAX];
+
+struct test_bulk_result {
+	s64 ns;
+	cycles_t cycles;
+};
+
+static int __init test_bulk_one(struct kmem_cache *s, int batch, bool bulk,
+				struct test_bulk_result *res)
+{
+	ktime_t start;
+	cycles_t c0;
+	int loop, i;
+
+	c0 = get_cycles();
+	start = ktime_get();
+	for (loop = 0; loop < TEST_BULK_LOOPS; loop++) {
+		if (bulk) {
+			if (!kmem_cache_alloc_bulk(s, GFP_KERNEL, batch, objs))
+				return -ENOMEM;
+			kmem_cache_free_bulk(s, batch, objs);
+			continue;
+		}
+		for (i = 0; i < batch; i++) {
+			objs[i] = kmem_cache_alloc(s, GFP_KERNEL);
+			if (!objs[i]) {
+				while (i--)
+					kmem_cache_free(s, objs[i]);
+				return -ENOMEM;
+			}
+		}
+		for (i = 0; i < batch; i++)
+			kmem_cache_free(s, objs[i]);
+	}
+	res->ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	res->cycles = get_cycles() - c0;
+	return 0;
+}
+
+static int __init test_bulk_size(size_t size)
+{
+	static const int batches[] = { 1, 8, 16, 32, TEST_BULK_MAX };
+	struct test_bulk_result one, bulk;
+	struct kmem_cache *s;
+	int i, ret = 0;
+
+	s = kmem_cache_create("test_kmem_bulk", size, 0, 0, NULL);
+	if (!s)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(batches); i++) {
+		u64 n = (u64)TEST_BULK_LOOPS * batches[i];
+
+		ret = test_bulk_one(s, batches[i], false, &one);
+		if (!ret)
+			ret = test_bulk_one(s, batches[i], true, &bulk);
+		if (ret)
+			break;
+
+		pr_info("test_kmem_bulk: size %4zu batch %2d single %4llu ns bulk %4llu ns per object",
+			size, batches[i], div64_u64(one.ns, n),
+			div64_u64(bulk.ns, n));
+		if (one.cycles)
+			pr_cont(", %llu/%llu cycles",
+				div64_u64(one.cycles, n),
+				div64_u64(bulk.cycles, n));
+		pr_cont("\n");
+	}
+
+	kmem_cache_destroy(s);
+	return ret;
+}
+
+static int __init test_kmem_bulk_init(void)
+{
+	static const size_t sizes[] = { 64, 256, 512, 2048 };
+	int i, ret = 0;
+
+	for (i = 0; i < ARRAY_SIZE(sizes) && !ret; i++)
+		ret = test_bulk_size(sizes[i]);
+	if (ret)
+		pr_err("test_kmem_bulk: allocation failed\n");
+
+	/* Nothing to keep loaded */
+	return ret ? ret : -EAGAIN;
+}
+module_init(test_kmem_bulk_init);
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("kmem_cache bulk allocation benchmark");
@@ -0,0 +1,205 @@
+/*
+ * Runtime check and benchmark of the LZ4 decompressor.
+ *
+ * Pages of assorted compressibility are compressed, decompressed through
+ * both entry points and compared against the original, including the
+ * bytes just past the output.  With kernel mode NEON the generic C and
+ * the NEON copy loops are both checked and timed.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/lz4.h>
+
+#define TEST_LZ4_LEN	PAGE_SIZE
+#define TEST_LZ4_GUARD	32
+#define TEST_LZ4_LOOPS	2000
+
+enum {
+	TEST_LZ4_ZERO,
+	TEST_LZ4_TEXT,
+	TEST_LZ4_RUNS,
+	TEST_LZ4_MIXED,
+	TEST_LZ4_RANDOM,
+	TEST_LZ4_NR,
+};
+
+static const char * const test_lz4_name[TEST_LZ4_NR] = {
+	"zero", "text", "runs", "mixed", "random",
+};
+
+static u8 *src, *cmp, *dst;
+static size_t cmp_len[TEST_LZ4_NR];
+static void *wrkmem;
+
+static void __init test_lz4_fill(u8 *p, int kind)
+{
+	static const char words[] __initconst =
+		"the quick brown fox jumps over the lazy dog while zram "
+		"swaps pages of a busy application back in ";
+	size_t i, j, run, off;
+	u32 r;
+
+	switch (kind) {
+	case TEST_LZ4_ZERO:
+		memset(p, 0, TEST_LZ4_LEN);
+		break;
+	case TEST_LZ4_TEXT:
+		for (i = 0; i < TEST_LZ4_LEN; i++)
+			p[i] = words[(i * 7 + i / 61) % (sizeof(words) - 1)];
+		break;
+	case TEST_LZ4_RUNS:
+		/* Matches at every short offset, the overlapping copies */
+		for (i = 0; i < TEST_LZ4_LEN; i += run) {
+			off = 1 + (i / 48) % 19;
+			run = min_t(size_t, 48 + i % 80, TEST_LZ4_LEN - i);
+			get_random_bytes(p + i, min(run, off));
+			for (j = off; j < run; j++)
+				p[i + j] = p[i + j - off];
+		}
+		break;
+	case TEST_LZ4_MIXED:
+		for (i = 0; i < TEST_LZ4_LEN; i += run) {
+			get_random_bytes(&r, sizeof(r));
+			run = min_t(size_t, 1 + (r & 127), TEST_LZ4_LEN - i);
+			if (r & 0x100)
+				get_random_bytes(p + i, run);
+			else if (i >= 256)
+				memcpy(p + i, p + i - 1 - ((r >> 9) & 255), run);
+			else
+				memset(p + i, r >> 24, run);
+		}
+		break;
+	default:
+		get_random_bytes(p, TEST_LZ4_LEN);
+		break;
+	}
+}
+
+static int __init test_lz4_check(int kind)
+{
+	u8 *in = src + kind * TEST_LZ4_LEN;
+	u8 *c = cmp + kind * LZ4_COMPRESSBOUND(TEST_LZ4_LEN);
+	size_t len, i;
+	int ret;
+
+	memset(dst, 0x5a, TEST_LZ4_LEN + TEST_LZ4_GUARD);
+	len = 0;
+	ret = lz4_decompress(c, &len, dst, TEST_LZ4_LEN);
+	if (ret || len != cmp_len[kind] || memcmp(dst, in, TEST_LZ4_LEN)) {
+		pr_err("test_lz4: %s: lz4_decompress mismatch, ret %d\n",
+				test_lz4_name[kind], ret);
+		return -EINVAL;
+	}
+
+	memset(dst, 0x5a, TEST_LZ4_LEN + TEST_LZ4_GUARD);
+	len = TEST_LZ4_LEN;
+	ret = lz4_decompress_unknownoutputsize(c, cmp_len[kind], dst, &len);
+	if (ret || len != TEST_LZ4_LEN || memcmp(dst, in, TEST_LZ4_LEN)) {
+		pr_err("test_lz4: %s: unknownoutputsize mismatch, ret %d\n",
+				test_lz4_name[kind], ret);
+		return -EINVAL;
+	}
+
+	for (i = TEST_LZ4_LEN; i < TEST_LZ4_LEN + TEST_LZ4_GUARD; i++) {
+		if (dst[i] != 0x5a) {
+			pr_err("test_lz4: %s: wrote past the output\n",
+					test_lz4_name[kind]);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static void __init test_lz4_bench(int kind, const char *impl)
+{
+	u8 *c = cmp + kind * LZ4_COMPRESSBOUND(TEST_LZ4_LEN);
+	ktime_t start;
+	s64 ns;
+	size_t len;
+	int i;
+
+	start = ktime_get();
+	for (i = 0; i < TEST_LZ4_LOOPS; i++)
+		lz4_decompress(c, &len, dst, TEST_LZ4_LEN);
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	pr_info("test_lz4: %-6s %-7s ratio %3zu%% %6lld ns/page\n",
+			test_lz4_name[kind], impl,
+			cmp_len[kind] * 100 / TEST_LZ4_LEN,
+			div_s64(ns, TEST_LZ4_LOOPS));
+}
+
+static int __init test_lz4_run(const char *impl)
+{
+	int kind;
+
+	for (kind = 0; kind < TEST_LZ4_NR; kind++) {
+		if (test_lz4_check(kind))
+			return -EINVAL;
+		test_lz4_bench(kind, impl);
+	}
+	return 0;
+}
+
+static int __init test_lz4_init(void)
+{
+	int kind;
+	int ret = -ENOMEM;
+
+	src = vmalloc(TEST_LZ4_NR * TEST_LZ4_LEN);
+	cmp = vmalloc(TEST_LZ4_NR * LZ4_COMPRESSBOUND(TEST_LZ4_LEN));
+	dst = kmalloc(TEST_LZ4_LEN + TEST_LZ4_GUARD, GFP_KERNEL);
+	wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	if (!src || !cmp || !dst || !wrkmem)
+		goto out;
+
+	for (kind = 0; kind < TEST_LZ4_NR; kind++) {
+		test_lz4_fill(src + kind * TEST_LZ4_LEN, kind);
+		ret = lz4_compress(src + kind * TEST_LZ4_LEN, TEST_LZ4_LEN,
+				cmp + kind * LZ4_COMPRESSBOUND(TEST_LZ4_LEN),
+				&cmp_len[kind], wrkmem);
+		if (ret) {
+			pr_err("test_lz4: %s: compress failed %d\n",
+					test_lz4_name[kind], ret);
+			goto out;
+		}
+	}
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+	{
+		bool neon = lz4_decompress_neon;
+
+		lz4_decompress_neon = false;
+		ret = test_lz4_run("generic");
+		lz4_decompress_neon = true;
+		if (!ret)
+			ret = test_lz4_run("neon");
+		lz4_decompress_neon = neon;
+	}
+#else
+	ret = test_lz4_run("generic");
+#endif
+	if (!ret)
+		pr_info("test_lz4: all tests passed\n");
+out:
+	vfree(wrkmem);
+	kfree(dst);
+	vfree(cmp);
+	vfree(src);
+	/* Nothing to keep loaded */
+	return ret ? ret : -EAGAIN;
+}
+module_init(test_lz4_init);
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 decompressor test and benchmark");
@@ -14,6 +14,8 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 #include "internal.h"
 
 #if defined CONFIG_COMPACTION || defined CONFIG_CMA
@@ -429,6 +431,9 @@ static int compact_finished(struct zone *zone,
 	if (fatal_signal_pending(current))
 		return COMPACT_PARTIAL;
 
+	if (cc->deadline && time_after(jiffies, cc->deadline))
+		return COMPACT_PARTIAL;
+
 	
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
@@ -437,12 +442,16 @@ static int compact_finished(struct zone *zone,
 		return COMPACT_CONTINUE;
 
 	
-	watermark = low_wmark_pages(zone);
+	watermark = cc->proactive ? high_wmark_pages(zone) :
+				    low_wmark_pages(zone);
 	watermark += (1 << cc->order);
 
 	if (!zone_watermark_ok(zone, cc->order, watermark, 0, 0))
 		return COMPACT_CONTINUE;
 
+	if (cc->proactive)
+		return COMPACT_PARTIAL;
+
 	
 	for (order = cc->order; order < MAX_ORDER; order++) {
 		
@@ -484,7 +493,9 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 {
 	int ret;
 
-	ret = compaction_suitable(zone, cc->order);
+	/* kcompactd has already applied its own threshold */
+	ret = cc->proactive ? COMPACT_CONTINUE :
+			      compaction_suitable(zone, cc->order);
 	switch (ret) {
 	case COMPACT_PARTIAL:
 	case COMPACT_SKIPPED:
@@ -500,6 +511,14 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 	cc->free_pfn = cc->migrate_pfn + zone->spanned_pages;
 	cc->free_pfn &= ~(pageblock_nr_pages-1);
 
+	/* Resume where the last budget ran out, if still within the zone */
+	if (cc->proactive && zone->kcompactd_migrate_pfn >= cc->migrate_pfn &&
+	    zone->kcompactd_migrate_pfn < zone->kcompactd_free_pfn &&
+	    zone->kcompactd_free_pfn <= cc->free_pfn) {
+		cc->migrate_pfn = zone->kcompactd_migrate_pfn;
+		cc->free_pfn = zone->kcompactd_free_pfn;
+	}
+
 	migrate_prep_local();
 
 	while ((ret = compact_finished(zone, cc)) == COMPACT_CONTINUE) {
@@ -546,6 +565,16 @@ out:
 	cc->nr_freepages -= release_freepages(&cc->freepages);
 	VM_BUG_ON(cc->nr_freepages != 0);
 
+	if (cc->proactive) {
+		if (ret == COMPACT_COMPLETE) {
+			zone->kcompactd_migrate_pfn = 0;
+			zone->kcompactd_free_pfn = 0;
+		} else {
+			zone->kcompactd_migrate_pfn = cc->migrate_pfn;
+			zone->kcompactd_free_pfn = cc->free_pfn;
+		}
+	}
+
 	return ret;
 }
 
@@ -672,6 +701,172 @@ static int compact_nodes(void)
 	return COMPACT_COMPLETE;
 }
 
+/*
+ * kcompactd: compacts each node's zones in the background while the
+ * fragmentation index for sysctl_kcompactd_order is above its threshold
+ * and the zone is short of high watermark at that order.  A run stops when
+ * the target is met or after sysctl_kcompactd_budget_ms, and the next one
+ * is at least sysctl_kcompactd_interval_ms later, so the daemon uses at most
+ * budget/interval of a CPU.  Order 0 disables it.
+ */
+int sysctl_kcompactd_order = 3;
+int sysctl_kcompactd_extfrag_threshold = 500;
+int sysctl_kcompactd_interval_ms = 500;
+int sysctl_kcompactd_budget_ms = 10;
+
+#define KCOMPACTD_MAX_BACKOFF	3
+
+enum {
+	KCOMPACTD_IDLE,		/* no zone needed work */
+	KCOMPACTD_DONE,		/* targets met */
+	KCOMPACTD_STUCK,	/* a full scan did not reach the target */
+	KCOMPACTD_MORE,		/* out of budget */
+};
+
+static bool kcompactd_zone_needs(struct zone *zone, int order)
+{
+	unsigned long watermark;
+
+	if (zone_watermark_ok(zone, order, high_wmark_pages(zone), 0, 0))
+		return false;
+	zone->kcompactd_ready_order = 0;
+
+	/* Short of order-0 pages is reclaim's business */
+	watermark = low_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	return fragmentation_index(zone, order) >
+		sysctl_kcompactd_extfrag_threshold;
+}
+
+static int kcompactd_do_work(pg_data_t *pgdat)
+{
+	int order = sysctl_kcompactd_order;
+	unsigned long deadline;
+	int zoneid, ret = KCOMPACTD_IDLE;
+
+	if (order <= 0)
+		return ret;
+
+	deadline = jiffies +
+		max(1UL, msecs_to_jiffies(sysctl_kcompactd_budget_ms));
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.order = order,
+			.migratetype = MIGRATE_UNMOVABLE,
+			.zone = zone,
+			.sync = false,
+			.proactive = true,
+			.deadline = deadline,
+		};
+		int status;
+
+		if (!populated_zone(zone))
+			continue;
+		if (!kcompactd_zone_needs(zone, order))
+			continue;
+		if (time_after(jiffies, deadline))
+			return KCOMPACTD_MORE;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		count_vm_event(KCOMPACTD_RUN);
+		status = compact_zone(zone, &cc);
+
+		if (zone_watermark_ok(zone, order, high_wmark_pages(zone),
+				      0, 0)) {
+			zone->kcompactd_ready_order = order;
+			count_vm_event(KCOMPACTD_SUCCESS);
+			ret = max(ret, (int)KCOMPACTD_DONE);
+		} else if (status == COMPACT_COMPLETE) {
+			ret = max(ret, (int)KCOMPACTD_STUCK);
+		} else {
+			ret = KCOMPACTD_MORE;
+		}
+	}
+
+	return ret;
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	unsigned int backoff = 0;
+	int ret = KCOMPACTD_IDLE;
+
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		long timeout;
+
+		timeout = msecs_to_jiffies(sysctl_kcompactd_interval_ms);
+		timeout <<= backoff;
+
+		/* Wakeups are only taken when idle so the budget holds */
+		if (ret == KCOMPACTD_IDLE)
+			wait_event_freezable_timeout(pgdat->kcompactd_wait,
+					pgdat->kcompactd_wake ||
+					kthread_should_stop(), timeout);
+		else
+			wait_event_freezable_timeout(pgdat->kcompactd_wait,
+					kthread_should_stop(), timeout);
+		pgdat->kcompactd_wake = false;
+		if (kthread_should_stop())
+			break;
+
+		ret = kcompactd_do_work(pgdat);
+		if (ret == KCOMPACTD_STUCK)
+			backoff = min_t(unsigned int, backoff + 1,
+					KCOMPACTD_MAX_BACKOFF);
+		else
+			backoff = 0;
+	}
+
+	return 0;
+}
+
+/* Called from the allocator slow path */
+void wakeup_kcompactd(pg_data_t *pgdat, int order)
+{
+	if (!order || order > sysctl_kcompactd_order || !pgdat->kcompactd)
+		return;
+	if (!waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	pgdat->kcompactd_wake = true;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+int kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int ret = 0;
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		pr_err("Failed to start kcompactd on node %d\n", nid);
+		ret = PTR_ERR(pgdat->kcompactd);
+		pgdat->kcompactd = NULL;
+	}
+	return ret;
+}
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run(nid);
+	return 0;
+}
+module_init(kcompactd_init);
+
 /* The written value is actually unused, all memory is compacted */
 int sysctl_compact_memory;
 
@@ -31,6 +31,9 @@
 #include <linux/cleancache.h>
 #include "internal.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/filemap.h>
+
 #include <linux/buffer_head.h> 
 
 #include <asm/mman.h>
@@ -330,8 +333,12 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 	int ret;
 
 	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
-	if (ret == 0)
-		lru_cache_add_file(page);
+	if (ret == 0) {
+		if (workingset_refault(mapping, offset))
+			__lru_cache_add(page, LRU_ACTIVE_FILE);
+		else
+			lru_cache_add_file(page);
+	}
 	return ret;
 }
 EXPORT_SYMBOL_GPL(add_to_page_cache_lru);
@@ -746,6 +753,7 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 find_page:
 		page = find_get_page(mapping, index);
 		if (!page) {
+			trace_mm_filemap_read(mapping, index);
 			page_cache_sync_readahead(mapping,
 					ra, filp,
 					index, last_index - index);
@@ -1174,7 +1182,7 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	if (likely(page)) {
 		do_async_mmap_readahead(vma, ra, file, page, offset);
 	} else {
-		
+		trace_mm_filemap_fault(mapping, offset);
 		do_sync_mmap_readahead(vma, ra, file, offset);
 		count_vm_event(PGMAJFAULT);
 		mem_cgroup_count_vm_event(vma->vm_mm, PGMAJFAULT);
@@ -1780,7 +1788,11 @@ again:
 		pagefault_enable();
 		flush_dcache_page(page);
 
-		mark_page_accessed(page);
+		/* end_page_writeback() rotates PG_reclaim pages to the tail */
+		if (unlikely(file->f_mode & FMODE_NOREUSE))
+			SetPageReclaim(page);
+		else
+			mark_page_accessed(page);
 		status = a_ops->write_end(file, mapping, pos, bytes, copied,
 						page, fsdata);
 		if (unlikely(status < 0))
@@ -75,6 +75,8 @@ struct compact_control {
 	unsigned long free_pfn;		
 	unsigned long migrate_pfn;	
 	bool sync;			
+	bool proactive;			/* kcompactd: resume, high wmark */
+	unsigned long deadline;		/* jiffies, 0 for none */
 
 	int order;			
 	int migratetype;		
@@ -89,6 +91,21 @@ isolate_migratepages_range(struct zone *zone, struct compact_control *cc,
 
 #endif
 
+#ifdef CONFIG_COMPACTION
+/* First high-order allocation from a zone kcompactd brought to target */
+static inline void kcompactd_note_alloc(struct zone *zone, int order)
+{
+	if (unlikely(order && order <= zone->kcompactd_ready_order)) {
+		zone->kcompactd_ready_order = 0;
+		count_vm_event(KCOMPACTD_AVOIDED);
+	}
+}
+#else
+static inline void kcompactd_note_alloc(struct zone *zone, int order)
+{
+}
+#endif
+
 static inline unsigned long page_order(struct page *page)
 {
 	
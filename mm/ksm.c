@@ -36,6 +36,8 @@
 #include <linux/hash.h>
 #include <linux/freezer.h>
 #include <linux/oom.h>
+#include <linux/list_sort.h>
+#include <linux/ktime.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -86,12 +88,14 @@
  * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @oom_score_adj: highest oom_score_adj of its users, at the last full scan
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	int oom_score_adj;
 };
 
 /**
@@ -189,6 +193,15 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Percentage of one CPU ksmd may use, 0 for sleep_millisecs alone */
+static unsigned int ksm_thread_cpu_budget;
+
+/* mms whose users all sit below this oom_score_adj are not scanned */
+static int ksm_scan_min_adj = OOM_SCORE_ADJ_MIN;
+
+/* Checksum a sample of each page's words rather than all of them */
+static unsigned int ksm_sampled_checksum = 1;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -673,11 +686,28 @@ error:
 }
 #endif /* CONFIG_SYSFS */
 
+/* One word from each 64 byte line, at an offset that moves line to line */
+#define KSM_SAMPLE_WORDS	(PAGE_SIZE / 64)
+
+/*
+ * The checksum only decides whether a page looks stable enough for the
+ * unstable tree: merging always compares the whole page, so a sample
+ * that misses a change costs at worst a wasted tree search.
+ */
 static u32 calc_checksum(struct page *page)
 {
+	u32 sample[KSM_SAMPLE_WORDS];
 	u32 checksum;
-	void *addr = kmap_atomic(page);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	u32 *addr = kmap_atomic(page);
+	int i;
+
+	if (ksm_sampled_checksum) {
+		for (i = 0; i < KSM_SAMPLE_WORDS; i++)
+			sample[i] = addr[i * 16 + ((i * 7) & 15)];
+		checksum = jhash2(sample, KSM_SAMPLE_WORDS, 17);
+	} else {
+		checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	}
 	kunmap_atomic(addr);
 	return checksum;
 }
@@ -1276,6 +1306,66 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+static int mm_slot_cmp(void *priv, struct list_head *a, struct list_head *b)
+{
+	struct mm_slot *slot_a = list_entry(a, struct mm_slot, mm_list);
+	struct mm_slot *slot_b = list_entry(b, struct mm_slot, mm_list);
+
+	return slot_b->oom_score_adj - slot_a->oom_score_adj;
+}
+
+/*
+ * Order the mm_slots by the highest oom_score_adj among their users, so
+ * that background processes are scanned before those in the foreground.
+ * Called with the cursor at ksm_mm_head, at the start of a full scan.
+ */
+static void rank_mm_slots(void)
+{
+	struct task_struct *p;
+	struct mm_struct *mm;
+	struct mm_slot *slot;
+	int adj;
+
+	spin_lock(&ksm_mmlist_lock);
+	list_for_each_entry(slot, &ksm_mm_head.mm_list, mm_list)
+		slot->oom_score_adj = OOM_SCORE_ADJ_MIN;
+	spin_unlock(&ksm_mmlist_lock);
+
+	rcu_read_lock();
+	for_each_process(p) {
+		task_lock(p);
+		mm = p->mm;
+		if (mm && test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
+			adj = p->signal->oom_score_adj;
+			spin_lock(&ksm_mmlist_lock);
+			slot = get_mm_slot(mm);
+			if (slot && slot->oom_score_adj < adj)
+				slot->oom_score_adj = adj;
+			spin_unlock(&ksm_mmlist_lock);
+		}
+		task_unlock(p);
+	}
+	rcu_read_unlock();
+
+	spin_lock(&ksm_mmlist_lock);
+	list_sort(NULL, &ksm_mm_head.mm_list, mm_slot_cmp);
+	spin_unlock(&ksm_mmlist_lock);
+}
+
+/*
+ * An mm passed over for a whole scan must not keep rmap_items in the
+ * unstable tree: they would be two scans old when next looked at.
+ */
+static void skip_mm_slot(struct mm_slot *slot)
+{
+	struct rmap_item *rmap_item;
+
+	for (rmap_item = slot->rmap_list; rmap_item;
+	     rmap_item = rmap_item->rmap_list)
+		if (rmap_item->address & UNSTABLE_FLAG)
+			remove_rmap_item_from_tree(rmap_item);
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1302,6 +1392,8 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 
 		root_unstable_tree = RB_ROOT;
 
+		rank_mm_slots();
+
 		spin_lock(&ksm_mmlist_lock);
 		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
 		ksm_scan.mm_slot = slot;
@@ -1318,6 +1410,22 @@ next_mm:
 	}
 
 	mm = slot->mm;
+	if (slot->oom_score_adj < ksm_scan_min_adj && !ksm_test_exit(mm)) {
+		skip_mm_slot(slot);
+
+		spin_lock(&ksm_mmlist_lock);
+		ksm_scan.mm_slot = list_entry(slot->mm_list.next,
+						struct mm_slot, mm_list);
+		spin_unlock(&ksm_mmlist_lock);
+
+		slot = ksm_scan.mm_slot;
+		if (slot != &ksm_mm_head)
+			goto next_mm;
+
+		ksm_scan.seqnr++;
+		return NULL;
+	}
+
 	down_read(&mm->mmap_sem);
 	if (ksm_test_exit(mm))
 		vma = NULL;
@@ -1432,22 +1540,45 @@ static int ksmd_should_run(void)
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+/*
+ * Sleep at least sleep_millisecs, and long enough after a batch that
+ * took @ran_us to keep ksmd within cpu_budget percent of a CPU.
+ */
+static unsigned long ksm_sleep_jiffies(s64 ran_us)
+{
+	unsigned long timeout = msecs_to_jiffies(ksm_thread_sleep_millisecs);
+	unsigned int budget = ksm_thread_cpu_budget;
+	u64 sleep_us;
+
+	if (!budget || budget >= 100 || ran_us <= 0)
+		return timeout;
+
+	sleep_us = div_u64((u64)ran_us * (100 - budget), budget);
+	return max(timeout, usecs_to_jiffies(min_t(u64, sleep_us, UINT_MAX)));
+}
+
 static int ksm_scan_thread(void *nothing)
 {
+	ktime_t start;
+	s64 ran_us;
+
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
+		ran_us = 0;
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
+		if (ksmd_should_run()) {
+			start = ktime_get();
 			ksm_do_scan(ksm_thread_pages_to_scan);
+			ran_us = ktime_us_delta(ktime_get(), start);
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
-			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+			schedule_timeout_interruptible(ksm_sleep_jiffies(ran_us));
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1876,6 +2007,75 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t cpu_budget_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_thread_cpu_budget);
+}
+
+static ssize_t cpu_budget_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long budget;
+	int err;
+
+	err = strict_strtoul(buf, 10, &budget);
+	if (err || budget > 100)
+		return -EINVAL;
+
+	ksm_thread_cpu_budget = budget;
+
+	return count;
+}
+KSM_ATTR(cpu_budget);
+
+static ssize_t scan_min_adj_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", ksm_scan_min_adj);
+}
+
+static ssize_t scan_min_adj_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	long adj;
+	int err;
+
+	err = strict_strtol(buf, 10, &adj);
+	if (err || adj < OOM_SCORE_ADJ_MIN || adj > OOM_SCORE_ADJ_MAX)
+		return -EINVAL;
+
+	ksm_scan_min_adj = adj;
+
+	return count;
+}
+KSM_ATTR(scan_min_adj);
+
+static ssize_t sampled_checksum_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_sampled_checksum);
+}
+
+static ssize_t sampled_checksum_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > 1)
+		return -EINVAL;
+
+	ksm_sampled_checksum = val;
+
+	return count;
+}
+KSM_ATTR(sampled_checksum);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -1974,6 +2174,9 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&cpu_budget_attr.attr,
+	&scan_min_adj_attr.attr,
+	&sampled_checksum_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
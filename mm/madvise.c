@@ -28,6 +28,34 @@ static int madvise_need_mmap_write(int behavior)
 	}
 }
 
+#ifdef CONFIG_ANON_LARGE_PAGES
+#define VM_NO_ANON_LARGE (VM_SPECIAL|VM_INSERTPAGE|VM_MIXEDMAP|VM_SAO| \
+			  VM_HUGETLB|VM_SHARED|VM_MAYSHARE)
+
+/* Same rules as hugepage_madvise(), the fault path does the rest */
+static int anon_large_madvise(unsigned long *vm_flags, int advice)
+{
+	if (*vm_flags & VM_NO_ANON_LARGE)
+		return -EINVAL;
+
+	switch (advice) {
+	case MADV_HUGEPAGE:
+		if (*vm_flags & VM_HUGEPAGE)
+			return -EINVAL;
+		*vm_flags &= ~VM_NOHUGEPAGE;
+		*vm_flags |= VM_HUGEPAGE;
+		break;
+	case MADV_NOHUGEPAGE:
+		if (*vm_flags & VM_NOHUGEPAGE)
+			return -EINVAL;
+		*vm_flags &= ~VM_HUGEPAGE;
+		*vm_flags |= VM_NOHUGEPAGE;
+		break;
+	}
+	return 0;
+}
+#endif
+
 static long madvise_behavior(struct vm_area_struct * vma,
 		     struct vm_area_struct **prev,
 		     unsigned long start, unsigned long end, int behavior)
@@ -71,7 +99,11 @@ static long madvise_behavior(struct vm_area_struct * vma,
 		break;
 	case MADV_HUGEPAGE:
 	case MADV_NOHUGEPAGE:
+#ifdef CONFIG_ANON_LARGE_PAGES
+		error = anon_large_madvise(&new_flags, behavior);
+#else
 		error = hugepage_madvise(vma, &new_flags, behavior);
+#endif
 		if (error)
 			goto out;
 		break;
@@ -255,7 +287,7 @@ madvise_behavior_valid(int behavior)
 	case MADV_MERGEABLE:
 	case MADV_UNMERGEABLE:
 #endif
-#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#if defined(CONFIG_TRANSPARENT_HUGEPAGE) || defined(CONFIG_ANON_LARGE_PAGES)
 	case MADV_HUGEPAGE:
 	case MADV_NOHUGEPAGE:
 #endif
@@ -626,6 +626,21 @@ out:
 	return pfn_to_page(pfn);
 }
 
+/*
+ * A fork template (zygote) does not hand its page cache ptes in private
+ * file mappings to the child: they are clean and refault on first touch
+ * just as after reclaim unmapped them.  Only the anon ptes are copied.
+ */
+static inline bool fork_skip_pte(struct mm_struct *src_mm,
+				 struct vm_area_struct *vma, struct page *page)
+{
+	if (!test_bit(MMF_FORK_TEMPLATE, &src_mm->flags))
+		return false;
+	if (!vma->vm_file || (vma->vm_flags & (VM_SHARED | VM_NONLINEAR |
+			      VM_PFNMAP | VM_MIXEDMAP | VM_INSERTPAGE)))
+		return false;
+	return !PageAnon(page) && page->mapping == vma->vm_file->f_mapping;
+}
 
 static inline unsigned long
 copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
@@ -673,6 +688,10 @@ copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		goto out_set_pte;
 	}
 
+	page = vm_normal_page(vma, addr, pte);
+	if (page && fork_skip_pte(src_mm, vma, page))
+		return 0;
+
 	if (is_cow_mapping(vm_flags)) {
 		ptep_set_wrprotect(src_mm, addr, src_pte);
 		pte = pte_wrprotect(pte);
@@ -682,7 +701,6 @@ copy_one_pte(struct mm_struct *dst_mm, struct mm_struct *src_mm,
 		pte = pte_mkclean(pte);
 	pte = pte_mkold(pte);
 
-	page = vm_normal_page(vma, addr, pte);
 	if (page) {
 		get_page(page);
 		page_dup_rmap(page);
@@ -1092,6 +1110,7 @@ void zap_page_range(struct vm_area_struct *vma, unsigned long address,
 	unmap_vmas(&tlb, vma, address, end, &nr_accounted, details);
 	tlb_finish_mmu(&tlb, address, end);
 }
+EXPORT_SYMBOL_GPL(zap_page_range);
 
 static void zap_page_range_single(struct vm_area_struct *vma, unsigned long address,
 		unsigned long size, struct zap_details *details)
@@ -2239,7 +2258,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	page = lookup_swap_cache(entry);
 	if (!page) {
 		grab_swap_token(mm); 
-		page = swapin_readahead(entry,
+		page = swapin_readahead_vma(entry,
 					GFP_HIGHUSER_MOVABLE, vma, address);
 		if (!page) {
 			page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
@@ -2370,6 +2389,105 @@ static inline int check_stack_guard_page(struct vm_area_struct *vma, unsigned lo
 	return 0;
 }
 
+#ifdef CONFIG_ANON_LARGE_PAGES
+#define ANON_LARGE_ORDER	4
+#define ANON_LARGE_NR		(1 << ANON_LARGE_ORDER)
+#define ANON_LARGE_SIZE		(PAGE_SIZE << ANON_LARGE_ORDER)
+
+static bool anon_large_ptes_none(pte_t *pte)
+{
+	int i;
+
+	for (i = 0; i < ANON_LARGE_NR; i++)
+		if (!pte_none(pte[i]))
+			return false;
+	return true;
+}
+
+/*
+ * Fill the whole aligned 64K block around @address in a MADV_HUGEPAGE vma
+ * from one order-4 allocation.  Nothing is reclaimed or compacted for it:
+ * when no such block is free the caller maps the single page as usual.
+ * Returns -EAGAIN for that, else 0 or VM_FAULT_OOM.
+ */
+static int do_anonymous_large(struct mm_struct *mm, struct vm_area_struct *vma,
+			      unsigned long address, pmd_t *pmd)
+{
+	unsigned long start = address & ~(ANON_LARGE_SIZE - 1);
+	gfp_t gfp = (GFP_HIGHUSER_MOVABLE | __GFP_NOMEMALLOC | __GFP_NORETRY |
+		     __GFP_NOWARN | __GFP_NO_KSWAPD) & ~__GFP_WAIT;
+	struct page *page;
+	spinlock_t *ptl;
+	pte_t *pte;
+	bool none;
+	int i, charged = 0;
+
+	if (!(vma->vm_flags & VM_HUGEPAGE) || start < vma->vm_start ||
+	    start + ANON_LARGE_SIZE > vma->vm_end)
+		return -EAGAIN;
+
+	pte = pte_offset_map(pmd, start);
+	none = anon_large_ptes_none(pte);
+	pte_unmap(pte);
+	if (!none)
+		return -EAGAIN;
+
+	if (unlikely(anon_vma_prepare(vma)))
+		return VM_FAULT_OOM;
+	page = alloc_pages_vma(gfp, ANON_LARGE_ORDER, vma, start,
+			       numa_node_id());
+	if (!page) {
+		count_vm_event(ANON_LARGE_FAULT_FALLBACK);
+		return -EAGAIN;
+	}
+	split_page(page, ANON_LARGE_ORDER);
+
+	for (i = 0; i < ANON_LARGE_NR; i++) {
+		clear_user_highpage(page + i, start + i * PAGE_SIZE);
+		__SetPageUptodate(page + i);
+	}
+	for (; charged < ANON_LARGE_NR; charged++)
+		if (mem_cgroup_newpage_charge(page + charged, mm, GFP_KERNEL))
+			goto release;
+
+	pte = pte_offset_map_lock(mm, pmd, start, &ptl);
+	if (!anon_large_ptes_none(pte)) {
+		pte_unmap_unlock(pte, ptl);
+		goto release;
+	}
+	for (i = 0; i < ANON_LARGE_NR; i++) {
+		unsigned long addr = start + i * PAGE_SIZE;
+		pte_t entry = mk_pte(page + i, vma->vm_page_prot);
+
+		if (vma->vm_flags & VM_WRITE)
+			entry = pte_mkwrite(pte_mkdirty(entry));
+		page_add_new_anon_rmap(page + i, vma, addr);
+		set_pte_at(mm, addr, pte + i, entry);
+		update_mmu_cache(vma, addr, pte + i);
+	}
+	add_mm_counter(mm, MM_ANONPAGES, ANON_LARGE_NR);
+	pte_unmap_unlock(pte, ptl);
+	count_vm_event(ANON_LARGE_FAULT_ALLOC);
+	return 0;
+
+release:
+	for (i = 0; i < ANON_LARGE_NR; i++) {
+		if (i < charged)
+			mem_cgroup_uncharge_page(page + i);
+		page_cache_release(page + i);
+	}
+	count_vm_event(ANON_LARGE_FAULT_FALLBACK);
+	return -EAGAIN;
+}
+#else
+static inline int do_anonymous_large(struct mm_struct *mm,
+				     struct vm_area_struct *vma,
+				     unsigned long address, pmd_t *pmd)
+{
+	return -EAGAIN;
+}
+#endif
+
 static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		unsigned long address, pte_t *page_table, pmd_t *pmd,
 		unsigned int flags)
@@ -2377,6 +2495,7 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	struct page *page;
 	spinlock_t *ptl;
 	pte_t entry;
+	int ret;
 
 	pte_unmap(page_table);
 
@@ -2394,7 +2513,10 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 		goto setpte;
 	}
 
-	
+	ret = do_anonymous_large(mm, vma, address, pmd);
+	if (ret != -EAGAIN)
+		return ret;
+
 	if (unlikely(anon_vma_prepare(vma)))
 		goto oom;
 	page = alloc_zeroed_user_highpage_movable(vma, address);
@@ -44,6 +44,9 @@ int sysctl_oom_kill_allocating_task;
 int sysctl_oom_dump_tasks = 1;
 static DEFINE_SPINLOCK(zone_scan_lock);
 
+unsigned long (*oom_driver_pages)(pid_t tgid);
+EXPORT_SYMBOL_GPL(oom_driver_pages);
+
 extern void show_meminfo(void);
 
 void compare_swap_oom_score_adj(int old_val, int new_val)
@@ -54,6 +57,7 @@ void compare_swap_oom_score_adj(int old_val, int new_val)
 	if (current->signal->oom_score_adj == old_val)
 		current->signal->oom_score_adj = new_val;
 	trace_oom_score_adj_update(current);
+	lowmem_adj_update(current);
 	spin_unlock_irq(&sighand->siglock);
 }
 
@@ -66,6 +70,7 @@ int test_set_oom_score_adj(int new_val)
 	old_val = current->signal->oom_score_adj;
 	current->signal->oom_score_adj = new_val;
 	trace_oom_score_adj_update(current);
+	lowmem_adj_update(current);
 	spin_unlock_irq(&sighand->siglock);
 
 	return old_val;
@@ -495,8 +495,8 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
-static void free_pcppages_bulk(struct zone *zone, int count,
-					struct per_cpu_pages *pcp)
+static void __free_pcppages_bulk(struct zone *zone, int count,
+				 struct list_head *lists, unsigned int order)
 {
 	int migratetype = 0;
 	int batch_free = 0;
@@ -514,7 +514,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 			batch_free++;
 			if (++migratetype == MIGRATE_PCPTYPES)
 				migratetype = 0;
-			list = &pcp->lists[migratetype];
+			list = &lists[migratetype];
 		} while (list_empty(list));
 
 		
@@ -526,14 +526,21 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 			
 			list_del(&page->lru);
 			
-			__free_one_page(page, zone, 0, page_private(page));
-			trace_mm_page_pcpu_drain(page, 0, page_private(page));
+			__free_one_page(page, zone, order, page_private(page));
+			trace_mm_page_pcpu_drain(page, order,
+						 page_private(page));
 		} while (--to_free && --batch_free && !list_empty(list));
 	}
-	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
+	__mod_zone_page_state(zone, NR_FREE_PAGES, count << order);
 	spin_unlock(&zone->lock);
 }
 
+static inline void free_pcppages_bulk(struct zone *zone, int count,
+				      struct per_cpu_pages *pcp)
+{
+	__free_pcppages_bulk(zone, count, pcp->lists, 0);
+}
+
 static void free_one_page(struct zone *zone, struct page *page, int order,
 				int migratetype)
 {
@@ -572,6 +579,28 @@ static bool free_pages_prepare(struct page *page, unsigned int order)
 	return true;
 }
 
+/* Called with interrupts disabled */
+static void free_pcp_order_page(struct zone *zone, struct page *page,
+				unsigned int order, int migratetype)
+{
+	struct per_cpu_order_pages *pco;
+
+	pco = &this_cpu_ptr(zone->pageset)->pcp.orders[order - 1];
+	if (!pco->high || migratetype == MIGRATE_ISOLATE) {
+		free_one_page(zone, page, order, migratetype);
+		return;
+	}
+
+	set_page_private(page, migratetype);
+	if (migratetype >= MIGRATE_PCPTYPES)
+		migratetype = MIGRATE_MOVABLE;
+	list_add(&page->lru, &pco->lists[migratetype]);
+	if (++pco->count >= pco->high) {
+		__free_pcppages_bulk(zone, pco->batch, pco->lists, order);
+		pco->count -= pco->batch;
+	}
+}
+
 static void __free_pages_ok(struct page *page, unsigned int order)
 {
 	unsigned long flags;
@@ -584,8 +613,12 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
-					get_pageblock_migratetype(page));
+	if (order <= PCP_HIGH_ORDER)
+		free_pcp_order_page(page_zone(page), page, order,
+				    get_pageblock_migratetype(page));
+	else
+		free_one_page(page_zone(page), page, order,
+			      get_pageblock_migratetype(page));
 	local_irq_restore(flags);
 }
 
@@ -934,6 +967,33 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 }
 #endif
 
+static void drain_pcp_orders(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int i;
+
+	for (i = 0; i < PCP_HIGH_ORDER; i++) {
+		struct per_cpu_order_pages *pco = &pcp->orders[i];
+
+		if (pco->count) {
+			__free_pcppages_bulk(zone, pco->count, pco->lists,
+					     i + 1);
+			pco->count = 0;
+		}
+	}
+}
+
+static bool pcp_has_pages(struct per_cpu_pages *pcp)
+{
+	int i;
+
+	if (pcp->count)
+		return true;
+	for (i = 0; i < PCP_HIGH_ORDER; i++)
+		if (pcp->orders[i].count)
+			return true;
+	return false;
+}
+
 static void drain_pages(unsigned int cpu)
 {
 	unsigned long flags;
@@ -951,6 +1011,7 @@ static void drain_pages(unsigned int cpu)
 			free_pcppages_bulk(zone, pcp->count, pcp);
 			pcp->count = 0;
 		}
+		drain_pcp_orders(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -972,7 +1033,7 @@ void drain_all_pages(void)
 		bool has_pcps = false;
 		for_each_populated_zone(zone) {
 			pcp = per_cpu_ptr(zone->pageset, cpu);
-			if (pcp->pcp.count) {
+			if (pcp_has_pages(&pcp->pcp)) {
 				has_pcps = true;
 				break;
 			}
@@ -1127,6 +1188,46 @@ int split_free_page(struct page *page)
 	return 1 << order;
 }
 
+/* Called with interrupts disabled */
+static struct page *rmqueue_pcp_order(struct zone *zone, unsigned int order,
+				      int migratetype, int cold)
+{
+	struct per_cpu_order_pages *pco;
+	struct list_head *list;
+	struct page *page;
+
+	pco = &this_cpu_ptr(zone->pageset)->pcp.orders[order - 1];
+	if (unlikely(!pco->high)) {
+		spin_lock(&zone->lock);
+		page = __rmqueue(zone, order, migratetype);
+		spin_unlock(&zone->lock);
+		if (page)
+			__mod_zone_page_state(zone, NR_FREE_PAGES,
+					      -(1 << order));
+		return page;
+	}
+
+	list = &pco->lists[migratetype];
+	if (list_empty(list)) {
+		pco->miss++;
+		pco->count += rmqueue_bulk(zone, order, pco->batch, list,
+					   migratetype, cold);
+		if (unlikely(list_empty(list)))
+			return NULL;
+	} else {
+		pco->hit++;
+	}
+
+	if (cold)
+		page = list_entry(list->prev, struct page, lru);
+	else
+		page = list_entry(list->next, struct page, lru);
+
+	list_del(&page->lru);
+	pco->count--;
+	return page;
+}
+
 static inline
 struct page *buffered_rmqueue(struct zone *preferred_zone,
 			struct zone *zone, int order, gfp_t gfp_flags,
@@ -1159,6 +1260,11 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
+	} else if (order <= PCP_HIGH_ORDER) {
+		local_irq_save(flags);
+		page = rmqueue_pcp_order(zone, order, migratetype, cold);
+		if (!page)
+			goto failed;
 	} else {
 		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
 			WARN_ON_ONCE(order > 1);
@@ -1476,8 +1582,10 @@ zonelist_scan:
 try_this_zone:
 		page = buffered_rmqueue(preferred_zone, zone, order,
 						gfp_mask, migratetype);
-		if (page)
+		if (page) {
+			kcompactd_note_alloc(zone, order);
 			break;
+		}
 this_zone_full:
 		if (NUMA_BUILD)
 			zlc_mark_zone_full(zonelist, z);
@@ -1760,8 +1868,10 @@ void wake_all_kswapd(unsigned int order, struct zonelist *zonelist,
 	struct zoneref *z;
 	struct zone *zone;
 
-	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx)
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx) {
 		wakeup_kswapd(zone, order, classzone_idx);
+		wakeup_kcompactd(zone->zone_pgdat, order);
+	}
 }
 
 static inline int
@@ -2915,7 +3025,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int migratetype, order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -2925,6 +3035,17 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+
+	/* Roughly batch pages per order, half the order-0 cache in all */
+	for (order = 1; order <= PCP_HIGH_ORDER; order++) {
+		struct per_cpu_order_pages *pco = &pcp->orders[order - 1];
+
+		pco->batch = max(1UL, batch >> (order + 1));
+		pco->high = batch ? 2 * pco->batch : 0;
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++)
+			INIT_LIST_HEAD(&pco->lists[migratetype]);
+	}
 }
 
 
@@ -3010,6 +3131,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		drain_pcp_orders(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -3355,6 +3477,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 
 	for (j = 0; j < MAX_NR_ZONES; j++) {
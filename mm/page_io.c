@@ -19,14 +19,18 @@
 #include <linux/swapops.h>
 #include <linux/writeback.h>
 #include <linux/frontswap.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <asm/pgtable.h>
 
-static struct bio *get_swap_bio(gfp_t gfp_flags,
-				struct page *page, bio_end_io_t end_io)
+#define SWAP_BATCH_PAGES	16
+
+static struct bio *get_swap_bio(gfp_t gfp_flags, struct page *page,
+				bio_end_io_t end_io, int nr_vecs)
 {
 	struct bio *bio;
 
-	bio = bio_alloc(gfp_flags, 1);
+	bio = bio_alloc(gfp_flags, nr_vecs);
 	if (bio) {
 		bio->bi_sector = map_swap_page(page, &bio->bi_bdev);
 		bio->bi_sector <<= PAGE_SHIFT - 9;
@@ -44,26 +48,33 @@ static struct bio *get_swap_bio(gfp_t gfp_flags,
 static void end_swap_bio_write(struct bio *bio, int err)
 {
 	const int uptodate = test_bit(BIO_UPTODATE, &bio->bi_flags);
-	struct page *page = bio->bi_io_vec[0].bv_page;
+	struct bio_vec *bvec;
+	int i;
 
-	if (!uptodate) {
-		SetPageError(page);
-		/*
-		 * We failed to write the page out to swap-space.
-		 * Re-dirty the page in order to avoid it being reclaimed.
-		 * Also print a dire warning that things will go BAD (tm)
-		 * very quickly.
-		 *
-		 * Also clear PG_reclaim to avoid rotate_reclaimable_page()
-		 */
-		set_page_dirty(page);
-		printk(KERN_ALERT "Write-error on swap-device (%u:%u:%Lu)\n",
-				imajor(bio->bi_bdev->bd_inode),
-				iminor(bio->bi_bdev->bd_inode),
-				(unsigned long long)bio->bi_sector);
-		ClearPageReclaim(page);
+	__bio_for_each_segment(bvec, bio, i, 0) {
+		struct page *page = bvec->bv_page;
+
+		if (!uptodate) {
+			SetPageError(page);
+			/*
+			 * We failed to write the page out to swap-space.
+			 * Re-dirty the page in order to avoid it being
+			 * reclaimed.  Also print a dire warning that things
+			 * will go BAD (tm) very quickly.
+			 *
+			 * Also clear PG_reclaim to avoid
+			 * rotate_reclaimable_page()
+			 */
+			set_page_dirty(page);
+			printk(KERN_ALERT "Write-error on swap-device "
+					"(%u:%u:%Lu)\n",
+					imajor(bio->bi_bdev->bd_inode),
+					iminor(bio->bi_bdev->bd_inode),
+					(unsigned long long)bio->bi_sector);
+			ClearPageReclaim(page);
+		}
+		end_page_writeback(page);
 	}
-	end_page_writeback(page);
 	bio_put(bio);
 }
 
@@ -86,6 +97,69 @@ void end_swap_bio_read(struct bio *bio, int err)
 	bio_put(bio);
 }
 
+/**
+ * swap_write_unplug - submit a batch of swap writes
+ * @plug: batch gathered by swap_writepage() through wbc->swap_plug
+ *
+ * The time to submit is charged evenly to the pages in the batch, which
+ * for zram is the time to compress them.
+ */
+void swap_write_unplug(struct bio **plug)
+{
+	struct page *pages[SWAP_BATCH_PAGES];
+	struct bio *bio = *plug;
+	unsigned long ns;
+	ktime_t start;
+	int i, nr;
+
+	if (!bio)
+		return;
+	*plug = NULL;
+	nr = bio->bi_vcnt;
+	for (i = 0; i < nr; i++)
+		pages[i] = bio->bi_io_vec[i].bv_page;
+
+	start = ktime_get();
+	submit_bio(WRITE, bio);
+	ns = div_s64(ktime_to_ns(ktime_sub(ktime_get(), start)), nr);
+	for (i = 0; i < nr; i++)
+		workingset_swap_cost(pages[i], WRITE, ns);
+}
+
+/*
+ * Add @page to the batch in *wbc->swap_plug if it goes to the slot right
+ * after it, else send the batch and start a new one.  Reclaim hands out
+ * swap slots in order, so a pass over the inactive list mostly makes one
+ * bio, which zram takes in one call.
+ */
+static bool swap_write_batch(struct page *page, struct writeback_control *wbc)
+{
+	struct bio *bio = *wbc->swap_plug;
+	struct block_device *bdev;
+	sector_t sector;
+
+	sector = map_swap_page(page, &bdev) << (PAGE_SHIFT - 9);
+	if (bio && (bio->bi_bdev != bdev ||
+		    bio->bi_sector + (bio->bi_size >> 9) != sector ||
+		    bio_add_page(bio, page, PAGE_SIZE, 0) != PAGE_SIZE)) {
+		swap_write_unplug(wbc->swap_plug);
+		bio = NULL;
+	}
+	if (!bio) {
+		bio = get_swap_bio(GFP_NOIO, page, end_swap_bio_write,
+				   SWAP_BATCH_PAGES);
+		if (!bio)
+			return false;
+		*wbc->swap_plug = bio;
+	}
+	count_vm_event(PSWPOUT);
+	set_page_writeback(page);
+	unlock_page(page);
+	if (bio->bi_vcnt == SWAP_BATCH_PAGES)
+		swap_write_unplug(wbc->swap_plug);
+	return true;
+}
+
 /*
  * We may have stale swap cache pages in memory: notice
  * them here and get rid of the unnecessary final write.
@@ -94,18 +168,23 @@ int swap_writepage(struct page *page, struct writeback_control *wbc)
 {
 	struct bio *bio;
 	int ret = 0, rw = WRITE;
+	ktime_t start;
 
 	if (try_to_free_swap(page)) {
 		unlock_page(page);
 		goto out;
 	}
+	start = ktime_get();
 	if (frontswap_store(page) == 0) {
 		set_page_writeback(page);
 		unlock_page(page);
 		end_page_writeback(page);
-		goto out;
+		goto cost;
 	}
-	bio = get_swap_bio(GFP_NOIO, page, end_swap_bio_write);
+	if (wbc->swap_plug && wbc->sync_mode != WB_SYNC_ALL &&
+	    swap_write_batch(page, wbc))
+		goto out;
+	bio = get_swap_bio(GFP_NOIO, page, end_swap_bio_write, 1);
 	if (bio == NULL) {
 		set_page_dirty(page);
 		unlock_page(page);
@@ -118,6 +197,9 @@ int swap_writepage(struct page *page, struct writeback_control *wbc)
 	set_page_writeback(page);
 	unlock_page(page);
 	submit_bio(rw, bio);
+cost:
+	workingset_swap_cost(page, WRITE,
+			     ktime_to_ns(ktime_sub(ktime_get(), start)));
 out:
 	return ret;
 }
@@ -126,15 +208,17 @@ int swap_readpage(struct page *page)
 {
 	struct bio *bio;
 	int ret = 0;
+	ktime_t start;
 
 	VM_BUG_ON(!PageLocked(page));
 	VM_BUG_ON(PageUptodate(page));
+	start = ktime_get();
 	if (frontswap_load(page) == 0) {
 		SetPageUptodate(page);
 		unlock_page(page);
-		goto out;
+		goto cost;
 	}
-	bio = get_swap_bio(GFP_KERNEL, page, end_swap_bio_read);
+	bio = get_swap_bio(GFP_KERNEL, page, end_swap_bio_read, 1);
 	if (bio == NULL) {
 		unlock_page(page);
 		ret = -ENOMEM;
@@ -142,6 +226,9 @@ int swap_readpage(struct page *page)
 	}
 	count_vm_event(PSWPIN);
 	submit_bio(READ, bio);
+cost:
+	workingset_swap_cost(page, READ,
+			     ktime_to_ns(ktime_sub(ktime_get(), start)));
 out:
 	return ret;
 }
@@ -2085,6 +2085,96 @@ void kmem_cache_free(struct kmem_cache *s, void *x)
 }
 EXPORT_SYMBOL(kmem_cache_free);
 
+/*
+ * The bulk paths work on the cpu slab directly with interrupts off, which
+ * replaces the per object cmpxchg_double.  Bumping the tid before turning
+ * interrupts back on makes any fastpath that was preempted around this
+ * retry.  __slab_alloc() and __slab_free() cope with being called with
+ * interrupts off, and refill from and return to the per cpu partial list
+ * as usual.
+ */
+void kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p)
+{
+	struct kmem_cache_cpu *c;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		slab_free_hook(s, p[i]);
+
+	local_irq_disable();
+	c = this_cpu_ptr(s->cpu_slab);
+	for (i = 0; i < size; i++) {
+		void *object = p[i];
+		struct page *page = virt_to_head_page(object);
+
+		if (likely(page == c->page)) {
+			set_freepointer(s, object, c->freelist);
+			c->freelist = object;
+			stat(s, FREE_FASTPATH);
+		} else {
+			c->tid = next_tid(c->tid);
+			__slab_free(s, page, object, _RET_IP_);
+			c = this_cpu_ptr(s->cpu_slab);
+		}
+		trace_kmem_cache_free(_RET_IP_, object);
+	}
+	c->tid = next_tid(c->tid);
+	local_irq_enable();
+}
+EXPORT_SYMBOL(kmem_cache_free_bulk);
+
+int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
+			  void **p)
+{
+	struct kmem_cache_cpu *c;
+	size_t i;
+
+	if (slab_pre_alloc_hook(s, flags))
+		return 0;
+
+	local_irq_disable();
+	c = this_cpu_ptr(s->cpu_slab);
+	for (i = 0; i < size; i++) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			c->tid = next_tid(c->tid);
+			/* May enable interrupts to grab a new slab */
+			p[i] = __slab_alloc(s, flags, NUMA_NO_NODE, _RET_IP_,
+					    c);
+			if (unlikely(!p[i]))
+				goto error;
+			c = this_cpu_ptr(s->cpu_slab);
+			continue;
+		}
+		c->freelist = get_freepointer(s, object);
+		p[i] = object;
+		stat(s, ALLOC_FASTPATH);
+	}
+	c->tid = next_tid(c->tid);
+	local_irq_enable();
+
+	for (i = 0; i < size; i++) {
+		if (unlikely(flags & __GFP_ZERO))
+			memset(p[i], 0, s->objsize);
+		slab_post_alloc_hook(s, flags, p[i]);
+		trace_kmem_cache_alloc(_RET_IP_, p[i], s->objsize, s->size,
+				       flags);
+	}
+	return size;
+
+error:
+	c = this_cpu_ptr(s->cpu_slab);
+	c->tid = next_tid(c->tid);
+	local_irq_enable();
+	while (i--) {
+		slab_post_alloc_hook(s, flags, p[i]);
+		kmem_cache_free(s, p[i]);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(kmem_cache_alloc_bulk);
+
 
 static int slub_min_order;
 static int slub_max_order = PAGE_ALLOC_COSTLY_ORDER;
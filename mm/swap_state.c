@@ -17,6 +17,7 @@
 #include <linux/pagevec.h>
 #include <linux/migrate.h>
 #include <linux/page_cgroup.h>
+#include <linux/highmem.h>
 
 #include <asm/pgtable.h>
 
@@ -45,6 +46,10 @@ struct address_space swapper_space = {
 
 #define INC_CACHE_INFO(x)	do { swap_cache_info.x++; } while (0)
 
+/* Readahead pages of in-memory swap later found by a fault */
+static atomic_t swapin_ra_hits = ATOMIC_INIT(0);
+static unsigned long swapin_ra_prev;
+
 static struct {
 	unsigned long add_total;
 	unsigned long del_total;
@@ -264,8 +269,14 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		/* PG_readahead is PG_reclaim while under writeback */
+		if (!PageWriteback(page) && PageReadahead(page)) {
+			ClearPageReadahead(page);
+			atomic_inc(&swapin_ra_hits);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -377,6 +388,10 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	unsigned long start_offset, end_offset;
 	unsigned long mask = (1UL << page_cluster) - 1;
 
+	/* Neighbours in an in-memory device only cost a decompression */
+	if (swp_swap_info(entry)->flags & SWP_INMEM)
+		goto skip;
+
 	/* Read a page_cluster sized and aligned cluster around offset. */
 	start_offset = offset & ~mask;
 	end_offset = offset | mask;
@@ -392,5 +407,117 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 		page_cache_release(page);
 	}
 	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
+	return read_swap_cache_async(entry, gfp_mask, vma, addr);
+}
+
+#define SWAPIN_RA_VMA_MAX	16
+
+/*
+ * How many pages to read around a fault on in-memory swap: as many as
+ * the previous window turned out useful, plus one.  With no hits it
+ * drops to none, and probes with one page while faults look sequential.
+ */
+static unsigned long swapin_ra_window(unsigned long addr, bool *backward)
+{
+	unsigned long hits = atomic_xchg(&swapin_ra_hits, 0);
+	unsigned long pfn = addr >> PAGE_SHIFT;
+	unsigned long prev = ACCESS_ONCE(swapin_ra_prev);
+	unsigned long max = min(1UL << page_cluster,
+				(unsigned long)SWAPIN_RA_VMA_MAX);
+
+	swapin_ra_prev = pfn;
+	*backward = pfn < prev;
+	if (hits)
+		return min(roundup_pow_of_two(hits + 1), max);
+	if (pfn == prev + 1 || pfn + 1 == prev)
+		return min(2UL, max);
+	return 1;
+}
+
+/**
+ * swapin_readahead_vma - swap in a faulting page and its vma neighbours
+ * @entry: swap entry of this memory
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma this address belongs to
+ * @addr: faulting address
+ *
+ * For rotating and solid state devices this is swapin_readahead().  On
+ * in-memory swap (zram) every page read is a decompression, and pages
+ * next to each other in the swap area belong to whatever was reclaimed
+ * together, so read the swap entries mapped next to @addr instead, in
+ * the direction of the fault and within the same page table.
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swapin_readahead_vma(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	swp_entry_t ents[SWAPIN_RA_VMA_MAX];
+	unsigned long addrs[SWAPIN_RA_VMA_MAX];
+	unsigned long nr, start, end, lo, hi, pos;
+	struct page *page;
+	bool backward;
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte, pteval;
+	int i, n = 0;
+
+	if (!(swp_swap_info(entry)->flags & SWP_INMEM))
+		return swapin_readahead(entry, gfp_mask, vma, addr);
+
+	addr &= PAGE_MASK;
+	nr = swapin_ra_window(addr, &backward);
+	if (nr <= 1)
+		goto skip;
+
+	lo = max(vma->vm_start, addr & PMD_MASK);
+	hi = min(vma->vm_end, (addr & PMD_MASK) + PMD_SIZE);
+	if (backward) {
+		start = addr - min(addr - lo, (nr - 1) << PAGE_SHIFT);
+		end = addr + PAGE_SIZE;
+	} else {
+		start = addr;
+		end = min(hi, addr + (nr << PAGE_SHIFT));
+	}
+
+	pgd = pgd_offset(vma->vm_mm, start);
+	if (pgd_none(*pgd) || pgd_bad(*pgd))
+		goto skip;
+	pud = pud_offset(pgd, start);
+	if (pud_none(*pud) || pud_bad(*pud))
+		goto skip;
+	pmd = pmd_offset(pud, start);
+	if (pmd_none(*pmd) || pmd_bad(*pmd) || pmd_trans_huge(*pmd))
+		goto skip;
+
+	pte = pte_offset_map(pmd, start);
+	for (pos = start; pos < end; pos += PAGE_SIZE) {
+		pteval = pte[(pos - start) >> PAGE_SHIFT];
+		if (pos == addr || pte_none(pteval) || pte_present(pteval) ||
+		    pte_file(pteval))
+			continue;
+		ents[n] = pte_to_swp_entry(pteval);
+		addrs[n] = pos;
+		if (!non_swap_entry(ents[n]))
+			n++;
+	}
+	pte_unmap(pte);
+
+	for (i = 0; i < n; i++) {
+		page = find_get_page(&swapper_space, ents[i].val);
+		if (page) {
+			page_cache_release(page);
+			continue;
+		}
+		page = read_swap_cache_async(ents[i], gfp_mask, vma, addrs[i]);
+		if (!page)
+			continue;
+		SetPageReadahead(page);
+		page_cache_release(page);
+	}
+	lru_add_drain();
+skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
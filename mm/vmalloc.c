@@ -27,6 +27,7 @@
 #include <linux/pfn.h>
 #include <linux/kmemleak.h>
 #include <linux/atomic.h>
+#include <linux/workqueue.h>
 #include <asm/uaccess.h>
 #include <asm/tlbflush.h>
 #include <asm/shmparam.h>
@@ -517,10 +518,20 @@ static void vmap_debug_free_range(unsigned long start, unsigned long end)
 #endif
 }
 
+/*
+ * Lazily freed vmap space, in KB, allowed to pile up before the TLB is
+ * flushed for it.  0 scales it with the number of online cpus.
+ */
+static unsigned int lazy_max_kb;
+module_param(lazy_max_kb, uint, S_IRUGO | S_IWUSR);
+
 static unsigned long lazy_max_pages(void)
 {
 	unsigned int log;
 
+	if (lazy_max_kb)
+		return lazy_max_kb >> (PAGE_SHIFT - 10);
+
 	log = fls(num_online_cpus());
 
 	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
@@ -532,7 +543,7 @@ static void purge_fragmented_blocks_allcpus(void);
 
 void set_iounmap_nonlazy(void)
 {
-	atomic_set(&vmap_lazy_nr, lazy_max_pages()+1);
+	atomic_set(&vmap_lazy_nr, 2 * lazy_max_pages() + 1);
 }
 
 static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
@@ -597,12 +608,26 @@ static void purge_vmap_area_lazy(void)
 	__purge_vmap_area_lazy(&start, &end, 1, 0);
 }
 
+static void purge_vmap_area_work(struct work_struct *work)
+{
+	try_purge_vmap_area_lazy();
+}
+static DECLARE_WORK(purge_vmap_work, purge_vmap_area_work);
+
+/* The unmapping thread only flushes itself once the worker falls behind */
 static void free_vmap_area_noflush(struct vmap_area *va)
 {
+	unsigned long nr, max = lazy_max_pages();
+
 	va->flags |= VM_LAZY_FREE;
-	atomic_add((va->va_end - va->va_start) >> PAGE_SHIFT, &vmap_lazy_nr);
-	if (unlikely(atomic_read(&vmap_lazy_nr) > lazy_max_pages()))
+	nr = atomic_add_return((va->va_end - va->va_start) >> PAGE_SHIFT,
+			       &vmap_lazy_nr);
+	if (likely(nr <= max))
+		return;
+	if (nr > 2 * max || !keventd_up())
 		try_purge_vmap_area_lazy();
+	else
+		schedule_work(&purge_vmap_work);
 }
 
 static void free_unmap_vmap_area_noflush(struct vmap_area *va)
@@ -646,7 +671,6 @@ static void free_unmap_vmap_area_addr(unsigned long addr)
 #endif
 
 #define VMALLOC_PAGES		(VMALLOC_SPACE / PAGE_SIZE)
-#define VMAP_MAX_ALLOC		BITS_PER_LONG	
 #define VMAP_BBMAP_BITS_MAX	1024	
 #define VMAP_BBMAP_BITS_MIN	(VMAP_MAX_ALLOC*2)
 #define VMAP_MIN(x, y)		((x) < (y) ? (x) : (y)) 
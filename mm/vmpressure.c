@@ -0,0 +1,86 @@
+/*
+ * Reclaim pressure notification
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/export.h>
+#include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <linux/swap.h>
+#include <linux/vmpressure.h>
+
+/*
+ * The pressure is the share of the pages scanned by global reclaim that
+ * couldn't be reclaimed, in percent.  It is worked out over a window of
+ * scanned pages so that a single unlucky pass doesn't count for much, and
+ * so that the notifiers aren't called for every batch of pages.
+ */
+static const unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
+
+static DEFINE_SPINLOCK(vmpressure_lock);
+static unsigned long vmpressure_scanned;
+static unsigned long vmpressure_reclaimed;
+
+static ATOMIC_NOTIFIER_HEAD(vmpressure_notifier);
+
+int vmpressure_register_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&vmpressure_notifier, nb);
+}
+EXPORT_SYMBOL(vmpressure_register_notifier);
+
+int vmpressure_unregister_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&vmpressure_notifier, nb);
+}
+EXPORT_SYMBOL(vmpressure_unregister_notifier);
+
+/**
+ * vmpressure - Account a reclaim pass
+ * @gfp: allocation flags of the reclaim
+ * @scanned: number of pages scanned
+ * @reclaimed: number of pages reclaimed
+ */
+void vmpressure(gfp_t gfp, unsigned long scanned, unsigned long reclaimed)
+{
+	unsigned long pressure = 0;
+
+	/*
+	 * Reclaim for allocations that can't do I/O or use highmem says
+	 * little about how short the system is of memory as a whole
+	 */
+	if (!(gfp & (__GFP_HIGHMEM | __GFP_MOVABLE | __GFP_IO | __GFP_FS)))
+		return;
+
+	if (!scanned)
+		return;
+
+	spin_lock(&vmpressure_lock);
+	vmpressure_scanned += scanned;
+	vmpressure_reclaimed += reclaimed;
+	if (vmpressure_scanned < vmpressure_win) {
+		spin_unlock(&vmpressure_lock);
+		return;
+	}
+	scanned = vmpressure_scanned;
+	reclaimed = vmpressure_reclaimed;
+	vmpressure_scanned = 0;
+	vmpressure_reclaimed = 0;
+	spin_unlock(&vmpressure_lock);
+
+	/* Slab and compound pages can make reclaimed larger than scanned */
+	if (reclaimed < scanned)
+		pressure = 100 - reclaimed * 100 / scanned;
+
+	atomic_notifier_call_chain(&vmpressure_notifier, pressure, NULL);
+}
@@ -41,6 +41,7 @@
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
+#include <linux/vmpressure.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -355,7 +356,7 @@ typedef enum {
 } pageout_t;
 
 static pageout_t pageout(struct page *page, struct address_space *mapping,
-			 struct scan_control *sc)
+			 struct scan_control *sc, struct bio **swap_plug)
 {
 	if (!is_page_cache_freeable(page))
 		return PAGE_KEEP;
@@ -382,6 +383,7 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 			.range_start = 0,
 			.range_end = LLONG_MAX,
 			.for_reclaim = 1,
+			.swap_plug = swap_plug,
 		};
 
 		SetPageReclaim(page);
@@ -430,6 +432,7 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 
 		freepage = mapping->a_ops->freepage;
 
+		workingset_eviction(mapping, page);
 		__delete_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -543,6 +546,8 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 {
 	LIST_HEAD(ret_pages);
 	LIST_HEAD(free_pages);
+	LIST_HEAD(batched_pages);
+	struct bio *swap_plug = NULL;
 	int pgactivate = 0;
 	unsigned long nr_dirty = 0;
 	unsigned long nr_congested = 0;
@@ -653,13 +658,19 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 				goto keep_locked;
 
 			
-			switch (pageout(page, mapping, sc)) {
+			switch (pageout(page, mapping, sc, &swap_plug)) {
 			case PAGE_KEEP:
 				nr_congested++;
 				goto keep_locked;
 			case PAGE_ACTIVATE:
 				goto activate_locked;
 			case PAGE_SUCCESS:
+				if (PageWriteback(page) && PageSwapCache(page) &&
+				    swap_plug) {
+					/* retried once the batch is written */
+					list_add(&page->lru, &batched_pages);
+					continue;
+				}
 				if (PageWriteback(page))
 					goto keep_lumpy;
 				if (PageDirty(page))
@@ -744,6 +755,34 @@ keep_lumpy:
 		VM_BUG_ON(PageLRU(page) || PageUnevictable(page));
 	}
 
+	/*
+	 * Swap writes were batched, zram has finished them by now.  Free
+	 * what is clean as the loop would have done right after pageout().
+	 */
+	swap_write_unplug(&swap_plug);
+	while (!list_empty(&batched_pages)) {
+		struct address_space *mapping;
+		struct page *page;
+
+		page = lru_to_page(&batched_pages);
+		list_del(&page->lru);
+		if (PageWriteback(page) || PageDirty(page) ||
+		    !trylock_page(page))
+			goto keep_batched;
+		mapping = page_mapping(page);
+		if (PageDirty(page) || PageWriteback(page) || !mapping ||
+		    !__remove_mapping(mapping, page)) {
+			unlock_page(page);
+			goto keep_batched;
+		}
+		__clear_page_locked(page);
+		nr_reclaimed++;
+		list_add(&page->lru, &free_pages);
+		continue;
+keep_batched:
+		list_add(&page->lru, &ret_pages);
+	}
+
 	if (nr_dirty && nr_dirty == nr_congested && global_reclaim(sc))
 		zone_set_flag(mz->zone, ZONE_CONGESTED);
 
@@ -1398,7 +1437,7 @@ static void get_scan_count(struct mem_cgroup_zone *mz, struct scan_control *sc,
 {
 	unsigned long anon, file, free;
 	unsigned long anon_prio, file_prio;
-	unsigned long ap, fp;
+	unsigned long ap, fp, unit;
 	struct zone_reclaim_stat *reclaim_stat = get_reclaim_stat(mz);
 	u64 fraction[2], denominator;
 	enum lru_list lru;
@@ -1436,23 +1475,32 @@ static void get_scan_count(struct mem_cgroup_zone *mz, struct scan_control *sc,
 
 	anon_prio = vmscan_swappiness(mz, sc);
 	file_prio = 200 - vmscan_swappiness(mz, sc);
+	unit = workingset_cost_unit();
 
 	spin_lock_irq(&mz->zone->lru_lock);
 	if (unlikely(reclaim_stat->recent_scanned[0] > anon / 4)) {
 		reclaim_stat->recent_scanned[0] /= 2;
 		reclaim_stat->recent_rotated[0] /= 2;
+		reclaim_stat->recent_cost[0] /= 2;
 	}
 
 	if (unlikely(reclaim_stat->recent_scanned[1] > file / 4)) {
 		reclaim_stat->recent_scanned[1] /= 2;
 		reclaim_stat->recent_rotated[1] /= 2;
+		reclaim_stat->recent_cost[1] /= 2;
 	}
 
+	/*
+	 * Refaults and swap outs weigh in as rotations, scaled by what they
+	 * cost: a zram swap in is far cheaper than an eMMC read.
+	 */
 	ap = (anon_prio + 1) * (reclaim_stat->recent_scanned[0] + 1);
-	ap /= reclaim_stat->recent_rotated[0] + 1;
+	ap /= reclaim_stat->recent_rotated[0] +
+		reclaim_stat->recent_cost[0] / unit + 1;
 
 	fp = (file_prio + 1) * (reclaim_stat->recent_scanned[1] + 1);
-	fp /= reclaim_stat->recent_rotated[1] + 1;
+	fp /= reclaim_stat->recent_rotated[1] +
+		reclaim_stat->recent_cost[1] / unit + 1;
 	spin_unlock_irq(&mz->zone->lru_lock);
 
 	fraction[0] = ap;
@@ -1471,6 +1519,9 @@ out:
 			scan = div64_u64(scan * fraction[file], denominator);
 		}
 		nr[lru] = scan;
+		if (global_reclaim(sc))
+			count_vm_events(file ? PGSCAN_BALANCE_FILE :
+				       PGSCAN_BALANCE_ANON, scan);
 	}
 }
 
@@ -1567,6 +1618,8 @@ static void shrink_zone(int priority, struct zone *zone,
 		.priority = priority,
 	};
 	struct mem_cgroup *memcg;
+	unsigned long nr_scanned = sc->nr_scanned;
+	unsigned long nr_reclaimed = sc->nr_reclaimed;
 
 	memcg = mem_cgroup_iter(root, NULL, &reclaim);
 	do {
@@ -1582,6 +1635,10 @@ static void shrink_zone(int priority, struct zone *zone,
 		}
 		memcg = mem_cgroup_iter(root, memcg, &reclaim);
 	} while (memcg);
+
+	if (global_reclaim(sc))
+		vmpressure(sc->gfp_mask, sc->nr_scanned - nr_scanned,
+			   sc->nr_reclaimed - nr_reclaimed);
 }
 
 static inline bool compaction_ready(struct zone *zone, struct scan_control *sc)
@@ -19,6 +19,7 @@
 #include <linux/math64.h>
 #include <linux/writeback.h>
 #include <linux/compaction.h>
+#include <linux/swap.h>
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
 DEFINE_PER_CPU(struct vm_event_state, vm_event_states) = {{0}};
@@ -545,6 +546,9 @@ const char * const vmstat_text[] = {
 	"nr_anon_transparent_hugepages",
 	"nr_dirty_threshold",
 	"nr_dirty_background_threshold",
+	"workingset_anon_read_ns",
+	"workingset_anon_write_ns",
+	"workingset_file_read_ns",
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
 	"pgpgin",
@@ -581,6 +585,16 @@ const char * const vmstat_text[] = {
 
 	"pgrotated",
 
+	"workingset_refault",
+	"workingset_activate",
+	"pgscan_balance_anon",
+	"pgscan_balance_file",
+
+#ifdef CONFIG_ANON_LARGE_PAGES
+	"anon_large_fault_alloc",
+	"anon_large_fault_fallback",
+#endif
+
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
 	"compact_pages_moved",
@@ -588,6 +602,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_run",
+	"compact_daemon_success",
+	"compact_daemon_avoided",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -782,7 +799,7 @@ static const struct file_operations pagetypeinfo_file_ops = {
 static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 							struct zone *zone)
 {
-	int i;
+	int i, j;
 	seq_printf(m, "Node %d, zone %8s", pgdat->node_id, zone->name);
 	seq_printf(m,
 		   "\n  pages free     %lu"
@@ -825,6 +842,22 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
 			   pageset->pcp.batch);
+		for (j = 0; j < PCP_HIGH_ORDER; j++) {
+			struct per_cpu_order_pages *pco;
+			unsigned long rate = 0;
+			u64 total;
+
+			pco = &pageset->pcp.orders[j];
+			total = (u64)pco->hit + pco->miss;
+			if (total)
+				rate = div64_u64((u64)pco->hit * 100, total);
+
+			seq_printf(m,
+				   "\n           order %d: count %i high %i batch %i"
+				   " hit %lu miss %lu (%lu%%)",
+				   j + 1, pco->count, pco->high, pco->batch,
+				   pco->hit, pco->miss, rate);
+		}
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
@@ -872,6 +905,13 @@ enum writeback_stat_item {
 	NR_VM_WRITEBACK_STAT_ITEMS,
 };
 
+enum workingset_stat_item {
+	WORKINGSET_ANON_READ_NS,
+	WORKINGSET_ANON_WRITE_NS,
+	WORKINGSET_FILE_READ_NS,
+	NR_VM_WORKINGSET_STAT_ITEMS,
+};
+
 static void *vmstat_start(struct seq_file *m, loff_t *pos)
 {
 	unsigned long *v;
@@ -880,7 +920,8 @@ static void *vmstat_start(struct seq_file *m, loff_t *pos)
 	if (*pos >= ARRAY_SIZE(vmstat_text))
 		return NULL;
 	stat_items_size = NR_VM_ZONE_STAT_ITEMS * sizeof(unsigned long) +
-			  NR_VM_WRITEBACK_STAT_ITEMS * sizeof(unsigned long);
+			  NR_VM_WRITEBACK_STAT_ITEMS * sizeof(unsigned long) +
+			  NR_VM_WORKINGSET_STAT_ITEMS * sizeof(unsigned long);
 
 #ifdef CONFIG_VM_EVENT_COUNTERS
 	stat_items_size += sizeof(struct vm_event_state);
@@ -898,6 +939,11 @@ static void *vmstat_start(struct seq_file *m, loff_t *pos)
 			    v + NR_DIRTY_THRESHOLD);
 	v += NR_VM_WRITEBACK_STAT_ITEMS;
 
+	workingset_costs(v + WORKINGSET_ANON_READ_NS,
+			 v + WORKINGSET_ANON_WRITE_NS,
+			 v + WORKINGSET_FILE_READ_NS);
+	v += NR_VM_WORKINGSET_STAT_ITEMS;
+
 #ifdef CONFIG_VM_EVENT_COUNTERS
 	all_vm_events(v);
 	v[PGPGIN] /= 2;		
@@ -0,0 +1,206 @@
+/*
+ * Workingset detection and reclaim cost accounting
+ *
+ * When reclaim evicts a file page it leaves a shadow entry holding the
+ * zone's eviction age in a hashed table keyed by mapping and index.  If the
+ * page is read back while the number of evictions since then is no larger
+ * than the active file list, it would have stayed resident had the active
+ * list given up that much room, so it is refaulting from the working set:
+ * it goes straight to the active list.  Colliding entries simply overwrite
+ * each other, which only loses the odd refault.
+ *
+ * Each refault and each swap out is charged to the zone at what it costs:
+ * swap I/O is timed as it is submitted, which for zram is the whole
+ * (de)compression, and a file refault is charged the read service time of
+ * its block device.  get_scan_count() counts these costs alongside the
+ * rotations, so reclaim leans away from whichever list is thrashing
+ * expensively.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/genhd.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
+#include <linux/init.h>
+#include <linux/vmstat.h>
+#include <linux/math64.h>
+
+#define EVICTION_TAG_BITS	8
+#define EVICTION_ZONE_BITS	(NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_AGE_BITS	(32 - EVICTION_ZONE_BITS - EVICTION_TAG_BITS)
+#define EVICTION_AGE_MASK	((1U << EVICTION_AGE_BITS) - 1)
+#define EVICTION_TAG_MASK	((1U << EVICTION_TAG_BITS) - 1)
+
+static u32 *shadow_table __read_mostly;
+static unsigned int shadow_shift __read_mostly;
+
+/* Running averages in ns, 1/8 weight per sample */
+static unsigned long anon_read_ns, anon_write_ns, file_read_ns;
+
+static unsigned long shadow_hash(struct address_space *mapping, pgoff_t index)
+{
+	unsigned long key = (unsigned long)mapping ^
+			    hash_long(index, BITS_PER_LONG);
+
+	return hash_long(key, BITS_PER_LONG);
+}
+
+static u32 pack_shadow(struct zone *zone, unsigned long age, unsigned long h)
+{
+	u32 zoneid = zone_to_nid(zone) << ZONES_SHIFT | zone_idx(zone);
+
+	return ((age & EVICTION_AGE_MASK) << EVICTION_ZONE_BITS | zoneid) <<
+		EVICTION_TAG_BITS | (h & EVICTION_TAG_MASK);
+}
+
+static void unpack_shadow(u32 shadow, struct zone **zone, unsigned long *age)
+{
+	u32 zoneid = shadow >> EVICTION_TAG_BITS;
+	int nid = zoneid >> ZONES_SHIFT & ((1U << NODES_SHIFT) - 1);
+
+	*zone = NODE_DATA(nid)->node_zones +
+		(zoneid & ((1U << ZONES_SHIFT) - 1));
+	*age = shadow >> (EVICTION_TAG_BITS + EVICTION_ZONE_BITS);
+}
+
+static void update_avg(unsigned long *avg, unsigned long ns)
+{
+	unsigned long old = ACCESS_ONCE(*avg);
+
+	*avg = old ? old - old / 8 + ns / 8 : ns;
+}
+
+/* Called with irqs disabled or enabled, from reclaim and fault paths */
+static void note_cost(struct zone *zone, int file, unsigned long ns)
+{
+	struct zone_reclaim_stat *stat = &zone->reclaim_stat;
+	unsigned long flags;
+
+	spin_lock_irqsave(&zone->lru_lock, flags);
+	stat->recent_cost[file] += max(1UL, ns / NSEC_PER_USEC);
+	if (unlikely(stat->recent_cost[file] > (1UL << 30))) {
+		stat->recent_cost[0] /= 2;
+		stat->recent_cost[1] /= 2;
+	}
+	spin_unlock_irqrestore(&zone->lru_lock, flags);
+}
+
+/*
+ * What one unit of recent_cost is worth in rotations: the cheaper kind of
+ * refault counts as one rotation, the other as many as it costs more.
+ */
+unsigned long workingset_cost_unit(void)
+{
+	unsigned long anon = ACCESS_ONCE(anon_read_ns) / NSEC_PER_USEC;
+	unsigned long file = ACCESS_ONCE(file_read_ns) / NSEC_PER_USEC;
+
+	if (!anon || !file)
+		return max3(anon, file, 1UL);
+	return min(anon, file);
+}
+
+void workingset_costs(unsigned long *anon_read, unsigned long *anon_write,
+		      unsigned long *file_read)
+{
+	*anon_read = ACCESS_ONCE(anon_read_ns);
+	*anon_write = ACCESS_ONCE(anon_write_ns);
+	*file_read = ACCESS_ONCE(file_read_ns);
+}
+
+/* Called under mapping->tree_lock while reclaim removes the page */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long h, age;
+
+	if (!shadow_table)
+		return;
+
+	h = shadow_hash(mapping, page->index);
+	age = atomic_long_inc_return(&zone->inactive_age);
+	shadow_table[h >> (BITS_PER_LONG - shadow_shift)] =
+		pack_shadow(zone, age, h);
+}
+
+static unsigned long bdev_read_ns(struct address_space *mapping)
+{
+	struct super_block *sb = mapping->host ? mapping->host->i_sb : NULL;
+	struct hd_struct *part;
+	unsigned long ios;
+
+	if (!sb || !sb->s_bdev)
+		return 0;
+
+	part = sb->s_bdev->bd_part;
+	ios = part_stat_read(part, ios[READ]);
+	if (!ios)
+		return 0;
+	return div64_u64((u64)part_stat_read(part, ticks[READ]) *
+			 (NSEC_PER_SEC / HZ), ios);
+}
+
+/*
+ * A page is being added to @mapping at @index.  Returns true if it was
+ * recently evicted from the working set and should start out active.
+ */
+bool workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	unsigned long h, age, distance, ns;
+	struct zone *zone;
+	u32 *slot, shadow;
+
+	if (!shadow_table)
+		return false;
+
+	h = shadow_hash(mapping, index);
+	slot = &shadow_table[h >> (BITS_PER_LONG - shadow_shift)];
+	shadow = ACCESS_ONCE(*slot);
+	if (!shadow || (shadow & EVICTION_TAG_MASK) != (h & EVICTION_TAG_MASK))
+		return false;
+	if (cmpxchg(slot, shadow, 0) != shadow)
+		return false;
+
+	unpack_shadow(shadow, &zone, &age);
+	distance = (atomic_long_read(&zone->inactive_age) - age) &
+		EVICTION_AGE_MASK;
+
+	count_vm_event(WORKINGSET_REFAULT);
+	ns = bdev_read_ns(mapping);
+	if (ns)
+		update_avg(&file_read_ns, ns);
+	note_cost(zone, 1, ns ? ns : ACCESS_ONCE(file_read_ns));
+
+	if (distance > zone_page_state(zone, NR_ACTIVE_FILE))
+		return false;
+
+	atomic_long_inc(&zone->inactive_age);
+	count_vm_event(WORKINGSET_ACTIVATE);
+	return true;
+}
+
+/* Swap I/O on @page took @ns to submit, which for zram is all of it */
+void workingset_swap_cost(struct page *page, int rw, unsigned long ns)
+{
+	update_avg(rw == WRITE ? &anon_write_ns : &anon_read_ns, ns);
+	note_cost(page_zone(page), 0, ns);
+}
+
+static int __init workingset_init(void)
+{
+	unsigned long entries;
+
+	entries = roundup_pow_of_two(max(totalram_pages / 8, 1024UL));
+	shadow_shift = ilog2(entries);
+	shadow_table = vzalloc(entries * sizeof(u32));
+	if (!shadow_table)
+		pr_warn("workingset: no shadow table, refaults not detected\n");
+	return 0;
+}
+module_init(workingset_init);
@@ -16,12 +16,20 @@
 
 #include <linux/proc_fs.h>
 #include <linux/suspend.h>
+#include <linux/module.h>
+#include <linux/hash.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/hrtimer.h>
 #include <net/net_namespace.h>
+#include <net/sock.h>
+#include <net/activity_stats.h>
 
 #define BUCKET_MAX 10
 
 static unsigned long activity_stats[BUCKET_MAX];
 static ktime_t last_transmit;
+static unsigned long last_transmit_jiffies;
 static ktime_t suspend_time;
 static DEFINE_SPINLOCK(activity_lock);
 
@@ -32,6 +40,10 @@ void activity_stats_update(void)
 	ktime_t now;
 	s64 delta;
 
+	/* Under a second since the last counted one: nothing to count */
+	if (jiffies - ACCESS_ONCE(last_transmit_jiffies) < HZ - 1)
+		return;
+
 	spin_lock_irqsave(&activity_lock, flags);
 	now = ktime_get();
 	delta = ktime_to_ns(ktime_sub(now, last_transmit));
@@ -42,6 +54,7 @@ void activity_stats_update(void)
 
 		activity_stats[i]++;
 		last_transmit = now;
+		last_transmit_jiffies = jiffies;
 		break;
 	}
 	spin_unlock_irqrestore(&activity_lock, flags);
@@ -72,6 +85,177 @@ static int activity_stats_read_proc(char *page, char **start, off_t off,
 	return p - page;
 }
 
+/*
+ * Per-UID radio windows.  The table is shared with user space as is, see
+ * <linux/activity_stats.h>; a small hash on the side maps UIDs to entries.
+ * The dominant UID of a window is settled by the first packet after it, so
+ * no timer runs while the radio is idle.
+ */
+#define ACTIVITY_UID_ENTRIES	256
+#define ACTIVITY_UID_HASH_BITS	9
+#define ACTIVITY_WINDOW_UIDS	8
+
+static unsigned int tail_ms = 10000;
+module_param(tail_ms, uint, 0644);
+MODULE_PARM_DESC(tail_ms, "Idle time after which the radio window ends");
+
+struct activity_window_uid {
+	struct activity_uid_entry *e;
+	u64 bytes;
+};
+
+static struct activity_uid_header *uid_hdr;
+static struct activity_uid_entry *uid_entries;
+static u16 uid_hash[1 << ACTIVITY_UID_HASH_BITS];
+static struct activity_window_uid window[ACTIVITY_WINDOW_UIDS];
+static int window_nr;
+static u64 window_bytes;
+static ktime_t window_last;
+static DEFINE_SPINLOCK(uid_lock);
+
+uid_t activity_stats_skb_uid(struct sk_buff *skb)
+{
+	return skb->sk ? sock_i_uid(skb->sk) : ACTIVITY_UID_NONE;
+}
+EXPORT_SYMBOL(activity_stats_skb_uid);
+
+/* hash slots hold entry index + 1, 0 is free */
+static struct activity_uid_entry *activity_uid_entry(uid_t uid)
+{
+	unsigned int h = hash_32(uid, ACTIVITY_UID_HASH_BITS);
+	struct activity_uid_entry *e;
+
+	while (uid_hash[h]) {
+		e = &uid_entries[uid_hash[h] - 1];
+		if (e->uid == uid)
+			return e;
+		h = (h + 1) & ((1 << ACTIVITY_UID_HASH_BITS) - 1);
+	}
+
+	if (uid_hdr->nr_used == ACTIVITY_UID_ENTRIES)
+		return &uid_entries[1];
+	e = &uid_entries[uid_hdr->nr_used++];
+	e->uid = uid;
+	uid_hash[h] = uid_hdr->nr_used;
+	return e;
+}
+
+static void activity_window_close(void)
+{
+	struct activity_window_uid *top = NULL;
+	int i;
+
+	for (i = 0; i < window_nr; i++)
+		if (!top || window[i].bytes > top->bytes)
+			top = &window[i];
+	if (top)
+		top->e->dominant++;
+	uid_hdr->window_bytes += window_bytes;
+	window_nr = 0;
+	window_bytes = 0;
+}
+
+void activity_stats_radio(uid_t uid, unsigned int len, int tx)
+{
+	struct activity_uid_entry *e;
+	unsigned long flags;
+	ktime_t now;
+	int i;
+
+	if (!uid_hdr)
+		return;
+
+	now = ktime_get_boottime();
+	spin_lock_irqsave(&uid_lock, flags);
+	uid_hdr->seq++;
+	smp_wmb();
+
+	e = activity_uid_entry(uid);
+	if (!window_nr ||
+	    ktime_us_delta(now, window_last) > tail_ms * USEC_PER_MSEC) {
+		if (window_nr)
+			activity_window_close();
+		uid_hdr->windows++;
+		uid_hdr->tail_ms = tail_ms;
+		e->first++;
+	}
+	window_last = now;
+	window_bytes += len;
+
+	for (i = 0; i < window_nr; i++)
+		if (window[i].e == e)
+			break;
+	/* UIDs beyond the first few of a window go unattributed */
+	if (i == window_nr && window_nr < ACTIVITY_WINDOW_UIDS) {
+		e->windows++;
+		window[window_nr].e = e;
+		window[window_nr++].bytes = 0;
+	}
+	if (i < window_nr)
+		window[i].bytes += len;
+
+	if (tx) {
+		e->tx_packets++;
+		e->tx_bytes += len;
+	} else {
+		e->rx_packets++;
+		e->rx_bytes += len;
+	}
+
+	smp_wmb();
+	uid_hdr->seq++;
+	spin_unlock_irqrestore(&uid_lock, flags);
+}
+EXPORT_SYMBOL(activity_stats_radio);
+
+static ssize_t activity_uid_read(struct file *file, char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	return simple_read_from_buffer(buf, count, ppos, uid_hdr,
+				       (void *)&uid_entries[uid_hdr->nr_used] -
+				       (void *)uid_hdr);
+}
+
+static int activity_uid_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, uid_hdr, vma->vm_pgoff);
+}
+
+static const struct file_operations activity_uid_fops = {
+	.read		= activity_uid_read,
+	.mmap		= activity_uid_mmap,
+	.llseek		= default_llseek,
+};
+
+static void __init activity_uid_init(void)
+{
+	size_t size;
+
+	size = PAGE_ALIGN(sizeof(*uid_hdr) +
+			      ACTIVITY_UID_ENTRIES * sizeof(*uid_entries));
+	uid_hdr = vmalloc_user(size);
+	if (!uid_hdr)
+		return;
+
+	uid_entries = (struct activity_uid_entry *)(uid_hdr + 1);
+	uid_hdr->magic = ACTIVITY_UID_MAGIC;
+	uid_hdr->version = ACTIVITY_UID_VERSION;
+	uid_hdr->nr_entries = ACTIVITY_UID_ENTRIES;
+	uid_hdr->entry_size = sizeof(*uid_entries);
+	uid_hdr->tail_ms = tail_ms;
+	activity_uid_entry(ACTIVITY_UID_NONE);
+	activity_uid_entry(ACTIVITY_UID_OTHER);
+
+	if (!proc_create("activity_uid", S_IRUGO, init_net.proc_net_stat,
+			 &activity_uid_fops)) {
+		vfree(uid_hdr);
+		uid_hdr = NULL;
+	}
+}
+
 static int activity_stats_notifier(struct notifier_block *nb,
 					unsigned long event, void *dummy)
 {
@@ -83,6 +267,7 @@ static int activity_stats_notifier(struct notifier_block *nb,
 		case PM_POST_SUSPEND:
 			suspend_time = ktime_sub(ktime_get_real(), suspend_time);
 			last_transmit = ktime_sub(last_transmit, suspend_time);
+			last_transmit_jiffies = jiffies - HZ;
 	}
 
 	return 0;
@@ -96,6 +281,7 @@ static int  __init activity_stats_init(void)
 {
 	create_proc_read_entry("activity", S_IRUGO,
 			init_net.proc_net_stat, activity_stats_read_proc, NULL);
+	activity_uid_init();
 	return register_pm_notifier(&activity_stats_notifier_block);
 }
 
@@ -301,6 +301,53 @@ static ssize_t store_group(struct device *dev, struct device_attribute *attr,
 	return netdev_store(dev, attr, buf, len, change_group);
 }
 
+NETDEVICE_SHOW(tcp_rmem_default, fmt_udec);
+
+static int change_tcp_rmem_default(struct net_device *net, unsigned long val)
+{
+	net->tcp_rmem_default = min_t(unsigned long, val, INT_MAX);
+	return 0;
+}
+
+static ssize_t store_tcp_rmem_default(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, change_tcp_rmem_default);
+}
+
+NETDEVICE_SHOW(tcp_wmem_default, fmt_udec);
+
+static int change_tcp_wmem_default(struct net_device *net, unsigned long val)
+{
+	net->tcp_wmem_default = min_t(unsigned long, val, INT_MAX);
+	return 0;
+}
+
+static ssize_t store_tcp_wmem_default(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, change_tcp_wmem_default);
+}
+
+NETDEVICE_SHOW(tcp_initrwnd, fmt_udec);
+
+static int change_tcp_initrwnd(struct net_device *net, unsigned long val)
+{
+	if (val > 65535)
+		return -EINVAL;
+	net->tcp_initrwnd = val;
+	return 0;
+}
+
+static ssize_t store_tcp_initrwnd(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, change_tcp_initrwnd);
+}
+
 static struct device_attribute net_class_attributes[] = {
 	__ATTR(addr_assign_type, S_IRUGO, show_addr_assign_type, NULL),
 	__ATTR(addr_len, S_IRUGO, show_addr_len, NULL),
@@ -322,6 +369,12 @@ static struct device_attribute net_class_attributes[] = {
 	__ATTR(tx_queue_len, S_IRUGO | S_IWUSR, show_tx_queue_len,
 	       store_tx_queue_len),
 	__ATTR(netdev_group, S_IRUGO | S_IWUSR, show_group, store_group),
+	__ATTR(tcp_rmem_default, S_IRUGO | S_IWUSR, show_tcp_rmem_default,
+	       store_tcp_rmem_default),
+	__ATTR(tcp_wmem_default, S_IRUGO | S_IWUSR, show_tcp_wmem_default,
+	       store_tcp_wmem_default),
+	__ATTR(tcp_initrwnd, S_IRUGO | S_IWUSR, show_tcp_initrwnd,
+	       store_tcp_initrwnd),
 	{}
 };
 
@@ -549,34 +602,18 @@ static ssize_t show_rps_map(struct netdev_rx_queue *queue,
 	return len;
 }
 
-static ssize_t store_rps_map(struct netdev_rx_queue *queue,
-		      struct rx_queue_attribute *attribute,
-		      const char *buf, size_t len)
+int netdev_rx_queue_set_rps_mask(struct netdev_rx_queue *queue,
+				 const struct cpumask *mask)
 {
 	struct rps_map *old_map, *map;
-	cpumask_var_t mask;
-	int err, cpu, i;
+	int cpu, i;
 	static DEFINE_SPINLOCK(rps_map_lock);
 
-	if (!capable(CAP_NET_ADMIN))
-		return -EPERM;
-
-	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
-		return -ENOMEM;
-
-	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
-	if (err) {
-		free_cpumask_var(mask);
-		return err;
-	}
-
 	map = kzalloc(max_t(unsigned,
 	    RPS_MAP_SIZE(cpumask_weight(mask)), L1_CACHE_BYTES),
 	    GFP_KERNEL);
-	if (!map) {
-		free_cpumask_var(mask);
+	if (!map)
 		return -ENOMEM;
-	}
 
 	i = 0;
 	for_each_cpu_and(cpu, mask, cpu_online_mask)
@@ -601,8 +638,28 @@ static ssize_t store_rps_map(struct netdev_rx_queue *queue,
 		kfree_rcu(old_map, rcu);
 		static_key_slow_dec(&rps_needed);
 	}
+	return 0;
+}
+EXPORT_SYMBOL(netdev_rx_queue_set_rps_mask);
+
+static ssize_t store_rps_map(struct netdev_rx_queue *queue,
+		      struct rx_queue_attribute *attribute,
+		      const char *buf, size_t len)
+{
+	cpumask_var_t mask;
+	int err;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	err = bitmap_parse(buf, len, cpumask_bits(mask), nr_cpumask_bits);
+	if (!err)
+		err = netdev_rx_queue_set_rps_mask(queue, mask);
 	free_cpumask_var(mask);
-	return len;
+	return err ? err : len;
 }
 
 static ssize_t show_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
@@ -638,21 +695,12 @@ static void rps_dev_flow_table_release(struct rcu_head *rcu)
 	schedule_work(&table->free_work);
 }
 
-static ssize_t store_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
-				     struct rx_queue_attribute *attr,
-				     const char *buf, size_t len)
+int netdev_rx_queue_set_rps_flow_cnt(struct netdev_rx_queue *queue,
+				     unsigned long count)
 {
-	unsigned long mask, count;
+	unsigned long mask;
 	struct rps_dev_flow_table *table, *old_table;
 	static DEFINE_SPINLOCK(rps_dev_flow_lock);
-	int rc;
-
-	if (!capable(CAP_NET_ADMIN))
-		return -EPERM;
-
-	rc = kstrtoul(buf, 0, &count);
-	if (rc < 0)
-		return rc;
 
 	if (count) {
 		mask = count - 1;
@@ -687,7 +735,26 @@ static ssize_t store_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
 	if (old_table)
 		call_rcu(&old_table->rcu, rps_dev_flow_table_release);
 
-	return len;
+	return 0;
+}
+EXPORT_SYMBOL(netdev_rx_queue_set_rps_flow_cnt);
+
+static ssize_t store_rps_dev_flow_table_cnt(struct netdev_rx_queue *queue,
+				     struct rx_queue_attribute *attr,
+				     const char *buf, size_t len)
+{
+	unsigned long count;
+	int rc;
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	rc = kstrtoul(buf, 0, &count);
+	if (rc < 0)
+		return rc;
+
+	rc = netdev_rx_queue_set_rps_flow_cnt(queue, count);
+	return rc ? rc : len;
 }
 
 static struct rx_queue_attribute rps_cpus_attribute =
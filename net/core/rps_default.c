@@ -0,0 +1,234 @@
+/*
+ * Default receive steering for devices fed by one interrupt
+ *
+ * A driver calling netif_rps_follow_irq() gets every rx queue steered to
+ * the online cpus other than the one its interrupt is routed to, and a
+ * per queue RFS flow table.  The map follows cpu hotplug and affinity
+ * changes of the interrupt until the device is unregistered or somebody
+ * writes rps_cpus by hand, after which that device is left alone.
+ *
+ *	This program is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License
+ *	as published by the Free Software Foundation; either version
+ *	2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/export.h>
+#include <linux/cpu.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/netdevice.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+struct rps_default {
+	struct list_head list;
+	struct net_device *dev;
+	int irq;
+	bool user;
+	bool notifier;
+	struct cpumask applied;
+	struct irq_affinity_notify notify;
+};
+
+static LIST_HEAD(rps_default_list);
+static DEFINE_MUTEX(rps_default_lock);
+
+static int rps_irq_cpu(int irq)
+{
+	struct irq_data *d = irq > 0 ? irq_get_irq_data(irq) : NULL;
+	int cpu;
+
+	if (!d)
+		return 0;
+	cpu = cpumask_first_and(d->affinity, cpu_online_mask);
+	return cpu < nr_cpu_ids ? cpu : 0;
+}
+
+static bool rps_map_matches(struct netdev_rx_queue *queue,
+			    const struct cpumask *mask)
+{
+	struct rps_map *map;
+	bool match;
+	int i;
+
+	rcu_read_lock();
+	map = rcu_dereference(queue->rps_map);
+	match = (map ? map->len : 0) == cpumask_weight(mask);
+	for (i = 0; match && map && i < map->len; i++)
+		match = cpumask_test_cpu(map->cpus[i], mask);
+	rcu_read_unlock();
+	return match;
+}
+
+static void rps_default_apply(struct rps_default *rd)
+{
+	struct net_device *dev = rd->dev;
+	struct cpumask mask;
+	unsigned int i;
+
+	if (rd->user)
+		return;
+
+	cpumask_copy(&mask, cpu_online_mask);
+	/* Empty once the irq cpu is the only one left: rps off */
+	cpumask_clear_cpu(rps_irq_cpu(rd->irq), &mask);
+	if (cpumask_equal(&mask, &rd->applied))
+		return;
+
+	for (i = 0; i < dev->real_num_rx_queues; i++) {
+		if (!rps_map_matches(&dev->_rx[i], &rd->applied)) {
+			netdev_info(dev, "rps_cpus set by hand, not tracking\n");
+			rd->user = true;
+			return;
+		}
+	}
+	for (i = 0; i < dev->real_num_rx_queues; i++)
+		netdev_rx_queue_set_rps_mask(&dev->_rx[i], &mask);
+	cpumask_copy(&rd->applied, &mask);
+}
+
+static void rps_default_apply_all(struct work_struct *work)
+{
+	struct rps_default *rd;
+
+	get_online_cpus();
+	mutex_lock(&rps_default_lock);
+	list_for_each_entry(rd, &rps_default_list, list)
+		rps_default_apply(rd);
+	mutex_unlock(&rps_default_lock);
+	put_online_cpus();
+}
+static DECLARE_WORK(rps_default_work, rps_default_apply_all);
+
+static void rps_default_irq_notify(struct irq_affinity_notify *notify,
+				   const cpumask_t *mask)
+{
+	schedule_work(&rps_default_work);
+}
+
+static void rps_default_irq_release(struct kref *ref)
+{
+	kfree(container_of(ref, struct rps_default, notify.kref));
+}
+
+/* Call with rps_default_lock held */
+static struct rps_default *rps_default_find(struct net_device *dev)
+{
+	struct rps_default *rd;
+
+	list_for_each_entry(rd, &rps_default_list, list)
+		if (rd->dev == dev)
+			return rd;
+	return NULL;
+}
+
+static void rps_default_free(struct rps_default *rd)
+{
+	if (rd->notifier)
+		irq_set_affinity_notifier(rd->irq, NULL);
+	else
+		kfree(rd);
+}
+
+/**
+ *	netif_rps_follow_irq - steer rx away from the cpu taking an interrupt
+ *	@dev: registered device
+ *	@irq: interrupt that starts the receive path, 0 if unknown (cpu0)
+ *	@flow_cnt: RFS flow table entries per rx queue, 0 for none
+ *
+ *	Calling it again for the same device changes the interrupt.
+ */
+int netif_rps_follow_irq(struct net_device *dev, int irq,
+			 unsigned long flow_cnt)
+{
+	struct irq_desc *desc = irq > 0 ? irq_to_desc(irq) : NULL;
+	struct rps_default *rd, *old;
+	unsigned int i;
+	int err;
+
+	rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+	if (!rd)
+		return -ENOMEM;
+	rd->dev = dev;
+	rd->irq = irq;
+	rd->notify.notify = rps_default_irq_notify;
+	rd->notify.release = rps_default_irq_release;
+
+	for (i = 0; flow_cnt && i < dev->real_num_rx_queues; i++) {
+		err = netdev_rx_queue_set_rps_flow_cnt(&dev->_rx[i], flow_cnt);
+		if (err) {
+			kfree(rd);
+			return err;
+		}
+	}
+
+	get_online_cpus();
+	mutex_lock(&rps_default_lock);
+	old = rps_default_find(dev);
+	if (old) {
+		list_del(&old->list);
+		cpumask_copy(&rd->applied, &old->applied);
+		rd->user = old->user;
+		rps_default_free(old);
+	}
+	if (desc && !desc->affinity_notify &&
+	    !irq_set_affinity_notifier(irq, &rd->notify))
+		rd->notifier = true;
+	list_add(&rd->list, &rps_default_list);
+	rps_default_apply(rd);
+	mutex_unlock(&rps_default_lock);
+	put_online_cpus();
+	return 0;
+}
+EXPORT_SYMBOL(netif_rps_follow_irq);
+
+static int rps_default_netdev_event(struct notifier_block *nb,
+				    unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+	struct rps_default *rd;
+
+	if (event != NETDEV_UNREGISTER)
+		return NOTIFY_DONE;
+
+	mutex_lock(&rps_default_lock);
+	rd = rps_default_find(dev);
+	if (rd) {
+		list_del(&rd->list);
+		rps_default_free(rd);
+	}
+	mutex_unlock(&rps_default_lock);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block rps_default_netdev_nb = {
+	.notifier_call = rps_default_netdev_event,
+};
+
+static int __cpuinit rps_default_cpu_callback(struct notifier_block *nfb,
+					      unsigned long action, void *hcpu)
+{
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DEAD:
+		schedule_work(&rps_default_work);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __refdata rps_default_cpu_nb = {
+	.notifier_call = rps_default_cpu_callback,
+};
+
+static int __init rps_default_init(void)
+{
+	register_hotcpu_notifier(&rps_default_cpu_nb);
+	return register_netdevice_notifier(&rps_default_netdev_nb);
+}
+subsys_initcall(rps_default_init);
@@ -122,11 +122,33 @@ static void skb_under_panic(struct sk_buff *skb, int sz, void *here)
 }
 
 
+/* Point a fresh head at @data, which has @size bytes before the shinfo */
+static inline void __skb_init_data(struct sk_buff *skb, u8 *data,
+				   unsigned int size)
+{
+	struct skb_shared_info *shinfo;
+
+	memset(skb, 0, offsetof(struct sk_buff, tail));
+	skb->truesize = SKB_TRUESIZE(size);
+	atomic_set(&skb->users, 1);
+	skb->head = data;
+	skb->data = data;
+	skb_reset_tail_pointer(skb);
+	skb->end = skb->tail + size;
+#ifdef NET_SKBUFF_DATA_USES_OFFSET
+	skb->mac_header = ~0U;
+#endif
+
+	shinfo = skb_shinfo(skb);
+	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
+	atomic_set(&shinfo->dataref, 1);
+	kmemcheck_annotate_variable(shinfo->destructor_arg);
+}
+
 struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 			    int fclone, int node)
 {
 	struct kmem_cache *cache;
-	struct skb_shared_info *shinfo;
 	struct sk_buff *skb;
 	u8 *data;
 
@@ -146,23 +168,7 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 	size = SKB_WITH_OVERHEAD(ksize(data));
 	prefetchw(data + size);
 
-	memset(skb, 0, offsetof(struct sk_buff, tail));
-	
-	skb->truesize = SKB_TRUESIZE(size);
-	atomic_set(&skb->users, 1);
-	skb->head = data;
-	skb->data = data;
-	skb_reset_tail_pointer(skb);
-	skb->end = skb->tail + size;
-#ifdef NET_SKBUFF_DATA_USES_OFFSET
-	skb->mac_header = ~0U;
-#endif
-
-	
-	shinfo = skb_shinfo(skb);
-	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
-	atomic_set(&shinfo->dataref, 1);
-	kmemcheck_annotate_variable(shinfo->destructor_arg);
+	__skb_init_data(skb, data, size);
 
 	if (fclone) {
 		struct sk_buff *child = skb + 1;
@@ -186,7 +192,6 @@ EXPORT_SYMBOL(__alloc_skb);
 
 struct sk_buff *build_skb(void *data)
 {
-	struct skb_shared_info *shinfo;
 	struct sk_buff *skb;
 	unsigned int size;
 
@@ -196,27 +201,46 @@ struct sk_buff *build_skb(void *data)
 
 	size = ksize(data) - SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 
-	memset(skb, 0, offsetof(struct sk_buff, tail));
-	skb->truesize = SKB_TRUESIZE(size);
-	atomic_set(&skb->users, 1);
-	skb->head = data;
-	skb->data = data;
-	skb_reset_tail_pointer(skb);
-	skb->end = skb->tail + size;
-#ifdef NET_SKBUFF_DATA_USES_OFFSET
-	skb->mac_header = ~0U;
-#endif
-
-	
-	shinfo = skb_shinfo(skb);
-	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
-	atomic_set(&shinfo->dataref, 1);
-	kmemcheck_annotate_variable(shinfo->destructor_arg);
+	__skb_init_data(skb, data, size);
 
 	return skb;
 }
 EXPORT_SYMBOL(build_skb);
 
+/*
+ * Allocate @nr skbs of @length bytes for @dev, as __netdev_alloc_skb()
+ * would, taking the heads from skbuff_head_cache in one bulk call.  Returns
+ * how many were filled in from the start of @skbs.
+ */
+int __netdev_alloc_skb_bulk(struct net_device *dev, unsigned int length,
+			    gfp_t gfp_mask, struct sk_buff **skbs, int nr)
+{
+	unsigned int size;
+	int i;
+
+	if (nr <= 0 || !kmem_cache_alloc_bulk(skbuff_head_cache,
+				gfp_mask & ~__GFP_DMA, nr, (void **)skbs))
+		return 0;
+
+	size = SKB_DATA_ALIGN(length + NET_SKB_PAD) +
+	       SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
+	for (i = 0; i < nr; i++) {
+		struct sk_buff *skb = skbs[i];
+		u8 *data = kmalloc_track_caller(size, gfp_mask);
+
+		if (!data) {
+			kmem_cache_free_bulk(skbuff_head_cache, nr - i,
+					     (void **)skbs + i);
+			break;
+		}
+		__skb_init_data(skb, data, SKB_WITH_OVERHEAD(ksize(data)));
+		skb_reserve(skb, NET_SKB_PAD);
+		skb->dev = dev;
+	}
+	return i;
+}
+EXPORT_SYMBOL(__netdev_alloc_skb_bulk);
+
 struct sk_buff *__netdev_alloc_skb(struct net_device *dev,
 		unsigned int length, gfp_t gfp_mask)
 {
@@ -1248,6 +1248,10 @@ struct sock *sk_clone_lock(const struct sock *sk, const gfp_t priority)
 		bh_lock_sock(newsk);
 		newsk->sk_backlog.head	= newsk->sk_backlog.tail = NULL;
 		newsk->sk_backlog.len = 0;
+#ifdef CONFIG_NETFILTER_XT_MATCH_QTAGUID
+		/* A tag is per socket, the child starts out untagged */
+		RCU_INIT_POINTER(newsk->sk_qtaguid, NULL);
+#endif
 
 		atomic_set(&newsk->sk_rmem_alloc, 0);
 		atomic_set(&newsk->sk_wmem_alloc, 1);
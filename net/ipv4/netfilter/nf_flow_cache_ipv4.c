@@ -0,0 +1,500 @@
+/*
+ * IPv4 forwarding flow cache
+ *
+ * Once conntrack has seen a forwarded TCP or UDP connection established in
+ * both directions, each direction is entered in a hash keyed by the tuple
+ * as it arrives and the input device, together with the translated tuple
+ * and the route it leaves by.  Later packets of the flow are matched in
+ * PRE_ROUTING ahead of defrag and conntrack, NATed, TTL decremented and
+ * handed straight to dst_output() with POST_ROUTING skipped.  Anything out
+ * of the ordinary (fragments, IP options, TCP SYN/FIN/RST, packets above
+ * the route MTU) still takes the full path, so conntrack sees the flow
+ * close and state changes.
+ *
+ * The conntrack entry is kept alive by a periodic scan that refreshes its
+ * timeout for flows used since the last scan and drops flows idle for
+ * longer than the cache timeout, or whose entry or route went away.
+ * Rules in the mangle and filter tables are only evaluated for the first
+ * packets of a flow.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+#include <linux/types.h>
+#include <linux/module.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/jhash.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/netdevice.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/netfilter.h>
+#include <linux/netfilter_ipv4.h>
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/dst.h>
+#include <net/checksum.h>
+#include <net/netfilter/nf_conntrack.h>
+#include <net/netfilter/nf_conntrack_helper.h>
+
+#define FLOW_HASH_SIZE		1024
+#define FLOW_MAX		4096
+#define FLOW_GC_INTERVAL	HZ
+
+static bool enable = true;
+module_param(enable, bool, 0644);
+MODULE_PARM_DESC(enable, "Forward established flows from the cache");
+
+static unsigned int timeout = 30;
+module_param(timeout, uint, 0644);
+MODULE_PARM_DESC(timeout, "Seconds after which an idle flow leaves the cache");
+
+struct flow_key {
+	__be32 saddr;
+	__be32 daddr;
+	__be16 sport;
+	__be16 dport;
+	u8 protonum;
+	int iif;
+};
+
+struct flow {
+	struct hlist_node hnode;
+	struct flow_key key;
+	__be32 new_saddr;
+	__be32 new_daddr;
+	__be16 new_sport;
+	__be16 new_dport;
+	struct dst_entry *dst;
+	struct nf_conn *ct;
+	unsigned long ct_timeout;
+	unsigned long last_used;
+	unsigned long last_sync;
+	unsigned long packets;
+	bool dead;
+	struct rcu_head rcu;
+};
+
+static struct hlist_head flow_hash[FLOW_HASH_SIZE];
+static DEFINE_SPINLOCK(flow_lock);
+static unsigned int flow_count;
+static u32 flow_seed __read_mostly;
+static unsigned long stat_hits, stat_added, stat_removed;
+
+static void flow_gc(struct work_struct *work);
+static DECLARE_DELAYED_WORK(flow_gc_work, flow_gc);
+
+static inline u32 flow_hash_key(const struct flow_key *key)
+{
+	return jhash_3words((__force u32)key->saddr, (__force u32)key->daddr,
+			    ((__force u32)key->sport << 16 |
+			     (__force u32)key->dport) ^ key->protonum,
+			    flow_seed ^ key->iif) & (FLOW_HASH_SIZE - 1);
+}
+
+static struct flow *flow_lookup(const struct flow_key *key)
+{
+	struct hlist_node *n;
+	struct flow *f;
+
+	hlist_for_each_entry_rcu(f, n, &flow_hash[flow_hash_key(key)], hnode)
+		if (!memcmp(&f->key, key, sizeof(*key)) && !f->dead)
+			return f;
+	return NULL;
+}
+
+static void flow_free_rcu(struct rcu_head *head)
+{
+	struct flow *f = container_of(head, struct flow, rcu);
+
+	dst_release(f->dst);
+	nf_ct_put(f->ct);
+	kfree(f);
+}
+
+/* Called with flow_lock held */
+static void flow_remove(struct flow *f)
+{
+	hlist_del_rcu(&f->hnode);
+	flow_count--;
+	stat_removed++;
+	call_rcu(&f->rcu, flow_free_rcu);
+}
+
+static int flow_key_from_skb(struct sk_buff *skb, struct flow_key *key)
+{
+	const struct iphdr *iph = ip_hdr(skb);
+	const struct tcphdr *th;
+	unsigned int thoff = sizeof(*iph);
+
+	if (iph->ihl != 5 || iph->frag_off & htons(IP_MF | IP_OFFSET) ||
+	    iph->ttl <= 1)
+		return -1;
+
+	switch (iph->protocol) {
+	case IPPROTO_TCP:
+		if (!pskb_may_pull(skb, thoff + sizeof(struct tcphdr)))
+			return -1;
+		th = (struct tcphdr *)(skb_network_header(skb) + thoff);
+		if (tcp_flag_word(th) & (TCP_FLAG_SYN | TCP_FLAG_FIN |
+					 TCP_FLAG_RST))
+			return -1;
+		break;
+	case IPPROTO_UDP:
+		if (!pskb_may_pull(skb, thoff + sizeof(struct udphdr)))
+			return -1;
+		break;
+	default:
+		return -1;
+	}
+
+	iph = ip_hdr(skb);
+	memset(key, 0, sizeof(*key));
+	key->saddr = iph->saddr;
+	key->daddr = iph->daddr;
+	key->protonum = iph->protocol;
+	/* source and dest sit at the same offsets in both headers */
+	th = (struct tcphdr *)(skb_network_header(skb) + thoff);
+	key->sport = th->source;
+	key->dport = th->dest;
+	key->iif = skb->dev->ifindex;
+	return 0;
+}
+
+static int flow_manip(struct sk_buff *skb, const struct flow *f)
+{
+	unsigned int thoff = sizeof(struct iphdr);
+	struct iphdr *iph;
+	struct udphdr *uh;
+	struct tcphdr *th;
+	__sum16 *check;
+	__be16 *sport, *dport;
+
+	if (!skb_make_writable(skb, thoff + (f->key.protonum == IPPROTO_TCP ?
+					     sizeof(*th) : sizeof(*uh))))
+		return -1;
+
+	iph = ip_hdr(skb);
+	if (f->key.protonum == IPPROTO_TCP) {
+		th = (struct tcphdr *)(skb_network_header(skb) + thoff);
+		check = &th->check;
+		sport = &th->source;
+		dport = &th->dest;
+	} else {
+		uh = (struct udphdr *)(skb_network_header(skb) + thoff);
+		check = (uh->check || skb->ip_summed == CHECKSUM_PARTIAL) ?
+			&uh->check : NULL;
+		sport = &uh->source;
+		dport = &uh->dest;
+	}
+
+	if (check) {
+		if (iph->saddr != f->new_saddr)
+			inet_proto_csum_replace4(check, skb, iph->saddr,
+						 f->new_saddr, 1);
+		if (iph->daddr != f->new_daddr)
+			inet_proto_csum_replace4(check, skb, iph->daddr,
+						 f->new_daddr, 1);
+		if (*sport != f->new_sport)
+			inet_proto_csum_replace2(check, skb, *sport,
+						 f->new_sport, 0);
+		if (*dport != f->new_dport)
+			inet_proto_csum_replace2(check, skb, *dport,
+						 f->new_dport, 0);
+		if (f->key.protonum == IPPROTO_UDP && !*check)
+			*check = CSUM_MANGLED_0;
+	}
+	*sport = f->new_sport;
+	*dport = f->new_dport;
+
+	csum_replace4(&iph->check, iph->saddr, f->new_saddr);
+	csum_replace4(&iph->check, iph->daddr, f->new_daddr);
+	iph->saddr = f->new_saddr;
+	iph->daddr = f->new_daddr;
+	ip_decrease_ttl(iph);
+	return 0;
+}
+
+static unsigned int flow_cache_in(unsigned int hooknum,
+				  struct sk_buff *skb,
+				  const struct net_device *in,
+				  const struct net_device *out,
+				  int (*okfn)(struct sk_buff *))
+{
+	struct flow_key key;
+	struct dst_entry *dst;
+	struct flow *f;
+
+	if (!enable || skb->pkt_type != PACKET_HOST ||
+	    !net_eq(dev_net(in), &init_net) || skb->nfct)
+		return NF_ACCEPT;
+	if (flow_key_from_skb(skb, &key))
+		return NF_ACCEPT;
+
+	rcu_read_lock();
+	f = flow_lookup(&key);
+	if (!f)
+		goto slow;
+
+	dst = dst_check(f->dst, 0);
+	if (!dst || nf_ct_is_dying(f->ct)) {
+		f->dead = true;
+		goto slow;
+	}
+	if (skb->len > dst_mtu(dst) && !skb_is_gso(skb))
+		goto slow;
+	if (flow_manip(skb, f))
+		goto slow;
+
+	f->last_used = jiffies;
+	f->packets++;
+	stat_hits++;
+
+	skb_dst_set(skb, dst_clone(dst));
+	IPCB(skb)->flags |= IPSKB_FORWARDED | IPSKB_REROUTED;
+	rcu_read_unlock();
+
+	IP_INC_STATS_BH(&init_net, IPSTATS_MIB_OUTFORWDATAGRAMS);
+	dst_output(skb);
+	return NF_STOLEN;
+
+slow:
+	rcu_read_unlock();
+	return NF_ACCEPT;
+}
+
+/* After SNAT: the packet went through the whole forwarding path */
+static unsigned int flow_cache_out(unsigned int hooknum,
+				   struct sk_buff *skb,
+				   const struct net_device *in,
+				   const struct net_device *out,
+				   int (*okfn)(struct sk_buff *))
+{
+	const struct nf_conntrack_tuple *orig, *repl;
+	enum ip_conntrack_info ctinfo;
+	enum ip_conntrack_dir dir;
+	struct dst_entry *dst = skb_dst(skb);
+	struct nf_conn *ct;
+	struct flow_key key;
+	struct flow *f;
+
+	if (!enable || !(IPCB(skb)->flags & IPSKB_FORWARDED) ||
+	    !dst || dst->xfrm || !net_eq(dev_net(out), &init_net))
+		return NF_ACCEPT;
+
+	ct = nf_ct_get(skb, &ctinfo);
+	if (!ct || nf_ct_is_untracked(ct) ||
+	    (ctinfo != IP_CT_ESTABLISHED && ctinfo != IP_CT_ESTABLISHED_REPLY) ||
+	    !test_bit(IPS_ASSURED_BIT, &ct->status) || nfct_help(ct) ||
+	    test_bit(IPS_SEQ_ADJUST_BIT, &ct->status))
+		return NF_ACCEPT;
+
+	dir = CTINFO2DIR(ctinfo);
+	orig = &ct->tuplehash[dir].tuple;
+	repl = &ct->tuplehash[!dir].tuple;
+	if (orig->dst.protonum == IPPROTO_TCP) {
+		if (ct->proto.tcp.state != TCP_CONNTRACK_ESTABLISHED)
+			return NF_ACCEPT;
+	} else if (orig->dst.protonum != IPPROTO_UDP)
+		return NF_ACCEPT;
+
+	memset(&key, 0, sizeof(key));
+	key.saddr = orig->src.u3.ip;
+	key.daddr = orig->dst.u3.ip;
+	key.sport = orig->src.u.all;
+	key.dport = orig->dst.u.all;
+	key.protonum = orig->dst.protonum;
+	key.iif = skb->skb_iif;
+
+	rcu_read_lock();
+	f = flow_lookup(&key);
+	rcu_read_unlock();
+	if (f || ACCESS_ONCE(flow_count) >= FLOW_MAX)
+		return NF_ACCEPT;
+
+	f = kzalloc(sizeof(*f), GFP_ATOMIC);
+	if (!f)
+		return NF_ACCEPT;
+
+	f->key = key;
+	f->new_saddr = repl->dst.u3.ip;
+	f->new_daddr = repl->src.u3.ip;
+	f->new_sport = repl->dst.u.all;
+	f->new_dport = repl->src.u.all;
+	f->dst = dst_clone(dst);
+	nf_conntrack_get(&ct->ct_general);
+	f->ct = ct;
+	f->last_used = f->last_sync = jiffies;
+	/* What the packet that just went through conntrack set it to */
+	f->ct_timeout = max_t(long, ct->timeout.expires - jiffies,
+			      2 * FLOW_GC_INTERVAL);
+
+	/* Conntrack no longer sees every segment of the window */
+	if (key.protonum == IPPROTO_TCP) {
+		spin_lock_bh(&ct->lock);
+		ct->proto.tcp.seen[0].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+		ct->proto.tcp.seen[1].flags |= IP_CT_TCP_FLAG_BE_LIBERAL;
+		spin_unlock_bh(&ct->lock);
+	}
+
+	spin_lock_bh(&flow_lock);
+	if (flow_lookup(&key)) {
+		spin_unlock_bh(&flow_lock);
+		dst_release(f->dst);
+		nf_ct_put(ct);
+		kfree(f);
+		return NF_ACCEPT;
+	}
+	hlist_add_head_rcu(&f->hnode, &flow_hash[flow_hash_key(&key)]);
+	flow_count++;
+	stat_added++;
+	spin_unlock_bh(&flow_lock);
+	return NF_ACCEPT;
+}
+
+static void flow_gc(struct work_struct *work)
+{
+	struct hlist_node *n, *tmp;
+	struct flow *f;
+	unsigned long idle = timeout * HZ;
+	int i;
+
+	spin_lock_bh(&flow_lock);
+	for (i = 0; i < FLOW_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(f, n, tmp, &flow_hash[i], hnode) {
+			if (f->dead || !enable || nf_ct_is_dying(f->ct) ||
+			    time_after(jiffies, f->last_used + idle) ||
+			    (f->key.protonum == IPPROTO_TCP &&
+			     f->ct->proto.tcp.state !=
+			     TCP_CONNTRACK_ESTABLISHED)) {
+				flow_remove(f);
+				continue;
+			}
+			if (time_after(f->last_used, f->last_sync) &&
+			    !test_bit(IPS_FIXED_TIMEOUT_BIT, &f->ct->status)) {
+				mod_timer_pending(&f->ct->timeout,
+						  jiffies + f->ct_timeout);
+				f->last_sync = f->last_used;
+			}
+		}
+	}
+	spin_unlock_bh(&flow_lock);
+
+	schedule_delayed_work(&flow_gc_work, FLOW_GC_INTERVAL);
+}
+
+static void flow_flush(const struct net_device *dev)
+{
+	struct hlist_node *n, *tmp;
+	struct flow *f;
+	int i;
+
+	spin_lock_bh(&flow_lock);
+	for (i = 0; i < FLOW_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(f, n, tmp, &flow_hash[i], hnode)
+			if (!dev || f->key.iif == dev->ifindex ||
+			    f->dst->dev == dev)
+				flow_remove(f);
+	spin_unlock_bh(&flow_lock);
+}
+
+static int flow_netdev_event(struct notifier_block *this,
+			     unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+
+	if (event == NETDEV_DOWN || event == NETDEV_UNREGISTER)
+		flow_flush(dev);
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block flow_netdev_notifier = {
+	.notifier_call	= flow_netdev_event,
+};
+
+static int flow_stat_show(struct seq_file *s, void *v)
+{
+	seq_printf(s, "entries %u hits %lu added %lu removed %lu\n",
+		   flow_count, stat_hits, stat_added, stat_removed);
+	return 0;
+}
+
+static int flow_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, flow_stat_show, NULL);
+}
+
+static const struct file_operations flow_stat_fops = {
+	.owner		= THIS_MODULE,
+	.open		= flow_stat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static struct nf_hook_ops flow_cache_ops[] __read_mostly = {
+	{
+		.hook		= flow_cache_in,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_PRE_ROUTING,
+		.priority	= NF_IP_PRI_CONNTRACK_DEFRAG - 1,
+	},
+	{
+		.hook		= flow_cache_out,
+		.owner		= THIS_MODULE,
+		.pf		= NFPROTO_IPV4,
+		.hooknum	= NF_INET_POST_ROUTING,
+		.priority	= NF_IP_PRI_NAT_SRC + 1,
+	},
+};
+
+static int __init nf_flow_cache_init(void)
+{
+	int ret;
+
+	get_random_bytes(&flow_seed, sizeof(flow_seed));
+
+	if (!proc_net_fops_create(&init_net, "nf_flow_cache", S_IRUGO,
+				  &flow_stat_fops))
+		return -ENOMEM;
+
+	ret = register_netdevice_notifier(&flow_netdev_notifier);
+	if (ret < 0)
+		goto err_proc;
+
+	ret = nf_register_hooks(flow_cache_ops, ARRAY_SIZE(flow_cache_ops));
+	if (ret < 0)
+		goto err_notifier;
+
+	schedule_delayed_work(&flow_gc_work, FLOW_GC_INTERVAL);
+	return 0;
+
+err_notifier:
+	unregister_netdevice_notifier(&flow_netdev_notifier);
+err_proc:
+	proc_net_remove(&init_net, "nf_flow_cache");
+	return ret;
+}
+
+static void __exit nf_flow_cache_fini(void)
+{
+	nf_unregister_hooks(flow_cache_ops, ARRAY_SIZE(flow_cache_ops));
+	unregister_netdevice_notifier(&flow_netdev_notifier);
+	cancel_delayed_work_sync(&flow_gc_work);
+	flow_flush(NULL);
+	rcu_barrier();
+	proc_net_remove(&init_net, "nf_flow_cache");
+}
+
+module_init(nf_flow_cache_init);
+module_exit(nf_flow_cache_fini);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("IPv4 forwarding flow cache for established conntrack flows");
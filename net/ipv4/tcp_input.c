@@ -182,6 +182,26 @@ static void tcp_fixup_sndbuf(struct sock *sk)
 }
 
 
+/*
+ * Buffer defaults of the device the connection runs over, for links such
+ * as cellular ones whose latency calls for other sizes than the global
+ * tcp_rmem/tcp_wmem defaults.
+ */
+void tcp_init_dev_buffers(struct sock *sk, const struct dst_entry *dst)
+{
+	const struct net_device *dev = dst ? dst->dev : NULL;
+
+	if (!dev)
+		return;
+
+	if (dev->tcp_rmem_default && !(sk->sk_userlocks & SOCK_RCVBUF_LOCK))
+		sk->sk_rcvbuf = min_t(int, dev->tcp_rmem_default,
+				      sysctl_tcp_rmem[2]);
+	if (dev->tcp_wmem_default && !(sk->sk_userlocks & SOCK_SNDBUF_LOCK))
+		sk->sk_sndbuf = min_t(int, dev->tcp_wmem_default,
+				      sysctl_tcp_wmem[2]);
+}
+
 static int __tcp_grow_window(const struct sock *sk, const struct sk_buff *skb)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
@@ -248,6 +268,7 @@ static void tcp_init_buffer_space(struct sock *sk)
 	struct tcp_sock *tp = tcp_sk(sk);
 	int maxwin;
 
+	tcp_init_dev_buffers(sk, __sk_dst_get(sk));
 	if (!(sk->sk_userlocks & SOCK_RCVBUF_LOCK))
 		tcp_fixup_rcvbuf(sk);
 	if (!(sk->sk_userlocks & SOCK_SNDBUF_LOCK))
@@ -356,11 +377,18 @@ static inline void tcp_rcv_rtt_measure_ts(struct sock *sk,
 		tcp_rcv_rtt_update(tp, tcp_time_stamp - tp->rx_opt.rcv_tsecr, 0);
 }
 
+/*
+ * Once per RTT, size the receive buffer for what the application read in
+ * that RTT.  While the sender is still ramping up (slow start) the amount
+ * read grows every RTT, so leave room for the growth expected in the next
+ * one instead of trailing the sender by an RTT each step; on long RTT
+ * links such as cellular this is what gets a download to full rate early.
+ */
 void tcp_rcv_space_adjust(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	int time;
-	int space;
+	int copied;
 
 	if (tp->rcvq_space.time == 0)
 		goto new_measure;
@@ -369,35 +397,41 @@ void tcp_rcv_space_adjust(struct sock *sk)
 	if (time < (tp->rcv_rtt_est.rtt >> 3) || tp->rcv_rtt_est.rtt == 0)
 		return;
 
-	space = 2 * (tp->copied_seq - tp->rcvq_space.seq);
+	copied = tp->copied_seq - tp->rcvq_space.seq;
+	if (copied <= tp->rcvq_space.space)
+		goto new_measure;
 
-	space = max(tp->rcvq_space.space, space);
+	if (sysctl_tcp_moderate_rcvbuf &&
+	    !(sk->sk_userlocks & SOCK_RCVBUF_LOCK)) {
+		int rcvwin, rcvmem, rcvbuf;
 
-	if (tp->rcvq_space.space != space) {
-		int rcvmem;
+		rcvwin = (copied << 1) + 16 * tp->advmss;
 
-		tp->rcvq_space.space = space;
+		if (tp->rcvq_space.space &&
+		    copied >= tp->rcvq_space.space +
+			      (tp->rcvq_space.space >> 2)) {
+			u64 grow = (u64)rcvwin *
+				   (copied - tp->rcvq_space.space);
 
-		if (sysctl_tcp_moderate_rcvbuf &&
-		    !(sk->sk_userlocks & SOCK_RCVBUF_LOCK)) {
-			int new_clamp = space;
+			do_div(grow, tp->rcvq_space.space);
+			rcvwin += (int)min_t(u64, grow << 1,
+					     sysctl_tcp_rmem[2]);
+		}
 
-			space /= tp->advmss;
-			if (!space)
-				space = 1;
-			rcvmem = SKB_TRUESIZE(tp->advmss + MAX_TCP_HEADER);
-			while (tcp_win_from_space(rcvmem) < tp->advmss)
-				rcvmem += 128;
-			space *= rcvmem;
-			space = min(space, sysctl_tcp_rmem[2]);
-			if (space > sk->sk_rcvbuf) {
-				sk->sk_rcvbuf = space;
+		rcvmem = SKB_TRUESIZE(tp->advmss + MAX_TCP_HEADER);
+		while (tcp_win_from_space(rcvmem) < tp->advmss)
+			rcvmem += 128;
 
-				
-				tp->window_clamp = new_clamp;
-			}
+		rcvbuf = min_t(u64, (u64)(rcvwin / tp->advmss) * rcvmem,
+			       sysctl_tcp_rmem[2]);
+		if (rcvbuf > sk->sk_rcvbuf) {
+			sk->sk_rcvbuf = rcvbuf;
+
+			
+			tp->window_clamp = rcvwin;
 		}
 	}
+	tp->rcvq_space.space = copied;
 
 new_measure:
 	tp->rcvq_space.seq = tp->copied_seq;
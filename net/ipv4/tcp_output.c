@@ -1981,7 +1981,7 @@ struct sk_buff *tcp_make_synack(struct sock *sk, struct dst_entry *dst,
 			&req->window_clamp,
 			ireq->wscale_ok,
 			&rcv_wscale,
-			dst_metric(dst, RTAX_INITRWND));
+			tcp_dst_initrwnd(dst));
 		ireq->rcv_wscale = rcv_wscale;
 	}
 
@@ -2088,6 +2088,7 @@ static void tcp_connect_init(struct sock *sk)
 		tp->advmss = tp->rx_opt.user_mss;
 
 	tcp_initialize_rcv_mss(sk);
+	tcp_init_dev_buffers(sk, dst);
 
 	
 	if (sk->sk_userlocks & SOCK_RCVBUF_LOCK &&
@@ -2100,7 +2101,7 @@ static void tcp_connect_init(struct sock *sk)
 				  &tp->window_clamp,
 				  sysctl_tcp_window_scaling,
 				  &rcv_wscale,
-				  dst_metric(dst, RTAX_INITRWND));
+				  tcp_dst_initrwnd(dst));
 
 	tp->rx_opt.rcv_wscale = rcv_wscale;
 	tp->rcv_ssthresh = tp->rcv_wnd;
@@ -93,9 +93,11 @@ static DEFINE_SPINLOCK(iface_stat_list_lock);
 
 static struct rb_root sock_tag_tree = RB_ROOT;
 static DEFINE_SPINLOCK(sock_tag_list_lock);
+static seqcount_t sock_tag_seq = SEQCNT_ZERO;
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
+static seqcount_t tag_counter_set_seq = SEQCNT_ZERO;
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
 static DEFINE_SPINLOCK(uid_tag_data_tree_lock);
@@ -156,6 +158,45 @@ static struct tag_node *tag_node_tree_search(struct rb_root *root, tag_t tag)
 	return NULL;
 }
 
+/*
+ * tag_node_tree_search() for the packet path, under rcu_read_lock() and
+ * with writers bumping @seq.  A walk racing a rebalance can take a wrong
+ * turn, which the retry catches; the depth bound keeps it from chasing a
+ * half rotated link until then.
+ */
+#define TAG_NODE_MAX_DEPTH	64
+
+static struct tag_node *tag_node_tree_search_rcu(struct rb_root *root,
+						 const seqcount_t *seq,
+						 tag_t tag)
+{
+	struct tag_node *data;
+	struct rb_node *node;
+	unsigned int start;
+	int depth;
+
+	do {
+		start = read_seqcount_begin(seq);
+		data = NULL;
+		node = ACCESS_ONCE(root->rb_node);
+		for (depth = 0; node && depth < TAG_NODE_MAX_DEPTH; depth++) {
+			struct tag_node *this = rb_entry(node, struct tag_node,
+							 node);
+			int result = tag_compare(tag, this->tag);
+
+			if (result < 0) {
+				node = ACCESS_ONCE(node->rb_left);
+			} else if (result > 0) {
+				node = ACCESS_ONCE(node->rb_right);
+			} else {
+				data = this;
+				break;
+			}
+		}
+	} while (read_seqcount_retry(seq, start));
+	return data;
+}
+
 static void tag_node_tree_insert(struct tag_node *data, struct rb_root *root)
 {
 	struct rb_node **new = &(root->rb_node), *parent = NULL;
@@ -196,6 +237,19 @@ static struct tag_stat *tag_stat_tree_search(struct rb_root *root, tag_t tag)
 	return rb_entry(&node->node, struct tag_stat, tn.node);
 }
 
+/* Lockless, caller holds rcu_read_lock() */
+static struct tag_stat *tag_stat_lookup(struct iface_stat *iface_entry,
+					tag_t tag)
+{
+	struct tag_node *node;
+
+	node = tag_node_tree_search_rcu(&iface_entry->tag_stat_tree,
+					&iface_entry->tag_stat_seq, tag);
+	if (!node)
+		return NULL;
+	return container_of(node, struct tag_stat, tn);
+}
+
 static void tag_counter_set_tree_insert(struct tag_counter_set *data,
 					struct rb_root *root)
 {
@@ -281,10 +335,17 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
+/* Called under sock_tag_list_lock, the socket is still referenced */
+static void sock_tag_unlink(struct sock_tag *st_entry)
+{
+	rb_erase(&st_entry->sock_node, &sock_tag_tree);
+	RCU_INIT_POINTER(st_entry->sk->sk_qtaguid, NULL);
+}
+
 static struct proc_qtu_data *proc_qtu_data_tree_search(struct rb_root *root,
 						       const pid_t pid)
 {
@@ -579,18 +640,20 @@ static int read_proc_bool(char *page, char **start, off_t off,
 static int get_active_counter_set(tag_t tag)
 {
 	int active_set = 0;
-	struct tag_counter_set *tcs;
+	struct tag_node *node;
 
 	MT_DEBUG("qtaguid: get_active_counter_set(tag=0x%llx)"
 		 " (uid=%u)\n",
 		 tag, get_uid_from_tag(tag));
 	
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
-	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
-	if (tcs)
-		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+	rcu_read_lock();
+	node = tag_node_tree_search_rcu(&tag_counter_set_tree,
+					&tag_counter_set_seq, tag);
+	if (node)
+		active_set = ACCESS_ONCE(container_of(
+				node, struct tag_counter_set, tn)->active_set);
+	rcu_read_unlock();
 	return active_set;
 }
 
@@ -605,7 +668,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -631,9 +694,10 @@ static int pp_iface_stat_line(bool header, char *outp,
 			       "tx_other_bytes tx_other_packets\n"
 			);
 	} else {
-		struct data_counters *cnts;
+		struct data_counters *cnts, totals;
 		int cnt_set = 0;   
-		cnts = &iface_entry->totals_via_skb;
+		data_counters_read(iface_entry->totals_via_skb, &totals);
+		cnts = &totals;
 		len = snprintf(
 			outp, char_count,
 			"%s "
@@ -821,7 +885,18 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		kfree(new_iface);
 		return NULL;
 	}
+	new_iface->totals_via_skb = kcalloc(nr_cpu_ids,
+					    sizeof(*new_iface->totals_via_skb),
+					    GFP_ATOMIC);
+	if (new_iface->totals_via_skb == NULL) {
+		pr_err("qtaguid: iface_stat: create(%s): "
+		       "counters alloc failed\n", net_dev->name);
+		kfree(new_iface->ifname);
+		kfree(new_iface);
+		return NULL;
+	}
 	spin_lock_init(&new_iface->tag_stat_list_lock);
+	seqcount_init(&new_iface->tag_stat_seq);
 	new_iface->tag_stat_tree = RB_ROOT;
 	_iface_stat_set_active(new_iface, net_dev, true);
 
@@ -830,6 +905,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "work alloc failed\n", new_iface->ifname);
 		_iface_stat_set_active(new_iface, net_dev, false);
+		kfree(new_iface->totals_via_skb);
 		kfree(new_iface->ifname);
 		kfree(new_iface);
 		return NULL;
@@ -837,7 +913,8 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	/* The packet path walks the list under rcu only */
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1013,16 +1090,25 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
-static struct sock_tag *get_sock_stat(const struct sock *sk)
+/* The packet path finds the tag through the sock, not the tree */
+static bool get_sock_tag(const struct sock *sk, tag_t *tag)
 {
 	struct sock_tag *sock_tag_entry;
-	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
+	unsigned int start;
+
+	MT_DEBUG("qtaguid: get_sock_tag(sk=%p)\n", sk);
 	if (!sk)
-		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+		return false;
+	rcu_read_lock();
+	sock_tag_entry = rcu_dereference(sk->sk_qtaguid);
+	if (sock_tag_entry) {
+		do {
+			start = read_seqcount_begin(&sock_tag_seq);
+			*tag = sock_tag_entry->tag;
+		} while (read_seqcount_retry(&sock_tag_seq, start));
+	}
+	rcu_read_unlock();
+	return sock_tag_entry != NULL;
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1065,6 +1151,47 @@ data_counters_update(struct data_counters *dc, int set,
 	}
 }
 
+void data_counters_read(const struct data_counters_pcpu *slots,
+			struct data_counters *res)
+{
+	const int nr = sizeof(res->bpc) / sizeof(res->bpc[0][0][0]);
+	struct byte_packet_counters *sum = &res->bpc[0][0][0];
+	int cpu, i;
+
+	memset(res, 0, sizeof(*res));
+	for_each_possible_cpu(cpu) {
+		const struct data_counters_pcpu *slot = &slots[cpu];
+		const struct byte_packet_counters *bpc;
+		struct data_counters dc;
+		unsigned int start;
+
+		do {
+			start = u64_stats_fetch_begin(&slot->syncp);
+			dc = slot->dc;
+		} while (u64_stats_fetch_retry(&slot->syncp, start));
+
+		bpc = &dc.bpc[0][0][0];
+		for (i = 0; i < nr; i++) {
+			sum[i].bytes += bpc[i].bytes;
+			sum[i].packets += bpc[i].packets;
+		}
+	}
+}
+
+static void data_counters_pcpu_update(struct data_counters_pcpu *slots,
+				      int set, enum ifs_tx_rx direction,
+				      int proto, int bytes)
+{
+	struct data_counters_pcpu *slot;
+
+	local_bh_disable();
+	slot = &slots[smp_processor_id()];
+	u64_stats_update_begin(&slot->syncp);
+	data_counters_update(&slot->dc, set, direction, proto, bytes);
+	u64_stats_update_end(&slot->syncp);
+	local_bh_enable();
+}
+
 static void iface_stat_update(struct net_device *net_dev, bool stash_only)
 {
 	struct rtnl_link_stats64 dev_stats, *stats;
@@ -1153,21 +1280,21 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 			 par->family, proto);
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	entry = get_iface_entry(el_dev->name);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	data_counters_update(&entry->totals_via_skb, 0, direction, proto,
-			     bytes);
-	spin_unlock_bh(&iface_stat_list_lock);
+	data_counters_pcpu_update(entry->totals_via_skb, 0, direction, proto,
+				  bytes);
+	rcu_read_unlock();
 }
 
 static void tag_stat_update(struct tag_stat *tag_entry,
@@ -1179,27 +1306,33 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
-			     proto, bytes);
-	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
-				     direction, proto, bytes);
+	data_counters_pcpu_update(tag_entry->counters, active_set, direction,
+				  proto, bytes);
+	if (tag_entry->parent)
+		data_counters_pcpu_update(tag_entry->parent->counters,
+					  active_set, direction, proto, bytes);
 }
 
 static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
-					   tag_t tag)
+					   tag_t tag, struct tag_stat *parent)
 {
 	struct tag_stat *new_tag_stat_entry = NULL;
 	IF_DEBUG("qtaguid: iface_stat: %s(): ife=%p tag=0x%llx"
 		 " (uid=%u)\n", __func__,
 		 iface_entry, tag, get_uid_from_tag(tag));
-	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry), GFP_ATOMIC);
+	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry) +
+				     nr_cpu_ids *
+				     sizeof(new_tag_stat_entry->counters[0]),
+				     GFP_ATOMIC);
 	if (!new_tag_stat_entry) {
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
 	new_tag_stat_entry->tn.tag = tag;
+	new_tag_stat_entry->parent = parent;
+	write_seqcount_begin(&iface_entry->tag_stat_seq);
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
+	write_seqcount_end(&iface_entry->tag_stat_seq);
 done:
 	return new_tag_stat_entry;
 }
@@ -1211,8 +1344,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
-	struct sock_tag *sock_tag_entry;
+	struct tag_stat *uid_tag_stat;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
@@ -1231,9 +1363,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
 		 ifname, iface_entry);
 
-	sock_tag_entry = get_sock_stat(sk);
-	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
+	if (get_sock_tag(sk, &tag)) {
 		acct_tag = get_atag_from_tag(tag);
 		uid_tag = get_utag_from_tag(tag);
 	} else {
@@ -1245,6 +1375,16 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
 	
+	rcu_read_lock();
+	tag_stat_entry = tag_stat_lookup(iface_entry, tag);
+	if (tag_stat_entry) {
+		tag_stat_update(tag_stat_entry, direction, proto, bytes);
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+
+	/* First packet for the tag here, it may have raced in since */
 	spin_lock_bh(&iface_entry->tag_stat_list_lock);
 
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
@@ -1256,24 +1396,21 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	}
 
 	
-	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      uid_tag);
-	if (!tag_stat_entry) {
+	uid_tag_stat = tag_stat_tree_search(&iface_entry->tag_stat_tree,
+					    uid_tag);
+	if (!uid_tag_stat) {
 		
-		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
-		uid_tag_counters = &new_tag_stat->counters;
-	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_stat = create_if_tag_stat(iface_entry, uid_tag, NULL);
+		new_tag_stat = uid_tag_stat;
 	}
 
-	if (acct_tag) {
+	if (acct_tag && uid_tag_stat) {
 		
-		new_tag_stat = create_if_tag_stat(iface_entry, tag);
-		new_tag_stat->parent_counters = uid_tag_counters;
-	} else {
-		BUG_ON(!new_tag_stat);
+		new_tag_stat = create_if_tag_stat(iface_entry, tag,
+						  uid_tag_stat);
 	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
+	if (new_tag_stat)
+		tag_stat_update(new_tag_stat, direction, proto, bytes);
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 }
 
@@ -1836,7 +1973,7 @@ static int ctrl_cmd_delete(const char *input)
 			 input, st_entry->tag, entry_uid);
 
 		if (!acct_tag || st_entry->tag == tag) {
-			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			sock_tag_unlink(st_entry);
 			
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -1861,8 +1998,10 @@ static int ctrl_cmd_delete(const char *input)
 			 tcs_entry->tn.tag,
 			 get_uid_from_tag(tcs_entry->tn.tag),
 			 tcs_entry->active_set);
+		write_seqcount_begin(&tag_counter_set_seq);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
-		kfree(tcs_entry);
+		write_seqcount_end(&tag_counter_set_seq);
+		kfree_rcu(tcs_entry, rcu);
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -1887,9 +2026,12 @@ static int ctrl_cmd_delete(const char *input)
 					 input, iface_entry->ifname,
 					 get_atag_from_tag(ts_entry->tn.tag),
 					 entry_uid);
+				write_seqcount_begin(
+					&iface_entry->tag_stat_seq);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				write_seqcount_end(&iface_entry->tag_stat_seq);
+				kfree_rcu(ts_entry, rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -1967,7 +2109,9 @@ static int ctrl_cmd_counter_set(const char *input)
 			goto err;
 		}
 		tcs->tn.tag = tag;
+		write_seqcount_begin(&tag_counter_set_seq);
 		tag_counter_set_tree_insert(tcs, &tag_counter_set_tree);
+		write_seqcount_end(&tag_counter_set_seq);
 		CT_DEBUG("qtaguid: ctrl_counterset(%s): added tcs tag=0x%llx "
 			 "(uid=%u) set=%d\n",
 			 input, tag, get_uid_from_tag(tag), counter_set);
@@ -2060,7 +2204,9 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(IS_ERR_OR_NULL(prev_tag_ref_entry));
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
+		write_seqcount_begin(&sock_tag_seq);
 		sock_tag_entry->tag = full_tag;
+		write_seqcount_end(&sock_tag_seq);
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2095,6 +2241,7 @@ static int ctrl_cmd_tag(const char *input)
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
 		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		rcu_assign_pointer(el_socket->sk->sk_qtaguid, sock_tag_entry);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2156,7 +2303,7 @@ static int ctrl_cmd_untag(const char *input)
 		res = -EINVAL;
 		goto err_put;
 	}
-	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	sock_tag_unlink(sock_tag_entry);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2180,7 +2327,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2267,7 +2414,7 @@ struct proc_print_info {
 static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
-	struct data_counters *cnts;
+	struct data_counters *cnts, counters;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2297,7 +2444,8 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		data_counters_read(ppi->ts_entry->counters, &counters);
+		cnts = &counters;
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2534,7 +2682,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		tr->num_sock_tags--;
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
-		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		sock_tag_unlink(st_entry);
 		list_del(&st_entry->list);
 		
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -12,7 +12,10 @@
 
 #include <linux/types.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
 #include <linux/spinlock_types.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 #define IDEBUG_MASK (1<<0)
@@ -145,6 +148,17 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 		+ counters->bpc[set][direction][IFS_PROTO_OTHER].packets;
 }
 
+/*
+ * The packet path only adds to the slot of the cpu it runs on, readers sum
+ * all slots with data_counters_read().
+ */
+struct data_counters_pcpu {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+};
+
+void data_counters_read(const struct data_counters_pcpu *slots,
+			struct data_counters *res);
 
 struct tag_node {
 	struct rb_node node;
@@ -153,8 +167,11 @@ struct tag_node {
 
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
-	struct data_counters *parent_counters;
+	/* The uid tag_stat, also counted into, freed only along with us */
+	struct tag_stat *parent;
+	struct rcu_head rcu;
+	/* nr_cpu_ids slots */
+	struct data_counters_pcpu counters[0];
 };
 
 struct iface_stat {
@@ -165,14 +182,16 @@ struct iface_stat {
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
+	struct data_counters_pcpu *totals_via_skb;
 	struct byte_packet_counters last_known[IFS_MAX_DIRECTIONS];
 	
 	bool last_known_valid;
 
 	struct proc_dir_entry *proc_ptr;
 
+	/* Searched locklessly by the packet path, see tag_stat_lookup() */
 	struct rb_root tag_stat_tree;
+	seqcount_t tag_stat_seq;
 	spinlock_t tag_stat_list_lock;
 };
 
@@ -190,7 +209,9 @@ struct sock_tag {
 	struct list_head list;   
 	pid_t pid;
 
+	/* Also cached in sk->sk_qtaguid, changes under sock_tag_seq */
 	tag_t tag;
+	struct rcu_head rcu;
 };
 
 struct qtaguid_event_counts {
@@ -215,6 +236,7 @@ struct qtaguid_event_counts {
 struct tag_counter_set {
 	struct tag_node tn;
 	int active_set;
+	struct rcu_head rcu;
 };
 
 struct uid_tag_data {
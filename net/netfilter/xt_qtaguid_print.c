@@ -144,9 +144,9 @@ char *pp_tag_ref(struct tag_ref *tr)
 
 char *pp_tag_stat(struct tag_stat *ts)
 {
+	struct data_counters counters;
 	char *tn_str;
 	char *counters_str;
-	char *parent_counters_str;
 	char *res;
 
 	if (!ts) {
@@ -155,15 +155,14 @@ char *pp_tag_stat(struct tag_stat *ts)
 		return res;
 	}
 	tn_str = pp_tag_node(&ts->tn);
-	counters_str = pp_data_counters(&ts->counters, true);
-	parent_counters_str = pp_data_counters(ts->parent_counters, false);
+	data_counters_read(ts->counters, &counters);
+	counters_str = pp_data_counters(&counters, true);
 	res = kasprintf(GFP_ATOMIC,
-			"tag_stat@%p{%s, counters=%s, parent_counters=%s}",
-			ts, tn_str, counters_str, parent_counters_str);
+			"tag_stat@%p{%s, counters=%s, parent=%p}",
+			ts, tn_str, counters_str, ts->parent);
 	_bug_on_err_or_null(res);
 	kfree(tn_str);
 	kfree(counters_str);
-	kfree(parent_counters_str);
 	return res;
 }
 
@@ -173,7 +172,10 @@ char *pp_iface_stat(struct iface_stat *is)
 	if (!is) {
 		res = kasprintf(GFP_ATOMIC, "iface_stat@null{}");
 	} else {
-		struct data_counters *cnts = &is->totals_via_skb;
+		struct data_counters *cnts, totals;
+
+		data_counters_read(is->totals_via_skb, &totals);
+		cnts = &totals;
 		res = kasprintf(GFP_ATOMIC, "iface_stat@%p{"
 				"list=list_head{...}, "
 				"ifname=%s, "
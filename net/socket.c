@@ -1744,10 +1744,16 @@ static int __sys_sendmsg(struct socket *sock, struct msghdr __user *msg,
 
 	if (sock->file->f_flags & O_NONBLOCK)
 		msg_sys->msg_flags |= MSG_DONTWAIT;
-	if (used_address && msg_sys->msg_name &&
+	/*
+	 * Within a sendmmsg batch the LSM has already approved sending to
+	 * this address, or on this connected socket when messages carry no
+	 * address, so only the first datagram pays for the check.
+	 */
+	if (used_address &&
 	    used_address->name_len == msg_sys->msg_namelen &&
-	    !memcmp(&used_address->name, msg_sys->msg_name,
-		    used_address->name_len)) {
+	    (!msg_sys->msg_name ||
+	     !memcmp(&used_address->name, msg_sys->msg_name,
+		     used_address->name_len))) {
 		err = sock_sendmsg_nosec(sock, msg_sys, total_len);
 		goto out_freectl;
 	}
@@ -50,6 +50,21 @@
 					 COMPRE_CAPTURE_HEADER_SIZE)
 #define COMPRE_OUTPUT_METADATA_SIZE	(sizeof(struct output_meta_data_st))
 
+/*
+ * Playback only allocates what hw_params asks for, so the ceiling can be
+ * most of the audio ION heap: a few minutes of compressed audio, with the
+ * AP woken once per period.
+ */
+#define COMPRE_PLAYBACK_MAX_BUF_SIZE	(4 * 1024 * 1024)
+
+/*
+ * DSP callbacks only keep the AP awake once userspace has to refill, i.e.
+ * when less than this many periods are left queued for the DSP.
+ */
+static int lowwm_periods = 1;
+module_param(lowwm_periods, int, 0644);
+MODULE_PARM_DESC(lowwm_periods, "Queued periods below which a write done holds a wakelock");
+
 struct wake_lock compr_lpa_wakelock;
 struct wake_lock compr_lpa_q6_cb_wakelock;
 
@@ -95,9 +110,9 @@ static struct snd_pcm_hardware msm_compr_hardware_playback = {
 	.rate_max =	     48000,
 	.channels_min =	 1,
 	.channels_max =	 2,
-	.buffer_bytes_max =     2 * 1024 * 1024,
+	.buffer_bytes_max =     COMPRE_PLAYBACK_MAX_BUF_SIZE,
 	.period_bytes_min =	8 * 1024,
-	.period_bytes_max =     1024 * 1024,
+	.period_bytes_max =     COMPRE_PLAYBACK_MAX_BUF_SIZE / 2,
 	.periods_min =	  2,
 	.periods_max =	  256,
 	.fifo_size =	    0,
@@ -136,9 +151,13 @@ static void compr_event_handler(uint32_t opcode,
 	int i = 0;
 	int time_stamp_flag = 0;
 	int buffer_length = 0;
-	wake_lock_timeout(&compr_lpa_q6_cb_wakelock, 1.5 * HZ);
 
-	
+	compr->dsp_events++;
+	if (opcode != ASM_DATA_EVENT_WRITE_DONE) {
+		wake_lock_timeout(&compr_lpa_q6_cb_wakelock, 1.5 * HZ);
+		compr->dsp_awake++;
+	}
+
 	switch (opcode) {
 	case ASM_DATA_EVENT_WRITE_DONE: {
 		uint32_t *ptrmem = (uint32_t *)&param;
@@ -150,6 +169,12 @@ static void compr_event_handler(uint32_t opcode,
 		else
 			if (substream->timer_running)
 				snd_timer_interrupt(substream->timer, 1);
+		if (frames_to_bytes(runtime,
+				snd_pcm_playback_hw_avail(runtime)) <=
+				lowwm_periods * prtd->pcm_count) {
+			wake_lock_timeout(&compr_lpa_q6_cb_wakelock, 1.5 * HZ);
+			compr->dsp_awake++;
+		}
 		atomic_inc(&prtd->out_count);
 		wake_up(&the_locks.write_wait);
 		if (!atomic_read(&prtd->start)) {
@@ -617,6 +642,7 @@ static int msm_compr_open(struct snd_pcm_substream *substream)
 	pr_info("[%p] %s: session ID %d\n", prtd, __func__, prtd->audio_client->session);
 
 	prtd->session_id = prtd->audio_client->session;
+	compr->opened = jiffies;
 
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		runtime->hw = msm_compr_hardware_playback;
@@ -700,6 +726,9 @@ static int msm_compr_playback_close(struct snd_pcm_substream *substream)
 	int dir = 0;
 
 	pr_debug("[%p] %s\n", prtd, __func__);
+	pr_info("[%p] %s: %u DSP events, %u held a wakelock, in %u s\n",
+		prtd, __func__, compr->dsp_events, compr->dsp_awake,
+		jiffies_to_msecs(jiffies - compr->opened) / 1000);
 
 	dir = IN;
 	atomic_set(&prtd->pending_buffer, 0);
@@ -825,7 +854,7 @@ static int msm_compr_hw_params(struct snd_pcm_substream *substream,
 	struct msm_audio *prtd = &compr->prtd;
 	struct snd_dma_buffer *dma_buf = &substream->dma_buffer;
 	struct audio_buffer *buf;
-	int dir, ret;
+	int dir, ret, bufcnt;
 	short bit_width = 16;
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	char * str_name;
@@ -950,10 +979,14 @@ static int msm_compr_hw_params(struct snd_pcm_substream *substream,
 		return -ENOMEM;
 	}
 
+	if (dir == IN)
+		bufcnt = DIV_ROUND_UP(params_buffer_bytes(params),
+				runtime->hw.period_bytes_min);
+	else
+		bufcnt = runtime->hw.periods_max;
 	ret = q6asm_audio_client_buf_alloc_contiguous(dir,
 			prtd->audio_client,
-			runtime->hw.period_bytes_min,
-			runtime->hw.periods_max);
+			runtime->hw.period_bytes_min, bufcnt);
 	if (ret < 0) {
 		pr_err("[%p] Audio Start: Buffer Allocation failed "
 					"rc = %d\n", prtd, ret);
@@ -966,7 +999,7 @@ static int msm_compr_hw_params(struct snd_pcm_substream *substream,
 	dma_buf->private_data = NULL;
 	dma_buf->area = buf[0].data;
 	dma_buf->addr =  buf[0].phys;
-	dma_buf->bytes = runtime->hw.buffer_bytes_max;
+	dma_buf->bytes = runtime->hw.period_bytes_min * bufcnt;
 
 	pr_debug("[%p] %s: buf[%p]dma_buf->area[%p]dma_buf->addr[%p]\n"
 		 "dma_buf->bytes[%d]\n", prtd, __func__,
@@ -31,6 +31,9 @@ struct compr_audio {
 	struct msm_audio prtd;
 	struct compr_info info;
 	uint32_t codec;
+	unsigned long opened;
+	unsigned int dsp_events;
+	unsigned int dsp_awake;
 };
 
 struct msm_compr_q6_ops {
@@ -45,9 +45,10 @@ struct snd_msm_volume {
    unsigned volume;
 };
 
-#define PLAYBACK_NUM_PERIODS       2
+#define PLAYBACK_MIN_NUM_PERIODS   2
+#define PLAYBACK_MAX_NUM_PERIODS   8
 #define PLAYBACK_MAX_PERIOD_SIZE   2048
-#define PLAYBACK_MIN_PERIOD_SIZE   1024
+#define PLAYBACK_MIN_PERIOD_SIZE   512
 #define CAPTURE_NUM_PERIODS        2
 #define CAPTURE_MIN_PERIOD_SIZE        128
 #define CAPTURE_MAX_PERIOD_SIZE        1024
@@ -84,11 +85,11 @@ static struct snd_pcm_hardware msm_pcm_hardware_playback = {
    .rate_max =             48000,
    .channels_min =         1,
    .channels_max =         6,
-   .buffer_bytes_max =     PLAYBACK_NUM_PERIODS * PLAYBACK_MAX_PERIOD_SIZE,
+   .buffer_bytes_max =     PLAYBACK_MAX_NUM_PERIODS * PLAYBACK_MAX_PERIOD_SIZE,
    .period_bytes_min =     PLAYBACK_MIN_PERIOD_SIZE,
    .period_bytes_max =     PLAYBACK_MAX_PERIOD_SIZE,
-   .periods_min =          PLAYBACK_NUM_PERIODS,
-   .periods_max =          PLAYBACK_NUM_PERIODS,
+   .periods_min =          PLAYBACK_MIN_NUM_PERIODS,
+   .periods_max =          PLAYBACK_MAX_NUM_PERIODS,
    .fifo_size =            0,
 };
 
@@ -96,8 +97,38 @@ static unsigned int supported_sample_rates[] = {
    8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000
 };
 
+/* q6asm walks its buffers with a mask */
+static unsigned int playback_periods[] = { 2, 4, 8 };
+
+static struct snd_pcm_hw_constraint_list constraints_playback_periods = {
+   .count = ARRAY_SIZE(playback_periods),
+   .list = playback_periods,
+   .mask = 0,
+};
+
 static uint32_t in_frame_info[CAPTURE_NUM_PERIODS][2];
 
+/*
+ * In mmap mode the DSP is kept periods - 1 buffers ahead and each
+ * WRITE_DONE queues the next one, so the ring runs like free-running DMA
+ * and the one period user space is refilling is the only one not queued.
+ */
+static void msm_pcm_mmap_queue(struct msm_audio *prtd)
+{
+   uint32_t idx = 0;
+   uint32_t size = 0;
+
+   while (atomic_read(&prtd->pending_buffer) < prtd->periods - 1 &&
+          q6asm_is_cpu_buf_avail_nolock(IN, prtd->audio_client,
+               &size, &idx)) {
+       pr_debug("%s:writing %d bytes of buffer to dsp\n",
+               __func__, prtd->pcm_count);
+       q6asm_write_nolock(prtd->audio_client,
+           prtd->pcm_count, 0, 0, NO_TIMESTAMP);
+       atomic_inc(&prtd->pending_buffer);
+   }
+}
+
 static struct snd_pcm_hw_constraint_list constraints_sample_rates = {
    .count = ARRAY_SIZE(supported_sample_rates),
    .list = supported_sample_rates,
@@ -120,6 +151,8 @@ static void event_handler(uint32_t opcode,
        pr_debug("ASM_DATA_EVENT_WRITE_DONE\n");
        pr_debug("Buffer Consumed = 0x%08x\n", *ptrmem);
        prtd->pcm_irq_pos += prtd->pcm_count;
+       if (prtd->mmap_flag)
+           atomic_dec(&prtd->pending_buffer);
        if (atomic_read(&prtd->start))
            snd_pcm_period_elapsed(substream);
        atomic_inc(&prtd->out_count);
@@ -128,14 +161,7 @@ static void event_handler(uint32_t opcode,
            break;
        if (!prtd->mmap_flag)
            break;
-       if (q6asm_is_cpu_buf_avail_nolock(IN,
-               prtd->audio_client,
-               &size, &idx)) {
-           pr_debug("%s:writing %d bytes of buffer to dsp 2\n",
-                   __func__, prtd->pcm_count);
-           q6asm_write_nolock(prtd->audio_client,
-               prtd->pcm_count, 0, 0, NO_TIMESTAMP);
-       }
+       msm_pcm_mmap_queue(prtd);
        break;
    }
    case ASM_DATA_CMDRSP_EOS:
@@ -173,11 +199,7 @@ static void event_handler(uint32_t opcode,
                break;
            }
            if (prtd->mmap_flag) {
-               pr_debug("%s:writing %d bytes buffer to dsp\n",
-                   __func__, prtd->pcm_count);
-               q6asm_write_nolock(prtd->audio_client,
-                   prtd->pcm_count,
-                   0, 0, NO_TIMESTAMP);
+               msm_pcm_mmap_queue(prtd);
            } else {
                while (atomic_read(&prtd->out_needed)) {
                    pr_debug("%s:writing %d bytesto dsp\n",
@@ -227,6 +249,8 @@ static int msm_pcm_playback_prepare(struct snd_pcm_substream *substream)
        pr_info("%s: CMD Format block failed\n", __func__);
 
    atomic_set(&prtd->out_count, runtime->periods);
+   prtd->periods = runtime->periods;
+   atomic_set(&prtd->pending_buffer, 0);
 
    prtd->enabled = 1;
    prtd->cmd_ack = 0;
@@ -372,12 +396,17 @@ static int msm_pcm_open(struct snd_pcm_substream *substream)
    if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
        ret = snd_pcm_hw_constraint_minmax(runtime,
            SNDRV_PCM_HW_PARAM_BUFFER_BYTES,
-           PLAYBACK_NUM_PERIODS * PLAYBACK_MIN_PERIOD_SIZE,
-           PLAYBACK_NUM_PERIODS * PLAYBACK_MAX_PERIOD_SIZE);
+           PLAYBACK_MIN_NUM_PERIODS * PLAYBACK_MIN_PERIOD_SIZE,
+           PLAYBACK_MAX_NUM_PERIODS * PLAYBACK_MAX_PERIOD_SIZE);
        if (ret < 0) {
            pr_err("constraint for buffer bytes min max ret = %d\n",
                                    ret);
        }
+       ret = snd_pcm_hw_constraint_list(runtime, 0,
+           SNDRV_PCM_HW_PARAM_PERIODS,
+           &constraints_playback_periods);
+       if (ret < 0)
+           pr_err("constraint for periods ret = %d\n", ret);
    }
 
    if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
@@ -29,6 +29,7 @@
 #include <linux/debugfs.h>
 #include <linux/time.h>
 #include <linux/atomic.h>
+#include <linux/moduleparam.h>
 
 #include <asm/ioctls.h>
 
@@ -66,6 +67,31 @@
 static DEFINE_MUTEX(session_lock);
 
 static struct audio_client *session[SESSION_MAX+1];
+
+/*
+ * Contiguous session buffers stay allocated and mapped in the ADSP
+ * after the session closes, for the next one asking for the same size.
+ * Mappings are not per session, only an ADSP restart drops them: that
+ * bumps map_cache_gen and entries from before it are never reused.
+ */
+#define MAP_CACHE_NR 4
+
+struct q6asm_map_cache_entry {
+	struct audio_buffer buf;
+	uint32_t size;
+	int gen;
+	bool in_use;
+};
+
+static struct q6asm_map_cache_entry map_cache[MAP_CACHE_NR];
+static DEFINE_MUTEX(map_cache_lock);
+static atomic_t map_cache_gen = ATOMIC_INIT(0);
+static unsigned int map_cache_max_kb = 256;
+module_param(map_cache_max_kb, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int map_cache_hits, map_cache_misses;
+module_param(map_cache_hits, uint, S_IRUGO);
+module_param(map_cache_misses, uint, S_IRUGO);
 static int32_t q6asm_mmapcallback(struct apr_client_data *data, void *priv);
 static int32_t q6asm_callback(struct apr_client_data *data, void *priv);
 static void q6asm_add_hdr(struct audio_client *ac, struct apr_hdr *hdr,
@@ -295,12 +321,164 @@ int q6asm_audio_client_buf_free(unsigned int dir,
 	return 0;
 }
 
+static void q6asm_contig_mem_free(struct audio_buffer *buf)
+{
+#ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
+	ion_unmap_kernel(buf->client, buf->handle);
+	ion_free(buf->client, buf->handle);
+	ion_client_destroy(buf->client);
+	pr_debug("%s:data[%p]phys[%p][%p], client[%p] handle[%p]\n",
+		__func__,
+		(void *)buf->data,
+		(void *)buf->phys,
+		(void *)&buf->phys,
+		(void *)buf->client,
+		(void *)buf->handle);
+#else
+	pr_debug("%s:data[%p]phys[%p][%p] mem_buffer[%p]\n",
+		__func__,
+		(void *)buf->data,
+		(void *)buf->phys,
+		(void *)&buf->phys,
+		(void *)buf->mem_buffer);
+	if (IS_ERR((void *)buf->mem_buffer))
+		pr_err("%s:mem buffer invalid, error = %ld\n",
+			 __func__,
+			PTR_ERR((void *)buf->mem_buffer));
+	else {
+		if (iounmap(buf->mem_buffer) < 0)
+			pr_err("%s: unmap buffer failed\n", __func__);
+	}
+	free_contiguous_memory_by_paddr(buf->phys);
+#endif
+}
+
+/* map_cache_lock held; ac is only used for the unmap command */
+static void q6asm_map_cache_evict(struct audio_client *ac,
+				  struct q6asm_map_cache_entry *e)
+{
+	if (e->gen == atomic_read(&map_cache_gen) &&
+	    q6asm_memory_unmap(ac, e->buf.phys, IN) < 0)
+		pr_err("%s CMD Memory_unmap_regions failed\n", __func__);
+	q6asm_contig_mem_free(&e->buf);
+	memset(e, 0, sizeof(*e));
+}
+
+static bool q6asm_map_cache_get(struct audio_client *ac,
+				struct audio_buffer *buf, uint32_t size)
+{
+	struct q6asm_map_cache_entry *e;
+	bool hit = false;
+	int i;
+
+	mutex_lock(&map_cache_lock);
+	for (i = 0; i < MAP_CACHE_NR; i++) {
+		e = &map_cache[i];
+		if (!e->size || e->in_use)
+			continue;
+		if (e->gen != atomic_read(&map_cache_gen)) {
+			q6asm_map_cache_evict(ac, e);
+			continue;
+		}
+		if (!hit && e->size == size) {
+			*buf = e->buf;
+			e->in_use = true;
+			hit = true;
+		}
+	}
+	if (hit)
+		map_cache_hits++;
+	else
+		map_cache_misses++;
+	mutex_unlock(&map_cache_lock);
+	return hit;
+}
+
+/* A buffer mapped at gen is kept for reuse, if it fits the budget */
+static void q6asm_map_cache_add(struct audio_client *ac,
+				struct audio_buffer *buf, uint32_t size, int gen)
+{
+	struct q6asm_map_cache_entry *e, *slot = NULL;
+	uint32_t total = 0;
+	int i;
+
+	mutex_lock(&map_cache_lock);
+	for (i = 0; i < MAP_CACHE_NR; i++) {
+		e = &map_cache[i];
+		if (e->size && !e->in_use &&
+		    e->gen != atomic_read(&map_cache_gen))
+			q6asm_map_cache_evict(ac, e);
+		total += e->size;
+	}
+	for (i = 0; i < MAP_CACHE_NR; i++) {
+		e = &map_cache[i];
+		if (!slot && !e->size)
+			slot = e;
+		if (total + size > map_cache_max_kb * 1024 &&
+		    e->size && !e->in_use) {
+			total -= e->size;
+			q6asm_map_cache_evict(ac, e);
+			if (!slot)
+				slot = e;
+		}
+	}
+	if (slot && total + size <= map_cache_max_kb * 1024) {
+		slot->buf = *buf;
+		slot->size = size;
+		slot->gen = gen;
+		slot->in_use = true;
+	}
+	mutex_unlock(&map_cache_lock);
+}
+
+/* False if buf is not ours to keep: the caller unmaps and frees it */
+static bool q6asm_map_cache_put(struct audio_buffer *buf)
+{
+	struct q6asm_map_cache_entry *e;
+	bool kept = false;
+	int i;
+
+	mutex_lock(&map_cache_lock);
+	for (i = 0; i < MAP_CACHE_NR; i++) {
+		e = &map_cache[i];
+		if (!e->in_use || e->buf.phys != buf->phys)
+			continue;
+		if (e->gen == atomic_read(&map_cache_gen)) {
+			e->in_use = false;
+			kept = true;
+		} else {
+			memset(e, 0, sizeof(*e));
+		}
+		break;
+	}
+	mutex_unlock(&map_cache_lock);
+	return kept;
+}
+
+/* Gives back what the cache holds when the audio heap runs out */
+static bool q6asm_map_cache_flush(struct audio_client *ac)
+{
+	bool freed = false;
+	int i;
+
+	mutex_lock(&map_cache_lock);
+	for (i = 0; i < MAP_CACHE_NR; i++) {
+		if (map_cache[i].size && !map_cache[i].in_use) {
+			q6asm_map_cache_evict(ac, &map_cache[i]);
+			freed = true;
+		}
+	}
+	mutex_unlock(&map_cache_lock);
+	return freed;
+}
+
 int q6asm_audio_client_buf_free_contiguous(unsigned int dir,
 			struct audio_client *ac)
 {
 	struct audio_port_data *port;
 	int cnt = 0;
 	int rc = 0;
+	bool kept;
 	pr_debug("%s: Session id %d\n", __func__, ac->session);
 	mutex_lock(&ac->cmd_lock);
 	port = &ac->port[dir];
@@ -309,45 +487,17 @@ int q6asm_audio_client_buf_free_contiguous(unsigned int dir,
 		return 0;
 	}
 	cnt = port->max_buf_cnt - 1;
+	kept = port->buf[0].data && q6asm_map_cache_put(&port->buf[0]);
 
-	if (cnt >= 0) {
+	if (cnt >= 0 && !kept) {
 		rc = q6asm_memory_unmap(ac, port->buf[0].phys, dir);
 		if (rc < 0)
 			pr_err("%s CMD Memory_unmap_regions failed\n",
 							__func__);
 	}
 
-	if (port->buf[0].data) {
-#ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
-		ion_unmap_kernel(port->buf[0].client, port->buf[0].handle);
-		ion_free(port->buf[0].client, port->buf[0].handle);
-		ion_client_destroy(port->buf[0].client);
-		pr_debug("%s:data[%p]phys[%p][%p], client[%p] handle[%p]\n",
-			__func__,
-			(void *)port->buf[0].data,
-			(void *)port->buf[0].phys,
-			(void *)&port->buf[0].phys,
-			(void *)port->buf[0].client,
-			(void *)port->buf[0].handle);
-#else
-		pr_debug("%s:data[%p]phys[%p][%p] mem_buffer[%p]\n",
-			__func__,
-			(void *)port->buf[0].data,
-			(void *)port->buf[0].phys,
-			(void *)&port->buf[0].phys,
-			(void *)port->buf[0].mem_buffer);
-		if (IS_ERR((void *)port->buf[0].mem_buffer))
-			pr_err("%s:mem buffer invalid, error = %ld\n",
-				 __func__,
-				PTR_ERR((void *)port->buf[0].mem_buffer));
-		else {
-			if (iounmap(
-				port->buf[0].mem_buffer) < 0)
-				pr_err("%s: unmap buffer failed\n", __func__);
-		}
-		free_contiguous_memory_by_paddr(port->buf[0].phys);
-#endif
-	}
+	if (port->buf[0].data && !kept)
+		q6asm_contig_mem_free(&port->buf[0]);
 
 	while (cnt >= 0) {
 		port->buf[cnt].data = NULL;
@@ -650,6 +800,8 @@ int q6asm_audio_client_buf_alloc_contiguous(unsigned int dir,
 {
 	int cnt = 0;
 	int rc = 0;
+	int gen;
+	bool cached = false;
 	struct audio_buffer *buf;
 #ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
 	int len;
@@ -681,6 +833,12 @@ int q6asm_audio_client_buf_alloc_contiguous(unsigned int dir,
 
 	ac->port[dir].buf = buf;
 
+	if (q6asm_map_cache_get(ac, &buf[0], bufsz * bufcnt)) {
+		memset((void *)buf[0].data, 0, (bufsz * bufcnt));
+		cached = true;
+		goto carve;
+	}
+
 #ifdef CONFIG_MSM_MULTIMEDIA_USE_ION
 	buf[0].client = msm_ion_client_create(UINT_MAX, "audio_client");
 	if (IS_ERR_OR_NULL((void *)buf[0].client)) {
@@ -690,6 +848,10 @@ int q6asm_audio_client_buf_alloc_contiguous(unsigned int dir,
 	}
 	buf[0].handle = ion_alloc(buf[0].client, bufsz * bufcnt, SZ_4K,
 				  (0x1 << ION_AUDIO_HEAP_ID));
+	if (IS_ERR_OR_NULL((void *) buf[0].handle) &&
+	    q6asm_map_cache_flush(ac))
+		buf[0].handle = ion_alloc(buf[0].client, bufsz * bufcnt,
+					  SZ_4K, (0x1 << ION_AUDIO_HEAP_ID));
 	if (IS_ERR_OR_NULL((void *) buf[0].handle)) {
 		pr_err("%s: ION memory allocation for AUDIO failed\n",
 			__func__);
@@ -733,6 +895,7 @@ int q6asm_audio_client_buf_alloc_contiguous(unsigned int dir,
 	}
 	buf[0].data = buf[0].mem_buffer;
 #endif
+carve:
 	if (!buf[0].data) {
 		pr_err("%s:invalid vaddr, iomap failed\n", __func__);
 		mutex_unlock(&ac->cmd_lock);
@@ -768,11 +931,15 @@ int q6asm_audio_client_buf_alloc_contiguous(unsigned int dir,
 	pr_debug("%s ac->port[%d].max_buf_cnt[%d]\n", __func__, dir,
 			 ac->port[dir].max_buf_cnt);
 	mutex_unlock(&ac->cmd_lock);
+	if (cached)
+		return 0;
+	gen = atomic_read(&map_cache_gen);
 	rc = q6asm_memory_map(ac, buf[0].phys, dir, bufsz, cnt);
 	if (rc < 0) {
 		pr_err("%s:CMD Memory_map_regions failed\n", __func__);
 		goto fail;
 	}
+	q6asm_map_cache_add(ac, &buf[0], bufsz * bufcnt, gen);
 	return 0;
 fail:
 	q6asm_audio_client_buf_free_contiguous(dir, ac);
@@ -793,6 +960,7 @@ static int32_t q6asm_mmapcallback(struct apr_client_data *data, void *priv)
 		apr_reset(this_mmap.apr);
 		this_mmap.apr = NULL;
 		atomic_set(&this_mmap.cmd_state, 0);
+		atomic_inc(&map_cache_gen);
 		return 0;
 	}
 
@@ -0,0 +1,432 @@
+/*
+ * binder_bench - binder transaction latency versus payload size
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * A child process becomes the context manager and replies to every
+ * transaction with an empty parcel, the parent times round trips to it.
+ * The payload is made of a number of separate pieces, like a parcel that
+ * carries a few blobs.  By default the pieces are first flattened into one
+ * buffer and sent with BC_TRANSACTION, with -g they are handed to the
+ * driver as is with BC_TRANSACTION_SG.
+ *
+ * The context manager can only be set once, stop servicemanager before
+ * running this on a live system.
+ */
+
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binder.h"
+
+#define MAP_SIZE	(1024 * 1024)
+
+static const size_t default_sizes[] = {
+	0, 64, 256, 1024, 4096, 16384, 65536, 262144
+};
+
+static int binder_open(const char *dev, void **map)
+{
+	int fd = open(dev, O_RDWR);
+
+	if (fd < 0) {
+		perror(dev);
+		return -1;
+	}
+	*map = mmap(NULL, MAP_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (*map == MAP_FAILED) {
+		perror("mmap");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int binder_write_read(int fd, void *wbuf, size_t wsize,
+			     void *rbuf, size_t rsize, size_t *consumed)
+{
+	struct binder_write_read bwr;
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_buffer = (unsigned long)wbuf;
+	bwr.write_size = wsize;
+	bwr.read_buffer = (unsigned long)rbuf;
+	bwr.read_size = rsize;
+
+	do {
+		if (ioctl(fd, BINDER_WRITE_READ, &bwr) >= 0) {
+			if (consumed)
+				*consumed = bwr.read_consumed;
+			return 0;
+		}
+	} while (errno == EINTR);
+
+	perror("BINDER_WRITE_READ");
+	return -1;
+}
+
+/* Skip the arguments of a return command, returns NULL for unknown ones */
+static char *skip_return(uint32_t cmd, char *ptr)
+{
+	switch (cmd) {
+	case BR_NOOP:
+	case BR_TRANSACTION_COMPLETE:
+	case BR_SPAWN_LOOPER:
+	case BR_OK:
+		return ptr;
+	case BR_INCREFS:
+	case BR_ACQUIRE:
+	case BR_RELEASE:
+	case BR_DECREFS:
+		return ptr + sizeof(struct binder_ptr_cookie);
+	default:
+		return NULL;
+	}
+}
+
+static void server(const char *dev, int ready)
+{
+	uint32_t rbuf[256];
+	struct {
+		uint32_t free_cmd;
+		const void *buffer;
+		uint32_t reply_cmd;
+		struct binder_transaction_data tr;
+	} __attribute__((packed)) reply;
+	uint32_t cmd;
+	void *map;
+	char status = 1;
+	int fd;
+
+	fd = binder_open(dev, &map);
+	if (fd >= 0 && ioctl(fd, BINDER_SET_CONTEXT_MGR, 0) < 0) {
+		perror("BINDER_SET_CONTEXT_MGR");
+		fd = -1;
+	}
+	if (fd >= 0)
+		status = 0;
+	if (write(ready, &status, 1) != 1 || status)
+		exit(1);
+
+	cmd = BC_ENTER_LOOPER;
+	if (binder_write_read(fd, &cmd, sizeof(cmd), NULL, 0, NULL))
+		exit(1);
+
+	memset(&reply, 0, sizeof(reply));
+	reply.free_cmd = BC_FREE_BUFFER;
+	reply.reply_cmd = BC_REPLY;
+
+	for (;;) {
+		size_t consumed;
+		char *ptr, *end;
+
+		if (binder_write_read(fd, NULL, 0, rbuf, sizeof(rbuf),
+				      &consumed))
+			exit(1);
+
+		ptr = (char *)rbuf;
+		end = ptr + consumed;
+		while (ptr < end) {
+			struct binder_transaction_data *txn;
+
+			memcpy(&cmd, ptr, sizeof(cmd));
+			ptr += sizeof(cmd);
+			if (cmd != BR_TRANSACTION) {
+				ptr = skip_return(cmd, ptr);
+				if (ptr == NULL) {
+					fprintf(stderr, "server: unexpected "
+						"return %08x\n", cmd);
+					exit(1);
+				}
+				continue;
+			}
+
+			txn = (struct binder_transaction_data *)ptr;
+			ptr += sizeof(*txn);
+			reply.buffer = txn->data.ptr.buffer;
+			if (binder_write_read(fd, &reply, sizeof(reply),
+					      NULL, 0, NULL))
+				exit(1);
+		}
+	}
+}
+
+struct client {
+	int fd;
+	const void *pending_free;
+	int use_sg;
+	int pieces;
+	void **piece;
+	size_t *piece_size;
+	char *flat;
+	struct binder_sg_entry *sg;
+};
+
+static int client_transact(struct client *c)
+{
+	char wbuf[2 * sizeof(uint32_t) + sizeof(void *) +
+		  sizeof(struct binder_transaction_data_sg)];
+	struct binder_transaction_data_sg sg;
+	struct binder_transaction_data *tr = &sg.transaction_data;
+	uint32_t rbuf[64];
+	uint32_t cmd;
+	size_t wsize = 0;
+	int i;
+
+	if (c->pending_free) {
+		cmd = BC_FREE_BUFFER;
+		memcpy(wbuf, &cmd, sizeof(cmd));
+		memcpy(wbuf + sizeof(cmd), &c->pending_free, sizeof(void *));
+		wsize = sizeof(cmd) + sizeof(void *);
+	}
+
+	memset(&sg, 0, sizeof(sg));
+	tr->target.handle = 0;
+	tr->code = 1;
+
+	if (c->use_sg) {
+		for (i = 0; i < c->pieces; i++) {
+			c->sg[i].buffer = c->piece[i];
+			c->sg[i].size = c->piece_size[i];
+			tr->data_size += (c->piece_size[i] +
+					  sizeof(void *) - 1) &
+					 ~(sizeof(void *) - 1);
+		}
+		sg.entries = c->sg;
+		sg.entries_count = c->pieces;
+
+		cmd = BC_TRANSACTION_SG;
+		memcpy(wbuf + wsize, &cmd, sizeof(cmd));
+		memcpy(wbuf + wsize + sizeof(cmd), &sg, sizeof(sg));
+		wsize += sizeof(cmd) + sizeof(sg);
+	} else {
+		/* What libbinder does to build the parcel */
+		for (i = 0; i < c->pieces; i++) {
+			memcpy(c->flat + tr->data_size, c->piece[i],
+			       c->piece_size[i]);
+			tr->data_size += c->piece_size[i];
+		}
+		tr->data.ptr.buffer = c->flat;
+
+		cmd = BC_TRANSACTION;
+		memcpy(wbuf + wsize, &cmd, sizeof(cmd));
+		memcpy(wbuf + wsize + sizeof(cmd), tr, sizeof(*tr));
+		wsize += sizeof(cmd) + sizeof(*tr);
+	}
+
+	c->pending_free = NULL;
+	if (binder_write_read(c->fd, wbuf, wsize, NULL, 0, NULL))
+		return -1;
+
+	for (;;) {
+		size_t consumed;
+		char *ptr, *end;
+
+		if (binder_write_read(c->fd, NULL, 0, rbuf, sizeof(rbuf),
+				      &consumed))
+			return -1;
+
+		ptr = (char *)rbuf;
+		end = ptr + consumed;
+		while (ptr < end) {
+			memcpy(&cmd, ptr, sizeof(cmd));
+			ptr += sizeof(cmd);
+			if (cmd == BR_REPLY) {
+				struct binder_transaction_data *txn =
+					(struct binder_transaction_data *)ptr;
+
+				c->pending_free = txn->data.ptr.buffer;
+				return 0;
+			}
+			if (cmd == BR_DEAD_REPLY || cmd == BR_FAILED_REPLY) {
+				fprintf(stderr, "transaction failed %08x\n",
+					cmd);
+				return -1;
+			}
+			ptr = skip_return(cmd, ptr);
+			if (ptr == NULL) {
+				fprintf(stderr, "client: unexpected return "
+					"%08x\n", cmd);
+				return -1;
+			}
+		}
+	}
+}
+
+static int client_setup(struct client *c, size_t size)
+{
+	size_t each = (size / c->pieces) & ~(sizeof(void *) - 1);
+	int i;
+
+	for (i = 0; i < c->pieces; i++) {
+		c->piece_size[i] = i == c->pieces - 1 ?
+			size - each * (c->pieces - 1) : each;
+		free(c->piece[i]);
+		c->piece[i] = malloc(c->piece_size[i] + 1);
+		if (c->piece[i] == NULL)
+			return -1;
+		memset(c->piece[i], i, c->piece_size[i]);
+	}
+	free(c->flat);
+	c->flat = malloc(size + 1);
+	return c->flat ? 0 : -1;
+}
+
+static double ts_us(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e6 + (b->tv_nsec - a->tv_nsec) / 1e3;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-d device] [-n iterations] [-p pieces] "
+		"[-g] [size...]\n"
+		"  -g  send the pieces with BC_TRANSACTION_SG instead of "
+		"flattening them\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = "/dev/binder";
+	struct client c;
+	size_t *sizes = NULL;
+	int nsizes, iterations = 10000;
+	int ready[2], opt, i, n, ret = 0;
+	char status;
+	void *map;
+	pid_t pid;
+
+	memset(&c, 0, sizeof(c));
+	c.pieces = 4;
+
+	while ((opt = getopt(argc, argv, "d:n:p:g")) != -1) {
+		switch (opt) {
+		case 'd':
+			dev = optarg;
+			break;
+		case 'n':
+			iterations = atoi(optarg);
+			break;
+		case 'p':
+			c.pieces = atoi(optarg);
+			break;
+		case 'g':
+			c.use_sg = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (iterations <= 0 || c.pieces <= 0 ||
+	    c.pieces > BINDER_SG_MAX_ENTRIES)
+		usage(argv[0]);
+
+	nsizes = argc - optind;
+	if (nsizes) {
+		sizes = calloc(nsizes, sizeof(*sizes));
+		if (sizes == NULL)
+			return 1;
+		for (i = 0; i < nsizes; i++)
+			sizes[i] = strtoul(argv[optind + i], NULL, 0);
+	} else {
+		nsizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+	}
+
+	c.piece = calloc(c.pieces, sizeof(*c.piece));
+	c.piece_size = calloc(c.pieces, sizeof(*c.piece_size));
+	c.sg = calloc(c.pieces, sizeof(*c.sg));
+	if (c.piece == NULL || c.piece_size == NULL || c.sg == NULL)
+		return 1;
+
+	if (pipe(ready))
+		return 1;
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		close(ready[0]);
+		server(dev, ready[1]);
+		exit(0);
+	}
+	close(ready[1]);
+	if (read(ready[0], &status, 1) != 1 || status) {
+		fprintf(stderr, "server failed to start\n");
+		waitpid(pid, NULL, 0);
+		return 1;
+	}
+
+	c.fd = binder_open(dev, &map);
+	if (c.fd < 0) {
+		ret = 1;
+		goto out;
+	}
+
+	printf("%s, %d pieces, %d iterations\n",
+	       c.use_sg ? "BC_TRANSACTION_SG" : "BC_TRANSACTION",
+	       c.pieces, iterations);
+	printf("%10s %10s %10s %10s\n", "size", "avg(us)", "min(us)",
+	       "max(us)");
+
+	for (i = 0; i < nsizes; i++) {
+		size_t size = sizes ? sizes[i] : default_sizes[i];
+		double total = 0, min = 1e12, max = 0;
+
+		if (client_setup(&c, size)) {
+			fprintf(stderr, "out of memory\n");
+			ret = 1;
+			goto out;
+		}
+
+		for (n = 0; n < iterations; n++) {
+			struct timespec start, end;
+			double us;
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			if (client_transact(&c)) {
+				ret = 1;
+				goto out;
+			}
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			us = ts_us(&start, &end);
+			total += us;
+			if (us < min)
+				min = us;
+			if (us > max)
+				max = us;
+		}
+
+		printf("%10zu %10.1f %10.1f %10.1f\n", size,
+		       total / iterations, min, max);
+	}
+
+out:
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	return ret;
+}